@@ -0,0 +1,330 @@
+//=======================================================================
+// Copyright (c) 2014-2017 Baptiste Wicht
+// Distributed under the terms of the MIT License.
+// (See accompanying file LICENSE or copy at
+//  http://opensource.org/licenses/MIT)
+//=======================================================================
+
+/*!
+ * \file
+ * \brief Visualizer of the filters of a RBM rendering from a separate thread
+ */
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <iomanip>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+
+#include "watcher.hpp"
+#include "ocv_visualizer.hpp"
+
+namespace dll {
+
+/*!
+ * \brief A RBM watcher drawing the filters without stalling the training.
+ *
+ * Every interval batches, and at the end of each epoch, the filters are
+ * copied into a snapshot, published through a lock-free triple buffer. A
+ * render thread draws the latest snapshot and writes it as a PNG tile in
+ * directory and/or shows it in a window (display). When the renderer is
+ * slower than the snapshots, the intermediate snapshots are overwritten,
+ * the training thread never waits on rendering.
+ *
+ * \tparam RBM The type of RBM
+ * \tparam C The configuration of the drawing (rbm_ocv_config)
+ */
+template <typename RBM, typename C = rbm_ocv_config<>>
+struct async_rbm_visualizer : default_rbm_watcher<RBM> {
+    using rbm_t     = RBM;                      ///< The type of the RBM
+    using weight    = typename rbm_t::weight;   ///< The type of the weights
+    using base_type = default_rbm_watcher<RBM>; ///< The base watcher
+
+    static constexpr bool conv = layer_traits<RBM>::is_convolutional_rbm_layer(); ///< Indicates if the RBM is convolutional
+
+    static inline size_t interval = 100;  ///< The number of batches between two snapshots (0 for epochs only)
+    static inline std::string directory;  ///< The directory of the PNG tiles (none if empty)
+    static inline bool display    = false; ///< Show the filters in a window
+
+    static constexpr auto scale   = C::scale;   ///< The scale
+    static constexpr auto padding = C::padding; ///< The padding
+
+    async_rbm_visualizer() = default;
+
+    async_rbm_visualizer(async_rbm_visualizer&& rhs) = default;
+    async_rbm_visualizer& operator=(async_rbm_visualizer&& rhs) = default;
+
+    /*!
+     * \brief Stop the render thread if it is still running
+     */
+    ~async_rbm_visualizer() {
+        stop_renderer();
+    }
+
+    /*!
+     * \brief Indicates that the training of the given RBM started.
+     * \param rbm The rbm that started training.
+     */
+    void training_begin(const RBM& rbm) {
+        base_type::training_begin(rbm);
+
+        stop_renderer();
+
+        state = std::make_unique<render_state>();
+
+        for (auto& snapshot : state->buffers) {
+            snapshot.filters = etl::dyn_matrix<weight, 3>(filters(), filter_width(), filter_height());
+        }
+
+        state->thread = std::thread([this] { render_loop(*state); });
+
+        publish(rbm, 0, 0);
+    }
+
+    /*!
+     * \brief Indicates the end of a batch of pretraining.
+     * \param rbm The RBM being trained
+     * \param context The RBM's training context
+     * \param batch The batch that just finished training
+     * \param batches The total number of batches
+     */
+    void batch_end(const RBM& rbm, const rbm_training_context& context, size_t batch, size_t batches) {
+        cpp_unused(context);
+        cpp_unused(batches);
+
+        if (interval && batch % interval == 0) {
+            publish(rbm, epoch, batch);
+        }
+    }
+
+    /*!
+     * \brief Indicates the end of an epoch of pretraining.
+     * \param epoch The epoch that just finished training
+     * \param context The RBM's training context
+     * \param rbm The RBM being trained
+     */
+    void epoch_end(size_t epoch, const rbm_training_context& context, const RBM& rbm) {
+        base_type::epoch_end(epoch, context, rbm);
+
+        publish(rbm, epoch, 0);
+
+        this->epoch = epoch + 1;
+    }
+
+    /*!
+     * \brief Indicates the end of pretraining.
+     * \param rbm The RBM being trained
+     */
+    void training_end(const RBM& rbm) {
+        stop_renderer();
+
+        base_type::training_end(rbm);
+    }
+
+    /*!
+     * \brief Returns the number of snapshots rendered so far
+     */
+    size_t rendered_snapshots() const {
+        return state ? state->rendered.load() : 0;
+    }
+
+    /*!
+     * \brief Returns the number of snapshots overwritten before being
+     * rendered
+     */
+    size_t skipped_snapshots() const {
+        return state ? state->skipped.load() : 0;
+    }
+
+private:
+    static constexpr size_t fresh = 4; ///< The flag of a published snapshot in the middle index
+
+    /*!
+     * \brief The filters of the RBM at one point of the training
+     */
+    struct snapshot {
+        etl::dyn_matrix<weight, 3> filters; ///< The filters
+        size_t epoch = 0;                   ///< The epoch of the snapshot
+        size_t batch = 0;                   ///< The batch of the snapshot
+    };
+
+    /*!
+     * \brief The state shared with the render thread
+     */
+    struct render_state {
+        std::array<snapshot, 3> buffers; ///< The triple buffer of snapshots
+
+        size_t back  = 0;           ///< The buffer written by the training thread
+        size_t front = 2;           ///< The buffer read by the render thread
+        std::atomic<size_t> middle; ///< The exchanged buffer (with the fresh flag)
+
+        std::atomic<bool> stop;        ///< Indicates that the render thread must stop
+        std::atomic<size_t> rendered;  ///< The number of rendered snapshots
+        std::atomic<size_t> skipped;   ///< The number of overwritten snapshots
+
+        std::thread thread; ///< The render thread
+
+        render_state() : middle(1), stop(false), rendered(0), skipped(0) {}
+    };
+
+    /*!
+     * \brief Returns the number of filters
+     */
+    static constexpr size_t filters() {
+        if constexpr (conv) {
+            return rbm_t::K;
+        } else {
+            return rbm_t::num_hidden;
+        }
+    }
+
+    /*!
+     * \brief Returns the width of a filter
+     */
+    static constexpr size_t filter_width() {
+        if constexpr (conv) {
+            return rbm_t::NW1;
+        } else {
+            return detail::best_width(rbm_t::num_visible);
+        }
+    }
+
+    /*!
+     * \brief Returns the height of a filter
+     */
+    static constexpr size_t filter_height() {
+        if constexpr (conv) {
+            return rbm_t::NW2;
+        } else {
+            return detail::best_height(rbm_t::num_visible);
+        }
+    }
+
+    /*!
+     * \brief Copy the filters of the RBM in a snapshot and publish it
+     */
+    void publish(const RBM& rbm, size_t epoch, size_t batch) {
+        if (!state) {
+            return;
+        }
+
+        auto& snapshot = state->buffers[state->back];
+
+        if constexpr (conv) {
+            // Only the filters of the first channel are drawn
+            snapshot.filters = rbm.w(0);
+        } else {
+            snapshot.filters = 0;
+
+            for (size_t h = 0; h < filters(); ++h) {
+                for (size_t v = 0; v < rbm_t::num_visible; ++v) {
+                    snapshot.filters(h, v / filter_height(), v % filter_height()) = rbm.w(v, h);
+                }
+            }
+        }
+
+        snapshot.epoch = epoch;
+        snapshot.batch = batch;
+
+        const size_t previous = state->middle.exchange(state->back | fresh, std::memory_order_acq_rel);
+
+        if (previous & fresh) {
+            ++state->skipped;
+        }
+
+        state->back = previous & ~fresh;
+    }
+
+    /*!
+     * \brief The main function of the render thread
+     */
+    void render_loop(render_state& s) {
+        while (true) {
+            const bool stop = s.stop.load(std::memory_order_acquire);
+
+            if (s.middle.load(std::memory_order_acquire) & fresh) {
+                s.front = s.middle.exchange(s.front, std::memory_order_acq_rel) & ~fresh;
+
+                render(s.buffers[s.front]);
+
+                ++s.rendered;
+            } else if (stop) {
+                break;
+            } else {
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            }
+        }
+    }
+
+    /*!
+     * \brief Draw the given snapshot and write and/or show it
+     */
+    void render(const snapshot& snapshot) {
+        const size_t tile_width  = detail::best_width(filters());
+        const size_t tile_height = detail::best_height(filters());
+
+        cv::Mat image(cv::Size(tile_height * (filter_height() + 1) + 1 + 2 * padding, tile_width * (filter_width() + 1) + 1 + 2 * padding), CV_8UC1);
+
+        image = cv::Scalar(255);
+
+        std::string title = "epoch " + std::to_string(snapshot.epoch) + " batch " + std::to_string(snapshot.batch);
+        cv::putText(image, title, cv::Point(10, 12), CV_FONT_NORMAL, 0.3, cv::Scalar(0), 1, 2);
+
+        for (size_t f = 0; f < filters(); ++f) {
+            const size_t hi = f / tile_height;
+            const size_t hj = f % tile_height;
+
+            auto filter = snapshot.filters(f);
+
+            weight min = 0;
+            weight max = 1;
+
+            if (scale) {
+                min = etl::min(filter);
+                max = etl::max(filter);
+            }
+
+            for (size_t i = 0; i < filter_width(); ++i) {
+                for (size_t j = 0; j < filter_height(); ++j) {
+                    auto value = (filter(i, j) - min) / (max - min + 1e-8);
+
+                    image.template at<uint8_t>(padding + 1 + hi * (filter_width() + 1) + i, padding + 1 + hj * (filter_height() + 1) + j) = value * 255;
+                }
+            }
+        }
+
+        if (!directory.empty()) {
+            std::stringstream file;
+            file << directory << "/filters_" << std::setfill('0') << std::setw(4) << snapshot.epoch << "_" << std::setw(6) << snapshot.batch << ".png";
+
+            if (!cv::imwrite(file.str(), image)) {
+                std::cerr << "ERROR: Impossible to write the filters to " << file.str() << std::endl;
+            }
+        }
+
+        if (display) {
+            cv::imshow("RBM Training", image);
+            cv::waitKey(1);
+        }
+    }
+
+    /*!
+     * \brief Render the last snapshot and stop the render thread
+     */
+    void stop_renderer() {
+        if (state && state->thread.joinable()) {
+            state->stop.store(true, std::memory_order_release);
+            state->thread.join();
+        }
+    }
+
+    std::unique_ptr<render_state> state; ///< The state shared with the render thread
+    size_t epoch = 0;                    ///< The current epoch
+};
+
+} //end of dll namespace
@@ -0,0 +1,368 @@
+//=======================================================================
+// Copyright (c) 2014-2017 Baptiste Wicht
+// Distributed under the terms of the MIT License.
+// (See accompanying file LICENSE or copy at
+//  http://opensource.org/licenses/MIT)
+//=======================================================================
+
+/*!
+ * \file
+ * \brief Watcher reporting the batch metrics from a separate thread
+ */
+
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include "watcher.hpp"
+#include "util/spsc_queue.hpp"
+
+namespace dll {
+
+/*!
+ * \brief A DBN watcher with a low overhead on the training thread.
+ *
+ * At the end of each batch, the metrics of the batch are only pushed in
+ * a lock-free queue. A reporter thread consumes the queue, aggregates the
+ * metrics and prints them once per interval (interval_ms). When file is
+ * set, each aggregate is also appended to this file, as one JSON object
+ * per line.
+ *
+ * The queue is flushed at the end of each epoch, before the epoch is
+ * reported like in the default watcher. If the reporter cannot keep up,
+ * the metrics of some batches are dropped (and counted), the training is
+ * never blocked.
+ */
+template <typename DBN>
+struct async_dbn_watcher : default_dbn_watcher<DBN> {
+    using base_type = default_dbn_watcher<DBN>; ///< The base watcher
+
+    static constexpr size_t queue_size = 4096; ///< The capacity of the queue of batch metrics
+
+    static inline size_t interval_ms = 1000; ///< The interval between two reports (ms)
+    static inline std::string file;          ///< The file of the JSON reports (none if empty)
+
+    /*!
+     * \brief The metrics of one batch
+     */
+    struct batch_record {
+        size_t epoch;    ///< The epoch of the batch
+        size_t batch;    ///< The index of the batch
+        size_t batches;  ///< The number of batches in the epoch
+        double error;    ///< The error on the batch
+        double loss;     ///< The loss on the batch
+        size_t duration; ///< The duration of the batch (ns)
+    };
+
+    async_dbn_watcher() = default;
+
+    async_dbn_watcher(async_dbn_watcher&& rhs) = default;
+    async_dbn_watcher& operator=(async_dbn_watcher&& rhs) = default;
+
+    /*!
+     * \brief Stop the reporter thread if it is still running
+     */
+    ~async_dbn_watcher() {
+        stop_reporter();
+    }
+
+    /*!
+     * \brief Fine-tuning of the given network just started
+     * \param dbn The DBN that is being trained
+     * \param max_epochs The maximum number of epochs
+     */
+    void fine_tuning_begin(const DBN& dbn, size_t max_epochs) {
+        base_type::fine_tuning_begin(dbn, max_epochs);
+
+        stop_reporter();
+
+        state = std::make_unique<reporter_state>();
+
+        if (!file.empty()) {
+            state->stream.open(file);
+
+            if (!state->stream) {
+                std::cerr << "ERROR: Impossible to open the report file " << file << std::endl;
+            }
+        }
+
+        state->thread = std::thread([this] { report_loop(*state); });
+    }
+
+    /*!
+     * \brief Indicates the beginning of a fine-tuning batch
+     * \param epoch The current epoch
+     * \param dbn The DBN being trained
+     */
+    void ft_batch_start(size_t epoch, const DBN& dbn) {
+        cpp_unused(epoch);
+        cpp_unused(dbn);
+
+        batch_start = std::chrono::steady_clock::now();
+    }
+
+    /*!
+     * \brief Indicates the end of a fine-tuning batch
+     * \param epoch The current epoch
+     * \param batch The current batch
+     * \param batches THe total number of batches
+     * \param batch_error The batch error
+     * \param batch_loss The batch loss
+     * \param dbn The DBN being trained
+     */
+    void ft_batch_end(size_t epoch, size_t batch, size_t batches, double batch_error, double batch_loss, const DBN& dbn) {
+        cpp_unused(dbn);
+
+        const size_t duration = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - batch_start).count();
+
+        if (state) {
+            state->queue.push({epoch, batch, batches, batch_error, batch_loss, duration});
+        }
+
+        this->max_batches = batches;
+    }
+
+    /*!
+     * \brief One fine-tuning epoch is over
+     * \param epoch The current epoch
+     * \param error The current error
+     * \param loss The current loss
+     * \param dbn The network being trained
+     */
+    void ft_epoch_end(size_t epoch, double error, double loss, const DBN& dbn) {
+        flush();
+
+        base_type::ft_epoch_end(epoch, error, loss, dbn);
+    }
+
+    /*!
+     * \brief One fine-tuning epoch is over
+     * \param epoch The current epoch
+     * \param train_error The current error
+     * \param train_loss The current loss
+     * \param val_error The current validation error
+     * \param val_loss The current validation loss
+     * \param dbn The network being trained
+     */
+    void ft_epoch_end(size_t epoch, double train_error, double train_loss, double val_error, double val_loss, const DBN& dbn) {
+        flush();
+
+        base_type::ft_epoch_end(epoch, train_error, train_loss, val_error, val_loss, dbn);
+    }
+
+    /*!
+     * \brief Fine-tuning of the given network just finished
+     * \param dbn The DBN that is being trained
+     */
+    void fine_tuning_end(const DBN& dbn) {
+        stop_reporter();
+
+        base_type::fine_tuning_end(dbn);
+    }
+
+    /*!
+     * \brief Wait for the reporter to consume and report all the batch
+     * metrics pushed so far
+     */
+    void flush() {
+        if (!state || !state->thread.joinable()) {
+            return;
+        }
+
+        std::unique_lock<std::mutex> lock(state->lock);
+
+        const size_t ticket = ++state->requested;
+
+        state->condition.notify_all();
+        state->condition.wait(lock, [this, ticket] { return state->flushed >= ticket; });
+    }
+
+    /*!
+     * \brief Returns the number of batch metrics consumed by the reporter
+     */
+    size_t reported_batches() const {
+        return state ? state->reported.load() : 0;
+    }
+
+    /*!
+     * \brief Returns the number of batch metrics dropped because the
+     * reporter could not keep up
+     */
+    size_t dropped_batches() const {
+        return state ? state->queue.drops() : 0;
+    }
+
+private:
+    /*!
+     * \brief The state shared with the reporter thread
+     */
+    struct reporter_state {
+        spsc_queue<batch_record, queue_size> queue; ///< The batch metrics not yet consumed
+        std::atomic<size_t> reported{0};            ///< The number of batch metrics consumed
+
+        std::mutex lock;                   ///< The lock for the flush requests
+        std::condition_variable condition; ///< The condition for the flush requests
+        size_t requested = 0;              ///< The last flush requested
+        size_t flushed   = 0;              ///< The last flush done
+        bool done        = false;          ///< Indicates that the reporter must stop
+
+        std::ofstream stream; ///< The stream of the JSON reports
+        std::thread thread;   ///< The reporter thread
+    };
+
+    /*!
+     * \brief The metrics aggregated since the last report
+     */
+    struct aggregate {
+        size_t count    = 0;   ///< The number of batches
+        double error    = 0.0; ///< The sum of the errors
+        double loss     = 0.0; ///< The sum of the losses
+        size_t duration = 0;   ///< The sum of the durations (ns)
+
+        batch_record last; ///< The last batch
+    };
+
+    /*!
+     * \brief The loop of the reporter thread
+     */
+    void report_loop(reporter_state& s) {
+        // The queue is polled often enough to never be full in practice
+        const auto poll     = std::chrono::milliseconds(std::min<size_t>(interval_ms, 10));
+        const auto interval = std::chrono::milliseconds(interval_ms);
+
+        aggregate current;
+        auto last_report = std::chrono::steady_clock::now();
+
+        std::unique_lock<std::mutex> lock(s.lock);
+
+        while (true) {
+            s.condition.wait_for(lock, poll, [&s] { return s.done || s.requested > s.flushed; });
+
+            // The lock is not needed to consume the queue
+            lock.unlock();
+
+            batch_record record;
+            while (s.queue.pop(record)) {
+                ++current.count;
+                current.error += record.error;
+                current.loss += record.loss;
+                current.duration += record.duration;
+                current.last = record;
+
+                ++s.reported;
+            }
+
+            lock.lock();
+
+            const bool flushing = s.done || s.requested > s.flushed;
+            const auto now      = std::chrono::steady_clock::now();
+
+            if (current.count && (flushing || now - last_report >= interval)) {
+                report(s, current, !flushing);
+
+                current     = aggregate();
+                last_report = now;
+            }
+
+            if (flushing) {
+                clear_line();
+
+                s.flushed = s.requested;
+                s.condition.notify_all();
+
+                if (s.done) {
+                    break;
+                }
+            }
+        }
+    }
+
+    /*!
+     * \brief Report the given aggregate
+     * \param s The state of the reporter
+     * \param current The aggregated metrics
+     * \param console Indicates if the aggregate is printed on the console
+     */
+    void report(reporter_state& s, const aggregate& current, bool console) {
+        const double error    = current.error / current.count;
+        const double loss     = current.loss / current.count;
+        const double batch_ms = (current.duration / current.count) * 1e-6;
+        const size_t dropped  = s.queue.drops();
+        const auto& last      = current.last;
+
+        if (s.stream) {
+            s.stream << "{\"epoch\": " << last.epoch
+                     << ", \"batch\": " << last.batch + 1
+                     << ", \"batches\": " << last.batches
+                     << ", \"count\": " << current.count
+                     << ", \"error\": " << error
+                     << ", \"loss\": " << loss
+                     << ", \"batch_time_ms\": " << batch_ms
+                     << ", \"dropped\": " << dropped << "}" << std::endl;
+        }
+
+        if (!console) {
+            return;
+        }
+
+        char buffer[512];
+        snprintf(buffer, 512, "epoch %3ld/%ld batch %4ld/%4ld - error: %.5f loss: %.5f (%ld batches, %.3fms/batch)",
+                 last.epoch, this->ft_max_epochs, last.batch + 1, last.batches, error, loss, current.count, batch_ms);
+
+        if constexpr (dbn_traits<DBN>::is_verbose()) {
+            std::cout << buffer << std::endl;
+        } else {
+            std::cout << "\r" << buffer;
+
+            if (strlen(buffer) < this->last_line_length) {
+                std::cout << std::string(this->last_line_length - strlen(buffer), ' ');
+            }
+
+            std::cout.flush();
+
+            this->last_line_length = strlen(buffer);
+        }
+    }
+
+    /*!
+     * \brief Clear the progress line before the report of the epoch
+     */
+    void clear_line() {
+        if constexpr (!dbn_traits<DBN>::is_verbose()) {
+            if (this->last_line_length) {
+                std::cout << "\r" << std::string(this->last_line_length, ' ');
+                std::cout.flush();
+
+                this->last_line_length = 0;
+            }
+        }
+    }
+
+    /*!
+     * \brief Stop the reporter thread, after it consumed all the batch
+     * metrics
+     */
+    void stop_reporter() {
+        if (!state || !state->thread.joinable()) {
+            return;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(state->lock);
+            state->done = true;
+            state->condition.notify_all();
+        }
+
+        state->thread.join();
+        state->stream.close();
+    }
+
+    std::chrono::steady_clock::time_point batch_start; ///< The start of the current batch
+    std::unique_ptr<reporter_state> state;             ///< The state of the reporter of the last training
+};
+
+} //end of dll namespace
@@ -0,0 +1,336 @@
+//=======================================================================
+// Copyright (c) 2014-2017 Baptiste Wicht
+// Distributed under the terms of the MIT License.
+// (See accompanying file LICENSE or copy at
+//  http://opensource.org/licenses/MIT)
+//=======================================================================
+
+#pragma once
+
+#include <array>
+#include <fstream>
+#include <tuple>
+
+#include "cpp_utils/assert.hpp"         //Assertions
+
+#include "etl/etl.hpp"
+
+#include "layer.hpp"
+#include "layer_traits.hpp"
+#include "util/time_major.hpp"
+#include "util/scheduler.hpp"
+#include "trainer/sgd_context.hpp" // For has_weights_changed
+
+namespace dll {
+
+/*!
+ * \brief Base class for bidirectional recurrent layers (fast / dynamic)
+ *
+ * The layer holds two recurrent layers of the same type, one reading the
+ * sequences forward and one reading them backward. The two directions are
+ * independent and are run concurrently, as two tasks of the scheduler, in
+ * the forward pass as well as in the BPTT.
+ *
+ * The outputs of the two directions are concatenated for each time step:
+ * [B, T, 2H], the first H features from the forward direction and the last
+ * H from the backward direction. Each direction writes its time-major
+ * outputs directly into its slice of the merged outputs.
+ */
+template <typename Derived, typename Layer>
+struct base_bidirectional_layer : layer<Derived> {
+    using derived_t   = Derived;                ///< The derived type (CRTP)
+    using direction_t = Layer;                  ///< The layer of each direction
+    using weight      = typename Layer::weight; ///< The data type for this layer
+    using base_type   = layer<Derived>;         ///< The base type
+
+    static_assert(Layer::bptt_window == 0, "The windowed BPTT is not supported in bidirectional layers");
+
+    /*!
+     * \brief The number of trainable parameters of one direction
+     */
+    static constexpr size_t direction_parameters = std::tuple_size<decltype(std::declval<Layer&>().trainable_parameters())>();
+
+    std::array<Layer, 2> layers; ///< The forward (0) and the backward (1) direction
+
+    /*!
+     * \brief Initialize the bidirectional layer
+     */
+    base_bidirectional_layer()
+            : base_type() {
+        // Nothing else to init here
+    }
+
+    base_bidirectional_layer(const base_bidirectional_layer& rhs) = delete;
+    base_bidirectional_layer(base_bidirectional_layer&& rhs)      = delete;
+
+    base_bidirectional_layer& operator=(const base_bidirectional_layer& rhs) = delete;
+    base_bidirectional_layer& operator=(base_bidirectional_layer&& rhs) = delete;
+
+    /*!
+     * \brief Returns the number of floating point operations of the
+     * forward pass of one sample
+     */
+    size_t forward_flops() const noexcept {
+        return 2 * layers[0].forward_flops();
+    }
+
+    /*!
+     * \brief Returns the number of floating point operations of the
+     * backward pass (errors and gradients) of one sample
+     */
+    size_t backward_flops() const noexcept {
+        return 2 * layers[0].backward_flops();
+    }
+
+    /*!
+     * \brief Returns a short description of the layer
+     * \return an std::string containing a short description of the layer
+     */
+    std::string to_short_string(std::string pre = "") const {
+        return "Bidirectional " + layers[0].to_short_string(pre);
+    }
+
+    /*!
+     * \brief Returns a full description of the layer
+     * \return an std::string containing a full description of the layer
+     */
+    std::string to_full_string(std::string pre = "") const {
+        return "Bidirectional(" + layers[0].to_full_string(pre) + ")";
+    }
+
+    /*!
+     * \brief Returns the output shape
+     * \return an std::string containing the description of the output shape
+     */
+    std::vector<size_t> output_shape(const std::vector<size_t>& input_shape) const {
+        auto shape = layers[0].output_shape(input_shape);
+        shape.back() *= 2;
+        return shape;
+    }
+
+    /*!
+     * \brief Apply the layer to the given batch of input.
+     *
+     * \param output A batch of output that will be filled [B, T, 2H]
+     * \param x A batch of input [B, T, S]
+     */
+    template <typename H, typename V>
+    void forward_batch_impl(H&& output, const V& x) const {
+        const size_t Batch = etl::dim<0>(x);
+        const size_t T     = etl::dim<1>(x);
+        const size_t H_d   = layers[0].hidden_units;
+
+        if (etl::dim<0>(x_rev) != Batch || etl::dim<1>(x_rev) != T) {
+            x_rev.resize(Batch, T, etl::dim<2>(x));
+            last_h[0].resize(Batch, H_d);
+            last_h[1].resize(Batch, H_d);
+        }
+
+        reverse_time(x_rev, x);
+
+        dll::scheduler().parallel_for(2, [&](size_t d) {
+            // Only the last step is output by the layer itself, the
+            // sequences are taken from its time-major caches
+            if (d == 0) {
+                layers[0].forward_batch(last_h[0], x);
+            } else {
+                layers[1].forward_batch(last_h[1], x_rev);
+            }
+
+            time_to_batch_slice(output, layers[d].time_major_outputs(), d * H_d, d == 1);
+        });
+    }
+
+    /*!
+     * \brief Backpropagate the errors to the previous layers, computing the
+     * gradients of the two directions
+     * \param output The ETL expression into which write the output
+     * \param context The training context
+     */
+    template <typename H, typename C>
+    void backward_batch_impl(H&& output, C& context) const {
+        backward_pass<true>(output, context);
+    }
+
+    /*!
+     * \brief Compute the gradients of the two directions, without
+     * backpropagating the errors
+     * \param context The training context
+     */
+    template <typename C>
+    void compute_gradients_impl(C& context) const {
+        backward_pass<false>(d_x_rev, context);
+    }
+
+    /*!
+     * \brief Backup the weights in the secondary weights matrix
+     */
+    void backup_weights() {
+        layers[0].backup_weights();
+        layers[1].backup_weights();
+    }
+
+    /*!
+     * \brief Restore the weights from the secondary weights matrix
+     */
+    void restore_weights() {
+        layers[0].restore_weights();
+        layers[1].restore_weights();
+    }
+
+    /*!
+     * \brief Must be called after the weights of the directions have been
+     * modified.
+     */
+    void weights_changed() {
+        if constexpr (has_weights_changed<Layer>::value) {
+            layers[0].weights_changed();
+            layers[1].weights_changed();
+        }
+    }
+
+    /*!
+     * \brief Load the weigts into the given stream
+     */
+    void store(std::ostream& os) const {
+        layers[0].store(os);
+        layers[1].store(os);
+    }
+
+    /*!
+     * \brief Load the weigts from the given stream
+     */
+    void load(std::istream& is) {
+        layers[0].load(is);
+        layers[1].load(is);
+    }
+
+    /*!
+     * \brief Load the weigts into the given file
+     */
+    void store(const std::string& file) const {
+        std::ofstream os(file, std::ofstream::binary);
+        store(os);
+    }
+
+    /*!
+     * \brief Load the weigts from the given file
+     */
+    void load(const std::string& file) {
+        std::ifstream is(file, std::ifstream::binary);
+        load(is);
+    }
+
+    /*!
+     * \brief Returns the trainable variables of this layer, the variables
+     * of the forward direction followed by the ones of the backward
+     * direction.
+     * \return a tuple containing references to the variables of this layer
+     */
+    decltype(auto) trainable_parameters() {
+        return std::tuple_cat(layers[0].trainable_parameters(), layers[1].trainable_parameters());
+    }
+
+    /*!
+     * \brief Returns the trainable variables of this layer, the variables
+     * of the forward direction followed by the ones of the backward
+     * direction.
+     * \return a tuple containing references to the variables of this layer
+     */
+    decltype(auto) trainable_parameters() const {
+        return std::tuple_cat(layers[0].trainable_parameters(), layers[1].trainable_parameters());
+    }
+
+private:
+    /*!
+     * \brief The training context of one direction, viewing the updater
+     * contexts of its own variables.
+     */
+    template <size_t L, typename Input, typename Errors, typename Up>
+    struct direction_context {
+        static constexpr size_t layer = L; ///< The index of the layer
+
+        /*!
+         * \brief The updater contexts of the variables of the direction
+         */
+        struct updater_view {
+            Up context; ///< The sub contexts
+        };
+
+        const Input& input; ///< The input of the direction
+        Errors& errors;     ///< The errors of the direction
+        updater_view up;    ///< The updater view
+    };
+
+    /*!
+     * \brief Backpropagate the errors through the two directions.
+     *
+     * \param output The errors of the input, only written when Direct
+     * \param context The training context
+     */
+    template <bool Direct, typename Output, typename C>
+    void backward_pass(Output& output, C& context) const {
+        const size_t Batch = etl::dim<0>(context.errors);
+        const size_t T     = etl::dim<1>(context.errors);
+        const size_t H_d   = layers[0].hidden_units;
+
+        if (etl::dim<0>(direction_errors[0]) != Batch || etl::dim<1>(direction_errors[0]) != T) {
+            direction_errors[0].resize(Batch, T, H_d);
+            direction_errors[1].resize(Batch, T, H_d);
+            d_x_rev.resize(Batch, T, etl::dim<2>(x_rev));
+        }
+
+        batch_slice_to_batch(direction_errors[0], context.errors, 0, false);
+        batch_slice_to_batch(direction_errors[1], context.errors, H_d, true);
+
+        dll::scheduler().parallel_for(2, [&](size_t d) {
+            if (d == 0) {
+                backward_direction<0, Direct>(output, context.input, context);
+            } else {
+                backward_direction<1, Direct>(d_x_rev, x_rev, context);
+            }
+        });
+
+        // The errors of the backward direction are reversed in time
+
+        if constexpr (Direct) {
+            reverse_time<true>(output, d_x_rev);
+        }
+    }
+
+    /*!
+     * \brief Returns the updater contexts of the variables [First, First + N)
+     */
+    template <size_t First, typename Up, size_t... I>
+    static auto direction_updater(Up& up, std::index_sequence<I...> /*seq*/) {
+        return std::make_tuple(std::get<First + I>(up).get()...);
+    }
+
+    /*!
+     * \brief Backpropagate the errors through the direction D
+     */
+    template <size_t D, bool Direct, typename Output, typename Input, typename C>
+    void backward_direction(Output& output, const Input& input, C& context) const {
+        auto up = direction_updater<D * direction_parameters>(context.up.context, std::make_index_sequence<direction_parameters>());
+
+        using errors_t  = std::decay_t<decltype(direction_errors[D])>;
+        using context_t = direction_context<C::layer, Input, errors_t, decltype(up)>;
+
+        context_t direction{input, direction_errors[D], {up}};
+
+        if constexpr (Direct) {
+            layers[D].backward_batch(output, direction);
+        } else {
+            cpp_unused(output);
+
+            layers[D].compute_gradients(direction);
+        }
+    }
+
+    mutable etl::dyn_matrix<weight, 3> x_rev;                           ///< The input, reversed in time
+    mutable etl::dyn_matrix<weight, 3> d_x_rev;                         ///< The input errors of the backward direction
+    mutable std::array<etl::dyn_matrix<weight, 2>, 2> last_h;           ///< The last step output of each direction (unused)
+    mutable std::array<etl::dyn_matrix<weight, 3>, 2> direction_errors; ///< The errors of each direction
+};
+
+} //end of dll namespace
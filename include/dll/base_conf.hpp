@@ -18,12 +18,14 @@
 #include "version.hpp"
 #include "unit_type.hpp"
 #include "updater_type.hpp"
+#include "noise_type.hpp"
 #include "strategy.hpp"
 #include "function.hpp"
 #include "loss.hpp"
 #include "decay_type.hpp"
 #include "sparsity_method.hpp"
 #include "bias_mode.hpp"
+#include "upsample_type.hpp"
 #include "initializer.hpp"
 #include "output.hpp"
 
@@ -112,6 +114,8 @@ struct pooling_id;
 struct activation_id;
 struct loss_id;
 struct output_policy_id;
+struct lr_schedule_id;
+struct transport_id;
 struct initializer_id;
 struct initializer_bias_id;
 struct initializer_forget_bias_id;
@@ -134,21 +138,45 @@ struct svm_concatenate_id;
 struct svm_scale_id;
 struct init_weights_id;
 struct clip_gradients_id;
+struct data_parallel_id;
+struct pipeline_stages_id;
+struct parallel_gradients_id;
+struct grad_accumulate_id;
+struct loss_scaling_id;
+struct checkpoint_id;
+struct stage_inputs_id;
+struct flat_parameters_id;
+struct compressed_activations_id;
 struct weight_type_id;
 struct free_energy_id;
+struct sparse_input_id;
 struct no_epoch_error_id;
+struct running_error_id;
+struct async_validation_id;
 struct random_crop_id;
 struct batch_mode_id;
+struct pipeline_pretrain_id;
+struct inference_only_id;
 struct dbn_only_id;
 struct last_only_id;
 struct horizontal_mirroring_id;
 struct vertical_mirroring_id;
 struct categorical_id;
+struct compact_labels_id;
+struct indexed_shuffle_id;
+struct length_bucketing_id;
 struct threaded_id;
+struct workers_id;
+struct lock_free_id;
+struct gpu_prefetch_id;
 struct nop_id;
 struct no_bias_id;
+struct max_pool_indices_id;
 struct elastic_distortion_id;
+struct distortion_bank_id;
+struct storage_type_id;
 struct noise_id;
+struct noise_kind_id;
 struct scale_pre_id;
 struct normalize_pre_id;
 struct binarize_pre_id;
@@ -157,6 +185,13 @@ struct updater_id;
 struct early_stopping_id;
 struct early_training_id;
 struct truncate_id;
+struct bptt_window_id;
+struct variable_length_id;
+struct stride_id;
+struct padding_id;
+struct dilation_id;
+struct groups_id;
+struct upsample_id;
 
 /*!
  * \brief Sets the minibatch size
@@ -183,7 +218,11 @@ template <updater_type UT>
 struct updater : value_conf_elt<updater_id, updater_type, UT> {};
 
 /*!
- * \brief Sets the strategy type for early stopping
+ * \brief Sets the strategy type for early stopping.
+ *
+ * For a RBM, only the error strategies are valid, they are applied to the
+ * reconstruction error of the pretraining epochs.
+ *
  * \tparam UT The strategy type
  */
 template <strategy S>
@@ -238,6 +277,22 @@ struct loss : value_conf_elt<loss_id, loss_function, FT> {};
 template <typename P>
 struct output_policy : type_conf_elt<output_policy_id, P> {};
 
+/*!
+ * \brief Sets the learning rate schedule of the SGD trainer
+ *
+ * \tparam S The schedule type (constant_lr, step_lr, cosine_lr or warmup_lr)
+ */
+template <typename S>
+struct lr_schedule : type_conf_elt<lr_schedule_id, S> {};
+
+/*!
+ * \brief Sets the transport of the gradients of the distributed SGD trainer
+ *
+ * \tparam T The transport type (local_transport or mpi_transport)
+ */
+template <typename T>
+struct transport : type_conf_elt<transport_id, T> {};
+
 /*!
  * \brief Sets the initializer
  * \tparam IT The initializer type
@@ -379,11 +434,52 @@ struct vertical_mirroring : basic_conf_elt<vertical_mirroring_id> {};
  */
 struct categorical : basic_conf_elt<categorical_id> {};
 
+/*!
+ * \brief Store the categorical labels as class indices in the generator
+ * cache and expand them into categorical rows one batch at a time
+ */
+struct compact_labels : basic_conf_elt<compact_labels_id> {};
+
+/*!
+ * \brief Shuffle the generator with a permutation of the indices of the
+ * samples, gathered batch by batch, instead of permuting the cache itself
+ */
+struct indexed_shuffle : basic_conf_elt<indexed_shuffle_id> {};
+
+/*!
+ * \brief Group the samples of similar lengths in the same batches.
+ *
+ * The samples are zero-padded sequences, their length is the number of
+ * time steps up to the last non-zero one. At each shuffle, the samples are
+ * sorted by decreasing length, the ties in random order, and the order of
+ * the complete batches is shuffled. Implies indexed_shuffle.
+ */
+struct length_bucketing : basic_conf_elt<length_bucketing_id> {};
+
 /*!
  * \brief Use a thread for data augmentation.
  */
 struct threaded : basic_conf_elt<threaded_id> {};
 
+/*!
+ * \brief Sets the number of threads used by a generator to prepare batches
+ * \tparam N The number of workers
+ */
+template <size_t N>
+struct workers : value_conf_elt<workers_id, size_t, N> {};
+
+/*!
+ * \brief Use a lock-free ring to hand batches from the generator threads
+ * to the consumer.
+ */
+struct lock_free : basic_conf_elt<lock_free_id> {};
+
+/*!
+ * \brief Prefetch the next batch of a generator to the GPU, through pinned
+ * host buffers (only when the training stays on the GPU, ETL_GPU).
+ */
+struct gpu_prefetch : basic_conf_elt<gpu_prefetch_id> {};
+
 /*!
  * \brief Sets the elastic distortion kernel
  * \tparam K The elastic distortion kernel
@@ -391,6 +487,20 @@ struct threaded : basic_conf_elt<threaded_id> {};
 template <size_t K>
 struct elastic_distortion : value_conf_elt<elastic_distortion_id, size_t, K> {};
 
+/*!
+ * \brief Precompute a bank of displacement fields for elastic distortion
+ * \tparam N The number of displacement fields
+ */
+template <size_t N>
+struct distortion_bank : value_conf_elt<distortion_bank_id, size_t, N> {};
+
+/*!
+ * \brief Sets the type used to store the inputs in the generator cache
+ * \tparam T The storage type
+ */
+template <typename T>
+struct storage_type : type_conf_elt<storage_type_id, T> {};
+
 /*!
  * \brief Sets the noise
  * \tparam N The percent of noise
@@ -398,6 +508,13 @@ struct elastic_distortion : value_conf_elt<elastic_distortion_id, size_t, K> {};
 template <size_t N>
 struct noise : value_conf_elt<noise_id, size_t, N> {};
 
+/*!
+ * \brief Sets the type of the noise applied on the inputs
+ * \tparam T The noise type
+ */
+template <noise_type T>
+struct noise_kind : value_conf_elt<noise_kind_id, noise_type, T> {};
+
 /*!
  * \brief Sets the prescaling factor
  * \tparam S The scaling factor
@@ -443,16 +560,153 @@ struct shuffle_pre : basic_conf_elt<shuffle_pre_id> {};
  */
 struct free_energy : basic_conf_elt<free_energy_id> {};
 
+/*!
+ * \brief Indicates that the inputs of the layer are very sparse and that
+ * the products with its weights should be computed from the non-zero inputs
+ */
+struct sparse_input : basic_conf_elt<sparse_input_id> {};
+
 /*!
  * \brief Disable error calculation on epoch.
  */
 struct no_epoch_error : basic_conf_elt<no_epoch_error_id> {};
 
+/*!
+ * \brief Compute the training error and loss of an epoch from the batches
+ * of the epoch, as they are trained, instead of evaluating the training set
+ * again after the epoch.
+ *
+ * The metrics are computed by the trainer with the weights of each batch
+ * and in training mode (dropout, ...). Only the validation set is evaluated
+ * after each epoch.
+ */
+struct running_error : basic_conf_elt<running_error_id> {};
+
+/*!
+ * \brief Validate each epoch on a snapshot of the network, on another thread,
+ * while the next epoch is trained.
+ *
+ * The early stopping decisions are taken one epoch late.
+ */
+struct async_validation : basic_conf_elt<async_validation_id> {};
+
 /*!
  * \brief Enable gradient clipping.
  */
 struct clip_gradients : basic_conf_elt<clip_gradients_id> {};
 
+/*!
+ * \brief Use data-parallel SGD.
+ *
+ * Each batch is split into R micro-batches that are trained in parallel
+ * by the thread pool of the network. The gradients of the micro-batches
+ * are summed before the weights are updated. Layers that modify their
+ * state during training (dropout, batch normalization) are not supported.
+ *
+ * When set on a RBM, the Contrastive Divergence of each micro-batch is
+ * computed in parallel during pretraining and the reduced gradients are
+ * used for the update.
+ *
+ * \tparam R The number of micro-batches
+ */
+template <size_t R>
+struct data_parallel : value_conf_elt<data_parallel_id, size_t, R> {};
+
+/*!
+ * \brief Train the network with pipeline model parallelism.
+ *
+ * The layers are partitioned into S contiguous stages of balanced numbers
+ * of parameters, each run by its own thread (pinned with
+ * execution().stages). The micro-batches of data_parallel flow from one
+ * stage to the next: all the micro-batches are first forwarded through
+ * the stages, and then backpropagated in reverse order (GPipe schedule).
+ *
+ * \tparam S The number of stages
+ */
+template <size_t S>
+struct pipeline_stages : value_conf_elt<pipeline_stages_id, size_t, S> {};
+
+/*!
+ * \brief Compute the filter gradients of the Contrastive Divergence of a
+ * convolutional RBM in parallel.
+ *
+ * Each batch is split into S slices whose partial filter gradients are
+ * computed in parallel and then summed. Unlike data_parallel, the Gibbs
+ * chain is still computed on the whole batch.
+ *
+ * \tparam S The number of slices of each batch
+ */
+template <size_t S>
+struct parallel_gradients : value_conf_elt<parallel_gradients_id, size_t, S> {};
+
+/*!
+ * \brief Accumulate the gradients of several batches before updating the
+ * weights with SGD.
+ *
+ * The weights are updated once every N batches, with the sum of their
+ * gradients, which gives the effect of a batch N times larger while the
+ * contexts are only sized for one batch.
+ *
+ * \tparam N The number of batches to accumulate
+ */
+template <size_t N>
+struct grad_accumulate : value_conf_elt<grad_accumulate_id, size_t, N> {};
+
+/*!
+ * \brief Enable dynamic loss scaling in SGD.
+ *
+ * The errors of the last layer are multiplied by the loss scale of the
+ * network and the gradients are divided by it before the update. When
+ * the gradients overflow, the update is skipped and the scale is halved.
+ */
+struct loss_scaling : basic_conf_elt<loss_scaling_id> {};
+
+/*!
+ * \brief Enable activation checkpointing in SGD.
+ *
+ * Only the contexts of every K-th layer (and of the last layer) are kept
+ * between the forward and the backward passes. The activations of the
+ * other layers are released and recomputed, segment by segment, during
+ * the backward pass. Only the dynamic buffers of the contexts can be
+ * released. Layers whose training forward pass is not deterministic or
+ * modifies their state (dropout, batch normalization) are not supported.
+ *
+ * \tparam K The distance between two checkpointed layers
+ */
+template <size_t K>
+struct checkpoint : value_conf_elt<checkpoint_id, size_t, K> {};
+
+/*!
+ * \brief Stage the next batch while the current batch is trained.
+ *
+ * The next batch is copied into a second input buffer of the SGD trainer
+ * while the current batch is trained on another thread. The buffers are
+ * then swapped with the input of the first layer.
+ */
+struct stage_inputs : basic_conf_elt<stage_inputs_id> {};
+
+/*!
+ * \brief Store the gradients and the state of the updater of the whole
+ * network in contiguous buffers.
+ *
+ * The SGD trainer allocates one buffer for all the gradients and one
+ * buffer per moment of the updater, the contexts of the layers holding
+ * views into them.
+ */
+struct flat_parameters : basic_conf_elt<flat_parameters_id> {};
+
+/*!
+ * \brief Compress the activations kept by SGD between the forward and the
+ * backward passes.
+ *
+ * The outputs of the RELU dense and convolutional layers are kept as
+ * bitmasks of their signs, which is all their derivative needs, and the
+ * inputs of these layers, only used for their gradients, are kept in
+ * bfloat16. The activations are decompressed, layer by layer, during the
+ * backward pass. Only the dynamic buffers of the contexts are compressed.
+ */
+struct compressed_activations : basic_conf_elt<compressed_activations_id> {};
+
 /*!
  * \brief Indicates that the layer is only made to be used in a DBN.
  *
@@ -477,11 +731,32 @@ struct nop : basic_conf_elt<nop_id> {};
  */
 struct no_bias : basic_conf_elt<no_bias_id> {};
 
+/*!
+ * \brief Record the position of the max of each pooling window during
+ * training, so that the backward pass of max pooling is a scatter
+ */
+struct max_pool_indices : basic_conf_elt<max_pool_indices_id> {};
+
 /*!
  * \brief Use batch mode in DBN (Do not process the complete dataset at once)
  */
 struct batch_mode : basic_conf_elt<batch_mode_id> {};
 
+/*!
+ * \brief Pretrain the layers of a batch mode DBN concurrently.
+ *
+ * Each layer starts pipeline_delay epochs after the previous one and is
+ * trained, on its own thread, on the current activations of the previous
+ * layers.
+ */
+struct pipeline_pretrain : basic_conf_elt<pipeline_pretrain_id> {};
+
+/*!
+ * \brief Build the network for inference only: the members only used for
+ * training are removed and the training functions do not compile
+ */
+struct inference_only : basic_conf_elt<inference_only_id> {};
+
 /*!
  * \brief Sets the BPTT steps to truncate
  * \tparam T The truncate steps
@@ -489,6 +764,73 @@ struct batch_mode : basic_conf_elt<batch_mode_id> {};
 template <size_t T>
 struct truncate : value_conf_elt<truncate_id, size_t, T> {};
 
+/*!
+ * \brief Sets the length of the windows of the windowed BPTT.
+ *
+ * The sequences are processed in windows of W time steps, carrying the
+ * state of the layer from a window to the next. Only the states at the
+ * boundaries of the windows are kept between the forward and the backward
+ * passes and the gradients are truncated at the boundaries of the windows.
+ * The activations are recomputed, one window at a time, during the
+ * backward pass, so the memory is proportional to the window and not to
+ * the number of time steps.
+ *
+ * \tparam W The number of time steps of a window (must divide the number of time steps)
+ */
+template <size_t W>
+struct bptt_window : value_conf_elt<bptt_window_id, size_t, W> {};
+
+/*!
+ * \brief Indicates that the sequences have variable lengths, zero-padded
+ * up to the number of time steps of the layer.
+ *
+ * The length of each sample is the number of time steps up to its last
+ * non-zero one. The finished samples are not updated anymore, their
+ * outputs are zero and the last step output of a sample is the output of
+ * its last time step.
+ */
+struct variable_length : basic_conf_elt<variable_length_id> {};
+
+/*!
+ * \brief Sets the stride of a convolutional or pooling layer
+ * \tparam S1 The stride of the first dimension
+ * \tparam S2 The stride of the second dimension
+ */
+template <size_t S1, size_t S2 = S1>
+struct stride : value_pair_conf_elt<stride_id, size_t, S1, S2> {};
+
+/*!
+ * \brief Sets the zero-padding of a convolutional or pooling layer
+ * \tparam P1 The padding of the first dimension
+ * \tparam P2 The padding of the second dimension
+ */
+template <size_t P1, size_t P2 = P1>
+struct padding : value_pair_conf_elt<padding_id, size_t, P1, P2> {};
+
+/*!
+ * \brief Sets the dilation of the filters of a convolutional layer, the
+ * taps of the filters being D1 (D2) pixels apart
+ * \tparam D1 The dilation of the first dimension
+ * \tparam D2 The dilation of the second dimension
+ */
+template <size_t D1, size_t D2 = D1>
+struct dilation : value_pair_conf_elt<dilation_id, size_t, D1, D2> {};
+
+/*!
+ * \brief Sets the number of groups of a convolutional layer, each group of
+ * filters only seeing its own group of input channels
+ * \tparam G The number of groups
+ */
+template <size_t G>
+struct groups : value_conf_elt<groups_id, size_t, G> {};
+
+/*!
+ * \brief Sets the interpolation of an upsample layer
+ * \tparam UT The upsample type
+ */
+template <upsample_type UT>
+struct upsample : value_conf_elt<upsample_id, upsample_type, UT> {};
+
 /*!
  * \brief Conditional shuffle (shuffle if Cond = true)
  */
@@ -0,0 +1,600 @@
+//=======================================================================
+// Copyright (c) 2014-2017 Baptiste Wicht
+// Distributed under the terms of the MIT License.
+// (See accompanying file LICENSE or copy at
+//  http://opensource.org/licenses/MIT)
+//=======================================================================
+
+#pragma once
+
+#include <fstream>
+
+#include "cpp_utils/assert.hpp" //Assertions
+#include "cpp_utils/io.hpp"     // For binary writing
+
+#include "etl/etl.hpp"
+
+#include "layer.hpp"
+#include "layer_traits.hpp"
+#include "function.hpp"
+#include "util/tmp.hpp"
+#include "util/time_major.hpp"
+#include "util/scratch_arena.hpp"
+
+namespace dll {
+
+/*!
+ * \brief Base class for GRU layers (fast / dynamic)
+ *
+ * The candidate of each step is computed from the reset gate applied to the
+ * recurrent projection of the previous output:
+ *
+ *   z = sigmoid(x U_z + h W_z + b_z)
+ *   r = sigmoid(x U_r + h W_r + b_r)
+ *   n = f(x U_h + b_h + r * (h W_h))
+ *   h' = (1 - z) * n + z * h
+ *
+ * With this formulation, the recurrent projections of the three gates are a
+ * single GEMM per time step.
+ */
+template <typename Derived, typename Desc>
+struct base_gru_layer : layer<Derived> {
+    using desc      = Desc;                            ///< The descriptor of the layer
+    using derived_t = Derived;                         ///< The derived type (CRTP)
+    using weight    = typename desc::weight;           ///< The data type for this layer
+    using this_type = base_gru_layer<derived_t, desc>; ///< The type of this layer
+    using base_type = layer<Derived>;                  ///< The base type
+
+    static constexpr auto activation_function = desc::activation_function; ///< The layer's activation function
+    static constexpr size_t bptt_window       = 0;                         ///< The BPTT is always done on the complete sequences
+    static constexpr bool last_step_output    = true;                      ///< The outputs can be only the last time step of the sequences
+
+    static_assert(is_element_wise(activation_function), "The activation function of the GRU candidate must be element-wise");
+
+    etl::dyn_matrix<weight, 2> u_all; ///< The concatenated U weights of the three gates (z, r, h)
+    etl::dyn_matrix<weight, 2> w_all; ///< The concatenated W weights of the three gates (z, r, h)
+
+    /*!
+     * \brief The caches of a forward pass
+     */
+    struct forward_cache {
+        etl::dyn_matrix<float, 3> x_t;  ///< The input (time-major)
+        etl::dyn_matrix<float, 3> xp_t; ///< The input projections of the three gates
+        etl::dyn_matrix<float, 2> hp;   ///< The recurrent projections of the three gates of the current step
+        etl::dyn_matrix<float, 3> z_t;  ///< The update gates
+        etl::dyn_matrix<float, 3> r_t;  ///< The reset gates
+        etl::dyn_matrix<float, 3> n_t;  ///< The candidates
+        etl::dyn_matrix<float, 3> m_t;  ///< The recurrent projections of the candidates
+        etl::dyn_matrix<float, 3> h_t;  ///< The outputs
+    };
+
+    /*!
+     * \brief The scratch state of an inference forward pass.
+     *
+     * With its own scratch, a forward pass does not modify the layer and
+     * several threads can use the same layer concurrently.
+     */
+    struct inference_scratch : forward_cache {};
+
+    mutable forward_cache cache; ///< The caches of the training forward pass
+
+    /*!
+     * \brief Initialize the neural layer
+     */
+    base_gru_layer()
+            : base_type() {
+        // Nothing to init here
+    }
+
+    base_gru_layer(const base_gru_layer& rhs) = delete;
+    base_gru_layer(base_gru_layer&& rhs)      = delete;
+
+    base_gru_layer& operator=(const base_gru_layer& rhs) = delete;
+    base_gru_layer& operator=(base_gru_layer&& rhs) = delete;
+
+    /*!
+     * \brief Returns the outputs of the last training forward pass, in the
+     * time-major layout [T, B, H]
+     */
+    const etl::dyn_matrix<float, 3>& time_major_outputs() const {
+        return cache.h_t;
+    }
+
+    /*!
+     * \brief Backup the weights in the secondary weights matrix
+     */
+    void backup_weights() {
+        unique_safe_get(as_derived().bak_w_z) = as_derived().w_z;
+        unique_safe_get(as_derived().bak_u_z) = as_derived().u_z;
+        unique_safe_get(as_derived().bak_b_z) = as_derived().b_z;
+        unique_safe_get(as_derived().bak_w_r) = as_derived().w_r;
+        unique_safe_get(as_derived().bak_u_r) = as_derived().u_r;
+        unique_safe_get(as_derived().bak_b_r) = as_derived().b_r;
+        unique_safe_get(as_derived().bak_w_h) = as_derived().w_h;
+        unique_safe_get(as_derived().bak_u_h) = as_derived().u_h;
+        unique_safe_get(as_derived().bak_b_h) = as_derived().b_h;
+    }
+
+    /*!
+     * \brief Restore the weights from the secondary weights matrix
+     */
+    void restore_weights() {
+        as_derived().w_z = *as_derived().bak_w_z;
+        as_derived().u_z = *as_derived().bak_u_z;
+        as_derived().b_z = *as_derived().bak_b_z;
+        as_derived().w_r = *as_derived().bak_w_r;
+        as_derived().u_r = *as_derived().bak_u_r;
+        as_derived().b_r = *as_derived().bak_b_r;
+        as_derived().w_h = *as_derived().bak_w_h;
+        as_derived().u_h = *as_derived().bak_u_h;
+        as_derived().b_h = *as_derived().bak_b_h;
+
+        weights_changed();
+    }
+
+    /*!
+     * \brief Rebuild the concatenated weights of the gates, must be called
+     * after the weights have been modified.
+     */
+    void weights_changed() {
+        auto& d = as_derived();
+
+        const size_t S = etl::dim<0>(d.u_z);
+        const size_t H = etl::dim<0>(d.w_z);
+
+        if (etl::dim<0>(u_all) != S || etl::dim<1>(u_all) != 3 * H) {
+            u_all = etl::dyn_matrix<weight, 2>(S, 3 * H);
+            w_all = etl::dyn_matrix<weight, 2>(H, 3 * H);
+        }
+
+        d.u_z.ensure_cpu_up_to_date();
+        d.u_r.ensure_cpu_up_to_date();
+        d.u_h.ensure_cpu_up_to_date();
+        d.w_z.ensure_cpu_up_to_date();
+        d.w_r.ensure_cpu_up_to_date();
+        d.w_h.ensure_cpu_up_to_date();
+
+        concat_gates(u_all.memory_start(), S, H, d.u_z.memory_start(), d.u_r.memory_start(), d.u_h.memory_start());
+        concat_gates(w_all.memory_start(), H, H, d.w_z.memory_start(), d.w_r.memory_start(), d.w_h.memory_start());
+
+        u_all.invalidate_gpu();
+        w_all.invalidate_gpu();
+    }
+
+    /*!
+     * \brief Apply the layer to the given batch of input.
+     *
+     * \param output A batch of output that will be filled, with the complete
+     * sequences or only their last time step
+     * \param x A batch of input
+     */
+    template <typename H, typename V>
+    void forward_batch_impl(H&& output, const V& x) const {
+        forward_sequence(cache, output, x);
+    }
+
+    /*!
+     * \brief Apply the layer to the given batch of input, using the given
+     * scratch instead of the caches of the layer.
+     *
+     * \param output A batch of output that will be filled
+     * \param x A batch of input
+     * \param scratch The scratch of the forward pass
+     */
+    template <typename H, typename V>
+    void inference_forward_batch(H&& output, const V& x, inference_scratch& scratch) const {
+        forward_sequence(scratch, output, x);
+    }
+
+    /*!
+     * \brief Backpropagation through time of the errors of the batch.
+     *
+     * The errors of each time step are computed by a single element-wise
+     * kernel and carried to the previous step with a single GEMM with the
+     * concatenated W weights. The gradients of the weights and the errors
+     * of the input are then computed for all the time steps at once.
+     *
+     * With truncation, the errors are carried through at most bptt_steps
+     * time steps, the sequence being split into windows of bptt_steps,
+     * from the last step.
+     *
+     * \param output The ETL expression into which write the output
+     * \param context The training context
+     * \param direct Indicates if the errors of the input must be written to the output
+     */
+    template <typename Output, typename C>
+    void backward_pass(Output&& output, C& context, bool direct) const {
+        auto& d = as_derived();
+
+        const size_t Batch = etl::dim<0>(context.errors);
+        const size_t T     = d.time_steps;
+        const size_t S     = d.sequence_length;
+        const size_t H     = d.hidden_units;
+
+        temporary_scope<float> scope;
+
+        auto delta_t = scope.matrix<3>(T, Batch, H);
+        auto d_a_t   = scope.matrix<3>(T, Batch, 3 * H); // The errors of the input projections
+        auto d_p_t   = scope.matrix<3>(T, Batch, 3 * H); // The errors of the recurrent projections
+        auto d_h     = scope.matrix<2>(Batch, H);
+
+        // 1. Rearrange errors
+
+        errors_to_time(delta_t, context.errors);
+
+        // 2. Backpropagation through time
+
+        for (size_t tt = T; tt > 0; --tt) {
+            const size_t t = tt - 1;
+
+            // The errors are not carried further than the truncation window
+            if ((T - 1 - t) % d.bptt_steps == 0) {
+                d_h = delta_t(t);
+            } else {
+                d_h = delta_t(t) + d_h;
+            }
+
+            gates_backward_kernel(t, Batch, d_h, d_a_t, d_p_t);
+
+            if (t > 0) {
+                d_h += d_p_t(t) * trans(w_all);
+            }
+        }
+
+        // 3. Gradients of all the time steps
+
+        auto w_grad = scope.matrix<2>(H, 3 * H);
+        auto u_grad = scope.matrix<2>(S, 3 * H);
+        auto b_grad = scope.matrix<1>(3 * H);
+
+        cache.x_t.ensure_cpu_up_to_date();
+        cache.h_t.ensure_cpu_up_to_date();
+
+        etl::custom_dyn_matrix<float, 2> d_a(d_a_t.memory_start(), T * Batch, 3 * H);
+        etl::custom_dyn_matrix<float, 2> x(cache.x_t.memory_start(), T * Batch, S);
+
+        u_grad = trans(x) * d_a;
+        b_grad = etl::bias_batch_sum_2d(d_a);
+
+        if (T > 1) {
+            etl::custom_dyn_matrix<float, 2> d_p(d_p_t.memory_start() + Batch * 3 * H, (T - 1) * Batch, 3 * H);
+            etl::custom_dyn_matrix<float, 2> h(cache.h_t.memory_start(), (T - 1) * Batch, H);
+
+            w_grad = trans(h) * d_p;
+        } else {
+            w_grad = 0;
+        }
+
+        w_grad.ensure_cpu_up_to_date();
+        u_grad.ensure_cpu_up_to_date();
+        b_grad.ensure_cpu_up_to_date();
+
+        split_gates(std::get<0>(context.up.context)->grad, std::get<3>(context.up.context)->grad, std::get<6>(context.up.context)->grad, w_grad, H);
+        split_gates(std::get<1>(context.up.context)->grad, std::get<4>(context.up.context)->grad, std::get<7>(context.up.context)->grad, u_grad, S);
+        split_gates(std::get<2>(context.up.context)->grad, std::get<5>(context.up.context)->grad, std::get<8>(context.up.context)->grad, b_grad, 1);
+
+        // 4. Errors of the input of all the time steps
+
+        if (direct) {
+            auto d_x_t = scope.matrix<3>(T, Batch, S);
+
+            etl::reshape(d_x_t, T * Batch, S) = d_a * trans(u_all);
+
+            swap_batch_time(output, d_x_t);
+        }
+    }
+
+    /*!
+     * \brief Load the weigts into the given stream
+     */
+    void store(std::ostream& os) const {
+        cpp::binary_write_all(os, as_derived().w_z);
+        cpp::binary_write_all(os, as_derived().u_z);
+        cpp::binary_write_all(os, as_derived().b_z);
+        cpp::binary_write_all(os, as_derived().w_r);
+        cpp::binary_write_all(os, as_derived().u_r);
+        cpp::binary_write_all(os, as_derived().b_r);
+        cpp::binary_write_all(os, as_derived().w_h);
+        cpp::binary_write_all(os, as_derived().u_h);
+        cpp::binary_write_all(os, as_derived().b_h);
+    }
+
+    /*!
+     * \brief Load the weigts from the given stream
+     */
+    void load(std::istream& is) {
+        cpp::binary_load_all(is, as_derived().w_z);
+        cpp::binary_load_all(is, as_derived().u_z);
+        cpp::binary_load_all(is, as_derived().b_z);
+        cpp::binary_load_all(is, as_derived().w_r);
+        cpp::binary_load_all(is, as_derived().u_r);
+        cpp::binary_load_all(is, as_derived().b_r);
+        cpp::binary_load_all(is, as_derived().w_h);
+        cpp::binary_load_all(is, as_derived().u_h);
+        cpp::binary_load_all(is, as_derived().b_h);
+
+        weights_changed();
+    }
+
+    /*!
+     * \brief Load the weigts into the given file
+     */
+    void store(const std::string& file) const {
+        std::ofstream os(file, std::ofstream::binary);
+        store(os);
+    }
+
+    /*!
+     * \brief Load the weigts from the given file
+     */
+    void load(const std::string& file) {
+        std::ifstream is(file, std::ifstream::binary);
+        load(is);
+    }
+
+    /*!
+     * \brief Returns the trainable variables of this layer.
+     * \return a tuple containing references to the variables of this layer
+     */
+    decltype(auto) trainable_parameters() {
+        return std::make_tuple(
+            std::ref(as_derived().w_z), std::ref(as_derived().u_z), std::ref(as_derived().b_z),
+            std::ref(as_derived().w_r), std::ref(as_derived().u_r), std::ref(as_derived().b_r),
+            std::ref(as_derived().w_h), std::ref(as_derived().u_h), std::ref(as_derived().b_h));
+    }
+
+    /*!
+     * \brief Returns the trainable variables of this layer.
+     * \return a tuple containing references to the variables of this layer
+     */
+    decltype(auto) trainable_parameters() const {
+        return std::make_tuple(
+            std::cref(as_derived().w_z), std::cref(as_derived().u_z), std::cref(as_derived().b_z),
+            std::cref(as_derived().w_r), std::cref(as_derived().u_r), std::cref(as_derived().b_r),
+            std::cref(as_derived().w_h), std::cref(as_derived().u_h), std::cref(as_derived().b_h));
+    }
+
+private:
+    /*!
+     * \brief Forward propagation through time of the complete sequences.
+     *
+     * The input projections of the three gates are computed for all the
+     * time steps at once, with a single GEMM with the concatenated U
+     * weights. Each time step is then a single GEMM of the previous output
+     * with the concatenated W weights, followed by a single element-wise
+     * kernel computing the gates and the output.
+     *
+     * \param c The caches of the forward pass
+     * \param output A batch of output that will be filled
+     * \param x A batch of input
+     */
+    template <typename Cache, typename Output, typename V>
+    void forward_sequence(Cache& c, Output&& output, const V& x) const {
+        auto& d = as_derived();
+
+        const size_t Batch = etl::dim<0>(x);
+        const size_t T     = d.time_steps;
+        const size_t S     = d.sequence_length;
+        const size_t H     = d.hidden_units;
+
+        if (etl::dim<0>(c.x_t) != T || etl::dim<1>(c.x_t) != Batch) {
+            c.x_t.resize(T, Batch, S);
+            c.xp_t.resize(T, Batch, 3 * H);
+            c.hp.resize(Batch, 3 * H);
+            c.z_t.resize(T, Batch, H);
+            c.r_t.resize(T, Batch, H);
+            c.n_t.resize(T, Batch, H);
+            c.m_t.resize(T, Batch, H);
+            c.h_t.resize(T, Batch, H);
+        }
+
+        // 1. Rearrange input
+
+        swap_batch_time(c.x_t, x);
+
+        // 2. Input projections of all the time steps
+
+        etl::reshape(c.xp_t, T * Batch, 3 * H) = etl::reshape(c.x_t, T * Batch, S) * u_all;
+
+        for (size_t t = 0; t < T; ++t) {
+            // 3. Recurrent projection
+
+            if (t > 0) {
+                c.hp = c.h_t(t - 1) * w_all;
+            }
+
+            // 4. Gates and output
+
+            gates_kernel(c, t, Batch);
+        }
+
+        // 5. Rearrange the output
+
+        outputs_to_batch(output, c.h_t);
+    }
+
+    /*!
+     * \brief Compute the gates and the output of a time step from the
+     * input projections in xp_t and the recurrent projections in hp.
+     *
+     * \param c The caches of the forward pass
+     * \param t The time step
+     * \param Batch The number of samples of the batch
+     */
+    template <typename Cache>
+    void gates_kernel(Cache& c, size_t t, size_t Batch) const {
+        auto& d = as_derived();
+
+        const size_t H = d.hidden_units;
+        const size_t N = Batch * H;
+
+        c.xp_t.ensure_cpu_up_to_date();
+        c.h_t.ensure_cpu_up_to_date();
+        d.b_z.ensure_cpu_up_to_date();
+        d.b_r.ensure_cpu_up_to_date();
+        d.b_h.ensure_cpu_up_to_date();
+
+        if (t > 0) {
+            c.hp.ensure_cpu_up_to_date();
+        }
+
+        const float* xp = c.xp_t.memory_start() + t * 3 * N;
+        const float* hp = c.hp.memory_start();
+
+        float* z_ptr = c.z_t.memory_start() + t * N;
+        float* r_ptr = c.r_t.memory_start() + t * N;
+        float* n_ptr = c.n_t.memory_start() + t * N;
+        float* m_ptr = c.m_t.memory_start() + t * N;
+        float* h_ptr = c.h_t.memory_start() + t * N;
+
+        const weight* b_z = d.b_z.memory_start();
+        const weight* b_r = d.b_r.memory_start();
+        const weight* b_h = d.b_h.memory_start();
+
+        for (size_t b = 0; b < Batch; ++b) {
+            const float* xb = xp + b * 3 * H;
+            const float* hb = hp + b * 3 * H;
+
+            for (size_t j = 0; j < H; ++j) {
+                const size_t n = b * H + j;
+
+                float a_z = xb[0 * H + j] + float(b_z[j]);
+                float a_r = xb[1 * H + j] + float(b_r[j]);
+                float m   = 0;
+                float h   = 0;
+
+                if (t > 0) {
+                    a_z += hb[0 * H + j];
+                    a_r += hb[1 * H + j];
+                    m = hb[2 * H + j];
+                    h = h_ptr[n - N];
+                }
+
+                z_ptr[n] = f_activate_one<function::SIGMOID>(a_z);
+                r_ptr[n] = f_activate_one<function::SIGMOID>(a_r);
+                n_ptr[n] = f_activate_one<activation_function>(xb[2 * H + j] + float(b_h[j]) + r_ptr[n] * m);
+                m_ptr[n] = m;
+                h_ptr[n] = (1.0f - z_ptr[n]) * n_ptr[n] + z_ptr[n] * h;
+            }
+        }
+
+        c.z_t.invalidate_gpu();
+        c.r_t.invalidate_gpu();
+        c.n_t.invalidate_gpu();
+        c.m_t.invalidate_gpu();
+        c.h_t.invalidate_gpu();
+    }
+
+    /*!
+     * \brief Compute the errors of the projections of a time step from the
+     * errors of its output.
+     *
+     * The errors of the input projections are written in d_a_t(t), the
+     * errors of the recurrent projections in d_p_t(t) and d_h is replaced by
+     * the errors carried directly to the previous output.
+     */
+    template <typename DH, typename DA>
+    void gates_backward_kernel(size_t t, size_t Batch, DH& d_h, DA& d_a_t, DA& d_p_t) const {
+        auto& d = as_derived();
+
+        const size_t H = d.hidden_units;
+        const size_t N = Batch * H;
+
+        d_h.ensure_cpu_up_to_date();
+        cache.z_t.ensure_cpu_up_to_date();
+        cache.r_t.ensure_cpu_up_to_date();
+        cache.n_t.ensure_cpu_up_to_date();
+        cache.m_t.ensure_cpu_up_to_date();
+        cache.h_t.ensure_cpu_up_to_date();
+
+        const float* z_ptr = cache.z_t.memory_start() + t * N;
+        const float* r_ptr = cache.r_t.memory_start() + t * N;
+        const float* n_ptr = cache.n_t.memory_start() + t * N;
+        const float* m_ptr = cache.m_t.memory_start() + t * N;
+        const float* h_ptr = cache.h_t.memory_start() + t * N;
+
+        float* dh = d_h.memory_start();
+        float* da = d_a_t.memory_start() + t * 3 * N;
+        float* dp = d_p_t.memory_start() + t * 3 * N;
+
+        for (size_t b = 0; b < Batch; ++b) {
+            for (size_t j = 0; j < H; ++j) {
+                const size_t n = b * H + j;
+
+                const float h_prev = t > 0 ? h_ptr[n - N] : 0.0f;
+
+                const float d_n = dh[n] * (1.0f - z_ptr[n]) * f_derivative_one<activation_function>(n_ptr[n]);
+                const float d_z = dh[n] * (h_prev - n_ptr[n]) * f_derivative_one<function::SIGMOID>(z_ptr[n]);
+                const float d_r = d_n * m_ptr[n] * f_derivative_one<function::SIGMOID>(r_ptr[n]);
+
+                da[b * 3 * H + 0 * H + j] = d_z;
+                da[b * 3 * H + 1 * H + j] = d_r;
+                da[b * 3 * H + 2 * H + j] = d_n;
+
+                dp[b * 3 * H + 0 * H + j] = d_z;
+                dp[b * 3 * H + 1 * H + j] = d_r;
+                dp[b * 3 * H + 2 * H + j] = d_n * r_ptr[n];
+
+                dh[n] = dh[n] * z_ptr[n];
+            }
+        }
+
+        d_h.invalidate_gpu();
+        d_a_t.invalidate_gpu();
+        d_p_t.invalidate_gpu();
+    }
+
+    /*!
+     * \brief Concatenate the weights of the three gates
+     * \param all The concatenated weights [N, 3 * H]
+     */
+    template <typename T>
+    static void concat_gates(T* all, size_t N, size_t H, const T* z, const T* r, const T* h) {
+        for (size_t i = 0; i < N; ++i) {
+            std::copy_n(z + i * H, H, all + (i * 3 + 0) * H);
+            std::copy_n(r + i * H, H, all + (i * 3 + 1) * H);
+            std::copy_n(h + i * H, H, all + (i * 3 + 2) * H);
+        }
+    }
+
+    /*!
+     * \brief Split the concatenated gradients of the three gates
+     * \param all The concatenated gradients [N, 3 * H]
+     */
+    template <typename G, typename A>
+    static void split_gates(G& z, G& r, G& h, const A& all, size_t N) {
+        const size_t H = etl::size(z) / N;
+
+        const float* in = all.memory_start();
+
+        for (size_t i = 0; i < N; ++i) {
+            std::copy_n(in + (i * 3 + 0) * H, H, z.memory_start() + i * H);
+            std::copy_n(in + (i * 3 + 1) * H, H, r.memory_start() + i * H);
+            std::copy_n(in + (i * 3 + 2) * H, H, h.memory_start() + i * H);
+        }
+
+        z.invalidate_gpu();
+        r.invalidate_gpu();
+        h.invalidate_gpu();
+    }
+
+    //CRTP Deduction
+
+    /*!
+     * \brief Returns a reference to the derived object, i.e. the object using the CRTP injector.
+     * \return a reference to the derived object.
+     */
+    derived_t& as_derived() {
+        return *static_cast<derived_t*>(this);
+    }
+
+    /*!
+     * \brief Returns a reference to the derived object, i.e. the object using the CRTP injector.
+     * \return a reference to the derived object.
+     */
+    const derived_t& as_derived() const {
+        return *static_cast<const derived_t*>(this);
+    }
+};
+
+} //end of dll namespace
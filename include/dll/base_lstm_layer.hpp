@@ -8,6 +8,8 @@
 #pragma once
 
 #include <fstream>
+#include <vector>
+#include <algorithm>
 
 #include "cpp_utils/assert.hpp" //Assertions
 #include "cpp_utils/io.hpp"     // For binary writing
@@ -16,7 +18,10 @@
 
 #include "layer.hpp"
 #include "layer_traits.hpp"
+#include "function.hpp"
 #include "util/tmp.hpp"
+#include "util/time_major.hpp"
+#include "util/scratch_arena.hpp"
 
 namespace dll {
 
@@ -32,6 +37,46 @@ struct base_lstm_layer : layer<Derived> {
     using base_type = layer<Derived>;                          ///< The base type
 
     static constexpr auto activation_function = desc::activation_function; ///< The layer's activation function
+    static constexpr size_t bptt_window       = desc::BpttWindow;          ///< The length of the BPTT windows (0 for the complete sequence)
+    static constexpr bool last_step_output    = true;                      ///< The outputs can be only the last time step of the sequences
+    static constexpr bool var_length          = desc::VariableLength;      ///< Indicates if the sequences are zero-padded to the time steps
+
+    static_assert(!var_length || !bptt_window, "The variable length sequences are not supported with the windowed BPTT");
+    static_assert(!var_length || is_element_wise(activation_function), "The variable length sequences need an element-wise activation function");
+
+    etl::dyn_matrix<weight, 2> u_all; ///< The concatenated U weights of the four gates (i, g, f, o)
+    etl::dyn_matrix<weight, 2> w_all; ///< The concatenated W weights of the four gates (i, g, f, o)
+
+    mutable etl::dyn_matrix<float, 3> z_t; ///< The pre-activations of the four gates
+
+    mutable etl::dyn_matrix<float, 2> h_0;    ///< The output carried at the beginning of the current window
+    mutable etl::dyn_matrix<float, 2> s_0;    ///< The state carried at the beginning of the current window
+    mutable etl::dyn_matrix<float, 3> h_ckpt; ///< The outputs at the end of each window
+    mutable etl::dyn_matrix<float, 3> s_ckpt; ///< The states at the end of each window
+
+    mutable std::vector<size_t> lengths; ///< The length of each sequence (only with variable_length)
+    mutable std::vector<size_t> active;  ///< The number of active rows at each time step (only with variable_length)
+
+    /*!
+     * \brief The scratch state of an inference forward pass.
+     *
+     * With its own scratch, a forward pass does not modify the layer and
+     * several threads can use the same layer concurrently.
+     */
+    struct inference_scratch {
+        etl::dyn_matrix<float, 3> x_t; ///< The input (time-major)
+        etl::dyn_matrix<float, 3> z_t; ///< The pre-activations of the four gates
+        etl::dyn_matrix<float, 3> i_t; ///< The input gates
+        etl::dyn_matrix<float, 3> g_t; ///< The cell inputs
+        etl::dyn_matrix<float, 3> f_t; ///< The forget gates
+        etl::dyn_matrix<float, 3> o_t; ///< The output gates
+        etl::dyn_matrix<float, 3> s_t; ///< The states
+        etl::dyn_matrix<float, 3> h_t; ///< The outputs
+        etl::dyn_matrix<float, 2> h_0; ///< The carried output (unused)
+        etl::dyn_matrix<float, 2> s_0; ///< The carried state (unused)
+        std::vector<size_t> lengths;   ///< The length of each sequence
+        std::vector<size_t> active;    ///< The number of active rows at each time step
+    };
 
     /*!
      * \brief Initialize the neural layer
@@ -47,6 +92,14 @@ struct base_lstm_layer : layer<Derived> {
     base_lstm_layer& operator=(const base_lstm_layer& rhs) = delete;
     base_lstm_layer& operator=(base_lstm_layer&& rhs) = delete;
 
+    /*!
+     * \brief Returns the outputs of the last training forward pass, in the
+     * time-major layout [T, B, H]
+     */
+    const etl::dyn_matrix<float, 3>& time_major_outputs() const {
+        return as_derived().h_t;
+    }
+
     /*!
      * \brief Backup the weights in the secondary weights matrix
      */
@@ -81,6 +134,373 @@ struct base_lstm_layer : layer<Derived> {
         as_derived().w_o = *as_derived().bak_w_o;
         as_derived().u_o = *as_derived().bak_u_o;
         as_derived().b_o = *as_derived().bak_b_o;
+
+        weights_changed();
+    }
+
+    /*!
+     * \brief Rebuild the concatenated weights of the gates, must be called
+     * after the weights have been modified.
+     */
+    void weights_changed() {
+        auto& d = as_derived();
+
+        const size_t S = etl::dim<0>(d.u_i);
+        const size_t H = etl::dim<0>(d.w_i);
+
+        if (etl::dim<0>(u_all) != S || etl::dim<1>(u_all) != 4 * H) {
+            u_all = etl::dyn_matrix<weight, 2>(S, 4 * H);
+            w_all = etl::dyn_matrix<weight, 2>(H, 4 * H);
+        }
+
+        concat_gates(u_all, d.u_i, d.u_g, d.u_f, d.u_o);
+        concat_gates(w_all, d.w_i, d.w_g, d.w_f, d.w_o);
+    }
+
+    /*!
+     * \brief Returns the number of time steps held in the caches of the
+     * layer, the complete sequence or a single window.
+     */
+    size_t cache_steps() const {
+        return bptt_window ? bptt_window : as_derived().time_steps;
+    }
+
+    /*!
+     * \brief Forward propagation through time of the input already
+     * rearranged in x_t.
+     *
+     * The input projections of the four gates are computed for all the
+     * time steps at once, with a single GEMM with the concatenated U
+     * weights. Each time step is then a single GEMM of the previous output
+     * with the concatenated W weights, followed by a single element-wise
+     * kernel computing the gates, the state and the output.
+     *
+     * With variable length sequences, the steps after the end of the
+     * longest sequence are skipped and the recurrent projection of each
+     * step is only computed for the leading rows holding the running
+     * sequences. The finished sequences have zero gates, state and output.
+     *
+     * \param c The caches of the forward pass, the layer itself or an inference scratch
+     * \param Batch The number of samples of the batch
+     * \param T The number of time steps in x_t
+     * \param carry Indicates if the sequence starts from the state in h_0 and s_0
+     */
+    template <typename Cache>
+    void forward_fused(Cache& c, size_t Batch, size_t T, bool carry = false) const {
+        const size_t S = as_derived().sequence_length;
+        const size_t H = as_derived().hidden_units;
+
+        auto& z_t = c.z_t;
+        auto& h_0 = c.h_0;
+        auto& s_0 = c.s_0;
+
+        if (etl::size(z_t) != T * Batch * 4 * H) {
+            z_t.resize(T, Batch, 4 * H);
+        }
+
+        // 1. Input projections of all the time steps
+
+        if constexpr (var_length) {
+            padded_lengths(c.lengths, c.active, c.x_t);
+
+            const size_t steps = std::count_if(c.active.begin(), c.active.end(), [](size_t n) { return n > 0; });
+
+            if (steps) {
+                c.x_t.ensure_cpu_up_to_date();
+                z_t.ensure_cpu_up_to_date();
+
+                etl::custom_dyn_matrix<float, 2> x(c.x_t.memory_start(), steps * Batch, S);
+                etl::custom_dyn_matrix<float, 2> z(z_t.memory_start(), steps * Batch, 4 * H);
+
+                z = x * u_all;
+
+                z_t.invalidate_gpu();
+            }
+        } else {
+            etl::reshape(z_t, T * Batch, 4 * H) = etl::reshape(c.x_t, T * Batch, S) * u_all;
+        }
+
+        for (size_t t = 0; t < T; ++t) {
+            // 2. Recurrent projection
+
+            if constexpr (var_length) {
+                const size_t n = c.active[t];
+
+                if (t > 0 && n > 0) {
+                    c.h_t.ensure_cpu_up_to_date();
+                    z_t.ensure_cpu_up_to_date();
+
+                    etl::custom_dyn_matrix<float, 2> h(c.h_t.memory_start() + (t - 1) * Batch * H, n, H);
+                    etl::custom_dyn_matrix<float, 2> z(z_t.memory_start() + t * Batch * 4 * H, n, 4 * H);
+
+                    z += h * w_all;
+
+                    z_t.invalidate_gpu();
+                }
+            } else if (t > 0) {
+                z_t(t) += c.h_t(t - 1) * w_all;
+            } else if (carry) {
+                z_t(0) += h_0 * w_all;
+            }
+
+            // 3. Gates, state and output
+
+            gates_kernel(c, t, Batch, carry);
+
+            if constexpr (!is_element_wise(activation_function)) {
+                if (t == 0 && !carry) {
+                    c.s_t(0) = c.g_t(0) >> c.i_t(0);
+                    c.h_t(0) = f_activate<activation_function>(c.s_t(0)) >> c.o_t(0);
+                } else if (t == 0) {
+                    c.s_t(0) = f_activate<activation_function>((c.g_t(0) >> c.i_t(0)) + (s_0 >> c.f_t(0)));
+                    c.h_t(0) = c.s_t(0) >> c.o_t(0);
+                } else {
+                    c.s_t(t) = f_activate<activation_function>((c.g_t(t) >> c.i_t(t)) + (c.s_t(t - 1) >> c.f_t(t)));
+                    c.h_t(t) = c.s_t(t) >> c.o_t(t);
+                }
+            }
+        }
+    }
+
+    /*!
+     * \brief Apply the layer to the given batch of input, using the given
+     * scratch instead of the caches of the layer.
+     *
+     * \param output A batch of output that will be filled
+     * \param x A batch of input
+     * \param scratch The scratch of the forward pass
+     */
+    template <typename Output, typename V>
+    void inference_forward_batch(Output&& output, const V& x, inference_scratch& scratch) const {
+        auto& d = as_derived();
+
+        const size_t Batch = etl::dim<0>(x);
+        const size_t T     = d.time_steps;
+        const size_t H     = d.hidden_units;
+
+        if (etl::dim<0>(scratch.x_t) != T || etl::dim<1>(scratch.x_t) != Batch) {
+            scratch.x_t.resize(T, Batch, d.sequence_length);
+            scratch.i_t.resize(T, Batch, H);
+            scratch.g_t.resize(T, Batch, H);
+            scratch.f_t.resize(T, Batch, H);
+            scratch.o_t.resize(T, Batch, H);
+            scratch.s_t.resize(T, Batch, H);
+            scratch.h_t.resize(T, Batch, H);
+        }
+
+        swap_batch_time(scratch.x_t, x);
+
+        forward_fused(scratch, Batch, T);
+
+        write_outputs(output, scratch);
+    }
+
+    /*!
+     * \brief Write the time-major outputs of the given caches into the
+     * batch-major outputs
+     *
+     * \param output A batch of output that will be filled
+     * \param c The caches of the forward pass
+     */
+    template <typename Output, typename Cache>
+    void write_outputs(Output&& output, const Cache& c) const {
+        if constexpr (var_length) {
+            outputs_to_batch(output, c.h_t, c.lengths);
+        } else {
+            outputs_to_batch(output, c.h_t);
+        }
+    }
+
+    /*!
+     * \brief Rearrange the batch-major errors into the time-major errors,
+     * the errors of the padding being set to zero.
+     *
+     * \param delta_t The time-major errors
+     * \param errors The batch-major errors
+     */
+    template <typename Delta, typename Errors>
+    void read_errors(Delta&& delta_t, const Errors& errors) const {
+        if constexpr (var_length) {
+            errors_to_time(delta_t, errors, lengths);
+        } else {
+            errors_to_time(delta_t, errors);
+        }
+    }
+
+    /*!
+     * \brief Returns the number of time steps to backpropagate, up to the
+     * end of the longest sequence of the last forward pass.
+     */
+    size_t backward_steps() const {
+        if constexpr (var_length) {
+            return lengths.empty() ? 0 : *std::max_element(lengths.begin(), lengths.end());
+        } else {
+            return as_derived().time_steps;
+        }
+    }
+
+    /*!
+     * \brief Forward propagation of the input, one window at a time.
+     *
+     * Only the output and the state at the end of each window are kept,
+     * the activations of the window are overwritten by the next one.
+     *
+     * \param output A batch of output that will be filled
+     * \param x A batch of input
+     */
+    template <typename Output, typename V>
+    void forward_windowed(Output& output, const V& x) const {
+        auto& d = as_derived();
+
+        const size_t Batch = etl::dim<0>(x);
+        const size_t K     = d.time_steps / bptt_window;
+
+        cpp_assert(d.time_steps % bptt_window == 0, "The BPTT window must divide the number of time steps");
+
+        if (etl::dim<0>(h_ckpt) != K || etl::dim<1>(h_ckpt) != Batch) {
+            h_0.resize(Batch, d.hidden_units);
+            s_0.resize(Batch, d.hidden_units);
+            h_ckpt.resize(K, Batch, d.hidden_units);
+            s_ckpt.resize(K, Batch, d.hidden_units);
+        }
+
+        for (size_t k = 0; k < K; ++k) {
+            forward_window(x, k);
+
+            h_ckpt(k) = d.h_t(bptt_window - 1);
+            s_ckpt(k) = d.s_t(bptt_window - 1);
+
+            outputs_window_to_batch(output, d.h_t, k * bptt_window, d.time_steps);
+        }
+    }
+
+    /*!
+     * \brief Backpropagate the errors window by window, from the last one.
+     *
+     * The activations of each window are recomputed from the state saved
+     * at the end of the previous window and the errors are not propagated
+     * further than the beginning of the window. Apart from the caches of
+     * the window, only the errors of the current time step are stored.
+     *
+     * \param output The ETL expression into which write the output
+     * \param context The training context
+     * \param direct Indicates if the errors of the input must be written to the output
+     */
+    template <typename Output, typename C>
+    void backward_windowed(Output& output, C& context, bool direct) const {
+        auto& d = as_derived();
+
+        const size_t Batch = etl::dim<0>(context.errors);
+        const size_t H     = d.hidden_units;
+        const size_t S     = d.sequence_length;
+
+        auto& w_i_grad = std::get<0>(context.up.context)->grad;
+        auto& u_i_grad = std::get<1>(context.up.context)->grad;
+        auto& b_i_grad = std::get<2>(context.up.context)->grad;
+        auto& w_g_grad = std::get<3>(context.up.context)->grad;
+        auto& u_g_grad = std::get<4>(context.up.context)->grad;
+        auto& b_g_grad = std::get<5>(context.up.context)->grad;
+        auto& w_f_grad = std::get<6>(context.up.context)->grad;
+        auto& u_f_grad = std::get<7>(context.up.context)->grad;
+        auto& b_f_grad = std::get<8>(context.up.context)->grad;
+        auto& w_o_grad = std::get<9>(context.up.context)->grad;
+        auto& u_o_grad = std::get<10>(context.up.context)->grad;
+        auto& b_o_grad = std::get<11>(context.up.context)->grad;
+
+        w_i_grad = 0;
+        u_i_grad = 0;
+        b_i_grad = 0;
+        w_g_grad = 0;
+        u_g_grad = 0;
+        b_g_grad = 0;
+        w_f_grad = 0;
+        u_f_grad = 0;
+        b_f_grad = 0;
+        w_o_grad = 0;
+        u_o_grad = 0;
+        b_o_grad = 0;
+
+        temporary_scope<float> scope;
+
+        auto delta_t = scope.matrix<3>(bptt_window, Batch, H);
+        auto d_x_t   = scope.matrix<3>(bptt_window, Batch, S);
+
+        auto d_h   = scope.matrix<2>(Batch, H);
+        auto d_c   = scope.matrix<2>(Batch, H);
+        auto d_h_o = scope.matrix<2>(Batch, H);
+        auto d_h_i = scope.matrix<2>(Batch, H);
+        auto d_h_f = scope.matrix<2>(Batch, H);
+        auto d_h_c = scope.matrix<2>(Batch, H);
+
+        for (size_t kk = d.time_steps / bptt_window; kk > 0; --kk) {
+            const size_t k = kk - 1;
+
+            forward_window(context.input, k);
+
+            errors_to_time_window(delta_t, context.errors, k * bptt_window, d.time_steps);
+
+            d_h = 0;
+            d_c = 0;
+
+            for (size_t tt = bptt_window; tt > 0; --tt) {
+                const size_t t = tt - 1;
+
+                d_h = delta_t(t) + d_h;
+                d_c = ((d.o_t(t) >> d_h) >> f_derivative<activation_function>(d.s_t(t))) + d_c;
+
+                d_h_o = etl::ml::sigmoid_backward(d.o_t(t), d.s_t(t) >> d_h);
+                d_h_i = etl::ml::sigmoid_backward(d.i_t(t), d.g_t(t) >> d_c);
+                d_h_c = etl::ml::tanh_backward(d.g_t(t), d.i_t(t) >> d_c);
+
+                if (t > 0) {
+                    d_h_f = etl::ml::sigmoid_backward(d.f_t(t), d.s_t(t - 1) >> d_c);
+                } else if (k > 0) {
+                    d_h_f = etl::ml::sigmoid_backward(d.f_t(0), s_0 >> d_c);
+                } else {
+                    d_h_f = 0;
+                }
+
+                b_o_grad += bias_batch_sum_2d(d_h_o);
+                b_i_grad += bias_batch_sum_2d(d_h_i);
+                b_f_grad += bias_batch_sum_2d(d_h_f);
+                b_g_grad += bias_batch_sum_2d(d_h_c);
+
+                u_o_grad += batch_outer(d.x_t(t), d_h_o);
+                u_i_grad += batch_outer(d.x_t(t), d_h_i);
+                u_f_grad += batch_outer(d.x_t(t), d_h_f);
+                u_g_grad += batch_outer(d.x_t(t), d_h_c);
+
+                if (t > 0) {
+                    w_o_grad += batch_outer(d.h_t(t - 1), d_h_o);
+                    w_i_grad += batch_outer(d.h_t(t - 1), d_h_i);
+                    w_f_grad += batch_outer(d.h_t(t - 1), d_h_f);
+                    w_g_grad += batch_outer(d.h_t(t - 1), d_h_c);
+                } else if (k > 0) {
+                    w_o_grad += batch_outer(h_0, d_h_o);
+                    w_i_grad += batch_outer(h_0, d_h_i);
+                    w_f_grad += batch_outer(h_0, d_h_f);
+                    w_g_grad += batch_outer(h_0, d_h_c);
+                }
+
+                // The part going back to x
+                d_x_t(t) = d_h_o * trans(d.u_o);
+                d_x_t(t) += d_h_i * trans(d.u_i);
+                d_x_t(t) += d_h_f * trans(d.u_f);
+                d_x_t(t) += d_h_c * trans(d.u_g);
+
+                // The part going back to h, for the previous step
+                d_h = d_h_o * trans(d.w_o);
+                d_h += d_h_i * trans(d.w_i);
+                d_h += d_h_f * trans(d.w_f);
+                d_h += d_h_c * trans(d.w_g);
+
+                d_c = d.f_t(t) >> d_c;
+            }
+
+            if (direct) {
+                time_window_to_batch(output, d_x_t, k * bptt_window);
+            }
+        }
     }
 
     /*!
@@ -117,6 +537,8 @@ struct base_lstm_layer : layer<Derived> {
         cpp::binary_load_all(is, as_derived().w_o);
         cpp::binary_load_all(is, as_derived().u_o);
         cpp::binary_load_all(is, as_derived().b_o);
+
+        weights_changed();
     }
 
     /*!
@@ -160,6 +582,143 @@ struct base_lstm_layer : layer<Derived> {
     }
 
 private:
+    /*!
+     * \brief Forward propagation through the given window of the input,
+     * starting from the state at the end of the previous window.
+     *
+     * \param x A batch of input
+     * \param k The index of the window
+     */
+    template <typename V>
+    void forward_window(const V& x, size_t k) const {
+        batch_to_time_window(as_derived().x_t, x, k * bptt_window);
+
+        if (k > 0) {
+            h_0 = h_ckpt(k - 1);
+            s_0 = s_ckpt(k - 1);
+        }
+
+        forward_fused(as_derived(), etl::dim<0>(x), bptt_window, k > 0);
+    }
+
+    /*!
+     * \brief Concatenate the weights of the four gates
+     * \param all The concatenated weights [N, 4 * H]
+     */
+    template <typename A, typename M>
+    static void concat_gates(A& all, const M& i, const M& g, const M& f, const M& o) {
+        const size_t N = etl::dim<0>(i);
+        const size_t H = etl::dim<1>(i);
+
+        i.ensure_cpu_up_to_date();
+        g.ensure_cpu_up_to_date();
+        f.ensure_cpu_up_to_date();
+        o.ensure_cpu_up_to_date();
+
+        weight* out = all.memory_start();
+
+        for (size_t r = 0; r < N; ++r) {
+            std::copy_n(i.memory_start() + r * H, H, out + (r * 4 + 0) * H);
+            std::copy_n(g.memory_start() + r * H, H, out + (r * 4 + 1) * H);
+            std::copy_n(f.memory_start() + r * H, H, out + (r * 4 + 2) * H);
+            std::copy_n(o.memory_start() + r * H, H, out + (r * 4 + 3) * H);
+        }
+
+        all.invalidate_gpu();
+    }
+
+    /*!
+     * \brief Compute the gates, the state and the output of a time step
+     * from the pre-activations in z_t.
+     *
+     * The state and the output are only computed here for element-wise
+     * activation functions.
+     *
+     * \param c The caches of the forward pass
+     * \param t The time step
+     * \param Batch The number of samples of the batch
+     * \param carry Indicates if the state before the first step is in s_0
+     */
+    template <typename Cache>
+    void gates_kernel(Cache& c, size_t t, size_t Batch, bool carry) const {
+        auto& d   = as_derived();
+        auto& z_t = c.z_t;
+        auto& s_0 = c.s_0;
+
+        const size_t H = d.hidden_units;
+        const size_t N = Batch * H;
+
+        z_t.ensure_cpu_up_to_date();
+        c.s_t.ensure_cpu_up_to_date();
+        d.b_i.ensure_cpu_up_to_date();
+
+        if (carry) {
+            s_0.ensure_cpu_up_to_date();
+        }
+        d.b_g.ensure_cpu_up_to_date();
+        d.b_f.ensure_cpu_up_to_date();
+        d.b_o.ensure_cpu_up_to_date();
+
+        const float* z = z_t.memory_start() + t * 4 * N;
+
+        float* i_ptr = c.i_t.memory_start() + t * N;
+        float* g_ptr = c.g_t.memory_start() + t * N;
+        float* f_ptr = c.f_t.memory_start() + t * N;
+        float* o_ptr = c.o_t.memory_start() + t * N;
+        float* s_ptr = c.s_t.memory_start() + t * N;
+        float* h_ptr = c.h_t.memory_start() + t * N;
+
+        const float* s_prev = t > 0 ? s_ptr - N : s_0.memory_start();
+
+        const weight* b_i = d.b_i.memory_start();
+        const weight* b_g = d.b_g.memory_start();
+        const weight* b_f = d.b_f.memory_start();
+        const weight* b_o = d.b_o.memory_start();
+
+        for (size_t b = 0; b < Batch; ++b) {
+            const float* zb = z + b * 4 * H;
+
+            // The finished sequences are not updated anymore
+            if constexpr (var_length) {
+                if (t >= c.lengths[b]) {
+                    std::fill_n(i_ptr + b * H, H, 0.0f);
+                    std::fill_n(g_ptr + b * H, H, 0.0f);
+                    std::fill_n(f_ptr + b * H, H, 0.0f);
+                    std::fill_n(o_ptr + b * H, H, 0.0f);
+                    std::fill_n(s_ptr + b * H, H, 0.0f);
+                    std::fill_n(h_ptr + b * H, H, 0.0f);
+                    continue;
+                }
+            }
+
+            for (size_t j = 0; j < H; ++j) {
+                const size_t n = b * H + j;
+
+                i_ptr[n] = f_activate_one<function::SIGMOID>(zb[0 * H + j] + float(b_i[j]));
+                g_ptr[n] = f_activate_one<function::TANH>(zb[1 * H + j] + float(b_g[j]));
+                f_ptr[n] = f_activate_one<function::SIGMOID>(zb[2 * H + j] + float(b_f[j]));
+                o_ptr[n] = f_activate_one<function::SIGMOID>(zb[3 * H + j] + float(b_o[j]));
+
+                if constexpr (is_element_wise(activation_function)) {
+                    if (t == 0 && !carry) {
+                        s_ptr[n] = g_ptr[n] * i_ptr[n];
+                        h_ptr[n] = f_activate_one<activation_function>(s_ptr[n]) * o_ptr[n];
+                    } else {
+                        s_ptr[n] = f_activate_one<activation_function>(g_ptr[n] * i_ptr[n] + s_prev[n] * f_ptr[n]);
+                        h_ptr[n] = s_ptr[n] * o_ptr[n];
+                    }
+                }
+            }
+        }
+
+        c.i_t.invalidate_gpu();
+        c.g_t.invalidate_gpu();
+        c.f_t.invalidate_gpu();
+        c.o_t.invalidate_gpu();
+        c.s_t.invalidate_gpu();
+        c.h_t.invalidate_gpu();
+    }
+
     //CRTP Deduction
 
     /*!
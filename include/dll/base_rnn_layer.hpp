@@ -17,6 +17,8 @@
 #include "layer.hpp"
 #include "layer_traits.hpp"
 #include "util/tmp.hpp"
+#include "util/time_major.hpp"
+#include "util/scratch_arena.hpp"
 
 namespace dll {
 
@@ -32,6 +34,8 @@ struct base_rnn_layer : layer<Derived> {
     using base_type = layer<Derived>;                  ///< The base type
 
     static constexpr auto activation_function = desc::activation_function; ///< The layer's activation function
+    static constexpr size_t bptt_window       = desc::BpttWindow;          ///< The length of the BPTT windows (0 for the complete sequence)
+    static constexpr bool last_step_output    = true;                      ///< The outputs can be only the last time step of the sequences
 
     /*!
      * \brief Initialize the neural layer
@@ -50,10 +54,33 @@ struct base_rnn_layer : layer<Derived> {
     mutable etl::dyn_matrix<float, 3> x_t;
     mutable etl::dyn_matrix<float, 3> s_t;
 
+    mutable etl::dyn_matrix<float, 2> s_0;    ///< The state carried at the beginning of the current window
+    mutable etl::dyn_matrix<float, 3> s_ckpt; ///< The states at the end of each window
+
+    /*!
+     * \brief The scratch state of an inference forward pass.
+     *
+     * With its own scratch, a forward pass does not modify the layer and
+     * several threads can use the same layer concurrently.
+     */
+    struct inference_scratch {
+        etl::dyn_matrix<float, 3> x_t; ///< The input (time-major)
+        etl::dyn_matrix<float, 3> s_t; ///< The states (time-major)
+    };
+
     void prepare_cache(size_t Batch, size_t time_steps, size_t sequence_length, size_t hidden_units) const {
         if (cpp_unlikely(!x_t.memory_start())) {
-            x_t.resize(time_steps, Batch, sequence_length);
-            s_t.resize(time_steps, Batch, hidden_units);
+            const size_t steps = bptt_window ? bptt_window : time_steps;
+
+            x_t.resize(steps, Batch, sequence_length);
+            s_t.resize(steps, Batch, hidden_units);
+
+            if constexpr (bptt_window) {
+                cpp_assert(time_steps % bptt_window == 0, "The BPTT window must divide the number of time steps");
+
+                s_0.resize(Batch, hidden_units);
+                s_ckpt.resize(time_steps / bptt_window, Batch, hidden_units);
+            }
         }
     }
 
@@ -71,31 +98,41 @@ struct base_rnn_layer : layer<Derived> {
 
         prepare_cache(Batch, time_steps, sequence_length, hidden_units);
 
-        // 1. Rearrange input
+        if constexpr (bptt_window) {
+            for (size_t k = 0; k < time_steps / bptt_window; ++k) {
+                forward_window(x, w, u, b, k);
+
+                s_ckpt(k) = s_t(bptt_window - 1);
 
-        for (size_t b = 0; b < Batch; ++b) {
-            for (size_t t = 0; t < time_steps; ++t) {
-                x_t(t)(b) = x(b)(t);
+                outputs_window_to_batch(output, s_t, k * bptt_window, time_steps);
             }
+
+            return;
         }
 
-        // 2. Forward propagation through time
+        forward_sequence(*this, output, x, w, u, b, time_steps);
+    }
 
-        // t == 0
+    /*!
+     * \brief Apply the layer to the given batch of input, using the given
+     * scratch instead of the caches of the layer.
+     *
+     * \param output A batch of output that will be filled
+     * \param x A batch of input
+     * \param scratch The scratch of the forward pass
+     */
+    template <typename H, typename V>
+    void inference_forward_batch(H&& output, const V& x, inference_scratch& scratch) const {
+        auto& d = as_derived();
 
-        s_t(0) = f_activate<activation_function>(bias_add_2d(x_t(0) * u, b));
+        const size_t Batch = etl::dim<0>(x);
 
-        for (size_t t = 1; t < time_steps; ++t) {
-            s_t(t) = f_activate<activation_function>(bias_add_2d(x_t(t) * u + s_t(t - 1) * w, b));
+        if (etl::dim<0>(scratch.x_t) != d.time_steps || etl::dim<1>(scratch.x_t) != Batch) {
+            scratch.x_t.resize(d.time_steps, Batch, d.sequence_length);
+            scratch.s_t.resize(d.time_steps, Batch, d.hidden_units);
         }
 
-        // 3. Rearrange the output
-
-        for (size_t b = 0; b < Batch; ++b) {
-            for (size_t t = 0; t < time_steps; ++t) {
-                output(b)(t) = s_t(t)(b);
-            }
-        }
+        forward_sequence(scratch, output, x, d.w, d.u, d.b, d.time_steps);
     }
 
     /*!
@@ -107,19 +144,25 @@ struct base_rnn_layer : layer<Derived> {
     void backward_batch_impl(H&& output, C& context, const W& w, const U& u, size_t time_steps, size_t sequence_length, size_t hidden_units, size_t bptt_steps, bool direct = true) const {
         cpp_unused(sequence_length);
 
+        if constexpr (bptt_window) {
+            cpp_unused(bptt_steps);
+
+            backward_windowed(output, context, w, u, time_steps, sequence_length, hidden_units, direct);
+
+            return;
+        }
+
         const size_t Batch = etl::dim<0>(context.errors);
 
-        etl::dyn_matrix<float, 3> delta_t(time_steps, Batch, hidden_units);
-        etl::dyn_matrix<float, 3> d_h_t(time_steps, Batch, hidden_units);
-        etl::dyn_matrix<float, 3> d_x_t(time_steps, Batch, sequence_length);
+        temporary_scope<float> scope;
+
+        auto delta_t = scope.matrix<3>(time_steps, Batch, hidden_units);
+        auto d_h_t   = scope.matrix<3>(time_steps, Batch, hidden_units);
+        auto d_x_t   = scope.matrix<3>(time_steps, Batch, sequence_length);
 
         // 1. Rearrange errors
 
-        for (size_t b = 0; b < Batch; ++b) {
-            for (size_t t = 0; t < time_steps; ++t) {
-                delta_t(t)(b) = context.errors(b)(t);
-            }
-        }
+        errors_to_time(delta_t, context.errors);
 
         // 2. Get the gradients from the context
 
@@ -173,11 +216,7 @@ struct base_rnn_layer : layer<Derived> {
         // 3. Rearrange for the output
 
         if (direct) {
-            for (size_t b = 0; b < Batch; ++b) {
-                for (size_t t = 0; t < time_steps; ++t) {
-                    output(b)(t) = d_x_t(t)(b);
-                }
-            }
+            swap_batch_time(output, d_x_t);
         }
     }
 
@@ -192,6 +231,14 @@ struct base_rnn_layer : layer<Derived> {
         }
     }
 
+    /*!
+     * \brief Returns the outputs of the last training forward pass, in the
+     * time-major layout [T, B, H]
+     */
+    const etl::dyn_matrix<float, 3>& time_major_outputs() const {
+        return s_t;
+    }
+
     /*!
      * \brief Backup the weights in the secondary weights matrix
      */
@@ -261,6 +308,121 @@ struct base_rnn_layer : layer<Derived> {
     }
 
 private:
+    /*!
+     * \brief Forward propagation through time of the complete sequences.
+     *
+     * \param cache The caches (x_t and s_t) of the forward pass
+     */
+    template <typename Cache, typename H, typename V, typename W, typename U, typename B>
+    static void forward_sequence(Cache& cache, H&& output, const V& x, const W& w, const U& u, const B& b, size_t time_steps) {
+        auto& x_t = cache.x_t;
+        auto& s_t = cache.s_t;
+
+        // 1. Rearrange input
+
+        swap_batch_time(x_t, x);
+
+        // 2. Forward propagation through time
+
+        // t == 0
+
+        s_t(0) = f_activate<activation_function>(bias_add_2d(x_t(0) * u, b));
+
+        for (size_t t = 1; t < time_steps; ++t) {
+            s_t(t) = f_activate<activation_function>(bias_add_2d(x_t(t) * u + s_t(t - 1) * w, b));
+        }
+
+        // 3. Rearrange the output
+
+        outputs_to_batch(output, s_t);
+    }
+
+    /*!
+     * \brief Forward propagation through the given window of the input,
+     * starting from the state at the end of the previous window.
+     *
+     * \param x A batch of input
+     * \param k The index of the window
+     */
+    template <typename V, typename W, typename U, typename B>
+    void forward_window(const V& x, const W& w, const U& u, const B& b, size_t k) const {
+        batch_to_time_window(x_t, x, k * bptt_window);
+
+        if (k == 0) {
+            s_t(0) = f_activate<activation_function>(bias_add_2d(x_t(0) * u, b));
+        } else {
+            s_0    = s_ckpt(k - 1);
+            s_t(0) = f_activate<activation_function>(bias_add_2d(x_t(0) * u + s_0 * w, b));
+        }
+
+        for (size_t t = 1; t < bptt_window; ++t) {
+            s_t(t) = f_activate<activation_function>(bias_add_2d(x_t(t) * u + s_t(t - 1) * w, b));
+        }
+    }
+
+    /*!
+     * \brief Backpropagate the errors window by window, from the last one.
+     *
+     * The states of each window are recomputed from the state saved at the
+     * end of the previous window and the errors are not propagated further
+     * than the beginning of the window.
+     */
+    template <typename H, typename C, typename W, typename U>
+    void backward_windowed(H&& output, C& context, const W& w, const U& u, size_t time_steps, size_t sequence_length, size_t hidden_units, bool direct) const {
+        const size_t Batch = etl::dim<0>(context.errors);
+
+        temporary_scope<float> scope;
+
+        auto delta_t = scope.matrix<3>(bptt_window, Batch, hidden_units);
+        auto d_x_t   = scope.matrix<3>(bptt_window, Batch, sequence_length);
+        auto d_h     = scope.matrix<2>(Batch, hidden_units);
+
+        auto& w_grad = std::get<0>(context.up.context)->grad;
+        auto& u_grad = std::get<1>(context.up.context)->grad;
+        auto& b_grad = std::get<2>(context.up.context)->grad;
+
+        w_grad = 0;
+        u_grad = 0;
+        b_grad = 0;
+
+        const auto& b = as_derived().b;
+
+        for (size_t kk = time_steps / bptt_window; kk > 0; --kk) {
+            const size_t k = kk - 1;
+
+            forward_window(context.input, w, u, b, k);
+
+            errors_to_time_window(delta_t, context.errors, k * bptt_window, time_steps);
+
+            d_h = 0;
+
+            for (size_t tt = bptt_window; tt > 0; --tt) {
+                const size_t t = tt - 1;
+
+                d_h = (delta_t(t) + d_h) >> f_derivative<activation_function>(s_t(t));
+
+                if (t > 0) {
+                    w_grad += etl::batch_outer(s_t(t - 1), d_h);
+                } else if (k > 0) {
+                    w_grad += etl::batch_outer(s_0, d_h);
+                }
+
+                u_grad += etl::batch_outer(x_t(t), d_h);
+                b_grad += etl::bias_batch_sum_2d(d_h);
+
+                // Gradients to the input
+                d_x_t(t) = d_h * trans(u);
+
+                // Update for next steps
+                d_h = d_h * trans(w);
+            }
+
+            if (direct) {
+                time_window_to_batch(output, d_x_t, k * bptt_window);
+            }
+        }
+    }
+
     //CRTP Deduction
 
     /*!
@@ -0,0 +1,249 @@
+//=======================================================================
+// Copyright (c) 2014-2017 Baptiste Wicht
+// Distributed under the terms of the MIT License.
+// (See accompanying file LICENSE or copy at
+//  http://opensource.org/licenses/MIT)
+//=======================================================================
+
+/*!
+ * \file
+ * \brief Cascade of classifiers, with early exits of the confident samples
+ */
+
+#pragma once
+
+#include <tuple>
+#include <algorithm>
+#include <memory>
+#include <numeric>
+#include <vector>
+#include <utility>
+#include <type_traits>
+
+#include "cpp_utils/assert.hpp"
+
+#include "etl/etl.hpp"
+
+#include "dll/inference_session.hpp"
+
+namespace dll {
+
+/*!
+ * \brief An exit of a cascade: a classifier network (the head) taking the
+ * output of the layer L of the main network
+ */
+template <size_t L, typename Head>
+struct cascade_exit {
+    static constexpr size_t layer = L; ///< The layer of the main network whose output is given to the head
+
+    using head_t = Head; ///< The type of the head network
+};
+
+/*!
+ * \brief A classifier network with early exits.
+ *
+ * The exit heads are evaluated, in order, on the outputs of their layer of
+ * the main network. The samples for which the highest output of a head
+ * (its softmax confidence) reaches the threshold take the outputs of this
+ * head and stop there. Only the remaining samples are compacted into a
+ * smaller batch and forwarded through the next layers. The samples
+ * reaching the end of the network take the outputs of the main network.
+ *
+ * The networks are only read, through inference sessions owned by the
+ * cascade: a cascade must only be used by one thread at a time.
+ */
+template <typename DBN, typename... Exits>
+struct dbn_cascade {
+    static_assert(sizeof...(Exits) > 0, "A cascade needs at least one exit");
+
+    using weight = typename DBN::weight; ///< The data type of the outputs
+
+    static constexpr size_t exits = sizeof...(Exits); ///< The number of exit heads
+
+    using output_t = etl::dyn_matrix<weight, 2>; ///< The type of the outputs [B, C]
+
+    weight threshold; ///< The confidence from which a sample exits at a head
+
+    std::vector<size_t> exited; ///< The number of samples that exited at each head (the last one being the end of the network)
+
+    /*!
+     * \brief Create a cascade of the given network and heads
+     * \param dbn The main network
+     * \param threshold The confidence from which a sample exits at a head
+     * \param heads The exit heads, in the order of their layers
+     */
+    dbn_cascade(const DBN& dbn, weight threshold, const typename Exits::head_t&... heads)
+            : threshold(threshold), exited(exits + 1, 0), main(dbn), heads(heads...) {}
+
+    dbn_cascade(const dbn_cascade& rhs) = delete;
+    dbn_cascade& operator=(const dbn_cascade& rhs) = delete;
+
+    /*!
+     * \brief Forward the given batch through the cascade
+     * \param input The input batch
+     * \return The outputs of the batch, from the head at which each sample exited [B, C]
+     */
+    template <typename Input>
+    output_t forward_batch(const Input& input) {
+        rows.resize(etl::dim<0>(input));
+        std::iota(rows.begin(), rows.end(), 0);
+
+        output_t result;
+
+        forward_stage<0, 0>(input, result, etl::dim<0>(input));
+
+        return result;
+    }
+
+    /*!
+     * \brief Predict the class of each sample of the given batch
+     * \param input The input batch
+     * \return The predicted class of each sample
+     */
+    template <typename Input>
+    std::vector<size_t> predict_batch(const Input& input) {
+        auto result = forward_batch(input);
+
+        std::vector<size_t> labels(etl::dim<0>(result));
+
+        for (size_t b = 0; b < labels.size(); ++b) {
+            labels[b] = std::distance(result(b).begin(), std::max_element(result(b).begin(), result(b).end()));
+        }
+
+        return labels;
+    }
+
+private:
+    /*!
+     * \brief Forward the remaining samples from the layer L of the main
+     * network up to the exit I
+     */
+    template <size_t I, size_t L, typename Input>
+    void forward_stage(const Input& input, output_t& result, size_t B) {
+        if constexpr (I < exits) {
+            constexpr size_t E = std::tuple_element_t<I, std::tuple<Exits...>>::layer;
+
+            static_assert(E >= L && E + 1 < DBN::layers, "The exits must be in order, before the last layer of the network");
+
+            auto features = main.template forward_batch<E, L>(input);
+            auto output   = std::get<I>(heads).forward_batch(features);
+
+            const size_t n = etl::dim<0>(features);
+
+            outputs = etl::reshape(output, n, etl::size(output) / n);
+
+            keep.clear();
+
+            for (size_t s = 0; s < n; ++s) {
+                if (*std::max_element(outputs(s).begin(), outputs(s).end()) >= threshold) {
+                    store(result, B, s);
+                } else {
+                    keep.push_back(s);
+                }
+            }
+
+            exited[I] += n - keep.size();
+
+            if (keep.empty()) {
+                return;
+            }
+
+            // Only the remaining samples continue through the next layers
+            auto remaining = compact(std::move(features), std::make_index_sequence<etl::dimensions<decltype(features)>() - 1>());
+
+            for (size_t k = 0; k < keep.size(); ++k) {
+                rows[k] = rows[keep[k]];
+            }
+
+            rows.resize(keep.size());
+
+            forward_stage<I + 1, E + 1>(remaining, result, B);
+        } else {
+            auto output = main.template forward_batch<DBN::layers - 1, L>(input);
+
+            const size_t n = etl::dim<0>(input);
+
+            outputs = etl::reshape(output, n, etl::size(output) / n);
+
+            for (size_t s = 0; s < n; ++s) {
+                store(result, B, s);
+            }
+
+            exited[exits] += n;
+        }
+    }
+
+    /*!
+     * \brief Store the outputs of the sample s of the current stage into
+     * the result
+     */
+    void store(output_t& result, size_t B, size_t s) {
+        const size_t C = etl::dim<1>(outputs);
+
+        if (etl::dim<0>(result) != B || etl::dim<1>(result) != C) {
+            result = output_t(B, C);
+        }
+
+        result(rows[s]) = outputs(s);
+    }
+
+    /*!
+     * \brief Gather the kept samples of the given batch into a smaller batch
+     */
+    template <typename Features, size_t... D>
+    etl::dyn_matrix<weight, sizeof...(D) + 1> compact(Features&& features, std::index_sequence<D...> /*seq*/) const {
+        using batch_t = etl::dyn_matrix<weight, sizeof...(D) + 1>;
+
+        // Nothing exited, the batch is kept as is
+        if (keep.size() == etl::dim<0>(features)) {
+            if constexpr (std::is_same<std::decay_t<Features>, batch_t>::value) {
+                return std::move(features);
+            } else {
+                batch_t remaining(keep.size(), etl::dim<D + 1>(features)...);
+                remaining = features;
+                return remaining;
+            }
+        }
+
+        batch_t remaining(keep.size(), etl::dim<D + 1>(features)...);
+
+        const size_t n = etl::size(features) / etl::dim<0>(features);
+
+        features.ensure_cpu_up_to_date();
+
+        for (size_t k = 0; k < keep.size(); ++k) {
+            std::copy_n(features.memory_start() + keep[k] * n, n, remaining.memory_start() + k * n);
+        }
+
+        remaining.invalidate_gpu();
+
+        return remaining;
+    }
+
+    dbn_inference_session<DBN> main;                                    ///< The session of the main network
+    std::tuple<dbn_inference_session<typename Exits::head_t>...> heads; ///< The session of each head
+
+    output_t outputs;         ///< The outputs of the current stage
+    std::vector<size_t> rows; ///< The row of the result of each remaining sample
+    std::vector<size_t> keep; ///< The samples of the current stage that continue
+};
+
+/*!
+ * \brief Create a cascade of the given network with the given exit heads
+ *
+ * \tparam L The layer of the main network whose output is given to each head
+ *
+ * \param dbn The main network
+ * \param threshold The confidence from which a sample exits at a head
+ * \param heads The exit heads
+ *
+ * \return The cascade
+ */
+template <size_t... L, typename DBN, typename... Head>
+std::unique_ptr<dbn_cascade<DBN, cascade_exit<L, Head>...>> make_cascade(const DBN& dbn, typename DBN::weight threshold, const Head&... heads) {
+    static_assert(sizeof...(L) == sizeof...(Head), "There must be one layer per exit head");
+
+    return std::make_unique<dbn_cascade<DBN, cascade_exit<L, Head>...>>(dbn, threshold, heads...);
+}
+
+} //end of dll namespace
@@ -0,0 +1,264 @@
+//=======================================================================
+// Copyright (c) 2014-2017 Baptiste Wicht
+// Distributed under the terms of the MIT License.
+// (See accompanying file LICENSE or copy at
+//  http://opensource.org/licenses/MIT)
+//=======================================================================
+
+/*!
+ * \file
+ * \brief Incremental checkpoints of a network, written in the background
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <condition_variable>
+
+namespace dll {
+
+/*!
+ * \brief Incremental checkpoints of the weights of a network.
+ *
+ * Each checkpoint takes a snapshot of the weights of the layers in memory,
+ * in the thread of the caller, and the snapshot is written to the files by
+ * a background thread. The training only waits for the in-memory copy,
+ * not for the files. Each neural layer has its own file and only the
+ * layers whose weights changed since the previous checkpoint are
+ * rewritten. The snapshots are double-buffered: if the writer is still
+ * busy with a checkpoint, the next one replaces the waiting one.
+ *
+ * Each file is written to a temporary file first and then renamed, so
+ * that a crash during a checkpoint leaves the previous version of the
+ * layer in place.
+ *
+ * The training state needed to resume a training can be queued as well,
+ * it is written in its own file after the layers.
+ */
+template <typename DBN>
+struct dbn_checkpointer {
+    using dbn_t = DBN; ///< The type of the network
+
+    /*!
+     * \brief Create a new checkpointer of the given network
+     * \param dbn The network
+     * \param prefix The prefix of the path of the files
+     */
+    dbn_checkpointer(const dbn_t& dbn, const std::string& prefix) : dbn(dbn), prefix(prefix) {
+        dbn.for_each_layer([this](auto& layer) {
+            if constexpr (decay_layer_traits<decltype(layer)>::is_neural_layer()) {
+                ++neural_layers;
+            }
+        });
+
+        // The training state is written after the layers
+        stored.resize(neural_layers);
+        waiting.resize(neural_layers + 1);
+        dirty.resize(neural_layers + 1, false);
+
+        thread = std::thread([this] { work(); });
+    }
+
+    dbn_checkpointer(const dbn_checkpointer& rhs) = delete;
+    dbn_checkpointer& operator=(const dbn_checkpointer& rhs) = delete;
+
+    /*!
+     * \brief Write the waiting checkpoint and stop the writer
+     */
+    ~dbn_checkpointer() {
+        {
+            std::lock_guard<std::mutex> l(main_lock);
+            stop_flag = true;
+        }
+
+        condition.notify_all();
+
+        thread.join();
+    }
+
+    /*!
+     * \brief Returns the path of the file of the given neural layer
+     * \param prefix The prefix of the path of the files
+     * \param r The index of the neural layer
+     */
+    static std::string layer_path(const std::string& prefix, size_t r) {
+        return prefix + ".layer_" + std::to_string(r);
+    }
+
+    /*!
+     * \brief Returns the path of the file of the training state
+     * \param prefix The prefix of the path of the files
+     */
+    static std::string state_path(const std::string& prefix) {
+        return prefix + ".state";
+    }
+
+    /*!
+     * \brief Take a checkpoint of the current weights of the network.
+     *
+     * The weights are copied in memory and the changed layers are queued
+     * for the writer.
+     */
+    void checkpoint() {
+        size_t r = 0;
+
+        dbn.for_each_layer([this, &r](auto& layer) {
+            if constexpr (decay_layer_traits<decltype(layer)>::is_neural_layer()) {
+                std::ostringstream os;
+                layer.store(os);
+
+                auto snapshot = os.str();
+
+                // The last snapshot is only modified by the caller thread
+                if (snapshot != stored[r]) {
+                    stored[r] = snapshot;
+
+                    std::lock_guard<std::mutex> l(main_lock);
+
+                    waiting[r] = std::move(snapshot);
+                    dirty[r]   = true;
+                }
+
+                ++r;
+            }
+        });
+
+        condition.notify_one();
+    }
+
+    /*!
+     * \brief Queue the training state (updater state, counters and position
+     * of the generator) for the writer.
+     *
+     * The state is written after the layers of the checkpoint taken before
+     * it. If the writer is still busy, it replaces the waiting state.
+     *
+     * \param state The training state
+     */
+    void checkpoint_state(std::string state) {
+        {
+            std::lock_guard<std::mutex> l(main_lock);
+
+            waiting[neural_layers] = std::move(state);
+            dirty[neural_layers]   = true;
+        }
+
+        condition.notify_one();
+    }
+
+    /*!
+     * \brief Wait for the writer to write all the queued layers
+     * \return true if all the layers were written so far, false otherwise
+     */
+    bool flush() {
+        std::unique_lock<std::mutex> ulock(main_lock);
+
+        flushed.wait(ulock, [this] { return !writing && std::find(dirty.begin(), dirty.end(), true) == dirty.end(); });
+
+        return !failed;
+    }
+
+    /*!
+     * \brief Returns the number of layer files written so far
+     */
+    size_t written() const {
+        std::lock_guard<std::mutex> l(main_lock);
+        return written_layers;
+    }
+
+private:
+    /*!
+     * \brief The main loop of the writer
+     */
+    void work() {
+        std::string record;
+
+        std::unique_lock<std::mutex> ulock(main_lock);
+
+        while (true) {
+            condition.wait(ulock, [this] { return stop_flag || std::find(dirty.begin(), dirty.end(), true) != dirty.end(); });
+
+            auto it = std::find(dirty.begin(), dirty.end(), true);
+
+            if (it == dirty.end()) {
+                return;
+            }
+
+            const size_t r = std::distance(dirty.begin(), it);
+
+            record.swap(waiting[r]);
+            dirty[r] = false;
+            writing  = true;
+
+            ulock.unlock();
+
+            const bool ok = write_record(r == neural_layers ? state_path(prefix) : layer_path(prefix, r), record);
+
+            ulock.lock();
+
+            writing = false;
+            failed  = failed || !ok;
+            written_layers += ok && r < neural_layers;
+
+            flushed.notify_all();
+        }
+    }
+
+    /*!
+     * \brief Write the file of a layer or of the training state
+     * \param path The path of the file
+     * \param record The weights of the layer or the training state
+     * \return true if the file was written, false otherwise
+     */
+    bool write_record(const std::string& path, const std::string& record) const {
+        const auto tmp = path + ".tmp";
+
+        {
+            std::ofstream os(tmp, std::ofstream::binary);
+
+            os.write(record.data(), record.size());
+
+            if (!os) {
+                std::cerr << "ERROR: Impossible to write checkpoint to " << tmp << std::endl;
+                return false;
+            }
+        }
+
+        if (std::rename(tmp.c_str(), path.c_str())) {
+            std::cerr << "ERROR: Impossible to rename checkpoint to " << path << std::endl;
+            return false;
+        }
+
+        return true;
+    }
+
+    const dbn_t& dbn;   ///< The network
+    std::string prefix; ///< The prefix of the path of the files
+
+    size_t neural_layers  = 0; ///< The number of neural layers
+    size_t written_layers = 0; ///< The number of layer files written
+
+    std::vector<std::string> stored;  ///< The last snapshot of each layer (caller thread only)
+    std::vector<std::string> waiting; ///< The snapshot of each layer (and the training state) waiting for the writer
+    std::vector<bool> dirty;          ///< Indicates if the snapshot of each layer (and the training state) is waiting
+
+    bool writing   = false; ///< Indicates if the writer is writing a layer
+    bool failed    = false; ///< Indicates if a write failed
+    bool stop_flag = false; ///< Indicates if the writer must stop
+
+    mutable std::mutex main_lock;      ///< The lock protecting the waiting snapshots
+    std::condition_variable condition; ///< Wakes up the writer
+    std::condition_variable flushed;   ///< Wakes up the callers of flush
+
+    std::thread thread; ///< The writer thread
+};
+
+} //end of dll namespace
@@ -27,6 +27,9 @@
 #include "decay_type.hpp"
 #include "layer_traits.hpp"
 #include "util/blas.hpp"
+#include "util/scratch_arena.hpp"
+#include "util/sparse_batch.hpp"
+#include "util/memory.hpp"
 
 namespace dll {
 
@@ -41,6 +44,13 @@ struct base_trainer {
 
     bool init = true; ///< Helper to indicate if first epoch of CD
 
+    /*!
+     * \brief Prepare the trainer before the first epoch
+     */
+    void init_training() {
+        //Nothing to prepare by default
+    }
+
     /*!
      * \brief Update the gradients given some type of decay
      * \param grad The gradients to update
@@ -54,6 +64,9 @@ struct base_trainer {
         STATIC_IF_DECAY(decay_type::L1, grad = grad - rbm.l1_weight_cost * abs(value) - penalty);
         STATIC_IF_DECAY(decay_type::L2, grad = grad - rbm.l2_weight_cost * value - penalty);
         STATIC_IF_DECAY(decay_type::L1L2, grad = grad - rbm.l1_weight_cost * abs(value) - rbm.l2_weight_cost * value - penalty);
+
+        // With plain gradient descent, decoupled weight decay is L2 weight decay
+        STATIC_IF_DECAY(decay_type::DECOUPLED, grad = grad - rbm.l2_weight_cost * value - penalty);
     }
 };
 
@@ -112,10 +125,9 @@ void update_normal(RBM& rbm, Trainer& t) {
 
         t.b_grad -= q_local_penalty;
 
-        for (size_t i = 0; i < num_hidden(rbm); ++i) {
-            for (size_t j = 0; j < num_visible(rbm); ++j) {
-                t.w_grad(j, i) -= q_local_penalty(i);
-            }
+        // Row by row, following the layout of the gradients
+        for (size_t j = 0; j < num_visible(rbm); ++j) {
+            t.w_grad(j) -= q_local_penalty;
         }
     }
 
@@ -247,6 +259,324 @@ void update_convolutional(RBM& rbm, Trainer& t) {
 
 /* The training procedures */
 
+/*!
+ * \brief Traits to test if a trainer has a scratch arena for the
+ * temporaries of the batches
+ */
+template <typename T, typename Enable = void>
+struct has_scratch_arena : std::false_type {};
+
+/*!
+ * \copydoc has_scratch_arena
+ */
+template <typename T>
+struct has_scratch_arena<T, std::void_t<decltype(std::declval<T&>().scratch)>> : std::true_type {};
+
+/*!
+ * \brief Copy a (possibly partial) batch into the given buffer, the
+ * missing samples are set to zero
+ */
+template <typename Buffer, typename Batch>
+void copy_batch(Buffer& buffer, const Batch& batch) {
+    const size_t B  = etl::dim<0>(buffer);
+    const size_t IB = etl::dim<0>(batch);
+
+    if (cpp_likely(IB == B)) {
+        buffer = batch;
+    } else {
+        etl::slice(buffer, 0, IB) = batch;
+        etl::slice(buffer, IB, B) = 0;
+    }
+}
+
+/*!
+ * \brief Returns the first buffer if C is true, the second otherwise
+ */
+template <bool C, typename A, typename B>
+decltype(auto) select_buffer(A& a, B& b) {
+    if constexpr (C) {
+        return (a);
+    } else {
+        return (b);
+    }
+}
+
+/*!
+ * \brief Compute the positive gradients of the weights of a fully-connected
+ * RBM, from the non-zero inputs if the inputs are sparse
+ * \param w_grad The gradients of the weights to set
+ * \param vf The batch of (expected) visible units
+ * \param h1_a The batch of hidden activations
+ */
+template <typename RBM, typename G, typename V, typename H>
+void positive_gradients(G&& w_grad, const V& vf, const H& h1_a) {
+    if constexpr (RBM::sparse_input) {
+        sparse_batch<etl::value_t<V>> sparse;
+
+        sparse.update(vf);
+
+        if (sparse.active) {
+            sparse.outer(h1_a, w_grad);
+            return;
+        }
+    }
+
+    w_grad = batch_outer(vf, h1_a);
+}
+
+/*!
+ * \brief Activate the hidden units of a batch and, if a buffer is given,
+ * compute the sums of their activation probabilities over the batch
+ */
+template <bool S, typename RBM, typename HA, typename HS, typename VA, typename VS, typename Sum>
+void activate_hidden_sums(RBM& rbm, HA&& h_a, HS&& h_s, VA&& v_a, VS&& v_s, Sum&& h_sum) {
+    if constexpr (std::is_same<std::decay_t<Sum>, std::nullptr_t>::value) {
+        cpp_unused(h_sum);
+
+        rbm.template batch_activate_hidden<true, S>(h_a, h_s, v_a, v_s);
+    } else {
+        rbm.template batch_activate_hidden_sums<S>(h_a, h_s, v_a, v_s, h_sum);
+    }
+}
+
+/*!
+ * \brief Run the Gibbs chain of (P)CD-K on a batch or on a micro-batch.
+ *
+ * The visible units of the negative phase are never sampled and the hidden
+ * units of the last step are only sampled for the persistent chain. With
+ * MeanField, the intermediate steps of CD-K also use the probabilities of
+ * the hidden units: only the first hidden step (or the persistent chain)
+ * is sampled.
+ *
+ * \param rbm The RBM being trained
+ * \param init Indicates if the persistent chain must be initialized
+ * \param h1_sum If given, set to the sums of the hidden activations of the first step
+ * \param h2_sum If given, set to the sums of the hidden activations of the last step
+ */
+template <bool Persistent, size_t K, bool MeanField, typename RBM, typename V1, typename H1A, typename H1S, typename V2A, typename V2S, typename H2A, typename H2S, typename PHA, typename PHS, typename H1Sum = std::nullptr_t, typename H2Sum = std::nullptr_t>
+void gibbs_chain(RBM& rbm, bool init, V1&& v1, H1A&& h1_a, H1S&& h1_s, V2A&& v2_a, V2S&& v2_s, H2A&& h2_a, H2S&& h2_s, PHA&& p_h_a, PHS&& p_h_s, H1Sum&& h1_sum = nullptr, H2Sum&& h2_sum = nullptr) {
+    //First step
+    activate_hidden_sums<true>(rbm, h1_a, h1_s, v1, v1, h1_sum);
+
+    //CD-1
+    if constexpr (Persistent) {
+        if (init) {
+            p_h_a = h1_a;
+            p_h_s = h1_s;
+        }
+
+        rbm.template batch_activate_visible<true, false>(p_h_a, p_h_s, v2_a, v2_s);
+
+        if constexpr (K == 1) {
+            activate_hidden_sums<true>(rbm, h2_a, h2_s, v2_a, v2_s, h2_sum);
+        } else {
+            rbm.template batch_activate_hidden<true, !MeanField>(h2_a, h2_s, v2_a, v2_s);
+        }
+    } else {
+        cpp_unused(init);
+        cpp_unused(p_h_a);
+        cpp_unused(p_h_s);
+
+        rbm.template batch_activate_visible<true, false>(h1_a, h1_s, v2_a, v2_s);
+
+        if constexpr (K == 1) {
+            activate_hidden_sums<false>(rbm, h2_a, h2_s, v2_a, v2_s, h2_sum);
+        } else {
+            rbm.template batch_activate_hidden<true, !MeanField>(h2_a, h2_s, v2_a, v2_s);
+        }
+    }
+
+    //CD-k
+    for (size_t k = 1; k < K; ++k) {
+        if constexpr (MeanField) {
+            rbm.template batch_activate_visible<true, false>(h2_a, h2_a, v2_a, v2_s);
+        } else {
+            rbm.template batch_activate_visible<true, false>(h2_a, h2_s, v2_a, v2_s);
+        }
+
+        // The last hidden samples are only used by the persistent chain
+        if (k == K - 1) {
+            activate_hidden_sums<Persistent>(rbm, h2_a, h2_s, v2_a, v2_s, h2_sum);
+        } else {
+            rbm.template batch_activate_hidden<true, !MeanField>(h2_a, h2_s, v2_a, v2_s);
+        }
+    }
+}
+
+/*!
+ * \brief The gradients of the micro-batches of a data-parallel trainer
+ * \tparam R The number of micro-batches
+ */
+template <size_t R, typename W, typename B, typename C>
+struct micro_gradients {
+    static_assert(R > 0, "There must be at least one micro-batch");
+
+    cpp::thread_pool<(R > 1)> pool; ///< The pool training the micro-batches
+
+    std::vector<W> w; ///< The gradients of the weights of each micro-batch
+    std::vector<B> b; ///< The gradients of the hidden biases of each micro-batch
+    std::vector<C> c; ///< The gradients of the visible biases of each micro-batch
+
+    /*!
+     * \brief Allocate the gradients of the micro-batches with the shape of
+     * the gradients of the trainer
+     */
+    void init(const W& w_grad, const B& b_grad, const C& c_grad) {
+        if (w.empty()) {
+            w.resize(R, w_grad);
+            b.resize(R, b_grad);
+            c.resize(R, c_grad);
+        }
+    }
+
+    /*!
+     * \brief Returns the number of bytes of the gradients of the micro-batches
+     */
+    size_t memory() const {
+        return memory_bytes(w, b, c);
+    }
+};
+
+/*!
+ * \brief Compute the gradients of a batch by splitting it into
+ * micro-batches trained in parallel. The gradients of the micro-batches
+ * are then reduced into the gradients of the trainer.
+ *
+ * The inputs must already be in the buffers of the trainer.
+ */
+template <bool Persistent, size_t K, bool Conv, typename RBM, typename Trainer>
+void compute_micro_gradients(RBM& rbm, Trainer& t) {
+    dll::auto_timer timer("cd:gradients:micro");
+
+    constexpr size_t R = rbm_layer_traits<RBM>::micro_batches();
+
+    static_assert(R <= RBM::batch_size, "There cannot be more micro-batches than samples in a batch");
+
+    const size_t B = etl::dim<0>(t.v1);
+
+    auto& micro = t.micro;
+
+    micro.init(t.w_grad, t.b_grad, t.c_grad);
+
+    cpp::maybe_parallel_foreach_n(micro.pool, 0, R, [&](size_t r) {
+        const size_t first = r * B / R;
+        const size_t last  = (r + 1) * B / R;
+
+        // The micro-batches are already using all the cores
+        SERIAL_SECTION {
+            auto v1   = etl::slice(t.v1, first, last);
+            auto vf   = etl::slice(t.vf, first, last);
+            auto h1_a = etl::slice(t.h1_a, first, last);
+            auto h1_s = etl::slice(t.h1_s, first, last);
+            auto v2_a = etl::slice(t.v2_a, first, last);
+            auto h2_a = etl::slice(t.h2_a, first, last);
+
+            // The samples are only stored when necessary, the visible ones are never used
+            auto h2_s  = etl::slice(select_buffer<Persistent || (K > 1)>(t.h2_s, t.h2_a), first, last);
+            auto p_h_a = etl::slice(select_buffer<Persistent>(t.p_h_a, t.h1_a), first, last);
+            auto p_h_s = etl::slice(select_buffer<Persistent>(t.p_h_s, t.h1_s), first, last);
+
+            gibbs_chain<Persistent, K, Trainer::mean_field>(rbm, t.init, v1, h1_a, h1_s, v2_a, v2_a, h2_a, h2_s, p_h_a, p_h_s);
+
+            if constexpr (Conv) {
+                micro.w[r] = conv_4d_valid_filter_flipped(vf, h1_a) - conv_4d_valid_filter_flipped(v2_a, h2_a);
+                micro.b[r] = mean_r(sum_l(h1_a - h2_a));
+                micro.c[r] = mean_r(sum_l(vf - v2_a));
+            } else {
+                positive_gradients<RBM>(micro.w[r], vf, h1_a);
+                micro.w[r] -= batch_outer(v2_a, h2_a);
+                micro.b[r] = sum_l(h1_a - h2_a);
+                micro.c[r] = sum_l(vf - v2_a);
+            }
+        }
+    });
+
+    //Reduce the gradients
+
+    t.w_grad = micro.w[0];
+    t.b_grad = micro.b[0];
+    t.c_grad = micro.c[0];
+
+    for (size_t r = 1; r < R; ++r) {
+        t.w_grad += micro.w[r];
+        t.b_grad += micro.b[r];
+        t.c_grad += micro.c[r];
+    }
+}
+
+/*!
+ * \brief The partial filter gradients of the batch slices of a
+ * convolutional trainer (parallel_gradients)
+ * \tparam S The number of slices
+ */
+template <size_t S, typename W>
+struct slice_gradients {
+    static_assert(S > 0, "There must be at least one slice");
+
+    cpp::thread_pool<(S > 1)> pool; ///< The pool computing the slices
+
+    std::vector<W> w; ///< The filter gradients of each slice
+
+    /*!
+     * \brief Allocate the gradients of the slices with the shape of the
+     * gradients of the trainer
+     */
+    void init(const W& w_grad) {
+        if (w.empty()) {
+            w.resize(S, w_grad);
+        }
+    }
+
+    /*!
+     * \brief Returns the number of bytes of the gradients of the slices
+     */
+    size_t memory() const {
+        return memory_bytes(w);
+    }
+};
+
+/*!
+ * \brief Compute the filter gradients of a convolutional RBM by splitting
+ * the batch into slices whose positive and negative gradients are computed
+ * in parallel. The partial gradients are then reduced into the gradients
+ * of the trainer.
+ *
+ * The Gibbs chain must already have been computed on the whole batch.
+ */
+template <typename RBM, typename Trainer>
+void compute_slice_gradients(Trainer& t) {
+    dll::auto_timer timer("cd:gradients:slices");
+
+    constexpr size_t S = rbm_layer_traits<RBM>::gradient_slices();
+
+    static_assert(S <= RBM::batch_size, "There cannot be more slices than samples in a batch");
+
+    const size_t B = etl::dim<0>(t.v1);
+
+    auto& slices = t.slices;
+
+    slices.init(t.w_grad);
+
+    cpp::maybe_parallel_foreach_n(slices.pool, 0, S, [&](size_t s) {
+        const size_t first = s * B / S;
+        const size_t last  = (s + 1) * B / S;
+
+        // The slices are already using all the cores
+        SERIAL_SECTION {
+            slices.w[s] = conv_4d_valid_filter_flipped(etl::slice(t.vf, first, last), etl::slice(t.h1_a, first, last));
+            slices.w[s] -= conv_4d_valid_filter_flipped(etl::slice(t.v2_a, first, last), etl::slice(t.h2_a, first, last));
+        }
+    });
+
+    //Reduce the gradients
+
+    t.w_grad = slices.w[0];
+
+    for (size_t s = 1; s < S; ++s) {
+        t.w_grad += slices.w[s];
+    }
+}
+
 /*!
  * \brief Compute the gradients for a fully-connected RBM
  */
@@ -262,58 +592,47 @@ void compute_gradients_normal(InputBatch& input_batch, ExpectedBatch& expected_b
     cpp_assert(etl::size(t.v1) >= etl::size(input_batch), "Invalid input to compute_gradients_normal");
     cpp_assert(etl::size(t.vf) >= etl::size(expected_batch), "Invalid input to compute_gradients_normal");
 
-    const auto B          = etl::dim<0>(t.v1);
-    const size_t IB       = etl::dim<0>(input_batch);
-    const bool full_batch = (IB == RBM::batch_size);
+    const auto B = etl::dim<0>(t.v1);
 
     //Copy input/expected for computations
-    if(cpp_likely(full_batch)){
-        t.v1 = input_batch;
-        t.vf = expected_batch;
-    } else {
-        t.v1 = 0;
-        t.vf = 0;
+    copy_batch(t.v1, input_batch);
+    copy_batch(t.vf, expected_batch);
 
-        etl::slice(t.v1, 0, IB) = input_batch;
-        etl::slice(t.vf, 0, IB) = expected_batch;
-    }
+    // Transpose the weights once for all the visible activations of the chain
+    rbm.prepare_weights();
 
-    //First step
-    rbm.template batch_activate_hidden<true, true>(t.h1_a, t.h1_s, t.v1, t.v1);
+    if constexpr (rbm_layer_traits<RBM>::micro_batches() > 1) {
+        compute_micro_gradients<Persistent, K, false>(rbm, t);
 
-    if (Persistent && t.init) {
-        t.p_h_a = t.h1_a;
-        t.p_h_s = t.h1_s;
-    }
+        t.h2_sum = sum_l(t.h2_a);
 
-    //CD-1
-    if constexpr (Persistent) {
-        rbm.template batch_activate_visible<true, false>(t.p_h_a, t.p_h_s, t.v2_a, t.v2_s);
-        rbm.template batch_activate_hidden<true, true>(t.h2_a, t.h2_s, t.v2_a, t.v2_s);
-    } else {
-        rbm.template batch_activate_visible<true, false>(t.h1_a, t.h1_s, t.v2_a, t.v2_s);
-        rbm.template batch_activate_hidden<true, (K > 1)>(t.h2_a, t.h2_s, t.v2_a, t.v2_s);
+        return;
     }
 
-    //CD-k
-    for (size_t k = 1; k < K; ++k) {
-        rbm.template batch_activate_visible<true, false>(t.h2_a, t.h2_s, t.v2_a, t.v2_s);
-        rbm.template batch_activate_hidden<true, true>(t.h2_a, t.h2_s, t.v2_a, t.v2_s);
-    }
+    // The sums of the hidden activations are computed by the activation kernels
+    gibbs_chain<Persistent, K, Trainer::mean_field>(rbm, t.init, t.v1, t.h1_a, t.h1_s, t.v2_a, t.v2_s, t.h2_a, t.h2_s,
+                                                    select_buffer<Persistent>(t.p_h_a, t.h1_a), select_buffer<Persistent>(t.p_h_s, t.h1_s), t.h1_sum, t.h2_sum);
 
     //Compute the gradients
 
     {
         dll::auto_timer timer("cd:batch_compute_gradients:std");
 
-        t.w_grad = batch_outer(t.vf, t.h1_a);
-        t.w_grad -= batch_outer(t.v2_a, t.h2_a);
+        positive_gradients<RBM>(t.w_grad, t.vf, t.h1_a);
 
-        t.b_grad = t.h1_a(0) - t.h2_a(0);
-        for (size_t b = 1; b < B; b++) {
-            t.b_grad += t.h1_a(b) - t.h2_a(b);
+        if constexpr (has_scratch_arena<Trainer>::value) {
+            t.scratch.reset();
+
+            auto w_neg = t.scratch.template matrix<2>(etl::dim<0>(t.w_grad), etl::dim<1>(t.w_grad));
+
+            w_neg = batch_outer(t.v2_a, t.h2_a);
+            t.w_grad -= w_neg;
+        } else {
+            t.w_grad -= batch_outer(t.v2_a, t.h2_a);
         }
 
+        t.b_grad = t.h1_sum - t.h2_sum;
+
         t.c_grad = t.vf(0) - t.v2_a(0);
         for (size_t b = 1; b < B; b++) {
             t.c_grad += t.vf(b) - t.v2_a(b);
@@ -341,21 +660,28 @@ void train_normal(InputBatch& input_batch, ExpectedBatch& expected_batch, rbm_tr
         t.init = false;
     }
 
-    context.batch_error = mean((t.vf - t.v2_a) >> (t.vf - t.v2_a));
+    if (context.monitor) {
+        context.batch_error = mean((t.vf - t.v2_a) >> (t.vf - t.v2_a));
+    }
 
     nan_check_deep_3(t.w_grad, t.b_grad, t.c_grad);
 
-    //Compute the mean activation probabilities
-    t.q_global_batch = mean(t.h2_a);
+    //Compute the mean activation probabilities from the sums of the activations
+    const auto B = etl::dim<0>(t.h2_a);
+
+    t.q_global_batch = sum(t.h2_sum) / (B * etl::size(t.h2_sum));
 
     if constexpr (rbm_layer_traits<rbm_t>::sparsity_method() == sparsity_method::LOCAL_TARGET) {
-        t.q_local_batch = mean_l(t.h2_a);
+        t.q_local_batch = t.h2_sum / B;
     }
 
     context.batch_sparsity = t.q_global_batch;
 
     //Update the weights and biases based on the gradients
     t.update(rbm);
+
+    //The transposed weights are now outdated
+    rbm.release_weights();
 }
 
 /*!
@@ -367,51 +693,50 @@ void compute_gradients_conv(InputBatch& input_batch, ExpectedBatch& expected_bat
 
     cpp_assert(etl::dim<0>(input_batch) == etl::dim<0>(expected_batch), "Invalid batch sizes");
 
-    const size_t B        = etl::dim<0>(input_batch);
-    const bool full_batch = etl::dim<0>(input_batch) == RBM::batch_size;
-
     //Copy input/expected for computations
-    if(cpp_likely(full_batch)){
-        t.v1 = input_batch;
-        t.vf = expected_batch;
-    } else {
-        t.v1 = 0;
-        t.vf = 0;
-
-        etl::slice(t.v1, 0, B) = input_batch;
-        etl::slice(t.vf, 0, B) = expected_batch;
-    }
+    copy_batch(t.v1, input_batch);
+    copy_batch(t.vf, expected_batch);
 
-    //First step
-    rbm.template batch_activate_hidden<true, true>(t.h1_a, t.h1_s, t.v1, t.v1);
-
-    if (Persistent && t.init) {
-        t.p_h_a = t.h1_a;
-        t.p_h_s = t.h1_s;
-    }
+    // Use the FFT path for all the activations of the chain, if faster
+    rbm.prepare_filters(t.v1);
 
-    //CD-1
-    if (Persistent) {
-        rbm.template batch_activate_visible<true, false>(t.p_h_a, t.p_h_s, t.v2_a, t.v2_s);
-        rbm.template batch_activate_hidden<true, true>(t.h2_a, t.h2_s, t.v2_a, t.v2_s);
-    } else {
-        rbm.template batch_activate_visible<true, false>(t.h1_a, t.h1_s, t.v2_a, t.v2_s);
-        rbm.template batch_activate_hidden<true, (N > 1)>(t.h2_a, t.h2_s, t.v2_a, t.v2_s);
+    if constexpr (rbm_layer_traits<RBM>::micro_batches() > 1) {
+        compute_micro_gradients<Persistent, N, true>(rbm, t);
+        return;
     }
 
-    //CD-k
-    for (size_t k = 1; k < N; ++k) {
-        rbm.template batch_activate_visible<true, false>(t.h2_a, t.h2_s, t.v2_a, t.v2_s);
-        rbm.template batch_activate_hidden<true, true>(t.h2_a, t.h2_s, t.v2_a, t.v2_s);
-    }
+    gibbs_chain<Persistent, N, Trainer::mean_field>(rbm, t.init, t.v1, t.h1_a, t.h1_s, t.v2_a, t.v2_s, t.h2_a, t.h2_s,
+                                                    select_buffer<Persistent>(t.p_h_a, t.h1_a), select_buffer<Persistent>(t.p_h_s, t.h1_s));
 
     //Compute gradients
 
     {
         dll::auto_timer timer("cd:batch_compute_gradients_conv");
 
-        t.w_pos = conv_4d_valid_filter_flipped(t.vf, t.h1_a);
-        t.w_neg = conv_4d_valid_filter_flipped(t.v2_a, t.h2_a);
+        if constexpr (rbm_layer_traits<RBM>::gradient_slices() > 1) {
+            compute_slice_gradients<RBM>(t);
+        } else {
+            t.w_pos = conv_4d_valid_filter_flipped(t.vf, t.h1_a);
+            t.w_neg = conv_4d_valid_filter_flipped(t.v2_a, t.h2_a);
+
+            t.w_grad = t.w_pos - t.w_neg;
+        }
+
+        if constexpr (has_scratch_arena<Trainer>::value) {
+            t.scratch.reset();
+
+            auto h_sum = t.scratch.template matrix<3>(etl::dim<1>(t.h1_a), etl::dim<2>(t.h1_a), etl::dim<3>(t.h1_a));
+            auto v_sum = t.scratch.template matrix<3>(etl::dim<1>(t.v1), etl::dim<2>(t.v1), etl::dim<3>(t.v1));
+
+            h_sum = sum_l(t.h1_a - t.h2_a);
+            v_sum = sum_l(t.vf - t.v2_a);
+
+            t.b_grad = mean_r(h_sum);
+            t.c_grad = mean_r(v_sum);
+        } else {
+            t.b_grad = mean_r(sum_l(t.h1_a - t.h2_a));
+            t.c_grad = mean_r(sum_l(t.vf - t.v2_a));
+        }
     }
 }
 
@@ -433,11 +758,6 @@ void train_convolutional(InputBatch& input_batch, ExpectedBatch& expected_batch,
         t.init = false;
     }
 
-    //Compute the gradients
-    t.w_grad = t.w_pos - t.w_neg;
-    t.b_grad = mean_r(sum_l(t.h1_a - t.h2_a));
-    t.c_grad = mean_r(sum_l(t.vf - t.v2_a));
-
     nan_check_deep(t.w_grad);
     nan_check_deep(t.b_grad);
     nan_check_deep(t.c_grad);
@@ -453,17 +773,29 @@ void train_convolutional(InputBatch& input_batch, ExpectedBatch& expected_batch,
 
     //Only b_bias are supported for now
     if constexpr (rbm_layer_traits<rbm_t>::sparsity_method() == sparsity_method::LEE && rbm_layer_traits<rbm_t>::bias_mode() == bias_mode::SIMPLE) {
-        t.b_bias = mean_r(mean_l(t.h2_a)) - rbm.pbias;
+        if constexpr (has_scratch_arena<Trainer>::value) {
+            auto h_mean = t.scratch.template matrix<3>(etl::dim<1>(t.h2_a), etl::dim<2>(t.h2_a), etl::dim<3>(t.h2_a));
+
+            h_mean   = mean_l(t.h2_a);
+            t.b_bias = mean_r(h_mean) - rbm.pbias;
+        } else {
+            t.b_bias = mean_r(mean_l(t.h2_a)) - rbm.pbias;
+        }
     }
 
     //Accumulate the sparsity
     context.batch_sparsity = t.q_global_batch;
 
     //Accumulate the error
-    context.batch_error = mean(etl::scale((t.vf - t.v2_a), (t.vf - t.v2_a)));
+    if (context.monitor) {
+        context.batch_error = mean(etl::scale((t.vf - t.v2_a), (t.vf - t.v2_a)));
+    }
 
     //Update the weights and biases based on the gradients
     t.update(rbm);
+
+    //The frequency-domain filters are now outdated
+    rbm.release_filters();
 }
 
 /* The specialized trainers */
@@ -473,10 +805,12 @@ void train_convolutional(InputBatch& input_batch, ExpectedBatch& expected_batch,
  *
  * This class provides update which applies the gradients to the RBM.
  */
-template <size_t N, typename RBM, bool Persistent, typename Enable = void>
+template <size_t N, typename RBM, bool Persistent, bool MeanField = false, typename Enable = void>
 struct base_cd_trainer : base_trainer<RBM> {
     static_assert(N > 0, "(P)CD-0 is not a valid training method");
 
+    static constexpr bool mean_field = MeanField; ///< Indicates if the intermediate hidden steps use their probabilities
+
     using rbm_t  = RBM;                    ///< The type of RBM being trained
     using weight = typename rbm_t::weight; ///< The data type for this layer
 
@@ -498,11 +832,16 @@ struct base_cd_trainer : base_trainer<RBM> {
     etl::fast_matrix<weight, batch_size, num_hidden> h2_a; ///< The hidden activation probabilites at step N
     etl::fast_matrix<weight, batch_size, num_hidden> h2_s; ///< The hidden states at step N
 
+    etl::fast_vector<weight, num_hidden> h1_sum; ///< The sums of the hidden activation probabilities at step one
+    etl::fast_vector<weight, num_hidden> h2_sum; ///< The sums of the hidden activation probabilities at step N
+
     //Gradients
     etl::fast_matrix<weight, num_visible, num_hidden> w_grad; ///< The gradients of the weights
     etl::fast_vector<weight, num_hidden> b_grad;              ///< The gradients of the hidden biases
     etl::fast_vector<weight, num_visible> c_grad;             ///< The gradients of the visible biases
 
+    micro_gradients<rbm_layer_traits<rbm_t>::micro_batches(), decltype(w_grad), decltype(b_grad), decltype(c_grad)> micro; ///< The gradients of the micro-batches (data_parallel)
+
     //{{{ Momentum
 
     etl::fast_matrix<weight, num_visible, num_hidden> w_inc; ///< The gradients of the weights at the previous step for momentum
@@ -548,11 +887,18 @@ struct base_cd_trainer : base_trainer<RBM> {
         train_normal<Persistent, N>(input_batch, expected_batch, context, rbm, *this);
     }
 
+    /*!
+     * \brief Returns the number of bytes of the buffers of the trainer
+     */
+    size_t memory() const {
+        return memory_bytes(v1, vf, h1_a, h1_s, v2_a, v2_s, h2_a, h2_s, h1_sum, h2_sum, w_grad, b_grad, c_grad, micro, w_inc, b_inc, c_inc, q_local_batch, q_local_t, p_h_a, p_h_s);
+    }
+
     /*!
      * \brief The name of the trainer
      */
     static std::string name() {
-        return std::string("") + (Persistent ? "Persistent " : "") + "Contrastive Divergence";
+        return std::string("") + (MeanField ? "Mean-Field " : "") + (Persistent ? "Persistent " : "") + "Contrastive Divergence";
     }
 };
 
@@ -561,10 +907,12 @@ struct base_cd_trainer : base_trainer<RBM> {
  *
  * This class provides update which applies the gradients to the RBM.
  */
-template <size_t N, typename RBM, bool Persistent>
-struct base_cd_trainer<N, RBM, Persistent, std::enable_if_t<layer_traits<RBM>::is_dynamic() && !layer_traits<RBM>::is_convolutional_rbm_layer()>> : base_trainer<RBM> {
+template <size_t N, typename RBM, bool Persistent, bool MeanField>
+struct base_cd_trainer<N, RBM, Persistent, MeanField, std::enable_if_t<layer_traits<RBM>::is_dynamic() && !layer_traits<RBM>::is_convolutional_rbm_layer()>> : base_trainer<RBM> {
     static_assert(N > 0, "(P)CD-0 is not a valid training method");
 
+    static constexpr bool mean_field = MeanField; ///< Indicates if the intermediate hidden steps use their probabilities
+
     using rbm_t  = RBM;                    ///< The type of RBM being trained
     using weight = typename rbm_t::weight; ///< The weight data type
 
@@ -584,11 +932,18 @@ struct base_cd_trainer<N, RBM, Persistent, std::enable_if_t<layer_traits<RBM>::i
     etl::dyn_matrix<weight> h2_a; ///< The hidden activations at step K
     etl::dyn_matrix<weight> h2_s; ///< The hidden samples at step K
 
+    etl::dyn_vector<weight> h1_sum; ///< The sums of the hidden activations at step 1
+    etl::dyn_vector<weight> h2_sum; ///< The sums of the hidden activations at step K
+
     //Gradients
     etl::dyn_matrix<weight> w_grad; ///< The gradients of the weights
     etl::dyn_vector<weight> b_grad; ///< The gradients of the hidden biases
     etl::dyn_vector<weight> c_grad; ///< The gradients of the visible biases
 
+    micro_gradients<rbm_layer_traits<rbm_t>::micro_batches(), decltype(w_grad), decltype(b_grad), decltype(c_grad)> micro; ///< The gradients of the micro-batches (data_parallel)
+
+    scratch_arena<weight> scratch; ///< The scratch memory for the temporaries of the batches
+
     //{{{ Momentum
 
     etl::dyn_matrix<weight> w_inc; ///< The gradients of the weights at the previous step, for momentum
@@ -621,6 +976,8 @@ struct base_cd_trainer<N, RBM, Persistent, std::enable_if_t<layer_traits<RBM>::i
               v2_s(batch_size, rbm.num_visible),
               h2_a(batch_size, rbm.num_hidden),
               h2_s(batch_size, rbm.num_hidden),
+              h1_sum(rbm.num_hidden),
+              h2_sum(rbm.num_hidden),
               w_grad(rbm.num_visible, rbm.num_hidden),
               b_grad(rbm.num_hidden),
               c_grad(rbm.num_visible),
@@ -646,6 +1003,8 @@ struct base_cd_trainer<N, RBM, Persistent, std::enable_if_t<layer_traits<RBM>::i
               v2_s(batch_size, rbm.num_visible),
               h2_a(batch_size, rbm.num_hidden),
               h2_s(batch_size, rbm.num_hidden),
+              h1_sum(rbm.num_hidden),
+              h2_sum(rbm.num_hidden),
               w_grad(rbm.num_visible, rbm.num_hidden),
               b_grad(rbm.num_hidden),
               c_grad(rbm.num_visible),
@@ -660,6 +1019,14 @@ struct base_cd_trainer<N, RBM, Persistent, std::enable_if_t<layer_traits<RBM>::i
         static_assert(rbm_layer_traits<rbm_t>::has_momentum(), "This constructor should only be used with momentum support");
     }
 
+    /*!
+     * \brief Size the scratch memory once for all the batches
+     */
+    void init_training() {
+        //The negative statistics of the weights
+        scratch.reserve(rbm.num_visible * rbm.num_hidden);
+    }
+
     /*!
      * \brief Update the given RBM
      */
@@ -675,11 +1042,18 @@ struct base_cd_trainer<N, RBM, Persistent, std::enable_if_t<layer_traits<RBM>::i
         train_normal<Persistent, N>(input_batch, expected_batch, context, rbm, *this);
     }
 
+    /*!
+     * \brief Returns the number of bytes of the buffers of the trainer
+     */
+    size_t memory() const {
+        return memory_bytes(v1, vf, h1_a, h1_s, v2_a, v2_s, h2_a, h2_s, h1_sum, h2_sum, w_grad, b_grad, c_grad, micro, w_inc, b_inc, c_inc, q_local_batch, q_local_t, p_h_a, p_h_s) + scratch.size() * sizeof(weight);
+    }
+
     /*!
      * \brief Return the name of the trainer
      */
     static std::string name() {
-        return std::string("") + (Persistent ? "Persistent " : "") + "Contrastive Divergence (dynamic)";
+        return std::string("") + (MeanField ? "Mean-Field " : "") + (Persistent ? "Persistent " : "") + "Contrastive Divergence (dynamic)";
     }
 };
 
@@ -688,10 +1062,12 @@ struct base_cd_trainer<N, RBM, Persistent, std::enable_if_t<layer_traits<RBM>::i
  *
  * This class provides update which applies the gradients to the RBM.
  */
-template <size_t N, typename RBM, bool Persistent>
-struct base_cd_trainer<N, RBM, Persistent, std::enable_if_t<!layer_traits<RBM>::is_dynamic() && layer_traits<RBM>::is_convolutional_rbm_layer()>> : base_trainer<RBM> {
+template <size_t N, typename RBM, bool Persistent, bool MeanField>
+struct base_cd_trainer<N, RBM, Persistent, MeanField, std::enable_if_t<!layer_traits<RBM>::is_dynamic() && layer_traits<RBM>::is_convolutional_rbm_layer()>> : base_trainer<RBM> {
     static_assert(N > 0, "(P)CD-0 is not a valid training method");
 
+    static constexpr bool mean_field = MeanField; ///< Indicates if the intermediate hidden steps use their probabilities
+
     using rbm_t  = RBM;                    ///< The type of the RBM being trained
     using weight = typename rbm_t::weight; ///< The weight data type
 
@@ -715,6 +1091,9 @@ struct base_cd_trainer<N, RBM, Persistent, std::enable_if_t<!layer_traits<RBM>::
     etl::fast_vector<weight, K> b_grad;      ///< Gradients of hidden biases
     etl::fast_vector<weight, NC> c_grad;     ///< Gradients of visible biases
 
+    micro_gradients<rbm_layer_traits<rbm_t>::micro_batches(), decltype(w_grad), decltype(b_grad), decltype(c_grad)> micro; ///< The gradients of the micro-batches (data_parallel)
+    slice_gradients<rbm_layer_traits<rbm_t>::gradient_slices(), decltype(w_grad)> slices; ///< The filter gradients of the batch slices (parallel_gradients)
+
     //{{{ Momentum
 
     etl::fast_matrix<weight, W_DIMS> w_inc; ///< Gradients of the weights weights of the previous step, for momentum
@@ -791,11 +1170,18 @@ struct base_cd_trainer<N, RBM, Persistent, std::enable_if_t<!layer_traits<RBM>::
         train_convolutional<Persistent, N>(input_batch, expected_batch, context, rbm, *this);
     }
 
+    /*!
+     * \brief Returns the number of bytes of the buffers of the trainer
+     */
+    size_t memory() const {
+        return memory_bytes(w_grad, b_grad, c_grad, micro, slices, w_inc, b_inc, c_inc, q_local_batch, q_local_t, w_bias, b_bias, c_bias, p_h_a, p_h_s, w_pos, w_neg, v1, vf, h1_a, h1_s, v2_a, v2_s, h2_a, h2_s);
+    }
+
     /*!
      * \brief Return the name of the trainer
      */
     static std::string name() {
-        return std::string("") + (Persistent ? "Persistent " : "") + "Contrastive Divergence (convolutional)";
+        return std::string("") + (MeanField ? "Mean-Field " : "") + (Persistent ? "Persistent " : "") + "Contrastive Divergence (convolutional)";
     }
 };
 
@@ -804,10 +1190,12 @@ struct base_cd_trainer<N, RBM, Persistent, std::enable_if_t<!layer_traits<RBM>::
  *
  * This class provides update which applies the gradients to the RBM.
  */
-template <size_t N, typename RBM, bool Persistent>
-struct base_cd_trainer<N, RBM, Persistent, std::enable_if_t<layer_traits<RBM>::is_dynamic() && layer_traits<RBM>::is_convolutional_rbm_layer()>> : base_trainer<RBM> {
+template <size_t N, typename RBM, bool Persistent, bool MeanField>
+struct base_cd_trainer<N, RBM, Persistent, MeanField, std::enable_if_t<layer_traits<RBM>::is_dynamic() && layer_traits<RBM>::is_convolutional_rbm_layer()>> : base_trainer<RBM> {
     static_assert(N > 0, "(P)CD-0 is not a valid training method");
 
+    static constexpr bool mean_field = MeanField; ///< Indicates if the intermediate hidden steps use their probabilities
+
     using rbm_t  = RBM;                    ///< The type of the RBM being trained
     using weight = typename rbm_t::weight; ///< The data type
 
@@ -822,6 +1210,11 @@ struct base_cd_trainer<N, RBM, Persistent, std::enable_if_t<layer_traits<RBM>::i
     etl::dyn_matrix<weight, 1> b_grad; ///< Gradients of hidden biases bk
     etl::dyn_matrix<weight, 1> c_grad; ///< Visible gradient
 
+    micro_gradients<rbm_layer_traits<rbm_t>::micro_batches(), decltype(w_grad), decltype(b_grad), decltype(c_grad)> micro; ///< The gradients of the micro-batches (data_parallel)
+    slice_gradients<rbm_layer_traits<rbm_t>::gradient_slices(), decltype(w_grad)> slices; ///< The filter gradients of the batch slices (parallel_gradients)
+
+    scratch_arena<weight> scratch; ///< The scratch memory for the temporaries of the batches
+
     //{{{ Momentum
 
     etl::dyn_matrix<weight, 4> w_inc; ///< Gradients of the weights of the previous step, for momentum
@@ -896,6 +1289,17 @@ struct base_cd_trainer<N, RBM, Persistent, std::enable_if_t<layer_traits<RBM>::i
         //Nothign else to init
     }
 
+    /*!
+     * \brief Size the scratch memory once for all the batches
+     */
+    void init_training() {
+        const size_t h_size = rbm.k * rbm.nh1 * rbm.nh2;
+        const size_t v_size = rbm.nc * rbm.nv1 * rbm.nv2;
+
+        //The sums of the hidden and visible statistics and the mean hidden activations
+        scratch.reserve(2 * h_size + v_size, 3);
+    }
+
     /*!
      * \brief Update the given RBM
      */
@@ -911,11 +1315,19 @@ struct base_cd_trainer<N, RBM, Persistent, std::enable_if_t<layer_traits<RBM>::i
         train_convolutional<Persistent, N>(input_batch, expected_batch, context, rbm, *this);
     }
 
+    /*!
+     * \brief Returns the number of bytes of the buffers of the trainer
+     */
+    size_t memory() const {
+        return memory_bytes(w_grad, b_grad, c_grad, micro, slices, w_inc, b_inc, c_inc, q_local_batch, q_local_t, w_bias, b_bias, c_bias, p_h_a, p_h_s, w_pos, w_neg, v1, vf, h1_a, h1_s, v2_a, v2_s, h2_a, h2_s)
+               + scratch.size() * sizeof(weight);
+    }
+
     /*!
      * \brief Return the name of the trainer
      */
     static std::string name() {
-        return std::string("") + (Persistent ? "Persistent " : "") + "Contrastive Divergence (dynamic convolutional)";
+        return std::string("") + (MeanField ? "Mean-Field " : "") + (Persistent ? "Persistent " : "") + "Contrastive Divergence (dynamic convolutional)";
     }
 };
 
@@ -931,6 +1343,24 @@ using cd_trainer = base_cd_trainer<N, RBM, false>;
 template <size_t N, typename RBM, typename Enable = void>
 using persistent_cd_trainer = base_cd_trainer<N, RBM, true>;
 
+/*!
+ * \brief Mean-Field Contrastive Divergence Trainer for RBM.
+ *
+ * The negative phase only samples the first hidden step, the other steps
+ * use the probabilities of the units.
+ */
+template <size_t N, typename RBM>
+using mean_field_cd_trainer = base_cd_trainer<N, RBM, false, true>;
+
+/*!
+ * \brief Mean-Field Persistent Contrastive Divergence Trainer for RBM.
+ *
+ * Only the hidden units of the persistent chain are sampled, the
+ * intermediate steps use the probabilities of the units.
+ */
+template <size_t N, typename RBM>
+using mean_field_persistent_cd_trainer = base_cd_trainer<N, RBM, true, true>;
+
 /*!
  * \brief CD-1 trainer for RBM
  */
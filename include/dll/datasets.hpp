@@ -227,8 +227,33 @@ dataset_holder<TrainG, TestG, ValG> make_dataset_holder(const std::string& name,
     return {name, train_generator, test_generator, val_generator};
 }
 
+/*!
+ * \brief Helper to create a dataset_holder with a validation set taken
+ * from the train set.
+ *
+ * The train and validation generators are views of the given generator,
+ * they share its caches: the samples are read and stored only once.
+ *
+ * \param generator The generator holding the train and validation samples
+ * \param test_generator The test data generator
+ * \param split The number of samples of the train set, the next samples are the validation set
+ *
+ * \return The dataset holder around the three generators
+ */
+template<typename G, typename TestG>
+dataset_holder<G, TestG, G> make_dataset_holder(const std::string& name, std::unique_ptr<G>&& generator, std::unique_ptr<TestG>&& test_generator, size_t split){
+    std::shared_ptr<const G> source(std::move(generator));
+
+    auto train_generator = make_generator_view(source, 0, split);
+    auto val_generator   = make_generator_view(source, split, source->size());
+
+    return {name, train_generator, test_generator, val_generator};
+}
+
 } // end of namespace dll
 
+#include "datasets/snapshot.hpp"
+#include "datasets/mapped.hpp"
 #include "datasets/mnist.hpp"
 #include "datasets/mnist_ae.hpp"
 #include "datasets/cifar.hpp"
@@ -12,40 +12,73 @@
 namespace dll {
 
 /*!
- * \brief Create a data generator around the CIFAR-10 train set
+ * \brief Create a data generator around a shard of the CIFAR-10 train set
  * \param folder The folder in which the CIFAR-10 train files are
  * \param limit The limit size (0 = no limit)
+ * \param s The shard of the train set to keep
  * \param parameters The parameters of the generator
  * \return a unique_ptr around the create generator
  */
 template<typename... Parameters>
-auto make_cifar10_generator_train(const std::string& folder, size_t limit, Parameters&&... /*parameters*/){
+auto make_cifar10_generator_train_shard(const std::string& folder, size_t limit, const shard& s, Parameters&&... /*parameters*/){
     // Create examples for the caches
     etl::fast_dyn_matrix<float, 3, 32, 32> input;
     float label;
 
     size_t n = 50000;
-    size_t m = 0;
 
     if(limit > 0 && limit < n){
         n = limit;
-        m = limit;
+    }
+
+    using desc = dll::inmemory_data_generator_desc<Parameters..., dll::categorical>;
+
+    // Reuse the snapshot of a previous run with the same preprocessing
+    auto snapshot = dataset_snapshot_path<desc, decltype(input)>("cifar10-train", {folder + "/data_batch_1.bin", folder + "/data_batch_2.bin", folder + "/data_batch_3.bin", folder + "/data_batch_4.bin", folder + "/data_batch_5.bin"}, 0, n, s);
+
+    if(!snapshot.empty()){
+        auto generator = prepare_generator(input, label, s.size(n), 10, desc{});
+
+        if(load_dataset_snapshot(*generator, snapshot)){
+            return generator;
+        }
     }
 
     // Prepare the empty generator
-    auto generator = prepare_generator(input, label, n, 10, dll::inmemory_data_generator_desc<Parameters..., dll::categorical>{});
+    auto generator = prepare_generator(input, label, n, 10, desc{});
 
-    generator->label_cache = 0;
+    // Decode all the necessary images (and apply their transformations) and labels
+    if(!read_cifar10_mapped(*generator, {folder + "/data_batch_1.bin", folder + "/data_batch_2.bin", folder + "/data_batch_3.bin", folder + "/data_batch_4.bin", folder + "/data_batch_5.bin"})){
+        std::cerr << "Something went wrong, impossible to load CIFAR-10 training images" << std::endl;
+        return generator;
+    }
 
-    // Read all the necessary images and labels
-    cifar::read_training_categorical(folder, m, generator->input_cache, generator->label_cache);
+    // Only keep the shard of this process
+    if(!s.complete()){
+        generator = select_shard(*generator, s, input, label, 10, desc{});
+    }
 
-    // Apply the transformations on the input
-    generator->finalize_prepared_data();
+    generator->finalize_decoded_data();
+
+    if(!snapshot.empty()){
+        save_dataset_snapshot(*generator, snapshot);
+    }
 
     return generator;
 }
 
+/*!
+ * \brief Create a data generator around the CIFAR-10 train set
+ * \param folder The folder in which the CIFAR-10 train files are
+ * \param limit The limit size (0 = no limit)
+ * \param parameters The parameters of the generator
+ * \return a unique_ptr around the create generator
+ */
+template<typename... Parameters>
+auto make_cifar10_generator_train(const std::string& folder, size_t limit, Parameters&&... parameters){
+    return make_cifar10_generator_train_shard(folder, limit, shard(), std::forward<Parameters>(parameters)...);
+}
+
 /*!
  * \brief Create a data generator around the CIFAR-10 test set
  * \param folder The folder in which the CIFAR-10 test files are
@@ -60,23 +93,38 @@ auto make_cifar10_generator_test(const std::string& folder, size_t limit, Parame
     float label;
 
     size_t n = 10000;
-    size_t m = 0;
 
     if(limit > 0 && limit < n){
         n = limit;
-        m = limit;
+    }
+
+    using desc = dll::inmemory_data_generator_desc<Parameters..., dll::categorical>;
+
+    // Reuse the snapshot of a previous run with the same preprocessing
+    auto snapshot = dataset_snapshot_path<desc, decltype(input)>("cifar10-test", {folder + "/test_batch.bin"}, 0, n, shard());
+
+    if(!snapshot.empty()){
+        auto generator = prepare_generator(input, label, n, 10, desc{});
+
+        if(load_dataset_snapshot(*generator, snapshot)){
+            return generator;
+        }
     }
 
     // Prepare the empty generator
-    auto generator = prepare_generator(input, label, n, 10, dll::inmemory_data_generator_desc<Parameters..., dll::categorical>{});
+    auto generator = prepare_generator(input, label, n, 10, desc{});
 
-    generator->label_cache = 0;
+    // Decode all the necessary images (and apply their transformations) and labels
+    if(!read_cifar10_mapped(*generator, {folder + "/test_batch.bin"})){
+        std::cerr << "Something went wrong, impossible to load CIFAR-10 test images" << std::endl;
+        return generator;
+    }
 
-    // Read all the necessary images and labels
-    cifar::read_test_categorical(folder, m, generator->input_cache, generator->label_cache);
+    generator->finalize_decoded_data();
 
-    // Apply the transformations on the input
-    generator->finalize_prepared_data();
+    if(!snapshot.empty()){
+        save_dataset_snapshot(*generator, snapshot);
+    }
 
     return generator;
 }
@@ -171,4 +219,72 @@ auto make_cifar10_dataset_sub(size_t limit, Parameters&&... parameters){
         make_cifar10_generator_test(0, std::forward<Parameters>(parameters)...));
 }
 
+/*!
+ * \brief Creates a dataset around CIFAR-10 with a validation set
+ *
+ * The validation set is extracted from the end of the train set, the
+ * train and validation generators are views of a single read of the train
+ * set.
+ *
+ * \param folder The folder in which the CIFAR-10 files are
+ * \param split The number of samples of the train set, the next samples are the validation set
+ * \param parameters The parameters of the generator
+ * \return The CIFAR-10 dataset
+ */
+template<typename... Parameters>
+auto make_cifar10_dataset_val(const std::string& folder, size_t split, Parameters&&... parameters){
+    return make_dataset_holder(
+        "cifar",
+        make_cifar10_generator_train(folder, 0, std::forward<Parameters>(parameters)...),
+        make_cifar10_generator_test(folder, 0, std::forward<Parameters>(parameters)...),
+        split);
+}
+
+/*!
+ * \brief Creates a dataset around CIFAR-10 with a validation set
+ *
+ * The CIFAR-10 train files are assumed to be in a cifar-10/cifar-10-batches-bin sub folder.
+ *
+ * \param split The number of samples of the train set, the next samples are the validation set
+ * \param parameters The parameters of the generator
+ * \return The CIFAR-10 dataset
+ */
+template<typename... Parameters>
+auto make_cifar10_dataset_val(size_t split, Parameters&&... parameters){
+    return make_cifar10_dataset_val("cifar-10/cifar-10-batches-bin", split, std::forward<Parameters>(parameters)...);
+}
+
+/*!
+ * \brief Creates a dataset around CIFAR-10, with only a shard of the train set
+ *
+ * The shards are computed from the DLL random seed, all the processes
+ * must use the same seed.
+ *
+ * \param folder The folder in which the CIFAR-10 files are
+ * \param s The shard of the train set to keep
+ * \param parameters The parameters of the generator
+ * \return The CIFAR-10 dataset
+ */
+template<typename... Parameters>
+auto make_cifar10_dataset_shard(const std::string& folder, const shard& s, Parameters&&... parameters){
+    return make_dataset_holder(
+        "cifar",
+        make_cifar10_generator_train_shard(folder, 0, s, std::forward<Parameters>(parameters)...),
+        make_cifar10_generator_test(folder, 0, std::forward<Parameters>(parameters)...));
+}
+
+/*!
+ * \brief Creates a dataset around CIFAR-10, with only a shard of the train set
+ *
+ * The CIFAR-10 train files are assumed to be in a cifar-10/cifar-10-batches-bin sub folder.
+ *
+ * \param s The shard of the train set to keep
+ * \param parameters The parameters of the generator
+ * \return The CIFAR-10 dataset
+ */
+template<typename... Parameters>
+auto make_cifar10_dataset_shard(const shard& s, Parameters&&... parameters){
+    return make_cifar10_dataset_shard("cifar-10/cifar-10-batches-bin", s, std::forward<Parameters>(parameters)...);
+}
+
 } // end of namespace dll
@@ -8,11 +8,23 @@
 #pragma once
 
 #include <vector>
+#include <deque>
 #include <unordered_map>
 #include <utility>
 #include <string>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <cstdio>
+#include <cstdint>
+#include <fstream>
+#include <condition_variable>
 
 #include <dirent.h>
+#include <sys/stat.h>
+
+#include "cpp_utils/io.hpp"
 
 // Only for image loading...
 #include <opencv2/highgui/highgui.hpp>
@@ -21,61 +33,588 @@ namespace dll {
 
 namespace imagenet {
 
-inline void read_files(std::vector<std::pair<size_t, size_t>>& files, std::unordered_map<size_t, float>& label_map, const std::string& file_path){
-    files.reserve(1200000);
+/*!
+ * \brief The modification time of a file or a directory
+ */
+struct file_time {
+    int64_t sec  = 0; ///< The seconds
+    int64_t nsec = 0; ///< The nanoseconds
+
+    /*!
+     * \brief Indicates if the two times are the same
+     */
+    bool operator==(const file_time& rhs) const {
+        return sec == rhs.sec && nsec == rhs.nsec;
+    }
+
+    /*!
+     * \brief Indicates if the two times are different
+     */
+    bool operator!=(const file_time& rhs) const {
+        return !(*this == rhs);
+    }
+};
+
+/*!
+ * \brief The image files of one class of the dataset
+ */
+struct class_files {
+    std::string name;           ///< The name of the directory of the class
+    size_t label = 0;           ///< The label (synset number) of the class
+    file_time time;             ///< The modification time of the directory when it was scanned
+    std::vector<size_t> images; ///< The numbers of the images of the class
+};
+
+/*!
+ * \brief Get the modification time of the given path
+ * \return true if the path exists, false otherwise
+ */
+inline bool modification_time(const std::string& path, file_time& time) {
+    struct stat st;
+
+    if (::stat(path.c_str(), &st) != 0) {
+        return false;
+    }
+
+    time.sec  = st.st_mtim.tv_sec;
+    time.nsec = st.st_mtim.tv_nsec;
+
+    return true;
+}
+
+/*!
+ * \brief List the entries of the given directory starting with a 'n' (the
+ * synsets and their images)
+ * \return true if the directory was read, false otherwise
+ */
+inline bool list_entries(const std::string& path, std::vector<std::string>& entries) {
+    auto dir = opendir(path.c_str());
+
+    if (!dir) {
+        return false;
+    }
 
     struct dirent* entry;
-    auto dir = opendir(file_path.c_str());
 
     while ((entry = readdir(dir))) {
-        std::string file_name(entry->d_name);
+        if (entry->d_name[0] == 'n') {
+            entries.emplace_back(entry->d_name);
+        }
+    }
+
+    closedir(dir);
+
+    return true;
+}
+
+/*!
+ * \brief Scan the directory of the given class
+ * \param file_path The path to the directories of the classes
+ * \param c The class to scan
+ */
+inline void scan_class(const std::string& file_path, class_files& c) {
+    const auto path = file_path + "/" + c.name;
+
+    // The time is taken first, a change during the scan invalidates the index
+    modification_time(path, c.time);
+
+    std::vector<std::string> names;
+
+    if (!list_entries(path, names)) {
+        std::cerr << "ERROR: Failed to read the directory " << path << std::endl;
+    }
+
+    c.images.clear();
+    c.images.reserve(names.size());
+
+    for (auto& image_name : names) {
+        std::string image_number(image_name.begin() + image_name.find('_') + 1, image_name.end() - 5);
+        c.images.push_back(std::atoi(image_number.c_str()));
+    }
+}
+
+constexpr uint32_t index_magic   = 0x444C4C49; ///< The magic number of the index files
+constexpr uint32_t index_version = 1;          ///< The version of the index files
+
+/*!
+ * \brief Read the index of the classes from the given file
+ * \param path The path to the index
+ * \param root The modification time of the directory of the classes when it was indexed
+ * \param classes The indexed classes
+ * \return true if the index was read, false otherwise
+ */
+inline bool read_index(const std::string& path, file_time& root, std::vector<class_files>& classes) {
+    std::ifstream is(path, std::ios::binary);
+
+    if (!is) {
+        return false;
+    }
+
+    uint32_t magic   = 0;
+    uint32_t version = 0;
+    uint64_t n       = 0;
+
+    cpp::binary_load(is, magic);
+    cpp::binary_load(is, version);
+
+    if (!is || magic != index_magic || version != index_version) {
+        return false;
+    }
+
+    cpp::binary_load(is, root.sec);
+    cpp::binary_load(is, root.nsec);
+    cpp::binary_load(is, n);
+
+    classes.resize(n);
+
+    for (auto& c : classes) {
+        uint64_t length = 0;
+        uint64_t label  = 0;
+        uint64_t images = 0;
+
+        cpp::binary_load(is, length);
+
+        if (!is || length > 256) {
+            return false;
+        }
+
+        c.name.resize(length);
+        is.read(&c.name[0], length);
+
+        cpp::binary_load(is, label);
+        cpp::binary_load(is, c.time.sec);
+        cpp::binary_load(is, c.time.nsec);
+        cpp::binary_load(is, images);
+
+        if (!is || images > 100000000) {
+            return false;
+        }
+
+        c.label = label;
+        c.images.resize(images);
+
+        for (auto& image : c.images) {
+            uint64_t number = 0;
+            cpp::binary_load(is, number);
+            image = number;
+        }
+    }
+
+    return bool(is);
+}
+
+/*!
+ * \brief Write the index of the classes to the given file.
+ *
+ * The index is written next to the file and then renamed, so that a
+ * concurrent reader never sees a partial index.
+ *
+ * \param path The path to the index
+ * \param root The modification time of the directory of the classes
+ * \param classes The classes
+ * \return true if the index was written, false otherwise
+ */
+inline bool write_index(const std::string& path, const file_time& root, const std::vector<class_files>& classes) {
+    const auto temp = path + ".tmp";
+
+    {
+        std::ofstream os(temp, std::ios::binary);
+
+        if (!os) {
+            return false;
+        }
+
+        cpp::binary_write(os, index_magic);
+        cpp::binary_write(os, index_version);
+        cpp::binary_write(os, root.sec);
+        cpp::binary_write(os, root.nsec);
+        cpp::binary_write(os, uint64_t(classes.size()));
+
+        for (auto& c : classes) {
+            cpp::binary_write(os, uint64_t(c.name.size()));
+            os.write(c.name.data(), c.name.size());
+
+            cpp::binary_write(os, uint64_t(c.label));
+            cpp::binary_write(os, c.time.sec);
+            cpp::binary_write(os, c.time.nsec);
+            cpp::binary_write(os, uint64_t(c.images.size()));
+
+            for (auto image : c.images) {
+                cpp::binary_write(os, uint64_t(image));
+            }
+        }
+
+        if (!os) {
+            return false;
+        }
+    }
+
+    return std::rename(temp.c_str(), path.c_str()) == 0;
+}
+
+/*!
+ * \brief Read the list of the image files of the dataset and the map of
+ * the labels.
+ *
+ * The list is kept in an index file. The index is used as long as the
+ * modification times of the directories did not change. Only the classes
+ * whose directory changed are scanned again, all the classes are scanned
+ * if a class was added or removed. The scans are done in parallel, since
+ * they are mostly waiting on the file system.
+ *
+ * \param files The image files, as (label, image) pairs
+ * \param label_map The index of each label
+ * \param file_path The path to the directories of the classes
+ * \param index_path The path to the index file (no index if empty)
+ */
+inline void read_files(std::vector<std::pair<size_t, size_t>>& files, std::unordered_map<size_t, float>& label_map, const std::string& file_path, const std::string& index_path){
+    file_time root;
+
+    if (!modification_time(file_path, root)) {
+        std::cerr << "ERROR: Failed to read the directory " << file_path << std::endl;
+        return;
+    }
+
+    std::vector<class_files> classes;
+    std::vector<size_t> stale;
+
+    file_time indexed_root;
+
+    if (!index_path.empty() && read_index(index_path, indexed_root, classes) && indexed_root == root) {
+        for (size_t c = 0; c < classes.size(); ++c) {
+            file_time time;
+
+            if (!modification_time(file_path + "/" + classes[c].name, time) || time != classes[c].time) {
+                stale.push_back(c);
+            }
+        }
+    } else {
+        std::vector<std::string> names;
+        list_entries(file_path, names);
+
+        classes.clear();
+        classes.resize(names.size());
+
+        for (size_t c = 0; c < names.size(); ++c) {
+            classes[c].name  = names[c];
+            classes[c].label = std::atoi(names[c].c_str() + 1);
+
+            stale.push_back(c);
+        }
+    }
+
+    if (!stale.empty()) {
+        const size_t threads = std::min(stale.size(), size_t(4) * std::max(size_t(1), size_t(std::thread::hardware_concurrency())));
+
+        std::atomic<size_t> next(0);
+
+        auto worker = [&]() {
+            size_t s;
+            while ((s = next++) < stale.size()) {
+                scan_class(file_path, classes[stale[s]]);
+            }
+        };
+
+        std::vector<std::thread> pool;
 
-        if (file_name.find("n") != 0) {
-            continue;
+        for (size_t t = 1; t < threads; ++t) {
+            pool.emplace_back(worker);
         }
 
-        std::string label_name(file_name.begin() + 1, file_name.end());
-        size_t label = std::atoi(label_name.c_str());
+        worker();
+
+        for (auto& thread : pool) {
+            thread.join();
+        }
+
+        if (!index_path.empty() && !write_index(index_path, root, classes)) {
+            std::cerr << "WARNING: Failed to write the index " << index_path << std::endl;
+        }
+    }
 
+    size_t total = 0;
+
+    for (auto& c : classes) {
+        total += c.images.size();
+    }
+
+    files.reserve(files.size() + total);
+
+    for (auto& c : classes) {
         auto l = label_map.size();
-        label_map[label] = l;
+        label_map[c.label] = l;
+
+        for (auto image : c.images) {
+            files.emplace_back(c.label, image);
+        }
+    }
+}
+
+/*!
+ * \brief Read the list of the image files of the dataset and the map of
+ * the labels, with the index next to the directory of the classes
+ * \param files The image files, as (label, image) pairs
+ * \param label_map The index of each label
+ * \param file_path The path to the directories of the classes
+ */
+inline void read_files(std::vector<std::pair<size_t, size_t>>& files, std::unordered_map<size_t, float>& label_map, const std::string& file_path){
+    read_files(files, label_map, file_path, file_path + ".index");
+}
+
+/*!
+ * \brief The type of a decoded ImageNet image
+ */
+using image_type = etl::fast_dyn_matrix<float, 3, 256, 256>;
+
+/*!
+ * \brief Returns the path to the given image
+ * \param imagenet_path The path to the ImageNet dataset
+ * \param image_file The (label, image) pair identifying the image
+ * \return The path to the JPEG file
+ */
+inline std::string image_path(const std::string& imagenet_path, const std::pair<size_t, size_t>& image_file){
+    auto label = std::string("/n") + (image_file.first < 10000000 ? "0" : "") + std::to_string(image_file.first);
 
-        struct dirent* sub_entry;
-        auto sub_dir = opendir((file_path + "/" + file_name).c_str());
+    return std::string(imagenet_path) + "/train" + label + label + "_" + std::to_string(image_file.second) + ".JPEG";
+}
+
+/*!
+ * \brief Decode the given image into CHW layout
+ *
+ * The image is converted row by row, each row of interleaved pixels
+ * being split into the three planes of the output.
+ *
+ * \param image The output image
+ * \param path The path to the JPEG file
+ */
+inline void decode_image(image_type& image, const std::string& path){
+    auto mat = cv::imread(path.c_str(), cv::IMREAD_ANYCOLOR | cv::IMREAD_ANYDEPTH);
 
-        while ((sub_entry = readdir(sub_dir))) {
-            std::string image_name(sub_entry->d_name);
+    if (!mat.data || mat.empty()) {
+        std::cerr << "ERROR: Failed to read image: " << path << std::endl;
+        image = 0;
+        return;
+    }
+
+    if (mat.cols != 256 || mat.rows != 256) {
+        std::cerr << "ERROR: Image of invalid size: " << path << std::endl;
+        image = 0;
+        return;
+    }
 
-            if (image_name.find("n") != 0){
-                continue;
+    float* c0 = image.memory_start();
+    float* c1 = c0 + 256 * 256;
+    float* c2 = c1 + 256 * 256;
+
+    if (cpp_likely(mat.channels() == 3)) {
+        for (size_t y = 0; y < 256; ++y) {
+            const unsigned char* row = mat.ptr<unsigned char>(y);
+
+            float* r0 = c0 + y * 256;
+            float* r1 = c1 + y * 256;
+            float* r2 = c2 + y * 256;
+
+            for (size_t x = 0; x < 256; ++x) {
+                r0[x] = row[3 * x + 0];
+                r1[x] = row[3 * x + 1];
+                r2[x] = row[3 * x + 2];
             }
+        }
+    } else {
+        for (size_t y = 0; y < 256; ++y) {
+            const unsigned char* row = mat.ptr<unsigned char>(y);
 
-            std::string image_number(image_name.begin() + image_name.find('_') + 1, image_name.end() - 5);
-            size_t image = std::atoi(image_number.c_str());
+            float* r0 = c0 + y * 256;
 
-            files.emplace_back(label, image);
+            for (size_t x = 0; x < 256; ++x) {
+                r0[x] = row[x];
+            }
         }
+
+        image(1) = 0;
+        image(2) = 0;
     }
 }
 
+/*!
+ * \brief A pool of threads decoding images ahead of their use.
+ *
+ * When an image is requested, the following images are queued for
+ * decoding as well, so that the consumer does not wait on the disk or
+ * on the decoder.
+ */
+struct image_prefetcher {
+    /*!
+     * \brief A decoded (or being decoded) image
+     */
+    struct slot {
+        bool ready     = false;            ///< Indicates if the image is decoded
+        bool requested = false;            ///< Indicates if the consumer is waiting for the image
+        std::unique_ptr<image_type> image; ///< The decoded image
+    };
+
+    std::string imagenet_path;                                     ///< The path to the dataset
+    std::shared_ptr<std::vector<std::pair<size_t, size_t>>> files; ///< The image files
+
+    size_t ahead; ///< The number of images to decode ahead
+
+    std::unordered_map<size_t, slot> slots; ///< The images currently prefetched
+    std::deque<size_t> queue;               ///< The images waiting to be decoded
+
+    bool stop_flag = false; ///< Indicates that the threads must stop
+
+    std::mutex lock;                         ///< The main lock
+    std::condition_variable work_condition;  ///< The condition variable for the threads to wait for work
+    std::condition_variable ready_condition; ///< The condition variable for the consumer to wait for an image
+
+    std::vector<std::thread> threads; ///< The decoding threads
+
+    /*!
+     * \brief Construct a new prefetcher and start its threads
+     * \param imagenet_path The path to the dataset
+     * \param files The image files
+     * \param ahead The number of images to decode ahead
+     * \param n_threads The number of decoding threads
+     */
+    image_prefetcher(const std::string& imagenet_path, std::shared_ptr<std::vector<std::pair<size_t, size_t>>> files, size_t ahead, size_t n_threads)
+            : imagenet_path(imagenet_path), files(files), ahead(ahead) {
+        for (size_t t = 0; t < n_threads; ++t) {
+            threads.emplace_back([this] { thread_main(); });
+        }
+    }
+
+    image_prefetcher(const image_prefetcher& rhs) = delete;
+    image_prefetcher& operator=(const image_prefetcher& rhs) = delete;
+
+    /*!
+     * \brief Stop and join the decoding threads
+     */
+    ~image_prefetcher() {
+        cpp::with_lock(lock, [this] { stop_flag = true; });
+
+        work_condition.notify_all();
+
+        for (auto& thread : threads) {
+            thread.join();
+        }
+    }
+
+    /*!
+     * \brief Returns the given image, waiting for it to be decoded if necessary
+     * \param index The index of the image
+     * \return The decoded image
+     */
+    image_type get(size_t index) {
+        std::unique_lock<std::mutex> ulock(lock);
+
+        // The requested image goes first in the queue
+        if (!slots.count(index)) {
+            slots[index];
+            queue.push_front(index);
+        }
+
+        slots[index].requested = true;
+
+        evict(index);
+
+        for (size_t i = index + 1; i < std::min(index + 1 + ahead, files->size()); ++i) {
+            if (!slots.count(i)) {
+                slots[i];
+                queue.push_back(i);
+            }
+        }
+
+        work_condition.notify_all();
+
+        ready_condition.wait(ulock, [this, index] { return slots[index].ready; });
+
+        auto image = std::move(slots[index].image);
+
+        slots.erase(index);
+
+        ulock.unlock();
+
+        return *image;
+    }
+
+private:
+    /*!
+     * \brief Remove the decoded images that are not going to be used.
+     *
+     * This only happens when the consumer moves backward, for instance
+     * when the generator is reset in the middle of an epoch.
+     *
+     * \param index The index of the requested image
+     */
+    void evict(size_t index) {
+        if (slots.size() <= 2 * ahead + 1) {
+            return;
+        }
+
+        for (auto it = slots.begin(); it != slots.end();) {
+            if (it->second.ready && !it->second.requested && (it->first < index || it->first > index + ahead)) {
+                it = slots.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+
+    /*!
+     * \brief The main function of a decoding thread
+     */
+    void thread_main() {
+        while (true) {
+            std::unique_lock<std::mutex> ulock(lock);
+
+            work_condition.wait(ulock, [this] { return stop_flag || !queue.empty(); });
+
+            if (stop_flag) {
+                return;
+            }
+
+            auto index = queue.front();
+            queue.pop_front();
+
+            ulock.unlock();
+
+            auto image = std::make_unique<image_type>();
+            decode_image(*image, image_path(imagenet_path, (*files)[index]));
+
+            ulock.lock();
+
+            auto it = slots.find(index);
+
+            // The slot may have been evicted in the meantime
+            if (it != slots.end()) {
+                it->second.image = std::move(image);
+                it->second.ready = true;
+
+                ready_condition.notify_all();
+            }
+        }
+    }
+};
+
 struct image_iterator : std::iterator<
                                      std::input_iterator_tag,
-                                     etl::fast_dyn_matrix<float, 3, 256, 256>,
+                                     image_type,
                                      ptrdiff_t,
-                                     etl::fast_dyn_matrix<float, 3, 256, 256>*,
-                                     etl::fast_dyn_matrix<float, 3, 256, 256>&
+                                     image_type*,
+                                     image_type&
                                  > {
 
-    using value_type = etl::fast_dyn_matrix<float, 3, 256, 256>;
+    using value_type = image_type;
 
     std::string imagenet_path;
     std::shared_ptr<std::vector<std::pair<size_t, size_t>>> files;
     std::shared_ptr<std::unordered_map<size_t, float>> labels;
+    std::shared_ptr<image_prefetcher> prefetcher;
 
     size_t index;
 
-    image_iterator(const std::string& imagenet_path, std::shared_ptr<std::vector<std::pair<size_t, size_t>>> files, std::shared_ptr<std::unordered_map<size_t, float>> labels, size_t index) :
-        imagenet_path(imagenet_path), files(files), labels(labels), index(index)
+    image_iterator(const std::string& imagenet_path, std::shared_ptr<std::vector<std::pair<size_t, size_t>>> files, std::shared_ptr<std::unordered_map<size_t, float>> labels, size_t index, std::shared_ptr<image_prefetcher> prefetcher = nullptr) :
+        imagenet_path(imagenet_path), files(files), labels(labels), prefetcher(prefetcher), index(index)
     {
         // Nothing else to init
     }
@@ -100,50 +639,13 @@ struct image_iterator : std::iterator<
     }
 
     value_type operator*() {
-        auto& image_file = (*files)[index];
-
-        auto label = std::string("/n") + (image_file.first < 10000000 ? "0" : "") + std::to_string(image_file.first);
-
-        auto image_path =
-            std::string(imagenet_path) + "/train" + label + label +
-            "_" + std::to_string(image_file.second) + ".JPEG";
-
-        auto mat = cv::imread(image_path.c_str(), cv::IMREAD_ANYCOLOR | cv::IMREAD_ANYDEPTH);
-
-        value_type image;
-
-        if (!mat.data || mat.empty()) {
-            std::cerr << "ERROR: Failed to read image: " << image_path << std::endl;
-            image = 0;
-            return image;
-        }
-
-        if (mat.cols != 256 || mat.rows != 256) {
-            std::cerr << "ERROR: Image of invalid size: " << image_path << std::endl;
-            image = 0;
-            return image;
+        if (prefetcher) {
+            return prefetcher->get(index);
         }
 
-        if (cpp_likely(mat.channels() == 3)) {
-            for (size_t x = 0; x < 256; ++x) {
-                for (size_t y = 0; y < 256; ++y) {
-                    auto pixel = mat.at<cv::Vec3b>(y, x);
-
-                    image(0, x, y) = pixel.val[0];
-                    image(1, x, y) = pixel.val[1];
-                    image(2, x, y) = pixel.val[2];
-                }
-            }
-        } else {
-            for (size_t x = 0; x < 256; ++x) {
-                for (size_t y = 0; y < 256; ++y) {
-                    image(0, x, y) = mat.at<unsigned char>(y, x);
-                }
-            }
+        value_type image;
 
-            image(1) = 0;
-            image(2) = 0;
-        }
+        decode_image(image, image_path(imagenet_path, (*files)[index]));
 
         return image;
     }
@@ -226,9 +728,15 @@ auto make_imagenet_dataset(const std::string& folder, Parameters&&... /*paramete
     std::default_random_engine engine(rd());
     std::shuffle(train_files->begin(), train_files->end(), engine);
 
+    using desc = dll::outmemory_data_generator_desc<Parameters..., dll::categorical>;
+
+    // Decode the images ahead of the generators, on all the cores
+    auto prefetcher = std::make_shared<imagenet::image_prefetcher>(
+        folder, train_files, desc::BatchSize * desc::BigBatchSize, std::max(std::thread::hardware_concurrency(), 1u));
+
     // The image iterators
-    imagenet::image_iterator iit(folder, train_files, labels, 0);
-    imagenet::image_iterator iend(folder, train_files, labels, train_files->size());
+    imagenet::image_iterator iit(folder, train_files, labels, 0, prefetcher);
+    imagenet::image_iterator iend(folder, train_files, labels, train_files->size(), prefetcher);
 
     // The label iterators
     imagenet::label_iterator lit(train_files, labels, 0);
@@ -236,8 +744,8 @@ auto make_imagenet_dataset(const std::string& folder, Parameters&&... /*paramete
 
     return make_dataset_holder(
         "imagenet",
-        make_generator(iit, iend, lit, lend, train_files->size(), 1000, dll::outmemory_data_generator_desc<Parameters..., dll::categorical>{}),
-        make_generator(iit, iend, lit, lend, train_files->size(), 1000, dll::outmemory_data_generator_desc<Parameters..., dll::categorical>{}));
+        make_generator(iit, iend, lit, lend, train_files->size(), 1000, desc{}),
+        make_generator(iit, iend, lit, lend, train_files->size(), 1000, desc{}));
 }
 
 } // end of namespace dll
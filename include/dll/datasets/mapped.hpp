@@ -0,0 +1,301 @@
+//=======================================================================
+// Copyright (c) 2014-2017 Baptiste Wicht
+// Distributed under the terms of the MIT License.
+// (See accompanying file LICENSE or copy at
+//  http://opensource.org/licenses/MIT)
+//=======================================================================
+
+/*!
+ * \file
+ * \brief Readers of the MNIST and CIFAR-10 binary files through memory
+ * mappings.
+ *
+ * The files are mapped in memory and the samples are decoded in parallel
+ * chunks directly into the cache of an in memory generator, the scaling,
+ * normalization and binarization of the inputs being applied on the fly
+ * (see inmemory_data_generator::decode_data).
+ */
+
+#pragma once
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "etl/etl.hpp"
+
+namespace dll {
+
+/*!
+ * \brief A read-only memory mapping of a complete file
+ */
+struct mapped_file {
+    /*!
+     * \brief Map the given file in memory
+     * \param path The path to the file
+     */
+    explicit mapped_file(const std::string& path) {
+        fd = ::open(path.c_str(), O_RDONLY);
+
+        if (fd < 0) {
+            return;
+        }
+
+        struct stat st;
+
+        if (::fstat(fd, &st) < 0 || st.st_size == 0) {
+            return;
+        }
+
+        length  = st.st_size;
+        mapping = ::mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+
+        if (mapping == MAP_FAILED) {
+            mapping = nullptr;
+            return;
+        }
+
+        ::madvise(mapping, length, MADV_SEQUENTIAL);
+    }
+
+    mapped_file(const mapped_file& rhs) = delete;
+    mapped_file& operator=(const mapped_file& rhs) = delete;
+
+    /*!
+     * \brief Unmap the file
+     */
+    ~mapped_file() {
+        if (mapping) {
+            ::munmap(mapping, length);
+        }
+
+        if (fd >= 0) {
+            ::close(fd);
+        }
+    }
+
+    /*!
+     * \brief Indicates if the file is mapped
+     */
+    explicit operator bool() const noexcept {
+        return mapping;
+    }
+
+    /*!
+     * \brief Returns the bytes of the file
+     */
+    const uint8_t* data() const noexcept {
+        return static_cast<const uint8_t*>(mapping);
+    }
+
+    /*!
+     * \brief Returns the number of bytes of the file
+     */
+    size_t size() const noexcept {
+        return length;
+    }
+
+private:
+    int fd        = -1;      ///< The file descriptor
+    void* mapping = nullptr; ///< The start of the mapping
+    size_t length = 0;       ///< The length of the mapping
+};
+
+namespace mapped_detail {
+
+constexpr size_t chunk_size = 1024; ///< The number of samples decoded by a thread at once
+
+/*!
+ * \brief Read a big-endian 32 bits integer
+ */
+inline uint32_t read_be32(const uint8_t* p) {
+    return (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | uint32_t(p[3]);
+}
+
+/*!
+ * \brief Call the functor on chunks of the n samples, in parallel
+ * \param n The number of samples
+ * \param func The functor, called with the first sample and the size of a chunk
+ */
+template <typename Functor>
+void parallel_chunks(size_t n, Functor&& func) {
+    const size_t chunks  = (n + chunk_size - 1) / chunk_size;
+    const size_t threads = std::max(size_t(1), std::min(chunks, size_t(std::thread::hardware_concurrency())));
+
+    std::atomic<size_t> next(0);
+
+    auto worker = [&]() {
+        size_t c;
+        while ((c = next++) < chunks) {
+            func(c * chunk_size, std::min(chunk_size, n - c * chunk_size));
+        }
+    };
+
+    std::vector<std::thread> pool;
+
+    for (size_t t = 1; t < threads; ++t) {
+        pool.emplace_back(worker);
+    }
+
+    worker();
+
+    for (auto& thread : pool) {
+        thread.join();
+    }
+}
+
+/*!
+ * \brief Set the label of the ith sample of the given label cache, the
+ * cache being categorical (zeroed beforehand) or compact
+ */
+template <typename Cache>
+void set_label(Cache& cache, size_t i, size_t label) {
+    if constexpr (etl::dimensions<Cache>() == 1) {
+        cache.memory_start()[i] = etl::value_t<Cache>(label);
+    } else {
+        cache.memory_start()[i * etl::dim<1>(cache) + label] = etl::value_t<Cache>(1);
+    }
+}
+
+} //end of namespace mapped_detail
+
+/*!
+ * \brief Decode the images of a MNIST idx file into the input cache of
+ * the given generator, starting at the given image.
+ *
+ * As many images as the cache can hold are decoded.
+ *
+ * \param generator The in memory generator
+ * \param path The path to the idx images file
+ * \param start The index of the first image to decode
+ *
+ * \return true if the images were decoded, false otherwise
+ */
+template <typename Generator>
+bool read_mnist_images_mapped(Generator& generator, const std::string& path, size_t start) {
+    mapped_file file(path);
+
+    constexpr size_t header = 16;
+
+    if (!file || file.size() < header || mapped_detail::read_be32(file.data()) != 0x803) {
+        return false;
+    }
+
+    const size_t count  = mapped_detail::read_be32(file.data() + 4);
+    const size_t stride = mapped_detail::read_be32(file.data() + 8) * mapped_detail::read_be32(file.data() + 12);
+    const size_t n      = etl::dim<0>(generator.input_cache);
+
+    if (stride != etl::size(generator.input_cache) / std::max(n, size_t(1)) || start + n > count || file.size() < header + (start + n) * stride) {
+        return false;
+    }
+
+    const uint8_t* images = file.data() + header + start * stride;
+
+    mapped_detail::parallel_chunks(n, [&](size_t first, size_t size) {
+        generator.decode_data(first, images + first * stride, size, stride);
+    });
+
+    return true;
+}
+
+/*!
+ * \brief Read the labels of a MNIST idx file into the label cache of the
+ * given generator, starting at the given label.
+ *
+ * \param generator The in memory generator
+ * \param path The path to the idx labels file
+ * \param start The index of the first label to read
+ *
+ * \return true if the labels were read, false otherwise
+ */
+template <typename Generator>
+bool read_mnist_labels_mapped(Generator& generator, const std::string& path, size_t start) {
+    mapped_file file(path);
+
+    constexpr size_t header = 8;
+
+    const size_t n = etl::dim<0>(generator.label_cache);
+
+    if (!file || file.size() < header || mapped_detail::read_be32(file.data()) != 0x801 || start + n > mapped_detail::read_be32(file.data() + 4) || file.size() < header + start + n) {
+        return false;
+    }
+
+    generator.label_cache = 0;
+
+    const uint8_t* labels = file.data() + header + start;
+
+    for (size_t i = 0; i < n; ++i) {
+        mapped_detail::set_label(generator.label_cache, i, labels[i]);
+    }
+
+    return true;
+}
+
+/*!
+ * \brief Decode the records of CIFAR-10 binary files into the caches of
+ * the given generator.
+ *
+ * The files are read in order until the caches are full.
+ *
+ * \param generator The in memory generator
+ * \param files The paths to the CIFAR-10 binary files
+ *
+ * \return true if the caches were filled, false otherwise
+ */
+template <typename Generator>
+bool read_cifar10_mapped(Generator& generator, const std::vector<std::string>& files) {
+    // A record is made of the label and of the image
+    constexpr size_t stride = 3 * 32 * 32;
+    constexpr size_t record = stride + 1;
+
+    const size_t n = etl::dim<0>(generator.input_cache);
+
+    if (etl::size(generator.input_cache) != n * stride) {
+        return false;
+    }
+
+    generator.label_cache = 0;
+
+    size_t i = 0;
+
+    for (auto& path : files) {
+        if (i == n) {
+            break;
+        }
+
+        mapped_file file(path);
+
+        if (!file || file.size() % record) {
+            return false;
+        }
+
+        const size_t records = std::min(file.size() / record, n - i);
+        const uint8_t* data  = file.data();
+
+        mapped_detail::parallel_chunks(records, [&](size_t first, size_t size) {
+            generator.decode_data(i + first, data + first * record + 1, size, record);
+
+            for (size_t r = first; r < first + size; ++r) {
+                mapped_detail::set_label(generator.label_cache, i + r, data[r * record]);
+            }
+        });
+
+        i += records;
+    }
+
+    if (i < n) {
+        return false;
+    }
+
+    return true;
+}
+
+} //end of dll namespace
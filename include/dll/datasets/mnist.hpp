@@ -15,48 +15,79 @@ using mnist_example_t = etl::fast_dyn_matrix<float, 1, 28, 28>;
 using mnist_example_nc_t = etl::fast_dyn_matrix<float, 28, 28>;
 
 /*!
- * \brief Create a data generator around the MNIST train set
+ * \brief Create a data generator around a shard of the MNIST train set
  * \param folder The folder in which the MNIST train files are
  * \param limit The limit size (0 = no limit)
+ * \param s The shard of the train set to keep
  * \param parameters The parameters of the generator
  * \return a unique_ptr around the create generator
  */
 template<typename Example, typename... Parameters>
-auto make_mnist_generator_train_impl(const std::string& folder, size_t start, size_t limit, Parameters&&... /*parameters*/){
+auto make_mnist_generator_train_shard_impl(const std::string& folder, size_t start, size_t limit, const shard& s, Parameters&&... /*parameters*/){
     // Create examples for the caches
     Example input;
     float label;
 
     size_t n = 60000 - start;
-    size_t m = 0;
 
     if(limit > 0 && limit < n){
         n = limit;
-        m = limit;
+    }
+
+    using desc = dll::inmemory_data_generator_desc<Parameters..., dll::categorical>;
+
+    // Reuse the snapshot of a previous run with the same preprocessing
+    auto snapshot = dataset_snapshot_path<desc, Example>("mnist-train", {folder + "/train-images-idx3-ubyte", folder + "/train-labels-idx1-ubyte"}, start, n, s);
+
+    if(!snapshot.empty()){
+        auto generator = prepare_generator(input, label, s.size(n), 10, desc{});
+
+        if(load_dataset_snapshot(*generator, snapshot)){
+            return generator;
+        }
     }
 
     // Prepare the empty generator
-    auto generator = prepare_generator(input, label, n, 10, dll::inmemory_data_generator_desc<Parameters..., dll::categorical>{});
+    auto generator = prepare_generator(input, label, n, 10, desc{});
 
-    // Read all the necessary images
-    if(!mnist::read_mnist_image_file_flat(generator->input_cache, folder + "/train-images-idx3-ubyte", m, start)){
+    // Decode all the necessary images (and apply their transformations)
+    if(!read_mnist_images_mapped(*generator, folder + "/train-images-idx3-ubyte", start)){
         std::cerr << "Something went wrong, impossible to load MNIST training images" << std::endl;
         return generator;
     }
 
     // Read all the labels (categorical)
-    generator->label_cache = 0;
-    if(!mnist::read_mnist_label_file_categorical(generator->label_cache, folder + "/train-labels-idx1-ubyte", m, start)){
+    if(!read_mnist_labels_mapped(*generator, folder + "/train-labels-idx1-ubyte", start)){
         std::cerr << "Something went wrong, impossible to load MNIST training labels" << std::endl;
         return generator;
     }
 
-    // Apply the transformations on the input
-    generator->finalize_prepared_data();
+    // Only keep the shard of this process
+    if(!s.complete()){
+        generator = select_shard(*generator, s, input, label, 10, desc{});
+    }
+
+    generator->finalize_decoded_data();
+
+    if(!snapshot.empty()){
+        save_dataset_snapshot(*generator, snapshot);
+    }
 
     return generator;
 }
 
+/*!
+ * \brief Create a data generator around the MNIST train set
+ * \param folder The folder in which the MNIST train files are
+ * \param limit The limit size (0 = no limit)
+ * \param parameters The parameters of the generator
+ * \return a unique_ptr around the create generator
+ */
+template<typename Example, typename... Parameters>
+auto make_mnist_generator_train_impl(const std::string& folder, size_t start, size_t limit, Parameters&&... parameters){
+    return make_mnist_generator_train_shard_impl<Example>(folder, start, limit, shard(), std::forward<Parameters>(parameters)...);
+}
+
 /*!
  * \brief Create a data generator around the MNIST test set
  * \param folder The folder in which the MNIST test files are
@@ -71,31 +102,44 @@ auto make_mnist_generator_test_impl(const std::string& folder, size_t start, siz
     float label;
 
     size_t n = 10000 - start;
-    size_t m = 0;
 
     if(limit > 0 && limit < n){
         n = limit;
-        m = limit;
+    }
+
+    using desc = dll::inmemory_data_generator_desc<Parameters..., dll::categorical>;
+
+    // Reuse the snapshot of a previous run with the same preprocessing
+    auto snapshot = dataset_snapshot_path<desc, Example>("mnist-test", {folder + "/t10k-images-idx3-ubyte", folder + "/t10k-labels-idx1-ubyte"}, start, n, shard());
+
+    if(!snapshot.empty()){
+        auto generator = prepare_generator(input, label, n, 10, desc{});
+
+        if(load_dataset_snapshot(*generator, snapshot)){
+            return generator;
+        }
     }
 
     // Prepare the empty generator
-    auto generator = prepare_generator(input, label, n, 10, dll::inmemory_data_generator_desc<Parameters..., dll::categorical>{});
+    auto generator = prepare_generator(input, label, n, 10, desc{});
 
-    // Read all the necessary images
-    if(!mnist::read_mnist_image_file_flat(generator->input_cache, folder + "/t10k-images-idx3-ubyte", m, start)){
+    // Decode all the necessary images (and apply their transformations)
+    if(!read_mnist_images_mapped(*generator, folder + "/t10k-images-idx3-ubyte", start)){
         std::cerr << "Something went wrong, impossible to load MNIST test images" << std::endl;
         return generator;
     }
 
     // Read all the labels (categorical)
-    generator->label_cache = 0;
-    if(!mnist::read_mnist_label_file_categorical(generator->label_cache, folder + "/t10k-labels-idx1-ubyte", m, start)){
+    if(!read_mnist_labels_mapped(*generator, folder + "/t10k-labels-idx1-ubyte", start)){
         std::cerr << "Something went wrong, impossible to load MNIST test labels" << std::endl;
         return generator;
     }
 
-    // Apply the transformations on the input
-    generator->finalize_prepared_data();
+    generator->finalize_decoded_data();
+
+    if(!snapshot.empty()){
+        save_dataset_snapshot(*generator, snapshot);
+    }
 
     return generator;
 }
@@ -158,6 +202,39 @@ auto make_mnist_dataset(Parameters&&... parameters){
         make_mnist_generator_test(0UL, 10000UL, std::forward<Parameters>(parameters)...));
 }
 
+/*!
+ * \brief Creates a dataset around MNIST, with only a shard of the train set
+ *
+ * The shards are computed from the DLL random seed, all the processes
+ * must use the same seed.
+ *
+ * \param folder The folder in which the MNIST files are
+ * \param s The shard of the train set to keep
+ * \param parameters The parameters of the generator
+ * \return The MNIST dataset
+ */
+template<typename... Parameters>
+auto make_mnist_dataset_shard(const std::string& folder, const shard& s, Parameters&&... parameters){
+    return make_dataset_holder(
+        "mnist",
+        make_mnist_generator_train_shard_impl<mnist_example_t>(folder, 0UL, 60000UL, s, std::forward<Parameters>(parameters)...),
+        make_mnist_generator_test_impl<mnist_example_t>(folder, 0UL, 10000UL, std::forward<Parameters>(parameters)...));
+}
+
+/*!
+ * \brief Creates a dataset around MNIST, with only a shard of the train set
+ *
+ * The MNIST train files are assumed to be in a mnist sub folder.
+ *
+ * \param s The shard of the train set to keep
+ * \param parameters The parameters of the generator
+ * \return The MNIST dataset
+ */
+template<typename... Parameters>
+auto make_mnist_dataset_shard(const shard& s, Parameters&&... parameters){
+    return make_mnist_dataset_shard("mnist", s, std::forward<Parameters>(parameters)...);
+}
+
 /*!
  * \brief Creates a dataset around MNIST
  *
@@ -226,7 +303,8 @@ auto make_mnist_dataset_sub(size_t start, size_t limit, Parameters&&... paramete
  * \brief Creates a dataset with a validation set
  *
  * Since MNIST does not have a validation set, it is extracted from the training
- * set.
+ * set. The train and validation generators are views of a single read of
+ * the training set.
  *
  * \param folder The folder in which the MNIST files are
  * \param limit The limit size (0 = no limit)
@@ -236,11 +314,23 @@ auto make_mnist_dataset_sub(size_t start, size_t limit, Parameters&&... paramete
  */
 template<typename... Parameters>
 auto make_mnist_dataset_val(const std::string& folder, size_t start, size_t middle, size_t limit, Parameters&&... parameters){
+    // The sizes of the train and validation sets (0 = no limit)
+    const size_t train_n = (middle > 0 && middle < 60000 - start) ? middle : 60000 - start;
+    const size_t val_n   = (limit > middle && limit - middle < 60000 - middle) ? limit - middle : 60000 - middle;
+
+    // Both sets are views of a single read of the train set
+    const size_t first = std::min(start, middle);
+    const size_t last  = std::max(start + train_n, middle + val_n);
+
+    auto full = make_mnist_generator_train_impl<mnist_example_t>(folder, first, last - first, std::forward<Parameters>(parameters)...);
+
+    std::shared_ptr<const typename decltype(full)::element_type> source(std::move(full));
+
     return make_dataset_holder(
         "mnist",
-        make_mnist_generator_train_impl<mnist_example_t>(folder, start, middle, std::forward<Parameters>(parameters)...),
+        make_generator_view(source, start - first, train_n),
         make_mnist_generator_test_impl<mnist_example_t>(folder, 0UL, 10000UL, std::forward<Parameters>(parameters)...),
-        make_mnist_generator_train_impl<mnist_example_t>(folder, middle, limit - middle, std::forward<Parameters>(parameters)...)
+        make_generator_view(source, middle - first, val_n)
     );
 }
 
@@ -258,12 +348,7 @@ auto make_mnist_dataset_val(const std::string& folder, size_t start, size_t midd
  */
 template<typename... Parameters>
 auto make_mnist_dataset_val(size_t start, size_t middle, size_t limit, Parameters&&... parameters){
-    return make_dataset_holder(
-        "mnist",
-        make_mnist_generator_train(start, middle, std::forward<Parameters>(parameters)...),
-        make_mnist_generator_test(0UL, 10000UL, std::forward<Parameters>(parameters)...),
-        make_mnist_generator_train(middle, limit - middle, std::forward<Parameters>(parameters)...)
-    );
+    return make_mnist_dataset_val("mnist", start, middle, limit, std::forward<Parameters>(parameters)...);
 }
 
 } // end of namespace dll
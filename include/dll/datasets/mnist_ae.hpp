@@ -40,7 +40,10 @@ auto make_mnist_ae_generator_train(const std::string& folder, size_t start, size
         return generator;
     }
 
-    generator->label_cache = generator->input_cache;
+    // The labels are the inputs themselves, unless the generator keeps a copy
+    if (!generator->shared_labels) {
+        generator->label_cache = generator->input_cache;
+    }
 
     // Apply the transformations on the input
     generator->finalize_prepared_data();
@@ -77,7 +80,10 @@ auto make_mnist_ae_generator_test(const std::string& folder, size_t start, size_
         return generator;
     }
 
-    generator->label_cache = generator->input_cache;
+    // The labels are the inputs themselves, unless the generator keeps a copy
+    if (!generator->shared_labels) {
+        generator->label_cache = generator->input_cache;
+    }
 
     // Apply the transformations on the input
     generator->finalize_prepared_data();
@@ -0,0 +1,199 @@
+//=======================================================================
+// Copyright (c) 2014-2017 Baptiste Wicht
+// Distributed under the terms of the MIT License.
+// (See accompanying file LICENSE or copy at
+//  http://opensource.org/licenses/MIT)
+//=======================================================================
+
+/*!
+ * \file
+ * \brief Snapshots of the preprocessed caches of the dataset generators
+ *
+ * A snapshot is a packed dataset file (see write_packed_dataset) holding
+ * the finalized input cache of a generator and the class index of each
+ * label. It is keyed by the dataset, the range of samples, the shard, the
+ * descriptor of the generator (and therefore its preprocessing) and the
+ * size and modification time of the raw files.
+ */
+
+#pragma once
+
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <typeinfo>
+#include <vector>
+
+namespace dll {
+
+/*!
+ * \brief The configuration of the dataset snapshots
+ */
+struct dataset_snapshots {
+    static inline std::string directory; ///< The directory of the snapshots (disabled if empty)
+};
+
+/*!
+ * \brief Returns the path of the snapshot of a dataset generator
+ *
+ * \param name The name of the dataset part (mnist-train, ...)
+ * \param files The raw files of the dataset
+ * \param start The index of the first sample
+ * \param n The number of samples
+ * \param s The shard of the samples
+ *
+ * \tparam Desc The descriptor of the generator
+ * \tparam Example The type of a sample
+ *
+ * \return The path of the snapshot, or an empty string if the snapshots are disabled
+ */
+template <typename Desc, typename Example>
+std::string dataset_snapshot_path(const std::string& name, const std::vector<std::string>& files, size_t start, size_t n, const shard& s) {
+    if (dataset_snapshots::directory.empty()) {
+        return {};
+    }
+
+    std::stringstream key;
+    key << name << '|' << start << '|' << n << '|' << s.index << '/' << s.count << '|' << typeid(Desc).name() << '|' << typeid(Example).name();
+
+    for (auto& file : files) {
+        struct stat st;
+
+        if (::stat(file.c_str(), &st) == 0) {
+            key << '|' << file << ':' << st.st_size << ':' << st.st_mtime;
+        } else {
+            key << '|' << file;
+        }
+    }
+
+    // FNV-1a hash of the key
+    uint64_t hash = 14695981039346656037ULL;
+
+    for (char c : key.str()) {
+        hash ^= uint8_t(c);
+        hash *= 1099511628211ULL;
+    }
+
+    char hex[17];
+    snprintf(hex, sizeof(hex), "%016llx", static_cast<unsigned long long>(hash));
+
+    return dataset_snapshots::directory + "/" + name + "-" + hex + ".dlld";
+}
+
+/*!
+ * \brief Write the finalized caches of the given generator as a snapshot
+ * \param generator The generator, filled and finalized
+ * \param path The path of the snapshot
+ * \return true if the snapshot was written, false otherwise
+ */
+template <typename Generator>
+bool save_dataset_snapshot(const Generator& generator, const std::string& path) {
+    using T = etl::value_t<decltype(generator.input_cache)>;
+
+    static constexpr size_t D = etl::dimensions<decltype(generator.input_cache)>() - 1;
+    static constexpr bool compact = etl::dimensions<decltype(generator.label_cache)>() == 1;
+
+    static_assert(D <= packed_dataset_header::max_dimensions, "Too many dimensions for the packed format");
+
+    const size_t n = etl::dim<0>(generator.input_cache);
+
+    if (!n) {
+        return false;
+    }
+
+    packed_dataset_header header;
+    std::memset(&header, 0, sizeof(header));
+
+    header.magic       = packed_dataset_header::file_magic;
+    header.version     = packed_dataset_header::file_version;
+    header.weight_size = sizeof(T);
+    header.dimensions  = D;
+    header.samples     = n;
+
+    for (size_t d = 0; d < D; ++d) {
+        header.dims[d] = etl::dim(generator.input_cache, d + 1);
+    }
+
+    std::vector<T> labels(n);
+
+    for (size_t i = 0; i < n; ++i) {
+        if constexpr (compact) {
+            labels[i] = T(generator.label_cache[i]);
+        } else {
+            auto row  = generator.label_cache(i);
+            labels[i] = T(std::distance(row.begin(), std::max_element(row.begin(), row.end())));
+        }
+    }
+
+    // The snapshot only appears once complete
+    const std::string tmp = path + ".tmp";
+
+    {
+        std::ofstream os(tmp, std::ios::binary);
+
+        std::vector<char> padding(packed_dataset_header::size, 0);
+        std::memcpy(padding.data(), &header, sizeof(header));
+
+        os.write(padding.data(), padding.size());
+        os.write(reinterpret_cast<const char*>(generator.input_cache.memory_start()), etl::size(generator.input_cache) * sizeof(T));
+        os.write(reinterpret_cast<const char*>(labels.data()), n * sizeof(T));
+
+        if (!os) {
+            std::cerr << "ERROR: Impossible to write the dataset snapshot " << path << std::endl;
+            std::remove(tmp.c_str());
+            return false;
+        }
+    }
+
+    return std::rename(tmp.c_str(), path.c_str()) == 0;
+}
+
+/*!
+ * \brief Fill the caches of the given generator from a snapshot
+ * \param generator The prepared generator, with caches of the correct size
+ * \param path The path of the snapshot
+ * \return true if the caches were filled, false if there is no usable snapshot
+ */
+template <typename Generator>
+bool load_dataset_snapshot(Generator& generator, const std::string& path) {
+    using T = etl::value_t<decltype(generator.input_cache)>;
+    using L = etl::value_t<decltype(generator.label_cache)>;
+
+    static constexpr size_t D = etl::dimensions<decltype(generator.input_cache)>() - 1;
+    static constexpr bool compact = etl::dimensions<decltype(generator.label_cache)>() == 1;
+
+    if (path.empty() || !std::ifstream(path)) {
+        return false;
+    }
+
+    packed_dataset_file<T, D> file(path);
+
+    if (!file.data || file.samples != etl::dim<0>(generator.input_cache) || file.stride * file.samples != etl::size(generator.input_cache)) {
+        return false;
+    }
+
+    std::memcpy(generator.input_cache.memory_start(), file.data, etl::size(generator.input_cache) * sizeof(T));
+    generator.input_cache.invalidate_gpu();
+
+    if constexpr (compact) {
+        for (size_t i = 0; i < file.samples; ++i) {
+            generator.label_cache[i] = uint32_t(file.label(i));
+        }
+    } else {
+        generator.label_cache = L(0);
+
+        for (size_t i = 0; i < file.samples; ++i) {
+            generator.label_cache(i, size_t(file.label(i))) = L(1);
+        }
+    }
+
+    return true;
+}
+
+} //end of dll namespace
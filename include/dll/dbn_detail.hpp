@@ -102,6 +102,31 @@ size_t fast_distance(Iterator& first, Iterator& last) {
     }
 }
 
+/*!
+ * \brief Placeholder of a member only used for training, in a network
+ * built for inference only
+ */
+struct no_training_state {};
+
+/*!
+ * \brief The type of a member of the network only used for training,
+ * replaced by an empty placeholder in an inference_only network
+ */
+template <typename DBN, typename T>
+using training_state_t = std::conditional_t<dbn_traits<DBN>::inference_only(), no_training_state, T>;
+
+// Create a batch of n samples with the shape of the given sample
+
+template <typename Batch, typename Sample, size_t... I>
+Batch make_batch(size_t n, const Sample& sample, std::index_sequence<I...> /*seq*/) {
+    return Batch(n, etl::dim<I>(sample)...);
+}
+
+template <typename Batch, typename Sample>
+Batch make_batch(size_t n, const Sample& sample) {
+    return make_batch<Batch>(n, sample, std::make_index_sequence<etl::decay_traits<Sample>::dimensions()>());
+}
+
 template <typename D, size_t N, typename T>
 struct for_each_impl;
 
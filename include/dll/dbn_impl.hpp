@@ -16,6 +16,8 @@
 
 #pragma once
 
+#include <bitset>
+
 #include "cpp_utils/maybe_parallel.hpp"
 #include "cpp_utils/tuple_utils.hpp"
 
@@ -24,12 +26,30 @@
 #include "trainer/dbn_trainer.hpp"
 #include "trainer/rbm_trainer_fwd.hpp"
 #include "dll/trainer/rbm_training_context.hpp"
+#include "trainer/grad_compression.hpp"
 #include "dbn_common.hpp"
 #include "svm_common.hpp"
 #include "util/export.hpp"
 #include "util/timers.hpp"
+#include "util/affinity.hpp"
+#include "util/huge_pages.hpp"
+#include "util/memory.hpp"
+#include "util/conv_tuning.hpp"
 #include "util/random.hpp"
 #include "util/ready.hpp"
+#include "util/scratch_arena.hpp"
+#include "util/model_file.hpp"
+#include "util/compact_model.hpp"
+#include "util/scheduler.hpp"
+#include "util/filter_pruning.hpp"
+#include "util/conv_pool.hpp"
+#include "inference_session.hpp"
+#include "inference_batcher.hpp"
+#include "ensemble.hpp"
+#include "cascade.hpp"
+#include "pipeline.hpp"
+#include "checkpointer.hpp"
+#include "hot_model.hpp"
 #include "dbn_detail.hpp" // dbn_detail namespace
 
 namespace dll {
@@ -88,6 +108,8 @@ struct dbn final {
         "batch_mode dbn does not support shuffle in layers");
     static_assert(!dbn_traits<this_type>::shuffle_pretrain() || dbn_traits<this_type>::batch_mode(),
         "shuffle_pre is only compatible with batch mode, for normal mode, use shuffle in layers");
+    static_assert(!dbn_traits<this_type>::pipeline_pretrain() || dbn_traits<this_type>::batch_mode(),
+        "pipeline_pretrain is only compatible with batch mode");
 
     template <size_t N>
     using layer_type = detail::layer_type_t<N, layers_t>; ///< The type of the layer at index Nth
@@ -99,6 +121,8 @@ struct dbn final {
 
     using watcher_t       = typename desc::template watcher_t<this_type>;                            ///< The watcher type
     using output_policy_t = typename desc::output_policy_t;                                          ///< The output policy
+    using lr_schedule_t   = typename desc::lr_schedule_t;                                            ///< The learning rate schedule
+    using transport_t     = typename desc::transport_t;                                              ///< The transport of the distributed trainer
 
     static constexpr size_t input_layer_n   = 0;                                                   ///< The index of the input layer
     static constexpr size_t output_layer_n  = find_output_layer<layers_t::size - 1, this_type>::L; ///< The index of the output layer
@@ -109,6 +133,11 @@ struct dbn final {
     using input_one_t   = typename input_layer_t::input_one_t; ///< The type of one input
     using input_t       = std::vector<input_one_t>;            ///< The type of a set of input
 
+    using inference_session = dbn_inference_session<this_type>; ///< The type of an inference session on the network
+    using inference_batcher = dbn_inference_batcher<this_type>; ///< The type of a micro-batching front-end on the network
+    using checkpointer      = dbn_checkpointer<this_type>;      ///< The type of the background checkpoints of the network
+    using hot_model         = dbn_hot_model<this_type>;         ///< The type of a hot-reloadable network for inference
+
 private:
     template <size_t I, typename Input>
     struct types_helper {
@@ -143,6 +172,11 @@ public:
     weight learning_rate       = 0.1; ///< The learning rate for finetuning
     weight learning_rate_decay = 0.0; ///< The learning rate decay
 
+    size_t lr_step_epochs       = 10;  ///< The number of epochs between two steps (step_lr)
+    weight lr_gamma             = 0.1; ///< The factor applied at each step (step_lr)
+    weight lr_min               = 0.0; ///< The final learning rate (cosine_lr)
+    size_t lr_warmup_iterations = 0;   ///< The number of warmup iterations (warmup_lr)
+
     weight initial_momentum     = 0.9; ///< The initial momentum
     weight final_momentum       = 0.9; ///< The final momentum applied after *final_momentum_epoch* epoch
     weight final_momentum_epoch = 6;   ///< The epoch at which momentum change
@@ -159,15 +193,38 @@ public:
 
     weight gradient_clip = 5.0; ///< The gradient clipping
 
+    weight loss_scale        = 65536.0; ///< The current loss scale (with loss_scaling)
+    size_t loss_scale_window = 2000;    ///< The number of updates without overflow before the loss scale is doubled
+
     weight goal     = 0.0; ///< The learning goal
     size_t patience = 1;   ///< The patience for early stopping goals
 
+    size_t validation_subset      = 0;  ///< The number of validation samples evaluated at each epoch (0 for all of them)
+    size_t validation_full_epochs = 10; ///< The number of epochs between two evaluations of the complete validation set (validation_subset)
+
+    size_t pipeline_delay = 1; ///< The number of epochs of a layer before the next layer starts (pipeline_pretrain)
+
+    // The members only used for training are removed from inference_only networks
+
+    size_t checkpoint_epochs  = 1;                                                          ///< The number of epochs between two checkpoints (enable_checkpoints)
+    size_t checkpoint_batches = 0;                                                          ///< The number of batches between two checkpoints inside an epoch (0 to disable)
+    dbn_detail::training_state_t<this_type, std::unique_ptr<checkpointer>> checkpoints; ///< The background checkpoints taken during fine-tuning
+    dbn_detail::training_state_t<this_type, std::string> resume_state;                  ///< The training state resumed by the next fine-tuning (resume)
+
+    dbn_detail::training_state_t<this_type, memory_report> memory; ///< The memory accounted during the last fine-tuning
+
+    dbn_detail::training_state_t<this_type, std::bitset<layers>> frozen; ///< The layers not trained by fine-tuning (e.g. pretrained layers kept fixed)
+    dbn_detail::training_state_t<this_type, feature_cache_options> feature_cache; ///< The cache of the outputs of the frozen layers during fine-tuning
+
+    dbn_detail::training_state_t<this_type, std::array<grad_compression_options, layers>> gradient_compression; ///< The compression of the gradients of each layer by the distributed trainer
+
 #ifdef DLL_SVM_SUPPORT
     //TODO Ideally these fields should be private
-    svm::model svm_model;    ///< The learned model
-    svm::problem problem;    ///< libsvm is stupid, therefore, you cannot destroy the problem if you want to use the model...
-    bool svm_loaded = false; ///< Indicates if a SVM model has been loaded (and therefore must be saved)
-#endif                       //DLL_SVM_SUPPORT
+    svm::model svm_model;                                         ///< The learned model
+    dbn_detail::training_state_t<this_type, svm::problem> problem; ///< libsvm is stupid, therefore, you cannot destroy the problem if you want to use the model...
+    bool svm_loaded        = false;                               ///< Indicates if a SVM model has been loaded (and therefore must be saved)
+    bool svm_problem_ready = false;                               ///< Indicates if the SVM problem has been built (and can be searched again)
+#endif                                                            //DLL_SVM_SUPPORT
 
     mutable output_policy_t out; ///< The output policy instance
 
@@ -178,13 +235,13 @@ public:
 
     using ae_generator_t = std::conditional_t<
         !dbn_traits<this_type>::batch_mode(),
-        inmemory_data_generator_desc<dll::batch_size<batch_size>, dll::big_batch_size<big_batch_size>, dll::scale_pre<desc::ScalePre>, dll::autoencoder, dll::noise<desc::Noise>, dll::binarize_pre<desc::BinarizePre>, dll::normalize_pre_cond<desc::NormalizePre>>,
-        outmemory_data_generator_desc<dll::batch_size<batch_size>, dll::big_batch_size<big_batch_size>, dll::scale_pre<desc::ScalePre>, dll::autoencoder, dll::noise<desc::Noise>, dll::binarize_pre<desc::BinarizePre>, dll::normalize_pre_cond<desc::NormalizePre>>>;
+        inmemory_data_generator_desc<dll::batch_size<batch_size>, dll::big_batch_size<big_batch_size>, dll::scale_pre<desc::ScalePre>, dll::autoencoder, dll::noise<desc::Noise>, dll::noise_kind<desc::NoiseKind>, dll::binarize_pre<desc::BinarizePre>, dll::normalize_pre_cond<desc::NormalizePre>>,
+        outmemory_data_generator_desc<dll::batch_size<batch_size>, dll::big_batch_size<big_batch_size>, dll::scale_pre<desc::ScalePre>, dll::autoencoder, dll::noise<desc::Noise>, dll::noise_kind<desc::NoiseKind>, dll::binarize_pre<desc::BinarizePre>, dll::normalize_pre_cond<desc::NormalizePre>>>;
 
     using reg_generator_t = std::conditional_t<
         !dbn_traits<this_type>::batch_mode(),
-        inmemory_data_generator_desc<dll::batch_size<batch_size>, dll::big_batch_size<big_batch_size>, dll::scale_pre<desc::ScalePre>, dll::autoencoder, dll::noise<desc::Noise>, dll::binarize_pre<desc::BinarizePre>, dll::normalize_pre_cond<desc::NormalizePre>>,
-        outmemory_data_generator_desc<dll::batch_size<batch_size>, dll::big_batch_size<big_batch_size>, dll::scale_pre<desc::ScalePre>, dll::autoencoder, dll::noise<desc::Noise>, dll::binarize_pre<desc::BinarizePre>, dll::normalize_pre_cond<desc::NormalizePre>>>;
+        inmemory_data_generator_desc<dll::batch_size<batch_size>, dll::big_batch_size<big_batch_size>, dll::scale_pre<desc::ScalePre>, dll::autoencoder, dll::noise<desc::Noise>, dll::noise_kind<desc::NoiseKind>, dll::binarize_pre<desc::BinarizePre>, dll::normalize_pre_cond<desc::NormalizePre>>,
+        outmemory_data_generator_desc<dll::batch_size<batch_size>, dll::big_batch_size<big_batch_size>, dll::scale_pre<desc::ScalePre>, dll::autoencoder, dll::noise<desc::Noise>, dll::noise_kind<desc::NoiseKind>, dll::binarize_pre<desc::BinarizePre>, dll::normalize_pre_cond<desc::NormalizePre>>>;
 
     template<size_t B>
     using rbm_generator_fast_t = std::conditional_t<
@@ -204,20 +261,20 @@ public:
     template<size_t B>
     using rbm_denoising_generator_fast_t = std::conditional_t<
         !dbn_traits<this_type>::batch_mode(),
-        inmemory_data_generator_desc<dll::batch_size<B>, dll::big_batch_size<big_batch_size>, dll::scale_pre<desc::ScalePre>, dll::autoencoder, dll::noise<desc::Noise>, dll::binarize_pre<desc::BinarizePre>, dll::normalize_pre_cond<desc::NormalizePre>>,
-        outmemory_data_generator_desc<dll::batch_size<B>, dll::big_batch_size<big_batch_size>, dll::scale_pre<desc::ScalePre>, dll::autoencoder, dll::noise<desc::Noise>, dll::binarize_pre<desc::BinarizePre>, dll::normalize_pre_cond<desc::NormalizePre>>>;
+        inmemory_data_generator_desc<dll::batch_size<B>, dll::big_batch_size<big_batch_size>, dll::scale_pre<desc::ScalePre>, dll::autoencoder, dll::noise<desc::Noise>, dll::noise_kind<desc::NoiseKind>, dll::binarize_pre<desc::BinarizePre>, dll::normalize_pre_cond<desc::NormalizePre>>,
+        outmemory_data_generator_desc<dll::batch_size<B>, dll::big_batch_size<big_batch_size>, dll::scale_pre<desc::ScalePre>, dll::autoencoder, dll::noise<desc::Noise>, dll::noise_kind<desc::NoiseKind>, dll::binarize_pre<desc::BinarizePre>, dll::normalize_pre_cond<desc::NormalizePre>>>;
 
     template<size_t B>
-    using rbm_denoising_ingenerator_fast_inner_t = inmemory_data_generator_desc<dll::batch_size<B>, dll::big_batch_size<big_batch_size>, dll::autoencoder, dll::noise<desc::Noise>>;
+    using rbm_denoising_ingenerator_fast_inner_t = inmemory_data_generator_desc<dll::batch_size<B>, dll::big_batch_size<big_batch_size>, dll::autoencoder, dll::noise<desc::Noise>, dll::noise_kind<desc::NoiseKind>>;
 
     template<size_t B>
     using rbm_denoising_generator_fast_inner_t = std::conditional_t<
         !dbn_traits<this_type>::batch_mode(),
-        inmemory_data_generator_desc<dll::batch_size<B>, dll::big_batch_size<big_batch_size>, dll::autoencoder, dll::noise<desc::Noise>>,
-        outmemory_data_generator_desc<dll::batch_size<B>, dll::big_batch_size<big_batch_size>, dll::autoencoder, dll::noise<desc::Noise>>>;
+        inmemory_data_generator_desc<dll::batch_size<B>, dll::big_batch_size<big_batch_size>, dll::autoencoder, dll::noise<desc::Noise>, dll::noise_kind<desc::NoiseKind>>,
+        outmemory_data_generator_desc<dll::batch_size<B>, dll::big_batch_size<big_batch_size>, dll::autoencoder, dll::noise<desc::Noise>, dll::noise_kind<desc::NoiseKind>>>;
 
 private:
-    cpp::thread_pool<!dbn_traits<this_type>::is_serial()> pool;
+    mutable cpp::thread_pool<!dbn_traits<this_type>::is_serial()> pool;
 
     template<size_t I, cpp_disable_iff(I == layers)>
     void dyn_init(){
@@ -247,6 +304,13 @@ private:
         return rbm_denoising_generator_fast_t<layer_type<L>::batch_size>{};
     }
 
+    template<size_t L = rbm_layer_n>
+    auto get_rbm_denoising_ingenerator_inner_desc(){
+        static_assert(decay_layer_traits<layer_type<L>>::is_rbm_layer(), "Invalid use of get_rbm_denoising_ingenerator_inner_desc");
+
+        return rbm_denoising_ingenerator_fast_inner_t<layer_type<L>::batch_size>{};
+    }
+
     template<size_t L = rbm_layer_n>
     auto get_rbm_generator_inner_desc(){
         static_assert(decay_layer_traits<layer_type<L>>::is_rbm_layer(), "Invalid use of get_rbm_generator_inner_desc");
@@ -284,6 +348,8 @@ private:
     }
 
     void validate_pretraining() const {
+        static_assert(!dbn_traits<this_type>::inference_only(), "inference_only networks cannot be trained");
+
         validate_pretraining_base<0>();
     }
 
@@ -328,6 +394,37 @@ public:
         if(updater == updater_type::NADAM){
             learning_rate = 0.002;
         }
+
+        // Pin the workers of the pool following the execution policy
+
+        if constexpr (!dbn_traits<this_type>::is_serial()) {
+            pin_pool(pool, execution().pool, etl::threads);
+        }
+
+        // Back the large weights with huge pages following the execution policy
+
+        if (execution().huge_pages) {
+            for_each_layer([](auto& layer) {
+                this_type::advise_weights_huge_pages(layer);
+            });
+        }
+    }
+
+    /*!
+     * \brief Advise the kernel to back the large weights of the given layer
+     * (and of its sub layers) with transparent huge pages
+     */
+    template <typename Layer>
+    static void advise_weights_huge_pages(const Layer& layer) {
+        if constexpr (is_utility_layer<Layer>) {
+            cpp::for_each(layer.layers, [](auto& sub_layer) {
+                this_type::advise_weights_huge_pages(sub_layer);
+            });
+        } else if constexpr (decay_layer_traits<Layer>::is_neural_layer()) {
+            advise_huge_pages(layer.trainable_parameters());
+        } else {
+            cpp_unused(layer);
+        }
     }
 
     //No copying
@@ -372,7 +469,7 @@ public:
     }
 
     template<typename Layer>
-    void sub_display_pretty(const std::vector<size_t>& output, const std::string& parent, const std::string& pre, Layer& layer, std::vector<std::array<std::string, 4>>& rows) const {
+    void sub_display_pretty(const std::vector<size_t>& output, const std::string& parent, const std::string& pre, Layer& layer, std::vector<std::array<std::string, 5>>& rows) const {
         std::vector<size_t> sub_output = output;
 
         cpp::for_each_i(layer.layers, [&](size_t i, auto& sub_layer) {
@@ -381,10 +478,12 @@ public:
 
             std::string sub_pre = pre + "  ";
             std::string sub_parameters_str = "0";
+            std::string sub_memory_str = "0B";
 
             // Extract the number of parameters
             if constexpr (decay_layer_traits<decltype(sub_layer)>::is_neural_layer()) {
                 sub_parameters_str = std::to_string(sub_layer.parameters());
+                sub_memory_str     = memory_str(sub_layer.parameters() * sizeof(weight));
             }
 
             // Extract the output shape if possible
@@ -396,6 +495,7 @@ public:
             row[1] = sub_pre + sub_layer.to_short_string(sub_pre);
             row[2] = sub_parameters_str;
             row[3] = this_type::shape_to_string(sub_output);
+            row[4] = sub_memory_str;
 
             if constexpr (decay_layer_traits<decltype(sub_layer)>::base_traits::is_multi) {
                 sub_display_pretty(sub_output, number, sub_pre, sub_layer, rows);
@@ -407,7 +507,7 @@ public:
      * \brief Prints a textual representation of the network.
      */
     void display_pretty() const {
-        constexpr size_t columns = 4;
+        constexpr size_t columns = 5;
 
         out << '\n';
 
@@ -416,6 +516,7 @@ public:
         column_name[1] = "Layer";
         column_name[2] = "Parameters";
         column_name[3] = "Output Shape";
+        column_name[4] = "Memory";
 
         std::vector<std::array<std::string, columns>> rows;
 
@@ -425,10 +526,12 @@ public:
 
         for_each_layer_i([&](size_t I, auto& layer) {
             std::string parameters_str = "0";
+            std::string layer_memory_str = "0B";
 
             // Extract the number of parameters
             if constexpr (decay_layer_traits<decltype(layer)>::is_neural_layer()) {
-                parameters_str = std::to_string(layer.parameters());
+                parameters_str   = std::to_string(layer.parameters());
+                layer_memory_str = memory_str(layer.parameters() * sizeof(weight));
 
                 parameters += layer.parameters();
             }
@@ -443,6 +546,7 @@ public:
             row[1] = layer.to_short_string("");
             row[2] = parameters_str;
             row[3] = this_type::shape_to_string(output);
+            row[4] = layer_memory_str;
 
             if constexpr (decay_layer_traits<decltype(layer)>::base_traits::is_multi) {
                 sub_display_pretty(output, std::to_string(I), "", layer, rows);
@@ -454,12 +558,14 @@ public:
         column_length[1] = column_name[1].size();
         column_length[2] = column_name[2].size();
         column_length[3] = column_name[3].size();
+        column_length[4] = column_name[4].size();
 
         for(auto& row : rows){
             column_length[0] = std::max(column_length[0], row[0].size());
             column_length[1] = std::max(column_length[1], row[1].size());
             column_length[2] = std::max(column_length[2], row[2].size());
             column_length[3] = std::max(column_length[3], row[3].size());
+            column_length[4] = std::max(column_length[4], row[4].size());
         }
 
         const size_t line_length = (columns + 1) * 1 + 2 + (columns - 1) * 2 + std::accumulate(column_length.begin(), column_length.end(), 0);
@@ -468,11 +574,12 @@ public:
 
         char buffer[512];
 
-        snprintf(buffer, 512, " | %-*s | %-*s | %-*s | %-*s |\n",
+        snprintf(buffer, 512, " | %-*s | %-*s | %-*s | %-*s | %-*s |\n",
                int(column_length[0]), column_name[0].c_str(),
                int(column_length[1]), column_name[1].c_str(),
                int(column_length[2]), column_name[2].c_str(),
-               int(column_length[3]), column_name[3].c_str());
+               int(column_length[3]), column_name[3].c_str(),
+               int(column_length[4]), column_name[4].c_str());
 
         out << buffer;
 
@@ -480,11 +587,12 @@ public:
 
         for(auto& row : rows){
             // Print the layer line
-            snprintf(buffer, 512, " | %-*s | %-*s | %*s | %-*s |\n",
+            snprintf(buffer, 512, " | %-*s | %-*s | %*s | %-*s | %*s |\n",
                    int(column_length[0]), row[0].c_str(),
                    int(column_length[1]), row[1].c_str(),
                    int(column_length[2]), row[2].c_str(),
-                   int(column_length[3]), row[3].c_str());
+                   int(column_length[3]), row[3].c_str(),
+                   int(column_length[4]), row[4].c_str());
 
             out << buffer;
         }
@@ -494,6 +602,168 @@ public:
         snprintf(buffer, 512, "  %*s: %*lu\n", int(column_length[0] + column_length[1] + 5), "Total Parameters", int(column_length[2]), parameters);
 
         out << buffer;
+
+        // The memory of the training is only known once a training started
+        if constexpr (!dbn_traits<this_type>::inference_only()) {
+            if (!memory.empty()) {
+                display_memory();
+            }
+        }
+    }
+
+    /*!
+     * \brief Prints the memory accounted during the last fine-tuning of
+     * the network.
+     *
+     * For each layer, the memory of the parameters, of the inputs, outputs
+     * and errors of its context and of the gradients and state of the
+     * updater is printed, together with the memory of the other buffers
+     * of the trainer and of the caches of the generators.
+     */
+    void display_memory() const {
+        if (memory.empty()) {
+            out << "\nNo memory accounted (the network has not been fine-tuned)" << std::endl;
+            return;
+        }
+
+        constexpr size_t columns = 5;
+
+        out << '\n';
+
+        std::array<std::string, columns> column_name;
+        column_name[0] = "Index";
+        column_name[1] = "Parameters";
+        column_name[2] = "Context";
+        column_name[3] = "Updater";
+        column_name[4] = "Total";
+
+        std::vector<std::array<std::string, columns>> rows;
+
+        for (size_t i = 0; i < memory.layers.size(); ++i) {
+            auto& layer = memory.layers[i];
+
+            rows.push_back({std::to_string(i), memory_str(layer.parameters), memory_str(layer.context), memory_str(layer.updater), memory_str(layer.total())});
+        }
+
+        auto sum = memory.layers_total();
+
+        rows.push_back({"Layers", memory_str(sum.parameters), memory_str(sum.context), memory_str(sum.updater), memory_str(sum.total())});
+
+        std::array<size_t, columns> column_length;
+
+        for (size_t c = 0; c < columns; ++c) {
+            column_length[c] = column_name[c].size();
+
+            for (auto& row : rows) {
+                column_length[c] = std::max(column_length[c], row[c].size());
+            }
+        }
+
+        const size_t line_length = (columns + 1) * 1 + 2 + (columns - 1) * 2 + std::accumulate(column_length.begin(), column_length.end(), 0);
+
+        out << " " << std::string(line_length, '-') << '\n';
+
+        char buffer[512];
+
+        snprintf(buffer, 512, " | %-*s | %-*s | %-*s | %-*s | %-*s |\n",
+               int(column_length[0]), column_name[0].c_str(),
+               int(column_length[1]), column_name[1].c_str(),
+               int(column_length[2]), column_name[2].c_str(),
+               int(column_length[3]), column_name[3].c_str(),
+               int(column_length[4]), column_name[4].c_str());
+
+        out << buffer;
+
+        out << " " << std::string(line_length, '-') << '\n';
+
+        for (size_t r = 0; r < rows.size(); ++r) {
+            auto& row = rows[r];
+
+            // The sum of the layers is separated from the layers
+            if (r == rows.size() - 1) {
+                out << " " << std::string(line_length, '-') << '\n';
+            }
+
+            snprintf(buffer, 512, " | %-*s | %*s | %*s | %*s | %*s |\n",
+                   int(column_length[0]), row[0].c_str(),
+                   int(column_length[1]), row[1].c_str(),
+                   int(column_length[2]), row[2].c_str(),
+                   int(column_length[3]), row[3].c_str(),
+                   int(column_length[4]), row[4].c_str());
+
+            out << buffer;
+        }
+
+        out << " " << std::string(line_length, '-') << '\n';
+
+        out << "  Trainer buffers: " << memory_str(memory.trainer) << '\n';
+        out << "  Generator caches: " << memory_str(memory.generator) << '\n';
+        out << "  Total memory: " << memory_str(memory.total()) << std::endl;
+    }
+
+    /*!
+     * \brief Prints the achieved throughput of each layer during the
+     * training.
+     *
+     * The time of the forward and backward passes of each layer is read
+     * from the timers of the trainer and the number of floating point
+     * operations and of bytes moved by each pass is computed from the
+     * shape of the layer.
+     */
+    void display_throughput() const {
+        constexpr size_t columns = 8;
+
+        out << '\n';
+
+        std::array<std::string, columns> column_name;
+        column_name[0] = "Index";
+        column_name[1] = "Layer";
+        column_name[2] = "Forward";
+        column_name[3] = "GFLOP/s";
+        column_name[4] = "GB/s";
+        column_name[5] = "Backward";
+        column_name[6] = "GFLOP/s";
+        column_name[7] = "GB/s";
+
+        std::vector<std::array<std::string, columns>> rows;
+
+        throughput_rows(merged_timers(), rows, std::make_index_sequence<layers>());
+
+        std::array<size_t, columns> column_length;
+
+        for (size_t c = 0; c < columns; ++c) {
+            column_length[c] = column_name[c].size();
+
+            for (auto& row : rows) {
+                column_length[c] = std::max(column_length[c], row[c].size());
+            }
+        }
+
+        const size_t line_length = (columns + 1) * 1 + 2 + (columns - 1) * 2 + std::accumulate(column_length.begin(), column_length.end(), 0);
+
+        auto print_row = [&](const std::array<std::string, columns>& row) {
+            std::ostringstream line;
+
+            line << " |";
+
+            for (size_t c = 0; c < columns; ++c) {
+                line << ' ' << (c < 2 ? std::left : std::right) << std::setw(column_length[c]) << row[c] << " |";
+            }
+
+            out << line.str() << '\n';
+        };
+
+        out << " " << std::string(line_length, '-') << '\n';
+
+        print_row(column_name);
+
+        out << " " << std::string(line_length, '-') << '\n';
+
+        for (auto& row : rows) {
+            print_row(row);
+        }
+
+        out << " " << std::string(line_length, '-') << '\n';
     }
 
     /*!
@@ -520,6 +790,116 @@ public:
         });
     }
 
+    /*!
+     * \brief Fold the batch normalization layers into the weights of the
+     * layers preceding them, for inference.
+     *
+     * Only the normalization following a dense or convolutional layer
+     * without activation function can be folded. The folded normalization
+     * layers do not normalize their inputs anymore and the network must
+     * not be trained after this.
+     */
+    void fold_batch_norm() {
+        for_each_layer_pair([](auto& layer_1, auto& layer_2) {
+            using layer_1_t = std::decay_t<decltype(layer_1)>;
+            using layer_2_t = std::decay_t<decltype(layer_2)>;
+
+            if constexpr (cpp::is_specialization_of_v<batch_normalization_2d_layer_impl, layer_2_t> || cpp::is_specialization_of_v<batch_normalization_4d_layer_impl, layer_2_t>) {
+                if constexpr (layer_2_t::template foldable<layer_1_t>()) {
+                    if (!layer_2.folded) {
+                        layer_2.fold_into(layer_1);
+                    }
+                }
+            }
+        });
+    }
+
+    /*!
+     * \brief Prune the weights of the dense layers to the given sparsity,
+     * setting the weights of smallest magnitude to zero.
+     *
+     * The pruned layers use sparse weights for inference once the density
+     * of their weights is low enough.
+     *
+     * \param sparsity The fraction of the weights of each layer to set to zero
+     */
+    void prune(double sparsity) {
+        for_each_layer([sparsity](auto& layer) {
+            if constexpr (cpp::is_specialization_of_v<dense_layer_impl, std::decay_t<decltype(layer)>>) {
+                layer.prune(sparsity);
+            }
+        });
+    }
+
+    /*!
+     * \brief Prune whole filters of the dynamic convolutional layers,
+     * removing the matching input channels of the following layers.
+     *
+     * The layers physically shrink, the network must be fine-tuned again
+     * after the pruning. The static layers cannot change their shapes: the
+     * weights of a static network must be loaded into the equivalent
+     * dynamic network (dyn_dbn_desc) to be pruned, the static descriptor
+     * of the pruned network is then given by static_network_desc.
+     *
+     * \param ratio The fraction of the filters of each layer to remove
+     * \param score The score of the filters
+     * \return The number of removed filters
+     */
+    size_t prune_filters(double ratio, filter_score score = filter_score::L1) {
+        return dll::prune_filters(*this, ratio, score);
+    }
+
+    /*!
+     * \brief Quantize the weights of the dense and convolutional layers
+     * to int8, for inference.
+     *
+     * The range of the input of each layer is calibrated on the batches
+     * of the given generator. The quantized layers then compute their test
+     * forward pass with int8 products and int32 accumulation. The
+     * quantization must be done again after the weights are modified.
+     *
+     * \param generator The generator of the calibration samples
+     */
+    template <typename Generator>
+    void quantize(Generator& generator) {
+        std::array<weight, layers> ranges;
+        ranges.fill(weight(0));
+
+        generator.reset();
+        generator.set_test();
+
+        while (generator.has_next_batch()) {
+            quantize_calibrate<0>(generator.data_batch(), ranges);
+
+            generator.next_batch();
+        }
+
+        for_each_layer_i([&ranges](size_t I, auto& layer) {
+            using layer_t = std::decay_t<decltype(layer)>;
+
+            if constexpr (cpp::is_specialization_of_v<dense_layer_impl, layer_t> || cpp::is_specialization_of_v<conv_layer_impl, layer_t>) {
+                layer.quantize(ranges[I]);
+            }
+        });
+    }
+
+    /*!
+     * \brief Select the fastest implementation of the convolutions of each
+     * convolutional and deconvolutional layer.
+     *
+     * The Winograd (or GEMM) and the generic ETL implementations of the
+     * forward pass and of the backpropagation of the errors are timed on
+     * a batch of the network and the fastest is kept by each layer. When
+     * a file is given, the shapes already tuned in the file are not timed
+     * again and the new ones are added to the file.
+     *
+     * \param file The tuning cache file
+     * \return The tuning of all the layer shapes
+     */
+    conv_tuning_cache autotune(const std::string& file = "") {
+        return autotune_convolutions(*this, file);
+    }
+
     /*!
      * \brief Store the network weights to the given file.
      * \param file The path to the file
@@ -571,87 +951,393 @@ public:
     }
 
     /*!
-     * \brief Returns the Nth layer.
-     * \return The Nth layer
-     * \tparam N The index of the layer to return (from 0)
+     * \brief Store the network weights to the given file, in the packed
+     * model format.
+     *
+     * The weights of each layer are stored in their own aligned and
+     * checksummed record.
+     *
+     * \param file The path to the file
+     * \return true if the file was written, false otherwise
      */
-    template <size_t N>
-    layer_type<N>& layer_get() {
-        return detail::layer_get<N>(tuples);
-    }
+    bool store_packed(const std::string& file) const {
+        std::vector<std::string> records;
 
-    /*!
-     * \brief Returns the Nth layer.
-     * \return The Nth layer
-     * \tparam N The index of the layer to return (from 0)
-     */
-    template <size_t N>
-    constexpr const layer_type<N>& layer_get() const {
-        return detail::layer_get<N>(tuples);
+        for_each_layer([&records](auto& layer) {
+            if constexpr (decay_layer_traits<decltype(layer)>::is_neural_layer()) {
+                std::ostringstream os;
+                layer.store(os);
+                records.push_back(os.str());
+            }
+        });
+
+        return write_packed_model(file, records, sizeof(weight));
     }
 
     /*!
-     * \brief Initialize the Nth layer  with the given args. The Nth layer must
-     * be a dynamic layer.
-     * \tparam N The index of the layer to return (from 0)
-     * \param args The arguments for initialization of the layer.
+     * \brief Load the network weights from the given packed model file.
+     *
+     * The file is mapped in memory and the checksums of all the records
+     * are verified before any layer is modified. The weights of each layer
+     * are then read directly from the mapping, without going through a
+     * file stream.
+     *
+     * \param file The path to the file
+     * \return true if the network was loaded, false otherwise
      */
-    template <size_t N, typename... Args>
-    void init_layer(Args&&... args){
-        layer_get<N>().init_layer(std::forward<Args>(args)...);
-    }
+    bool load_packed(const std::string& file) {
+        packed_model_file model(file, sizeof(weight));
 
-    template <size_t N>
-    size_t layer_input_size() const noexcept {
-        return dll::input_size(layer_get<N>());
-    }
+        if (!model.valid()) {
+            return false;
+        }
 
-    template <size_t N>
-    size_t layer_output_size() const noexcept {
-        return dll::output_size(layer_get<N>());
-    }
+        size_t neural_layers = 0;
 
-    /*!
-     * \brief Returns the input size expected by the network
-     * \return The input size of the network
-     */
-    size_t input_size() const noexcept {
-        return dll::input_size(layer_get<input_layer_n>());
-    }
+        for_each_layer([&neural_layers](auto& layer) {
+            if constexpr (decay_layer_traits<decltype(layer)>::is_neural_layer()) {
+                ++neural_layers;
+            }
+        });
 
-    /*!
-     * \brief Returns the output size generated by the network
-     * \return The output size of the network
-     */
-    size_t output_size() const noexcept {
-        return dll::output_size(layer_get<output_layer_n>());
-    }
+        if (model.records() != neural_layers) {
+            std::cerr << "ERROR: The packed model " << file << " does not match the network" << std::endl;
+            return false;
+        }
 
-    size_t full_output_size() const noexcept {
-        size_t output = 0;
-        for_each_layer([&output](auto& layer) {
-            output += layer.output_size();
+        size_t r = 0;
+
+        for_each_layer([&model, &r](auto& layer) {
+            if constexpr (decay_layer_traits<decltype(layer)>::is_neural_layer()) {
+                auto buffer = model.record(r++);
+                std::istream is(&buffer);
+                layer.load(is);
+            }
         });
-        return output;
+
+        return true;
     }
 
     /*!
-     * \brief Indicates if training should save memory (true) or run as efficiently as possible (false).
+     * \brief Store the network weights to the given file, in the compact
+     * model format.
      *
-     * \return true if the training should save memory, false otherwise.
+     * The weights of each layer are encoded in half precision (FP16 or
+     * BF16) or quantized to int8 and, if compress is set and zstd is
+     * supported (DLL_ZSTD_SUPPORT), compressed.
+     *
+     * \param file The path to the file
+     * \param encoding The encoding of the weights
+     * \param compress Indicates if the encoded weights are compressed
+     * \return true if the file was written, false otherwise
      */
-    static constexpr bool batch_mode() noexcept {
-        return dbn_traits<this_type>::batch_mode();
-    }
+    bool store_compact(const std::string& file, model_encoding encoding, bool compress = false) const {
+        if (compress && !compact_compression_support()) {
+            std::cerr << "WARNING: DLL_ZSTD_SUPPORT is not defined, the compact model is not compressed" << std::endl;
+        }
 
-    /* pretrain */
+        std::vector<std::string> raw;
 
-    /*!
-     * \brief Pretrain the network by training all layers in an unsupervised
-     * manner.
-     */
-    template <typename Generator, cpp_enable_iff(is_generator<Generator>)>
-    void pretrain(Generator& generator, size_t max_epochs) {
+        for_each_layer([&raw](auto& layer) {
+            if constexpr (decay_layer_traits<decltype(layer)>::is_neural_layer()) {
+                std::ostringstream os;
+                layer.store(os);
+                raw.push_back(os.str());
+            }
+        });
+
+        std::vector<std::string> records(raw.size());
+
+        dll::scheduler().parallel_for(raw.size(), [&](size_t r) {
+            records[r] = encode_compact_record<weight>(raw[r], encoding, compress);
+        });
+
+        return write_packed_model(file, records, sizeof(weight), compact_model_magic);
+    }
+
+    /*!
+     * \brief Load the network weights from the given compact model file.
+     *
+     * The records of the layers are verified and decoded in parallel
+     * before any layer is modified.
+     *
+     * \param file The path to the file
+     * \return true if the network was loaded, false otherwise
+     */
+    bool load_compact(const std::string& file) {
+        packed_model_file model(file, sizeof(weight), compact_model_magic);
+
+        if (!model.valid()) {
+            return false;
+        }
+
+        size_t neural_layers = 0;
+
+        for_each_layer([&neural_layers](auto& layer) {
+            if constexpr (decay_layer_traits<decltype(layer)>::is_neural_layer()) {
+                ++neural_layers;
+            }
+        });
+
+        if (model.records() != neural_layers) {
+            std::cerr << "ERROR: The compact model " << file << " does not match the network" << std::endl;
+            return false;
+        }
+
+        std::vector<std::string> raw(neural_layers);
+        std::vector<char> decoded(neural_layers, false);
+
+        dll::scheduler().parallel_for(neural_layers, [&](size_t r) {
+            auto& record = model.table[r];
+            decoded[r]   = decode_compact_record<weight>(static_cast<const char*>(model.mapping) + record.offset, record.length, raw[r]);
+        });
+
+        if (std::find(decoded.begin(), decoded.end(), false) != decoded.end()) {
+            std::cerr << "ERROR: Invalid compact model " << file << std::endl;
+            return false;
+        }
+
+        size_t r = 0;
+
+        for_each_layer([&raw, &r](auto& layer) {
+            if constexpr (decay_layer_traits<decltype(layer)>::is_neural_layer()) {
+                std::istringstream is(raw[r++]);
+                layer.load(is);
+            }
+        });
+
+        return true;
+    }
+
+    /*!
+     * \brief Enable the background checkpoints of the weights and of the
+     * training state during fine-tuning.
+     *
+     * A checkpoint is taken at the end of every epochs epochs, every
+     * batches batches inside the epochs and at the end of the training.
+     * Only the layers whose weights changed since the previous checkpoint
+     * are rewritten.
+     *
+     * \param prefix The prefix of the path of the files of the layers
+     * \param epochs The number of epochs between two checkpoints
+     * \param batches The number of batches between two checkpoints inside an epoch (0 to disable)
+     */
+    void enable_checkpoints(const std::string& prefix, size_t epochs = 1, size_t batches = 0) {
+        static_assert(!dbn_traits<this_type>::inference_only(), "inference_only networks cannot be trained");
+
+        checkpoints        = std::make_unique<checkpointer>(*this, prefix);
+        checkpoint_epochs  = std::max(size_t(1), epochs);
+        checkpoint_batches = batches;
+    }
+
+    /*!
+     * \brief Take a checkpoint of the current weights, written in the
+     * background. This has no effect if the checkpoints are not enabled.
+     */
+    void checkpoint() {
+        if (checkpoints) {
+            checkpoints->checkpoint();
+        }
+    }
+
+    /*!
+     * \brief Queue the given training state, written in the background
+     * after the weights. This has no effect if the checkpoints are not
+     * enabled.
+     */
+    void checkpoint_state(std::string state) {
+        if (checkpoints) {
+            checkpoints->checkpoint_state(std::move(state));
+        }
+    }
+
+    /*!
+     * \brief Wait for the background checkpoints to be written
+     * \return true if all the checkpoints were written, false otherwise
+     */
+    bool flush_checkpoints() {
+        return checkpoints ? checkpoints->flush() : true;
+    }
+
+    /*!
+     * \brief Load the network weights from the files of the checkpoints
+     * with the given prefix.
+     * \param prefix The prefix of the path of the files of the layers
+     * \return true if the network was loaded, false otherwise
+     */
+    bool load_checkpoint(const std::string& prefix) {
+        std::vector<std::string> records;
+
+        bool ok = true;
+
+        for_each_layer([&](auto& layer) {
+            if constexpr (decay_layer_traits<decltype(layer)>::is_neural_layer()) {
+                std::ifstream is(checkpointer::layer_path(prefix, records.size()), std::ifstream::binary);
+
+                std::ostringstream os;
+
+                if (is) {
+                    os << is.rdbuf();
+                } else {
+                    ok = false;
+                }
+
+                records.push_back(os.str());
+            }
+        });
+
+        if (!ok) {
+            std::cerr << "ERROR: Incomplete checkpoint " << prefix << std::endl;
+            return false;
+        }
+
+        size_t r = 0;
+
+        for_each_layer([&records, &r](auto& layer) {
+            if constexpr (decay_layer_traits<decltype(layer)>::is_neural_layer()) {
+                std::istringstream is(records[r++]);
+                layer.load(is);
+            }
+        });
+
+        return true;
+    }
+
+    /*!
+     * \brief Load the weights and the training state of the checkpoints
+     * with the given prefix. The next fine-tuning resumes the training
+     * where the checkpoint was taken: epoch, position in the epoch, state
+     * of the updater, learning rate and early stopping.
+     *
+     * \param prefix The prefix of the path of the files of the checkpoints
+     * \return true if the network was loaded, false otherwise
+     */
+    bool resume(const std::string& prefix) {
+        static_assert(!dbn_traits<this_type>::inference_only(), "inference_only networks cannot be trained");
+
+        std::ifstream is(checkpointer::state_path(prefix), std::ifstream::binary);
+
+        if (!is) {
+            std::cerr << "ERROR: No training state in checkpoint " << prefix << std::endl;
+            return false;
+        }
+
+        std::ostringstream os;
+        os << is.rdbuf();
+
+        if (!load_checkpoint(prefix)) {
+            return false;
+        }
+
+        resume_state = os.str();
+
+        return true;
+    }
+
+    /*!
+     * \brief Returns the Nth layer.
+     * \return The Nth layer
+     * \tparam N The index of the layer to return (from 0)
+     */
+    template <size_t N>
+    layer_type<N>& layer_get() {
+        return detail::layer_get<N>(tuples);
+    }
+
+    /*!
+     * \brief Returns the Nth layer.
+     * \return The Nth layer
+     * \tparam N The index of the layer to return (from 0)
+     */
+    template <size_t N>
+    constexpr const layer_type<N>& layer_get() const {
+        return detail::layer_get<N>(tuples);
+    }
+
+    /*!
+     * \brief Returns the number of leading layers of the network that are
+     * frozen. These layers are only forwarded in test mode during
+     * fine-tuning and are not backpropagated.
+     */
+    size_t frozen_prefix() const {
+        size_t prefix = 0;
+
+        while (prefix < layers && frozen[prefix]) {
+            ++prefix;
+        }
+
+        return prefix;
+    }
+
+    /*!
+     * \brief Returns the thread pool of the network
+     */
+    cpp::thread_pool<!dbn_traits<this_type>::is_serial()>& get_thread_pool() {
+        return pool;
+    }
+
+    /*!
+     * \brief Initialize the Nth layer  with the given args. The Nth layer must
+     * be a dynamic layer.
+     * \tparam N The index of the layer to return (from 0)
+     * \param args The arguments for initialization of the layer.
+     */
+    template <size_t N, typename... Args>
+    void init_layer(Args&&... args){
+        layer_get<N>().init_layer(std::forward<Args>(args)...);
+    }
+
+    template <size_t N>
+    size_t layer_input_size() const noexcept {
+        return dll::input_size(layer_get<N>());
+    }
+
+    template <size_t N>
+    size_t layer_output_size() const noexcept {
+        return dll::output_size(layer_get<N>());
+    }
+
+    /*!
+     * \brief Returns the input size expected by the network
+     * \return The input size of the network
+     */
+    size_t input_size() const noexcept {
+        return dll::input_size(layer_get<input_layer_n>());
+    }
+
+    /*!
+     * \brief Returns the output size generated by the network
+     * \return The output size of the network
+     */
+    size_t output_size() const noexcept {
+        return dll::output_size(layer_get<output_layer_n>());
+    }
+
+    size_t full_output_size() const noexcept {
+        size_t output = 0;
+        for_each_layer([&output](auto& layer) {
+            output += layer.output_size();
+        });
+        return output;
+    }
+
+    /*!
+     * \brief Indicates if training should save memory (true) or run as efficiently as possible (false).
+     *
+     * \return true if the training should save memory, false otherwise.
+     */
+    static constexpr bool batch_mode() noexcept {
+        return dbn_traits<this_type>::batch_mode();
+    }
+
+    /* pretrain */
+
+    /*!
+     * \brief Pretrain the network by training all layers in an unsupervised
+     * manner.
+     */
+    template <typename Generator, cpp_enable_iff(is_generator<Generator>)>
+    void pretrain(Generator& generator, size_t max_epochs) {
         static_assert(pretrain_possible, "Only networks with RBM can be pretrained");
 
         validate_pretraining();
@@ -670,7 +1356,11 @@ public:
                 out << "warning: batch_mode dbn does not support shuffle in layers (will be ignored)";
             }
 
-            pretrain_layer_batch<0>(generator, watcher, max_epochs);
+            if constexpr (dbn_traits<this_type>::pipeline_pretrain()) {
+                pretrain_pipeline(generator, watcher, max_epochs);
+            } else {
+                pretrain_layer_batch<0>(generator, watcher, max_epochs);
+            }
         } else {
             pretrain_layer<0>(generator, watcher, max_epochs);
         }
@@ -831,6 +1521,7 @@ public:
     template <typename Iterator, typename LabelIterator>
     void train_with_labels(Iterator&& first, Iterator&& last, LabelIterator&& lfirst, LabelIterator&& llast, size_t labels, size_t max_epochs) {
         static_assert(pretrain_possible, "Only networks with RBM can be pretrained");
+        static_assert(!dbn_traits<this_type>::inference_only(), "inference_only networks cannot be trained");
 
         dll::auto_timer timer("net:train:labels");
 
@@ -936,14 +1627,64 @@ public:
      */
     template <size_t LS, size_t L, typename Input>
     decltype(auto) test_forward_batch_impl(Input&& sample) const {
-        if constexpr (L != LS) {
-            decltype(auto) next = layer_get<L>().test_forward_batch(sample);
-            return test_forward_batch_impl<LS, L + 1>(next);
+        if constexpr (L != LS && layer_traits<layer_type<L>>::is_shape_layer() && !fuse_next<L + 1>::value) {
+            // The data is not changed, the next layer directly reads the
+            // sample (the fused layers are applied in place on a copy)
+            return test_forward_batch_impl<LS, L + 1>(layer_get<L>().view_batch(sample));
+        } else if constexpr (L != LS && last_step_next<L>()) {
+            // The recurrent layer directly outputs the last time step
+            auto next = forward_last_step<L, false>(sample);
+
+            if constexpr (L + 1 == LS) {
+                return next;
+            } else {
+                return test_forward_batch_impl<LS, L + 2>(next);
+            }
+        } else if constexpr (L != LS && conv_pool_next<L>()) {
+            // The pooling layer directly pools the convolution
+            auto next = batch_extend(sample, layer_get<L + 1>().template prepare_one_output<typename layer_type<L + 1>::input_one_t>());
+
+            conv_pool_forward<layer_type<L + 1>>(layer_get<L>(), next, sample);
+
+            if constexpr (L + 1 == LS) {
+                return next;
+            } else {
+                return test_forward_batch_impl<LS, L + 2>(next);
+            }
+        } else if constexpr (L != LS) {
+            decltype(auto) next = timed_test_forward_batch<L>(sample);
+
+            if constexpr (fuse_next<L + 1>::value) {
+                // The following element-wise layers are applied in place,
+                // in a single pass over the output of this layer
+                constexpr size_t E = fused_end<L + 1, LS>();
+
+                fused_forward<L + 1, E>(next);
+
+                if constexpr (E > LS) {
+                    return next;
+                } else {
+                    return test_forward_batch_impl<LS, E>(next);
+                }
+            } else {
+                return test_forward_batch_impl<LS, L + 1>(next);
+            }
         } else {
-            return layer_get<L>().test_forward_batch(sample);
+            return timed_test_forward_batch<L>(sample);
         }
     }
 
+    /*!
+     * \brief Return the test representation of the layer L for the given
+     * input batch, timed by the test timer of the layer.
+     */
+    template <size_t L, typename Input>
+    decltype(auto) timed_test_forward_batch(Input&& sample) const {
+        dll::auto_timer timer(layer_timers<L>::test());
+
+        return layer_get<L>().test_forward_batch(sample);
+    }
+
     /*
      * \brief Return the train representation for the given input batch.
      *
@@ -956,7 +1697,19 @@ public:
      */
     template <size_t LS, size_t L, typename Input>
     decltype(auto) train_forward_batch_impl(Input&& sample) {
-        if constexpr (L != LS) {
+        if constexpr (L != LS && layer_traits<layer_type<L>>::is_shape_layer()) {
+            // The data is not changed, the next layer directly reads the sample
+            return train_forward_batch_impl<LS, L + 1>(layer_get<L>().view_batch(sample));
+        } else if constexpr (L != LS && last_step_next<L>()) {
+            // The recurrent layer directly outputs the last time step
+            auto next = forward_last_step<L, true>(sample);
+
+            if constexpr (L + 1 == LS) {
+                return next;
+            } else {
+                return train_forward_batch_impl<LS, L + 2>(next);
+            }
+        } else if constexpr (L != LS) {
             decltype(auto) next = layer_get<L>().train_forward_batch(sample);
             return train_forward_batch_impl<LS, L + 1>(next);
         } else {
@@ -1120,7 +1873,9 @@ public:
 
         auto next = prepare_many_ready_output(layer, samples[0], samples.size());
 
-        layer.test_forward_many(next, samples);
+        parallel_forward_many(samples.size(), [&](size_t i) {
+            layer.test_forward_one(next[i], samples[i]);
+        });
 
         if constexpr (L != LS) {
             return test_forward_many_impl<LS, L + 1>(next);
@@ -1199,6 +1954,36 @@ public:
         return test_forward_many_impl<LS, L>(samples);
     }
 
+    /*!
+     * \brief Apply the given functor to the samples [0, n), split in chunks
+     * of batch_size samples over the thread pool of the network.
+     *
+     * The samples are forwarded serially if one of the layers needs a
+     * scratch state for its test forward pass.
+     *
+     * \param n The number of samples
+     * \param functor The functor forwarding the ith sample
+     */
+    template <typename Functor>
+    void parallel_forward_many(size_t n, Functor&& functor) const {
+        if constexpr (session_detail::is_stateless<this_type>(std::make_index_sequence<layers>())) {
+            const size_t chunks = (n + batch_size - 1) / batch_size;
+
+            cpp::maybe_parallel_foreach_n(pool, 0, chunks, [&](size_t c) {
+                // Each chunk is forwarded on its own thread
+                SERIAL_SECTION {
+                    for (size_t i = c * batch_size; i < std::min(n, (c + 1) * batch_size); ++i) {
+                        functor(i);
+                    }
+                }
+            });
+        } else {
+            for (size_t i = 0; i < n; ++i) {
+                functor(i);
+            }
+        }
+    }
+
     // Forward a collection of samples (iterators) at a time
     // This is not as fast as it could be, far from it, but supports
     // larger range of input. The rationale being that time should
@@ -1222,9 +2007,17 @@ public:
         auto n    = std::distance(first, last);
         auto next = prepare_many_ready_output(layer, *first, n);
 
-        cpp::foreach_i(first, last, [&](auto& sample, size_t i) {
-            layer.test_forward_one(next[i], sample);
-        });
+        using category = typename std::iterator_traits<Iterator>::iterator_category;
+
+        if constexpr (std::is_base_of_v<std::random_access_iterator_tag, category>) {
+            parallel_forward_many(n, [&](size_t i) {
+                layer.test_forward_one(next[i], first[i]);
+            });
+        } else {
+            cpp::foreach_i(first, last, [&](auto& sample, size_t i) {
+                layer.test_forward_one(next[i], sample);
+            });
+        }
 
         if constexpr (L != LS) {
             return test_forward_many_impl<LS, L + 1>(next);
@@ -1319,12 +2112,47 @@ public:
      */
     template<typename Input>
     void save_features(const Input& sample, const std::string& file, format f = format::DLL) const {
-        cpp_assert(f == format::DLL, "Only DLL format is supported for now");
-
         decltype(auto) probs = features(sample);
 
-        if (f == format::DLL) {
-            export_features_dll(probs, file);
+        export_features(probs, file, f);
+    }
+
+    /*!
+     * \brief Save the features generated for the given samples in the given file.
+     *
+     * The samples are forwarded by blocks and the features of each block
+     * are written at once. In the DLL format, the features of each sample
+     * are written on one line. In the BINARY and NPY formats, the features
+     * are written as float values.
+     *
+     * \param first Iterator to the first sample
+     * \param last Iterator to the past-the-end sample
+     * \param file The output file
+     * \param f The format of the exported features
+     */
+    template <typename Iterator>
+    void save_features(Iterator first, Iterator last, const std::string& file, format f = format::DLL) const {
+        // The number of samples forwarded at once
+        constexpr size_t block = 1024;
+
+        features_writer<> writer(file, f);
+
+        while (first != last) {
+            auto block_last = first;
+            size_t n        = 0;
+
+            while (block_last != last && n < block) {
+                ++block_last;
+                ++n;
+            }
+
+            auto probs = forward_many(first, block_last);
+
+            for (auto& sample_probs : probs) {
+                writer.write(sample_probs);
+            }
+
+            first = block_last;
         }
     }
 
@@ -1348,6 +2176,34 @@ public:
         return trainer;
     }
 
+    /*!
+     * \brief Train the network with the given generator.
+     *
+     * This is the entry point of all the fine-tuning functions. It is
+     * defined out of the class (in dbn_train_impl.hpp) so that the
+     * complete training of a network can be explicitly instantiated in a
+     * single translation unit (see dll/instantiate.hpp).
+     *
+     * \param generator A generator for data and labels
+     * \param max_epochs The maximum number of epochs to train the network for.
+     *
+     * \return The final error or loss
+     */
+    template <typename Generator>
+    weight train_generator(Generator& generator, size_t max_epochs);
+
+    /*!
+     * \brief Train the network with the given generator, with validation.
+     *
+     * \param generator A generator for training data and labels
+     * \param val_generator A generator for validation data and labels
+     * \param max_epochs The maximum number of epochs to train the network for.
+     *
+     * \return The final error or loss
+     */
+    template <typename Generator, typename ValGenerator>
+    weight train_generator(Generator& generator, ValGenerator& val_generator, size_t max_epochs);
+
     // Fine-tune for classification
 
     /*!
@@ -1364,8 +2220,7 @@ public:
 
         validate_generator(generator);
 
-        dll::dbn_trainer<this_type> trainer;
-        return trainer.train(*this, generator, max_epochs);
+        return train_generator(generator, max_epochs);
     }
 
     /*!
@@ -1384,10 +2239,49 @@ public:
         validate_generator(train_generator);
         validate_generator(val_generator);
 
-        dll::dbn_trainer<this_type> trainer;
-        return trainer.train(*this, train_generator, val_generator, max_epochs);
+        return this->train_generator(train_generator, val_generator, max_epochs);
     }
 
+    /*!
+     * \brief Fine tune the network for classification on the soft targets
+     * of a teacher network (knowledge distillation).
+     *
+     * \param teacher The teacher network
+     * \param generator A generator for data and labels
+     * \param max_epochs The maximum number of epochs to train the network for.
+     * \param options The options of the distillation
+     *
+     * \return The final classification error
+     */
+    template <typename Teacher, typename Generator>
+    weight fine_tune_distill(const Teacher& teacher, Generator& generator, size_t max_epochs, const distill_options& options = distill_options());
+
+    /*!
+     * \brief Fine tune the network for classification on an unbounded
+     * stream of samples, until the stream is closed.
+     *
+     * \param stream The stream of training data and labels
+     * \param options The options of the streaming fine-tuning
+     *
+     * \return The running classification error on the stream
+     */
+    template <typename Stream>
+    weight fine_tune_stream(Stream& stream, const stream_options& options = stream_options());
+
+    /*!
+     * \brief Fine tune the network for classification on an unbounded
+     * stream of samples, with periodic asynchronous evaluations on the
+     * validation set.
+     *
+     * \param stream The stream of training data and labels
+     * \param val_generator A generator for validation data and labels
+     * \param options The options of the streaming fine-tuning
+     *
+     * \return The running classification error on the stream
+     */
+    template <typename Stream, typename ValGenerator>
+    weight fine_tune_stream(Stream& stream, ValGenerator& val_generator, const stream_options& options = stream_options());
+
     /*!
      * \brief Fine tune the network for classifcation.
      * \param training_data A container containing all the samples
@@ -1445,8 +2339,7 @@ public:
 
         cpp_assert(dll::input_size(layer_get<0>()) == dll::output_size(layer_get<layers - 1>()), "The network is not build as an autoencoder");
 
-        dll::dbn_trainer<this_type> trainer;
-        return trainer.train(*this, generator, max_epochs);
+        return train_generator(generator, max_epochs);
     }
 
     /*!
@@ -1501,8 +2394,7 @@ public:
 
         validate_generator(generator);
 
-        dll::dbn_trainer<this_type> trainer;
-        return trainer.train(*this, generator, max_epochs);
+        return train_generator(generator, max_epochs);
     }
 
     /*!
@@ -1918,7 +2810,8 @@ public:
             dll::auto_timer timer("net:compute_loss:BCE");
 
             // Avoid Nan in log(out) or log(1-out)
-            auto out = etl::force_temporary(etl::clip(output, 0.001, 0.999));
+            temporary_scope<weight> scope;
+            auto out = scope.value(etl::clip(output, 0.001, 0.999));
 
             if (cpp_unlikely(!full_batch)) {
                 auto sout = slice(out, 0, n);
@@ -2187,20 +3080,7 @@ public:
     bool svm_grid_search(const Samples& training_data, const Labels& labels, size_t n_fold = 5, const svm::rbf_grid& g = svm::rbf_grid()) {
         make_problem(training_data, labels, dbn_traits<this_type>::scale());
 
-        //Make libsvm quiet
-        svm::make_quiet();
-
-        auto parameters = default_svm_parameters();
-
-        //Make sure parameters are not messed up
-        if (!svm::check(problem, parameters)) {
-            return false;
-        }
-
-        //Perform a grid-search
-        svm::rbf_grid_search(problem, parameters, n_fold, g);
-
-        return true;
+        return svm_grid_search_problem(n_fold, g);
     }
 
     template <typename It, typename LIt>
@@ -2210,6 +3090,28 @@ public:
             std::forward<LIt>(lfirst), std::forward<LIt>(llast),
             dbn_traits<this_type>::scale());
 
+        return svm_grid_search_problem(n_fold, g);
+    }
+
+    /*!
+     * \brief Perform a grid search of the parameters of the SVM on the
+     * problem built by the last SVM training or grid search, without
+     * forwarding the samples again.
+     *
+     * The grid points are cross-validated concurrently on the thread pool
+     * of the network.
+     *
+     * \param n_fold The number of folds of the cross-validation
+     * \param g The grid
+     *
+     * \return true if the grid search was performed, false otherwise
+     */
+    bool svm_grid_search_problem(size_t n_fold = 5, const svm::rbf_grid& g = svm::rbf_grid()) {
+        if (!svm_problem_ready) {
+            std::cerr << "ERROR: No SVM problem, svm_train or svm_grid_search must be called first" << std::endl;
+            return false;
+        }
+
         //Make libsvm quiet
         svm::make_quiet();
 
@@ -2221,7 +3123,7 @@ public:
         }
 
         //Perform a grid-search
-        svm::rbf_grid_search(problem, parameters, n_fold, g);
+        svm_parallel_grid_search(problem, parameters, n_fold, g, pool);
 
         return true;
     }
@@ -2232,6 +3134,45 @@ public:
         return svm::predict(svm_model, features);
     }
 
+    /*!
+     * \brief Predict the labels of a range of samples with the SVM.
+     *
+     * The features are extracted and classified in batch-sized chunks
+     * over the thread pool of the network.
+     *
+     * \param first The beginning of the range of samples
+     * \param last The end of the range of samples
+     *
+     * \return The predicted label of each sample
+     */
+    template <typename Iterator>
+    std::vector<double> svm_predict(Iterator first, Iterator last) {
+        std::vector<const safe_value_t<Iterator>*> samples;
+
+        std::for_each(first, last, [&samples](auto& sample) {
+            samples.push_back(&sample);
+        });
+
+        std::vector<double> labels(samples.size());
+
+        if constexpr (dbn_traits<this_type>::concatenate()) {
+            etl::dyn_matrix<weight, 2> features;
+
+            set_full_activation_probabilities(features, samples);
+
+            cpp::maybe_parallel_foreach_n(pool, 0, samples.size(), [&](size_t i) {
+                labels[i] = svm::predict(svm_model, features(i));
+            });
+        } else {
+            parallel_forward_many(samples.size(), [&](size_t i) {
+                auto features = get_final_activation_probabilities(*samples[i]);
+                labels[i]     = svm::predict(svm_model, features);
+            });
+        }
+
+        return labels;
+    }
+
 #endif //DLL_SVM_SUPPORT
 
 private:
@@ -2243,6 +3184,104 @@ private:
     template <size_t I>
     struct train_next<I, std::enable_if_t<(I == layers - 1)>> : cpp::bool_constant<layer_traits<layer_type<I>>::pretrain_last()> {};
 
+    template <size_t I, typename Enable = void>
+    struct fuse_next : std::false_type {};
+
+    template <size_t I>
+    struct fuse_next<I, std::enable_if_t<(I < layers)>> : cpp::bool_constant<layer_traits<layer_type<I>>::is_element_wise_layer()> {};
+
+    /*!
+     * \brief Indicates if the layer I is a recurrent layer followed by a
+     * recurrent_last layer, which can directly output the last time step
+     */
+    template <size_t I>
+    static constexpr bool last_step_next() {
+        return rnn_last_step<this_type, layer_type<I>, I>();
+    }
+
+    /*!
+     * \brief Indicates if the convolutional layer I is followed by a
+     * pooling layer pooling its output on the fly
+     */
+    template <size_t I>
+    static constexpr bool conv_pool_next() {
+        if constexpr (I + 1 < layers) {
+            return conv_pool_fusion<layer_type<I>, layer_type<I + 1>>();
+        } else {
+            return false;
+        }
+    }
+
+    /*!
+     * \brief Forward the given batch through the recurrent layer I into a
+     * batch of its last time step, which is the output of the
+     * recurrent_last layer I + 1
+     */
+    template <size_t I, bool Train, typename Input>
+    auto forward_last_step(const Input& sample) const {
+        using last_t = layer_type<I + 1>;
+
+        auto next = batch_extend(sample, layer_get<I + 1>().template prepare_one_output<typename last_t::input_one_t>());
+
+        if constexpr (Train) {
+            layer_get<I>().train_forward_batch(next, sample);
+        } else {
+            layer_get<I>().test_forward_batch(next, sample);
+        }
+
+        return next;
+    }
+
+    /*!
+     * \brief Returns the index of the first layer after I (included) that
+     * cannot be fused, or LS + 1 if all the layers up to LS can be fused
+     */
+    template <size_t I, size_t LS>
+    static constexpr size_t fused_end() {
+        if constexpr (I <= LS && fuse_next<I>::value) {
+            return fused_end<I + 1, LS>();
+        } else {
+            return I;
+        }
+    }
+
+    /*!
+     * \brief Apply the element-wise layers [I, E) to a single value
+     */
+    template <size_t I, size_t E, typename T>
+    static T fused_apply_one(T x) {
+        if constexpr (I < E) {
+            return fused_apply_one<I + 1, E>(layer_type<I>::apply_one(x));
+        } else {
+            return x;
+        }
+    }
+
+    /*!
+     * \brief Apply the element-wise layers [I, E) in place to the given
+     * batch, in a single pass, without materializing their outputs.
+     */
+    template <size_t I, size_t E, typename Output>
+    static void fused_forward(Output& output) {
+        dll::auto_timer timer("net:forward:fused");
+
+        if constexpr (etl::all_dma<Output>) {
+            output.ensure_cpu_up_to_date();
+
+            auto* ptr = output.memory_start();
+
+            for (size_t i = 0; i < etl::size(output); ++i) {
+                ptr[i] = fused_apply_one<I, E>(ptr[i]);
+            }
+
+            output.invalidate_gpu();
+        } else {
+            for (auto& value : output) {
+                value = fused_apply_one<I, E>(value);
+            }
+        }
+    }
+
     template <size_t I, typename Enable = void>
     struct inline_next : std::false_type {};
 
@@ -2375,7 +3414,42 @@ private:
                     (generator, max_epochs);
             }
 
-            if constexpr (train_next<I + 1>::value) {
+            if constexpr (train_next<I + 1>::value && Generator::desc::Noise) {
+                // Reset correctly the generator
+                generator.reset();
+                generator.set_test();
+
+                // The noise is applied on the fly by the generators, only
+                // the clean input of the next layer needs to be kept
+                auto one_c = prepare_one_ready_output(layer, generator.label_batch()(0));
+
+                // The same sample as input and label makes the next generator
+                // an auto-encoder of its inputs, without any label cache
+                auto next_generator = prepare_generator(
+                    one_c, one_c,
+                    generator.size(), output_size(),
+                    get_rbm_denoising_ingenerator_inner_desc());
+
+                next_generator->set_safe();
+
+                size_t i = 0;
+                while (generator.has_next_batch()) {
+                    auto next_batch_c = layer.train_forward_batch(generator.label_batch());
+
+                    next_generator->set_data_batch(i, next_batch_c);
+
+                    i += etl::dim<0>(next_batch_c);
+
+                    generator.next_batch();
+                }
+
+                next_generator->finalize_prepared_data();
+
+                // Release the memory if possible
+                generator.clear();
+
+                pretrain_layer_denoising<I + 1>(*next_generator, watcher, max_epochs);
+            } else if constexpr (train_next<I + 1>::value) {
                 // Reset correctly the generator
                 generator.reset();
                 generator.set_test();
@@ -2460,59 +3534,281 @@ private:
     //Normal version
     template <size_t I, typename Generator, cpp_enable_iff((I > 0 && I < layers && !batch_layer_ignore<I>::value))>
     void pretrain_layer_batch(Generator& generator, watcher_t& watcher, size_t max_epochs) {
-        using layer_t = layer_type<I>;
-
         decltype(auto) rbm = layer_get<I>();
 
         watcher.pretrain_layer(*this, I, rbm, 0);
 
-        using rbm_trainer_t = dll::rbm_trainer<layer_t, !watcher_t::ignore_sub, dbn_detail::rbm_watcher_t<watcher_t>>;
+        // The previous layers are frozen and applied on the fly to the
+        // batches of the generator
+        auto next_generator = make_forward_generator<I - 1>(*this, generator);
 
-        //Initialize the RBM trainer
-        rbm_trainer_t r_trainer;
+        rbm.template train<
+                !watcher_t::ignore_sub,               //Enable the RBM Watcher or not
+                dbn_detail::rbm_watcher_t<watcher_t>> //Replace the RBM watcher if not void
+            (next_generator, max_epochs);
 
-        //Init the RBM and training parameters
-        r_trainer.init_training(rbm, generator);
+        //train the next layer, if any
+        pretrain_layer_batch<I + 1>(generator, watcher, max_epochs);
+    }
 
-        //Get the specific trainer (CD)
-        auto trainer = rbm_trainer_t::get_trainer(rbm);
+    //Stop template recursion
+    template <size_t I, typename Generator, cpp_enable_iff(I == layers)>
+    void pretrain_layer_batch(Generator&, watcher_t&, size_t) {}
 
-        //Train for max_epochs epoch
-        for (size_t epoch = 0; epoch < max_epochs; ++epoch) {
-            size_t big_batch = 0;
+    /* Pipelined pretraining */
 
-            //Create a new context for this epoch
-            rbm_training_context context;
+    /*!
+     * \brief The state of the training of one layer in pipelined pretraining
+     */
+    template <size_t I>
+    struct pipeline_stage {
+        using rbm_trainer_t = dll::rbm_trainer<layer_type<I>, !watcher_t::ignore_sub, dbn_detail::rbm_watcher_t<watcher_t>>; ///< The type of the RBM trainer
+
+        rbm_trainer_t r_trainer;                        ///< The RBM trainer
+        typename rbm_trainer_t::trainer_type trainer;   ///< The specific trainer (CD)
+        rbm_training_context context;                   ///< The context of the current epoch
+
+        size_t start = 0;     ///< The first round of the training of this layer
+        size_t epoch = 0;     ///< The current epoch of the layer
+        bool done    = false; ///< Indicates if the training of the layer is over
+
+        /*!
+         * \brief Indicates if the layer is trained during the given round
+         */
+        bool active(size_t round) const {
+            return !done && round >= start;
+        }
+    };
 
-            r_trainer.init_epoch();
+    /*!
+     * \brief Placeholder stage for the layers that are not pretrained
+     */
+    struct pipeline_no_stage {
+        /*!
+         * \brief Indicates if the layer is trained during the given round
+         */
+        bool active(size_t /*round*/) const {
+            return false;
+        }
+    };
+
+    template <typename Sequence>
+    struct pipeline_stages;
+
+    /*!
+     * \brief The tuple of the stages of all the layers
+     */
+    template <size_t... I>
+    struct pipeline_stages<std::index_sequence<I...>> {
+        using type = std::tuple<std::conditional_t<batch_layer_ignore<I>::value, pipeline_no_stage, pipeline_stage<I>>...>; ///< The type of the tuple
+    };
+
+    /*!
+     * \brief Pretrain all the layers concurrently.
+     *
+     * The data is iterated once per round. For each batch, the inputs of
+     * every active layer are first computed through the previous layers
+     * and then the active layers are trained concurrently on the thread
+     * pool of the network. Since the forward propagation through a layer
+     * is always done before its training starts on the batch, the layers
+     * are never read and updated at the same time.
+     */
+    template <typename Generator>
+    void pretrain_pipeline(Generator& generator, watcher_t& watcher, size_t max_epochs) {
+        using stages_t = typename pipeline_stages<std::make_index_sequence<layers>>::type;
+
+        if (!max_epochs) {
+            return;
+        }
+
+        auto stages = std::make_unique<stages_t>();
+
+        // Each layer starts pipeline_delay rounds after the previous one
+        size_t start = 0;
+        cpp::for_each(*stages, [&start, this](auto& stage) {
+            if constexpr (!std::is_same<std::decay_t<decltype(stage)>, pipeline_no_stage>::value) {
+                stage.start = start;
+                start += pipeline_delay;
+            }
+        });
+
+        for (size_t round = 0; pipeline_running(*stages); ++round) {
+            pipeline_init_round<0>(*stages, generator, watcher, round);
 
             generator.reset();
             generator.set_train();
 
             while (generator.has_next_batch()) {
-                auto next_batch = forward_batch<I - 1>(generator.data_batch());
+                pipeline_batch<0>(*stages, generator.data_batch(), round);
+
+                generator.next_batch();
+            }
 
-                r_trainer.train_batch(next_batch, next_batch, trainer, context, rbm);
+            pipeline_finalize_round<0>(*stages, round, max_epochs);
+        }
+    }
 
-                if (dbn_traits<this_type>::is_verbose()) {
-                    watcher.pretraining_batch(*this, big_batch);
+    /*!
+     * \brief Indicates if some layers are still being trained
+     */
+    template <typename Stages>
+    static bool pipeline_running(Stages& stages) {
+        bool running = false;
+
+        cpp::for_each(stages, [&running](auto& stage) {
+            if constexpr (!std::is_same<std::decay_t<decltype(stage)>, pipeline_no_stage>::value) {
+                running |= !stage.done;
+            }
+        });
+
+        return running;
+    }
+
+    /*!
+     * \brief Returns the index of the last layer that is trained during the
+     * given round
+     */
+    template <typename Stages>
+    static size_t pipeline_last_active(Stages& stages, size_t round) {
+        size_t last = 0;
+        size_t i    = 0;
+
+        cpp::for_each(stages, [&last, &i, round](auto& stage) {
+            if (stage.active(round)) {
+                last = i;
+            }
+
+            ++i;
+        });
+
+        return last;
+    }
+
+    /*!
+     * \brief Start the training of the layers starting at this round and
+     * start a new epoch for all the active layers
+     */
+    template <size_t I, typename Stages, typename Generator>
+    void pipeline_init_round(Stages& stages, Generator& generator, watcher_t& watcher, size_t round) {
+        if constexpr (I < layers) {
+            auto& stage = std::get<I>(stages);
+
+            if constexpr (!batch_layer_ignore<I>::value) {
+                decltype(auto) rbm = layer_get<I>();
+
+                if (stage.active(round) && round == stage.start) {
+                    watcher.pretrain_layer(*this, I, rbm, 0);
+
+                    stage.r_trainer.init_training(rbm, generator);
+
+                    if constexpr (rbm_layer_traits<layer_type<I>>::init_weights()) {
+                        if constexpr (I == 0) {
+                            rbm.init_weights(generator);
+                        } else {
+                            auto next_generator = make_forward_generator<I - 1>(*this, generator);
+                            rbm.init_weights(next_generator);
+                        }
+                    }
+
+                    stage.trainer = stage.r_trainer.get_trainer(rbm);
+                    stage.trainer->init_training();
                 }
 
-                generator.next_batch();
+                if (stage.active(round)) {
+                    stage.context = rbm_training_context();
+                    stage.context.trainer_memory = memory_bytes(stage.trainer);
+                    stage.r_trainer.init_epoch();
+                }
             }
 
-            r_trainer.finalize_epoch(epoch, context, rbm);
+            pipeline_init_round<I + 1>(stages, generator, watcher, round);
         }
+    }
 
-        r_trainer.finalize_training(rbm);
+    /*!
+     * \brief Update the ranges of the inputs of the layers [L, layers)
+     * with the given batch.
+     */
+    template <size_t L, typename Input>
+    void quantize_calibrate(const Input& input, std::array<weight, layers>& ranges) const {
+        ranges[L] = std::max(ranges[L], weight(etl::max(etl::abs(input))));
 
-        //train the next layer, if any
-        pretrain_layer_batch<I + 1>(generator, watcher, max_epochs);
+        if constexpr (L + 1 < layers) {
+            auto next = layer_get<L>().test_forward_batch(input);
+
+            quantize_calibrate<L + 1>(next, ranges);
+        }
     }
 
-    //Stop template recursion
-    template <size_t I, typename Generator, cpp_enable_iff(I == layers)>
-    void pretrain_layer_batch(Generator&, watcher_t&, size_t) {}
+    /*!
+     * \brief Train the active layers on one batch.
+     *
+     * The input of the next layer is computed before the training of this
+     * layer is started on the thread pool. The pool is only waited for at
+     * the end of the recursion, while the inputs are still alive.
+     */
+    template <size_t I, typename Stages, typename Input>
+    void pipeline_batch(Stages& stages, const Input& input, size_t round) {
+        auto& stage = std::get<I>(stages);
+
+        auto& pool = get_thread_pool();
+
+        auto train = [&] {
+            if constexpr (!batch_layer_ignore<I>::value) {
+                if (stage.active(round)) {
+                    pool.do_task([this, &stage, &input] {
+                        // The layers are each trained on their own thread
+                        SERIAL_SECTION {
+                            stage.r_trainer.train_batch(input, input, stage.trainer, stage.context, this->template layer_get<I>());
+                        }
+                    });
+                }
+            }
+        };
+
+        if constexpr (I + 1 < layers) {
+            if (I < pipeline_last_active(stages, round)) {
+                auto next = layer_get<I>().test_forward_batch(input);
+
+                train();
+
+                pipeline_batch<I + 1>(stages, next, round);
+
+                return;
+            }
+        }
+
+        train();
+
+        pool.wait();
+    }
+
+    /*!
+     * \brief Finalize the epoch of all the active layers and decide if
+     * their training is over
+     */
+    template <size_t I, typename Stages>
+    void pipeline_finalize_round(Stages& stages, size_t round, size_t max_epochs) {
+        if constexpr (I < layers) {
+            if constexpr (!batch_layer_ignore<I>::value) {
+                auto& stage = std::get<I>(stages);
+
+                decltype(auto) rbm = layer_get<I>();
+
+                if (stage.active(round)) {
+                    stage.r_trainer.finalize_epoch(stage.epoch, stage.context, rbm);
+
+                    if (stage.r_trainer.early_stop(stage.epoch, rbm) || ++stage.epoch == max_epochs) {
+                        stage.r_trainer.finalize_training(rbm);
+                        stage.trainer.reset();
+                        stage.done = true;
+                    }
+                }
+            }
+
+            pipeline_finalize_round<I + 1>(stages, round, max_epochs);
+        }
+    }
 
     /* Pretrain layer denoising batch  */
 
@@ -2568,6 +3864,7 @@ private:
 
             //Create a new context for this epoch
             rbm_training_context context;
+            context.trainer_memory = memory_bytes(trainer);
 
             r_trainer.init_epoch();
 
@@ -2714,6 +4011,183 @@ private:
         }
     }
 
+    /*!
+     * \brief Add the throughput rows of the layers of the network
+     */
+    template <size_t... I>
+    void throughput_rows(const std::vector<timer_t>& timers, std::vector<std::array<std::string, 8>>& rows, std::index_sequence<I...> /*seq*/) const {
+        (throughput_row<I>(timers, rows), ...);
+    }
+
+    /*!
+     * \brief Add the throughput row of the layer I
+     */
+    template <size_t I>
+    void throughput_row(const std::vector<timer_t>& timers, std::vector<std::array<std::string, 8>>& rows) const {
+        auto& layer = layer_get<I>();
+
+        using layer_t = layer_type<I>;
+
+        if constexpr (!decay_layer_traits<layer_t>::base_traits::is_multi) {
+            auto find = [&timers](const char* name) -> timer_t {
+                for (auto& timer : timers) {
+                    if (timer.name == name) {
+                        return timer;
+                    }
+                }
+
+                return {name, 0, 0};
+            };
+
+            size_t parameters = 0;
+
+            if constexpr (decay_layer_traits<layer_t>::is_neural_layer()) {
+                parameters = layer.parameters();
+            }
+
+            const double io = double(layer.input_size() + layer.output_size());
+
+            auto forward  = find(layer_timers<I>::forward());
+            auto backward = find(layer_timers<I>::backward());
+
+            // Each call of the timers is one batch
+            const double forward_samples  = double(forward.count) * batch_size;
+            const double backward_samples = double(backward.count) * batch_size;
+
+            // The backward pass reads and writes the errors and the gradients
+            const double forward_bytes  = sizeof(weight) * (forward_samples * io + forward.count * double(parameters));
+            const double backward_bytes = sizeof(weight) * (2.0 * backward_samples * io + 2.0 * backward.count * double(parameters));
+
+            auto rate = [](double v, size_t duration) {
+                return duration ? to_string_precision(v / duration, 4) : std::string("-");
+            };
+
+            rows.emplace_back();
+            auto& row = rows.back();
+
+            row[0] = std::to_string(I);
+            row[1] = layer.to_short_string("");
+            row[2] = duration_str(forward.duration);
+            row[3] = rate(forward_samples * layer.forward_flops(), forward.duration);
+            row[4] = rate(forward_bytes, forward.duration);
+            row[5] = duration_str(backward.duration);
+            row[6] = rate(backward_samples * layer.backward_flops(), backward.duration);
+            row[7] = rate(backward_bytes, backward.duration);
+        }
+    }
+
+    /*!
+     * \brief Compute the activation probabilities of the given samples, in
+     * parallel over the thread pool
+     * \param result The container of activation probabilities
+     * \param samples Pointers to the samples
+     */
+    template <typename Samples, typename Input>
+    void set_activation_probabilities(Samples& result, const std::vector<const Input*>& samples) const {
+        result.resize(samples.size());
+
+        parallel_forward_many(samples.size(), [&](size_t i) {
+            if constexpr (dbn_traits<this_type>::concatenate()) {
+                result[i] = etl::dyn_vector<weight>(full_output_size());
+                full_activation_probabilities(*samples[i], result[i]);
+            } else {
+                result[i] = forward_one(*samples[i]);
+            }
+        });
+    }
+
+    /*!
+     * \brief Write the outputs of the layers [L, layers) for the given
+     * batch in the features, from the column offset of the rows [first,
+     * first + n)
+     */
+    template <size_t L, typename Input>
+    void full_activation_batch(const Input& input, etl::dyn_matrix<weight, 2>& features, size_t first, size_t n, size_t offset) const {
+        auto next = layer_get<L>().test_forward_batch(input);
+
+        const size_t s = etl::size(next) / etl::dim<0>(next);
+        const size_t f = etl::dim<1>(features);
+
+        next.ensure_cpu_up_to_date();
+
+        for (size_t i = 0; i < n; ++i) {
+            std::copy_n(next.memory_start() + i * s, s, features.memory_start() + (first + i) * f + offset);
+        }
+
+        if constexpr (L + 1 < layers) {
+            full_activation_batch<L + 1>(next, features, first, n, offset + s);
+        }
+    }
+
+    /*!
+     * \brief Compute the concatenated activation probabilities of the given
+     * samples in a single contiguous matrix [N, F].
+     *
+     * The samples are forwarded in batches of batch_size samples (the last
+     * one zero-padded), spread over the thread pool of the network unless a
+     * layer needs a scratch state for its test forward pass. The outputs of
+     * each layer are written directly in their columns of the features.
+     *
+     * \param features The matrix of features
+     * \param samples Pointers to the samples
+     */
+    template <typename Input>
+    void set_full_activation_probabilities(etl::dyn_matrix<weight, 2>& features, const std::vector<const Input*>& samples) const {
+        using batch_t = etl::dyn_matrix<weight, etl::decay_traits<Input>::dimensions() + 1>;
+
+        const size_t n      = samples.size();
+        const size_t chunks = (n + batch_size - 1) / batch_size;
+
+        features = etl::dyn_matrix<weight, 2>(n, full_output_size());
+
+        auto chunk = [&](size_t c) {
+            const size_t first = c * batch_size;
+            const size_t last  = std::min(n, first + batch_size);
+
+            auto batch = dbn_detail::make_batch<batch_t>(batch_size, *samples[first]);
+
+            if (last - first < batch_size) {
+                batch = weight(0);
+            }
+
+            for (size_t i = first; i < last; ++i) {
+                batch(i - first) = *samples[i];
+            }
+
+            full_activation_batch<0>(batch, features, first, last - first, 0);
+        };
+
+        if constexpr (session_detail::is_stateless<this_type>(std::make_index_sequence<layers>())) {
+            cpp::maybe_parallel_foreach_n(pool, 0, chunks, [&](size_t c) {
+                // Each batch is forwarded on its own thread
+                SERIAL_SECTION {
+                    chunk(c);
+                }
+            });
+        } else {
+            for (size_t c = 0; c < chunks; ++c) {
+                chunk(c);
+            }
+        }
+
+        features.invalidate_gpu();
+    }
+
+    /*!
+     * \brief Returns views of the rows of the given features, to build the
+     * SVM problem without copying the features
+     */
+    static auto feature_rows(etl::dyn_matrix<weight, 2>& features) {
+        std::vector<decltype(features(0))> rows;
+        rows.reserve(etl::dim<0>(features));
+
+        for (size_t i = 0; i < etl::dim<0>(features); ++i) {
+            rows.push_back(features(i));
+        }
+
+        return rows;
+    }
+
     template <typename Input>
     using svm_sample_t = std::conditional_t<
         dbn_traits<this_type>::concatenate(),
@@ -2725,15 +4199,35 @@ private:
 
     template <typename Samples, typename Labels>
     void make_problem(const Samples& training_data, const Labels& labels, bool scale = false) {
-        svm_samples_t<safe_value_t<Samples>> svm_samples;
+        static_assert(!dbn_traits<this_type>::inference_only(), "inference_only networks cannot be trained");
+
+        std::vector<const safe_value_t<Samples>*> samples;
 
-        //Get all the activation probabilities
         for (auto& sample : training_data) {
-            add_activation_probabilities(svm_samples, sample);
+            samples.push_back(&sample);
+        }
+
+        if constexpr (dbn_traits<this_type>::concatenate()) {
+            etl::dyn_matrix<weight, 2> features;
+
+            //Get all the activation probabilities, in a single matrix
+            set_full_activation_probabilities(features, samples);
+
+            auto rows = feature_rows(features);
+
+            //static_cast ensure using the correct overload
+            problem = svm::make_problem(labels, static_cast<const decltype(rows)&>(rows), scale);
+        } else {
+            svm_samples_t<safe_value_t<Samples>> svm_samples;
+
+            //Get all the activation probabilities
+            set_activation_probabilities(svm_samples, samples);
+
+            //static_cast ensure using the correct overload
+            problem = svm::make_problem(labels, static_cast<const svm_samples_t<safe_value_t<Samples>>&>(svm_samples), scale);
         }
 
-        //static_cast ensure using the correct overload
-        problem = svm::make_problem(labels, static_cast<const svm_samples_t<safe_value_t<Samples>>&>(svm_samples), scale);
+        svm_problem_ready = true;
     }
 
     /*!
@@ -2741,18 +4235,39 @@ private:
      */
     template <typename Iterator, typename LIterator>
     void make_problem(Iterator first, Iterator last, LIterator&& lfirst, LIterator&& llast, bool scale = false) {
-        svm_samples_t<safe_value_t<Iterator>> svm_samples;
+        static_assert(!dbn_traits<this_type>::inference_only(), "inference_only networks cannot be trained");
+
+        std::vector<const safe_value_t<Iterator>*> samples;
 
-        //Get all the activation probabilities
-        std::for_each(first, last, [this, &svm_samples](auto& sample) {
-            this->add_activation_probabilities(svm_samples, sample);
+        std::for_each(first, last, [&samples](auto& sample) {
+            samples.push_back(&sample);
         });
 
-        //static_cast ensure using the correct overload
-        problem = svm::make_problem(
-            std::forward<LIterator>(lfirst), std::forward<LIterator>(llast),
-            svm_samples.begin(), svm_samples.end(),
-            scale);
+        if constexpr (dbn_traits<this_type>::concatenate()) {
+            etl::dyn_matrix<weight, 2> features;
+
+            //Get all the activation probabilities, in a single matrix
+            set_full_activation_probabilities(features, samples);
+
+            auto rows = feature_rows(features);
+
+            problem = svm::make_problem(
+                std::forward<LIterator>(lfirst), std::forward<LIterator>(llast),
+                rows.begin(), rows.end(),
+                scale);
+        } else {
+            svm_samples_t<safe_value_t<Iterator>> svm_samples;
+
+            //Get all the activation probabilities
+            set_activation_probabilities(svm_samples, samples);
+
+            problem = svm::make_problem(
+                std::forward<LIterator>(lfirst), std::forward<LIterator>(llast),
+                svm_samples.begin(), svm_samples.end(),
+                scale);
+        }
+
+        svm_problem_ready = true;
     }
 
 #endif //DLL_SVM_SUPPORT
@@ -2764,3 +4279,5 @@ template <typename Desc>
 const size_t dbn<Desc>::layers;
 
 } //end of namespace dll
+
+#include "dbn_train_impl.hpp"
@@ -0,0 +1,85 @@
+//=======================================================================
+// Copyright (c) 2014-2017 Baptiste Wicht
+// Distributed under the terms of the MIT License.
+// (See accompanying file LICENSE or copy at
+//  http://opensource.org/licenses/MIT)
+//=======================================================================
+
+/*!
+ * \file
+ * \brief Training functions of the networks, defined out of the class.
+ *
+ * Unlike the functions defined in the class, these functions are not
+ * implicitly inline, so that their explicit instantiation declarations
+ * (see dll/instantiate.hpp) prevent the instantiation of the complete
+ * training stack in the translation units using the network.
+ */
+
+#pragma once
+
+namespace dll {
+
+/*!
+ * \copydoc dbn::train_generator(Generator&, size_t)
+ */
+template <typename Desc>
+template <typename Generator>
+typename dbn<Desc>::weight dbn<Desc>::train_generator(Generator& generator, size_t max_epochs) {
+    dll::dbn_trainer<this_type> trainer;
+    return trainer.train(*this, generator, max_epochs);
+}
+
+/*!
+ * \copydoc dbn::train_generator(Generator&, ValGenerator&, size_t)
+ */
+template <typename Desc>
+template <typename Generator, typename ValGenerator>
+typename dbn<Desc>::weight dbn<Desc>::train_generator(Generator& generator, ValGenerator& val_generator, size_t max_epochs) {
+    dll::dbn_trainer<this_type> trainer;
+    return trainer.train(*this, generator, val_generator, max_epochs);
+}
+
+/*!
+ * \copydoc dbn::fine_tune_distill(const Teacher&, Generator&, size_t, const distill_options&)
+ */
+template <typename Desc>
+template <typename Teacher, typename Generator>
+typename dbn<Desc>::weight dbn<Desc>::fine_tune_distill(const Teacher& teacher, Generator& generator, size_t max_epochs, const distill_options& options) {
+    dll::auto_timer timer("net:train:ft:distill");
+
+    validate_generator(generator);
+
+    dll::dbn_trainer<this_type> trainer;
+    return trainer.train_distill(*this, teacher, generator, max_epochs, options);
+}
+
+/*!
+ * \copydoc dbn::fine_tune_stream(Stream&, const stream_options&)
+ */
+template <typename Desc>
+template <typename Stream>
+typename dbn<Desc>::weight dbn<Desc>::fine_tune_stream(Stream& stream, const stream_options& options) {
+    dll::auto_timer timer("net:train:ft:stream");
+
+    validate_generator(stream);
+
+    dll::dbn_trainer<this_type> trainer;
+    return trainer.template train_stream<Stream>(*this, stream, nullptr, options);
+}
+
+/*!
+ * \copydoc dbn::fine_tune_stream(Stream&, ValGenerator&, const stream_options&)
+ */
+template <typename Desc>
+template <typename Stream, typename ValGenerator>
+typename dbn<Desc>::weight dbn<Desc>::fine_tune_stream(Stream& stream, ValGenerator& val_generator, const stream_options& options) {
+    dll::auto_timer timer("net:train:ft:stream");
+
+    validate_generator(stream);
+    validate_generator(val_generator);
+
+    dll::dbn_trainer<this_type> trainer;
+    return trainer.train_stream(*this, stream, &val_generator, options);
+}
+
+} //end of namespace dll
@@ -9,6 +9,7 @@
 
 #include "util/tmp.hpp"
 #include "decay_type.hpp"
+#include "layer_traits.hpp"
 
 namespace dll {
 
@@ -48,6 +49,20 @@ struct dbn_traits {
         return desc::parameters::template contains<dll::batch_mode>();
     }
 
+    /*!
+     * \brief Indicates if the layers of the DBN are pretrained concurrently
+     */
+    static constexpr bool pipeline_pretrain() noexcept {
+        return desc::parameters::template contains<dll::pipeline_pretrain>();
+    }
+
+    /*!
+     * \brief Indicates if the DBN is only used for inference
+     */
+    static constexpr bool inference_only() noexcept {
+        return desc::parameters::template contains<dll::inference_only>();
+    }
+
     /*!
      * \brief Indicates if the DBN computes error on epoch.
      */
@@ -55,6 +70,22 @@ struct dbn_traits {
         return !desc::parameters::template contains<dll::no_epoch_error>();
     }
 
+    /*!
+     * \brief Indicates if the training error of an epoch is accumulated
+     * from its batches.
+     */
+    static constexpr bool running_error() noexcept {
+        return desc::parameters::template contains<dll::running_error>();
+    }
+
+    /*!
+     * \brief Indicates if the validation of an epoch runs during the next
+     * epoch.
+     */
+    static constexpr bool async_validation() noexcept {
+        return desc::parameters::template contains<dll::async_validation>();
+    }
+
     /*!
      * \brief Indicates if early stopping strategy is forced to use
      * training statistics when validation statistics are available.
@@ -114,6 +145,75 @@ struct dbn_traits {
         return desc::parameters::template contains<clip_gradients>();
     }
 
+    /*!
+     * \brief Indicates if the DBN uses dynamic loss scaling
+     */
+    static constexpr bool has_loss_scaling() noexcept {
+        return desc::parameters::template contains<loss_scaling>();
+    }
+
+    /*!
+     * \brief Indicates if the DBN stages the next batch during the training
+     * of the current batch
+     */
+    static constexpr bool stage_inputs() noexcept {
+        return desc::parameters::template contains<stage_inputs>();
+    }
+
+    /*!
+     * \brief Indicates if the DBN stores its gradients and the state of its
+     * updater in contiguous buffers
+     */
+    static constexpr bool flat_parameters() noexcept {
+        return desc::parameters::template contains<dll::flat_parameters>();
+    }
+
+    /*!
+     * \brief Indicates if SGD compresses the activations kept between the
+     * forward and the backward passes
+     */
+    static constexpr bool compressed_activations() noexcept {
+        return desc::parameters::template contains<dll::compressed_activations>();
+    }
+
+    /*!
+     * \brief Returns the number of micro-batches trained in parallel by SGD
+     */
+    static constexpr size_t micro_batches() noexcept {
+        return get_value_l_v<dll::data_parallel<1>, typename desc::parameters>;
+    }
+
+    /*!
+     * \brief Returns the number of stages of the pipeline trained by SGD
+     */
+    static constexpr size_t pipeline_stages() noexcept {
+        return get_value_l_v<dll::pipeline_stages<1>, typename desc::parameters>;
+    }
+
+    /*!
+     * \brief Returns the number of batches whose gradients are accumulated
+     * before each update of the weights by SGD
+     */
+    static constexpr size_t accumulated_batches() noexcept {
+        return get_value_l_v<dll::grad_accumulate<1>, typename desc::parameters>;
+    }
+
+    /*!
+     * \brief Returns the distance between two checkpointed layers in SGD
+     * (0 if checkpointing is disabled)
+     */
+    static constexpr size_t checkpoint_every() noexcept {
+        return get_value_l_v<dll::checkpoint<0>, typename desc::parameters>;
+    }
+
+    /*!
+     * \brief Returns the number of workers of the asynchronous and parameter
+     * server trainers (0 for automatic)
+     */
+    static constexpr size_t workers() noexcept {
+        return get_value_l_v<dll::workers<0>, typename desc::parameters>;
+    }
+
     /*!
      * \brief Returns the type of weight decay used during training
      */
@@ -183,4 +283,34 @@ struct transform_output_type {
 template <typename DBN, typename Layer>
 using transform_output_type_t = typename transform_output_type<DBN, Layer>::type;
 
+/*!
+ * \brief Indicates if the recurrent layer L of the DBN only outputs the
+ * last time step of its sequences, i.e. if it is directly followed by a
+ * recurrent_last layer.
+ *
+ * \tparam Layer The type of the layer, which must be the layer L itself
+ * (and not a layer of a group)
+ */
+template <typename DBN, typename Layer, size_t L>
+constexpr bool rnn_last_step() {
+    if constexpr (L + 1 < DBN::layers && std::is_same<typename DBN::template layer_type<L>, Layer>::value && layer_traits<Layer>::has_last_step_output()) {
+        return layer_traits<typename DBN::template layer_type<L + 1>>::is_recurrent_last_layer();
+    } else {
+        return false;
+    }
+}
+
+/*!
+ * \brief Indicates if the layer L of the DBN only receives the last time
+ * step of the sequences of the recurrent layer before it.
+ */
+template <typename DBN, size_t L>
+constexpr bool rnn_last_step_input() {
+    if constexpr (L > 0) {
+        return rnn_last_step<DBN, typename DBN::template layer_type<L - 1>, L - 1>();
+    } else {
+        return false;
+    }
+}
+
 } //end of dll namespace
@@ -13,35 +13,38 @@ namespace dll {
  * \brief Define how weight decay is applied.
  */
 enum class decay_type {
-    NONE,     ///< No weight decay is applied during training
-    L1,       ///< Apply L1 weight decay on weights
-    L1_FULL,  ///< Apply L1 weight decay on weights and biases
-    L2,       ///< Apply L2 weight decay on weights
-    L2_FULL,  ///< Apply L2 weight decay on weights and biases
-    L1L2,     ///< Apply L1/L2 weight decay on weights
-    L1L2_FULL ///< Apply L1/L2 weight decay on weights and biases
+    NONE,           ///< No weight decay is applied during training
+    L1,             ///< Apply L1 weight decay on weights
+    L1_FULL,        ///< Apply L1 weight decay on weights and biases
+    L2,             ///< Apply L2 weight decay on weights
+    L2_FULL,        ///< Apply L2 weight decay on weights and biases
+    L1L2,           ///< Apply L1/L2 weight decay on weights
+    L1L2_FULL,      ///< Apply L1/L2 weight decay on weights and biases
+    DECOUPLED,      ///< Apply decoupled weight decay (AdamW) on weights
+    DECOUPLED_FULL  ///< Apply decoupled weight decay (AdamW) on weights and biases
 };
 
 /*!
  * \brief Indicates the type of decay that is to be applied to weights
  * \param t The RBM weight decay type.
- * \return one of L1,L2,NONE
+ * \return one of L1,L2,L1L2,DECOUPLED,NONE
  */
 constexpr decay_type w_decay(decay_type t) {
     return
-        (t == decay_type::L1 || t == decay_type::L1_FULL)     ? decay_type::L1 :
-        (t == decay_type::L2 || t == decay_type::L2_FULL)     ? decay_type::L2 :
-        (t == decay_type::L1L2 || t == decay_type::L1L2_FULL) ? decay_type::L1L2
-                                                              : decay_type::NONE;
+        (t == decay_type::L1 || t == decay_type::L1_FULL)               ? decay_type::L1 :
+        (t == decay_type::L2 || t == decay_type::L2_FULL)               ? decay_type::L2 :
+        (t == decay_type::L1L2 || t == decay_type::L1L2_FULL)           ? decay_type::L1L2 :
+        (t == decay_type::DECOUPLED || t == decay_type::DECOUPLED_FULL) ? decay_type::DECOUPLED
+                                                                        : decay_type::NONE;
 }
 
 /*!
  * \brief Indicates the type of decay that is to be applied to biases
  * \param t The RBM weight decay type.
- * \return one of L1,L2,NONE
+ * \return one of L1,L2,L1L2,DECOUPLED,NONE
  */
 constexpr decay_type b_decay(decay_type t) {
-    return t == decay_type::L1_FULL ? decay_type::L1 : t == decay_type::L2_FULL ? decay_type::L2 : t == decay_type::L1L2_FULL ? decay_type::L1L2 : decay_type::NONE;
+    return t == decay_type::L1_FULL ? decay_type::L1 : t == decay_type::L2_FULL ? decay_type::L2 : t == decay_type::L1L2_FULL ? decay_type::L1L2 : t == decay_type::DECOUPLED_FULL ? decay_type::DECOUPLED : decay_type::NONE;
 }
 
 } //end of dll namespace
@@ -0,0 +1,199 @@
+//=======================================================================
+// Copyright (c) 2014-2017 Baptiste Wicht
+// Distributed under the terms of the MIT License.
+// (See accompanying file LICENSE or copy at
+//  http://opensource.org/licenses/MIT)
+//=======================================================================
+
+/*!
+ * \file
+ * \brief Ensemble of networks, forwarding the same batches concurrently
+ */
+
+#pragma once
+
+#include <tuple>
+#include <algorithm>
+#include <memory>
+#include <vector>
+#include <string>
+#include <type_traits>
+
+#include "cpp_utils/assert.hpp"
+
+#include "etl/etl.hpp"
+
+#include "dll/inference_session.hpp"
+#include "dll/util/scheduler.hpp"
+
+namespace dll {
+
+/*!
+ * \brief The aggregation of the outputs of the members of an ensemble
+ */
+enum class ensemble_aggregation {
+    AVERAGE, ///< Average the outputs of the members
+    VOTE     ///< The fraction of the members predicting each class
+};
+
+/*!
+ * \brief Returns a string representation of an ensemble aggregation
+ * \param a The ensemble aggregation to transform to string
+ * \return a string representation of an ensemble aggregation
+ */
+inline std::string to_string(ensemble_aggregation a) {
+    switch (a) {
+        case ensemble_aggregation::AVERAGE:
+            return "AVERAGE";
+        case ensemble_aggregation::VOTE:
+            return "VOTE";
+    }
+
+    cpp_unreachable("Unreachable code");
+
+    return "UNDEFINED";
+}
+
+/*!
+ * \brief An ensemble of networks classifying the same inputs.
+ *
+ * Each batch is given once to the ensemble and forwarded through all the
+ * members concurrently, one member per task of the scheduler.
+ * Each member is forwarded through its own inference session, the
+ * networks themselves are only read. The outputs of the members, one value
+ * per class, are then aggregated.
+ *
+ * The sessions are owned by the ensemble, an ensemble must only be used by
+ * one thread at a time.
+ */
+template <typename... DBN>
+struct dbn_ensemble {
+    static_assert(sizeof...(DBN) > 0, "An ensemble needs at least one network");
+
+    using weight = typename std::tuple_element_t<0, std::tuple<DBN...>>::weight; ///< The data type of the outputs
+
+    static constexpr size_t members = sizeof...(DBN); ///< The number of networks of the ensemble
+
+    using output_t = etl::dyn_matrix<weight, 2>; ///< The type of the aggregated outputs [B, C]
+
+    ensemble_aggregation aggregation; ///< The aggregation of the outputs
+
+    /*!
+     * \brief Create an ensemble of the given networks
+     * \param dbns The networks
+     */
+    explicit dbn_ensemble(const DBN&... dbns, ensemble_aggregation aggregation = ensemble_aggregation::AVERAGE)
+            : aggregation(aggregation), sessions(dbns...), outputs(members) {}
+
+    dbn_ensemble(const dbn_ensemble& rhs) = delete;
+    dbn_ensemble& operator=(const dbn_ensemble& rhs) = delete;
+
+    /*!
+     * \brief Forward the given batch through all the members and aggregate
+     * their outputs
+     * \param input The input batch
+     * \return The aggregated outputs of the batch [B, C]
+     */
+    template <typename Input>
+    output_t forward_batch(const Input& input) {
+        const size_t B = etl::dim<0>(input);
+
+        dll::scheduler().parallel_for(members, [&](size_t m) {
+            forward_member(m, input, B);
+        });
+
+        const size_t C = etl::dim<1>(outputs[0]);
+
+        for (size_t m = 1; m < members; ++m) {
+            cpp_assert(etl::dim<1>(outputs[m]) == C, "The members of an ensemble must have the same number of classes");
+        }
+
+        output_t result(B, C, weight(0));
+
+        if (aggregation == ensemble_aggregation::AVERAGE) {
+            for (auto& output : outputs) {
+                result += output;
+            }
+        } else {
+            for (auto& output : outputs) {
+                for (size_t b = 0; b < B; ++b) {
+                    result(b, label(output(b))) += weight(1);
+                }
+            }
+        }
+
+        result /= weight(members);
+
+        return result;
+    }
+
+    /*!
+     * \brief Predict the class of each sample of the given batch
+     * \param input The input batch
+     * \return The predicted class of each sample
+     */
+    template <typename Input>
+    std::vector<size_t> predict_batch(const Input& input) {
+        auto result = forward_batch(input);
+
+        std::vector<size_t> labels(etl::dim<0>(result));
+
+        for (size_t b = 0; b < labels.size(); ++b) {
+            labels[b] = label(result(b));
+        }
+
+        return labels;
+    }
+
+private:
+    /*!
+     * \brief Returns the class with the highest output
+     */
+    template <typename Output>
+    static size_t label(const Output& output) {
+        return std::distance(output.begin(), std::max_element(output.begin(), output.end()));
+    }
+
+    /*!
+     * \brief Forward the input batch through the member m and store its
+     * outputs
+     */
+    template <size_t I = 0, typename Input>
+    void forward_member(size_t m, const Input& input, size_t B) {
+        if constexpr (I < members) {
+            if (m == I) {
+                auto output = std::get<I>(sessions).planned_forward_batch(input);
+
+                const size_t C = etl::size(output) / B;
+
+                if (etl::dim<0>(outputs[I]) != B || etl::dim<1>(outputs[I]) != C) {
+                    outputs[I] = output_t(B, C);
+                }
+
+                outputs[I] = etl::reshape(output, B, C);
+            } else {
+                forward_member<I + 1>(m, input, B);
+            }
+        } else {
+            cpp_unused(m);
+            cpp_unused(input);
+            cpp_unused(B);
+        }
+    }
+
+    std::tuple<dbn_inference_session<DBN>...> sessions; ///< The session of each member
+
+    std::vector<output_t> outputs; ///< The outputs of each member
+};
+
+/*!
+ * \brief Create an ensemble of the given networks
+ * \param dbns The networks
+ * \return The ensemble of the networks
+ */
+template <typename... DBN>
+std::unique_ptr<dbn_ensemble<DBN...>> make_ensemble(const DBN&... dbns) {
+    return std::make_unique<dbn_ensemble<DBN...>>(dbns...);
+}
+
+} //end of dll namespace
@@ -12,6 +12,8 @@
 
 #pragma once
 
+#include <cmath>
+
 namespace dll {
 
 /*!
@@ -72,6 +74,59 @@ decltype(auto) f_activate(E&& expr) {
     }
 }
 
+/*!
+ * \brief Indicates if the given activation function is computed element
+ * by element
+ * \param f The activation function
+ */
+constexpr bool is_element_wise(function f) {
+    return f != function::SOFTMAX;
+}
+
+/*!
+ * \brief Computes the activation of a single value using the specified
+ * element-wise activation function
+ * \param x The input value
+ * \tparam F The activation function to use
+ * \return The result of the activation function
+ */
+template <function F, typename T>
+T f_activate_one(T x) {
+    static_assert(is_element_wise(F), "f_activate_one only works with element-wise functions");
+
+    if constexpr (F == function::IDENTITY) {
+        return x;
+    } else if constexpr (F == function::SIGMOID) {
+        return T(1) / (T(1) + std::exp(-x));
+    } else if constexpr (F == function::TANH) {
+        return std::tanh(x);
+    } else if constexpr (F == function::RELU) {
+        return x > T(0) ? x : T(0);
+    }
+}
+
+/*!
+ * \brief Computes the derivative of a single value from the output of the
+ * specified element-wise activation function
+ * \param y The output value
+ * \tparam F The activation function to use
+ * \return The derivative of the activation function
+ */
+template <function F, typename T>
+T f_derivative_one(T y) {
+    static_assert(is_element_wise(F), "f_derivative_one only works with element-wise functions");
+
+    if constexpr (F == function::IDENTITY) {
+        return T(1);
+    } else if constexpr (F == function::SIGMOID) {
+        return y * (T(1) - y);
+    } else if constexpr (F == function::TANH) {
+        return T(1) - y * y;
+    } else if constexpr (F == function::RELU) {
+        return y > T(0) ? T(1) : T(0);
+    }
+}
+
 /*!
  * \brief Computes the derivatives from the given output using the specified activation function
  * \param expr The input expression
@@ -10,13 +10,17 @@
 #include "etl/etl.hpp"
 
 #include "dll/util/tmp.hpp"
+#include "dll/util/memory.hpp"
 #include "dll/base_conf.hpp"
+#include "dll/util/converter.hpp"
 
 // Common helpers
 #include "dll/generators/cache_helper.hpp"
 #include "dll/generators/label_cache_helper.hpp"
 #include "dll/generators/augmenters.hpp"
 #include "dll/generators/transformers.hpp"
+#include "dll/generators/batch_ring.hpp"
+#include "dll/generators/shard.hpp"
 
 namespace dll {
 
@@ -58,3 +62,9 @@ static constexpr bool is_threaded = Desc::Threaded;
 
 #include "dll/generators/inmemory_data_generator.hpp"
 #include "dll/generators/outmemory_data_generator.hpp"
+#include "dll/generators/pipeline_data_generator.hpp"
+#include "dll/generators/mmap_data_generator.hpp"
+#include "dll/generators/forward_generator.hpp"
+#include "dll/generators/feature_cache_generator.hpp"
+#include "dll/generators/stream_generator.hpp"
+#include "dll/generators/distill_generator.hpp"
@@ -9,11 +9,84 @@
 
 #include <atomic>
 #include <thread>
+#include <vector>
+#include <utility>
+#include <type_traits>
+#include <algorithm>
 
+#include "dll/noise_type.hpp"
 #include "dll/util/random.hpp"
 
 namespace dll {
 
+namespace augment_detail {
+
+/*!
+ * \brief Copy a window of an image into the target, the window having the
+ * size of the target, optionally mirrored.
+ *
+ * The window is copied row by row, directly from the memory of the image,
+ * the mirroring being folded into the copy.
+ *
+ * \param target The target output
+ * \param image The input image
+ * \param y_offset The first row of the window
+ * \param x_offset The first column of the window
+ * \param h Indicates if the window is mirrored horizontally
+ * \param v Indicates if the window is mirrored vertically
+ */
+template <typename O, typename T>
+void copy_window(O&& target, const T& image, size_t y_offset, size_t x_offset, bool h, bool v) {
+    const size_t channels = etl::dim<0>(image);
+    const size_t in_rows  = etl::dim<1>(image);
+    const size_t in_cols  = etl::dim<2>(image);
+    const size_t rows     = etl::dim<1>(target);
+    const size_t cols     = etl::dim<2>(target);
+
+    image.ensure_cpu_up_to_date();
+
+    const auto* in = image.memory_start();
+    auto* out      = target.memory_start();
+
+    for (size_t c = 0; c < channels; ++c) {
+        for (size_t y = 0; y < rows; ++y) {
+            const auto* src = in + (c * in_rows + y_offset + (v ? rows - 1 - y : y)) * in_cols + x_offset;
+            auto* dst       = out + (c * rows + y) * cols;
+
+            if (h) {
+                std::reverse_copy(src, src + cols, dst);
+            } else {
+                std::copy_n(src, cols, dst);
+            }
+        }
+    }
+
+    target.invalidate_gpu();
+}
+
+/*!
+ * \brief Copy a complete image into the target, converting its values
+ * (the samples of a packed dataset can be stored in a narrower type than
+ * the batches).
+ *
+ * \param target The target output
+ * \param image The input image
+ */
+template <typename O, typename T>
+void copy_sample(O&& target, const T& image) {
+    if constexpr (std::is_same<etl::value_t<std::decay_t<O>>, etl::value_t<T>>::value) {
+        target = image;
+    } else {
+        image.ensure_cpu_up_to_date();
+
+        std::copy_n(image.memory_start(), etl::size(image), target.memory_start());
+
+        target.invalidate_gpu();
+    }
+}
+
+} //end of namespace augment_detail
+
 /*!
  * \brief Randomly extract crops of a certain size from images
  */
@@ -67,16 +140,44 @@ struct random_cropper<Desc, std::enable_if_t<Desc::random_crop_x != 0 && Desc::r
      */
     template <typename O, typename T>
     void transform_first(O&& target, const T& image) {
-        const size_t y_offset = dist_y(dll::rand_engine());
-        const size_t x_offset = dist_x(dll::rand_engine());
+        transform_first(target, image, dll::rand_engine());
+    }
 
-        for (size_t c = 0; c < etl::dim<0>(image); ++c) {
-            for (size_t y = 0; y < random_crop_y; ++y) {
-                for (size_t x = 0; x < random_crop_x; ++x) {
-                    target(c, y, x) = image(c, y_offset + y, x_offset + x);
-                }
-            }
-        }
+    /*!
+     * \brief Transform an image, using the given random engine.
+     *
+     * This is used as the first step for data augmentation.
+     *
+     * \param target The target output
+     * \param image The input image
+     * \param g The random engine
+     */
+    template <typename O, typename T, typename G>
+    void transform_first(O&& target, const T& image, G& g) const {
+        transform_first(target, image, g, false, false);
+    }
+
+    /*!
+     * \brief Transform an image, using the given random engine, and mirror
+     * the crop in the same copy.
+     *
+     * This is used as the first step for data augmentation.
+     *
+     * \param target The target output
+     * \param image The input image
+     * \param g The random engine
+     * \param h Indicates if the crop is mirrored horizontally
+     * \param v Indicates if the crop is mirrored vertically
+     */
+    template <typename O, typename T, typename G>
+    void transform_first(O&& target, const T& image, G& g, bool h, bool v) const {
+        auto local_dist_x = dist_x;
+        auto local_dist_y = dist_y;
+
+        const size_t y_offset = local_dist_y(g);
+        const size_t x_offset = local_dist_x(g);
+
+        augment_detail::copy_window(target, image, y_offset, x_offset, h, v);
     }
 
     /*!
@@ -89,16 +190,10 @@ struct random_cropper<Desc, std::enable_if_t<Desc::random_crop_x != 0 && Desc::r
      */
     template <typename O, typename T>
     void transform_first_test(O&& target, const T& image) {
-        const size_t y_offset = (x - random_crop_x) / 2;
-        const size_t x_offset = (y - random_crop_y) / 2;
+        const size_t y_offset = (y - random_crop_y) / 2;
+        const size_t x_offset = (x - random_crop_x) / 2;
 
-        for (size_t c = 0; c < etl::dim<0>(image); ++c) {
-            for (size_t y = 0; y < random_crop_y; ++y) {
-                for (size_t x = 0; x < random_crop_x; ++x) {
-                    target(c, y, x) = image(c, y_offset + y, x_offset + x);
-                }
-            }
-        }
+        augment_detail::copy_window(target, image, y_offset, x_offset, false, false);
     }
 };
 
@@ -134,7 +229,46 @@ struct random_cropper<Desc, std::enable_if_t<Desc::random_crop_x == 0 || Desc::r
      */
     template <typename O, typename T>
     void transform_first(O&& target, const T& image) {
-        target = image;
+        augment_detail::copy_sample(target, image);
+    }
+
+    /*!
+     * \brief Transform an image, using the given random engine.
+     *
+     * This is used as the first step for data augmentation.
+     *
+     * \param target The target output
+     * \param image The input image
+     * \param g The random engine
+     */
+    template <typename O, typename T, typename G>
+    void transform_first(O&& target, const T& image, G& g) const {
+        augment_detail::copy_sample(target, image);
+
+        cpp_unused(g);
+    }
+
+    /*!
+     * \brief Transform an image, using the given random engine, and mirror
+     * it in the same copy.
+     *
+     * This is used as the first step for data augmentation.
+     *
+     * \param target The target output
+     * \param image The input image
+     * \param g The random engine
+     * \param h Indicates if the image is mirrored horizontally
+     * \param v Indicates if the image is mirrored vertically
+     */
+    template <typename O, typename T, typename G>
+    void transform_first(O&& target, const T& image, G& g, bool h, bool v) const {
+        if (h || v) {
+            augment_detail::copy_window(target, image, 0, 0, h, v);
+        } else {
+            augment_detail::copy_sample(target, image);
+        }
+
+        cpp_unused(g);
     }
 
     /*!
@@ -147,7 +281,7 @@ struct random_cropper<Desc, std::enable_if_t<Desc::random_crop_x == 0 || Desc::r
      */
     template <typename O, typename T>
     void transform_first_test(O&& target, const T& image) {
-        target = image;
+        augment_detail::copy_sample(target, image);
     }
 };
 
@@ -202,7 +336,18 @@ struct random_mirrorer<Desc, std::enable_if_t<Desc::HorizontalMirroring || Desc:
      */
     template <typename O>
     void transform(O&& target) {
-        auto choice = dist(dll::rand_engine());
+        transform(target, dll::rand_engine());
+    }
+
+    /*!
+     * \brief Apply the transform on the input, using the given random engine
+     * \param target The input to transform
+     * \param g The random engine
+     */
+    template <typename O, typename G>
+    void transform(O&& target, G& g) const {
+        auto local_dist = dist;
+        auto choice     = local_dist(g);
 
         if (horizontal && vertical && choice == 1) {
             for (size_t c = 0; c < etl::dim<0>(target); ++c) {
@@ -226,6 +371,59 @@ struct random_mirrorer<Desc, std::enable_if_t<Desc::HorizontalMirroring || Desc:
             }
         }
     }
+
+    /*!
+     * \brief Draw the mirroring of one image, to be folded in its crop
+     * (see random_cropper::transform_first)
+     * \param g The random engine
+     * \return The pair of flags indicating if the image is mirrored horizontally and vertically
+     */
+    template <typename G>
+    std::pair<bool, bool> draw(G& g) const {
+        auto local_dist   = dist;
+        const auto choice = local_dist(g);
+
+        const bool h = (horizontal && vertical) ? choice == 2 : (horizontal && choice == 1);
+        const bool v = (horizontal && vertical) ? choice == 1 : (vertical && choice == 1);
+
+        return {h, v};
+    }
+
+    /*!
+     * \brief Apply the transform on the first n images of a batch
+     * \param batch The batch to transform
+     * \param n The number of images to transform
+     * \param g The random engine
+     */
+    template <typename O, typename G>
+    void transform_batch(O&& batch, size_t n, G& g) const {
+        auto local_dist = dist;
+
+        const size_t channels = etl::dim<1>(batch);
+
+        // Draw all the choices first and only touch the selected images
+
+        std::vector<size_t> choices(n);
+
+        for (auto& choice : choices) {
+            choice = local_dist(g);
+        }
+
+        for (size_t i = 0; i < n; ++i) {
+            const bool h = (horizontal && vertical) ? choices[i] == 2 : (horizontal && choices[i] == 1);
+            const bool v = (horizontal && vertical) ? choices[i] == 1 : (vertical && choices[i] == 1);
+
+            if (h) {
+                for (size_t c = 0; c < channels; ++c) {
+                    batch(i)(c) = hflip(batch(i)(c));
+                }
+            } else if (v) {
+                for (size_t c = 0; c < channels; ++c) {
+                    batch(i)(c) = vflip(batch(i)(c));
+                }
+            }
+        }
+    }
 };
 
 /*!
@@ -258,6 +456,43 @@ struct random_mirrorer<Desc, std::enable_if_t<!Desc::HorizontalMirroring && !Des
     static void transform(O&& target) {
         cpp_unused(target);
     }
+
+    /*!
+     * \brief Apply the transform on the input, using the given random engine
+     * \param target The input to transform
+     * \param g The random engine
+     */
+    template <typename O, typename G>
+    static void transform(O&& target, G& g) {
+        cpp_unused(target);
+        cpp_unused(g);
+    }
+
+    /*!
+     * \brief Draw the mirroring of one image, to be folded in its crop
+     * (see random_cropper::transform_first)
+     * \param g The random engine
+     * \return The pair of flags indicating if the image is mirrored horizontally and vertically
+     */
+    template <typename G>
+    static std::pair<bool, bool> draw(G& g) {
+        cpp_unused(g);
+
+        return {false, false};
+    }
+
+    /*!
+     * \brief Apply the transform on the first n images of a batch
+     * \param batch The batch to transform
+     * \param n The number of images to transform
+     * \param g The random engine
+     */
+    template <typename O, typename G>
+    static void transform_batch(O&& batch, size_t n, G& g) {
+        cpp_unused(batch);
+        cpp_unused(n);
+        cpp_unused(g);
+    }
 };
 
 /*!
@@ -271,7 +506,8 @@ struct random_noise;
  */
 template <typename Desc>
 struct random_noise<Desc, std::enable_if_t<Desc::Noise != 0>> {
-    static constexpr size_t N = Desc::Noise; ///< The amount of noise (in percent)
+    static constexpr size_t N        = Desc::Noise;     ///< The amount of noise (in percent)
+    static constexpr noise_type Kind = Desc::NoiseKind; ///< The type of noise
 
     std::uniform_int_distribution<size_t> dist; ///< The random distribution
 
@@ -298,10 +534,68 @@ struct random_noise<Desc, std::enable_if_t<Desc::Noise != 0>> {
      */
     template <typename O>
     void transform(O&& target) {
-        auto& g = dll::rand_engine();
+        transform(target, dll::rand_engine());
+    }
+
+    /*!
+     * \brief Apply the transform on the input, using the given random engine
+     * \param target The input to transform
+     * \param g The random engine
+     */
+    template <typename O, typename G>
+    void transform(O&& target, G& g) const {
+        corrupt(target.begin(), target.end(), g);
+    }
+
+    /*!
+     * \brief Apply the transform on the first n images of a batch
+     * \param batch The batch to transform
+     * \param n The number of images to transform
+     * \param g The random engine
+     */
+    template <typename O, typename G>
+    void transform_batch(O&& batch, size_t n, G& g) const {
+        // The first n images are contiguous in the batch
+        const size_t total = n * (etl::size(batch) / etl::dim<0>(batch));
 
-        for (auto& v : target) {
-            v *= dist(g) < N * 10 ? 0.0 : 1.0;
+        auto* memory = batch.memory_start();
+
+        corrupt(memory, memory + total, g);
+    }
+
+private:
+    /*!
+     * \brief Corrupt the values of the given range
+     * \param first The beginning of the range
+     * \param last The end of the range
+     * \param g The random engine
+     */
+    template <typename It, typename G>
+    void corrupt(It first, It last, G& g) const {
+        using T = std::decay_t<decltype(*first)>;
+
+        auto local_dist = dist;
+
+        if constexpr (Kind == noise_type::GAUSSIAN) {
+            std::normal_distribution<T> normal_dist(T(0), T(N) / T(100));
+
+            for (; first != last; ++first) {
+                *first += normal_dist(g);
+            }
+        } else if constexpr (Kind == noise_type::SALT_PEPPER) {
+            for (; first != last; ++first) {
+                const size_t r = local_dist(g);
+
+                if (r < N * 10) {
+                    *first = r < N * 5 ? T(0) : T(1);
+                }
+            }
+        } else {
+            for (; first != last; ++first) {
+                if (local_dist(g) < N * 10) {
+                    *first = T(0);
+                }
+            }
         }
     }
 };
@@ -336,6 +630,30 @@ struct random_noise<Desc, std::enable_if_t<Desc::Noise == 0>> {
     static void transform(O&& target) {
         cpp_unused(target);
     }
+
+    /*!
+     * \brief Apply the transform on the input, using the given random engine
+     * \param target The input to transform
+     * \param g The random engine
+     */
+    template <typename O, typename G>
+    static void transform(O&& target, G& g) {
+        cpp_unused(target);
+        cpp_unused(g);
+    }
+
+    /*!
+     * \brief Apply the transform on the first n images of a batch
+     * \param batch The batch to transform
+     * \param n The number of images to transform
+     * \param g The random engine
+     */
+    template <typename O, typename G>
+    static void transform_batch(O&& batch, size_t n, G& g) {
+        cpp_unused(batch);
+        cpp_unused(n);
+        cpp_unused(g);
+    }
 };
 
 /*!
@@ -344,21 +662,39 @@ struct random_noise<Desc, std::enable_if_t<Desc::Noise == 0>> {
 template <typename Desc, typename Enable = void>
 struct elastic_distorter;
 
-// TODO This needs to be made MUCH faster
-
 /*!
  * \copydoc elastic_distorter
+ *
+ * Each displacement field is turned into a remap table holding, for each
+ * output pixel, the four input pixels and the four bilinear weights. The
+ * warp is then a single gather over the image. When a distortion bank is
+ * configured, the tables are computed once at construction and each
+ * sample draws one of them at random.
  */
 template <typename Desc>
 struct elastic_distorter<Desc, std::enable_if_t<Desc::ElasticDistortion != 0>> {
-    using weight = typename Desc::weight; ///< The data type
+    using weight = float; ///< The type of the displacement fields
 
     static constexpr size_t K     = Desc::ElasticDistortion;         ///< size of elastic distortion kernel
+    static constexpr size_t N     = Desc::DistortionBank;            ///< The number of precomputed fields (0 for one field per sample)
     static constexpr size_t mid   = K / 2;                           ///< Half of the kernel
     static constexpr double sigma = 0.8 + 0.3 * ((K - 1) * 0.5 - 1); ///< Sigma for gaussian kernel
 
+    /*!
+     * \brief A displacement field, precomputed as a bilinear remap
+     */
+    struct remap {
+        std::vector<uint32_t> index; ///< The four input pixels of each output pixel
+        std::vector<weight> coeff;   ///< The four bilinear weights of each output pixel
+    };
+
     etl::fast_dyn_matrix<weight, K, K> kernel; ///< The precomputed kernel
 
+    size_t width;  ///< The first spatial dimension of the images
+    size_t height; ///< The second spatial dimension of the images
+
+    std::vector<remap> bank; ///< The bank of precomputed fields
+
     static_assert(K % 2 == 1, "The kernel size must be odd");
 
     /*!
@@ -366,11 +702,9 @@ struct elastic_distorter<Desc, std::enable_if_t<Desc::ElasticDistortion != 0>> {
      * \param image The image to distort
      */
     template <typename T>
-    elastic_distorter(const T& image) {
+    elastic_distorter(const T& image) : width(etl::dim<1>(image)), height(etl::dim<2>(image)) {
         static_assert(etl::dimensions<T>() == 3, "elastic_distorter can only be used with 3D images");
 
-        cpp_unused(image);
-
         // Precompute the gaussian kernel
 
         auto gaussian = [](double x, double y) {
@@ -383,6 +717,14 @@ struct elastic_distorter<Desc, std::enable_if_t<Desc::ElasticDistortion != 0>> {
                 kernel(i, j) = gaussian(double(i) - mid, double(j) - mid);
             }
         }
+
+        // Precompute the bank of fields
+
+        bank.reserve(N);
+
+        for (size_t n = 0; n < N; ++n) {
+            bank.push_back(make_remap(dll::rand_engine()));
+        }
     }
 
     /*!
@@ -399,16 +741,102 @@ struct elastic_distorter<Desc, std::enable_if_t<Desc::ElasticDistortion != 0>> {
      */
     template <typename O>
     void transform(O&& target) {
-        const size_t width  = etl::dim<1>(target);
-        const size_t height = etl::dim<2>(target);
+        transform(target, dll::rand_engine());
+    }
+
+    /*!
+     * \brief Apply the transform on the input, using the given random engine
+     * \param target The input to transform
+     * \param g The random engine
+     */
+    template <typename O, typename G>
+    void transform(O&& target, G& g) const {
+        std::vector<etl::value_t<std::decay_t<O>>> buffer(etl::size(target));
+
+        distort(target.memory_start(), etl::dim<0>(target), buffer.data(), g);
+    }
+
+    /*!
+     * \brief Apply the transform on the first n images of a batch
+     * \param batch The batch to transform
+     * \param n The number of images to transform
+     * \param g The random engine
+     */
+    template <typename O, typename G>
+    void transform_batch(O&& batch, size_t n, G& g) const {
+        const size_t channels = etl::dim<1>(batch);
+        const size_t stride   = channels * width * height;
+
+        std::vector<etl::value_t<std::decay_t<O>>> buffer(stride);
+
+        auto* images = batch.memory_start();
+
+        for (size_t i = 0; i < n; ++i) {
+            distort(images + i * stride, channels, buffer.data(), g);
+        }
+    }
+
+private:
+    /*!
+     * \brief Distort an image with a random field
+     * \param image The memory of the image
+     * \param channels The number of channels of the image
+     * \param buffer Temporary storage for one image
+     * \param g The random engine
+     */
+    template <typename T, typename G>
+    void distort(T* image, size_t channels, T* buffer, G& g) const {
+        if constexpr (N > 0) {
+            std::uniform_int_distribution<size_t> dist(0, N - 1);
+            warp(image, channels, bank[dist(g)], buffer);
+        } else {
+            warp(image, channels, make_remap(g), buffer);
+        }
+    }
+
+    /*!
+     * \brief Warp all the channels of an image with the given remap table
+     * \param image The memory of the image
+     * \param channels The number of channels of the image
+     * \param r The remap table
+     * \param buffer Temporary storage for one image
+     */
+    template <typename T>
+    void warp(T* image, size_t channels, const remap& r, T* buffer) const {
+        const size_t pixels = width * height;
+
+        std::copy(image, image + channels * pixels, buffer);
+
+        const uint32_t* index = r.index.data();
+        const weight* coeff   = r.coeff.data();
 
+        for (size_t channel = 0; channel < channels; ++channel) {
+            const T* in = buffer + channel * pixels;
+            T* out      = image + channel * pixels;
+
+            for (size_t p = 0; p < pixels; ++p) {
+                out[p] = coeff[4 * p + 0] * in[index[4 * p + 0]]
+                       + coeff[4 * p + 1] * in[index[4 * p + 1]]
+                       + coeff[4 * p + 2] * in[index[4 * p + 2]]
+                       + coeff[4 * p + 3] * in[index[4 * p + 3]];
+            }
+        }
+    }
+
+    /*!
+     * \brief Generate a random displacement field and compute its remap table
+     * \param g The random engine
+     * \return The remap table of the new field
+     */
+    template <typename G>
+    remap make_remap(G& g) const {
         // 0. Generate random displacement fields
 
         etl::dyn_matrix<weight> d_x(width, height);
         etl::dyn_matrix<weight> d_y(width, height);
 
-        d_x = etl::uniform_generator(dll::rand_engine(), -1.0, 1.0);
-        d_y = etl::uniform_generator(dll::rand_engine(), -1.0, 1.0);
+        d_x = etl::uniform_generator(g, -1.0, 1.0);
+        d_y = etl::uniform_generator(g, -1.0, 1.0);
 
         // 1. Gaussian blur the displacement fields
 
@@ -423,45 +851,54 @@ struct elastic_distorter<Desc, std::enable_if_t<Desc::ElasticDistortion != 0>> {
         d_x_blur *= (weight(8) / sum(d_x_blur));
         d_y_blur *= (weight(8) / sum(d_y_blur));
 
-        // 3. Apply the displacement field (using bilinear interpolation)
+        // 3. Compute the bilinear interpolation of each pixel
+
+        remap r;
+
+        r.index.resize(4 * width * height);
+        r.coeff.resize(4 * width * height);
 
-        auto safe = [&](size_t channel, weight x, weight y) {
+        // Out of the image, the first pixel is used
+        auto safe = [this](weight x, weight y) -> uint32_t {
             if (x < 0 || y < 0 || x > width - 1 || y > height - 1) {
-                return target(channel, 0UL, 0UL);
+                return 0;
             } else {
-                return target(channel, size_t(x), size_t(y));
+                return size_t(x) * height + size_t(y);
             }
         };
 
-        for (size_t channel = 0; channel < etl::dim<0>(target); ++channel) {
-            for (int x = 0; x < int(width); ++x) {
-                for (int y = 0; y < int(height); ++y) {
-                    auto dx = d_x_blur(x, y);
-                    auto dy = d_y_blur(x, y);
+        for (size_t x = 0; x < width; ++x) {
+            for (size_t y = 0; y < height; ++y) {
+                const size_t p = x * height + y;
 
-                    weight px = x + dx;
-                    weight py = y + dy;
+                weight px = x + d_x_blur(x, y);
+                weight py = y + d_y_blur(x, y);
 
-                    weight a = safe(channel, std::floor(px), std::floor(py));
-                    weight b = safe(channel, std::ceil(px), std::floor(py));
-                    weight c = safe(channel, std::ceil(px), std::ceil(py));
-                    weight d = safe(channel, std::floor(px), std::ceil(py));
+                weight x0 = std::floor(px);
+                weight y0 = std::floor(py);
 
-                    auto e = a * (1.0 - (px - std::floor(px))) + d * (px - std::floor(px));
-                    auto f = b * (1.0 - (px - std::floor(px))) + c * (px - std::floor(px));
+                weight fx = px - x0;
+                weight fy = py - y0;
 
-                    auto value = e * (1.0 - (py - std::floor(py))) + f * (py - std::floor(py));
+                r.index[4 * p + 0] = safe(x0, y0);
+                r.index[4 * p + 1] = safe(std::ceil(px), y0);
+                r.index[4 * p + 2] = safe(std::ceil(px), std::ceil(py));
+                r.index[4 * p + 3] = safe(x0, std::ceil(py));
 
-                    target(channel, x, y) = value;
-                }
+                r.coeff[4 * p + 0] = (1 - fx) * (1 - fy);
+                r.coeff[4 * p + 1] = fx * (1 - fy);
+                r.coeff[4 * p + 2] = fx * fy;
+                r.coeff[4 * p + 3] = (1 - fx) * fy;
             }
         }
+
+        return r;
     }
 
     /*!
      * \brief Apply a gaussian blur on the distortion matrix
      */
-    void gaussian_blur(const etl::dyn_matrix<weight>& d, etl::dyn_matrix<weight>& d_blur) {
+    void gaussian_blur(const etl::dyn_matrix<weight>& d, etl::dyn_matrix<weight>& d_blur) const {
         const size_t width  = etl::dim<0>(d);
         const size_t height = etl::dim<1>(d);
 
@@ -515,6 +952,30 @@ struct elastic_distorter<Desc, std::enable_if_t<Desc::ElasticDistortion == 0>> {
     static void transform(O&& target) {
         cpp_unused(target);
     }
+
+    /*!
+     * \brief Apply the transform on the input, using the given random engine
+     * \param target The input to transform
+     * \param g The random engine
+     */
+    template <typename O, typename G>
+    static void transform(O&& target, G& g) {
+        cpp_unused(target);
+        cpp_unused(g);
+    }
+
+    /*!
+     * \brief Apply the transform on the first n images of a batch
+     * \param batch The batch to transform
+     * \param n The number of images to transform
+     * \param g The random engine
+     */
+    template <typename O, typename G>
+    static void transform_batch(O&& batch, size_t n, G& g) {
+        cpp_unused(batch);
+        cpp_unused(n);
+        cpp_unused(g);
+    }
 };
 
 } //end of dll namespace
@@ -0,0 +1,432 @@
+//=======================================================================
+// Copyright (c) 2014-2017 Baptiste Wicht
+// Distributed under the terms of the MIT License.
+// (See accompanying file LICENSE or copy at
+//  http://opensource.org/licenses/MIT)
+//=======================================================================
+
+/*!
+ * \file
+ * \brief Rings of batch slots used to hand batches from the generator
+ * threads to the consumer.
+ *
+ * Both rings have the same interface. A producer acquires the next
+ * position to fill, ends its read of the sequential inputs and then
+ * publishes the batch. The consumer waits for a position to be ready
+ * and releases it once consumed.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <chrono>
+#include <algorithm>
+
+#include "dll/util/timers.hpp" // for auto_timer
+#include "dll/generators/generator_stats.hpp"
+
+namespace dll {
+
+/*!
+ * \brief A ring of batch slots protected by a mutex and condition variables
+ * \tparam N The number of slots in the ring
+ */
+template <size_t N>
+struct locked_batch_ring {
+    size_t limit; ///< The number of positions that can be produced
+
+    bool status[N];  ///< Status of each slot
+    bool claimed[N]; ///< Indicates if a slot is being filled by a producer
+
+    size_t next    = 0;     ///< The next position to fill
+    size_t active  = 0;     ///< The number of slots currently being filled
+    bool reading   = false; ///< Indicates if a producer is reading the sequential inputs
+    bool resetting = false; ///< Indicates if the ring is being reset
+    bool stop_flag = false; ///< Indicates that the producers must stop
+
+    mutable std::mutex main_lock;                    ///< The main lock
+    mutable std::condition_variable condition;       ///< The condition variable for the producers to wait for some space
+    mutable std::condition_variable ready_condition; ///< The condition variable for the consumer to wait for ready data
+
+    size_t fill_start[N];                 ///< The time at which each slot started being filled
+    mutable size_t observed = size_t(-1); ///< The last position whose occupancy was recorded
+
+    mutable generator_stats stats{&global_generator_stats()}; ///< The counters of the ring
+
+    /*!
+     * \brief Construct a new ring
+     * \param limit The number of positions that can be produced
+     */
+    explicit locked_batch_ring(size_t limit) : limit(limit) {
+        for (size_t b = 0; b < N; ++b) {
+            status[b]  = false;
+            claimed[b] = false;
+        }
+    }
+
+    /*!
+     * \brief Acquire the next position to fill.
+     *
+     * This blocks until a slot is free or until the ring is stopped.
+     * The producer is the only one reading the sequential inputs until
+     * it calls end_read().
+     *
+     * \param pos The acquired position
+     * \return true if a position was acquired, false if the ring was stopped
+     */
+    bool acquire(size_t& pos) {
+        std::unique_lock<std::mutex> ulock(main_lock);
+
+        condition.wait(ulock, [this] { return stop_flag || can_fill_next(); });
+
+        if (stop_flag) {
+            return false;
+        }
+
+        pos = next++;
+
+        claimed[pos % N] = true;
+        reading          = true;
+
+        ++active;
+
+        fill_start[pos % N] = generator_stats::now();
+
+        return true;
+    }
+
+    /*!
+     * \brief Indicates that the producer of the given position has finished
+     * reading the sequential inputs
+     * \param pos The position
+     */
+    void end_read(size_t pos) {
+        std::unique_lock<std::mutex> ulock(main_lock);
+
+        reading = false;
+
+        condition.notify_all();
+
+        cpp_unused(pos);
+    }
+
+    /*!
+     * \brief Publish the batch at the given position to the consumer
+     * \param pos The position
+     */
+    void publish(size_t pos) {
+        std::unique_lock<std::mutex> ulock(main_lock);
+
+        claimed[pos % N] = false;
+        status[pos % N]  = true;
+
+        --active;
+
+        stats.add_fill(generator_stats::now() - fill_start[pos % N]);
+
+        ready_condition.notify_all();
+        condition.notify_all();
+    }
+
+    /*!
+     * \brief Wait for the batch at the given position to be ready
+     * \param pos The position
+     */
+    void wait_ready(size_t pos) const {
+        dll::auto_timer timer("generator:wait");
+
+        std::unique_lock<std::mutex> ulock(main_lock);
+
+        if (pos != observed) {
+            observed = pos;
+            stats.add_occupancy(std::count(status, status + N, true));
+        }
+
+        if (!status[pos % N]) {
+            const size_t start = generator_stats::now();
+
+            ready_condition.wait(ulock, [this, pos] { return status[pos % N]; });
+
+            stats.add_wait(generator_stats::now() - start);
+        }
+    }
+
+    /*!
+     * \brief Release the slot of the given position once it has been consumed
+     * \param pos The position
+     */
+    void release(size_t pos) {
+        std::unique_lock<std::mutex> ulock(main_lock);
+
+        status[pos % N] = false;
+
+        condition.notify_all();
+    }
+
+    /*!
+     * \brief Reset the ring to its first position.
+     *
+     * This waits for the producers to finish the slots they are
+     * filling. The given functor is called while no producer is
+     * working.
+     *
+     * \param functor The functor to call while the producers are quiet
+     */
+    template <typename F>
+    void reset(F&& functor) {
+        std::unique_lock<std::mutex> ulock(main_lock);
+
+        resetting = true;
+
+        condition.wait(ulock, [this] { return !active; });
+
+        functor();
+
+        next     = 0;
+        observed = size_t(-1);
+
+        for (size_t b = 0; b < N; ++b) {
+            status[b]  = false;
+            claimed[b] = false;
+        }
+
+        resetting = false;
+
+        condition.notify_all();
+    }
+
+    /*!
+     * \brief Stop the producers
+     */
+    void stop() {
+        cpp::with_lock(main_lock, [this] { stop_flag = true; });
+
+        condition.notify_all();
+    }
+
+private:
+    /*!
+     * \brief Indicates if the next position can be filled
+     */
+    bool can_fill_next() const {
+        const size_t index = next % N;
+
+        return !reading && !resetting && !status[index] && !claimed[index] && next < limit;
+    }
+};
+
+/*!
+ * \brief A lock-free ring of batch slots.
+ *
+ * Each slot holds an atomic sequence number. A slot is free for
+ * position p when its sequence is p, ready for the consumer when its
+ * sequence is p + 1 and becomes free for position p + N once released.
+ *
+ * \tparam N The number of slots in the ring
+ */
+template <size_t N>
+struct lock_free_batch_ring {
+    size_t limit; ///< The number of positions that can be produced
+
+    std::atomic<size_t> sequences[N]; ///< The sequence number of each slot
+
+    std::atomic<size_t> enqueue_pos; ///< The next position to fill
+    std::atomic<size_t> read_turn;   ///< The position allowed to read the sequential inputs
+    std::atomic<size_t> active;      ///< The number of producers currently working
+    std::atomic<bool> resetting;     ///< Indicates if the ring is being reset
+    std::atomic<bool> stop_flag;     ///< Indicates that the producers must stop
+
+    size_t fill_start[N];                 ///< The time at which each slot started being filled
+    mutable size_t observed = size_t(-1); ///< The last position whose occupancy was recorded (consumer only)
+
+    mutable generator_stats stats{&global_generator_stats()}; ///< The counters of the ring
+
+    /*!
+     * \brief Construct a new ring
+     * \param limit The number of positions that can be produced
+     */
+    explicit lock_free_batch_ring(size_t limit) : limit(limit), enqueue_pos(0), read_turn(0), active(0), resetting(false), stop_flag(false) {
+        for (size_t b = 0; b < N; ++b) {
+            sequences[b].store(b, std::memory_order_relaxed);
+        }
+    }
+
+    /*!
+     * \brief Acquire the next position to fill.
+     *
+     * This spins until a slot is free or until the ring is stopped.
+     * The producer is the only one reading the sequential inputs until
+     * it calls end_read().
+     *
+     * \param pos The acquired position
+     * \return true if a position was acquired, false if the ring was stopped
+     */
+    bool acquire(size_t& pos) {
+        size_t spins = 0;
+
+        while (!stop_flag.load(std::memory_order_relaxed)) {
+            ++active;
+
+            if (!resetting.load()) {
+                size_t p = enqueue_pos.load(std::memory_order_relaxed);
+
+                if (p < limit && sequences[p % N].load(std::memory_order_acquire) == p && enqueue_pos.compare_exchange_weak(p, p + 1)) {
+                    // The inputs are read in the order of the positions
+                    while (read_turn.load(std::memory_order_acquire) != p) {
+                        backoff(spins);
+                    }
+
+                    pos = p;
+
+                    fill_start[p % N] = generator_stats::now();
+
+                    return true;
+                }
+            }
+
+            --active;
+
+            backoff(spins);
+        }
+
+        return false;
+    }
+
+    /*!
+     * \brief Indicates that the producer of the given position has finished
+     * reading the sequential inputs
+     * \param pos The position
+     */
+    void end_read(size_t pos) {
+        read_turn.store(pos + 1, std::memory_order_release);
+    }
+
+    /*!
+     * \brief Publish the batch at the given position to the consumer
+     * \param pos The position
+     */
+    void publish(size_t pos) {
+        stats.add_fill(generator_stats::now() - fill_start[pos % N]);
+
+        sequences[pos % N].store(pos + 1, std::memory_order_release);
+
+        --active;
+    }
+
+    /*!
+     * \brief Wait for the batch at the given position to be ready
+     * \param pos The position
+     */
+    void wait_ready(size_t pos) const {
+        dll::auto_timer timer("generator:wait");
+
+        if (pos != observed) {
+            observed = pos;
+            stats.add_occupancy(ready_slots(pos));
+        }
+
+        if (sequences[pos % N].load(std::memory_order_acquire) != pos + 1) {
+            const size_t start = generator_stats::now();
+
+            size_t spins = 0;
+
+            while (sequences[pos % N].load(std::memory_order_acquire) != pos + 1) {
+                backoff(spins);
+            }
+
+            stats.add_wait(generator_stats::now() - start);
+        }
+    }
+
+    /*!
+     * \brief Release the slot of the given position once it has been consumed
+     * \param pos The position
+     */
+    void release(size_t pos) {
+        sequences[pos % N].store(pos + N, std::memory_order_release);
+    }
+
+    /*!
+     * \brief Reset the ring to its first position.
+     *
+     * This waits for the producers to finish the slots they are
+     * filling. The given functor is called while no producer is
+     * working.
+     *
+     * \param functor The functor to call while the producers are quiet
+     */
+    template <typename F>
+    void reset(F&& functor) {
+        size_t spins = 0;
+
+        resetting.store(true);
+
+        while (active.load()) {
+            backoff(spins);
+        }
+
+        functor();
+
+        for (size_t b = 0; b < N; ++b) {
+            sequences[b].store(b, std::memory_order_relaxed);
+        }
+
+        enqueue_pos.store(0, std::memory_order_relaxed);
+        read_turn.store(0, std::memory_order_relaxed);
+
+        observed = size_t(-1);
+
+        resetting.store(false);
+    }
+
+    /*!
+     * \brief Stop the producers
+     */
+    void stop() {
+        stop_flag.store(true);
+    }
+
+private:
+    /*!
+     * \brief Returns the number of ready batches from the given position
+     * \param pos The position of the consumer
+     */
+    size_t ready_slots(size_t pos) const {
+        size_t ready = 0;
+
+        for (size_t i = 0; i < N; ++i) {
+            if (sequences[(pos + i) % N].load(std::memory_order_acquire) == pos + i + 1) {
+                ++ready;
+            }
+        }
+
+        return ready;
+    }
+
+    /*!
+     * \brief Wait a bit before trying again.
+     *
+     * The thread first yields and then sleeps to avoid burning a core
+     * while the other side is busy.
+     *
+     * \param spins The number of spins done so far
+     */
+    static void backoff(size_t& spins) {
+        if (spins++ < 128) {
+            std::this_thread::yield();
+        } else {
+            std::this_thread::sleep_for(std::chrono::microseconds(20));
+        }
+    }
+};
+
+/*!
+ * \brief Select the type of ring for the given generator descriptor
+ */
+template <typename Desc>
+using batch_ring_t = std::conditional_t<Desc::LockFree, lock_free_batch_ring<Desc::BigBatchSize>, locked_batch_ring<Desc::BigBatchSize>>;
+
+} //end of dll namespace
@@ -12,6 +12,31 @@
 
 namespace dll {
 
+/*!
+ * \brief Select the type used to store the inputs in the cache.
+ *
+ * Descriptors can define a storage_t type to store the inputs in a more
+ * compact type than the input type (void for the input type).
+ */
+template <typename Desc, typename T, typename Enable = void>
+struct cache_storage {
+    using type = T; ///< The storage type
+};
+
+/*!
+ * \copydoc cache_storage
+ */
+template <typename Desc, typename T>
+struct cache_storage<Desc, T, std::void_t<typename Desc::storage_t>> {
+    using type = std::conditional_t<std::is_void<typename Desc::storage_t>::value, T, typename Desc::storage_t>; ///< The storage type
+};
+
+/*!
+ * \brief Helper to get the storage type of the cache
+ */
+template <typename Desc, typename T>
+using cache_storage_t = typename cache_storage<Desc, T>::type;
+
 /*!
  * \brief Helper to create and initialize a cache for inputs
  *
@@ -28,7 +53,9 @@ template <typename Desc, typename Iterator>
 struct cache_helper<Desc, Iterator, std::enable_if_t<etl::is_1d<typename std::iterator_traits<Iterator>::value_type>>> {
     using T = etl::value_t<typename std::iterator_traits<Iterator>::value_type>; ///< Input type
 
-    using cache_type     = etl::dyn_matrix<T, 2>; ///< The type of the cache
+    using S = cache_storage_t<Desc, T>; ///< Storage type
+
+    using cache_type     = etl::dyn_matrix<S, 2>; ///< The type of the cache
     using big_cache_type = etl::dyn_matrix<T, 3>; ///< The type of the big cache
 
     static constexpr size_t batch_size     = Desc::BatchSize;    ///< The size of the generated batches
@@ -40,9 +67,10 @@ struct cache_helper<Desc, Iterator, std::enable_if_t<etl::is_1d<typename std::it
      * \param it An iterator to an element
      * \param cache The cache to initialize
      */
-    static void init(size_t n, const Iterator& it, cache_type& cache) {
+    template <typename C>
+    static void init(size_t n, const Iterator& it, C& cache) {
         auto one = *it;
-        cache    = cache_type(n, etl::dim<0>(one));
+        cache    = C(n, etl::dim<0>(one));
     }
 
     /*!
@@ -56,6 +84,44 @@ struct cache_helper<Desc, Iterator, std::enable_if_t<etl::is_1d<typename std::it
     }
 };
 
+/*!
+ * \brief cache_helper implementation for 1D inputs in standard containers
+ * (std::vector<float>, ...), stored in the contiguous cache with
+ * converter_bulk
+ */
+template <typename Desc, typename Iterator>
+struct cache_helper<Desc, Iterator, std::enable_if_t<is_std_sample<typename std::iterator_traits<Iterator>::value_type>>> {
+    using T = sample_value_t<typename std::iterator_traits<Iterator>::value_type>; ///< Input type
+
+    using S = cache_storage_t<Desc, T>; ///< Storage type
+
+    using cache_type     = etl::dyn_matrix<S, 2>; ///< The type of the cache
+    using big_cache_type = etl::dyn_matrix<T, 3>; ///< The type of the big cache
+
+    static constexpr size_t batch_size     = Desc::BatchSize;    ///< The size of the generated batches
+    static constexpr size_t big_batch_size = Desc::BigBatchSize; ///< The number of batches kept in cache
+
+    /*!
+     * \brief Init the cache
+     * \param n The size of the cache
+     * \param it An iterator to an element
+     * \param cache The cache to initialize
+     */
+    template <typename C>
+    static void init(size_t n, const Iterator& it, C& cache) {
+        cache = C(n, (*it).size());
+    }
+
+    /*!
+     * \brief Init the big cache
+     * \param it An iterator to an element
+     * \param cache The big cache to initialize
+     */
+    static void init_big(Iterator& it, big_cache_type& cache) {
+        cache = big_cache_type(big_batch_size, batch_size, (*it).size());
+    }
+};
+
 /*!
  * \brief cache_helper implementation for 3D inputs
  */
@@ -63,7 +129,9 @@ template <typename Desc, typename Iterator>
 struct cache_helper<Desc, Iterator, std::enable_if_t<etl::is_3d<typename std::iterator_traits<Iterator>::value_type>>> {
     using T = etl::value_t<typename std::iterator_traits<Iterator>::value_type>; ///< Input type
 
-    using cache_type     = etl::dyn_matrix<T, 4>; ///< The type of the cache
+    using S = cache_storage_t<Desc, T>; ///< Storage type
+
+    using cache_type     = etl::dyn_matrix<S, 4>; ///< The type of the cache
     using big_cache_type = etl::dyn_matrix<T, 5>; ///< The type of the big cache
 
     static constexpr size_t batch_size     = Desc::BatchSize;    ///< The size of the generated batches
@@ -75,9 +143,10 @@ struct cache_helper<Desc, Iterator, std::enable_if_t<etl::is_3d<typename std::it
      * \param it An iterator to an element
      * \param cache The cache to initialize
      */
-    static void init(size_t n, const Iterator& it, cache_type& cache) {
+    template <typename C>
+    static void init(size_t n, const Iterator& it, C& cache) {
         auto one = *it;
-        cache    = cache_type(n, etl::dim<0>(one), etl::dim<1>(one), etl::dim<2>(one));
+        cache    = C(n, etl::dim<0>(one), etl::dim<1>(one), etl::dim<2>(one));
     }
 
     /*!
@@ -103,7 +172,9 @@ template <typename Desc, typename Iterator>
 struct cache_helper<Desc, Iterator, std::enable_if_t<etl::is_2d<typename std::iterator_traits<Iterator>::value_type>>> {
     using T = etl::value_t<typename std::iterator_traits<Iterator>::value_type>; ///< Input type
 
-    using cache_type     = etl::dyn_matrix<T, 3>; ///< The type of the cache
+    using S = cache_storage_t<Desc, T>; ///< Storage type
+
+    using cache_type     = etl::dyn_matrix<S, 3>; ///< The type of the cache
     using big_cache_type = etl::dyn_matrix<T, 4>; ///< The type of the big cache
 
     static constexpr size_t batch_size     = Desc::BatchSize;    ///< The size of the generated batches
@@ -115,9 +186,10 @@ struct cache_helper<Desc, Iterator, std::enable_if_t<etl::is_2d<typename std::it
      * \param it An iterator to an element
      * \param cache The cache to initialize
      */
-    static void init(size_t n, const Iterator& it, cache_type& cache) {
+    template <typename C>
+    static void init(size_t n, const Iterator& it, C& cache) {
         auto one = *it;
-        cache    = cache_type(n, etl::dim<0>(one), etl::dim<1>(one));
+        cache    = C(n, etl::dim<0>(one), etl::dim<1>(one));
     }
 
     /*!
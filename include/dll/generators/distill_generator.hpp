@@ -0,0 +1,470 @@
+//=======================================================================
+// Copyright (c) 2014-2017 Baptiste Wicht
+// Distributed under the terms of the MIT License.
+// (See accompanying file LICENSE or copy at
+//  http://opensource.org/licenses/MIT)
+//=======================================================================
+
+/*!
+ * \file
+ * \brief Generator adaptor replacing the labels by the soft targets of a
+ * teacher network, for knowledge distillation.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cmath>
+#include <fstream>
+#include <future>
+#include <iostream>
+#include <mutex>
+#include <string>
+
+#include "etl/etl.hpp"
+
+#include "dll/util/memory.hpp"
+
+namespace dll {
+
+/*!
+ * \brief The options of a knowledge distillation
+ */
+struct distill_options {
+    double temperature = 1.0; ///< The temperature softening the outputs of the teacher
+    double alpha       = 1.0; ///< The weight of the soft targets (the hard labels have a weight of 1 - alpha)
+    std::string cache;        ///< The file caching the outputs of the teacher (empty to disable)
+};
+
+/*!
+ * \brief A generator adaptor replacing the labels of a generator by the
+ * soft targets of a teacher network.
+ *
+ * The soft targets are the outputs of the teacher (softmax), softened with
+ * the temperature T (the logits are divided by T, i.e. the probabilities
+ * are raised to the power 1/T and normalized) and mixed with the hard
+ * labels with the weight alpha. In test mode, the hard labels are
+ * returned, so that the errors are still measured against the labels.
+ *
+ * The teacher runs one batch ahead, in the background, on its own thread:
+ * the next batch is copied and forwarded through the teacher while the
+ * current batch is trained.
+ *
+ * With a cache file, the outputs of the teacher are written during the
+ * first epoch and read from the file during the following epochs, without
+ * running the teacher. Since the outputs are stored per batch, the cache
+ * is only used while the order of the batches does not change: an epoch
+ * started with a shuffle invalidates it.
+ *
+ * \tparam Teacher The type of the teacher network
+ * \tparam Generator The type of the wrapped generator
+ */
+template <typename Teacher, typename Generator>
+struct distill_generator {
+    using teacher_t   = Teacher;   ///< The type of the teacher network
+    using generator_t = Generator; ///< The type of the wrapped generator
+
+    using weight = typename teacher_t::weight; ///< The type of the values
+
+    using data_batch_t  = etl::dyn_matrix<weight, etl::decay_traits<decltype(std::declval<const generator_t&>().data_batch())>::dimensions()>;  ///< The type of a batch of samples
+    using label_batch_t = etl::dyn_matrix<weight, etl::decay_traits<decltype(std::declval<const generator_t&>().label_batch())>::dimensions()>; ///< The type of a batch of labels
+
+    static constexpr bool dll_generator = true; ///< Simple flag to indicate that the class is a DLL generator
+
+    static constexpr size_t batch_size = generator_t::batch_size; ///< The size of the generated batches
+
+    /*!
+     * \brief Construct a new distill_generator
+     * \param teacher The teacher network
+     * \param generator The generator of the samples and of the hard labels
+     * \param options The options of the distillation
+     */
+    distill_generator(const teacher_t& teacher, generator_t& generator, const distill_options& options)
+            : teacher(teacher), generator(generator), options(options) {}
+
+    distill_generator(const distill_generator& rhs) = delete;
+    distill_generator& operator=(const distill_generator& rhs) = delete;
+
+    /*!
+     * \brief Wait for the batches being forwarded in the background
+     */
+    ~distill_generator() {
+        discard();
+    }
+
+    /*!
+     * \brief Set the generator in test mode (hard labels), restarting the
+     * epoch if it has started
+     */
+    void set_test() {
+        restart();
+        generator.set_test();
+        training = false;
+    }
+
+    /*!
+     * \brief Set the generator in train mode (soft targets), restarting the
+     * epoch if it has started
+     */
+    void set_train() {
+        restart();
+        generator.set_train();
+        training = true;
+    }
+
+    /*!
+     * \brief Indicates that the generator must keep its data.
+     */
+    void set_safe() {
+        generator.set_safe();
+    }
+
+    /*!
+     * \brief Release the memory of the generator.
+     */
+    void clear() {
+        generator.clear();
+    }
+
+    /*!
+     * \brief Reset the generator to the beginning
+     */
+    void reset() {
+        discard();
+
+        // A complete epoch has been written in the order of the batches
+        if (writing && written == batches()) {
+            cached = true;
+        }
+
+        writing = false;
+        ordered = true;
+
+        generator.reset();
+    }
+
+    /*!
+     * \brief Reset the generator to the beginning and shuffle the data
+     */
+    void reset_shuffle() {
+        discard();
+
+        // The outputs of the teacher are cached in the previous order
+        cached  = false;
+        writing = false;
+        ordered = false;
+
+        generator.reset_shuffle();
+    }
+
+    /*!
+     * \brief Prepare the wrapped generator for the epoch
+     */
+    void prepare_epoch() {
+        generator.prepare_epoch();
+    }
+
+    /*!
+     * \brief Returns the number of samples of the generator
+     */
+    size_t size() const {
+        return generator.size();
+    }
+
+    /*!
+     * \brief Returns the number of batches of the generator
+     */
+    size_t batches() const {
+        return generator.batches();
+    }
+
+    /*!
+     * \brief Returns the memory of the wrapped generator and of the copied
+     * batches (bytes)
+     */
+    size_t memory() const {
+        size_t bytes = memory_bytes(generator);
+
+        for (auto& slot : slots) {
+            bytes += memory_bytes(slot.data, slot.labels, slot.targets);
+        }
+
+        return bytes;
+    }
+
+    /*!
+     * \brief Returns the index of the current batch
+     */
+    size_t current_batch() const {
+        return current;
+    }
+
+    /*!
+     * \brief Indicates if there is a next batch
+     */
+    bool has_next_batch() const {
+        return current < batches();
+    }
+
+    /*!
+     * \brief Move to the next batch
+     */
+    void next_batch() {
+        prime();
+
+        slots[current % 2].pending = {};
+
+        ++current;
+
+        if (generator.has_next_batch()) {
+            load(slots[(current + 1) % 2], current + 1);
+        }
+    }
+
+    /*!
+     * \brief Returns the current batch of samples
+     */
+    const data_batch_t& data_batch() const {
+        prime();
+
+        return slots[current % 2].data;
+    }
+
+    /*!
+     * \brief Returns the current batch of soft targets (train mode) or of
+     * hard labels (test mode)
+     */
+    const label_batch_t& label_batch() const {
+        prime();
+
+        auto& slot = slots[current % 2];
+
+        if (!training) {
+            return slot.labels;
+        }
+
+        if (slot.pending.valid()) {
+            slot.pending.get();
+        }
+
+        return slot.targets;
+    }
+
+private:
+    /*!
+     * \brief A batch copied from the wrapped generator
+     */
+    struct batch_slot {
+        data_batch_t data;         ///< The samples
+        label_batch_t labels;      ///< The hard labels
+        label_batch_t targets;     ///< The soft targets
+        std::future<void> pending; ///< The soft targets being computed in the background
+    };
+
+    /*!
+     * \brief Copy the given batch into the given container, reallocating it
+     * if the shapes are different
+     */
+    template <typename Target, typename Batch>
+    static void copy_batch(Target& target, const Batch& batch) {
+        if (etl::size(target) == etl::size(batch) && etl::dim<0>(target) == etl::dim<0>(batch)) {
+            target = batch;
+        } else {
+            target = Target(batch);
+        }
+    }
+
+    /*!
+     * \brief Load the current and the next batches of the epoch, if not
+     * already done
+     */
+    void prime() const {
+        if (primed) {
+            return;
+        }
+
+        primed = true;
+
+        if (generator.has_next_batch()) {
+            load(slots[current % 2], current);
+        }
+
+        if (generator.has_next_batch()) {
+            load(slots[(current + 1) % 2], current + 1);
+        }
+    }
+
+    /*!
+     * \brief Copy the current batch of the wrapped generator into the given
+     * slot, start computing its soft targets and move the wrapped generator
+     * to its next batch
+     */
+    void load(batch_slot& slot, size_t batch) const {
+        copy_batch(slot.data, generator.data_batch());
+        copy_batch(slot.labels, generator.label_batch());
+
+        generator.next_batch();
+
+        if (!training) {
+            return;
+        }
+
+        copy_batch(slot.targets, slot.labels);
+
+        if (cached) {
+            read_cache(slot.targets, batch);
+            soften(slot);
+            return;
+        }
+
+        if (!options.cache.empty() && ordered && !writing && batch == 0) {
+            writing = true;
+            written = 0;
+        }
+
+        slot.pending = std::async(std::launch::async, [this, &slot, batch]() {
+            // The other threads are busy with the student
+            SERIAL_SECTION {
+                std::lock_guard<std::mutex> l(teacher_lock);
+
+                auto outputs = teacher.test_forward_batch(slot.data);
+
+                slot.targets = outputs;
+            }
+
+            if (writing) {
+                write_cache(slot.targets, batch);
+            }
+
+            soften(slot);
+        });
+    }
+
+    /*!
+     * \brief Soften the outputs of the teacher in the targets of the given
+     * slot and mix them with the hard labels
+     */
+    void soften(batch_slot& slot) const {
+        const size_t n       = etl::dim<0>(slot.targets);
+        const size_t classes = etl::size(slot.targets) / std::max(n, size_t(1));
+
+        const double power = 1.0 / options.temperature;
+
+        auto* targets      = slot.targets.memory_start();
+        const auto* labels = slot.labels.memory_start();
+
+        for (size_t i = 0; i < n; ++i) {
+            double sum = 0.0;
+
+            for (size_t c = 0; c < classes; ++c) {
+                targets[i * classes + c] = std::pow(std::max(targets[i * classes + c], weight(1e-30)), power);
+                sum += targets[i * classes + c];
+            }
+
+            for (size_t c = 0; c < classes; ++c) {
+                targets[i * classes + c] = options.alpha * targets[i * classes + c] / sum + (1.0 - options.alpha) * labels[i * classes + c];
+            }
+        }
+
+        slot.targets.invalidate_gpu();
+    }
+
+    /*!
+     * \brief Write the outputs of the teacher for the given batch to the
+     * cache file
+     */
+    void write_cache(const label_batch_t& outputs, size_t batch) const {
+        std::lock_guard<std::mutex> l(cache_lock);
+
+        if (!cache_file.is_open()) {
+            cache_file.open(options.cache, std::ios::in | std::ios::out | std::ios::binary | std::ios::trunc);
+        }
+
+        const size_t stride = batch_size * (etl::size(outputs) / etl::dim<0>(outputs));
+
+        cache_file.seekp(batch * stride * sizeof(weight));
+        cache_file.write(reinterpret_cast<const char*>(outputs.memory_start()), etl::size(outputs) * sizeof(weight));
+
+        if (cache_file) {
+            ++written;
+        } else {
+            std::cerr << "ERROR: Impossible to write the outputs of the teacher to " << options.cache << std::endl;
+            cache_file.clear();
+        }
+    }
+
+    /*!
+     * \brief Read the outputs of the teacher for the given batch from the
+     * cache file
+     */
+    void read_cache(label_batch_t& outputs, size_t batch) const {
+        std::lock_guard<std::mutex> l(cache_lock);
+
+        const size_t stride = batch_size * (etl::size(outputs) / etl::dim<0>(outputs));
+
+        cache_file.seekg(batch * stride * sizeof(weight));
+        cache_file.read(reinterpret_cast<char*>(outputs.memory_start()), etl::size(outputs) * sizeof(weight));
+    }
+
+    /*!
+     * \brief Discard the loaded batches and restart the wrapped generator,
+     * if the epoch has started
+     */
+    void restart() {
+        if (primed) {
+            discard();
+            generator.reset();
+        }
+    }
+
+    /*!
+     * \brief Wait for the batches being forwarded, if any, discard them and
+     * restart from the first batch
+     */
+    void discard() {
+        for (auto& slot : slots) {
+            if (slot.pending.valid()) {
+                slot.pending.wait();
+            }
+
+            slot.pending = {};
+        }
+
+        current = 0;
+        primed  = false;
+    }
+
+    const teacher_t& teacher;      ///< The teacher network
+    generator_t& generator;        ///< The wrapped generator
+    const distill_options options; ///< The options of the distillation
+
+    size_t current = 0;   ///< The index of the current batch
+    bool training = true; ///< Indicates if the generator is in train mode
+
+    mutable batch_slot slots[2]; ///< The current and the next batches
+    mutable bool primed = false; ///< Indicates if the first batches of the epoch are loaded
+
+    bool ordered = true;                    ///< Indicates if the epoch was started without a shuffle
+    bool cached  = false;                   ///< Indicates if the cache holds the outputs of a complete epoch
+    mutable bool writing = false;           ///< Indicates if the outputs of the epoch are written to the cache
+    mutable std::atomic<size_t> written{0}; ///< The number of batches written to the cache in the epoch
+
+    mutable std::mutex teacher_lock; ///< The lock serializing the forward passes of the teacher
+    mutable std::mutex cache_lock;   ///< The lock of the cache file
+    mutable std::fstream cache_file; ///< The cache file
+};
+
+/*!
+ * \brief Create a generator adaptor replacing the labels of the given
+ * generator by the soft targets of the given teacher.
+ * \param teacher The teacher network
+ * \param generator The generator to wrap
+ * \param options The options of the distillation
+ * \return The generator adaptor
+ */
+template <typename Teacher, typename Generator>
+distill_generator<Teacher, Generator> make_distill_generator(const Teacher& teacher, Generator& generator, const distill_options& options) {
+    return {teacher, generator, options};
+}
+
+} //end of dll namespace
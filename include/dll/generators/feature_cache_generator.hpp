@@ -0,0 +1,512 @@
+//=======================================================================
+// Copyright (c) 2014-2017 Baptiste Wicht
+// Distributed under the terms of the MIT License.
+// (See accompanying file LICENSE or copy at
+//  http://opensource.org/licenses/MIT)
+//=======================================================================
+
+/*!
+ * \file
+ * \brief Generator of the features of the frozen first layers of a network,
+ * computed once and cached in memory or in a memory-mapped file.
+ */
+
+#pragma once
+
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <numeric>
+#include <string>
+#include <vector>
+
+#include "cpp_utils/assert.hpp"
+
+#include "etl/etl.hpp"
+
+#include "dll/util/compact_model.hpp" // for the half-precision conversions
+#include "dll/util/memory.hpp"
+#include "dll/util/random.hpp"
+#include "dll/util/timers.hpp"
+
+namespace dll {
+
+/*!
+ * \brief The options of the cache of the features of the frozen layers of
+ * a network during fine-tuning
+ */
+struct feature_cache_options {
+    bool enabled            = false;               ///< Indicates if the features of the frozen layers are cached
+    model_encoding encoding = model_encoding::RAW; ///< The storage of the features (RAW, FP16 or BF16)
+    std::string file;                              ///< The file backing the cache (empty to keep it in memory)
+};
+
+/*!
+ * \brief A generator of the outputs of the first layers of a network.
+ *
+ * The wrapped generator is forwarded once, in test mode, through the
+ * layers [0, prefix), and the outputs of the last of these layers are
+ * stored, flattened, along with the labels. The epochs are then generated
+ * from the cache without running these layers again. The samples of the
+ * wrapped generator must not be augmented.
+ *
+ * The features can be stored in half precision (FP16 or BF16) and kept in
+ * a memory-mapped file, whose pages are only loaded when they are read.
+ *
+ * \tparam DBN The type of the network
+ * \tparam Generator The type of the wrapped generator
+ */
+template <typename DBN, typename Generator>
+struct feature_cache_generator {
+    using dbn_t       = DBN;       ///< The type of the network
+    using generator_t = Generator; ///< The type of the wrapped generator
+
+    using weight = typename dbn_t::weight; ///< The type of the values
+
+    static constexpr size_t label_dimensions = etl::decay_traits<decltype(std::declval<const generator_t&>().label_batch())>::dimensions(); ///< The dimensions of a batch of labels
+
+    using data_batch_t  = etl::dyn_matrix<weight, 2>;                ///< The type of a batch of features [B, F]
+    using label_batch_t = etl::dyn_matrix<weight, label_dimensions>; ///< The type of a batch of labels
+
+    static constexpr bool dll_generator = true; ///< Simple flag to indicate that the class is a DLL generator
+
+    static constexpr size_t batch_size = generator_t::batch_size; ///< The size of the generated batches
+
+    /*!
+     * \brief Cache the features of the given generator
+     * \param dbn The network
+     * \param generator The generator of the inputs of the network
+     * \param prefix The number of layers whose output is cached (at least 1)
+     * \param options The options of the cache
+     */
+    feature_cache_generator(const dbn_t& dbn, generator_t& generator, size_t prefix, const feature_cache_options& options)
+            : cached_layers(prefix), encoding(options.encoding) {
+        if (encoding != model_encoding::RAW && encoding != model_encoding::FP16 && encoding != model_encoding::BF16) {
+            std::cerr << "WARNING: The features can only be cached as RAW, FP16 or BF16, they are stored as RAW" << std::endl;
+            encoding = model_encoding::RAW;
+        }
+
+        value_size = encoding == model_encoding::RAW ? sizeof(weight) : sizeof(uint16_t);
+
+        build(dbn, generator, options.file);
+    }
+
+    feature_cache_generator(const feature_cache_generator& rhs) = delete;
+    feature_cache_generator& operator=(const feature_cache_generator& rhs) = delete;
+
+    /*!
+     * \brief Release the storage of the cache
+     */
+    ~feature_cache_generator() {
+        if (mapping) {
+            ::munmap(mapping, length);
+        }
+    }
+
+    /*!
+     * \brief Indicates if the features have been cached
+     */
+    bool valid() const {
+        return samples > 0;
+    }
+
+    /*!
+     * \brief Returns the number of layers whose output is cached
+     */
+    size_t prefix() const {
+        return cached_layers;
+    }
+
+    /*!
+     * \brief Returns the number of values of the features of a sample
+     */
+    size_t features() const {
+        return F;
+    }
+
+    /*!
+     * \brief Set the generator in test mode
+     */
+    void set_test() {
+        // Nothing to do
+    }
+
+    /*!
+     * \brief Set the generator in train mode
+     */
+    void set_train() {
+        // Nothing to do
+    }
+
+    /*!
+     * \brief Indicates that the generator must keep its data.
+     */
+    void set_safe() {
+        // Nothing to do
+    }
+
+    /*!
+     * \brief Release the memory of the generator.
+     *
+     * The cache is kept until the generator is destroyed.
+     */
+    void clear() {
+        // Nothing to do
+    }
+
+    /*!
+     * \brief Reset the generator to the beginning
+     */
+    void reset() {
+        current = 0;
+        ready   = false;
+    }
+
+    /*!
+     * \brief Reset the generator to the beginning and shuffle the samples
+     */
+    void reset_shuffle() {
+        reset();
+
+        std::shuffle(order.begin(), order.end(), dll::rand_engine());
+    }
+
+    /*!
+     * \brief Prepare the dataset for an epoch
+     */
+    void prepare_epoch() {
+        // Nothing can be done here
+    }
+
+    /*!
+     * \brief Returns the number of samples of the generator
+     */
+    size_t size() const {
+        return samples;
+    }
+
+    /*!
+     * \brief Returns the number of batches of the generator
+     */
+    size_t batches() const {
+        return (samples + batch_size - 1) / batch_size;
+    }
+
+    /*!
+     * \brief Returns the memory of the cache kept in memory and of the
+     * current batch (bytes)
+     */
+    size_t memory() const {
+        return memory_values.size() + memory_bytes(labels, batch, labels_batch);
+    }
+
+    /*!
+     * \brief Returns the index of the current batch
+     */
+    size_t current_batch() const {
+        return current / batch_size;
+    }
+
+    /*!
+     * \brief Indicates if there is a next batch
+     */
+    bool has_next_batch() const {
+        return current < samples;
+    }
+
+    /*!
+     * \brief Move to the next batch
+     */
+    void next_batch() {
+        current += batch_size;
+        ready = false;
+    }
+
+    /*!
+     * \brief Returns the features of the current batch
+     */
+    const data_batch_t& data_batch() const {
+        prime();
+
+        return batch;
+    }
+
+    /*!
+     * \brief Returns the labels of the current batch
+     */
+    const label_batch_t& label_batch() const {
+        prime();
+
+        return labels_batch;
+    }
+
+private:
+    /*!
+     * \brief Forward the wrapped generator through the layers and store the
+     * outputs of the last cached layer
+     */
+    void build(const dbn_t& dbn, generator_t& generator, const std::string& file) {
+        dll::auto_timer timer("net:feature_cache:build");
+
+        const size_t n = generator.size();
+
+        generator.set_test();
+        generator.reset();
+
+        size_t first = 0;
+
+        while (generator.has_next_batch() && first < n) {
+            const auto& inputs  = generator.data_batch();
+            const auto& targets = generator.label_batch();
+
+            const size_t b = std::min(size_t(etl::dim<0>(inputs)), n - first);
+
+            bool stored = true;
+
+            forward_prefix(dbn, inputs, [&](auto& output) {
+                if (!first && !allocate(etl::size(output) / etl::dim<0>(output), n, file)) {
+                    stored = false;
+                    return;
+                }
+
+                output.ensure_cpu_up_to_date();
+
+                encode(output.memory_start(), first, b);
+            });
+
+            if (!stored) {
+                return;
+            }
+
+            store_labels(targets, first, b, n);
+
+            first += b;
+
+            generator.next_batch();
+        }
+
+        generator.reset();
+
+        samples = first;
+
+        order.resize(samples);
+        std::iota(order.begin(), order.end(), size_t(0));
+    }
+
+    /*!
+     * \brief Forward the inputs through the layers [0, cached_layers) and
+     * call the functor with the output of the last one
+     */
+    template <size_t L = 0, typename Inputs, typename Functor>
+    void forward_prefix(const dbn_t& dbn, const Inputs& inputs, Functor&& functor) {
+        if constexpr (L + 1 < dbn_t::layers) {
+            if (L + 1 == cached_layers) {
+                auto output = dbn.template forward_batch<L>(inputs);
+
+                functor(output);
+            } else {
+                forward_prefix<L + 1>(dbn, inputs, functor);
+            }
+        } else {
+            cpp_unused(dbn);
+            cpp_unused(inputs);
+            cpp_unused(functor);
+        }
+    }
+
+    /*!
+     * \brief Allocate the storage of the features of n samples
+     */
+    bool allocate(size_t features, size_t n, const std::string& file) {
+        F      = features;
+        length = n * F * value_size;
+
+        if (file.empty()) {
+            memory_values.resize(length);
+            values = memory_values.data();
+            return true;
+        }
+
+        int fd = ::open(file.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+
+        if (fd < 0) {
+            std::cerr << "ERROR: Impossible to create the feature cache " << file << std::endl;
+            return false;
+        }
+
+        bool ok = ::ftruncate(fd, length) == 0;
+
+        if (ok) {
+            mapping = ::mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+
+            if (mapping == MAP_FAILED) {
+                mapping = nullptr;
+                ok      = false;
+            }
+        }
+
+        // The file only backs the pages of the mapping
+        ::close(fd);
+        ::unlink(file.c_str());
+
+        if (!ok) {
+            std::cerr << "ERROR: Impossible to map the feature cache " << file << std::endl;
+            return false;
+        }
+
+        values = static_cast<char*>(mapping);
+
+        return true;
+    }
+
+    /*!
+     * \brief Store the features of the samples [first, first + b)
+     */
+    void encode(const weight* output, size_t first, size_t b) {
+        const size_t count = b * F;
+
+        char* target = values + first * F * value_size;
+
+        if (encoding == model_encoding::RAW) {
+            std::memcpy(target, output, count * sizeof(weight));
+        } else {
+            auto* half = reinterpret_cast<uint16_t*>(target);
+
+            for (size_t i = 0; i < count; ++i) {
+                half[i] = encoding == model_encoding::FP16 ? float_to_half(float(output[i])) : float_to_bf16(float(output[i]));
+            }
+        }
+    }
+
+    /*!
+     * \brief Decode the features of the sample s into the given row
+     */
+    void decode(size_t s, weight* row) const {
+        const char* source = values + s * F * value_size;
+
+        if (encoding == model_encoding::RAW) {
+            std::memcpy(row, source, F * sizeof(weight));
+        } else {
+            auto* half = reinterpret_cast<const uint16_t*>(source);
+
+            for (size_t i = 0; i < F; ++i) {
+                row[i] = encoding == model_encoding::FP16 ? half_to_float(half[i]) : bf16_to_float(half[i]);
+            }
+        }
+    }
+
+    /*!
+     * \brief Store the labels of the samples [first, first + b) of the n
+     * samples
+     */
+    template <typename Targets>
+    void store_labels(const Targets& targets, size_t first, size_t b, size_t n) {
+        const size_t LF = etl::size(targets) / etl::dim<0>(targets);
+
+        if (!first) {
+            for (size_t d = 1; d < label_dimensions; ++d) {
+                label_dims[d] = etl::dim(targets, d);
+            }
+
+            labels.resize(LF * n);
+        }
+
+        targets.ensure_cpu_up_to_date();
+
+        std::copy_n(targets.memory_start(), b * LF, labels.begin() + first * LF);
+    }
+
+    /*!
+     * \brief Fill the batches of the current samples
+     */
+    void prime() const {
+        if (ready) {
+            return;
+        }
+
+        const size_t b  = std::min(batch_size, samples - current);
+        const size_t LF = samples ? labels.size() / samples : 0;
+
+        if (etl::dim<0>(batch) != b) {
+            batch        = data_batch_t(b, F);
+            labels_batch = make_label_batch(b, std::make_index_sequence<label_dimensions - 1>());
+        }
+
+        for (size_t i = 0; i < b; ++i) {
+            const size_t s = order[current + i];
+
+            decode(s, batch.memory_start() + i * F);
+
+            std::copy_n(labels.begin() + s * LF, LF, labels_batch.memory_start() + i * LF);
+        }
+
+        batch.invalidate_gpu();
+        labels_batch.invalidate_gpu();
+
+        ready = true;
+    }
+
+    /*!
+     * \brief Create a batch of b labels
+     */
+    template <size_t... I>
+    label_batch_t make_label_batch(size_t b, std::index_sequence<I...> /*seq*/) const {
+        return label_batch_t(b, label_dims[I + 1]...);
+    }
+
+    size_t cached_layers;    ///< The number of layers whose output is cached
+    model_encoding encoding; ///< The storage of the features
+    size_t value_size = 0;   ///< The size of a stored value (bytes)
+
+    size_t samples = 0; ///< The number of cached samples
+    size_t F       = 0; ///< The number of values of the features of a sample
+
+    std::vector<char> memory_values; ///< The features, when kept in memory
+    void* mapping = nullptr;         ///< The mapping of the file of the features
+    size_t length = 0;               ///< The size of the features (bytes)
+    char* values  = nullptr;         ///< The stored features
+
+    std::vector<weight> labels;                        ///< The labels of all the samples
+    std::array<size_t, label_dimensions> label_dims{}; ///< The dimensions of the labels of a sample
+
+    std::vector<size_t> order; ///< The order of the samples in the epoch
+    size_t current = 0;        ///< The index of the first sample of the current batch
+
+    mutable data_batch_t batch;         ///< The features of the current batch
+    mutable label_batch_t labels_batch; ///< The labels of the current batch
+    mutable bool ready = false;         ///< Indicates if the current batches have been filled
+};
+
+/*!
+ * \brief Traits to test if a generator is a cache of the features of the
+ * first layers of a network
+ */
+template <typename Generator>
+struct is_feature_cache : std::false_type {};
+
+/*!
+ * \copydoc is_feature_cache
+ */
+template <typename DBN, typename Generator>
+struct is_feature_cache<feature_cache_generator<DBN, Generator>> : std::true_type {};
+
+/*!
+ * \brief Indicates if the samples of the given generator are never
+ * augmented, so that the features of its samples can be cached
+ */
+template <typename Generator, typename Enable = void>
+struct is_cacheable_generator : std::false_type {};
+
+/*!
+ * \copydoc is_cacheable_generator
+ */
+template <typename Generator>
+struct is_cacheable_generator<Generator, std::void_t<typename Generator::desc>> : std::bool_constant<!is_augmented<typename Generator::desc>> {};
+
+} //end of dll namespace
@@ -0,0 +1,237 @@
+//=======================================================================
+// Copyright (c) 2014-2017 Baptiste Wicht
+// Distributed under the terms of the MIT License.
+// (See accompanying file LICENSE or copy at
+//  http://opensource.org/licenses/MIT)
+//=======================================================================
+
+/*!
+ * \file
+ * \brief Generator adaptor forwarding the batches through the first layers
+ * of a network.
+ */
+
+#pragma once
+
+#include <future>
+
+namespace dll {
+
+/*!
+ * \brief A generator adaptor forwarding each batch of a generator through
+ * the layers [0, L] of a network.
+ *
+ * The layers are applied on the fly instead of storing the representation
+ * of the complete dataset. The labels of the generated batches are the
+ * forwarded batches themselves, for unsupervised training of the layer L + 1.
+ *
+ * The batches are double-buffered: while the current batch is consumed, the
+ * next batch is read from the wrapped generator and forwarded in the
+ * background.
+ *
+ * \tparam DBN The type of the network
+ * \tparam L The last layer applied to the batches
+ * \tparam Generator The type of the wrapped generator
+ */
+template <typename DBN, size_t L, typename Generator>
+struct forward_generator {
+    using dbn_t       = DBN;       ///< The type of the network
+    using generator_t = Generator; ///< The type of the wrapped generator
+
+    using batch_t = std::decay_t<decltype(std::declval<const dbn_t&>().template forward_batch<L>(std::declval<const generator_t&>().data_batch()))>; ///< The type of a forwarded batch
+
+    static constexpr bool dll_generator = true; ///< Simple flag to indicate that the class is a DLL generator
+
+    static constexpr size_t batch_size = generator_t::batch_size; ///< The size of the generated batches
+
+    /*!
+     * \brief Construct a new forward_generator
+     * \param dbn The network whose layers are applied
+     * \param generator The generator of the inputs of the network
+     */
+    forward_generator(const dbn_t& dbn, generator_t& generator) : dbn(dbn), generator(generator) {}
+
+    forward_generator(const forward_generator& rhs) = delete;
+    forward_generator& operator=(const forward_generator& rhs) = delete;
+
+    /*!
+     * \brief Wait for the batch being forwarded in the background
+     */
+    ~forward_generator() {
+        wait();
+    }
+
+    /*!
+     * \brief Set the generator in test mode
+     */
+    void set_test() {
+        wait();
+        generator.set_test();
+    }
+
+    /*!
+     * \brief Set the generator in train mode
+     */
+    void set_train() {
+        wait();
+        generator.set_train();
+    }
+
+    /*!
+     * \brief Indicates that the generator must keep its data.
+     *
+     * The wrapped generator is never released by the adaptor.
+     */
+    void set_safe() {
+        // Nothing to do
+    }
+
+    /*!
+     * \brief Release the memory of the generator.
+     *
+     * The wrapped generator is never released by the adaptor since it is
+     * still needed by the following layers.
+     */
+    void clear() {
+        // Nothing to do
+    }
+
+    /*!
+     * \brief Reset the generator to the beginning
+     */
+    void reset() {
+        discard();
+        generator.reset();
+    }
+
+    /*!
+     * \brief Reset the generator to the beginning and shuffle the data
+     */
+    void reset_shuffle() {
+        discard();
+        generator.reset_shuffle();
+    }
+
+    /*!
+     * \brief Returns the number of samples of the generator
+     */
+    size_t size() const {
+        return generator.size();
+    }
+
+    /*!
+     * \brief Returns the number of batches of the generator
+     */
+    size_t batches() const {
+        return generator.batches();
+    }
+
+    /*!
+     * \brief Indicates if there is a next batch
+     */
+    bool has_next_batch() const {
+        return current < generator.size();
+    }
+
+    /*!
+     * \brief Move to the next batch
+     */
+    void next_batch() {
+        // The wrapped generator is only advanced by the forwarding
+        if (!ready) {
+            data_batch();
+        }
+
+        current += batch_size;
+        ready = false;
+    }
+
+    /*!
+     * \brief Returns the current batch, forwarded through the layers
+     */
+    const batch_t& data_batch() const {
+        if (!ready) {
+            // The first batch of an epoch is forwarded on demand
+            if (!pending.valid()) {
+                launch();
+            }
+
+            batch = pending.get();
+            ready = true;
+
+            // Forward the next batch while this one is consumed
+            if (generator.has_next_batch()) {
+                launch();
+            }
+        }
+
+        return batch;
+    }
+
+    /*!
+     * \brief Returns the labels of the current batch, i.e. the forwarded
+     * batch itself
+     */
+    const batch_t& label_batch() const {
+        return data_batch();
+    }
+
+private:
+    /*!
+     * \brief Forward the current batch of the wrapped generator in the
+     * background and move the wrapped generator to its next batch
+     */
+    void launch() const {
+        pending = std::async(std::launch::async, [this]() {
+            auto next = dbn.template forward_batch<L>(generator.data_batch());
+
+            generator.next_batch();
+
+            return next;
+        });
+    }
+
+    /*!
+     * \brief Wait for the batch being forwarded, if any
+     */
+    void wait() const {
+        if (pending.valid()) {
+            pending.wait();
+        }
+    }
+
+    /*!
+     * \brief Wait for the batch being forwarded, if any, discard it and
+     * restart from the first batch
+     */
+    void discard() {
+        wait();
+
+        pending = {};
+        current = 0;
+        ready   = false;
+    }
+
+    const dbn_t& dbn;       ///< The network
+    generator_t& generator; ///< The wrapped generator
+
+    size_t current = 0; ///< The index of the first sample of the current batch
+
+    mutable batch_t batch;                ///< The current forwarded batch
+    mutable bool ready = false;           ///< Indicates if the current batch has already been forwarded
+    mutable std::future<batch_t> pending; ///< The next batch, being forwarded in the background
+};
+
+/*!
+ * \brief Create a generator adaptor forwarding the batches of the given
+ * generator through the layers [0, L] of the given network.
+ * \param dbn The network
+ * \param generator The generator to wrap
+ * \return The generator adaptor
+ */
+template <size_t L, typename DBN, typename Generator>
+forward_generator<DBN, L, Generator> make_forward_generator(const DBN& dbn, Generator& generator) {
+    return {dbn, generator};
+}
+
+} //end of dll namespace
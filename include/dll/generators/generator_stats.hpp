@@ -0,0 +1,161 @@
+//=======================================================================
+// Copyright (c) 2014-2017 Baptiste Wicht
+// Distributed under the terms of the MIT License.
+// (See accompanying file LICENSE or copy at
+//  http://opensource.org/licenses/MIT)
+//=======================================================================
+
+/*!
+ * \file
+ * \brief Counters of the throughput and the starvation of the generators
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+
+#include "dll/util/timers.hpp" // for duration_str
+
+namespace dll {
+
+/*!
+ * \brief Counters of a generator: how often (and how long) the consumer
+ * waited for a batch, how long the producers took to fill a batch and how
+ * many batches were ready when the consumer asked for one.
+ *
+ * All the durations are in nanoseconds. The counters of each generator are
+ * also added to the counters of their parent, if any.
+ */
+struct generator_stats {
+    static constexpr size_t bins = 17; ///< The number of bins of the occupancy histogram (the last one is for 16 and more)
+
+    std::atomic<size_t> waits;           ///< The number of times the consumer blocked
+    std::atomic<size_t> wait_duration;   ///< The total time the consumer blocked
+    std::atomic<size_t> fills;           ///< The number of batches filled by the producers
+    std::atomic<size_t> fill_duration;   ///< The total time spent filling the batches
+    std::atomic<size_t> occupancy[bins]; ///< The number of ready batches seen by the consumer
+
+    generator_stats* parent; ///< The counters to which these counters are added
+
+    /*!
+     * \brief Create new counters
+     * \param parent The counters to which these counters are added
+     */
+    explicit generator_stats(generator_stats* parent = nullptr) : parent(parent) {
+        reset();
+    }
+
+    /*!
+     * \brief Reset all the counters to zero
+     */
+    void reset() {
+        waits.store(0, std::memory_order_relaxed);
+        wait_duration.store(0, std::memory_order_relaxed);
+        fills.store(0, std::memory_order_relaxed);
+        fill_duration.store(0, std::memory_order_relaxed);
+
+        for (auto& bin : occupancy) {
+            bin.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    /*!
+     * \brief Returns the current time, in nanoseconds
+     */
+    static size_t now() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    /*!
+     * \brief Record a wait of the consumer
+     * \param duration The duration of the wait
+     */
+    void add_wait(size_t duration) {
+        waits.fetch_add(1, std::memory_order_relaxed);
+        wait_duration.fetch_add(duration, std::memory_order_relaxed);
+
+        if (parent) {
+            parent->add_wait(duration);
+        }
+    }
+
+    /*!
+     * \brief Record the fill of a batch by a producer
+     * \param duration The duration of the fill
+     */
+    void add_fill(size_t duration) {
+        fills.fetch_add(1, std::memory_order_relaxed);
+        fill_duration.fetch_add(duration, std::memory_order_relaxed);
+
+        if (parent) {
+            parent->add_fill(duration);
+        }
+    }
+
+    /*!
+     * \brief Record the number of ready batches when the consumer asked for one
+     * \param ready The number of ready batches
+     */
+    void add_occupancy(size_t ready) {
+        occupancy[std::min(ready, bins - 1)].fetch_add(1, std::memory_order_relaxed);
+
+        if (parent) {
+            parent->add_occupancy(ready);
+        }
+    }
+
+    /*!
+     * \brief Returns the number of batches asked by the consumer
+     */
+    size_t batches() const {
+        size_t n = 0;
+
+        for (auto& bin : occupancy) {
+            n += bin.load(std::memory_order_relaxed);
+        }
+
+        return n;
+    }
+
+    /*!
+     * \brief Print the counters on one line to the given stream
+     */
+    void dump(std::ostream& os) const {
+        const size_t n  = batches();
+        const size_t f  = fills.load(std::memory_order_relaxed);
+        const size_t w  = waits.load(std::memory_order_relaxed);
+        const size_t fd = fill_duration.load(std::memory_order_relaxed);
+        const size_t wd = wait_duration.load(std::memory_order_relaxed);
+
+        os << "generator: " << n << " batches"
+           << ", fill " << duration_str(f ? double(fd) / f : 0.0, 3) << "/batch"
+           << ", blocked " << w << " times (" << duration_str(wd, 3) << ")"
+           << ", ready batches [";
+
+        bool first = true;
+
+        for (size_t b = 0; b < bins; ++b) {
+            const size_t count = occupancy[b].load(std::memory_order_relaxed);
+
+            if (count) {
+                os << (first ? "" : " ") << b << (b == bins - 1 ? "+" : "") << ":" << count;
+                first = false;
+            }
+        }
+
+        os << "]" << std::endl;
+    }
+};
+
+/*!
+ * \brief Returns the counters of all the generators together
+ */
+inline generator_stats& global_generator_stats() {
+    static generator_stats stats;
+    return stats;
+}
+
+} //end of dll namespace
@@ -12,8 +12,21 @@
 
 #pragma once
 
+#include <array>
 #include <atomic>
+#include <limits>
+#include <memory>
 #include <thread>
+#include <vector>
+#include <numeric>
+#include <utility>
+#include <algorithm>
+
+#include "dll/util/affinity.hpp"
+#include "dll/util/huge_pages.hpp"
+#include "dll/util/training_state.hpp"
+#include "dll/util/time_major.hpp"
+#include "dll/util/gpu_prefetch.hpp"
 
 namespace dll {
 
@@ -29,28 +42,98 @@ struct inmemory_data_generator;
 template <typename Iterator, typename LIterator, typename Desc>
 struct inmemory_data_generator<Iterator, LIterator, Desc, std::enable_if_t<!is_augmented<Desc>>> {
     using desc                 = Desc;                                                              ///< The generator descriptor
-    using weight               = etl::value_t<typename std::iterator_traits<Iterator>::value_type>; ///< The data type
+    using weight               = sample_value_t<typename std::iterator_traits<Iterator>::value_type>; ///< The data type
     using data_cache_helper_t  = cache_helper<Desc, Iterator>;                                      ///< The helper for the data cache
-    using label_cache_helper_t = label_cache_helper<Desc, weight, LIterator>;                       ///< The helper for the label cache
+    using label_cache_helper_t = std::conditional_t<
+        Desc::CompactLabels,
+        compact_label_cache_helper<Desc, weight, LIterator>,
+        label_cache_helper<Desc, weight, LIterator>>; ///< The helper for the label cache
 
     using data_cache_type  = typename data_cache_helper_t::cache_type;  ///< The type of the data cache
     using label_cache_type = typename label_cache_helper_t::cache_type; ///< The type of the label cache
 
+    using staging_type       = etl::dyn_matrix<weight, etl::dimensions<data_cache_type>()>; ///< The type of the widened batch
+    using label_staging_type = etl::dyn_matrix<weight, 2>;                                  ///< The type of the expanded label batch
+
     static constexpr bool dll_generator = true; ///< Simple flag to indicate that the class is a DLL generator
 
+    static constexpr bool compressed = !std::is_same<etl::value_t<data_cache_type>, weight>::value; ///< Indicates if the inputs are stored in a more compact type
+
+    static constexpr bool compact_labels = Desc::CompactLabels; ///< Indicates if the labels are stored as class indices
+
+    static constexpr bool bucketing = Desc::LengthBucketing;              ///< Indicates if the samples are bucketed by length
+    static constexpr bool indexed   = Desc::IndexedShuffle || bucketing; ///< Indicates if the samples are shuffled through their indices
+
+    static constexpr bool prefetch = desc::GpuPrefetch && gpu_prefetch_support(); ///< Indicates if the next batch is prefetched to the GPU
+
+    static constexpr size_t npos = std::numeric_limits<size_t>::max(); ///< The position of an empty prefetch slot
+
     static constexpr size_t batch_size = desc::BatchSize; ///< The size of the generated batches
 
+    /*!
+     * \brief Indicates if the labels can be the inputs themselves, for
+     * auto-encoders reconstructing their inputs.
+     */
+    static constexpr bool shareable_labels = desc::AutoEncoder && !compact_labels && std::is_same<data_cache_type, label_cache_type>::value;
+
+    static_assert(desc::Copy == 1, "copy augmentation is only useful in combination with another augmentation");
+
     data_cache_type input_cache;  ///< The input cache
     label_cache_type label_cache; ///< The label cache
 
-    size_t current = 0;     ///< The current index
-    bool is_safe   = false; ///< Indicates if the generator is safe to reclaim memory from
+    mutable staging_type staging;             ///< The widened or gathered batch (only used with compressed storage or indexed shuffle)
+    mutable label_staging_type label_staging; ///< The expanded label batch (only used with compact labels)
+    mutable label_cache_type label_gather;    ///< The gathered label batch (only used with indexed shuffle)
+
+    mutable gpu_batch_slots<weight, etl::dimensions<data_cache_type>()> data_slots; ///< The device copies of the current and next batches (only used with prefetch)
+    mutable std::array<size_t, 2> slot_position{{npos, npos}};                      ///< The position of the batch of each slot
+
+    std::vector<uint32_t> order;   ///< The order of the samples (only used with indexed shuffle or by a view)
+    std::vector<uint32_t> lengths; ///< The length of each sample (only used with length bucketing)
 
+    std::shared_ptr<const inmemory_data_generator> source; ///< The generator holding the caches of a view (nullptr if the generator holds its own caches)
+
+    size_t current     = 0;     ///< The current index
+    bool is_safe       = false; ///< Indicates if the generator is safe to reclaim memory from
+    bool shared_labels = false; ///< Indicates if the labels are the inputs themselves (no label cache)
+
+    /*!
+     * \brief Construct an empty inmemory data generator, to be filled with
+     * set_data_batch and set_label_batch and then finalized.
+     *
+     * When the same object is given as input and label, the generator is an
+     * auto-encoder of its inputs and no label cache is allocated.
+     */
     template <typename Input, typename Label>
     inmemory_data_generator(const Input& input, const Label& label, size_t n, size_t n_classes){
+        if constexpr (shareable_labels) {
+            shared_labels = static_cast<const void*>(&input) == static_cast<const void*>(&label);
+        }
+
         // Initialize both caches for enough elements
         data_cache_helper_t::init(n, &input, input_cache);
-        label_cache_helper_t::init(n, n_classes, &label, label_cache);
+
+        if (!shared_labels) {
+            label_cache_helper_t::init(n, n_classes, &label, label_cache);
+        }
+
+        advise_huge_pages(std::tie(input_cache, label_cache));
+
+        if constexpr (compressed || indexed) {
+            data_cache_helper_t::init(batch_size, &input, staging);
+        }
+
+        if constexpr (compact_labels) {
+            label_cache_helper_t::init_batch(n_classes, label_staging);
+        }
+
+        if constexpr (indexed) {
+            init_order(n, n_classes, &label);
+        }
+
+        if constexpr (prefetch) {
+            data_slots.init(2, batch_size, input_cache(0));
+        }
     }
 
     /*!
@@ -59,44 +142,187 @@ struct inmemory_data_generator<Iterator, LIterator, Desc, std::enable_if_t<!is_a
     inmemory_data_generator(Iterator first, Iterator last, LIterator lfirst, LIterator llast, size_t n_classes){
         const size_t n = std::distance(first, last);
 
+        // An auto-encoder trained on its own inputs does not need a copy of them
+        if constexpr (shareable_labels && std::is_same<Iterator, LIterator>::value) {
+            shared_labels = first == lfirst;
+        }
+
         data_cache_helper_t::init(n, first, input_cache);
-        label_cache_helper_t::init(n, n_classes, lfirst, label_cache);
+
+        if (!shared_labels) {
+            label_cache_helper_t::init(n, n_classes, lfirst, label_cache);
+        }
+
+        advise_huge_pages(std::tie(input_cache, label_cache));
+
+        if constexpr (compressed || indexed) {
+            data_cache_helper_t::init(batch_size, first, staging);
+        }
+
+        if constexpr (compact_labels) {
+            label_cache_helper_t::init_batch(n_classes, label_staging);
+        }
+
+        if constexpr (indexed) {
+            init_order(n, n_classes, lfirst);
+        }
+
+        if constexpr (prefetch) {
+            data_slots.init(2, batch_size, input_cache(0));
+        }
 
         // Fill the cache
 
-        size_t i = 0;
-        while (first != last) {
-            input_cache(i) = *first;
+        if constexpr (is_std_sample<typename std::iterator_traits<Iterator>::value_type>) {
+            // The samples are copied at once into the contiguous cache
+            converter_bulk::convert(first, last, input_cache);
 
-            label_cache_helper_t::set(i, lfirst, label_cache);
+            for (size_t i = 0; i < n && !shared_labels; ++i) {
+                label_cache_helper_t::set(i, lfirst, label_cache);
+                ++lfirst;
+            }
+        } else {
+            size_t i = 0;
+            while (first != last) {
+                if constexpr (compressed) {
+                    auto sample = *first;
+                    auto sub    = input_cache(i);
+                    std::copy(sample.begin(), sample.end(), sub.begin());
+                } else {
+                    input_cache(i) = *first;
+                }
 
-            ++i;
-            ++first;
-            ++lfirst;
+                if (!shared_labels) {
+                    label_cache_helper_t::set(i, lfirst, label_cache);
+                }
+
+                ++i;
+                ++first;
+                ++lfirst;
+            }
         }
 
-        // Transform if necessary
+        if constexpr (bucketing) {
+            init_lengths();
+        }
 
-        pre_scaler<desc>::transform_all(input_cache);
-        pre_normalizer<desc>::transform_all(input_cache);
-        pre_binarizer<desc>::transform_all(input_cache);
+        // Transform if necessary (compressed inputs are transformed batch by batch)
+
+        if constexpr (!compressed) {
+            pre_transformer<desc>::transform_all(input_cache);
+        }
 
         // In case of auto-encoders, the label images also need to be transformed
         if constexpr (desc::AutoEncoder) {
-            pre_scaler<desc>::transform_all(label_cache);
-            pre_normalizer<desc>::transform_all(label_cache);
-            pre_binarizer<desc>::transform_all(label_cache);
+            if (!shared_labels) {
+                pre_transformer<desc>::transform_all(label_cache);
+            }
         }
 
         cpp_unused(llast);
     }
 
+    /*!
+     * \brief Construct a view of some samples of another generator.
+     *
+     * The view does not copy the samples, it only holds their indices in
+     * the caches of the source generator, which must not be modified
+     * anymore. The samples are gathered batch by batch and only the indices
+     * are shuffled.
+     *
+     * \param source The generator holding the caches
+     * \param indices The indices of the samples of the view in the caches of the source
+     */
+    inmemory_data_generator(std::shared_ptr<const inmemory_data_generator> source, std::vector<uint32_t> indices)
+            : order(std::move(indices)), source(std::move(source)) {
+        const auto& inputs = this->source->input_cache;
+
+        staging = batch_like<staging_type>(inputs, std::make_index_sequence<etl::dimensions<data_cache_type>() - 1>());
+
+        if constexpr (compact_labels) {
+            label_staging = this->source->label_staging;
+        } else {
+            label_gather = batch_like<label_cache_type>(this->source->labels(), std::make_index_sequence<etl::dimensions<label_cache_type>() - 1>());
+        }
+
+        if constexpr (prefetch) {
+            data_slots.init(2, batch_size, inputs(0));
+        }
+    }
+
     inmemory_data_generator(const inmemory_data_generator& rhs) = delete;
     inmemory_data_generator operator=(const inmemory_data_generator& rhs) = delete;
 
     inmemory_data_generator(inmemory_data_generator&& rhs) = delete;
     inmemory_data_generator operator=(inmemory_data_generator&& rhs) = delete;
 
+    /*!
+     * \brief Create a batch of batch_size samples with the shape of the
+     * samples of the given cache
+     */
+    template <typename M, typename C, size_t... I>
+    static M batch_like(const C& cache, std::index_sequence<I...> /*seq*/) {
+        return M(batch_size, etl::dim<I + 1>(cache)...);
+    }
+
+    /*!
+     * \brief Returns the cache holding the inputs of the generator (the
+     * cache of the source of a view)
+     */
+    const data_cache_type& inputs() const {
+        return source ? source->input_cache : input_cache;
+    }
+
+    /*!
+     * \brief Initialize the order of the samples and the gathered label batch
+     * \param n The number of samples
+     * \param n_classes The number of classes
+     * \param it An iterator to a label
+     */
+    template <typename LIt>
+    void init_order(size_t n, size_t n_classes, const LIt& it) {
+        order.resize(n);
+        std::iota(order.begin(), order.end(), uint32_t(0));
+
+        if constexpr (!compact_labels) {
+            label_cache_helper_t::init(batch_size, n_classes, it, label_gather);
+        } else {
+            cpp_unused(n_classes);
+            cpp_unused(it);
+        }
+    }
+
+    /*!
+     * \brief Compute the length of each sample, the samples being
+     * zero-padded sequences [T, N]. This must be done before the inputs are
+     * transformed.
+     */
+    void init_lengths() {
+        static_assert(etl::dimensions<data_cache_type>() == 3, "Length bucketing is only supported for sequences [T, N]");
+
+        const size_t T = etl::dim<1>(input_cache);
+        const size_t N = etl::dim<2>(input_cache);
+
+        input_cache.ensure_cpu_up_to_date();
+
+        lengths.resize(size());
+
+        for (size_t i = 0; i < size(); ++i) {
+            lengths[i] = padded_length(input_cache.memory_start() + i * T * N, T, N);
+        }
+    }
+
+    /*!
+     * \brief Returns the index in the caches of the ith sample of the epoch
+     */
+    size_t sample_index(size_t i) const {
+        if constexpr (indexed) {
+            return order[i];
+        } else {
+            return source ? order[i] : i;
+        }
+    }
+
     /*!
      * \brief Display a description of the generator in the given stream
      * \param stream The stream to print to
@@ -138,6 +364,11 @@ struct inmemory_data_generator<Iterator, LIterator, Desc, std::enable_if_t<!is_a
         if (is_safe) {
             input_cache.clear();
             label_cache.clear();
+            staging.clear();
+            label_staging.clear();
+            label_gather.clear();
+            order.clear();
+            lengths.clear();
         }
     }
 
@@ -160,13 +391,14 @@ struct inmemory_data_generator<Iterator, LIterator, Desc, std::enable_if_t<!is_a
      */
     void reset() {
         current = 0;
+        slot_position.fill(npos);
     }
 
     /*!
      * \brief Reset the generator and shuffle the order of samples
      */
     void reset_shuffle() {
-        current = 0;
+        reset();
         shuffle();
     }
 
@@ -178,15 +410,51 @@ struct inmemory_data_generator<Iterator, LIterator, Desc, std::enable_if_t<!is_a
     void shuffle() {
         cpp_assert(!current, "Shuffle should only be performed on start of generation");
 
-        etl::parallel_shuffle(input_cache, label_cache, dll::random_engine());
+        if constexpr (bucketing) {
+            // The lengths are indexed by the samples of the caches
+            const auto& sample_lengths = source ? source->lengths : lengths;
+
+            // The samples of the same length are in random order
+            std::shuffle(order.begin(), order.end(), dll::random_engine());
+            std::stable_sort(order.begin(), order.end(), [&sample_lengths](uint32_t a, uint32_t b) { return sample_lengths[a] > sample_lengths[b]; });
+
+            // Shuffle the complete batches, the last one stays last
+            const size_t full = order.size() / batch_size;
+
+            std::vector<uint32_t> batch_order(full);
+            std::iota(batch_order.begin(), batch_order.end(), uint32_t(0));
+            std::shuffle(batch_order.begin(), batch_order.end(), dll::random_engine());
+
+            const std::vector<uint32_t> sorted(order);
+
+            for (size_t k = 0; k < full; ++k) {
+                std::copy_n(sorted.begin() + batch_order[k] * batch_size, batch_size, order.begin() + k * batch_size);
+            }
+        } else if constexpr (indexed) {
+            // Only the indices are permuted, the samples are gathered batch by batch
+            std::shuffle(order.begin(), order.end(), dll::random_engine());
+        } else if (source) {
+            // The caches of a view are shared, only its indices are permuted
+            std::shuffle(order.begin(), order.end(), dll::random_engine());
+        } else if (shared_labels) {
+            etl::shuffle(input_cache, dll::random_engine());
+        } else {
+            etl::parallel_shuffle(input_cache, label_cache, dll::random_engine());
+        }
     }
 
     /*!
      * \brief Prepare the dataset for an epoch
      */
     void prepare_epoch(){
-        input_cache.ensure_gpu_up_to_date();
+        // With prefetch, only the batches are moved to the GPU
+        if constexpr (!prefetch) {
+            input_cache.ensure_gpu_up_to_date();
+        }
+
         label_cache.ensure_gpu_up_to_date();
+
+        slot_position.fill(npos);
     }
 
     /*!
@@ -202,7 +470,44 @@ struct inmemory_data_generator<Iterator, LIterator, Desc, std::enable_if_t<!is_a
      * \return The number of elements in the generator
      */
     size_t size() const {
-        return etl::dim<0>(input_cache);
+        return source ? order.size() : etl::dim<0>(input_cache);
+    }
+
+    /*!
+     * \brief Returns the number of bytes of the caches of the generator
+     * (only the indices and the batches for a view)
+     */
+    size_t memory() const {
+        return memory_bytes(input_cache, label_cache, staging, label_staging, label_gather, order, lengths) + data_slots.memory();
+    }
+
+    /*!
+     * \brief Write the position of the generator in the epoch and the order
+     * of the samples.
+     *
+     * The order of the samples is only known with indexed shuffle, the
+     * samples shuffled in place are resumed in the order of the caches.
+     */
+    void store_state(std::ostream& os) const {
+        state_write(os, uint64_t(current));
+        state_write_raw(os, order.data(), order.size(), sizeof(uint32_t));
+    }
+
+    /*!
+     * \brief Read the position of the generator in the epoch and the order
+     * of the samples, written by store_state
+     * \return true if the state was read, false otherwise
+     */
+    bool load_state(std::istream& is) {
+        uint64_t position = 0;
+
+        if (!state_read(is, position) || position > size() || !state_read_raw(is, order.data(), order.size(), sizeof(uint32_t))) {
+            return false;
+        }
+
+        current = position;
+
+        return true;
     }
 
     /*!
@@ -214,7 +519,7 @@ struct inmemory_data_generator<Iterator, LIterator, Desc, std::enable_if_t<!is_a
      * \return The augmented number of elements in the generator
      */
     size_t augmented_size() const {
-        return etl::dim<0>(input_cache);
+        return size();
     }
 
     /*!
@@ -247,7 +552,80 @@ struct inmemory_data_generator<Iterator, LIterator, Desc, std::enable_if_t<!is_a
      * \return a a batch of data.
      */
     auto data_batch() const {
-        return etl::slice(input_cache, current, std::min(current + batch_size, size()));
+        if constexpr (prefetch) {
+            const size_t s    = current_batch() % 2;
+            const size_t next = current + batch_size;
+
+            if (slot_position[s] != current) {
+                data_slots.upload(s, host_data_batch(current));
+                slot_position[s] = current;
+            }
+
+            // The copy of the next batch overlaps with the training of this one
+            if (next < size() && slot_position[1 - s] != next) {
+                data_slots.upload(1 - s, host_data_batch(next));
+                slot_position[1 - s] = next;
+            }
+
+            return data_slots.batch(s);
+        } else {
+            return host_data_batch(current);
+        }
+    }
+
+    /*!
+     * \brief Returns the data batch starting at the given position, in host
+     * memory
+     */
+    auto host_data_batch(size_t position) const {
+        if constexpr (compressed) {
+            const size_t n      = std::min(batch_size, size() - position);
+            const size_t stride = etl::size(inputs()) / etl::dim<0>(inputs());
+
+            // Widen and scale the inputs in a single pass
+            for (size_t s = 0; s < n; ++s) {
+                const auto* in = inputs().memory_start() + sample_index(position + s) * stride;
+                auto* out      = staging.memory_start() + s * stride;
+
+                for (size_t i = 0; i < stride; ++i) {
+                    if constexpr (desc::ScalePre != 0) {
+                        out[i] = weight(in[i]) / weight(desc::ScalePre);
+                    } else {
+                        out[i] = weight(in[i]);
+                    }
+                }
+            }
+
+            staging.invalidate_gpu();
+
+            auto batch = etl::slice(staging, 0, n);
+
+            pre_transformer<desc, true>::transform_all(batch);
+
+            return batch;
+        } else if constexpr (indexed) {
+            const size_t n = std::min(batch_size, size() - position);
+
+            // Gather the samples of the batch in their shuffled order
+            for (size_t s = 0; s < n; ++s) {
+                staging(s) = inputs()(order[position + s]);
+            }
+
+            return etl::slice(staging, 0, n);
+        } else {
+            if (source) {
+                const size_t n = std::min(batch_size, size() - position);
+
+                // Gather the samples of the view from the shared cache
+                for (size_t s = 0; s < n; ++s) {
+                    staging(s) = inputs()(order[position + s]);
+                }
+
+                return etl::slice(std::as_const(staging), 0, n);
+            }
+
+            return etl::slice(input_cache, position, std::min(position + batch_size, size()));
+        }
     }
 
     /*!
@@ -255,7 +633,54 @@ struct inmemory_data_generator<Iterator, LIterator, Desc, std::enable_if_t<!is_a
      * \return a a batch of label.
      */
     auto label_batch() const {
-        return etl::slice(label_cache, current, std::min(current + batch_size, size()));
+        if constexpr (compact_labels) {
+            const size_t n = std::min(batch_size, size() - current);
+
+            if (indexed || source) {
+                label_cache_helper_t::expand(labels(), order.data() + current, n, label_staging);
+            } else {
+                label_cache_helper_t::expand(labels(), current, n, label_staging);
+            }
+
+            return etl::slice(label_staging, 0, n);
+        } else if constexpr (indexed) {
+            const size_t n = std::min(batch_size, size() - current);
+
+            for (size_t s = 0; s < n; ++s) {
+                label_gather(s) = labels()(order[current + s]);
+            }
+
+            return etl::slice(label_gather, 0, n);
+        } else {
+            if (source) {
+                const size_t n = std::min(batch_size, size() - current);
+
+                // Gather the labels of the view from the shared cache
+                for (size_t s = 0; s < n; ++s) {
+                    label_gather(s) = labels()(order[current + s]);
+                }
+
+                return etl::slice(std::as_const(label_gather), 0, n);
+            }
+
+            return etl::slice(labels(), current, std::min(current + batch_size, size()));
+        }
+    }
+
+    /*!
+     * \brief Returns the labels of the generator (the inputs themselves for
+     * an auto-encoder of its inputs)
+     */
+    const label_cache_type& labels() const {
+        if (source) {
+            return source->labels();
+        }
+
+        if constexpr (shareable_labels) {
+            return shared_labels ? input_cache : label_cache;
+        } else {
+            return label_cache;
+        }
     }
 
     /*!
@@ -275,6 +700,9 @@ struct inmemory_data_generator<Iterator, LIterator, Desc, std::enable_if_t<!is_a
      */
     template <typename Input>
     void set_label_batch(size_t i, Input&& input_batch) {
+        static_assert(!compact_labels || !sizeof(Input), "Compact labels cannot be set from a batch");
+        cpp_assert(!shared_labels, "The labels of an auto-encoder of its inputs cannot be set");
+
         etl::slice(label_cache, i, i + etl::dim<0>(input_batch)) = input_batch;
     }
 
@@ -282,15 +710,78 @@ struct inmemory_data_generator<Iterator, LIterator, Desc, std::enable_if_t<!is_a
      * \brief Finalize the dataset if it was filled directly after having being prepared.
      */
     void finalize_prepared_data() {
-        pre_scaler<desc>::transform_all(input_cache);
-        pre_normalizer<desc>::transform_all(input_cache);
-        pre_binarizer<desc>::transform_all(input_cache);
+        if constexpr (bucketing) {
+            init_lengths();
+        }
+
+        // Compressed inputs are transformed batch by batch
+        if constexpr (!compressed) {
+            pre_transformer<desc>::transform_all(input_cache);
+        }
+
+        // In case of auto-encoders, the label images also need to be transformed
+        if constexpr (desc::AutoEncoder) {
+            if (!shared_labels) {
+                pre_transformer<desc>::transform_all(label_cache);
+            }
+        }
+    }
+
+    /*!
+     * \brief Decode raw samples into the input cache and apply the
+     * transformations of the inputs on the fly.
+     *
+     * Different threads can decode different samples concurrently. Once
+     * all the samples are decoded, the generator must be finalized with
+     * finalize_decoded_data instead of finalize_prepared_data.
+     *
+     * \param i The index of the first decoded sample in the cache
+     * \param raw The first raw sample
+     * \param n The number of samples to decode
+     * \param raw_stride The distance between two raw samples
+     */
+    template <typename Raw>
+    void decode_data(size_t i, const Raw* raw, size_t n, size_t raw_stride) {
+        static_assert(!bucketing, "The lengths of the samples must be computed before their transformations");
+
+        using value_type = etl::value_t<data_cache_type>;
+
+        const size_t stride = etl::size(input_cache) / etl::dim<0>(input_cache);
+
+        for (size_t s = 0; s < n; ++s) {
+            const Raw* in   = raw + s * raw_stride;
+            value_type* out = input_cache.memory_start() + (i + s) * stride;
+
+            if constexpr (compressed) {
+                // Compressed inputs are transformed batch by batch
+                std::copy_n(in, stride, out);
+            } else {
+                // The scaling is fused with the conversion
+                for (size_t k = 0; k < stride; ++k) {
+                    if constexpr (desc::ScalePre != 0) {
+                        out[k] = value_type(in[k]) / value_type(desc::ScalePre);
+                    } else {
+                        out[k] = value_type(in[k]);
+                    }
+                }
+
+                pre_transformer<desc, true>::transform_raw(out, stride);
+            }
+        }
+    }
+
+    /*!
+     * \brief Finalize the dataset once it was filled with decode_data.
+     */
+    void finalize_decoded_data() {
+        input_cache.invalidate_gpu();
+        label_cache.invalidate_gpu();
 
         // In case of auto-encoders, the label images also need to be transformed
         if constexpr (desc::AutoEncoder) {
-            pre_scaler<desc>::transform_all(label_cache);
-            pre_normalizer<desc>::transform_all(label_cache);
-            pre_binarizer<desc>::transform_all(label_cache);
+            if (!shared_labels) {
+                pre_transformer<desc>::transform_all(label_cache);
+            }
         }
     }
 
@@ -309,7 +800,7 @@ struct inmemory_data_generator<Iterator, LIterator, Desc, std::enable_if_t<!is_a
 template <typename Iterator, typename LIterator, typename Desc>
 struct inmemory_data_generator<Iterator, LIterator, Desc, std::enable_if_t<is_augmented<Desc>>> {
     using desc                 = Desc;                                        ///< The generator descriptor
-    using weight               = etl::value_t<typename Iterator::value_type>; ///< The data type
+    using weight               = etl::value_t<typename std::iterator_traits<Iterator>::value_type>; ///< The data type
     using data_cache_helper_t  = cache_helper<desc, Iterator>;                ///< The helper for the data cache
     using label_cache_helper_t = label_cache_helper<desc, weight, LIterator>; ///< The helper for the label cache
 
@@ -317,14 +808,39 @@ struct inmemory_data_generator<Iterator, LIterator, Desc, std::enable_if_t<is_au
     using big_cache_type   = typename data_cache_helper_t::big_cache_type; ///< The type of big data cache
     using label_cache_type = typename label_cache_helper_t::cache_type;    ///< The type of the label cache
 
+    using big_label_cache_type = etl::dyn_matrix<etl::value_t<label_cache_type>, etl::dimensions<label_cache_type>() + 1>; ///< The type of the big label cache
+
     static constexpr bool dll_generator    = true;               ///< Simple flag to indicate that the class is a DLL generator
 
     static constexpr size_t batch_size     = desc::BatchSize;    ///< The size of the generated batches
     static constexpr size_t big_batch_size = desc::BigBatchSize; ///< The number of batches kept in cache
+    static constexpr size_t copies         = desc::Copy;         ///< The number of augmented copies of each sample per epoch
 
-    data_cache_type input_cache;  ///< The data cache
-    big_cache_type batch_cache;   ///< The data batch cache
-    label_cache_type label_cache; ///< The label cache
+    static constexpr bool indexed = desc::IndexedShuffle; ///< Indicates if the samples are shuffled through their indices
+
+    static_assert(!desc::LengthBucketing, "Length bucketing is not supported with data augmentation");
+
+    /*!
+     * \brief Indicates if the labels are gathered into the label batch cache
+     * by the thread, with the inputs
+     */
+    static constexpr bool gathered_labels = copies > 1 || indexed;
+
+    /*!
+     * \brief Indicates if the labels can be the inputs themselves, for
+     * auto-encoders reconstructing their clean inputs.
+     */
+    static constexpr bool shareable_labels = desc::AutoEncoder && std::is_same<data_cache_type, label_cache_type>::value;
+
+    static_assert(std::is_same<etl::value_t<data_cache_type>, weight>::value, "Compressed storage is not supported with augmentation");
+    static_assert(!desc::CompactLabels, "Compact labels are not supported with augmentation");
+
+    data_cache_type input_cache;            ///< The data cache
+    big_cache_type batch_cache;             ///< The data batch cache
+    label_cache_type label_cache;           ///< The label cache
+    big_label_cache_type label_batch_cache; ///< The label batch cache (only used with copies or indexed shuffle)
+
+    std::vector<uint32_t> order; ///< The order of the samples (only used with indexed shuffle)
 
     random_cropper<Desc> cropper;      ///< The random cropper
     random_mirrorer<Desc> mirrorer;    ///< The random mirrorer
@@ -332,17 +848,12 @@ struct inmemory_data_generator<Iterator, LIterator, Desc, std::enable_if_t<is_au
     random_noise<Desc> noiser;         ///< The random noiser
 
 
-    size_t current = 0;     ///< The current index
-    bool is_safe   = false; ///< Indicates if the generator is safe to reclaim memory from
-
-    mutable volatile bool status[big_batch_size];    ///< Status of each batch
-    mutable volatile size_t indices[big_batch_size]; ///< Indices of each batch
-
-    mutable std::mutex main_lock;                    ///< The main lock
-    mutable std::condition_variable condition;       ///< The condition variable for the thread to wait for some space
-    mutable std::condition_variable ready_condition; ///< The condition variable for a reader to wait for ready data
+    size_t current     = 0;     ///< The current index
+    size_t generation  = 0;     ///< The current generation (incremented at each reset)
+    bool is_safe       = false; ///< Indicates if the generator is safe to reclaim memory from
+    bool shared_labels = false; ///< Indicates if the labels are the inputs themselves (no label cache)
 
-    volatile bool stop_flag = false; ///< Boolean flag indicating to the thread to stop
+    batch_ring_t<desc> ring; ///< The ring of batches between the thread and the consumer
 
     std::thread main_thread; ///< The main thread
     bool train_mode = false; ///< The train mode status
@@ -351,13 +862,27 @@ struct inmemory_data_generator<Iterator, LIterator, Desc, std::enable_if_t<is_au
      * \brief Construct an inmemory data generator
      */
     inmemory_data_generator(Iterator first, Iterator last, LIterator lfirst, LIterator llast, size_t n_classes)
-            : cropper(*first), mirrorer(*first), distorter(*first), noiser(*first) {
+            : cropper(*first), mirrorer(*first), distorter(*first), noiser(*first), ring((copies * std::distance(first, last) + batch_size - 1) / batch_size) {
         const size_t n = std::distance(first, last);
 
         data_cache_helper_t::init(n, first, input_cache);
         data_cache_helper_t::init_big(first, batch_cache);
 
-        label_cache_helper_t::init(n, n_classes, lfirst, label_cache);
+        // An auto-encoder trained on its own inputs does not need a copy of them
+        if constexpr (shareable_labels && std::is_same<Iterator, LIterator>::value) {
+            shared_labels = first == lfirst;
+        }
+
+        if (!shared_labels) {
+            label_cache_helper_t::init(n, n_classes, lfirst, label_cache);
+        }
+
+        advise_huge_pages(std::tie(input_cache, batch_cache, label_cache));
+
+        // The copies are generated lazily, only their labels need a batch cache
+        if constexpr (gathered_labels) {
+            init_label_batch_cache();
+        }
 
         // Fill the cache
 
@@ -365,121 +890,197 @@ struct inmemory_data_generator<Iterator, LIterator, Desc, std::enable_if_t<is_au
         while (first != last) {
             input_cache(i) = *first;
 
-            label_cache_helper_t::set(i, lfirst, label_cache);
+            if (!shared_labels) {
+                label_cache_helper_t::set(i, lfirst, label_cache);
+            }
 
             ++i;
             ++first;
             ++lfirst;
         }
 
-        // Transform if necessary
+        cpp_unused(llast);
+
+        finalize_prepared_data();
+    }
 
-        pre_scaler<desc>::transform_all(input_cache);
-        pre_normalizer<desc>::transform_all(input_cache);
-        pre_binarizer<desc>::transform_all(input_cache);
+    /*!
+     * \brief Construct an empty inmemory data generator, to be filled with
+     * set_data_batch and set_label_batch and then finalized.
+     *
+     * When the same object is given as input and label, the generator is an
+     * auto-encoder of its inputs and no label cache is allocated.
+     */
+    template <typename Input, typename Label>
+    inmemory_data_generator(const Input& input, const Label& label, size_t n, size_t n_classes)
+            : cropper(input), mirrorer(input), distorter(input), noiser(input), ring((copies * n + batch_size - 1) / batch_size) {
+        Iterator it(&input);
+
+        data_cache_helper_t::init(n, it, input_cache);
+        data_cache_helper_t::init_big(it, batch_cache);
+
+        if constexpr (shareable_labels) {
+            shared_labels = static_cast<const void*>(&input) == static_cast<const void*>(&label);
+        }
+
+        if (!shared_labels) {
+            label_cache_helper_t::init(n, n_classes, &label, label_cache);
+        }
+
+        advise_huge_pages(std::tie(input_cache, batch_cache, label_cache));
+
+        if constexpr (gathered_labels) {
+            init_label_batch_cache();
+        }
+    }
+
+    inmemory_data_generator(const inmemory_data_generator& rhs) = delete;
+    inmemory_data_generator operator=(const inmemory_data_generator& rhs) = delete;
+
+    inmemory_data_generator(inmemory_data_generator&& rhs) = delete;
+    inmemory_data_generator operator=(inmemory_data_generator&& rhs) = delete;
+
+    /*!
+     * \brief Set some part of the data to a new set of value
+     * \param i The beginning at which to start storing the new data
+     * \param input_batch An input batch
+     */
+    template <typename Input>
+    void set_data_batch(size_t i, Input&& input_batch) {
+        etl::slice(input_cache, i, i + etl::dim<0>(input_batch)) = input_batch;
+    }
+
+    /*!
+     * \brief Set some part of the labels to a new set of value
+     * \param i The beginning at which to start storing the new data
+     * \param input_batch A label batch
+     */
+    template <typename Input>
+    void set_label_batch(size_t i, Input&& input_batch) {
+        cpp_assert(!shared_labels, "The labels of an auto-encoder of its inputs cannot be set");
+
+        etl::slice(label_cache, i, i + etl::dim<0>(input_batch)) = input_batch;
+    }
+
+    /*!
+     * \brief Finalize the dataset once it has been filled and start
+     * generating the batches.
+     */
+    void finalize_prepared_data() {
+        if constexpr (indexed) {
+            order.resize(samples());
+            std::iota(order.begin(), order.end(), uint32_t(0));
+        }
+
+        pre_transformer<desc>::transform_all(input_cache);
 
         // In case of auto-encoders, the label images also need to be transformed
         if constexpr (desc::AutoEncoder) {
-            pre_scaler<desc>::transform_all(label_cache);
-            pre_normalizer<desc>::transform_all(label_cache);
-            pre_binarizer<desc>::transform_all(label_cache);
+            if (!shared_labels) {
+                pre_transformer<desc>::transform_all(label_cache);
+            }
         }
 
-        for (size_t b = 0; b < big_batch_size; ++b) {
-            status[b]  = false;
-            indices[b] = b;
-        }
+        start_thread();
+    }
 
-        cpp_unused(llast);
+    /*!
+     * \brief Returns the labels of the generator (the inputs themselves for
+     * an auto-encoder of its inputs)
+     */
+    const label_cache_type& labels() const {
+        if constexpr (shareable_labels) {
+            return shared_labels ? input_cache : label_cache;
+        } else {
+            return label_cache;
+        }
+    }
 
+    /*!
+     * \brief Start the thread filling the batches
+     */
+    void start_thread() {
         main_thread = std::thread([this] {
-            while (true) {
-                // The index of the batch inside the batch cache
-                size_t index = 0;
-
-                {
-                    std::unique_lock<std::mutex> ulock(main_lock);
-
-                    bool found = false;
-
-                    // Try to find a read batch first
-                    for (size_t b = 0; b < big_batch_size; ++b) {
-                        if (!status[b] && indices[b] * batch_size < size()) {
-                            index = b;
-                            found = true;
-                            break;
-                        }
-                    }
+            pin_thread(execution().generators, 0);
 
-                    // if not found, wait for a ready to compute batch
-
-                    if (!found) {
-                        // Wait for the end or for some work
-                        condition.wait(ulock, [this, &index] {
-                            if (stop_flag) {
-                                return true;
-                            }
-
-                            for (size_t b = 0; b < big_batch_size; ++b) {
-                                if (!status[b] && indices[b] * batch_size < size()) {
-                                    index = b;
-                                    return true;
-                                }
-                            }
-
-                            return false;
-                        });
-
-                        // If there is no more thread for the thread, exit
-                        if (stop_flag) {
-                            return;
-                        }
-                    }
-                }
+            size_t batch = 0;
+
+            while (ring.acquire(batch)) {
+                dll::auto_timer timer("generator:fill");
+
+                // Nothing is read sequentially by this generator
+                ring.end_read(batch);
 
-                // Get the batch that needs to be read
-                const size_t batch = indices[index];
+                const size_t index = batch % big_batch_size;
 
                 // Get the index from where to read inside the input cache
                 const size_t input_n = batch * batch_size;
 
-                for (size_t i = 0; i < batch_size && input_n + i < size(); ++i) {
-                    if (train_mode) {
-                        // Random crop the image
-                        cropper.transform_first(batch_cache(index)(i), input_cache(input_n + i));
+                const size_t n = std::min(batch_size, size() - input_n);
 
-                        // Mirror the image
-                        mirrorer.transform(batch_cache(index)(i));
+                // The augmentations of a batch only depend on its position
+                random_stream g(generation, batch);
 
-                        // Distort the image
-                        distorter.transform(batch_cache(index)(i));
+                // With copies, the logical sample l is an augmented copy of
+                // the sample l % samples()
+                for (size_t i = 0; i < n; ++i) {
+                    const size_t s = sample_index((input_n + i) % samples());
 
-                        // Noise the image
-                        noiser.transform(batch_cache(index)(i));
+                    if (train_mode) {
+                        // Random crop and mirror the image in a single copy
+                        const auto mirror = mirrorer.draw(g);
+                        cropper.transform_first(batch_cache(index)(i), input_cache(s), g, mirror.first, mirror.second);
                     } else {
                         // Center crop the image
-                        cropper.transform_first_test(batch_cache(index)(i), input_cache(input_n + i));
+                        cropper.transform_first_test(batch_cache(index)(i), input_cache(s));
                     }
-                }
 
-                // Notify a waiter that one batch is ready
-
-                {
-                    std::unique_lock<std::mutex> ulock(main_lock);
-
-                    status[index] = true;
+                    if constexpr (gathered_labels) {
+                        label_batch_cache(index)(i) = labels()(s);
+                    }
+                }
 
-                    ready_condition.notify_one();
+                // The augmentations are applied on the whole batch
+                if (train_mode) {
+                    distorter.transform_batch(batch_cache(index), n, g);
+                    noiser.transform_batch(batch_cache(index), n, g);
                 }
+
+                // Notify the consumer that one batch is ready
+                ring.publish(batch);
             }
         });
     }
 
-    inmemory_data_generator(const inmemory_data_generator& rhs) = delete;
-    inmemory_data_generator operator=(const inmemory_data_generator& rhs) = delete;
+    /*!
+     * \brief Returns the index in the caches of the ith sample of the epoch
+     */
+    size_t sample_index(size_t i) const {
+        if constexpr (indexed) {
+            return order[i];
+        } else {
+            return i;
+        }
+    }
 
-    inmemory_data_generator(inmemory_data_generator&& rhs) = delete;
-    inmemory_data_generator operator=(inmemory_data_generator&& rhs) = delete;
+    /*!
+     * \brief Initialize the label batch cache with the dimensions of the labels
+     */
+    void init_label_batch_cache() {
+        static constexpr size_t L = etl::dimensions<label_cache_type>();
+
+        if constexpr (L == 1) {
+            label_batch_cache = big_label_cache_type(big_batch_size, batch_size);
+        } else if constexpr (L == 2) {
+            label_batch_cache = big_label_cache_type(big_batch_size, batch_size, etl::dim<1>(labels()));
+        } else if constexpr (L == 3) {
+            label_batch_cache = big_label_cache_type(big_batch_size, batch_size, etl::dim<1>(labels()), etl::dim<2>(labels()));
+        } else {
+            static_assert(L == 4, "Invalid number of dimensions for the labels");
+
+            label_batch_cache = big_label_cache_type(big_batch_size, batch_size, etl::dim<1>(labels()), etl::dim<2>(labels()), etl::dim<3>(labels()));
+        }
+    }
 
     /*!
      * \brief Display a description of the generator in the given stream
@@ -495,6 +1096,10 @@ struct inmemory_data_generator<Iterator, LIterator, Desc, std::enable_if_t<is_au
             stream << "    Augmented Size: " << augmented_size() << std::endl;
         }
 
+        if (copies > 1) {
+            stream << "            Copies: " << copies << std::endl;
+        }
+
         return stream;
     }
 
@@ -523,6 +1128,8 @@ struct inmemory_data_generator<Iterator, LIterator, Desc, std::enable_if_t<is_au
             input_cache.clear();
             batch_cache.clear();
             label_cache.clear();
+            label_batch_cache.clear();
+            order.clear();
         }
     }
 
@@ -544,25 +1151,19 @@ struct inmemory_data_generator<Iterator, LIterator, Desc, std::enable_if_t<is_au
      * \brief Destructs the inmemory_data_generator
      */
     ~inmemory_data_generator() {
-        cpp::with_lock(main_lock, [this] { stop_flag = true; });
+        ring.stop();
 
-        condition.notify_all();
-
-        main_thread.join();
+        // A prepared generator may never have been finalized
+        if (main_thread.joinable()) {
+            main_thread.join();
+        }
     }
 
     /*!
      * \brief Reset the generation to its beginning
      */
     void reset_generation() {
-        std::unique_lock<std::mutex> ulock(main_lock);
-
-        for (size_t b = 0; b < big_batch_size; ++b) {
-            status[b]  = false;
-            indices[b] = b;
-        }
-
-        condition.notify_one();
+        ring.reset([this] { ++generation; });
     }
 
     /*!
@@ -578,8 +1179,13 @@ struct inmemory_data_generator<Iterator, LIterator, Desc, std::enable_if_t<is_au
      */
     void reset_shuffle() {
         current = 0;
-        shuffle();
-        reset_generation();
+
+        // The thread must not read the inputs while they are shuffled
+        ring.reset([this] {
+            ++generation;
+
+            shuffle();
+        });
     }
 
     /*!
@@ -590,7 +1196,14 @@ struct inmemory_data_generator<Iterator, LIterator, Desc, std::enable_if_t<is_au
     void shuffle() {
         cpp_assert(!current, "Shuffle should only be performed on start of generation");
 
-        etl::parallel_shuffle(input_cache, label_cache, dll::random_engine());
+        if constexpr (indexed) {
+            // Only the indices are permuted, the thread gathers the samples
+            std::shuffle(order.begin(), order.end(), dll::random_engine());
+        } else if (shared_labels) {
+            etl::shuffle(input_cache, dll::random_engine());
+        } else {
+            etl::parallel_shuffle(input_cache, label_cache, dll::random_engine());
+        }
     }
 
     /*!
@@ -609,11 +1222,38 @@ struct inmemory_data_generator<Iterator, LIterator, Desc, std::enable_if_t<is_au
     }
 
     /*!
-     * \brief Returns the number of elements in the generator
+     * \brief Returns the number of elements stored in the generator
+     * \return The number of elements stored in the generator
+     */
+    size_t samples() const {
+        return etl::dim<0>(input_cache);
+    }
+
+    /*!
+     * \brief Returns the number of elements in the generator.
+     *
+     * With copy augmentation, this is the number of elements generated
+     * in one epoch.
+     *
      * \return The number of elements in the generator
      */
     size_t size() const {
-        return etl::dim<0>(input_cache);
+        return copies * samples();
+    }
+
+    /*!
+     * \brief Returns the number of bytes of the caches of the generator
+     */
+    size_t memory() const {
+        return memory_bytes(input_cache, batch_cache, label_cache, label_batch_cache, order);
+    }
+
+    /*!
+     * \brief Returns the counters of the generator (waits of the consumer,
+     * fills of the producers and occupancy of the ring)
+     */
+    const generator_stats& stats() const {
+        return ring.stats;
     }
 
     /*!
@@ -650,18 +1290,8 @@ struct inmemory_data_generator<Iterator, LIterator, Desc, std::enable_if_t<is_au
      * This should only be called if the generator has a next batch.
      */
     void next_batch() {
-        // Get information from batch that has been consumed
-        const auto batch = current / batch_size;
-        const auto b     = batch % big_batch_size;
-
-        {
-            std::unique_lock<std::mutex> ulock(main_lock);
-
-            status[b] = false;
-            indices[b] += big_batch_size;
-
-            condition.notify_one();
-        }
+        // Release the batch that has been consumed
+        ring.release(current / batch_size);
 
         current += batch_size;
     }
@@ -671,32 +1301,11 @@ struct inmemory_data_generator<Iterator, LIterator, Desc, std::enable_if_t<is_au
      * \return a a batch of data.
      */
     auto data_batch() const {
-        std::unique_lock<std::mutex> ulock(main_lock);
-
         const auto batch = current / batch_size;
-        const auto b     = batch % big_batch_size;
-
-        if (status[b]) {
-            const auto input_n = indices[b] * batch_size + batch_size;
 
-            if (input_n > size()) {
-                return etl::slice(batch_cache(b), 0, batch_size - (input_n - size()));
-            } else {
-                return etl::slice(batch_cache(b), 0, batch_size);
-            }
-        }
+        ring.wait_ready(batch);
 
-        ready_condition.wait(ulock, [this, b] {
-            return status[b];
-        });
-
-        const auto input_n = indices[b] * batch_size + batch_size;
-
-        if (input_n > size()) {
-            return etl::slice(batch_cache(b), 0, batch_size - (input_n - size()));
-        } else {
-            return etl::slice(batch_cache(b), 0, batch_size);
-        }
+        return etl::slice(batch_cache(batch % big_batch_size), 0, std::min(batch_size, size() - current));
     }
 
     /*!
@@ -704,7 +1313,15 @@ struct inmemory_data_generator<Iterator, LIterator, Desc, std::enable_if_t<is_au
      * \return a a batch of label.
      */
     auto label_batch() const {
-        return etl::slice(label_cache, current, std::min(current + batch_size, size()));
+        if constexpr (gathered_labels) {
+            const auto batch = current / batch_size;
+
+            ring.wait_ready(batch);
+
+            return etl::slice(label_batch_cache(batch % big_batch_size), 0, std::min(batch_size, size() - current));
+        } else {
+            return etl::slice(labels(), current, std::min(current + batch_size, size()));
+        }
     }
 
     /*!
@@ -725,6 +1342,9 @@ const size_t inmemory_data_generator<Iterator, LIterator, Desc, std::enable_if_t
 template <typename Iterator, typename LIterator, typename Desc>
 const size_t inmemory_data_generator<Iterator, LIterator, Desc, std::enable_if_t<is_augmented<Desc>>>::big_batch_size;
 
+template <typename Iterator, typename LIterator, typename Desc>
+const size_t inmemory_data_generator<Iterator, LIterator, Desc, std::enable_if_t<is_augmented<Desc>>>::copies;
+
 /*!
  * \brief Display the given generator on the given stream
  * \param os The output stream
@@ -761,6 +1381,21 @@ struct inmemory_data_generator_desc {
      */
     static constexpr bool Categorical = parameters::template contains<categorical>();
 
+    /*!
+     * \brief Indicates if the categorical labels are stored as class indices
+     */
+    static constexpr bool CompactLabels = parameters::template contains<compact_labels>();
+
+    /*!
+     * \brief Indicates if the samples are shuffled through a permutation of their indices
+     */
+    static constexpr bool IndexedShuffle = parameters::template contains<indexed_shuffle>();
+
+    /*!
+     * \brief Indicates if the samples are bucketed by length
+     */
+    static constexpr bool LengthBucketing = parameters::template contains<length_bucketing>();
+
     /*!
      * \brief Indicates if horizontal mirroring should be used as augmentation.
      */
@@ -786,11 +1421,31 @@ struct inmemory_data_generator_desc {
      */
     static constexpr size_t ElasticDistortion = detail::get_value_v<elastic_distortion<0>, Parameters...>;
 
+    /*!
+     * \brief The number of precomputed displacement fields for elastic distortion
+     */
+    static constexpr size_t DistortionBank = detail::get_value_v<distortion_bank<0>, Parameters...>;
+
+    /*!
+     * \brief The number of augmented copies of each sample per epoch
+     */
+    static constexpr size_t Copy = detail::get_value_v<copy<1>, Parameters...>;
+
+    /*!
+     * \brief The type used to store the inputs (void for the input type)
+     */
+    using storage_t = detail::get_type_t<storage_type<void>, Parameters...>;
+
     /*!
      * \brief The noise
      */
     static constexpr size_t Noise = detail::get_value_v<noise<0>, Parameters...>;
 
+    /*!
+     * \brief The type of noise
+     */
+    static constexpr auto NoiseKind = detail::get_value_v<noise_kind<noise_type::MASKING>, Parameters...>;
+
     /*!
      * \brief The scaling
      */
@@ -811,16 +1466,29 @@ struct inmemory_data_generator_desc {
      */
     static constexpr bool AutoEncoder = parameters::template contains<autoencoder>();
 
+    /*!
+     * \brief Indicates if the batches are handed over with a lock-free ring
+     */
+    static constexpr bool LockFree = parameters::template contains<lock_free>();
+
+    /*!
+     * \brief Indicates if the next batch is prefetched to the GPU
+     */
+    static constexpr bool GpuPrefetch = parameters::template contains<gpu_prefetch>();
+
     static_assert(BatchSize > 0, "The batch size must be larger than one");
     static_assert(BigBatchSize > 0, "The big batch size must be larger than one");
+    static_assert(Copy > 0, "The number of copies must be at least one");
     static_assert(!(AutoEncoder && (random_crop_x || random_crop_y)), "autoencoder mode is not compatible with random crop");
+    static_assert(!CompactLabels || Categorical, "compact labels are only possible for categorical labels");
 
     //Make sure only valid types are passed to the configuration list
     static_assert(
         detail::is_valid_v<
             cpp::type_list<
-                batch_size_id, big_batch_size_id, horizontal_mirroring_id, vertical_mirroring_id, random_crop_id, elastic_distortion_id,
-                categorical_id, noise_id, nop_id, normalize_pre_id, binarize_pre_id, scale_pre_id, autoencoder_id>,
+                batch_size_id, big_batch_size_id, horizontal_mirroring_id, vertical_mirroring_id, random_crop_id, elastic_distortion_id, distortion_bank_id,
+                categorical_id, compact_labels_id, indexed_shuffle_id, length_bucketing_id, noise_id, noise_kind_id, nop_id, normalize_pre_id, binarize_pre_id, scale_pre_id, autoencoder_id, lock_free_id, gpu_prefetch_id, copy_id,
+                storage_type_id>,
             Parameters...>,
         "Invalid parameters type for rbm_desc");
 
@@ -849,6 +1517,27 @@ auto make_generator(const Container& container, const LContainer& lcontainer, si
     return std::make_unique<generator_t>(container.begin(), container.end(), lcontainer.begin(), lcontainer.end(), n_classes);
 }
 
+/*!
+ * \brief Make an in memory data generator from a shard of the given range
+ */
+template <typename Iterator, typename LIterator, typename... Parameters>
+auto make_generator(Iterator first, Iterator last, LIterator lfirst, LIterator llast, size_t n_classes, const shard& s, const inmemory_data_generator_desc<Parameters...>& desc) {
+    auto mask = std::make_shared<const std::vector<bool>>(s.members(std::distance(first, last)));
+
+    auto range  = make_shard_range(first, last, mask);
+    auto lrange = make_shard_range(lfirst, llast, mask);
+
+    return make_generator(range.first, range.second, lrange.first, lrange.second, n_classes, desc);
+}
+
+/*!
+ * \brief Make an in memory data generator from a shard of the given containers
+ */
+template <typename Container, typename LContainer, typename... Parameters>
+auto make_generator(const Container& container, const LContainer& lcontainer, size_t n_classes, const shard& s, const inmemory_data_generator_desc<Parameters...>& desc) {
+    return make_generator(container.begin(), container.end(), lcontainer.begin(), lcontainer.end(), n_classes, s, desc);
+}
+
 // The following are simply helpers for creating generic generators
 
 /*!
@@ -889,4 +1578,66 @@ auto prepare_generator(const Input& input, const Label& label, size_t n, size_t
     return std::make_unique<generator_t>(input, label, n, n_classes);
 }
 
+/*!
+ * \brief Extract a shard from a prepared (and filled) generator.
+ *
+ * The returned generator only holds the samples of the shard and
+ * still needs to be finalized.
+ *
+ * \param full The complete generator
+ * \param s The shard to extract
+ * \param input An example of input
+ * \param label An example of label
+ * \param n_classes The number of classes
+ * \param desc The descriptor of the generator
+ *
+ * \return a new generator holding the samples of the given shard
+ */
+template <typename Generator, typename Input, typename Label, typename... Parameters>
+auto select_shard(const Generator& full, const shard& s, const Input& input, const Label& label, size_t n_classes, const inmemory_data_generator_desc<Parameters...>& desc) {
+    const size_t n = full.size();
+
+    auto generator = prepare_generator(input, label, s.size(n), n_classes, desc);
+    auto mask      = s.members(n);
+
+    for (size_t i = 0, j = 0; i < n; ++i) {
+        if (mask[i]) {
+            generator->input_cache(j) = full.input_cache(i);
+
+            if (!generator->shared_labels) {
+                generator->label_cache(j) = full.labels()(i);
+            }
+            ++j;
+        }
+    }
+
+    return generator;
+}
+
+/*!
+ * \brief Create a view of the samples [start, start + n) of an in memory
+ * data generator.
+ *
+ * The view shares the caches of the source, which is kept alive by the
+ * view and must not be modified anymore, only the indices of the samples
+ * are allocated. The range is truncated to the samples of the source.
+ *
+ * \param source The generator holding the caches
+ * \param start The index of the first sample of the view
+ * \param n The number of samples of the view
+ *
+ * \return a new generator over the given samples of the source
+ */
+template <typename Generator>
+std::unique_ptr<Generator> make_generator_view(const std::shared_ptr<const Generator>& source, size_t start, size_t n) {
+    // The samples missing from the source are ignored
+    start = std::min(start, source->size());
+    n     = std::min(n, source->size() - start);
+
+    std::vector<uint32_t> indices(n);
+    std::iota(indices.begin(), indices.end(), uint32_t(start));
+
+    return std::make_unique<Generator>(source, std::move(indices));
+}
+
 } //end of dll namespace
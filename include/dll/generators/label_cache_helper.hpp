@@ -21,7 +21,7 @@ struct label_cache_helper;
  * This version makes the label categorical.
  */
 template <typename Desc, typename T, typename LIterator>
-struct label_cache_helper<Desc, T, LIterator, std::enable_if_t<Desc::Categorical && !etl::is_etl_expr<typename std::iterator_traits<LIterator>::value_type>>> {
+struct label_cache_helper<Desc, T, LIterator, std::enable_if_t<Desc::Categorical && !etl::is_etl_expr<typename std::iterator_traits<LIterator>::value_type> && !is_std_sample<typename std::iterator_traits<LIterator>::value_type>>> {
     using cache_type     = etl::dyn_matrix<T, 2>; ///< The type of the cache
     using big_cache_type = etl::dyn_matrix<T, 3>; ///< The type of the big cache
 
@@ -67,13 +67,93 @@ struct label_cache_helper<Desc, T, LIterator, std::enable_if_t<Desc::Categorical
     }
 };
 
+/*!
+ * \brief Helper to create and initialize a compact cache for categorical
+ * labels.
+ *
+ * The cache only holds the class index of each label, the categorical
+ * rows are expanded one batch at a time.
+ */
+template <typename Desc, typename T, typename LIterator>
+struct compact_label_cache_helper {
+    using cache_type = etl::dyn_matrix<uint32_t, 1>; ///< The type of the cache
+    using batch_type = etl::dyn_matrix<T, 2>;        ///< The type of an expanded batch
+
+    static constexpr size_t batch_size = Desc::BatchSize; ///< The size of the generated batches
+
+    /*!
+     * \brief Init the cache
+     * \param n The size of the cache
+     * \param n_classes The number of classes
+     * \param it An iterator to an element
+     * \param cache The cache to initialize
+     */
+    static void init(size_t n, size_t n_classes, const LIterator& it, cache_type& cache) {
+        cache = cache_type(n);
+        cache = 0;
+
+        cpp_unused(n_classes);
+        cpp_unused(it);
+    }
+
+    /*!
+     * \brief Init the expanded batch
+     * \param n_classes The number of classes
+     * \param batch The batch to initialize
+     */
+    static void init_batch(size_t n_classes, batch_type& batch) {
+        batch = batch_type(batch_size, n_classes);
+    }
+
+    /*!
+     * \brief Set the value of a label in the cache from the iterator
+     * \param i The index of the label in the cache
+     * \param it The label iterator
+     * \param cache The label cache
+     */
+    template <typename E>
+    static void set(size_t i, const LIterator& it, E&& cache) {
+        cache[i] = static_cast<uint32_t>(*it);
+    }
+
+    /*!
+     * \brief Expand some labels of the cache into categorical rows
+     * \param cache The label cache
+     * \param first The index of the first label to expand
+     * \param n The number of labels to expand
+     * \param batch The batch receiving the categorical rows
+     */
+    static void expand(const cache_type& cache, size_t first, size_t n, batch_type& batch) {
+        batch = T(0);
+
+        for (size_t i = 0; i < n; ++i) {
+            batch(i, cache[first + i]) = T(1);
+        }
+    }
+
+    /*!
+     * \brief Expand the labels of the given indices into categorical rows
+     * \param cache The label cache
+     * \param indices The indices of the labels to expand
+     * \param n The number of labels to expand
+     * \param batch The batch receiving the categorical rows
+     */
+    static void expand(const cache_type& cache, const uint32_t* indices, size_t n, batch_type& batch) {
+        batch = T(0);
+
+        for (size_t i = 0; i < n; ++i) {
+            batch(i, cache[indices[i]]) = T(1);
+        }
+    }
+};
+
 /*!
  * \brief Helper to create and initialize a cache for labels.
  *
  * This version keeps the flat label as such.
  */
 template <typename Desc, typename T, typename LIterator>
-struct label_cache_helper<Desc, T, LIterator, std::enable_if_t<!Desc::Categorical && !etl::is_etl_expr<typename std::iterator_traits<LIterator>::value_type>>> {
+struct label_cache_helper<Desc, T, LIterator, std::enable_if_t<!Desc::Categorical && !etl::is_etl_expr<typename std::iterator_traits<LIterator>::value_type> && !is_std_sample<typename std::iterator_traits<LIterator>::value_type>>> {
     using cache_type     = etl::dyn_matrix<T, 1>; ///< The type of the cache
     using big_cache_type = etl::dyn_matrix<T, 2>; ///< The type of the big cache
 
@@ -175,6 +255,59 @@ struct label_cache_helper<Desc, T, LIterator, std::enable_if_t<etl::is_1d<typena
     }
 };
 
+/*!
+ * \brief Helper to create and initialize a cache for labels.
+ *
+ * This version keeps the 1D label in a standard container as such.
+ */
+template <typename Desc, typename T, typename LIterator>
+struct label_cache_helper<Desc, T, LIterator, std::enable_if_t<is_std_sample<typename std::iterator_traits<LIterator>::value_type>>> {
+    using cache_type     = etl::dyn_matrix<T, 2>; ///< The type of the cache
+    using big_cache_type = etl::dyn_matrix<T, 3>; ///< The type of the big cache
+
+    static constexpr size_t batch_size     = Desc::BatchSize;    ///< The size of the generated batches
+    static constexpr size_t big_batch_size = Desc::BigBatchSize; ///< The number of batches kept in cache
+
+    static_assert(!Desc::Categorical, "Cannot make such vector labels categorical");
+
+    /*!
+     * \brief Init the cache
+     * \param n The size of the cache
+     * \param n_classes The number of classes
+     * \param it An iterator to an element
+     * \param cache The cache to initialize
+     */
+    static void init(size_t n, size_t n_classes, const LIterator& it, cache_type& cache) {
+        cache = cache_type(n, (*it).size());
+
+        cpp_unused(n_classes);
+    }
+
+    /*!
+     * \brief Init the big cache
+     * \param n_classes The number of classes
+     * \param it An iterator to an element
+     * \param cache The big cache to initialize
+     */
+    static void init_big(size_t n_classes, const LIterator& it, big_cache_type& cache) {
+        cache = big_cache_type(big_batch_size, batch_size, (*it).size());
+
+        cpp_unused(n_classes);
+    }
+
+    /*!
+     * \brief Set the value of a label in the cache from the iterator
+     * \param i The index of the label in the cache
+     * \param it The label iterator
+     * \param cache The label cache
+     */
+    template <typename E>
+    static void set(size_t i, const LIterator& it, E&& cache) {
+        auto& label = *it;
+        std::copy(label.begin(), label.end(), cache(i).begin());
+    }
+};
+
 /*!
  * \brief Helper to create and initialize a cache for labels.
  *
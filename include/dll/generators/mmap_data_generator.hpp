@@ -0,0 +1,1074 @@
+//=======================================================================
+// Copyright (c) 2014-2017 Baptiste Wicht
+// Distributed under the terms of the MIT License.
+// (See accompanying file LICENSE or copy at
+//  http://opensource.org/licenses/MIT)
+//=======================================================================
+
+/*!
+ * \file
+ * \brief Implementation of a data generator reading a packed dataset file
+ * through a memory mapping.
+ *
+ * The packed dataset format is a fixed-size header followed by all the
+ * samples, stored contiguously with a fixed stride, and then by all the
+ * labels. Such a file can be written with write_packed_dataset or, sample
+ * by sample, with packed_dataset_writer.
+ *
+ * The samples can be stored in a narrower type than the batches (for
+ * instance decoded images stored as uint8_t and trained on as float), in
+ * which case they are converted while they are copied into the batches.
+ * A large dataset can be split in several files (shards), read by the same
+ * generator.
+ */
+
+#pragma once
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <numeric>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "dll/util/affinity.hpp"
+
+namespace dll {
+
+/*!
+ * \brief The header of a packed dataset file
+ */
+struct packed_dataset_header {
+    static constexpr uint32_t file_magic     = 0x444C4C44; ///< The magic number ("DLLD")
+    static constexpr uint32_t file_version   = 2;          ///< The current version of the format
+    static constexpr size_t max_dimensions   = 4;          ///< The maximum number of dimensions of a sample
+    static constexpr size_t size             = 4096;       ///< The size of the header (the data starts on a page)
+
+    static constexpr uint32_t value_labels  = 0; ///< The labels are stored as values of the samples
+    static constexpr uint32_t uint32_labels = 1; ///< The labels are stored as uint32_t
+
+    uint32_t magic;                 ///< The magic number
+    uint32_t version;               ///< The version of the format
+    uint32_t weight_size;           ///< The size of one value (in bytes)
+    uint32_t dimensions;            ///< The number of dimensions of a sample
+    uint64_t samples;               ///< The number of samples
+    uint64_t dims[max_dimensions];  ///< The dimensions of a sample
+    uint32_t label_format;          ///< The storage of the labels (always value_labels in version 1)
+};
+
+/*!
+ * \brief The storage of the labels of a packed dataset of values of type
+ * T: the labels of integral values are stored as uint32_t since they would
+ * not always fit in the values (1000 classes in uint8_t)
+ */
+template <typename T>
+constexpr uint32_t packed_label_format = std::is_integral<T>::value ? packed_dataset_header::uint32_labels : packed_dataset_header::value_labels;
+
+/*!
+ * \brief The type of the labels of a packed dataset of values of type T
+ */
+template <typename T>
+using packed_label_t = std::conditional_t<std::is_integral<T>::value, uint32_t, T>;
+
+/*!
+ * \brief Returns the header of a packed dataset of values of type T
+ * \param samples The number of samples
+ * \param dims The dimensions of a sample
+ */
+template <typename T, size_t D>
+packed_dataset_header make_packed_dataset_header(size_t samples, const std::array<size_t, D>& dims) {
+    static_assert(D <= packed_dataset_header::max_dimensions, "Too many dimensions for the packed format");
+
+    packed_dataset_header header;
+    std::memset(&header, 0, sizeof(header));
+
+    header.magic        = packed_dataset_header::file_magic;
+    header.version      = packed_dataset_header::file_version;
+    header.weight_size  = sizeof(T);
+    header.dimensions   = D;
+    header.samples      = samples;
+    header.label_format = packed_label_format<T>;
+
+    for (size_t d = 0; d < D; ++d) {
+        header.dims[d] = dims[d];
+    }
+
+    return header;
+}
+
+/*!
+ * \brief Write a dataset in the packed format
+ *
+ * The samples are written as values of type T and the labels are
+ * written as a single value of type packed_label_t<T> per sample.
+ *
+ * \param path The path to the file to write
+ * \param images The samples
+ * \param labels The labels
+ *
+ * \return true if the file was written, false otherwise
+ */
+template <typename T = float, typename Images, typename Labels>
+bool write_packed_dataset(const std::string& path, const Images& images, const Labels& labels) {
+    using image_t = typename Images::value_type;
+
+    static constexpr size_t D = etl::dimensions<image_t>();
+
+    static_assert(D <= packed_dataset_header::max_dimensions, "Too many dimensions for the packed format");
+
+    std::ofstream os(path, std::ios::binary);
+
+    if (!os || images.empty() || images.size() != labels.size()) {
+        std::cerr << "ERROR: Impossible to write packed dataset to " << path << std::endl;
+        return false;
+    }
+
+    std::array<size_t, D> dims;
+
+    for (size_t d = 0; d < D; ++d) {
+        dims[d] = etl::dim(images.front(), d);
+    }
+
+    auto header = make_packed_dataset_header<T>(images.size(), dims);
+
+    std::vector<char> padding(packed_dataset_header::size, 0);
+    std::memcpy(padding.data(), &header, sizeof(header));
+    os.write(padding.data(), padding.size());
+
+    std::vector<T> buffer(etl::size(images.front()));
+
+    for (auto& image : images) {
+        std::copy(image.begin(), image.end(), buffer.begin());
+        os.write(reinterpret_cast<const char*>(buffer.data()), buffer.size() * sizeof(T));
+    }
+
+    for (auto& label : labels) {
+        packed_label_t<T> value(label);
+        os.write(reinterpret_cast<const char*>(&value), sizeof(value));
+    }
+
+    return bool(os);
+}
+
+/*!
+ * \brief Write a packed dataset sample by sample, without holding the
+ * dataset in memory.
+ *
+ * The file is written next to its path and only appears once it has been
+ * closed successfully. The labels are kept in memory until the end.
+ *
+ * \tparam T The type of the stored values
+ * \tparam D The number of dimensions of a sample
+ */
+template <typename T, size_t D>
+struct packed_dataset_writer {
+    /*!
+     * \brief Start a packed dataset with samples of the given dimensions
+     * \param path The path to the file to write
+     * \param dims The dimensions of a sample
+     */
+    packed_dataset_writer(std::string path, const std::array<size_t, D>& dims)
+            : path(std::move(path)), dims(dims), os(this->path + ".tmp", std::ios::binary) {
+        stride = std::accumulate(dims.begin(), dims.end(), size_t(1), std::multiplies<size_t>());
+
+        // The header is only known at the end
+        std::vector<char> padding(packed_dataset_header::size, 0);
+        os.write(padding.data(), padding.size());
+    }
+
+    packed_dataset_writer(const packed_dataset_writer& rhs) = delete;
+    packed_dataset_writer& operator=(const packed_dataset_writer& rhs) = delete;
+
+    /*!
+     * \brief Remove the partial file if the writer was not closed
+     */
+    ~packed_dataset_writer() {
+        if (!closed) {
+            os.close();
+            std::remove((path + ".tmp").c_str());
+        }
+    }
+
+    /*!
+     * \brief Append a sample to the dataset
+     * \param sample The sample, with stride values, converted to T
+     * \param label The label of the sample
+     * \return true if the sample was written, false otherwise
+     */
+    template <typename Sample>
+    bool add(const Sample& sample, size_t label) {
+        if (etl::size(sample) != stride) {
+            std::cerr << "ERROR: Invalid sample size for packed dataset " << path << std::endl;
+            return false;
+        }
+
+        buffer.resize(stride);
+        std::copy(sample.begin(), sample.end(), buffer.begin());
+
+        os.write(reinterpret_cast<const char*>(buffer.data()), stride * sizeof(T));
+        labels.push_back(packed_label_t<T>(label));
+
+        return bool(os);
+    }
+
+    /*!
+     * \brief Returns the number of samples written so far
+     */
+    size_t size() const {
+        return labels.size();
+    }
+
+    /*!
+     * \brief Write the labels and the header and move the file to its path
+     * \return true if the dataset was written, false otherwise
+     */
+    bool close() {
+        if (closed) {
+            return true;
+        }
+
+        const std::string tmp = path + ".tmp";
+
+        os.write(reinterpret_cast<const char*>(labels.data()), labels.size() * sizeof(packed_label_t<T>));
+
+        auto header = make_packed_dataset_header<T>(labels.size(), dims);
+
+        os.seekp(0);
+        os.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        os.close();
+
+        if (!os || labels.empty()) {
+            std::cerr << "ERROR: Impossible to write packed dataset to " << path << std::endl;
+            return false;
+        }
+
+        closed = std::rename(tmp.c_str(), path.c_str()) == 0;
+
+        return closed;
+    }
+
+private:
+    std::string path;                      ///< The path to the dataset
+    std::array<size_t, D> dims;            ///< The dimensions of a sample
+    size_t stride = 0;                     ///< The number of values of a sample
+    std::ofstream os;                      ///< The stream to the temporary file
+    std::vector<T> buffer;                 ///< The conversion buffer of one sample
+    std::vector<packed_label_t<T>> labels; ///< The labels written at the end
+    bool closed = false;                   ///< Indicates if the file was closed
+};
+
+/*!
+ * \brief A read-only memory mapping of a packed dataset file
+ * \tparam T The type of the values
+ * \tparam D The number of dimensions of a sample
+ */
+template <typename T, size_t D>
+struct packed_dataset_file {
+    using view_type = etl::custom_dyn_matrix<T, D>; ///< The type of a view on a sample
+
+    int fd              = -1;      ///< The file descriptor
+    void* mapping       = nullptr; ///< The start of the mapping
+    size_t length       = 0;       ///< The length of the mapping
+    size_t samples      = 0;       ///< The number of samples
+    size_t stride       = 0;       ///< The number of values of one sample
+    const T* data       = nullptr; ///< The first sample
+    const char* labels  = nullptr; ///< The first label
+    bool uint32_labels  = false;   ///< Indicates if the labels are stored as uint32_t
+
+    std::array<size_t, D> dims; ///< The dimensions of a sample
+
+    /*!
+     * \brief Map the given file in memory
+     * \param path The path to the packed dataset
+     */
+    explicit packed_dataset_file(const std::string& path) {
+        dims.fill(0);
+
+        fd = ::open(path.c_str(), O_RDONLY);
+
+        if (fd < 0) {
+            std::cerr << "ERROR: Impossible to open packed dataset " << path << std::endl;
+            return;
+        }
+
+        struct stat st;
+
+        if (::fstat(fd, &st) < 0 || size_t(st.st_size) < packed_dataset_header::size) {
+            std::cerr << "ERROR: Invalid packed dataset " << path << std::endl;
+            return;
+        }
+
+        packed_dataset_header header;
+
+        if (::pread(fd, &header, sizeof(header), 0) != ssize_t(sizeof(header))
+                || header.magic != packed_dataset_header::file_magic
+                || header.version < 1 || header.version > packed_dataset_header::file_version
+                || header.weight_size != sizeof(T)
+                || header.dimensions != D) {
+            std::cerr << "ERROR: Incompatible packed dataset " << path << std::endl;
+            return;
+        }
+
+        // The first version always stored the labels as values
+        uint32_labels = header.version > 1 && header.label_format == packed_dataset_header::uint32_labels;
+
+        const size_t label_size = uint32_labels ? sizeof(uint32_t) : sizeof(T);
+
+        stride = 1;
+
+        for (size_t d = 0; d < D; ++d) {
+            dims[d] = header.dims[d];
+            stride *= dims[d];
+        }
+
+        if (size_t(st.st_size) < packed_dataset_header::size + header.samples * (stride * sizeof(T) + label_size)) {
+            std::cerr << "ERROR: Truncated packed dataset " << path << std::endl;
+            return;
+        }
+
+        length  = st.st_size;
+        mapping = ::mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+
+        if (mapping == MAP_FAILED) {
+            std::cerr << "ERROR: Impossible to map packed dataset " << path << std::endl;
+            mapping = nullptr;
+            return;
+        }
+
+        samples = header.samples;
+        data    = reinterpret_cast<const T*>(static_cast<const char*>(mapping) + packed_dataset_header::size);
+        labels  = reinterpret_cast<const char*>(data + samples * stride);
+
+        ::madvise(mapping, length, MADV_SEQUENTIAL);
+    }
+
+    packed_dataset_file(const packed_dataset_file& rhs) = delete;
+    packed_dataset_file& operator=(const packed_dataset_file& rhs) = delete;
+
+    /*!
+     * \brief Unmap the file
+     */
+    ~packed_dataset_file() {
+        if (mapping) {
+            ::munmap(mapping, length);
+        }
+
+        if (fd >= 0) {
+            ::close(fd);
+        }
+    }
+
+    /*!
+     * \brief Advise the kernel about the access pattern to the samples
+     * \param random true if the samples will be accessed randomly
+     */
+    void advise(bool random) {
+        if (mapping) {
+            ::madvise(mapping, length, random ? MADV_RANDOM : MADV_SEQUENTIAL);
+        }
+    }
+
+    /*!
+     * \brief Returns a view on the given sample, directly in the mapping
+     * \param i The index of the sample
+     * \return a view on the sample
+     */
+    view_type sample(size_t i) const {
+        // The mapping is read-only, the view is only used for reading
+        return std::apply([this, i](auto... d) { return view_type(const_cast<T*>(data + i * stride), d...); }, dims);
+    }
+
+    /*!
+     * \brief Returns the label of the given sample
+     * \param i The index of the sample
+     * \return the label of the sample
+     */
+    double label(size_t i) const {
+        // The labels following narrow samples are not always aligned
+        if (uint32_labels) {
+            uint32_t value;
+            std::memcpy(&value, labels + i * sizeof(uint32_t), sizeof(value));
+            return value;
+        } else {
+            T value;
+            std::memcpy(&value, labels + i * sizeof(T), sizeof(value));
+            return value;
+        }
+    }
+
+    /*!
+     * \brief Returns a sample initialized to zero, with the correct dimensions
+     */
+    etl::dyn_matrix<T, D> example() const {
+        return std::apply([](auto... d) { return etl::dyn_matrix<T, D>(std::max(d, size_t(1))..., T(0)); }, dims);
+    }
+};
+
+/*!
+ * \brief A data generator reading its samples from memory-mapped packed
+ * datasets.
+ *
+ * Batches are prepared by workers, directly from the page cache into the
+ * batch cache. Shuffling only permutes the indices of the samples.
+ *
+ * The dataset can be split into several files (shards) of samples of the
+ * same dimensions. The shards are shuffled as a whole and the samples are
+ * shuffled within each shard, so that the workers only read one shard at
+ * a time. The shards should be written with the samples in random order.
+ *
+ * \tparam T The type of the values of the batches
+ * \tparam D The number of dimensions of a sample
+ * \tparam S The type of the values stored in the files
+ */
+template <typename T, size_t D, typename Desc, typename S = T>
+struct mmap_data_generator {
+    using desc   = Desc; ///< The generator descriptor
+    using weight = T;    ///< The data type
+
+    static constexpr bool dll_generator    = true;               ///< Simple flag to indicate that the class is a DLL generator
+    static constexpr size_t batch_size     = desc::BatchSize;    ///< The size of the generated batches
+    static constexpr size_t big_batch_size = desc::BigBatchSize; ///< The number of batches kept in cache
+    static constexpr size_t workers        = desc::Workers;      ///< The number of threads preparing batches
+
+    static_assert(D == 3 || !(desc::random_crop_x || desc::random_crop_y), "Random cropping is only supported for 3D inputs");
+    static_assert(!desc::AutoEncoder || std::is_same<T, S>::value, "autoencoder mode needs samples stored as the batches");
+
+    using file_type = packed_dataset_file<S, D>; ///< The type of a mapped file
+
+    using big_data_cache_type  = etl::dyn_matrix<T, D + 2>; ///< The type of the big data cache
+    using big_label_cache_type = std::conditional_t<
+        desc::AutoEncoder,
+        etl::dyn_matrix<T, D + 2>,
+        std::conditional_t<desc::Categorical, etl::dyn_matrix<T, 3>, etl::dyn_matrix<T, 2>>>; ///< The type of the big label cache
+
+    std::vector<std::unique_ptr<file_type>> files; ///< The mapped files
+    std::vector<size_t> offsets;                   ///< The index of the first sample of each file (and the total)
+
+    big_data_cache_type batch_cache;  ///< The data batch cache
+    big_label_cache_type label_cache; ///< The label batch cache
+
+    std::vector<size_t> order; ///< The order of the samples
+
+    size_t current    = 0;     ///< The current index
+    size_t generation = 0;     ///< The current generation (incremented at each reset)
+    bool is_safe      = false; ///< Indicates if the generator is safe to reclaim memory from
+    bool train_mode   = false; ///< The train mode status
+
+    batch_ring_t<desc> ring; ///< The ring of batches between the workers and the consumer
+
+    std::vector<std::thread> threads; ///< The worker threads
+
+    random_cropper<Desc> cropper;      ///< The random cropper
+    random_mirrorer<Desc> mirrorer;    ///< The random mirrorer
+    elastic_distorter<Desc> distorter; ///< The elastic distorter
+    random_noise<Desc> noiser;         ///< The random noiser
+
+    runtime_preprocessing preprocessing; ///< The preprocessing configured at runtime
+
+    /*!
+     * \brief Construct a mmap_data_generator
+     * \param path The path to the packed dataset
+     * \param n_classes The number of classes
+     */
+    mmap_data_generator(const std::string& path, size_t n_classes)
+            : mmap_data_generator(std::vector<std::string>{path}, n_classes) {}
+
+    /*!
+     * \brief Construct a mmap_data_generator reading several shards
+     * \param paths The paths to the packed datasets
+     * \param n_classes The number of classes
+     */
+    mmap_data_generator(const std::vector<std::string>& paths, size_t n_classes)
+            : files(open_files(paths)), offsets(shard_offsets(files)),
+              ring(offsets.back() / batch_size + (offsets.back() % batch_size == 0 ? 0 : 1)),
+              cropper(files.front()->example()), mirrorer(files.front()->example()), distorter(files.front()->example()), noiser(files.front()->example()) {
+        auto& dims = files.front()->dims;
+
+        if constexpr (desc::random_crop_x && desc::random_crop_y) {
+            batch_cache = big_data_cache_type(big_batch_size, batch_size, dims[0], desc::random_crop_y, desc::random_crop_x);
+        } else {
+            batch_cache = std::apply([](auto... d) { return big_data_cache_type(big_batch_size, batch_size, d...); }, dims);
+        }
+
+        if constexpr (desc::AutoEncoder) {
+            label_cache = std::apply([](auto... d) { return big_label_cache_type(big_batch_size, batch_size, d...); }, dims);
+        } else if constexpr (desc::Categorical) {
+            label_cache = big_label_cache_type(big_batch_size, batch_size, n_classes);
+        } else {
+            label_cache = big_label_cache_type(big_batch_size, batch_size);
+        }
+
+        cpp_unused(n_classes);
+
+        order.resize(size());
+        std::iota(order.begin(), order.end(), 0);
+
+        for (size_t w = 0; w < workers; ++w) {
+            threads.emplace_back([this, w] { worker_main(w); });
+        }
+    }
+
+    mmap_data_generator(const mmap_data_generator& rhs) = delete;
+    mmap_data_generator& operator=(const mmap_data_generator& rhs) = delete;
+
+    mmap_data_generator(mmap_data_generator&& rhs) = delete;
+    mmap_data_generator& operator=(mmap_data_generator&& rhs) = delete;
+
+    /*!
+     * \brief Destructs the mmap_data_generator
+     */
+    ~mmap_data_generator() {
+        ring.stop();
+
+        for (auto& thread : threads) {
+            thread.join();
+        }
+    }
+
+    /*!
+     * \brief Map the given files
+     */
+    static std::vector<std::unique_ptr<file_type>> open_files(const std::vector<std::string>& paths) {
+        std::vector<std::unique_ptr<file_type>> files;
+
+        for (auto& path : paths) {
+            files.emplace_back(std::make_unique<file_type>(path));
+
+            if (files.back()->dims != files.front()->dims) {
+                std::cerr << "ERROR: The shard " << path << " does not have the dimensions of the first shard" << std::endl;
+                files.pop_back();
+            }
+        }
+
+        // The generator always needs a file (an empty one if none is valid)
+        if (files.empty()) {
+            std::cerr << "ERROR: No packed dataset to read" << std::endl;
+            files.emplace_back(std::make_unique<file_type>(std::string()));
+        }
+
+        return files;
+    }
+
+    /*!
+     * \brief Returns the index of the first sample of each file, followed
+     * by the total number of samples
+     */
+    static std::vector<size_t> shard_offsets(const std::vector<std::unique_ptr<file_type>>& files) {
+        std::vector<size_t> offsets(1, 0);
+
+        for (auto& file : files) {
+            offsets.push_back(offsets.back() + file->samples);
+        }
+
+        return offsets;
+    }
+
+    /*!
+     * \brief Returns the file holding the given sample and the index of the
+     * sample in this file
+     */
+    std::pair<size_t, size_t> locate(size_t s) const {
+        const size_t f = std::upper_bound(offsets.begin(), offsets.end(), s) - offsets.begin() - 1;
+        return {f, s - offsets[f]};
+    }
+
+    /*!
+     * \brief The main function of a worker thread.
+     *
+     * Since the samples can be accessed randomly, the workers prepare
+     * their batches fully concurrently.
+     *
+     * \param w The index of the worker
+     */
+    void worker_main(size_t w) {
+        pin_thread(execution().generators, w);
+
+        size_t batch = 0;
+
+        while (ring.acquire(batch)) {
+            dll::auto_timer timer("generator:fill");
+
+            ring.end_read(batch);
+
+            const size_t index = batch % big_batch_size;
+            const size_t first = batch * batch_size;
+            const size_t n     = std::min(batch_size, size() - first);
+
+            random_stream g(generation, batch);
+
+            SERIAL_SECTION {
+                for (size_t i = 0; i < n; ++i) {
+                    const auto [f, s] = locate(order[first + i]);
+
+                    const auto& file = *files[f];
+                    const auto raw   = file.sample(s);
+
+                    if (train_mode) {
+                        // Random crop and mirror the image in a single copy
+                        const auto mirror = mirrorer.draw(g);
+                        cropper.transform_first(batch_cache(index)(i), raw, g, mirror.first, mirror.second);
+                    } else {
+                        // Center crop the image
+                        cropper.transform_first_test(batch_cache(index)(i), raw);
+                    }
+
+                    if constexpr (desc::AutoEncoder) {
+                        label_cache(index)(i) = raw;
+                    } else if constexpr (desc::Categorical) {
+                        label_cache(index)(i) = T(0);
+                        label_cache(index)(i, size_t(file.label(s))) = T(1);
+                    } else {
+                        label_cache(index)[i] = file.label(s);
+                    }
+                }
+
+                // The other transformations are applied on the whole batch
+
+                transform_batch(index, n, g);
+            }
+
+            ring.publish(batch);
+        }
+    }
+
+    /*!
+     * \brief Apply the preprocessing and the augmentations on the first
+     * n images of a batch.
+     * \param index The index of the batch in the cache
+     * \param n The number of images in the batch
+     * \param g The random engine
+     */
+    template <typename G>
+    void transform_batch(size_t index, size_t n, G& g) {
+        auto samples = etl::slice(batch_cache(index), 0, n);
+
+        pre_transformer<desc>::transform_all(samples);
+
+        preprocessing.transform_all(samples, g);
+
+        if (train_mode) {
+            distorter.transform_batch(batch_cache(index), n, g);
+            noiser.transform_batch(batch_cache(index), n, g);
+        }
+
+        // In case of auto-encoders, the label images also need to be transformed
+        if constexpr (desc::AutoEncoder) {
+            auto labels = etl::slice(label_cache(index), 0, n);
+
+            pre_transformer<desc>::transform_all(labels);
+
+            preprocessing.transform_clean(labels);
+        }
+    }
+
+    /*!
+     * \brief Display a description of the generator in the given stream
+     * \param stream The stream to print to
+     * \return stream
+     */
+    std::ostream& display(std::ostream& stream) const {
+        stream << "Memory-Mapped Data Generator" << std::endl;
+        stream << "              Size: " << size() << std::endl;
+        stream << "           Batches: " << batches() << std::endl;
+
+        if (files.size() > 1) {
+            stream << "            Shards: " << files.size() << std::endl;
+        }
+
+        if (augmented_size() != size()) {
+            stream << "    Augmented Size: " << augmented_size() << std::endl;
+        }
+
+        if (workers > 1) {
+            stream << "           Workers: " << workers << std::endl;
+        }
+
+        return stream;
+    }
+
+    /*!
+     * \brief Display a description of the generator in the standard output.
+     */
+    void display() const {
+        display(std::cout);
+    }
+
+    /*!
+     * \brief Indicates that it is safe to destroy the memory of the generator
+     * when not used by the pretraining phase
+     */
+    void set_safe() {
+        is_safe = true;
+    }
+
+    /*!
+     * \brier Clear the memory of the generator.
+     *
+     * This is only done if the generator is marked as safe it is safe.
+     */
+    void clear() {
+        if (is_safe) {
+            batch_cache.clear();
+            label_cache.clear();
+        }
+    }
+
+    /*!
+     * brief Sets the generator in test mode
+     */
+    void set_test() {
+        train_mode = false;
+    }
+
+    /*!
+     * brief Sets the generator in train mode
+     */
+    void set_train() {
+        train_mode = true;
+    }
+
+    /*!
+     * \brief Reset the generator to the beginning
+     */
+    void reset() {
+        current = 0;
+
+        ring.reset([this] { ++generation; });
+    }
+
+    /*!
+     * \brief Reset the generator and shuffle the order of samples
+     */
+    void reset_shuffle() {
+        current = 0;
+
+        // The workers must not read the order while it is shuffled
+        ring.reset([this] {
+            ++generation;
+            shuffle();
+        });
+    }
+
+    /*!
+     * \brief Shuffle the order of the samples.
+     *
+     * Only the indices of the samples are shuffled, the files are left
+     * untouched. The order of the shards is shuffled and then the samples
+     * are shuffled within each shard.
+     *
+     * This should only be done when the generator is at the beginning.
+     */
+    void shuffle() {
+        cpp_assert(!current, "Shuffle should only be performed on start of generation");
+
+        auto& g = dll::rand_engine();
+
+        std::vector<size_t> shards(files.size());
+        std::iota(shards.begin(), shards.end(), 0);
+        std::shuffle(shards.begin(), shards.end(), g);
+
+        auto it = order.begin();
+
+        for (auto f : shards) {
+            auto first = it;
+
+            for (size_t s = offsets[f]; s < offsets[f + 1]; ++s) {
+                *it++ = s;
+            }
+
+            std::shuffle(first, it, g);
+
+            files[f]->advise(true);
+        }
+    }
+
+    /*!
+     * \brief Prepare the dataset for an epoch
+     */
+    void prepare_epoch() {
+        // Nothing can be done here
+    }
+
+    /*!
+     * \brief Return the index of the current batch in the generation
+     * \return The current batch index
+     */
+    size_t current_batch() const {
+        return current / batch_size;
+    }
+
+    /*!
+     * \brief Returns the number of elements in the generator
+     * \return The number of elements in the generator
+     */
+    size_t size() const {
+        return offsets.back();
+    }
+
+    /*!
+     * \brief Returns the number of bytes of the caches of the generator
+     * (the mapped files are not accounted)
+     */
+    size_t memory() const {
+        return memory_bytes(batch_cache, label_cache, order, offsets);
+    }
+
+    /*!
+     * \brief Returns the counters of the generator (waits of the consumer,
+     * fills of the producers and occupancy of the ring)
+     */
+    const generator_stats& stats() const {
+        return ring.stats;
+    }
+
+    /*!
+     * \brief Returns the augmented number of elements in the generator.
+     *
+     * This number may be an estimate, depending on which augmentation
+     * techniques are enabled.
+     *
+     * \return The augmented number of elements in the generator
+     */
+    size_t augmented_size() const {
+        return cropper.scaling() * mirrorer.scaling() * noiser.scaling() * distorter.scaling() * size();
+    }
+
+    /*!
+     * \brief Returns the number of batches in the generator.
+     * \return The number of batches in the generator
+     */
+    size_t batches() const {
+        return size() / batch_size + (size() % batch_size == 0 ? 0 : 1);
+    }
+
+    /*!
+     * \brief Indicates if the generator has a next batch or not
+     * \return true if the generator has a next batch, false otherwise
+     */
+    bool has_next_batch() const {
+        return current < size();
+    }
+
+    /*!
+     * \brief Moves to the next batch.
+     *
+     * This should only be called if the generator has a next batch.
+     */
+    void next_batch() {
+        // Release the batch that has been consumed
+        ring.release(current / batch_size);
+
+        current += batch_size;
+    }
+
+    /*!
+     * \brief Returns the current data batch
+     * \return a a batch of data.
+     */
+    auto data_batch() const {
+        const auto batch = current / batch_size;
+
+        ring.wait_ready(batch);
+
+        return etl::slice(batch_cache(batch % big_batch_size), 0, std::min(batch_size, size() - current));
+    }
+
+    /*!
+     * \brief Returns the current label batch
+     * \return a a batch of label.
+     */
+    auto label_batch() const {
+        const auto batch = current / batch_size;
+
+        ring.wait_ready(batch);
+
+        return etl::slice(label_cache(batch % big_batch_size), 0, std::min(batch_size, size() - current));
+    }
+
+    /*!
+     * \brief Returns the number of dimensions of the input.
+     * \return The number of dimensions of the input.
+     */
+    static constexpr size_t dimensions() {
+        return D;
+    }
+};
+
+template <typename T, size_t D, typename Desc, typename S>
+const size_t mmap_data_generator<T, D, Desc, S>::batch_size;
+
+template <typename T, size_t D, typename Desc, typename S>
+const size_t mmap_data_generator<T, D, Desc, S>::big_batch_size;
+
+template <typename T, size_t D, typename Desc, typename S>
+const size_t mmap_data_generator<T, D, Desc, S>::workers;
+
+/*!
+ * \brief Display the given generator on the given stream
+ * \param os The output stream
+ * \param generator The generator to display
+ * \return os
+ */
+template <typename T, size_t D, typename Desc, typename S>
+std::ostream& operator<<(std::ostream& os, mmap_data_generator<T, D, Desc, S>& generator) {
+    return generator.display(os);
+}
+
+/*!
+ * \brief Descriptor for a mmap_data_generator
+ */
+template <typename... Parameters>
+struct mmap_data_generator_desc {
+    /*!
+     * A list of all the parameters of the descriptor
+     */
+    using parameters = cpp::type_list<Parameters...>;
+
+    /*!
+     * \brief The size of a batch
+     */
+    static constexpr size_t BatchSize = detail::get_value_v<batch_size<1>, Parameters...>;
+
+    /*!
+     * \brief The number of batch in cache
+     */
+    static constexpr size_t BigBatchSize = detail::get_value_v<big_batch_size<1>, Parameters...>;
+
+    /*!
+     * \brief The number of workers preparing the batches
+     */
+    static constexpr size_t Workers = detail::get_value_v<workers<1>, Parameters...>;
+
+    /*!
+     * \brief Indicates if the generators must make the labels categorical
+     */
+    static constexpr bool Categorical = parameters::template contains<categorical>();
+
+    /*!
+     * \brief Indicates if horizontal mirroring should be used as augmentation.
+     */
+    static constexpr bool HorizontalMirroring = parameters::template contains<horizontal_mirroring>();
+
+    /*!
+     * \brief Indicates if vertical mirroring should be used as augmentation.
+     */
+    static constexpr bool VerticalMirroring = parameters::template contains<vertical_mirroring>();
+
+    /*!
+     * \brief The random cropping X
+     */
+    static constexpr size_t random_crop_x = detail::get_value_1<random_crop<0, 0>, Parameters...>::value;
+
+    /*!
+     * \brief The random cropping Y
+     */
+    static constexpr size_t random_crop_y = detail::get_value_2<random_crop<0, 0>, Parameters...>::value;
+
+    /*!
+     * \brief The elastic distortion kernel
+     */
+    static constexpr size_t ElasticDistortion = detail::get_value_v<elastic_distortion<0>, Parameters...>;
+
+    /*!
+     * \brief The number of precomputed displacement fields for elastic distortion
+     */
+    static constexpr size_t DistortionBank = detail::get_value_v<distortion_bank<0>, Parameters...>;
+
+    /*!
+     * \brief The noise
+     */
+    static constexpr size_t Noise = detail::get_value_v<noise<0>, Parameters...>;
+
+    /*!
+     * \brief The type of noise
+     */
+    static constexpr auto NoiseKind = detail::get_value_v<noise_kind<noise_type::MASKING>, Parameters...>;
+
+    /*!
+     * \brief The scaling
+     */
+    static constexpr size_t ScalePre = detail::get_value_v<scale_pre<0>, Parameters...>;
+
+    /*!
+     * \brief The binarization threshold
+     */
+    static constexpr size_t BinarizePre = detail::get_value_v<binarize_pre<0>, Parameters...>;
+
+    /*!
+     * \brief Indicates if input are normalized
+     */
+    static constexpr bool NormalizePre = parameters::template contains<normalize_pre>();
+
+    /*!
+     * \brief Indicates if this is an auto-encoder task
+     */
+    static constexpr bool AutoEncoder = parameters::template contains<autoencoder>();
+
+    /*!
+     * \brief Indicates if the batches are handed over with a lock-free ring
+     */
+    static constexpr bool LockFree = parameters::template contains<lock_free>();
+
+    static_assert(BatchSize > 0, "The batch size must be larger than one");
+    static_assert(BigBatchSize > 0, "The big batch size must be larger than one");
+    static_assert(Workers > 0, "The generator needs at least one worker");
+    static_assert(!(AutoEncoder && (random_crop_x || random_crop_y)), "autoencoder mode is not compatible with random crop");
+    static_assert(!(AutoEncoder && Categorical), "autoencoder mode is not compatible with categorical labels");
+
+    //Make sure only valid types are passed to the configuration list
+    static_assert(
+        detail::is_valid_v<
+            cpp::type_list<
+                batch_size_id, big_batch_size_id, horizontal_mirroring_id, vertical_mirroring_id, random_crop_id,
+                elastic_distortion_id, distortion_bank_id, categorical_id, noise_id, noise_kind_id, workers_id, lock_free_id, nop_id, normalize_pre_id,
+                binarize_pre_id, scale_pre_id, autoencoder_id>,
+            Parameters...>,
+        "Invalid parameters type for mmap_data_generator_desc");
+
+    /*!
+     * The generator type
+     */
+    template <typename T, size_t D, typename S = T>
+    using generator_t = mmap_data_generator<T, D, mmap_data_generator_desc<Parameters...>, S>;
+};
+
+/*!
+ * \brief Make a memory-mapped data generator from a packed dataset file
+ * \tparam T The type of the values of the batches
+ * \tparam D The number of dimensions of the samples
+ * \tparam S The type of the values stored in the file
+ * \param path The path to the packed dataset
+ * \param n_classes The number of classes
+ */
+template <typename T, size_t D, typename S = T, typename... Parameters>
+auto make_mmap_generator(const std::string& path, size_t n_classes, const mmap_data_generator_desc<Parameters...>& /*desc*/) {
+    using generator_t = typename mmap_data_generator_desc<Parameters...>::template generator_t<T, D, S>;
+    return std::make_unique<generator_t>(path, n_classes);
+}
+
+/*!
+ * \brief Make a memory-mapped data generator from the shards of a packed
+ * dataset
+ * \tparam T The type of the values of the batches
+ * \tparam D The number of dimensions of the samples
+ * \tparam S The type of the values stored in the files
+ * \param paths The paths to the shards
+ * \param n_classes The number of classes
+ */
+template <typename T, size_t D, typename S = T, typename... Parameters>
+auto make_mmap_generator(const std::vector<std::string>& paths, size_t n_classes, const mmap_data_generator_desc<Parameters...>& /*desc*/) {
+    using generator_t = typename mmap_data_generator_desc<Parameters...>::template generator_t<T, D, S>;
+    return std::make_unique<generator_t>(paths, n_classes);
+}
+
+} //end of dll namespace
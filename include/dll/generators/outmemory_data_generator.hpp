@@ -14,6 +14,11 @@
 
 #include <atomic>
 #include <thread>
+#include <vector>
+
+#include "dll/util/affinity.hpp"
+#include "dll/util/huge_pages.hpp"
+#include "dll/util/gpu_prefetch.hpp"
 
 namespace dll {
 
@@ -40,6 +45,12 @@ struct outmemory_data_generator<Iterator, LIterator, Desc, std::enable_if_t<!is_
     static constexpr size_t batch_size     = desc::BatchSize;    ///< The size of the batch
     static constexpr size_t big_batch_size = desc::BigBatchSize; ///< The number of batches kept in cache
 
+    /*!
+     * \brief Indicates if the labels can be the inputs themselves, for
+     * auto-encoders reconstructing their inputs.
+     */
+    static constexpr bool shareable_labels = desc::AutoEncoder && std::is_same<big_data_cache_type, big_label_cache_type>::value;
+
     big_data_cache_type batch_cache;  ///< The data batch cache
     big_label_cache_type label_cache; ///< The label batch cache
 
@@ -47,6 +58,7 @@ struct outmemory_data_generator<Iterator, LIterator, Desc, std::enable_if_t<!is_
     size_t current_real = 0;     ///< The current real index
     size_t current_b    = 0;     ///< The current batch
     bool is_safe        = false; ///< Indicates if the generator is safe to reclaim memory from
+    bool shared_labels  = false; ///< Indicates if the labels are the inputs themselves (no label cache)
 
     const size_t _size; ///< The size of the dataset
     Iterator orig_it;   ///< The original first iterator on data
@@ -66,8 +78,18 @@ struct outmemory_data_generator<Iterator, LIterator, Desc, std::enable_if_t<!is_
      */
     outmemory_data_generator(Iterator first, Iterator last, LIterator lfirst, LIterator llast, size_t n_classes, size_t size)
             : _size(size), orig_it(first), orig_lit(lfirst), it(orig_it), lit(orig_lit) {
+        // An auto-encoder trained on its own inputs does not need a copy of them
+        if constexpr (shareable_labels && std::is_same<Iterator, LIterator>::value) {
+            shared_labels = first == lfirst;
+        }
+
         data_cache_helper_t::init_big(first, batch_cache);
-        label_cache_helper_t::init_big(n_classes, lfirst, label_cache);
+
+        if (!shared_labels) {
+            label_cache_helper_t::init_big(n_classes, lfirst, label_cache);
+        }
+
+        advise_huge_pages(std::tie(batch_cache, label_cache));
 
         reset();
 
@@ -151,17 +173,15 @@ struct outmemory_data_generator<Iterator, LIterator, Desc, std::enable_if_t<!is_
 
                 sub = *it;
 
-                pre_scaler<desc>::transform(sub);
-                pre_normalizer<desc>::transform(sub);
-                pre_binarizer<desc>::transform(sub);
+                pre_transformer<desc>::transform(sub);
 
-                label_cache_helper_t::set(i, lit, label_cache(b));
+                if (!shared_labels) {
+                    label_cache_helper_t::set(i, lit, label_cache(b));
 
-                // In case of auto-encoders, the label images also need to be transformed
-                if constexpr (desc::AutoEncoder) {
-                    pre_scaler<desc>::transform(label_cache(b)(i));
-                    pre_normalizer<desc>::transform(label_cache(b)(i));
-                    pre_binarizer<desc>::transform(label_cache(b)(i));
+                    // In case of auto-encoders, the label images also need to be transformed
+                    if constexpr (desc::AutoEncoder) {
+                        pre_transformer<desc>::transform(label_cache(b)(i));
+                    }
                 }
 
                 ++i;
@@ -224,6 +244,13 @@ struct outmemory_data_generator<Iterator, LIterator, Desc, std::enable_if_t<!is_
         return _size;
     }
 
+    /*!
+     * \brief Returns the number of bytes of the caches of the generator
+     */
+    size_t memory() const {
+        return memory_bytes(batch_cache, label_cache);
+    }
+
     /*!
      * \brief Returns the augmented number of elements in the generator.
      *
@@ -280,7 +307,19 @@ struct outmemory_data_generator<Iterator, LIterator, Desc, std::enable_if_t<!is_
      * \return a a batch of label.
      */
     auto label_batch() const {
-        return etl::slice(label_cache(current_b), 0, std::min(batch_size, current_real - current));
+        return etl::slice(labels()(current_b), 0, std::min(batch_size, current_real - current));
+    }
+
+    /*!
+     * \brief Returns the label batch cache (the data batch cache itself for
+     * an auto-encoder of its inputs)
+     */
+    const big_label_cache_type& labels() const {
+        if constexpr (shareable_labels) {
+            return shared_labels ? batch_cache : label_cache;
+        } else {
+            return label_cache;
+        }
     }
 
     /*!
@@ -299,6 +338,7 @@ template <typename Iterator, typename LIterator, typename Desc>
 struct outmemory_data_generator<Iterator, LIterator, Desc, std::enable_if_t<is_augmented<Desc> || is_threaded<Desc>>> {
     using desc                 = Desc;                                        ///< The generator descriptor
     using weight               = etl::value_t<typename Iterator::value_type>; ///< The data type
+    using raw_type             = typename Iterator::value_type;               ///< The type of a raw input
     using data_cache_helper_t  = cache_helper<desc, Iterator>;                ///< The helper for the data cache
     using label_cache_helper_t = label_cache_helper<desc, weight, LIterator>; ///< The helper for the label cache
 
@@ -308,25 +348,33 @@ struct outmemory_data_generator<Iterator, LIterator, Desc, std::enable_if_t<is_a
     static constexpr bool dll_generator    = true;               ///< Simple flag to indicate that the class is a DLL generator
     static constexpr size_t batch_size     = desc::BatchSize;    ///< The size of the generated batches
     static constexpr size_t big_batch_size = desc::BigBatchSize; ///< The number of batches kept in cache
+    static constexpr size_t workers        = desc::Workers;      ///< The number of threads preparing batches
+
+    static constexpr bool prefetch = desc::GpuPrefetch && gpu_prefetch_support(); ///< Indicates if the batches are prefetched to the GPU by the workers
+
+    /*!
+     * \brief Indicates if the labels can be the inputs themselves, for
+     * auto-encoders reconstructing their inputs (the augmentations change
+     * the inputs, not the labels).
+     */
+    static constexpr bool shareable_labels = desc::AutoEncoder && !is_augmented<Desc> && std::is_same<big_data_cache_type, big_label_cache_type>::value;
 
     big_data_cache_type batch_cache;  ///< The data batch cache
     big_label_cache_type label_cache; ///< The label batch cache
 
-    size_t current      = 0;     ///< The current index
-    size_t current_read = 0;     ///< The current index read
-    bool is_safe        = false; ///< Indicates if the generator is safe to reclaim memory from
+    size_t current     = 0;     ///< The current index
+    bool is_safe       = false; ///< Indicates if the generator is safe to reclaim memory from
+    bool shared_labels = false; ///< Indicates if the labels are the inputs themselves (no label cache)
 
-    mutable volatile bool status[big_batch_size];    ///< Status of each batch
-    mutable volatile size_t indices[big_batch_size]; ///< Indices of each batch
+    size_t generation = 0; ///< The current generation (incremented at each reset)
 
-    mutable std::mutex main_lock;                    ///< The main lock
-    mutable std::condition_variable condition;       ///< The condition variable for the thread to wait for some space
-    mutable std::condition_variable ready_condition; ///< The condition variable for a reader to wait for ready data
+    batch_ring_t<desc> ring; ///< The ring of batches between the workers and the consumer
 
-    volatile bool stop_flag = false; ///< Boolean flag indicating to the thread to stop
+    mutable gpu_batch_slots<weight, etl::dimensions<big_data_cache_type>() - 1> data_slots; ///< The device copies of the batches (only used with prefetch)
 
-    std::thread main_thread; ///< The main thread
-    bool train_mode = false; ///< The train mode status
+    std::vector<std::thread> threads;             ///< The worker threads
+    std::vector<std::vector<raw_type>> raw_cache; ///< The raw inputs read by each worker
+    bool train_mode = false;                      ///< The train mode status
 
     const size_t _size; ///< The size of the dataset
     Iterator orig_it;   ///< The original first iterator on data
@@ -349,130 +397,152 @@ struct outmemory_data_generator<Iterator, LIterator, Desc, std::enable_if_t<is_a
      * \param size The size of the entire dataset
      */
     outmemory_data_generator(Iterator first, Iterator last, LIterator lfirst, LIterator llast, size_t n_classes, size_t size)
-            : _size(size), orig_it(first), orig_lit(lfirst), it(orig_it), lit(orig_lit), cropper(*first), mirrorer(*first), distorter(*first), noiser(*first) {
+            : ring(size / batch_size + (size % batch_size == 0 ? 0 : 1)),
+              _size(size), orig_it(first), orig_lit(lfirst), it(orig_it), lit(orig_lit), cropper(*first), mirrorer(*first), distorter(*first), noiser(*first) {
+        // An auto-encoder trained on its own inputs does not need a copy of them
+        if constexpr (shareable_labels && std::is_same<Iterator, LIterator>::value) {
+            shared_labels = first == lfirst;
+        }
+
         data_cache_helper_t::init_big(first, batch_cache);
-        label_cache_helper_t::init_big(n_classes, lfirst, label_cache);
+
+        if (!shared_labels) {
+            label_cache_helper_t::init_big(n_classes, lfirst, label_cache);
+        }
+
+        advise_huge_pages(std::tie(batch_cache, label_cache));
+
+        if constexpr (prefetch) {
+            data_slots.init(big_batch_size, batch_size, batch_cache(0)(0));
+        }
 
         cpp_unused(last);
         cpp_unused(llast);
 
-        main_thread = std::thread([this] {
-            while (true) {
-                // The index of the batch inside the batch cache
-                size_t index = 0;
+        raw_cache.resize(workers);
 
-                {
-                    std::unique_lock<std::mutex> ulock(main_lock);
+        for (size_t w = 0; w < workers; ++w) {
+            raw_cache[w].resize(batch_size);
+        }
 
-                    bool found = false;
+        for (size_t w = 0; w < workers; ++w) {
+            threads.emplace_back([this, w] { worker_main(w); });
+        }
+    }
 
-                    // Try to find a read batch first
-                    for (size_t b = 0; b < big_batch_size; ++b) {
-                        if (!status[b] && indices[b] * batch_size < _size) {
-                            index = b;
-                            found = true;
-                            break;
-                        }
-                    }
+    outmemory_data_generator(const outmemory_data_generator& rhs) = delete;
+    outmemory_data_generator& operator=(const outmemory_data_generator& rhs) = delete;
 
-                    // if not found, wait for a ready to compute batch
-
-                    if (!found) {
-                        // Wait for the end or for some work
-                        condition.wait(ulock, [this, &index] {
-                            if (stop_flag) {
-                                return true;
-                            }
-
-                            for (size_t b = 0; b < big_batch_size; ++b) {
-                                if (!status[b] && indices[b] * batch_size < _size) {
-                                    index = b;
-                                    return true;
-                                }
-                            }
-
-                            return false;
-                        });
-
-                        // If there is no more thread for the thread, exit
-                        if (stop_flag) {
-                            return;
-                        }
-                    }
-                }
+    outmemory_data_generator(outmemory_data_generator&& rhs) = delete;
+    outmemory_data_generator& operator=(outmemory_data_generator&& rhs) = delete;
 
-                SERIAL_SECTION {
-                    for (size_t i = 0; i < batch_size && current_read < _size; ++i) {
-                        auto sub = batch_cache(index)(i);
+    /*!
+     * \brief Destructs the outmemory_data_generator
+     */
+    ~outmemory_data_generator() {
+        ring.stop();
+
+        for (auto& thread : threads) {
+            thread.join();
+        }
+    }
 
-                        if (train_mode) {
-                            // Random crop the image
-                            cropper.transform_first(sub, *it);
+    /*!
+     * \brief The main function of a worker thread.
+     *
+     * Each worker claims the next batch in order, reads the raw inputs
+     * from the iterators and then applies the transformations in
+     * parallel with the other workers.
+     *
+     * \param w The index of the worker
+     */
+    void worker_main(size_t w) {
+        pin_thread(execution().generators, w);
 
-                            pre_scaler<desc>::transform(sub);
-                            pre_normalizer<desc>::transform(sub);
-                            pre_binarizer<desc>::transform(sub);
+        auto& raw = raw_cache[w];
 
-                            // Mirror the image
-                            mirrorer.transform(sub);
+        size_t batch = 0;
 
-                            // Distort the image
-                            distorter.transform(sub);
+        while (ring.acquire(batch)) {
+            dll::auto_timer timer("generator:fill");
 
-                            // Noise the image
-                            noiser.transform(sub);
-                        } else {
-                            // Center crop the image
-                            cropper.transform_first_test(sub, *it);
+            const size_t index = batch % big_batch_size;
 
-                            pre_scaler<desc>::transform(sub);
-                            pre_normalizer<desc>::transform(sub);
-                            pre_binarizer<desc>::transform(sub);
-                        }
+            // Only one worker reads from the iterators at the same time,
+            // in the order of the batches
 
-                        label_cache_helper_t::set(i, lit, label_cache(index));
+            const size_t n = std::min(batch_size, _size - batch * batch_size);
 
-                        // In case of auto-encoders, the label images also need to be transformed
-                        if constexpr (desc::AutoEncoder){
-                            pre_scaler<desc>::transform(label_cache(index)(i));
-                            pre_normalizer<desc>::transform(label_cache(index)(i));
-                            pre_binarizer<desc>::transform(label_cache(index)(i));
-                        }
+            for (size_t i = 0; i < n; ++i) {
+                raw[i] = *it;
 
-                        ++it;
-                        ++lit;
-                        ++current_read;
-                    }
+                if (!shared_labels) {
+                    label_cache_helper_t::set(i, lit, label_cache(index));
                 }
 
-                // Notify a waiter that one batch is ready
+                ++it;
+                ++lit;
+            }
 
-                {
-                    std::unique_lock<std::mutex> ulock(main_lock);
+            ring.end_read(batch);
 
-                    status[index] = true;
+            // The transformations are done concurrently by the workers
 
-                    ready_condition.notify_one();
+            random_stream g(generation, batch);
+
+            SERIAL_SECTION {
+                for (size_t i = 0; i < n; ++i) {
+                    if (train_mode) {
+                        // Random crop and mirror the image in a single copy
+                        const auto mirror = mirrorer.draw(g);
+                        cropper.transform_first(batch_cache(index)(i), raw[i], g, mirror.first, mirror.second);
+                    } else {
+                        // Center crop the image
+                        cropper.transform_first_test(batch_cache(index)(i), raw[i]);
+                    }
                 }
+
+                // The other transformations are applied on the whole batch
+
+                transform_batch(index, n, g);
             }
-        });
-    }
 
-    outmemory_data_generator(const outmemory_data_generator& rhs) = delete;
-    outmemory_data_generator& operator=(const outmemory_data_generator& rhs) = delete;
+            // The copy to the GPU is done by the worker, before the consumer needs the batch
+            if constexpr (prefetch) {
+                data_slots.upload(index, etl::slice(batch_cache(index), 0, n));
+            }
 
-    outmemory_data_generator(outmemory_data_generator&& rhs) = delete;
-    outmemory_data_generator& operator=(outmemory_data_generator&& rhs) = delete;
+            // Notify the consumer that one batch is ready
+            ring.publish(batch);
+        }
+    }
 
     /*!
-     * \brief Destructs the outmemory_data_generator
+     * \brief Apply the preprocessing and the augmentations on the first
+     * n images of a batch.
+     * \param index The index of the batch in the cache
+     * \param n The number of images in the batch
+     * \param g The random engine
      */
-    ~outmemory_data_generator() {
-        cpp::with_lock(main_lock, [this] { stop_flag = true; });
+    template <typename G>
+    void transform_batch(size_t index, size_t n, G& g) {
+        auto samples = etl::slice(batch_cache(index), 0, n);
 
-        condition.notify_all();
+        pre_transformer<desc>::transform_all(samples);
+
+        if (train_mode) {
+            distorter.transform_batch(batch_cache(index), n, g);
+            noiser.transform_batch(batch_cache(index), n, g);
+        }
 
-        main_thread.join();
+        // In case of auto-encoders, the label images also need to be transformed
+        if constexpr (desc::AutoEncoder) {
+            if (!shared_labels) {
+                auto labels = etl::slice(label_cache(index), 0, n);
+
+                pre_transformer<desc>::transform_all(labels);
+            }
+        }
     }
 
     /*!
@@ -489,6 +559,10 @@ struct outmemory_data_generator<Iterator, LIterator, Desc, std::enable_if_t<is_a
             stream << "    Augmented Size: " << augmented_size() << std::endl;
         }
 
+        if (workers > 1) {
+            stream << "           Workers: " << workers << std::endl;
+        }
+
         return stream;
     }
 
@@ -537,18 +611,12 @@ struct outmemory_data_generator<Iterator, LIterator, Desc, std::enable_if_t<is_a
      * \brief Reset the generation
      */
     void reset_generation() {
-        std::unique_lock<std::mutex> ulock(main_lock);
-
-        current_read = 0;
-        it           = orig_it;
-        lit          = orig_lit;
-
-        for (size_t b = 0; b < big_batch_size; ++b) {
-            status[b]  = false;
-            indices[b] = b;
-        }
+        ring.reset([this] {
+            ++generation;
 
-        condition.notify_one();
+            it  = orig_it;
+            lit = orig_lit;
+        });
     }
 
     /*!
@@ -598,6 +666,21 @@ struct outmemory_data_generator<Iterator, LIterator, Desc, std::enable_if_t<is_a
         return _size;
     }
 
+    /*!
+     * \brief Returns the number of bytes of the caches of the generator
+     */
+    size_t memory() const {
+        return memory_bytes(batch_cache, label_cache, raw_cache) + data_slots.memory();
+    }
+
+    /*!
+     * \brief Returns the counters of the generator (waits of the consumer,
+     * fills of the producers and occupancy of the ring)
+     */
+    const generator_stats& stats() const {
+        return ring.stats;
+    }
+
     /*!
      * \brief Returns the augmented number of elements in the generator.
      *
@@ -632,18 +715,8 @@ struct outmemory_data_generator<Iterator, LIterator, Desc, std::enable_if_t<is_a
      * This should only be called if the generator has a next batch.
      */
     void next_batch() {
-        // Get information from batch that has been consumed
-        const auto batch = current / batch_size;
-        const auto b     = batch % big_batch_size;
-
-        {
-            std::unique_lock<std::mutex> ulock(main_lock);
-
-            status[b] = false;
-            indices[b] += big_batch_size;
-
-            condition.notify_one();
-        }
+        // Release the batch that has been consumed
+        ring.release(current / batch_size);
 
         current += batch_size;
     }
@@ -653,20 +726,15 @@ struct outmemory_data_generator<Iterator, LIterator, Desc, std::enable_if_t<is_a
      * \return a a batch of data.
      */
     auto data_batch() const {
-        std::unique_lock<std::mutex> ulock(main_lock);
-
         const auto batch = current / batch_size;
-        const auto b     = batch % big_batch_size;
-
-        if (status[b]) {
-            return etl::slice(batch_cache(b), 0, std::min(batch_size, _size - current));
-        }
 
-        ready_condition.wait(ulock, [this, b] {
-            return status[b];
-        });
+        ring.wait_ready(batch);
 
-        return etl::slice(batch_cache(b), 0, std::min(batch_size, _size - current));
+        if constexpr (prefetch) {
+            return data_slots.batch(batch % big_batch_size);
+        } else {
+            return etl::slice(batch_cache(batch % big_batch_size), 0, std::min(batch_size, _size - current));
+        }
     }
 
     /*!
@@ -674,20 +742,23 @@ struct outmemory_data_generator<Iterator, LIterator, Desc, std::enable_if_t<is_a
      * \return a a batch of label.
      */
     auto label_batch() const {
-        std::unique_lock<std::mutex> ulock(main_lock);
-
         const auto batch = current / batch_size;
-        const auto b     = batch % big_batch_size;
 
-        if (status[b]) {
-            return etl::slice(label_cache(b), 0, std::min(batch_size, _size - current));
-        }
+        ring.wait_ready(batch);
 
-        ready_condition.wait(ulock, [this, b] {
-            return status[b];
-        });
+        return etl::slice(labels()(batch % big_batch_size), 0, std::min(batch_size, _size - current));
+    }
 
-        return etl::slice(label_cache(b), 0, std::min(batch_size, _size - current));
+    /*!
+     * \brief Returns the label batch cache (the data batch cache itself for
+     * an auto-encoder of its inputs)
+     */
+    const big_label_cache_type& labels() const {
+        if constexpr (shareable_labels) {
+            return shared_labels ? batch_cache : label_cache;
+        } else {
+            return label_cache;
+        }
     }
 
     /*!
@@ -713,6 +784,9 @@ const size_t outmemory_data_generator<Iterator, LIterator, Desc, std::enable_if_
 template <typename Iterator, typename LIterator, typename Desc>
 const size_t outmemory_data_generator<Iterator, LIterator, Desc, std::enable_if_t<is_augmented<Desc> || is_threaded<Desc>>>::big_batch_size;
 
+template <typename Iterator, typename LIterator, typename Desc>
+const size_t outmemory_data_generator<Iterator, LIterator, Desc, std::enable_if_t<is_augmented<Desc> || is_threaded<Desc>>>::workers;
+
 /*!
  * \brief Display the given generator on the given stream
  * \param os The output stream
@@ -759,10 +833,25 @@ struct outmemory_data_generator_desc {
      */
     static constexpr bool VerticalMirroring = parameters::template contains<vertical_mirroring>();
 
+    /*!
+     * \brief The number of workers preparing the batches
+     */
+    static constexpr size_t Workers = detail::get_value_v<workers<1>, Parameters...>;
+
     /*!
      * \brief Indicates if the generator is threaded
      */
-    static constexpr bool Threaded = parameters::template contains<threaded>();
+    static constexpr bool Threaded = parameters::template contains<threaded>() || Workers > 1;
+
+    /*!
+     * \brief Indicates if the batches are handed over with a lock-free ring
+     */
+    static constexpr bool LockFree = parameters::template contains<lock_free>();
+
+    /*!
+     * \brief Indicates if the next batch is prefetched to the GPU
+     */
+    static constexpr bool GpuPrefetch = parameters::template contains<gpu_prefetch>();
 
     /*!
      * \brief The random cropping X
@@ -779,11 +868,21 @@ struct outmemory_data_generator_desc {
      */
     static constexpr size_t ElasticDistortion = detail::get_value_v<elastic_distortion<0>, Parameters...>;
 
+    /*!
+     * \brief The number of precomputed displacement fields for elastic distortion
+     */
+    static constexpr size_t DistortionBank = detail::get_value_v<distortion_bank<0>, Parameters...>;
+
     /*!
      * \brief The noise
      */
     static constexpr size_t Noise = detail::get_value_v<noise<0>, Parameters...>;
 
+    /*!
+     * \brief The type of noise
+     */
+    static constexpr auto NoiseKind = detail::get_value_v<noise_kind<noise_type::MASKING>, Parameters...>;
+
     /*!
      * \brief The scaling
      */
@@ -806,6 +905,7 @@ struct outmemory_data_generator_desc {
 
     static_assert(BatchSize > 0, "The batch size must be larger than one");
     static_assert(BigBatchSize > 0, "The big batch size must be larger than one");
+    static_assert(Workers > 0, "The generator needs at least one worker");
     static_assert(!(AutoEncoder && (random_crop_x || random_crop_y)), "autoencoder mode is not compatible with random crop");
 
     //Make sure only valid types are passed to the configuration list
@@ -813,7 +913,7 @@ struct outmemory_data_generator_desc {
         detail::is_valid_v<
             cpp::type_list<
                 batch_size_id, big_batch_size_id, horizontal_mirroring_id, vertical_mirroring_id, random_crop_id,
-                elastic_distortion_id, categorical_id, noise_id, threaded_id, nop_id, normalize_pre_id, binarize_pre_id, scale_pre_id, autoencoder_id>,
+                elastic_distortion_id, distortion_bank_id, categorical_id, noise_id, noise_kind_id, threaded_id, workers_id, lock_free_id, gpu_prefetch_id, nop_id, normalize_pre_id, binarize_pre_id, scale_pre_id, autoencoder_id>,
             Parameters...>,
         "Invalid parameters type for rbm_desc");
 
@@ -842,4 +942,25 @@ auto make_generator(const Container& container, const LContainer& lcontainer, si
     return std::make_unique<generator_t>(container.begin(), container.end(), lcontainer.begin(), lcontainer.end(), n_classes, size);
 }
 
+/*!
+ * \brief Make an out of memory data generator from a shard of the given range
+ */
+template <typename Iterator, typename LIterator, typename... Parameters>
+auto make_generator(Iterator first, Iterator last, LIterator lfirst, LIterator llast, size_t size, size_t n_classes, const shard& s, const outmemory_data_generator_desc<Parameters...>& desc) {
+    auto mask = std::make_shared<const std::vector<bool>>(s.members(size));
+
+    auto range  = make_shard_range(first, last, mask);
+    auto lrange = make_shard_range(lfirst, llast, mask);
+
+    return make_generator(range.first, range.second, lrange.first, lrange.second, s.size(size), n_classes, desc);
+}
+
+/*!
+ * \brief Make an out of memory data generator from a shard of the given containers
+ */
+template <typename Container, typename LContainer, typename... Parameters>
+auto make_generator(const Container& container, const LContainer& lcontainer, size_t size, size_t n_classes, const shard& s, const outmemory_data_generator_desc<Parameters...>& desc) {
+    return make_generator(container.begin(), container.end(), lcontainer.begin(), lcontainer.end(), size, n_classes, s, desc);
+}
+
 } //end of dll namespace
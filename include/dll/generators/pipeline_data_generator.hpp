@@ -0,0 +1,713 @@
+//=======================================================================
+// Copyright (c) 2014-2017 Baptiste Wicht
+// Distributed under the terms of the MIT License.
+// (See accompanying file LICENSE or copy at
+//  http://opensource.org/licenses/MIT)
+//=======================================================================
+
+/*!
+ * \file
+ * \brief Out-of-memory data generator made of a pipeline of stages
+ */
+
+#pragma once
+
+#include <atomic>
+#include <algorithm>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <unordered_map>
+#include <condition_variable>
+
+#include "dll/util/huge_pages.hpp"
+
+namespace dll {
+
+/*!
+ * \brief The configuration of one stage of a pipeline
+ */
+struct pipeline_stage {
+    size_t workers  = 1; ///< The number of threads of the stage
+    size_t capacity = 2; ///< The maximum number of batches waiting for the stage
+};
+
+/*!
+ * \brief The configuration of the stages of a pipeline generator.
+ *
+ * The reading of the inputs is always done by a single thread, in the
+ * order of the dataset, and the batches are collated, in order, by the
+ * consumer.
+ */
+struct pipeline_options {
+    pipeline_stage decode;     ///< The conversion, crop and mirror of the raw inputs
+    pipeline_stage preprocess; ///< The scaling, normalization and binarization of the inputs
+    pipeline_stage augment;    ///< The elastic distortion and the noise of the inputs
+};
+
+namespace pipeline_detail {
+
+/*!
+ * \brief A bounded queue of batches between two stages of a pipeline.
+ *
+ * The producers wait while the queue is full, the consumers wait while
+ * it is empty. Once closed, all the waiting threads are woken up.
+ */
+struct bounded_queue {
+    /*!
+     * \brief Create a queue holding at most capacity batches
+     */
+    explicit bounded_queue(size_t capacity) : capacity(std::max(capacity, size_t(1))) {}
+
+    bounded_queue(const bounded_queue& rhs) = delete;
+    bounded_queue& operator=(const bounded_queue& rhs) = delete;
+
+    /*!
+     * \brief Add a batch to the queue, waiting for some space
+     * \return true if the batch was added, false if the queue is closed
+     */
+    bool push(size_t item) {
+        std::unique_lock<std::mutex> l(lock);
+
+        space_condition.wait(l, [this] { return closed || items.size() < capacity; });
+
+        if (closed) {
+            return false;
+        }
+
+        items.push_back(item);
+
+        ready_condition.notify_one();
+
+        return true;
+    }
+
+    /*!
+     * \brief Remove a batch from the queue, waiting for one
+     * \return true if a batch was removed, false if the queue is closed
+     */
+    bool pop(size_t& item) {
+        std::unique_lock<std::mutex> l(lock);
+
+        ready_condition.wait(l, [this] { return closed || !items.empty(); });
+
+        if (closed) {
+            return false;
+        }
+
+        item = items.front();
+        items.pop_front();
+
+        space_condition.notify_one();
+
+        return true;
+    }
+
+    /*!
+     * \brief Close the queue
+     */
+    void close() {
+        std::lock_guard<std::mutex> l(lock);
+
+        closed = true;
+
+        space_condition.notify_all();
+        ready_condition.notify_all();
+    }
+
+private:
+    const size_t capacity;    ///< The maximum number of batches in the queue
+    std::deque<size_t> items; ///< The batches in the queue
+    bool closed = false;      ///< Indicates if the queue is closed
+
+    std::mutex lock;                         ///< The lock protecting the queue
+    std::condition_variable space_condition; ///< The condition of the producers
+    std::condition_variable ready_condition; ///< The condition of the consumers
+};
+
+} //end of namespace pipeline_detail
+
+/*!
+ * \brief An out-of-memory data generator made of a pipeline of stages.
+ *
+ * A reader thread reads the raw inputs and the labels of the batches, in
+ * order, from the iterators. The batches then go through the decode
+ * (conversion, crop and mirror), preprocess (scaling, normalization and
+ * binarization) and augment (elastic distortion and noise) stages, each
+ * with its own number of workers and its own bounded queue, so that only
+ * the bottleneck stage of a dataset needs more threads. The batches are
+ * collated back in order for the consumer.
+ *
+ * The whole pipeline holds at most BigBatchSize batches: the reader waits
+ * for the consumer once they are all in flight.
+ */
+template <typename Iterator, typename LIterator, typename Desc>
+struct pipeline_data_generator {
+    using desc                 = Desc;                                        ///< The generator descriptor
+    using weight               = etl::value_t<typename Iterator::value_type>; ///< The data type
+    using raw_type             = typename Iterator::value_type;               ///< The type of a raw input
+    using data_cache_helper_t  = cache_helper<desc, Iterator>;                ///< The helper for the data cache
+    using label_cache_helper_t = label_cache_helper<desc, weight, LIterator>; ///< The helper for the label cache
+
+    using big_data_cache_type  = typename data_cache_helper_t::big_cache_type;  ///< The type of the big data cache
+    using big_label_cache_type = typename label_cache_helper_t::big_cache_type; ///< The type of the big label cache
+
+    static constexpr bool dll_generator    = true;               ///< Simple flag to indicate that the class is a DLL generator
+    static constexpr size_t batch_size     = desc::BatchSize;    ///< The size of the generated batches
+    static constexpr size_t big_batch_size = desc::BigBatchSize; ///< The number of batches in flight in the pipeline
+
+    big_data_cache_type batch_cache;  ///< The data batch cache
+    big_label_cache_type label_cache; ///< The label batch cache
+
+    size_t current = 0;     ///< The current index
+    bool is_safe   = false; ///< Indicates if the generator is safe to reclaim memory from
+
+    const size_t _size; ///< The size of the dataset
+    Iterator orig_it;   ///< The original first iterator on data
+    LIterator orig_lit; ///< The original first iterator on label
+    Iterator it;        ///< The current iterator on data
+    LIterator lit;      ///< The current iterator on label
+
+    random_cropper<Desc> cropper;      ///< The random cropper
+    random_mirrorer<Desc> mirrorer;    ///< The random mirrorer
+    elastic_distorter<Desc> distorter; ///< The elastic distorter
+    random_noise<Desc> noiser;         ///< The random noiser
+
+    /*!
+     * \brief Construct a pipeline_data_generator
+     * \param first The iterator on the beginning on data
+     * \param last The iterator on the end  on data
+     * \param lfirst The iterator on the beginning on labels
+     * \param llast The iterator on the end  on labels
+     * \param n_classes The number of classes
+     * \param size The size of the entire dataset
+     * \param options The configuration of the stages
+     */
+    pipeline_data_generator(Iterator first, Iterator last, LIterator lfirst, LIterator llast, size_t n_classes, size_t size, const pipeline_options& options)
+            : _size(size), orig_it(first), orig_lit(lfirst), it(orig_it), lit(orig_lit),
+              cropper(*first), mirrorer(*first), distorter(*first), noiser(*first),
+              options(options), free_queue(big_batch_size), decode_queue(options.decode.capacity),
+              preprocess_queue(options.preprocess.capacity), augment_queue(options.augment.capacity) {
+        data_cache_helper_t::init_big(first, batch_cache);
+        label_cache_helper_t::init_big(n_classes, lfirst, label_cache);
+
+        advise_huge_pages(std::tie(batch_cache, label_cache));
+
+        cpp_unused(last);
+        cpp_unused(llast);
+
+        raw_cache.resize(big_batch_size);
+        item_batch.resize(big_batch_size);
+        item_generation.resize(big_batch_size);
+
+        for (size_t i = 0; i < big_batch_size; ++i) {
+            raw_cache[i].resize(batch_size);
+            free_queue.push(i);
+        }
+
+        threads.emplace_back([this] { read_main(); });
+
+        start_stage(options.decode, decode_queue, preprocess_queue, [this](size_t item) { decode(item); });
+        start_stage(options.preprocess, preprocess_queue, augment_queue, [this](size_t item) { preprocess(item); });
+
+        for (size_t w = 0; w < std::max(options.augment.workers, size_t(1)); ++w) {
+            threads.emplace_back([this] {
+                size_t item;
+                while (augment_queue.pop(item)) {
+                    if (current_item(item)) {
+                        augment(item);
+                    }
+
+                    collate(item);
+                }
+            });
+        }
+    }
+
+    pipeline_data_generator(const pipeline_data_generator& rhs) = delete;
+    pipeline_data_generator& operator=(const pipeline_data_generator& rhs) = delete;
+
+    pipeline_data_generator(pipeline_data_generator&& rhs) = delete;
+    pipeline_data_generator& operator=(pipeline_data_generator&& rhs) = delete;
+
+    /*!
+     * \brief Destructs the pipeline_data_generator
+     */
+    ~pipeline_data_generator() {
+        {
+            std::lock_guard<std::mutex> l(ready_lock);
+
+            stopped = true;
+
+            reader_condition.notify_all();
+            ready_condition.notify_all();
+        }
+
+        free_queue.close();
+        decode_queue.close();
+        preprocess_queue.close();
+        augment_queue.close();
+
+        for (auto& thread : threads) {
+            thread.join();
+        }
+    }
+
+    /*!
+     * \brief Display a description of the generator in the given stream
+     * \param stream The stream to print to
+     * \return stream
+     */
+    std::ostream& display(std::ostream& stream) const {
+        stream << "Pipeline Data Generator" << std::endl;
+        stream << "              Size: " << size() << std::endl;
+        stream << "           Batches: " << batches() << std::endl;
+
+        if (augmented_size() != size()) {
+            stream << "    Augmented Size: " << augmented_size() << std::endl;
+        }
+
+        stream << "            Decode: " << options.decode.workers << " workers" << std::endl;
+        stream << "        Preprocess: " << options.preprocess.workers << " workers" << std::endl;
+        stream << "           Augment: " << options.augment.workers << " workers" << std::endl;
+
+        return stream;
+    }
+
+    /*!
+     * \brief Display a description of the generator in the standard output.
+     */
+    void display() const {
+        display(std::cout);
+    }
+
+    /*!
+     * \brief Indicates that it is safe to destroy the memory of the generator
+     * when not used by the pretraining phase
+     */
+    void set_safe() {
+        is_safe = true;
+    }
+
+    /*!
+     * \brief Clear the memory of the generator.
+     *
+     * The caches are never cleared since they are used by the stages until
+     * the generator is destroyed.
+     */
+    void clear() {
+        // Nothing to do
+    }
+
+    /*!
+     * brief Sets the generator in test mode
+     */
+    void set_test() {
+        train_mode = false;
+    }
+
+    /*!
+     * brief Sets the generator in train mode
+     */
+    void set_train() {
+        train_mode = true;
+    }
+
+    /*!
+     * \brief Reset the generator to the beginning
+     */
+    void reset() {
+        std::vector<size_t> released;
+
+        {
+            std::lock_guard<std::mutex> l(ready_lock);
+
+            ++generation;
+
+            // The collated batches of the previous generation are discarded
+            for (auto& ready : ready_batches) {
+                released.push_back(ready.second);
+            }
+
+            ready_batches.clear();
+
+            if (held) {
+                released.push_back(held_item);
+            }
+
+            restart = true;
+
+            reader_condition.notify_all();
+        }
+
+        for (auto item : released) {
+            free_queue.push(item);
+        }
+
+        current = 0;
+        held    = false;
+    }
+
+    /*!
+     * \brief Reset the generator and shuffle the order of samples
+     */
+    void reset_shuffle() {
+        cpp_unreachable("Pipeline generator cannot be shuffled");
+    }
+
+    /*!
+     * \brief Shuffle the order of the samples.
+     *
+     * This should only be done when the generator is at the beginning.
+     */
+    void shuffle() {
+        cpp_unreachable("Pipeline generator cannot be shuffled");
+    }
+
+    /*!
+     * \brief Prepare the dataset for an epoch
+     */
+    void prepare_epoch(){
+        // Nothing can be done here
+    }
+
+    /*!
+     * \brief Return the index of the current batch in the generation
+     * \return The current batch index
+     */
+    size_t current_batch() const {
+        return current / batch_size;
+    }
+
+    /*!
+     * \brief Returns the number of elements in the generator
+     * \return The number of elements in the generator
+     */
+    size_t size() const {
+        return _size;
+    }
+
+    /*!
+     * \brief Returns the number of bytes of the caches of the generator
+     */
+    size_t memory() const {
+        return memory_bytes(batch_cache, label_cache, raw_cache);
+    }
+
+    /*!
+     * \brief Returns the augmented number of elements in the generator.
+     *
+     * This number may be an estimate, depending on which augmentation
+     * techniques are enabled.
+     *
+     * \return The augmented number of elements in the generator
+     */
+    size_t augmented_size() const {
+        return cropper.scaling() * mirrorer.scaling() * noiser.scaling() * distorter.scaling() * size();
+    }
+
+    /*!
+     * \brief Returns the number of batches in the generator.
+     * \return The number of batches in the generator
+     */
+    size_t batches() const {
+        return size() / batch_size + (size() % batch_size == 0 ? 0 : 1);
+    }
+
+    /*!
+     * \brief Indicates if the generator has a next batch or not
+     * \return true if the generator has a next batch, false otherwise
+     */
+    bool has_next_batch() const {
+        return current < size();
+    }
+
+    /*!
+     * \brief Moves to the next batch.
+     *
+     * This should only be called if the generator has a next batch.
+     */
+    void next_batch() {
+        // The consumed batch goes back to the reader
+        free_queue.push(acquire());
+
+        held = false;
+
+        current += batch_size;
+    }
+
+    /*!
+     * \brief Returns the current data batch
+     * \return a a batch of data.
+     */
+    auto data_batch() const {
+        return etl::slice(batch_cache(acquire()), 0, std::min(batch_size, _size - current));
+    }
+
+    /*!
+     * \brief Returns the current label batch
+     * \return a a batch of label.
+     */
+    auto label_batch() const {
+        return etl::slice(label_cache(acquire()), 0, std::min(batch_size, _size - current));
+    }
+
+    /*!
+     * \brief Returns the number of dimensions of the input.
+     * \return The number of dimensions of the input.
+     */
+    static constexpr size_t dimensions() {
+        return etl::dimensions<big_data_cache_type>() - 2;
+    }
+
+private:
+    /*!
+     * \brief Start the workers of a stage, applying the given functor on
+     * the batches of the current generation
+     */
+    template <typename Functor>
+    void start_stage(const pipeline_stage& stage, pipeline_detail::bounded_queue& input, pipeline_detail::bounded_queue& output, Functor functor) {
+        for (size_t w = 0; w < std::max(stage.workers, size_t(1)); ++w) {
+            threads.emplace_back([this, &input, &output, functor] {
+                size_t item;
+                while (input.pop(item)) {
+                    if (current_item(item)) {
+                        functor(item);
+                    }
+
+                    // The batches of a previous generation go through without any work
+                    if (!output.push(item)) {
+                        return;
+                    }
+                }
+            });
+        }
+    }
+
+    /*!
+     * \brief Indicates if the given batch of the pipeline belongs to the
+     * current generation
+     */
+    bool current_item(size_t item) const {
+        return item_generation[item] == generation;
+    }
+
+    /*!
+     * \brief The main function of the reader thread: read the raw inputs
+     * and the labels of the batches, in order.
+     */
+    void read_main() {
+        size_t item;
+
+        while (free_queue.pop(item)) {
+            size_t batch;
+
+            {
+                std::unique_lock<std::mutex> l(ready_lock);
+
+                reader_condition.wait(l, [this] { return stopped || restart || next_read < batches(); });
+
+                if (stopped) {
+                    return;
+                }
+
+                if (restart) {
+                    it  = orig_it;
+                    lit = orig_lit;
+
+                    next_read = 0;
+                    restart   = false;
+                }
+
+                batch = next_read++;
+
+                item_batch[item]      = batch;
+                item_generation[item] = generation;
+            }
+
+            dll::auto_timer timer("generator:read");
+
+            const size_t n = std::min(batch_size, _size - batch * batch_size);
+
+            for (size_t i = 0; i < n; ++i) {
+                raw_cache[item][i] = *it;
+
+                label_cache_helper_t::set(i, lit, label_cache(item));
+
+                ++it;
+                ++lit;
+            }
+
+            if (!decode_queue.push(item)) {
+                return;
+            }
+        }
+    }
+
+    /*!
+     * \brief Convert the raw inputs of a batch, with random crop and mirror
+     * in train mode
+     */
+    void decode(size_t item) {
+        dll::auto_timer timer("generator:decode");
+
+        const size_t batch = item_batch[item];
+        const size_t n     = std::min(batch_size, _size - batch * batch_size);
+
+        random_stream g(item_generation[item], batch, 0);
+
+        for (size_t i = 0; i < n; ++i) {
+            if (train_mode) {
+                // Random crop and mirror the image in a single copy
+                const auto mirror = mirrorer.draw(g);
+                cropper.transform_first(batch_cache(item)(i), raw_cache[item][i], g, mirror.first, mirror.second);
+            } else {
+                // Center crop the image
+                cropper.transform_first_test(batch_cache(item)(i), raw_cache[item][i]);
+            }
+        }
+    }
+
+    /*!
+     * \brief Apply the preprocessing on a batch
+     */
+    void preprocess(size_t item) {
+        dll::auto_timer timer("generator:preprocess");
+
+        const size_t n = std::min(batch_size, _size - item_batch[item] * batch_size);
+
+        auto samples = etl::slice(batch_cache(item), 0, n);
+
+        pre_transformer<desc>::transform_all(samples);
+
+        // In case of auto-encoders, the label images also need to be transformed
+        if constexpr (desc::AutoEncoder) {
+            auto labels = etl::slice(label_cache(item), 0, n);
+
+            pre_transformer<desc>::transform_all(labels);
+        }
+    }
+
+    /*!
+     * \brief Apply the augmentations on a batch, in train mode
+     */
+    void augment(size_t item) {
+        if (!train_mode) {
+            return;
+        }
+
+        dll::auto_timer timer("generator:augment");
+
+        const size_t batch = item_batch[item];
+        const size_t n     = std::min(batch_size, _size - batch * batch_size);
+
+        random_stream g(item_generation[item], batch, 1);
+
+        distorter.transform_batch(batch_cache(item), n, g);
+        noiser.transform_batch(batch_cache(item), n, g);
+    }
+
+    /*!
+     * \brief Hand a batch to the consumer, or back to the reader if it
+     * belongs to a previous generation
+     */
+    void collate(size_t item) {
+        {
+            std::lock_guard<std::mutex> l(ready_lock);
+
+            if (current_item(item)) {
+                ready_batches[item_batch[item]] = item;
+                ready_condition.notify_all();
+                return;
+            }
+        }
+
+        free_queue.push(item);
+    }
+
+    /*!
+     * \brief Returns the batch of the pipeline holding the current batch,
+     * waiting for it to be collated
+     */
+    size_t acquire() const {
+        if (!held) {
+            const size_t batch = current / batch_size;
+
+            std::unique_lock<std::mutex> l(ready_lock);
+
+            ready_condition.wait(l, [this, batch] { return stopped || ready_batches.count(batch); });
+
+            held_item = ready_batches[batch];
+            held      = true;
+
+            ready_batches.erase(batch);
+        }
+
+        return held_item;
+    }
+
+    const pipeline_options options; ///< The configuration of the stages
+
+    std::vector<std::vector<raw_type>> raw_cache; ///< The raw inputs of each batch of the pipeline
+    std::vector<size_t> item_batch;               ///< The index of the batch held by each batch of the pipeline
+    std::vector<size_t> item_generation;          ///< The generation of each batch of the pipeline
+
+    pipeline_detail::bounded_queue free_queue;       ///< The batches of the pipeline waiting for the reader
+    pipeline_detail::bounded_queue decode_queue;     ///< The batches waiting for the decode stage
+    pipeline_detail::bounded_queue preprocess_queue; ///< The batches waiting for the preprocess stage
+    pipeline_detail::bounded_queue augment_queue;    ///< The batches waiting for the augment stage
+
+    mutable std::mutex ready_lock;                            ///< The lock protecting the collated batches and the generation
+    mutable std::condition_variable ready_condition;          ///< The condition of the consumer
+    std::condition_variable reader_condition;                 ///< The condition of the reader
+    mutable std::unordered_map<size_t, size_t> ready_batches; ///< The batch of the pipeline holding each collated batch
+
+    std::atomic<size_t> generation{0}; ///< The current generation (incremented at each reset)
+    size_t next_read = 0;              ///< The next batch to read
+    bool restart     = true;           ///< Indicates if the reader must restart from the beginning
+    bool stopped     = false;          ///< Indicates if the pipeline is stopped
+
+    mutable size_t held_item = 0;     ///< The batch of the pipeline held by the consumer
+    mutable bool held        = false; ///< Indicates if the consumer holds a batch of the pipeline
+
+    std::atomic<bool> train_mode{false}; ///< The train mode status
+
+    std::vector<std::thread> threads; ///< The threads of the stages
+};
+
+template <typename Iterator, typename LIterator, typename Desc>
+const size_t pipeline_data_generator<Iterator, LIterator, Desc>::batch_size;
+
+template <typename Iterator, typename LIterator, typename Desc>
+const size_t pipeline_data_generator<Iterator, LIterator, Desc>::big_batch_size;
+
+/*!
+ * \brief Display the given generator on the given stream
+ * \param os The output stream
+ * \param generator The generator to display
+ * \return os
+ */
+template <typename Iterator, typename LIterator, typename Desc>
+std::ostream& operator<<(std::ostream& os, pipeline_data_generator<Iterator, LIterator, Desc>& generator) {
+    return generator.display(os);
+}
+
+/*!
+ * \brief Make a pipeline data generator from iterators
+ */
+template <typename Iterator, typename LIterator, typename... Parameters>
+auto make_pipeline_generator(Iterator first, Iterator last, LIterator lfirst, LIterator llast, size_t size, size_t n_classes, const pipeline_options& options, const outmemory_data_generator_desc<Parameters...>& /*desc*/) {
+    using generator_t = pipeline_data_generator<Iterator, LIterator, outmemory_data_generator_desc<Parameters...>>;
+    return std::make_unique<generator_t>(first, last, lfirst, llast, n_classes, size, options);
+}
+
+/*!
+ * \brief Make a pipeline data generator from containers
+ */
+template <typename Container, typename LContainer, typename... Parameters>
+auto make_pipeline_generator(const Container& container, const LContainer& lcontainer, size_t size, size_t n_classes, const pipeline_options& options, const outmemory_data_generator_desc<Parameters...>& desc) {
+    return make_pipeline_generator(container.begin(), container.end(), lcontainer.begin(), lcontainer.end(), size, n_classes, options, desc);
+}
+
+} //end of dll namespace
@@ -0,0 +1,186 @@
+//=======================================================================
+// Copyright (c) 2014-2017 Baptiste Wicht
+// Distributed under the terms of the MIT License.
+// (See accompanying file LICENSE or copy at
+//  http://opensource.org/licenses/MIT)
+//=======================================================================
+
+/*!
+ * \file
+ * \brief Support for iterating over a shard of a dataset.
+ *
+ * The samples of the dataset are permuted with a global permutation,
+ * computed from the DLL random seed, and the permutation is split in
+ * count contiguous parts. All the processes working on the same dataset
+ * must therefore use the same seed (see dll::set_seed) to get disjoint
+ * shards.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <iterator>
+#include <memory>
+#include <numeric>
+#include <vector>
+
+namespace dll {
+
+/*!
+ * \brief A shard of a dataset
+ */
+struct shard {
+    size_t index = 0; ///< The index of the shard
+    size_t count = 1; ///< The number of shards
+
+    /*!
+     * \brief Construct the complete shard
+     */
+    shard() = default;
+
+    /*!
+     * \brief Construct a shard
+     * \param index The index of the shard
+     * \param count The number of shards
+     */
+    shard(size_t index, size_t count) : index(index), count(count) {
+        cpp_assert(count > 0, "There must be at least one shard");
+        cpp_assert(index < count, "Invalid shard index");
+    }
+
+    /*!
+     * \brief Indicates if this shard is the complete dataset
+     */
+    bool complete() const {
+        return count == 1;
+    }
+
+    /*!
+     * \brief Returns the number of samples in this shard
+     * \param n The number of samples in the dataset
+     * \return The number of samples in the shard
+     */
+    size_t size(size_t n) const {
+        return (index + 1) * n / count - index * n / count;
+    }
+
+    /*!
+     * \brief Compute which samples of the dataset belong to this shard
+     * \param n The number of samples in the dataset
+     * \return A vector with true for each sample in the shard
+     */
+    std::vector<bool> members(size_t n) const {
+        std::vector<bool> mask(n, complete());
+
+        if (!complete()) {
+            std::vector<size_t> order(n);
+            std::iota(order.begin(), order.end(), 0);
+
+            // The permutation must be the same in all the processes
+            random_engine g(dll::seed());
+            std::shuffle(order.begin(), order.end(), g);
+
+            for (size_t k = index * n / count; k < (index + 1) * n / count; ++k) {
+                mask[order[k]] = true;
+            }
+        }
+
+        return mask;
+    }
+};
+
+/*!
+ * \brief An iterator adapter skipping the samples that are not part
+ * of a shard.
+ */
+template <typename Iterator>
+struct shard_iterator {
+    using iterator_category = std::input_iterator_tag;                                   ///< The iterator category
+    using value_type        = typename std::iterator_traits<Iterator>::value_type;      ///< The type of value
+    using difference_type   = typename std::iterator_traits<Iterator>::difference_type; ///< The type of difference
+    using pointer           = typename std::iterator_traits<Iterator>::pointer;         ///< The type of pointer
+    using reference         = typename std::iterator_traits<Iterator>::reference;       ///< The type of reference
+
+    Iterator it;                                   ///< The underlying iterator
+    std::shared_ptr<const std::vector<bool>> mask; ///< The members of the shard
+    size_t position;                               ///< The position in the complete dataset
+
+    /*!
+     * \brief Construct a new shard_iterator and advance it to the first
+     * member of the shard
+     * \param it The underlying iterator
+     * \param mask The members of the shard
+     * \param position The position of it in the complete dataset
+     */
+    shard_iterator(Iterator it, std::shared_ptr<const std::vector<bool>> mask, size_t position) : it(it), mask(mask), position(position) {
+        skip();
+    }
+
+    /*!
+     * \brief Returns the current element
+     */
+    decltype(auto) operator*() {
+        return *it;
+    }
+
+    /*!
+     * \brief Returns the current element
+     */
+    decltype(auto) operator*() const {
+        return *it;
+    }
+
+    /*!
+     * \brief Advance to the next member of the shard
+     */
+    shard_iterator& operator++() {
+        ++it;
+        ++position;
+
+        skip();
+
+        return *this;
+    }
+
+    /*!
+     * \brief Advance to the next member of the shard
+     */
+    shard_iterator operator++(int) {
+        auto copy = *this;
+        ++(*this);
+        return copy;
+    }
+
+    bool operator==(const shard_iterator& rhs) const {
+        return position == rhs.position;
+    }
+
+    bool operator!=(const shard_iterator& rhs) const {
+        return position != rhs.position;
+    }
+
+private:
+    /*!
+     * \brief Skip the samples that are not members of the shard
+     */
+    void skip() {
+        while (position < mask->size() && !(*mask)[position]) {
+            ++it;
+            ++position;
+        }
+    }
+};
+
+/*!
+ * \brief Create the begin and end shard iterators around a range
+ * \param first The beginning of the range
+ * \param last The end of the range
+ * \param mask The members of the shard
+ * \return a pair with the begin and end shard iterators
+ */
+template <typename Iterator>
+auto make_shard_range(Iterator first, Iterator last, std::shared_ptr<const std::vector<bool>> mask) {
+    return std::make_pair(shard_iterator<Iterator>(first, mask, 0), shard_iterator<Iterator>(last, mask, mask->size()));
+}
+
+} //end of dll namespace
@@ -0,0 +1,371 @@
+//=======================================================================
+// Copyright (c) 2014-2017 Baptiste Wicht
+// Distributed under the terms of the MIT License.
+// (See accompanying file LICENSE or copy at
+//  http://opensource.org/licenses/MIT)
+//=======================================================================
+
+/*!
+ * \file
+ * \brief Unbounded streams of samples for online fine-tuning
+ */
+
+#pragma once
+
+#include <deque>
+#include <mutex>
+#include <random>
+#include <utility>
+#include <condition_variable>
+
+#include "etl/etl.hpp"
+
+#include "dll/util/random.hpp"
+
+namespace dll {
+
+/*!
+ * \brief The options of a streaming fine-tuning
+ */
+struct stream_options {
+    size_t max_batches    = 0; ///< The maximum number of trained batches (0 to train until the stream is closed)
+    size_t replay_size    = 0; ///< The number of samples kept in the replay buffer (0 to disable the replay)
+    size_t replay_batches = 1; ///< The number of replayed batches trained after each batch of the stream
+    size_t eval_batches   = 0; ///< The number of batches between two evaluations on the validation set (0 to disable)
+};
+
+namespace stream_detail {
+
+/*!
+ * \brief Create a batch of n samples with the shape of the given sample
+ */
+template <typename Batch, typename Sample, size_t... I>
+Batch make_batch(size_t n, const Sample& sample, std::index_sequence<I...>) {
+    return Batch(n, etl::dim<I>(sample)...);
+}
+
+/*!
+ * \brief Create a batch of n samples with the shape of the given sample
+ */
+template <typename Batch, typename Sample>
+Batch make_batch(size_t n, const Sample& sample) {
+    return make_batch<Batch>(n, sample, std::make_index_sequence<etl::decay_traits<Sample>::dimensions()>());
+}
+
+} //end of namespace stream_detail
+
+/*!
+ * \brief An unbounded stream of samples and labels, fed by producers and
+ * consumed in batches by the streaming fine-tuning.
+ *
+ * Unlike the generators, a stream has no size and cannot be reset nor
+ * shuffled: each sample is trained once, in the order of arrival. The
+ * stream buffers at most capacity samples, the producers wait (push) or
+ * fail (try_push) when the buffer is full. A batch is complete once
+ * batch_size samples are waiting, only the last batch, after the stream
+ * is closed, can be smaller.
+ *
+ * \tparam Sample The type of one sample
+ * \tparam Label The type of one label (one-hot for categorical labels)
+ * \tparam B The number of samples of a batch
+ */
+template <typename Sample, typename Label, size_t B>
+struct stream_generator {
+    using sample_t = Sample; ///< The type of one sample
+    using label_t  = Label;  ///< The type of one label
+
+    using weight = etl::value_t<sample_t>; ///< The type of the values
+
+    using data_batch_t  = etl::dyn_matrix<weight, etl::decay_traits<sample_t>::dimensions() + 1>; ///< The type of a batch of samples
+    using label_batch_t = etl::dyn_matrix<weight, etl::decay_traits<label_t>::dimensions() + 1>;  ///< The type of a batch of labels
+
+    static constexpr bool dll_stream_generator = true; ///< Simple flag to indicate that the class is a DLL stream
+
+    static constexpr size_t batch_size = B; ///< The size of the generated batches
+
+    /*!
+     * \brief Create a new stream
+     * \param capacity The maximum number of buffered samples (at least one batch)
+     */
+    explicit stream_generator(size_t capacity = 4 * B) : capacity(std::max(capacity, B)) {}
+
+    stream_generator(const stream_generator& rhs) = delete;
+    stream_generator& operator=(const stream_generator& rhs) = delete;
+
+    /*!
+     * \brief Add a sample to the stream, waiting for some space in the
+     * buffer
+     * \return true if the sample was added, false if the stream is closed
+     */
+    bool push(const sample_t& sample, const label_t& label) {
+        std::unique_lock<std::mutex> l(main_lock);
+
+        space_condition.wait(l, [this] { return closed || samples.size() < capacity; });
+
+        if (closed) {
+            return false;
+        }
+
+        samples.emplace_back(sample, label);
+
+        if (samples.size() >= B) {
+            ready_condition.notify_one();
+        }
+
+        return true;
+    }
+
+    /*!
+     * \brief Add a sample to the stream if there is some space in the
+     * buffer
+     * \return true if the sample was added, false if the buffer is full or
+     * the stream is closed
+     */
+    bool try_push(const sample_t& sample, const label_t& label) {
+        std::lock_guard<std::mutex> l(main_lock);
+
+        if (closed || samples.size() >= capacity) {
+            ++dropped_samples;
+            return false;
+        }
+
+        samples.emplace_back(sample, label);
+
+        if (samples.size() >= B) {
+            ready_condition.notify_one();
+        }
+
+        return true;
+    }
+
+    /*!
+     * \brief Close the stream, the waiting samples are still consumed
+     */
+    void close() {
+        std::lock_guard<std::mutex> l(main_lock);
+
+        closed = true;
+
+        space_condition.notify_all();
+        ready_condition.notify_all();
+    }
+
+    /*!
+     * \brief Returns the number of samples refused by try_push
+     */
+    size_t dropped() const {
+        std::lock_guard<std::mutex> l(main_lock);
+        return dropped_samples;
+    }
+
+    /*!
+     * \brief Indicates if there is a next batch, waiting for a complete
+     * batch or for the stream to be closed
+     */
+    bool has_next_batch() {
+        if (ready) {
+            return true;
+        }
+
+        std::unique_lock<std::mutex> l(main_lock);
+
+        ready_condition.wait(l, [this] { return closed || samples.size() >= B; });
+
+        if (samples.empty()) {
+            return false;
+        }
+
+        const size_t n = std::min(B, samples.size());
+
+        if (etl::dim<0>(data) != n) {
+            data   = stream_detail::make_batch<data_batch_t>(n, samples.front().first);
+            labels = stream_detail::make_batch<label_batch_t>(n, samples.front().second);
+        }
+
+        for (size_t i = 0; i < n; ++i) {
+            data(i)   = samples.front().first;
+            labels(i) = samples.front().second;
+
+            samples.pop_front();
+        }
+
+        space_condition.notify_all();
+
+        ready = true;
+
+        return true;
+    }
+
+    /*!
+     * \brief Move to the next batch
+     */
+    void next_batch() {
+        ready = false;
+    }
+
+    /*!
+     * \brief Returns the current batch of samples
+     */
+    const data_batch_t& data_batch() const {
+        return data;
+    }
+
+    /*!
+     * \brief Returns the current batch of labels
+     */
+    const label_batch_t& label_batch() const {
+        return labels;
+    }
+
+private:
+    const size_t capacity; ///< The maximum number of buffered samples
+
+    std::deque<std::pair<sample_t, label_t>> samples; ///< The buffered samples
+    size_t dropped_samples = 0;                       ///< The number of samples refused by try_push
+    bool closed            = false;                   ///< Indicates if the stream is closed
+
+    mutable std::mutex main_lock;            ///< The lock of the buffer
+    std::condition_variable space_condition; ///< The condition variable for the producers to wait for some space
+    std::condition_variable ready_condition; ///< The condition variable for the consumer to wait for a batch
+
+    data_batch_t data;    ///< The current batch of samples
+    label_batch_t labels; ///< The current batch of labels
+    bool ready = false;   ///< Indicates if the current batch is ready
+};
+
+/*!
+ * \brief A replay buffer keeping a uniform sample of all the samples seen
+ * by a stream (reservoir sampling).
+ *
+ * The samples are kept in a single preallocated batch of capacity samples.
+ * Random batches are drawn from the buffer and trained along the stream to
+ * limit the forgetting of the older samples.
+ *
+ * \tparam Stream The type of the stream
+ */
+template <typename Stream>
+struct replay_buffer {
+    using stream_t      = Stream;                           ///< The type of the stream
+    using data_batch_t  = typename stream_t::data_batch_t;  ///< The type of a batch of samples
+    using label_batch_t = typename stream_t::label_batch_t; ///< The type of a batch of labels
+
+    static constexpr size_t batch_size = stream_t::batch_size; ///< The size of the replayed batches
+
+    /*!
+     * \brief Create a new replay buffer
+     * \param capacity The maximum number of samples kept in the buffer
+     */
+    explicit replay_buffer(size_t capacity) : capacity(capacity) {}
+
+    /*!
+     * \brief Returns the number of samples in the buffer
+     */
+    size_t size() const {
+        return std::min(seen, capacity);
+    }
+
+    /*!
+     * \brief Offer all the samples of the given batch to the buffer
+     */
+    void add(const data_batch_t& data, const label_batch_t& labels) {
+        if (!capacity) {
+            return;
+        }
+
+        if (!seen) {
+            samples       = stream_detail::make_batch<data_batch_t>(capacity, data(0));
+            sample_labels = stream_detail::make_batch<label_batch_t>(capacity, labels(0));
+        }
+
+        auto& g = dll::rand_engine();
+
+        for (size_t i = 0; i < etl::dim<0>(data); ++i) {
+            size_t slot = seen;
+
+            // Each seen sample is kept with a probability of capacity / seen
+            if (seen >= capacity) {
+                slot = std::uniform_int_distribution<size_t>(0, seen)(g);
+            }
+
+            if (slot < capacity) {
+                samples(slot)       = data(i);
+                sample_labels(slot) = labels(i);
+            }
+
+            ++seen;
+        }
+    }
+
+    /*!
+     * \brief Draw a random batch from the buffer
+     * \return true if a batch was drawn, false if the buffer holds less
+     * than a batch
+     */
+    bool draw() {
+        if (size() < batch_size) {
+            return false;
+        }
+
+        if (etl::dim<0>(data) != batch_size) {
+            data   = stream_detail::make_batch<data_batch_t>(batch_size, samples(0));
+            labels = stream_detail::make_batch<label_batch_t>(batch_size, sample_labels(0));
+        }
+
+        std::uniform_int_distribution<size_t> dist(0, size() - 1);
+
+        auto& g = dll::rand_engine();
+
+        for (size_t i = 0; i < batch_size; ++i) {
+            const size_t slot = dist(g);
+
+            data(i)   = samples(slot);
+            labels(i) = sample_labels(slot);
+        }
+
+        return true;
+    }
+
+    /*!
+     * \brief Returns the last drawn batch of samples
+     */
+    const data_batch_t& data_batch() const {
+        return data;
+    }
+
+    /*!
+     * \brief Returns the last drawn batch of labels
+     */
+    const label_batch_t& label_batch() const {
+        return labels;
+    }
+
+private:
+    const size_t capacity; ///< The maximum number of samples
+    size_t seen = 0;       ///< The number of samples offered to the buffer
+
+    data_batch_t samples;        ///< The samples of the buffer
+    label_batch_t sample_labels; ///< The labels of the buffer
+
+    data_batch_t data;    ///< The last drawn batch of samples
+    label_batch_t labels; ///< The last drawn batch of labels
+};
+
+/*!
+ * \brief Traits to test if a type is DLL stream or not
+ */
+template <typename T, typename = int>
+struct is_stream_generator_impl : std::false_type {};
+
+/*!
+ * \brief Traits to test if a type is DLL stream or not
+ */
+template <typename T>
+struct is_stream_generator_impl<T, decltype((void)T::dll_stream_generator, 0)> : std::true_type {};
+
+/*!
+ * \brief Traits to test if a type is DLL stream or not
+ */
+template <typename T>
+constexpr bool is_stream_generator = is_stream_generator_impl<T>::value;
+
+} //end of dll namespace
@@ -7,7 +7,10 @@
 
 #pragma once
 
+#include <cmath>
+#include <algorithm>
 #include <atomic>
+#include <random>
 #include <thread>
 
 #include "cpp_utils/data.hpp"
@@ -102,6 +105,18 @@ struct pre_binarizer <Desc, std::enable_if_t<Desc::BinarizePre != 0>> {
     static void transform_all(O&& target){
         etl::binarize(target, B);
     }
+
+    /*!
+     * \brief Apply the transform on the n values of a sample in memory
+     * \param target The first value of the sample
+     * \param n The number of values of the sample
+     */
+    template<typename T>
+    static void transform_raw(T* target, size_t n){
+        for(size_t i = 0; i < n; ++i){
+            target[i] = target[i] > B ? 1.0 : 0.0;
+        }
+    }
 };
 
 /*!
@@ -126,6 +141,17 @@ struct pre_binarizer <Desc, std::enable_if_t<Desc::BinarizePre == 0>> {
     static void transform_all(O&& target){
         cpp_unused(target);
     }
+
+    /*!
+     * \brief Apply the transform on the n values of a sample in memory
+     * \param target The first value of the sample
+     * \param n The number of values of the sample
+     */
+    template<typename T>
+    static void transform_raw(T* target, size_t n){
+        cpp_unused(target);
+        cpp_unused(n);
+    }
 };
 
 /*!
@@ -156,6 +182,34 @@ struct pre_normalizer <Desc, std::enable_if_t<Desc::NormalizePre>> {
     static void transform_all(O&& target){
         etl::normalize_sub(target);
     }
+
+    /*!
+     * \brief Apply the transform on the n values of a sample in memory
+     * \param target The first value of the sample
+     * \param n The number of values of the sample
+     */
+    template<typename T>
+    static void transform_raw(T* target, size_t n){
+        double mean = 0.0;
+
+        for(size_t i = 0; i < n; ++i){
+            mean += target[i];
+        }
+
+        mean /= n;
+
+        double stddev = 0.0;
+
+        for(size_t i = 0; i < n; ++i){
+            stddev += (target[i] - mean) * (target[i] - mean);
+        }
+
+        stddev = std::sqrt(stddev / n);
+
+        for(size_t i = 0; i < n; ++i){
+            target[i] = (target[i] - mean) / stddev;
+        }
+    }
 };
 
 /*!
@@ -180,6 +234,186 @@ struct pre_normalizer <Desc, std::enable_if_t<!Desc::NormalizePre>> {
     static void transform_all(O&& target){
         cpp_unused(target);
     }
+
+    /*!
+     * \brief Apply the transform on the n values of a sample in memory
+     * \param target The first value of the sample
+     * \param n The number of values of the sample
+     */
+    template<typename T>
+    static void transform_raw(T* target, size_t n){
+        cpp_unused(target);
+        cpp_unused(n);
+    }
+};
+
+/*!
+ * \brief The preprocessing of the inputs configured in the descriptor
+ * (scaling, normalization and binarization), fused in a single kernel.
+ *
+ * Each sample is transformed with at most one pass to compute its
+ * statistics and one pass to write it, instead of one pass per
+ * transformer (and three for the normalization). When the samples are
+ * normalized, the scaling is skipped since it does not change the
+ * normalized values.
+ *
+ * \tparam Scaled Indicates if the inputs were already scaled
+ */
+template<typename Desc, bool Scaled = false>
+struct pre_transformer {
+    static constexpr size_t S    = Scaled ? 0 : Desc::ScalePre; ///< The scaling factor
+    static constexpr size_t B    = Desc::BinarizePre;           ///< The binarization threshold
+    static constexpr bool N      = Desc::NormalizePre;          ///< Indicates if the samples are normalized
+    static constexpr bool active = S || B || N;                 ///< Indicates if the samples are transformed
+
+    /*!
+     * \brief Apply the transforms on the n values of a sample in memory
+     * \param target The first value of the sample
+     * \param n The number of values of the sample
+     */
+    template<typename T>
+    static void transform_raw(T* target, size_t n){
+        if constexpr (N) {
+            double sum    = 0.0;
+            double sum_sq = 0.0;
+
+            for(size_t i = 0; i < n; ++i){
+                sum += target[i];
+                sum_sq += double(target[i]) * target[i];
+            }
+
+            const double mean   = sum / n;
+            const double stddev = std::sqrt(std::max(sum_sq / n - mean * mean, 0.0));
+
+            const T m   = mean;
+            const T inv = 1.0 / stddev;
+
+            for(size_t i = 0; i < n; ++i){
+                if constexpr (B != 0) {
+                    target[i] = (target[i] - m) * inv > T(B) ? T(1) : T(0);
+                } else {
+                    target[i] = (target[i] - m) * inv;
+                }
+            }
+        } else if constexpr (S != 0 && B != 0) {
+            for(size_t i = 0; i < n; ++i){
+                target[i] = target[i] / T(S) > T(B) ? T(1) : T(0);
+            }
+        } else if constexpr (S != 0) {
+            for(size_t i = 0; i < n; ++i){
+                target[i] = target[i] / T(S);
+            }
+        } else if constexpr (B != 0) {
+            for(size_t i = 0; i < n; ++i){
+                target[i] = target[i] > T(B) ? T(1) : T(0);
+            }
+        } else {
+            cpp_unused(target);
+            cpp_unused(n);
+        }
+    }
+
+    /*!
+     * \brief Apply the transforms on one sample
+     * \param target The sample to transform
+     */
+    template<typename O>
+    static void transform(O&& target){
+        if constexpr (active) {
+            target.ensure_cpu_up_to_date();
+
+            transform_raw(target.memory_start(), etl::size(target));
+
+            target.invalidate_gpu();
+        }
+    }
+
+    /*!
+     * \brief Apply the transforms on each sample of a batch
+     * \param target The batch to transform
+     */
+    template<typename O>
+    static void transform_all(O&& target){
+        if constexpr (active) {
+            const size_t samples = etl::dim<0>(target);
+
+            if (!samples) {
+                return;
+            }
+
+            const size_t n = etl::size(target) / samples;
+
+            target.ensure_cpu_up_to_date();
+
+            auto* memory = target.memory_start();
+
+            for(size_t s = 0; s < samples; ++s){
+                transform_raw(memory + s * n, n);
+            }
+
+            target.invalidate_gpu();
+        }
+    }
+};
+
+/*!
+ * \brief Preprocessing of the inputs configured at runtime.
+ *
+ * Contrary to the other transformers, the preprocessing is not part of
+ * the generator descriptor, but set on the generator, and applied on each
+ * batch when it is prepared.
+ */
+struct runtime_preprocessing {
+    bool binarize  = false; ///< Binarize the inputs (with a threshold of 30)
+    bool normalize = false; ///< Normalize each input
+    double shift   = 0.0;   ///< The value to add to the inputs
+    double scale   = 1.0;   ///< The factor to multiply the inputs with
+    double noise   = 0.0;   ///< The standard deviation of the normal noise (0 for none)
+
+    /*!
+     * \brief Apply the preprocessing on a batch of inputs, except the noise
+     * \param target The batch to transform
+     */
+    template<typename O>
+    void transform_clean(O&& target) const {
+        if (binarize) {
+            etl::binarize(target, 30.0);
+        }
+
+        if (normalize) {
+            etl::normalize_sub(target);
+        }
+
+        if (shift != 0.0) {
+            target += shift;
+        }
+
+        if (scale != 1.0) {
+            target *= scale;
+        }
+    }
+
+    /*!
+     * \brief Apply the preprocessing on a batch of inputs
+     * \param target The batch to transform
+     * \param g The random engine
+     */
+    template<typename O, typename G>
+    void transform_all(O&& target, G& g) const {
+        transform_clean(target);
+
+        if (noise > 0.0) {
+            etl::normalize_sub(target);
+
+            std::normal_distribution<double> distribution(0.0, noise);
+
+            for (auto& x : target) {
+                x += distribution(g);
+            }
+
+            etl::normalize_sub(target);
+        }
+    }
 };
 
 } //end of dll namespace
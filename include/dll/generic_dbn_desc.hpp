@@ -10,6 +10,8 @@
 #include "base_conf.hpp"
 #include "watcher.hpp"
 #include "util/tmp.hpp"
+#include "trainer/lr_schedule.hpp"
+#include "trainer/transport.hpp"
 
 namespace dll {
 
@@ -58,6 +60,11 @@ struct generic_dbn_desc {
      */
     static constexpr size_t Noise = detail::get_value_v<noise<0>, Parameters...>;
 
+    /*!
+     * \brief The type of noise
+     */
+    static constexpr auto NoiseKind = detail::get_value_v<noise_kind<noise_type::MASKING>, Parameters...>;
+
     /*!
      * \brief The pre binarization thresholding
      */
@@ -92,6 +99,8 @@ struct generic_dbn_desc {
     using watcher_t = typename detail::get_template_type<watcher<default_dbn_watcher>, Parameters...>::template value<DBN>;
 
     using output_policy_t = detail::get_type_t<output_policy<default_output_policy>, Parameters...>; ///< The output policy
+    using lr_schedule_t   = detail::get_type_t<lr_schedule<constant_lr>, Parameters...>;             ///< The learning rate schedule
+    using transport_t     = detail::get_type_t<transport<local_transport>, Parameters...>;         ///< The transport of the distributed trainer
 
     /*! The DBN type */
     using dbn_t = DBN_T<generic_dbn_desc<DBN_T, Layers, Parameters...>>;
@@ -106,15 +115,29 @@ struct generic_dbn_desc {
 
     static_assert(BatchSize > 0, "Batch size must be at least 1");
     static_assert(BigBatchSize > 0, "Big Batch size must be at least 1");
+    static_assert(detail::get_value_v<data_parallel<1>, Parameters...> > 0, "There must be at least one micro-batch");
+    static_assert(detail::get_value_v<data_parallel<1>, Parameters...> <= BatchSize, "There cannot be more micro-batches than samples in a batch");
+    static_assert(detail::get_value_v<grad_accumulate<1>, Parameters...> > 0, "There must be at least one accumulated batch");
+    static_assert(detail::get_value_v<checkpoint<0>, Parameters...> < 2 || detail::get_value_v<data_parallel<1>, Parameters...> == 1,
+                  "checkpoint is not supported with data_parallel");
+    static_assert(!parameters::template contains<compressed_activations>() || detail::get_value_v<data_parallel<1>, Parameters...> == 1,
+                  "compressed_activations is not supported with data_parallel");
+    static_assert(!parameters::template contains<compressed_activations>() || detail::get_value_v<checkpoint<0>, Parameters...> < 2,
+                  "compressed_activations is not supported with checkpoint");
+    static_assert(detail::get_value_v<pipeline_stages<1>, Parameters...> > 0, "There must be at least one stage");
+    static_assert(detail::get_value_v<pipeline_stages<1>, Parameters...> < 2 || detail::get_value_v<data_parallel<1>, Parameters...> > 1,
+                  "pipeline_stages needs the micro-batches of data_parallel");
 
     //Make sure only valid types are passed to the configuration list
     static_assert(
         detail::is_valid_v<
             cpp::type_list<
-                trainer_id, watcher_id, weight_decay_id, big_batch_size_id, batch_size_id, verbose_id, no_epoch_error_id,
+                trainer_id, watcher_id, weight_decay_id, big_batch_size_id, batch_size_id, verbose_id, no_epoch_error_id, running_error_id, async_validation_id,
                 batch_mode_id, svm_concatenate_id, svm_scale_id, serial_id, shuffle_id, shuffle_pre_id, loss_id,
-                normalize_pre_id, binarize_pre_id, scale_pre_id, autoencoder_id, noise_id, updater_id,
-                early_stopping_id, early_training_id, clip_gradients_id, output_policy_id>,
+                normalize_pre_id, binarize_pre_id, scale_pre_id, autoencoder_id, noise_id, noise_kind_id, updater_id,
+                early_stopping_id, early_training_id, clip_gradients_id, data_parallel_id, pipeline_stages_id, grad_accumulate_id, workers_id,
+                loss_scaling_id, checkpoint_id, stage_inputs_id, flat_parameters_id, compressed_activations_id, output_policy_id,
+                lr_schedule_id, transport_id, pipeline_pretrain_id>,
             Parameters...>,
         "Invalid parameters type");
 };
@@ -124,3 +147,7 @@ struct generic_dbn_desc {
 // Include the trainers
 #include "dll/trainer/conjugate_gradient.hpp"
 #include "dll/trainer/stochastic_gradient_descent.hpp"
+#include "dll/trainer/async_sgd_trainer.hpp"
+#include "dll/trainer/distributed_sgd_trainer.hpp"
+#include "dll/trainer/param_server_trainer.hpp"
+#include "dll/trainer/conv_autotune.hpp"
@@ -0,0 +1,205 @@
+//=======================================================================
+// Copyright (c) 2014-2017 Baptiste Wicht
+// Distributed under the terms of the MIT License.
+// (See accompanying file LICENSE or copy at
+//  http://opensource.org/licenses/MIT)
+//=======================================================================
+
+/*!
+ * \file
+ * \brief Hot reload of the weights of a network used for inference
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <future>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+
+#include "dll/util/model_file.hpp"
+#include "dll/util/compact_model.hpp"
+
+namespace dll {
+
+/*!
+ * \brief A network whose weights can be replaced while it is used for
+ * inference.
+ *
+ * The current network is published through an atomic shared pointer. Each
+ * inference acquires the current network and keeps it alive until it
+ * returns: a reload never waits for the inferences and the inferences
+ * never wait for a reload. A new network is loaded in a new instance, in
+ * the thread of the caller or in the background, optionally warmed up,
+ * and only then published. The inferences started before the publication
+ * finish on the previous weights, which are released with the last of
+ * them.
+ *
+ * The format of the file is detected from its magic number: packed models
+ * and compact models are read through a mapping of the file, the other
+ * files with the stream loader of the network.
+ */
+template <typename DBN>
+struct dbn_hot_model {
+    using dbn_t    = DBN;                               ///< The type of the network
+    using pointer  = std::shared_ptr<const dbn_t>;      ///< The type of a pointer to a published network
+    using warmup_t = std::function<void(const dbn_t&)>; ///< The type of the warmup functor
+
+    /*!
+     * \brief Create a hot model publishing the given network
+     * \param dbn The first network
+     */
+    explicit dbn_hot_model(pointer dbn) {
+        publish(std::move(dbn));
+    }
+
+    /*!
+     * \brief Create a hot model publishing the network loaded from the
+     * given file
+     * \param file The path to the file
+     */
+    explicit dbn_hot_model(const std::string& file) {
+        if (!reload(file)) {
+            std::cerr << "ERROR: The hot model has no network" << std::endl;
+        }
+    }
+
+    dbn_hot_model(const dbn_hot_model& rhs) = delete;
+    dbn_hot_model& operator=(const dbn_hot_model& rhs) = delete;
+
+    /*!
+     * \brief Returns the current network.
+     *
+     * The returned pointer keeps the network alive, even if another one is
+     * published in the meantime.
+     */
+    pointer acquire() const {
+        return std::atomic_load_explicit(&current, std::memory_order_acquire);
+    }
+
+    /*!
+     * \brief Returns the number of networks published so far
+     */
+    size_t version() const {
+        return published.load(std::memory_order_acquire);
+    }
+
+    /*!
+     * \brief Set the functor called on each new network before it is
+     * published (to fault in the weights and allocate the buffers)
+     */
+    void set_warmup(warmup_t warmup) {
+        std::lock_guard<std::mutex> l(reload_lock);
+        this->warmup = std::move(warmup);
+    }
+
+    /*!
+     * \brief Publish the given network, the next inferences use it.
+     * \param dbn The new network
+     */
+    void publish(pointer dbn) {
+        std::atomic_store_explicit(&current, std::move(dbn), std::memory_order_release);
+        ++published;
+    }
+
+    /*!
+     * \brief Load a new network from the given file and publish it.
+     *
+     * The current network is kept if the file cannot be loaded.
+     *
+     * \param file The path to the file
+     * \return true if the new network was published, false otherwise
+     */
+    bool reload(const std::string& file) {
+        // The reloads are serialized, the inferences are not blocked
+        std::lock_guard<std::mutex> l(reload_lock);
+
+        auto dbn = std::make_shared<dbn_t>();
+
+        if (!load_network(*dbn, file)) {
+            std::cerr << "ERROR: Impossible to reload the network from " << file << std::endl;
+            return false;
+        }
+
+        if (warmup) {
+            warmup(*dbn);
+        }
+
+        publish(std::move(dbn));
+
+        return true;
+    }
+
+    /*!
+     * \brief Load a new network from the given file and publish it, in the
+     * background.
+     * \param file The path to the file
+     * \return A future indicating if the new network was published
+     */
+    std::future<bool> reload_async(const std::string& file) {
+        return std::async(std::launch::async, [this, file] { return reload(file); });
+    }
+
+    /*!
+     * \brief Forward the given batch through the current network.
+     *
+     * The network is kept alive until the batch is forwarded, even if
+     * another one is published in the meantime.
+     */
+    template <typename Input>
+    auto test_forward_batch(Input&& sample) const {
+        auto dbn = acquire();
+        return dbn->test_forward_batch(std::forward<Input>(sample));
+    }
+
+    /*!
+     * \brief Forward the given sample through the current network.
+     */
+    template <typename Input>
+    auto forward_one(Input&& sample) const {
+        auto dbn = acquire();
+        return dbn->forward_one(std::forward<Input>(sample));
+    }
+
+private:
+    /*!
+     * \brief Load the network from the given file, in the format given by
+     * its magic number
+     */
+    static bool load_network(dbn_t& dbn, const std::string& file) {
+        uint32_t magic = 0;
+
+        {
+            std::ifstream is(file, std::ifstream::binary);
+
+            if (!is) {
+                return false;
+            }
+
+            is.read(reinterpret_cast<char*>(&magic), sizeof(magic));
+        }
+
+        if (magic == packed_model_header::file_magic) {
+            return dbn.load_packed(file);
+        } else if (magic == compact_model_magic) {
+            return dbn.load_compact(file);
+        }
+
+        dbn.load(file);
+
+        return true;
+    }
+
+    pointer current;                  ///< The published network
+    std::atomic<size_t> published{0}; ///< The number of published networks
+    std::mutex reload_lock;           ///< The lock serializing the reloads
+    warmup_t warmup;                  ///< The warmup of the new networks
+};
+
+} //end of dll namespace
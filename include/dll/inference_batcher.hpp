@@ -0,0 +1,223 @@
+//=======================================================================
+// Copyright (c) 2014-2017 Baptiste Wicht
+// Distributed under the terms of the MIT License.
+// (See accompanying file LICENSE or copy at
+//  http://opensource.org/licenses/MIT)
+//=======================================================================
+
+/*!
+ * \file
+ * \brief Dynamic batching of single samples for online inference
+ */
+
+#pragma once
+
+#include <chrono>
+#include <deque>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <condition_variable>
+
+#include "cpp_utils/assert.hpp"
+
+#include "etl/etl.hpp"
+
+#include "dll/inference_session.hpp"
+
+namespace dll {
+
+/*!
+ * \brief A front-end gathering single samples into batches for inference.
+ *
+ * The samples are queued by the callers and the workers forward them
+ * together, once max_batch samples are waiting or once the first waiting
+ * sample has waited for max_delay. Each worker has its own inference
+ * session on the network. The result of each sample is returned through a
+ * future.
+ */
+template <typename DBN>
+struct dbn_inference_batcher {
+    using dbn_t       = DBN;                             ///< The type of the network
+    using weight      = typename dbn_t::weight;          ///< The data type of the network
+    using input_one_t = typename dbn_t::input_one_t;     ///< The type of one sample
+    using session_t   = dbn_inference_session<dbn_t>;    ///< The type of the sessions of the workers
+    using clock       = std::chrono::steady_clock;       ///< The clock for the delays
+
+    static constexpr size_t input_dimensions = etl::decay_traits<input_one_t>::dimensions(); ///< The number of dimensions of one sample
+
+    using batch_t = etl::dyn_matrix<weight, input_dimensions + 1>; ///< The type of a batch of samples
+
+    using output_batch_t = std::decay_t<decltype(std::declval<session_t&>().planned_forward_batch(std::declval<const batch_t&>()))>; ///< The type of a batch of results
+
+    using output_one_t = etl::dyn_matrix<weight, etl::decay_traits<output_batch_t>::dimensions() - 1>; ///< The type of the result of one sample
+
+    /*!
+     * \brief Create a new batcher on the given network
+     * \param dbn The network
+     * \param max_delay The maximum time a sample waits for the next ones
+     * \param max_batch The maximum number of samples of a batch
+     * \param n_workers The number of workers
+     */
+    explicit dbn_inference_batcher(const dbn_t& dbn,
+                                   std::chrono::microseconds max_delay = std::chrono::microseconds(1000),
+                                   size_t max_batch = dbn_t::batch_size, size_t n_workers = 1)
+            : dbn(dbn), max_delay(max_delay), max_batch(std::max(size_t(1), max_batch)) {
+        for (size_t w = 0; w < std::max(size_t(1), n_workers); ++w) {
+            threads.emplace_back([this] { work(); });
+        }
+    }
+
+    dbn_inference_batcher(const dbn_inference_batcher& rhs) = delete;
+    dbn_inference_batcher& operator=(const dbn_inference_batcher& rhs) = delete;
+
+    /*!
+     * \brief Forward the waiting samples and stop the workers
+     */
+    ~dbn_inference_batcher() {
+        {
+            std::lock_guard<std::mutex> l(main_lock);
+            stop_flag = true;
+        }
+
+        condition.notify_all();
+
+        for (auto& thread : threads) {
+            thread.join();
+        }
+    }
+
+    /*!
+     * \brief Queue a sample to be forwarded through the network
+     * \param sample The sample
+     * \return a future to the output of the network for the sample
+     */
+    std::future<output_one_t> forward(const input_one_t& sample) {
+        std::future<output_one_t> result;
+
+        {
+            std::lock_guard<std::mutex> l(main_lock);
+
+            cpp_assert(!stop_flag, "Sample submitted to a stopped batcher");
+
+            queue.emplace_back(sample);
+            result = queue.back().promise.get_future();
+        }
+
+        condition.notify_one();
+
+        return result;
+    }
+
+private:
+    /*!
+     * \brief A sample waiting to be forwarded
+     */
+    struct request {
+        input_one_t input;                 ///< The sample
+        std::promise<output_one_t> promise; ///< The promise of the result
+        clock::time_point time;            ///< The time at which the sample was queued
+
+        explicit request(const input_one_t& input) : input(input), time(clock::now()) {}
+    };
+
+    /*!
+     * \brief The main loop of a worker
+     */
+    void work() {
+        session_t session(dbn);
+
+        std::vector<request> requests;
+
+        std::unique_lock<std::mutex> ulock(main_lock);
+
+        while (true) {
+            condition.wait(ulock, [this] { return stop_flag || !queue.empty(); });
+
+            if (queue.empty()) {
+                return;
+            }
+
+            // Wait for more samples, until the first one has waited long enough
+            const auto deadline = queue.front().time + max_delay;
+
+            condition.wait_until(ulock, deadline, [this] { return stop_flag || queue.size() >= max_batch || queue.empty(); });
+
+            const size_t n = std::min(queue.size(), max_batch);
+
+            if (!n) {
+                // Another worker took the samples
+                continue;
+            }
+
+            requests.clear();
+
+            for (size_t i = 0; i < n; ++i) {
+                requests.push_back(std::move(queue.front()));
+                queue.pop_front();
+            }
+
+            ulock.unlock();
+
+            forward_requests(session, requests);
+
+            ulock.lock();
+        }
+    }
+
+    /*!
+     * \brief Forward the given samples as one batch and fulfill their
+     * promises
+     */
+    void forward_requests(session_t& session, std::vector<request>& requests) {
+        try {
+            auto batch = make_batch(requests.size(), requests.front().input);
+
+            for (size_t i = 0; i < requests.size(); ++i) {
+                batch(i) = requests[i].input;
+            }
+
+            // The results are copied out of the arenas of the session
+            auto output = session.planned_forward_batch(batch);
+
+            for (size_t i = 0; i < requests.size(); ++i) {
+                requests[i].promise.set_value(output_one_t(output(i)));
+            }
+        } catch (...) {
+            for (auto& r : requests) {
+                r.promise.set_exception(std::current_exception());
+            }
+        }
+    }
+
+    /*!
+     * \brief Create a batch of n samples of the same shape as the given
+     * sample
+     */
+    static batch_t make_batch(size_t n, const input_one_t& one) {
+        if constexpr (input_dimensions == 1) {
+            return batch_t(n, etl::dim<0>(one));
+        } else if constexpr (input_dimensions == 2) {
+            return batch_t(n, etl::dim<0>(one), etl::dim<1>(one));
+        } else {
+            static_assert(input_dimensions == 3, "Invalid number of dimensions for dbn_inference_batcher");
+
+            return batch_t(n, etl::dim<0>(one), etl::dim<1>(one), etl::dim<2>(one));
+        }
+    }
+
+    const dbn_t& dbn;                     ///< The network
+    const std::chrono::microseconds max_delay; ///< The maximum time a sample waits for the next ones
+    const size_t max_batch;               ///< The maximum number of samples of a batch
+
+    std::deque<request> queue;        ///< The samples waiting to be forwarded
+    std::vector<std::thread> threads; ///< The threads of the workers
+
+    bool stop_flag = false; ///< Indicates that the workers must stop
+
+    std::mutex main_lock;              ///< The main lock
+    std::condition_variable condition; ///< The condition variable of the workers
+};
+
+} //end of dll namespace
@@ -0,0 +1,325 @@
+//=======================================================================
+// Copyright (c) 2014-2017 Baptiste Wicht
+// Distributed under the terms of the MIT License.
+// (See accompanying file LICENSE or copy at
+//  http://opensource.org/licenses/MIT)
+//=======================================================================
+
+/*!
+ * \file
+ * \brief Inference session, to forward batches concurrently through a network
+ */
+
+#pragma once
+
+#include <tuple>
+#include <algorithm>
+#include <utility>
+#include <type_traits>
+
+#include "dll/util/ready.hpp"
+#include "dll/util/batch_extend.hpp"
+#include "dll/util/scratch_arena.hpp"
+#include "dll/util/external_batch.hpp"
+#include "dll/util/conv_pool.hpp"
+
+namespace dll {
+
+namespace session_detail {
+
+/*!
+ * \brief The scratch of a layer without state in its forward pass
+ */
+struct no_scratch {};
+
+/*!
+ * \brief Extract the inference scratch type of a layer, no_scratch if the
+ * layer does not have one.
+ */
+template <typename Layer, typename Enable = void>
+struct scratch_type {
+    using type = no_scratch; ///< The scratch type
+};
+
+/*!
+ * \copydoc scratch_type
+ */
+template <typename Layer>
+struct scratch_type<Layer, std::void_t<typename Layer::inference_scratch>> {
+    using type = typename Layer::inference_scratch; ///< The scratch type
+};
+
+/*!
+ * \brief The tuple of the scratch of each layer of a network
+ */
+template <typename DBN, typename Sequence>
+struct scratch_tuple;
+
+/*!
+ * \copydoc scratch_tuple
+ */
+template <typename DBN, size_t... I>
+struct scratch_tuple<DBN, std::index_sequence<I...>> {
+    using type = std::tuple<typename scratch_type<typename DBN::template layer_type<I>>::type...>; ///< The tuple type
+};
+
+/*!
+ * \brief Indicates if none of the layers of the network needs a scratch
+ * state for their test forward pass, i.e. if several threads can forward
+ * samples through the network itself.
+ */
+template <typename DBN, size_t... I>
+constexpr bool is_stateless(std::index_sequence<I...>) {
+    return (std::is_same_v<typename scratch_type<typename DBN::template layer_type<I>>::type, no_scratch> && ...);
+}
+
+} //end of namespace session_detail
+
+/*!
+ * \brief An inference session on a network.
+ *
+ * The session owns the scratch state of the forward passes of the layers
+ * that need one (the recurrent layers) while the layers themselves (and
+ * their weights) are only read. Each thread can create its own session on
+ * the same network and forward batches concurrently, without copying the
+ * parameters. The network must not be trained while sessions are in use.
+ *
+ * With planned_forward_batch, the activations are written to two
+ * ping-pong arenas owned by the session: in a forward pass, only the input
+ * and the output of the current layer are alive, so the output of each
+ * layer reuses the arena of the input of the previous layer. The peak
+ * memory is twice the largest activation instead of the sum of all the
+ * activations, and no memory is allocated once the arenas are large
+ * enough.
+ */
+template <typename DBN>
+struct dbn_inference_session {
+    using dbn_t  = DBN;                   ///< The type of the network
+    using weight = typename dbn_t::weight; ///< The data type of the network
+
+    /*!
+     * \brief Create a new session on the given network
+     * \param dbn The network
+     */
+    explicit dbn_inference_session(const dbn_t& dbn) : dbn(dbn) {}
+
+    /*!
+     * \brief Return the test representation for the given input batch.
+     *
+     * \tparam LS The layer from which the representation is extracted
+     * \tparam L The layer to which the input is given
+     *
+     * \param input The input batch to the layer L
+     *
+     * \return The test representation of the LS layer forwarded from L
+     */
+    template <size_t LS = dbn_t::layers - 1, size_t L = 0, typename Input>
+    auto forward_batch(const Input& input) {
+        if constexpr (L != LS && conv_pool_next<L>()) {
+            using pool_t = typename dbn_t::template layer_type<L + 1>;
+
+            // The pooling layer directly pools the convolution
+            const auto& pool = dbn.template layer_get<L + 1>();
+
+            auto next = batch_extend(input, pool.template prepare_one_output<typename pool_t::input_one_t>());
+
+            conv_pool_forward<pool_t>(dbn.template layer_get<L>(), next, input);
+
+            if constexpr (L + 1 != LS) {
+                return forward_batch<LS, L + 2>(next);
+            } else {
+                return next;
+            }
+        } else {
+            auto next = forward_layer<L>(input);
+
+            if constexpr (L != LS) {
+                return forward_batch<LS, L + 1>(next);
+            } else {
+                return next;
+            }
+        }
+    }
+
+    /*!
+     * \brief Return the test representation for the given input batch,
+     * with the activations in the ping-pong arenas of the session.
+     *
+     * The returned batch is a view in an arena of the session. It is only
+     * valid until the next call on the session.
+     *
+     * \tparam LS The layer from which the representation is extracted
+     * \tparam L The layer to which the input is given
+     *
+     * \param input The input batch to the layer L
+     *
+     * \return The test representation of the LS layer forwarded from L
+     */
+    template <size_t LS = dbn_t::layers - 1, size_t L = 0, typename Input>
+    auto planned_forward_batch(const Input& input) {
+        auto output = planned_layer<L>(input);
+
+        if constexpr (L != LS) {
+            return planned_forward_batch<LS, L + 1>(output);
+        } else {
+            return output;
+        }
+    }
+
+    /*!
+     * \brief Compute the test representation for the given input batch
+     * into the given output batch, with the intermediate activations in
+     * the ping-pong arenas of the session.
+     *
+     * With views of memory owned by the caller (see external_batch), the
+     * inputs are read and the outputs are written in place, without any
+     * copy.
+     *
+     * \tparam LS The layer from which the representation is extracted
+     * \tparam L The layer to which the input is given
+     *
+     * \param output The output batch, of the shape of the outputs of LS
+     * \param input The input batch to the layer L
+     */
+    template <size_t LS = dbn_t::layers - 1, size_t L = 0, typename Output, typename Input>
+    void planned_forward_batch(Output&& output, const Input& input) {
+        if constexpr (L != LS) {
+            planned_forward_batch<LS, L + 1>(output, planned_layer<L>(input));
+        } else {
+            forward_layer<L>(output, input);
+        }
+    }
+
+    /*!
+     * \brief Gather a batch of inputs stored with a stride in memory owned
+     * by the caller into the input arena of the session.
+     *
+     * ETL views are contiguous, the strided samples are therefore copied
+     * once. The returned batch is only valid until the next call to
+     * strided_batch on the session.
+     *
+     * \param memory The memory of the first sample
+     * \param stride The distance between two samples, in number of values
+     * \param batch The number of samples of the batch
+     * \param dims The dimensions of one sample
+     *
+     * \return A view of the gathered batch [batch, dims...]
+     */
+    template <typename... Dims>
+    auto strided_batch(const weight* memory, size_t stride, size_t batch, Dims... dims) {
+        const size_t n = (size_t(dims) * ...);
+
+        cpp_assert(stride >= n, "The stride cannot be smaller than one sample");
+
+        input_arena.reserve(batch * n);
+
+        auto input = input_arena.template matrix<sizeof...(Dims) + 1>(batch, size_t(dims)...);
+
+        weight* ptr = input.memory_start();
+
+        for (size_t b = 0; b < batch; ++b) {
+            std::copy_n(memory + b * stride, n, ptr + b * n);
+        }
+
+        return input;
+    }
+
+    /*!
+     * \brief Returns the number of values allocated by the arenas of the
+     * session
+     */
+    size_t footprint() const {
+        return arenas[0].size() + arenas[1].size() + input_arena.size();
+    }
+
+private:
+    /*!
+     * \brief Forward the input batch through the layer L, into a view in
+     * the arena L % 2
+     */
+    template <size_t L, typename Input>
+    auto planned_layer(const Input& input) {
+        const auto& layer = dbn.template layer_get<L>();
+
+        auto one = prepare_one_ready_output(layer, input(0));
+
+        // The output of the layer L is in the arena L % 2, the arena of its input is still alive
+        auto& arena = arenas[L % 2];
+
+        arena.reserve(etl::dim<0>(input) * etl::size(one));
+
+        auto output = batch_view(arena, etl::dim<0>(input), one, std::make_index_sequence<etl::decay_traits<decltype(one)>::dimensions()>());
+
+        forward_layer<L>(output, input);
+
+        return output;
+    }
+
+    /*!
+     * \brief Create a view for a batch of outputs of the shape of the
+     * given output in the given arena
+     */
+    template <typename One, size_t... I>
+    static auto batch_view(scratch_arena<weight>& arena, size_t batch, const One& one, std::index_sequence<I...>) {
+        return arena.template matrix<sizeof...(I) + 1>(batch, etl::dim(one, I)...);
+    }
+
+    /*!
+     * \brief Forward the input batch through the layer L, into the given
+     * output batch
+     */
+    template <size_t L, typename Output, typename Input>
+    void forward_layer(Output& output, const Input& input) {
+        const auto& layer = dbn.template layer_get<L>();
+
+        using layer_t = typename dbn_t::template layer_type<L>;
+
+        if constexpr (std::is_same<typename session_detail::scratch_type<layer_t>::type, session_detail::no_scratch>::value) {
+            layer.test_forward_batch(output, input);
+        } else {
+            layer.inference_forward_batch(output, input, std::get<L>(scratch));
+        }
+    }
+
+    /*!
+     * \brief Indicates if the convolutional layer L is followed by a
+     * pooling layer pooling its output on the fly
+     */
+    template <size_t L>
+    static constexpr bool conv_pool_next() {
+        if constexpr (L + 1 < dbn_t::layers) {
+            return conv_pool_fusion<typename dbn_t::template layer_type<L>, typename dbn_t::template layer_type<L + 1>>();
+        } else {
+            return false;
+        }
+    }
+
+    /*!
+     * \brief Forward the input batch through the layer L
+     */
+    template <size_t L, typename Input>
+    auto forward_layer(const Input& input) {
+        const auto& layer = dbn.template layer_get<L>();
+
+        using layer_t = typename dbn_t::template layer_type<L>;
+
+        if constexpr (std::is_same<typename session_detail::scratch_type<layer_t>::type, session_detail::no_scratch>::value) {
+            return layer.test_forward_batch(input);
+        } else {
+            auto output = batch_extend(input, prepare_one_ready_output(layer, input(0)));
+
+            layer.inference_forward_batch(output, input, std::get<L>(scratch));
+
+            return output;
+        }
+    }
+
+    const dbn_t& dbn; ///< The network
+
+    scratch_arena<weight> arenas[2]; ///< The ping-pong arenas of the activations
+    scratch_arena<weight> input_arena; ///< The arena of the gathered strided inputs
+
+    typename session_detail::scratch_tuple<dbn_t, std::make_index_sequence<dbn_t::layers>>::type scratch; ///< The scratch of each layer
+};
+
+} //end of dll namespace
@@ -6,9 +6,12 @@
 //=======================================================================
 
 #include "dll/util/random.hpp"
+#include "dll/util/random_fill.hpp"
 
 /*!
  * \brief Initialization methods
+ *
+ * The large tensors are initialized in parallel, see random_fill.hpp
  */
 
 #pragma once
@@ -85,7 +88,7 @@ struct init_normal {
         constexpr auto mean   = etl::value_t<B>(Mean::num) / etl::value_t<B>(Mean::den);
         constexpr auto stddev = etl::value_t<B>(Std::num) / etl::value_t<B>(Std::den);
 
-        b = etl::normal_generator<etl::value_t<B>>(dll::rand_engine(), mean, stddev);
+        random_normal(b, mean, stddev);
     }
 };
 
@@ -109,7 +112,7 @@ struct init_uniform {
         constexpr auto a = etl::value_t<W>(A::num) / etl::value_t<W>(A::den);
         constexpr auto b = etl::value_t<W>(B::num) / etl::value_t<W>(B::den);
 
-        w = etl::uniform_generator<etl::value_t<W>>(dll::rand_engine(), a, b);
+        random_uniform(w, a, b);
     }
 };
 
@@ -130,7 +133,7 @@ struct init_lecun {
     static void initialize(B& b, size_t nin, size_t nout){
         cpp_unused(nout);
 
-        b = etl::normal_generator<etl::value_t<B>>(dll::rand_engine(), 0.0, 1.0) / sqrt(double(nin));
+        random_normal(b, 0.0, 1.0 / sqrt(double(nin)));
     }
 };
 
@@ -149,7 +152,7 @@ struct init_xavier {
     static void initialize(B& b, size_t nin, size_t nout){
         cpp_unused(nout);
 
-        b = etl::normal_generator<etl::value_t<B>>(dll::rand_engine(), 0.0, 1.0) * sqrt(1.0 / nin);
+        random_normal(b, 0.0, sqrt(1.0 / nin));
     }
 };
 
@@ -166,7 +169,7 @@ struct init_xavier_full {
      */
     template<typename B>
     static void initialize(B& b, size_t nin, size_t nout){
-        b = etl::normal_generator<etl::value_t<B>>(dll::rand_engine(), 0.0, 1.0) * sqrt(2.0 / (nin + nout));
+        random_normal(b, 0.0, sqrt(2.0 / (nin + nout)));
     }
 };
 
@@ -185,7 +188,7 @@ struct init_he {
     static void initialize(B& b, size_t nin, size_t nout){
         cpp_unused(nout);
 
-        b = etl::normal_generator<etl::value_t<B>>(dll::rand_engine(), 0.0, 1.0) * sqrt(2.0 / nin);
+        random_normal(b, 0.0, sqrt(2.0 / nin));
     }
 };
 
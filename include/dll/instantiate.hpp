@@ -0,0 +1,59 @@
+//=======================================================================
+// Copyright (c) 2014-2017 Baptiste Wicht
+// Distributed under the terms of the MIT License.
+// (See accompanying file LICENSE or copy at
+//  http://opensource.org/licenses/MIT)
+//=======================================================================
+
+/*!
+ * \file
+ * \brief Explicit instantiation of the training of networks.
+ *
+ * The training of a network instantiates the complete trainer stack
+ * (dbn_trainer, sgd_trainer and the contexts of all the layers), which is
+ * the most expensive part of the compilation of a network. It can be
+ * compiled once, in a separate translation unit (or a prebuilt library),
+ * and only declared in the other translation units:
+ *
+ * \code
+ * // network.hpp, included everywhere
+ * using network_t = dll::network_desc<...>::network_t;
+ * using generator_t = ...;
+ * DLL_EXTERN_TRAINING(network_t, generator_t);
+ *
+ * // network.cpp, compiled once
+ * #include "network.hpp"
+ * DLL_INSTANTIATE_TRAINING(network_t, generator_t);
+ * \endcode
+ *
+ * The types must be given as single identifiers (use type aliases).
+ */
+
+#pragma once
+
+/*!
+ * \brief Declare that the training of the network with the generator is
+ * instantiated in another translation unit.
+ */
+#define DLL_EXTERN_TRAINING(Network, Generator) \
+    extern template typename Network::weight Network::train_generator<Generator>(Generator&, size_t)
+
+/*!
+ * \brief Declare that the training of the network with the generator and
+ * the validation generator is instantiated in another translation unit.
+ */
+#define DLL_EXTERN_TRAINING_VAL(Network, Generator, ValGenerator) \
+    extern template typename Network::weight Network::train_generator<Generator, ValGenerator>(Generator&, ValGenerator&, size_t)
+
+/*!
+ * \brief Instantiate the training of the network with the generator.
+ */
+#define DLL_INSTANTIATE_TRAINING(Network, Generator) \
+    template typename Network::weight Network::train_generator<Generator>(Generator&, size_t)
+
+/*!
+ * \brief Instantiate the training of the network with the generator and
+ * the validation generator.
+ */
+#define DLL_INSTANTIATE_TRAINING_VAL(Network, Generator, ValGenerator) \
+    template typename Network::weight Network::train_generator<Generator, ValGenerator>(Generator&, ValGenerator&, size_t)
@@ -239,7 +239,7 @@ struct layer {
         auto output_batch = batch_extend(input_batch, one);
 
         // Finally forward propagation from input to output
-        test_forward_batch(output_batch, input_batch);
+        as_derived().test_forward_batch(output_batch, input_batch);
 
         // Return the output batch
         return output_batch;
@@ -263,7 +263,7 @@ struct layer {
         auto output_batch = batch_extend(input_batch, one);
 
         // Finally forward propagation from input to output
-        train_forward_batch(output_batch, input_batch);
+        as_derived().train_forward_batch(output_batch, input_batch);
 
         // Return the output batch
         return output_batch;
@@ -395,6 +395,22 @@ struct layer {
         return *cg_context_ptr;
     }
 
+    /*!
+     * \brief Returns the number of floating point operations of the
+     * forward pass of one sample. By default, one operation per output.
+     */
+    size_t forward_flops() const noexcept {
+        return as_derived().output_size();
+    }
+
+    /*!
+     * \brief Returns the number of floating point operations of the
+     * backward pass of one sample. By default, one operation per output.
+     */
+    size_t backward_flops() const noexcept {
+        return as_derived().output_size();
+    }
+
     /*!
      * \brief Backup the weights in the secondary weights matrix
      */
@@ -41,6 +41,12 @@ struct avgp_3d_layer_impl;
 template <typename Desc>
 struct dyn_avgp_3d_layer_impl;
 
+template <typename Desc>
+struct global_avgp_layer_impl;
+
+template <typename Desc>
+struct dyn_global_avgp_layer_impl;
+
 template <typename Desc>
 struct upsample_3d_layer_impl;
 
@@ -77,6 +83,15 @@ struct dyn_dense_layer_impl;
 template <typename Desc>
 struct conv_layer_impl;
 
+template <typename Desc>
+struct conv_same_layer_impl;
+
+template <typename Desc>
+struct batch_normalization_2d_layer_impl;
+
+template <typename Desc>
+struct batch_normalization_4d_layer_impl;
+
 template <typename Desc>
 struct dyn_conv_layer_impl;
 
@@ -113,4 +128,16 @@ struct dyn_merge_layer_desc;
 template <typename Desc>
 struct dyn_merge_layer_impl;
 
+template <typename Layer>
+struct bidirectional_layer_desc;
+
+template <typename Desc>
+struct bidirectional_layer_impl;
+
+template <typename Layer>
+struct dyn_bidirectional_layer_desc;
+
+template <typename Desc>
+struct dyn_bidirectional_layer_impl;
+
 } //end of dll namespace
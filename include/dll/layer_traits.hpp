@@ -14,6 +14,113 @@
 
 namespace dll {
 
+namespace traits_detail {
+
+/*!
+ * \brief Indicates if the layer is applied independently to each value
+ * (with a static apply_one function)
+ */
+template <typename Layer, typename Enable = void>
+struct element_wise_layer : std::false_type {};
+
+/*!
+ * \copydoc element_wise_layer
+ */
+template <typename Layer>
+struct element_wise_layer<Layer, std::void_t<decltype(Layer::element_wise)>> : std::bool_constant<Layer::element_wise> {};
+
+/*!
+ * \brief Indicates if the layer only gives a shape to its input (with a
+ * view_batch function)
+ */
+template <typename Layer, typename Enable = void>
+struct shape_layer : std::false_type {};
+
+/*!
+ * \copydoc shape_layer
+ */
+template <typename Layer>
+struct shape_layer<Layer, std::void_t<decltype(Layer::shape_only)>> : std::bool_constant<Layer::shape_only> {};
+
+/*!
+ * \brief Indicates if the layer extracts the last time step of the
+ * sequences of a recurrent layer
+ */
+template <typename Layer, typename Enable = void>
+struct recurrent_last_layer : std::false_type {};
+
+/*!
+ * \copydoc recurrent_last_layer
+ */
+template <typename Layer>
+struct recurrent_last_layer<Layer, std::void_t<decltype(Layer::recurrent_last)>> : std::bool_constant<Layer::recurrent_last> {};
+
+/*!
+ * \brief Indicates if the recurrent layer can output only the last time
+ * step of its sequences
+ */
+template <typename Layer, typename Enable = void>
+struct last_step_layer : std::false_type {};
+
+/*!
+ * \copydoc last_step_layer
+ */
+template <typename Layer>
+struct last_step_layer<Layer, std::void_t<decltype(Layer::last_step_output)>> : std::bool_constant<Layer::last_step_output> {};
+
+/*!
+ * \brief Indicates if the convolutional layer can be fused with a
+ * following pooling layer
+ */
+template <typename Layer, typename Enable = void>
+struct pool_fusion_layer : std::false_type {};
+
+/*!
+ * \copydoc pool_fusion_layer
+ */
+template <typename Layer>
+struct pool_fusion_layer<Layer, std::void_t<decltype(Layer::pool_fusion)>> : std::bool_constant<Layer::pool_fusion> {};
+
+/*!
+ * \brief Indicates if the pooling layer can be fused with a previous
+ * convolutional layer for inference
+ */
+template <typename Layer, typename Enable = void>
+struct conv_fusion_layer : std::false_type {};
+
+/*!
+ * \copydoc conv_fusion_layer
+ */
+template <typename Layer>
+struct conv_fusion_layer<Layer, std::void_t<decltype(Layer::conv_fusion)>> : std::bool_constant<Layer::conv_fusion> {};
+
+/*!
+ * \brief Indicates if the pooling layer can be fused with a previous
+ * convolutional layer for training (from its max indices)
+ */
+template <typename Layer, typename Enable = void>
+struct conv_train_fusion_layer : std::false_type {};
+
+/*!
+ * \copydoc conv_train_fusion_layer
+ */
+template <typename Layer>
+struct conv_train_fusion_layer<Layer, std::void_t<decltype(Layer::conv_train_fusion)>> : std::bool_constant<Layer::conv_train_fusion> {};
+
+/*!
+ * \brief Indicates if the activation function of the layer is RELU
+ */
+template <typename Layer, typename Enable = void>
+struct relu_layer : std::false_type {};
+
+/*!
+ * \copydoc relu_layer
+ */
+template <typename Layer>
+struct relu_layer<Layer, std::void_t<decltype(Layer::activation_function)>> : std::bool_constant<Layer::activation_function == function::RELU> {};
+
+} //end of namespace traits_detail
+
 /*!
  * \brief Type Traits to get information on layer type
  */
@@ -120,6 +227,80 @@ struct layer_traits {
         return base_traits::is_transform;
     }
 
+    /*!
+     * \brief Indicates if this layer is applied independently to each
+     * value, and can therefore be fused with the previous layer.
+     */
+    static constexpr bool is_element_wise_layer() {
+        return traits_detail::element_wise_layer<layer_t>::value;
+    }
+
+    /*!
+     * \brief Indicates if this layer only gives a shape to its input,
+     * without changing the data, and can therefore be replaced by a view.
+     */
+    static constexpr bool is_shape_layer() {
+        return traits_detail::shape_layer<layer_t>::value;
+    }
+
+    /*!
+     * \brief Indicates if this layer extracts the last time step of the
+     * sequences of a recurrent layer
+     */
+    static constexpr bool is_recurrent_last_layer() {
+        return traits_detail::recurrent_last_layer<layer_t>::value;
+    }
+
+    /*!
+     * \brief Indicates if this recurrent layer can output only the last
+     * time step of its sequences, when it is followed by a recurrent_last
+     * layer
+     */
+    static constexpr bool has_last_step_output() {
+        return traits_detail::last_step_layer<layer_t>::value;
+    }
+
+    /*!
+     * \brief Indicates if this convolutional layer can be fused with a
+     * following pooling layer, without materializing its output
+     */
+    static constexpr bool has_pool_fusion() {
+        return traits_detail::pool_fusion_layer<layer_t>::value;
+    }
+
+    /*!
+     * \brief Indicates if this pooling layer can be fused with a previous
+     * convolutional layer for inference
+     */
+    static constexpr bool has_conv_fusion() {
+        return traits_detail::conv_fusion_layer<layer_t>::value;
+    }
+
+    /*!
+     * \brief Indicates if this pooling layer can be fused with a previous
+     * convolutional layer for training
+     */
+    static constexpr bool has_conv_train_fusion() {
+        return traits_detail::conv_train_fusion_layer<layer_t>::value;
+    }
+
+    /*!
+     * \brief Indicates if the activation function of this layer is RELU:
+     * its derivative only depends on the sign of its output
+     */
+    static constexpr bool has_relu_activation() {
+        return traits_detail::relu_layer<layer_t>::value;
+    }
+
+    /*!
+     * \brief Indicates if the training of this layer only uses its input to
+     * compute its gradients and its output for the derivative of its
+     * activation (standard dense and convolutional layers)
+     */
+    static constexpr bool has_compressible_activations() {
+        return is_standard_dense_layer() || is_standard_convolutional_layer();
+    }
+
     /*!
      * \brief Indicates if this layer keeps the same type
      */
@@ -234,6 +415,29 @@ struct rbm_layer_traits {
     static constexpr bool free_energy() {
         return base_traits::has_free_energy;
     }
+
+    /*!
+     * \brief Returns the number of micro-batches trained in parallel for
+     * each batch (data-parallel pretraining)
+     */
+    static constexpr size_t micro_batches() {
+        return base_traits::micro_batches;
+    }
+
+    /*!
+     * \brief Returns the number of batch slices whose filter gradients are
+     * computed in parallel (convolutional RBM only)
+     */
+    static constexpr size_t gradient_slices() {
+        return base_traits::gradient_slices;
+    }
+
+    /*!
+     * \brief Returns the early stopping strategy of the training of the RBM
+     */
+    static constexpr strategy early_stopping() {
+        return base_traits::early_strategy;
+    }
 };
 
 template <typename T>
@@ -26,6 +26,8 @@ struct activation_layer_impl : transform_layer<activation_layer_impl<Desc>> {
 
     static constexpr function activation_function = desc::activation_function;
 
+    static constexpr bool element_wise = is_element_wise(activation_function); ///< Indicates if the layer is applied independently to each value
+
     activation_layer_impl() = default;
 
     /*!
@@ -60,6 +62,17 @@ struct activation_layer_impl : transform_layer<activation_layer_impl<Desc>> {
         output = f_activate<activation_function>(input);
     }
 
+    /*!
+     * \brief Apply the layer to a single value, only for element-wise
+     * activation functions
+     * \param x The input value
+     * \return the output value
+     */
+    template <typename T>
+    static T apply_one(T x) {
+        return f_activate_one<activation_function>(x);
+    }
+
     /*!
      * \brief Adapt the errors, called before backpropagation of the errors.
      *
@@ -118,15 +131,11 @@ struct layer_base_traits<activation_layer_impl<Desc>> {
  * \brief Specialization of sgd_context for activation_layer_impl
  */
 template <typename DBN, typename Desc, size_t L>
-struct sgd_context<DBN, activation_layer_impl<Desc>, L> {
+struct sgd_context<DBN, activation_layer_impl<Desc>, L> : transform_sgd_context<previous_output_t<DBN, L>, activation_layer_impl<Desc>::element_wise> {
     using layer_t          = activation_layer_impl<Desc>;                            ///< The current layer type
     using previous_layer   = typename DBN::template layer_type<L - 1>;          ///< The previous layer type
     using previous_context = sgd_context<DBN, previous_layer, L - 1>;           ///< The previous layer's context
-    using inputs_t         = decltype(std::declval<previous_context>().output); ///< The type of inputs
-
-    inputs_t input;  ///< A batch of input
-    inputs_t output; ///< A batch of output
-    inputs_t errors; ///< A batch of errors
+    using inputs_t         = previous_output_t<DBN, L>;                         ///< The type of inputs
 
     sgd_context(const layer_t& /*layer*/){}
 };
@@ -8,6 +8,7 @@
 #pragma once
 
 #include "dll/neural_layer.hpp"
+#include "dll/util/scratch_arena.hpp"
 
 namespace dll {
 
@@ -45,6 +46,9 @@ struct batch_normalization_2d_layer_impl : neural_layer<batch_normalization_2d_l
 
     weight momentum = 0.9;
 
+    bool folded       = false; ///< Indicates that the normalization has been folded into the previous layer
+    bool folded_shift = false; ///< Indicates that the shift (beta) of the folded normalization is still applied by this layer
+
     //Backup gamma and beta
     std::unique_ptr<etl::fast_matrix<weight, Input>> bak_gamma; ///< Backup gamma
     std::unique_ptr<etl::fast_matrix<weight, Input>> bak_beta;  ///< Backup beta
@@ -80,6 +84,22 @@ struct batch_normalization_2d_layer_impl : neural_layer<batch_normalization_2d_l
         return 4 * Input;
     }
 
+    /*!
+     * \brief Returns the number of floating point operations of the
+     * forward pass of one sample
+     */
+    static constexpr size_t forward_flops() noexcept {
+        return 4 * input_size();
+    }
+
+    /*!
+     * \brief Returns the number of floating point operations of the
+     * backward pass (errors and gradients) of one sample
+     */
+    static constexpr size_t backward_flops() noexcept {
+        return 8 * input_size();
+    }
+
     /*!
      * \brief Return the size of the input of this layer
      * \return The size of the input of this layer
@@ -120,7 +140,19 @@ struct batch_normalization_2d_layer_impl : neural_layer<batch_normalization_2d_l
 
         const auto B = etl::dim<0>(input);
 
-        auto inv_var = etl::force_temporary(1.0 / etl::sqrt(var + e));
+        if (folded) {
+            if (folded_shift) {
+                output = bias_add_2d(input, beta);
+            } else {
+                output = input;
+            }
+
+            return;
+        }
+
+        temporary_scope<weight> scope;
+
+        auto inv_var = scope.value(1.0 / etl::sqrt(var + e));
 
         for(size_t b = 0; b < B; ++b){
             output(b) = (gamma >> ((input(b) - mean) >> inv_var)) + beta;
@@ -136,6 +168,8 @@ struct batch_normalization_2d_layer_impl : neural_layer<batch_normalization_2d_l
     void train_forward_batch(Output& output, const Input& input) {
         dll::auto_timer timer("bn:2d:train:forward");
 
+        cpp_assert(!folded, "A folded batch normalization layer cannot be trained");
+
         const auto B = etl::dim<0>(input);
 
         last_mean = etl::bias_batch_mean_2d(input);
@@ -254,6 +288,57 @@ struct batch_normalization_2d_layer_impl : neural_layer<batch_normalization_2d_l
         return std::make_tuple(std::cref(gamma), std::cref(beta));
     }
 
+    /*!
+     * \brief Indicates if the normalization can be folded into the given
+     * previous layer
+     * \tparam Layer The type of the previous layer
+     */
+    template <typename Layer>
+    static constexpr bool foldable() {
+        if constexpr (cpp::is_specialization_of_v<dense_layer_impl, Layer>) {
+            return Layer::activation_function == function::IDENTITY && Layer::output_size() == Input;
+        } else {
+            return false;
+        }
+    }
+
+    /*!
+     * \brief Fold the normalization into the weights and the biases of
+     * the previous layer, for inference.
+     *
+     * The scale of the normalization is merged into the weights of the
+     * previous layer and its shift into the biases. If the previous layer
+     * has no biases, this layer still adds the shift. The layer cannot be
+     * trained anymore after this.
+     *
+     * \param layer The previous layer
+     */
+    template <typename Layer>
+    void fold_into(Layer& layer) {
+        static_assert(foldable<Layer>(), "The normalization cannot be folded into this layer");
+
+        cpp_assert(!folded, "The normalization has already been folded");
+
+        const size_t NV = etl::dim<0>(layer.w);
+
+        auto scale = etl::force_temporary(gamma / etl::sqrt(var + e));
+
+        for (size_t i = 0; i < NV; ++i) {
+            layer.w(i) = layer.w(i) >> scale;
+        }
+
+        if constexpr (Layer::no_bias) {
+            beta         = beta - (scale >> mean);
+            folded_shift = true;
+        } else {
+            layer.b = (scale >> (layer.b - mean)) + beta;
+        }
+
+        layer.weights_changed();
+
+        folded = true;
+    }
+
     /*!
      * \brief Backup the weights in the secondary weights matrix
      */
@@ -8,6 +8,8 @@
 #pragma once
 
 #include "dll/neural_layer.hpp"
+#include "dll/util/scratch_arena.hpp"
+#include "dll/util/batch_norm.hpp"
 
 namespace dll {
 
@@ -43,10 +45,11 @@ struct batch_normalization_4d_layer_impl : neural_layer<batch_normalization_4d_l
     etl::fast_matrix<weight, Kernels> last_var;
     etl::fast_matrix<weight, Kernels> inv_var;
 
-    etl::dyn_matrix<weight, 4> input_pre; /// B x K x W x H
-
     weight momentum = 0.9;
 
+    bool folded       = false; ///< Indicates that the normalization has been folded into the previous layer
+    bool folded_shift = false; ///< Indicates that the shift (beta) of the folded normalization is still applied by this layer
+
     //Backup gamma and beta
     std::unique_ptr<etl::fast_matrix<weight, Kernels>> bak_gamma; ///< Backup gamma
     std::unique_ptr<etl::fast_matrix<weight, Kernels>> bak_beta;  ///< Backup beta
@@ -82,6 +85,22 @@ struct batch_normalization_4d_layer_impl : neural_layer<batch_normalization_4d_l
         return 4 * Kernels;
     }
 
+    /*!
+     * \brief Returns the number of floating point operations of the
+     * forward pass of one sample
+     */
+    static constexpr size_t forward_flops() noexcept {
+        return 4 * input_size();
+    }
+
+    /*!
+     * \brief Returns the number of floating point operations of the
+     * backward pass (errors and gradients) of one sample
+     */
+    static constexpr size_t backward_flops() noexcept {
+        return 8 * input_size();
+    }
+
     /*!
      * \brief Return the size of the input of this layer
      * \return The size of the input of this layer
@@ -120,7 +139,19 @@ struct batch_normalization_4d_layer_impl : neural_layer<batch_normalization_4d_l
     void test_forward_batch(Output& output, const Input& input) const {
         const auto B = etl::dim<0>(input);
 
-        auto inv_var = etl::force_temporary(1.0 / etl::sqrt(var + e));
+        if (folded) {
+            if (folded_shift) {
+                output = bias_add_4d(input, beta);
+            } else {
+                output = input;
+            }
+
+            return;
+        }
+
+        temporary_scope<weight> scope;
+
+        auto inv_var = scope.value(1.0 / etl::sqrt(var + e));
 
         for (size_t b = 0; b < B; ++b) {
             for (size_t k = 0; k < Kernels; ++k) {
@@ -138,31 +169,46 @@ struct batch_normalization_4d_layer_impl : neural_layer<batch_normalization_4d_l
     void train_forward_batch(Output& output, const Input& input) {
         cpp_unused(output);
 
+        cpp_assert(!folded, "A folded batch normalization layer cannot be trained");
+
         const auto B = etl::dim<0>(input);
         const auto S = B * W * H;
 
-        // Compute the mean of the mini-batch
-        last_mean = etl::bias_batch_mean_4d(input);
-
-        // Compute the variance of the mini-batch
-        last_var  = 0;
-
-        for (size_t b = 0; b < B; ++b) {
-            for (size_t k = 0; k < Kernels; ++k) {
-                last_var(k) += etl::sum((input(b)(k) - last_mean(k)) >> (input(b)(k) - last_mean(k)));
+        if constexpr (etl::all_dma<Output, Input>) {
+            // One pass for the statistics and one for the output
+            input.ensure_cpu_up_to_date();
+            gamma.ensure_cpu_up_to_date();
+            beta.ensure_cpu_up_to_date();
+
+            batch_norm_4d_forward(input.memory_start(), output.memory_start(), B, Kernels, W * H,
+                                  gamma.memory_start(), beta.memory_start(), e,
+                                  last_mean.memory_start(), last_var.memory_start(), inv_var.memory_start());
+
+            output.invalidate_gpu();
+            last_mean.invalidate_gpu();
+            last_var.invalidate_gpu();
+            inv_var.invalidate_gpu();
+        } else {
+            // Compute the mean of the mini-batch
+            last_mean = etl::bias_batch_mean_4d(input);
+
+            // Compute the variance of the mini-batch
+            last_var = 0;
+
+            for (size_t b = 0; b < B; ++b) {
+                for (size_t k = 0; k < Kernels; ++k) {
+                    last_var(k) += etl::sum((input(b)(k) - last_mean(k)) >> (input(b)(k) - last_mean(k)));
+                }
             }
-        }
-
-        last_var /= S;
 
-        inv_var  = 1.0 / etl::sqrt(last_var + e);
+            last_var /= S;
 
-        input_pre.inherit_if_null(input);
+            inv_var = 1.0 / etl::sqrt(last_var + e);
 
-        for(size_t b = 0; b < B; ++b){
-            for (size_t k = 0; k < Kernels; ++k) {
-                input_pre(b)(k) = (input(b)(k) - last_mean(k)) >> inv_var(k);
-                output(b)(k)    = (gamma(k) >> input_pre(b)(k)) + beta(k);
+            for (size_t b = 0; b < B; ++b) {
+                for (size_t k = 0; k < Kernels; ++k) {
+                    output(b)(k) = (gamma(k) >> ((input(b)(k) - last_mean(k)) >> inv_var(k))) + beta(k);
+                }
             }
         }
 
@@ -193,23 +239,39 @@ struct batch_normalization_4d_layer_impl : neural_layer<batch_normalization_4d_l
         const auto B = etl::dim<0>(context.input);
         const auto S = B * W * H;
 
-        auto dxhat = etl::force_temporary_dim_only(context.errors);
+        if constexpr (etl::all_dma<std::decay_t<HH>, decltype(context.input), decltype(context.errors)>) {
+            // The normalized input is recomputed from the statistics
+            context.input.ensure_cpu_up_to_date();
+            context.errors.ensure_cpu_up_to_date();
+            gamma.ensure_cpu_up_to_date();
 
-        for(size_t b = 0; b < B; ++b){
-            for (size_t k = 0; k < Kernels; ++k) {
-                dxhat(b)(k) = context.errors(b)(k) >> gamma(k);
+            batch_norm_4d_backward(context.input.memory_start(), context.errors.memory_start(), output.memory_start(), B, Kernels, W * H,
+                                   gamma.memory_start(), last_mean.memory_start(), inv_var.memory_start());
+
+            output.invalidate_gpu();
+        } else {
+            temporary_scope<weight> scope;
+
+            auto dxhat = scope.like(context.errors);
+            auto xhat  = scope.like(context.input);
+
+            for (size_t b = 0; b < B; ++b) {
+                for (size_t k = 0; k < Kernels; ++k) {
+                    dxhat(b)(k) = context.errors(b)(k) >> gamma(k);
+                    xhat(b)(k)  = (context.input(b)(k) - last_mean(k)) >> inv_var(k);
+                }
             }
-        }
 
-        auto dxhat_l      = etl::bias_batch_sum_4d(dxhat);
-        auto dxhat_xhat_l = etl::bias_batch_sum_4d(dxhat >> input_pre);
+            auto dxhat_l      = etl::bias_batch_sum_4d(dxhat);
+            auto dxhat_xhat_l = etl::bias_batch_sum_4d(dxhat >> xhat);
 
-        *dxhat_l;
-        *dxhat_xhat_l;
+            *dxhat_l;
+            *dxhat_xhat_l;
 
-        for(size_t b = 0; b < B; ++b){
-            for (size_t k = 0; k < Kernels; ++k) {
-                output(b)(k) = ((1.0 / S) * inv_var(k)) >> (S * dxhat(b)(k) - dxhat_l(k) - (input_pre(b)(k) >> dxhat_xhat_l(k)));
+            for (size_t b = 0; b < B; ++b) {
+                for (size_t k = 0; k < Kernels; ++k) {
+                    output(b)(k) = ((1.0 / S) * inv_var(k)) >> (S * dxhat(b)(k) - dxhat_l(k) - (xhat(b)(k) >> dxhat_xhat_l(k)));
+                }
             }
         }
     }
@@ -220,11 +282,39 @@ struct batch_normalization_4d_layer_impl : neural_layer<batch_normalization_4d_l
      */
     template<typename C>
     void compute_gradients(C& context) const {
-        // Gradients of gamma
-        std::get<0>(context.up.context)->grad = etl::bias_batch_sum_4d(input_pre >> context.errors);
+        auto& gamma_grad = std::get<0>(context.up.context)->grad;
+        auto& beta_grad  = std::get<1>(context.up.context)->grad;
+
+        if constexpr (etl::all_dma<decltype(context.input), decltype(context.errors)>) {
+            const auto B = etl::dim<0>(context.input);
+
+            context.input.ensure_cpu_up_to_date();
+            context.errors.ensure_cpu_up_to_date();
+
+            batch_norm_4d_gradients(context.input.memory_start(), context.errors.memory_start(), B, Kernels, W * H,
+                                    last_mean.memory_start(), inv_var.memory_start(), gamma_grad.memory_start(), beta_grad.memory_start());
 
-        // Gradients of beta
-        std::get<1>(context.up.context)->grad = etl::bias_batch_sum_4d(context.errors);
+            gamma_grad.invalidate_gpu();
+            beta_grad.invalidate_gpu();
+        } else {
+            const auto B = etl::dim<0>(context.input);
+
+            temporary_scope<weight> scope;
+
+            auto xhat = scope.like(context.input);
+
+            for (size_t b = 0; b < B; ++b) {
+                for (size_t k = 0; k < Kernels; ++k) {
+                    xhat(b)(k) = (context.input(b)(k) - last_mean(k)) >> inv_var(k);
+                }
+            }
+
+            // Gradients of gamma
+            gamma_grad = etl::bias_batch_sum_4d(xhat >> context.errors);
+
+            // Gradients of beta
+            beta_grad = etl::bias_batch_sum_4d(context.errors);
+        }
     }
 
     /*!
@@ -274,6 +364,68 @@ struct batch_normalization_4d_layer_impl : neural_layer<batch_normalization_4d_l
         return std::make_tuple(std::cref(gamma), std::cref(beta));
     }
 
+    /*!
+     * \brief Indicates if the given layer has no biases
+     * \tparam Layer The type of the layer
+     */
+    template <typename Layer>
+    static constexpr bool layer_no_bias() {
+        if constexpr (cpp::is_specialization_of_v<conv_layer_impl, Layer>) {
+            return Layer::no_bias;
+        } else {
+            return false;
+        }
+    }
+
+    /*!
+     * \brief Indicates if the normalization can be folded into the given
+     * previous layer
+     * \tparam Layer The type of the previous layer
+     */
+    template <typename Layer>
+    static constexpr bool foldable() {
+        if constexpr (cpp::is_specialization_of_v<conv_layer_impl, Layer> || cpp::is_specialization_of_v<conv_same_layer_impl, Layer>) {
+            return Layer::activation_function == function::IDENTITY && Layer::K == Kernels;
+        } else {
+            return false;
+        }
+    }
+
+    /*!
+     * \brief Fold the normalization into the filters and the biases of
+     * the previous layer, for inference.
+     *
+     * The scale of the normalization is merged into the filters of the
+     * previous layer and its shift into the biases. If the previous layer
+     * has no biases, this layer still adds the shift. The layer cannot be
+     * trained anymore after this.
+     *
+     * \param layer The previous layer
+     */
+    template <typename Layer>
+    void fold_into(Layer& layer) {
+        static_assert(foldable<Layer>(), "The normalization cannot be folded into this layer");
+
+        cpp_assert(!folded, "The normalization has already been folded");
+
+        auto scale = etl::force_temporary(gamma / etl::sqrt(var + e));
+
+        for (size_t k = 0; k < Kernels; ++k) {
+            layer.w(k) *= scale(k);
+        }
+
+        if constexpr (layer_no_bias<Layer>()) {
+            beta         = beta - (scale >> mean);
+            folded_shift = true;
+        } else {
+            layer.b = (scale >> (layer.b - mean)) + beta;
+        }
+
+        layer.weights_changed();
+
+        folded = true;
+    }
+
     /*!
      * \brief Backup the weights in the secondary weights matrix
      */
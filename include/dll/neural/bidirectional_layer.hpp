@@ -0,0 +1,13 @@
+//=======================================================================
+// Copyright (c) 2014-2017 Baptiste Wicht
+// Distributed under the terms of the MIT License.
+// (See accompanying file LICENSE or copy at
+//  http://opensource.org/licenses/MIT)
+//=======================================================================
+
+#pragma once
+
+#include "dll/neural/dyn_bidirectional_layer.hpp"
+
+#include "dll/neural/bidirectional_layer_impl.hpp"
+#include "dll/neural/bidirectional_layer_desc.hpp"
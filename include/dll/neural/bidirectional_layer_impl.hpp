@@ -0,0 +1,205 @@
+//=======================================================================
+// Copyright (c) 2014-2017 Baptiste Wicht
+// Distributed under the terms of the MIT License.
+// (See accompanying file LICENSE or copy at
+//  http://opensource.org/licenses/MIT)
+//=======================================================================
+
+#pragma once
+
+#include "dll/base_traits.hpp"
+#include "dll/dbn_traits.hpp"
+#include "dll/base_bidirectional_layer.hpp"
+
+#include "dll/util/timers.hpp" // for auto_timer
+
+namespace dll {
+
+/*!
+ * \brief Bidirectional recurrent layer of neural network.
+ *
+ * The forward and the backward directions are two layers of the type
+ * given in the descriptor, run concurrently.
+ */
+template <typename Desc>
+struct bidirectional_layer_impl final : base_bidirectional_layer<bidirectional_layer_impl<Desc>, typename Desc::direction_t> {
+    using desc        = Desc;                                               ///< The descriptor of the layer
+    using direction_t = typename desc::direction_t;                         ///< The layer of each direction
+    using weight      = typename direction_t::weight;                       ///< The data type for this layer
+    using this_type   = bidirectional_layer_impl<desc>;                     ///< The type of this layer
+    using base_type   = base_bidirectional_layer<this_type, direction_t>; ///< The base type
+    using layer_t     = this_type;                                          ///< This layer's type
+    using dyn_layer_t = typename desc::dyn_layer_t;                         ///< The dynamic version of this layer
+
+    static constexpr size_t time_steps      = direction_t::time_steps;       ///< The number of time steps
+    static constexpr size_t sequence_length = direction_t::sequence_length;  ///< The length of the sequences
+    static constexpr size_t hidden_units    = 2 * direction_t::hidden_units; ///< The number of outputs per time step (both directions)
+
+    using input_one_t  = etl::fast_dyn_matrix<weight, time_steps, sequence_length>; ///< The type of one input
+    using output_one_t = etl::fast_dyn_matrix<weight, time_steps, hidden_units>;    ///< The type of one output
+    using input_t      = std::vector<input_one_t>;                                  ///< The type of the input
+    using output_t     = std::vector<output_one_t>;                                 ///< The type of the output
+
+    /*!
+     * \brief Returns the input size of this layer
+     */
+    static constexpr size_t input_size() noexcept {
+        return time_steps * sequence_length;
+    }
+
+    /*!
+     * \brief Returns the output size of this layer
+     */
+    static constexpr size_t output_size() noexcept {
+        return time_steps * hidden_units;
+    }
+
+    /*!
+     * \brief Returns the number of parameters of this layer
+     */
+    static constexpr size_t parameters() noexcept {
+        return 2 * direction_t::parameters();
+    }
+
+    /*!
+     * \brief Apply the layer to the given batch of input.
+     *
+     * \param x A batch of input
+     * \param output A batch of output that will be filled
+     */
+    template <typename H, typename V>
+    void forward_batch(H&& output, const V& x) const {
+        dll::auto_timer timer("bidirectional:forward_batch");
+
+        cpp_assert(etl::dim<0>(output) == etl::dim<0>(x), "The number of samples must be consistent");
+
+        base_type::forward_batch_impl(output, x);
+    }
+
+    /*!
+     * \brief Prepare one empty output for this layer
+     * \return an empty ETL matrix suitable to store one output of this layer
+     *
+     * \tparam Input The type of one Input
+     */
+    template <typename Input>
+    output_one_t prepare_one_output() const {
+        return {};
+    }
+
+    /*!
+     * \brief Prepare a set of empty outputs for this layer
+     * \param samples The number of samples to prepare the output for
+     * \return a container containing empty ETL matrices suitable to store samples output of this layer
+     * \tparam Input The type of one input
+     */
+    template <typename Input>
+    static output_t prepare_output(size_t samples) {
+        return output_t{samples};
+    }
+
+    /*!
+     * \brief Initialize the dynamic version of the layer from the
+     * fast version of the layer
+     * \param dyn Reference to the dynamic version of the layer that
+     * needs to be initialized
+     */
+    template <typename DLayer>
+    static void dyn_init(DLayer& dyn) {
+        dyn.init_layer(time_steps, sequence_length, direction_t::hidden_units);
+    }
+
+    /*!
+     * \brief Adapt the errors, called before backpropagation of the errors.
+     *
+     * This must be used by layers that have both an activation fnction and a non-linearity.
+     *
+     * \param context the training context
+     */
+    template <typename C>
+    void adapt_errors(C& context) const {
+        // Nothing to do here (done in BPTT)
+        cpp_unused(context);
+    }
+
+    /*!
+     * \brief Backpropagate the errors to the previous layers
+     * \param output The ETL expression into which write the output
+     * \param context The training context
+     */
+    template <typename H, typename C>
+    void backward_batch(H&& output, C& context) const {
+        dll::auto_timer timer("bidirectional:backward_batch");
+
+        base_type::backward_batch_impl(output, context);
+    }
+
+    /*!
+     * \brief Compute the gradients for this layer, if any
+     * \param context The trainng context
+     */
+    template <typename C>
+    void compute_gradients(C& context) const {
+        if constexpr (!C::layer) {
+            dll::auto_timer timer("bidirectional:compute_gradients");
+
+            base_type::compute_gradients_impl(context);
+        }
+    }
+};
+
+//Allow odr-use of the constexpr static members
+
+template <typename Desc>
+const size_t bidirectional_layer_impl<Desc>::time_steps;
+
+template <typename Desc>
+const size_t bidirectional_layer_impl<Desc>::sequence_length;
+
+template <typename Desc>
+const size_t bidirectional_layer_impl<Desc>::hidden_units;
+
+// Declare the traits for the Layer
+
+template <typename Desc>
+struct layer_base_traits<bidirectional_layer_impl<Desc>> {
+    static constexpr bool is_neural     = true;  ///< Indicates if the layer is a neural layer
+    static constexpr bool is_dense      = false; ///< Indicates if the layer is dense
+    static constexpr bool is_conv       = false; ///< Indicates if the layer is convolutional
+    static constexpr bool is_deconv     = false; ///< Indicates if the layer is deconvolutional
+    static constexpr bool is_standard   = true;  ///< Indicates if the layer is standard
+    static constexpr bool is_rbm        = false; ///< Indicates if the layer is RBM
+    static constexpr bool is_pooling    = false; ///< Indicates if the layer is a pooling layer
+    static constexpr bool is_unpooling  = false; ///< Indicates if the layer is an unpooling laye
+    static constexpr bool is_transform  = false; ///< Indicates if the layer is a transform layer
+    static constexpr bool is_recurrent  = true;  ///< Indicates if the layer is a recurrent layer
+    static constexpr bool is_multi      = false; ///< Indicates if the layer is a multi-layer layer
+    static constexpr bool is_dynamic    = false; ///< Indicates if the layer is dynamic
+    static constexpr bool pretrain_last = false; ///< Indicates if the layer is dynamic
+    static constexpr bool sgd_supported = true;  ///< Indicates if the layer is supported by SGD
+};
+
+/*!
+ * \brief specialization of sgd_context for bidirectional_layer_impl
+ */
+template <typename DBN, typename Desc, size_t L>
+struct sgd_context<DBN, bidirectional_layer_impl<Desc>, L> {
+    using layer_t = bidirectional_layer_impl<Desc>;
+    using weight  = typename layer_t::weight; ///< The data type for this layer
+
+    static constexpr size_t time_steps      = layer_t::time_steps;      ///< The number of time steps
+    static constexpr size_t sequence_length = layer_t::sequence_length; ///< The length of the sequences
+    static constexpr size_t hidden_units    = layer_t::hidden_units;    ///< The number of outputs per time step
+
+    static constexpr size_t layer    = L;               ///< The index of the layer
+    static constexpr auto batch_size = DBN::batch_size; ///< The batch size of the network
+
+    etl::fast_matrix<weight, batch_size, time_steps, sequence_length> input;
+    etl::fast_matrix<weight, batch_size, time_steps, hidden_units> output;
+    etl::fast_matrix<weight, batch_size, time_steps, hidden_units> errors;
+
+    sgd_context(const bidirectional_layer_impl<Desc>& /* layer */)
+            : output(0.0), errors(0.0) {}
+};
+
+} //end of dll namespace
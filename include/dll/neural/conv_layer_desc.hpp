@@ -31,6 +31,14 @@ struct conv_layer_desc {
 
     static constexpr auto activation_function = detail::get_value_v<activation<function::SIGMOID>, Parameters...>;            ///< The layer's activation function
 
+    static constexpr size_t S1 = detail::get_value_1<stride<1, 1>, Parameters...>::value;  ///< The stride of the first dimension
+    static constexpr size_t S2 = detail::get_value_2<stride<1, 1>, Parameters...>::value;  ///< The stride of the second dimension
+    static constexpr size_t P1 = detail::get_value_1<padding<0, 0>, Parameters...>::value; ///< The padding of the first dimension
+    static constexpr size_t P2 = detail::get_value_2<padding<0, 0>, Parameters...>::value; ///< The padding of the second dimension
+    static constexpr size_t G  = detail::get_value_v<groups<1>, Parameters...>;            ///< The number of groups
+    static constexpr size_t D1 = detail::get_value_1<dilation<1, 1>, Parameters...>::value; ///< The dilation of the first dimension
+    static constexpr size_t D2 = detail::get_value_2<dilation<1, 1>, Parameters...>::value; ///< The dilation of the second dimension
+
     using w_initializer = detail::get_type_t<initializer<init_lecun>, Parameters...>;     ///< The initializer for the weights
     using b_initializer = detail::get_type_t<initializer_bias<init_zero>, Parameters...>; ///< The initializer for the biases
 
@@ -49,10 +57,15 @@ struct conv_layer_desc {
     static_assert(NW2 > 0, "A matrix of at least 1x1 is necessary for the weights");
     static_assert(NC > 0, "At least one channel is necessary");
     static_assert(K > 0, "At least one group is necessary");
+    static_assert(S1 > 0 && S2 > 0, "The stride must be at least 1");
+    static_assert(D1 > 0 && D2 > 0, "The dilation must be at least 1");
+    static_assert(NV1 + 2 * P1 >= D1 * (NW1 - 1) + 1, "The filters cannot be larger than the padded input");
+    static_assert(NV2 + 2 * P2 >= D2 * (NW2 - 1) + 1, "The filters cannot be larger than the padded input");
+    static_assert(G > 0 && NC % G == 0 && K % G == 0, "The channels and the filters must be divisible by the number of groups");
 
     //Make sure only valid types are passed to the configuration list
     static_assert(
-        detail::is_valid_v<cpp::type_list<weight_type_id, activation_id, initializer_id, initializer_bias_id, no_bias_id>, Parameters...>,
+        detail::is_valid_v<cpp::type_list<weight_type_id, activation_id, initializer_id, initializer_bias_id, no_bias_id, stride_id, padding_id, groups_id, dilation_id>, Parameters...>,
         "Invalid parameters type for rbm_desc");
 };
 
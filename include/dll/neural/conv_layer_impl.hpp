@@ -10,6 +10,11 @@
 #include "dll/neural_layer.hpp"
 
 #include "dll/util/timers.hpp" // for auto_timer
+#include "dll/util/winograd.hpp"
+#include "dll/util/quantize.hpp"
+#include "dll/util/conv_epilogue.hpp"
+#include "dll/util/conv_tuning.hpp"
+#include "dll/util/grouped_conv.hpp"
 
 namespace dll {
 
@@ -31,9 +36,16 @@ struct conv_layer_impl final : neural_layer<conv_layer_impl<Desc>, Desc> {
     static constexpr size_t NW2 = desc::NW2; ///< The second dimension of the filter
     static constexpr size_t NC  = desc::NC;  ///< The number of input channels
     static constexpr size_t K   = desc::K;   ///< The number of filters
+    static constexpr size_t S1  = desc::S1;  ///< The stride of the first dimension
+    static constexpr size_t S2  = desc::S2;  ///< The stride of the second dimension
+    static constexpr size_t P1  = desc::P1;  ///< The padding of the first dimension
+    static constexpr size_t P2  = desc::P2;  ///< The padding of the second dimension
+    static constexpr size_t G   = desc::G;   ///< The number of groups
+    static constexpr size_t D1  = desc::D1;  ///< The dilation of the first dimension
+    static constexpr size_t D2  = desc::D2;  ///< The dilation of the second dimension
 
-    static constexpr size_t NH1 = NV1 - NW1 + 1; //By definition
-    static constexpr size_t NH2 = NV2 - NW2 + 1; //By definition
+    static constexpr size_t NH1 = (NV1 - D1 * (NW1 - 1) - 1 + 2 * P1) / S1 + 1; //By definition
+    static constexpr size_t NH2 = (NV2 - D2 * (NW2 - 1) - 1 + 2 * P2) / S2 + 1; //By definition
 
     static constexpr auto activation_function = desc::activation_function; ///< The activation function
     static constexpr auto no_bias             = desc::parameters::template contains<dll::no_bias>(); ///< Disable the biases
@@ -46,7 +58,15 @@ struct conv_layer_impl final : neural_layer<conv_layer_impl<Desc>, Desc> {
     using input_t      = std::vector<input_one_t>; ///< The type of the input
     using output_t     = std::vector<output_one_t>; ///< The type of the output
 
-    using w_type = etl::fast_matrix<weight, K, NC, NW1, NW2>; ///< The type of the weights
+    static constexpr bool pointwise = NW1 == 1 && NW2 == 1 && S1 == 1 && S2 == 1 && P1 == 0 && P2 == 0; ///< Indicates if the convolution is a matrix multiplication
+
+    static constexpr bool dilated = (D1 > 1 && NW1 > 1) || (D2 > 1 && NW2 > 1); ///< Indicates if the filters are dilated
+
+    static constexpr bool winograd = G == 1 && !dilated && NW1 == 3 && NW2 == 3 && S1 == 1 && S2 == 1 && P1 <= 2 && P2 <= 2; ///< Indicates if the Winograd convolution is used
+
+    static constexpr bool pool_fusion = is_element_wise(activation_function); ///< The output can be directly pooled by a following pooling layer
+
+    using w_type = etl::fast_matrix<weight, K, NC / G, NW1, NW2>; ///< The type of the weights
     using b_type = etl::fast_matrix<weight, K>; ///< The type of the biases
 
     //Weights and biases
@@ -57,12 +77,22 @@ struct conv_layer_impl final : neural_layer<conv_layer_impl<Desc>, Desc> {
     std::unique_ptr<w_type> bak_w; ///< Backup Weights
     std::unique_ptr<b_type> bak_b; ///< Backup Hidden biases
 
+    //Transformed filters for the Winograd convolution
+    conditional_fast_matrix_t<winograd, weight, 16, K, NC> w_forward;  ///< Transformed filters for the forward pass
+    conditional_fast_matrix_t<winograd, weight, 16, NC, K> w_backward; ///< Transformed filters for the backward pass
+
+    int8_quantization<weight> q8; ///< The int8 filters for quantized inference
+
+    conv_tuning tuning; ///< The implementations of the convolutions
+
     /*!
      * \brief Initialize a conv layer with basic weights.
      */
     conv_layer_impl() : base_type() {
         w_initializer::initialize(w, input_size(), output_size());
         b_initializer::initialize(b, input_size(), output_size());
+
+        weights_changed();
     }
 
     // No copying or moving
@@ -98,6 +128,22 @@ struct conv_layer_impl final : neural_layer<conv_layer_impl<Desc>, Desc> {
         return K * NW1 * NW2;
     }
 
+    /*!
+     * \brief Returns the number of floating point operations of the
+     * forward pass of one sample
+     */
+    static constexpr size_t forward_flops() noexcept {
+        return 2 * K * (NC / G) * NW1 * NW2 * NH1 * NH2;
+    }
+
+    /*!
+     * \brief Returns the number of floating point operations of the
+     * backward pass (errors and gradients) of one sample
+     */
+    static constexpr size_t backward_flops() noexcept {
+        return 4 * K * (NC / G) * NW1 * NW2 * NH1 * NH2;
+    }
+
     /*!
      * \brief Returns a short description of the layer
      * \return an std::string containing a short description of the layer
@@ -105,11 +151,13 @@ struct conv_layer_impl final : neural_layer<conv_layer_impl<Desc>, Desc> {
     static std::string to_short_string(std::string pre = "") {
         cpp_unused(pre);
 
+        const char* name = G > 1 ? "Conv (grouped)" : (dilated ? "Conv (dilated)" : "Conv");
+
         if constexpr (activation_function == function::IDENTITY) {
-            return "Conv";
+            return name;
         } else {
             char buffer[512];
-            snprintf(buffer, 512, "Conv (%s)", to_string(activation_function).c_str());
+            snprintf(buffer, 512, "%s (%s)", name, to_string(activation_function).c_str());
             return {buffer};
         }
     }
@@ -142,7 +190,95 @@ struct conv_layer_impl final : neural_layer<conv_layer_impl<Desc>, Desc> {
         return {K, NH1, NH2};
     }
 
+    /*!
+     * \brief Returns the key of the shape of the layer in the tuning cache
+     */
+    static std::string tuning_key() {
+        char buffer[512];
+        snprintf(buffer, 512, "conv:%lux%lux%lu:%lux%lux%lu:s%lux%lu:p%lux%lu:g%lu:d%lux%lu", NC, NV1, NV2, K, NW1, NW2, S1, S2, P1, P2, G, D1, D2);
+        return {buffer};
+    }
+
+    /*!
+     * \brief Returns the available implementations of the forward pass and
+     * of the backpropagation of the errors
+     */
+    static std::vector<conv_impl> conv_impls() {
+        if constexpr (winograd) {
+            return {conv_impl::WINOGRAD, conv_impl::ETL};
+        } else {
+            return {conv_impl::ETL};
+        }
+    }
+
+    /*!
+     * \brief Returns the shape of the convolution, for the grouped kernels
+     */
+    static grouped_conv_shape shape() {
+        return {NC, NV1, NV2, K, NW1, NW2, S1, S2, P1, P2, G, D1, D2};
+    }
+
+    /*!
+     * \brief Refresh the cached transformed filters, must be called after
+     * the weights have been modified.
+     */
+    void weights_changed() {
+        if constexpr (winograd) {
+            winograd_conv<weight>::transform_filters(w, w_forward, false);
+            winograd_conv<weight>::transform_filters(w, w_backward, true);
+        }
+
+        q8.active = false;
+    }
+
+    /*!
+     * \brief Quantize the filters of the layer to int8, for inference.
+     *
+     * The quantized filters are dropped when the weights are modified. The
+     * grouped and dilated convolutions are not quantized.
+     *
+     * \param input_range The maximum absolute value of the input of the layer
+     */
+    void quantize(weight input_range) {
+        if constexpr (G == 1 && !dilated) {
+            q8.quantize(w, K, NC * NW1 * NW2, false, input_range);
+        } else {
+            cpp_unused(input_range);
+        }
+    }
+
     using base_type::forward_batch;
+    using base_type::test_forward_batch;
+
+    /*!
+     * \brief Compute the test presentation for a batch of inputs, with the
+     * int8 filters once the layer has been quantized.
+     *
+     * \param output The output batch to fill
+     * \param input The input batch to compute the representation from
+     */
+    template <typename H1, typename V>
+    void test_forward_batch(H1&& output, const V& v) const {
+        if constexpr (etl::all_dma<H1, V> && etl::dimensions<H1>() == 4) {
+            if (q8.active) {
+                dll::auto_timer timer("conv:forward_batch:int8");
+
+                static constexpr bool fused = is_element_wise(activation_function);
+
+                using epilogue_t = conv_epilogue_op<fused ? activation_function : function::IDENTITY, !no_bias, weight>;
+
+                q8.conv(v, output, NC, NV1, NV2, NW1, NW2, S1, S2, P1, P2, epilogue_t(b));
+
+                if constexpr (!fused) {
+                    output = f_activate<activation_function>(output);
+                }
+
+                return;
+            }
+        }
+
+        forward_batch(output, v);
+    }
 
     /*!
      * \brief Apply the layer to the given batch of input.
@@ -154,18 +290,59 @@ struct conv_layer_impl final : neural_layer<conv_layer_impl<Desc>, Desc> {
     void forward_batch(H1&& output, const V& v) const {
         dll::auto_timer timer("conv:forward_batch");
 
-        if constexpr (etl::dimensions<V>() == 4) {
-            output = etl::ml::convolution_forward(v, w);
+        // The biases and the activation are applied in a single pass
+        static constexpr bool fused = is_element_wise(activation_function) && etl::all_dma<H1> && etl::dimensions<H1>() == 4;
+
+        using epilogue_t = conv_epilogue_op<fused ? activation_function : function::IDENTITY, fused && !no_bias, weight>;
+
+        if constexpr (winograd && etl::all_dma<H1, V> && etl::dimensions<H1>() == 4) {
+            if (tuning.forward != conv_impl::ETL) {
+                // The epilogue is applied while the output blocks are written
+                if constexpr (etl::dimensions<V>() == 4) {
+                    winograd_conv<weight>::apply(v, w_forward, output, P1, P2, epilogue_t(b));
+                } else {
+                    winograd_conv<weight>::apply(etl::reshape(v, etl::dim<0>(v), NC, NV1, NV2), w_forward, output, P1, P2, epilogue_t(b));
+                }
+            } else {
+                etl_forward_batch<fused>(output, v);
+            }
         } else {
-            output = etl::ml::convolution_forward(etl::reshape(v, etl::dim<0>(v), NC, NV1, NV2), w);
+            etl_forward_batch<fused>(output, v);
         }
 
-        if constexpr (!no_bias) {
-            output = bias_add_4d(output, b);
+        if constexpr (!fused) {
+            if constexpr (!no_bias) {
+                output = bias_add_4d(output, b);
+            }
+
+            if constexpr (activation_function != function::IDENTITY) {
+                output = f_activate<activation_function>(output);
+            }
+        }
+    }
+
+    /*!
+     * \brief Apply the generic ETL convolution to the given batch of input.
+     *
+     * \tparam Fused Indicates if the biases and the activation are applied here
+     * \param output A batch of output that will be filled
+     * \param v A batch of input
+     */
+    template <bool Fused, typename H1, typename V>
+    void etl_forward_batch(H1&& output, const V& v) const {
+        if constexpr (G > 1 || dilated || (pointwise && etl::all_dma<H1, V>)) {
+            static_assert(etl::all_dma<H1, V>, "The grouped and dilated convolutions are only supported on direct memory");
+
+            // The pointwise convolutions are directly computed with GEMM
+            grouped_conv<weight>::forward(v, w, output, shape());
+        } else if constexpr (etl::dimensions<V>() == 4) {
+            output = etl::ml::convolution_forward<S1, S2, P1, P2>(v, w);
+        } else {
+            output = etl::ml::convolution_forward<S1, S2, P1, P2>(etl::reshape(v, etl::dim<0>(v), NC, NV1, NV2), w);
         }
 
-        if constexpr (activation_function != function::IDENTITY) {
-            output = f_activate<activation_function>(output);
+        if constexpr (Fused && (!no_bias || activation_function != function::IDENTITY)) {
+            conv_epilogue<activation_function, !no_bias>(output, b);
         }
     }
 
@@ -197,7 +374,7 @@ struct conv_layer_impl final : neural_layer<conv_layer_impl<Desc>, Desc> {
      */
     template<typename DRBM>
     static void dyn_init(DRBM& dyn){
-        dyn.init_layer(NC, NV1, NV2, K, NW1, NW2);
+        dyn.init_layer(NC, NV1, NV2, K, NW1, NW2, S1, S2, P1, P2, G, D1, D2);
     }
 
     /*!
@@ -225,10 +402,37 @@ struct conv_layer_impl final : neural_layer<conv_layer_impl<Desc>, Desc> {
     void backward_batch(H&& output, C& context) const {
         dll::auto_timer timer("conv:backward_batch");
 
+        if constexpr (G > 1 || dilated || (pointwise && etl::all_dma<H>)) {
+            grouped_conv<weight>::backward(context.errors, w, output, shape());
+        } else {
+            etl_backward_batch(output, context);
+        }
+    }
+
+    /*!
+     * \brief Backpropagate the errors with the dense (ungrouped) convolutions
+     * \param output The ETL expression into which write the output
+     * \param context The training context
+     */
+    template<typename H, typename C>
+    void etl_backward_batch(H&& output, C& context) const {
+        if constexpr (winograd && etl::all_dma<H>) {
+            if (tuning.backward != conv_impl::ETL) {
+                // The padding of the backward correlation is the complement of the forward padding
+                if constexpr (etl::dimensions<H>() == 4) {
+                    winograd_conv<weight>::apply(context.errors, w_backward, output, 2 - P1, 2 - P2);
+                } else {
+                    winograd_conv<weight>::apply(context.errors, w_backward, etl::reshape(output, etl::dim<0>(output), NC, NV1, NV2), 2 - P1, 2 - P2);
+                }
+
+                return;
+            }
+        }
+
         if constexpr (etl::dimensions<H>() == 4) {
-            output = etl::ml::convolution_backward(context.errors, w);
+            output = etl::ml::convolution_backward<S1, S2, P1, P2>(context.errors, w);
         } else {
-            etl::reshape(output, etl::dim<0>(output), NC, NV1, NV2) = etl::ml::convolution_backward(context.errors, w);
+            etl::reshape(output, etl::dim<0>(output), NC, NV1, NV2) = etl::ml::convolution_backward<S1, S2, P1, P2>(context.errors, w);
         }
     }
 
@@ -240,7 +444,11 @@ struct conv_layer_impl final : neural_layer<conv_layer_impl<Desc>, Desc> {
     void compute_gradients(C& context) const {
         dll::auto_timer timer("conv:compute_gradients");
 
-        std::get<0>(context.up.context)->grad = etl::ml::convolution_backward_filter(context.input, context.errors);
+        if constexpr (G > 1 || dilated || pointwise) {
+            grouped_conv<weight>::backward_filter(context.input, context.errors, std::get<0>(context.up.context)->grad, shape());
+        } else {
+            std::get<0>(context.up.context)->grad = etl::ml::convolution_backward_filter<S1, S2, P1, P2>(context.input, context.errors);
+        }
 
         if constexpr (!no_bias) {
             std::get<1>(context.up.context)->grad = etl::bias_batch_sum_4d(context.errors);
@@ -274,6 +482,27 @@ const size_t conv_layer_impl<Desc>::NW2;
 template <typename Desc>
 const size_t conv_layer_impl<Desc>::K;
 
+template <typename Desc>
+const size_t conv_layer_impl<Desc>::S1;
+
+template <typename Desc>
+const size_t conv_layer_impl<Desc>::S2;
+
+template <typename Desc>
+const size_t conv_layer_impl<Desc>::P1;
+
+template <typename Desc>
+const size_t conv_layer_impl<Desc>::P2;
+
+template <typename Desc>
+const size_t conv_layer_impl<Desc>::G;
+
+template <typename Desc>
+const size_t conv_layer_impl<Desc>::D1;
+
+template <typename Desc>
+const size_t conv_layer_impl<Desc>::D2;
+
 // Declare the traits for the Layer
 
 template<typename Desc>
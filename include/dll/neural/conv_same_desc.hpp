@@ -31,6 +31,9 @@ struct conv_same_desc {
 
     static constexpr auto activation_function = detail::get_value_v<activation<function::SIGMOID>, Parameters...>;            ///< The layer's activation function
 
+    static constexpr size_t D1 = detail::get_value_1<dilation<1, 1>, Parameters...>::value; ///< The dilation of the first dimension
+    static constexpr size_t D2 = detail::get_value_2<dilation<1, 1>, Parameters...>::value; ///< The dilation of the second dimension
+
     using w_initializer = detail::get_type_t<initializer<init_lecun>, Parameters...>;     ///< The initializer for the weights
     using b_initializer = detail::get_type_t<initializer_bias<init_zero>, Parameters...>; ///< The initializer for the biases
 
@@ -49,10 +52,11 @@ struct conv_same_desc {
     static_assert(NW2 > 0, "A matrix of at least 1x1 is necessary for the weights");
     static_assert(NC > 0, "At least one channel is necessary");
     static_assert(K > 0, "At least one group is necessary");
+    static_assert(D1 > 0 && D2 > 0, "The dilation must be at least 1");
 
     //Make sure only valid types are passed to the configuration list
     static_assert(
-        detail::is_valid_v<cpp::type_list<weight_type_id, activation_id, initializer_id, initializer_bias_id>, Parameters...>,
+        detail::is_valid_v<cpp::type_list<weight_type_id, activation_id, initializer_id, initializer_bias_id, dilation_id>, Parameters...>,
         "Invalid parameters type for conv_same_desc");
 };
 
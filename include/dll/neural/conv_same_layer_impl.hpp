@@ -10,6 +10,10 @@
 #include "dll/neural_layer.hpp"
 
 #include "dll/util/timers.hpp" // for auto_timer
+#include "dll/util/winograd.hpp"
+#include "dll/util/conv_epilogue.hpp"
+#include "dll/util/conv_tuning.hpp"
+#include "dll/util/grouped_conv.hpp"
 
 namespace dll {
 
@@ -31,12 +35,14 @@ struct conv_same_layer_impl final : neural_layer<conv_same_layer_impl<Desc>, Des
     static constexpr size_t NW2 = desc::NW2; ///< The second dimension of the filter
     static constexpr size_t NC  = desc::NC;  ///< The number of input channels
     static constexpr size_t K   = desc::K;   ///< The number of filters
+    static constexpr size_t D1  = desc::D1;  ///< The dilation of the first dimension
+    static constexpr size_t D2  = desc::D2;  ///< The dilation of the second dimension
 
     static constexpr size_t NH1 = NV1; //By definition
     static constexpr size_t NH2 = NV2; //By definition
 
-    static constexpr size_t P1 = (NW1 - 1) / 2;
-    static constexpr size_t P2 = (NW2 - 1) / 2;
+    static constexpr size_t P1 = D1 * (NW1 - 1) / 2;
+    static constexpr size_t P2 = D2 * (NW2 - 1) / 2;
 
     static constexpr auto activation_function = desc::activation_function; ///< The layer's activation function
 
@@ -51,6 +57,10 @@ struct conv_same_layer_impl final : neural_layer<conv_same_layer_impl<Desc>, Des
     using input_t      = std::vector<input_one_t>; ///< The type of the input
     using output_t     = std::vector<output_one_t>; ///< The type of the output
 
+    static constexpr bool dilated = (D1 > 1 && NW1 > 1) || (D2 > 1 && NW2 > 1); ///< Indicates if the filters are dilated
+
+    static constexpr bool winograd = !dilated && NW1 == 3 && NW2 == 3; ///< Indicates if the Winograd convolution is used
+
     using w_type = etl::fast_matrix<weight, K, NC, NW1, NW2>; ///< The type of the weights
     using b_type = etl::fast_matrix<weight, K>; ///< The type of the biases
 
@@ -62,12 +72,20 @@ struct conv_same_layer_impl final : neural_layer<conv_same_layer_impl<Desc>, Des
     std::unique_ptr<w_type> bak_w; ///< Backup Weights
     std::unique_ptr<b_type> bak_b; ///< Backup Hidden biases
 
+    //Transformed filters for the Winograd convolution
+    conditional_fast_matrix_t<winograd, weight, 16, K, NC> w_forward;  ///< Transformed filters for the forward pass
+    conditional_fast_matrix_t<winograd, weight, 16, NC, K> w_backward; ///< Transformed filters for the backward pass
+
+    conv_tuning tuning; ///< The implementations of the convolutions
+
     /*!
      * \brief Initialize a conv layer with basic weights.
      */
     conv_same_layer_impl() : base_type() {
         w_initializer::initialize(w, input_size(), output_size());
         b_initializer::initialize(b, input_size(), output_size());
+
+        weights_changed();
     }
 
     /*!
@@ -94,6 +112,22 @@ struct conv_same_layer_impl final : neural_layer<conv_same_layer_impl<Desc>, Des
         return K * NW1 * NW2;
     }
 
+    /*!
+     * \brief Returns the number of floating point operations of the
+     * forward pass of one sample
+     */
+    static constexpr size_t forward_flops() noexcept {
+        return 2 * K * NC * NW1 * NW2 * NH1 * NH2;
+    }
+
+    /*!
+     * \brief Returns the number of floating point operations of the
+     * backward pass (errors and gradients) of one sample
+     */
+    static constexpr size_t backward_flops() noexcept {
+        return 4 * K * NC * NW1 * NW2 * NH1 * NH2;
+    }
+
     /*!
      * \brief Returns a short description of the layer
      * \return an std::string containing a short description of the layer
@@ -128,6 +162,45 @@ struct conv_same_layer_impl final : neural_layer<conv_same_layer_impl<Desc>, Des
         return {K, NH1, NH2};
     }
 
+    /*!
+     * \brief Returns the key of the shape of the layer in the tuning cache
+     */
+    static std::string tuning_key() {
+        char buffer[512];
+        snprintf(buffer, 512, "conv_same:%lux%lux%lu:%lux%lux%lu:d%lux%lu", NC, NV1, NV2, K, NW1, NW2, D1, D2);
+        return {buffer};
+    }
+
+    /*!
+     * \brief Returns the shape of the convolution, for the dilated kernels
+     */
+    static grouped_conv_shape shape() {
+        return {NC, NV1, NV2, K, NW1, NW2, 1, 1, P1, P2, 1, D1, D2};
+    }
+
+    /*!
+     * \brief Returns the available implementations of the forward pass and
+     * of the backpropagation of the errors
+     */
+    static std::vector<conv_impl> conv_impls() {
+        if constexpr (winograd) {
+            return {conv_impl::WINOGRAD, conv_impl::ETL};
+        } else {
+            return {conv_impl::ETL};
+        }
+    }
+
+    /*!
+     * \brief Refresh the cached transformed filters, must be called after
+     * the weights have been modified.
+     */
+    void weights_changed() {
+        if constexpr (winograd) {
+            winograd_conv<weight>::transform_filters(w, w_forward, false);
+            winograd_conv<weight>::transform_filters(w, w_backward, true);
+        }
+    }
+
     /*!
      * \brief Apply the layer to the given batch of input.
      *
@@ -138,14 +211,54 @@ struct conv_same_layer_impl final : neural_layer<conv_same_layer_impl<Desc>, Des
     void forward_batch(H1&& output, const V& v) const {
         dll::auto_timer timer("conv:forward_batch");
 
-        if constexpr (etl::dimensions<V>() == 4) {
+        // The biases and the activation are applied in a single pass
+        static constexpr bool fused = is_element_wise(activation_function) && etl::all_dma<H1> && etl::dimensions<H1>() == 4;
+
+        using epilogue_t = conv_epilogue_op<fused ? activation_function : function::IDENTITY, fused, weight>;
+
+        if constexpr (winograd && etl::all_dma<H1, V> && etl::dimensions<H1>() == 4) {
+            if (tuning.forward != conv_impl::ETL) {
+                // The epilogue is applied while the output blocks are written
+                if constexpr (etl::dimensions<V>() == 4) {
+                    winograd_conv<weight>::apply(v, w_forward, output, P1, P2, epilogue_t(b));
+                } else {
+                    winograd_conv<weight>::apply(etl::reshape(v, etl::dim<0>(v), NC, NV1, NV2), w_forward, output, P1, P2, epilogue_t(b));
+                }
+            } else {
+                etl_forward_batch<fused>(output, v);
+            }
+        } else {
+            etl_forward_batch<fused>(output, v);
+        }
+
+        if constexpr (!fused) {
+            output = bias_add_4d(output, b);
+            output = f_activate<activation_function>(output);
+        }
+    }
+
+    /*!
+     * \brief Apply the generic ETL convolution to the given batch of input.
+     *
+     * \tparam Fused Indicates if the biases and the activation are applied here
+     * \param output A batch of output that will be filled
+     * \param v A batch of input
+     */
+    template <bool Fused, typename H1, typename V>
+    void etl_forward_batch(H1&& output, const V& v) const {
+        if constexpr (dilated) {
+            static_assert(etl::all_dma<H1, V>, "The dilated convolution is only supported on direct memory");
+
+            grouped_conv<weight>::forward(v, w, output, shape());
+        } else if constexpr (etl::dimensions<V>() == 4) {
             output = etl::ml::convolution_forward<1, 1, P1, P2>(v, w);
         } else {
             output = etl::ml::convolution_forward<1, 1, P1, P2>(etl::reshape(v, etl::dim<0>(v), NC, NV1, NV2), w);
         }
 
-        output = bias_add_4d(output, b);
-        output = f_activate<activation_function>(output);
+        if constexpr (Fused) {
+            conv_epilogue<activation_function, true>(output, b);
+        }
     }
 
     template <typename Input>
@@ -172,7 +285,7 @@ struct conv_same_layer_impl final : neural_layer<conv_same_layer_impl<Desc>, Des
      */
     template<typename DRBM>
     static void dyn_init(DRBM& dyn){
-        dyn.init_layer(NC, NV1, NV2, K, NW1, NW2);
+        dyn.init_layer(NC, NV1, NV2, K, NW1, NW2, D1, D2);
     }
 
     /*!
@@ -200,7 +313,18 @@ struct conv_same_layer_impl final : neural_layer<conv_same_layer_impl<Desc>, Des
     void backward_batch(H&& output, C& context) const {
         dll::auto_timer timer("conv_same:backward_batch");
 
-        output = etl::ml::convolution_backward<1, 1, P1, P2>(context.errors, w);
+        if constexpr (winograd && etl::all_dma<H> && etl::dimensions<H>() == 4) {
+            if (tuning.backward != conv_impl::ETL) {
+                winograd_conv<weight>::apply(context.errors, w_backward, output, NW1 - 1 - P1, NW2 - 1 - P2);
+                return;
+            }
+        }
+
+        if constexpr (dilated) {
+            grouped_conv<weight>::backward(context.errors, w, output, shape());
+        } else {
+            output = etl::ml::convolution_backward<1, 1, P1, P2>(context.errors, w);
+        }
     }
 
     /*!
@@ -211,7 +335,12 @@ struct conv_same_layer_impl final : neural_layer<conv_same_layer_impl<Desc>, Des
     void compute_gradients(C& context) const {
         dll::auto_timer timer("conv_same:compute_gradients");
 
-        std::get<0>(context.up.context)->grad = etl::ml::convolution_backward_filter<1, 1, P1, P2>(context.input, context.errors);
+        if constexpr (dilated) {
+            grouped_conv<weight>::backward_filter(context.input, context.errors, std::get<0>(context.up.context)->grad, shape());
+        } else {
+            std::get<0>(context.up.context)->grad = etl::ml::convolution_backward_filter<1, 1, P1, P2>(context.input, context.errors);
+        }
+
         std::get<1>(context.up.context)->grad = etl::bias_batch_sum_4d(context.errors);
     }
 };
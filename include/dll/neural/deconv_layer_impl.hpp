@@ -9,6 +9,9 @@
 
 #include "dll/neural_layer.hpp"
 
+#include "dll/util/deconv_gemm.hpp"
+#include "dll/util/conv_tuning.hpp"
+
 namespace dll {
 
 /*!
@@ -54,12 +57,26 @@ struct deconv_layer_impl final : neural_layer<deconv_layer_impl<Desc>, Desc> {
     std::unique_ptr<w_type> bak_w; ///< Backup Weights
     std::unique_ptr<b_type> bak_b; ///< Backup Hidden biases
 
+    etl::fast_matrix<weight, K * NW1 * NW2, NC> w_t; ///< The transposed weights (forward pass)
+
+    conv_tuning tuning; ///< The implementations of the convolutions
+
     /*!
      * \brief Initialize a conv layer with basic weights.
      */
     deconv_layer_impl() : base_type() {
         w_initializer::initialize(w, input_size(), output_size());
         b_initializer::initialize(b, input_size(), output_size());
+
+        weights_changed();
+    }
+
+    /*!
+     * \brief Refresh the cached transposed weights, must be called after
+     * the weights have been modified.
+     */
+    void weights_changed() {
+        deconv_gemm<weight>::transpose_filters(w, w_t);
     }
 
     /*!
@@ -86,6 +103,22 @@ struct deconv_layer_impl final : neural_layer<deconv_layer_impl<Desc>, Desc> {
         return K * NW1 * NW2;
     }
 
+    /*!
+     * \brief Returns the number of floating point operations of the
+     * forward pass of one sample
+     */
+    static constexpr size_t forward_flops() noexcept {
+        return 2 * K * NC * NW1 * NW2 * NV1 * NV2;
+    }
+
+    /*!
+     * \brief Returns the number of floating point operations of the
+     * backward pass (errors and gradients) of one sample
+     */
+    static constexpr size_t backward_flops() noexcept {
+        return 4 * K * NC * NW1 * NW2 * NV1 * NV2;
+    }
+
     /*!
      * \brief Returns a short description of the layer
      * \return an std::string containing a short description of the layer
@@ -120,6 +153,23 @@ struct deconv_layer_impl final : neural_layer<deconv_layer_impl<Desc>, Desc> {
         return {K, NH1, NH2};
     }
 
+    /*!
+     * \brief Returns the key of the shape of the layer in the tuning cache
+     */
+    static std::string tuning_key() {
+        char buffer[512];
+        snprintf(buffer, 512, "deconv:%lux%lux%lu:%lux%lux%lu", NC, NV1, NV2, K, NW1, NW2);
+        return {buffer};
+    }
+
+    /*!
+     * \brief Returns the available implementations of the forward pass and
+     * of the backpropagation of the errors
+     */
+    static std::vector<conv_impl> conv_impls() {
+        return {conv_impl::GEMM, conv_impl::ETL};
+    }
+
     /*!
      * \brief Apply the layer to the given batch of input.
      *
@@ -128,21 +178,23 @@ struct deconv_layer_impl final : neural_layer<deconv_layer_impl<Desc>, Desc> {
      */
     template <typename H1, typename V>
     void forward_batch(H1&& output, const V& v) const {
-        output = etl::conv_4d_full_flipped(v, w);
-
-        if constexpr (etl::decay_traits<H1>::is_fast) {
-            static constexpr auto batch_size = etl::decay_traits<H1>::template dim<0>();
-
-            auto b_rep = etl::force_temporary(etl::rep_l<batch_size>(etl::rep<NH1, NH2>(b)));
-
-            output = f_activate<activation_function>(b_rep + output);
-        } else {
-            auto batch_size = etl::dim<0>(output);
-
-            auto b_rep = etl::force_temporary(etl::rep_l(etl::rep<NH1, NH2>(b), batch_size));
-
-            output = f_activate<activation_function>(b_rep + output);
+        if constexpr (etl::all_dma<H1, V> && etl::dimensions<H1>() == 4 && etl::dimensions<V>() == 4) {
+            if (tuning.forward != conv_impl::ETL) {
+                // The biases and the activation are applied once each output channel is complete
+                if constexpr (is_element_wise(activation_function)) {
+                    deconv_gemm<weight>::forward(v, w_t, output, conv_epilogue_op<activation_function, true, weight>(b));
+                } else {
+                    deconv_gemm<weight>::forward(v, w_t, output);
+
+                    output = f_activate<activation_function>(bias_add_4d(output, b));
+                }
+
+                return;
+            }
         }
+
+        output = etl::conv_4d_full_flipped(v, w);
+        output = f_activate<activation_function>(bias_add_4d(output, b));
     }
 
     /*!
@@ -199,11 +251,17 @@ struct deconv_layer_impl final : neural_layer<deconv_layer_impl<Desc>, Desc> {
      */
     template<typename H, typename C>
     void backward_batch(H&& output, C& context) const {
+        if constexpr (etl::all_dma<H>) {
+            if (tuning.backward != conv_impl::ETL) {
+                deconv_gemm<weight>::backward(context.errors, w, output);
+                return;
+            }
+        }
+
         if constexpr (etl::decay_traits<H>::dimensions() == 4) {
             output = etl::conv_4d_valid_flipped(context.errors, w);
         } else {
-            static constexpr auto B               = etl::decay_traits<H>::template dim<0>();
-            etl::reshape<B, NC, NV1, NV2>(output) = etl::conv_4d_valid_flipped(context.errors, w);
+            etl::reshape(output, etl::dim<0>(output), NC, NV1, NV2) = etl::conv_4d_valid_flipped(context.errors, w);
         }
     }
 
@@ -11,6 +11,12 @@
 #include "dll/neural_layer.hpp"
 
 #include "dll/util/timers.hpp" // for auto_timer
+#include "dll/util/conv_epilogue.hpp"
+#include "dll/util/quantize.hpp"
+#include "dll/util/sparse_weights.hpp"
+#include "dll/util/sparse_batch.hpp"
+#include "dll/util/dense_backward.hpp"
+#include "dll/trainer/chained_input.hpp"
 
 namespace dll {
 
@@ -31,6 +37,7 @@ struct dense_layer_impl final : neural_layer<dense_layer_impl<Desc>, Desc> {
 
     static constexpr auto activation_function = desc::activation_function;                           ///< The layer's activation function
     static constexpr auto no_bias             = desc::parameters::template contains<dll::no_bias>(); ///< Disable the biases
+    static constexpr auto sparse_input        = desc::parameters::template contains<dll::sparse_input>(); ///< Indicates if the inputs are very sparse
 
     using w_initializer = typename desc::w_initializer; ///< The initializer for the weights
     using b_initializer = typename desc::b_initializer; ///< The initializer for the biases
@@ -51,6 +58,9 @@ struct dense_layer_impl final : neural_layer<dense_layer_impl<Desc>, Desc> {
     std::unique_ptr<w_type> bak_w; ///< Backup Weights
     std::unique_ptr<b_type> bak_b; ///< Backup Hidden biases
 
+    int8_quantization<weight> q8; ///< The int8 weights for quantized inference
+    sparse_weights<weight> sparse; ///< The sparse weights for inference with pruned weights
+
     /*!
      * \brief Initialize a dense layer with basic weights.
      *
@@ -84,6 +94,22 @@ struct dense_layer_impl final : neural_layer<dense_layer_impl<Desc>, Desc> {
         return num_visible * num_hidden + num_hidden;
     }
 
+    /*!
+     * \brief Returns the number of floating point operations of the
+     * forward pass of one sample
+     */
+    static constexpr size_t forward_flops() noexcept {
+        return 2 * num_visible * num_hidden;
+    }
+
+    /*!
+     * \brief Returns the number of floating point operations of the
+     * backward pass (errors and gradients) of one sample
+     */
+    static constexpr size_t backward_flops() noexcept {
+        return 4 * num_visible * num_hidden;
+    }
+
     /*!
      * \brief Returns a short description of the layer
      * \return an std::string containing a short description of the layer
@@ -138,6 +164,23 @@ struct dense_layer_impl final : neural_layer<dense_layer_impl<Desc>, Desc> {
     void forward_batch(H&& output, const V& input) const {
         dll::auto_timer timer("dense:forward_batch");
 
+        forward_logits_batch(output, input);
+
+        output = f_activate<activation_function>(output);
+    }
+
+    /*!
+     * \brief Apply the layer to the given batch of input, without the
+     * activation function.
+     *
+     * The SGD trainer uses it to fuse the softmax of the last layer with
+     * the categorical cross-entropy.
+     *
+     * \param input A batch of input
+     * \param output A batch of output that will be filled
+     */
+    template <typename H, typename V>
+    void forward_logits_batch(H&& output, const V& input) const {
         const auto Batch = etl::dim<0>(input);
 
         // Note: The compile-time Batch information is lost here, but it does
@@ -145,13 +188,111 @@ struct dense_layer_impl final : neural_layer<dense_layer_impl<Desc>, Desc> {
 
         cpp_assert(etl::dim<0>(output) == Batch, "The number of samples must be consistent");
 
+        if constexpr (sparse_input && etl::all_dma<H, V>) {
+            sparse_batch<weight> sparse;
+
+            sparse.update(input);
+
+            if (sparse.active) {
+                sparse.multiply(w, output);
+
+                if constexpr (!no_bias) {
+                    output = bias_add_2d(output, b);
+                }
+
+                return;
+            }
+        }
+
         output = etl::reshape(input, Batch, num_visible) * w;
 
         if constexpr (!no_bias) {
             output = bias_add_2d(output, b);
         }
+    }
 
-        output = f_activate<activation_function>(output);
+    using base_type::test_forward_batch;
+
+    /*!
+     * \brief Compute the test presentation for a batch of inputs, with the
+     * int8 weights once the layer has been quantized.
+     *
+     * \param output The output batch to fill
+     * \param input The input batch to compute the representation from
+     */
+    template <typename H, typename V>
+    void test_forward_batch(H&& output, const V& input) const {
+        if constexpr (etl::all_dma<H, V>) {
+            if (q8.active) {
+                dll::auto_timer timer("dense:forward_batch:int8");
+
+                static constexpr bool fused = is_element_wise(activation_function);
+
+                using epilogue_t = conv_epilogue_op<fused ? activation_function : function::IDENTITY, !no_bias, weight>;
+
+                q8.dense(input, output, epilogue_t(b));
+
+                if constexpr (!fused) {
+                    output = f_activate<activation_function>(output);
+                }
+
+                return;
+            }
+
+            if (sparse.active) {
+                dll::auto_timer timer("dense:forward_batch:sparse");
+
+                static constexpr bool fused = is_element_wise(activation_function);
+
+                using epilogue_t = conv_epilogue_op<fused ? activation_function : function::IDENTITY, !no_bias, weight>;
+
+                sparse.forward(input, output, epilogue_t(b));
+
+                if constexpr (!fused) {
+                    output = f_activate<activation_function>(output);
+                }
+
+                return;
+            }
+        }
+
+        forward_batch(output, input);
+    }
+
+    /*!
+     * \brief Prune the weights of the layer to the given sparsity, setting
+     * the weights of smallest magnitude to zero.
+     *
+     * The sparse weights are used for inference once the density of the
+     * weights is low enough.
+     *
+     * \param sparsity The fraction of the weights to set to zero
+     */
+    void prune(double sparsity) {
+        magnitude_prune(w, sparsity);
+
+        weights_changed();
+    }
+
+    /*!
+     * \brief Quantize the weights of the layer to int8, for inference.
+     *
+     * The quantized weights are dropped when the weights are modified.
+     *
+     * \param input_range The maximum absolute value of the input of the layer
+     */
+    void quantize(weight input_range) {
+        q8.quantize(w, num_hidden, num_visible, true, input_range);
+    }
+
+    /*!
+     * \brief Indicates that the weights have been modified, the quantized
+     * weights are not valid anymore and the sparse weights are rebuilt.
+     */
+    void weights_changed() {
+        q8.active = false;
+
+        sparse.update(w);
     }
 
     /*!
@@ -205,6 +346,11 @@ struct dense_layer_impl final : neural_layer<dense_layer_impl<Desc>, Desc> {
 
     /*!
      * \brief Backpropagate the errors to the previous layers
+     *
+     * The gradients of the weights and of the biases are computed in the
+     * same sweep over the errors and are then already available for
+     * compute_gradients.
+     *
      * \param output The ETL expression into which write the output
      * \param context The training context
      */
@@ -212,23 +358,82 @@ struct dense_layer_impl final : neural_layer<dense_layer_impl<Desc>, Desc> {
     void backward_batch(H&& output, C& context) const {
         dll::unsafe_auto_timer timer("dense:backward_batch");
 
-        // The reshape has no overhead, so better than SFINAE for nothing
-        constexpr auto Batch = etl::decay_traits<decltype(context.errors)>::template dim<0>();
-        etl::reshape<Batch, num_visible>(output) = context.errors * etl::transpose(w);
+        cpp_assert(etl::size(output) == etl::dim<0>(context.errors) * num_visible, "Invalid size for the errors of the inputs");
+
+        fused_backward(output.memory_start(), context);
+
+        output.invalidate_gpu();
+
+        context.gradients_ready = true;
     }
 
     /*!
      * \brief Compute the gradients for this layer, if any
+     *
+     * The errors of the inputs are not computed here, they are never used
+     * for the first layer.
+     *
      * \param context The trainng context
      */
     template<typename C>
     void compute_gradients(C& context) const {
         dll::unsafe_auto_timer timer("dense:compute_gradients");
 
-        std::get<0>(context.up.context)->grad = batch_outer(context.input, context.errors);
+        // Already computed during the backward pass
+        if (context.gradients_ready) {
+            context.gradients_ready = false;
+            return;
+        }
+
+        if constexpr (sparse_input) {
+            sparse_batch<weight> sparse;
+
+            sparse.update(context.input);
+
+            if (sparse.active) {
+                sparse.outer(context.errors, std::get<0>(context.up.context)->grad);
+
+                if constexpr (!no_bias) {
+                    std::get<1>(context.up.context)->grad = bias_batch_sum_2d(context.errors);
+                }
+
+                return;
+            }
+        }
+
+        fused_backward(nullptr, context);
+    }
+
+private:
+    /*!
+     * \brief Compute the gradients of the weights and the biases, and the
+     * errors of the inputs if output is not null, in one sweep over the
+     * errors.
+     *
+     * \param output The errors of the inputs, or nullptr
+     * \param context The trainng context
+     */
+    template<typename C>
+    void fused_backward(weight* output, C& context) const {
+        auto& w_grad = std::get<0>(context.up.context)->grad;
+
+        context.input.ensure_cpu_up_to_date();
+        context.errors.ensure_cpu_up_to_date();
+        w.ensure_cpu_up_to_date();
+
+        weight* b_grad = nullptr;
+
+        if constexpr (!no_bias) {
+            b_grad = std::get<1>(context.up.context)->grad.memory_start();
+        }
+
+        dense_backward<weight>::backward(context.input.memory_start(), context.errors.memory_start(), w.memory_start(),
+                                         output, w_grad.memory_start(), b_grad, etl::dim<0>(context.errors), num_visible, num_hidden);
+
+        w_grad.invalidate_gpu();
 
         if constexpr (!no_bias) {
-            std::get<1>(context.up.context)->grad = bias_batch_sum_2d(context.errors);
+            std::get<1>(context.up.context)->grad.invalidate_gpu();
         }
     }
 };
@@ -274,12 +479,36 @@ struct sgd_context<DBN, dense_layer_impl<Desc>, L> {
 
     static constexpr auto batch_size = DBN::batch_size;
 
-    etl::fast_matrix<weight, batch_size, num_visible> input;
+    /*!
+     * \brief The type of the input, a view of the output of the previous
+     * layer after the first layer
+     */
+    using owned_input_type = etl::fast_matrix<weight, batch_size, num_visible>;
+    using input_type       = std::conditional_t<(L > 0), etl::custom_dyn_matrix<weight, 2>, owned_input_type>;
+
+    chained_input<weight, 2> input_storage; ///< The memory of the input (only used after the first layer)
+
+    input_type input;
     etl::fast_matrix<weight, batch_size, num_hidden> output;
     etl::fast_matrix<weight, batch_size, num_hidden> errors;
 
+    bool gradients_ready = false; ///< Indicates if the gradients have been computed by the backward pass
+
     sgd_context(const dense_layer_impl<Desc>& /* layer */)
-            : output(0.0), errors(0.0) {}
+            : input(make_input(input_storage)), output(0.0), errors(0.0) {}
+
+private:
+    /*!
+     * \brief Create the input of the context
+     */
+    static input_type make_input(chained_input<weight, 2>& storage) {
+        if constexpr (L > 0) {
+            return storage.view(batch_size, num_visible);
+        } else {
+            cpp_unused(storage);
+            return input_type();
+        }
+    }
 };
 
 } //end of dll namespace
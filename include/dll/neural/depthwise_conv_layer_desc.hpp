@@ -0,0 +1,38 @@
+//=======================================================================
+// Copyright (c) 2014-2017 Baptiste Wicht
+// Distributed under the terms of the MIT License.
+// (See accompanying file LICENSE or copy at
+//  http://opensource.org/licenses/MIT)
+//=======================================================================
+
+#pragma once
+
+#include "dll/neural/conv_layer_desc.hpp"
+
+namespace dll {
+
+/*!
+ * \brief Describe a depthwise convolutional layer.
+ *
+ * Each input channel is convolved with its own filter. This is a
+ * convolutional layer with as many filters and groups as input channels.
+ */
+template <size_t NC_T, size_t NV_1, size_t NV_2, size_t NW_1, size_t NW_2, typename... Parameters>
+struct depthwise_conv_layer_desc {
+    /*! The descriptor of the equivalent grouped convolutional layer */
+    using conv_desc = conv_layer_desc<NC_T, NV_1, NV_2, NC_T, NW_1, NW_2, groups<NC_T>, Parameters...>;
+
+    /*! The conv type */
+    using layer_t = typename conv_desc::layer_t;
+
+    /*! The conv type */
+    using dyn_layer_t = typename conv_desc::dyn_layer_t;
+};
+
+/*!
+ * \brief Describe a depthwise convolutional layer.
+ */
+template <size_t NC_T, size_t NV_1, size_t NV_2, size_t NW_1, size_t NW_2, typename... Parameters>
+using depthwise_conv_layer = typename depthwise_conv_layer_desc<NC_T, NV_1, NV_2, NW_1, NW_2, Parameters...>::layer_t;
+
+} //end of dll namespace
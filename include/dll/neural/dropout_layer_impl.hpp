@@ -8,6 +8,7 @@
 #pragma once
 
 #include "dll/transform/transform_layer.hpp"
+#include "dll/util/dropout_mask.hpp"
 
 namespace dll {
 
@@ -24,9 +25,9 @@ struct dropout_layer_impl : transform_layer<dropout_layer_impl<Desc>> {
 
     static constexpr float p = float(desc::Drop) / 100.0f; ///< The dropout rate
 
-    mutable decltype(etl::state_inverted_dropout_mask(dll::rand_engine(), p)) dropout; ///< The dropout mask generator (ETL)
+    mutable dropout_mask mask; ///< The dropout mask of the current batch
 
-    dropout_layer_impl() : dropout(dll::rand_engine(), p) {
+    dropout_layer_impl() : mask(p) {
         // Nothing else to init
     }
 
@@ -96,9 +97,8 @@ struct dropout_layer_impl : transform_layer<dropout_layer_impl<Desc>> {
     void train_forward_batch(Output& output, const Input& input) const noexcept {
         dll::auto_timer timer("dropout:train:forward");
 
-        // Note: For now, cannot do on one pass because of state_inverted dropout not copy-able
-        output = dropout;
-        output = output >> input;
+        mask.next();
+        mask.apply(output, input);
     }
 
     /*!
@@ -122,7 +122,8 @@ struct dropout_layer_impl : transform_layer<dropout_layer_impl<Desc>> {
     void backward_batch(H&& output, C& context) const {
         dll::unsafe_auto_timer timer("dropout:backward");
 
-        output = context.errors;
+        // The mask of the forward pass is generated again
+        mask.apply(output, context.errors);
     }
 
     /*!
@@ -163,7 +164,7 @@ struct sgd_context<DBN, dropout_layer_impl<Desc>, L> {
     using layer_t          = dropout_layer_impl<Desc>;                            ///< The current layer type
     using previous_layer   = typename DBN::template layer_type<L - 1>;          ///< The previous layer type
     using previous_context = sgd_context<DBN, previous_layer, L - 1>;           ///< The previous layer's context
-    using inputs_t         = decltype(std::declval<previous_context>().output); ///< The type of inputs
+    using inputs_t         = std::decay_t<decltype(std::declval<previous_context>().output)>; ///< The type of inputs
 
     inputs_t input;  ///< A batch of input
     inputs_t output; ///< A batch of output
@@ -8,6 +8,7 @@
 #pragma once
 
 #include "dll/neural_layer.hpp"
+#include "dll/util/scratch_arena.hpp"
 
 namespace dll {
 
@@ -98,6 +99,22 @@ struct dyn_batch_normalization_2d_layer_impl : neural_layer<dyn_batch_normalizat
         return 4 * Input;
     }
 
+    /*!
+     * \brief Returns the number of floating point operations of the
+     * forward pass of one sample
+     */
+    size_t forward_flops() const noexcept {
+        return 4 * input_size();
+    }
+
+    /*!
+     * \brief Returns the number of floating point operations of the
+     * backward pass (errors and gradients) of one sample
+     */
+    size_t backward_flops() const noexcept {
+        return 8 * input_size();
+    }
+
     /*!
      * \brief Return the size of the input of this layer
      * \return The size of the input of this layer
@@ -138,7 +155,9 @@ struct dyn_batch_normalization_2d_layer_impl : neural_layer<dyn_batch_normalizat
 
         const auto B = etl::dim<0>(input);
 
-        auto inv_var = etl::force_temporary(1.0 / etl::sqrt(var + e));
+        temporary_scope<weight> scope;
+
+        auto inv_var = scope.value(1.0 / etl::sqrt(var + e));
 
         for(size_t b = 0; b < B; ++b){
             output(b) = (gamma >> ((input(b) - mean) >> inv_var)) + beta;
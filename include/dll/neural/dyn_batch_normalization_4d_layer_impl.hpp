@@ -8,6 +8,10 @@
 #pragma once
 
 #include "dll/neural_layer.hpp"
+#include "dll/util/scratch_arena.hpp"
+#include "dll/util/batch_norm.hpp"
+#include "dll/util/static_desc.hpp"
+#include "dll/util/filter_pruning.hpp"
 
 namespace dll {
 
@@ -40,8 +44,6 @@ struct dyn_batch_normalization_4d_layer_impl : neural_layer<dyn_batch_normalizat
     etl::dyn_matrix<weight, 1> last_var;
     etl::dyn_matrix<weight, 1> inv_var;
 
-    etl::dyn_matrix<weight, 4> input_pre; /// B x K x W x H
-
     weight momentum = 0.9;
 
     //Backup gamma and beta
@@ -94,6 +96,44 @@ struct dyn_batch_normalization_4d_layer_impl : neural_layer<dyn_batch_normalizat
         return "batch_norm";
     }
 
+    /*!
+     * \brief Returns the descriptor of the equivalent static layer
+     */
+    std::string static_desc() const {
+        return "dll::batch_normalization_4d_layer_desc<" + std::to_string(Kernels) + ", " + std::to_string(W) + ", " + std::to_string(H)
+               + detail::static_weight_param<weight>() + ">::layer_t";
+    }
+
+    /*!
+     * \brief Indicates if the input channels of the layer can be pruned
+     */
+    bool can_keep_channels() const noexcept {
+        return true;
+    }
+
+    /*!
+     * \brief Only keep the given channels of the layer
+     * \param kept The indices of the kept channels, in increasing order
+     * \param channels The number of channels before the pruning
+     */
+    void keep_channels(const std::vector<size_t>& kept, size_t channels) {
+        cpp_assert(channels == Kernels, "Invalid pruning of the channels");
+        cpp_unused(channels);
+
+        gamma     = kept_blocks(gamma, kept, Kernels, 1, kept.size());
+        beta      = kept_blocks(beta, kept, Kernels, 1, kept.size());
+        mean      = kept_blocks(mean, kept, Kernels, 1, kept.size());
+        var       = kept_blocks(var, kept, Kernels, 1, kept.size());
+        last_mean = kept_blocks(last_mean, kept, Kernels, 1, kept.size());
+        last_var  = kept_blocks(last_var, kept, Kernels, 1, kept.size());
+        inv_var   = kept_blocks(inv_var, kept, Kernels, 1, kept.size());
+
+        Kernels = kept.size();
+
+        bak_gamma.reset();
+        bak_beta.reset();
+    }
+
     /*!
      * \brief Return the number of trainable parameters of this network.
      * \return The the number of trainable parameters of this network.
@@ -102,6 +142,22 @@ struct dyn_batch_normalization_4d_layer_impl : neural_layer<dyn_batch_normalizat
         return 4 * Kernels;
     }
 
+    /*!
+     * \brief Returns the number of floating point operations of the
+     * forward pass of one sample
+     */
+    size_t forward_flops() const noexcept {
+        return 4 * input_size();
+    }
+
+    /*!
+     * \brief Returns the number of floating point operations of the
+     * backward pass (errors and gradients) of one sample
+     */
+    size_t backward_flops() const noexcept {
+        return 8 * input_size();
+    }
+
     /*!
      * \brief Return the size of the input of this layer
      * \return The size of the input of this layer
@@ -140,7 +196,9 @@ struct dyn_batch_normalization_4d_layer_impl : neural_layer<dyn_batch_normalizat
     void test_forward_batch(Output& output, const Input& input) const {
         const auto B = etl::dim<0>(input);
 
-        auto inv_var = etl::force_temporary(1.0 / etl::sqrt(var + e));
+        temporary_scope<weight> scope;
+
+        auto inv_var = scope.value(1.0 / etl::sqrt(var + e));
 
         for (size_t b = 0; b < B; ++b) {
             for (size_t k = 0; k < Kernels; ++k) {
@@ -161,28 +219,41 @@ struct dyn_batch_normalization_4d_layer_impl : neural_layer<dyn_batch_normalizat
         const auto B = etl::dim<0>(input);
         const auto S = B * W * H;
 
-        // Compute the mean of the mini-batch
-        last_mean = etl::bias_batch_mean_4d(input);
-
-        // Compute the variance of the mini-batch
-        last_var  = 0;
-
-        for (size_t b = 0; b < B; ++b) {
-            for (size_t k = 0; k < Kernels; ++k) {
-                last_var(k) += etl::sum((input(b)(k) - last_mean(k)) >> (input(b)(k) - last_mean(k)));
+        if constexpr (etl::all_dma<Output, Input>) {
+            // One pass for the statistics and one for the output
+            input.ensure_cpu_up_to_date();
+            gamma.ensure_cpu_up_to_date();
+            beta.ensure_cpu_up_to_date();
+
+            batch_norm_4d_forward(input.memory_start(), output.memory_start(), B, Kernels, W * H,
+                                  gamma.memory_start(), beta.memory_start(), e,
+                                  last_mean.memory_start(), last_var.memory_start(), inv_var.memory_start());
+
+            output.invalidate_gpu();
+            last_mean.invalidate_gpu();
+            last_var.invalidate_gpu();
+            inv_var.invalidate_gpu();
+        } else {
+            // Compute the mean of the mini-batch
+            last_mean = etl::bias_batch_mean_4d(input);
+
+            // Compute the variance of the mini-batch
+            last_var = 0;
+
+            for (size_t b = 0; b < B; ++b) {
+                for (size_t k = 0; k < Kernels; ++k) {
+                    last_var(k) += etl::sum((input(b)(k) - last_mean(k)) >> (input(b)(k) - last_mean(k)));
+                }
             }
-        }
-
-        last_var /= S;
 
-        inv_var  = 1.0 / etl::sqrt(last_var + e);
+            last_var /= S;
 
-        input_pre.inherit_if_null(input);
+            inv_var = 1.0 / etl::sqrt(last_var + e);
 
-        for(size_t b = 0; b < B; ++b){
-            for (size_t k = 0; k < Kernels; ++k) {
-                input_pre(b)(k) = (input(b)(k) - last_mean(k)) >> inv_var(k);
-                output(b)(k)    = (gamma(k) >> input_pre(b)(k)) + beta(k);
+            for (size_t b = 0; b < B; ++b) {
+                for (size_t k = 0; k < Kernels; ++k) {
+                    output(b)(k) = (gamma(k) >> ((input(b)(k) - last_mean(k)) >> inv_var(k))) + beta(k);
+                }
             }
         }
 
@@ -213,23 +284,39 @@ struct dyn_batch_normalization_4d_layer_impl : neural_layer<dyn_batch_normalizat
         const auto B = etl::dim<0>(context.input);
         const auto S = B * W * H;
 
-        auto dxhat = etl::force_temporary_dim_only(context.errors);
+        if constexpr (etl::all_dma<std::decay_t<HH>, decltype(context.input), decltype(context.errors)>) {
+            // The normalized input is recomputed from the statistics
+            context.input.ensure_cpu_up_to_date();
+            context.errors.ensure_cpu_up_to_date();
+            gamma.ensure_cpu_up_to_date();
 
-        for(size_t b = 0; b < B; ++b){
-            for (size_t k = 0; k < Kernels; ++k) {
-                dxhat(b)(k) = context.errors(b)(k) >> gamma(k);
+            batch_norm_4d_backward(context.input.memory_start(), context.errors.memory_start(), output.memory_start(), B, Kernels, W * H,
+                                   gamma.memory_start(), last_mean.memory_start(), inv_var.memory_start());
+
+            output.invalidate_gpu();
+        } else {
+            temporary_scope<weight> scope;
+
+            auto dxhat = scope.like(context.errors);
+            auto xhat  = scope.like(context.input);
+
+            for (size_t b = 0; b < B; ++b) {
+                for (size_t k = 0; k < Kernels; ++k) {
+                    dxhat(b)(k) = context.errors(b)(k) >> gamma(k);
+                    xhat(b)(k)  = (context.input(b)(k) - last_mean(k)) >> inv_var(k);
+                }
             }
-        }
 
-        auto dxhat_l      = etl::bias_batch_sum_4d(dxhat);
-        auto dxhat_xhat_l = etl::bias_batch_sum_4d(dxhat >> input_pre);
+            auto dxhat_l      = etl::bias_batch_sum_4d(dxhat);
+            auto dxhat_xhat_l = etl::bias_batch_sum_4d(dxhat >> xhat);
 
-        *dxhat_l;
-        *dxhat_xhat_l;
+            *dxhat_l;
+            *dxhat_xhat_l;
 
-        for(size_t b = 0; b < B; ++b){
-            for (size_t k = 0; k < Kernels; ++k) {
-                output(b)(k) = ((1.0 / S) * inv_var(k)) >> (S * dxhat(b)(k) - dxhat_l(k) - (input_pre(b)(k) >> dxhat_xhat_l(k)));
+            for (size_t b = 0; b < B; ++b) {
+                for (size_t k = 0; k < Kernels; ++k) {
+                    output(b)(k) = ((1.0 / S) * inv_var(k)) >> (S * dxhat(b)(k) - dxhat_l(k) - (xhat(b)(k) >> dxhat_xhat_l(k)));
+                }
             }
         }
     }
@@ -240,11 +327,39 @@ struct dyn_batch_normalization_4d_layer_impl : neural_layer<dyn_batch_normalizat
      */
     template<typename C>
     void compute_gradients(C& context) const {
-        // Gradients of gamma
-        std::get<0>(context.up.context)->grad = etl::bias_batch_sum_4d(input_pre >> context.errors);
+        auto& gamma_grad = std::get<0>(context.up.context)->grad;
+        auto& beta_grad  = std::get<1>(context.up.context)->grad;
+
+        if constexpr (etl::all_dma<decltype(context.input), decltype(context.errors)>) {
+            const auto B = etl::dim<0>(context.input);
+
+            context.input.ensure_cpu_up_to_date();
+            context.errors.ensure_cpu_up_to_date();
+
+            batch_norm_4d_gradients(context.input.memory_start(), context.errors.memory_start(), B, Kernels, W * H,
+                                    last_mean.memory_start(), inv_var.memory_start(), gamma_grad.memory_start(), beta_grad.memory_start());
+
+            gamma_grad.invalidate_gpu();
+            beta_grad.invalidate_gpu();
+        } else {
+            const auto B = etl::dim<0>(context.input);
+
+            temporary_scope<weight> scope;
 
-        // Gradients of beta
-        std::get<1>(context.up.context)->grad = etl::bias_batch_sum_4d(context.errors);
+            auto xhat = scope.like(context.input);
+
+            for (size_t b = 0; b < B; ++b) {
+                for (size_t k = 0; k < Kernels; ++k) {
+                    xhat(b)(k) = (context.input(b)(k) - last_mean(k)) >> inv_var(k);
+                }
+            }
+
+            // Gradients of gamma
+            gamma_grad = etl::bias_batch_sum_4d(xhat >> context.errors);
+
+            // Gradients of beta
+            beta_grad = etl::bias_batch_sum_4d(context.errors);
+        }
     }
 
     /*!
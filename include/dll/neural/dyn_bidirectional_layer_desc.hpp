@@ -0,0 +1,41 @@
+//=======================================================================
+// Copyright (c) 2014-2017 Baptiste Wicht
+// Distributed under the terms of the MIT License.
+// (See accompanying file LICENSE or copy at
+//  http://opensource.org/licenses/MIT)
+//=======================================================================
+
+#pragma once
+
+#include "dll/base_conf.hpp"
+#include "dll/util/tmp.hpp"
+
+namespace dll {
+
+/*!
+ * \brief Describe a dynamic bidirectional recurrent layer, made of two
+ * layers of the given type, reading the sequences in the two directions.
+ */
+template <typename Layer>
+struct dyn_bidirectional_layer_desc {
+    using direction_t = Layer; ///< The layer of each direction
+
+    /*!
+     * \brief A list of all the parameters of the descriptor
+     */
+    using parameters = cpp::type_list<>;
+
+    /*! The layer type */
+    using layer_t = dyn_bidirectional_layer_impl<dyn_bidirectional_layer_desc<Layer>>;
+
+    /*! The dynamic layer type */
+    using dyn_layer_t = dyn_bidirectional_layer_impl<dyn_bidirectional_layer_desc<Layer>>;
+};
+
+/*!
+ * \brief Describe a dynamic bidirectional recurrent layer.
+ */
+template <typename Layer>
+using dyn_bidirectional_layer = typename dyn_bidirectional_layer_desc<Layer>::layer_t;
+
+} //end of dll namespace
@@ -24,6 +24,14 @@ struct dyn_conv_layer_desc {
 
     static constexpr auto activation_function = detail::get_value_v<activation<function::SIGMOID>, Parameters...>;            ///< The layer's activation function
 
+    static constexpr size_t S1 = detail::get_value_1<stride<1, 1>, Parameters...>::value;  ///< The stride of the first dimension (default)
+    static constexpr size_t S2 = detail::get_value_2<stride<1, 1>, Parameters...>::value;  ///< The stride of the second dimension (default)
+    static constexpr size_t P1 = detail::get_value_1<padding<0, 0>, Parameters...>::value; ///< The padding of the first dimension (default)
+    static constexpr size_t P2 = detail::get_value_2<padding<0, 0>, Parameters...>::value; ///< The padding of the second dimension (default)
+    static constexpr size_t G  = detail::get_value_v<groups<1>, Parameters...>;            ///< The number of groups (default)
+    static constexpr size_t D1 = detail::get_value_1<dilation<1, 1>, Parameters...>::value; ///< The dilation of the first dimension (default)
+    static constexpr size_t D2 = detail::get_value_2<dilation<1, 1>, Parameters...>::value; ///< The dilation of the second dimension (default)
+
     using w_initializer = detail::get_type_t<initializer<init_lecun>, Parameters...>;     ///< The initializer for the weights
     using b_initializer = detail::get_type_t<initializer_bias<init_zero>, Parameters...>; ///< The initializer for the biases
 
@@ -38,7 +46,7 @@ struct dyn_conv_layer_desc {
 
     //Make sure only valid types are passed to the configuration list
     static_assert(
-        detail::is_valid_v<cpp::type_list<weight_type_id, activation_id, initializer_id, initializer_bias_id, no_bias_id>, Parameters...>,
+        detail::is_valid_v<cpp::type_list<weight_type_id, activation_id, initializer_id, initializer_bias_id, no_bias_id, stride_id, padding_id, groups_id, dilation_id>, Parameters...>,
         "Invalid parameters type for dyn_conv_layer_desc");
 };
 
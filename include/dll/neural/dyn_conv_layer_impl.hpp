@@ -11,6 +11,10 @@
 #include "dll/neural_layer.hpp"
 
 #include "dll/util/timers.hpp" // for auto_timer
+#include "dll/util/conv_epilogue.hpp"
+#include "dll/util/grouped_conv.hpp"
+#include "dll/util/static_desc.hpp"
+#include "dll/util/filter_pruning.hpp"
 
 namespace dll {
 
@@ -58,6 +62,14 @@ struct dyn_conv_layer_impl final : neural_layer<dyn_conv_layer_impl<Desc>, Desc>
     size_t nw1; ///< The first dimension of the filters
     size_t nw2; ///< The second dimension of the filters
 
+    size_t s1; ///< The stride of the first dimension
+    size_t s2; ///< The stride of the second dimension
+    size_t p1; ///< The padding of the first dimension
+    size_t p2; ///< The padding of the second dimension
+    size_t g;  ///< The number of groups
+    size_t d1; ///< The dilation of the first dimension
+    size_t d2; ///< The dilation of the second dimension
+
     dyn_conv_layer_impl(): base_type() {
         // Nothing else to init
     }
@@ -65,18 +77,32 @@ struct dyn_conv_layer_impl final : neural_layer<dyn_conv_layer_impl<Desc>, Desc>
     /*!
      * \brief Initialize the dynamic layer
      */
-    void init_layer(size_t nc, size_t nv1, size_t nv2, size_t k, size_t nw1, size_t nw2){
+    void init_layer(size_t nc, size_t nv1, size_t nv2, size_t k, size_t nw1, size_t nw2,
+                    size_t s1 = desc::S1, size_t s2 = desc::S2, size_t p1 = desc::P1, size_t p2 = desc::P2, size_t g = desc::G,
+                    size_t d1 = desc::D1, size_t d2 = desc::D2){
         this->nv1 = nv1;
         this->nv2 = nv2;
         this->nw1 = nw1;
         this->nw2 = nw2;
         this->nc = nc;
         this->k = k;
+        this->s1 = s1;
+        this->s2 = s2;
+        this->p1 = p1;
+        this->p2 = p2;
+        this->g = g;
+        this->d1 = d1;
+        this->d2 = d2;
+
+        cpp_assert(s1 > 0 && s2 > 0, "The stride must be at least 1");
+        cpp_assert(d1 > 0 && d2 > 0, "The dilation must be at least 1");
+        cpp_assert(nv1 + 2 * p1 >= shape().ew1() && nv2 + 2 * p2 >= shape().ew2(), "The filters cannot be larger than the padded input");
+        cpp_assert(g > 0 && nc % g == 0 && k % g == 0, "The channels and the filters must be divisible by the number of groups");
 
-        this->nh1 = nv1 - nw1 + 1;
-        this->nh2 = nv2 - nw2 + 1;
+        this->nh1 = shape().nh1();
+        this->nh2 = shape().nh2();
 
-        w = etl::dyn_matrix<weight, 4>(k, nc, nw1, nw2);
+        w = etl::dyn_matrix<weight, 4>(k, nc / g, nw1, nw2);
 
         b = etl::dyn_vector<weight>(k);
 
@@ -84,6 +110,75 @@ struct dyn_conv_layer_impl final : neural_layer<dyn_conv_layer_impl<Desc>, Desc>
         b_initializer::initialize(b, input_size(), output_size());
     }
 
+    /*!
+     * \brief Initialize the dynamic layer as a depthwise convolution, with
+     * one filter per input channel
+     */
+    void init_depthwise(size_t nc, size_t nv1, size_t nv2, size_t nw1, size_t nw2,
+                        size_t s1 = desc::S1, size_t s2 = desc::S2, size_t p1 = desc::P1, size_t p2 = desc::P2){
+        init_layer(nc, nv1, nv2, nc, nw1, nw2, s1, s2, p1, p2, nc);
+    }
+
+    /*!
+     * \brief Returns the shape of the convolution, for the grouped kernels
+     */
+    grouped_conv_shape shape() const {
+        return {nc, nv1, nv2, k, nw1, nw2, s1, s2, p1, p2, g, d1, d2};
+    }
+
+    /*!
+     * \brief Indicates if the convolutions are computed by the grouped
+     * kernels, for the grouped and dilated convolutions and the pointwise
+     * convolutions (directly computed with GEMM)
+     */
+    bool direct_kernels() const {
+        return g > 1 || shape().dilated() || shape().pointwise();
+    }
+
+    /*!
+     * \brief Indicates if the filters of the layer can be pruned
+     */
+    bool can_keep_filters() const noexcept {
+        return g == 1;
+    }
+
+    /*!
+     * \brief Only keep the given filters of the layer
+     * \param kept The indices of the kept filters, in increasing order
+     */
+    void keep_filters(const std::vector<size_t>& kept) {
+        cpp_assert(g == 1, "The filters of a grouped convolution cannot be pruned");
+
+        w = kept_blocks(w, kept, k, nc * nw1 * nw2, kept.size(), nc, nw1, nw2);
+        b = kept_blocks(b, kept, k, 1, kept.size());
+        k = kept.size();
+
+        bak_w.reset();
+        bak_b.reset();
+    }
+
+    /*!
+     * \brief Indicates if the input channels of the layer can be pruned
+     */
+    bool can_keep_channels() const noexcept {
+        return g == 1;
+    }
+
+    /*!
+     * \brief Only keep the given input channels of the layer
+     * \param kept The indices of the kept channels, in increasing order
+     * \param channels The number of channels before the pruning
+     */
+    void keep_channels(const std::vector<size_t>& kept, size_t channels) {
+        cpp_assert(g == 1 && channels == nc, "Invalid pruning of the input channels");
+        cpp_unused(channels);
+
+        w  = kept_blocks(w, kept, nc, nw1 * nw2, k, kept.size(), nw1, nw2);
+        nc = kept.size();
+
+        bak_w.reset();
+    }
+
     /*!
      * \brief Return the size of the input of this layer
      * \return The size of the input of this layer
@@ -108,6 +203,22 @@ struct dyn_conv_layer_impl final : neural_layer<dyn_conv_layer_impl<Desc>, Desc>
         return k * nw1 * nw2;
     }
 
+    /*!
+     * \brief Returns the number of floating point operations of the
+     * forward pass of one sample
+     */
+    size_t forward_flops() const noexcept {
+        return 2 * k * (nc / g) * nw1 * nw2 * nh1 * nh2;
+    }
+
+    /*!
+     * \brief Returns the number of floating point operations of the
+     * backward pass (errors and gradients) of one sample
+     */
+    size_t backward_flops() const noexcept {
+        return 4 * k * (nc / g) * nw1 * nw2 * nh1 * nh2;
+    }
+
     /*!
      * \brief Returns a short description of the layer
      * \return an std::string containing a short description of the layer
@@ -142,6 +253,36 @@ struct dyn_conv_layer_impl final : neural_layer<dyn_conv_layer_impl<Desc>, Desc>
         return {buffer};
     }
 
+    /*!
+     * \brief Returns the descriptor of the equivalent static layer
+     */
+    std::string static_desc() const {
+        std::string params = detail::static_activation_param(activation_function);
+
+        if (s1 != 1 || s2 != 1) {
+            params += ", dll::stride<" + std::to_string(s1) + ", " + std::to_string(s2) + ">";
+        }
+
+        if (p1 || p2) {
+            params += ", dll::padding<" + std::to_string(p1) + ", " + std::to_string(p2) + ">";
+        }
+
+        if (g != 1) {
+            params += ", dll::groups<" + std::to_string(g) + ">";
+        }
+
+        if (d1 != 1 || d2 != 1) {
+            params += ", dll::dilation<" + std::to_string(d1) + ", " + std::to_string(d2) + ">";
+        }
+
+        if (no_bias) {
+            params += ", dll::no_bias";
+        }
+
+        return "dll::conv_layer_desc<" + std::to_string(nc) + ", " + std::to_string(nv1) + ", " + std::to_string(nv2) + ", "
+               + std::to_string(k) + ", " + std::to_string(nw1) + ", " + std::to_string(nw2) + params + detail::static_weight_param<weight>() + ">::layer_t";
+    }
+
     /*!
      * \brief Returns the output shape
      * \return an std::string containing the description of the output shape
@@ -164,18 +305,29 @@ struct dyn_conv_layer_impl final : neural_layer<dyn_conv_layer_impl<Desc>, Desc>
     void forward_batch(H1&& output, const V& v) const {
         dll::auto_timer timer("conv:forward_batch");
 
-        if constexpr (etl::dimensions<V>() == 4) {
-            output = etl::ml::convolution_forward(v, w);
+        if (direct_kernels() && etl::all_dma<H1, V>) {
+            if constexpr (etl::all_dma<H1, V>) {
+                grouped_conv<weight>::forward(v, w, output, shape());
+            }
+        } else if constexpr (etl::dimensions<V>() == 4) {
+            output = etl::ml::convolution_forward(v, w, s1, s2, p1, p2);
         } else {
-            output = etl::ml::convolution_forward(etl::reshape(v, etl::dim<0>(v), nc, nv1, nv2), w);
+            output = etl::ml::convolution_forward(etl::reshape(v, etl::dim<0>(v), nc, nv1, nv2), w, s1, s2, p1, p2);
         }
 
-        if constexpr (!no_bias) {
-            output = bias_add_4d(output, b);
-        }
+        // The biases and the activation are applied in a single pass
+        if constexpr (is_element_wise(activation_function) && etl::all_dma<H1> && etl::dimensions<H1>() == 4) {
+            if constexpr (!no_bias || activation_function != function::IDENTITY) {
+                conv_epilogue<activation_function, !no_bias>(output, b);
+            }
+        } else {
+            if constexpr (!no_bias) {
+                output = bias_add_4d(output, b);
+            }
 
-        if constexpr (activation_function != function::IDENTITY) {
-            output = f_activate<activation_function>(output);
+            if constexpr (activation_function != function::IDENTITY) {
+                output = f_activate<activation_function>(output);
+            }
         }
     }
 
@@ -246,10 +398,14 @@ struct dyn_conv_layer_impl final : neural_layer<dyn_conv_layer_impl<Desc>, Desc>
     void backward_batch(H&& output, C& context) const {
         dll::auto_timer timer("conv:backward_batch");
 
-        if constexpr (etl::dimensions<H>() == 4) {
-            output = etl::ml::convolution_backward(context.errors, w);
+        if (direct_kernels() && etl::all_dma<H>) {
+            if constexpr (etl::all_dma<H>) {
+                grouped_conv<weight>::backward(context.errors, w, output, shape());
+            }
+        } else if constexpr (etl::dimensions<H>() == 4) {
+            output = etl::ml::convolution_backward(context.errors, w, s1, s2, p1, p2);
         } else {
-            etl::reshape(output, etl::dim<0>(output), nc, nv1, nv2) = etl::ml::convolution_backward(context.errors, w);
+            etl::reshape(output, etl::dim<0>(output), nc, nv1, nv2) = etl::ml::convolution_backward(context.errors, w, s1, s2, p1, p2);
         }
     }
 
@@ -261,7 +417,11 @@ struct dyn_conv_layer_impl final : neural_layer<dyn_conv_layer_impl<Desc>, Desc>
     void compute_gradients(C& context) const {
         dll::auto_timer timer("conv:compute_gradients");
 
-        std::get<0>(context.up.context)->grad = etl::ml::convolution_backward_filter(context.input, context.errors);
+        if (direct_kernels()) {
+            grouped_conv<weight>::backward_filter(context.input, context.errors, std::get<0>(context.up.context)->grad, shape());
+        } else {
+            std::get<0>(context.up.context)->grad = etl::ml::convolution_backward_filter(context.input, context.errors, s1, s2, p1, p2);
+        }
 
         if constexpr (!no_bias) {
             std::get<1>(context.up.context)->grad = etl::bias_batch_sum_4d(context.errors);
@@ -11,6 +11,8 @@
 #include "dll/neural_layer.hpp"
 
 #include "dll/util/timers.hpp" // for auto_timer
+#include "dll/util/conv_epilogue.hpp"
+#include "dll/util/grouped_conv.hpp"
 
 namespace dll {
 
@@ -60,6 +62,9 @@ struct dyn_conv_same_layer_impl final : neural_layer<dyn_conv_same_layer_impl<De
     size_t p1; ///< The first dimension padding
     size_t p2; ///< The second dimension padding
 
+    size_t d1; ///< The first dimension dilation
+    size_t d2; ///< The second dimension dilation
+
     dyn_conv_same_layer_impl(): base_type() {
         // Nothing else to init
     }
@@ -67,7 +72,7 @@ struct dyn_conv_same_layer_impl final : neural_layer<dyn_conv_same_layer_impl<De
     /*!
      * \brief Initialize the dynamic layer
      */
-    void init_layer(size_t nc, size_t nv1, size_t nv2, size_t k, size_t nw1, size_t nw2){
+    void init_layer(size_t nc, size_t nv1, size_t nv2, size_t k, size_t nw1, size_t nw2, size_t d1 = desc::D1, size_t d2 = desc::D2){
         this->nv1 = nv1;
         this->nv2 = nv2;
         this->nw1 = nw1;
@@ -78,8 +83,13 @@ struct dyn_conv_same_layer_impl final : neural_layer<dyn_conv_same_layer_impl<De
         this->nh1 = nv1;
         this->nh2 = nv2;
 
-        this->p1 = (nw1 - 1) / 2;
-        this->p2 = (nw2 - 1) / 2;
+        this->d1 = d1;
+        this->d2 = d2;
+
+        cpp_assert(d1 > 0 && d2 > 0, "The dilation must be at least 1");
+
+        this->p1 = d1 * (nw1 - 1) / 2;
+        this->p2 = d2 * (nw2 - 1) / 2;
 
         w = etl::dyn_matrix<weight, 4>(k, nc, nw1, nw2);
 
@@ -89,6 +99,13 @@ struct dyn_conv_same_layer_impl final : neural_layer<dyn_conv_same_layer_impl<De
         b_initializer::initialize(b, input_size(), output_size());
     }
 
+    /*!
+     * \brief Returns the shape of the convolution, for the dilated kernels
+     */
+    grouped_conv_shape shape() const {
+        return {nc, nv1, nv2, k, nw1, nw2, 1, 1, p1, p2, 1, d1, d2};
+    }
+
     /*!
      * \brief Return the size of the input of this layer
      * \return The size of the input of this layer
@@ -113,6 +130,22 @@ struct dyn_conv_same_layer_impl final : neural_layer<dyn_conv_same_layer_impl<De
         return k * nw1 * nw2;
     }
 
+    /*!
+     * \brief Returns the number of floating point operations of the
+     * forward pass of one sample
+     */
+    size_t forward_flops() const noexcept {
+        return 2 * k * nc * nw1 * nw2 * nh1 * nh2;
+    }
+
+    /*!
+     * \brief Returns the number of floating point operations of the
+     * backward pass (errors and gradients) of one sample
+     */
+    size_t backward_flops() const noexcept {
+        return 4 * k * nc * nw1 * nw2 * nh1 * nh2;
+    }
+
     /*!
      * \brief Return the size, in bytes, used by this layer
      * \return the size, in bytes, used by this layer
@@ -175,14 +208,23 @@ struct dyn_conv_same_layer_impl final : neural_layer<dyn_conv_same_layer_impl<De
     void forward_batch(H1&& output, const V& v) const {
         dll::auto_timer timer("conv:forward_batch");
 
-        if constexpr (etl::dimensions<V>() == 4) {
+        if (shape().dilated() && etl::all_dma<H1, V>) {
+            if constexpr (etl::all_dma<H1, V>) {
+                grouped_conv<weight>::forward(v, w, output, shape());
+            }
+        } else if constexpr (etl::dimensions<V>() == 4) {
             output = etl::ml::convolution_forward(v, w, 1, 1, p1, p2);
         } else {
             output = etl::ml::convolution_forward(etl::reshape(v, etl::dim<0>(v), nc, nv1, nv2), w, 1, 1, p1, p2);
         }
 
-        output = bias_add_4d(output, b);
-        output = f_activate<activation_function>(output);
+        // The biases and the activation are applied in a single pass
+        if constexpr (is_element_wise(activation_function) && etl::all_dma<H1> && etl::dimensions<H1>() == 4) {
+            conv_epilogue<activation_function, true>(output, b);
+        } else {
+            output = bias_add_4d(output, b);
+            output = f_activate<activation_function>(output);
+        }
     }
 
     void prepare_input(input_one_t& input) const {
@@ -248,7 +290,13 @@ struct dyn_conv_same_layer_impl final : neural_layer<dyn_conv_same_layer_impl<De
      */
     template<typename H, typename C>
     void backward_batch(H&& output, C& context) const {
-        output = etl::ml::convolution_backward(context.errors, w, 1, 1, p1, p2);
+        if (shape().dilated() && etl::all_dma<H>) {
+            if constexpr (etl::all_dma<H>) {
+                grouped_conv<weight>::backward(context.errors, w, output, shape());
+            }
+        } else {
+            output = etl::ml::convolution_backward(context.errors, w, 1, 1, p1, p2);
+        }
     }
 
     /*!
@@ -257,7 +305,11 @@ struct dyn_conv_same_layer_impl final : neural_layer<dyn_conv_same_layer_impl<De
      */
     template<typename C>
     void compute_gradients(C& context) const {
-        std::get<0>(context.up.context)->grad = etl::ml::convolution_backward_filter(context.input, context.errors, 1, 1, p1, p2);
+        if (shape().dilated()) {
+            grouped_conv<weight>::backward_filter(context.input, context.errors, std::get<0>(context.up.context)->grad, shape());
+        } else {
+            std::get<0>(context.up.context)->grad = etl::ml::convolution_backward_filter(context.input, context.errors, 1, 1, p1, p2);
+        }
         std::get<1>(context.up.context)->grad = etl::bias_batch_sum_4d(context.errors);
     }
 };
@@ -10,6 +10,9 @@
 #include "dll/base_traits.hpp"
 #include "dll/neural_layer.hpp"
 
+#include "dll/util/deconv_gemm.hpp"
+#include "dll/util/conv_tuning.hpp"
+
 namespace dll {
 
 /*!
@@ -45,6 +48,10 @@ struct dyn_deconv_layer_impl final : neural_layer<dyn_deconv_layer_impl<Desc>, D
     std::unique_ptr<w_type> bak_w; ///< Backup Weights
     std::unique_ptr<b_type> bak_b; ///< Backup Hidden biases
 
+    etl::dyn_matrix<weight, 2> w_t; ///< The transposed weights (forward pass)
+
+    conv_tuning tuning; ///< The implementations of the convolutions
+
     size_t nv1; ///< The first visible dimension
     size_t nv2; ///< The second visible dimension
     size_t nh1; ///< The first output dimension
@@ -82,6 +89,18 @@ struct dyn_deconv_layer_impl final : neural_layer<dyn_deconv_layer_impl<Desc>, D
 
         w_initializer::initialize(w, input_size(), output_size());
         b_initializer::initialize(b, input_size(), output_size());
+
+        w_t = etl::dyn_matrix<weight, 2>(k * nw1 * nw2, nc);
+
+        weights_changed();
+    }
+
+    /*!
+     * \brief Refresh the cached transposed weights, must be called after
+     * the weights have been modified.
+     */
+    void weights_changed() {
+        deconv_gemm<weight>::transpose_filters(w, w_t);
     }
 
     /*!
@@ -108,6 +127,22 @@ struct dyn_deconv_layer_impl final : neural_layer<dyn_deconv_layer_impl<Desc>, D
         return k * nw1 * nw2;
     }
 
+    /*!
+     * \brief Returns the number of floating point operations of the
+     * forward pass of one sample
+     */
+    size_t forward_flops() const noexcept {
+        return 2 * k * nc * nw1 * nw2 * nv1 * nv2;
+    }
+
+    /*!
+     * \brief Returns the number of floating point operations of the
+     * backward pass (errors and gradients) of one sample
+     */
+    size_t backward_flops() const noexcept {
+        return 4 * k * nc * nw1 * nw2 * nv1 * nv2;
+    }
+
     /*!
      * \brief Returns a short description of the layer
      * \return an std::string containing a short description of the layer
@@ -142,6 +177,23 @@ struct dyn_deconv_layer_impl final : neural_layer<dyn_deconv_layer_impl<Desc>, D
         return {k, nh1, nh2};
     }
 
+    /*!
+     * \brief Returns the key of the shape of the layer in the tuning cache
+     */
+    std::string tuning_key() const {
+        char buffer[512];
+        snprintf(buffer, 512, "deconv:%lux%lux%lu:%lux%lux%lu", nc, nv1, nv2, k, nw1, nw2);
+        return {buffer};
+    }
+
+    /*!
+     * \brief Returns the available implementations of the forward pass and
+     * of the backpropagation of the errors
+     */
+    static std::vector<conv_impl> conv_impls() {
+        return {conv_impl::GEMM, conv_impl::ETL};
+    }
+
     /*!
      * \brief Apply the layer to the given batch of input.
      *
@@ -150,13 +202,23 @@ struct dyn_deconv_layer_impl final : neural_layer<dyn_deconv_layer_impl<Desc>, D
      */
     template <typename H1, typename V>
     void forward_batch(H1&& output, const V& v) const {
-        output = etl::conv_4d_full_flipped(v, w);
-
-        const auto batch_size = etl::dim<0>(output);
-
-        auto b_rep = etl::force_temporary(etl::rep_l(etl::rep(b, nh1, nh2), batch_size));
+        if constexpr (etl::all_dma<H1, V> && etl::dimensions<H1>() == 4 && etl::dimensions<V>() == 4) {
+            if (tuning.forward != conv_impl::ETL) {
+                // The biases and the activation are applied once each output channel is complete
+                if constexpr (is_element_wise(activation_function)) {
+                    deconv_gemm<weight>::forward(v, w_t, output, conv_epilogue_op<activation_function, true, weight>(b));
+                } else {
+                    deconv_gemm<weight>::forward(v, w_t, output);
+
+                    output = f_activate<activation_function>(bias_add_4d(output, b));
+                }
+
+                return;
+            }
+        }
 
-        output = f_activate<activation_function>(b_rep + output);
+        output = etl::conv_4d_full_flipped(v, w);
+        output = f_activate<activation_function>(bias_add_4d(output, b));
     }
 
     void prepare_input(input_one_t& input) const {
@@ -222,6 +284,13 @@ struct dyn_deconv_layer_impl final : neural_layer<dyn_deconv_layer_impl<Desc>, D
      */
     template <typename H, typename C>
     void backward_batch(H&& output, C& context) const {
+        if constexpr (etl::all_dma<H>) {
+            if (tuning.backward != conv_impl::ETL) {
+                deconv_gemm<weight>::backward(context.errors, w, output);
+                return;
+            }
+        }
+
         if constexpr (etl::decay_traits<H>::dimensions() == 4) {
             output = etl::conv_4d_valid_flipped(context.errors, w);
         } else {
@@ -10,6 +10,11 @@
 #include "dll/base_traits.hpp"  // The traits
 #include "dll/neural_layer.hpp" // The base class
 #include "dll/util/timers.hpp"  // For auto_timer
+#include "dll/util/static_desc.hpp" // For static_desc
+#include "dll/util/sparse_batch.hpp" // For sparse inputs
+#include "dll/util/dense_backward.hpp" // For the combined backward pass
+#include "dll/util/filter_pruning.hpp" // For keep_channels
+#include "dll/trainer/chained_input.hpp" // For chained_input
 
 namespace dll {
 
@@ -27,6 +32,7 @@ struct dyn_dense_layer_impl final : neural_layer<dyn_dense_layer_impl<Desc>, Des
 
     static constexpr auto activation_function = desc::activation_function;                           ///< The layer's activation function
     static constexpr auto no_bias             = desc::parameters::template contains<dll::no_bias>(); ///< Disable the biases
+    static constexpr auto sparse_input        = desc::parameters::template contains<dll::sparse_input>(); ///< Indicates if the inputs are very sparse
 
     using w_initializer = typename desc::w_initializer; ///< The initializer for the weights
     using b_initializer = typename desc::b_initializer; ///< The initializer for the biases
@@ -66,6 +72,30 @@ struct dyn_dense_layer_impl final : neural_layer<dyn_dense_layer_impl<Desc>, Des
         b_initializer::initialize(b, input_size(), output_size());
     }
 
+    /*!
+     * \brief Indicates if the input channels of the layer can be pruned
+     */
+    bool can_keep_channels() const noexcept {
+        return true;
+    }
+
+    /*!
+     * \brief Only keep the inputs of the given channels, the inputs being
+     * made of channels planes of the same size
+     * \param kept The indices of the kept channels, in increasing order
+     * \param channels The number of channels before the pruning
+     */
+    void keep_channels(const std::vector<size_t>& kept, size_t channels) {
+        cpp_assert(num_visible % channels == 0, "Invalid pruning of the input channels");
+
+        const size_t plane = num_visible / channels;
+
+        w           = kept_blocks(w, kept, channels, plane * num_hidden, kept.size() * plane, num_hidden);
+        num_visible = kept.size() * plane;
+
+        bak_w.reset();
+    }
+
     /*!
      * \brief Returns the input size of this layer
      */
@@ -88,6 +118,22 @@ struct dyn_dense_layer_impl final : neural_layer<dyn_dense_layer_impl<Desc>, Des
         return num_visible * num_hidden + num_hidden;
     }
 
+    /*!
+     * \brief Returns the number of floating point operations of the
+     * forward pass of one sample
+     */
+    size_t forward_flops() const noexcept {
+        return 2 * num_visible * num_hidden;
+    }
+
+    /*!
+     * \brief Returns the number of floating point operations of the
+     * backward pass (errors and gradients) of one sample
+     */
+    size_t backward_flops() const noexcept {
+        return 4 * num_visible * num_hidden;
+    }
+
     /*!
      * \brief Returns a full description of the layer
      * \return an std::string containing a full description of the layer
@@ -122,6 +168,19 @@ struct dyn_dense_layer_impl final : neural_layer<dyn_dense_layer_impl<Desc>, Des
         return {buffer};
     }
 
+    /*!
+     * \brief Returns the descriptor of the equivalent static layer
+     */
+    std::string static_desc() const {
+        std::string params = detail::static_activation_param(activation_function);
+
+        if (no_bias) {
+            params += ", dll::no_bias";
+        }
+
+        return "dll::dense_layer_desc<" + std::to_string(num_visible) + ", " + std::to_string(num_hidden) + params + detail::static_weight_param<weight>() + ">::layer_t";
+    }
+
     /*!
      * \brief Returns the output shape
      * \return an std::string containing the description of the output shape
@@ -142,6 +201,23 @@ struct dyn_dense_layer_impl final : neural_layer<dyn_dense_layer_impl<Desc>, Des
     void forward_batch(H&& output, const V& input) const {
         dll::auto_timer timer("dense:forward");
 
+        forward_logits_batch(output, input);
+
+        output = f_activate<activation_function>(output);
+    }
+
+    /*!
+     * \brief Apply the layer to the given batch of input, without the
+     * activation function.
+     *
+     * The SGD trainer uses it to fuse the softmax of the last layer with
+     * the categorical cross-entropy.
+     *
+     * \param input A batch of input
+     * \param output A batch of output that will be filled
+     */
+    template <typename H, typename V>
+    void forward_logits_batch(H&& output, const V& input) const {
         const auto Batch = etl::dim<0>(input);
 
         // Note: The compile-time Batch information is lost here, but it does
@@ -149,13 +225,27 @@ struct dyn_dense_layer_impl final : neural_layer<dyn_dense_layer_impl<Desc>, Des
 
         cpp_assert(etl::dim<0>(output) == Batch, "The number of samples must be consistent");
 
+        if constexpr (sparse_input && etl::all_dma<H, V>) {
+            sparse_batch<weight> sparse;
+
+            sparse.update(input);
+
+            if (sparse.active) {
+                sparse.multiply(w, output);
+
+                if constexpr (!no_bias) {
+                    output = bias_add_2d(output, b);
+                }
+
+                return;
+            }
+        }
+
         output = etl::reshape(input, Batch, num_visible) * w;
 
         if constexpr (!no_bias) {
             output = bias_add_2d(output, b);
         }
-
-        output = f_activate<activation_function>(output);
     }
 
     /*!
@@ -216,6 +306,11 @@ struct dyn_dense_layer_impl final : neural_layer<dyn_dense_layer_impl<Desc>, Des
 
     /*!
      * \brief Backpropagate the errors to the previous layers
+     *
+     * The gradients of the weights and of the biases are computed in the
+     * same sweep over the errors and are then already available for
+     * compute_gradients.
+     *
      * \param output The ETL expression into which write the output
      * \param context The training context
      */
@@ -223,23 +318,82 @@ struct dyn_dense_layer_impl final : neural_layer<dyn_dense_layer_impl<Desc>, Des
     void backward_batch(H&& output, C& context) const {
         dll::unsafe_auto_timer timer("dense:backward");
 
-        // The reshape has no overhead, so better than SFINAE for nothing
-        auto batch_size = etl::dim<0>(output);
-        etl::reshape(output, batch_size, num_visible) = context.errors * etl::transpose(w);
+        cpp_assert(etl::size(output) == etl::dim<0>(context.errors) * num_visible, "Invalid size for the errors of the inputs");
+
+        fused_backward(output.memory_start(), context);
+
+        output.invalidate_gpu();
+
+        context.gradients_ready = true;
     }
 
     /*!
      * \brief Compute the gradients for this layer, if any
+     *
+     * The errors of the inputs are not computed here, they are never used
+     * for the first layer.
+     *
      * \param context The trainng context
      */
     template<typename C>
     void compute_gradients(C& context) const {
         dll::unsafe_auto_timer timer("dense:gradients");
 
-        std::get<0>(context.up.context)->grad = batch_outer(context.input, context.errors);
+        // Already computed during the backward pass
+        if (context.gradients_ready) {
+            context.gradients_ready = false;
+            return;
+        }
+
+        if constexpr (sparse_input) {
+            sparse_batch<weight> sparse;
+
+            sparse.update(context.input);
+
+            if (sparse.active) {
+                sparse.outer(context.errors, std::get<0>(context.up.context)->grad);
+
+                if constexpr (!no_bias) {
+                    std::get<1>(context.up.context)->grad = bias_batch_sum_2d(context.errors);
+                }
+
+                return;
+            }
+        }
+
+        fused_backward(nullptr, context);
+    }
+
+private:
+    /*!
+     * \brief Compute the gradients of the weights and the biases, and the
+     * errors of the inputs if output is not null, in one sweep over the
+     * errors.
+     *
+     * \param output The errors of the inputs, or nullptr
+     * \param context The trainng context
+     */
+    template<typename C>
+    void fused_backward(weight* output, C& context) const {
+        auto& w_grad = std::get<0>(context.up.context)->grad;
+
+        context.input.ensure_cpu_up_to_date();
+        context.errors.ensure_cpu_up_to_date();
+        w.ensure_cpu_up_to_date();
+
+        weight* b_grad = nullptr;
 
         if constexpr (!no_bias) {
-            std::get<1>(context.up.context)->grad = bias_batch_sum_2d(context.errors);
+            b_grad = std::get<1>(context.up.context)->grad.memory_start();
+        }
+
+        dense_backward<weight>::backward(context.input.memory_start(), context.errors.memory_start(), w.memory_start(),
+                                         output, w_grad.memory_start(), b_grad, etl::dim<0>(context.errors), num_visible, num_hidden);
+
+        w_grad.invalidate_gpu();
+
+        if constexpr (!no_bias) {
+            std::get<1>(context.up.context)->grad.invalidate_gpu();
         }
     }
 };
@@ -274,11 +428,35 @@ struct sgd_context<DBN, dyn_dense_layer_impl<Desc>, L> {
 
     static constexpr auto batch_size = DBN::batch_size;
 
-    etl::dyn_matrix<weight, 2> input;
+    /*!
+     * \brief The type of the input, a view of the output of the previous
+     * layer after the first layer
+     */
+    using owned_input_type = etl::dyn_matrix<weight, 2>;
+    using input_type       = std::conditional_t<(L > 0), etl::custom_dyn_matrix<weight, 2>, owned_input_type>;
+
+    chained_input<weight, 2> input_storage; ///< The memory of the input (only used after the first layer)
+
+    input_type input;
     etl::dyn_matrix<weight, 2> output;
     etl::dyn_matrix<weight, 2> errors;
 
-    sgd_context(const layer_t& layer) : input(batch_size, layer.num_visible, 0.0), output(batch_size, layer.num_hidden, 0.0), errors(batch_size, layer.num_hidden, 0.0) {}
+    bool gradients_ready = false; ///< Indicates if the gradients have been computed by the backward pass
+
+    sgd_context(const layer_t& layer) : input(make_input(input_storage, layer)), output(batch_size, layer.num_hidden, 0.0), errors(batch_size, layer.num_hidden, 0.0) {}
+
+private:
+    /*!
+     * \brief Create the input of the context
+     */
+    static input_type make_input(chained_input<weight, 2>& storage, const layer_t& layer) {
+        if constexpr (L > 0) {
+            return storage.view(batch_size, layer.num_visible);
+        } else {
+            cpp_unused(storage);
+            return input_type(batch_size, layer.num_visible, 0.0);
+        }
+    }
 };
 
 
@@ -0,0 +1,38 @@
+//=======================================================================
+// Copyright (c) 2014-2017 Baptiste Wicht
+// Distributed under the terms of the MIT License.
+// (See accompanying file LICENSE or copy at
+//  http://opensource.org/licenses/MIT)
+//=======================================================================
+
+#pragma once
+
+#include "dll/neural/dyn_conv_layer_desc.hpp"
+
+namespace dll {
+
+/*!
+ * \brief Describe a dynamic depthwise convolutional layer.
+ *
+ * The layer is a dynamic convolutional layer, which must be initialized
+ * with init_depthwise, with as many filters and groups as input channels.
+ */
+template <typename... Parameters>
+struct dyn_depthwise_conv_layer_desc {
+    /*! The descriptor of the equivalent dynamic convolutional layer */
+    using conv_desc = dyn_conv_layer_desc<Parameters...>;
+
+    /*! The conv type */
+    using layer_t = typename conv_desc::layer_t;
+
+    /*! The conv type */
+    using dyn_layer_t = typename conv_desc::dyn_layer_t;
+};
+
+/*!
+ * \brief Describe a dynamic depthwise convolutional layer.
+ */
+template <typename... Parameters>
+using dyn_depthwise_conv_layer = typename dyn_depthwise_conv_layer_desc<Parameters...>::layer_t;
+
+} //end of dll namespace
@@ -8,6 +8,7 @@
 #pragma once
 
 #include "dll/transform/transform_layer.hpp"
+#include "dll/util/dropout_mask.hpp"
 
 namespace dll {
 
@@ -24,28 +25,17 @@ struct dyn_dropout_layer_impl : transform_layer<dyn_dropout_layer_impl<Desc>> {
 
     float p; ///< The dropout probability
 
-    using dropout_t = decltype(etl::state_inverted_dropout_mask(dll::rand_engine(), p));
-
-    dropout_t* dropout = nullptr; ///< The dropout mask generator (ETL)
+    mutable dropout_mask mask; ///< The dropout mask of the current batch
 
     dyn_dropout_layer_impl() = default;
 
-    /*!
-     * \brief Delete the layer and frees all allocated resources
-     */
-    ~dyn_dropout_layer_impl() {
-        if (dropout) {
-            delete dropout;
-        }
-    }
-
     /*!
      * \brief Initialize the dynamic layer
      */
     void init_layer(float p) {
         this->p = p;
 
-        dropout = new dropout_t(dll::rand_engine(), p);
+        mask = dropout_mask(p);
     }
 
     /*!
@@ -103,9 +93,8 @@ struct dyn_dropout_layer_impl : transform_layer<dyn_dropout_layer_impl<Desc>> {
     void train_forward_batch(Output& output, const Input& input) const {
         dll::auto_timer timer("dropout:train:forward");
 
-        // Note: For now, cannot do on one pass because of state_inverted dropout not copy-able
-        output = *dropout;
-        output = output >> input;
+        mask.next();
+        mask.apply(output, input);
     }
 
     /*!
@@ -129,7 +118,8 @@ struct dyn_dropout_layer_impl : transform_layer<dyn_dropout_layer_impl<Desc>> {
     void backward_batch(H&& output, C& context) const {
         dll::unsafe_auto_timer timer("dropout:backward");
 
-        output = context.errors;
+        // The mask of the forward pass is generated again
+        mask.apply(output, context.errors);
     }
 
     /*!
@@ -170,7 +160,7 @@ struct sgd_context<DBN, dyn_dropout_layer_impl<Desc>, L> {
     using layer_t          = dyn_dropout_layer_impl<Desc>;                      ///< The current layer type
     using previous_layer   = typename DBN::template layer_type<L - 1>;          ///< The previous layer type
     using previous_context = sgd_context<DBN, previous_layer, L - 1>;           ///< The previous layer's context
-    using inputs_t         = decltype(std::declval<previous_context>().output); ///< The type of inputs
+    using inputs_t         = std::decay_t<decltype(std::declval<previous_context>().output)>; ///< The type of inputs
 
     inputs_t input;  ///< A batch of input
     inputs_t output; ///< A batch of output
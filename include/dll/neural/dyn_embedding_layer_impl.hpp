@@ -9,7 +9,9 @@
 
 #include "dll/neural_layer_no_bias.hpp"
 
-#include "dll/util/timers.hpp" // for auto_timer
+#include "dll/util/timers.hpp"           // for auto_timer
+#include "dll/util/sparse_rows.hpp"      // for embedding_row_gradients
+#include "dll/util/embedding_gather.hpp" // for batch_embedding_gather
 
 namespace dll {
 
@@ -130,7 +132,8 @@ struct dyn_embedding_layer_impl final : neural_layer_no_bias<dyn_embedding_layer
     void forward_batch(H1&& output, const V& v) const {
         dll::auto_timer timer("embedding:forward_batch");
 
-        output = batch_embedding_lookup(v, w);
+        // Each distinct word of the batch is read only once from the embedding
+        batch_embedding_gather(output, v, w);
     }
 
     void prepare_input(input_one_t& input) const {
@@ -197,7 +200,8 @@ struct dyn_embedding_layer_impl final : neural_layer_no_bias<dyn_embedding_layer
     void compute_gradients(C& context) const {
         dll::auto_timer timer("embedding:compute_gradients");
 
-        std::get<0>(context.up.context)->grad = batch_embedding_gradients(context.input, context.errors, w);;
+        // Only the rows of the words of the batch are computed
+        embedding_row_gradients(std::get<0>(context.up.context)->grad, context.rows, context.input, context.errors);
     }
 };
 
@@ -235,6 +239,8 @@ struct sgd_context<DBN, dyn_embedding_layer_impl<Desc>, L> {
     etl::dyn_matrix<weight, 3> output;
     etl::dyn_matrix<weight, 3> errors;
 
+    std::vector<size_t> rows; ///< The rows of the vocabulary with non-zero gradients
+
     sgd_context(const dyn_embedding_layer_impl<Desc>&  layer )
             : input(batch_size, layer.I), output(batch_size, layer.I, layer.K), errors(batch_size, layer.I, layer.K) {
         output = weight(0);
@@ -0,0 +1,333 @@
+//=======================================================================
+// Copyright (c) 2014-2017 Baptiste Wicht
+// Distributed under the terms of the MIT License.
+// (See accompanying file LICENSE or copy at
+//  http://opensource.org/licenses/MIT)
+//=======================================================================
+
+#pragma once
+
+#include "dll/base_traits.hpp"
+#include "dll/dbn_traits.hpp"
+#include "dll/base_gru_layer.hpp"
+
+#include "dll/util/timers.hpp" // for auto_timer
+
+namespace dll {
+
+/*!
+ * \brief Dynamic GRU recurrent layer of neural network.
+ */
+template <typename Desc>
+struct dyn_gru_layer_impl final : base_gru_layer<dyn_gru_layer_impl<Desc>, Desc> {
+    using desc        = Desc;                            ///< The descriptor of the layer
+    using weight      = typename desc::weight;           ///< The data type for this layer
+    using this_type   = dyn_gru_layer_impl<desc>;        ///< The type of this layer
+    using base_type   = base_gru_layer<this_type, desc>; ///< The base type
+    using layer_t     = this_type;                       ///< This layer's type
+    using dyn_layer_t = typename desc::dyn_layer_t;      ///< The dynamic version of this layer
+
+    static constexpr auto activation_function = desc::activation_function; ///< The activation function of the candidate
+
+    using w_initializer = typename desc::w_initializer; ///< The initializer for the W weights
+    using u_initializer = typename desc::u_initializer; ///< The initializer for the U weights
+    using b_initializer = typename desc::b_initializer; ///< The initializer for the biases
+
+    using input_one_t  = etl::dyn_matrix<weight, 2>; ///< The type of one input
+    using output_one_t = etl::dyn_matrix<weight, 2>; ///< The type of one output
+    using input_t      = std::vector<input_one_t>;   ///< The type of the input
+    using output_t     = std::vector<output_one_t>;  ///< The type of the output
+
+    using w_type = etl::dyn_matrix<weight, 2>; ///< The type of the W weights
+    using u_type = etl::dyn_matrix<weight, 2>; ///< The type of the U weights
+    using b_type = etl::dyn_matrix<weight, 1>; ///< The type of the biases
+
+    //Weights and biases
+    w_type w_z; ///< Weights W of the update gate
+    u_type u_z; ///< Weights U of the update gate
+    b_type b_z; ///< Biases of the update gate
+    w_type w_r; ///< Weights W of the reset gate
+    u_type u_r; ///< Weights U of the reset gate
+    b_type b_r; ///< Biases of the reset gate
+    w_type w_h; ///< Weights W of the candidate
+    u_type u_h; ///< Weights U of the candidate
+    b_type b_h; ///< Biases of the candidate
+
+    //Backup Weights and biases
+    std::unique_ptr<w_type> bak_w_z; ///< Backup Weights W of the update gate
+    std::unique_ptr<u_type> bak_u_z; ///< Backup Weights U of the update gate
+    std::unique_ptr<b_type> bak_b_z; ///< Backup Biases of the update gate
+    std::unique_ptr<w_type> bak_w_r; ///< Backup Weights W of the reset gate
+    std::unique_ptr<u_type> bak_u_r; ///< Backup Weights U of the reset gate
+    std::unique_ptr<b_type> bak_b_r; ///< Backup Biases of the reset gate
+    std::unique_ptr<w_type> bak_w_h; ///< Backup Weights W of the candidate
+    std::unique_ptr<u_type> bak_u_h; ///< Backup Weights U of the candidate
+    std::unique_ptr<b_type> bak_b_h; ///< Backup Biases of the candidate
+
+    size_t time_steps;      ///< The number of time steps
+    size_t sequence_length; ///< The length of the sequences
+    size_t hidden_units;    ///< The number of hidden units
+    size_t bptt_steps;      ///< The number of BPTT steps
+
+    /*!
+     * \brief Initialize a GRU layer with basic weights.
+     */
+    dyn_gru_layer_impl() : base_type() {}
+
+    /*!
+     * \brief Initialize the dynamic layer
+     */
+    void init_layer(size_t time_steps, size_t sequence_length, size_t hidden_units) {
+        this->time_steps      = time_steps;
+        this->sequence_length = sequence_length;
+        this->hidden_units    = hidden_units;
+
+        this->bptt_steps = desc::Truncate == 0 ? time_steps : desc::Truncate;
+
+        w_z = etl::dyn_matrix<weight, 2>(hidden_units, hidden_units);
+        w_r = etl::dyn_matrix<weight, 2>(hidden_units, hidden_units);
+        w_h = etl::dyn_matrix<weight, 2>(hidden_units, hidden_units);
+
+        u_z = etl::dyn_matrix<weight, 2>(sequence_length, hidden_units);
+        u_r = etl::dyn_matrix<weight, 2>(sequence_length, hidden_units);
+        u_h = etl::dyn_matrix<weight, 2>(sequence_length, hidden_units);
+
+        b_z = etl::dyn_matrix<weight, 1>(hidden_units);
+        b_r = etl::dyn_matrix<weight, 1>(hidden_units);
+        b_h = etl::dyn_matrix<weight, 1>(hidden_units);
+
+        w_initializer::initialize(w_z, hidden_units, hidden_units);
+        w_initializer::initialize(w_r, hidden_units, hidden_units);
+        w_initializer::initialize(w_h, hidden_units, hidden_units);
+
+        u_initializer::initialize(u_z, sequence_length, hidden_units);
+        u_initializer::initialize(u_r, sequence_length, hidden_units);
+        u_initializer::initialize(u_h, sequence_length, hidden_units);
+
+        b_initializer::initialize(b_z, hidden_units, hidden_units);
+        b_initializer::initialize(b_r, hidden_units, hidden_units);
+        b_initializer::initialize(b_h, hidden_units, hidden_units);
+
+        this->weights_changed();
+    }
+
+    /*!
+     * \brief Returns the input size of this layer
+     */
+    size_t input_size() const noexcept {
+        return time_steps * sequence_length;
+    }
+
+    /*!
+     * \brief Returns the output size of this layer
+     */
+    size_t output_size() const noexcept {
+        return time_steps * hidden_units;
+    }
+
+    /*!
+     * \brief Returns the number of parameters of this layer
+     */
+    size_t parameters() const noexcept {
+        return 3 * hidden_units * hidden_units + 3 * hidden_units * sequence_length + 3 * hidden_units;
+    }
+
+    /*!
+     * \brief Returns the number of floating point operations of the
+     * forward pass of one sample
+     */
+    size_t forward_flops() const noexcept {
+        return 6 * time_steps * hidden_units * (sequence_length + hidden_units);
+    }
+
+    /*!
+     * \brief Returns the number of floating point operations of the
+     * backward pass (errors and gradients) of one sample
+     */
+    size_t backward_flops() const noexcept {
+        return 12 * time_steps * hidden_units * (sequence_length + hidden_units);
+    }
+
+    /*!
+     * \brief Returns a short description of the layer
+     * \return an std::string containing a short description of the layer
+     */
+    std::string to_short_string(std::string pre = "") const {
+        cpp_unused(pre);
+
+        char buffer[512];
+        snprintf(buffer, 512, "GRU (%s) (dyn)", to_string(activation_function).c_str());
+        return {buffer};
+    }
+
+    /*!
+     * \brief Returns a short description of the layer
+     * \return an std::string containing a short description of the layer
+     */
+    std::string to_full_string(std::string pre = "") const {
+        cpp_unused(pre);
+
+        char buffer[512];
+        snprintf(buffer, 512, "GRU(dyn): %lux%lu -> %s -> %lux%lu", time_steps, sequence_length, to_string(activation_function).c_str(), time_steps, hidden_units);
+        return {buffer};
+    }
+
+    /*!
+     * \brief Returns the output shape
+     * \return an std::string containing the description of the output shape
+     */
+    std::vector<size_t> output_shape(const std::vector<size_t>& input_shape) const {
+        cpp_unused(input_shape);
+
+        return {time_steps, hidden_units};
+    }
+
+    /*!
+     * \brief Apply the layer to the given batch of input.
+     *
+     * \param x A batch of input
+     * \param output A batch of output that will be filled, with the complete
+     * sequences or only their last time step
+     */
+    template <typename H, typename V>
+    void forward_batch(H&& output, const V& x) const {
+        dll::auto_timer timer("gru:forward_batch");
+
+        cpp_assert(etl::dim<0>(output) == etl::dim<0>(x), "The number of samples must be consistent");
+
+        base_type::forward_batch_impl(output, x);
+    }
+
+    /*!
+     * \brief Prepare one empty output for this layer
+     * \return an empty ETL matrix suitable to store one output of this layer
+     *
+     * \tparam Input The type of one Input
+     */
+    template <typename Input>
+    output_one_t prepare_one_output() const {
+        return output_one_t(time_steps, hidden_units);
+    }
+
+    /*!
+     * \brief Prepare a set of empty outputs for this layer
+     * \param samples The number of samples to prepare the output for
+     * \return a container containing empty ETL matrices suitable to store samples output of this layer
+     * \tparam Input The type of one input
+     */
+    template <typename Input>
+    output_t prepare_output(size_t samples) const {
+        output_t output;
+        output.reserve(samples);
+        for (size_t i = 0; i < samples; ++i) {
+            output.emplace_back(time_steps, hidden_units);
+        }
+        return output;
+    }
+
+    /*!
+     * \brief Initialize the dynamic version of the layer from the
+     * fast version of the layer
+     * \param dyn Reference to the dynamic version of the layer that
+     * needs to be initialized
+     */
+    template <typename DLayer>
+    static void dyn_init(DLayer& dyn) {
+        cpp_unused(dyn);
+    }
+
+    /*!
+     * \brief Adapt the errors, called before backpropagation of the errors.
+     *
+     * This must be used by layers that have both an activation fnction and a non-linearity.
+     *
+     * \param context the training context
+     */
+    template <typename C>
+    void adapt_errors(C& context) const {
+        // Nothing to do here (done in BPTT)
+        cpp_unused(context);
+    }
+
+    /*!
+     * \brief Backpropagate the errors to the previous layers
+     * \param output The ETL expression into which write the output
+     * \param context The training context
+     */
+    template <typename H, typename C>
+    void backward_batch(H&& output, C& context) const {
+        dll::auto_timer timer("gru:backward_batch");
+
+        this->backward_pass(output, context, true);
+    }
+
+    /*!
+     * \brief Compute the gradients for this layer, if any
+     * \param context The trainng context
+     */
+    template <typename C>
+    void compute_gradients(C& context) const {
+        if constexpr (!C::layer) {
+            dll::auto_timer timer("gru:compute_gradients");
+            this->backward_pass(this->cache.x_t, context, false);
+        }
+    }
+};
+
+// Declare the traits for the Layer
+
+template <typename Desc>
+struct layer_base_traits<dyn_gru_layer_impl<Desc>> {
+    static constexpr bool is_neural     = true;  ///< Indicates if the layer is a neural layer
+    static constexpr bool is_dense      = false; ///< Indicates if the layer is dense
+    static constexpr bool is_conv       = false; ///< Indicates if the layer is convolutional
+    static constexpr bool is_deconv     = false; ///< Indicates if the layer is deconvolutional
+    static constexpr bool is_standard   = true;  ///< Indicates if the layer is standard
+    static constexpr bool is_rbm        = false; ///< Indicates if the layer is RBM
+    static constexpr bool is_pooling    = false; ///< Indicates if the layer is a pooling layer
+    static constexpr bool is_unpooling  = false; ///< Indicates if the layer is an unpooling laye
+    static constexpr bool is_transform  = false; ///< Indicates if the layer is a transform layer
+    static constexpr bool is_recurrent  = true;  ///< Indicates if the layer is a recurrent layer
+    static constexpr bool is_multi      = false; ///< Indicates if the layer is a multi-layer layer
+    static constexpr bool is_dynamic    = true;  ///< Indicates if the layer is dynamic
+    static constexpr bool pretrain_last = false; ///< Indicates if the layer is dynamic
+    static constexpr bool sgd_supported = true;  ///< Indicates if the layer is supported by SGD
+};
+
+/*!
+ * \brief specialization of sgd_context for dyn_gru_layer_impl
+ */
+template <typename DBN, typename Desc, size_t L>
+struct sgd_context<DBN, dyn_gru_layer_impl<Desc>, L> {
+    using layer_t = dyn_gru_layer_impl<Desc>;
+    using weight  = typename layer_t::weight; ///< The data type for this layer
+
+    static constexpr size_t layer    = L;               ///< The index of the layer
+    static constexpr auto batch_size = DBN::batch_size; ///< The batch size of the network
+
+    static constexpr bool last_step = rnn_last_step<DBN, layer_t, L>(); ///< Indicates if only the last time step is output
+
+    using outputs_t = etl::dyn_matrix<weight, last_step ? 2 : 3>; ///< The type of a batch of output
+
+    etl::dyn_matrix<weight, 3> input;
+    outputs_t output;
+    outputs_t errors;
+
+    sgd_context(const dyn_gru_layer_impl<Desc>& layer)
+            : input(batch_size, layer.time_steps, layer.sequence_length), output(make_outputs(layer)), errors(make_outputs(layer)) {}
+
+private:
+    /*!
+     * \brief Create a batch of output, only the last time step when the
+     * layer is followed by a recurrent_last layer
+     */
+    static outputs_t make_outputs(const dyn_gru_layer_impl<Desc>& layer) {
+        if constexpr (last_step) {
+            return outputs_t(batch_size, layer.hidden_units, weight(0.0));
+        } else {
+            return outputs_t(batch_size, layer.time_steps, layer.hidden_units, weight(0.0));
+        }
+    }
+};
+
+} //end of dll namespace
@@ -8,8 +8,10 @@
 #pragma once
 
 #include "dll/base_traits.hpp"
+#include "dll/dbn_traits.hpp"
 
-#include "dll/util/timers.hpp" // for auto_timer
+#include "dll/util/timers.hpp"     // for auto_timer
+#include "dll/util/time_major.hpp" // for is_last_step
 
 namespace dll {
 
@@ -25,6 +27,8 @@ struct dyn_recurrent_last_layer_impl final : layer<dyn_recurrent_last_layer_impl
     using layer_t     = this_type;                       ///< This layer's type
     using dyn_layer_t = typename desc::dyn_layer_t;      ///< The dynamic version of this layer
 
+    static constexpr bool recurrent_last = true; ///< The layer extracts the last time step of the sequences
+
     using input_one_t  = etl::dyn_matrix<weight, 2>; ///< The type of one input
     using output_one_t = etl::dyn_matrix<weight, 1>; ///< The type of one output
     using input_t      = std::vector<input_one_t>;   ///< The type of the input
@@ -108,8 +112,13 @@ struct dyn_recurrent_last_layer_impl final : layer<dyn_recurrent_last_layer_impl
 
         cpp_assert(etl::dim<0>(output) == Batch, "The number of samples must be consistent");
 
-        for(size_t b = 0; b < Batch; ++b){
-            output(b) = input(b)(time_steps - 1);
+        if constexpr (is_last_step<V>) {
+            // The recurrent layer only gave the last time step
+            output = input;
+        } else {
+            for (size_t b = 0; b < Batch; ++b) {
+                output(b) = input(b)(time_steps - 1);
+            }
         }
     }
 
@@ -173,12 +182,17 @@ struct dyn_recurrent_last_layer_impl final : layer<dyn_recurrent_last_layer_impl
     void backward_batch(H&& output, C& context) const {
         dll::auto_timer timer("recurrent_last:backward_batch");
 
-        const auto Batch = etl::dim<0>(output);
+        if constexpr (is_last_step<H>) {
+            // The recurrent layer only needs the errors of the last time step
+            output = context.errors;
+        } else {
+            const auto Batch = etl::dim<0>(output);
 
-        output = 0;
+            output = 0;
 
-        for(size_t b = 0; b < Batch; ++b){
-            output(b)(time_steps - 1) = context.errors(b);
+            for (size_t b = 0; b < Batch; ++b) {
+                output(b)(time_steps - 1) = context.errors(b);
+            }
         }
     }
 
@@ -223,12 +237,29 @@ struct sgd_context<DBN, dyn_recurrent_last_layer_impl<Desc>, L> {
 
     static constexpr auto batch_size = DBN::batch_size;
 
-    etl::dyn_matrix<weight, 3> input;
+    static constexpr bool last_step = rnn_last_step_input<DBN, L>(); ///< Indicates if only the last time step is input
+
+    using inputs_t = etl::dyn_matrix<weight, last_step ? 2 : 3>; ///< The type of a batch of input
+
+    inputs_t input;
     etl::dyn_matrix<weight, 2> output;
     etl::dyn_matrix<weight, 2> errors;
 
     sgd_context(const dyn_recurrent_last_layer_impl<Desc>& layer)
-            : input(batch_size, layer.time_steps, layer.hidden_units), output(batch_size, layer.hidden_units, 0.0), errors(batch_size, layer.hidden_units, 0.0) {}
+            : input(make_inputs(layer)), output(batch_size, layer.hidden_units, 0.0), errors(batch_size, layer.hidden_units, 0.0) {}
+
+private:
+    /*!
+     * \brief Create a batch of input, only the last time step when the
+     * recurrent layer before does not output the complete sequences
+     */
+    static inputs_t make_inputs(const dyn_recurrent_last_layer_impl<Desc>& layer) {
+        if constexpr (last_step) {
+            return inputs_t(batch_size, layer.hidden_units);
+        } else {
+            return inputs_t(batch_size, layer.time_steps, layer.hidden_units);
+        }
+    }
 };
 
 } //end of dll namespace
@@ -8,6 +8,7 @@
 #pragma once
 
 #include "dll/base_traits.hpp"
+#include "dll/dbn_traits.hpp"
 #include "dll/base_rnn_layer.hpp"
 
 #include "dll/util/timers.hpp" // for auto_timer
@@ -75,6 +76,8 @@ struct dyn_rnn_layer_impl final : base_rnn_layer<dyn_rnn_layer_impl<Desc>, Desc>
 
         this->bptt_steps = desc::Truncate == 0 ? time_steps : desc::Truncate;
 
+        cpp_assert(desc::BpttWindow == 0 || time_steps % desc::BpttWindow == 0, "The BPTT window must divide the number of time steps");
+
         w = etl::dyn_matrix<weight, 2>(hidden_units, hidden_units);
         u = etl::dyn_matrix<weight, 2>(sequence_length, hidden_units);
         b = etl::dyn_matrix<weight, 1>(hidden_units);
@@ -106,6 +109,22 @@ struct dyn_rnn_layer_impl final : base_rnn_layer<dyn_rnn_layer_impl<Desc>, Desc>
         return hidden_units * hidden_units + hidden_units * sequence_length + hidden_units;
     }
 
+    /*!
+     * \brief Returns the number of floating point operations of the
+     * forward pass of one sample
+     */
+    size_t forward_flops() const noexcept {
+        return 2 * time_steps * hidden_units * (sequence_length + hidden_units);
+    }
+
+    /*!
+     * \brief Returns the number of floating point operations of the
+     * backward pass (errors and gradients) of one sample
+     */
+    size_t backward_flops() const noexcept {
+        return 4 * time_steps * hidden_units * (sequence_length + hidden_units);
+    }
+
     /*!
      * \brief Returns a short description of the layer
      * \return an std::string containing a short description of the layer
@@ -154,7 +173,8 @@ struct dyn_rnn_layer_impl final : base_rnn_layer<dyn_rnn_layer_impl<Desc>, Desc>
      * \brief Apply the layer to the given batch of input.
      *
      * \param x A batch of input
-     * \param output A batch of output that will be filled
+     * \param output A batch of output that will be filled, with the complete
+     * sequences or only their last time step
      */
     template <typename H, typename V>
     void forward_batch(H&& output, const V& x) const {
@@ -271,12 +291,29 @@ struct sgd_context<DBN, dyn_rnn_layer_impl<Desc>, L> {
     static constexpr size_t layer    = L;               ///< The index of the layer
     static constexpr auto batch_size = DBN::batch_size; ///< The batch size of the network
 
+    static constexpr bool last_step = rnn_last_step<DBN, layer_t, L>(); ///< Indicates if only the last time step is output
+
+    using outputs_t = etl::dyn_matrix<weight, last_step ? 2 : 3>; ///< The type of a batch of output
+
     etl::dyn_matrix<weight, 3> input;
-    etl::dyn_matrix<weight, 3> output;
-    etl::dyn_matrix<weight, 3> errors;
+    outputs_t output;
+    outputs_t errors;
 
     sgd_context(const dyn_rnn_layer_impl<Desc>& layer)
-            : input(batch_size, layer.time_steps, layer.sequence_length), output(batch_size, layer.time_steps, layer.hidden_units, 0.0), errors(batch_size, layer.time_steps, layer.hidden_units, 0.0) {}
+            : input(batch_size, layer.time_steps, layer.sequence_length), output(make_outputs(layer)), errors(make_outputs(layer)) {}
+
+private:
+    /*!
+     * \brief Create a batch of output, only the last time step when the
+     * layer is followed by a recurrent_last layer
+     */
+    static outputs_t make_outputs(const dyn_rnn_layer_impl<Desc>& layer) {
+        if constexpr (last_step) {
+            return outputs_t(batch_size, layer.hidden_units, weight(0.0));
+        } else {
+            return outputs_t(batch_size, layer.time_steps, layer.hidden_units, weight(0.0));
+        }
+    }
 };
 
 } //end of dll namespace
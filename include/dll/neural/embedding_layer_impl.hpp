@@ -9,7 +9,9 @@
 
 #include "dll/neural_layer_no_bias.hpp"
 
-#include "dll/util/timers.hpp" // for auto_timer
+#include "dll/util/timers.hpp"           // for auto_timer
+#include "dll/util/sparse_rows.hpp"      // for embedding_row_gradients
+#include "dll/util/embedding_gather.hpp" // for batch_embedding_gather
 
 namespace dll {
 
@@ -117,7 +119,8 @@ struct embedding_layer_impl final : neural_layer_no_bias<embedding_layer_impl<De
     void forward_batch(H1&& output, const V& v) const {
         dll::auto_timer timer("embedding:forward_batch");
 
-        output = batch_embedding_lookup(v, w);
+        // Each distinct word of the batch is read only once from the embedding
+        batch_embedding_gather(output, v, w);
     }
 
     /*!
@@ -172,7 +175,8 @@ struct embedding_layer_impl final : neural_layer_no_bias<embedding_layer_impl<De
     void compute_gradients(C& context) const {
         dll::auto_timer timer("embedding:compute_gradients");
 
-        std::get<0>(context.up.context)->grad = batch_embedding_gradients(context.input, context.errors, w);;
+        // Only the rows of the words of the batch are computed
+        embedding_row_gradients(std::get<0>(context.up.context)->grad, context.rows, context.input, context.errors);
     }
 };
 
@@ -225,6 +229,8 @@ struct sgd_context<DBN, embedding_layer_impl<Desc>, L> {
     etl::fast_matrix<weight, batch_size, I, K> output;
     etl::fast_matrix<weight, batch_size, I, K> errors;
 
+    std::vector<size_t> rows; ///< The rows of the vocabulary with non-zero gradients
+
     sgd_context(const embedding_layer_impl<Desc>& /* layer */)
             : output(0.0), errors(0.0) {}
 };
@@ -8,6 +8,7 @@
 #pragma once
 
 #include "dll/base_traits.hpp"
+#include "dll/dbn_traits.hpp"
 #include "dll/base_lstm_layer.hpp"
 
 #include "dll/util/timers.hpp" // for auto_timer
@@ -32,6 +33,8 @@ struct lstm_layer_impl final : base_lstm_layer<lstm_layer_impl<Desc>, Desc> {
 
     static constexpr size_t bptt_steps = desc::Truncate == 0 ? time_steps : desc::Truncate; ///< The number of bptt steps
 
+    static_assert(desc::BpttWindow == 0 || time_steps % desc::BpttWindow == 0, "The BPTT window must divide the number of time steps");
+
     static constexpr auto activation_function = desc::activation_function; ///< The layer's activation function
 
     using w_initializer  = typename desc::w_initializer;  ///< The initializer for the W weights
@@ -99,6 +102,8 @@ struct lstm_layer_impl final : base_lstm_layer<lstm_layer_impl<Desc>, Desc> {
 
         // Initialized differently because should be initialized to 1
         fb_initializer::initialize(b_f, hidden_units, hidden_units);
+
+        this->weights_changed();
     }
 
     /*!
@@ -122,6 +127,22 @@ struct lstm_layer_impl final : base_lstm_layer<lstm_layer_impl<Desc>, Desc> {
         return 4 * hidden_units * hidden_units + 4 * hidden_units * sequence_length;
     }
 
+    /*!
+     * \brief Returns the number of floating point operations of the
+     * forward pass of one sample
+     */
+    static constexpr size_t forward_flops() noexcept {
+        return 8 * time_steps * hidden_units * (sequence_length + hidden_units);
+    }
+
+    /*!
+     * \brief Returns the number of floating point operations of the
+     * backward pass (errors and gradients) of one sample
+     */
+    static constexpr size_t backward_flops() noexcept {
+        return 16 * time_steps * hidden_units * (sequence_length + hidden_units);
+    }
+
     /*!
      * \brief Returns a short description of the layer
      * \return an std::string containing a short description of the layer
@@ -196,14 +217,21 @@ struct lstm_layer_impl final : base_lstm_layer<lstm_layer_impl<Desc>, Desc> {
 
     void prepare_cache(size_t Batch) const {
         if (cpp_unlikely(!i_t.memory_start())) {
-            g_t.resize(time_steps, Batch, hidden_units);
-            i_t.resize(time_steps, Batch, hidden_units);
-            f_t.resize(time_steps, Batch, hidden_units);
-            o_t.resize(time_steps, Batch, hidden_units);
+            const size_t steps = this->cache_steps();
+
+            g_t.resize(steps, Batch, hidden_units);
+            i_t.resize(steps, Batch, hidden_units);
+            f_t.resize(steps, Batch, hidden_units);
+            o_t.resize(steps, Batch, hidden_units);
+
+            x_t.resize(steps, Batch, sequence_length);
+            s_t.resize(steps, Batch, hidden_units);
+            h_t.resize(steps, Batch, hidden_units);
 
-            x_t.resize(time_steps, Batch, sequence_length);
-            s_t.resize(time_steps, Batch, hidden_units);
-            h_t.resize(time_steps, Batch, hidden_units);
+            // The windowed BPTT does not keep the errors of all the steps
+            if constexpr (base_type::bptt_window) {
+                return;
+            }
 
             d_h_t.resize(time_steps, Batch, hidden_units);
             d_c_t.resize(time_steps, Batch, hidden_units);
@@ -230,7 +258,8 @@ struct lstm_layer_impl final : base_lstm_layer<lstm_layer_impl<Desc>, Desc> {
      * \brief Apply the layer to the given batch of input.
      *
      * \param x A batch of input
-     * \param output A batch of output that will be filled
+     * \param output A batch of output that will be filled, with the complete
+     * sequences or only their last time step
      */
     template <typename H, typename V>
     void forward_batch(H&& output, const V& x) const {
@@ -242,43 +271,22 @@ struct lstm_layer_impl final : base_lstm_layer<lstm_layer_impl<Desc>, Desc> {
 
         prepare_cache(Batch);
 
-        // 1. Rearrange input
-
-        for (size_t b = 0; b < Batch; ++b) {
-            for (size_t t = 0; t < time_steps; ++t) {
-                x_t(t)(b) = x(b)(t);
-            }
+        if constexpr (base_type::bptt_window) {
+            this->forward_windowed(output, x);
+            return;
         }
 
-        // 2. Forward propagation through time
-
-        // t == 0
-
-        g_t(0) =    etl::tanh(bias_add_2d(x_t(0) * (u_g), b_g));
-        i_t(0) = etl::sigmoid(bias_add_2d(x_t(0) * (u_i), b_i));
-        f_t(0) = etl::sigmoid(bias_add_2d(x_t(0) * (u_f), b_f));
-        o_t(0) = etl::sigmoid(bias_add_2d(x_t(0) * (u_o), b_o));
+        // 1. Rearrange input
 
-        s_t(0) = g_t(0) >> i_t(0);
-        h_t(0) = f_activate<activation_function>(s_t(0)) >> o_t(0);
+        swap_batch_time(x_t, x);
 
-        for (size_t t = 1; t < time_steps; ++t) {
-            g_t(t) =    etl::tanh(bias_add_2d(x_t(t) * u_g + h_t(t - 1) * w_g, b_g));
-            i_t(t) = etl::sigmoid(bias_add_2d(x_t(t) * u_i + h_t(t - 1) * w_i, b_i));
-            f_t(t) = etl::sigmoid(bias_add_2d(x_t(t) * u_f + h_t(t - 1) * w_f, b_f));
-            o_t(t) = etl::sigmoid(bias_add_2d(x_t(t) * u_o + h_t(t - 1) * w_o, b_o));
+        // 2. Forward propagation through time, with fused gates
 
-            s_t(t) = f_activate<activation_function>( (g_t(t) >> i_t(t)) + (s_t(t - 1) >> f_t(t)) );
-            h_t(t) = s_t(t) >> o_t(t);
-        }
+        this->forward_fused(*this, Batch, time_steps);
 
         // 3. Rearrange the output
 
-        for (size_t b = 0; b < Batch; ++b) {
-            for (size_t t = 0; t < time_steps; ++t) {
-                output(b)(t) = h_t(t)(b);
-            }
-        }
+        this->write_outputs(output, *this);
     }
 
     /*!
@@ -329,17 +337,20 @@ struct lstm_layer_impl final : base_lstm_layer<lstm_layer_impl<Desc>, Desc> {
 
     template <typename Output, typename C>
     void backward_pass(Output& output, C& context, bool direct = true) const {
+        if constexpr (base_type::bptt_window) {
+            this->backward_windowed(output, context, direct);
+            return;
+        }
+
         const size_t Batch = etl::dim<0>(context.errors);
 
         // 1. Rearrange input/errors
 
-        etl::dyn_matrix<float, 3> delta_t(time_steps, Batch, hidden_units);
+        temporary_scope<float> scope;
 
-        for (size_t b = 0; b < Batch; ++b) {
-            for (size_t t = 0; t < time_steps; ++t) {
-                delta_t(t)(b) = context.errors(b)(t);
-            }
-        }
+        auto delta_t = scope.matrix<3>(time_steps, Batch, hidden_units);
+
+        this->read_errors(delta_t, context.errors);
 
         // 2. Get gradients from the context
 
@@ -371,85 +382,91 @@ struct lstm_layer_impl final : base_lstm_layer<lstm_layer_impl<Desc>, Desc> {
 
         // 3. Backpropagation through time
 
-        size_t ttt = time_steps - 1;
-
-        do {
-            const size_t last_step = std::max(int(time_steps) - int(bptt_steps), 0);
-
-            // Backpropagation through time
-            for(int tt = ttt; tt >= int(last_step); --tt){
-                const size_t t = tt;
-
-                if (t == time_steps - 1) {
-                    d_h_t(t) = delta_t(t);
-                    d_c_t(t) = (o_t(t) >> d_h_t(t)) >> f_derivative<activation_function>(s_t(t));
-                } else {
-                    d_h_t(t) = delta_t(t) + d_h_t(t + 1);
-                    d_c_t(t) = ((o_t(t) >> d_h_t(t)) >> f_derivative<activation_function>(s_t(t))) + d_c_t(t + 1);
-                }
+        // With variable length sequences, the steps after the end of the
+        // longest sequence have no errors
+        const size_t steps = this->backward_steps();
 
-                d_h_o_t(t) = etl::ml::sigmoid_backward(o_t(t), s_t(t) >> d_h_t(t));
-                d_h_i_t(t) = etl::ml::sigmoid_backward(i_t(t), g_t(t) >> d_c_t(t));
-                d_h_c_t(t) = etl::ml::tanh_backward(g_t(t), i_t(t) >> d_c_t(t));
+        for (size_t t = steps; t < time_steps; ++t) {
+            d_h_t(t) = 0;
+            d_c_t(t) = 0;
+            d_x_t(t) = 0;
+        }
 
-                if (t == 0) {
-                    d_h_f_t(t) = 0;
-                } else {
-                    d_h_f_t(t) = etl::ml::sigmoid_backward(f_t(t), s_t(t - 1) >> d_c_t(t));
+        if (steps) {
+            size_t ttt = steps - 1;
+
+            do {
+                const size_t last_step = std::max(int(time_steps) - int(bptt_steps), 0);
+
+                // Backpropagation through time
+                for(int tt = ttt; tt >= int(last_step); --tt){
+                    const size_t t = tt;
+
+                    if (t == time_steps - 1) {
+                        d_h_t(t) = delta_t(t);
+                        d_c_t(t) = (o_t(t) >> d_h_t(t)) >> f_derivative<activation_function>(s_t(t));
+                    } else {
+                        d_h_t(t) = delta_t(t) + d_h_t(t + 1);
+                        d_c_t(t) = ((o_t(t) >> d_h_t(t)) >> f_derivative<activation_function>(s_t(t))) + d_c_t(t + 1);
+                    }
+
+                    d_h_o_t(t) = etl::ml::sigmoid_backward(o_t(t), s_t(t) >> d_h_t(t));
+                    d_h_i_t(t) = etl::ml::sigmoid_backward(i_t(t), g_t(t) >> d_c_t(t));
+                    d_h_c_t(t) = etl::ml::tanh_backward(g_t(t), i_t(t) >> d_c_t(t));
+
+                    if (t == 0) {
+                        d_h_f_t(t) = 0;
+                    } else {
+                        d_h_f_t(t) = etl::ml::sigmoid_backward(f_t(t), s_t(t - 1) >> d_c_t(t));
+                    }
+
+                    b_o_grad += bias_batch_sum_2d(d_h_o_t(t));
+                    b_i_grad += bias_batch_sum_2d(d_h_i_t(t));
+                    b_f_grad += bias_batch_sum_2d(d_h_f_t(t));
+                    b_g_grad += bias_batch_sum_2d(d_h_c_t(t));
+
+                    u_o_grad += batch_outer(x_t(t), d_h_o_t(t));
+                    u_i_grad += batch_outer(x_t(t), d_h_i_t(t));
+                    u_f_grad += batch_outer(x_t(t), d_h_f_t(t));
+                    u_g_grad += batch_outer(x_t(t), d_h_c_t(t));
+
+                    if(t > 0){
+                        w_o_grad += batch_outer(h_t(t - 1), d_h_o_t(t));
+                        w_i_grad += batch_outer(h_t(t - 1), d_h_i_t(t));
+                        w_f_grad += batch_outer(h_t(t - 1), d_h_f_t(t));
+                        w_g_grad += batch_outer(h_t(t - 1), d_h_c_t(t));
+                    }
+
+                    // The part going back to x
+                    d_x_o_t(t) = d_h_o_t(t) * trans(u_o);
+                    d_x_i_t(t) = d_h_i_t(t) * trans(u_i);
+                    d_x_f_t(t) = d_h_f_t(t) * trans(u_f);
+                    d_x_c_t(t) = d_h_c_t(t) * trans(u_g);
+
+                    d_x_t(t) = d_x_o_t(t) + d_x_i_t(t) + d_x_f_t(t) + d_x_c_t(t);
+
+                    // The part going back to h
+                    d_xh_o_t(t) = d_h_o_t(t) * trans(w_o);
+                    d_xh_i_t(t) = d_h_i_t(t) * trans(w_i);
+                    d_xh_f_t(t) = d_h_f_t(t) * trans(w_f);
+                    d_xh_c_t(t) = d_h_c_t(t) * trans(w_g);
+
+                    // Update for the next step
+                    d_h_t(t) = d_xh_o_t(t) + d_xh_i_t(t) + d_xh_f_t(t) + d_xh_c_t(t);
+                    d_c_t(t) = f_t(t) >> d_c_t(t);
                 }
 
-                b_o_grad += bias_batch_sum_2d(d_h_o_t(t));
-                b_i_grad += bias_batch_sum_2d(d_h_i_t(t));
-                b_f_grad += bias_batch_sum_2d(d_h_f_t(t));
-                b_g_grad += bias_batch_sum_2d(d_h_c_t(t));
-
-                u_o_grad += batch_outer(x_t(t), d_h_o_t(t));
-                u_i_grad += batch_outer(x_t(t), d_h_i_t(t));
-                u_f_grad += batch_outer(x_t(t), d_h_f_t(t));
-                u_g_grad += batch_outer(x_t(t), d_h_c_t(t));
-
-                if(t > 0){
-                    w_o_grad += batch_outer(h_t(t - 1), d_h_o_t(t));
-                    w_i_grad += batch_outer(h_t(t - 1), d_h_i_t(t));
-                    w_f_grad += batch_outer(h_t(t - 1), d_h_f_t(t));
-                    w_g_grad += batch_outer(h_t(t - 1), d_h_c_t(t));
+                // If only the last time step is used, no need to use the other errors
+                if constexpr (desc::parameters::template contains<last_only>()) {
+                    break;
                 }
-
-                // The part going back to x
-                d_x_o_t(t) = d_h_o_t(t) * trans(u_o);
-                d_x_i_t(t) = d_h_i_t(t) * trans(u_i);
-                d_x_f_t(t) = d_h_f_t(t) * trans(u_f);
-                d_x_c_t(t) = d_h_c_t(t) * trans(u_g);
-
-                d_x_t(t) = d_x_o_t(t) + d_x_i_t(t) + d_x_f_t(t) + d_x_c_t(t);
-
-                // The part going back to h
-                d_xh_o_t(t) = d_h_o_t(t) * trans(w_o);
-                d_xh_i_t(t) = d_h_i_t(t) * trans(w_i);
-                d_xh_f_t(t) = d_h_f_t(t) * trans(w_f);
-                d_xh_c_t(t) = d_h_c_t(t) * trans(w_g);
-
-                // Update for the next step
-                d_h_t(t) = d_xh_o_t(t) + d_xh_i_t(t) + d_xh_f_t(t) + d_xh_c_t(t);
-                d_c_t(t) = f_t(t) >> d_c_t(t);
-            }
-
-            --ttt;
-
-            // If only the last time step is used, no need to use the other errors
-            if constexpr (desc::parameters::template contains<last_only>()) {
-                break;
-            }
-        } while (ttt != 0);
+            } while (ttt-- > 1);
+        }
 
         // 3. Rearrange for the output
 
         if (direct) {
-            for (size_t b = 0; b < Batch; ++b) {
-                for (size_t t = 0; t < time_steps; ++t) {
-                    output(b)(t) = d_x_t(t)(b);
-                }
-            }
+            swap_batch_time(output, d_x_t);
         }
     }
 
@@ -523,9 +540,19 @@ struct sgd_context<DBN, lstm_layer_impl<Desc>, L> {
     static constexpr size_t layer    = L;               ///< The index of the layer
     static constexpr auto batch_size = DBN::batch_size; ///< The batch size of the network
 
+    static constexpr bool last_step = rnn_last_step<DBN, layer_t, L>(); ///< Indicates if only the last time step is output
+
+    /*!
+     * \brief The type of a batch of output, only the last time step when
+     * the layer is followed by a recurrent_last layer
+     */
+    using outputs_t = std::conditional_t<last_step,
+                                         etl::fast_matrix<weight, batch_size, hidden_units>,
+                                         etl::fast_matrix<weight, batch_size, time_steps, hidden_units>>;
+
     etl::fast_matrix<weight, batch_size, time_steps, sequence_length> input;
-    etl::fast_matrix<weight, batch_size, time_steps, hidden_units> output;
-    etl::fast_matrix<weight, batch_size, time_steps, hidden_units> errors;
+    outputs_t output;
+    outputs_t errors;
 
     sgd_context(const lstm_layer_impl<Desc>& /* layer */)
             : output(0.0), errors(0.0) {}
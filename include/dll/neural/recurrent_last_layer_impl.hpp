@@ -8,8 +8,10 @@
 #pragma once
 
 #include "dll/base_traits.hpp"
+#include "dll/dbn_traits.hpp"
 
-#include "dll/util/timers.hpp" // for auto_timer
+#include "dll/util/timers.hpp"     // for auto_timer
+#include "dll/util/time_major.hpp" // for is_last_step
 
 namespace dll {
 
@@ -25,6 +27,8 @@ struct recurrent_last_layer_impl final : layer<recurrent_last_layer_impl<Desc>>
     using layer_t     = this_type;                       ///< This layer's type
     using dyn_layer_t = typename desc::dyn_layer_t;      ///< The dynamic version of this layer
 
+    static constexpr bool recurrent_last = true; ///< The layer extracts the last time step of the sequences
+
     static constexpr size_t time_steps   = desc::time_steps;   ///< The number of time steps
     static constexpr size_t hidden_units = desc::hidden_units; ///< The number of hidden units
 
@@ -102,8 +106,13 @@ struct recurrent_last_layer_impl final : layer<recurrent_last_layer_impl<Desc>>
 
         cpp_assert(etl::dim<0>(output) == Batch, "The number of samples must be consistent");
 
-        for(size_t b = 0; b < Batch; ++b){
-            output(b) = input(b)(time_steps - 1);
+        if constexpr (is_last_step<V>) {
+            // The recurrent layer only gave the last time step
+            output = input;
+        } else {
+            for (size_t b = 0; b < Batch; ++b) {
+                output(b) = input(b)(time_steps - 1);
+            }
         }
     }
 
@@ -162,12 +171,17 @@ struct recurrent_last_layer_impl final : layer<recurrent_last_layer_impl<Desc>>
     void backward_batch(H&& output, C& context) const {
         dll::auto_timer timer("recurrent_last:backward_batch");
 
-        const auto Batch = etl::dim<0>(output);
+        if constexpr (is_last_step<H>) {
+            // The recurrent layer only needs the errors of the last time step
+            output = context.errors;
+        } else {
+            const auto Batch = etl::dim<0>(output);
 
-        output = 0;
+            output = 0;
 
-        for(size_t b = 0; b < Batch; ++b){
-            output(b)(time_steps - 1) = context.errors(b);
+            for (size_t b = 0; b < Batch; ++b) {
+                output(b)(time_steps - 1) = context.errors(b);
+            }
         }
     }
 
@@ -223,7 +237,17 @@ struct sgd_context<DBN, recurrent_last_layer_impl<Desc>, L> {
 
     static constexpr auto batch_size = DBN::batch_size;
 
-    etl::fast_matrix<weight, batch_size, time_steps, hidden_units> input;
+    static constexpr bool last_step = rnn_last_step_input<DBN, L>(); ///< Indicates if only the last time step is input
+
+    /*!
+     * \brief The type of a batch of input, only the last time step when
+     * the recurrent layer before does not output the complete sequences
+     */
+    using inputs_t = std::conditional_t<last_step,
+                                        etl::fast_matrix<weight, batch_size, hidden_units>,
+                                        etl::fast_matrix<weight, batch_size, time_steps, hidden_units>>;
+
+    inputs_t input;
     etl::fast_matrix<weight, batch_size, hidden_units> output;
     etl::fast_matrix<weight, batch_size, hidden_units> errors;
 
@@ -8,6 +8,7 @@
 #pragma once
 
 #include "dll/base_traits.hpp"
+#include "dll/dbn_traits.hpp"
 #include "dll/base_rnn_layer.hpp"
 
 #include "dll/util/timers.hpp" // for auto_timer
@@ -32,6 +33,8 @@ struct rnn_layer_impl final : base_rnn_layer<rnn_layer_impl<Desc>, Desc> {
 
     static constexpr size_t bptt_steps = desc::Truncate == 0 ? time_steps : desc::Truncate; ///< The number of bptt steps
 
+    static_assert(desc::BpttWindow == 0 || time_steps % desc::BpttWindow == 0, "The BPTT window must divide the number of time steps");
+
     static constexpr auto activation_function = desc::activation_function; ///< The layer's activation function
 
     using w_initializer = typename desc::w_initializer; ///< The initializer for the W weights
@@ -91,6 +94,22 @@ struct rnn_layer_impl final : base_rnn_layer<rnn_layer_impl<Desc>, Desc> {
         return hidden_units * hidden_units + hidden_units * sequence_length + hidden_units;
     }
 
+    /*!
+     * \brief Returns the number of floating point operations of the
+     * forward pass of one sample
+     */
+    static constexpr size_t forward_flops() noexcept {
+        return 2 * time_steps * hidden_units * (sequence_length + hidden_units);
+    }
+
+    /*!
+     * \brief Returns the number of floating point operations of the
+     * backward pass (errors and gradients) of one sample
+     */
+    static constexpr size_t backward_flops() noexcept {
+        return 4 * time_steps * hidden_units * (sequence_length + hidden_units);
+    }
+
     /*!
      * \brief Returns a short description of the layer
      * \return an std::string containing a short description of the layer
@@ -139,7 +158,8 @@ struct rnn_layer_impl final : base_rnn_layer<rnn_layer_impl<Desc>, Desc> {
      * \brief Apply the layer to the given batch of input.
      *
      * \param x A batch of input
-     * \param output A batch of output that will be filled
+     * \param output A batch of output that will be filled, with the complete
+     * sequences or only their last time step
      */
     template <typename H, typename V>
     void forward_batch(H&& output, const V& x) const {
@@ -266,9 +286,19 @@ struct sgd_context<DBN, rnn_layer_impl<Desc>, L> {
     static constexpr size_t layer    = L;               ///< The index of the layer
     static constexpr auto batch_size = DBN::batch_size; ///< The batch size of the network
 
+    static constexpr bool last_step = rnn_last_step<DBN, layer_t, L>(); ///< Indicates if only the last time step is output
+
+    /*!
+     * \brief The type of a batch of output, only the last time step when
+     * the layer is followed by a recurrent_last layer
+     */
+    using outputs_t = std::conditional_t<last_step,
+                                         etl::fast_matrix<weight, batch_size, hidden_units>,
+                                         etl::fast_matrix<weight, batch_size, time_steps, hidden_units>>;
+
     etl::fast_matrix<weight, batch_size, time_steps, sequence_length> input;
-    etl::fast_matrix<weight, batch_size, time_steps, hidden_units> output;
-    etl::fast_matrix<weight, batch_size, time_steps, hidden_units> errors;
+    outputs_t output;
+    outputs_t errors;
 
     sgd_context(const rnn_layer_impl<Desc>& /* layer */)
             : output(0.0), errors(0.0) {}
@@ -58,6 +58,17 @@ struct neural_layer : layer<Derived> {
     void restore_weights() {
         as_derived().w = *as_derived().bak_w;
         as_derived().b = *as_derived().bak_b;
+
+        as_derived().weights_changed();
+    }
+
+    /*!
+     * \brief Indicates that the weights have been modified. This does
+     * nothing by default, the layers caching values computed from the
+     * weights refresh them.
+     */
+    void weights_changed() {
+        // Nothing to do by default
     }
 
     /*!
@@ -74,6 +85,8 @@ struct neural_layer : layer<Derived> {
     void load(std::istream& is) {
         cpp::binary_load_all(is, as_derived().w);
         cpp::binary_load_all(is, as_derived().b);
+
+        as_derived().weights_changed();
     }
 
     /*!
@@ -0,0 +1,41 @@
+//=======================================================================
+// Copyright (c) 2014-2017 Baptiste Wicht
+// Distributed under the terms of the MIT License.
+// (See accompanying file LICENSE or copy at
+//  http://opensource.org/licenses/MIT)
+//=======================================================================
+
+#pragma once
+
+namespace dll {
+
+/*!
+ * \brief The type of noise applied on the inputs by the generators
+ */
+enum class noise_type {
+    MASKING,    ///< Set N% of the values to zero
+    GAUSSIAN,   ///< Add a gaussian noise of standard deviation N/100
+    SALT_PEPPER ///< Set N% of the values to zero or one
+};
+
+/*!
+ * \brief Returns a string representation of a noise type
+ * \param t The noise type to transform to string
+ * \return a string representation of a noise type
+ */
+inline std::string to_string(noise_type t) {
+    switch (t) {
+        case noise_type::MASKING:
+            return "MASKING";
+        case noise_type::GAUSSIAN:
+            return "GAUSSIAN";
+        case noise_type::SALT_PEPPER:
+            return "SALT_PEPPER";
+    }
+
+    cpp_unreachable("Unreachable code");
+
+    return "UNDEFINED";
+}
+
+} //end of dll namespace
@@ -0,0 +1,293 @@
+//=======================================================================
+// Copyright (c) 2014-2017 Baptiste Wicht
+// Distributed under the terms of the MIT License.
+// (See accompanying file LICENSE or copy at
+//  http://opensource.org/licenses/MIT)
+//=======================================================================
+
+/*!
+ * \file
+ * \brief Parallel Tempering trainer for RBM
+ *
+ * The negative phase is computed from several persistent chains sampling
+ * the model at different inverse temperatures (the ladder goes linearly
+ * from 1 to pt_beta_min). After each Gibbs step, the states of adjacent
+ * chains are swapped with the Metropolis acceptance ratio computed from
+ * the tempered free energies. Only the chain at temperature 1 is used
+ * for the gradients, the others help it to move between the modes.
+ */
+
+#pragma once
+
+#include "dll/contrastive_divergence.hpp"
+#include "dll/util/random.hpp"
+
+namespace dll {
+
+/*!
+ * \brief Parallel Tempering trainer for dense RBM with binary units.
+ *
+ * The number of chains is taken from the pt_chains field of the RBM and
+ * the chains are advanced concurrently on a thread pool.
+ */
+template <typename RBM>
+struct pt_cd_trainer : base_cd_trainer<1, RBM, true> {
+    using rbm_t     = RBM;                             ///< The type of RBM being trained
+    using weight    = typename rbm_t::weight;          ///< The data type for this layer
+    using base_type = base_cd_trainer<1, RBM, true>;   ///< The base trainer
+
+    static_assert(!layer_traits<rbm_t>::is_convolutional_rbm_layer(), "pt_cd_trainer only supports dense RBM");
+    static_assert(rbm_t::visible_unit == unit_type::BINARY, "pt_cd_trainer only supports binary visible units");
+    static_assert(rbm_t::hidden_unit == unit_type::BINARY, "pt_cd_trainer only supports binary hidden units");
+
+    static constexpr auto batch_size = rbm_t::batch_size; ///< The batch size of the RBM
+
+    const size_t M; ///< The number of chains
+
+    std::vector<weight> betas;                 ///< The inverse temperature of each chain
+    std::vector<etl::dyn_matrix<weight>> v;    ///< The visible states of each chain
+    std::vector<etl::dyn_matrix<weight>> h;    ///< The hidden states of each chain
+    std::vector<etl::dyn_matrix<weight>> pre;  ///< The hidden pre-activations (without biases) of each chain
+    std::vector<etl::dyn_vector<weight>> cv;   ///< The visible energy term of each chain
+    std::vector<lane_random> generators;       ///< The random generator of each chain
+
+    size_t parity = 0; ///< The parity of the next swap sweep
+
+    cpp::thread_pool<true> pool; ///< The pool advancing the chains
+
+    /*!
+     * \brief Construct a new pt_cd_trainer for the given RBM
+     */
+    explicit pt_cd_trainer(rbm_t& rbm) : base_type(rbm), M(std::max(size_t(2), rbm.pt_chains)) {
+        const size_t NV = etl::dim<1>(this->v1);
+        const size_t NH = etl::dim<1>(this->h1_a);
+
+        for (size_t m = 0; m < M; ++m) {
+            betas.push_back(weight(1.0 - double(m) * (1.0 - rbm.pt_beta_min) / double(M - 1)));
+
+            v.emplace_back(batch_size, NV);
+            h.emplace_back(batch_size, NH);
+            pre.emplace_back(batch_size, NH);
+            cv.emplace_back(batch_size);
+            generators.emplace_back(dll::rand_engine()());
+        }
+    }
+
+    /*!
+     * \brief Train the RBM with one batch of data
+     */
+    template <typename InputBatch, typename ExpectedBatch>
+    void train_batch(InputBatch& input_batch, ExpectedBatch& expected_batch, rbm_training_context& context) {
+        dll::auto_timer timer("pt:train:normal");
+
+        using namespace etl;
+
+        auto& t = *this;
+
+        cpp_assert(etl::dim<0>(input_batch) == etl::dim<0>(expected_batch), "Invalid batch sizes");
+
+        const size_t B = etl::dim<0>(t.v1);
+
+        //Copy input/expected for computations
+        copy_batch(t.v1, input_batch);
+        copy_batch(t.vf, expected_batch);
+
+        //Positive phase
+        t.rbm.template batch_activate_hidden<true, false>(t.h1_a, t.h1_a, t.v1, t.v1);
+
+        //The chains start from the first batch
+        if (t.init) {
+            for (auto& chain : v) {
+                chain = t.v1;
+            }
+
+            t.init = false;
+        }
+
+        //Advance all the chains by one Gibbs step
+        cpp::maybe_parallel_foreach_n(pool, 0, M, [this](size_t m) {
+            SERIAL_SECTION {
+                gibbs_step(m);
+            }
+        });
+
+        swap_chains();
+
+        //Negative phase from the chain at temperature 1
+        t.v2_a = v[0];
+        t.rbm.template batch_activate_hidden<true, false>(t.h2_a, t.h2_a, t.v2_a, t.v2_a);
+
+        {
+            dll::auto_timer timer("pt:batch_compute_gradients");
+
+            t.w_grad = batch_outer(t.vf, t.h1_a);
+
+            if constexpr (has_scratch_arena<pt_cd_trainer>::value) {
+                t.scratch.reset();
+
+                auto w_neg = t.scratch.template matrix<2>(etl::dim<0>(t.w_grad), etl::dim<1>(t.w_grad));
+
+                w_neg = batch_outer(t.v2_a, t.h2_a);
+                t.w_grad -= w_neg;
+            } else {
+                t.w_grad -= batch_outer(t.v2_a, t.h2_a);
+            }
+
+            t.b_grad = t.h1_a(0) - t.h2_a(0);
+            for (size_t b = 1; b < B; b++) {
+                t.b_grad += t.h1_a(b) - t.h2_a(b);
+            }
+
+            t.c_grad = t.vf(0) - t.v2_a(0);
+            for (size_t b = 1; b < B; b++) {
+                t.c_grad += t.vf(b) - t.v2_a(b);
+            }
+        }
+
+        if (context.monitor) {
+            context.batch_error = mean((t.vf - t.v2_a) >> (t.vf - t.v2_a));
+        }
+
+        nan_check_deep_3(t.w_grad, t.b_grad, t.c_grad);
+
+        //Compute the mean activation probabilities
+        t.q_global_batch = mean(t.h2_a);
+
+        if constexpr (rbm_layer_traits<rbm_t>::sparsity_method() == sparsity_method::LOCAL_TARGET) {
+            t.q_local_batch = mean_l(t.h2_a);
+        }
+
+        context.batch_sparsity = t.q_global_batch;
+
+        //Update the weights and biases based on the gradients
+        t.update(t.rbm);
+    }
+
+    /*!
+     * \brief Return the name of the trainer
+     */
+    static std::string name() {
+        return "Parallel Tempering";
+    }
+
+private:
+    /*!
+     * \brief Advance one chain by one tempered Gibbs step and compute the
+     * terms of its free energy
+     * \param m The index of the chain
+     */
+    void gibbs_step(size_t m) {
+        const weight beta = betas[m];
+
+        h[m] = v[m] * this->rbm.w;
+        tempered_sample(h[m], this->rbm.b, beta, generators[m]);
+
+        v[m] = h[m] * transpose(this->rbm.w);
+        tempered_sample(v[m], this->rbm.c, beta, generators[m]);
+
+        pre[m] = v[m] * this->rbm.w;
+
+        for (size_t r = 0; r < batch_size; ++r) {
+            cv[m][r] = etl::dot(this->rbm.c, v[m](r));
+        }
+    }
+
+    /*!
+     * \brief Sample binary units at the given inverse temperature
+     * \param x The pre-activations (without biases), set to the samples
+     * \param bias The biases of the units
+     * \param beta The inverse temperature
+     * \param rng The random generator
+     */
+    template <typename X, typename Bias>
+    static void tempered_sample(X& x, const Bias& bias, weight beta, lane_random& rng) {
+        const size_t N = etl::size(bias);
+
+        x.ensure_cpu_up_to_date();
+        bias.ensure_cpu_up_to_date();
+
+        weight* x_ptr       = x.memory_start();
+        const weight* b_ptr = bias.memory_start();
+
+        for (size_t i = 0; i < etl::dim<0>(x); ++i) {
+            weight* row = x_ptr + i * N;
+
+            for (size_t j = 0; j < N; ++j) {
+                const weight p = weight(1) / (weight(1) + std::exp(-beta * (row[j] + b_ptr[j])));
+
+                row[j] = rng() < p ? weight(1) : weight(0);
+            }
+        }
+
+        x.invalidate_gpu();
+    }
+
+    /*!
+     * \brief Compute the tempered free energy of a visible state of a chain
+     * \param m The index of the chain
+     * \param r The row of the state in the chain
+     * \param beta The inverse temperature
+     */
+    weight free_energy(size_t m, size_t r, weight beta) const {
+        const size_t NH = etl::dim<1>(pre[m]);
+
+        const weight* x     = pre[m].memory_start() + r * NH;
+        const weight* b_ptr = this->rbm.b.memory_start();
+
+        weight energy = -beta * cv[m][r];
+
+        for (size_t j = 0; j < NH; ++j) {
+            const weight a = beta * (x[j] + b_ptr[j]);
+
+            // Stable softplus
+            energy -= a > weight(20) ? a : std::log1p(std::exp(a));
+        }
+
+        return energy;
+    }
+
+    /*!
+     * \brief Propose to swap the states of adjacent chains, alternatively
+     * the even and the odd pairs
+     */
+    void swap_chains() {
+        dll::auto_timer timer("pt:swap");
+
+        for (size_t m = 0; m < M; ++m) {
+            pre[m].ensure_cpu_up_to_date();
+            v[m].ensure_cpu_up_to_date();
+        }
+
+        this->rbm.b.ensure_cpu_up_to_date();
+
+        std::uniform_real_distribution<double> dist(0.0, 1.0);
+
+        const size_t NV = etl::dim<1>(v[0]);
+        const size_t NH = etl::dim<1>(pre[0]);
+
+        for (size_t m = parity; m + 1 < M; m += 2) {
+            const weight b1 = betas[m];
+            const weight b2 = betas[m + 1];
+
+            for (size_t r = 0; r < batch_size; ++r) {
+                const double delta = free_energy(m, r, b1) + free_energy(m + 1, r, b2)
+                                   - free_energy(m, r, b2) - free_energy(m + 1, r, b1);
+
+                if (delta >= 0.0 || std::log(dist(dll::rand_engine())) < delta) {
+                    std::swap_ranges(v[m].memory_start() + r * NV, v[m].memory_start() + (r + 1) * NV, v[m + 1].memory_start() + r * NV);
+                    std::swap_ranges(pre[m].memory_start() + r * NH, pre[m].memory_start() + (r + 1) * NH, pre[m + 1].memory_start() + r * NH);
+                    std::swap(cv[m][r], cv[m + 1][r]);
+                }
+            }
+        }
+
+        for (size_t m = 0; m < M; ++m) {
+            pre[m].invalidate_gpu();
+            v[m].invalidate_gpu();
+        }
+
+        parity = 1 - parity;
+    }
+};
+
+} //end of dll namespace
@@ -0,0 +1,250 @@
+//=======================================================================
+// Copyright (c) 2014-2017 Baptiste Wicht
+// Distributed under the terms of the MIT License.
+// (See accompanying file LICENSE or copy at
+//  http://opensource.org/licenses/MIT)
+//=======================================================================
+
+/*!
+ * \file
+ * \brief Inference with pipeline model parallelism across groups of layers
+ */
+
+#pragma once
+
+#include <array>
+#include <memory>
+#include <tuple>
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <type_traits>
+
+#include "cpp_utils/assert.hpp"
+
+#include "etl/etl.hpp"
+
+#include "dll/inference_session.hpp"
+#include "dll/util/pipeline_stages.hpp"
+
+namespace dll {
+
+namespace pipeline_detail {
+
+/*!
+ * \brief Indicates if the cuts leave at least one layer to each stage
+ */
+template <size_t Layers, size_t... Cuts>
+constexpr bool ordered_cuts() {
+    constexpr size_t cuts[] = {Cuts...};
+
+    size_t first = 0;
+
+    for (size_t cut : cuts) {
+        if (cut < first || cut + 1 >= Layers) {
+            return false;
+        }
+
+        first = cut + 1;
+    }
+
+    return true;
+}
+
+} //end of namespace pipeline_detail
+
+/*!
+ * \brief A network whose layers are split into stages forwarding the
+ * micro-batches of a batch concurrently.
+ *
+ * The stage s owns the layers after the cut s - 1 up to the cut s, with
+ * its own inference session and its own thread, pinned with
+ * execution().stages. A batch is split into micro-batches that flow in
+ * order from one stage to the next through bounded buffers, so that the
+ * stages work on different micro-batches at the same time, each stage
+ * keeping the weights of its layers in the caches of its cores.
+ *
+ * The network is only read: a pipeline must only be used by one thread at
+ * a time.
+ */
+template <typename DBN, size_t... Cuts>
+struct dbn_pipeline {
+    static_assert(sizeof...(Cuts) > 0, "A pipeline needs at least one cut");
+
+    using weight    = typename DBN::weight;       ///< The data type of the outputs
+    using session_t = dbn_inference_session<DBN>; ///< The type of the session of a stage
+    using output_t  = etl::dyn_matrix<weight, 2>; ///< The type of the outputs [B, C]
+
+    static constexpr size_t stages   = sizeof...(Cuts) + 1; ///< The number of stages
+    static constexpr size_t capacity = 2;                   ///< The number of micro-batches buffered between two stages
+
+    static constexpr std::array<size_t, stages + 1> bounds = {{0, (Cuts + 1)..., DBN::layers}}; ///< The first layer of each stage
+
+    static_assert(pipeline_detail::ordered_cuts<DBN::layers, Cuts...>(), "The cuts of a pipeline must be in order, before the last layer of the network");
+
+    size_t micro_batch; ///< The number of samples of a micro-batch
+
+    /*!
+     * \brief Create a pipeline of the given network
+     * \param dbn The network
+     * \param micro_batch The number of samples of a micro-batch
+     */
+    dbn_pipeline(const DBN& dbn, size_t micro_batch) : micro_batch(micro_batch), workers(stages), done(stages) {
+        for (size_t s = 0; s < stages; ++s) {
+            sessions.push_back(std::make_unique<session_t>(dbn));
+        }
+    }
+
+    dbn_pipeline(const dbn_pipeline& rhs) = delete;
+    dbn_pipeline& operator=(const dbn_pipeline& rhs) = delete;
+
+    /*!
+     * \brief Forward the given batch through the pipeline
+     * \param input The input batch
+     * \return The outputs of the batch [B, C]
+     */
+    template <typename Input>
+    output_t forward_batch(const Input& input) {
+        using input_t = etl::dyn_matrix<weight, etl::dimensions<Input>()>;
+
+        const size_t n      = etl::dim<0>(input);
+        const size_t micros = (n + micro_batch - 1) / micro_batch;
+
+        // The buffers of the inputs of each stage
+        decltype(stage_buffers<0, input_t>()) buffers;
+
+        output_t result;
+
+        done.reset();
+
+        workers.run([&](size_t s) {
+            for (size_t r = 0; r < micros; ++r) {
+                run_stage<0>(s, r, input, buffers, result, n);
+
+                done.publish(s);
+            }
+        });
+
+        return result;
+    }
+
+    /*!
+     * \brief Predict the class of each sample of the given batch
+     * \param input The input batch
+     * \return The predicted class of each sample
+     */
+    template <typename Input>
+    std::vector<size_t> predict_batch(const Input& input) {
+        auto result = forward_batch(input);
+
+        std::vector<size_t> labels(etl::dim<0>(result));
+
+        for (size_t b = 0; b < labels.size(); ++b) {
+            labels[b] = std::distance(result(b).begin(), std::max_element(result(b).begin(), result(b).end()));
+        }
+
+        return labels;
+    }
+
+private:
+    /*!
+     * \brief Build the buffers of the inputs of the stages [S, stages)
+     * given the type of the input of the stage S
+     */
+    template <size_t S, typename In>
+    static auto stage_buffers() {
+        if constexpr (S == stages) {
+            return std::tuple<>();
+        } else {
+            using out_t = std::decay_t<decltype(std::declval<session_t&>().template forward_batch<bounds[S + 1] - 1, bounds[S]>(std::declval<const In&>()))>;
+
+            return std::tuple_cat(std::tuple<std::array<In, capacity>>(), stage_buffers<S + 1, out_t>());
+        }
+    }
+
+    /*!
+     * \brief Forward the micro-batch r through the stage s
+     */
+    template <size_t S, typename Input, typename Buffers>
+    void run_stage(size_t s, size_t r, const Input& input, Buffers& buffers, output_t& result, size_t n) {
+        if constexpr (S < stages) {
+            if (s != S) {
+                run_stage<S + 1>(s, r, input, buffers, result, n);
+                return;
+            }
+
+            auto& slot = std::get<S>(buffers)[r % capacity];
+
+            if constexpr (S == 0) {
+                const size_t first = r * micro_batch;
+                const size_t last  = std::min(n, first + micro_batch);
+
+                slot = copy_rows(input, first, last, std::make_index_sequence<etl::dimensions<Input>() - 1>());
+            } else {
+                // Wait for the micro-batch from the previous stage
+                done.wait(S - 1, r + 1);
+            }
+
+            auto output = sessions[S]->template forward_batch<bounds[S + 1] - 1, bounds[S]>(slot);
+
+            if constexpr (S + 1 < stages) {
+                // Wait for the next stage to release the slot
+                if (r >= capacity) {
+                    done.wait(S + 1, r + 1 - capacity);
+                }
+
+                std::get<S + 1>(buffers)[r % capacity] = std::move(output);
+            } else {
+                const size_t m = etl::dim<0>(output);
+                const size_t C = etl::size(output) / m;
+
+                if (etl::dim<0>(result) != n || etl::dim<1>(result) != C) {
+                    result = output_t(n, C);
+                }
+
+                etl::slice(result, r * micro_batch, r * micro_batch + m) = etl::reshape(output, m, C);
+            }
+        } else {
+            cpp_unused(s);
+            cpp_unused(r);
+            cpp_unused(input);
+            cpp_unused(buffers);
+            cpp_unused(result);
+            cpp_unused(n);
+        }
+    }
+
+    /*!
+     * \brief Copy the rows [first, last) of the given batch
+     */
+    template <typename Input, size_t... D>
+    static etl::dyn_matrix<weight, sizeof...(D) + 1> copy_rows(const Input& input, size_t first, size_t last, std::index_sequence<D...> /*seq*/) {
+        etl::dyn_matrix<weight, sizeof...(D) + 1> rows(last - first, etl::dim<D + 1>(input)...);
+
+        rows = etl::slice(input, first, last);
+
+        return rows;
+    }
+
+    std::vector<std::unique_ptr<session_t>> sessions; ///< The session of each stage
+
+    stage_workers workers; ///< The thread of each stage
+    stage_progress done;   ///< The micro-batches forwarded by each stage
+};
+
+/*!
+ * \brief Create a pipeline of the given network
+ *
+ * \tparam Cuts The last layer of each stage, except the last one
+ *
+ * \param dbn The network
+ * \param micro_batch The number of samples of a micro-batch
+ *
+ * \return The pipeline
+ */
+template <size_t... Cuts, typename DBN>
+std::unique_ptr<dbn_pipeline<DBN, Cuts...>> make_pipeline(const DBN& dbn, size_t micro_batch) {
+    return std::make_unique<dbn_pipeline<DBN, Cuts...>>(dbn, micro_batch);
+}
+
+} //end of dll namespace
@@ -9,6 +9,8 @@
 
 #include "pooling_layer.hpp"
 
+#include "dll/util/pooling.hpp"
+
 namespace dll {
 
 /*!
@@ -28,6 +30,8 @@ struct avgp_2d_layer_impl final : pooling_2d_layer<avgp_2d_layer_impl<Desc>, Des
     using input_t      = typename base::input_t;      ///< The type of many input
     using output_t     = typename base::output_t;     ///< The type of many output
 
+    static constexpr bool conv_fusion = true; ///< The layer can pool the output of a convolution on the fly
+
     avgp_2d_layer_impl() = default;
 
     /*!
@@ -46,8 +50,13 @@ struct avgp_2d_layer_impl final : pooling_2d_layer<avgp_2d_layer_impl<Desc>, Des
         cpp_unused(pre);
 
         char buffer[1024];
-        snprintf(buffer, 1024, "AVGP(2d): %lux%lux%lu -> (%lux%lu) -> %lux%lux%lu",
-                 base::I1, base::I2, base::I3, base::C1, base::C2, base::O1, base::O2, base::O3);
+        if (base::is_strided) {
+            snprintf(buffer, 1024, "AVGP(2d): %lux%lux%lu -> (%lux%lu, S%lux%lu, P%lux%lu) -> %lux%lux%lu",
+                     base::I1, base::I2, base::I3, base::C1, base::C2, base::S1, base::S2, base::P1, base::P2, base::O1, base::O2, base::O3);
+        } else {
+            snprintf(buffer, 1024, "AVGP(2d): %lux%lux%lu -> (%lux%lu) -> %lux%lux%lu",
+                     base::I1, base::I2, base::I3, base::C1, base::C2, base::O1, base::O2, base::O3);
+        }
         return {buffer};
     }
 
@@ -68,7 +77,11 @@ struct avgp_2d_layer_impl final : pooling_2d_layer<avgp_2d_layer_impl<Desc>, Des
      */
     template <typename Input, typename Output>
     static void forward_batch(Output& output, const Input& input) {
-        output = etl::ml::avg_pool_forward<base::C1, base::C2>(input);
+        if constexpr (base::is_strided) {
+            avg_pool_2d_forward(output, input, base::I2, base::I3, base::C1, base::C2, base::S1, base::S2, base::P1, base::P2);
+        } else {
+            output = etl::ml::avg_pool_forward<base::C1, base::C2>(input);
+        }
     }
 
     /*!
@@ -79,7 +92,7 @@ struct avgp_2d_layer_impl final : pooling_2d_layer<avgp_2d_layer_impl<Desc>, Des
      */
     template<typename DLayer>
     static void dyn_init(DLayer& dyn){
-        dyn.init_layer(base::I1, base::I2, base::I3, base::C1, base::C2);
+        dyn.init_layer(base::I1, base::I2, base::I3, base::C1, base::C2, base::S1, base::S2, base::P1, base::P2);
     }
 
     /*!
@@ -103,9 +116,12 @@ struct avgp_2d_layer_impl final : pooling_2d_layer<avgp_2d_layer_impl<Desc>, Des
     void backward_batch(H&& output, C& context) const {
         static constexpr size_t C1 = base::C1; ///< The pooling first dimension
         static constexpr size_t C2 = base::C2; ///< The pooling second dimension
-        static constexpr size_t C3 = base::C3; ///< The pooling second dimension
 
-        output = etl::ml::avg_pool_backward<C1, C2, C3>(context.input, context.output, context.errors);
+        if constexpr (base::is_strided) {
+            avg_pool_2d_backward(output, context.errors, base::I2, base::I3, C1, C2, base::S1, base::S2, base::P1, base::P2);
+        } else {
+            output = etl::ml::avg_pool_backward<C1, C2>(context.input, context.output, context.errors);
+        }
     }
 
     /*!
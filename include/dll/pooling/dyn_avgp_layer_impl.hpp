@@ -9,6 +9,8 @@
 
 #include "pooling_layer.hpp"
 
+#include "dll/util/pooling.hpp"
+
 namespace dll {
 
 /*!
@@ -46,11 +48,23 @@ struct dyn_avgp_2d_layer_impl final : dyn_pooling_2d_layer<dyn_avgp_2d_layer_imp
         cpp_unused(pre);
 
         char buffer[1024];
-        snprintf(buffer, 1024, "AVGP(2d): %lux%lux%lu -> (%lux%lu) -> %lux%lux%lu",
-                 base::i1, base::i2, base::i3, base::c1, base::c2, base::o1, base::o2, base::o3);
+        if (base::is_strided()) {
+            snprintf(buffer, 1024, "AVGP(2d): %lux%lux%lu -> (%lux%lu, S%lux%lu, P%lux%lu) -> %lux%lux%lu",
+                     base::i1, base::i2, base::i3, base::c1, base::c2, base::s1, base::s2, base::p1, base::p2, base::o1, base::o2, base::o3);
+        } else {
+            snprintf(buffer, 1024, "AVGP(2d): %lux%lux%lu -> (%lux%lu) -> %lux%lux%lu",
+                     base::i1, base::i2, base::i3, base::c1, base::c2, base::o1, base::o2, base::o3);
+        }
         return {buffer};
     }
 
+    /*!
+     * \brief Returns the descriptor of the equivalent static layer
+     */
+    std::string static_desc() const {
+        return "dll::avgp_2d_layer_desc<" + base::static_desc_args() + ">::layer_t";
+    }
+
     /*!
      * \brief Returns the output shape
      * \return an std::string containing the description of the output shape
@@ -68,7 +82,11 @@ struct dyn_avgp_2d_layer_impl final : dyn_pooling_2d_layer<dyn_avgp_2d_layer_imp
      */
     template <typename Input, typename Output>
     void forward_batch(Output& output, const Input& input) const {
-        output = etl::ml::avg_pool_forward(input, base::c1, base::c2);
+        if (base::is_strided()) {
+            avg_pool_2d_forward(output, input, base::i2, base::i3, base::c1, base::c2, base::s1, base::s2, base::p1, base::p2);
+        } else {
+            output = etl::ml::avg_pool_forward(input, base::c1, base::c2);
+        }
     }
 
     /*!
@@ -104,7 +122,11 @@ struct dyn_avgp_2d_layer_impl final : dyn_pooling_2d_layer<dyn_avgp_2d_layer_imp
         size_t c1 = base::c1;
         size_t c2 = base::c2;
 
-        output = etl::ml::avg_pool_backward(context.input, context.output, context.errors, c1, c2);
+        if (base::is_strided()) {
+            avg_pool_2d_backward(output, context.errors, base::i2, base::i3, c1, c2, base::s1, base::s2, base::p1, base::p2);
+        } else {
+            output = etl::ml::avg_pool_backward(context.input, context.output, context.errors, c1, c2);
+        }
     }
 
     /*!
@@ -153,8 +175,8 @@ struct sgd_context<DBN, dyn_avgp_2d_layer_impl<Desc>, L> {
 
     sgd_context(const layer_t& layer)
             : input(batch_size, layer.i1, layer.i2, layer.i3),
-              output(batch_size, layer.i1, layer.i2 / layer.c1, layer.i3 / layer.c2),
-              errors(batch_size, layer.i1, layer.i2 / layer.c1, layer.i3 / layer.c2) {}
+              output(batch_size, layer.o1, layer.o2, layer.o3),
+              errors(batch_size, layer.o1, layer.o2, layer.o3) {}
 };
 
 /*!
@@ -9,6 +9,9 @@
 
 #include "pooling_layer.hpp"
 
+#include "dll/util/max_pool_indices.hpp"
+#include "dll/util/pooling.hpp"
+
 namespace dll {
 
 /*!
@@ -28,6 +31,8 @@ struct dyn_mp_2d_layer_impl final : dyn_pooling_2d_layer<dyn_mp_2d_layer_impl<De
     using input_t      = typename base::input_t;      ///< The type of many input
     using output_t     = typename base::output_t;     ///< The type of many output
 
+    static constexpr bool indices = desc::parameters::template contains<dll::max_pool_indices>(); ///< Record the position of the max for the backward pass
+
     dyn_mp_2d_layer_impl() = default;
 
     /*!
@@ -46,11 +51,23 @@ struct dyn_mp_2d_layer_impl final : dyn_pooling_2d_layer<dyn_mp_2d_layer_impl<De
         cpp_unused(pre);
 
         char buffer[1024];
-        snprintf(buffer, 1024, "MP(2d): %lux%lux%lu -> (%lux%lu) -> %lux%lux%lu",
-                 base::i1, base::i2, base::i3, base::c1, base::c2, base::o1, base::o2, base::o3);
+        if (base::is_strided()) {
+            snprintf(buffer, 1024, "MP(2d): %lux%lux%lu -> (%lux%lu, S%lux%lu, P%lux%lu) -> %lux%lux%lu",
+                     base::i1, base::i2, base::i3, base::c1, base::c2, base::s1, base::s2, base::p1, base::p2, base::o1, base::o2, base::o3);
+        } else {
+            snprintf(buffer, 1024, "MP(2d): %lux%lux%lu -> (%lux%lu) -> %lux%lux%lu",
+                     base::i1, base::i2, base::i3, base::c1, base::c2, base::o1, base::o2, base::o3);
+        }
         return {buffer};
     }
 
+    /*!
+     * \brief Returns the descriptor of the equivalent static layer
+     */
+    std::string static_desc() const {
+        return "dll::mp_2d_layer_desc<" + base::static_desc_args(indices ? ", dll::max_pool_indices" : "") + ">::layer_t";
+    }
+
     /*!
      * \brief Returns the output shape
      * \return an std::string containing the description of the output shape
@@ -68,7 +85,42 @@ struct dyn_mp_2d_layer_impl final : dyn_pooling_2d_layer<dyn_mp_2d_layer_impl<De
      */
     template <typename Input, typename Output>
     void forward_batch(Output& output, const Input& input) const {
-        output = etl::ml::max_pool_forward(input, base::c1, base::c2);
+        if (base::is_strided()) {
+            max_pool_2d_forward(output, input, base::i2, base::i3, base::c1, base::c2, base::s1, base::s2, base::p1, base::p2);
+        } else {
+            output = etl::ml::max_pool_forward(input, base::c1, base::c2);
+        }
+    }
+
+    using base::train_forward_batch;
+
+    /*!
+     * \brief Forward activation of the layer for one batch of sample during
+     * training, recording the position of the max of each window in the
+     * context (with max_pool_indices)
+     * \param output The output matrix
+     * \param input The input matrix
+     * \param context The training context
+     */
+    template <typename Input, typename Output, typename C>
+    void train_forward_batch(Output& output, const Input& input, C& context) const {
+        if constexpr (indices && etl::all_dma<Output, Input>) {
+            cpp_assert(base::c1 * base::c2 <= max_pool_indices_window, "Pooling window too large for the max pooling indices");
+
+            context.indices.resize(etl::size(output));
+
+            input.ensure_cpu_up_to_date();
+
+            max_pool_2d_forward_indices(input.memory_start(), output.memory_start(), context.indices.data(),
+                                        etl::dim<0>(input) * base::i1, base::i2, base::i3, base::c1, base::c2,
+                                        base::s1, base::s2, base::p1, base::p2);
+
+            output.invalidate_gpu();
+        } else {
+            cpp_unused(context);
+
+            forward_batch(output, input);
+        }
     }
 
     /*!
@@ -104,7 +156,26 @@ struct dyn_mp_2d_layer_impl final : dyn_pooling_2d_layer<dyn_mp_2d_layer_impl<De
         size_t c1 = base::c1;
         size_t c2 = base::c2;
 
-        output = etl::ml::max_pool_backward(context.input, context.output, context.errors, c1, c2);
+        if constexpr (indices && etl::all_dma<std::decay_t<H>, decltype(context.errors)>) {
+            // Only scatter the errors to the max of each window
+            if (context.indices.size() == etl::size(context.errors)) {
+                context.errors.ensure_cpu_up_to_date();
+
+                max_pool_2d_backward_indices(context.errors.memory_start(), context.indices.data(), output.memory_start(),
+                                             etl::dim<0>(context.errors) * base::i1, base::i2, base::i3, c1, c2,
+                                             base::s1, base::s2, base::p1, base::p2);
+
+                output.invalidate_gpu();
+
+                return;
+            }
+        }
+
+        if (base::is_strided()) {
+            max_pool_2d_backward(output, context.input, context.output, context.errors, base::i2, base::i3, c1, c2, base::s1, base::s2, base::p1, base::p2);
+        } else {
+            output = etl::ml::max_pool_backward(context.input, context.output, context.errors, c1, c2);
+        }
     }
 
     /*!
@@ -151,10 +222,12 @@ struct sgd_context<DBN, dyn_mp_2d_layer_impl<Desc>, L> {
     etl::dyn_matrix<weight, 4> output;
     etl::dyn_matrix<weight, 4> errors;
 
+    std::vector<uint8_t> indices; ///< The position of the max of each pooling window (with max_pool_indices)
+
     sgd_context(const layer_t& layer)
             : input(batch_size, layer.i1, layer.i2, layer.i3),
-              output(batch_size, layer.i1, layer.i2 / layer.c1, layer.i3 / layer.c2),
-              errors(batch_size, layer.i1, layer.i2 / layer.c1, layer.i3 / layer.c2) {}
+              output(batch_size, layer.o1, layer.o2, layer.o3),
+              errors(batch_size, layer.o1, layer.o2, layer.o3) {}
 };
 
 /*!
@@ -174,6 +247,8 @@ struct dyn_mp_3d_layer_impl final : dyn_pooling_3d_layer<dyn_mp_3d_layer_impl<De
     using input_t      = typename base::input_t;      ///< The type of many input
     using output_t     = typename base::output_t;     ///< The type of many output
 
+    static constexpr bool indices = desc::parameters::template contains<dll::max_pool_indices>(); ///< Record the position of the max for the backward pass
+
     dyn_mp_3d_layer_impl() = default;
 
     /*!
@@ -235,6 +310,36 @@ struct dyn_mp_3d_layer_impl final : dyn_pooling_3d_layer<dyn_mp_3d_layer_impl<De
         output = etl::ml::max_pool_3d_forward(input, base::c1, base::c2, base::c3);
     }
 
+    using base::train_forward_batch;
+
+    /*!
+     * \brief Forward activation of the layer for one batch of sample during
+     * training, recording the position of the max of each window in the
+     * context (with max_pool_indices)
+     * \param output The output matrix
+     * \param input The input matrix
+     * \param context The training context
+     */
+    template <typename Input, typename Output, typename C>
+    void train_forward_batch(Output& output, const Input& input, C& context) const {
+        if constexpr (indices && etl::all_dma<Output, Input>) {
+            cpp_assert(base::c1 * base::c2 * base::c3 <= max_pool_indices_window, "Pooling window too large for the max pooling indices");
+
+            context.indices.resize(etl::size(output));
+
+            input.ensure_cpu_up_to_date();
+
+            max_pool_3d_forward_indices(input.memory_start(), output.memory_start(), context.indices.data(),
+                                        etl::dim<0>(input), base::i1, base::i2, base::i3, base::c1, base::c2, base::c3);
+
+            output.invalidate_gpu();
+        } else {
+            cpp_unused(context);
+
+            forward_batch(output, input);
+        }
+    }
+
     /*!
      * \brief Initialize the dynamic version of the layer from the
      * fast version of the layer
@@ -269,6 +374,20 @@ struct dyn_mp_3d_layer_impl final : dyn_pooling_3d_layer<dyn_mp_3d_layer_impl<De
         size_t c2 = base::c2;
         size_t c3 = base::c3;
 
+        if constexpr (indices && etl::all_dma<std::decay_t<H>, decltype(context.errors)>) {
+            // Only scatter the errors to the max of each window
+            if (context.indices.size() == etl::size(context.errors)) {
+                context.errors.ensure_cpu_up_to_date();
+
+                max_pool_3d_backward_indices(context.errors.memory_start(), context.indices.data(), output.memory_start(),
+                                             etl::dim<0>(context.errors), base::i1, base::i2, base::i3, c1, c2, c3);
+
+                output.invalidate_gpu();
+
+                return;
+            }
+        }
+
         output = etl::ml::max_pool_3d_backward(context.input, context.output, context.errors, c1, c2, c3);
     }
 
@@ -316,6 +435,8 @@ struct sgd_context<DBN, dyn_mp_3d_layer_impl<Desc>, L> {
     etl::dyn_matrix<weight, 4> output;
     etl::dyn_matrix<weight, 4> errors;
 
+    std::vector<uint8_t> indices; ///< The position of the max of each pooling window (with max_pool_indices)
+
     sgd_context(const layer_t& layer)
             : input(batch_size, layer.i1, layer.i2, layer.i3),
               output(batch_size, layer.i1 / layer.c1, layer.i2 / layer.c2, layer.i3 / layer.c3),
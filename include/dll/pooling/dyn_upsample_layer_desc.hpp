@@ -21,6 +21,8 @@ struct dyn_upsample_3d_layer_desc : dyn_unpooling_3d_layer_desc<Parameters...> {
      */
     using parameters = cpp::type_list<Parameters...>;
 
+    static constexpr upsample_type mode = detail::get_value_v<upsample<upsample_type::NEAREST>, Parameters...>; ///< The interpolation of the layer
+
     /*! The RBM type */
     using layer_t = dyn_upsample_3d_layer_impl<dyn_upsample_3d_layer_desc<Parameters...>>;
 
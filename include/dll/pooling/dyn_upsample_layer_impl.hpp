@@ -9,6 +9,9 @@
 
 #include "unpooling_layer.hpp"
 
+#include "dll/util/timers.hpp" // for auto_timer
+#include "dll/util/upsample.hpp"
+
 namespace dll {
 
 /*!
@@ -46,7 +49,7 @@ struct dyn_upsample_3d_layer_impl final : dyn_unpooling_3d_layer<dyn_upsample_3d
         cpp_unused(pre);
 
         char buffer[512];
-        snprintf(buffer, 512, "upsample(3D): %lux%lux%lu -> (%lux%lux%lu) -> %lux%lux%lu",
+        snprintf(buffer, 512, "upsample(3D%s): %lux%lux%lu -> (%lux%lux%lu) -> %lux%lux%lu", desc::mode == upsample_type::BILINEAR ? ", bilinear" : "",
                  base::i1, base::i2, base::i3, base::c1, base::c2, base::c3, base::o1, base::o2, base::o3);
         return {buffer};
     }
@@ -68,7 +71,9 @@ struct dyn_upsample_3d_layer_impl final : dyn_unpooling_3d_layer<dyn_upsample_3d
      */
     template <typename Input, typename Output>
     void forward_batch(Output& output, const Input& input) const {
-        output = etl::upsample_3d(input, base::c1, base::c2, base::c3);
+        dll::auto_timer timer("upsample:forward_batch");
+
+        upsample_3d_forward<desc::mode>(output, input, base::i1, base::i2, base::i3, base::c1, base::c2, base::c3);
     }
 
     /*!
@@ -101,17 +106,10 @@ struct dyn_upsample_3d_layer_impl final : dyn_unpooling_3d_layer<dyn_upsample_3d
      */
     template<typename H, typename C>
     void backward_batch(H&& output, C& context) const {
-        const size_t c1 = base::c1;
-        const size_t c2 = base::c2;
-        const size_t c3 = base::c3;
-
-        if constexpr (etl::decay_traits<H>::dimensions() == 4) {
-            output = etl::max_pool_3d(context.errors, c1, c2, c3);
-        } else {
-            const size_t B = etl::dim<0>(output);
+        dll::auto_timer timer("upsample:backward_batch");
 
-            etl::reshape(output, B, base::i1, base::i2, base::i3) = etl::max_pool_3d(context.errors, c1, c2, c3);
-        }
+        // Each input gets the (weighted) sum of the errors of its block
+        upsample_3d_backward<desc::mode>(output, context.errors, base::i1, base::i2, base::i3, base::c1, base::c2, base::c3);
     }
 
     /*!
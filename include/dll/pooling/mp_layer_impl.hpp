@@ -9,6 +9,8 @@
 
 #include "pooling_layer.hpp"
 
+#include "dll/util/max_pool_indices.hpp"
+#include "dll/util/pooling.hpp"
 #include "dll/util/timers.hpp" // for auto_timer
 
 namespace dll {
@@ -30,6 +32,13 @@ struct mp_2d_layer_impl final : pooling_2d_layer<mp_2d_layer_impl<Desc>, Desc> {
     using input_t      = typename base::input_t;      ///< The type of many input
     using output_t     = typename base::output_t;     ///< The type of many output
 
+    static constexpr bool indices = desc::parameters::template contains<dll::max_pool_indices>(); ///< Record the position of the max for the backward pass
+
+    static_assert(!indices || base::C1 * base::C2 <= max_pool_indices_window, "Pooling window too large for the max pooling indices");
+
+    static constexpr bool conv_fusion       = true;                                           ///< The layer can pool the output of a convolution on the fly
+    static constexpr bool conv_train_fusion = base::C1 * base::C2 <= max_pool_indices_window; ///< The layer can pool the output of a convolution on the fly in training
+
     mp_2d_layer_impl() = default;
 
     /*!
@@ -48,8 +57,13 @@ struct mp_2d_layer_impl final : pooling_2d_layer<mp_2d_layer_impl<Desc>, Desc> {
         cpp_unused(pre);
 
         char buffer[1024];
-        snprintf(buffer, 1024, "MP(2D): %lux%lux%lu -> (%lux%lu) -> %lux%lux%lu",
-                 base::I1, base::I2, base::I3, base::C1, base::C2, base::O1, base::O2, base::O3);
+        if (base::is_strided) {
+            snprintf(buffer, 1024, "MP(2D): %lux%lux%lu -> (%lux%lu, S%lux%lu, P%lux%lu) -> %lux%lux%lu",
+                     base::I1, base::I2, base::I3, base::C1, base::C2, base::S1, base::S2, base::P1, base::P2, base::O1, base::O2, base::O3);
+        } else {
+            snprintf(buffer, 1024, "MP(2D): %lux%lux%lu -> (%lux%lu) -> %lux%lux%lu",
+                     base::I1, base::I2, base::I3, base::C1, base::C2, base::O1, base::O2, base::O3);
+        }
         return {buffer};
     }
 
@@ -72,7 +86,42 @@ struct mp_2d_layer_impl final : pooling_2d_layer<mp_2d_layer_impl<Desc>, Desc> {
     static void forward_batch(Output& output, const Input& input) {
         dll::auto_timer timer("mp:forward_batch");
 
-        output = etl::ml::max_pool_forward<base::C1, base::C2>(input);
+        if constexpr (base::is_strided) {
+            max_pool_2d_forward(output, input, base::I2, base::I3, base::C1, base::C2, base::S1, base::S2, base::P1, base::P2);
+        } else {
+            output = etl::ml::max_pool_forward<base::C1, base::C2>(input);
+        }
+    }
+
+    using base::train_forward_batch;
+
+    /*!
+     * \brief Forward activation of the layer for one batch of sample during
+     * training, recording the position of the max of each window in the
+     * context (with max_pool_indices)
+     * \param output The output matrix
+     * \param input The input matrix
+     * \param context The training context
+     */
+    template <typename Input, typename Output, typename C>
+    void train_forward_batch(Output& output, const Input& input, C& context) const {
+        if constexpr (indices && etl::all_dma<Output, Input>) {
+            dll::auto_timer timer("mp:forward_batch");
+
+            context.indices.resize(etl::size(output));
+
+            input.ensure_cpu_up_to_date();
+
+            max_pool_2d_forward_indices(input.memory_start(), output.memory_start(), context.indices.data(),
+                                        etl::dim<0>(input) * base::I1, base::I2, base::I3, base::C1, base::C2,
+                                        base::S1, base::S2, base::P1, base::P2);
+
+            output.invalidate_gpu();
+        } else {
+            cpp_unused(context);
+
+            forward_batch(output, input);
+        }
     }
 
     /*!
@@ -83,7 +132,7 @@ struct mp_2d_layer_impl final : pooling_2d_layer<mp_2d_layer_impl<Desc>, Desc> {
      */
     template<typename DLayer>
     static void dyn_init(DLayer& dyn){
-        dyn.init_layer(base::I1, base::I2, base::I3, base::C1, base::C2);
+        dyn.init_layer(base::I1, base::I2, base::I3, base::C1, base::C2, base::S1, base::S2, base::P1, base::P2);
     }
 
     /*!
@@ -110,7 +159,26 @@ struct mp_2d_layer_impl final : pooling_2d_layer<mp_2d_layer_impl<Desc>, Desc> {
         static constexpr size_t C1 = base::C1; ///< The pooling first dimension
         static constexpr size_t C2 = base::C2; ///< The pooling second dimension
 
-        output = etl::ml::max_pool_backward<C1, C2>(context.input, context.output, context.errors);
+        if constexpr (indices && etl::all_dma<std::decay_t<H>, decltype(context.errors)>) {
+            // Only scatter the errors to the max of each window
+            if (context.indices.size() == etl::size(context.errors)) {
+                context.errors.ensure_cpu_up_to_date();
+
+                max_pool_2d_backward_indices(context.errors.memory_start(), context.indices.data(), output.memory_start(),
+                                             etl::dim<0>(context.errors) * base::I1, base::I2, base::I3, C1, C2,
+                                             base::S1, base::S2, base::P1, base::P2);
+
+                output.invalidate_gpu();
+
+                return;
+            }
+        }
+
+        if constexpr (base::is_strided) {
+            max_pool_2d_backward(output, context.input, context.output, context.errors, base::I2, base::I3, C1, C2, base::S1, base::S2, base::P1, base::P2);
+        } else {
+            output = etl::ml::max_pool_backward<C1, C2>(context.input, context.output, context.errors);
+        }
     }
 
     /*!
@@ -165,6 +233,8 @@ struct sgd_context<DBN, mp_2d_layer_impl<Desc>, L> {
     etl::fast_matrix<weight, batch_size, O1, O2, O3> output;
     etl::fast_matrix<weight, batch_size, O1, O2, O3> errors;
 
+    std::vector<uint8_t> indices; ///< The position of the max of each pooling window (with max_pool_indices)
+
     sgd_context(const mp_2d_layer_impl<Desc>& /*layer*/){}
 };
 
@@ -185,6 +255,10 @@ struct mp_3d_layer_impl final : pooling_3d_layer<mp_3d_layer_impl<Desc>, Desc> {
     using input_t      = typename base::input_t;      ///< The type of many input
     using output_t     = typename base::output_t;     ///< The type of many output
 
+    static constexpr bool indices = desc::parameters::template contains<dll::max_pool_indices>(); ///< Record the position of the max for the backward pass
+
+    static_assert(!indices || base::C1 * base::C2 * base::C3 <= max_pool_indices_window, "Pooling window too large for the max pooling indices");
+
     mp_3d_layer_impl() = default;
 
     /*!
@@ -230,6 +304,36 @@ struct mp_3d_layer_impl final : pooling_3d_layer<mp_3d_layer_impl<Desc>, Desc> {
         output = etl::ml::max_pool_3d_forward<base::C1, base::C2, base::C3>(input);
     }
 
+    using base::train_forward_batch;
+
+    /*!
+     * \brief Forward activation of the layer for one batch of sample during
+     * training, recording the position of the max of each window in the
+     * context (with max_pool_indices)
+     * \param output The output matrix
+     * \param input The input matrix
+     * \param context The training context
+     */
+    template <typename Input, typename Output, typename C>
+    void train_forward_batch(Output& output, const Input& input, C& context) const {
+        if constexpr (indices && etl::all_dma<Output, Input>) {
+            dll::auto_timer timer("mp:forward_batch");
+
+            context.indices.resize(etl::size(output));
+
+            input.ensure_cpu_up_to_date();
+
+            max_pool_3d_forward_indices(input.memory_start(), output.memory_start(), context.indices.data(),
+                                        etl::dim<0>(input), base::I1, base::I2, base::I3, base::C1, base::C2, base::C3);
+
+            output.invalidate_gpu();
+        } else {
+            cpp_unused(context);
+
+            forward_batch(output, input);
+        }
+    }
+
     /*!
      * \brief Initialize the dynamic version of the layer from the
      * fast version of the layer
@@ -266,6 +370,20 @@ struct mp_3d_layer_impl final : pooling_3d_layer<mp_3d_layer_impl<Desc>, Desc> {
         static constexpr size_t C2 = base::C2; ///< The pooling second dimension
         static constexpr size_t C3 = base::C3; ///< The pooling third dimension
 
+        if constexpr (indices && etl::all_dma<std::decay_t<H>, decltype(context.errors)>) {
+            // Only scatter the errors to the max of each window
+            if (context.indices.size() == etl::size(context.errors)) {
+                context.errors.ensure_cpu_up_to_date();
+
+                max_pool_3d_backward_indices(context.errors.memory_start(), context.indices.data(), output.memory_start(),
+                                             etl::dim<0>(context.errors), base::I1, base::I2, base::I3, C1, C2, C3);
+
+                output.invalidate_gpu();
+
+                return;
+            }
+        }
+
         output = etl::ml::max_pool_3d_backward<C1, C2, C3>(context.input, context.output, context.errors);
     }
 
@@ -321,6 +439,8 @@ struct sgd_context<DBN, mp_3d_layer_impl<Desc>, L> {
     etl::fast_matrix<weight, batch_size, O1, O2, O3> output;
     etl::fast_matrix<weight, batch_size, O1, O2, O3> errors;
 
+    std::vector<uint8_t> indices; ///< The position of the max of each pooling window (with max_pool_indices)
+
     sgd_context(const mp_3d_layer_impl<Desc>& /*layer*/){}
 };
 
@@ -10,6 +10,7 @@
 #include "etl/etl.hpp"
 
 #include "dll/layer.hpp"
+#include "dll/util/static_desc.hpp"
 
 namespace dll {
 
@@ -26,12 +27,17 @@ struct pooling_2d_layer : layer<Parent> {
     static constexpr size_t I3 = desc::I3; ///< The third dimension of the input
     static constexpr size_t C1 = desc::C1; ///< The first dimension pooling ratio
     static constexpr size_t C2 = desc::C2; ///< The second dimension pooling ratio
+    static constexpr size_t S1 = desc::S1; ///< The stride of the first dimension
+    static constexpr size_t S2 = desc::S2; ///< The stride of the second dimension
+    static constexpr size_t P1 = desc::P1; ///< The padding of the first dimension
+    static constexpr size_t P2 = desc::P2; ///< The padding of the second dimension
 
-    static constexpr size_t O1 = I1;      ///< The first dimension of the output
-    static constexpr size_t O2 = I2 / C1; ///< The second dimension of the output
-    static constexpr size_t O3 = I3 / C2; ///< The third dimension of the output
+    static constexpr size_t O1 = I1;                          ///< The first dimension of the output
+    static constexpr size_t O2 = (I2 - C1 + 2 * P1) / S1 + 1; ///< The second dimension of the output
+    static constexpr size_t O3 = (I3 - C2 + 2 * P2) / S2 + 1; ///< The third dimension of the output
 
-    static constexpr bool is_nop = C1 * C2 == 1; ///< Indicate if the operation has no effect
+    static constexpr bool is_strided = S1 != C1 || S2 != C2 || P1 || P2; ///< Indicate if the windows do not simply tile the input
+    static constexpr bool is_nop     = C1 * C2 == 1 && !is_strided;      ///< Indicate if the operation has no effect
 
     using input_one_t  = etl::fast_dyn_matrix<weight, I1, I2, I3>; ///< The type of one input
     using output_one_t = etl::fast_dyn_matrix<weight, O1, O2, O3>; ///< The type of one output
@@ -64,6 +70,22 @@ struct pooling_2d_layer : layer<Parent> {
         return 0;
     }
 
+    /*!
+     * \brief Returns the number of floating point operations of the
+     * forward pass of one sample
+     */
+    static constexpr size_t forward_flops() noexcept {
+        return input_size();
+    }
+
+    /*!
+     * \brief Returns the number of floating point operations of the
+     * backward pass of one sample
+     */
+    static constexpr size_t backward_flops() noexcept {
+        return input_size();
+    }
+
     /*!
      * \brief Prepare a set of empty outputs for this layer
      * \param samples The number of samples to prepare the output for
@@ -116,6 +138,10 @@ struct dyn_pooling_2d_layer : layer<Parent> {
     size_t i3; ///< The third dimension of the input
     size_t c1; ///< The first dimension pooling ratio
     size_t c2; ///< The second dimension pooling ratio
+    size_t s1; ///< The stride of the first dimension
+    size_t s2; ///< The stride of the second dimension
+    size_t p1; ///< The padding of the first dimension
+    size_t p2; ///< The padding of the second dimension
 
     size_t o1; ///< The first dimension of the output
     size_t o2; ///< The second dimension of the output
@@ -125,16 +151,72 @@ struct dyn_pooling_2d_layer : layer<Parent> {
 
     /*!
      * \brief Initialize the dynamic layer
+     *
+     * A stride of zero means a stride equal to the pooling window.
      */
-    void init_layer(size_t i1, size_t i2, size_t i3, size_t c1, size_t c2){
+    void init_layer(size_t i1, size_t i2, size_t i3, size_t c1, size_t c2,
+                    size_t s1 = desc::S1, size_t s2 = desc::S2, size_t p1 = desc::P1, size_t p2 = desc::P2){
         this->i1 = i1;
         this->i2 = i2;
         this->i3 = i3;
         this->c1 = c1;
         this->c2 = c2;
+        this->s1 = s1 ? s1 : c1;
+        this->s2 = s2 ? s2 : c2;
+        this->p1 = p1;
+        this->p2 = p2;
+
+        cpp_assert(p1 < c1 && p2 < c2, "The padding must be smaller than the pooling window");
+        cpp_assert(i2 + 2 * p1 >= c1 && i3 + 2 * p2 >= c2, "The pooling window cannot be larger than the padded input");
+
         this->o1 = i1;
-        this->o2 = i2 / c1;
-        this->o3 = i3 / c2;
+        this->o2 = (i2 - c1 + 2 * p1) / this->s1 + 1;
+        this->o3 = (i3 - c2 + 2 * p2) / this->s2 + 1;
+    }
+
+    /*!
+     * \brief Indicates if the input channels of the layer can be pruned
+     */
+    bool can_keep_channels() const noexcept {
+        return true;
+    }
+
+    /*!
+     * \brief Only keep the given channels of the layer
+     * \param kept The indices of the kept channels, in increasing order
+     * \param channels The number of channels before the pruning
+     */
+    void keep_channels(const std::vector<size_t>& kept, size_t channels) {
+        cpp_assert(channels == i1, "Invalid pruning of the channels");
+        cpp_unused(channels);
+
+        i1 = kept.size();
+        o1 = kept.size();
+    }
+
+    /*!
+     * \brief Indicates if the windows do not simply tile the input
+     */
+    bool is_strided() const noexcept {
+        return s1 != c1 || s2 != c2 || p1 || p2;
+    }
+
+    /*!
+     * \brief Returns the template arguments of the descriptor of the
+     * equivalent static layer
+     * \param params The additional parameters of the layer
+     */
+    std::string static_desc_args(std::string params = "") const {
+        if (s1 != c1 || s2 != c2) {
+            params += ", dll::stride<" + std::to_string(s1) + ", " + std::to_string(s2) + ">";
+        }
+
+        if (p1 || p2) {
+            params += ", dll::padding<" + std::to_string(p1) + ", " + std::to_string(p2) + ">";
+        }
+
+        return std::to_string(i1) + ", " + std::to_string(i2) + ", " + std::to_string(i3) + ", "
+               + std::to_string(c1) + ", " + std::to_string(c2) + params + detail::static_weight_param<weight>();
     }
 
     /*!
@@ -161,6 +243,22 @@ struct dyn_pooling_2d_layer : layer<Parent> {
         return 0;
     }
 
+    /*!
+     * \brief Returns the number of floating point operations of the
+     * forward pass of one sample
+     */
+    size_t forward_flops() const noexcept {
+        return input_size();
+    }
+
+    /*!
+     * \brief Returns the number of floating point operations of the
+     * backward pass of one sample
+     */
+    size_t backward_flops() const noexcept {
+        return input_size();
+    }
+
     /*!
      * \brief Prepare a set of empty outputs for this layer
      * \param samples The number of samples to prepare the output for
@@ -250,6 +348,22 @@ struct pooling_3d_layer : layer<Parent> {
         return 0;
     }
 
+    /*!
+     * \brief Returns the number of floating point operations of the
+     * forward pass of one sample
+     */
+    static constexpr size_t forward_flops() noexcept {
+        return input_size();
+    }
+
+    /*!
+     * \brief Returns the number of floating point operations of the
+     * backward pass of one sample
+     */
+    static constexpr size_t backward_flops() noexcept {
+        return input_size();
+    }
+
     /*!
      * \brief Prepare a set of empty outputs for this layer
      * \param samples The number of samples to prepare the output for
@@ -325,6 +439,27 @@ struct dyn_pooling_3d_layer : layer<Parent> {
         this->o3 = i3 / c3;
     }
 
+    /*!
+     * \brief Indicates if the input channels of the layer can be pruned,
+     * only if the channels are not pooled together
+     */
+    bool can_keep_channels() const noexcept {
+        return c1 == 1;
+    }
+
+    /*!
+     * \brief Only keep the given channels of the layer
+     * \param kept The indices of the kept channels, in increasing order
+     * \param channels The number of channels before the pruning
+     */
+    void keep_channels(const std::vector<size_t>& kept, size_t channels) {
+        cpp_assert(c1 == 1 && channels == i1, "Invalid pruning of the channels");
+        cpp_unused(channels);
+
+        i1 = kept.size();
+        o1 = kept.size();
+    }
+
     /*!
      * \brief Return the size of the input of this layer
      * \return The size of the input of this layer
@@ -349,6 +484,22 @@ struct dyn_pooling_3d_layer : layer<Parent> {
         return 0;
     }
 
+    /*!
+     * \brief Returns the number of floating point operations of the
+     * forward pass of one sample
+     */
+    size_t forward_flops() const noexcept {
+        return input_size();
+    }
+
+    /*!
+     * \brief Returns the number of floating point operations of the
+     * backward pass of one sample
+     */
+    size_t backward_flops() const noexcept {
+        return input_size();
+    }
+
     /*!
      * \brief Prepare a set of empty outputs for this layer
      * \param samples The number of samples to prepare the output for
@@ -20,17 +20,24 @@ struct pooling_2d_layer_desc {
     static constexpr size_t C1 = T_C1; ///< The pooling first dimension
     static constexpr size_t C2 = T_C2; ///< The pooling second dimension
 
+    static constexpr size_t S1 = detail::get_value_1<stride<T_C1, T_C2>, Parameters...>::value;  ///< The stride of the first dimension
+    static constexpr size_t S2 = detail::get_value_2<stride<T_C1, T_C2>, Parameters...>::value;  ///< The stride of the second dimension
+    static constexpr size_t P1 = detail::get_value_1<padding<0, 0>, Parameters...>::value;       ///< The padding of the first dimension
+    static constexpr size_t P2 = detail::get_value_2<padding<0, 0>, Parameters...>::value;       ///< The padding of the second dimension
+
     /*! The type used to store the weights */
     using weight = detail::get_type_t<weight_type<float>, Parameters...>;
 
     static_assert(C1 > 0, "Cannot shrink a layer by less than 1");
     static_assert(C2 > 0, "Cannot shrink a layer by less than 1");
-    static_assert(I2 % C1 == 0, "Input dimension is not divisible by C");
-    static_assert(I3 % C2 == 0, "Input dimension is not divisible by C");
+    static_assert(S1 > 0 && S2 > 0, "The stride must be at least 1");
+    static_assert(P1 < C1 && P2 < C2, "The padding must be smaller than the pooling window");
+    static_assert(I2 + 2 * P1 >= C1 && I3 + 2 * P2 >= C2, "The pooling window cannot be larger than the padded input");
+    static_assert(S1 != C1 || S2 != C2 || P1 || P2 || (I2 % C1 == 0 && I3 % C2 == 0), "Input dimension is not divisible by C");
 
     //Make sure only valid types are passed to the configuration list
     static_assert(
-        detail::is_valid_v<cpp::type_list<weight_type_id>, Parameters...>,
+        detail::is_valid_v<cpp::type_list<weight_type_id, max_pool_indices_id, stride_id, padding_id>, Parameters...>,
         "Invalid parameters type for pooling_layer");
 };
 
@@ -39,12 +46,17 @@ struct pooling_2d_layer_desc {
  */
 template <typename... Parameters>
 struct dyn_pooling_2d_layer_desc {
+    static constexpr size_t S1 = detail::get_value_1<stride<0, 0>, Parameters...>::value;  ///< The stride of the first dimension (default, 0 for the pooling window)
+    static constexpr size_t S2 = detail::get_value_2<stride<0, 0>, Parameters...>::value;  ///< The stride of the second dimension (default, 0 for the pooling window)
+    static constexpr size_t P1 = detail::get_value_1<padding<0, 0>, Parameters...>::value; ///< The padding of the first dimension (default)
+    static constexpr size_t P2 = detail::get_value_2<padding<0, 0>, Parameters...>::value; ///< The padding of the second dimension (default)
+
     /*! The type used to store the weights */
     using weight = detail::get_type_t<weight_type<float>, Parameters...>;
 
     //Make sure only valid types are passed to the configuration list
     static_assert(
-        detail::is_valid_v<cpp::type_list<weight_type_id>, Parameters...>,
+        detail::is_valid_v<cpp::type_list<weight_type_id, max_pool_indices_id, stride_id, padding_id>, Parameters...>,
         "Invalid parameters type for pooling_layer");
 };
 
@@ -72,7 +84,7 @@ struct pooling_3d_layer_desc {
 
     //Make sure only valid types are passed to the configuration list
     static_assert(
-        detail::is_valid_v<cpp::type_list<weight_type_id>, Parameters...>,
+        detail::is_valid_v<cpp::type_list<weight_type_id, max_pool_indices_id>, Parameters...>,
         "Invalid parameters type for pooling_layer");
 };
 
@@ -86,7 +98,7 @@ struct dyn_pooling_3d_layer_desc {
 
     //Make sure only valid types are passed to the configuration list
     static_assert(
-        detail::is_valid_v<cpp::type_list<weight_type_id>, Parameters...>,
+        detail::is_valid_v<cpp::type_list<weight_type_id, max_pool_indices_id>, Parameters...>,
         "Invalid parameters type for pooling_layer");
 };
 
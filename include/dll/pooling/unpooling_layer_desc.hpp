@@ -30,7 +30,7 @@ struct unpooling_3d_layer_desc {
 
     //Make sure only valid types are passed to the configuration list
     static_assert(
-        detail::is_valid_v<cpp::type_list<weight_type_id>, Parameters...>,
+        detail::is_valid_v<cpp::type_list<weight_type_id, upsample_id>, Parameters...>,
         "Invalid parameters type for unpooling_layer");
 };
 
@@ -44,7 +44,7 @@ struct dyn_unpooling_3d_layer_desc {
 
     //Make sure only valid types are passed to the configuration list
     static_assert(
-        detail::is_valid_v<cpp::type_list<weight_type_id>, Parameters...>,
+        detail::is_valid_v<cpp::type_list<weight_type_id, upsample_id>, Parameters...>,
         "Invalid parameters type for dyn_unpooling_layer");
 };
 
@@ -21,6 +21,8 @@ struct upsample_3d_layer_desc : unpooling_3d_layer_desc<T_I1, T_I2, T_I3, T_C1,
      */
     using parameters = cpp::type_list<Parameters...>;
 
+    static constexpr upsample_type mode = detail::get_value_v<upsample<upsample_type::NEAREST>, Parameters...>; ///< The interpolation of the layer
+
     /*! The layer type */
     using layer_t = upsample_3d_layer_impl<upsample_3d_layer_desc<T_I1, T_I2, T_I3, T_C1, T_C2, T_C3, Parameters...>>;
 
@@ -10,6 +10,9 @@
 #include "dll/base_traits.hpp"
 #include "unpooling_layer.hpp"
 
+#include "dll/util/timers.hpp" // for auto_timer
+#include "dll/util/upsample.hpp"
+
 namespace dll {
 
 /*!
@@ -47,7 +50,7 @@ struct upsample_3d_layer_impl final : unpooling_3d_layer<upsample_3d_layer_impl<
         cpp_unused(pre);
 
         char buffer[512];
-        snprintf(buffer, 512, "upsample(3D): %lux%lux%lu -> (%lux%lux%lu) -> %lux%lux%lu",
+        snprintf(buffer, 512, "upsample(3D%s): %lux%lux%lu -> (%lux%lux%lu) -> %lux%lux%lu", desc::mode == upsample_type::BILINEAR ? ", bilinear" : "",
                  base::I1, base::I2, base::I3, base::C1, base::C2, base::C3, base::O1, base::O2, base::O3);
         return {buffer};
     }
@@ -70,7 +73,9 @@ struct upsample_3d_layer_impl final : unpooling_3d_layer<upsample_3d_layer_impl<
      */
     template <typename Input, typename Output>
     static void forward_batch(Output& output, const Input& input) {
-        output = etl::upsample_3d<base::C1, base::C2, base::C3>(input);
+        dll::auto_timer timer("upsample:forward_batch");
+
+        upsample_3d_forward<desc::mode>(output, input, base::I1, base::I2, base::I3, base::C1, base::C2, base::C3);
     }
 
     /*!
@@ -103,17 +108,10 @@ struct upsample_3d_layer_impl final : unpooling_3d_layer<upsample_3d_layer_impl<
      */
     template<typename H, typename C>
     void backward_batch(H&& output, C& context) const {
-        static constexpr size_t C1 = base::C1; ///< The pooling first dimension
-        static constexpr size_t C2 = base::C2; ///< The pooling second dimension
-        static constexpr size_t C3 = base::C3; ///< The pooling third dimension
-
-        if constexpr (etl::decay_traits<H>::dimensions() == 4) {
-            output = etl::max_pool_3d<C1, C2, C3>(context.errors);
-        } else {
-            constexpr auto B = etl::decay_traits<H>::template dim<0>();
+        dll::auto_timer timer("upsample:backward_batch");
 
-            etl::reshape<B, base::I1, base::I2, base::I3>(output) = etl::max_pool_3d<C1, C2, C3>(context.errors);
-        }
+        // Each input gets the (weighted) sum of the errors of its block
+        upsample_3d_backward<desc::mode>(output, context.errors, base::I1, base::I2, base::I3, base::C1, base::C2, base::C3);
     }
 
     /*!
@@ -16,6 +16,12 @@
 #include <vector>
 #include <iostream>
 #include <iomanip>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <atomic>
+#include <mutex>
+#include <thread>
 
 #include "dll/rbm/rbm.hpp"
 #include "dll/rbm/conv_rbm.hpp"
@@ -37,6 +43,8 @@ struct options {
     bool cublas = false;
     bool cufft  = false;
     bool cache  = false;
+
+    std::string profile; ///< The build profile (overrides the one of the configuration)
 };
 
 template <typename LastLayer, typename Enable = void>
@@ -87,6 +95,8 @@ struct datasource_pack {
 struct general_desc {
     bool batch_mode       = false;
     size_t big_batch = 1;
+
+    std::string profile = "default"; ///< The build profile (default, native, lto or pgo)
 };
 
 struct pretraining_desc {
@@ -113,6 +123,14 @@ struct weights_desc {
     std::string file = "weights.dat";
 };
 
+/*!
+ * \brief A sweep over the runtime parameters of the network
+ */
+struct sweep_desc {
+    std::vector<std::pair<std::string, std::string>> grid; ///< The values of each swept parameter (separated with spaces)
+    size_t parallel = 1;                                   ///< The number of configurations run concurrently
+};
+
 struct task {
     std::vector<std::string> default_actions;
 
@@ -125,8 +143,328 @@ struct task {
     dll::processor::training_desc ft_desc;
     dll::processor::weights_desc w_desc;
     dll::processor::general_desc general_desc;
+    dll::processor::sweep_desc sweep;
+};
+
+/*!
+ * \brief The runtime parameters of a generated program.
+ *
+ * The parameters that do not change the type of the network (learning
+ * rates, epochs, data sources, actions, ...) are not compiled in the
+ * generated program but passed in a parameters file, one "key value" per
+ * line. This allows to reuse the compiled program when only these
+ * parameters change.
+ */
+struct params {
+    std::map<std::string, std::string> values; ///< The value of each parameter
+
+    /*!
+     * \brief Load the parameters from the given file
+     * \return true if the file was loaded, false otherwise
+     */
+    bool load(const std::string& file) {
+        std::ifstream stream(file);
+
+        if (!stream) {
+            return false;
+        }
+
+        std::string line;
+        while (std::getline(stream, line)) {
+            auto space = line.find(' ');
+
+            if (space == std::string::npos) {
+                values[line] = "";
+            } else {
+                values[line.substr(0, space)] = line.substr(space + 1);
+            }
+        }
+
+        return true;
+    }
+
+    /*!
+     * \brief Indicates if the given parameter is set
+     */
+    bool contains(const std::string& key) const {
+        return values.count(key);
+    }
+
+    /*!
+     * \brief Set the given value from the given parameter, if it is set
+     * \param key The name of the parameter
+     * \param value The value to set
+     */
+    template <typename T>
+    void get(const std::string& key, T& value) const {
+        auto it = values.find(key);
+
+        if (it == values.end()) {
+            return;
+        }
+
+        if constexpr (std::is_same<T, std::string>::value) {
+            value = it->second;
+        } else if constexpr (std::is_same<T, bool>::value) {
+            value = it->second == "true";
+        } else if constexpr (std::is_same<T, std::vector<std::string>>::value) {
+            std::stringstream stream(it->second);
+            std::string v;
+
+            value.clear();
+            while (stream >> v) {
+                value.push_back(v);
+            }
+        } else {
+            std::stringstream stream(it->second);
+            double v;
+            stream >> v;
+            value = T(v);
+        }
+    }
 };
 
+/*!
+ * \brief Write one parameter to the given parameters file stream
+ */
+template <typename T>
+void write_param(std::ostream& out, const std::string& key, const T& value) {
+    if constexpr (std::is_same<T, bool>::value) {
+        out << key << ' ' << (value ? "true" : "false") << '\n';
+    } else if constexpr (std::is_same<T, std::vector<std::string>>::value) {
+        out << key;
+        for (auto& v : value) {
+            out << ' ' << v;
+        }
+        out << '\n';
+    } else {
+        out << key << ' ' << std::setprecision(17) << value << '\n';
+    }
+}
+
+/*!
+ * \brief Write the runtime parameters of the given task
+ * \param out The stream of the parameters file
+ * \param t The task
+ */
+inline void write_task(std::ostream& out, const task& t) {
+    auto write_source = [&out](const std::string& prefix, const datasource& ds) {
+        write_param(out, prefix + ".source_file", ds.source_file);
+        write_param(out, prefix + ".reader", ds.reader);
+        write_param(out, prefix + ".binarize", ds.binarize);
+        write_param(out, prefix + ".normalize", ds.normalize);
+        write_param(out, prefix + ".scale", ds.scale);
+        write_param(out, prefix + ".scale_d", ds.scale_d);
+        write_param(out, prefix + ".shift", ds.shift);
+        write_param(out, prefix + ".shift_d", ds.shift_d);
+        write_param(out, prefix + ".normal_noise", ds.normal_noise);
+        write_param(out, prefix + ".normal_noise_d", ds.normal_noise_d);
+        write_param(out, prefix + ".limit", ds.limit);
+    };
+
+    write_source("pretraining.samples", t.pretraining.samples);
+    write_source("pretraining_clean.samples", t.pretraining_clean.samples);
+    write_source("training.samples", t.training.samples);
+    write_source("training.labels", t.training.labels);
+    write_source("testing.samples", t.testing.samples);
+    write_source("testing.labels", t.testing.labels);
+
+    write_param(out, "pt_desc.epochs", t.pt_desc.epochs);
+    write_param(out, "pt_desc.denoising", t.pt_desc.denoising);
+    write_param(out, "ft_desc.epochs", t.ft_desc.epochs);
+    write_param(out, "w_desc.file", t.w_desc.file);
+
+    if (!t.sweep.grid.empty()) {
+        write_param(out, "sweep.parallel", t.sweep.parallel);
+
+        for (auto& [key, values] : t.sweep.grid) {
+            write_param(out, "sweep.grid." + key, values);
+        }
+    }
+}
+
+/*!
+ * \brief Read the runtime parameters of the given task
+ * \param p The parameters
+ * \param t The task to complete
+ */
+inline void read_task(const params& p, task& t) {
+    auto read_source = [&p](const std::string& prefix, datasource& ds) {
+        p.get(prefix + ".source_file", ds.source_file);
+        p.get(prefix + ".reader", ds.reader);
+        p.get(prefix + ".binarize", ds.binarize);
+        p.get(prefix + ".normalize", ds.normalize);
+        p.get(prefix + ".scale", ds.scale);
+        p.get(prefix + ".scale_d", ds.scale_d);
+        p.get(prefix + ".shift", ds.shift);
+        p.get(prefix + ".shift_d", ds.shift_d);
+        p.get(prefix + ".normal_noise", ds.normal_noise);
+        p.get(prefix + ".normal_noise_d", ds.normal_noise_d);
+        p.get(prefix + ".limit", ds.limit);
+    };
+
+    read_source("pretraining.samples", t.pretraining.samples);
+    read_source("pretraining_clean.samples", t.pretraining_clean.samples);
+    read_source("training.samples", t.training.samples);
+    read_source("training.labels", t.training.labels);
+    read_source("testing.samples", t.testing.samples);
+    read_source("testing.labels", t.testing.labels);
+
+    p.get("pt_desc.epochs", t.pt_desc.epochs);
+    p.get("pt_desc.denoising", t.pt_desc.denoising);
+    p.get("ft_desc.epochs", t.ft_desc.epochs);
+    p.get("w_desc.file", t.w_desc.file);
+}
+
+/*!
+ * \brief Set the runtime parameters of the network
+ * \param p The parameters
+ * \param dbn The network
+ */
+template <typename DBN>
+void set_dbn_params(const params& p, DBN& dbn) {
+    p.get("dbn.learning_rate", dbn.learning_rate);
+    p.get("dbn.momentum", dbn.initial_momentum);
+    p.get("dbn.momentum", dbn.final_momentum);
+    p.get("dbn.l1_weight_cost", dbn.l1_weight_cost);
+    p.get("dbn.l2_weight_cost", dbn.l2_weight_cost);
+}
+
+/*!
+ * \brief Set the runtime parameters of a layer of the network
+ * \param p The parameters
+ * \param prefix The prefix of the parameters of the layer
+ * \param layer The layer
+ */
+template <typename Layer>
+void set_layer_params(const params& p, const std::string& prefix, Layer& layer) {
+    // Only the RBM layers have their own training parameters
+    if constexpr (decay_layer_traits<Layer>::is_rbm_layer()) {
+        p.get(prefix + ".learning_rate", layer.learning_rate);
+        p.get(prefix + ".momentum", layer.initial_momentum);
+        p.get(prefix + ".momentum", layer.final_momentum);
+        p.get(prefix + ".l1_weight_cost", layer.l1_weight_cost);
+        p.get(prefix + ".l2_weight_cost", layer.l2_weight_cost);
+        p.get(prefix + ".sparsity_target", layer.sparsity_target);
+        p.get(prefix + ".pbias", layer.pbias);
+        p.get(prefix + ".pbias_lambda", layer.pbias_lambda);
+    } else {
+        cpp_unused(p);
+        cpp_unused(prefix);
+        cpp_unused(layer);
+    }
+}
+
+/*!
+ * \brief Set the runtime parameters of the network and of all its layers
+ * \param p The parameters
+ * \param dbn The network
+ */
+template <typename DBN>
+void set_params(const params& p, DBN& dbn) {
+    set_dbn_params(p, dbn);
+
+    dbn.for_each_layer_i([&p](size_t I, auto& layer) {
+        set_layer_params(p, "layer." + std::to_string(I), layer);
+    });
+}
+
+/*!
+ * \brief A configuration of a sweep
+ */
+struct sweep_configuration {
+    params p;                ///< The parameters of the configuration
+    std::string description; ///< The swept values of the configuration
+};
+
+/*!
+ * \brief Returns all the configurations of the sweep of the given
+ * parameters (the cartesian product of the swept values).
+ *
+ * Without sweep, the only configuration is the given parameters.
+ */
+inline std::vector<sweep_configuration> sweep_configurations(const params& p) {
+    const std::string prefix = "sweep.grid.";
+
+    std::vector<sweep_configuration> configurations{{p, ""}};
+
+    for (auto& [key, raw_values] : p.values) {
+        if (key.compare(0, prefix.size(), prefix) != 0) {
+            continue;
+        }
+
+        const auto name = key.substr(prefix.size());
+
+        std::vector<std::string> values;
+        p.get(key, values);
+
+        std::vector<sweep_configuration> next;
+
+        for (auto& configuration : configurations) {
+            for (auto& value : values) {
+                auto extended = configuration;
+
+                extended.p.values[name] = value;
+                extended.description += (extended.description.empty() ? "" : " ") + name + "=" + value;
+
+                next.push_back(std::move(extended));
+            }
+        }
+
+        configurations = std::move(next);
+    }
+
+    return configurations;
+}
+
+/*!
+ * \brief Indicates if the given datasource is streamed from a packed
+ * dataset file instead of being loaded in memory
+ */
+inline bool is_streamed(const datasource& ds) {
+    return ds.reader == "packed";
+}
+
+/*!
+ * \brief Returns the preprocessing of the given datasource, to be applied
+ * by the generator on each batch
+ */
+inline dll::runtime_preprocessing preprocessing_of(const datasource& ds) {
+    dll::runtime_preprocessing preprocessing;
+
+    preprocessing.binarize  = ds.binarize;
+    preprocessing.normalize = ds.normalize;
+    preprocessing.shift     = ds.shift ? ds.shift_d : 0.0;
+    preprocessing.scale     = ds.scale ? ds.scale_d : 1.0;
+    preprocessing.noise     = ds.normal_noise ? ds.normal_noise_d : 0.0;
+
+    return preprocessing;
+}
+
+/*!
+ * \brief Create a generator streaming the samples and the labels of the
+ * given packed dataset file through a memory mapping.
+ *
+ * The samples are never entirely loaded in memory and the preprocessing
+ * of the datasource is applied on each batch.
+ *
+ * \param dbn The network
+ * \param ds The datasource
+ */
+template <bool Three, bool Categorical, typename DBN>
+auto make_packed_generator(const DBN& dbn, const datasource& ds) {
+    using generator_desc = std::conditional_t<
+        Categorical,
+        dll::mmap_data_generator_desc<dll::batch_size<DBN::batch_size>, dll::categorical>,
+        dll::mmap_data_generator_desc<dll::batch_size<DBN::batch_size>>>;
+
+    auto generator = dll::make_mmap_generator<float, Three ? 3 : 1>(ds.source_file, dbn.output_size(), generator_desc{});
+
+    generator->preprocessing = preprocessing_of(ds);
+
+    return generator;
+}
+
 template <bool Three, typename Sample>
 bool read_samples(const datasource& ds, std::vector<Sample>& samples) {
     size_t limit = 0;
@@ -208,6 +546,90 @@ bool read_labels(const datasource& ds, std::vector<Label>& labels) {
     return !labels.empty();
 }
 
+/*!
+ * \brief A cache of the datasources read by the actions.
+ *
+ * Each datasource is read once and then shared, read-only, by all the
+ * actions and all the networks of a sweep, possibly concurrently.
+ */
+template <typename Container, bool Three>
+struct data_cache {
+    /*!
+     * \brief Returns the samples of the given datasource, reading them if
+     * necessary
+     * \return a pointer to the samples, nullptr if they cannot be read
+     */
+    const std::vector<Container>* samples(const datasource& ds) {
+        std::lock_guard<std::mutex> l(lock);
+
+        auto key = key_of(ds);
+
+        if (!sample_sets.count(key)) {
+            std::vector<Container> samples;
+
+            if (!read_samples<Three>(ds, samples)) {
+                return nullptr;
+            }
+
+            sample_sets[key] = std::move(samples);
+        }
+
+        return &sample_sets[key];
+    }
+
+    /*!
+     * \brief Returns the labels of the given datasource, reading them if
+     * necessary
+     * \return a pointer to the labels, nullptr if they cannot be read
+     */
+    const std::vector<size_t>* labels(const datasource& ds) {
+        std::lock_guard<std::mutex> l(lock);
+
+        auto key = key_of(ds);
+
+        if (!label_sets.count(key)) {
+            std::vector<size_t> labels;
+
+            if (!read_labels(ds, labels)) {
+                return nullptr;
+            }
+
+            label_sets[key] = std::move(labels);
+        }
+
+        return &label_sets[key];
+    }
+
+private:
+    /*!
+     * \brief Returns a key identifying the datasource and its preprocessing
+     */
+    static std::string key_of(const datasource& ds) {
+        std::stringstream key;
+        write_param(key, "source_file", ds.source_file);
+        write_param(key, "reader", ds.reader);
+        write_param(key, "binarize", ds.binarize);
+        write_param(key, "normalize", ds.normalize);
+        write_param(key, "scale", ds.scale ? ds.scale_d : 1.0);
+        write_param(key, "shift", ds.shift ? ds.shift_d : 0.0);
+        write_param(key, "normal_noise", ds.normal_noise ? ds.normal_noise_d : 0.0);
+        write_param(key, "limit", ds.limit);
+        return key.str();
+    }
+
+    std::mutex lock;                                              ///< The lock protecting the sets
+    std::map<std::string, std::vector<Container>> sample_sets;    ///< The samples of each datasource
+    std::map<std::string, std::vector<size_t>> label_sets;        ///< The labels of each datasource
+};
+
+/*!
+ * \brief The results of the execution of the actions on one network
+ */
+struct execution_result {
+    double train_error = -1.0; ///< The final training error (-1 if not trained)
+    double test_error  = -1.0; ///< The test error rate (-1 if not tested)
+};
+
 inline void print_title(const std::string& value) {
     std::cout << std::string(25, ' ') << std::endl;
     std::cout << std::string(25, '*') << std::endl;
@@ -217,12 +639,14 @@ inline void print_title(const std::string& value) {
 }
 
 template <typename Container, bool Three, typename DBN>
-void execute(DBN& dbn, task& task, const std::vector<std::string>& actions) {
+execution_result execute(DBN& dbn, task& task, const std::vector<std::string>& actions, data_cache<Container, Three>& data) {
     print_title("Network");
     dbn.display();
 
     using dbn_t = std::decay_t<DBN>;
 
+    execution_result result;
+
     //Execute all the actions sequentially
     for (auto& action : actions) {
         if (action == "pretrain") {
@@ -230,105 +654,117 @@ void execute(DBN& dbn, task& task, const std::vector<std::string>& actions) {
 
             if (task.pretraining.samples.empty()) {
                 std::cout << "dllp: error: pretrain is not possible without a pretraining input" << std::endl;
-                return;
+                return result;
             }
 
-            std::vector<Container> pt_samples;
+            if (is_streamed(task.pretraining.samples)) {
+                if (task.pt_desc.denoising) {
+                    std::cout << "dllp: error: denoising pretraining is not possible with a packed input" << std::endl;
+                    return result;
+                }
+
+                if constexpr (dbn_t::pretrain_possible) {
+                    auto generator = make_packed_generator<Three, false>(dbn, task.pretraining.samples);
+
+                    //Pretrain the network
+                    dbn.pretrain(*generator, task.pt_desc.epochs);
+                }
+
+                continue;
+            }
 
             //Try to read the samples
-            if (!read_samples<Three>(task.pretraining.samples, pt_samples)) {
+            auto* pt_samples = data.samples(task.pretraining.samples);
+
+            if (!pt_samples) {
                 std::cout << "dllp: error: failed to read the pretraining samples" << std::endl;
-                return;
+                return result;
             }
 
             if (task.pt_desc.denoising) {
-                std::vector<Container> clean_samples;
-
                 //Try to read the samples
-                if (!read_samples<Three>(task.pretraining_clean.samples, clean_samples)) {
+                auto* clean_samples = data.samples(task.pretraining_clean.samples);
+
+                if (!clean_samples) {
                     std::cout << "dllp: error: failed to read the clean samples" << std::endl;
-                    return;
+                    return result;
                 }
 
                 //Pretrain the network
                 if constexpr(dbn_t::pretrain_possible && dbn_t::layers_t::is_denoising) {
-                    dbn.pretrain_denoising(pt_samples.begin(), pt_samples.end(), clean_samples.begin(), clean_samples.end(), task.pt_desc.epochs);
+                    dbn.pretrain_denoising(pt_samples->begin(), pt_samples->end(), clean_samples->begin(), clean_samples->end(), task.pt_desc.epochs);
                 }
             } else {
                 if constexpr (dbn_t::pretrain_possible) {
                     //Pretrain the network
-                    dbn.pretrain(pt_samples.begin(), pt_samples.end(), task.pt_desc.epochs);
+                    dbn.pretrain(pt_samples->begin(), pt_samples->end(), task.pt_desc.epochs);
                 }
             }
         } else if (action == "train") {
             print_title("Training");
 
-            if (task.training.samples.empty() || task.training.labels.empty()) {
+            if (task.training.samples.empty() || (task.training.labels.empty() && !is_streamed(task.training.samples))) {
                 std::cout << "dllp: error: train is not possible without samples and labels" << std::endl;
-                return;
+                return result;
             }
 
-            std::vector<Container> ft_samples;
-            std::vector<size_t> ft_labels;
+            using last_layer = typename dbn_t::template layer_type<dbn_t::layers - 1>;
+
+            if(!sgd_possible<last_layer>::value){
+                std::cout << "dllp: error: The network is not trainable by SGD" << std::endl;
+                return result;
+            }
+
+            // The labels are stored with the samples in the packed file
+            if (is_streamed(task.training.samples)) {
+                if constexpr(sgd_possible<last_layer>::value) {
+                    auto generator = make_packed_generator<Three, true>(dbn, task.training.samples);
+
+                    //Train the network
+                    result.train_error = dbn.fine_tune(*generator, task.ft_desc.epochs);
+                    std::cout << "Train Classification Error:" << result.train_error << std::endl;
+                }
+
+                continue;
+            }
 
             //Try to read the samples
-            if (!read_samples<Three>(task.training.samples, ft_samples)) {
+            auto* ft_samples = data.samples(task.training.samples);
+
+            if (!ft_samples) {
                 std::cout << "dllp: error: failed to read the training samples" << std::endl;
-                return;
+                return result;
             }
 
             //Try to read the labels
-            if (!read_labels(task.training.labels, ft_labels)) {
-                std::cout << "dllp: error: failed to read the training labels" << std::endl;
-                return;
-            }
-
-            using last_layer = typename dbn_t::template layer_type<dbn_t::layers - 1>;
+            auto* ft_labels = data.labels(task.training.labels);
 
-            if(!sgd_possible<last_layer>::value){
-                std::cout << "dllp: error: The network is not trainable by SGD" << std::endl;
-                return;
+            if (!ft_labels) {
+                std::cout << "dllp: error: failed to read the training labels" << std::endl;
+                return result;
             }
 
             //Train the network
             if constexpr(sgd_possible<last_layer>::value) {
-                auto ft_error = dbn.fine_tune(ft_samples, ft_labels, task.ft_desc.epochs);
-                std::cout << "Train Classification Error:" << ft_error << std::endl;
+                result.train_error = dbn.fine_tune(*ft_samples, *ft_labels, task.ft_desc.epochs);
+                std::cout << "Train Classification Error:" << result.train_error << std::endl;
             }
         } else if (action == "test") {
             print_title("Testing");
 
-            if (task.testing.samples.empty() || task.testing.labels.empty()) {
+            if (task.testing.samples.empty() || (task.testing.labels.empty() && !is_streamed(task.testing.samples))) {
                 std::cout << "dllp: error: test is not possible without samples and labels" << std::endl;
-                return;
-            }
-
-            std::vector<Container> test_samples;
-            std::vector<size_t> test_labels;
-
-            //Try to read the samples
-            if (!read_samples<Three>(task.testing.samples, test_samples)) {
-                std::cout << "dllp: error: failed to read the test samples" << std::endl;
-                return;
-            }
-
-            //Try to read the labels
-            if (!read_labels(task.testing.labels, test_labels)) {
-                std::cout << "dllp: error: failed to read the test labels" << std::endl;
-                return;
+                return result;
             }
 
             auto classes = dbn.output_size();
 
             etl::dyn_matrix<size_t, 2> conf(classes, classes, 0.0);
 
-            size_t n  = test_samples.size();
+            size_t n  = 0;
             size_t tp = 0;
 
-            for (size_t i = 0; i < test_samples.size(); ++i) {
-                auto sample = test_samples[i];
-                auto label  = test_labels[i];
-
+            auto add_prediction = [&](const auto& sample, size_t label) {
                 auto predicted = dbn.predict(sample);
 
                 if (predicted == label) {
@@ -336,10 +772,56 @@ void execute(DBN& dbn, task& task, const std::vector<std::string>& actions) {
                 }
 
                 ++conf(label, predicted);
+                ++n;
+            };
+
+            if (is_streamed(task.testing.samples)) {
+                auto generator = make_packed_generator<Three, false>(dbn, task.testing.samples);
+
+                generator->set_test();
+                generator->reset();
+
+                while (generator->has_next_batch()) {
+                    auto data_batch  = generator->data_batch();
+                    auto label_batch = generator->label_batch();
+
+                    for (size_t i = 0; i < etl::dim<0>(data_batch); ++i) {
+                        add_prediction(data_batch(i), size_t(label_batch[i]));
+                    }
+
+                    generator->next_batch();
+                }
+            } else {
+                //Try to read the samples
+                auto* test_samples = data.samples(task.testing.samples);
+
+                if (!test_samples) {
+                    std::cout << "dllp: error: failed to read the test samples" << std::endl;
+                    return result;
+                }
+
+                //Try to read the labels
+                auto* test_labels = data.labels(task.testing.labels);
+
+                if (!test_labels) {
+                    std::cout << "dllp: error: failed to read the test labels" << std::endl;
+                    return result;
+                }
+
+                for (size_t i = 0; i < test_samples->size(); ++i) {
+                    add_prediction((*test_samples)[i], (*test_labels)[i]);
+                }
+            }
+
+            if (!n) {
+                std::cout << "dllp: error: no test samples" << std::endl;
+                return result;
             }
 
             double test_error = (n - tp) / double(n);
 
+            result.test_error = test_error;
+
             std::cout << "Error rate: " << test_error << std::endl;
             std::cout << "Accuracy: " << (1.0 - test_error) << std::endl
                       << std::endl;
@@ -397,7 +879,116 @@ void execute(DBN& dbn, task& task, const std::vector<std::string>& actions) {
         }
     }
 
-    //TODO
+    return result;
+}
+
+/*!
+ * \brief Execute the given actions on the given network
+ * \param dbn The network
+ * \param task The task
+ * \param actions The actions to execute
+ */
+template <typename Container, bool Three, typename DBN>
+execution_result execute(DBN& dbn, task& task, const std::vector<std::string>& actions) {
+    data_cache<Container, Three> data;
+    return execute<Container, Three>(dbn, task, actions, data);
+}
+
+/*!
+ * \brief Create a network with the given parameters and execute its actions
+ * \param p The parameters
+ * \param data The cache of the datasources
+ * \param suffix The suffix of the weights file
+ */
+template <typename DBN, typename Container, bool Three>
+execution_result execute_configuration(const params& p, data_cache<Container, Three>& data, const std::string& suffix) {
+    auto dbn = std::make_unique<DBN>();
+    set_params(p, *dbn);
+
+    task t;
+    read_task(p, t);
+    t.w_desc.file += suffix;
+
+    std::vector<std::string> actions;
+    p.get("actions", actions);
+
+    return execute<Container, Three>(*dbn, t, actions, data);
+}
+
+/*!
+ * \brief Run the program described by the given parameters.
+ *
+ * Without sweep, the actions are executed on a single network. With a
+ * sweep, a network is created for each configuration of the grid, and the
+ * configurations are executed back to back or concurrently, sharing the
+ * datasources. The weights of each configuration are saved with the index
+ * of the configuration appended to the weights file.
+ *
+ * \param p The parameters
+ * \return 0 on success
+ */
+template <typename DBN, typename Container, bool Three>
+int run(const params& p) {
+    data_cache<Container, Three> data;
+
+    auto configurations = sweep_configurations(p);
+
+    if (configurations.size() == 1) {
+        execute_configuration<DBN>(configurations.front().p, data, "");
+        return 0;
+    }
+
+    size_t parallel = 1;
+    p.get("sweep.parallel", parallel);
+    parallel = std::max(size_t(1), std::min(parallel, configurations.size()));
+
+    std::vector<execution_result> results(configurations.size());
+
+    std::atomic<size_t> next(0);
+
+    auto worker = [&]() {
+        size_t i;
+        while ((i = next++) < configurations.size()) {
+            print_title("Sweep " + std::to_string(i + 1) + "/" + std::to_string(configurations.size()));
+            std::cout << configurations[i].description << std::endl;
+
+            results[i] = execute_configuration<DBN>(configurations[i].p, data, "." + std::to_string(i));
+        }
+    };
+
+    if (parallel == 1) {
+        worker();
+    } else {
+        std::vector<std::thread> threads;
+
+        for (size_t t = 0; t < parallel; ++t) {
+            threads.emplace_back(worker);
+        }
+
+        for (auto& thread : threads) {
+            thread.join();
+        }
+    }
+
+    print_title("Sweep");
+
+    std::cout << std::setprecision(6);
+
+    for (size_t i = 0; i < configurations.size(); ++i) {
+        std::cout << std::setw(3) << i << " | " << configurations[i].description;
+
+        if (results[i].train_error >= 0.0) {
+            std::cout << " | Train Error: " << results[i].train_error;
+        }
+
+        if (results[i].test_error >= 0.0) {
+            std::cout << " | Test Error: " << results[i].test_error;
+        }
+
+        std::cout << std::endl;
+    }
+
+    return 0;
 }
 
 } //end of namespace processor
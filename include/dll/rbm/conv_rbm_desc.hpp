@@ -100,7 +100,7 @@ public:
     static_assert(
         detail::is_valid_v<cpp::type_list<
                              momentum_id, batch_size_id, visible_id, hidden_id, dbn_only_id,
-                             weight_decay_id, sparsity_id, trainer_rbm_id, watcher_id, clip_gradients_id,
+                             weight_decay_id, sparsity_id, trainer_rbm_id, watcher_id, clip_gradients_id, data_parallel_id, parallel_gradients_id, early_stopping_id,
                              bias_id, weight_type_id, shuffle_id, verbose_id, nop_id>,
                          Parameters...>,
         "Invalid parameters type");
@@ -333,6 +333,9 @@ struct rbm_layer_base_traits<conv_rbm_mp_impl<Desc>> {
     static constexpr auto bias_mode          = get_value_l_v<bias<dll::bias_mode::NONE>, param>;           ///< The RBM's sparsity bias mode
     static constexpr auto decay              = get_value_l_v<weight_decay<dll::decay_type::NONE>, param>;  ///< The RMB's sparsity decay type
     static constexpr bool has_sparsity       = sparsity_method != dll::sparsity_method::NONE;              ///< Does the RBM has sparsity
+    static constexpr size_t micro_batches    = get_value_l_v<data_parallel<1>, param>;                     ///< The number of micro-batches per batch
+    static constexpr size_t gradient_slices  = get_value_l_v<parallel_gradients<1>, param>;                ///< The number of slices of the filter gradients
+    static constexpr auto early_strategy     = get_value_l_v<early_stopping<strategy::NONE>, param>;       ///< The early stopping strategy of the training
 };
 
 } //end of dll namespace
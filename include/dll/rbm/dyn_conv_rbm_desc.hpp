@@ -71,7 +71,7 @@ struct dyn_conv_rbm_desc {
     //Make sure only valid types are passed to the configuration list
     static_assert(
         detail::is_valid_v<cpp::type_list<
-                             batch_size_id, momentum_id, visible_id, hidden_id, dbn_only_id, clip_gradients_id,
+                             batch_size_id, momentum_id, visible_id, hidden_id, dbn_only_id, clip_gradients_id, data_parallel_id, parallel_gradients_id, early_stopping_id,
                              weight_decay_id, sparsity_id, trainer_rbm_id, watcher_id,
                              bias_id, weight_type_id, shuffle_id, verbose_id, nop_id>,
                          Parameters...>,
@@ -66,6 +66,15 @@ struct rbm_base : layer<Parent> {
 
     weight gradient_clip = 5.0; ///< The default gradient clipping value
 
+    size_t pt_chains   = 4;   ///< The number of tempered chains (pt_cd_trainer)
+    weight pt_beta_min = 0.2; ///< The inverse temperature of the hottest chain (pt_cd_trainer)
+
+    size_t monitor_batches = 0; ///< The number of batches sampled for the epoch statistics (0 for all the batches)
+
+    double goal      = 0.0; ///< The reconstruction error goal (early stopping)
+    size_t patience  = 1;   ///< The patience for early stopping
+    double min_delta = 0.0; ///< The minimum relative decrease of the error considered as an improvement (early stopping)
+
     /*!
      * \brief Construct an empty rbm_base
      */
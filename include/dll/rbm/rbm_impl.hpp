@@ -271,6 +271,8 @@ struct rbm_layer_base_traits<rbm_impl<Desc>> {
     static constexpr auto bias_mode          = get_value_l_v<bias<dll::bias_mode::NONE>, param>;           ///< The RBM's sparsity bias mode
     static constexpr auto decay              = get_value_l_v<weight_decay<dll::decay_type::NONE>, param>;  ///< The RMB's sparsity decay type
     static constexpr bool has_sparsity       = sparsity_method != dll::sparsity_method::NONE;              ///< Does the RBM has sparsity
+    static constexpr size_t micro_batches    = get_value_l_v<data_parallel<1>, param>;                     ///< The number of micro-batches per batch
+    static constexpr auto early_strategy     = get_value_l_v<early_stopping<strategy::NONE>, param>;       ///< The early stopping strategy of the training
 };
 
 /*!
@@ -328,8 +330,11 @@ struct cg_context<rbm_impl<Desc>> {
     etl::fast_matrix<weight, num_visible, num_hidden> gr_w_tmp;
     etl::fast_vector<weight, num_hidden> gr_b_tmp;
 
-    std::vector<etl::dyn_vector<weight>> gr_probs_a;
-    std::vector<etl::dyn_vector<weight>> gr_probs_s;
+    etl::dyn_matrix<weight, 2> gr_probs_a;
+    etl::dyn_matrix<weight, 2> gr_errors;
+
+    std::vector<etl::dyn_matrix<weight, 2>> gr_w_parts;
+    std::vector<etl::dyn_matrix<weight, 1>> gr_b_parts;
 };
 
 } //end of dll namespace
@@ -144,6 +144,62 @@ struct standard_conv_rbm : public rbm_base<Parent, Desc> {
         return free_energy(as_derived().v1);
     }
 
+    /*!
+     * \brief Compute the energy of each joint configuration of the given
+     * batch
+     * \param energies The energies of the batch [B]
+     * \param v The batch of inputs [B, NC, NV1, NV2]
+     * \param h The batch of outputs [B, K, NH1, NH2]
+     */
+    template <typename E, typename V, typename H>
+    void batch_energy(E&& energies, const V& v, const H& h) const {
+        dll::auto_timer timer("crbm:batch_energy");
+
+        as_derived().batch_energy_impl(energies, v, h);
+    }
+
+    /*!
+     * \brief Compute the free energy of each input of the given batch
+     * \param energies The free energies of the batch [B]
+     * \param v The batch of inputs [B, NC, NV1, NV2]
+     */
+    template <typename E, typename V>
+    void batch_free_energy(E&& energies, const V& v) const {
+        dll::auto_timer timer("crbm:batch_free_energy");
+
+        as_derived().batch_free_energy_impl(energies, v);
+    }
+
+    /*!
+     * \brief Compute the responses of the filters to the given batch of
+     * inputs, without the biases.
+     *
+     * The responses are computed in a scratch buffer of the layer, only
+     * reallocated when the shape of the batch changes. The returned
+     * reference is only valid until the next call.
+     *
+     * \param v The batch of inputs [B, NC, NV1, NV2]
+     */
+    template <typename V>
+    etl::dyn_matrix<weight, 4>& energy_responses(const V& v) const {
+        static_assert(etl::dimensions<V>() == 4, "The energies are computed on 4D batches");
+
+        const auto& w = as_derived().w;
+
+        const size_t B   = etl::dim<0>(v);
+        const size_t K   = etl::dim<0>(w);
+        const size_t NH1 = etl::dim<2>(v) - etl::dim<2>(w) + 1;
+        const size_t NH2 = etl::dim<3>(v) - etl::dim<3>(w) + 1;
+
+        if (etl::dim<0>(energy_x) != B || etl::dim<1>(energy_x) != K || etl::dim<2>(energy_x) != NH1 || etl::dim<3>(energy_x) != NH2) {
+            energy_x = etl::dyn_matrix<weight, 4>(B, K, NH1, NH2);
+        }
+
+        energy_x = etl::conv_4d_valid_flipped(v, w);
+
+        return energy_x;
+    }
+
     friend base_type;
 
 private:
@@ -251,6 +307,8 @@ private:
         }
     }
 
+    mutable etl::dyn_matrix<weight, 4> energy_x; ///< The scratch of the responses of the energies
+
     /*!
      * \brief Returns a reference to the derived object, i.e. the object using the CRTP injector.
      * \return a reference to the derived object.
@@ -12,6 +12,8 @@
 
 #pragma once
 
+#include <cmath>
+#include <complex>
 #include <cstddef>
 #include <ctime>
 #include <random>
@@ -50,8 +52,87 @@ struct standard_crbm : public standard_conv_rbm<Derived, Desc> {
     static constexpr unit_type visible_unit = desc::visible_unit; ///< The visible unit type
     static constexpr unit_type hidden_unit  = desc::hidden_unit;  ///< The hidden unit type
 
+    mutable etl::dyn_matrix<std::complex<weight>, 4> w_fft; ///< The filters in the frequency domain (FFT path)
+    mutable bool fft_filters = false;                        ///< Indicates if w_fft is up to date with w
+
     standard_crbm() = default;
 
+    /*!
+     * \brief Indicates if the FFT path is expected to be faster than the
+     * direct convolutions, for both the hidden and visible activations.
+     *
+     * This compares the number of floating point operations of both
+     * approaches for one sample.
+     */
+    static bool prefer_fft(size_t nc, size_t k, size_t nv1, size_t nv2, size_t nw1, size_t nw2) {
+        const double nh = double(nv1 - nw1 + 1) * double(nv2 - nw2 + 1);
+        const double nv = double(nv1) * double(nv2);
+
+        const double direct = 4.0 * k * nc * nh * nw1 * nw2;
+        const double fft    = 2.0 * (nc + k) * 5.0 * nv * std::log2(nv) + 16.0 * k * nc * nv;
+
+        return fft < direct;
+    }
+
+    /*!
+     * \brief Compute the filters in the frequency domain, if the FFT path
+     * is faster for inputs of the size of the given batch.
+     *
+     * The activations then use the FFT path until release_filters() is
+     * called. This must be called again after each modification of the
+     * weights.
+     *
+     * \param v A batch of inputs
+     */
+    template <typename V>
+    void prepare_filters(const V& v) const {
+        const auto& w = as_derived().w;
+
+        const size_t K   = etl::dim<0>(w);
+        const size_t NC  = etl::dim<1>(w);
+        const size_t NW1 = etl::dim<2>(w);
+        const size_t NW2 = etl::dim<3>(w);
+        const size_t NV1 = etl::dim<2>(v);
+        const size_t NV2 = etl::dim<3>(v);
+
+        if (!prefer_fft(NC, K, NV1, NV2, NW1, NW2)) {
+            return;
+        }
+
+        dll::auto_timer timer("crbm:prepare_filters");
+
+        if (etl::dim<0>(w_fft) != K || etl::dim<1>(w_fft) != NC || etl::dim<2>(w_fft) != NV1 || etl::dim<3>(w_fft) != NV2) {
+            w_fft = etl::dyn_matrix<std::complex<weight>, 4>(K, NC, NV1, NV2);
+        }
+
+        etl::dyn_matrix<std::complex<weight>, 2> tmp(NV1, NV2);
+
+        for (size_t k = 0; k < K; ++k) {
+            for (size_t c = 0; c < NC; ++c) {
+                tmp = std::complex<weight>(0.0);
+
+                for (size_t i = 0; i < NW1; ++i) {
+                    for (size_t j = 0; j < NW2; ++j) {
+                        tmp(i, j) = w(k, c, i, j);
+                    }
+                }
+
+                w_fft(k)(c) = etl::fft_2d(tmp);
+            }
+        }
+
+        w_fft.ensure_cpu_up_to_date();
+
+        fft_filters = true;
+    }
+
+    /*!
+     * \brief Go back to the direct convolutions
+     */
+    void release_filters() const {
+        fft_filters = false;
+    }
+
     // Make base class them participate in overload resolution
     using base_type::activate_hidden;
     using base_type::batch_activate_hidden;
@@ -135,7 +216,15 @@ struct standard_crbm : public standard_conv_rbm<Derived, Desc> {
 
         using namespace etl;
 
-        h_a = etl::conv_4d_valid_flipped(v_a, as_derived().w);
+        if constexpr (etl::all_dma<H1, V1>) {
+            if (fft_filters) {
+                fft_valid_flipped(h_a, v_a);
+            } else {
+                h_a = etl::conv_4d_valid_flipped(v_a, as_derived().w);
+            }
+        } else {
+            h_a = etl::conv_4d_valid_flipped(v_a, as_derived().w);
+        }
 
         auto b_rep = as_derived().get_batch_b_rep(v_a);
 
@@ -168,7 +257,15 @@ struct standard_crbm : public standard_conv_rbm<Derived, Desc> {
 
         as_derived().template validate_outputs<H1, H2, 1>();
 
-        v_a = etl::conv_4d_full(h_s, as_derived().w);
+        if constexpr (etl::all_dma<H2, V1>) {
+            if (fft_filters) {
+                fft_full(v_a, h_s);
+            } else {
+                v_a = etl::conv_4d_full(h_s, as_derived().w);
+            }
+        } else {
+            v_a = etl::conv_4d_full(h_s, as_derived().w);
+        }
 
         auto c_rep = as_derived().get_batch_c_rep(h_s);
 
@@ -188,13 +285,168 @@ struct standard_crbm : public standard_conv_rbm<Derived, Desc> {
     friend base_type;
 
 private:
+    /*!
+     * \brief Compute the valid (flipped) convolution of a batch of inputs
+     * with the filters, with the cached frequency-domain filters.
+     *
+     * Since the output is smaller than the input, the circular
+     * correlation of the size of the input is exact on the output.
+     */
+    template <typename H, typename V>
+    void fft_valid_flipped(H&& h_a, const V& v_a) const {
+        dll::auto_timer timer("crbm:fft_valid_flipped");
+
+        using complex_t = std::complex<weight>;
+
+        const size_t B   = etl::dim<0>(v_a);
+        const size_t NC  = etl::dim<1>(v_a);
+        const size_t NV1 = etl::dim<2>(v_a);
+        const size_t NV2 = etl::dim<3>(v_a);
+        const size_t K   = etl::dim<1>(h_a);
+        const size_t NH1 = etl::dim<2>(h_a);
+        const size_t NH2 = etl::dim<3>(h_a);
+        const size_t N   = NV1 * NV2;
+
+        etl::dyn_matrix<complex_t, 3> v_f(NC, NV1, NV2);
+        etl::dyn_matrix<complex_t, 2> tmp(NV1, NV2);
+        etl::dyn_matrix<complex_t, 2> acc(NV1, NV2);
+
+        v_a.ensure_cpu_up_to_date();
+
+        const weight* v_ptr = v_a.memory_start();
+        weight* h_ptr       = h_a.memory_start();
+
+        for (size_t b = 0; b < B; ++b) {
+            for (size_t c = 0; c < NC; ++c) {
+                const weight* in = v_ptr + (b * NC + c) * N;
+
+                for (size_t i = 0; i < N; ++i) {
+                    tmp[i] = in[i];
+                }
+
+                v_f(c) = etl::fft_2d(tmp);
+            }
+
+            v_f.ensure_cpu_up_to_date();
+
+            for (size_t k = 0; k < K; ++k) {
+                acc = complex_t(0.0);
+                acc.ensure_cpu_up_to_date();
+
+                complex_t* a = acc.memory_start();
+
+                for (size_t c = 0; c < NC; ++c) {
+                    const complex_t* x = v_f.memory_start() + c * N;
+                    const complex_t* f = w_fft.memory_start() + (k * NC + c) * N;
+
+                    for (size_t i = 0; i < N; ++i) {
+                        a[i] += x[i] * std::conj(f[i]);
+                    }
+                }
+
+                acc.invalidate_gpu();
+
+                tmp = etl::ifft_2d(acc);
+                tmp.ensure_cpu_up_to_date();
+
+                weight* out = h_ptr + (b * K + k) * NH1 * NH2;
+
+                for (size_t i = 0; i < NH1; ++i) {
+                    for (size_t j = 0; j < NH2; ++j) {
+                        out[i * NH2 + j] = tmp(i, j).real();
+                    }
+                }
+            }
+        }
+
+        h_a.invalidate_gpu();
+    }
+
+    /*!
+     * \brief Compute the full convolution of a batch of hidden units with
+     * the filters, with the cached frequency-domain filters.
+     *
+     * The output has exactly the size of the FFT, so the circular
+     * convolution is the linear one.
+     */
+    template <typename V, typename H>
+    void fft_full(V&& v_a, const H& h_s) const {
+        dll::auto_timer timer("crbm:fft_full");
+
+        using complex_t = std::complex<weight>;
+
+        const size_t B   = etl::dim<0>(h_s);
+        const size_t K   = etl::dim<1>(h_s);
+        const size_t NH1 = etl::dim<2>(h_s);
+        const size_t NH2 = etl::dim<3>(h_s);
+        const size_t NC  = etl::dim<1>(v_a);
+        const size_t NV1 = etl::dim<2>(v_a);
+        const size_t NV2 = etl::dim<3>(v_a);
+        const size_t N   = NV1 * NV2;
+
+        etl::dyn_matrix<complex_t, 3> h_f(K, NV1, NV2);
+        etl::dyn_matrix<complex_t, 2> tmp(NV1, NV2);
+        etl::dyn_matrix<complex_t, 2> acc(NV1, NV2);
+
+        h_s.ensure_cpu_up_to_date();
+
+        const weight* h_ptr = h_s.memory_start();
+        weight* v_ptr       = v_a.memory_start();
+
+        for (size_t b = 0; b < B; ++b) {
+            for (size_t k = 0; k < K; ++k) {
+                const weight* in = h_ptr + (b * K + k) * NH1 * NH2;
+
+                tmp = complex_t(0.0);
+
+                for (size_t i = 0; i < NH1; ++i) {
+                    for (size_t j = 0; j < NH2; ++j) {
+                        tmp(i, j) = in[i * NH2 + j];
+                    }
+                }
+
+                h_f(k) = etl::fft_2d(tmp);
+            }
+
+            h_f.ensure_cpu_up_to_date();
+
+            for (size_t c = 0; c < NC; ++c) {
+                acc = complex_t(0.0);
+                acc.ensure_cpu_up_to_date();
+
+                complex_t* a = acc.memory_start();
+
+                for (size_t k = 0; k < K; ++k) {
+                    const complex_t* x = h_f.memory_start() + k * N;
+                    const complex_t* f = w_fft.memory_start() + (k * NC + c) * N;
+
+                    for (size_t i = 0; i < N; ++i) {
+                        a[i] += x[i] * f[i];
+                    }
+                }
+
+                acc.invalidate_gpu();
+
+                tmp = etl::ifft_2d(acc);
+                tmp.ensure_cpu_up_to_date();
+
+                weight* out = v_ptr + (b * NC + c) * N;
+
+                for (size_t i = 0; i < N; ++i) {
+                    out[i] = tmp[i].real();
+                }
+            }
+        }
+
+        v_a.invalidate_gpu();
+    }
+
     template<typename Input, typename Out>
     weight energy_impl(const Input& v, const Out& h) const {
         static_assert(etl::is_etl_expr<Out>, "energy_impl works with ETL expressions only");
 
         auto rv = as_derived().reshape_v_a(v);
-        auto tmp = as_derived().energy_tmp();
-        tmp = etl::conv_4d_valid_flipped(rv, as_derived().w);
+        auto& tmp = as_derived().energy_responses(rv);
 
         if constexpr (desc::visible_unit == unit_type::BINARY && desc::hidden_unit == unit_type::BINARY) {
             //Definition according to Honglak Lee
@@ -215,8 +467,7 @@ private:
     template<typename Input>
     weight free_energy_impl(const Input& v) const {
         auto rv = as_derived().reshape_v_a(v);
-        auto tmp = as_derived().energy_tmp();
-        tmp = etl::conv_4d_valid_flipped(rv, as_derived().w);
+        auto& tmp = as_derived().energy_responses(rv);
 
         if constexpr (desc::visible_unit == unit_type::BINARY && desc::hidden_unit == unit_type::BINARY) {
             //Definition computed from E(v,h)
@@ -236,6 +487,54 @@ private:
         }
     }
 
+    template <typename E, typename V, typename H>
+    void batch_energy_impl(E&& energies, const V& v, const H& h) const {
+        static_assert(etl::dimensions<H>() == 4, "The energies are computed on 4D batches");
+
+        auto& x = as_derived().energy_responses(v);
+
+        if constexpr (desc::visible_unit == unit_type::BINARY && desc::hidden_unit == unit_type::BINARY) {
+            energies = -etl::sum_r(h >> x);
+
+            for (size_t i = 0; i < etl::dim<0>(v); ++i) {
+                energies[i] -= etl::sum(as_derived().c >> etl::sum_r(v(i))) + etl::sum(as_derived().b >> etl::sum_r(h(i)));
+            }
+        } else if constexpr (desc::visible_unit == unit_type::GAUSSIAN && desc::hidden_unit == unit_type::BINARY) {
+            auto c_rep = as_derived().get_c_rep();
+
+            energies = -etl::sum_r(h >> x);
+
+            for (size_t i = 0; i < etl::dim<0>(v); ++i) {
+                energies[i] += -sum(etl::pow(v(i) - c_rep, 2) / 2.0) - etl::sum(as_derived().b >> etl::sum_r(h(i)));
+            }
+        } else {
+            energies = 0.0;
+        }
+    }
+
+    template <typename E, typename V>
+    void batch_free_energy_impl(E&& energies, const V& v) const {
+        auto& x = as_derived().energy_responses(v);
+
+        // The softplus of the whole batch is reduced at once
+        auto b_rep = as_derived().get_batch_b_rep(v);
+        energies   = -etl::sum_r(etl::log(1.0 + etl::exp(b_rep + x)));
+
+        if constexpr (desc::visible_unit == unit_type::BINARY && desc::hidden_unit == unit_type::BINARY) {
+            for (size_t i = 0; i < etl::dim<0>(v); ++i) {
+                energies[i] -= etl::sum(as_derived().c >> etl::sum_r(v(i)));
+            }
+        } else if constexpr (desc::visible_unit == unit_type::GAUSSIAN && desc::hidden_unit == unit_type::BINARY) {
+            auto c_rep = as_derived().get_c_rep();
+
+            for (size_t i = 0; i < etl::dim<0>(v); ++i) {
+                energies[i] -= sum(etl::pow(v(i) - c_rep, 2) / 2.0);
+            }
+        } else {
+            energies = 0.0;
+        }
+    }
+
     /*!
      * \brief Returns a reference to the derived object, i.e. the object using the CRTP injector.
      * \return a reference to the derived object.
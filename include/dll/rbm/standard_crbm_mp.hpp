@@ -25,6 +25,7 @@
 #include "dll/rbm/standard_conv_rbm.hpp" //The base class
 #include "dll/base_conf.hpp"             //The configuration helpers
 #include "dll/rbm/rbm_tmp.hpp"           // static_if macros
+#include "dll/util/random.hpp"           // lane_random
 
 namespace dll {
 
@@ -161,6 +162,23 @@ struct standard_crbm_mp : public standard_conv_rbm<Derived, Desc> {
 
         h_a = etl::conv_4d_valid_flipped(v_a, as_derived().w);
 
+        // Exponentials, block sums, normalization and sampling in one pass
+        if constexpr (hidden_unit == unit_type::BINARY && etl::all_dma<H1, H2>) {
+            if (complete_blocks(h_a)) {
+                constexpr weight scale = visible_unit == unit_type::GAUSSIAN ? 1.0 / (0.1 * 0.1) : 1.0;
+
+                fused_p_max_pool<S, true>(h_a, h_a, h_s, scale);
+
+                nan_check_deep(h_a);
+
+                if (S) {
+                    nan_check_deep(h_s);
+                }
+
+                return;
+            }
+        }
+
         auto b_rep = as_derived().get_batch_b_rep(v_a);
 
         // Note: this is wrong because of PMP
@@ -198,10 +216,25 @@ struct standard_crbm_mp : public standard_conv_rbm<Derived, Desc> {
         cpp_assert(etl::dim<0>(v_a) == Batch, "The number of batch must be consistent");
         cpp_unused(Batch);
 
-        auto b_rep = as_derived().get_batch_b_rep(v_a);
-
         auto h_a = etl::force_temporary(etl::conv_4d_valid_flipped(v_a, as_derived().w));
 
+        // Exponentials, block sums, normalization and sampling in one pass
+        if constexpr (etl::all_dma<Po>) {
+            if (complete_blocks(h_a)) {
+                fused_p_max_pool<S, false>(h_a, p_a, p_s, weight(1.0));
+
+                nan_check_etl(p_a);
+
+                if (S) {
+                    nan_check_etl(p_s);
+                }
+
+                return;
+            }
+        }
+
+        auto b_rep = as_derived().get_batch_b_rep(v_a);
+
         if (pooling_unit == unit_type::BINARY) {
             p_a = etl::p_max_pool_p(b_rep + h_a, C(), C());
         }
@@ -291,6 +324,20 @@ struct standard_crbm_mp : public standard_conv_rbm<Derived, Desc> {
         batch_activate_pooling(batch_reshape(output), batch_reshape(input));
     }
 
+    /*!
+     * \brief Prepare the filters for the activations of a batch.
+     *
+     * The FFT path of standard_crbm is not implemented with probabilistic
+     * max pooling, the direct convolutions are always used.
+     */
+    template <typename V>
+    void prepare_filters(const V& /*v*/) const {}
+
+    /*!
+     * \brief Release the prepared filters
+     */
+    void release_filters() const {}
+
     friend base_type;
 
 private:
@@ -298,13 +345,195 @@ private:
         return as_derived().pool_C();
     }
 
+    /*!
+     * \brief Indicates if the hidden units of the given batch are exactly
+     * covered by the pooling blocks
+     */
+    template <typename H>
+    bool complete_blocks(const H& h) const {
+        return etl::dim<2>(h) % C() == 0 && etl::dim<3>(h) % C() == 0;
+    }
+
+    /*!
+     * \brief Compute the probabilistic max pooling of a batch of
+     * pre-activations, one strip of C rows at a time.
+     *
+     * For each strip, the energies of the units are computed once and
+     * kept in cache for the exponentials, the block sums, the
+     * normalization and the multinomial sampling of each block (at most
+     * one unit of a block is on). The loops run over the width of the
+     * strip, which is contiguous in memory.
+     *
+     * \tparam S Indicates if the units are sampled
+     * \tparam Hidden If true, compute the hidden units, otherwise the pooling units
+     *
+     * \param x The batch of pre-activations, without the biases
+     * \param a The probabilities to set (can be x in hidden mode)
+     * \param s The samples to set (if S)
+     * \param scale The factor of the energies
+     */
+    template <bool S, bool Hidden, typename X, typename A, typename Sa>
+    void fused_p_max_pool(const X& x, A&& a, Sa&& s, weight scale) const {
+        dll::auto_timer timer("crbm:mp:fused_p_max_pool");
+
+        const size_t B   = etl::dim<0>(x);
+        const size_t K   = etl::dim<1>(x);
+        const size_t NH1 = etl::dim<2>(x);
+        const size_t NH2 = etl::dim<3>(x);
+        const size_t c   = C();
+        const size_t NP2 = NH2 / c;
+        const size_t N   = c * NH2;
+
+        cpp_assert(NH1 % c == 0 && NH2 % c == 0, "Invalid pooling factor for fused_p_max_pool");
+
+        decltype(auto) b = as_derived().b;
+
+        x.ensure_cpu_up_to_date();
+        b.ensure_cpu_up_to_date();
+
+        const weight* x_ptr = x.memory_start();
+        const weight* b_ptr = b.memory_start();
+        weight* a_ptr       = a.memory_start();
+        weight* s_ptr       = nullptr;
+
+        if constexpr (S) {
+            s_ptr = s.memory_start();
+        } else {
+            cpp_unused(s);
+        }
+
+        std::vector<weight> e(N);      // The energies, then the exponentials, of the strip
+        std::vector<weight> m(NH2);    // The maximum energy of the block of each column
+        std::vector<weight> norm(NH2); // The inverse normalization of the block of each column
+        std::vector<weight> off(NP2);  // The probability of each block to be off
+
+        // Can be called concurrently on micro-batches
+        lane_random rng(S ? next_stream_seed() : 1);
+
+        for (size_t bk = 0; bk < B * K; ++bk) {
+            const weight bias = b_ptr[bk % K];
+
+            for (size_t r = 0; r < NH1 / c; ++r) {
+                const weight* in = x_ptr + bk * NH1 * NH2 + r * N;
+
+                // Energies of the strip and maximum of each block (0 for the off state)
+
+                for (size_t i = 0; i < N; ++i) {
+                    e[i] = scale * (in[i] + bias);
+                }
+
+                for (size_t j = 0; j < NP2; ++j) {
+                    weight max = 0.0;
+
+                    for (size_t ii = 0; ii < c; ++ii) {
+                        for (size_t jj = 0; jj < c; ++jj) {
+                            max = std::max(max, e[ii * NH2 + j * c + jj]);
+                        }
+                    }
+
+                    for (size_t jj = 0; jj < c; ++jj) {
+                        m[j * c + jj] = max;
+                    }
+                }
+
+                // Exponentials
+
+                for (size_t ii = 0; ii < c; ++ii) {
+                    weight* row = e.data() + ii * NH2;
+
+                    for (size_t j = 0; j < NH2; ++j) {
+                        row[j] = std::exp(row[j] - m[j]);
+                    }
+                }
+
+                // Block sums and normalization
+
+                for (size_t j = 0; j < NP2; ++j) {
+                    weight sum = std::exp(-m[j * c]);
+
+                    for (size_t ii = 0; ii < c; ++ii) {
+                        for (size_t jj = 0; jj < c; ++jj) {
+                            sum += e[ii * NH2 + j * c + jj];
+                        }
+                    }
+
+                    off[j] = std::exp(-m[j * c]) / sum;
+
+                    for (size_t jj = 0; jj < c; ++jj) {
+                        norm[j * c + jj] = weight(1.0) / sum;
+                    }
+                }
+
+                for (size_t ii = 0; ii < c; ++ii) {
+                    weight* row = e.data() + ii * NH2;
+
+                    for (size_t j = 0; j < NH2; ++j) {
+                        row[j] *= norm[j];
+                    }
+                }
+
+                // Store the probabilities
+
+                if constexpr (Hidden) {
+                    std::copy(e.begin(), e.end(), a_ptr + bk * NH1 * NH2 + r * N);
+                } else {
+                    weight* out = a_ptr + bk * (NH1 / c) * NP2 + r * NP2;
+
+                    for (size_t j = 0; j < NP2; ++j) {
+                        out[j] = weight(1.0) - off[j];
+                    }
+                }
+
+                // Multinomial sampling of each block
+
+                if constexpr (S) {
+                    weight* out = Hidden ? s_ptr + bk * NH1 * NH2 + r * N : s_ptr + bk * (NH1 / c) * NP2 + r * NP2;
+
+                    if constexpr (Hidden) {
+                        std::fill(out, out + N, weight(0.0));
+                    }
+
+                    for (size_t j = 0; j < NP2; ++j) {
+                        const weight u = rng();
+
+                        weight cumulative = 0.0;
+                        bool on           = false;
+
+                        for (size_t ii = 0; ii < c && !on; ++ii) {
+                            for (size_t jj = 0; jj < c && !on; ++jj) {
+                                cumulative += e[ii * NH2 + j * c + jj];
+
+                                if (u < cumulative) {
+                                    on = true;
+
+                                    if constexpr (Hidden) {
+                                        out[ii * NH2 + j * c + jj] = 1.0;
+                                    }
+                                }
+                            }
+                        }
+
+                        if constexpr (!Hidden) {
+                            out[j] = on ? 1.0 : 0.0;
+                        }
+                    }
+                }
+            }
+        }
+
+        a.invalidate_gpu();
+
+        if constexpr (S) {
+            s.invalidate_gpu();
+        }
+    }
+
     template<typename Input, typename Out>
     weight energy_impl(const Input& v, const Out& h) const {
         static_assert(etl::is_etl_expr<Out>, "energy_impl works with ETL expressions only");
 
         auto rv = as_derived().reshape_v_a(v);
-        auto tmp = as_derived().energy_tmp();
-        tmp = etl::conv_4d_valid_flipped(as_derived().reshape_v_a(rv), as_derived().w);
+        auto& tmp = as_derived().energy_responses(rv);
 
         if  constexpr (desc::visible_unit == unit_type::BINARY && desc::hidden_unit == unit_type::BINARY) {
             //Definition according to Honglak Lee
@@ -325,8 +554,7 @@ private:
     template <typename Input>
     weight free_energy_impl(const Input& v) const {
         auto rv = as_derived().reshape_v_a(v);
-        auto tmp = as_derived().energy_tmp();
-        tmp = etl::conv_4d_valid_flipped(rv, as_derived().w);
+        auto& tmp = as_derived().energy_responses(rv);
 
         if  constexpr (desc::visible_unit == unit_type::BINARY && desc::hidden_unit == unit_type::BINARY) {
             //Definition computed from E(v,h)
@@ -348,6 +576,54 @@ private:
         }
     }
 
+    template <typename E, typename V, typename H>
+    void batch_energy_impl(E&& energies, const V& v, const H& h) const {
+        static_assert(etl::dimensions<H>() == 4, "The energies are computed on 4D batches");
+
+        auto& x = as_derived().energy_responses(v);
+
+        if constexpr (desc::visible_unit == unit_type::BINARY && desc::hidden_unit == unit_type::BINARY) {
+            energies = -etl::sum_r(h >> x);
+
+            for (size_t i = 0; i < etl::dim<0>(v); ++i) {
+                energies[i] -= etl::sum(as_derived().c >> etl::sum_r(v(i))) + etl::sum(as_derived().b >> etl::sum_r(h(i)));
+            }
+        } else if constexpr (desc::visible_unit == unit_type::GAUSSIAN && desc::hidden_unit == unit_type::BINARY) {
+            auto c_rep = as_derived().get_c_rep();
+
+            energies = -etl::sum_r(h >> x);
+
+            for (size_t i = 0; i < etl::dim<0>(v); ++i) {
+                energies[i] += sum(etl::pow(v(i) - c_rep, 2) / 2.0) - etl::sum(as_derived().b >> etl::sum_r(h(i)));
+            }
+        } else {
+            energies = 0.0;
+        }
+    }
+
+    template <typename E, typename V>
+    void batch_free_energy_impl(E&& energies, const V& v) const {
+        auto& x = as_derived().energy_responses(v);
+
+        // The softplus of the whole batch is reduced at once
+        auto b_rep = as_derived().get_batch_b_rep(v);
+        energies   = -etl::sum_r(etl::log(1.0 + etl::exp(b_rep + x)));
+
+        if constexpr (desc::visible_unit == unit_type::BINARY && desc::hidden_unit == unit_type::BINARY) {
+            for (size_t i = 0; i < etl::dim<0>(v); ++i) {
+                energies[i] -= etl::sum(as_derived().c >> etl::sum_r(v(i)));
+            }
+        } else if constexpr (desc::visible_unit == unit_type::GAUSSIAN && desc::hidden_unit == unit_type::BINARY) {
+            auto c_rep = as_derived().get_c_rep();
+
+            for (size_t i = 0; i < etl::dim<0>(v); ++i) {
+                energies[i] -= sum(etl::pow(v(i) - c_rep, 2) / 2.0);
+            }
+        } else {
+            energies = 0.0;
+        }
+    }
+
     /*!
      * \brief Returns a reference to the derived object, i.e. the object using the CRTP injector.
      * \return a reference to the derived object.
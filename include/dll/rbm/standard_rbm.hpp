@@ -20,6 +20,8 @@
 
 #include "dll/util/checks.hpp"    //NaN checks
 #include "dll/util/timers.hpp"    //auto_timer
+#include "dll/util/random.hpp"    //lane_random
+#include "dll/util/sparse_batch.hpp" //sparse_batch
 #include "dll/rbm/rbm_base.hpp"       //The base class
 #include "dll/base_conf.hpp"      //Descriptor configuration
 #include "dll/rbm/rbm_tmp.hpp"        // static_if macros
@@ -48,9 +50,14 @@ struct standard_rbm : public rbm_base<Parent, Desc> {
     static constexpr unit_type visible_unit = desc::visible_unit; ///< The type of visible unit
     static constexpr unit_type hidden_unit  = desc::hidden_unit;  ///< The type of hidden unit
 
+    static constexpr bool sparse_input = desc::parameters::template contains<dll::sparse_input>(); ///< Indicates if the inputs are very sparse
+
     static_assert(visible_unit != unit_type::SOFTMAX, "Softmax Visible units are not support");
     static_assert(hidden_unit != unit_type::GAUSSIAN, "Gaussian hidden units are not supported");
 
+    mutable etl::dyn_matrix<weight, 2> w_t;  ///< The transposed weights (for the visible activations of batches)
+    mutable bool transposed_weights = false; ///< Indicates if w_t is up to date with w
+
     /*!
      * \brief Construct empty standard_rbm
      */
@@ -91,6 +98,63 @@ struct standard_rbm : public rbm_base<Parent, Desc> {
         return free_energy(rbm, rbm.v1);
     }
 
+    /*!
+     * \brief Compute the energy of each joint configuration of the given
+     * batch
+     * \param energies The energies of the batch [B]
+     * \param v The batch of inputs [B, NV]
+     * \param h The batch of outputs [B, NH]
+     */
+    template <typename E, typename V, typename H>
+    void batch_energy(E&& energies, const V& v, const H& h) const {
+        dll::auto_timer timer("rbm:batch_energy");
+
+        auto& rbm = as_derived();
+
+        const size_t B = etl::dim<0>(v);
+
+        auto rv = etl::reshape(v, B, rbm.num_visible);
+        auto& x = energy_responses(rv);
+
+        if constexpr (visible_unit == unit_type::BINARY && hidden_unit == unit_type::BINARY) {
+            energies = -(rv * rbm.c) - (h * rbm.b) - etl::sum_r(h >> x);
+        } else if constexpr (visible_unit == unit_type::GAUSSIAN && hidden_unit == unit_type::BINARY) {
+            energies = etl::sum_r(etl::pow(rv - etl::rep_l(rbm.c, B), 2) / 2.0) - (h * rbm.b) - etl::sum_r(h >> x);
+        } else {
+            energies = 0.0;
+        }
+    }
+
+    /*!
+     * \brief Compute the free energy of each input of the given batch.
+     *
+     * The activations of the whole batch are computed with a single matrix
+     * multiplication, in a scratch buffer of the layer, and the softplus is
+     * reduced at once.
+     *
+     * \param energies The free energies of the batch [B]
+     * \param v The batch of inputs [B, NV]
+     */
+    template <typename E, typename V>
+    void batch_free_energy(E&& energies, const V& v) const {
+        dll::auto_timer timer("rbm:batch_free_energy");
+
+        auto& rbm = as_derived();
+
+        const size_t B = etl::dim<0>(v);
+
+        auto rv = etl::reshape(v, B, rbm.num_visible);
+        auto x = etl::bias_add_2d(energy_responses(rv), rbm.b);
+
+        if constexpr (visible_unit == unit_type::BINARY && hidden_unit == unit_type::BINARY) {
+            energies = -(rv * rbm.c) - etl::sum_r(etl::log(1.0 + etl::exp(x)));
+        } else if constexpr (visible_unit == unit_type::GAUSSIAN && hidden_unit == unit_type::BINARY) {
+            energies = etl::sum_r(etl::pow(rv - etl::rep_l(rbm.c, B), 2) / 2.0) - etl::sum_r(etl::log(1.0 + etl::exp(x)));
+        } else {
+            energies = 0.0;
+        }
+    }
+
     //Various functions
 
     /*!
@@ -170,7 +234,40 @@ struct standard_rbm : public rbm_base<Parent, Desc> {
 
     template <bool P = true, bool S = true, typename H, typename V>
     void batch_activate_visible(const H& h_a, const H& h_s, V&& v_a, V&& v_s) const {
-        batch_std_activate_visible<P, S>(h_a, h_s, std::forward<V>(v_a), std::forward<V>(v_s), as_derived().c, as_derived().w);
+        if (transposed_weights) {
+            batch_std_activate_visible<P, S, true>(h_a, h_s, std::forward<V>(v_a), std::forward<V>(v_s), as_derived().c, w_t);
+        } else {
+            batch_std_activate_visible<P, S>(h_a, h_s, std::forward<V>(v_a), std::forward<V>(v_s), as_derived().c, as_derived().w);
+        }
+    }
+
+    /*!
+     * \brief Compute the transposed weights, so that the visible
+     * activations of batches are plain products with contiguous weights.
+     *
+     * The visible activations of batches then use the transposed weights
+     * until release_weights() is called. This must be called again after
+     * each modification of the weights.
+     */
+    void prepare_weights() const {
+        dll::auto_timer timer("rbm:prepare_weights");
+
+        const auto& w = as_derived().w;
+
+        if (etl::dim<0>(w_t) != etl::dim<1>(w) || etl::dim<1>(w_t) != etl::dim<0>(w)) {
+            w_t = etl::dyn_matrix<weight, 2>(etl::dim<1>(w), etl::dim<0>(w));
+        }
+
+        w_t = etl::transpose(w);
+
+        transposed_weights = true;
+    }
+
+    /*!
+     * \brief Go back to the products with the transposed weights
+     */
+    void release_weights() const {
+        transposed_weights = false;
     }
 
     // batch_activate_hidden
@@ -187,6 +284,52 @@ struct standard_rbm : public rbm_base<Parent, Desc> {
         batch_std_activate_hidden<P, S>(std::forward<H1>(h_a), std::forward<H2>(h_s), v_a, v_s, as_derived().b, as_derived().w);
     }
 
+    /*!
+     * \brief Compute the hidden representation from the given input, as well
+     * as the sum of the activation probabilities of each hidden unit over the
+     * batch.
+     *
+     * With binary hidden units, the sums are accumulated inside the sigmoid
+     * kernel, without another pass over the activations.
+     *
+     * \param h_a The batch output to set the activation probabilities of the hidden representation
+     * \param h_s The batch output to set the activation samples of the hidden representation
+     * \param v_a The batch input activation probabilities of the visible representation
+     * \param v_s The batch input the activation samples of the visible representation
+     * \param h_sum The output to set the sums of the activation probabilities
+     */
+    template <bool S = true, typename H1, typename H2, typename V, typename Sum>
+    void batch_activate_hidden_sums(H1&& h_a, H2&& h_s, const V& v_a, const V& v_s, Sum&& h_sum) const {
+        using bias_t = std::decay_t<decltype(as_derived().b)>;
+
+        if constexpr (hidden_unit == unit_type::BINARY && etl::all_dma<H1, H2, bias_t, Sum>) {
+            batch_std_activate_hidden<true, S>(std::forward<H1>(h_a), std::forward<H2>(h_s), v_a, v_s, as_derived().b, as_derived().w, h_sum.memory_start());
+
+            h_sum.invalidate_gpu();
+        } else {
+            batch_std_activate_hidden<true, S>(h_a, h_s, v_a, v_s, as_derived().b, as_derived().w);
+
+            h_sum = etl::sum_l(h_a);
+        }
+    }
+
+    /*!
+     * \brief Compute the hidden representation from the given batch of input.
+     *
+     * Special functions to be used by optimizer.
+     *
+     * \param h_a The batch output to set the activation probabilities of the hidden representation
+     * \param h_s The batch output to set the activation samples of the hidden representation
+     * \param v_a The batch input activation probabilities of the visible representation
+     * \param v_s The batch input the activation samples of the visible representation
+     * \param b The biases
+     * \param w The weights
+     */
+    template <bool P = true, bool S = true, typename H1, typename H2, typename V, typename B, typename W>
+    void batch_activate_hidden(H1&& h_a, H2&& h_s, const V& v_a, const V& v_s, const B& b, const W& w) const {
+        batch_std_activate_hidden<P, S>(std::forward<H1>(h_a), std::forward<H2>(h_s), v_a, v_s, b, w);
+    }
+
     /*!
      * \brief Compute the hidden representation from a given batch of input
      *
@@ -429,6 +572,24 @@ private:
         }
     }
 
+    /*!
+     * \brief Compute the activations of the given batch of inputs, without
+     * the biases, in the energy scratch of the layer (only reallocated when
+     * the size of the batch changes)
+     */
+    template <typename V>
+    etl::dyn_matrix<weight, 2>& energy_responses(const V& rv) const {
+        const size_t B = etl::dim<0>(rv);
+
+        if (etl::dim<0>(energy_x) != B || etl::dim<1>(energy_x) != as_derived().num_hidden) {
+            energy_x = etl::dyn_matrix<weight, 2>(B, as_derived().num_hidden);
+        }
+
+        energy_x = rv * as_derived().w;
+
+        return energy_x;
+    }
+
     //Note: Considering that energy and free energy are not critical, their implementations
     //are not highly optimized.
 
@@ -440,16 +601,12 @@ private:
             //Definition according to G. Hinton
             //E(v,h) = -sum(ai*vi) - sum(bj*hj) -sum(vi*hj*wij)
 
-            auto x = rbm.b + rv * rbm.w;
-
-            return -etl::dot(rbm.c, rv) - etl::dot(rbm.b, h) - etl::sum(x);
+            return -etl::dot(rbm.c, rv) - etl::dot(rbm.b, h) - etl::dot(h, rv * rbm.w);
         } else if constexpr (visible_unit == unit_type::GAUSSIAN && hidden_unit == unit_type::BINARY) {
             //Definition according to G. Hinton
             //E(v,h) = -sum((vi - ai)^2/(2*var*var)) - sum(bj*hj) -sum((vi/var)*hj*wij)
 
-            auto x = rbm.b + rv * rbm.w;
-
-            return etl::sum(etl::pow(rv - rbm.c, 2) / 2.0) - etl::dot(rbm.b, h) - etl::sum(x);
+            return etl::sum(etl::pow(rv - rbm.c, 2) / 2.0) - etl::dot(rbm.b, h) - etl::dot(h, rv * rbm.w);
         } else {
             return 0.0;
         }
@@ -549,7 +706,7 @@ private:
     }
 
     template <bool P = true, bool S = true, typename H1, typename H2, typename V, typename B, typename W>
-    static void batch_std_activate_hidden(H1&& h_a, H2&& h_s, const V& v_a, const V&, const B& b, const W& w) {
+    static void batch_std_activate_hidden(H1&& h_a, H2&& h_s, const V& v_a, const V&, const B& b, const W& w, weight* h_sum = nullptr) {
         dll::auto_timer timer("rbm:std:batch_activate_hidden");
 
         using namespace etl;
@@ -558,8 +715,30 @@ private:
 
         cpp_assert(etl::dim<0>(h_s) == Batch && etl::dim<0>(v_a) == Batch, "The number of batch must be consistent");
 
-        H_PROBS(unit_type::BINARY, h_a = etl::sigmoid(rep_l(b, Batch) + v_a * w));
-        H_PROBS(unit_type::RELU, h_a = max(rep_l(b, Batch) + v_a * w, 0.0));
+        if constexpr (P && hidden_unit == unit_type::BINARY) {
+            if constexpr (etl::all_dma<H1, H2, B>) {
+                input_product(h_a, v_a, w);
+
+                fused_sigmoid<S>(h_a, h_s, b, h_sum);
+            } else {
+                h_a = etl::sigmoid(rep_l(b, Batch) + v_a * w);
+
+                if constexpr (S) {
+                    h_s = bernoulli(h_a);
+                }
+            }
+        }
+
+        if constexpr (S && hidden_unit == unit_type::RELU && etl::all_dma<H1, H2, B>) {
+            input_product(h_s, v_a, w);
+
+            fused_normal<unit_type::RELU, P>(h_a, h_s, b);
+        } else {
+            H_PROBS(unit_type::RELU, h_a = max(rep_l(b, Batch) + v_a * w, 0.0));
+            H_SAMPLE_PROBS(unit_type::RELU, h_s = max(logistic_noise(rep_l(b, Batch) + v_a * w), 0.0));
+            H_SAMPLE_INPUT(unit_type::RELU, h_s = max(logistic_noise(rep_l(b, Batch) + v_a * w), 0.0));
+        }
+
         H_PROBS(unit_type::RELU1, h_a = min(max(rep_l(b, Batch) + v_a * w, 0.0), 1.0));
         H_PROBS(unit_type::RELU6, h_a = min(max(rep_l(b, Batch) + v_a * w, 0.0), 6.0));
 
@@ -571,8 +750,6 @@ private:
             }
         }
 
-        H_SAMPLE_PROBS(unit_type::BINARY, h_s = bernoulli(h_a));
-        H_SAMPLE_PROBS(unit_type::RELU, h_s = max(logistic_noise(rep_l(b, Batch) + v_a * w), 0.0));
         H_SAMPLE_PROBS(unit_type::RELU1, h_s = min(max(ranged_noise(rep_l(b, Batch) + v_a * w, 1.0), 0.0), 1.0));
         H_SAMPLE_PROBS(unit_type::RELU6, h_s = min(max(ranged_noise(rep_l(b, Batch) + v_a * w, 6.0), 0.0), 6.0));
         H_SAMPLE_PROBS_MULTI(unit_type::SOFTMAX){
@@ -582,7 +759,6 @@ private:
         }
 
         H_SAMPLE_INPUT(unit_type::BINARY, h_s = bernoulli(etl::sigmoid(rep_l(b, Batch) + v_a * w)));
-        H_SAMPLE_INPUT(unit_type::RELU, h_s = max(logistic_noise(rep_l(b, Batch) + v_a * w), 0.0));
         H_SAMPLE_INPUT(unit_type::RELU1, h_s = min(max(ranged_noise(rep_l(b, Batch) + v_a * w, 1.0), 0.0), 1.0));
         H_SAMPLE_INPUT(unit_type::RELU6, h_s = min(max(ranged_noise(rep_l(b, Batch) + v_a * w, 6.0), 0.0), 6.0));
         H_SAMPLE_INPUT_MULTI(unit_type::RELU1){
@@ -602,7 +778,13 @@ private:
         }
     }
 
-    template <bool P = true, bool S = true, typename H, typename V, typename C, typename W>
+    /*!
+     * \brief Compute the visible activations of a batch of hidden units.
+     *
+     * \tparam Transposed Indicates if the given weights are already
+     * transposed ([H, V] instead of [V, H])
+     */
+    template <bool P = true, bool S = true, bool Transposed = false, typename H, typename V, typename C, typename W>
     static void batch_std_activate_visible(const H&, const H& h_s, V&& v_a, V&& v_s, const C& c, const W& w) {
         dll::auto_timer timer("rbm:std:batch_activate_visible");
 
@@ -610,15 +792,48 @@ private:
 
         const auto Batch = etl::dim<0>(v_s);
 
+        // The products of the hidden units with the transposed weights
+        auto product = [&h_s, &w]() {
+            if constexpr (Transposed) {
+                return h_s * w;
+            } else {
+                return transpose(w * transpose(h_s));
+            }
+        };
+
+        auto direct_product = [&h_s, &w]() {
+            if constexpr (Transposed) {
+                return h_s * w;
+            } else {
+                return h_s * transpose(w);
+            }
+        };
+
         cpp_assert(etl::dim<0>(h_s) == Batch && etl::dim<0>(v_a) == Batch, "The number of batch must be consistent");
 
-        V_PROBS(unit_type::BINARY, v_a = etl::sigmoid(rep_l(c, Batch) + transpose(w * transpose(h_s))));
-        V_PROBS(unit_type::GAUSSIAN, v_a = rep_l(c, Batch) + transpose(w * transpose(h_s)));
-        V_PROBS(unit_type::RELU, v_a = max(rep_l(c, Batch) + transpose(w * transpose(h_s)), 0.0));
+        if constexpr (P && visible_unit == unit_type::BINARY) {
+            if constexpr (etl::all_dma<V, C>) {
+                v_a = direct_product();
 
-        V_SAMPLE_INPUT(unit_type::BINARY, v_s = bernoulli(etl::sigmoid(rep_l(c, Batch) + transpose(w * transpose(h_s)))));
-        V_SAMPLE_INPUT(unit_type::GAUSSIAN, v_s = normal_noise(rep_l(c, Batch) + transpose(w * transpose(h_s))));
-        V_SAMPLE_INPUT(unit_type::RELU, v_s = logistic_noise(max(rep_l(c, Batch) + transpose(w * transpose(h_s)), 0.0)));
+                fused_sigmoid<false>(v_a, v_s, c);
+            } else {
+                v_a = etl::sigmoid(rep_l(c, Batch) + product());
+            }
+        }
+
+        V_PROBS(unit_type::GAUSSIAN, v_a = rep_l(c, Batch) + product());
+        V_PROBS(unit_type::RELU, v_a = max(rep_l(c, Batch) + product(), 0.0));
+
+        V_SAMPLE_INPUT(unit_type::BINARY, v_s = bernoulli(etl::sigmoid(rep_l(c, Batch) + product())));
+        if constexpr (!P && S && visible_unit == unit_type::GAUSSIAN && etl::all_dma<V, C>) {
+            v_s = direct_product();
+
+            fused_normal<unit_type::GAUSSIAN, false>(v_a, v_s, c);
+        } else {
+            V_SAMPLE_INPUT(unit_type::GAUSSIAN, v_s = normal_noise(rep_l(c, Batch) + product()));
+        }
+
+        V_SAMPLE_INPUT(unit_type::RELU, v_s = logistic_noise(max(rep_l(c, Batch) + product(), 0.0)));
 
         if (P) {
             nan_check_deep(v_a);
@@ -629,6 +844,181 @@ private:
         }
     }
 
+    /*!
+     * \brief Compute the product of a batch of visible units with the
+     * weights, from the non-zero inputs if the inputs are sparse.
+     *
+     * \param h The batch of pre-activations to set
+     * \param v The batch of visible units
+     * \param w The weights
+     */
+    template <typename H, typename V, typename W>
+    static void input_product(H&& h, const V& v, const W& w) {
+        if constexpr (sparse_input && etl::all_dma<V>) {
+            sparse_batch<weight> sparse;
+
+            sparse.update(v);
+
+            if (sparse.active) {
+                dll::auto_timer timer("rbm:std:sparse_product");
+
+                sparse.multiply(w, h);
+                return;
+            }
+        }
+
+        h = v * w;
+    }
+
+    /*!
+     * \brief Add the biases to a batch of pre-activations, apply the
+     * sigmoid and optionally sample the result, in a single pass.
+     *
+     * \param a The batch of pre-activations, set to the probabilities
+     * \param s The batch of samples to set (if S)
+     * \param bias The biases of the units
+     * \param sums If not null, set to the sums of the probabilities of each unit
+     */
+    template <bool S, typename A, typename Sa, typename Bias>
+    static void fused_sigmoid(A&& a, Sa&& s, const Bias& bias, weight* sums = nullptr) {
+        dll::auto_timer timer("rbm:std:fused_sigmoid");
+
+        using T = etl::value_t<std::decay_t<A>>;
+
+        const size_t Batch = etl::dim<0>(a);
+        const size_t N     = etl::size(bias);
+
+        cpp_assert(etl::size(a) == Batch * N, "Invalid sizes for fused_sigmoid");
+
+        a.ensure_cpu_up_to_date();
+        bias.ensure_cpu_up_to_date();
+
+        T* a_ptr       = a.memory_start();
+        const T* b_ptr = bias.memory_start();
+
+        // Can be called concurrently on micro-batches
+        lane_random rng(S ? next_stream_seed() : 1);
+
+        if (sums) {
+            std::fill_n(sums, N, weight(0));
+        }
+
+        for (size_t i = 0; i < Batch; ++i) {
+            T* row = a_ptr + i * N;
+
+            for (size_t j = 0; j < N; ++j) {
+                row[j] = T(1) / (T(1) + std::exp(-(row[j] + b_ptr[j])));
+            }
+
+            if (sums) {
+                for (size_t j = 0; j < N; ++j) {
+                    sums[j] += row[j];
+                }
+            }
+
+            if constexpr (S) {
+                T* s_row = s.memory_start() + i * N;
+
+                for (size_t j = 0; j < N; j += lane_random::lanes) {
+                    rng.refill();
+
+                    const size_t end = std::min(N - j, lane_random::lanes);
+
+                    for (size_t l = 0; l < end; ++l) {
+                        s_row[j + l] = rng.block[l] < row[j + l] ? T(1) : T(0);
+                    }
+                }
+            }
+        }
+
+        a.invalidate_gpu();
+
+        if constexpr (S) {
+            s.invalidate_gpu();
+        } else {
+            cpp_unused(s);
+        }
+    }
+
+    /*!
+     * \brief Add the biases to a batch of pre-activations and sample the
+     * units with normal noise, in a single pass.
+     *
+     * Gaussian units are sampled as x + N(0, 1) and ReLU units as
+     * max(x + N(0, sigmoid(x)), 0), the normal numbers being generated by
+     * blocks of lanes.
+     *
+     * \param a The batch of activations to set (if P)
+     * \param s The batch of pre-activations, set to the samples
+     * \param bias The biases of the units
+     */
+    template <unit_type Unit, bool P, typename A, typename Sa, typename Bias>
+    static void fused_normal(A&& a, Sa&& s, const Bias& bias) {
+        static_assert(Unit == unit_type::GAUSSIAN || Unit == unit_type::RELU, "fused_normal only supports gaussian and relu units");
+
+        dll::auto_timer timer("rbm:std:fused_normal");
+
+        using T = etl::value_t<std::decay_t<Sa>>;
+
+        const size_t Batch = etl::dim<0>(s);
+        const size_t N     = etl::size(bias);
+
+        cpp_assert(etl::size(s) == Batch * N, "Invalid sizes for fused_normal");
+
+        s.ensure_cpu_up_to_date();
+        bias.ensure_cpu_up_to_date();
+
+        T* s_ptr       = s.memory_start();
+        const T* b_ptr = bias.memory_start();
+
+        // Can be called concurrently on micro-batches
+        lane_random rng(next_stream_seed());
+
+        for (size_t i = 0; i < Batch; ++i) {
+            T* row   = s_ptr + i * N;
+            T* a_row = nullptr;
+
+            if constexpr (P) {
+                a_row = a.memory_start() + i * N;
+            }
+
+            for (size_t j = 0; j < N; j += lane_random::lanes) {
+                rng.refill_normal();
+
+                const size_t end = std::min(N - j, lane_random::lanes);
+
+                for (size_t l = 0; l < end; ++l) {
+                    const T x = row[j + l] + b_ptr[j + l];
+                    const T n = rng.block[l];
+
+                    if constexpr (Unit == unit_type::GAUSSIAN) {
+                        if constexpr (P) {
+                            a_row[j + l] = x;
+                        }
+
+                        row[j + l] = x + n;
+                    } else {
+                        if constexpr (P) {
+                            a_row[j + l] = std::max(x, T(0));
+                        }
+
+                        row[j + l] = std::max(x + n / (T(1) + std::exp(-x)), T(0));
+                    }
+                }
+            }
+        }
+
+        if constexpr (P) {
+            a.invalidate_gpu();
+        } else {
+            cpp_unused(a);
+        }
+
+        s.invalidate_gpu();
+    }
+
+    mutable etl::dyn_matrix<weight, 2> energy_x; ///< The scratch of the activations of the energies
+
     /*!
      * \brief Returns a reference to the derived object, i.e. the object using the CRTP injector.
      * \return a reference to the derived object.
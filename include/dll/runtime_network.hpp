@@ -0,0 +1,669 @@
+//=======================================================================
+// Copyright (c) 2014-2017 Baptiste Wicht
+// Distributed under the terms of the MIT License.
+// (See accompanying file LICENSE or copy at
+//  http://opensource.org/licenses/MIT)
+//=======================================================================
+
+/*!
+ * \file
+ * \brief Network composed at runtime from dynamic layers.
+ *
+ * The layers of a runtime_network are type-erased: the network holds a
+ * vector of polymorphic layer handles, each of them owning a dynamic layer
+ * and its training context. The architecture can therefore be changed (or
+ * loaded from a configuration) without recompilation. The virtual calls
+ * are only made once per layer and per batch, the computations themselves
+ * being the batch kernels of the layers.
+ */
+
+#pragma once
+
+#include <cctype>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "dll/network.hpp"
+#include "dll/neural/dyn_dense_layer.hpp"
+#include "dll/neural/dyn_conv_layer.hpp"
+#include "dll/pooling/dyn_mp_layer.hpp"
+#include "dll/util/static_desc.hpp"
+
+namespace dll {
+
+/*!
+ * \brief The network seen by the contexts of the layers of a runtime
+ * network
+ */
+template <typename T, size_t B>
+struct runtime_network_view {
+    using weight = T; ///< The data type of the network
+
+    static constexpr size_t batch_size = B;                                        ///< The batch size
+    static constexpr auto updater      = updater_type::SGD;                        ///< The updater type
+    static constexpr auto loss         = loss_function::CATEGORICAL_CROSS_ENTROPY; ///< The loss function
+};
+
+/*!
+ * \brief A type-erased layer of a runtime network.
+ *
+ * All the buffers are batches of flat samples, in row-major order.
+ */
+template <typename T>
+struct runtime_layer {
+    virtual ~runtime_layer() = default;
+
+    /*!
+     * \brief Returns a description of the layer
+     */
+    virtual std::string to_string() const = 0;
+
+    /*!
+     * \brief Returns the descriptor of the equivalent static layer
+     */
+    virtual std::string static_desc() const = 0;
+
+    /*!
+     * \brief Store the weights of the layer, if any, to the given stream
+     */
+    virtual void store(std::ostream& os) const = 0;
+
+    /*!
+     * \brief Returns the size of one input of the layer
+     */
+    virtual size_t input_size() const = 0;
+
+    /*!
+     * \brief Returns the size of one output of the layer
+     */
+    virtual size_t output_size() const = 0;
+
+    /*!
+     * \brief Returns the number of trainable parameters of the layer
+     */
+    virtual size_t parameters() const = 0;
+
+    /*!
+     * \brief Compute the outputs of the given batch of inputs
+     * \param input The first n inputs of the batch
+     * \param n The number of inputs
+     * \param train Indicates if this is a training forward pass
+     */
+    virtual void forward_batch(const T* input, size_t n, bool train) = 0;
+
+    /*!
+     * \brief Returns the outputs of the last forward pass
+     */
+    virtual const T* output() = 0;
+
+    /*!
+     * \brief Returns the errors of the outputs, to be filled before the
+     * backward pass
+     */
+    virtual T* errors() = 0;
+
+    /*!
+     * \brief Backpropagate the errors of the outputs and compute the
+     * gradients of the layer
+     * \param input_errors The errors of the inputs to fill (nullptr for the
+     * first layer)
+     */
+    virtual void backward_batch(T* input_errors) = 0;
+
+    /*!
+     * \brief Apply the gradients to the parameters of the layer
+     * \param eps The learning rate
+     * \param n The number of samples of the batch
+     */
+    virtual void update(T eps, size_t n) = 0;
+};
+
+/*!
+ * \brief Runtime handle of a dynamic layer, with its training context
+ */
+template <typename T, size_t B, typename Layer>
+struct runtime_layer_model final : runtime_layer<T> {
+    using view_t    = runtime_network_view<T, B>;                    ///< The view of the network
+    using context_t = full_sgd_context<view_t, Layer, 0>;            ///< The context of the layer
+    using input_t   = std::decay_t<decltype(std::declval<context_t&>().input)>; ///< The type of the inputs
+
+    static_assert(std::is_same<typename Layer::weight, T>::value, "The layers must have the data type of the network");
+
+    Layer layer;                          ///< The layer
+    std::unique_ptr<context_t> context;   ///< The training context of the layer
+    std::unique_ptr<input_t> back_errors; ///< The errors of the inputs
+
+    /*!
+     * \brief Construct and initialize the layer
+     * \param args The arguments of the init_layer function of the layer
+     */
+    template <typename... Args>
+    explicit runtime_layer_model(Args... args) {
+        layer.init_layer(args...);
+
+        context     = std::make_unique<context_t>(layer);
+        back_errors = std::make_unique<input_t>(context->input);
+    }
+
+    /*!
+     * \copydoc runtime_layer::to_string
+     */
+    std::string to_string() const override {
+        return layer.to_full_string();
+    }
+
+    /*!
+     * \copydoc runtime_layer::static_desc
+     */
+    std::string static_desc() const override {
+        return layer.static_desc();
+    }
+
+    /*!
+     * \copydoc runtime_layer::store
+     */
+    void store(std::ostream& os) const override {
+        if constexpr (decay_layer_traits<Layer>::is_neural_layer()) {
+            layer.store(os);
+        } else {
+            cpp_unused(os);
+        }
+    }
+
+    /*!
+     * \copydoc runtime_layer::input_size
+     */
+    size_t input_size() const override {
+        return layer.input_size();
+    }
+
+    /*!
+     * \copydoc runtime_layer::output_size
+     */
+    size_t output_size() const override {
+        return layer.output_size();
+    }
+
+    /*!
+     * \copydoc runtime_layer::parameters
+     */
+    size_t parameters() const override {
+        return layer.parameters();
+    }
+
+    /*!
+     * \copydoc runtime_layer::forward_batch
+     */
+    void forward_batch(const T* input, size_t n, bool train) override {
+        auto& ctx = *context;
+
+        ctx.input.ensure_cpu_up_to_date();
+        std::copy(input, input + n * layer.input_size(), ctx.input.memory_start());
+        ctx.input.invalidate_gpu();
+
+        if (!train) {
+            layer.forward_batch(ctx.output, ctx.input);
+        } else if constexpr (has_context_forward<Layer, context_t>::value) {
+            layer.train_forward_batch(ctx.output, ctx.input, ctx);
+        } else {
+            layer.train_forward_batch(ctx.output, ctx.input);
+        }
+    }
+
+    /*!
+     * \copydoc runtime_layer::output
+     */
+    const T* output() override {
+        context->output.ensure_cpu_up_to_date();
+
+        return context->output.memory_start();
+    }
+
+    /*!
+     * \copydoc runtime_layer::errors
+     */
+    T* errors() override {
+        context->errors.ensure_cpu_up_to_date();
+
+        return context->errors.memory_start();
+    }
+
+    /*!
+     * \copydoc runtime_layer::backward_batch
+     */
+    void backward_batch(T* input_errors) override {
+        auto& ctx = *context;
+
+        // The errors have been written on the CPU
+        ctx.errors.invalidate_gpu();
+
+        layer.adapt_errors(ctx);
+
+        if (input_errors) {
+            layer.backward_batch(*back_errors, ctx);
+
+            back_errors->ensure_cpu_up_to_date();
+            std::copy(back_errors->memory_start(), back_errors->memory_start() + etl::size(*back_errors), input_errors);
+        }
+
+        layer.compute_gradients(ctx);
+    }
+
+    /*!
+     * \copydoc runtime_layer::update
+     */
+    void update(T eps, size_t n) override {
+        if constexpr (decay_layer_traits<Layer>::is_neural_layer()) {
+            update_variables(eps / n, std::make_index_sequence<std::tuple_size<decltype(layer.trainable_parameters())>::value>());
+
+            if constexpr (has_weights_changed<Layer>::value) {
+                layer.weights_changed();
+            }
+        } else {
+            cpp_unused(eps);
+            cpp_unused(n);
+        }
+    }
+
+private:
+    /*!
+     * \brief Apply the gradients of the variables of the layer
+     */
+    template <size_t... I>
+    void update_variables(T f, std::index_sequence<I...> /*seq*/) {
+        auto variables = layer.trainable_parameters();
+
+        ((std::get<I>(variables).get() += f * std::get<I>(context->up.context)->grad), ...);
+    }
+};
+
+/*!
+ * \brief A network composed at runtime of dynamic layers.
+ *
+ * The network is trained with SGD for classification (softmax and
+ * categorical cross-entropy, the last layer must be a softmax layer).
+ *
+ * \tparam T The data type of the network
+ * \tparam B The batch size
+ */
+template <typename T = float, size_t B = 100>
+struct runtime_network {
+    using weight = T; ///< The data type of the network
+
+    static constexpr size_t batch_size = B; ///< The batch size
+
+    std::vector<std::unique_ptr<runtime_layer<T>>> layers; ///< The layers of the network
+
+    weight learning_rate = 0.1; ///< The learning rate
+
+    /*!
+     * \brief Add a layer at the end of the network
+     * \param args The arguments of the init_layer function of the layer
+     * \tparam Layer The type of the dynamic layer
+     */
+    template <typename Layer, typename... Args>
+    void add_layer(Args... args) {
+        layers.push_back(std::make_unique<runtime_layer_model<T, B, Layer>>(args...));
+    }
+
+    /*!
+     * \brief Returns the size of one input of the network
+     */
+    size_t input_size() const {
+        return layers.front()->input_size();
+    }
+
+    /*!
+     * \brief Returns the size of one output of the network
+     */
+    size_t output_size() const {
+        return layers.back()->output_size();
+    }
+
+    /*!
+     * \brief Display the network on the standard output
+     */
+    void display() const {
+        size_t parameters = 0;
+
+        std::cout << "Runtime Network with " << layers.size() << " layers" << std::endl;
+
+        for (auto& layer : layers) {
+            std::cout << "    " << layer->to_string() << std::endl;
+
+            parameters += layer->parameters();
+        }
+
+        std::cout << "Total parameters: " << parameters << std::endl;
+    }
+
+    /*!
+     * \brief Generate the source of the equivalent static network, whose
+     * weights can be loaded from the file written by store.
+     * \param name The name of the alias to the static network
+     */
+    std::string static_network_desc(const std::string& name = "network_t") const {
+        std::vector<std::string> descs;
+
+        for (auto& layer : layers) {
+            descs.push_back(layer->static_desc());
+        }
+
+        return detail::static_network_source(descs, B, updater_type::SGD, loss_function::CATEGORICAL_CROSS_ENTROPY, name);
+    }
+
+    /*!
+     * \brief Store the weights of the network to the given file.
+     * \param file The path to the file
+     */
+    void store(const std::string& file) const {
+        std::ofstream os(file, std::ofstream::binary);
+        store(os);
+    }
+
+    /*!
+     * \brief Store the weights of the network using the given output stream.
+     * \param os The stream to output the network weights to.
+     */
+    void store(std::ostream& os) const {
+        for (auto& layer : layers) {
+            layer->store(os);
+        }
+    }
+
+    /*!
+     * \brief Compute the outputs of the given batch of inputs
+     * \param input The first n inputs of the batch
+     * \param n The number of inputs
+     * \return The outputs of the batch
+     */
+    const T* forward_batch(const T* input, size_t n) {
+        return forward(input, n, false);
+    }
+
+    /*!
+     * \brief Train the network on one batch
+     * \param inputs The first n inputs of the batch
+     * \param labels The first n labels of the batch (one-hot)
+     * \param n The number of samples
+     * \return a pair containing the error and the loss of the batch
+     */
+    std::pair<double, double> train_batch(const T* inputs, const T* labels, size_t n) {
+        dll::auto_timer timer("runtime_network:train_batch");
+
+        cpp_assert(n <= batch_size, "Invalid batch size");
+
+        const T* output = forward(inputs, n, true);
+
+        const size_t classes = output_size();
+
+        T* errors = layers.back()->errors();
+
+        double error = 0.0;
+        double loss  = 0.0;
+
+        for (size_t i = 0; i < n; ++i) {
+            const T* out = output + i * classes;
+            const T* lab = labels + i * classes;
+
+            size_t max_out = 0;
+            size_t max_lab = 0;
+
+            for (size_t c = 0; c < classes; ++c) {
+                errors[i * classes + c] = lab[c] - out[c];
+
+                loss -= lab[c] * std::log(std::max(out[c], T(1e-12)));
+
+                max_out = out[c] > out[max_out] ? c : max_out;
+                max_lab = lab[c] > lab[max_lab] ? c : max_lab;
+            }
+
+            error += max_out != max_lab;
+        }
+
+        // The samples after n must not contribute to the gradients
+        std::fill(errors + n * classes, errors + batch_size * classes, T(0));
+
+        for (size_t l = layers.size(); l-- > 0;) {
+            layers[l]->backward_batch(l ? layers[l - 1]->errors() : nullptr);
+        }
+
+        for (auto& layer : layers) {
+            layer->update(learning_rate, n);
+        }
+
+        return std::make_pair(error / n, loss / n);
+    }
+
+    /*!
+     * \brief Train the network on one batch
+     * \param inputs The batch of inputs
+     * \param labels The batch of labels (one-hot)
+     * \return a pair containing the error and the loss of the batch
+     */
+    template <typename Inputs, typename Labels>
+    std::pair<double, double> train_batch(const Inputs& inputs, const Labels& labels) {
+        inputs.ensure_cpu_up_to_date();
+        labels.ensure_cpu_up_to_date();
+
+        return train_batch(inputs.memory_start(), labels.memory_start(), etl::dim<0>(inputs));
+    }
+
+    /*!
+     * \brief Train the network with a generator of data and (one-hot)
+     * labels
+     * \param generator The generator
+     * \param epochs The number of epochs
+     * \return The error of the last epoch
+     */
+    template <typename Generator>
+    double fine_tune(Generator& generator, size_t epochs) {
+        double error = 0.0;
+
+        generator.set_train();
+
+        for (size_t epoch = 0; epoch < epochs; ++epoch) {
+            generator.reset();
+
+            error = 0.0;
+
+            double loss    = 0.0;
+            size_t batches = 0;
+
+            while (generator.has_next_batch()) {
+                auto[batch_error, batch_loss] = train_batch(generator.data_batch(), generator.label_batch());
+
+                error += batch_error;
+                loss += batch_loss;
+                ++batches;
+
+                generator.next_batch();
+            }
+
+            if (batches) {
+                error /= batches;
+                loss /= batches;
+            }
+
+            std::cout << "epoch " << epoch << " - error: " << error << " loss: " << loss << std::endl;
+        }
+
+        return error;
+    }
+
+private:
+    /*!
+     * \brief Forward propagate a batch through all the layers
+     */
+    const T* forward(const T* input, size_t n, bool train) {
+        for (auto& layer : layers) {
+            layer->forward_batch(input, n, train);
+
+            input = layer->output();
+        }
+
+        return input;
+    }
+};
+
+/*!
+ * \brief The dynamic layers available in the runtime networks
+ */
+template <typename T>
+struct runtime_layers {
+    template <function F>
+    using dense = dyn_dense_layer<weight_type<T>, activation<F>>; ///< A dense layer
+
+    template <function F>
+    using conv = dyn_conv_layer<weight_type<T>, activation<F>>; ///< A convolutional layer
+
+    using mp = dyn_mp_2d_layer<weight_type<T>>; ///< A max pooling layer
+};
+
+namespace detail {
+
+/*!
+ * \brief Parse the name of an activation function
+ * \return true if the name is valid, false otherwise
+ */
+inline bool parse_function(const std::string& name, function& f) {
+    if (name == "sigmoid") {
+        f = function::SIGMOID;
+    } else if (name == "tanh") {
+        f = function::TANH;
+    } else if (name == "relu") {
+        f = function::RELU;
+    } else if (name == "softmax") {
+        f = function::SOFTMAX;
+    } else if (name == "identity") {
+        f = function::IDENTITY;
+    } else {
+        return false;
+    }
+
+    return true;
+}
+
+/*!
+ * \brief Add a dynamic layer of the given template with the given
+ * activation function to the network
+ */
+template <template <function> typename Layer, typename Network, typename... Args>
+void add_layer_with(Network& network, function f, Args... args) {
+    switch (f) {
+        case function::IDENTITY:
+            network.template add_layer<Layer<function::IDENTITY>>(args...);
+            break;
+        case function::SIGMOID:
+            network.template add_layer<Layer<function::SIGMOID>>(args...);
+            break;
+        case function::TANH:
+            network.template add_layer<Layer<function::TANH>>(args...);
+            break;
+        case function::RELU:
+            network.template add_layer<Layer<function::RELU>>(args...);
+            break;
+        case function::SOFTMAX:
+            network.template add_layer<Layer<function::SOFTMAX>>(args...);
+            break;
+    }
+}
+
+} // end of namespace detail
+
+/*!
+ * \brief Create a runtime network from a configuration.
+ *
+ * Each line of the configuration describes one layer, empty lines and
+ * lines starting with # are ignored:
+ *
+ *     dense <inputs> <outputs> [activation]
+ *     conv <channels> <height> <width> <filters> <filter_height> <filter_width> [activation]
+ *     mp <channels> <height> <width> <pool_height> <pool_width>
+ *
+ * The activation is one of sigmoid (default), tanh, relu, softmax and
+ * identity.
+ *
+ * \param stream The stream to read the configuration from
+ * \return The network, or nullptr if the configuration is invalid
+ */
+template <typename T = float, size_t B = 100>
+std::unique_ptr<runtime_network<T, B>> make_runtime_network(std::istream& stream) {
+    auto network = std::make_unique<runtime_network<T, B>>();
+
+    std::string line;
+    size_t n = 0;
+
+    while (std::getline(stream, line)) {
+        ++n;
+
+        std::istringstream ls(line);
+
+        std::string type;
+
+        if (!(ls >> type) || type[0] == '#') {
+            continue;
+        }
+
+        std::vector<size_t> args;
+        std::string name = "sigmoid";
+
+        for (std::string token; ls >> token;) {
+            if (std::isdigit(static_cast<unsigned char>(token[0]))) {
+                args.push_back(std::stoul(token));
+            } else {
+                name = token;
+            }
+        }
+
+        function f;
+
+        if (!detail::parse_function(name, f)) {
+            std::cerr << "ERROR: Invalid activation function \"" << name << "\" (line " << n << ")" << std::endl;
+            return nullptr;
+        }
+
+        const size_t before = network->layers.size();
+
+        if (type == "dense" && args.size() == 2) {
+            detail::add_layer_with<runtime_layers<T>::template dense>(*network, f, args[0], args[1]);
+        } else if (type == "conv" && args.size() == 6) {
+            detail::add_layer_with<runtime_layers<T>::template conv>(*network, f, args[0], args[1], args[2], args[3], args[4], args[5]);
+        } else if (type == "mp" && args.size() == 5) {
+            network->template add_layer<typename runtime_layers<T>::mp>(args[0], args[1], args[2], args[3], args[4]);
+        } else {
+            std::cerr << "ERROR: Invalid layer \"" << line << "\" (line " << n << ")" << std::endl;
+            return nullptr;
+        }
+
+        if (before && network->layers[before - 1]->output_size() != network->layers[before]->input_size()) {
+            std::cerr << "ERROR: The input of the layer does not match the output of the previous layer (line " << n << ")" << std::endl;
+            return nullptr;
+        }
+    }
+
+    if (network->layers.empty()) {
+        std::cerr << "ERROR: The network has no layers" << std::endl;
+        return nullptr;
+    }
+
+    return network;
+}
+
+/*!
+ * \brief Create a runtime network from a configuration string
+ * \param configuration The configuration (see make_runtime_network(std::istream&))
+ * \return The network, or nullptr if the configuration is invalid
+ */
+template <typename T = float, size_t B = 100>
+std::unique_ptr<runtime_network<T, B>> make_runtime_network(const std::string& configuration) {
+    std::istringstream stream(configuration);
+    return make_runtime_network<T, B>(stream);
+}
+
+} //end of dll namespace
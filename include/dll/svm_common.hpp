@@ -12,9 +12,12 @@
 
 #ifdef DLL_SVM_SUPPORT
 
+#include <cmath>
 #include <fstream>
+#include <vector>
 
 #include "cpp_utils/io.hpp"
+#include "cpp_utils/maybe_parallel.hpp"
 #include "nice_svm.hpp"
 
 namespace dll {
@@ -31,6 +34,69 @@ inline svm_parameter default_svm_parameters() {
     return parameters;
 }
 
+/*!
+ * \brief Returns the values of one dimension of a grid search
+ */
+inline std::vector<double> svm_grid_values(double first, double last, size_t steps, svm::grid_search_type type) {
+    std::vector<double> values(std::max(steps, size_t(1)));
+
+    for (size_t i = 0; i < values.size(); ++i) {
+        const double t = values.size() > 1 ? double(i) / (values.size() - 1) : 0.0;
+
+        if (type == svm::grid_search_type::EXP) {
+            values[i] = first * std::pow(last / first, t);
+        } else {
+            values[i] = first + t * (last - first);
+        }
+    }
+
+    return values;
+}
+
+/*!
+ * \brief Perform a grid search of the C and gamma parameters of a RBF SVM
+ * on the given problem.
+ *
+ * The grid points are cross-validated concurrently on the given thread
+ * pool, all sharing the same (read-only) problem. The best parameters are
+ * printed and returned.
+ *
+ * \param problem The SVM problem
+ * \param parameters The parameters of the SVM (C and gamma are searched)
+ * \param n_fold The number of folds of the cross-validation
+ * \param g The grid
+ * \param pool The thread pool
+ *
+ * \return The parameters with the best accuracy
+ */
+template <typename Pool>
+svm_parameter svm_parallel_grid_search(svm::problem& problem, const svm_parameter& parameters, size_t n_fold, const svm::rbf_grid& g, Pool& pool) {
+    const auto c_values     = svm_grid_values(g.c_first, g.c_last, g.c_steps, g.type);
+    const auto gamma_values = svm_grid_values(g.gamma_first, g.gamma_last, g.gamma_steps, g.type);
+
+    std::vector<double> accuracies(c_values.size() * gamma_values.size());
+
+    cpp::maybe_parallel_foreach_n(pool, 0, accuracies.size(), [&](size_t i) {
+        auto point_parameters = parameters;
+
+        point_parameters.C     = c_values[i / gamma_values.size()];
+        point_parameters.gamma = gamma_values[i % gamma_values.size()];
+
+        accuracies[i] = svm::cross_validation(problem, point_parameters, n_fold);
+    });
+
+    const size_t best = std::distance(accuracies.begin(), std::max_element(accuracies.begin(), accuracies.end()));
+
+    auto best_parameters = parameters;
+
+    best_parameters.C     = c_values[best / gamma_values.size()];
+    best_parameters.gamma = gamma_values[best % gamma_values.size()];
+
+    std::cout << "Best: C=" << best_parameters.C << " gamma=" << best_parameters.gamma << " accuracy=" << accuracies[best] << std::endl;
+
+    return best_parameters;
+}
+
 template <typename DBN>
 void svm_store(const DBN& dbn, std::ostream& os) {
     if (dbn.svm_loaded) {
@@ -191,45 +257,15 @@ bool svm_train(DBN& dbn, Iterator&& first, Iterator&& last, LIterator&& lfirst,
 
 template <typename DBN, typename Samples, typename Labels>
 bool svm_grid_search(DBN& dbn, const Samples& training_data, const Labels& labels, size_t n_fold = 5, const svm::rbf_grid& g = svm::rbf_grid()) {
-    make_problem(dbn, training_data, labels, dbn_traits<DBN>::scale());
-
-    //Make libsvm quiet
-    svm::make_quiet();
-
-    auto parameters = default_svm_parameters();
-
-    //Make sure parameters are not messed up
-    if (!svm::check(dbn.problem, parameters)) {
-        return false;
-    }
-
-    //Perform a grid-search
-    svm::rbf_grid_search(dbn.problem, parameters, n_fold, g);
-
-    return true;
+    return dbn.svm_grid_search(training_data, labels, n_fold, g);
 }
 
 template <typename DBN, typename Iterator, typename LIterator>
 bool svm_grid_search(DBN& dbn, Iterator&& first, Iterator&& last, LIterator&& lfirst, LIterator&& llast, size_t n_fold = 5, const svm::rbf_grid& g = svm::rbf_grid()) {
-    make_problem(dbn,
-                 std::forward<Iterator>(first), std::forward<Iterator>(last),
-                 std::forward<LIterator>(lfirst), std::forward<LIterator>(llast),
-                 dbn_traits<DBN>::scale());
-
-    //Make libsvm quiet
-    svm::make_quiet();
-
-    auto parameters = default_svm_parameters();
-
-    //Make sure parameters are not messed up
-    if (!svm::check(dbn.problem, parameters)) {
-        return false;
-    }
-
-    //Perform a grid-search
-    svm::rbf_grid_search(dbn.problem, parameters, n_fold, g);
-
-    return true;
+    return dbn.svm_grid_search(
+        std::forward<Iterator>(first), std::forward<Iterator>(last),
+        std::forward<LIterator>(lfirst), std::forward<LIterator>(llast),
+        n_fold, g);
 }
 
 template <typename DBN, typename Sample>
@@ -7,7 +7,15 @@
 
 #pragma once
 
+#include <vector>
+#include <numeric>
+
 #include "cpp_utils/stop_watch.hpp"
+#include "cpp_utils/maybe_parallel.hpp"
+
+#include "etl/etl.hpp"
+
+#include "dll/inference_session.hpp"
 
 namespace dll {
 
@@ -56,6 +64,79 @@ struct label_predictor {
     }
 };
 
+namespace test_detail {
+
+/*!
+ * \brief Create a batch of n samples with the shape of the given sample
+ */
+template <typename Batch, typename Sample, size_t... I>
+Batch make_batch(size_t n, const Sample& sample, std::index_sequence<I...>) {
+    return Batch(n, etl::dim<I>(sample)...);
+}
+
+/*!
+ * \brief Forward the given samples through the network in full batches of
+ * the batch size of the network and sum the results of the functor on
+ * each batch.
+ *
+ * The last batch is padded with zeroes. The functor is called with the
+ * input batch, the output batch, the index of the first sample of the
+ * batch and the number of real samples of the batch.
+ *
+ * When parallel is set, the batches are spread over the thread pool of the
+ * network, unless a layer needs a scratch state for its test forward pass.
+ */
+template <typename DBN, typename Sample, typename Functor>
+double forward_batches(DBN& dbn, const std::vector<const Sample*>& samples, bool parallel, Functor&& functor) {
+    using weight  = typename DBN::weight;
+    using batch_t = etl::dyn_matrix<weight, etl::decay_traits<Sample>::dimensions() + 1>;
+
+    constexpr size_t B = DBN::batch_size;
+
+    const size_t n      = samples.size();
+    const size_t chunks = (n + B - 1) / B;
+
+    std::vector<double> results(chunks, 0.0);
+
+    auto chunk = [&](size_t c) {
+        const size_t first = c * B;
+        const size_t last  = std::min(n, first + B);
+
+        auto batch = make_batch<batch_t>(B, *samples[first], std::make_index_sequence<etl::decay_traits<Sample>::dimensions()>());
+
+        if (last - first < B) {
+            batch = weight(0);
+        }
+
+        for (size_t i = first; i < last; ++i) {
+            batch(i - first) = *samples[i];
+        }
+
+        results[c] = functor(batch, dbn.test_forward_batch(batch), first, last - first);
+    };
+
+    if constexpr (session_detail::is_stateless<DBN>(std::make_index_sequence<DBN::layers>())) {
+        if (parallel) {
+            cpp::maybe_parallel_foreach_n(dbn.get_thread_pool(), 0, chunks, [&](size_t c) {
+                // Each batch is forwarded on its own thread
+                SERIAL_SECTION {
+                    chunk(c);
+                }
+            });
+
+            return std::accumulate(results.begin(), results.end(), 0.0);
+        }
+    }
+
+    for (size_t c = 0; c < chunks; ++c) {
+        chunk(c);
+    }
+
+    return std::accumulate(results.begin(), results.end(), 0.0);
+}
+
+} //end of namespace test_detail
+
 template <typename DBN, typename Functor, typename Samples, typename Labels>
 double test_set(DBN& dbn, const Samples& images, const Labels& labels, Functor&& f) {
     return test_set(dbn, images.begin(), images.end(), labels.begin(), labels.end(), std::forward<Functor>(f));
@@ -107,4 +188,97 @@ double test_set_ae(DBN& dbn, Iterator first, Iterator last) {
     return std::abs(rate) / images;
 }
 
+/*!
+ * \brief Compute the classification error of the network on the given
+ * samples (ETL containers), forwarded in batches of the batch size of the
+ * network.
+ *
+ * The predicted label of each sample is the index of its largest output,
+ * as with the predictor. The predictors of the RBM networks (label_predictor)
+ * and of the SVM (svm_predictor) are not batched, use test_set for them.
+ *
+ * \param dbn A pointer to the network
+ * \param parallel Indicates if the batches are spread over the thread pool
+ * of the network
+ */
+template <typename DBN, typename Samples, typename Labels>
+double test_set_batch(DBN& dbn, const Samples& images, const Labels& labels, bool parallel = false) {
+    return test_set_batch(dbn, images.begin(), images.end(), labels.begin(), labels.end(), parallel);
+}
+
+/*!
+ * \copydoc test_set_batch
+ */
+template <typename DBN, typename Iterator, typename LIterator>
+double test_set_batch(DBN& dbn, Iterator first, Iterator last, LIterator lfirst, LIterator /*llast*/, bool parallel = false) {
+    using sample_t = std::decay_t<decltype(*first)>;
+
+    std::vector<const sample_t*> samples;
+    std::vector<size_t> labels;
+
+    for (; first != last; ++first, ++lfirst) {
+        samples.push_back(&*first);
+        labels.push_back(*lfirst);
+    }
+
+    if (samples.empty()) {
+        return 0.0;
+    }
+
+    auto errors = test_detail::forward_batches(*dbn, samples, parallel, [&dbn, &labels](auto& /*batch*/, const auto& output, size_t first, size_t n) {
+        size_t errors = 0;
+
+        for (size_t i = 0; i < n; ++i) {
+            if (dbn->predict_label(output(i)) != labels[first + i]) {
+                ++errors;
+            }
+        }
+
+        return double(errors);
+    });
+
+    return errors / static_cast<double>(samples.size());
+}
+
+/*!
+ * \brief Compute the mean absolute reconstruction error of the network on
+ * the given samples (ETL containers), forwarded in batches of the batch
+ * size of the network.
+ *
+ * \param dbn The network
+ * \param parallel Indicates if the batches are spread over the thread pool
+ * of the network
+ */
+template <typename DBN, typename Samples>
+double test_set_ae_batch(DBN& dbn, const Samples& images, bool parallel = false) {
+    return test_set_ae_batch(dbn, images.begin(), images.end(), parallel);
+}
+
+/*!
+ * \copydoc test_set_ae_batch
+ */
+template <typename DBN, typename Iterator>
+double test_set_ae_batch(DBN& dbn, Iterator first, Iterator last, bool parallel = false) {
+    using sample_t = std::decay_t<decltype(*first)>;
+
+    std::vector<const sample_t*> samples;
+
+    for (; first != last; ++first) {
+        samples.push_back(&*first);
+    }
+
+    if (samples.empty()) {
+        return 0.0;
+    }
+
+    auto rate = test_detail::forward_batches(dbn, samples, parallel, [](auto& batch, const auto& output, size_t /*first*/, size_t n) {
+        const size_t B = etl::dim<0>(batch);
+        const size_t N = etl::size(batch) / B;
+
+        return etl::asum(etl::slice(etl::reshape(batch, B, N), 0, n) - etl::slice(etl::reshape(output, B, N), 0, n)) / N;
+    });
+
+    return rate / samples.size();
+}
+
 } //end of dll namespace
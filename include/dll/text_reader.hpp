@@ -18,22 +18,50 @@
 #include <vector>
 #include <cstdint>
 #include <memory>
+#include <sstream>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <iterator>
 
 #include <dirent.h>
 
+#include "cpp_utils/assert.hpp"
 #include "cpp_utils/tmp.hpp"
 #include "etl/etl_light.hpp"
 
 namespace dll {
 namespace text {
 
-template<typename Container, typename Functor>
-void read_images(Container& images, const std::string& path, size_t limit, Functor func){
-    using Image = typename Container::value_type;
+namespace detail {
+
+/*!
+ * \brief A text file of a directory, with its identifier
+ */
+struct text_file {
+    size_t id;        ///< The identifier of the file (its name without extension)
+    std::string path; ///< The full path to the file
+};
+
+/*!
+ * \brief List the text files of a directory, sorted by identifier
+ * \param path The path to the directory
+ * \param limit The maximum identifier to keep (0 for no limit)
+ * \return A vector with the files of the directory
+ */
+inline std::vector<text_file> list_text_files(const std::string& path, size_t limit){
+    std::vector<text_file> files;
 
-    struct dirent* entry;
     auto dir = opendir(path.c_str());
 
+    if(!dir){
+        std::cerr << "dll::text: Impossible to open " << path << std::endl;
+        return files;
+    }
+
+    struct dirent* entry;
     while ((entry = readdir(dir))) {
         std::string file_name(entry->d_name);
 
@@ -43,50 +71,360 @@ void read_images(Container& images, const std::string& path, size_t limit, Funct
 
         int id = std::atoi(std::string(file_name.begin(), file_name.begin() + file_name.size() - 4).c_str());
 
-        if(!limit || id - 1 < (int) limit){
-            std::vector<double> temp;
+        if(id > 0 && (!limit || id - 1 < (int) limit)){
+            files.push_back({size_t(id), path + "/" + file_name});
+        }
+    }
 
-            std::string full_path(path + "/" + file_name);
+    closedir(dir);
 
-            std::ifstream file(full_path);
+    std::sort(files.begin(), files.end(), [](auto& lhs, auto& rhs){ return lhs.id < rhs.id; });
 
-            size_t lines = 0;
-            size_t columns = 0;
+    return files;
+}
+
+/*!
+ * \brief Parse the values of a text image
+ * \param full_path The path to the file
+ * \param values The output values
+ * \param lines The output number of lines
+ * \param columns The output number of columns
+ */
+inline void parse_text_image(const std::string& full_path, std::vector<double>& values, size_t& lines, size_t& columns){
+    values.clear();
 
-            // There is a bug in G++7.1 that causes this false positive
+    lines   = 0;
+    columns = 0;
+
+    std::ifstream file(full_path);
+
+    // There is a bug in G++7.1 that causes this false positive
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wstrict-aliasing"
-            std::string line;
-            while (std::getline(file, line)) {
-                std::istringstream ss(line);
-                std::string value;
-
-                while (std::getline(ss, value, ';')) {
-                    auto v = std::atof(value.c_str());
-                    temp.push_back(v);
-
-                    if(lines == 0){
-                        ++columns;
-                    }
-                }
+    std::string line;
+    while (std::getline(file, line)) {
+        std::istringstream ss(line);
+        std::string value;
 
-                ++lines;
+        while (std::getline(ss, value, ';')) {
+            values.push_back(std::atof(value.c_str()));
+
+            if(lines == 0){
+                ++columns;
             }
+        }
+
+        ++lines;
+    }
 #pragma GCC diagnostic pop
+}
+
+/*!
+ * \brief Load a text image into the given slot
+ * \param image The slot of the image
+ * \param file The file to read
+ * \param temp Temporary storage for the values
+ * \param func The functor to create an image
+ */
+template<typename Image, typename Functor>
+void load_text_image(Image& image, const text_file& file, std::vector<double>& temp, Functor& func){
+    size_t lines;
+    size_t columns;
+
+    parse_text_image(file.path, temp, lines, columns);
+
+    image = func(1, lines, columns);
+
+    size_t i = 0;
+    for (auto& value : temp) {
+        image[i++] = static_cast<typename Image::value_type>(value);
+    }
+}
+
+/*!
+ * \brief Returns the number of threads to use to parse n files
+ * \param threads The requested number of threads (0 for automatic)
+ * \param n The number of files
+ */
+inline size_t reader_threads(size_t threads, size_t n){
+    if(!threads){
+        threads = std::max(size_t(1), size_t(std::thread::hardware_concurrency()));
+    }
+
+    return std::max(size_t(1), std::min(threads, n));
+}
+
+/*!
+ * \brief Create an image of the given dimensions
+ * \tparam Image The type of image
+ * \tparam Three Indicates if the image is three-dimensional
+ */
+template<typename Image, bool Three>
+Image make_text_image(size_t c, size_t h, size_t w){
+    if constexpr (etl::all_fast<Image>) {
+        cpp_unused(c);
+        cpp_unused(h);
+        cpp_unused(w);
+        return Image();
+    } else if constexpr (Three) {
+        return Image(c, h, w);
+    } else {
+        return Image(c * h * w);
+    }
+}
+
+} //end of namespace detail
+
+/*!
+ * \brief Read all the text images of a directory.
+ *
+ * The directory is listed once and the files are then parsed in
+ * parallel, each thread filling its own slots of the container.
+ *
+ * \param images The container to fill
+ * \param path The path to the directory
+ * \param limit The maximum number of images to read (0 for no limit)
+ * \param func The functor to create an image
+ * \param threads The number of threads to use (0 for automatic)
+ */
+template<typename Container, typename Functor>
+void read_images(Container& images, const std::string& path, size_t limit, Functor func, size_t threads = 0){
+    auto files = detail::list_text_files(path, limit);
+
+    if(files.empty()){
+        return;
+    }
+
+    if(images.size() < files.back().id){
+        images.resize(files.back().id);
+    }
+
+    threads = detail::reader_threads(threads, files.size());
 
-            if((int) images.size() < id){
-                images.resize(id);
+    std::atomic<size_t> next(0);
+
+    auto worker = [&](){
+        std::vector<double> temp;
+
+        size_t f;
+        while ((f = next++) < files.size()) {
+            detail::load_text_image(images[files[f].id - 1], files[f], temp, func);
+        }
+    };
+
+    std::vector<std::thread> pool;
+
+    for (size_t t = 1; t < threads; ++t) {
+        pool.emplace_back(worker);
+    }
+
+    worker();
+
+    for (auto& thread : pool) {
+        thread.join();
+    }
+}
+
+/*!
+ * \brief A stream of text images parsed in the background.
+ *
+ * The directory is listed at construction and the images are then
+ * parsed, in order, by a pool of threads. The iterators of the stream
+ * only wait for the image they point to, so that a generator (see
+ * outmemory_data_generator) can start consuming the first images before
+ * the end of the corpus has been parsed. The parsed images are kept in
+ * the stream so that the next epochs do not read the files again.
+ *
+ * \tparam Image The type of image
+ * \tparam Three Indicates if the images are three-dimensional
+ */
+template<typename Image, bool Three = false>
+struct image_stream {
+    using image_type = Image; ///< The type of image
+
+private:
+    /*!
+     * \brief The state shared between the stream, its iterators and the
+     * parsing threads
+     */
+    struct state {
+        std::vector<detail::text_file> files; ///< The files to parse
+        std::vector<Image> images;            ///< The slots of the images
+        std::vector<char> ready;              ///< Indicates if each slot is ready
+
+        std::atomic<size_t> next{0};        ///< The next file to parse
+        std::atomic<bool> stop_flag{false}; ///< Indicates that the threads must stop
+
+        std::vector<std::thread> pool; ///< The parsing threads
+
+        mutable std::mutex lock;                   ///< The lock on the ready flags
+        mutable std::condition_variable condition; ///< The condition to wait for a slot
+
+        /*!
+         * \brief Parse the next files until the end or until stop
+         */
+        void work() {
+            std::vector<double> temp;
+
+            auto func = [](size_t c, size_t h, size_t w) { return detail::make_text_image<Image, Three>(c, h, w); };
+
+            size_t f;
+            while (!stop_flag.load(std::memory_order_relaxed) && (f = next++) < files.size()) {
+                const size_t slot = files[f].id - 1;
+
+                detail::load_text_image(images[slot], files[f], temp, func);
+
+                {
+                    std::lock_guard<std::mutex> l(lock);
+                    ready[slot] = true;
+                }
+
+                condition.notify_all();
             }
+        }
 
-            images[id - 1] = func(1, lines, columns);
+        /*!
+         * \brief Returns the image at the given slot, waiting for it to be parsed
+         */
+        const Image& get(size_t slot) const {
+            std::unique_lock<std::mutex> ulock(lock);
 
-            size_t i = 0;
-            for (auto& value : temp) {
-                images[id - 1][i++] = static_cast<typename Image::value_type>(value);
+            condition.wait(ulock, [this, slot] { return ready[slot]; });
+
+            return images[slot];
+        }
+
+        /*!
+         * \brief Stop and join the parsing threads
+         */
+        ~state() {
+            stop_flag = true;
+
+            for (auto& thread : pool) {
+                thread.join();
             }
         }
+    };
+
+public:
+    /*!
+     * \brief Start to parse the images of the given directory
+     * \param path The path to the directory
+     * \param limit The maximum number of images to read (0 for no limit)
+     * \param threads The number of threads to use (0 for automatic)
+     */
+    explicit image_stream(const std::string& path, size_t limit = 0, size_t threads = 0) : shared(std::make_shared<state>()) {
+        shared->files = detail::list_text_files(path, limit);
+
+        const size_t n = shared->files.empty() ? 0 : shared->files.back().id;
+
+        shared->images.resize(n);
+        shared->ready.resize(n, true);
+
+        // Only the slots with a file will be filled by the threads
+        for (auto& file : shared->files) {
+            shared->ready[file.id - 1] = false;
+        }
+
+        threads = detail::reader_threads(threads, shared->files.size());
+
+        for (size_t t = 0; t < threads && !shared->files.empty(); ++t) {
+            shared->pool.emplace_back([s = shared.get()]() { s->work(); });
+        }
     }
-}
+
+    image_stream(const image_stream& rhs) = delete;
+    image_stream& operator=(const image_stream& rhs) = delete;
+
+    image_stream(image_stream&& rhs) noexcept = default;
+    image_stream& operator=(image_stream&& rhs) noexcept = default;
+
+    /*!
+     * \brief Returns the number of images of the stream
+     */
+    size_t size() const {
+        return shared->images.size();
+    }
+
+    /*!
+     * \brief Wait for all the images to be parsed
+     */
+    void wait() const {
+        for (size_t i = 0; i < size(); ++i) {
+            shared->get(i);
+        }
+    }
+
+    /*!
+     * \brief An input iterator over the images of a stream
+     */
+    struct iterator {
+        using iterator_category = std::input_iterator_tag; ///< The iterator category
+        using value_type        = Image;                   ///< The type of value
+        using difference_type   = std::ptrdiff_t;          ///< The type of difference
+        using pointer           = const Image*;            ///< The type of pointer
+        using reference         = const Image&;            ///< The type of reference
+
+        std::shared_ptr<const state> shared; ///< The state of the stream
+        size_t position;                     ///< The current position
+
+        /*!
+         * \brief Returns the current image, waiting for it to be parsed
+         */
+        reference operator*() const {
+            return shared->get(position);
+        }
+
+        /*!
+         * \brief Returns a pointer to the current image, waiting for it to be parsed
+         */
+        pointer operator->() const {
+            return &shared->get(position);
+        }
+
+        /*!
+         * \brief Advance to the next image
+         */
+        iterator& operator++() {
+            ++position;
+            return *this;
+        }
+
+        /*!
+         * \brief Advance to the next image
+         */
+        iterator operator++(int) {
+            auto copy = *this;
+            ++position;
+            return copy;
+        }
+
+        bool operator==(const iterator& rhs) const {
+            return position == rhs.position;
+        }
+
+        bool operator!=(const iterator& rhs) const {
+            return position != rhs.position;
+        }
+    };
+
+    /*!
+     * \brief Returns an iterator to the first image
+     */
+    iterator begin() const {
+        return {shared, 0};
+    }
+
+    /*!
+     * \brief Returns an iterator past the last image
+     */
+    iterator end() const {
+        return {shared, size()};
+    }
+
+private:
+    std::shared_ptr<state> shared; ///< The shared state
+};
 
 template<template<typename...> typename  Container = std::vector, typename Label = uint8_t>
 void read_labels(Container<Label>& labels, const std::string& path, size_t limit = 0){
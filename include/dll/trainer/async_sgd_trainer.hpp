@@ -0,0 +1,327 @@
+//=======================================================================
+// Copyright (c) 2014-2017 Baptiste Wicht
+// Distributed under the terms of the MIT License.
+// (See accompanying file LICENSE or copy at
+//  http://opensource.org/licenses/MIT)
+//=======================================================================
+
+/*!
+ * \file async_sgd_trainer.hpp
+ * \brief Asynchronous Stochastic Gradient Descent (Hogwild) Implementation
+ *
+ * Several workers train batches of the same network at the same time.
+ * Each worker has its own context and updates the shared weights of the
+ * network without any synchronization. This is efficient when the
+ * updates of the different batches touch mostly disjoint parts of the
+ * weights (embeddings for instance).
+ */
+
+#pragma once
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <memory>
+#include <vector>
+
+#include "dll/trainer/stochastic_gradient_descent.hpp"
+
+namespace dll {
+
+/*!
+ * \brief Asynchronous gradient descent trainer.
+ *
+ * The batches are handed by the training loop to the first idle worker
+ * and train_batch returns without waiting for the batch to be trained.
+ * The workers are synchronized at the end of each epoch and before each
+ * evaluation of the network.
+ *
+ * The number of workers is set with dll::workers<N> in the descriptor of
+ * the network (all the hardware threads by default).
+ */
+template <typename DBN>
+struct async_sgd_trainer : sgd_trainer<DBN> {
+    using dbn_t     = DBN;                           ///< The type of DBN being trained
+    using base_type = sgd_trainer<dbn_t>;            ///< The synchronous trainer
+    using context_t = typename base_type::context_t; ///< The type of the context
+
+    static constexpr auto layers     = dbn_t::layers;     ///< The number of layers
+    static constexpr auto batch_size = dbn_t::batch_size; ///< The batch size for training
+
+    static_assert(dbn_traits<dbn_t>::micro_batches() == 1, "async_sgd_trainer does not support data_parallel");
+    static_assert(dbn_traits<dbn_t>::accumulated_batches() == 1, "async_sgd_trainer does not support grad_accumulate");
+    static_assert(!dbn_traits<dbn_t>::has_loss_scaling(), "async_sgd_trainer does not support loss_scaling");
+    static_assert(dbn_traits<dbn_t>::checkpoint_every() < 2, "async_sgd_trainer does not support checkpoint");
+    static_assert(!dbn_traits<dbn_t>::stage_inputs(), "async_sgd_trainer does not support stage_inputs");
+
+    using input_t = typename base_type::input_t; ///< The type of a batch of inputs
+    using label_t = typename base_type::label_t; ///< The type of a batch of labels
+
+    /*!
+     * \brief The state of a worker
+     */
+    struct worker_state {
+        context_t context; ///< The context of the worker
+        input_t inputs;    ///< The inputs of the current batch
+        label_t labels;    ///< The labels of the current batch
+
+        size_t n     = 0;     ///< The size of the current batch
+        size_t epoch = 0;     ///< The epoch of the current batch
+        bool pending = false; ///< Indicates if a batch is waiting to be trained
+
+        /*!
+         * \brief Construct the state of a worker for the given network
+         * \param dbn The network being trained
+         */
+        explicit worker_state(dbn_t& dbn) : context(build_context<full_sgd_context>(dbn)) {
+            base_type::inherit_dimensions(context);
+
+            inputs = std::get<0>(context).second->input;
+            labels = std::get<layers - 1>(context).second->output;
+        }
+    };
+
+    std::vector<std::unique_ptr<worker_state>> workers; ///< The state of the workers
+    std::vector<std::thread> threads;                   ///< The threads of the workers
+
+    bool stop_flag = false; ///< Indicates that the workers must stop
+
+    double last_error = 1.0;  ///< The error of the last trained batch
+    double last_loss  = -1.0; ///< The loss of the last trained batch
+
+    mutable std::mutex main_lock;              ///< The main lock
+    mutable std::condition_variable condition; ///< The condition variable for the workers and the training loop
+
+    /*!
+     * \brief construct a new async_sgd_trainer
+     * \param dbn The DBN being trained
+     */
+    explicit async_sgd_trainer(dbn_t& dbn) : base_type(dbn) {
+        size_t n = dbn_traits<dbn_t>::workers();
+
+        if (!n) {
+            n = std::max(size_t(1), size_t(std::thread::hardware_concurrency()));
+        }
+
+        for (size_t w = 0; w < n; ++w) {
+            workers.push_back(std::make_unique<worker_state>(dbn));
+        }
+
+        for (size_t w = 0; w < n; ++w) {
+            threads.emplace_back([this, w] { work(*workers[w]); });
+        }
+    }
+
+    async_sgd_trainer(const async_sgd_trainer& rhs) = delete;
+    async_sgd_trainer& operator=(const async_sgd_trainer& rhs) = delete;
+
+    /*!
+     * \brief Wait for the pending batches and stop the workers
+     */
+    ~async_sgd_trainer() {
+        wait_workers();
+
+        cpp::with_lock(main_lock, [this] { stop_flag = true; });
+
+        condition.notify_all();
+
+        for (auto& thread : threads) {
+            thread.join();
+        }
+    }
+
+    /*!
+     * \brief Give a batch of data to the first idle worker
+     * \param epoch The current epoch
+     * \param inputs A batch of inputs
+     * \param labels A batch of labels
+     * \return a pair containing the error and the loss of the last batch
+     * trained by the workers
+     */
+    template <typename Inputs, typename Labels>
+    std::pair<double, double> train_batch(size_t epoch, const Inputs& inputs, const Labels& labels) {
+        dll::auto_timer timer("async_sgd::train_batch");
+
+        const size_t n = etl::dim<0>(inputs);
+
+        // Ensure that the data batch and the label batch are of the same size
+        cpp_assert(n == etl::dim<0>(labels), "Invalid sizes");
+
+        // Ensure that the context can hold the inputs
+        cpp_assert(n <= batch_size, "Invalid sizes");
+
+        worker_state* worker = nullptr;
+
+        {
+            std::unique_lock<std::mutex> ulock(main_lock);
+
+            condition.wait(ulock, [this, &worker] { return (worker = idle_worker()); });
+        }
+
+        // The worker is idle, it does not touch its batch until it is pending
+
+        etl::slice(worker->inputs, 0, n) = inputs;
+        etl::slice(worker->labels, 0, n) = labels;
+
+        worker->n     = n;
+        worker->epoch = epoch;
+
+        double error;
+        double loss;
+
+        {
+            std::unique_lock<std::mutex> ulock(main_lock);
+
+            worker->pending = true;
+
+            error = last_error;
+            loss  = last_loss;
+        }
+
+        condition.notify_all();
+
+        return std::make_pair(error, loss);
+    }
+
+    /*!
+     * \brief Wait for all the pending batches to be trained
+     */
+    void finish_epoch() {
+        wait_workers();
+    }
+
+    /*!
+     * \brief Forward a batch of inputs once all the pending batches have
+     * been trained
+     */
+    template <bool Train, typename Inputs>
+    auto& forward_batch_helper(dbn_t& dbn, Inputs&& inputs) {
+        wait_workers();
+
+        return base_type::template forward_batch_helper<Train>(dbn, inputs);
+    }
+
+    /*!
+     * \brief Return the name of the trainer
+     */
+    static std::string name() {
+        return "Asynchronous Stochastic Gradient Descent";
+    }
+
+private:
+    /*!
+     * \brief Returns the first idle worker, or nullptr if all workers are
+     * busy. The lock must be held.
+     */
+    worker_state* idle_worker() {
+        for (auto& worker : workers) {
+            if (!worker->pending) {
+                return worker.get();
+            }
+        }
+
+        return nullptr;
+    }
+
+    /*!
+     * \brief Wait for all the workers to be idle
+     */
+    void wait_workers() {
+        std::unique_lock<std::mutex> ulock(main_lock);
+
+        condition.wait(ulock, [this] {
+            for (auto& worker : workers) {
+                if (worker->pending) {
+                    return false;
+                }
+            }
+
+            return true;
+        });
+    }
+
+    /*!
+     * \brief The main function of a worker
+     * \param worker The state of the worker
+     */
+    void work(worker_state& worker) {
+        while (true) {
+            {
+                std::unique_lock<std::mutex> ulock(main_lock);
+
+                condition.wait(ulock, [this, &worker] { return stop_flag || worker.pending; });
+
+                if (stop_flag) {
+                    return;
+                }
+            }
+
+            auto [error, loss] = train_worker(worker);
+
+            {
+                std::unique_lock<std::mutex> ulock(main_lock);
+
+                worker.pending = false;
+
+                last_error = error;
+                last_loss  = loss;
+
+                ++this->iteration;
+            }
+
+            condition.notify_all();
+        }
+    }
+
+    /*!
+     * \brief Train the current batch of a worker and update the shared
+     * weights without synchronization
+     * \param worker The state of the worker
+     * \return a pair containing the error and the loss for the batch
+     */
+    std::pair<double, double> train_worker(worker_state& worker) {
+        auto& context  = worker.context;
+        auto& last_ctx = *std::get<layers - 1>(context).second;
+
+        const size_t n     = worker.n;
+        const size_t epoch = worker.epoch;
+
+        auto inputs = etl::slice(worker.inputs, 0, n);
+        auto labels = etl::slice(worker.labels, 0, n);
+
+        double error = 1.0;
+        double loss  = -1.0;
+
+        // The other workers are already using the other cores
+        SERIAL_SECTION {
+            base_type::template forward_context<true>(context, inputs);
+
+            if constexpr (base_type::fused_metrics()) {
+                std::pair<double, double> metrics;
+
+                this->template last_errors<dbn_t::loss>(context, n == batch_size, n, labels, &metrics);
+
+                error = metrics.first / n;
+                loss  = metrics.second / n;
+            } else {
+                this->template last_errors<dbn_t::loss>(context, n == batch_size, n, labels);
+            }
+
+            base_type::backward_batch_helper(context);
+
+            cpp::for_each(context, [this, epoch, n](auto& layer_ctx) {
+                base_type::compute_gradients_layer(layer_ctx.first, *layer_ctx.second);
+
+                this->update_weights_layer(epoch, n, layer_ctx.first, *layer_ctx.second);
+            });
+
+            if constexpr (!base_type::fused_metrics()) {
+                std::tie(error, loss) = this->dbn.evaluate_metrics_batch(last_ctx.output, labels, n, true);
+            }
+        }
+
+        return std::make_pair(error, loss);
+    }
+};
+
+} //end of dll namespace
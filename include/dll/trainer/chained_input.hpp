@@ -0,0 +1,130 @@
+//=======================================================================
+// Copyright (c) 2014-2017 Baptiste Wicht
+// Distributed under the terms of the MIT License.
+// (See accompanying file LICENSE or copy at
+//  http://opensource.org/licenses/MIT)
+//=======================================================================
+
+/*!
+ * \file
+ * \brief Inputs of the SGD contexts shared with the output of the previous
+ * context.
+ *
+ * When the contexts of a network are chained, the input of a context is a
+ * view of the output of the context of the previous layer: the
+ * activations of a layer are stored only once and are not copied from
+ * one context to the next during the forward pass.
+ */
+
+#pragma once
+
+#include <type_traits>
+
+#include "etl/etl.hpp"
+
+#include "dll/util/huge_pages.hpp" // For huge_buffer
+
+namespace dll {
+
+/*!
+ * \brief The output of the last context built by the current thread, in
+ * which the next context can take its input
+ */
+template <typename T>
+struct context_chain {
+    T* memory   = nullptr; ///< The memory of the output of the previous context (nullptr if it cannot be shared)
+    size_t size = 0;       ///< The number of elements of the output of the previous context
+};
+
+/*!
+ * \brief Returns the chain of the contexts built by the current thread
+ * (nullptr if the contexts are not chained)
+ */
+template <typename T>
+context_chain<T>*& current_context_chain() {
+    thread_local context_chain<T>* chain = nullptr;
+    return chain;
+}
+
+/*!
+ * \brief The storage of the input of a SGD context: the input is a view
+ * of the output of the previous context when the contexts are chained, or
+ * of memory owned by the context otherwise.
+ *
+ * \tparam T The type of the values
+ * \tparam D The number of dimensions of the input
+ */
+template <typename T, size_t D>
+struct chained_input {
+    using type = etl::custom_dyn_matrix<T, D>; ///< The type of the input
+
+    /*!
+     * \brief Create the input of the given dimensions, in the output of the
+     * previous context if it has the same size
+     */
+    template <typename... S>
+    type view(S... sizes) {
+        static_assert(sizeof...(S) == D, "Invalid number of dimensions");
+
+        const size_t n = (size_t(sizes) * ...);
+
+        if (auto* chain = current_context_chain<T>(); chain && chain->memory && chain->size == n) {
+            T* memory = chain->memory;
+
+            // The output can only be shared with one input
+            chain->memory = nullptr;
+
+            return type(memory, sizes...);
+        }
+
+        owned      = huge_buffer<T>(n);
+        owned_size = n;
+
+        return type(owned.get(), sizes...);
+    }
+
+    /*!
+     * \brief Indicates if the input is the output of the previous context
+     */
+    bool chained() const noexcept {
+        return !owned;
+    }
+
+    /*!
+     * \brief Returns the number of bytes owned by the input
+     */
+    size_t memory() const noexcept {
+        return owned_size * sizeof(T);
+    }
+
+private:
+    huge_buffer<T> owned;  ///< The memory of the input when it is not chained
+    size_t owned_size = 0; ///< The number of elements of the owned memory
+};
+
+/*!
+ * \brief Traits to get the type of an input owned by a context, with the
+ * shape of the input of the given context (the input of a chained context
+ * is only a view)
+ */
+template <typename Context, typename Enable = void>
+struct owned_input {
+    using type = std::decay_t<decltype(std::declval<Context&>().input)>; ///< The type of the input
+};
+
+/*!
+ * \copydoc owned_input
+ */
+template <typename Context>
+struct owned_input<Context, std::void_t<typename Context::owned_input_type>> {
+    using type = typename Context::owned_input_type; ///< The type of the input
+};
+
+/*!
+ * \brief The type of an input owned by a context, with the shape of the
+ * input of the given context
+ */
+template <typename Context>
+using owned_input_t = typename owned_input<Context>::type;
+
+} //end of dll namespace
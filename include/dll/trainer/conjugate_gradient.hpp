@@ -16,25 +16,30 @@
 
 #pragma once
 
+#include <algorithm>
 #include <utility>
+#include <vector>
 
-#include "dll/util/batch.hpp"
+#include "cpp_utils/maybe_parallel.hpp"
+
+#include "dll/dbn_traits.hpp"
 
 namespace dll {
 
 /*!
  * \brief The context of the gradient search for a batch
  */
-template <typename Sample, typename Label>
+template <typename Inputs, typename Labels>
 struct gradient_context {
     size_t max_iterations; ///< The maximum number of iterations
     size_t epoch;          ///< The current epoch
-    batch<Sample> inputs;  ///< The inputs
-    batch<Label> targets;  ///< The targets
+    const Inputs& inputs;  ///< The batch of inputs
+    const Labels& targets; ///< The batch of targets
+    size_t n;              ///< The number of samples in the batch
     size_t start_layer;    ///< The index of the starting layer
 
-    gradient_context(batch<Sample> i, batch<Label> t, size_t e)
-            : max_iterations(5), epoch(e), inputs(std::move(i)), targets(std::move(t)), start_layer(0) {
+    gradient_context(const Inputs& i, const Labels& t, size_t e)
+            : max_iterations(5), epoch(e), inputs(i), targets(t), n(etl::dim<0>(i)), start_layer(0) {
         //Nothing else to init
     }
 };
@@ -50,6 +55,11 @@ struct cg_trainer_base {
 
     dbn_t& dbn; ///< The DBN being trained
 
+    size_t max_slices = 1; ///< The maximum number of slices of a batch evaluated in parallel
+
+    std::vector<weight> slice_costs;  ///< The cost of each slice of the batch
+    std::vector<weight> slice_errors; ///< The squared error of each slice of the batch
+
     explicit cg_trainer_base(dbn_t& dbn) : dbn(dbn) {
         dbn.for_each_layer([](auto& r1) {
             r1.init_cg_context();
@@ -64,23 +74,56 @@ struct cg_trainer_base {
 
     /*!
      * \brief Initialize the training of the network with the given batch size
+     *
+     * The batch is split in as many slices as there are threads in the pool
+     * of the network, each slice computing its part of the gradients.
+     *
      * \param batch_size The batch size of the network
      */
     void init_training(size_t batch_size) {
-        dbn.for_each_layer([batch_size](auto& rbm) {
+        max_slices = dbn_traits<dbn_t>::is_serial() ? 1 : std::max(size_t(1), std::min(batch_size, size_t(etl::threads)));
+
+        slice_costs.resize(max_slices);
+        slice_errors.resize(max_slices);
+
+        const size_t slices = max_slices;
+
+        dbn.for_each_layer([batch_size, slices](auto& rbm) {
             auto& ctx = rbm.get_cg_context();
 
-            if (ctx.is_trained) {
-                const auto n_hidden = num_hidden(rbm);
+            using context_t = std::decay_t<decltype(ctx)>;
+            using ctx_weight = typename context_t::weight;
+
+            if constexpr (context_t::is_trained) {
+                const auto n_visible = num_visible(rbm);
+                const auto n_hidden  = num_hidden(rbm);
+
+                ctx.gr_probs_a = etl::dyn_matrix<ctx_weight, 2>(batch_size, n_hidden);
+                ctx.gr_errors  = etl::dyn_matrix<ctx_weight, 2>(batch_size, n_hidden);
 
-                for (size_t i = 0; i < batch_size; ++i) {
-                    ctx.gr_probs_a.emplace_back(n_hidden);
-                    ctx.gr_probs_s.emplace_back(n_hidden);
+                ctx.gr_w_parts.clear();
+                ctx.gr_b_parts.clear();
+
+                for (size_t s = 0; s < slices; ++s) {
+                    ctx.gr_w_parts.emplace_back(n_visible, n_hidden);
+                    ctx.gr_b_parts.emplace_back(n_hidden);
                 }
             }
         });
     }
 
+    /*!
+     * \brief Set the number of epochs of the training
+     */
+    void set_max_epochs(size_t epochs) {
+        cpp_unused(epochs);
+    }
+
+    /*!
+     * \brief Finish an epoch of training
+     */
+    void finish_epoch() {}
+
     /*!
      * \brief Train a batch of inputs
      *
@@ -92,191 +135,162 @@ struct cg_trainer_base {
      */
     template <typename Inputs, typename Labels>
     std::pair<double, double> train_batch(size_t epoch, const Inputs& inputs, const Labels& labels) {
-        using T = etl::dyn_matrix<etl::value_t<Inputs>, etl::decay_traits<Inputs>::dimensions() - 1>;
-        using L = etl::dyn_matrix<etl::value_t<Labels>, etl::decay_traits<Labels>::dimensions() - 1>;
+        gradient_context<Inputs, Labels> context(inputs, labels, epoch);
 
-        std::vector<T> inputs_cache(etl::dim<0>(inputs));
-        std::vector<L> labels_cache(etl::dim<0>(labels));
-
-        for(size_t i = 0; i < etl::dim<0>(inputs); ++i){
-            inputs_cache[i] = inputs(i);
-            labels_cache[i] = labels(i);
-        }
-
-        gradient_context<decltype(inputs_cache.begin()), decltype(labels_cache.begin())> context(
-            make_batch(inputs_cache.begin(), inputs_cache.end()),
-            make_batch(labels_cache.begin(), labels_cache.end()),
-            epoch);
-
-        minimize(context);
-
-        //TODO Compute the mini-batch error
-        return std::make_pair(0.0, 0.0);
+        return minimize(context);
     }
 
     /* Gradient */
 
-    template <bool Temp, typename R1, typename R2, typename C1, typename C2, typename D>
-    static void update_diffs(R1&, R2& r2, C1& c1, C2& c2, std::vector<D>& diffs, size_t n_samples) {
-        auto n_visible = num_visible(r2);
-        auto n_hidden  = num_hidden(r2);
-
-        for (size_t sample = 0; sample < n_samples; ++sample) {
-            D diff(n_visible);
-
-            for (size_t i = 0; i < n_visible; ++i) {
-                double s = 0.0;
-                for (size_t j = 0; j < n_hidden; ++j) {
-                    s += diffs[sample][j] * (Temp ? c2.gr_w_tmp(i, j) : r2.w(i, j));
-                }
-
-                if (R1::hidden_unit != unit_type::RELU) {
-                    s *= c1.gr_probs_a[sample][i] * (1.0 - c1.gr_probs_a[sample][i]);
-                }
-
-                diff[i] = s;
-            }
-
-            diffs[sample].swap(diff);
+    /*!
+     * \brief Returns the given slice of the batch of inputs, as a matrix
+     */
+    template <typename R, typename Inputs>
+    static decltype(auto) input_slice(const R& rbm, const Inputs& inputs, size_t first, size_t last) {
+        if constexpr (etl::decay_traits<Inputs>::dimensions() == 2) {
+            cpp_unused(rbm);
+
+            return etl::slice(inputs, first, last);
+        } else {
+            return etl::reshape(etl::slice(inputs, first, last), last - first, num_visible(rbm));
         }
     }
 
-    template <bool Temp, typename R, typename D, typename V>
-    static void update_incs(R& r, std::vector<D>& diffs, const V& visibles) {
-        auto& ctx = r.get_cg_context();
+    /*!
+     * \brief Compute the activation probabilities of a slice of the batch
+     * for the given layer
+     */
+    template <bool Temp, typename R, typename V>
+    static void activate_slice(R& rbm, const V& visibles, size_t first, size_t last) {
+        auto& ctx = rbm.get_cg_context();
 
-        auto n_visible = num_visible(r);
-        auto n_hidden  = num_hidden(r);
+        auto probs = etl::slice(ctx.gr_probs_a, first, last);
 
-        auto it            = visibles.begin();
-        auto end           = visibles.end();
-        size_t sample = 0;
+        rbm.template batch_activate_hidden<true, false>(probs, probs, visibles, visibles, Temp ? ctx.gr_b_tmp : rbm.b, Temp ? ctx.gr_w_tmp : rbm.w);
+    }
 
-        while (it != end) {
-            auto& v = *it;
-            auto& d = diffs[sample];
+    /*!
+     * \brief Propagate the errors of a slice of the batch from the layer r2
+     * to the layer r1, its previous layer
+     */
+    template <bool Temp, typename R1, typename R2>
+    static void update_errors(R1& r1, R2& r2, size_t first, size_t last) {
+        auto& c1 = r1.get_cg_context();
+        auto& c2 = r2.get_cg_context();
 
-            for (size_t i = 0; i < n_visible; ++i) {
-                for (size_t j = 0; j < n_hidden; ++j) {
-                    ctx.gr_w_incs(i, j) += v[i] * d[j];
-                }
-            }
+        auto errors = etl::slice(c1.gr_errors, first, last);
 
-            for (size_t j = 0; j < n_hidden; ++j) {
-                ctx.gr_b_incs(j) += d[j];
-            }
+        errors = etl::slice(c2.gr_errors, first, last) * etl::transpose(Temp ? c2.gr_w_tmp : r2.w);
+
+        if (R1::hidden_unit != unit_type::RELU) {
+            auto probs = etl::slice(c1.gr_probs_a, first, last);
 
-            ++it;
-            ++sample;
+            errors >>= probs >> (1.0 - probs);
         }
     }
 
     /*!
-     * \brief Compute the gradient of one context
-     * \param contex The current gradient context
-     * \param cost The current cost
+     * \brief Compute the gradients of the given layer for the slice s of
+     * the batch
      */
-    template <bool Temp, typename Sample, typename Target>
-    void gradient(const gradient_context<Sample, Target>& context, weight& cost) {
-        const auto n_hidden = output_size(dbn.template layer_get<layers - 1>());
-        auto n_samples      = context.inputs.size();
-
-        static std::vector<std::vector<weight>> diffs;
-        diffs.resize(n_samples);
+    template <typename R, typename V>
+    static void update_incs(R& rbm, const V& visibles, size_t s, size_t first, size_t last) {
+        auto& ctx = rbm.get_cg_context();
 
-        dbn.for_each_layer([](auto& rbm) {
-            rbm.get_cg_context().gr_w_incs = 0.0;
-            rbm.get_cg_context().gr_b_incs = 0.0;
-        });
-
-        cost         = 0.0;
-        weight error = 0.0;
+        auto errors = etl::slice(ctx.gr_errors, first, last);
 
-        auto it  = context.inputs.begin();
-        auto end = context.inputs.end();
-        auto tit = context.targets.begin();
+        ctx.gr_w_parts[s] = etl::transpose(visibles) * errors;
+        ctx.gr_b_parts[s] = etl::bias_batch_sum_2d(errors);
+    }
 
-        size_t sample = 0;
+    /*!
+     * \brief Compute the cost and the gradients of one slice of the batch
+     * \param context The current gradient context
+     * \param s The index of the slice
+     * \param first The first sample of the slice
+     * \param last The end of the slice
+     */
+    template <bool Temp, typename Inputs, typename Labels>
+    void gradient_slice(const gradient_context<Inputs, Labels>& context, size_t s, size_t first, size_t last) {
+        auto& first_layer = dbn.template layer_get<0>();
+        auto& last_ctx    = dbn.template layer_get<layers - 1>().get_cg_context();
 
-        while (it != end) {
-            auto& input  = *it;
-            auto output  = std::ref(dbn.template layer_get<0>().get_cg_context().gr_probs_a[sample]);
-            auto& target = *tit;
+        // Forward propagation of the slice
 
-            dbn.for_each_layer_i([&input, &output, sample](size_t I, auto& rbm) {
-                auto& ctx        = rbm.get_cg_context();
-                auto& output_ref = static_cast<etl::dyn_vector<weight>&>(output);
+        activate_slice<Temp>(first_layer, input_slice(first_layer, context.inputs, first, last), first, last);
 
-                if (I == 0) {
-                    rbm.activate_hidden(output_ref, ctx.gr_probs_s[sample], input, input, Temp ? ctx.gr_b_tmp : rbm.b, Temp ? ctx.gr_w_tmp : rbm.w);
-                } else {
-                    rbm.activate_hidden(ctx.gr_probs_a[sample], ctx.gr_probs_s[sample], output_ref, output_ref, Temp ? ctx.gr_b_tmp : rbm.b, Temp ? ctx.gr_w_tmp : rbm.w);
-                    output = std::ref(ctx.gr_probs_a[sample]);
-                }
-            });
+        dbn.for_each_layer_pair([first, last](auto& r1, auto& r2) {
+            this_type::activate_slice<Temp>(r2, etl::slice(r1.get_cg_context().gr_probs_a, first, last), first, last);
+        });
 
-            auto& diff = diffs[sample];
-            diff.resize(n_hidden);
+        // Normalize the outputs and compute the cost
 
-            auto& result = dbn.template layer_get<layers - 1>().get_cg_context().gr_probs_a[sample];
-            weight scale = std::accumulate(result.begin(), result.end(), 0.0);
+        auto output  = etl::slice(last_ctx.gr_probs_a, first, last);
+        auto errors  = etl::slice(last_ctx.gr_errors, first, last);
+        auto targets = etl::slice(context.targets, first, last);
 
-            for (auto& r : result) {
-                r *= (1.0 / scale);
-            }
+        for (size_t i = 0; i < last - first; ++i) {
+            output(i) /= etl::sum(output(i));
+        }
 
-            for (size_t i = 0; i < n_hidden; ++i) {
-                diff[i] = result[i] - target[i];
-                cost += target[i] * log(result[i]);
-                error += diff[i] * diff[i];
-            }
+        errors = output - targets;
 
-            ++it;
-            ++tit;
-            ++sample;
-        }
+        slice_costs[s]  = -etl::sum(targets >> etl::log(output));
+        slice_errors[s] = etl::sum(errors >> errors);
 
-        cost = -cost;
+        // Backward propagation of the slice
 
-        //Get pointers to the different gr_probs
-        std::array<std::vector<etl::dyn_vector<weight>>*, layers> probs_refs;
-        dbn.for_each_layer_i([&probs_refs](size_t I, auto& rbm) {
-            probs_refs[I] = &rbm.get_cg_context().gr_probs_a;
+        dbn.for_each_layer_rpair([s, first, last](auto& r1, auto& r2) {
+            this_type::update_incs(r2, etl::slice(r1.get_cg_context().gr_probs_a, first, last), s, first, last);
+            this_type::update_errors<Temp>(r1, r2, first, last);
         });
 
-        update_incs<Temp>(dbn.template layer_get<layers - 1>(), diffs, dbn.template layer_get<layers - 2>().get_cg_context().gr_probs_a);
+        update_incs(first_layer, input_slice(first_layer, context.inputs, first, last), s, first, last);
+    }
 
-#ifdef __clang__
-        dbn.for_each_layer_rpair_i([n_samples, &probs_refs](size_t I, auto& r1, auto& r2) {
-            auto& c1 = r1.get_cg_context();
-            auto& c2 = r2.get_cg_context();
+    /*!
+     * \brief Compute the gradient of one context.
+     *
+     * The batch is split in slices evaluated in parallel, the gradients of
+     * the slices are then summed.
+     *
+     * \param context The current gradient context
+     * \param cost The current cost
+     */
+    template <bool Temp, typename Inputs, typename Labels>
+    void gradient(const gradient_context<Inputs, Labels>& context, weight& cost) {
+        const size_t n      = context.n;
+        const size_t slices = std::min(n, max_slices);
 
-            this_type::update_diffs<Temp>(r1, r2, c1, c2, diffs, n_samples);
+        cpp::maybe_parallel_foreach_n(dbn.get_thread_pool(), 0, slices, [&](size_t s) {
+            const size_t first = s * n / slices;
+            const size_t last  = (s + 1) * n / slices;
 
-            if (I > 0) {
-                this_type::update_incs<Temp>(r1, diffs, *probs_refs[I - 1]);
-            }
+            gradient_slice<Temp>(context, s, first, last);
         });
 
-#else
-        std::vector<std::vector<weight>>& diffs_p = diffs;
-
-        dbn.for_each_layer_rpair_i([&diffs_p, n_samples, &probs_refs](size_t I, auto& r1, auto& r2) {
-            auto& c1 = r1.get_cg_context();
-            auto& c2 = r2.get_cg_context();
+        dbn.for_each_layer([slices](auto& rbm) {
+            auto& ctx = rbm.get_cg_context();
 
-            this_type::update_diffs<Temp>(r1, r2, c1, c2, diffs_p, n_samples);
+            ctx.gr_w_incs = ctx.gr_w_parts[0];
+            ctx.gr_b_incs = ctx.gr_b_parts[0];
 
-            if (I > 0) {
-                this_type::update_incs<Temp>(r1, diffs_p, *probs_refs[I - 1]);
+            for (size_t s = 1; s < slices; ++s) {
+                ctx.gr_w_incs += ctx.gr_w_parts[s];
+                ctx.gr_b_incs += ctx.gr_b_parts[s];
             }
         });
-#endif
 
-        update_incs<Temp>(dbn.template layer_get<0>(), diffs, context.inputs);
+        cost         = 0.0;
+        weight error = 0.0;
+
+        for (size_t s = 0; s < slices; ++s) {
+            cost += slice_costs[s];
+            error += slice_errors[s];
+        }
 
         if (Debug) {
-            std::cout << "evaluating(" << Temp << "): cost:" << cost << " error: " << (error / n_samples) << std::endl;
+            std::cout << "evaluating(" << Temp << "): cost:" << cost << " error: " << (error / n) << std::endl;
         }
     }
 
@@ -388,9 +402,10 @@ struct cg_trainer_base {
 
     /*!
      * \brief Minimize the gradient of the given context
+     * \return the error and the loss of the batch, before the minimization
      */
-    template <typename Sample, typename Target>
-    void minimize(const gradient_context<Sample, Target>& context) {
+    template <typename Inputs, typename Labels>
+    std::pair<double, double> minimize(const gradient_context<Inputs, Labels>& context) {
         constexpr weight INT   = 0.1;       //Don't reevaluate within 0.1 of the limit of the current bracket
         constexpr weight EXT   = 3.0;       //Extrapolate maximum 3 times the current step-size
         constexpr weight SIG   = 0.1;       //Maximum allowed maximum ration between previous and new slopes
@@ -404,6 +419,11 @@ struct cg_trainer_base {
         weight cost = 0.0;
         gradient<false>(context, cost);
 
+        // The outputs of the first evaluation give the metrics of the batch
+        auto& outputs = dbn.template layer_get<layers - 1>().get_cg_context().gr_probs_a;
+
+        auto [error, loss] = dbn.evaluate_metrics_batch(etl::slice(outputs, 0, context.n), context.targets, context.n, true);
+
         dbn.for_each_layer([](auto& rbm) {
             auto& ctx = rbm.get_cg_context();
 
@@ -633,6 +653,8 @@ struct cg_trainer_base {
                 failed = true;
             }
         }
+
+        return std::make_pair(error, loss);
     }
 
     template <bool Train, typename Inputs>
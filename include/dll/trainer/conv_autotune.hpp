@@ -0,0 +1,116 @@
+//=======================================================================
+// Copyright (c) 2014-2017 Baptiste Wicht
+// Distributed under the terms of the MIT License.
+// (See accompanying file LICENSE or copy at
+//  http://opensource.org/licenses/MIT)
+//=======================================================================
+
+/*!
+ * \file
+ * \brief Selection of the fastest implementation of the convolutions of
+ * each layer of a network
+ */
+
+#pragma once
+
+#include <string>
+#include <type_traits>
+
+#include "cpp_utils/tuple_utils.hpp"
+
+#include "dll/trainer/stochastic_gradient_descent.hpp" // For build_context
+#include "dll/util/conv_tuning.hpp"
+
+namespace dll {
+
+/*!
+ * \brief Indicates if the implementations of the convolutions of the layer
+ * can be selected
+ */
+template <typename Layer, typename Enable = void>
+struct has_conv_tuning : std::false_type {};
+
+/*!
+ * \copydoc has_conv_tuning
+ */
+template <typename Layer>
+struct has_conv_tuning<Layer, std::void_t<decltype(std::declval<Layer&>().tuning), decltype(std::declval<const Layer&>().tuning_key())>> : std::true_type {};
+
+/*!
+ * \brief Select the fastest implementation of the convolutions of each
+ * layer of the given network.
+ *
+ * For each layer with several implementations, the forward pass, the
+ * backpropagation of the errors and the gradients of the filters are
+ * timed with each implementation, on a batch of the size of the network.
+ * The layer shapes already present in the cache file are not timed again.
+ * The new shapes are added to the cache file.
+ *
+ * \param dbn The network to tune
+ * \param file The tuning cache file (none if empty)
+ * \param repeat The number of measured runs of each implementation
+ * \return The tuning of all the layer shapes
+ */
+template <typename DBN>
+conv_tuning_cache autotune_convolutions(DBN& dbn, const std::string& file = "", size_t repeat = 5) {
+    conv_tuning_cache cache;
+
+    if (!file.empty()) {
+        cache.load(file);
+    }
+
+    auto context = build_context<full_sgd_context>(dbn);
+    sgd_trainer<DBN>::inherit_dimensions(context);
+
+    bool updated = false;
+
+    cpp::for_each(context, [&](auto& layer_ctx) {
+        auto& layer = layer_ctx.first;
+        auto& ctx   = *layer_ctx.second;
+
+        using layer_t = std::decay_t<decltype(layer)>;
+
+        if constexpr (has_conv_tuning<layer_t>::value) {
+            const auto key = layer.tuning_key() + ":b" + std::to_string(DBN::batch_size);
+
+            if (!cache.contains(key)) {
+                ctx.input  = etl::uniform_generator(-1.0, 1.0);
+                ctx.errors = etl::uniform_generator(-1.0, 1.0);
+
+                // The errors of the previous layer
+                auto back = ctx.input;
+
+                conv_tuning tuning;
+
+                tuning.forward = fastest_conv_impl(layer.conv_impls(), repeat, [&](conv_impl impl) {
+                    layer.tuning.forward = impl;
+                    layer.train_forward_batch(ctx.output, ctx.input);
+                });
+
+                tuning.backward = fastest_conv_impl(layer.conv_impls(), repeat, [&](conv_impl impl) {
+                    layer.tuning.backward = impl;
+                    layer.backward_batch(back, ctx);
+                });
+
+                // The gradients of the filters only have the ETL implementation
+                tuning.gradients = fastest_conv_impl({conv_impl::ETL}, repeat, [&](conv_impl impl) {
+                    layer.tuning.gradients = impl;
+                    layer.compute_gradients(ctx);
+                });
+
+                cache.entries[key] = tuning;
+                updated            = true;
+            }
+
+            layer.tuning = cache.entries[key];
+        }
+    });
+
+    if (updated && !file.empty()) {
+        cache.save(file);
+    }
+
+    return cache;
+}
+
+} //end of dll namespace
@@ -7,24 +7,78 @@
 
 #pragma once
 
+#include <algorithm>
+#include <chrono>
+#include <future>
+#include <memory>
+#include <numeric>
+#include <sstream>
+#include <vector>
+
 #include "cpp_utils/algorithm.hpp" // For parallel_shuffle
 
 #include "etl/etl.hpp"
 
 #include "dll/util/labels.hpp"
 #include "dll/util/timers.hpp"
+#include "dll/util/memory.hpp"
 #include "dll/util/random.hpp"
 #include "dll/util/batch.hpp" // For make_batch
+#include "dll/util/training_state.hpp"
+#include "dll/generators/stream_generator.hpp"
+#include "dll/generators/distill_generator.hpp"
+#include "dll/generators/feature_cache_generator.hpp"
 #include "dll/test.hpp"
 #include "dll/dbn_traits.hpp"
 
 namespace dll {
 
+/*!
+ * \brief Traits to test if a trainer can account its memory
+ */
+template <typename Trainer, typename Enable = void>
+struct has_memory_usage : std::false_type {};
+
+/*!
+ * \copydoc has_memory_usage
+ */
+template <typename Trainer>
+struct has_memory_usage<Trainer, std::void_t<decltype(std::declval<const Trainer&>().memory_usage())>> : std::true_type {};
+
+/*!
+ * \brief Traits to test if a trainer is distributed over several ranks
+ */
+template <typename Trainer, typename Enable = void>
+struct is_distributed_trainer : std::false_type {};
+
+/*!
+ * \copydoc is_distributed_trainer
+ */
+template <typename Trainer>
+struct is_distributed_trainer<Trainer, std::void_t<decltype(std::declval<const Trainer&>().rank())>> : std::true_type {};
+
+/*!
+ * \brief Traits to test if a trainer can train from the cached features
+ * of the frozen layers
+ */
+template <typename Trainer, typename Enable = void>
+struct has_feature_cache : std::false_type {};
+
+/*!
+ * \copydoc has_feature_cache
+ */
+template <typename Trainer>
+struct has_feature_cache<Trainer, std::void_t<decltype(Trainer::cacheable_prefix(size_t()))>> : std::true_type {};
+
 /*!
  * \brief A generic trainer for Deep Belief Network
  *
  * This trainer use the specified trainer of the DBN to perform supervised
  * fine-tuning.
+ *
+ * With a distributed trainer, only the rank 0 notifies the watcher and
+ * checkpoints the network, and the metrics of the epochs are averaged over
+ * the ranks.
  */
 template <typename DBN>
 struct dbn_trainer {
@@ -32,6 +86,8 @@ struct dbn_trainer {
     using weight     = typename dbn_t::weight; ///< The data type for this layer
     using error_type = typename dbn_t::weight; ///< The error type
 
+    static_assert(!dbn_traits<dbn_t>::inference_only(), "inference_only networks cannot be trained");
+
     /*!
      * \brief The trainer for the given RBM
      */
@@ -60,24 +116,61 @@ struct dbn_trainer {
     size_t best_epoch     = 0;   ///< The best epoch
     size_t patience       = 0;   ///< The current patience
 
+    double epoch_error   = 0.0; ///< The accumulated error of the batches of the epoch
+    double epoch_loss    = 0.0; ///< The accumulated loss of the batches of the epoch
+    size_t epoch_samples = 0;   ///< The number of samples trained in the epoch
+
+    std::unique_ptr<dbn_t> snapshot; ///< The snapshot of the network validated asynchronously
+
+    std::vector<size_t> subset_batches; ///< The validation batches evaluated at each epoch (validation_subset)
+
+    size_t first_epoch    = 0; ///< The first epoch of the training (resumed training)
+    size_t trained_epochs = 0; ///< The number of epochs completely trained
+
+    /*!
+     * \brief The position of a training resumed inside an epoch
+     */
+    struct resume_point {
+        bool active          = false; ///< Indicates if the next epoch is resumed inside the epoch
+        size_t batches       = 0;     ///< The number of batches already trained in the epoch
+        double epoch_error   = 0.0;   ///< The accumulated error of the trained batches
+        double epoch_loss    = 0.0;   ///< The accumulated loss of the trained batches
+        size_t epoch_samples = 0;     ///< The number of trained samples
+        std::string generator;        ///< The state of the generator (empty if not supported)
+    };
+
+    resume_point resume; ///< The position of the resumed training
+
     /*!
      * \brief Initialize the training
      * \param dbn The network to train
      * \param ae Indicates if trained as auto-encoder or not
      * \param max_epochs How many epochs will be used
      */
-    void start_training(dbn_t& dbn, size_t max_epochs){
+    void start_training(dbn_t& dbn, size_t max_epochs, size_t generator_memory = 0){
         constexpr auto batch_size = std::decay_t<dbn_t>::batch_size;
 
         //Initialize the momentum
         dbn.momentum = dbn.initial_momentum;
 
-        watcher.fine_tuning_begin(dbn, max_epochs);
-
         trainer = std::make_unique<trainer_t<dbn_t>>(dbn);
 
+        //Account the memory of the training before it starts
+        if constexpr (has_memory_usage<trainer_t<dbn_t>>::value) {
+            dbn.memory = trainer->memory_usage();
+        } else {
+            dbn.memory = memory_report();
+        }
+
+        dbn.memory.generator = generator_memory;
+
+        if (main_rank()) {
+            watcher.fine_tuning_begin(dbn, max_epochs);
+        }
+
         //Initialize the trainer if necessary
         trainer->init_training(batch_size);
+        trainer->set_max_epochs(max_epochs);
 
         // Set the initial error and loss
         current_error = 0.0;
@@ -85,6 +178,234 @@ struct dbn_trainer {
 
         current_val_error = 0.0;
         current_val_loss = 0.0;
+
+        // A new subset of validation is drawn for each training
+        subset_batches.clear();
+
+        first_epoch    = 0;
+        trained_epochs = 0;
+        resume         = resume_point();
+
+        if (!dbn.resume_state.empty()) {
+            if (!restore_training_state(dbn)) {
+                std::cerr << "ERROR: The training state does not match the network, the training is not resumed" << std::endl;
+
+                first_epoch = 0;
+                resume      = resume_point();
+
+                trainer = std::make_unique<trainer_t<dbn_t>>(dbn);
+                trainer->init_training(batch_size);
+                trainer->set_max_epochs(max_epochs);
+            }
+
+            dbn.resume_state.clear();
+        }
+    }
+
+    /*!
+     * \brief Serialize the training state, to be resumed at the given
+     * position
+     *
+     * \param dbn The network being trained
+     * \param epoch The epoch to resume
+     * \param batches The number of batches already trained in the epoch
+     * \param generator The state of the generator (empty if not supported)
+     *
+     * \return The training state
+     */
+    std::string store_training_state(const dbn_t& dbn, size_t epoch, size_t batches, const std::string& generator) const {
+        std::ostringstream os;
+
+        training_state_header header;
+        header.weight = sizeof(weight);
+
+        state_write(os, header);
+
+        state_write(os, uint64_t(epoch));
+        state_write(os, uint64_t(batches));
+
+        state_write(os, double(dbn.learning_rate));
+        state_write(os, double(dbn.momentum));
+        state_write(os, double(dbn.loss_scale));
+
+        state_write(os, double(current_error));
+        state_write(os, double(current_loss));
+        state_write(os, double(current_val_error));
+        state_write(os, double(current_val_loss));
+        state_write(os, double(best_error));
+        state_write(os, double(best_loss));
+        state_write(os, uint64_t(best_epoch));
+        state_write(os, uint64_t(patience));
+
+        state_write(os, epoch_error);
+        state_write(os, epoch_loss);
+        state_write(os, uint64_t(epoch_samples));
+
+        if constexpr (has_trainer_state<trainer_t<dbn_t>>::value) {
+            trainer->store_state(os);
+        }
+
+        state_write(os, uint64_t(generator.size()));
+        os.write(generator.data(), generator.size());
+
+        return os.str();
+    }
+
+    /*!
+     * \brief Restore the training state resumed by the network
+     * \return true if the state was restored, false otherwise
+     */
+    bool restore_training_state(dbn_t& dbn) {
+        std::istringstream is(dbn.resume_state);
+
+        training_state_header header;
+
+        if (!state_read(is, header) || header.magic != training_state_header::file_magic
+                || header.version != training_state_header::file_version || header.weight != sizeof(weight)) {
+            return false;
+        }
+
+        uint64_t epoch = 0;
+        uint64_t batches = 0;
+        double values[9];
+        uint64_t counters[3];
+
+        bool ok = state_read(is, epoch) && state_read(is, batches);
+
+        for (size_t i = 0; ok && i < 9; ++i) {
+            ok = state_read(is, values[i]);
+        }
+
+        ok = ok && state_read(is, counters[0]) && state_read(is, counters[1]);
+        ok = ok && state_read(is, resume.epoch_error) && state_read(is, resume.epoch_loss) && state_read(is, counters[2]);
+
+        if (!ok) {
+            return false;
+        }
+
+        if constexpr (has_trainer_state<trainer_t<dbn_t>>::value) {
+            if (!trainer->load_state(is)) {
+                return false;
+            }
+        }
+
+        uint64_t generator = 0;
+
+        if (!state_read(is, generator)) {
+            return false;
+        }
+
+        resume.generator.resize(generator);
+
+        if (!is.read(&resume.generator[0], generator)) {
+            return false;
+        }
+
+        dbn.learning_rate = values[0];
+        dbn.momentum      = values[1];
+        dbn.loss_scale    = values[2];
+
+        current_error     = values[3];
+        current_loss      = values[4];
+        current_val_error = values[5];
+        current_val_loss  = values[6];
+        best_error        = values[7];
+        best_loss         = values[8];
+        best_epoch        = counters[0];
+        patience          = counters[1];
+
+        first_epoch          = epoch;
+        trained_epochs       = epoch;
+        resume.active        = batches > 0;
+        resume.batches       = batches;
+        resume.epoch_samples = counters[2];
+
+        // The best weights are not part of the state, the resumed weights
+        // are the best weights known so far
+        if constexpr (dbn_t::early != strategy::NONE) {
+            dbn.backup_weights();
+        }
+
+        return true;
+    }
+
+    /*!
+     * \brief Restore the position of the generator and the metrics of a
+     * training resumed inside an epoch
+     */
+    template <typename Generator>
+    void resume_epoch(Generator& generator) {
+        resume.active = false;
+
+        epoch_error   = resume.epoch_error;
+        epoch_loss    = resume.epoch_loss;
+        epoch_samples = resume.epoch_samples;
+
+        if constexpr (has_generator_state<Generator>::value) {
+            if (!resume.generator.empty()) {
+                std::istringstream is(resume.generator);
+
+                if (generator.load_state(is)) {
+                    return;
+                }
+
+                std::cerr << "ERROR: The state of the generator does not match, the trained batches are skipped" << std::endl;
+            }
+        }
+
+        // Without the state of the generator, the trained batches are skipped
+        generator.reset();
+
+        for (size_t b = 0; b < resume.batches && generator.has_next_batch(); ++b) {
+            generator.next_batch();
+        }
+    }
+
+    /*!
+     * \brief Checkpoint the network and the training state inside an
+     * epoch, every checkpoint_batches batches
+     * \param dbn The network being trained
+     * \param generator The generator of the training data
+     * \param epoch The current epoch
+     */
+    template <typename Generator>
+    void checkpoint_batch(dbn_t& dbn, const Generator& generator, size_t epoch) {
+        // Only the synchronous trainers have a consistent state inside an epoch
+        if constexpr (has_trainer_state<trainer_t<dbn_t>>::value) {
+            const size_t batch = generator.current_batch();
+
+            if (!dbn.checkpoints || !dbn.checkpoint_batches || !main_rank() || !generator.has_next_batch() || batch % dbn.checkpoint_batches) {
+                return;
+            }
+
+            std::string state;
+
+            if constexpr (has_generator_state<Generator>::value) {
+                std::ostringstream os;
+                generator.store_state(os);
+                state = os.str();
+            }
+
+            dbn.checkpoint();
+            dbn.checkpoint_state(store_training_state(dbn, epoch, batch, state));
+        } else {
+            cpp_unused(dbn);
+            cpp_unused(generator);
+            cpp_unused(epoch);
+        }
+    }
+
+    /*!
+     * \brief Checkpoint the network and the training state at the end of
+     * an epoch, every checkpoint_epochs epochs
+     * \param dbn The network being trained
+     * \param epoch The current epoch
+     */
+    void checkpoint_epoch(dbn_t& dbn, size_t epoch) {
+        if (dbn.checkpoints && main_rank() && (epoch + 1) % dbn.checkpoint_epochs == 0) {
+            dbn.checkpoint();
+            dbn.checkpoint_state(store_training_state(dbn, trained_epochs, 0, std::string()));
+        }
     }
 
     /*!
@@ -105,7 +426,7 @@ struct dbn_trainer {
 
             if constexpr (s != strategy::NONE) {
                 if(best_epoch < max_epochs - 1){
-                    dbn.restore_weights();
+                    restore_best_weights(dbn);
 
                     if (is_error(s)) {
                         dbn.out << "Restore the best (error) weights from epoch " << best_epoch << std::endl;
@@ -116,18 +437,114 @@ struct dbn_trainer {
             }
         }
 
-        watcher.fine_tuning_end(dbn);
+        if (main_rank()) {
+            // The final weights are checkpointed before the end of the training,
+            // a finished training is not resumed
+            dbn.checkpoint();
+
+            if (dbn.checkpoints) {
+                dbn.checkpoint_state(store_training_state(dbn, max_epochs, 0, std::string()));
+            }
+
+            dbn.flush_checkpoints();
+
+            watcher.fine_tuning_end(dbn);
+        }
 
         return current_error;
     }
 
+    /*!
+     * \brief Copy the weights of a network into another network of the same
+     * type
+     * \param from The network to copy the weights from
+     * \param to The network to copy the weights to
+     */
+    static void copy_weights(const dbn_t& from, dbn_t& to){
+        std::stringstream buffer;
+
+        from.store(buffer);
+        to.load(buffer);
+    }
+
+    /*!
+     * \brief Save the current weights as the best weights.
+     *
+     * During an asynchronous validation, the best weights are the weights
+     * of the validated snapshot.
+     */
+    void backup_best_weights(dbn_t& dbn){
+        if (snapshot) {
+            snapshot->backup_weights();
+        } else {
+            dbn.backup_weights();
+        }
+    }
+
+    /*!
+     * \brief Restore the best weights into the network
+     */
+    void restore_best_weights(dbn_t& dbn){
+        if (snapshot) {
+            snapshot->restore_weights();
+
+            copy_weights(*snapshot, dbn);
+        } else {
+            dbn.restore_weights();
+        }
+    }
+
+    /*!
+     * \brief Create the snapshot of the network for the asynchronous
+     * validation.
+     *
+     * The snapshot is a new network of the same type, it must have the same
+     * shapes as the trained network once constructed (static or hybrid
+     * layers).
+     *
+     * \return true if the snapshot has been created, false otherwise
+     */
+    bool prepare_snapshot(dbn_t& dbn){
+        snapshot = std::make_unique<dbn_t>();
+
+        std::stringstream trained;
+        std::stringstream snapshotted;
+
+        dbn.store(trained);
+        snapshot->store(snapshotted);
+
+        if (trained.str().size() != snapshotted.str().size()) {
+            std::cerr << "ERROR: The network cannot be validated asynchronously (dynamic shapes), it is validated after each epoch" << std::endl;
+
+            snapshot.reset();
+
+            return false;
+        }
+
+        return true;
+    }
+
     /*!
      * \brief Start a new epoch
      * \param dbn The network that is trained
      * \param epoch The current epoch
      */
     void start_epoch(dbn_t& dbn, size_t epoch){
-        watcher.ft_epoch_start(epoch, dbn);
+        if (main_rank()) {
+            watcher.ft_epoch_start(epoch, dbn);
+        }
+    }
+
+    /*!
+     * \brief Indicates if this process notifies the watcher and checkpoints
+     * the network (always, unless the trainer is distributed)
+     */
+    bool main_rank() const {
+        if constexpr (is_distributed_trainer<trainer_t<dbn_t>>::value) {
+            return trainer->rank() == 0;
+        } else {
+            return true;
+        }
     }
 
     /*!
@@ -157,14 +574,14 @@ struct dbn_trainer {
                     best_error = error;
                     best_epoch = epoch;
 
-                    dbn.backup_weights();
+                    backup_best_weights(dbn);
                 }
             } else {
                 if(!epoch || loss < best_loss){
                     best_loss = loss;
                     best_epoch = epoch;
 
-                    dbn.backup_weights();
+                    backup_best_weights(dbn);
                 }
             }
         }
@@ -178,7 +595,7 @@ struct dbn_trainer {
                     dbn.out << "Stopping: Loss below goal";
 
                     if(epoch != best_epoch){
-                        dbn.restore_weights();
+                        restore_best_weights(dbn);
 
                         dbn.out << ", restore weights from epoch " << best_epoch;
                     }
@@ -194,7 +611,7 @@ struct dbn_trainer {
                     dbn.out << "Stopping: Error below goal";
 
                     if(epoch != best_epoch){
-                        dbn.restore_weights();
+                        restore_best_weights(dbn);
 
                         dbn.out << ", restore weights from epoch " << best_epoch;
                     }
@@ -213,7 +630,7 @@ struct dbn_trainer {
                         dbn.out << "Stopping: Loss has been increasing for " << dbn.patience << " epochs";
 
                         if (epoch != best_epoch) {
-                            dbn.restore_weights();
+                            restore_best_weights(dbn);
 
                             dbn.out << ", restore weights from epoch " << best_epoch;
                         }
@@ -235,7 +652,7 @@ struct dbn_trainer {
                         dbn.out << "Stopping: Error has been increasing for " << dbn.patience << " epochs";
 
                         if (epoch != best_epoch) {
-                            dbn.restore_weights();
+                            restore_best_weights(dbn);
 
                             dbn.out << ", restore weights from epoch " << best_epoch;
                         }
@@ -257,7 +674,7 @@ struct dbn_trainer {
                         dbn.out << "Stopping: Loss has been increasing (from best) for " << dbn.patience << " epochs";
 
                         if (epoch != best_epoch) {
-                            dbn.restore_weights();
+                            restore_best_weights(dbn);
 
                             dbn.out << ", restore weights from epoch " << best_epoch;
                         }
@@ -279,7 +696,7 @@ struct dbn_trainer {
                         dbn.out << "Stopping: Error has been increasing (from best) for " << dbn.patience << " epochs";
 
                         if (epoch != best_epoch) {
-                            dbn.restore_weights();
+                            restore_best_weights(dbn);
 
                             dbn.out << ", restore weights from epoch " << best_epoch;
                         }
@@ -312,7 +729,9 @@ struct dbn_trainer {
             dbn.momentum = dbn.final_momentum;
         }
 
-        watcher.ft_epoch_end(epoch, error, loss, dbn);
+        if (main_rank()) {
+            watcher.ft_epoch_end(epoch, error, loss, dbn);
+        }
 
         // Early stopping with training error/loss
         auto stop =  early_stop(dbn, epoch, error, loss, current_error, current_loss);
@@ -321,6 +740,8 @@ struct dbn_trainer {
         current_error = error;
         current_loss  = loss;
 
+        checkpoint_epoch(dbn, epoch);
+
         return stop;
     }
 
@@ -340,7 +761,9 @@ struct dbn_trainer {
             dbn.momentum = dbn.final_momentum;
         }
 
-        watcher.ft_epoch_end(epoch, error, train_stats.second, val_stats.first, val_stats.second, dbn);
+        if (main_rank()) {
+            watcher.ft_epoch_end(epoch, error, train_stats.second, val_stats.first, val_stats.second, dbn);
+        }
 
         // Early stopping with validation (or training) error/loss
 
@@ -358,6 +781,8 @@ struct dbn_trainer {
         current_val_error = val_stats.first;
         current_val_loss  = val_stats.second;
 
+        checkpoint_epoch(dbn, epoch);
+
         return stop;
     }
 
@@ -381,11 +806,180 @@ struct dbn_trainer {
             };
 
             std::tie(new_error, new_loss) = dbn.evaluate_metrics(generator, forward_helper);
+
+            if constexpr (is_distributed_trainer<trainer_t<dbn_t>>::value) {
+                std::tie(new_error, new_loss) = trainer->average_metrics(std::make_pair(new_error, new_loss));
+            }
         }
 
         return std::make_pair(new_error, new_loss);
     }
 
+    /*!
+     * \brief Accumulate the metrics of a trained batch in the metrics of the
+     * epoch
+     * \param n The number of samples of the batch
+     * \param error The error of the batch
+     * \param loss The loss of the batch
+     */
+    void accumulate_error_loss(size_t n, double error, double loss){
+        if constexpr (dbn_traits<dbn_t>::running_error()) {
+            epoch_error += error * n;
+            epoch_loss += loss * n;
+            epoch_samples += n;
+        } else {
+            cpp_unused(n);
+            cpp_unused(error);
+            cpp_unused(loss);
+        }
+    }
+
+    /*!
+     * \brief Compute the error and the loss of the epoch on the training set
+     *
+     * With running_error, they are the metrics accumulated from the batches
+     * of the epoch, otherwise the training set is evaluated again.
+     *
+     * \param dbn The network
+     * \param generator The generator of the training set
+     *
+     * \return a pair containing (error, loss)
+     */
+    template<typename Generator>
+    std::pair<double, double> compute_train_error_loss(dbn_t& dbn, Generator& generator){
+        if constexpr (dbn_traits<dbn_t>::error_on_epoch() && dbn_traits<dbn_t>::running_error()) {
+            auto stats = std::make_pair(epoch_error / std::max(epoch_samples, size_t(1)), epoch_loss / std::max(epoch_samples, size_t(1)));
+
+            if constexpr (is_distributed_trainer<trainer_t<dbn_t>>::value) {
+                stats = trainer->average_metrics(stats);
+            }
+
+            return stats;
+        } else {
+            return compute_error_loss(dbn, generator);
+        }
+    }
+
+    /*!
+     * \brief Compute the error and loss on a fixed random subset of the
+     * batches of the given generator
+     *
+     * \param dbn The network
+     * \param generator The generator of the validation set
+     *
+     * \return a pair containing (error, loss)
+     */
+    template<typename Generator>
+    std::pair<double, double> compute_subset_error_loss(dbn_t& dbn, Generator& generator){
+        dll::auto_timer timer("net:trainer:train:epoch:error:subset");
+
+        if (subset_batches.empty()) {
+            const size_t batches = generator.batches();
+            const size_t subset  = std::max(size_t(1), std::min(batches, (dbn.validation_subset * batches + generator.size() - 1) / generator.size()));
+
+            subset_batches.resize(batches);
+            std::iota(subset_batches.begin(), subset_batches.end(), 0);
+            std::shuffle(subset_batches.begin(), subset_batches.end(), dll::rand_engine());
+
+            subset_batches.resize(subset);
+            std::sort(subset_batches.begin(), subset_batches.end());
+        }
+
+        generator.reset();
+        generator.set_test();
+
+        double error = 0.0;
+        double loss  = 0.0;
+        size_t n     = 0;
+
+        auto next = subset_batches.begin();
+
+        for (size_t b = 0; generator.has_next_batch() && next != subset_batches.end(); ++b) {
+            if (b == *next) {
+                auto input_batch = generator.data_batch();
+                auto label_batch = generator.label_batch();
+
+                decltype(auto) output = trainer->template forward_batch_helper<false>(dbn, input_batch);
+
+                auto [batch_error, batch_loss] = dbn.evaluate_metrics_batch(output, label_batch, etl::dim<0>(input_batch), false);
+
+                error += batch_error;
+                loss += batch_loss;
+                n += etl::dim<0>(input_batch);
+
+                ++next;
+            }
+
+            generator.next_batch();
+        }
+
+        auto stats = std::make_pair(error / std::max(n, size_t(1)), loss / std::max(n, size_t(1)));
+
+        if constexpr (is_distributed_trainer<trainer_t<dbn_t>>::value) {
+            stats = trainer->average_metrics(stats);
+        }
+
+        return stats;
+    }
+
+    /*!
+     * \brief Indicates if the given validation metrics would stop the
+     * training, without changing the state of the early stopping
+     */
+    bool stop_candidate(dbn_t& dbn, double error, double loss) const {
+        static constexpr auto s = dbn_t::early;
+
+        if constexpr (s == strategy::LOSS_GOAL) {
+            return loss <= dbn.goal;
+        } else if constexpr (s == strategy::ERROR_GOAL) {
+            return error <= dbn.goal;
+        } else if constexpr (s == strategy::LOSS_DIRECT) {
+            return loss > current_val_loss && patience <= 1;
+        } else if constexpr (s == strategy::ERROR_DIRECT) {
+            return error > current_val_error && patience <= 1;
+        } else if constexpr (s == strategy::LOSS_BEST) {
+            return loss > best_loss && patience <= 1;
+        } else if constexpr (s == strategy::ERROR_BEST) {
+            return error > best_error && patience <= 1;
+        } else {
+            cpp_unused(dbn);
+            cpp_unused(error);
+            cpp_unused(loss);
+
+            return false;
+        }
+    }
+
+    /*!
+     * \brief Compute the error and loss of an epoch on the validation set.
+     *
+     * With a validation_subset, only a fixed random subset of the batches is
+     * evaluated, except every validation_full_epochs epochs and when the
+     * metrics of the subset would stop the training.
+     *
+     * \param dbn The network
+     * \param generator The generator of the validation set
+     * \param epoch The current epoch
+     *
+     * \return a pair containing (error, loss)
+     */
+    template<typename Generator>
+    std::pair<double, double> compute_val_error_loss(dbn_t& dbn, Generator& generator, size_t epoch){
+        if constexpr (dbn_traits<dbn_t>::error_on_epoch()) {
+            const size_t full_epochs = std::max(dbn.validation_full_epochs, size_t(1));
+
+            if (dbn.validation_subset && dbn.validation_subset < generator.size() && (epoch + 1) % full_epochs) {
+                auto stats = compute_subset_error_loss(dbn, generator);
+
+                if (dbn_traits<dbn_t>::early_uses_training() || !epoch || !stop_candidate(dbn, stats.first, stats.second)) {
+                    return stats;
+                }
+            }
+        }
+
+        return compute_error_loss(dbn, generator);
+    }
+
     /*!
      * \brief Train the network for one epoch
      * \param generator The generator for training data
@@ -396,21 +990,101 @@ struct dbn_trainer {
         // Set the generator in train mode
         generator.set_train();
 
+        epoch_error   = 0.0;
+        epoch_loss    = 0.0;
+        epoch_samples = 0;
+
+        if (resume.active) {
+            resume_epoch(generator);
+        }
+
+        if constexpr (dbn_traits<dbn_t>::stage_inputs()) {
+            train_epoch_staged(dbn, generator, epoch);
+            trained_epochs = epoch + 1;
+            return;
+        }
+
         //Train one mini-batch at a time
         while(generator.has_next_batch()){
             dll::auto_timer timer("net:trainer:train:epoch:batch");
 
-            watcher.ft_batch_start(epoch, dbn);
+            if (main_rank()) {
+                watcher.ft_batch_start(epoch, dbn);
+            }
 
             auto [batch_error, batch_loss] = trainer->train_batch(
                 epoch,
                 generator.data_batch(),
                 generator.label_batch());
 
-            watcher.ft_batch_end(epoch, generator.current_batch(), generator.batches(), batch_error, batch_loss, dbn);
+            accumulate_error_loss(etl::dim<0>(generator.data_batch()), batch_error, batch_loss);
+
+            if (main_rank()) {
+                watcher.ft_batch_end(epoch, generator.current_batch(), generator.batches(), batch_error, batch_loss, dbn);
+            }
 
             generator.next_batch();
+
+            checkpoint_batch(dbn, generator, epoch);
         }
+
+        // Wait for the trainer to finish the epoch
+        trainer->finish_epoch();
+
+        trained_epochs = epoch + 1;
+    }
+
+    /*!
+     * \brief Train the network for one epoch, staging the next batch while
+     * the current batch is trained on another thread
+     *
+     * \param dbn The network to train
+     * \param generator The generator to use for training data
+     * \param epoch The current epoch
+     */
+    template<typename Generator>
+    void train_epoch_staged(dbn_t& dbn, Generator& generator, size_t epoch){
+        auto stage = [this, &generator]() {
+            // The other threads are busy with the current batch
+            SERIAL_SECTION {
+                trainer->stage_batch(generator.data_batch(), generator.label_batch());
+            }
+        };
+
+        if (generator.has_next_batch()) {
+            stage();
+        }
+
+        //Train one mini-batch at a time
+        while(generator.has_next_batch()){
+            dll::auto_timer timer("net:trainer:train:epoch:batch");
+
+            watcher.ft_batch_start(epoch, dbn);
+
+            const size_t batch = generator.current_batch();
+            const size_t n     = etl::dim<0>(generator.data_batch());
+
+            trainer->swap_staged();
+
+            auto result = std::async(std::launch::async, [this, epoch]() { return trainer->train_staged(epoch); });
+
+            generator.next_batch();
+
+            if (generator.has_next_batch()) {
+                stage();
+            }
+
+            auto [batch_error, batch_loss] = result.get();
+
+            accumulate_error_loss(n, batch_error, batch_loss);
+
+            watcher.ft_batch_end(epoch, batch, generator.batches(), batch_error, batch_loss, dbn);
+
+            checkpoint_batch(dbn, generator, epoch);
+        }
+
+        // Wait for the trainer to finish the epoch
+        trainer->finish_epoch();
     }
 
     /*!
@@ -428,7 +1102,7 @@ struct dbn_trainer {
         train_epoch_only(dbn, generator, epoch);
 
         // Compute the error at this epoch
-        return compute_error_loss(dbn, generator);
+        return compute_train_error_loss(dbn, generator);
     }
 
     /*!
@@ -448,10 +1122,10 @@ struct dbn_trainer {
         train_epoch_only(dbn, train_generator, epoch);
 
         // Compute the training error at this epoch
-        auto train_stats = compute_error_loss(dbn, train_generator);
+        auto train_stats = compute_train_error_loss(dbn, train_generator);
 
-        // Compute the training error at this epoch
-        auto val_stats = compute_error_loss(dbn, val_generator);
+        // Compute the validation error at this epoch, from the inputs of the network
+        auto val_stats = without_feature_cache([&]() { return compute_val_error_loss(dbn, val_generator, epoch); });
 
         // Return the stats
         return std::make_pair(train_stats, val_stats);
@@ -477,14 +1151,136 @@ struct dbn_trainer {
      */
     template <typename Generator>
     error_type train(DBN& dbn, Generator& generator, size_t max_epochs) {
+        if constexpr (feature_cache_possible<Generator>()) {
+            if (const size_t prefix = feature_cache_prefix(dbn)) {
+                feature_cache_generator<dbn_t, Generator> cache(dbn, generator, prefix, dbn.feature_cache);
+
+                if (cache.valid()) {
+                    return train_epochs(dbn, cache, max_epochs);
+                }
+            }
+        }
+
+        return train_epochs(dbn, generator, max_epochs);
+    }
+
+    /*!
+     * \brief Train the network for max_epochs
+     *
+     * \param dbn The network to be trained
+     * \param train_generator The generator for the training data
+     * \param val_generator The generator for the validation data
+     * \param max_epochs The maximum number of epochs
+     *
+     * \return The final error
+     */
+    template <typename TrainGenerator, typename ValGenerator>
+    error_type train(DBN& dbn, TrainGenerator& train_generator, ValGenerator& val_generator, size_t max_epochs) {
+        if constexpr (feature_cache_possible<TrainGenerator>()) {
+            if (const size_t prefix = feature_cache_prefix(dbn)) {
+                feature_cache_generator<dbn_t, TrainGenerator> cache(dbn, train_generator, prefix, dbn.feature_cache);
+
+                if (cache.valid()) {
+                    return train_epochs(dbn, cache, val_generator, max_epochs);
+                }
+            }
+        }
+
+        return train_epochs(dbn, train_generator, val_generator, max_epochs);
+    }
+
+    /*!
+     * \brief Indicates if the features of the frozen layers can be cached
+     * for the given generator of training data: its samples must not be
+     * augmented, and the trainer must be able to train from the cached
+     * features.
+     */
+    template <typename Generator>
+    static constexpr bool feature_cache_possible() {
+        if constexpr (dbn_traits<dbn_t>::inference_only() || dbn_traits<dbn_t>::stage_inputs()) {
+            return false;
+        } else {
+            return is_cacheable_generator<Generator>::value && has_feature_cache<trainer_t<dbn_t>>::value;
+        }
+    }
+
+    /*!
+     * \brief Returns the number of frozen layers whose features are cached
+     * (0 if the cache is disabled)
+     */
+    size_t feature_cache_prefix(const dbn_t& dbn) const {
+        if (!dbn.feature_cache.enabled) {
+            return 0;
+        }
+
+        const size_t prefix = std::min(dbn.frozen_prefix(), size_t(dbn_t::layers - 1));
+
+        if (!prefix) {
+            std::cerr << "WARNING: The feature cache is only used when the first layers are frozen" << std::endl;
+            return 0;
+        }
+
+        if (!trainer_t<dbn_t>::cacheable_prefix(prefix)) {
+            std::cerr << "WARNING: The features of the frozen layers cannot be cached with this network or trainer" << std::endl;
+            return 0;
+        }
+
+        return prefix;
+    }
+
+    /*!
+     * \brief Let the trainer train from the cached features if the given
+     * generator is a cache of the features of the frozen layers
+     */
+    template <typename Generator>
+    void use_feature_cache([[maybe_unused]] const Generator& generator) {
+        if constexpr (is_feature_cache<Generator>::value) {
+            trainer->set_feature_prefix(generator.prefix());
+        }
+    }
+
+    /*!
+     * \brief Call the functor without the cached features, for the
+     * generators of the inputs of the network
+     */
+    template <typename Functor>
+    decltype(auto) without_feature_cache(Functor&& functor) {
+        if constexpr (has_feature_cache<trainer_t<dbn_t>>::value) {
+            const size_t prefix = trainer->feature_prefix();
+
+            trainer->set_feature_prefix(0);
+
+            auto result = functor();
+
+            trainer->set_feature_prefix(prefix);
+
+            return result;
+        } else {
+            return functor();
+        }
+    }
+
+    /*!
+     * \brief Train the network for max_epochs on the given generator
+     *
+     * \param dbn The network to be trained
+     * \param generator The generator for the training data
+     * \param max_epochs The maximum number of epochs
+     *
+     * \return The final error
+     */
+    template <typename Generator>
+    error_type train_epochs(DBN& dbn, Generator& generator, size_t max_epochs) {
         dll::auto_timer timer("net:trainer:train");
 
         // Initialization steps
-        start_training(dbn, max_epochs);
+        start_training(dbn, max_epochs, memory_bytes(generator));
+
+        use_feature_cache(generator);
 
         //Train the model for max_epochs epoch
 
-        size_t epoch = 0;
+        size_t epoch = first_epoch;
         for (; epoch < max_epochs; ++epoch) {
             dll::auto_timer timer("net:trainer:train:epoch");
 
@@ -513,7 +1309,7 @@ struct dbn_trainer {
     }
 
     /*!
-     * \brief Train the network for max_epochs
+     * \brief Train the network for max_epochs on the given generators
      *
      * \param dbn The network to be trained
      * \param train_generator The generator for the training data
@@ -523,18 +1319,26 @@ struct dbn_trainer {
      * \return The final error
      */
     template <typename TrainGenerator, typename ValGenerator>
-    error_type train(DBN& dbn, TrainGenerator& train_generator, ValGenerator& val_generator, size_t max_epochs) {
+    error_type train_epochs(DBN& dbn, TrainGenerator& train_generator, ValGenerator& val_generator, size_t max_epochs) {
         dll::auto_timer timer("net:trainer:train");
 
         // The validation generator is always in test mode
         val_generator.set_test();
 
         // Initialization steps
-        start_training(dbn, max_epochs);
+        start_training(dbn, max_epochs, memory_bytes(train_generator, val_generator));
+
+        use_feature_cache(train_generator);
+
+        if constexpr (dbn_traits<dbn_t>::async_validation()) {
+            if (prepare_snapshot(dbn)) {
+                return train_async(dbn, train_generator, val_generator, max_epochs);
+            }
+        }
 
         //Train the model for max_epochs epoch
 
-        size_t epoch = 0;
+        size_t epoch = first_epoch;
         for (; epoch < max_epochs; ++epoch) {
             dll::auto_timer timer("net:trainer:train:epoch");
 
@@ -558,6 +1362,235 @@ struct dbn_trainer {
 
         return stop_training(dbn, epoch, max_epochs);
     }
+
+    /*!
+     * \brief Train the network for max_epochs, each epoch being validated
+     * on a snapshot of the network while the next epoch is trained.
+     *
+     * The decisions of the early stopping are taken one epoch late: the
+     * training may go one epoch further than the synchronous training, the
+     * weights of the validated epoch are then restored.
+     *
+     * \param dbn The network to be trained
+     * \param train_generator The generator for the training data
+     * \param val_generator The generator for the validation data
+     * \param max_epochs The maximum number of epochs
+     *
+     * \return The final error
+     */
+    template <typename TrainGenerator, typename ValGenerator>
+    error_type train_async(DBN& dbn, TrainGenerator& train_generator, ValGenerator& val_generator, size_t max_epochs) {
+        std::future<std::pair<double, double>> validation;
+        std::pair<double, double> train_stats;
+
+        auto validate = [this, &val_generator]() {
+            auto [error, loss] = snapshot->evaluate_metrics(val_generator);
+
+            return std::make_pair(error, loss);
+        };
+
+        auto finish_validation = [this, &validation]() {
+            auto val_stats = validation.get();
+
+            if constexpr (is_distributed_trainer<trainer_t<dbn_t>>::value) {
+                val_stats = trainer->average_metrics(val_stats);
+            }
+
+            return val_stats;
+        };
+
+        bool stop = false;
+
+        size_t epoch = first_epoch;
+        for (; epoch < max_epochs; ++epoch) {
+            dll::auto_timer timer("net:trainer:train:epoch");
+
+            // Shuffle before the epoch if necessary
+            if(dbn_traits<dbn_t>::shuffle()){
+                train_generator.reset_shuffle();
+            } else {
+                train_generator.reset();
+            }
+
+            start_epoch(dbn, epoch);
+
+            train_epoch_only(dbn, train_generator, epoch);
+
+            // The previous epoch has been validated during this epoch
+
+            if (epoch > first_epoch && stop_epoch(dbn, epoch - 1, train_stats, finish_validation())) {
+                stop = true;
+                break;
+            }
+
+            train_stats = compute_train_error_loss(dbn, train_generator);
+
+            copy_weights(dbn, *snapshot);
+
+            validation = std::async(std::launch::async, validate);
+        }
+
+        if (stop) {
+            // The network has been trained one epoch further than the decision
+            copy_weights(*snapshot, dbn);
+        } else if (epoch > first_epoch) {
+            stop_epoch(dbn, epoch - 1, train_stats, finish_validation());
+        }
+
+        // Finalization
+
+        auto error = stop_training(dbn, epoch, max_epochs);
+
+        snapshot.reset();
+
+        return error;
+    }
+
+    /*!
+     * \brief Train the network (the student) for max_epochs on the soft
+     * targets of a teacher network (knowledge distillation)
+     *
+     * The labels of the generator are replaced by the outputs of the
+     * teacher, softened and mixed with the labels following the options.
+     * The teacher forwards the next batch in the background while the
+     * current batch is trained. The errors are still computed against the
+     * labels of the generator.
+     *
+     * \param dbn The network to be trained
+     * \param teacher The teacher network
+     * \param generator The generator for the training data
+     * \param max_epochs The maximum number of epochs
+     * \param options The options of the distillation
+     *
+     * \return The final error
+     */
+    template <typename Teacher, typename Generator>
+    error_type train_distill(DBN& dbn, const Teacher& teacher, Generator& generator, size_t max_epochs, const distill_options& options) {
+        auto distill_generator = make_distill_generator(teacher, generator, options);
+
+        return train(dbn, distill_generator, max_epochs);
+    }
+
+    /*!
+     * \brief Fine-tune the network on the batches of an unbounded stream
+     *
+     * The whole stream is trained as a single epoch. Each batch of the
+     * stream is trained once and offered to the replay buffer, followed by
+     * replay_batches batches drawn from the replay buffer. Every
+     * eval_batches batches, a snapshot of the network is evaluated on the
+     * validation set in the background, while the training goes on. An
+     * evaluation is skipped if the previous one is still running. The
+     * network is checkpointed every checkpoint_batches batches
+     * (enable_checkpoints), in the background as well.
+     *
+     * \param dbn The network to be trained
+     * \param stream The stream of the training data
+     * \param val_generator The generator of the validation data (nullptr to disable)
+     * \param options The options of the streaming fine-tuning
+     *
+     * \return The running error on the batches of the stream
+     */
+    template <typename Stream, typename ValGenerator = void>
+    error_type train_stream(DBN& dbn, Stream& stream, ValGenerator* val_generator, const stream_options& options) {
+        static_assert(is_stream_generator<Stream>, "train_stream needs a stream generator");
+
+        dll::auto_timer timer("net:trainer:stream");
+
+        start_training(dbn, 1);
+
+        replay_buffer<Stream> replay(options.replay_size);
+
+        std::future<std::pair<double, double>> validation;
+
+        bool evaluate = false;
+
+        if constexpr (!std::is_void<ValGenerator>::value) {
+            evaluate = val_generator && options.eval_batches && prepare_snapshot(dbn);
+        } else {
+            cpp_unused(val_generator);
+        }
+
+        auto report = [this, &dbn](size_t batches, const std::pair<double, double>& val_stats) {
+            current_val_error = val_stats.first;
+            current_val_loss  = val_stats.second;
+
+            if (main_rank()) {
+                dbn.out << "stream batch " << batches << " - val_error: " << val_stats.first << " val_loss: " << val_stats.second << std::endl;
+            }
+        };
+
+        epoch_error   = 0.0;
+        epoch_loss    = 0.0;
+        epoch_samples = 0;
+
+        size_t batches = 0;
+
+        while ((!options.max_batches || batches < options.max_batches) && stream.has_next_batch()) {
+            dll::auto_timer timer("net:trainer:stream:batch");
+
+            auto [batch_error, batch_loss] = trainer->train_batch(0, stream.data_batch(), stream.label_batch());
+
+            const size_t n = etl::dim<0>(stream.data_batch());
+
+            epoch_error += batch_error * n;
+            epoch_loss += batch_loss * n;
+            epoch_samples += n;
+
+            if (options.replay_size) {
+                replay.add(stream.data_batch(), stream.label_batch());
+
+                for (size_t r = 0; r < options.replay_batches && replay.draw(); ++r) {
+                    trainer->train_batch(0, replay.data_batch(), replay.label_batch());
+                }
+            }
+
+            stream.next_batch();
+
+            ++batches;
+
+            if constexpr (!std::is_void<ValGenerator>::value) {
+                if (evaluate && batches % options.eval_batches == 0) {
+                    if (validation.valid() && validation.wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+                        report(batches, validation.get());
+                    }
+
+                    if (!validation.valid()) {
+                        copy_weights(dbn, *snapshot);
+
+                        validation = std::async(std::launch::async, [this, val_generator]() {
+                            auto [error, loss] = snapshot->evaluate_metrics(*val_generator);
+
+                            return std::make_pair(error, loss);
+                        });
+                    }
+                }
+            }
+
+            if (dbn.checkpoints && dbn.checkpoint_batches && main_rank() && batches % dbn.checkpoint_batches == 0) {
+                dbn.checkpoint();
+
+                if constexpr (has_trainer_state<trainer_t<dbn_t>>::value) {
+                    dbn.checkpoint_state(store_training_state(dbn, 0, batches, std::string()));
+                }
+            }
+        }
+
+        // Wait for the trainer to finish the stream
+        trainer->finish_epoch();
+
+        if (validation.valid()) {
+            report(batches, validation.get());
+        }
+
+        current_error = epoch_error / std::max(epoch_samples, size_t(1));
+        current_loss  = epoch_loss / std::max(epoch_samples, size_t(1));
+
+        auto error = stop_training(dbn, 0, 1);
+
+        snapshot.reset();
+
+        return error;
+    }
 };
 
 } //end of dll namespace
@@ -0,0 +1,403 @@
+//=======================================================================
+// Copyright (c) 2014-2017 Baptiste Wicht
+// Distributed under the terms of the MIT License.
+// (See accompanying file LICENSE or copy at
+//  http://opensource.org/licenses/MIT)
+//=======================================================================
+
+/*!
+ * \file distributed_sgd_trainer.hpp
+ * \brief Data-parallel Stochastic Gradient Descent over several processes
+ *
+ * Each process (rank) trains the same network on its own shard of the
+ * data. The gradients of each batch are summed over all the ranks, so
+ * that all the ranks apply the same updates and keep the same weights.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <future>
+#include <vector>
+
+#include "dll/trainer/stochastic_gradient_descent.hpp"
+#include "dll/trainer/grad_compression.hpp"
+#include "dll/trainer/transport.hpp"
+
+namespace dll {
+
+/*!
+ * \brief Distributed data-parallel gradient descent trainer.
+ *
+ * The ranks are connected by the transport set with dll::transport<T> in
+ * the descriptor of the network (local_transport by default, for a single
+ * process). The parameters of the rank 0 are broadcast to all the ranks
+ * when the training starts.
+ *
+ * The gradients of a layer are packed into one buffer (bucket) as soon as
+ * they are computed, and the bucket is summed over the ranks while the
+ * errors are backpropagated to the lower layers. The updates are then
+ * applied with the total number of samples of the batch.
+ *
+ * Each rank must use a generator over its own shard of the data (see
+ * shard_range) and all the ranks must train the same number of batches.
+ *
+ * The gradients of each layer can be compressed before they are exchanged
+ * (dbn.gradient_compression, see grad_compression.hpp). All the ranks must
+ * use the same compression. The compression is also applied with a single
+ * rank, so that its effect on the accuracy can be measured.
+ */
+template <typename DBN>
+struct distributed_sgd_trainer : sgd_trainer<DBN> {
+    using dbn_t       = DBN;                         ///< The type of DBN being trained
+    using base_type   = sgd_trainer<dbn_t>;          ///< The synchronous trainer
+    using weight      = typename dbn_t::weight;      ///< The data type of the weights
+    using transport_t = typename dbn_t::transport_t; ///< The type of the transport
+
+    static constexpr auto layers = dbn_t::layers; ///< The number of layers
+
+    static_assert(dbn_traits<dbn_t>::micro_batches() == 1, "distributed_sgd_trainer does not support data_parallel");
+    static_assert(dbn_traits<dbn_t>::accumulated_batches() == 1, "distributed_sgd_trainer does not support grad_accumulate");
+    static_assert(!dbn_traits<dbn_t>::has_loss_scaling(), "distributed_sgd_trainer does not support loss_scaling");
+    static_assert(dbn_traits<dbn_t>::checkpoint_every() < 2, "distributed_sgd_trainer does not support checkpoint");
+    static_assert(!dbn_traits<dbn_t>::stage_inputs(), "distributed_sgd_trainer does not support stage_inputs");
+
+    transport_t transport; ///< The transport between the ranks
+
+    std::vector<std::vector<weight>> buckets;        ///< The packed gradients of each layer
+    std::vector<grad_compressor<weight>> compressors; ///< The compression state of the gradients of each layer
+    std::vector<bool> reduced;                       ///< Indicates if the gradients of each layer have been reduced
+    std::future<void> pending;                       ///< The last pending reduction
+
+    /*!
+     * \brief construct a new distributed_sgd_trainer
+     * \param dbn The DBN being trained
+     */
+    explicit distributed_sgd_trainer(dbn_t& dbn) : base_type(dbn), buckets(layers), compressors(layers), reduced(layers) {
+        // All the ranks start from the parameters of the rank 0
+
+        cpp::for_each(this->full_context, [this](auto& layer_ctx) {
+            this_type::for_each_parameter(layer_ctx.first, [this](auto& w) {
+                w.ensure_cpu_up_to_date();
+
+                transport.broadcast(w.memory_start(), etl::size(w));
+
+                w.invalidate_gpu();
+            });
+        });
+    }
+
+    distributed_sgd_trainer(const distributed_sgd_trainer& rhs) = delete;
+    distributed_sgd_trainer& operator=(const distributed_sgd_trainer& rhs) = delete;
+
+    /*!
+     * \brief Wait for the pending reductions
+     */
+    ~distributed_sgd_trainer() {
+        if (pending.valid()) {
+            pending.wait();
+        }
+    }
+
+    /*!
+     * \brief Returns the rank of the process
+     */
+    size_t rank() const {
+        return transport.rank();
+    }
+
+    /*!
+     * \brief Train a batch of data and apply the gradients summed over all
+     * the ranks
+     * \param epoch The current epoch
+     * \param inputs A batch of inputs
+     * \param labels A batch of labels
+     * \return a pair containing the error and the loss for the batch of
+     * this rank
+     */
+    template <typename Inputs, typename Labels>
+    std::pair<double, double> train_batch(size_t epoch, const Inputs& inputs, const Labels& labels) {
+        dll::auto_timer timer("distributed_sgd::train_batch");
+
+        auto& first_ctx = *std::get<0>(this->full_context).second;
+        auto& last_ctx  = *std::get<layers - 1>(this->full_context).second;
+
+        const auto n          = etl::dim<0>(inputs);
+        const bool full_batch = n == etl::dim<0>(first_ctx.input);
+
+        // Ensure that the data batch and the label batch are of the same size
+        cpp_assert(n == etl::dim<0>(labels), "Invalid sizes");
+
+        // Ensure that the context can hold the inputs
+        cpp_assert(n <= etl::dim<0>(first_ctx.input), "Invalid sizes");
+
+        {
+            dll::auto_timer timer("sgd::forward");
+
+            this->template forward_batch_helper<true>(inputs);
+        }
+
+        // The metrics computed together with the errors (fused kernels)
+        std::pair<double, double> metrics;
+
+        {
+            dll::auto_timer timer("sgd::backward");
+
+            this->compute_last_errors(full_batch, n, labels, metrics);
+
+            backward_reduce_batch();
+        }
+
+        {
+            dll::auto_timer timer("sgd::grad");
+
+            const size_t total = reduce_gradients(n);
+
+            cpp::for_each(this->full_context, [this, epoch, total](auto& layer_ctx) {
+                this->update_weights_layer(epoch, total, layer_ctx.first, *layer_ctx.second);
+            });
+
+            // Update the counter of iterations
+            ++this->iteration;
+        }
+
+        if constexpr (base_type::fused_metrics()) {
+            cpp_unused(last_ctx);
+
+            return std::make_pair(metrics.first / n, metrics.second / n);
+        } else {
+            dll::auto_timer timer("sgd::error");
+
+            auto[error, loss] = this->dbn.evaluate_metrics_batch(last_ctx.output, labels, n, true);
+
+            return std::make_pair(error, loss);
+        }
+    }
+
+    /*!
+     * \brief Average the error and the loss of an epoch over all the ranks,
+     * so that all the ranks take the same early stopping decisions
+     * \param metrics The error and the loss of this rank
+     * \return the error and the loss averaged over the ranks
+     */
+    std::pair<double, double> average_metrics(const std::pair<double, double>& metrics) {
+        double values[2] = {metrics.first, metrics.second};
+
+        transport.all_reduce(values, 2);
+
+        return std::make_pair(values[0] / transport.size(), values[1] / transport.size());
+    }
+
+    /*!
+     * \brief Return the name of the trainer
+     */
+    static std::string name() {
+        return "Distributed Stochastic Gradient Descent";
+    }
+
+private:
+    using this_type = distributed_sgd_trainer<dbn_t>; ///< The type of this trainer
+
+    /*!
+     * \brief Apply the functor to all the trainable parameters of the given
+     * layer
+     */
+    template <typename Layer, typename Functor>
+    static void for_each_parameter(Layer& layer, Functor&& functor) {
+        if constexpr (is_utility_layer<Layer>) {
+            cpp::for_each(layer.layers, [&functor](auto& sub_layer) {
+                this_type::for_each_parameter(sub_layer, functor);
+            });
+        } else if constexpr (decay_layer_traits<Layer>::is_neural_layer()) {
+            std::apply([&functor](auto&... w) { (functor(w), ...); }, layer.trainable_parameters());
+        } else {
+            cpp_unused(layer);
+            cpp_unused(functor);
+        }
+    }
+
+    /*!
+     * \brief Backpropagate the errors of the last layer and start the
+     * reduction of the gradients of each layer as soon as its errors
+     * are ready
+     */
+    void backward_reduce_batch() {
+        auto& first_layer = std::get<0>(this->full_context).first;
+        auto& first_ctx   = *std::get<0>(this->full_context).second;
+
+        bool last = true;
+        size_t b  = layers - 1;
+
+        cpp::for_each_rpair(this->full_context, [this, &last, &b](auto& layer_ctx_1, auto& layer_ctx_2) {
+            base_type::backward_layer(layer_ctx_2.first, *layer_ctx_2.second, base_type::get_errors(*layer_ctx_1.second), last);
+
+            this->reduce_layer(b--, layer_ctx_2.first, *layer_ctx_2.second);
+        });
+
+        {
+            dll::auto_timer timer(layer_timers<0>::backward());
+
+            first_layer.adapt_errors(first_ctx);
+        }
+
+        reduce_layer(0, first_layer, first_ctx);
+    }
+
+    /*!
+     * \brief Compute the gradients of the given layer, pack them into its
+     * bucket and start the reduction of the bucket.
+     *
+     * With flat_parameters, the gradients are reduced in place, without
+     * any bucket.
+     */
+    template <typename Layer, typename Context>
+    void reduce_layer(size_t b, Layer& layer, Context& context) {
+        {
+            dll::auto_timer timer(layer_timers<context_layer<Context>::value>::backward());
+
+            base_type::compute_gradients_layer(layer, context);
+        }
+
+        auto& options = this->dbn.gradient_compression[b];
+
+        if (transport.size() == 1 && options.method == grad_compression::NONE) {
+            return;
+        }
+
+        auto& tensors = compressors[b].tensors;
+
+        tensors.clear();
+
+        if constexpr (base_type::flat_parameters) {
+            // The gradients of the layer are contiguous in the flat storage
+            // of the trainer, they are reduced in place
+
+            weight* first = nullptr;
+            weight* last  = nullptr;
+
+            base_type::for_each_gradient(layer, context, [&first, &last](auto& grad) {
+                grad.ensure_cpu_up_to_date();
+
+                first = first ? std::min(first, grad.memory_start()) : grad.memory_start();
+                last  = last ? std::max(last, grad.memory_start() + etl::size(grad)) : grad.memory_start() + etl::size(grad);
+            });
+
+            if (first) {
+                base_type::for_each_gradient(layer, context, [first, &tensors](auto& grad) {
+                    const size_t o = grad.memory_start() - first;
+
+                    tensors.emplace_back(o, o + etl::size(grad));
+                });
+
+                reduced[b] = true;
+
+                reduce_async(b, first, size_t(last - first));
+            }
+
+            return;
+        }
+
+        dll::auto_timer timer("distributed_sgd::pack");
+
+        auto& bucket = buckets[b];
+
+        size_t s = 0;
+
+        base_type::for_each_gradient(layer, context, [&s](auto& grad) {
+            s += etl::size(grad);
+        });
+
+        if (!s) {
+            return;
+        }
+
+        bucket.resize(s);
+
+        size_t o = 0;
+
+        base_type::for_each_gradient(layer, context, [&bucket, &o, &tensors](auto& grad) {
+            grad.ensure_cpu_up_to_date();
+
+            std::copy(grad.memory_start(), grad.memory_start() + etl::size(grad), bucket.data() + o);
+
+            tensors.emplace_back(o, o + etl::size(grad));
+
+            o += etl::size(grad);
+        });
+
+        reduced[b] = true;
+
+        reduce_async(b, bucket.data(), bucket.size());
+    }
+
+    /*!
+     * \brief Start the reduction of the given buffer of the layer b, after
+     * the pending reductions.
+     *
+     * The reductions are chained so that all the ranks reduce the buffers
+     * in the same order.
+     */
+    void reduce_async(size_t b, weight* data, size_t n) {
+        pending = std::async(std::launch::async, [this, b, data, n, previous = std::move(pending)]() mutable {
+            if (previous.valid()) {
+                previous.get();
+            }
+
+            auto& options = this->dbn.gradient_compression[b];
+
+            if (options.method == grad_compression::NONE) {
+                transport.all_reduce(data, n);
+            } else {
+                compressors[b].all_reduce(transport, options, data, n);
+            }
+        });
+    }
+
+    /*!
+     * \brief Wait for the reductions and unpack the summed gradients of
+     * all the layers
+     * \param n The number of samples of the batch of this rank
+     * \return The number of samples of the batch of all the ranks
+     */
+    size_t reduce_gradients(size_t n) {
+        if (transport.size() == 1 && std::find(reduced.begin(), reduced.end(), true) == reduced.end()) {
+            return n;
+        }
+
+        dll::auto_timer timer("distributed_sgd::reduce");
+
+        if (pending.valid()) {
+            pending.get();
+        }
+
+        cpp::for_each_i(this->full_context, [this](size_t b, auto& layer_ctx) {
+            if (!reduced[b]) {
+                return;
+            }
+
+            reduced[b] = false;
+
+            auto& bucket = buckets[b];
+
+            size_t o = 0;
+
+            base_type::for_each_gradient(layer_ctx.first, *layer_ctx.second, [&bucket, &o](auto& grad) {
+                if constexpr (!base_type::flat_parameters) {
+                    std::copy(bucket.data() + o, bucket.data() + o + etl::size(grad), grad.memory_start());
+
+                    o += etl::size(grad);
+                }
+
+                grad.invalidate_gpu();
+            });
+        });
+
+        double total = n;
+
+        transport.all_reduce(&total, 1);
+
+        return size_t(total);
+    }
+};
+
+} //end of dll namespace
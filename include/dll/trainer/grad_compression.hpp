@@ -0,0 +1,250 @@
+//=======================================================================
+// Copyright (c) 2014-2017 Baptiste Wicht
+// Distributed under the terms of the MIT License.
+// (See accompanying file LICENSE or copy at
+//  http://opensource.org/licenses/MIT)
+//=======================================================================
+
+/*!
+ * \file
+ * \brief Compression of the gradients exchanged by the distributed SGD
+ * trainer.
+ *
+ * Instead of summing the gradients of a layer with all_reduce, each rank
+ * compresses them, the compressed gradients of all the ranks are gathered
+ * (all_gather) and each rank sums them. Two compressions are supported:
+ *   TOP_K  Only the largest gradients, in magnitude, are sent as (index,
+ *          value) pairs. The gradients that are not sent are kept in a
+ *          residual added to the gradients of the next batch (error
+ *          feedback): the updates are delayed, not lost.
+ *   INT8   The gradients are quantized to int8, with one scale per tensor.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <numeric>
+#include <utility>
+#include <vector>
+
+#include "cpp_utils/assert.hpp"
+
+#include "dll/util/timers.hpp" // For auto_timer
+
+namespace dll {
+
+/*!
+ * \brief The compression of the gradients of a layer exchanged by the
+ * distributed trainer
+ */
+enum class grad_compression : uint32_t {
+    NONE  = 0, ///< The gradients are summed in full precision (all_reduce)
+    TOP_K = 1, ///< Only the largest gradients are sent, the others are kept for the next batches
+    INT8  = 2  ///< The gradients are quantized to int8, with one scale per tensor
+};
+
+/*!
+ * \brief The options of the compression of the gradients of a layer
+ */
+struct grad_compression_options {
+    grad_compression method = grad_compression::NONE; ///< The compression of the gradients
+    double ratio            = 0.01;                   ///< The fraction of the gradients sent by TOP_K
+};
+
+/*!
+ * \brief A gradient sent by TOP_K
+ */
+template <typename T>
+struct top_k_entry {
+    uint32_t index; ///< The index of the gradient in the layer
+    T value;        ///< The value of the gradient
+};
+
+/*!
+ * \brief Returns the number of gradients sent by TOP_K out of the n
+ * gradients of a layer
+ */
+inline size_t top_k_count(const grad_compression_options& options, size_t n) {
+    return std::min(n, std::max(size_t(1), size_t(options.ratio * n)));
+}
+
+/*!
+ * \brief Returns the number of bytes sent by each rank for the gradients
+ * of a layer
+ *
+ * \param options The compression of the layer
+ * \param n The number of gradients of the layer
+ * \param tensors The number of tensors of the layer
+ */
+template <typename T>
+size_t compressed_bytes(const grad_compression_options& options, size_t n, size_t tensors) {
+    switch (options.method) {
+        case grad_compression::TOP_K:
+            return top_k_count(options, n) * sizeof(top_k_entry<T>);
+        case grad_compression::INT8:
+            return tensors * sizeof(T) + n;
+        default:
+            return n * sizeof(T);
+    }
+}
+
+/*!
+ * \brief The compression state of the gradients of a layer
+ */
+template <typename T>
+struct grad_compressor {
+    std::vector<std::pair<size_t, size_t>> tensors; ///< The range [first, last) of each tensor in the gradients
+
+    /*!
+     * \brief Sum the gradients of the layer over all the ranks, with the
+     * given compression
+     *
+     * \param transport The transport between the ranks
+     * \param options The compression of the layer
+     * \param grad The gradients, replaced by their sum
+     * \param n The number of gradients
+     */
+    template <typename Transport>
+    void all_reduce(Transport& transport, const grad_compression_options& options, T* grad, size_t n) {
+        {
+            dll::auto_timer timer("distributed_sgd::compress");
+
+            if (options.method == grad_compression::TOP_K) {
+                compress_top_k(options, grad, n);
+            } else {
+                compress_int8(grad);
+            }
+        }
+
+        gathered.resize(payload.size() * transport.size());
+
+        transport.all_gather(payload.data(), payload.size(), gathered.data());
+
+        dll::auto_timer timer("distributed_sgd::decompress");
+
+        std::fill_n(grad, n, T(0));
+
+        for (size_t r = 0; r < transport.size(); ++r) {
+            const char* block = gathered.data() + r * payload.size();
+
+            if (options.method == grad_compression::TOP_K) {
+                sum_top_k(block, payload.size() / sizeof(top_k_entry<T>), grad);
+            } else {
+                sum_int8(block, grad);
+            }
+        }
+    }
+
+private:
+    /*!
+     * \brief Compress the largest gradients, accumulated with the
+     * residual of the previous batches
+     */
+    void compress_top_k(const grad_compression_options& options, const T* grad, size_t n) {
+        cpp_assert(n <= std::numeric_limits<uint32_t>::max(), "Too many gradients for TOP_K");
+
+        if (residual.size() != n) {
+            residual.assign(n, T(0));
+        }
+
+        for (size_t i = 0; i < n; ++i) {
+            residual[i] += grad[i];
+        }
+
+        const size_t k = top_k_count(options, n);
+
+        order.resize(n);
+        std::iota(order.begin(), order.end(), uint32_t(0));
+
+        std::nth_element(order.begin(), order.begin() + (k - 1), order.end(), [this](uint32_t a, uint32_t b) {
+            return std::abs(residual[a]) > std::abs(residual[b]);
+        });
+
+        payload.resize(k * sizeof(top_k_entry<T>));
+
+        for (size_t j = 0; j < k; ++j) {
+            const top_k_entry<T> entry{order[j], residual[order[j]]};
+
+            std::memcpy(payload.data() + j * sizeof(entry), &entry, sizeof(entry));
+
+            // The sent gradients are not fed back
+            residual[order[j]] = T(0);
+        }
+    }
+
+    /*!
+     * \brief Quantize the gradients to int8, with one scale per tensor
+     */
+    void compress_int8(const T* grad) {
+        size_t values = 0;
+
+        for (auto& tensor : tensors) {
+            values += tensor.second - tensor.first;
+        }
+
+        payload.resize(tensors.size() * sizeof(T) + values);
+
+        char* scales    = payload.data();
+        int8_t* quantas = reinterpret_cast<int8_t*>(payload.data() + tensors.size() * sizeof(T));
+
+        for (size_t t = 0; t < tensors.size(); ++t) {
+            auto [first, last] = tensors[t];
+
+            T max = 0;
+
+            for (size_t i = first; i < last; ++i) {
+                max = std::max(max, T(std::abs(grad[i])));
+            }
+
+            const T scale = max / T(127);
+
+            std::memcpy(scales + t * sizeof(T), &scale, sizeof(T));
+
+            for (size_t i = first; i < last; ++i) {
+                *quantas++ = scale > T(0) ? int8_t(std::lround(grad[i] / scale)) : int8_t(0);
+            }
+        }
+    }
+
+    /*!
+     * \brief Add the gradients sent by TOP_K by one rank
+     */
+    static void sum_top_k(const char* block, size_t k, T* grad) {
+        for (size_t j = 0; j < k; ++j) {
+            top_k_entry<T> entry;
+
+            std::memcpy(&entry, block + j * sizeof(entry), sizeof(entry));
+
+            grad[entry.index] += entry.value;
+        }
+    }
+
+    /*!
+     * \brief Add the gradients quantized to int8 by one rank
+     */
+    void sum_int8(const char* block, T* grad) const {
+        const int8_t* quantas = reinterpret_cast<const int8_t*>(block + tensors.size() * sizeof(T));
+
+        for (size_t t = 0; t < tensors.size(); ++t) {
+            auto [first, last] = tensors[t];
+
+            T scale;
+            std::memcpy(&scale, block + t * sizeof(T), sizeof(T));
+
+            for (size_t i = first; i < last; ++i) {
+                grad[i] += scale * T(*quantas++);
+            }
+        }
+    }
+
+    std::vector<T> residual;     ///< The gradients not sent yet (TOP_K)
+    std::vector<uint32_t> order; ///< The indices of the gradients, by decreasing magnitude (TOP_K)
+    std::vector<char> payload;   ///< The compressed gradients of this rank
+    std::vector<char> gathered;  ///< The compressed gradients of all the ranks
+};
+
+} //end of dll namespace
@@ -0,0 +1,119 @@
+//=======================================================================
+// Copyright (c) 2014-2017 Baptiste Wicht
+// Distributed under the terms of the MIT License.
+// (See accompanying file LICENSE or copy at
+//  http://opensource.org/licenses/MIT)
+//=======================================================================
+
+/*!
+ * \file
+ * \brief Learning rate schedules for the SGD trainer.
+ *
+ * A schedule computes the learning rate of each batch from the base
+ * learning rate of the network, the current epoch and the current
+ * iteration (the number of updates of the weights, starting at 1). The
+ * parameters of the schedules are fields of the network (lr_step_epochs,
+ * lr_gamma, lr_min and lr_warmup_iterations).
+ */
+
+#pragma once
+
+#include <cmath>
+
+namespace dll {
+
+/*!
+ * \brief Constant learning rate (this is the default)
+ */
+struct constant_lr {
+    /*!
+     * \brief Returns the learning rate for the current batch
+     * \param dbn The network being trained
+     * \param epoch The current epoch
+     * \param iteration The current iteration
+     * \param max_epochs The number of epochs of the training
+     */
+    template <typename DBN>
+    static double rate(const DBN& dbn, size_t epoch, size_t iteration, size_t max_epochs) {
+        cpp_unused(epoch);
+        cpp_unused(iteration);
+        cpp_unused(max_epochs);
+
+        return dbn.learning_rate;
+    }
+};
+
+/*!
+ * \brief Step schedule, the learning rate is multiplied by lr_gamma every
+ * lr_step_epochs epochs
+ */
+struct step_lr {
+    /*!
+     * \brief Returns the learning rate for the current batch
+     * \param dbn The network being trained
+     * \param epoch The current epoch
+     * \param iteration The current iteration
+     * \param max_epochs The number of epochs of the training
+     */
+    template <typename DBN>
+    static double rate(const DBN& dbn, size_t epoch, size_t iteration, size_t max_epochs) {
+        cpp_unused(iteration);
+        cpp_unused(max_epochs);
+
+        return dbn.learning_rate * std::pow(dbn.lr_gamma, double(epoch / std::max(size_t(1), dbn.lr_step_epochs)));
+    }
+};
+
+/*!
+ * \brief Cosine annealing of the learning rate from learning_rate to
+ * lr_min over the epochs of the training
+ */
+struct cosine_lr {
+    /*!
+     * \brief Returns the learning rate for the current batch
+     * \param dbn The network being trained
+     * \param epoch The current epoch
+     * \param iteration The current iteration
+     * \param max_epochs The number of epochs of the training
+     */
+    template <typename DBN>
+    static double rate(const DBN& dbn, size_t epoch, size_t iteration, size_t max_epochs) {
+        cpp_unused(iteration);
+
+        if (!max_epochs) {
+            return dbn.learning_rate;
+        }
+
+        const double progress = double(epoch) / double(max_epochs);
+
+        return dbn.lr_min + 0.5 * (dbn.learning_rate - dbn.lr_min) * (1.0 + std::cos(M_PI * progress));
+    }
+};
+
+/*!
+ * \brief Linear warmup of the learning rate during the first
+ * lr_warmup_iterations iterations, followed by the given schedule
+ * \tparam Schedule The schedule to use after the warmup
+ */
+template <typename Schedule = constant_lr>
+struct warmup_lr {
+    /*!
+     * \brief Returns the learning rate for the current batch
+     * \param dbn The network being trained
+     * \param epoch The current epoch
+     * \param iteration The current iteration
+     * \param max_epochs The number of epochs of the training
+     */
+    template <typename DBN>
+    static double rate(const DBN& dbn, size_t epoch, size_t iteration, size_t max_epochs) {
+        const double base = Schedule::rate(dbn, epoch, iteration, max_epochs);
+
+        if (iteration < dbn.lr_warmup_iterations) {
+            return base * double(iteration) / double(dbn.lr_warmup_iterations);
+        }
+
+        return base;
+    }
+};
+
+} //end of dll namespace
@@ -0,0 +1,547 @@
+//=======================================================================
+// Copyright (c) 2014-2017 Baptiste Wicht
+// Distributed under the terms of the MIT License.
+// (See accompanying file LICENSE or copy at
+//  http://opensource.org/licenses/MIT)
+//=======================================================================
+
+/*!
+ * \file param_server_trainer.hpp
+ * \brief Parameter server Stochastic Gradient Descent
+ *
+ * Several workers train batches of the same network at the same time and
+ * push their gradients to a server, which applies them to the weights of
+ * the network with the updater of the network. Only the server holds the
+ * state of the updater. The gradients of the embeddings are pushed as the
+ * rows of the words of the batch only.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <vector>
+
+#include "dll/trainer/stochastic_gradient_descent.hpp"
+
+namespace dll {
+
+/*!
+ * \brief Parameter server gradient descent trainer.
+ *
+ * The batches are handed by the training loop to the first idle worker
+ * and train_batch returns without waiting for the batch to be trained.
+ * The workers read the current weights of the network (only the rows of
+ * the words of their batch for the embeddings) and compute the gradients
+ * of their batch, in a context without any state of updater. The
+ * gradients are then pushed to the server thread and the worker moves on
+ * to its next batch while the server applies them asynchronously. Each
+ * worker has at most one push waiting to be applied.
+ *
+ * The workers and the server are synchronized at the end of each epoch
+ * and before each evaluation of the network.
+ *
+ * The number of workers is set with dll::workers<N> in the descriptor of
+ * the network (all the hardware threads by default).
+ */
+template <typename DBN>
+struct param_server_trainer : sgd_trainer<DBN> {
+    using dbn_t     = DBN;                         ///< The type of DBN being trained
+    using base_type = sgd_trainer<dbn_t>;          ///< The synchronous trainer
+    using weight    = typename dbn_t::weight;      ///< The data type of the weights
+    using this_type = param_server_trainer<dbn_t>; ///< The type of this trainer
+
+    static constexpr auto layers     = dbn_t::layers;     ///< The number of layers
+    static constexpr auto batch_size = dbn_t::batch_size; ///< The batch size for training
+
+    static_assert(dbn_traits<dbn_t>::micro_batches() == 1, "param_server_trainer does not support data_parallel");
+    static_assert(dbn_traits<dbn_t>::accumulated_batches() == 1, "param_server_trainer does not support grad_accumulate");
+    static_assert(!dbn_traits<dbn_t>::has_loss_scaling(), "param_server_trainer does not support loss_scaling");
+    static_assert(dbn_traits<dbn_t>::checkpoint_every() < 2, "param_server_trainer does not support checkpoint");
+    static_assert(!dbn_traits<dbn_t>::stage_inputs(), "param_server_trainer does not support stage_inputs");
+
+    /*!
+     * \brief The view of the network for the workers, which only compute
+     * gradients
+     */
+    using worker_network_t = micro_batch_network<dbn_t, batch_size, updater_type::SGD>;
+
+    /*!
+     * \brief The type of the context of a worker
+     */
+    using worker_context_t = decltype(build_view_context<full_sgd_context, worker_network_t>(std::declval<dbn_t&>(), std::make_index_sequence<layers>()));
+
+    using input_t = typename base_type::input_t; ///< The type of a batch of inputs
+    using label_t = typename base_type::label_t; ///< The type of a batch of labels
+
+    /*!
+     * \brief The gradients pushed by a worker to the server
+     */
+    struct push_state {
+        std::vector<std::vector<size_t>> rows;   ///< The rows of each sparse variable (empty for dense variables)
+        std::vector<std::vector<weight>> values; ///< The gradients of each variable (only the rows for sparse variables)
+
+        size_t n     = 0;     ///< The size of the batch of the gradients
+        size_t epoch = 0;     ///< The epoch of the batch of the gradients
+        bool pending = false; ///< Indicates if the push is waiting to be applied
+    };
+
+    /*!
+     * \brief The state of a worker
+     */
+    struct worker_state {
+        worker_context_t context; ///< The context of the worker
+        input_t inputs;           ///< The inputs of the current batch
+        label_t labels;           ///< The labels of the current batch
+        push_state push;          ///< The last push of the worker
+
+        size_t n     = 0;     ///< The size of the current batch
+        size_t epoch = 0;     ///< The epoch of the current batch
+        bool pending = false; ///< Indicates if a batch is waiting to be trained
+
+        /*!
+         * \brief Construct the state of a worker for the given network
+         * \param dbn The network being trained
+         */
+        explicit worker_state(dbn_t& dbn) : context(build_view_context<full_sgd_context, worker_network_t>(dbn, std::make_index_sequence<layers>())) {
+            base_type::inherit_dimensions(context);
+
+            inputs = std::get<0>(context).second->input;
+            labels = std::get<layers - 1>(context).second->output;
+        }
+    };
+
+    std::vector<std::unique_ptr<worker_state>> workers; ///< The state of the workers
+    std::vector<std::thread> threads;                   ///< The threads of the workers
+    std::thread server;                                 ///< The thread of the server
+
+    std::deque<worker_state*> pushes; ///< The workers whose push is waiting to be applied, in order
+
+    bool stop_flag = false; ///< Indicates that the workers and the server must stop
+
+    double last_error = 1.0;  ///< The error of the last trained batch
+    double last_loss  = -1.0; ///< The loss of the last trained batch
+
+    mutable std::mutex main_lock;              ///< The main lock
+    mutable std::condition_variable condition; ///< The condition variable for the workers, the server and the training loop
+
+    /*!
+     * \brief construct a new param_server_trainer
+     * \param dbn The DBN being trained
+     */
+    explicit param_server_trainer(dbn_t& dbn) : base_type(dbn) {
+        size_t n = dbn_traits<dbn_t>::workers();
+
+        if (!n) {
+            n = std::max(size_t(1), size_t(std::thread::hardware_concurrency()));
+        }
+
+        for (size_t w = 0; w < n; ++w) {
+            workers.push_back(std::make_unique<worker_state>(dbn));
+        }
+
+        for (size_t w = 0; w < n; ++w) {
+            threads.emplace_back([this, w] { work(*workers[w]); });
+        }
+
+        server = std::thread([this] { serve(); });
+    }
+
+    param_server_trainer(const param_server_trainer& rhs) = delete;
+    param_server_trainer& operator=(const param_server_trainer& rhs) = delete;
+
+    /*!
+     * \brief Wait for the pending batches and pushes and stop the workers
+     * and the server
+     */
+    ~param_server_trainer() {
+        wait_workers();
+
+        cpp::with_lock(main_lock, [this] { stop_flag = true; });
+
+        condition.notify_all();
+
+        for (auto& thread : threads) {
+            thread.join();
+        }
+
+        server.join();
+    }
+
+    /*!
+     * \brief Give a batch of data to the first idle worker
+     * \param epoch The current epoch
+     * \param inputs A batch of inputs
+     * \param labels A batch of labels
+     * \return a pair containing the error and the loss of the last batch
+     * trained by the workers
+     */
+    template <typename Inputs, typename Labels>
+    std::pair<double, double> train_batch(size_t epoch, const Inputs& inputs, const Labels& labels) {
+        dll::auto_timer timer("param_server::train_batch");
+
+        const size_t n = etl::dim<0>(inputs);
+
+        // Ensure that the data batch and the label batch are of the same size
+        cpp_assert(n == etl::dim<0>(labels), "Invalid sizes");
+
+        // Ensure that the context can hold the inputs
+        cpp_assert(n <= batch_size, "Invalid sizes");
+
+        worker_state* worker = nullptr;
+
+        {
+            std::unique_lock<std::mutex> ulock(main_lock);
+
+            condition.wait(ulock, [this, &worker] { return (worker = idle_worker()); });
+        }
+
+        // The worker is idle, it does not touch its batch until it is pending
+
+        etl::slice(worker->inputs, 0, n) = inputs;
+        etl::slice(worker->labels, 0, n) = labels;
+
+        worker->n     = n;
+        worker->epoch = epoch;
+
+        double error;
+        double loss;
+
+        {
+            std::unique_lock<std::mutex> ulock(main_lock);
+
+            worker->pending = true;
+
+            error = last_error;
+            loss  = last_loss;
+        }
+
+        condition.notify_all();
+
+        return std::make_pair(error, loss);
+    }
+
+    /*!
+     * \brief Wait for all the pending batches to be trained and applied
+     */
+    void finish_epoch() {
+        wait_workers();
+    }
+
+    /*!
+     * \brief Forward a batch of inputs once all the pending batches have
+     * been trained and applied
+     */
+    template <bool Train, typename Inputs>
+    auto& forward_batch_helper(dbn_t& dbn, Inputs&& inputs) {
+        wait_workers();
+
+        return base_type::template forward_batch_helper<Train>(dbn, inputs);
+    }
+
+    /*!
+     * \brief Return the name of the trainer
+     */
+    static std::string name() {
+        return "Parameter Server Stochastic Gradient Descent";
+    }
+
+private:
+    /*!
+     * \brief Returns the first idle worker, or nullptr if all workers are
+     * busy. The lock must be held.
+     */
+    worker_state* idle_worker() {
+        for (auto& worker : workers) {
+            if (!worker->pending) {
+                return worker.get();
+            }
+        }
+
+        return nullptr;
+    }
+
+    /*!
+     * \brief Wait for all the workers to be idle and for all the pushes to
+     * be applied
+     */
+    void wait_workers() {
+        std::unique_lock<std::mutex> ulock(main_lock);
+
+        condition.wait(ulock, [this] {
+            for (auto& worker : workers) {
+                if (worker->pending || worker->push.pending) {
+                    return false;
+                }
+            }
+
+            return true;
+        });
+    }
+
+    /*!
+     * \brief Apply the functor to each variable of the given layer, with
+     * its gradients and its list of non-zero rows (nullptr for the dense
+     * variables)
+     */
+    template <typename Layer, typename Context, typename Functor>
+    static void for_each_variable(Layer& layer, Context& context, Functor&& functor) {
+        if constexpr (is_utility_layer<Layer>) {
+            cpp::for_each(layer.layers, context.sub_contexts, [&functor](auto& sub_layer, auto& sub_context) {
+                this_type::for_each_variable(sub_layer, sub_context, functor);
+            });
+        } else if constexpr (decay_layer_traits<Layer>::is_neural_layer()) {
+            static constexpr size_t N = std::tuple_size<decltype(layer.trainable_parameters())>();
+
+            for_each_variables(context, functor, std::make_index_sequence<N>());
+        } else {
+            cpp_unused(layer);
+            cpp_unused(context);
+            cpp_unused(functor);
+        }
+    }
+
+    /*!
+     * \copydoc for_each_variable
+     */
+    template <typename Context, typename Functor, size_t... I>
+    static void for_each_variables(Context& context, Functor& functor, std::index_sequence<I...> /*seq*/) {
+        (functor(std::get<I>(context.up.context)->grad, sparse_rows<I>(context)), ...);
+    }
+
+    /*!
+     * \brief Returns the list of non-zero rows of the Ith variable of the
+     * given context, or nullptr if the variable is dense
+     */
+    template <size_t I, typename Context>
+    static std::vector<size_t>* sparse_rows([[maybe_unused]] Context& context) {
+        if constexpr (I == 0 && has_sparse_rows<Context>::value) {
+            return &context.rows;
+        } else {
+            return nullptr;
+        }
+    }
+
+    /*!
+     * \brief The main function of a worker
+     * \param worker The state of the worker
+     */
+    void work(worker_state& worker) {
+        while (true) {
+            {
+                std::unique_lock<std::mutex> ulock(main_lock);
+
+                condition.wait(ulock, [this, &worker] { return stop_flag || worker.pending; });
+
+                if (stop_flag) {
+                    return;
+                }
+            }
+
+            auto [error, loss] = train_worker(worker);
+
+            // The previous push of the worker must have been applied
+
+            {
+                std::unique_lock<std::mutex> ulock(main_lock);
+
+                condition.wait(ulock, [&worker] { return !worker.push.pending; });
+            }
+
+            pack(worker);
+
+            {
+                std::unique_lock<std::mutex> ulock(main_lock);
+
+                worker.push.n     = worker.n;
+                worker.push.epoch = worker.epoch;
+
+                worker.push.pending = true;
+                pushes.push_back(&worker);
+
+                worker.pending = false;
+
+                last_error = error;
+                last_loss  = loss;
+            }
+
+            condition.notify_all();
+        }
+    }
+
+    /*!
+     * \brief Train the current batch of a worker, computing its gradients
+     * \param worker The state of the worker
+     * \return a pair containing the error and the loss for the batch
+     */
+    std::pair<double, double> train_worker(worker_state& worker) {
+        auto& context  = worker.context;
+        auto& last_ctx = *std::get<layers - 1>(context).second;
+
+        const size_t n = worker.n;
+
+        auto inputs = etl::slice(worker.inputs, 0, n);
+        auto labels = etl::slice(worker.labels, 0, n);
+
+        double error = 1.0;
+        double loss  = -1.0;
+
+        // The other workers are already using the other cores
+        SERIAL_SECTION {
+            base_type::template forward_context<true>(context, inputs);
+
+            if constexpr (base_type::fused_metrics()) {
+                std::pair<double, double> metrics;
+
+                this->template last_errors<dbn_t::loss>(context, n == batch_size, n, labels, &metrics);
+
+                error = metrics.first / n;
+                loss  = metrics.second / n;
+            } else {
+                this->template last_errors<dbn_t::loss>(context, n == batch_size, n, labels);
+            }
+
+            base_type::backward_batch_helper(context);
+
+            cpp::for_each(context, [](auto& layer_ctx) {
+                base_type::compute_gradients_layer(layer_ctx.first, *layer_ctx.second);
+            });
+
+            if constexpr (!base_type::fused_metrics()) {
+                std::tie(error, loss) = this->dbn.evaluate_metrics_batch(last_ctx.output, labels, n, true);
+            }
+        }
+
+        return std::make_pair(error, loss);
+    }
+
+    /*!
+     * \brief Copy the gradients of the worker into its push, only the
+     * non-zero rows of the sparse variables, and reset the sparse
+     * gradients of the worker
+     */
+    void pack(worker_state& worker) {
+        dll::auto_timer timer("param_server::push");
+
+        auto& push = worker.push;
+
+        size_t v = 0;
+
+        cpp::for_each(worker.context, [&push, &v](auto& layer_ctx) {
+            this_type::for_each_variable(layer_ctx.first, *layer_ctx.second, [&push, &v](auto& grad, std::vector<size_t>* rows) {
+                if (push.values.size() == v) {
+                    push.rows.emplace_back();
+                    push.values.emplace_back();
+                }
+
+                auto& push_rows   = push.rows[v];
+                auto& push_values = push.values[v];
+
+                grad.ensure_cpu_up_to_date();
+
+                const auto* g = grad.memory_start();
+
+                if (rows) {
+                    const size_t K = etl::size(grad) / etl::dim<0>(grad);
+
+                    push_rows = *rows;
+                    push_values.resize(rows->size() * K);
+
+                    for (size_t i = 0; i < rows->size(); ++i) {
+                        std::copy_n(g + (*rows)[i] * K, K, push_values.data() + i * K);
+                    }
+
+                    // The rows have been pushed
+                    zero_rows(grad, *rows);
+                    rows->clear();
+                } else {
+                    push_values.assign(g, g + etl::size(grad));
+                }
+
+                ++v;
+            });
+        });
+    }
+
+    /*!
+     * \brief The main function of the server
+     */
+    void serve() {
+        while (true) {
+            worker_state* worker = nullptr;
+
+            {
+                std::unique_lock<std::mutex> ulock(main_lock);
+
+                condition.wait(ulock, [this] { return stop_flag || !pushes.empty(); });
+
+                if (pushes.empty()) {
+                    return;
+                }
+
+                worker = pushes.front();
+                pushes.pop_front();
+            }
+
+            apply(worker->push);
+
+            cpp::with_lock(main_lock, [worker] { worker->push.pending = false; });
+
+            condition.notify_all();
+        }
+    }
+
+    /*!
+     * \brief Apply the gradients of the given push to the weights of the
+     * network, with the updater of the network
+     */
+    void apply(const push_state& push) {
+        dll::auto_timer timer("param_server::apply");
+
+        // The workers are already using the other cores
+        SERIAL_SECTION {
+            size_t v = 0;
+
+            cpp::for_each(this->full_context, [&push, &v](auto& layer_ctx) {
+                this_type::for_each_variable(layer_ctx.first, *layer_ctx.second, [&push, &v](auto& grad, std::vector<size_t>* rows) {
+                    auto& push_rows   = push.rows[v];
+                    auto& push_values = push.values[v];
+
+                    grad.ensure_cpu_up_to_date();
+
+                    auto* g = grad.memory_start();
+
+                    if (rows) {
+                        const size_t K = etl::size(grad) / etl::dim<0>(grad);
+
+                        // The previous rows have been reset by the last update
+                        *rows = push_rows;
+
+                        for (size_t i = 0; i < push_rows.size(); ++i) {
+                            std::copy_n(push_values.data() + i * K, K, g + push_rows[i] * K);
+                        }
+                    } else {
+                        std::copy(push_values.begin(), push_values.end(), g);
+                    }
+
+                    grad.invalidate_gpu();
+
+                    ++v;
+                });
+            });
+
+            cpp::for_each(this->full_context, [this, &push](auto& layer_ctx) {
+                this->update_weights_layer(push.epoch, push.n, layer_ctx.first, *layer_ctx.second);
+            });
+
+            // Update the counter of iterations
+            ++this->iteration;
+        }
+    }
+};
+
+} //end of dll namespace
@@ -8,12 +8,14 @@
 #pragma once
 
 #include <memory>
+#include <numeric>
 
 #include "cpp_utils/algorithm.hpp"
 
 #include "dll/decay_type.hpp"
 #include "dll/util/batch.hpp"
 #include "dll/util/timers.hpp"
+#include "dll/util/memory.hpp"
 #include "dll/util/random.hpp"
 #include "dll/layer_traits.hpp"
 #include "dll/trainer/rbm_trainer_fwd.hpp"
@@ -71,6 +73,11 @@ struct rbm_trainer {
     size_t total_batches  = 0;   ///< The total number of batches
     error_type last_error = 0.0; ///< The last training error
 
+    double prev_error = 0.0; ///< The training error of the previous epoch (early stopping)
+    double best_error = 0.0; ///< The best training error (early stopping)
+    size_t best_epoch = 0;   ///< The epoch of the best training error (early stopping)
+    size_t patience   = 1;   ///< The remaining patience (early stopping)
+
     //Note: input_first/input_last only relevant for its size, not
     //values since they can point to the input of the first level
     //and not the current level
@@ -97,6 +104,32 @@ struct rbm_trainer {
         total_batches = size / batch_size;
 
         last_error = 0.0;
+        patience   = std::max(rbm.patience, size_t(1));
+
+        select_monitored_batches(rbm, (size + batch_size - 1) / batch_size);
+    }
+
+    /*!
+     * \brief Select the fixed random subset of batches whose statistics are
+     * gathered at each epoch. All the batches are selected if
+     * monitor_batches is zero.
+     * \param rbm The RBM being trained
+     * \param n The number of batches per epoch
+     */
+    void select_monitored_batches(const RBM& rbm, size_t n) {
+        const bool all = !rbm.monitor_batches || rbm.monitor_batches >= n;
+
+        monitored.assign(n, all);
+
+        if (!all) {
+            std::vector<size_t> indices(n);
+            std::iota(indices.begin(), indices.end(), 0);
+            std::shuffle(indices.begin(), indices.end(), dll::rand_engine());
+
+            for (size_t i = 0; i < rbm.monitor_batches; ++i) {
+                monitored[indices[i]] = true;
+            }
+        }
     }
 
     /*!
@@ -132,6 +165,9 @@ struct rbm_trainer {
         //Allocate the trainer
         auto trainer = get_trainer(rbm);
 
+        //Allocate the memory of the trainer for all the batches
+        trainer->init_training();
+
         //Train for max_epochs epoch
         for (size_t epoch = 0; epoch < max_epochs; ++epoch) {
             //Shuffle if necessary
@@ -146,6 +182,7 @@ struct rbm_trainer {
 
             //Create a new context for this epoch
             rbm_training_context context;
+            context.trainer_memory = memory_bytes(trainer);
 
             //Start a new epoch
             init_epoch();
@@ -155,20 +192,29 @@ struct rbm_trainer {
 
             //Finalize the current epoch
             finalize_epoch(epoch, context, rbm);
+
+            //Stop the training if the error has converged
+            if (early_stop(epoch, rbm)) {
+                break;
+            }
         }
 
         return finalize_training(rbm);
     }
 
-    size_t batches = 0; ///< The number of batches
-    size_t samples = 0; ///< The number of samples
+    size_t batches           = 0; ///< The number of batches
+    size_t monitored_batches = 0; ///< The number of batches whose statistics have been gathered
+    size_t samples           = 0; ///< The number of samples whose statistics have been gathered
+
+    std::vector<bool> monitored; ///< Indicates, for each batch, if its statistics are gathered
 
     /*!
      * \brief Initialization of the epoch
      */
     void init_epoch() {
-        batches = 0;
-        samples = 0;
+        batches           = 0;
+        monitored_batches = 0;
+        samples           = 0;
     }
 
     template <typename Generator>
@@ -184,16 +230,24 @@ struct rbm_trainer {
 
     template <typename InputBatch, typename ExpectedBatch>
     void train_batch(InputBatch&& input, ExpectedBatch&& expected, trainer_type& trainer, rbm_training_context& context, rbm_t& rbm) {
+        //The batches after the expected ones are always monitored
+        context.monitor = batches >= monitored.size() || monitored[batches];
+
         ++batches;
 
         trainer->train_batch(input, expected, context);
 
-        context.reconstruction_error += context.batch_error;
-        context.sparsity += context.batch_sparsity;
+        if (context.monitor) {
+            ++monitored_batches;
 
-        if constexpr (EnableWatcher && rbm_layer_traits<rbm_t>::free_energy()) {
-            for (auto& v : input) {
-                context.free_energy += rbm.free_energy(v);
+            context.reconstruction_error += context.batch_error;
+            context.sparsity += context.batch_sparsity;
+
+            if constexpr (EnableWatcher && rbm_layer_traits<rbm_t>::free_energy()) {
+                for (auto& v : input) {
+                    context.free_energy += rbm.free_energy(v);
+                    ++samples;
+                }
             }
         }
 
@@ -202,11 +256,76 @@ struct rbm_trainer {
         }
     }
 
+    /*!
+     * \brief Decide, depending on the early stopping strategy, if the
+     * training must stop after the given epoch
+     * \param epoch The current epoch
+     * \param rbm The RBM being trained
+     * \return true if the training is over
+     */
+    bool early_stop(size_t epoch, rbm_t& rbm) {
+        static constexpr auto s = rbm_layer_traits<rbm_t>::early_stopping();
+
+        static_assert(s == strategy::NONE || is_error(s), "Only error strategies are supported to stop the training of a RBM");
+
+        if constexpr (s == strategy::NONE) {
+            cpp_unused(epoch);
+            cpp_unused(rbm);
+
+            return false;
+        } else {
+            const double error = last_error;
+
+            // A decrease smaller than min_delta is not an improvement
+            const bool improved      = !epoch || error < best_error * (1.0 - rbm.min_delta);
+            const bool improved_prev = !epoch || error < prev_error * (1.0 - rbm.min_delta);
+
+            if (improved) {
+                best_error = error;
+                best_epoch = epoch;
+
+                if constexpr (s != strategy::ERROR_GOAL) {
+                    rbm.backup_weights();
+                }
+            }
+
+            prev_error = error;
+
+            bool stop = false;
+
+            if constexpr (s == strategy::ERROR_GOAL) {
+                stop = error <= rbm.goal;
+            } else {
+                if ((s == strategy::ERROR_DIRECT && !improved_prev) || (s == strategy::ERROR_BEST && !improved)) {
+                    stop = !--patience;
+                } else {
+                    patience = std::max(rbm.patience, size_t(1));
+                }
+            }
+
+            if (stop) {
+                if constexpr (s != strategy::ERROR_GOAL) {
+                    if (epoch != best_epoch) {
+                        rbm.restore_weights();
+
+                        last_error = best_error;
+                    }
+                }
+
+#ifndef DLL_SILENT
+                std::cout << "Stopping pretraining after epoch " << epoch << " (" << to_string(s) << ")" << std::endl;
+#endif
+            }
+
+            return stop;
+        }
+    }
+
     void finalize_epoch(size_t epoch, rbm_training_context& context, rbm_t& rbm) {
         //Average all the gathered information
-        context.reconstruction_error /= batches;
-        context.sparsity /= batches;
-        context.free_energy /= samples;
+        context.reconstruction_error /= std::max(monitored_batches, size_t(1));
+        context.sparsity /= std::max(monitored_batches, size_t(1));
+        context.free_energy /= std::max(samples, size_t(1));
 
         //After some time increase the momentum
         if (rbm_layer_traits<rbm_t>::has_momentum() && epoch == rbm.final_momentum_epoch) {
@@ -23,6 +23,10 @@ struct rbm_training_context {
 
     double batch_error    = 0.0; ///< The mean reconstruction error for the last batch
     double batch_sparsity = 0.0; ///< The mean sparsity for the last batch
+
+    bool monitor = true; ///< Indicates if the statistics of the current batch are gathered
+
+    size_t trainer_memory = 0; ///< The number of bytes of the buffers of the trainer
 };
 
 } //end of dll namespace
@@ -0,0 +1,1163 @@
+//=======================================================================
+// Copyright (c) 2014-2017 Baptiste Wicht
+// Distributed under the terms of the MIT License.
+// (See accompanying file LICENSE or copy at
+//  http://opensource.org/licenses/MIT)
+//=======================================================================
+
+/*!
+ * \file sgd_context.hpp
+ * \brief The training contexts of the layers in the SGD trainer
+ *
+ * This contains the state of the updaters, the complete contexts of the
+ * layers and the functions to build the contexts of a network, without
+ * the trainer itself.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "cpp_utils/tuple_utils.hpp"
+
+#include "dll/dbn_traits.hpp"             // For dbn_traits
+#include "dll/trainer/context_fwd.hpp"    // For sgd_context
+#include "dll/trainer/chained_input.hpp"  // For context_chain
+#include "dll/util/huge_pages.hpp"        // For huge_buffer
+#include "dll/util/memory.hpp"            // For memory_bytes
+#include "dll/util/training_state.hpp"    // For store_buffers
+
+namespace dll {
+
+template <typename Layer>
+static constexpr bool is_group_layer = cpp::is_specialization_of_v<dll::group_layer_impl, Layer> || cpp::is_specialization_of_v<dll::dyn_group_layer_impl, Layer>;
+
+template <typename Layer>
+static constexpr bool is_merge_layer = cpp::is_specialization_of_v<dll::merge_layer_impl, Layer> || cpp::is_specialization_of_v<dll::dyn_merge_layer_impl, Layer>;
+
+template <typename Layer>
+static constexpr bool is_utility_layer = is_group_layer<Layer> || is_merge_layer<Layer>;
+
+/*!
+ * \brief Traits to test if a layer must be notified when its weights have
+ * been updated
+ */
+template <typename Layer, typename Enable = void>
+struct has_weights_changed : std::false_type {};
+
+/*!
+ * \copydoc has_weights_changed
+ */
+template <typename Layer>
+struct has_weights_changed<Layer, std::void_t<decltype(std::declval<Layer&>().weights_changed())>> : std::true_type {};
+
+/*!
+ * \brief Traits to test if the gradients of the first variable of a layer
+ * are sparse rows, listed in the rows of its context
+ */
+template <typename Context, typename Enable = void>
+struct has_sparse_rows : std::false_type {};
+
+/*!
+ * \copydoc has_sparse_rows
+ */
+template <typename Context>
+struct has_sparse_rows<Context, std::void_t<decltype(std::declval<Context&>().rows)>> : std::true_type {};
+
+/*!
+ * \brief Traits to test if the gradients of a layer can be computed by its
+ * backward pass, in which case its context tells if they are ready
+ */
+template <typename Context, typename Enable = void>
+struct has_gradients_ready : std::false_type {};
+
+/*!
+ * \copydoc has_gradients_ready
+ */
+template <typename Context>
+struct has_gradients_ready<Context, std::void_t<decltype(std::declval<Context&>().gradients_ready)>> : std::true_type {};
+
+/*!
+ * \brief Traits to test if a SGD context holds the inputs, outputs and
+ * errors of its layer (the contexts of the group layers do not)
+ */
+template <typename Context, typename Enable = void>
+struct has_context_buffers : std::false_type {};
+
+/*!
+ * \copydoc has_context_buffers
+ */
+template <typename Context>
+struct has_context_buffers<Context, std::void_t<decltype(std::declval<Context&>().errors)>> : std::true_type {};
+
+/*!
+ * \brief Traits to test if a SGD context holds the context of the updater
+ */
+template <typename Context, typename Enable = void>
+struct has_updater_context : std::false_type {};
+
+/*!
+ * \copydoc has_updater_context
+ */
+template <typename Context>
+struct has_updater_context<Context, std::void_t<decltype(std::declval<Context&>().up)>> : std::true_type {};
+
+/*!
+ * \brief Traits to test if a layer records state in its SGD context during
+ * the training forward pass
+ */
+template <typename Layer, typename Context, typename Enable = void>
+struct has_context_forward : std::false_type {};
+
+/*!
+ * \copydoc has_context_forward
+ */
+template <typename Layer, typename Context>
+struct has_context_forward<Layer, Context, std::void_t<decltype(std::declval<Layer&>().train_forward_batch(
+                                               std::declval<Context&>().output, std::declval<Context&>().input, std::declval<Context&>()))>> : std::true_type {};
+
+/*!
+ * \brief Traits to test if a SGD context computes its layer in place, its
+ * output being its input
+ */
+template <typename Context, typename Enable = void>
+struct is_in_place_context : std::false_type {};
+
+/*!
+ * \copydoc is_in_place_context
+ */
+template <typename Context>
+struct is_in_place_context<Context, std::void_t<decltype(Context::in_place)>> : std::bool_constant<Context::in_place> {};
+
+/*!
+ * \brief Traits to test if a layer can compute its forward pass without
+ * its activation function
+ */
+template <typename Layer, typename Context, typename Enable = void>
+struct has_forward_logits : std::false_type {};
+
+/*!
+ * \copydoc has_forward_logits
+ */
+template <typename Layer, typename Context>
+struct has_forward_logits<Layer, Context, std::void_t<decltype(std::declval<Layer&>().forward_logits_batch(
+                                              std::declval<Context&>().output, std::declval<Context&>().input))>> : std::true_type {};
+
+/*!
+ * \brief Traits to test if a SGD context has the contexts of sub layers
+ */
+template <typename Context, typename Enable = void>
+struct has_sub_contexts : std::false_type {};
+
+/*!
+ * \copydoc has_sub_contexts
+ */
+template <typename Context>
+struct has_sub_contexts<Context, std::void_t<decltype(std::declval<Context&>().sub_contexts)>> : std::true_type {};
+
+/*!
+ * \brief Traits to test if the input of a context can be shared with the
+ * output of the previous context
+ */
+template <typename Context, typename Enable = void>
+struct has_chained_input : std::false_type {};
+
+/*!
+ * \copydoc has_chained_input
+ */
+template <typename Context>
+struct has_chained_input<Context, std::void_t<decltype(std::declval<Context&>().input_storage)>> : std::true_type {};
+
+/*!
+ * \brief Traits to get the index of the layer of a SGD context
+ */
+template <typename Context>
+struct context_layer;
+
+/*!
+ * \copydoc context_layer
+ */
+template <typename DBN, typename Layer, size_t L>
+struct context_layer<sgd_context<DBN, Layer, L>> : std::integral_constant<size_t, L> {};
+
+/*!
+ * \brief Build the sub context for a updater context
+ *
+ * \param layer The layer to build the context for
+ */
+template <template <typename, size_t, updater_type, bool> typename SubContext, updater_type UT, bool Flat, typename Layer, size_t... I>
+auto build_sub_context(const Layer& layer, std::index_sequence<I...> /*seq*/) {
+    return std::make_tuple
+        (
+            std::make_shared<SubContext<Layer, I, UT, Flat>>(layer)...
+        );
+}
+
+/*!
+ * \brief Build the sub context for a updater context
+ *
+ * \param layer The layer to build the context for
+ */
+template <template <typename, size_t, updater_type, bool> typename SubContext, updater_type UT, bool Flat, typename Layer>
+auto build_sub_context(const Layer& layer) {
+    static constexpr size_t N = std::tuple_size<decltype(std::declval<Layer>().trainable_parameters())>();
+
+    return build_sub_context<SubContext, UT, Flat>(layer, std::make_index_sequence<N>());
+}
+
+/*!
+ * \brief Contiguous storage of the gradients and of the state of the
+ * updater of a whole network (flat_parameters).
+ *
+ * Each slot is a contiguous buffer: the first slot holds all the
+ * gradients and the next slots the state of the updater, one slot per
+ * moment. Each variable is at the same offset in all the slots.
+ */
+template <typename T>
+struct flat_storage {
+    static constexpr size_t slots     = 4;              ///< The maximum number of buffers of a variable
+    static constexpr size_t alignment = 64 / sizeof(T); ///< The alignment of each variable (in elements)
+
+    /*!
+     * \brief Returns the number of elements taken by a variable of n
+     * elements
+     */
+    static constexpr size_t padded(size_t n) {
+        return (n + alignment - 1) / alignment * alignment;
+    }
+
+    /*!
+     * \brief Create a storage for variables of the given total number of
+     * (padded) elements
+     */
+    explicit flat_storage(size_t capacity) : capacity(capacity) {}
+
+    flat_storage(const flat_storage& rhs) = delete;
+    flat_storage& operator=(const flat_storage& rhs) = delete;
+
+    /*!
+     * \brief Take the memory of a variable of n elements in the given slot
+     */
+    T* take(size_t slot, size_t n) {
+        if (!memory[slot]) {
+            memory[slot] = huge_buffer<T>(capacity + alignment);
+        }
+
+        cpp_assert(sizes[slot] + padded(n) <= capacity, "flat_storage: the storage has not been reserved large enough");
+
+        T* ptr = data(slot) + sizes[slot];
+
+        sizes[slot] += padded(n);
+
+        return ptr;
+    }
+
+    /*!
+     * \brief Returns the memory of the given slot (nullptr if unused)
+     */
+    T* data(size_t slot) {
+        if (!memory[slot]) {
+            return nullptr;
+        }
+
+        const auto address = reinterpret_cast<std::uintptr_t>(memory[slot].get());
+        const auto aligned = (address + 63) & ~std::uintptr_t(63);
+        return reinterpret_cast<T*>(aligned);
+    }
+
+    /*!
+     * \brief Returns the number of elements used in the given slot
+     */
+    size_t size(size_t slot) const {
+        return sizes[slot];
+    }
+
+private:
+    huge_buffer<T> memory[slots]; ///< The memory of each slot
+    size_t sizes[slots] = {};     ///< The number of used elements of each slot
+    size_t capacity;              ///< The number of elements of each slot
+};
+
+/*!
+ * \brief Returns the flat storage in which the contexts built by the
+ * current thread take their variables (nullptr if none)
+ */
+template <typename T>
+flat_storage<T>*& current_flat_storage() {
+    thread_local flat_storage<T>* storage = nullptr;
+    return storage;
+}
+
+/*!
+ * \brief Traits to test if a network stores its gradients and the state of
+ * its updater in contiguous buffers
+ */
+template <typename DBN, typename Enable = void>
+struct is_flat_network : std::false_type {};
+
+/*!
+ * \copydoc is_flat_network
+ */
+template <typename DBN>
+struct is_flat_network<DBN, std::void_t<typename DBN::desc>> : std::integral_constant<bool, dbn_traits<DBN>::flat_parameters()> {};
+
+/*!
+ * \brief The storage of the variables of a sub context: each variable is a
+ * copy of the shape of the optimized variable
+ * \param Layer The layer to optimize
+ * \param I The index of the variable to optimize
+ * \param Flat Indicates if the variables are views in a flat storage
+ */
+template <typename Layer, size_t I, bool Flat>
+struct sub_context_storage {
+    /*!
+     * \brief The type of the variables of the sub context
+     */
+    using type = std::remove_reference_t<decltype(std::get<I>(std::declval<Layer>().trainable_parameters()))>;
+
+    /*!
+     * \brief Create a variable of the shape of the given variable
+     */
+    template <typename V>
+    static type variable(const V& v, size_t slot) {
+        cpp_unused(slot);
+
+        return type(v);
+    }
+};
+
+/*!
+ * \brief The storage of the variables of a sub context: each variable is a
+ * view in the flat storage of the network, or in memory owned by the sub
+ * context when it is not built in a flat storage.
+ */
+template <typename Layer, size_t I>
+struct sub_context_storage<Layer, I, true> {
+    using variable_t = std::decay_t<decltype(std::get<I>(std::declval<Layer>().trainable_parameters()))>; ///< The type of the optimized variable
+    using value_type = etl::value_t<variable_t>;                                                         ///< The type of value of the variable
+
+    static constexpr size_t D = etl::decay_traits<variable_t>::dimensions(); ///< The number of dimensions of the variable
+
+    using type = etl::custom_dyn_matrix<value_type, D>; ///< The type of the variables of the sub context
+
+    /*!
+     * \brief Create a variable of the shape of the given variable, in the
+     * given slot of the flat storage
+     */
+    template <typename V>
+    type variable(const V& v, size_t slot) {
+        return variable(v, slot, std::make_index_sequence<D>());
+    }
+
+private:
+    /*!
+     * \copydoc variable
+     */
+    template <typename V, size_t... DI>
+    type variable(const V& v, size_t slot, std::index_sequence<DI...> /*seq*/) {
+        value_type* memory;
+
+        if (auto* storage = current_flat_storage<value_type>()) {
+            memory = storage->take(slot, etl::size(v));
+        } else {
+            owned.emplace_back(etl::size(v));
+            memory = owned.back().get();
+        }
+
+        return type(memory, etl::dim<DI>(v)...);
+    }
+
+    std::vector<huge_buffer<value_type>> owned; ///< The memory of the variables built out of a flat storage
+};
+
+/*!
+ * \brief The sub context for a specific updater
+ * \param Layer The layer to optimize
+ * \param I The index of the variable to optimize
+ * \param UT The updater type
+ */
+template<typename Layer, size_t I, updater_type UT, bool Flat>
+struct updater_sub_context;
+
+/*!
+ * \brief Specialization of updater_sub_context for SGD updater
+ */
+template<typename Layer, size_t I, bool Flat>
+struct updater_sub_context <Layer, I, updater_type::SGD, Flat> : sub_context_storage<Layer, I, Flat> {
+    /*!
+     * \brief The type of the variable to optimize
+     */
+    using type = typename sub_context_storage<Layer, I, Flat>::type;
+
+    type grad; ///< The gradients of the variable
+
+    /*!
+     * \brief Construct the sub_context for the given layer
+     * \param layer The layer to build the context for
+     */
+    updater_sub_context(const Layer& layer) : grad(this->variable(std::get<I>(layer.trainable_parameters()), 0)) {
+        grad = 0;
+    }
+
+    /*!
+     * \brief Returns the buffers of the gradients and of the state of the updater
+     */
+    auto buffers() const {
+        return std::tie(grad);
+    }
+
+    /*!
+     * \brief Returns the number of bytes of the gradients and of the state of the updater
+     */
+    size_t memory() const {
+        return memory_bytes(buffers());
+    }
+};
+
+/*!
+ * \brief Specialization of updater_sub_context for momentum updater
+ */
+template<typename Layer, size_t I, bool Flat>
+struct updater_sub_context <Layer, I, updater_type::MOMENTUM, Flat> : sub_context_storage<Layer, I, Flat> {
+    /*!
+     * \brief The type of the variable to optimize
+     */
+    using type = typename sub_context_storage<Layer, I, Flat>::type;
+
+    type grad; ///< The gradients of the variable
+    type inc;  ///< The accumulated momentum cache
+
+    /*!
+     * \brief Construct the sub_context for the given layer
+     * \param layer The layer to build the context for
+     */
+    updater_sub_context(const Layer& layer) : grad(this->variable(std::get<I>(layer.trainable_parameters()), 0)), inc(this->variable(grad, 1)) {
+        grad = 0;
+        inc = 0;
+    }
+
+    /*!
+     * \brief Returns the buffers of the gradients and of the state of the updater
+     */
+    auto buffers() const {
+        return std::tie(grad, inc);
+    }
+
+    /*!
+     * \brief Returns the number of bytes of the gradients and of the state of the updater
+     */
+    size_t memory() const {
+        return memory_bytes(buffers());
+    }
+};
+
+/*!
+ * \brief Specialization of updater_sub_context for Nesterov Accelerated Gradients updater
+ */
+template<typename Layer, size_t I, bool Flat>
+struct updater_sub_context <Layer, I, updater_type::NESTEROV, Flat> : sub_context_storage<Layer, I, Flat> {
+    /*!
+     * \brief The type of the variable to optimize
+     */
+    using type = typename sub_context_storage<Layer, I, Flat>::type;
+
+    type grad; ///< The gradients of the variable
+    type inc;  ///< The accumulated momentum cache
+
+    /*!
+     * \brief Construct the sub_context for the given layer
+     * \param layer The layer to build the context for
+     */
+    updater_sub_context(const Layer& layer) : grad(this->variable(std::get<I>(layer.trainable_parameters()), 0)), inc(this->variable(grad, 1)) {
+        grad = 0;
+        inc = 0;
+    }
+
+    /*!
+     * \brief Returns the buffers of the gradients and of the state of the updater
+     */
+    auto buffers() const {
+        return std::tie(grad, inc);
+    }
+
+    /*!
+     * \brief Returns the number of bytes of the gradients and of the state of the updater
+     */
+    size_t memory() const {
+        return memory_bytes(buffers());
+    }
+};
+
+/*!
+ * \brief Specialization of updater_sub_context for RMSPROP updater
+ */
+template<typename Layer, size_t I, bool Flat>
+struct updater_sub_context <Layer, I, updater_type::RMSPROP, Flat> : sub_context_storage<Layer, I, Flat> {
+    /*!
+     * \brief The type of the variable to optimize
+     */
+    using type = typename sub_context_storage<Layer, I, Flat>::type;
+
+    type grad; ///< The gradients of the variable
+    type inc;  ///< The accumulated squared gradients
+
+    /*!
+     * \brief Construct the sub_context for the given layer
+     * \param layer The layer to build the context for
+     */
+    updater_sub_context(const Layer& layer) : grad(this->variable(std::get<I>(layer.trainable_parameters()), 0)), inc(this->variable(grad, 1)) {
+        grad = 0;
+        inc = 0;
+    }
+
+    /*!
+     * \brief Returns the buffers of the gradients and of the state of the updater
+     */
+    auto buffers() const {
+        return std::tie(grad, inc);
+    }
+
+    /*!
+     * \brief Returns the number of bytes of the gradients and of the state of the updater
+     */
+    size_t memory() const {
+        return memory_bytes(buffers());
+    }
+};
+
+/*!
+ * \brief Specialization of updater_sub_context for Adagrad updater
+ */
+template<typename Layer, size_t I, bool Flat>
+struct updater_sub_context <Layer, I, updater_type::ADAGRAD, Flat> : sub_context_storage<Layer, I, Flat> {
+    /*!
+     * \brief The type of the variable to optimize
+     */
+    using type = typename sub_context_storage<Layer, I, Flat>::type;
+
+    type grad; ///< The gradients of the variable
+    type inc;  ///< Accumulated gradients for adagrad
+
+    /*!
+     * \brief Construct the sub_context for the given layer
+     * \param layer The layer to build the context for
+     */
+    updater_sub_context(const Layer& layer) : grad(this->variable(std::get<I>(layer.trainable_parameters()), 0)), inc(this->variable(grad, 1)) {
+        grad = 0;
+        inc = 0;
+    }
+
+    /*!
+     * \brief Returns the buffers of the gradients and of the state of the updater
+     */
+    auto buffers() const {
+        return std::tie(grad, inc);
+    }
+
+    /*!
+     * \brief Returns the number of bytes of the gradients and of the state of the updater
+     */
+    size_t memory() const {
+        return memory_bytes(buffers());
+    }
+};
+
+/*!
+ * \brief Specialization of updater_sub_context for Adadelta updater
+ */
+template<typename Layer, size_t I, bool Flat>
+struct updater_sub_context <Layer, I, updater_type::ADADELTA, Flat> : sub_context_storage<Layer, I, Flat> {
+    /*!
+     * \brief The type of the variable to optimize
+     */
+    using type = typename sub_context_storage<Layer, I, Flat>::type;
+
+    type grad; ///< The gradients of the variable
+    type g;
+    type x;
+    type v;
+
+    /*!
+     * \brief Construct the sub_context for the given layer
+     * \param layer The layer to build the context for
+     */
+    updater_sub_context(const Layer& layer) : grad(this->variable(std::get<I>(layer.trainable_parameters()), 0)), g(this->variable(grad, 1)), x(this->variable(grad, 2)), v(this->variable(grad, 3)) {
+        grad = 0;
+        g = 0;
+        x = 0;
+        v = 0;
+    }
+
+    /*!
+     * \brief Returns the buffers of the gradients and of the state of the updater
+     */
+    auto buffers() const {
+        return std::tie(grad, g, x, v);
+    }
+
+    /*!
+     * \brief Returns the number of bytes of the gradients and of the state of the updater
+     */
+    size_t memory() const {
+        return memory_bytes(buffers());
+    }
+};
+
+/*!
+ * \brief The context for the Adam updater
+ */
+template<typename Layer, size_t I, bool Flat>
+struct updater_sub_context <Layer, I, updater_type::ADAM, Flat> : sub_context_storage<Layer, I, Flat> {
+    /*!
+     * \brief The type of the variable to optimize
+     */
+    using type = typename sub_context_storage<Layer, I, Flat>::type;
+
+    type grad; ///< The gradients of the variable
+    type m;    ///< Estimates of the first moment of the gradient
+    type v;    ///< Estimates of the second moment of the gradient
+
+    /*!
+     * \brief Construct the sub_context for the given layer
+     * \param layer The layer to build the context for
+     */
+    updater_sub_context(const Layer& layer) : grad(this->variable(std::get<I>(layer.trainable_parameters()), 0)), m(this->variable(grad, 1)), v(this->variable(grad, 2)) {
+        grad = 0;
+        m = 0;
+        v = 0;
+    }
+
+    /*!
+     * \brief Returns the buffers of the gradients and of the state of the updater
+     */
+    auto buffers() const {
+        return std::tie(grad, m, v);
+    }
+
+    /*!
+     * \brief Returns the number of bytes of the gradients and of the state of the updater
+     */
+    size_t memory() const {
+        return memory_bytes(buffers());
+    }
+};
+
+/*!
+ * \brief The context for the Adam updater with bias correction
+ */
+template<typename Layer, size_t I, bool Flat>
+struct updater_sub_context <Layer, I, updater_type::ADAM_CORRECT, Flat> : sub_context_storage<Layer, I, Flat> {
+    /*!
+     * \brief The type of the variable to optimize
+     */
+    using type = typename sub_context_storage<Layer, I, Flat>::type;
+
+    type grad; ///< The gradients of the variable
+    type m;    ///< Estimates of the first moment of the gradient
+    type v;    ///< Estimates of the second moment of the gradient
+
+    /*!
+     * \brief Construct the sub_context for the given layer
+     * \param layer The layer to build the context for
+     */
+    updater_sub_context(const Layer& layer) : grad(this->variable(std::get<I>(layer.trainable_parameters()), 0)), m(this->variable(grad, 1)), v(this->variable(grad, 2)) {
+        grad = 0;
+        m = 0;
+        v = 0;
+    }
+
+    /*!
+     * \brief Returns the buffers of the gradients and of the state of the updater
+     */
+    auto buffers() const {
+        return std::tie(grad, m, v);
+    }
+
+    /*!
+     * \brief Returns the number of bytes of the gradients and of the state of the updater
+     */
+    size_t memory() const {
+        return memory_bytes(buffers());
+    }
+};
+
+/*!
+ * \brief The context for the Nesterov Adam (NAdam) updater with bias correction
+ */
+template<typename Layer, size_t I, bool Flat>
+struct updater_sub_context <Layer, I, updater_type::NADAM, Flat> : sub_context_storage<Layer, I, Flat> {
+    /*!
+     * \brief The type of the variable to optimize
+     */
+    using type = typename sub_context_storage<Layer, I, Flat>::type;
+
+    type grad; ///< The gradients of the variable
+    type m;    ///< Estimates of the first moment of the gradient
+    type v;    ///< Estimates of the second moment of the gradient
+
+    double m_schedule;
+
+    /*!
+     * \brief Construct the sub_context for the given layer
+     * \param layer The layer to build the context for
+     */
+    updater_sub_context(const Layer& layer) : grad(this->variable(std::get<I>(layer.trainable_parameters()), 0)), m(this->variable(grad, 1)), v(this->variable(grad, 2)) {
+        grad = 0;
+        m = 0;
+        v = 0;
+
+        m_schedule = 1.0;
+    }
+
+    /*!
+     * \brief Returns the buffers of the gradients and of the state of the updater
+     */
+    auto buffers() const {
+        return std::tie(grad, m, v);
+    }
+
+    /*!
+     * \brief Returns the number of bytes of the gradients and of the state of the updater
+     */
+    size_t memory() const {
+        return memory_bytes(buffers());
+    }
+};
+
+/*!
+ * \brief The context for the Adamax updater
+ */
+template<typename Layer, size_t I, bool Flat>
+struct updater_sub_context <Layer, I, updater_type::ADAMAX, Flat> : sub_context_storage<Layer, I, Flat> {
+    /*!
+     * \brief The type of the variable to optimize
+     */
+    using type = typename sub_context_storage<Layer, I, Flat>::type;
+
+    type grad; ///< The gradients of the variable
+    type m;    ///< Estimates of the first moment of the gradient
+    type v;    ///< Estimates of the second moment of the gradient
+
+    /*!
+     * \brief Construct the sub_context for the given layer
+     * \param layer The layer to build the context for
+     */
+    updater_sub_context(const Layer& layer) : grad(this->variable(std::get<I>(layer.trainable_parameters()), 0)), m(this->variable(grad, 1)), v(this->variable(grad, 2)) {
+        grad = 0;
+        m = 0;
+        v = 0;
+    }
+
+    /*!
+     * \brief Returns the buffers of the gradients and of the state of the updater
+     */
+    auto buffers() const {
+        return std::tie(grad, m, v);
+    }
+
+    /*!
+     * \brief Returns the number of bytes of the gradients and of the state of the updater
+     */
+    size_t memory() const {
+        return memory_bytes(buffers());
+    }
+};
+
+
+/*!
+ * \brief The context for the base updater (no update).
+ */
+template <updater_type UT, bool Neural, typename Layer, bool Flat = false>
+struct updater_context {
+    /*!
+     * \brief Construct a new updater_context using the parent context
+     */
+    updater_context(const Layer& layer) {
+        cpp_unused(layer);
+    }
+
+    /*!
+     * \brief Returns the number of bytes of the updater (none)
+     */
+    size_t memory() const {
+        return 0;
+    }
+};
+
+/*!
+ * \brief The context for the real updaters.
+ */
+template <updater_type UT, typename Layer, bool Flat>
+struct updater_context<UT, true, Layer, Flat> {
+    /*!
+     * \brief The context for the updater and for each variable of the layer
+     */
+    decltype(build_sub_context<updater_sub_context, UT, Flat>(std::declval<Layer&>())) context;
+
+    /*!
+     * \brief Construct a new updater_context using the parent context
+     */
+    updater_context(const Layer& layer) : context(build_sub_context<updater_sub_context, UT, Flat>(layer)) {
+        // Nothing else to init
+    }
+
+    /*!
+     * \brief Returns the buffers of the gradients and of the state of the updater
+     */
+    auto buffers() const {
+        return std::tie(context);
+    }
+
+    /*!
+     * \brief Returns the number of bytes of the gradients and of the state of the updater
+     */
+    size_t memory() const {
+        return memory_bytes(buffers());
+    }
+};
+
+/*!
+ * \brief The full SGD context, it contains the context of the layer as well as
+ * the context for the SGD updater
+ */
+template <typename DBN, typename Layer, size_t L>
+struct full_sgd_context : sgd_context<DBN, Layer, L> {
+    using context_type = sgd_context<DBN, Layer, L>; ///< The parent context type
+
+    /*!
+     * \brief The updater context
+     */
+    updater_context<DBN::updater, decay_layer_traits<Layer>::is_neural_layer(), Layer, is_flat_network<DBN>::value> up;
+
+    /*!
+     * \brief Construct the full_sgd_context for the given layer
+     */
+    full_sgd_context(const Layer& layer) : context_type(layer), up(layer) {
+        // Nothing else to init
+    }
+};
+
+/*!
+ * \brief The full SGD context, it contains the context of the layer as well as
+ * the context for the SGD updater
+ */
+template <typename DBN, typename... Layers, size_t L>
+struct full_sgd_context <DBN, group_layer_impl<group_layer_desc<Layers...>>, L>  {
+    using layer_t      = group_layer_impl<group_layer_desc<Layers...>>; ///< The layer
+    using context_type = sgd_context<DBN, layer_t, L>;                  ///< The parent context type
+
+    static constexpr size_t n_layers = sizeof...(Layers); ///< The number of layers
+
+    std::tuple<full_sgd_context<DBN, Layers, L>...> sub_contexts; ///< The sub contexts
+
+    /*!
+     * \brief Construct the full_sgd_context for the given layer
+     */
+    full_sgd_context(const layer_t& layer) : sub_contexts(layer.layers) {
+        // Nothing else to init
+    }
+};
+
+/*!
+ * \brief The full SGD context, it contains the context of the layer as well as
+ * the context for the SGD updater
+ */
+template <typename DBN, typename... Layers, size_t L>
+struct full_sgd_context <DBN, dyn_group_layer_impl<dyn_group_layer_desc<Layers...>>, L>  {
+    using layer_t      = dyn_group_layer_impl<dyn_group_layer_desc<Layers...>>; ///< The layer
+    using context_type = sgd_context<DBN, layer_t, L>;                  ///< The parent context type
+
+    static constexpr size_t n_layers = sizeof...(Layers); ///< The number of layers
+
+    std::tuple<full_sgd_context<DBN, Layers, L>...> sub_contexts; ///< The sub contexts
+
+    /*!
+     * \brief Construct the full_sgd_context for the given layer
+     */
+    full_sgd_context(const layer_t& layer) : sub_contexts(layer.layers) {
+        // Nothing else to init
+    }
+};
+
+/*!
+ * \brief The full SGD context, it contains the context of the layer as well as
+ * the context for the SGD updater
+ */
+template <typename DBN, size_t D, typename... Layers, size_t L>
+struct full_sgd_context<DBN, merge_layer_impl<merge_layer_desc<D, Layers...>>, L> : sgd_context<DBN, merge_layer_impl<merge_layer_desc<D, Layers...>>, L> {
+    using layer_t      = merge_layer_impl<merge_layer_desc<D, Layers...>>; ///< The layer
+    using context_type = sgd_context<DBN, layer_t, L>;                     ///< The parent context type
+
+    static constexpr size_t n_layers = sizeof...(Layers); ///< The number of layers
+
+    std::tuple<full_sgd_context<DBN, Layers, L>...> sub_contexts; ///< The sub contexts
+
+    bool parallel = false; ///< Indicates if the branches are run concurrently on the scheduler
+
+    /*!
+     * \brief Construct the full_sgd_context for the given layer
+     */
+    full_sgd_context(const layer_t& layer) : context_type(layer), sub_contexts(layer.layers) {
+        // Nothing else to init
+    }
+};
+
+/*!
+ * \brief The full SGD context, it contains the context of the layer as well as
+ * the context for the SGD updater
+ */
+template <typename DBN, size_t D, typename... Layers, size_t L>
+struct full_sgd_context<DBN, dyn_merge_layer_impl<dyn_merge_layer_desc<D, Layers...>>, L> : sgd_context<DBN, dyn_merge_layer_impl<dyn_merge_layer_desc<D, Layers...>>, L> {
+    using layer_t      = dyn_merge_layer_impl<dyn_merge_layer_desc<D, Layers...>>; ///< The layer
+    using context_type = sgd_context<DBN, layer_t, L>;                     ///< The parent context type
+
+    static constexpr size_t n_layers = sizeof...(Layers); ///< The number of layers
+
+    std::tuple<full_sgd_context<DBN, Layers, L>...> sub_contexts; ///< The sub contexts
+
+    bool parallel = false; ///< Indicates if the branches are run concurrently on the scheduler
+
+    /*!
+     * \brief Construct the full_sgd_context for the given layer
+     */
+    full_sgd_context(const layer_t& layer) : context_type(layer), sub_contexts(layer.layers) {
+        // Nothing else to init
+    }
+};
+
+/*!
+ * \brief Returns the number of bytes of the inputs, outputs and errors held
+ * by the given SGD context (and by the contexts of its sub layers)
+ */
+template <typename Context>
+size_t context_memory(const Context& context) {
+    size_t bytes = 0;
+
+    if constexpr (is_in_place_context<Context>::value) {
+        bytes += memory_bytes(context.input, context.errors);
+    } else if constexpr (has_chained_input<Context>::value) {
+        // A chained input is counted with the output of the previous context
+        bytes += context.input_storage.memory() + memory_bytes(context.output, context.errors);
+    } else if constexpr (has_context_buffers<Context>::value) {
+        bytes += memory_bytes(context.input, context.output, context.errors);
+    }
+
+    if constexpr (has_sub_contexts<Context>::value) {
+        cpp::for_each(context.sub_contexts, [&bytes](auto& sub_context) {
+            bytes += context_memory(sub_context);
+        });
+    }
+
+    return bytes;
+}
+
+/*!
+ * \brief Returns the number of bytes of the gradients and of the updater
+ * state held by the given SGD context (and by the contexts of its sub layers)
+ */
+template <typename Context>
+size_t updater_memory(const Context& context) {
+    size_t bytes = 0;
+
+    if constexpr (has_updater_context<Context>::value) {
+        bytes += context.up.memory();
+    }
+
+    if constexpr (has_sub_contexts<Context>::value) {
+        cpp::for_each(context.sub_contexts, [&bytes](auto& sub_context) {
+            bytes += updater_memory(sub_context);
+        });
+    }
+
+    return bytes;
+}
+
+/*!
+ * \brief Advise the kernel to back the large inputs, outputs, errors,
+ * gradients and updater state held by the given SGD context (and by the
+ * contexts of its sub layers) with transparent huge pages
+ */
+template <typename Context>
+void advise_context_huge_pages(const Context& context) {
+    if constexpr (is_in_place_context<Context>::value) {
+        advise_huge_pages(std::tie(context.input, context.errors));
+    } else if constexpr (has_context_buffers<Context>::value) {
+        advise_huge_pages(std::tie(context.input, context.output, context.errors));
+    }
+
+    if constexpr (has_updater_context<Context>::value) {
+        advise_huge_pages(context.up);
+    }
+
+    if constexpr (has_sub_contexts<Context>::value) {
+        cpp::for_each(context.sub_contexts, [](auto& sub_context) {
+            advise_context_huge_pages(sub_context);
+        });
+    }
+}
+
+/*!
+ * \brief Write the gradients and the updater state held by the given SGD
+ * context (and by the contexts of its sub layers)
+ */
+template <typename Context>
+void store_updater_state(std::ostream& os, const Context& context) {
+    if constexpr (has_updater_context<Context>::value) {
+        store_buffers(os, context.up);
+    }
+
+    if constexpr (has_sub_contexts<Context>::value) {
+        cpp::for_each(context.sub_contexts, [&os](auto& sub_context) {
+            store_updater_state(os, sub_context);
+        });
+    }
+}
+
+/*!
+ * \brief Read the gradients and the updater state held by the given SGD
+ * context (and by the contexts of its sub layers), in the order of
+ * store_updater_state
+ * \return true if the state was read, false otherwise
+ */
+template <typename Context>
+bool load_updater_state(std::istream& is, Context& context) {
+    bool ok = true;
+
+    if constexpr (has_updater_context<Context>::value) {
+        ok = load_buffers(is, context.up);
+    }
+
+    if constexpr (has_sub_contexts<Context>::value) {
+        cpp::for_each(context.sub_contexts, [&is, &ok](auto& sub_context) {
+            ok = ok && load_updater_state(is, sub_context);
+        });
+    }
+
+    return ok;
+}
+
+/*!
+ * \brief Build the context of the given layer and, when the contexts are
+ * chained, offer its output as the input of the next context
+ * \param layer The layer to build the context from
+ */
+template <typename DBN, typename Context, typename Layer>
+std::shared_ptr<Context> make_chained_context(Layer& layer) {
+    auto* chain = current_context_chain<typename DBN::weight>();
+
+    // The contexts of the sub layers must not take the output of the previous layer
+    if (chain && is_utility_layer<Layer>) {
+        chain->memory = nullptr;
+    }
+
+    auto context = std::make_shared<Context>(layer);
+
+    if (chain) {
+        if constexpr (has_context_buffers<Context>::value && !is_in_place_context<Context>::value && !has_sub_contexts<Context>::value) {
+            chain->memory = context->output.memory_start();
+            chain->size   = etl::size(context->output);
+        } else {
+            chain->memory = nullptr;
+        }
+    }
+
+    return context;
+}
+
+/*!
+ * \brief Build the context for a DBN for the given sequence of layers.
+ *
+ * The contexts are built in the order of the layers, the input of a
+ * context can be the output of the previous one (see context_chain).
+ *
+ * \param dbn The DBN to build the context from
+ */
+template<template<typename, typename, size_t> typename Context, typename DBN, size_t... I>
+auto build_context(DBN& dbn, std::index_sequence<I...> /*seq*/){
+    using context_t = std::tuple<std::pair<decltype(dbn.template layer_get<I>()), std::shared_ptr<Context<DBN, typename DBN::template layer_type<I>, I>>>...>;
+
+    // The elements of a braced list are evaluated in order
+    return context_t{
+        {
+            dbn.template layer_get<I>(), // Reference to the layer
+            make_chained_context<DBN, Context<DBN, typename DBN::template layer_type<I>, I>>(dbn.template layer_get<I>())
+        }...
+    };
+}
+
+/*!
+ * \brief Build the context for a DBN
+ * \param dbn The DBN to build the context from
+ */
+template<template<typename, typename, size_t> typename Context, typename DBN>
+auto build_context(DBN& dbn){
+    return build_context<Context>(dbn, std::make_index_sequence<DBN::layers>());
+}
+
+/*!
+ * \brief A view of a network with a different batch size or a different
+ * updater.
+ *
+ * This is used to build the contexts of the micro-batches in
+ * data-parallel mode and the contexts of the workers of the parameter
+ * server, the layers remain the ones of the network.
+ *
+ * \tparam DBN The network
+ * \tparam B The batch size of the view
+ * \tparam UT The updater type of the view
+ */
+template <typename DBN, size_t B, updater_type UT = DBN::updater>
+struct micro_batch_network {
+    using weight = typename DBN::weight; ///< The data type of the network
+
+    template <size_t I>
+    using layer_type = typename DBN::template layer_type<I>; ///< The type of the Ith layer
+
+    static constexpr size_t layers     = DBN::layers; ///< The number of layers
+    static constexpr size_t batch_size = B;           ///< The batch size
+    static constexpr auto updater      = UT;          ///< The updater type
+    static constexpr auto loss         = DBN::loss;   ///< The loss function
+};
+
+/*!
+ * \brief Build the context for a view of a DBN for the given sequence of
+ * layers
+ * \param dbn The DBN to build the context from
+ */
+template<template<typename, typename, size_t> typename Context, typename View, typename DBN, size_t... I>
+auto build_view_context(DBN& dbn, std::index_sequence<I...> /*seq*/){
+    return std::make_tuple
+        (
+            (std::make_pair(
+                std::ref(dbn.template layer_get<I>()),  // Reference to the layer
+                std::make_shared<Context<View, typename DBN::template layer_type<I>, I>>(dbn.template layer_get<I>()))
+            )...
+        );
+}
+
+/*!
+ * \brief Build the context of a micro-batch of size B for a DBN for the
+ * given sequence of layers
+ * \param dbn The DBN to build the context from
+ */
+template<template<typename, typename, size_t> typename Context, size_t B, typename DBN, size_t... I>
+auto build_micro_context(DBN& dbn, std::index_sequence<I...> seq){
+    return build_view_context<Context, micro_batch_network<DBN, B>>(dbn, seq);
+}
+
+/*!
+ * \brief Build the context of a micro-batch of size B for a DBN
+ * \param dbn The DBN to build the context from
+ */
+template<template<typename, typename, size_t> typename Context, size_t B, typename DBN>
+auto build_micro_context(DBN& dbn){
+    if constexpr (B == DBN::batch_size) {
+        return build_context<Context>(dbn);
+    } else {
+        return build_micro_context<Context, B>(dbn, std::make_index_sequence<DBN::layers>());
+    }
+}
+
+} //end of dll namespace
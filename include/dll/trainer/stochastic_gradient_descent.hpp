@@ -15,547 +15,584 @@
 
 #pragma once
 
-#include "cpp_utils/tuple_utils.hpp"
+#include <optional>
 
-#include "dll/trainer/context_fwd.hpp" // For sgd_context
-#include "dll/util/checks.hpp"         // For NaN checks
-#include "dll/util/timers.hpp"         // For auto_timer
+#include "cpp_utils/tuple_utils.hpp"
+#include "cpp_utils/maybe_parallel.hpp"
+
+#include "dll/trainer/sgd_context.hpp"  // For the contexts
+#include "dll/util/checks.hpp"          // For NaN checks
+#include "dll/util/timers.hpp"          // For auto_timer
+#include "dll/util/sparse_rows.hpp"     // For sparse gradients
+#include "dll/util/memory.hpp"          // For memory_bytes
+#include "dll/util/softmax_cce.hpp"     // For the fused softmax
+#include "dll/util/fused_losses.hpp"    // For the fused MSE and BCE
+#include "dll/util/affinity.hpp"        // For the execution policy
+#include "dll/util/scratch_arena.hpp"   // For the temporaries
+#include "dll/util/scheduler.hpp"       // For the merge branches
+#include "dll/util/pipeline_stages.hpp" // For the pipeline stages
+#include "dll/util/conv_pool.hpp"       // For the fused convolution and pooling
+#include "dll/util/compact_model.hpp"   // For the bfloat16 activations
 
 namespace dll {
 
-template <typename Layer>
-static constexpr bool is_group_layer = cpp::is_specialization_of_v<dll::group_layer_impl, Layer> || cpp::is_specialization_of_v<dll::dyn_group_layer_impl, Layer>;
+/*!
+ * \brief Simple gradient descent trainer
+ */
+template <typename DBN>
+struct sgd_trainer {
+    using dbn_t     = DBN;                    ///< The type of DBN being trained
+    using weight    = typename dbn_t::weight; ///< The data type for this layer
+    using this_type = sgd_trainer<dbn_t>;     ///< The type of this layer
 
-template <typename Layer>
-static constexpr bool is_merge_layer = cpp::is_specialization_of_v<dll::merge_layer_impl, Layer> || cpp::is_specialization_of_v<dll::dyn_merge_layer_impl, Layer>;
+    static constexpr auto layers     = dbn_t::layers;     ///< The number of layers
+    static constexpr auto batch_size = dbn_t::batch_size; ///< The batch size for training
 
-template <typename Layer>
-static constexpr bool is_utility_layer = is_group_layer<Layer> || is_merge_layer<Layer>;
+    static constexpr size_t micro_batches    = dbn_traits<dbn_t>::micro_batches();               ///< The number of micro-batches
+    static constexpr size_t micro_batch_size = (batch_size + micro_batches - 1) / micro_batches; ///< The size of a micro-batch
 
-/*!
- * \brief Build the sub context for a updater context
- *
- * \param layer The layer to build the context for
- */
-template <template <typename, size_t, updater_type> typename SubContext, updater_type UT, typename Layer, size_t... I>
-auto build_sub_context(const Layer& layer, std::index_sequence<I...> /*seq*/) {
-    return std::make_tuple
-        (
-            std::make_shared<SubContext<Layer, I, UT>>(layer)...
-        );
-}
+    static constexpr size_t accumulated_batches = dbn_traits<dbn_t>::accumulated_batches(); ///< The number of batches accumulated before each update
+    static constexpr size_t checkpoint_every    = dbn_traits<dbn_t>::checkpoint_every();    ///< The distance between two checkpointed layers
 
-/*!
- * \brief Build the sub context for a updater context
- *
- * \param layer The layer to build the context for
- */
-template <template <typename, size_t, updater_type> typename SubContext, updater_type UT, typename Layer>
-auto build_sub_context(const Layer& layer) {
-    static constexpr size_t N = std::tuple_size<decltype(std::declval<Layer>().trainable_parameters())>();
+    static constexpr size_t stages = std::min(dbn_traits<dbn_t>::pipeline_stages(), size_t(layers)); ///< The number of stages of the pipeline
 
-    return build_sub_context<SubContext, UT>(layer, std::make_index_sequence<N>());
-}
+    static constexpr bool flat_parameters = dbn_traits<dbn_t>::flat_parameters(); ///< Indicates if the gradients and the state of the updater are contiguous
 
-/*!
- * \brief The sub context for a specific updater
- * \param Layer The layer to optimize
- * \param I The index of the variable to optimize
- * \param UT The updater type
- */
-template<typename Layer, size_t I, updater_type UT>
-struct updater_sub_context;
+#ifdef ETL_GPU
+    static constexpr bool gpu_resident = true; ///< Indicates if the training stays on the GPU (full GPU support of ETL)
+#else
+    static constexpr bool gpu_resident = false; ///< Indicates if the training stays on the GPU (full GPU support of ETL)
+#endif
 
-/*!
- * \brief Specialization of updater_sub_context for SGD updater
- */
-template<typename Layer, size_t I>
-struct updater_sub_context <Layer, I, updater_type::SGD> {
-    /*!
-     * \brief The type of the variable to optimize
-     */
-    using type = std::remove_reference_t<decltype(std::get<I>(std::declval<Layer>().trainable_parameters()))>;
+    static constexpr bool compressed_activations = dbn_traits<dbn_t>::compressed_activations() && !gpu_resident; ///< Indicates if the activations are compressed between the forward and the backward passes
 
-    type grad; ///< The gradients of the variable
+    using context_t       = decltype(build_context<full_sgd_context>(std::declval<dbn_t&>()));                           ///< The type of the context
+    using micro_context_t = decltype(build_micro_context<full_sgd_context, micro_batch_size>(std::declval<dbn_t&>())); ///< The type of the context of a micro-batch
+
+    using input_t = std::decay_t<decltype(std::get<0>(std::declval<context_t&>()).second->input)>;           ///< The type of a batch of inputs
+    using label_t = std::decay_t<decltype(std::get<layers - 1>(std::declval<context_t&>()).second->output)>; ///< The type of a batch of labels
+
+    using last_layer_t         = std::decay_t<decltype(std::get<layers - 1>(std::declval<context_t&>()).first)>;         ///< The type of the last layer
+    using last_context_t       = std::decay_t<decltype(*std::get<layers - 1>(std::declval<context_t&>()).second)>;       ///< The type of the context of the last layer
+    using last_micro_context_t = std::decay_t<decltype(*std::get<layers - 1>(std::declval<micro_context_t&>()).second)>; ///< The type of the context of the last layer of a micro-batch
 
     /*!
-     * \brief Construct the sub_context for the given layer
-     * \param layer The layer to build the context for
+     * \brief Indicates if the softmax of the last layer is fused with the
+     * categorical cross-entropy.
+     *
+     * In that case, the last layer only computes its logits during
+     * training and softmax_cce computes the probabilities, the errors and
+     * the metrics of the batch in one go.
+     *
+     * The fused kernel runs on the host, it is not used when the training
+     * stays on the GPU.
      */
-    updater_sub_context(const Layer& layer) : grad(std::get<I>(layer.trainable_parameters())) {
-        grad = 0;
+    static constexpr bool fused_softmax_cce() {
+        if constexpr (!gpu_resident && dbn_t::loss == loss_function::CATEGORICAL_CROSS_ENTROPY && checkpoint_every <= 1 && has_forward_logits<last_layer_t, last_context_t>::value) {
+            return last_layer_t::activation_function == function::SOFTMAX;
+        } else {
+            return false;
+        }
     }
-};
 
-/*!
- * \brief Specialization of updater_sub_context for momentum updater
- */
-template<typename Layer, size_t I>
-struct updater_sub_context <Layer, I, updater_type::MOMENTUM> {
     /*!
-     * \brief The type of the variable to optimize
+     * \brief Indicates if the errors of the given context can be computed
+     * by the fused kernels of the MSE and BCE losses
      */
-    using type = std::remove_reference_t<decltype(std::get<I>(std::declval<Layer>().trainable_parameters()))>;
-
-    type grad; ///< The gradients of the variable
-    type inc;  ///< The accumulated momentum cache
+    template <typename Context>
+    static constexpr bool fused_loss_context() {
+        return !gpu_resident && etl::all_dma<decltype(std::declval<Context&>().output), decltype(std::declval<Context&>().errors)>;
+    }
 
     /*!
-     * \brief Construct the sub_context for the given layer
-     * \param layer The layer to build the context for
+     * \brief Indicates if the metrics of the batch are computed together
+     * with the errors of the last layer (by the fused softmax or by the
+     * fused MSE and BCE kernels), instead of being computed again from the
+     * outputs after the backward pass.
      */
-    updater_sub_context(const Layer& layer) : grad(std::get<I>(layer.trainable_parameters())), inc(grad) {
-        grad = 0;
-        inc = 0;
+    static constexpr bool fused_metrics() {
+        if constexpr (dbn_t::loss == loss_function::CATEGORICAL_CROSS_ENTROPY) {
+            return fused_softmax_cce();
+        } else {
+            return checkpoint_every <= 1 && fused_loss_context<last_context_t>();
+        }
     }
-};
 
-/*!
- * \brief Specialization of updater_sub_context for Nesterov Accelerated Gradients updater
- */
-template<typename Layer, size_t I>
-struct updater_sub_context <Layer, I, updater_type::NESTEROV> {
     /*!
-     * \brief The type of the variable to optimize
+     * \brief Indicates if the given context is the one of the last layer,
+     * forwarded only up to its logits
      */
-    using type = std::remove_reference_t<decltype(std::get<I>(std::declval<Layer>().trainable_parameters()))>;
-
-    type grad;     ///< The gradients of the variable
-    type inc;      ///< The accumulated momentum cache
-    type inc_prev; ///< The previous accumulated momentum cache
+    template <typename Context>
+    static constexpr bool is_logits_context() {
+        return fused_softmax_cce() && (std::is_same_v<Context, last_context_t> || std::is_same_v<Context, last_micro_context_t>);
+    }
 
     /*!
-     * \brief Construct the sub_context for the given layer
-     * \param layer The layer to build the context for
+     * \brief The activations of a layer compressed between the forward and
+     * the backward passes (compressed_activations)
      */
-    updater_sub_context(const Layer& layer) : grad(std::get<I>(layer.trainable_parameters())), inc(grad), inc_prev(grad) {
-        grad = 0;
-        inc = 0;
-        inc_prev = 0;
-    }
-};
+    struct compressed_layer {
+        std::vector<uint64_t> mask;      ///< The signs of the output (RELU layers)
+        std::vector<uint16_t> input;     ///< The input in bfloat16
+        std::vector<size_t> output_dims; ///< The dimensions of the output
+        std::vector<size_t> input_dims;  ///< The dimensions of the input
+        bool output_compressed = false;  ///< Indicates if the signs of the output are in the mask
+        bool output_released   = false;  ///< Indicates if the output is released
+        bool input_compressed  = false;  ///< Indicates if the input is kept in bfloat16
+        bool input_released    = false;  ///< Indicates if the input is released
+        bool input_shared      = false;  ///< Indicates if the input is a view of the output of the previous layer
+    };
 
-/*!
- * \brief Specialization of updater_sub_context for RMSPROP updater
- */
-template<typename Layer, size_t I>
-struct updater_sub_context <Layer, I, updater_type::RMSPROP> {
     /*!
-     * \brief The type of the variable to optimize
+     * \brief The buffers used to stage the next batch while the current
+     * batch is trained (stage_inputs)
      */
-    using type = std::remove_reference_t<decltype(std::get<I>(std::declval<Layer>().trainable_parameters()))>;
+    struct staging_buffers {
+        input_t inputs;         ///< The staged inputs
+        label_t labels;         ///< The staged labels
+        label_t current_labels; ///< The labels of the batch being trained
+        size_t n         = 0;   ///< The number of staged samples
+        size_t current_n = 0;   ///< The number of samples of the batch being trained
+    };
+
+    dbn_t& dbn;                                  ///< The DBN being trained
+    std::unique_ptr<flat_storage<weight>> flat;  ///< The storage of the gradients and of the state of the updater (flat_parameters)
+    context_t full_context;                      ///< The context
+    std::vector<micro_context_t> micro_contexts; ///< The contexts of the micro-batches (data-parallel mode)
+    size_t iteration;                            ///< The current iteration
+    size_t max_epochs = 0;                       ///< The number of epochs of the training (learning rate schedules)
+
+    std::vector<etl::dyn_vector<weight>> accumulated_grads; ///< The accumulated gradients of each variable (grad_accumulate)
+    size_t accumulated    = 0;                              ///< The number of batches currently accumulated
+    size_t accumulated_n  = 0;                              ///< The number of samples currently accumulated
+    size_t last_epoch     = 0;                              ///< The epoch of the last accumulated batch
+    size_t scaled_updates = 0;                              ///< The number of updates since the last change of the loss scale (loss_scaling)
+
+    std::vector<std::vector<size_t>> checkpoint_dims; ///< The dimensions of the input, output and errors of each layer (checkpoint)
+    std::vector<compressed_layer> compressed;         ///< The compressed activations of each layer (compressed_activations)
+
+    size_t frozen_prefix = 0; ///< The number of leading frozen layers of the current batch
+    size_t cached_prefix = 0; ///< The number of leading layers whose outputs are given as inputs (feature cache)
+
+    std::unique_ptr<staging_buffers> staging; ///< The staging buffers (stage_inputs)
+
+    std::vector<size_t> stage_of;                  ///< The stage of each layer (pipeline_stages)
+    std::unique_ptr<stage_workers> stage_threads;  ///< The threads of the stages (pipeline_stages)
+    std::unique_ptr<stage_progress> forward_done;  ///< The micro-batches forwarded by each stage (pipeline_stages)
+    std::unique_ptr<stage_progress> backward_done; ///< The micro-batches backpropagated by each stage (pipeline_stages)
 
-    type grad; ///< The gradients of the variable
-    type inc;  ///< The accumulated squared gradients
+    // Transform layers need to inherit dimensions from back
 
     /*!
-     * \brief Construct the sub_context for the given layer
-     * \param layer The layer to build the context for
+     * \brief Inherit the layer dimensions from front
      */
-    updater_sub_context(const Layer& layer) : grad(std::get<I>(layer.trainable_parameters())), inc(grad) {
-        grad = 0;
-        inc = 0;
+    template<typename L1, typename L2, cpp_enable_iff(decay_layer_traits<typename L2::first_type>::is_transform_layer())>
+    static void inherit_from_front(L1& l1, L2& l2){
+        auto& ctx1 = *l1.second;
+        auto& ctx2 = *l2.second;
+
+        if (ctx2.errors.size() == 0) {
+            ctx2.output = ctx1.output;
+            ctx2.errors = ctx1.output;
+            ctx2.input  = ctx1.output;
+        }
     }
-};
 
-/*!
- * \brief Specialization of updater_sub_context for Adagrad updater
- */
-template<typename Layer, size_t I>
-struct updater_sub_context <Layer, I, updater_type::ADAGRAD> {
     /*!
-     * \brief The type of the variable to optimize
+     * \brief Inherit the layer dimensions from front
      */
-    using type = std::remove_reference_t<decltype(std::get<I>(std::declval<Layer>().trainable_parameters()))>;
-
-    type grad; ///< The gradients of the variable
-    type inc;  ///< Accumulated gradients for adagrad
+    template<typename L1, typename L2, cpp_disable_iff(decay_layer_traits<typename L2::first_type>::is_transform_layer())>
+    static void inherit_from_front(L1& /*l1*/, L2& /*l2*/){ }
 
     /*!
-     * \brief Construct the sub_context for the given layer
-     * \param layer The layer to build the context for
+     * \brief construct a new sgd_trainer
+     * \param dbn The DBN being trained
      */
-    updater_sub_context(const Layer& layer) : grad(std::get<I>(layer.trainable_parameters())), inc(grad) {
-        grad = 0;
-        inc = 0;
-    }
-};
+    explicit sgd_trainer(dbn_t& dbn) : dbn(dbn), full_context(build_full_context(dbn)), iteration(1) {
+        inherit_dimensions(full_context);
 
-/*!
- * \brief Specialization of updater_sub_context for Adadelta updater
- */
-template<typename Layer, size_t I>
-struct updater_sub_context <Layer, I, updater_type::ADADELTA> {
-    /*!
-     * \brief The type of the variable to optimize
-     */
-    using type = std::remove_reference_t<decltype(std::get<I>(std::declval<Layer>().trainable_parameters()))>;
+        if constexpr (!dbn_traits<dbn_t>::is_serial()) {
+            share_branch_scheduler(full_context);
+        }
 
-    type grad; ///< The gradients of the variable
-    type g;
-    type x;
-    type v;
+        if (execution().huge_pages) {
+            advise_context_huge_pages(full_context);
+        }
 
-    /*!
-     * \brief Construct the sub_context for the given layer
-     * \param layer The layer to build the context for
-     */
-    updater_sub_context(const Layer& layer) : grad(std::get<I>(layer.trainable_parameters())), g(grad), x(grad), v(grad) {
-        grad = 0;
-        g = 0;
-        x = 0;
-        v = 0;
-    }
-};
+        if constexpr (micro_batches > 1) {
+            std::vector<std::optional<micro_context_t>> replicas(micro_batches);
 
-/*!
- * \brief The context for the Adam updater
- */
-template<typename Layer, size_t I>
-struct updater_sub_context <Layer, I, updater_type::ADAM> {
-    /*!
-     * \brief The type of the variable to optimize
-     */
-    using type = std::remove_reference_t<decltype(std::get<I>(std::declval<Layer>().trainable_parameters()))>;
+            auto build_replica = [this, &dbn, &replicas](size_t r) {
+                replicas[r].emplace(build_micro_context<full_sgd_context, micro_batch_size>(dbn));
 
-    type grad; ///< The gradients of the variable
-    type m;    ///< Estimates of the first moment of the gradient
-    type v;    ///< Estimates of the second moment of the gradient
+                inherit_dimensions(*replicas[r]);
 
-    /*!
-     * \brief Construct the sub_context for the given layer
-     * \param layer The layer to build the context for
-     */
-    updater_sub_context(const Layer& layer) : grad(std::get<I>(layer.trainable_parameters())), m(grad), v(grad) {
-        grad = 0;
-        m = 0;
-        v = 0;
+                if (execution().huge_pages) {
+                    advise_context_huge_pages(*replicas[r]);
+                }
+            };
+
+            // With a pinned pool, the replicas are first touched by the
+            // workers, and therefore allocated on their NUMA nodes
+
+            if (execution().pool != affinity_type::NONE) {
+                cpp::maybe_parallel_foreach_n(dbn.get_thread_pool(), 0, micro_batches, build_replica);
+            } else {
+                for (size_t r = 0; r < micro_batches; ++r) {
+                    build_replica(r);
+                }
+            }
+
+            for (auto& replica : replicas) {
+                micro_contexts.push_back(std::move(*replica));
+            }
+        }
+
+        if constexpr (stages > 1) {
+            std::vector<size_t> costs;
+
+            cpp::for_each(full_context, [&costs](auto& layer_ctx) {
+                using layer_t = std::decay_t<decltype(layer_ctx.first)>;
+
+                if constexpr (decay_layer_traits<layer_t>::is_neural_layer()) {
+                    costs.push_back(1 + layer_ctx.first.parameters());
+                } else {
+                    costs.push_back(1);
+                }
+            });
+
+            stage_of      = partition_stages(costs, stages);
+            stage_threads = std::make_unique<stage_workers>(stages);
+            forward_done  = std::make_unique<stage_progress>(stages);
+            backward_done = std::make_unique<stage_progress>(stages);
+        }
+
+        if constexpr (checkpoint_every > 1) {
+            checkpoint_dims.resize(3 * layers);
+
+            init_checkpoints(std::make_index_sequence<layers>());
+        }
+
+        if constexpr (compressed_activations) {
+            compressed.resize(layers);
+        }
+
+        if constexpr (dbn_traits<dbn_t>::stage_inputs()) {
+            staging = std::make_unique<staging_buffers>();
+
+            staging->inputs         = std::get<0>(full_context).second->input;
+            staging->labels         = std::get<layers - 1>(full_context).second->output;
+            staging->current_labels = staging->labels;
+        }
     }
-};
 
-/*!
- * \brief The context for the Adam updater with bias correction
- */
-template<typename Layer, size_t I>
-struct updater_sub_context <Layer, I, updater_type::ADAM_CORRECT> {
     /*!
-     * \brief The type of the variable to optimize
+     * \brief Build the context of the network.
+     *
+     * With flat_parameters, the gradients and the state of the updater of
+     * all the layers are taken from the flat storage of the trainer.
+     *
+     * The inputs of the contexts that support it are views of the outputs
+     * of the previous contexts, unless the activations are checkpointed
+     * (released separately) or the training stays on the GPU.
      */
-    using type = std::remove_reference_t<decltype(std::get<I>(std::declval<Layer>().trainable_parameters()))>;
+    context_t build_full_context(dbn_t& dbn) {
+        context_chain<weight> chain;
 
-    type grad; ///< The gradients of the variable
-    type m;    ///< Estimates of the first moment of the gradient
-    type mt;   ///< Corrected estimates of the first moment of the gradient
-    type v;    ///< Estimates of the second moment of the gradient
-    type vt;   ///< Corrected estimates of the second moment of the gradient
+        if constexpr (checkpoint_every <= 1 && !gpu_resident) {
+            current_context_chain<weight>() = &chain;
+        }
 
-    /*!
-     * \brief Construct the sub_context for the given layer
-     * \param layer The layer to build the context for
-     */
-    updater_sub_context(const Layer& layer) : grad(std::get<I>(layer.trainable_parameters())), m(grad), mt(grad), v(grad), vt(grad) {
-        grad = 0;
-        m = 0;
-        mt = 0;
-        v = 0;
-        vt = 0;
+        auto context = build_flat_context(dbn);
+
+        current_context_chain<weight>() = nullptr;
+
+        return context;
     }
-};
 
-/*!
- * \brief The context for the Nesterov Adam (NAdam) updater with bias correction
- */
-template<typename Layer, size_t I>
-struct updater_sub_context <Layer, I, updater_type::NADAM> {
     /*!
-     * \brief The type of the variable to optimize
+     * \brief Build the context of the network, with the flat storage of
+     * the trainer if necessary
      */
-    using type = std::remove_reference_t<decltype(std::get<I>(std::declval<Layer>().trainable_parameters()))>;
+    context_t build_flat_context(dbn_t& dbn) {
+        if constexpr (flat_parameters) {
+            size_t size = 0;
 
-    type grad; ///< The gradients of the variable
-    type m;    ///< Estimates of the first moment of the gradient
-    type mt;   ///< Corrected estimates of the first moment of the gradient
-    type v;    ///< Estimates of the second moment of the gradient
-    type vt;   ///< Corrected estimates of the second moment of the gradient
+            dbn.for_each_layer([&size](auto& layer) {
+                size += this_type::flat_size(layer);
+            });
 
-    double m_schedule;
+            flat = std::make_unique<flat_storage<weight>>(size);
 
-    /*!
-     * \brief Construct the sub_context for the given layer
-     * \param layer The layer to build the context for
-     */
-    updater_sub_context(const Layer& layer) : grad(std::get<I>(layer.trainable_parameters())), m(grad), mt(grad), v(grad), vt(grad) {
-        grad = 0;
-        m = 0;
-        mt = 0;
-        v = 0;
-        vt = 0;
+            current_flat_storage<weight>() = flat.get();
 
-        m_schedule = 1.0;
+            auto context = build_context<full_sgd_context>(dbn);
+
+            current_flat_storage<weight>() = nullptr;
+
+            return context;
+        } else {
+            return build_context<full_sgd_context>(dbn);
+        }
     }
-};
 
-/*!
- * \brief The context for the Adamax updater
- */
-template<typename Layer, size_t I>
-struct updater_sub_context <Layer, I, updater_type::ADAMAX> {
     /*!
-     * \brief The type of the variable to optimize
+     * \brief Returns the number of elements taken by the variables of the
+     * given layer in each slot of the flat storage
      */
-    using type = std::remove_reference_t<decltype(std::get<I>(std::declval<Layer>().trainable_parameters()))>;
+    template <typename Layer>
+    static size_t flat_size(Layer& layer) {
+        size_t size = 0;
+
+        if constexpr (is_utility_layer<Layer>) {
+            cpp::for_each(layer.layers, [&size](auto& sub_layer) {
+                size += this_type::flat_size(sub_layer);
+            });
+        } else if constexpr (decay_layer_traits<Layer>::is_neural_layer()) {
+            std::apply([&size](auto&... w) { ((size += flat_storage<weight>::padded(etl::size(w))), ...); }, layer.trainable_parameters());
+        } else {
+            cpp_unused(layer);
+        }
 
-    type grad; ///< The gradients of the variable
-    type m;    ///< Estimates of the first moment of the gradient
-    type v;    ///< Estimates of the second moment of the gradient
+        return size;
+    }
 
     /*!
-     * \brief Construct the sub_context for the given layer
-     * \param layer The layer to build the context for
+     * \brief Inherit dimensions from front to end (for transform layers)
+     * \param context The context to update
      */
-    updater_sub_context(const Layer& layer) : grad(std::get<I>(layer.trainable_parameters())), m(grad), v(grad) {
-        grad = 0;
-        m = 0;
-        v = 0;
-    }
-};
+    template <typename Context>
+    static void inherit_dimensions(Context& context) {
+        cpp::for_each_pair(context, [](auto& layer_ctx_1, auto& layer_ctx_2) {
+            constexpr bool l2_transform = decay_layer_traits<decltype(layer_ctx_2.first)>::is_transform_layer();
 
+            if (l2_transform) {
+                this_type::inherit_from_front(layer_ctx_1, layer_ctx_2);
+            }
+        });
+    }
 
-/*!
- * \brief The context for the base updater (no update).
- */
-template <updater_type UT, bool Neural, typename Layer>
-struct updater_context {
     /*!
-     * \brief Construct a new updater_context using the parent context
+     * \brief Let the merge layers of the given context run their branches
+     * concurrently on the scheduler.
+     *
+     * The merge layers nested in the branches of a merge layer keep
+     * running their branches serially, since they already run on the
+     * scheduler.
+     *
+     * \param context The context to update
      */
-    updater_context(const Layer& layer) {
-        cpp_unused(layer);
+    template <typename Context>
+    static void share_branch_scheduler(Context& context) {
+        cpp::for_each(context, [](auto& layer_ctx) {
+            this_type::share_branch_scheduler_layer(*layer_ctx.second);
+        });
     }
-};
 
-/*!
- * \brief The context for the real updaters.
- */
-template <updater_type UT, typename Layer>
-struct updater_context<UT, true, Layer> {
     /*!
-     * \brief The context for the updater and for each variable of the layer
+     * \brief Let the given context of a layer run its branches on the
+     * scheduler, if it is a merge layer
+     * \param context The context to update
      */
-    decltype(build_sub_context<updater_sub_context, UT>(std::declval<Layer&>())) context;
+    template <typename Context>
+    static void share_branch_scheduler_layer(Context& context) {
+        using layer_t = typename Context::layer_t;
+
+        if constexpr (is_merge_layer<layer_t>) {
+            context.parallel = true;
+        } else if constexpr (is_group_layer<layer_t>) {
+            cpp::for_each(context.sub_contexts, [](auto& sub_context) {
+                this_type::share_branch_scheduler_layer(sub_context);
+            });
+        }
+    }
 
     /*!
-     * \brief Construct a new updater_context using the parent context
+     * \brief Advise the kernel to back the large buffers of the contexts of
+     * all the layers with transparent huge pages
+     *
+     * The buffers are already touched, their pages are collapsed into huge
+     * pages by the kernel in the background.
+     *
+     * \param context The context of the network
      */
-    updater_context(const Layer& layer) : context(build_sub_context<updater_sub_context, UT>(layer)) {
-        // Nothing else to init
+    template <typename Context>
+    static void advise_context_huge_pages(Context& context) {
+        cpp::for_each(context, [](auto& layer_ctx) {
+            dll::advise_context_huge_pages(*layer_ctx.second);
+        });
     }
-};
-
-/*!
- * \brief The full SGD context, it contains the context of the layer as well as
- * the context for the SGD updater
- */
-template <typename DBN, typename Layer, size_t L>
-struct full_sgd_context : sgd_context<DBN, Layer, L> {
-    using context_type = sgd_context<DBN, Layer, L>; ///< The parent context type
 
     /*!
-     * \brief The updater context
+     * \brief Initialize the training
      */
-    updater_context<DBN::updater, decay_layer_traits<Layer>::is_neural_layer(), Layer> up;
+    void init_training(size_t) {}
 
     /*!
-     * \brief Construct the full_sgd_context for the given layer
+     * \brief Set the number of epochs of the training
+     * \param epochs The number of epochs
      */
-    full_sgd_context(const Layer& layer) : context_type(layer), up(layer) {
-        // Nothing else to init
+    void set_max_epochs(size_t epochs) {
+        max_epochs = epochs;
     }
-};
-
-/*!
- * \brief The full SGD context, it contains the context of the layer as well as
- * the context for the SGD updater
- */
-template <typename DBN, typename... Layers, size_t L>
-struct full_sgd_context <DBN, group_layer_impl<group_layer_desc<Layers...>>, L>  {
-    using layer_t      = group_layer_impl<group_layer_desc<Layers...>>; ///< The layer
-    using context_type = sgd_context<DBN, layer_t, L>;                  ///< The parent context type
-
-    static constexpr size_t n_layers = sizeof...(Layers); ///< The number of layers
-
-    std::tuple<full_sgd_context<DBN, Layers, L>...> sub_contexts; ///< The sub contexts
 
     /*!
-     * \brief Construct the full_sgd_context for the given layer
+     * \brief Returns the memory held by the layers and by the trainer
+     *
+     * For each layer, the parameters, the inputs, outputs and errors of
+     * its context and the gradients and state of the updater are
+     * accounted. The contexts of the micro-batches, the accumulated
+     * gradients and the staging buffers are accounted to the trainer.
      */
-    full_sgd_context(const layer_t& layer) : sub_contexts(layer.layers) {
-        // Nothing else to init
-    }
-};
-
-/*!
- * \brief The full SGD context, it contains the context of the layer as well as
- * the context for the SGD updater
- */
-template <typename DBN, typename... Layers, size_t L>
-struct full_sgd_context <DBN, dyn_group_layer_impl<dyn_group_layer_desc<Layers...>>, L>  {
-    using layer_t      = dyn_group_layer_impl<dyn_group_layer_desc<Layers...>>; ///< The layer
-    using context_type = sgd_context<DBN, layer_t, L>;                  ///< The parent context type
+    memory_report memory_usage() const {
+        memory_report report;
 
-    static constexpr size_t n_layers = sizeof...(Layers); ///< The number of layers
+        cpp::for_each(full_context, [&report](auto& layer_ctx) {
+            using layer_t = std::decay_t<decltype(layer_ctx.first)>;
 
-    std::tuple<full_sgd_context<DBN, Layers, L>...> sub_contexts; ///< The sub contexts
-
-    /*!
-     * \brief Construct the full_sgd_context for the given layer
-     */
-    full_sgd_context(const layer_t& layer) : sub_contexts(layer.layers) {
-        // Nothing else to init
-    }
-};
+            layer_memory layer;
 
-/*!
- * \brief The full SGD context, it contains the context of the layer as well as
- * the context for the SGD updater
- */
-template <typename DBN, size_t D, typename... Layers, size_t L>
-struct full_sgd_context<DBN, merge_layer_impl<merge_layer_desc<D, Layers...>>, L> : sgd_context<DBN, merge_layer_impl<merge_layer_desc<D, Layers...>>, L> {
-    using layer_t      = merge_layer_impl<merge_layer_desc<D, Layers...>>; ///< The layer
-    using context_type = sgd_context<DBN, layer_t, L>;                     ///< The parent context type
+            if constexpr (decay_layer_traits<layer_t>::is_neural_layer()) {
+                layer.parameters = layer_ctx.first.parameters() * sizeof(weight);
+            }
 
-    static constexpr size_t n_layers = sizeof...(Layers); ///< The number of layers
+            layer.context = context_memory(*layer_ctx.second);
+            layer.updater = updater_memory(*layer_ctx.second);
 
-    std::tuple<full_sgd_context<DBN, Layers, L>...> sub_contexts; ///< The sub contexts
+            report.layers.push_back(layer);
+        });
 
-    /*!
-     * \brief Construct the full_sgd_context for the given layer
-     */
-    full_sgd_context(const layer_t& layer) : context_type(layer), sub_contexts(layer.layers) {
-        // Nothing else to init
-    }
-};
+        for (auto& micro_context : micro_contexts) {
+            cpp::for_each(micro_context, [&report](auto& layer_ctx) {
+                report.trainer += context_memory(*layer_ctx.second) + updater_memory(*layer_ctx.second);
+            });
+        }
 
-/*!
- * \brief The full SGD context, it contains the context of the layer as well as
- * the context for the SGD updater
- */
-template <typename DBN, size_t D, typename... Layers, size_t L>
-struct full_sgd_context<DBN, dyn_merge_layer_impl<dyn_merge_layer_desc<D, Layers...>>, L> : sgd_context<DBN, dyn_merge_layer_impl<dyn_merge_layer_desc<D, Layers...>>, L> {
-    using layer_t      = dyn_merge_layer_impl<dyn_merge_layer_desc<D, Layers...>>; ///< The layer
-    using context_type = sgd_context<DBN, layer_t, L>;                     ///< The parent context type
+        report.trainer += memory_bytes(accumulated_grads);
 
-    static constexpr size_t n_layers = sizeof...(Layers); ///< The number of layers
+        if (staging) {
+            report.trainer += memory_bytes(staging->inputs, staging->labels, staging->current_labels);
+        }
 
-    std::tuple<full_sgd_context<DBN, Layers, L>...> sub_contexts; ///< The sub contexts
+        return report;
+    }
 
     /*!
-     * \brief Construct the full_sgd_context for the given layer
+     * \brief Write the state of the trainer: the counter of iterations, the
+     * gradients being accumulated and the state of the updater of each
+     * layer (momentum, moments, ...).
      */
-    full_sgd_context(const layer_t& layer) : context_type(layer), sub_contexts(layer.layers) {
-        // Nothing else to init
-    }
-};
-
-/*!
- * \brief Build the context for a DBN for the given sequence of layers
- * \param dbn The DBN to build the context from
- */
-template<template<typename, typename, size_t> typename Context, typename DBN, size_t... I>
-auto build_context(DBN& dbn, std::index_sequence<I...> /*seq*/){
-    return std::make_tuple
-        (
-            (std::make_pair(
-                std::ref(dbn.template layer_get<I>()),  // Reference to the layer
-                std::make_shared<Context<DBN, typename DBN::template layer_type<I>, I>>(dbn.template layer_get<I>()))
-            )...
-        );
-}
-
-/*!
- * \brief Build the context for a DBN
- * \param dbn The DBN to build the context from
- */
-template<template<typename, typename, size_t> typename Context, typename DBN>
-auto build_context(DBN& dbn){
-    return build_context<Context>(dbn, std::make_index_sequence<DBN::layers>());
-}
-
-/*!
- * \brief Simple gradient descent trainer
- */
-template <typename DBN>
-struct sgd_trainer {
-    using dbn_t     = DBN;                    ///< The type of DBN being trained
-    using weight    = typename dbn_t::weight; ///< The data type for this layer
-    using this_type = sgd_trainer<dbn_t>;     ///< The type of this layer
+    void store_state(std::ostream& os) const {
+        state_write(os, uint64_t(iteration));
+        state_write(os, uint64_t(scaled_updates));
+        state_write(os, uint64_t(accumulated));
+        state_write(os, uint64_t(accumulated_n));
+        state_write(os, uint64_t(last_epoch));
 
-    static constexpr auto layers     = dbn_t::layers;     ///< The number of layers
-    static constexpr auto batch_size = dbn_t::batch_size; ///< The batch size for training
+        state_write(os, uint64_t(accumulated_grads.size()));
 
-    dbn_t& dbn;                                                  ///< The DBN being trained
-    decltype(build_context<full_sgd_context>(dbn)) full_context; ///< The context
-    size_t iteration;                                            ///< The current iteration
+        for (auto& grad : accumulated_grads) {
+            store_buffers(os, grad);
+        }
 
-    // Transform layers need to inherit dimensions from back
+        cpp::for_each(full_context, [&os](auto& layer_ctx) {
+            store_updater_state(os, *layer_ctx.second);
+        });
+    }
 
     /*!
-     * \brief Inherit the layer dimensions from front
+     * \brief Read the state of the trainer written by store_state
+     * \return true if the state was read, false otherwise
      */
-    template<typename L1, typename L2, cpp_enable_iff(decay_layer_traits<typename L2::first_type>::is_transform_layer())>
-    static void inherit_from_front(L1& l1, L2& l2){
-        auto& ctx1 = *l1.second;
-        auto& ctx2 = *l2.second;
+    bool load_state(std::istream& is) {
+        uint64_t values[6];
 
-        if (ctx2.errors.size() == 0) {
-            ctx2.output = ctx1.output;
-            ctx2.errors = ctx1.output;
-            ctx2.input  = ctx1.output;
+        for (auto& value : values) {
+            if (!state_read(is, value)) {
+                return false;
+            }
         }
-    }
 
-    /*!
-     * \brief Inherit the layer dimensions from front
-     */
-    template<typename L1, typename L2, cpp_disable_iff(decay_layer_traits<typename L2::first_type>::is_transform_layer())>
-    static void inherit_from_front(L1& /*l1*/, L2& /*l2*/){ }
+        iteration      = values[0];
+        scaled_updates = values[1];
+        accumulated    = values[2];
+        accumulated_n  = values[3];
+        last_epoch     = values[4];
 
-    /*!
-     * \brief construct a new sgd_trainer
-     * \param dbn The DBN being trained
-     */
-    explicit sgd_trainer(dbn_t& dbn) : dbn(dbn), full_context(build_context<full_sgd_context>(dbn)), iteration(1) {
-        // Inherit dimensions from front to end (for transform layers)
+        accumulated_grads.clear();
 
-        cpp::for_each_pair(full_context, [](auto& layer_ctx_1, auto& layer_ctx_2) {
-            constexpr bool l2_transform = decay_layer_traits<decltype(layer_ctx_2.first)>::is_transform_layer();
+        bool ok = true;
 
-            if (l2_transform) {
-                this_type::inherit_from_front(layer_ctx_1, layer_ctx_2);
+        for (size_t v = 0; ok && v < values[5]; ++v) {
+            uint64_t n = 0;
+
+            ok = state_read(is, n);
+
+            if (ok) {
+                accumulated_grads.emplace_back(n);
+                ok = bool(is.read(reinterpret_cast<char*>(accumulated_grads.back().memory_start()), n * sizeof(weight)));
             }
+        }
+
+        cpp::for_each(full_context, [&is, &ok](auto& layer_ctx) {
+            ok = ok && load_updater_state(is, *layer_ctx.second);
         });
+
+        return ok;
     }
 
     /*!
-     * \brief Initialize the training
+     * \brief Finish an epoch of training
+     *
+     * The gradients of an incomplete accumulation are applied so that
+     * no batch is lost at the end of the epoch.
      */
-    void init_training(size_t) {}
+    void finish_epoch() {
+        if constexpr (accumulated_batches > 1) {
+            if (accumulated) {
+                size_t v = 0;
+
+                cpp::for_each(full_context, [this, &v](auto& layer_ctx) {
+                    this_type::for_each_gradient(layer_ctx.first, *layer_ctx.second, [this, &v](auto& grad) {
+                        this_type::restore_gradient(grad, accumulated_grads[v++]);
+                    });
+                });
+
+                update_accumulated(last_epoch);
+            }
+        }
+    }
 
     // CPP17 Replace SFINAE with if constexpr
 
     /*!
      * \brief Compute the errors of the last layer given the loss function
+     *
+     * When the softmax is fused with the loss, the output of the last layer
+     * holds its logits, which are replaced by the probabilities, and the
+     * (unnormalized) error and loss of the batch are stored in metrics, if
+     * given.
      */
-    template<loss_function F, typename Labels, cpp_enable_iff(F == loss_function::CATEGORICAL_CROSS_ENTROPY)>
-    void last_errors(bool full_batch, size_t n, const Labels& labels){
-        auto& last_ctx   = *std::get<layers - 1>(full_context).second;
+    template<loss_function F, typename Context, typename Labels, cpp_enable_iff(F == loss_function::CATEGORICAL_CROSS_ENTROPY)>
+    void last_errors(Context& context, bool full_batch, size_t n, const Labels& labels, std::pair<double, double>* metrics = nullptr){
+        auto& last_ctx   = *std::get<layers - 1>(context).second;
 
-        if (cpp_unlikely(!full_batch)) {
-            last_ctx.errors = 0;
+        if constexpr (is_logits_context<std::decay_t<decltype(last_ctx)>>()) {
+            dll::auto_timer timer("sgd::softmax_cce");
 
-            for (size_t i = 0; i < n; ++i) {
-                last_ctx.errors(i) = labels(i) - last_ctx.output(i);
+            auto batch_metrics = softmax_cce(last_ctx.output, labels, last_ctx.errors, n);
+
+            if (cpp_unlikely(!full_batch)) {
+                clear_tail(last_ctx.errors, n);
+            }
+
+            if (metrics) {
+                *metrics = batch_metrics;
             }
+        } else if (cpp_unlikely(!full_batch)) {
+            etl::slice(last_ctx.errors, 0, n) = labels - etl::slice(last_ctx.output, 0, n);
+
+            clear_tail(last_ctx.errors, n);
         } else {
             last_ctx.errors = labels - last_ctx.output;
         }
@@ -563,132 +600,1643 @@ struct sgd_trainer {
         // Note: No need to multiply by the derivative of
         // the activation function since the terms are
         // canceling out in the derivative of the loss
+
+        scale_errors(last_ctx);
     }
 
     /*!
-     * \brief Compute the errors of the last layer given the loss function
+     * \brief Compute the errors of the last layer with the fused kernel of
+     * the loss, along with the (unnormalized) error and loss of the batch
+     * if metrics is given
      */
-    template<loss_function F, typename Labels, cpp_enable_iff(F == loss_function::MEAN_SQUARED_ERROR)>
-    void last_errors(bool full_batch, size_t n, const Labels& labels){
-        auto& last_layer = std::get<layers - 1>(full_context).first;
-        auto& last_ctx   = *std::get<layers - 1>(full_context).second;
+    template<loss_function F, typename LastContext, typename Labels>
+    static void fused_last_errors(LastContext& last_ctx, bool full_batch, size_t n, const Labels& labels, std::pair<double, double>* metrics){
+        if (metrics) {
+            *metrics = fused_loss_errors<F, true>(last_ctx.output, labels, last_ctx.errors, n);
+        } else {
+            fused_loss_errors<F, false>(last_ctx.output, labels, last_ctx.errors, n);
+        }
 
         if (cpp_unlikely(!full_batch)) {
-            last_ctx.errors = 0;
+            clear_tail(last_ctx.errors, n);
+        }
+    }
+
+    /*!
+     * \brief Compute the errors of the last layer given the loss function
+     *
+     * The error and loss of the batch are computed together with the
+     * errors and stored in metrics, if given.
+     */
+    template<loss_function F, typename Context, typename Labels, cpp_enable_iff(F == loss_function::MEAN_SQUARED_ERROR)>
+    void last_errors(Context& context, bool full_batch, size_t n, const Labels& labels, std::pair<double, double>* metrics = nullptr){
+        auto& last_layer = std::get<layers - 1>(context).first;
+        auto& last_ctx   = *std::get<layers - 1>(context).second;
+
+        if constexpr (fused_loss_context<std::decay_t<decltype(last_ctx)>>()) {
+            dll::auto_timer timer("sgd::mse");
+
+            fused_last_errors<F>(last_ctx, full_batch, n, labels, metrics);
+        } else if (cpp_unlikely(!full_batch)) {
+            etl::slice(last_ctx.errors, 0, n) = 2.0 * (labels - etl::slice(last_ctx.output, 0, n));
+
+            clear_tail(last_ctx.errors, n);
+        } else {
+            cpp_unused(metrics);
+
+            last_ctx.errors = 2.0 * (labels - last_ctx.output);
+        }
+
+        // Multiply by the derivative of the activation function
+        last_layer.adapt_errors(last_ctx);
+
+        scale_errors(last_ctx);
+    }
+
+    /*!
+     * \brief Compute the errors of the last layer given the loss function
+     *
+     * The error and loss of the batch are computed together with the
+     * errors and stored in metrics, if given.
+     */
+    template<loss_function F, typename Context, typename Labels, cpp_enable_iff(F == loss_function::BINARY_CROSS_ENTROPY)>
+    void last_errors(Context& context, bool full_batch, size_t n, const Labels& labels, std::pair<double, double>* metrics = nullptr){
+        auto& last_layer = std::get<layers - 1>(context).first;
+        auto& last_ctx   = *std::get<layers - 1>(context).second;
+
+        if constexpr (fused_loss_context<std::decay_t<decltype(last_ctx)>>()) {
+            // The outputs are clipped in the kernel
+            dll::auto_timer timer("sgd::bce");
+
+            fused_last_errors<F>(last_ctx, full_batch, n, labels, metrics);
+        } else {
+            cpp_unused(metrics);
+
+            // Avoid Nan from division by ((1 - out) * out)
+            temporary_scope<weight> scope;
+            auto out = scope.value(etl::clip(last_ctx.output, 0.001, 0.999));
+
+            if (cpp_unlikely(!full_batch)) {
+                auto sout = etl::slice(out, 0, n);
+
+                etl::slice(last_ctx.errors, 0, n) = (labels - sout) / ((1.0 - sout) >> sout);
+
+                clear_tail(last_ctx.errors, n);
+            } else {
+                last_ctx.errors = (labels - out) / ((1.0 - out) >> out);
+            }
+        }
+
+        // Check for NAN before derivative
+        nan_check_etl(last_ctx.errors);
+
+        // Multiply by the derivative of the activation function
+        last_layer.adapt_errors(last_ctx);
+
+        // Check for NAN after derivative
+        nan_check_etl(last_ctx.errors);
+
+        scale_errors(last_ctx);
+    }
+
+    /*!
+     * \brief Clear the rows of a batch buffer after the n first rows, which
+     * are not used by a partial batch
+     * \param buffer The batch buffer
+     * \param n The number of rows of the partial batch
+     */
+    template <typename Buffer>
+    static void clear_tail(Buffer& buffer, size_t n) {
+        etl::slice(buffer, n, etl::dim<0>(buffer)) = 0;
+    }
+
+    /*!
+     * \brief Scale the errors of the last layer by the loss scale, so that
+     * the small gradients are not flushed to zero during backpropagation
+     * (loss scaling)
+     */
+    template <typename Context>
+    void scale_errors([[maybe_unused]] Context& last_ctx){
+        if constexpr (dbn_traits<dbn_t>::has_loss_scaling()) {
+            last_ctx.errors *= dbn.loss_scale;
+        }
+    }
+
+    /*!
+     * \brief Train a batch of data
+     * \param epoch The current epoch
+     * \param inputs A batch of inputs
+     * \param labels A batch of labels
+     * \return a pair containing the error and the loss for the batch
+     */
+    template <typename Inputs, typename Labels>
+    std::pair<double, double> train_batch(size_t epoch, const Inputs& inputs, const Labels& labels) {
+        if constexpr (micro_batches > 1) {
+            return train_batch_parallel(epoch, inputs, labels);
+        }
+
+        dll::auto_timer timer("sgd::train_batch");
+
+        update_frozen_prefix();
+
+        auto& first_ctx = *std::get<0>(full_context).second;
+
+        const auto n          = etl::dim<0>(inputs);
+        const bool full_batch = n == etl::dim<0>(first_ctx.input);
+
+        // Ensure that the data batch and the label batch are of the same size
+        cpp_assert(n == etl::dim<0>(labels), "Invalid sizes");
+
+        // Ensure that the context can hold the inputs
+        cpp_assert(n <= etl::dim<0>(first_ctx.input), "Invalid sizes");
+
+        //Feedforward pass
+
+        {
+            dll::auto_timer timer("sgd::forward");
+
+            forward_batch_helper<true>(inputs);
+        }
+
+        return train_forwarded(epoch, n, full_batch, labels);
+    }
+
+    /*!
+     * \brief Train the batch staged by the last call to swap_staged.
+     *
+     * The inputs have already been moved into the context of the first
+     * layer, so they are not copied again.
+     *
+     * \param epoch The current epoch
+     * \return a pair containing the error and the loss for the batch
+     */
+    std::pair<double, double> train_staged(size_t epoch) {
+        auto& first_ctx = *std::get<0>(full_context).second;
+
+        const size_t n = staging->current_n;
+        auto& labels   = staging->current_labels;
+
+        if constexpr (micro_batches > 1) {
+            return train_batch_parallel(epoch, etl::slice(first_ctx.input, 0, n), etl::slice(labels, 0, n));
+        } else {
+            dll::auto_timer timer("sgd::train_batch");
+
+            update_frozen_prefix();
+
+            //Feedforward pass
+
+            {
+                dll::auto_timer timer("sgd::forward");
+
+                forward_inplace<true>();
+            }
+
+            if (cpp_likely(n == batch_size)) {
+                return train_forwarded(epoch, n, true, labels);
+            } else {
+                return train_forwarded(epoch, n, false, etl::slice(labels, 0, n));
+            }
+        }
+    }
+
+    /*!
+     * \brief Copy a batch into the staging buffers, while the previous
+     * batch is being trained
+     * \param inputs A batch of inputs
+     * \param labels A batch of labels
+     */
+    template <typename Inputs, typename Labels>
+    void stage_batch(const Inputs& inputs, const Labels& labels) {
+        dll::auto_timer timer("sgd::stage_batch");
+
+        const size_t n = etl::dim<0>(inputs);
+
+        // Ensure that the data batch and the label batch are of the same size
+        cpp_assert(n == etl::dim<0>(labels), "Invalid sizes");
+
+        // Ensure that the staging buffers can hold the inputs
+        cpp_assert(n <= batch_size, "Invalid sizes");
+
+        if (cpp_unlikely(n < batch_size)) {
+            etl::slice(staging->inputs, 0, n) = inputs;
+            etl::slice(staging->labels, 0, n) = labels;
+
+            clear_tail(staging->inputs, n);
+            clear_tail(staging->labels, n);
+        } else {
+            staging->inputs = inputs;
+            staging->labels = labels;
+        }
+
+        staging->n = n;
+    }
+
+    /*!
+     * \brief Move the staged batch into the context of the first layer so
+     * that it can be trained with train_staged. The staging buffers
+     * can then be used for the next batch.
+     */
+    void swap_staged() {
+        auto& first_ctx = *std::get<0>(full_context).second;
+
+        using std::swap;
+
+        swap(first_ctx.input, staging->inputs);
+        swap(staging->current_labels, staging->labels);
+
+        staging->current_n = staging->n;
+    }
+
+    /*!
+     * \brief Backpropagate the errors of a forwarded batch and apply the
+     * gradients
+     * \param epoch The current epoch
+     * \param n The number of samples in the batch
+     * \param full_batch Indicates if the batch is complete
+     * \param labels A batch of labels
+     * \return a pair containing the error and the loss for the batch
+     */
+    template <typename Labels>
+    std::pair<double, double> train_forwarded(size_t epoch, size_t n, bool full_batch, const Labels& labels) {
+        auto& last_ctx = *std::get<layers - 1>(full_context).second;
+
+        // The metrics computed together with the errors (fused kernels)
+        std::pair<double, double> metrics;
+
+        if constexpr (checkpoint_every > 1) {
+            dll::auto_timer timer("sgd::backward");
+
+            //Compute the errors of the last layer
+
+            last_errors<dbn_t::loss>(full_context, full_batch, n, labels);
+
+            // Backpropagate the error, recomputing the released activations
+
+            checkpoint_backward_batch(epoch, n);
+        } else if constexpr (compressed_activations) {
+            dll::auto_timer timer("sgd::backward");
+
+            //Compute the errors of the last layer
+
+            compute_last_errors(full_batch, n, labels, metrics);
+
+            // Backpropagate the error, decompressing the activations
+
+            compressed_backward_batch(epoch, n);
+        } else if constexpr (!dbn_traits<dbn_t>::is_serial() && accumulated_batches == 1 && !dbn_traits<dbn_t>::has_loss_scaling()) {
+            dll::auto_timer timer("sgd::backward");
+
+            //Compute the errors of the last layer
+
+            compute_last_errors(full_batch, n, labels, metrics);
+
+            // Backpropagate the error and apply the gradients
+
+            backward_update_batch(epoch, n);
+
+            // Update the counter of iterations
+            ++iteration;
+        } else {
+            {
+                dll::auto_timer timer("sgd::backward");
+
+                //Compute the errors of the last layer
+
+                compute_last_errors(full_batch, n, labels, metrics);
+
+                // Backpropagate the error
+
+                backward_batch_helper(full_context);
+            }
+
+            // Compute and apply the gradients
+
+            train_gradients(epoch, n);
+        }
+
+        // Compute error and loss
+
+        if constexpr (fused_metrics()) {
+            cpp_unused(last_ctx);
+
+            return std::make_pair(metrics.first / n, metrics.second / n);
+        } else {
+            dll::auto_timer timer("sgd::error");
+
+            auto[error, loss] = dbn.evaluate_metrics_batch(last_ctx.output, labels, n, true);
+
+            return std::make_pair(error, loss);
+        }
+    }
+
+    /*!
+     * \brief Compute the errors of the last layer of the main context,
+     * along with the metrics of the batch when they are fused with the
+     * errors
+     */
+    template <typename Labels>
+    void compute_last_errors(bool full_batch, size_t n, const Labels& labels, std::pair<double, double>& metrics) {
+        if constexpr (fused_metrics()) {
+            last_errors<dbn_t::loss>(full_context, full_batch, n, labels, &metrics);
+        } else {
+            cpp_unused(metrics);
+
+            last_errors<dbn_t::loss>(full_context, full_batch, n, labels);
+        }
+    }
+
+    /*!
+     * \brief Compute and apply the gradients of the main context, once the
+     * errors have been backpropagated
+     * \param epoch The current epoch
+     * \param n The number of samples in the batch
+     */
+    void train_gradients(size_t epoch, size_t n) {
+        if constexpr (accumulated_batches > 1 || dbn_traits<dbn_t>::has_loss_scaling()) {
+            dll::auto_timer timer("sgd::grad");
+
+            // All the gradients are needed before the update
+
+            cpp::for_each(full_context, [this](auto& layer_ctx) {
+                if (this->is_trained(*layer_ctx.second)) {
+                    this_type::compute_gradients_layer(layer_ctx.first, *layer_ctx.second);
+                } else {
+                    this_type::discard_gradients(*layer_ctx.second);
+                }
+            });
+
+            if constexpr (accumulated_batches > 1) {
+                accumulate_gradients(epoch, n);
+            } else {
+                update_all_weights(epoch, n);
+            }
+        } else {
+            dll::auto_timer timer("sgd::grad");
+
+            cpp::for_each(full_context, [this, epoch, n](auto& layer_ctx) {
+                if (this->is_trained(*layer_ctx.second)) {
+                    this->apply_gradients_layer(epoch, n, layer_ctx.first, *layer_ctx.second);
+                } else {
+                    this_type::discard_gradients(*layer_ctx.second);
+                }
+            });
+
+            // Update the counter of iterations
+            ++iteration;
+        }
+    }
+
+    /*!
+     * \brief Backpropagate the errors of the last layer and apply the
+     * gradients of each layer as soon as its errors are ready.
+     *
+     * The gradients and the update of a layer only depend on its own
+     * context and weights, which are not used anymore by the backward
+     * pass of the lower layers. Each update is therefore handed to the
+     * thread pool of the network while the errors keep being propagated.
+     *
+     * \param epoch The current epoch
+     * \param n The number of samples in the batch
+     */
+    void backward_update_batch(size_t epoch, size_t n) {
+        auto& pool = dbn.get_thread_pool();
+
+        auto& first_layer = std::get<0>(full_context).first;
+        auto& first_ctx   = *std::get<0>(full_context).second;
+
+        bool last = true;
+
+        cpp::for_each_rpair(full_context, [this, &pool, &last, epoch, n](auto& layer_ctx_1, auto& layer_ctx_2) {
+            backward_prefix_layer(layer_ctx_2.first, *layer_ctx_2.second, get_errors(*layer_ctx_1.second), last, frozen_prefix);
+
+            if (!this->is_trained(*layer_ctx_2.second)) {
+                this_type::discard_gradients(*layer_ctx_2.second);
+                return;
+            }
+
+            pool.do_task([this, &layer_ctx_2, epoch, n] {
+                // The backward pass is using the other threads
+                SERIAL_SECTION {
+                    dll::auto_timer timer("sgd::grad");
+
+                    this->apply_gradients_layer(epoch, n, layer_ctx_2.first, *layer_ctx_2.second);
+                }
+            });
+        });
+
+        // With a frozen prefix, the first layer is neither backpropagated nor trained
+
+        if (!frozen_prefix) {
+            if constexpr (!conv_pool_next<0>()) {
+                dll::auto_timer timer(layer_timers<0>::backward());
+
+                first_layer.adapt_errors(first_ctx);
+            }
+
+            {
+                dll::auto_timer timer("sgd::grad");
+
+                apply_gradients_layer(epoch, n, first_layer, first_ctx);
+            }
+        }
+
+        pool.wait();
+    }
+
+    /*!
+     * \brief Indicates if the convolutional layer L is fused with the
+     * following max pooling layer: its output is never computed, the
+     * pooling layer directly pools the convolution of its input and adapts
+     * the errors of the convolution.
+     */
+    template <size_t L>
+    static constexpr bool conv_pool_next() {
+        if constexpr (L < layers - 1 && checkpoint_every <= 1 && !gpu_resident) {
+            return conv_pool_train_fusion<typename dbn_t::template layer_type<L>, typename dbn_t::template layer_type<L + 1>>();
+        } else {
+            return false;
+        }
+    }
+
+    /*!
+     * \brief Indicates if the activations of the given layer are released
+     * between the forward and the backward passes (checkpoint)
+     */
+    template <size_t L>
+    static constexpr bool is_released() {
+        if constexpr (checkpoint_every > 1 && L % checkpoint_every != 0 && L != layers - 1) {
+            return !is_utility_layer<typename dbn_t::template layer_type<L>>;
+        } else {
+            return false;
+        }
+    }
+
+    /*!
+     * \brief Indicates if the given layer is the last layer of a segment
+     * with released activations (checkpoint)
+     */
+    template <size_t L>
+    static constexpr bool is_segment_top() {
+        return checkpoint_every > 1 && L % checkpoint_every != 0 && L + 1 < layers && ((L + 1) % checkpoint_every == 0 || L + 1 == layers - 1);
+    }
+
+    template <size_t... L>
+    void init_checkpoints(std::index_sequence<L...> /*seq*/) {
+        (init_checkpoint<L>(), ...);
+    }
+
+    /*!
+     * \brief Save the dimensions of the activations of the given layer and
+     * release them if they are not checkpointed
+     */
+    template <size_t L>
+    void init_checkpoint() {
+        if constexpr (is_released<L>()) {
+            auto& context = *std::get<L>(full_context).second;
+
+            save_dimensions(checkpoint_dims[3 * L + 0], context.input);
+            save_dimensions(checkpoint_dims[3 * L + 1], context.output);
+            save_dimensions(checkpoint_dims[3 * L + 2], context.errors);
+
+            release_activations(context);
+        }
+    }
+
+    template <typename T>
+    static void save_dimensions(std::vector<size_t>& dims, const T& buffer) {
+        for (size_t d = 0; d < etl::dimensions(buffer); ++d) {
+            dims.push_back(etl::dim(buffer, d));
+        }
+    }
+
+    /*!
+     * \brief Release the dynamic activations of the given context
+     */
+    template <typename Context>
+    static void release_activations(Context& context) {
+        release_buffer(context.input);
+        release_buffer(context.output);
+        release_buffer(context.errors);
+    }
+
+    template <typename T>
+    static void release_buffer([[maybe_unused]] T& buffer) {
+        if constexpr (!etl::all_fast<T>) {
+            buffer = T();
+        }
+    }
+
+    /*!
+     * \brief Allocate again the released activations of the given layer
+     */
+    template <size_t L>
+    void restore_activations() {
+        if constexpr (is_released<L>()) {
+            auto& context = *std::get<L>(full_context).second;
+
+            restore_buffer(context.input, checkpoint_dims[3 * L + 0]);
+            restore_buffer(context.output, checkpoint_dims[3 * L + 1]);
+            restore_buffer(context.errors, checkpoint_dims[3 * L + 2]);
+        }
+    }
+
+    template <typename T>
+    static void restore_buffer([[maybe_unused]] T& buffer, [[maybe_unused]] const std::vector<size_t>& dims) {
+        if constexpr (!etl::all_fast<T>) {
+            if (!etl::size(buffer)) {
+                buffer = make_buffer<T>(dims, std::make_index_sequence<etl::decay_traits<T>::dimensions()>());
+            }
+        }
+    }
+
+    template <typename T, size_t... I>
+    static T make_buffer(const std::vector<size_t>& dims, std::index_sequence<I...> /*seq*/) {
+        return T(dims[I]..., typename T::value_type(0.0));
+    }
+
+    /*!
+     * \brief Forward the outputs of layer L - 1 through the layers
+     * [L, Last) of the main context, allocating their released
+     * activations
+     *
+     * \tparam Release Indicates if the activations of the released layers
+     * are released again once they have been forwarded to the next layer
+     */
+    template <bool Train, bool Release, size_t L, size_t Last>
+    void checkpoint_forward() {
+        if constexpr (L < Last) {
+            auto& prev_ctx  = *std::get<L - 1>(full_context).second;
+            auto& layer_ctx = std::get<L>(full_context);
+
+            restore_activations<L>();
+
+            this_type::template forward_prefix_layer<Train>(layer_ctx.first, get_output(prev_ctx), *layer_ctx.second, frozen_prefix);
+
+            if constexpr (Release && is_released<L - 1>()) {
+                release_activations(prev_ctx);
+            }
+
+            checkpoint_forward<Train, Release, L + 1, Last>();
+        }
+    }
+
+    /*!
+     * \brief Backpropagate the errors of the last layer with checkpointing
+     * and compute, and apply, the gradients of each layer.
+     *
+     * The activations of each segment of released layers are recomputed
+     * from the last checkpointed layer before the segment is
+     * backpropagated, and released again once the gradients of a layer
+     * have been computed.
+     *
+     * \param epoch The current epoch
+     * \param n The number of samples in the batch
+     */
+    void checkpoint_backward_batch(size_t epoch, size_t n) {
+        auto& first_layer = std::get<0>(full_context).first;
+        auto& first_ctx   = *std::get<0>(full_context).second;
+
+        bool last = true;
+
+        checkpoint_backward<layers - 1>(epoch, n, last);
+
+        if (!frozen_prefix) {
+            {
+                dll::auto_timer timer(layer_timers<0>::backward());
+
+                first_layer.adapt_errors(first_ctx);
+            }
+
+            checkpoint_gradients(epoch, n, first_layer, first_ctx);
+        }
+
+        if constexpr (accumulated_batches > 1) {
+            accumulate_gradients(epoch, n);
+        } else if constexpr (dbn_traits<dbn_t>::has_loss_scaling()) {
+            update_all_weights(epoch, n);
+        } else {
+            // Update the counter of iterations
+            ++iteration;
+        }
+    }
+
+    template <size_t L>
+    void checkpoint_backward(size_t epoch, size_t n, bool& last) {
+        if constexpr (L > 0) {
+            auto& prev_ctx  = *std::get<L - 1>(full_context).second;
+            auto& layer_ctx = std::get<L>(full_context);
+
+            if constexpr (is_segment_top<L>()) {
+                checkpoint_forward<true, false, L - L % checkpoint_every + 1, L + 1>();
+            }
+
+            backward_prefix_layer(layer_ctx.first, *layer_ctx.second, get_errors(prev_ctx), last, frozen_prefix);
+
+            if (is_trained(*layer_ctx.second)) {
+                checkpoint_gradients(epoch, n, layer_ctx.first, *layer_ctx.second);
+            } else {
+                discard_gradients(*layer_ctx.second);
+            }
+
+            if constexpr (is_released<L>()) {
+                release_activations(*layer_ctx.second);
+            }
+
+            checkpoint_backward<L - 1>(epoch, n, last);
+        }
+    }
+
+    /*!
+     * \brief Compute the gradients of a layer during the checkpointed
+     * backward pass, and apply them if all the gradients are not
+     * needed before the update
+     */
+    template <typename Layer, typename Context>
+    void checkpoint_gradients(size_t epoch, size_t n, Layer& layer, Context& context) {
+        dll::auto_timer timer("sgd::grad");
+
+        if constexpr (accumulated_batches > 1 || dbn_traits<dbn_t>::has_loss_scaling()) {
+            cpp_unused(epoch);
+            cpp_unused(n);
+
+            compute_gradients_layer(layer, context);
+        } else {
+            apply_gradients_layer(epoch, n, layer, context);
+        }
+    }
+
+    /*!
+     * \brief Indicates if the output of the given layer is kept as a
+     * bitmask of its signs between the forward and the backward passes
+     * (compressed_activations)
+     */
+    template <size_t L>
+    static constexpr bool is_masked() {
+        if constexpr (compressed_activations && L < layers - 1 && !conv_pool_next<L>()) {
+            using layer_t  = typename dbn_t::template layer_type<L>;
+            using output_t = std::decay_t<decltype(std::get<L>(std::declval<context_t&>()).second->output)>;
+
+            return decay_layer_traits<layer_t>::has_compressible_activations() && decay_layer_traits<layer_t>::has_relu_activation() && !etl::all_fast<output_t>;
+        } else {
+            return false;
+        }
+    }
+
+    /*!
+     * \brief Indicates if the input of the given layer is kept in bfloat16
+     * between the forward and the backward passes (compressed_activations)
+     */
+    template <size_t L>
+    static constexpr bool is_half_input() {
+        if constexpr (compressed_activations && L > 0 && std::is_same_v<weight, float> && !conv_pool_next<L>()) {
+            using layer_t = typename dbn_t::template layer_type<L>;
+            using input_t = std::decay_t<decltype(std::get<L>(std::declval<context_t&>()).second->input)>;
+
+            return decay_layer_traits<layer_t>::has_compressible_activations() && !etl::all_fast<input_t>;
+        } else {
+            return false;
+        }
+    }
+
+    /*!
+     * \brief Forward the outputs of layer L - 1 through the layers
+     * [L, layers) of the main context, allocating their released
+     * activations. In training, the activations consumed by each layer are
+     * compressed and released as soon as it has been forwarded.
+     */
+    template <bool Train, size_t L>
+    void compressed_forward() {
+        if constexpr (L < layers) {
+            expand_layer<L>();
+
+            this_type::template forward_prefix_pair<Train>(std::get<L - 1>(full_context), std::get<L>(full_context), frozen_prefix);
+
+            if constexpr (Train) {
+                compress_layer<L>();
+            }
+
+            compressed_forward<Train, L + 1>();
+        }
+    }
+
+    /*!
+     * \brief Allocate again the released activations of the given layer
+     * before it is forwarded
+     */
+    template <size_t L>
+    void expand_layer() {
+        if constexpr (is_half_input<L>()) {
+            auto& context = *std::get<L>(full_context).second;
+            auto& state   = compressed[L];
+
+            // A shared input is allocated with the output of the previous layer
+            if (state.input_released && !state.input_shared) {
+                if constexpr (!has_chained_input<std::decay_t<decltype(context)>>::value) {
+                    restore_buffer(context.input, state.input_dims);
+                }
+            }
+
+            state.input_compressed = false;
+            state.input_released   = false;
+        }
+
+        if constexpr (is_masked<L>()) {
+            restore_output<L>();
+
+            compressed[L].output_compressed = false;
+        }
+    }
+
+    /*!
+     * \brief Compress the activations consumed by the forward pass of the
+     * given layer: the output of the previous layer and the input of the
+     * layer. They are released when they are not needed anymore in full
+     * precision. A chained input is only released with the output of the
+     * previous layer.
+     */
+    template <size_t L>
+    void compress_layer() {
+        dll::auto_timer timer("sgd::compress");
+
+        auto& prev_ctx = *std::get<L - 1>(full_context).second;
+        auto& context  = *std::get<L>(full_context).second;
+
+        using layer_context_t = std::decay_t<decltype(context)>;
+
+        bool shared = false;
+
+        if constexpr (has_chained_input<layer_context_t>::value) {
+            shared = context.input.memory_start() == get_output(prev_ctx).memory_start();
+        }
+
+        if constexpr (is_half_input<L>()) {
+            auto& state = compressed[L];
+
+            if (shared ? is_masked<L - 1>() : !has_chained_input<layer_context_t>::value) {
+                if (state.input_dims.empty()) {
+                    save_dimensions(state.input_dims, context.input);
+                }
+
+                encode_half(state.input, context.input);
+
+                state.input_compressed = true;
+                state.input_released   = true;
+                state.input_shared     = shared;
+
+                if constexpr (!has_chained_input<layer_context_t>::value) {
+                    release_buffer(context.input);
+                }
+            }
+        }
+
+        if constexpr (is_masked<L - 1>()) {
+            auto& state = compressed[L - 1];
+
+            if (!shared || compressed[L].input_compressed) {
+                if (state.output_dims.empty()) {
+                    save_dimensions(state.output_dims, prev_ctx.output);
+                }
+
+                encode_mask(state.mask, prev_ctx.output);
+
+                state.output_compressed = true;
+                state.output_released   = true;
+
+                release_buffer(prev_ctx.output);
+            }
+        }
+    }
+
+    /*!
+     * \brief Allocate again the released output of the given layer, in which
+     * the input of the next layer is a view when they are shared
+     */
+    template <size_t L>
+    void restore_output() {
+        auto& context = *std::get<L>(full_context).second;
+        auto& state   = compressed[L];
+
+        if (state.output_released) {
+            restore_buffer(context.output, state.output_dims);
+
+            state.output_released = false;
+
+            if constexpr (is_half_input<L + 1>()) {
+                auto& next_ctx = *std::get<L + 1>(full_context).second;
+
+                using next_context_t = std::decay_t<decltype(next_ctx)>;
+
+                if constexpr (has_chained_input<next_context_t>::value) {
+                    if (compressed[L + 1].input_shared) {
+                        using input_t = std::decay_t<decltype(next_ctx.input)>;
+
+                        next_ctx.input = make_view<input_t>(context.output.memory_start(), compressed[L + 1].input_dims,
+                                                            std::make_index_sequence<etl::decay_traits<input_t>::dimensions()>());
+                    }
+                }
+            }
+        }
+    }
+
+    /*!
+     * \brief Decompress the activations needed by the backward pass of the
+     * given layer: its input, for its gradients, and its output, for the
+     * derivative of its activation
+     */
+    template <size_t L>
+    void decompress_layer() {
+        dll::auto_timer timer("sgd::decompress");
+
+        auto& context = *std::get<L>(full_context).second;
+
+        if constexpr (is_half_input<L>()) {
+            auto& state = compressed[L];
+
+            if (state.input_released) {
+                if (state.input_shared) {
+                    if constexpr (is_masked<L - 1>()) {
+                        restore_output<L - 1>();
+                    }
+                } else if constexpr (!has_chained_input<std::decay_t<decltype(context)>>::value) {
+                    restore_buffer(context.input, state.input_dims);
+                }
+
+                decode_half(state.input, context.input);
+
+                state.input_released = false;
+            }
+        }
+
+        if constexpr (is_masked<L>()) {
+            auto& state = compressed[L];
+
+            if (state.output_compressed) {
+                restore_output<L>();
+
+                // Only the signs of the output are needed by the derivative of RELU
+                decode_mask(state.mask, context.output);
+            }
+        }
+    }
+
+    /*!
+     * \brief Release the decompressed activations of the given layer once
+     * it has been backpropagated. A shared input is released with the
+     * output of the previous layer.
+     */
+    template <size_t L>
+    void release_layer() {
+        auto& context = *std::get<L>(full_context).second;
+
+        if constexpr (is_half_input<L>()) {
+            auto& state = compressed[L];
+
+            if (state.input_compressed && !state.input_shared) {
+                if constexpr (!has_chained_input<std::decay_t<decltype(context)>>::value) {
+                    release_buffer(context.input);
+
+                    state.input_released = true;
+                }
+            }
+        }
+
+        if constexpr (is_masked<L>()) {
+            auto& state = compressed[L];
+
+            if (state.output_compressed) {
+                release_buffer(context.output);
+
+                state.output_released = true;
+            }
+        }
+    }
+
+    /*!
+     * \brief Backpropagate the errors of the last layer with compressed
+     * activations and compute, and apply, the gradients of each layer.
+     *
+     * The activations of each layer are decompressed before the layer is
+     * backpropagated and released again once its gradients have been
+     * computed.
+     *
+     * \param epoch The current epoch
+     * \param n The number of samples in the batch
+     */
+    void compressed_backward_batch(size_t epoch, size_t n) {
+        auto& first_layer = std::get<0>(full_context).first;
+        auto& first_ctx   = *std::get<0>(full_context).second;
+
+        bool last = true;
+
+        compressed_backward<layers - 1>(epoch, n, last);
+
+        if (!frozen_prefix) {
+            decompress_layer<0>();
+
+            if constexpr (!conv_pool_next<0>()) {
+                dll::auto_timer timer(layer_timers<0>::backward());
+
+                first_layer.adapt_errors(first_ctx);
+            }
+
+            checkpoint_gradients(epoch, n, first_layer, first_ctx);
+        }
+
+        release_layer<0>();
+
+        if constexpr (accumulated_batches > 1) {
+            accumulate_gradients(epoch, n);
+        } else if constexpr (dbn_traits<dbn_t>::has_loss_scaling()) {
+            update_all_weights(epoch, n);
+        } else {
+            // Update the counter of iterations
+            ++iteration;
+        }
+    }
+
+    template <size_t L>
+    void compressed_backward(size_t epoch, size_t n, bool& last) {
+        if constexpr (L > 0) {
+            auto& prev_ctx  = *std::get<L - 1>(full_context).second;
+            auto& layer_ctx = std::get<L>(full_context);
+
+            decompress_layer<L>();
+
+            backward_prefix_layer(layer_ctx.first, *layer_ctx.second, get_errors(prev_ctx), last, frozen_prefix);
+
+            if (is_trained(*layer_ctx.second)) {
+                checkpoint_gradients(epoch, n, layer_ctx.first, *layer_ctx.second);
+            } else {
+                discard_gradients(*layer_ctx.second);
+            }
+
+            release_layer<L>();
+
+            compressed_backward<L - 1>(epoch, n, last);
+        }
+    }
+
+    /*!
+     * \brief Store the signs of the given output in the given bitmask
+     */
+    template <typename T>
+    static void encode_mask(std::vector<uint64_t>& mask, T& output) {
+        output.ensure_cpu_up_to_date();
+
+        const size_t n     = etl::size(output);
+        const auto* values = output.memory_start();
+
+        mask.assign((n + 63) / 64, 0);
+
+        for (size_t i = 0; i < n; ++i) {
+            if (values[i] > 0) {
+                mask[i / 64] |= uint64_t(1) << (i % 64);
+            }
+        }
+    }
+
+    /*!
+     * \brief Set the given output to one where the bitmask is set and to
+     * zero elsewhere
+     */
+    template <typename T>
+    static void decode_mask(const std::vector<uint64_t>& mask, T& output) {
+        const size_t n = etl::size(output);
+        auto* values   = output.memory_start();
+
+        for (size_t i = 0; i < n; ++i) {
+            values[i] = (mask[i / 64] >> (i % 64)) & 1 ? weight(1) : weight(0);
+        }
+
+        output.invalidate_gpu();
+    }
+
+    /*!
+     * \brief Store the given input in bfloat16
+     */
+    template <typename T>
+    static void encode_half(std::vector<uint16_t>& half, T& input) {
+        input.ensure_cpu_up_to_date();
+
+        half.resize(etl::size(input));
+
+        std::transform(input.memory_start(), input.memory_end(), half.begin(), float_to_bf16);
+    }
+
+    /*!
+     * \brief Restore the given input from bfloat16
+     */
+    template <typename T>
+    static void decode_half(const std::vector<uint16_t>& half, T& input) {
+        std::transform(half.begin(), half.end(), input.memory_start(), bf16_to_float);
+
+        input.invalidate_gpu();
+    }
+
+    template <typename T, size_t... I>
+    static T make_view(weight* memory, const std::vector<size_t>& dims, std::index_sequence<I...> /*seq*/) {
+        return T(memory, dims[I]...);
+    }
+
+    /*!
+     * \brief Train a batch of data in data-parallel mode.
+     *
+     * The batch is split into micro-batches, each trained on its own
+     * context by the thread pool of the network. The gradients of the
+     * micro-batches are then summed into the main context before the
+     * weights are updated.
+     *
+     * \param epoch The current epoch
+     * \param inputs A batch of inputs
+     * \param labels A batch of labels
+     * \return a pair containing the error and the loss for the batch
+     */
+    template <typename Inputs, typename Labels>
+    std::pair<double, double> train_batch_parallel(size_t epoch, const Inputs& inputs, const Labels& labels) {
+        if constexpr (stages > 1) {
+            return train_batch_pipeline(epoch, inputs, labels);
+        }
+
+        dll::auto_timer timer("sgd::train_batch");
+
+        update_frozen_prefix();
+
+        auto& last_ctx = *std::get<layers - 1>(full_context).second;
+
+        const size_t n      = etl::dim<0>(inputs);
+        const size_t active = (n + micro_batch_size - 1) / micro_batch_size;
+
+        // Ensure that the data batch and the label batch are of the same size
+        cpp_assert(n == etl::dim<0>(labels), "Invalid sizes");
+
+        // Ensure that the context can hold the inputs
+        cpp_assert(n <= batch_size, "Invalid sizes");
+
+        // Forward, backward and gradients of each micro-batch
+
+        {
+            dll::auto_timer timer("sgd::micro_batches");
+
+            cpp::maybe_parallel_foreach_n(dbn.get_thread_pool(), 0, active, [&](size_t r) {
+                // The threads of the pool are already busy
+                SERIAL_SECTION {
+                    auto& context = micro_contexts[r];
+
+                    const size_t first = r * micro_batch_size;
+                    const size_t last  = std::min(n, first + micro_batch_size);
+
+                    auto micro_inputs = etl::slice(inputs, first, last);
+                    auto micro_labels = etl::slice(labels, first, last);
+
+                    forward_context<true>(context, micro_inputs, frozen_prefix);
+
+                    last_errors<dbn_t::loss>(context, last - first == micro_batch_size, last - first, micro_labels);
+
+                    backward_batch_helper(context, frozen_prefix);
+
+                    cpp::for_each(context, [this](auto& layer_ctx) {
+                        if (this->is_trained(*layer_ctx.second)) {
+                            this_type::compute_gradients_layer(layer_ctx.first, *layer_ctx.second);
+                        } else {
+                            this_type::discard_gradients(*layer_ctx.second);
+                        }
+                    });
+
+                    // Gather the output for the metrics
+                    etl::slice(last_ctx.output, first, last) = etl::slice(std::get<layers - 1>(context).second->output, 0, last - first);
+                }
+            });
+        }
+
+        // Reduce and apply the gradients
+
+        {
+            dll::auto_timer timer("sgd::grad");
+
+            for (size_t r = 0; r < active; ++r) {
+                cpp::for_each(full_context, micro_contexts[r], [r](auto& layer_ctx, auto& micro_layer_ctx) {
+                    this_type::reduce_gradients_layer(layer_ctx.first, *layer_ctx.second, *micro_layer_ctx.second, r == 0);
+                });
+            }
+
+            if constexpr (accumulated_batches > 1) {
+                accumulate_gradients(epoch, n);
+            } else {
+                update_all_weights(epoch, n);
+            }
+        }
+
+        // Compute error and loss
+
+        {
+            dll::auto_timer timer("sgd::error");
+
+            auto[error, loss] = dbn.evaluate_metrics_batch(last_ctx.output, labels, n, true);
+
+            return std::make_pair(error, loss);
+        }
+    }
+
+    /*!
+     * \brief Train a batch of data with pipeline model parallelism.
+     *
+     * The batch is split into the micro-batches of the data-parallel mode.
+     * Each stage forwards all the micro-batches through its layers, as soon
+     * as the previous stage is done with them, and then backpropagates them
+     * in reverse order, as soon as the next stage is done with them. Each
+     * stage then reduces the gradients of its layers into the main context
+     * before the weights are updated.
+     *
+     * \param epoch The current epoch
+     * \param inputs A batch of inputs
+     * \param labels A batch of labels
+     * \return a pair containing the error and the loss for the batch
+     */
+    template <typename Inputs, typename Labels>
+    std::pair<double, double> train_batch_pipeline(size_t epoch, const Inputs& inputs, const Labels& labels) {
+        dll::auto_timer timer("sgd::train_batch");
+
+        update_frozen_prefix();
+
+        auto& last_ctx = *std::get<layers - 1>(full_context).second;
+
+        const size_t n      = etl::dim<0>(inputs);
+        const size_t active = (n + micro_batch_size - 1) / micro_batch_size;
+
+        // Ensure that the data batch and the label batch are of the same size
+        cpp_assert(n == etl::dim<0>(labels), "Invalid sizes");
+
+        // Ensure that the context can hold the inputs
+        cpp_assert(n <= batch_size, "Invalid sizes");
+
+        forward_done->reset();
+        backward_done->reset();
+
+        // Forward, backward, gradients and reduction of each stage
+
+        {
+            dll::auto_timer timer("sgd::pipeline");
+
+            stage_threads->run([&](size_t s) {
+                const size_t frozen = frozen_prefix;
+
+                // Fill: forward all the micro-batches through the layers of the stage
+
+                for (size_t r = 0; r < active; ++r) {
+                    if (s) {
+                        forward_done->wait(s - 1, r + 1);
+                    }
+
+                    auto& context = micro_contexts[r];
+
+                    const size_t first = r * micro_batch_size;
+                    const size_t last  = std::min(n, first + micro_batch_size);
+
+                    if (!s) {
+                        forward_first_layer<true>(context, etl::slice(inputs, first, last), frozen);
+                    }
+
+                    cpp::for_each_pair(context, [this, s, frozen](auto& layer_ctx_1, auto& layer_ctx_2) {
+                        if (stage_of[context_layer<std::decay_t<decltype(*layer_ctx_2.second)>>::value] == s) {
+                            this_type::template forward_prefix_pair<true>(layer_ctx_1, layer_ctx_2, frozen);
+                        }
+                    });
+
+                    if (s == stages - 1) {
+                        last_errors<dbn_t::loss>(context, last - first == micro_batch_size, last - first, etl::slice(labels, first, last));
+
+                        // Gather the output for the metrics
+                        etl::slice(last_ctx.output, first, last) = etl::slice(std::get<layers - 1>(context).second->output, 0, last - first);
+                    }
+
+                    forward_done->publish(s);
+                }
+
+                // Drain: backpropagate the micro-batches in reverse order
+
+                for (size_t k = 0; k < active; ++k) {
+                    if (s < stages - 1) {
+                        backward_done->wait(s + 1, k + 1);
+                    }
+
+                    auto& context = micro_contexts[active - 1 - k];
+
+                    // The errors of the last layer of the other stages still need to be adapted
+                    bool last = s == stages - 1;
+
+                    cpp::for_each_rpair(context, [this, s, frozen, &last](auto& layer_ctx_1, auto& layer_ctx_2) {
+                        if (stage_of[context_layer<std::decay_t<decltype(*layer_ctx_2.second)>>::value] == s) {
+                            backward_prefix_layer(layer_ctx_2.first, *layer_ctx_2.second, get_errors(*layer_ctx_1.second), last, frozen);
+                        }
+                    });
+
+                    if (!s && !frozen && !conv_pool_next<0>()) {
+                        dll::auto_timer timer(layer_timers<0>::backward());
+
+                        std::get<0>(context).first.adapt_errors(*std::get<0>(context).second);
+                    }
+
+                    cpp::for_each(context, [this, s](auto& layer_ctx) {
+                        if (stage_of[context_layer<std::decay_t<decltype(*layer_ctx.second)>>::value] == s) {
+                            if (this->is_trained(*layer_ctx.second)) {
+                                this_type::compute_gradients_layer(layer_ctx.first, *layer_ctx.second);
+                            } else {
+                                this_type::discard_gradients(*layer_ctx.second);
+                            }
+                        }
+                    });
+
+                    backward_done->publish(s);
+                }
+
+                // Reduce the gradients of the layers of the stage
+
+                for (size_t r = 0; r < active; ++r) {
+                    cpp::for_each(full_context, micro_contexts[r], [this, s, r](auto& layer_ctx, auto& micro_layer_ctx) {
+                        if (stage_of[context_layer<std::decay_t<decltype(*micro_layer_ctx.second)>>::value] == s) {
+                            this_type::reduce_gradients_layer(layer_ctx.first, *layer_ctx.second, *micro_layer_ctx.second, r == 0);
+                        }
+                    });
+                }
+            });
+        }
+
+        // Apply the gradients
+
+        {
+            dll::auto_timer timer("sgd::grad");
+
+            if constexpr (accumulated_batches > 1) {
+                accumulate_gradients(epoch, n);
+            } else {
+                update_all_weights(epoch, n);
+            }
+        }
+
+        // Compute error and loss
+
+        {
+            dll::auto_timer timer("sgd::error");
+
+            auto[error, loss] = dbn.evaluate_metrics_batch(last_ctx.output, labels, n, true);
+
+            return std::make_pair(error, loss);
+        }
+    }
+
+    /*!
+     * \brief Backpropagate the errors of the last layer through the context
+     * \param context The context of the network
+     * \param frozen The number of leading frozen layers
+     */
+    template <typename Context>
+    static void backward_batch_helper(Context& context, size_t frozen = 0) {
+        auto& first_layer = std::get<0>(context).first;
+        auto& first_ctx   = *std::get<0>(context).second;
+
+        bool last = true;
+
+        cpp::for_each_rpair(context, [&last, frozen](auto& layer_ctx_1, auto& layer_ctx_2) {
+            backward_prefix_layer(layer_ctx_2.first, *layer_ctx_2.second, get_errors(*layer_ctx_1.second), last, frozen);
+        });
+
+        if (!frozen && !conv_pool_next<0>()) {
+            dll::auto_timer timer(layer_timers<0>::backward());
+
+            first_layer.adapt_errors(first_ctx);
+        }
+    }
+
+    /*!
+     * \brief Backpropagate the errors through the given layer, which is not
+     * the first layer of the network.
+     *
+     * The layers of the frozen prefix are not backpropagated. The first
+     * layer after the prefix only adapts its errors, from which its
+     * gradients are computed, since the errors of its inputs would never
+     * be used.
+     */
+    template <typename Layer, typename Context, typename Errors>
+    static void backward_prefix_layer(Layer& layer, Context& context, Errors&& errors, bool& last, size_t frozen) {
+        constexpr size_t L = context_layer<Context>::value;
+
+        if (L > frozen) {
+            if constexpr (conv_pool_next<L - 1>()) {
+                dll::auto_timer timer(layer_timers<L>::backward());
+
+                conv_pool_backward<typename dbn_t::template layer_type<L - 1>, Layer>(errors, context);
+
+                // The errors of the convolution are already adapted
+                last = true;
+            } else {
+                backward_layer(layer, context, errors, last);
+            }
+        } else if (L == frozen) {
+            if constexpr (is_utility_layer<Layer>) {
+                backward_layer(layer, context, errors, last);
+            } else {
+                dll::auto_timer timer(layer_timers<L>::backward());
+
+                if (!last) {
+                    layer.adapt_errors(context);
+                }
+
+                last = false;
+            }
+        }
+    }
+
+    /*!
+     * \brief Update the number of leading frozen layers for the next batch.
+     * The last layer is always trained in training mode, since it computes
+     * the errors of the network.
+     */
+    void update_frozen_prefix() {
+        frozen_prefix = std::min(dbn.frozen_prefix(), layers - 1);
+    }
+
+    /*!
+     * \brief Indicates if the layer of the given context is trained (not
+     * frozen)
+     */
+    template <typename Context>
+    bool is_trained(const Context& /*context*/) const {
+        return !dbn.frozen[context_layer<Context>::value];
+    }
 
-            for (size_t i = 0; i < n; ++i) {
-                last_ctx.errors(i) = 2.0 * (labels(i) - last_ctx.output(i));
-            }
-        } else {
-            last_ctx.errors = 2.0 * (labels - last_ctx.output);
+    /*!
+     * \brief Discard the gradients already computed by the backward pass
+     * of a frozen layer
+     */
+    template <typename Context>
+    static void discard_gradients([[maybe_unused]] Context& context) {
+        if constexpr (has_gradients_ready<Context>::value) {
+            context.gradients_ready = false;
         }
-
-        // Multiply by the derivative of the activation function
-        last_layer.adapt_errors(last_ctx);
     }
 
     /*!
-     * \brief Compute the errors of the last layer given the loss function
+     * \brief Compute the gradients of the given layer into its context
      */
-    template<loss_function F, typename Labels, cpp_enable_iff(F == loss_function::BINARY_CROSS_ENTROPY)>
-    void last_errors(bool full_batch, size_t n, const Labels& labels){
-        auto& last_layer = std::get<layers - 1>(full_context).first;
-        auto& last_ctx   = *std::get<layers - 1>(full_context).second;
+    template <typename Layer, typename Context>
+    static void compute_gradients_layer(Layer& layer, Context& context){
+        if constexpr (is_utility_layer<Layer>) {
+            cpp::for_each(layer.layers, context.sub_contexts, [](auto& sub_layer, auto& sub_context) {
+                this_type::compute_gradients_layer(sub_layer, sub_context);
+            });
+        } else {
+            dll::auto_timer timer(layer_timers<context_layer<Context>::value>::backward());
 
-        // Avoid Nan from division by ((1 - out) * out)
-        auto out = etl::force_temporary(etl::clip(last_ctx.output, 0.001, 0.999));
+            layer.compute_gradients(context);
+        }
+    }
 
-        if (cpp_unlikely(!full_batch)) {
-            last_ctx.errors = 0;
+    /*!
+     * \brief Add the gradients of a micro-batch context to the gradients of
+     * the main context
+     * \param layer The layer
+     * \param context The main context of the layer
+     * \param micro_context The micro-batch context of the layer
+     * \param first Indicates if this is the first micro-batch
+     */
+    template <typename Layer, typename Context, typename MicroContext>
+    static void reduce_gradients_layer(Layer& layer, Context& context, MicroContext& micro_context, bool first){
+        if constexpr (is_utility_layer<Layer>) {
+            reduce_gradients_sub_layers(layer, context, micro_context, first, std::make_index_sequence<Layer::n_layers>());
+        } else if constexpr (has_sparse_rows<Context>::value) {
+            reduce_rows(std::get<0>(context.up.context)->grad, context.rows, std::get<0>(micro_context.up.context)->grad, micro_context.rows, first);
+        } else if constexpr (decay_layer_traits<Layer>::is_neural_layer()) {
+            static constexpr size_t N = std::tuple_size<decltype(layer.trainable_parameters())>();
 
-            for (size_t i = 0; i < n; ++i) {
-                last_ctx.errors(i) = (labels(i) - out(i)) / ((1.0 - out(i)) >> out(i));
-            }
+            reduce_gradients_variables(context, micro_context, first, std::make_index_sequence<N>());
         } else {
-            last_ctx.errors = (labels - out) / ((1.0 - out) >> out);
+            cpp_unused(layer);
+            cpp_unused(context);
+            cpp_unused(micro_context);
+            cpp_unused(first);
         }
+    }
 
-        // Check for NAN before derivative
-        nan_check_etl(last_ctx.errors);
+    template <typename Layer, typename Context, typename MicroContext, size_t... I>
+    static void reduce_gradients_sub_layers(Layer& layer, Context& context, MicroContext& micro_context, bool first, std::index_sequence<I...> /*seq*/){
+        (reduce_gradients_layer(std::get<I>(layer.layers), std::get<I>(context.sub_contexts), std::get<I>(micro_context.sub_contexts), first), ...);
+    }
 
-        // Multiply by the derivative of the activation function
-        last_layer.adapt_errors(last_ctx);
+    template <typename Context, typename MicroContext, size_t... I>
+    static void reduce_gradients_variables(Context& context, MicroContext& micro_context, bool first, std::index_sequence<I...> /*seq*/){
+        (reduce_gradients_variable(std::get<I>(context.up.context)->grad, std::get<I>(micro_context.up.context)->grad, first), ...);
+    }
 
-        // Check for NAN after derivative
-        nan_check_etl(last_ctx.errors);
+    template <typename G, typename MG>
+    static void reduce_gradients_variable(G& grad, const MG& micro_grad, bool first){
+        if (first) {
+            grad = micro_grad;
+        } else {
+            grad += micro_grad;
+        }
     }
 
     /*!
-     * \brief Train a batch of data
-     * \param epoch The current epoch
-     * \param inputs A batch of inputs
-     * \param labels A batch of labels
-     * \return a pair containing the error and the loss for the batch
+     * \brief Call the given functor on the gradients of each variable of
+     * the given layer
      */
-    template <typename Inputs, typename Labels>
-    std::pair<double, double> train_batch(size_t epoch, const Inputs& inputs, const Labels& labels) {
-        dll::auto_timer timer("sgd::train_batch");
+    template <typename Layer, typename Context, typename Functor>
+    static void for_each_gradient(Layer& layer, Context& context, Functor&& functor){
+        if constexpr (is_utility_layer<Layer>) {
+            cpp::for_each(layer.layers, context.sub_contexts, [&functor](auto& sub_layer, auto& sub_context) {
+                this_type::for_each_gradient(sub_layer, sub_context, functor);
+            });
+        } else if constexpr (decay_layer_traits<Layer>::is_neural_layer()) {
+            static constexpr size_t N = std::tuple_size<decltype(layer.trainable_parameters())>();
 
-        auto& first_layer = std::get<0>(full_context).first;
-        auto& first_ctx   = *std::get<0>(full_context).second;
-        auto& last_ctx    = *std::get<layers - 1>(full_context).second;
+            for_each_gradient_variables(context, functor, std::make_index_sequence<N>());
+        } else {
+            cpp_unused(layer);
+            cpp_unused(context);
+            cpp_unused(functor);
+        }
+    }
 
-        const auto n          = etl::dim<0>(inputs);
-        const bool full_batch = n == etl::dim<0>(first_ctx.input);
+    template <typename Context, typename Functor, size_t... I>
+    static void for_each_gradient_variables(Context& context, Functor& functor, std::index_sequence<I...> /*seq*/){
+        (functor(std::get<I>(context.up.context)->grad), ...);
+    }
 
-        // Ensure that the data batch and the label batch are of the same size
-        cpp_assert(n == etl::dim<0>(labels), "Invalid sizes");
+    /*!
+     * \brief Accumulate the gradients of the main context and update the
+     * weights once enough batches have been accumulated
+     * \param epoch The current epoch
+     * \param n The number of samples in the batch
+     */
+    void accumulate_gradients(size_t epoch, size_t n){
+        const bool first = accumulated == 0;
+        const bool last  = accumulated + 1 == accumulated_batches;
+
+        size_t v = 0;
+
+        cpp::for_each(full_context, [this, first, last, &v](auto& layer_ctx) {
+            this_type::for_each_gradient(layer_ctx.first, *layer_ctx.second, [this, first, last, &v](auto& grad) {
+                if (first && accumulated_grads.size() == v) {
+                    accumulated_grads.emplace_back(etl::size(grad));
+                }
+
+                auto& acc = accumulated_grads[v++];
+
+                if constexpr (gpu_resident) {
+                    // The accumulation stays on the device
+                    auto flat = etl::reshape(grad, etl::size(grad));
+
+                    if (last) {
+                        flat += acc;
+                    } else if (first) {
+                        acc = flat;
+                    } else {
+                        acc += flat;
+                    }
+
+                    return;
+                }
+
+                grad.ensure_cpu_up_to_date();
+
+                weight* acc_p  = acc.memory_start();
+                weight* grad_p = grad.memory_start();
+                const size_t s = etl::size(grad);
+
+                if (last) {
+                    // The last batch is directly summed into the gradients
+                    for (size_t i = 0; i < s; ++i) {
+                        grad_p[i] += acc_p[i];
+                    }
+
+                    grad.invalidate_gpu();
+                } else if (first) {
+                    std::copy(grad_p, grad_p + s, acc_p);
+                } else {
+                    for (size_t i = 0; i < s; ++i) {
+                        acc_p[i] += grad_p[i];
+                    }
+                }
+            });
+        });
 
-        // Ensure that the context can hold the inputs
-        cpp_assert(n <= etl::dim<0>(first_ctx.input), "Invalid sizes");
+        ++accumulated;
+        accumulated_n += n;
+        last_epoch = epoch;
 
-        //Feedforward pass
+        if (last) {
+            update_accumulated(epoch);
+        }
+    }
 
-        {
-            dll::auto_timer timer("sgd::forward");
+    /*!
+     * \brief Copy the accumulated gradients of a variable back into its
+     * gradients
+     */
+    template <typename G>
+    static void restore_gradient(G& grad, const etl::dyn_vector<weight>& acc) {
+        if constexpr (gpu_resident) {
+            etl::reshape(grad, etl::size(grad)) = acc;
 
-            forward_batch_helper<true>(inputs);
+            return;
         }
 
-        {
-            dll::auto_timer timer("sgd::backward");
-
-            //Compute the errors of the last layer
+        std::copy(acc.memory_start(), acc.memory_start() + etl::size(grad), grad.memory_start());
 
-            last_errors<dbn_t::loss>(full_batch, n, labels);
+        grad.invalidate_gpu();
+    }
 
-            // Backpropagate the error
+    /*!
+     * \brief Update the weights with the accumulated gradients, which must
+     * have been summed in the main context
+     * \param epoch The current epoch
+     */
+    void update_accumulated(size_t epoch){
+        update_all_weights(epoch, accumulated_n);
 
-            bool last = true;
+        accumulated   = 0;
+        accumulated_n = 0;
+    }
 
-            cpp::for_each_rpair(full_context, [&last](auto& layer_ctx_1, auto& layer_ctx_2) {
-                backward_layer(layer_ctx_2.first, *layer_ctx_2.second, get_errors(*layer_ctx_1.second), last);
-            });
+    /*!
+     * \brief Update all the weights of the network from the gradients of
+     * the main context.
+     *
+     * With loss scaling, the update is skipped and the loss scale is
+     * halved when the gradients overflowed. The loss scale is doubled
+     * after loss_scale_window updates without overflow.
+     *
+     * \param epoch The current epoch
+     * \param n The number of samples of the gradients
+     */
+    void update_all_weights(size_t epoch, size_t n){
+        if constexpr (dbn_traits<dbn_t>::has_loss_scaling()) {
+            if (!finite_gradients()) {
+                dbn.loss_scale = std::max(weight(1.0), dbn.loss_scale / weight(2.0));
+                scaled_updates = 0;
 
-            first_layer.adapt_errors(first_ctx);
+                return;
+            }
         }
 
-        // Compute and apply the gradients
-
-        {
-            dll::auto_timer timer("sgd::grad");
+        cpp::for_each(full_context, [this, epoch, n](auto& layer_ctx) {
+            if (this->is_trained(*layer_ctx.second)) {
+                this->update_weights_layer(epoch, n, layer_ctx.first, *layer_ctx.second);
+            }
+        });
 
-            cpp::for_each(full_context, [this, epoch, n](auto& layer_ctx) {
-                this->apply_gradients_layer(epoch, n, layer_ctx.first, *layer_ctx.second);
-            });
+        if constexpr (dbn_traits<dbn_t>::has_loss_scaling()) {
+            if (++scaled_updates == dbn.loss_scale_window) {
+                dbn.loss_scale *= 2.0;
+                scaled_updates = 0;
+            }
         }
 
         // Update the counter of iterations
         ++iteration;
+    }
 
-        // Compute error and loss
+    /*!
+     * \brief Indicates if all the gradients of the main context are finite
+     */
+    bool finite_gradients(){
+        bool finite = true;
 
-        {
-            dll::auto_timer timer("sgd::error");
+        cpp::for_each(full_context, [&finite](auto& layer_ctx) {
+            this_type::for_each_gradient(layer_ctx.first, *layer_ctx.second, [&finite](auto& grad) {
+                if constexpr (gpu_resident) {
+                    // Only the sum is read back, an overflow of the sum is
+                    // considered as an overflow of the gradients
+                    finite = finite && std::isfinite(etl::sum(grad));
 
-            auto[error, loss] = dbn.evaluate_metrics_batch(last_ctx.output, labels, n, true);
+                    return;
+                }
 
-            return std::make_pair(error, loss);
+                grad.ensure_cpu_up_to_date();
+
+                const weight* grad_p = grad.memory_start();
+
+                for (size_t i = 0; finite && i < etl::size(grad); ++i) {
+                    finite = std::isfinite(grad_p[i]);
+                }
+            });
+        });
+
+        return finite;
+    }
+
+    /*!
+     * \brief Update the weights of the given layer from the gradients of
+     * its context
+     */
+    template <typename Layer, typename Context>
+    void update_weights_layer(size_t epoch, size_t n, Layer& layer, Context& context){
+        if constexpr (is_utility_layer<Layer>) {
+            cpp::for_each(layer.layers, context.sub_contexts, [this, epoch, n](auto& sub_layer, auto& sub_context) {
+                this->update_weights_layer(epoch, n, sub_layer, sub_context);
+            });
+        } else {
+            this->update_weights<dbn_traits<dbn_t>::updater()>(epoch, layer, context, n);
         }
     }
 
@@ -700,7 +2248,11 @@ struct sgd_trainer {
             });
         } else {
             // Compute the gradients
-            layer.compute_gradients(context);
+            {
+                dll::auto_timer timer(layer_timers<context_layer<Context>::value>::backward());
+
+                layer.compute_gradients(context);
+            }
 
             // Apply the gradients
             this->update_weights<dbn_traits<dbn_t>::updater()>(epoch, layer, context, n);
@@ -709,6 +2261,8 @@ struct sgd_trainer {
 
     template <typename Layer, typename Context, typename Errors, cpp_disable_iff(is_utility_layer<Layer>)>
     static void backward_layer(Layer& layer, Context& context, Errors&& errors, bool& last){
+        dll::auto_timer timer(layer_timers<context_layer<Context>::value>::backward());
+
         if(!last){
             layer.adapt_errors(context);
         }
@@ -749,48 +2303,134 @@ struct sgd_trainer {
     static void backward_layer(Layer& layer, Context& context, Errors&& errors, bool& last){
         errors = 0;
 
-        // Dispatch all the sub contexts
+        // The first branch backpropagates directly into the errors, the
+        // others into zeroed buffers that are added to the errors
+
+        if (context.parallel) {
+            std::vector<std::decay_t<Errors>> back_errors(Layer::n_layers - 1, errors);
+
+            task_group branches;
+
+            cpp::for_each_i(layer.layers, context.sub_contexts, [&context, &errors, &back_errors, &branches, last](size_t i, auto& sub_layer, auto& sub_context) {
+                branches.run([&context, &errors, &back_errors, &sub_layer, &sub_context, last, i] {
+                    batch_dispatch(get_errors(sub_context), context.errors, i);
+
+                    bool sub_last = last;
 
-        cpp::for_each_i(layer.layers, context.sub_contexts, [&context, &errors, &last](size_t i, auto& sub_layer, auto& sub_context){
-            batch_dispatch(get_errors(sub_context), context.errors, i);
+                    if (i == 0) {
+                        backward_layer(sub_layer, sub_context, errors, sub_last);
+                    } else {
+                        backward_layer(sub_layer, sub_context, back_errors[i - 1], sub_last);
+                    }
+                });
+            });
+
+            branches.wait();
 
+            for (auto& branch_errors : back_errors) {
+                errors += branch_errors;
+            }
+        } else {
             auto back_errors = errors;
 
-            bool sub_last = last;
-            backward_layer(sub_layer, sub_context, back_errors, sub_last);
+            // Dispatch all the sub contexts
 
-            errors += back_errors;
-        });
+            cpp::for_each_i(layer.layers, context.sub_contexts, [&context, &errors, &back_errors, &last](size_t i, auto& sub_layer, auto& sub_context){
+                batch_dispatch(get_errors(sub_context), context.errors, i);
+
+                bool sub_last = last;
+
+                if (i == 0) {
+                    backward_layer(sub_layer, sub_context, errors, sub_last);
+                } else {
+                    if (i > 1) {
+                        back_errors = 0;
+                    }
+
+                    backward_layer(sub_layer, sub_context, back_errors, sub_last);
+
+                    errors += back_errors;
+                }
+            });
+        }
 
         last = false;
     }
 
-    template <bool Train, typename Layer, typename Inputs, typename Context, cpp_disable_iff(is_utility_layer<Layer>)>
-    static void forward_layer(Layer& layer, Inputs&& inputs, Context& context) {
-        context.input = inputs;
-
-        if constexpr (Train) {
+    /*!
+     * \brief Apply the training forward pass of the given layer on the
+     * input of its context, letting the layer record state in its context
+     * if it needs it
+     */
+    template <typename Layer, typename Context>
+    static void train_forward_context(Layer& layer, Context& context) {
+        if constexpr (is_logits_context<Context>()) {
+            // The softmax is computed together with the loss (last_errors)
+            layer.forward_logits_batch(context.output, context.input);
+        } else if constexpr (has_context_forward<Layer, Context>::value) {
+            layer.train_forward_batch(context.output, context.input, context);
+        } else {
             layer.train_forward_batch(context.output, context.input);
+        }
+    }
+
+    /*!
+     * \brief Apply the forward pass of the given layer on the input of its
+     * context.
+     *
+     * The shape layers do not copy their input into their output, their
+     * input is directly used as their output (see get_output). The
+     * contexts computed in place replace their input by their output.
+     */
+    template <bool Train, typename Layer, typename Context>
+    static void forward_context_layer(Layer& layer, Context& context) {
+        if constexpr (decay_layer_traits<Layer>::is_shape_layer()) {
+            cpp_unused(layer);
+            cpp_unused(context);
+        } else if constexpr (is_in_place_context<Context>::value) {
+            layer.forward_in_place(context.input);
+        } else if constexpr (Train) {
+            train_forward_context(layer, context);
         } else {
             layer.test_forward_batch(context.output, context.input);
         }
     }
 
+    /*!
+     * \brief Copy the inputs into the input of a context, unless the input
+     * is already a view of them (chained contexts)
+     */
+    template <typename Input, typename Inputs>
+    static void assign_input(Input& input, const Inputs& inputs) {
+        if constexpr (etl::is_dma<Input> && etl::is_dma<Inputs>) {
+            if (input.memory_start() == inputs.memory_start()) {
+                return;
+            }
+        }
+
+        input = inputs;
+    }
+
+    template <bool Train, typename Layer, typename Inputs, typename Context, cpp_disable_iff(is_utility_layer<Layer>)>
+    static void forward_layer(Layer& layer, Inputs&& inputs, Context& context) {
+        dll::auto_timer timer(layer_timers<context_layer<Context>::value>::forward());
+
+        assign_input(context.input, inputs);
+
+        forward_context_layer<Train>(layer, context);
+    }
+
     template <bool Train, size_t L, typename Layer, typename Inputs, typename Context>
     static void forward_layer_group(Layer& layer, Inputs&& inputs, Context& context) {
         if constexpr (L < Layer::n_layers) {
             auto& sub_layer   = std::get<L>(layer.layers);
             auto& sub_context = std::get<L>(context.sub_contexts);
 
-            sub_context.input = inputs;
+            assign_input(sub_context.input, inputs);
 
-            if constexpr (Train) {
-                sub_layer.train_forward_batch(sub_context.output, sub_context.input);
-            } else {
-                sub_layer.test_forward_batch(sub_context.output, sub_context.input);
-            }
+            forward_context_layer<Train>(sub_layer, sub_context);
 
-            forward_layer_group<Train, L + 1>(layer, sub_context.output, context);
+            forward_layer_group<Train, L + 1>(layer, get_output(sub_context), context);
         }
     }
 
@@ -805,58 +2445,258 @@ struct sgd_trainer {
             auto& sub_layer   = std::get<L>(layer.layers);
             auto& sub_context = std::get<L>(context.sub_contexts);
 
-            forward_layer<Train>(sub_layer, inputs, sub_context);
+            forward_layer<Train>(sub_layer, inputs, sub_context);
+
+            forward_layer_merge<Train, L + 1>(layer, inputs, context);
+        }
+    }
+
+    template <bool Train, typename Layer, typename Inputs, typename Context, cpp_enable_iff(is_merge_layer<Layer>)>
+    static void forward_layer(Layer& layer, Inputs&& inputs, Context& context) {
+        dll::auto_timer timer(layer_timers<context_layer<Context>::value>::forward());
+
+        assign_input(context.input, inputs);
+
+        if (context.parallel) {
+            // The branches are independent, each one is merged into its slice of the output as soon as it is done
+
+            task_group branches;
+
+            cpp::for_each_i(layer.layers, context.sub_contexts, [&context, &branches](size_t i, auto& sub_layer, auto& sub_context) {
+                branches.run([&context, &sub_layer, &sub_context, i] {
+                    this_type::template forward_layer<Train>(sub_layer, context.input, sub_context);
+
+                    batch_merge(context.output, get_output(sub_context), i);
+                });
+            });
+
+            branches.wait();
+        } else {
+            // Fully forward each group
+
+            forward_layer_merge<Train, 0>(layer, context.input, context);
+
+            // Concatenate all the sub contexts
+
+            cpp::for_each_i(context.sub_contexts, [&context](size_t i, auto& sub_context){
+                batch_merge(context.output, get_output(sub_context), i);
+            });
+        }
+    }
+
+    template <typename Context>
+    static auto& get_output(Context& context) {
+        if constexpr (is_group_layer<typename Context::layer_t>) {
+            return get_output(std::get<Context::n_layers - 1>(context.sub_contexts));
+        } else if constexpr (decay_layer_traits<typename Context::layer_t>::is_shape_layer()) {
+            // A shape layer does not change its input
+            return context.input;
+        } else {
+            return context.output;
+        }
+    }
+
+    template <typename Context>
+    static auto& get_errors(Context& context) {
+        if constexpr (is_group_layer < typename Context::layer_t>) {
+            return get_errors(std::get<Context::n_layers - 1>(context.sub_contexts));
+        } else {
+            return context.errors;
+        }
+    }
+
+    //TODO
+    template <bool Train, typename Inputs>
+    auto& forward_batch_helper(dbn_t& dbn, Inputs&& inputs) {
+        cpp_unused(dbn);
+
+        return this->template forward_batch_helper<Train>(inputs);
+    }
+
+    template <bool Train, typename Inputs>
+    auto& forward_batch_helper(Inputs&& inputs) {
+        if (cached_prefix) {
+            return forward_cached<Train>(inputs);
+        }
+
+        if constexpr (checkpoint_every > 1) {
+            forward_first_layer<Train>(full_context, inputs, frozen_prefix);
+
+            // The activations of the released layers are released as soon as possible
+            checkpoint_forward<Train, true, 1, layers>();
+
+            return std::get<layers - 1>(full_context).second->output;
+        } else if constexpr (compressed_activations) {
+            expand_layer<0>();
+
+            forward_first_layer<Train>(full_context, inputs, frozen_prefix);
+
+            // The activations are compressed as soon as they are consumed
+            compressed_forward<Train, 1>();
+
+            return std::get<layers - 1>(full_context).second->output;
+        } else {
+            return forward_context<Train>(full_context, inputs, frozen_prefix);
+        }
+    }
+
+    /*!
+     * \brief Indicates if the trainer can be given the outputs of the first
+     * prefix layers instead of the inputs of the network (feature cache)
+     */
+    static bool cacheable_prefix(size_t prefix) {
+        if constexpr (micro_batches > 1 || checkpoint_every > 1 || compressed_activations) {
+            cpp_unused(prefix);
+            return false;
+        } else {
+            // The output of a convolution fused with the next layer is never computed
+            return prefix && prefix < layers && !conv_pool_at(prefix - 1, std::make_index_sequence<layers - 1>());
+        }
+    }
+
+    /*!
+     * \brief Returns the number of leading layers whose outputs are given
+     * as inputs (0 if the inputs are the inputs of the network)
+     */
+    size_t feature_prefix() const {
+        return cached_prefix;
+    }
+
+    /*!
+     * \brief Set the number of leading layers whose outputs are given as
+     * inputs, from the cached features of the frozen layers. These layers
+     * are not forwarded anymore. 0 goes back to the inputs of the network.
+     */
+    void set_feature_prefix(size_t prefix) {
+        cpp_assert(!prefix || cacheable_prefix(prefix), "The features of these layers cannot be cached");
+
+        cached_prefix = prefix;
+    }
+
+    /*!
+     * \brief Indicates if the given layer is a convolution fused with the
+     * next layer
+     */
+    template <size_t... L>
+    static bool conv_pool_at(size_t layer, std::index_sequence<L...> /*seq*/) {
+        return ((L == layer && conv_pool_next<L>()) || ...);
+    }
+
+    /*!
+     * \brief Forward the cached features of the first layers through the
+     * following layers of the main context
+     * \param features The outputs of the layer cached_prefix - 1, flattened
+     * \return The output of the last layer
+     */
+    template <bool Train, typename Features>
+    auto& forward_cached(Features&& features) {
+        cpp::for_each(full_context, [this, &features](auto& layer_ctx) {
+            using context_t = std::decay_t<decltype(*layer_ctx.second)>;
+
+            if (context_layer<context_t>::value + 1 == cached_prefix) {
+                this_type::assign_features(get_output(*layer_ctx.second), features);
+            }
+        });
+
+        cpp::for_each_pair(full_context, [this](auto& layer_ctx_1, auto& layer_ctx_2) {
+            using context_t = std::decay_t<decltype(*layer_ctx_2.second)>;
+
+            if (context_layer<context_t>::value >= cached_prefix) {
+                this_type::template forward_prefix_pair<Train>(layer_ctx_1, layer_ctx_2, frozen_prefix);
+            }
+        });
 
-            forward_layer_merge<Train, L + 1>(layer, inputs, context);
-        }
+        return std::get<layers - 1>(full_context).second->output;
     }
 
-    template <bool Train, typename Layer, typename Inputs, typename Context, cpp_enable_iff(is_merge_layer<Layer>)>
-    static void forward_layer(Layer& layer, Inputs&& inputs, Context& context) {
-        context.input = inputs;
+    /*!
+     * \brief Copy the flattened features of a batch into the output of a
+     * layer, clearing the rest of the batch
+     */
+    template <typename Output, typename Features>
+    static void assign_features(Output& output, const Features& features) {
+        const size_t n = etl::dim<0>(features);
+        const size_t F = etl::size(output) / etl::dim<0>(output);
 
-        // Fully forward each group
+        cpp_assert(n <= etl::dim<0>(output), "Invalid sizes");
+        cpp_assert(etl::size(features) == n * F, "The features do not match the output of the cached layers");
 
-        forward_layer_merge<Train, 0>(layer, context.input, context);
+        features.ensure_cpu_up_to_date();
 
-        // Concatenate all the sub contexts
+        std::copy_n(features.memory_start(), n * F, output.memory_start());
+        std::fill(output.memory_start() + n * F, output.memory_end(), weight(0));
 
-        cpp::for_each_i(context.sub_contexts, [&context](size_t i, auto& sub_context){
-            batch_merge(context.output, get_output(sub_context), i);
-        });
+        output.invalidate_gpu();
     }
 
-    template <typename Context>
-    static auto& get_output(Context& context) {
-        if constexpr (is_group_layer<typename Context::layer_t>) {
-            return get_output(std::get<Context::n_layers - 1>(context.sub_contexts));
-        } else {
-            return context.output;
-        }
+    /*!
+     * \brief Forward the given inputs through the given context
+     * \param context The context of the network
+     * \param inputs A batch of inputs
+     * \param frozen The number of leading frozen layers, forwarded in test mode
+     * \return The output of the last layer
+     */
+    template <bool Train, typename Context, typename Inputs>
+    static auto& forward_context(Context& context, Inputs&& inputs, size_t frozen = 0) {
+        auto& last_ctx = *std::get<layers - 1>(context).second;
+
+        forward_first_layer<Train>(context, inputs, frozen);
+
+        cpp::for_each_pair(context, [frozen](auto& layer_ctx_1, auto& layer_ctx_2) {
+            this_type::template forward_prefix_pair<Train>(layer_ctx_1, layer_ctx_2, frozen);
+        });
+
+        return last_ctx.output;
     }
 
-    template <typename Context>
-    static auto& get_errors(Context& context) {
-        if constexpr (is_group_layer < typename Context::layer_t>) {
-            return get_errors(std::get<Context::n_layers - 1>(context.sub_contexts));
+    /*!
+     * \brief Forward the inputs through the given layer, in test mode if the
+     * layer is part of the frozen prefix of the network. The frozen layers
+     * keep no training state (dropout masks, batch statistics, ...).
+     */
+    template <bool Train, typename Layer, typename Inputs, typename Context>
+    static void forward_prefix_layer(Layer& layer, Inputs&& inputs, Context& context, size_t frozen) {
+        if constexpr (conv_pool_next<context_layer<Context>::value>()) {
+            // The convolution is computed by the next layer
+            assign_input(context.input, inputs);
+        } else if (Train && context_layer<Context>::value < frozen) {
+            forward_layer<false>(layer, inputs, context);
         } else {
-            return context.errors;
+            forward_layer<Train>(layer, inputs, context);
         }
     }
 
-    //TODO
-    template <bool Train, typename Inputs>
-    auto& forward_batch_helper(dbn_t& dbn, Inputs&& inputs) {
-        cpp_unused(dbn);
+    /*!
+     * \brief Forward the outputs of the first layer through the second
+     * layer. A max pooling layer fused with a convolutional layer pools
+     * the convolution of the input of the convolutional layer.
+     */
+    template <bool Train, typename LayerContext1, typename LayerContext2>
+    static void forward_prefix_pair(LayerContext1& layer_ctx_1, LayerContext2& layer_ctx_2, size_t frozen) {
+        using context_t = std::decay_t<decltype(*layer_ctx_2.second)>;
 
-        return this->template forward_batch_helper<Train>(inputs);
+        constexpr size_t L = context_layer<context_t>::value;
+
+        if constexpr (conv_pool_next<L - 1>()) {
+            dll::auto_timer timer(layer_timers<L>::forward());
+
+            conv_pool_train_forward<std::decay_t<decltype(layer_ctx_2.first)>>(layer_ctx_1.first, layer_ctx_1.second->input, *layer_ctx_2.second);
+        } else {
+            forward_prefix_layer<Train>(layer_ctx_2.first, get_output(*layer_ctx_1.second), *layer_ctx_2.second, frozen);
+        }
     }
 
-    template <bool Train, typename Inputs>
-    auto& forward_batch_helper(Inputs&& inputs) {
-        auto& first_layer = std::get<0>(full_context).first;
-        auto& first_ctx   = *std::get<0>(full_context).second;
-        auto& last_ctx    = *std::get<layers - 1>(full_context).second;
+    /*!
+     * \brief Forward the given inputs through the first layer of the given
+     * context
+     * \param context The context of the network
+     * \param inputs A batch of inputs
+     * \param frozen The number of leading frozen layers, forwarded in test mode
+     */
+    template <bool Train, typename Context, typename Inputs>
+    static void forward_first_layer(Context& context, Inputs&& inputs, size_t frozen = 0) {
+        auto& first_layer = std::get<0>(context).first;
+        auto& first_ctx   = *std::get<0>(context).second;
 
         const auto n          = etl::dim<0>(inputs);
         const bool full_batch = n == etl::dim<0>(first_ctx.input);
@@ -865,27 +2705,62 @@ struct sgd_trainer {
         cpp_assert(n <= etl::dim<0>(first_ctx.input), "Invalid sizes");
 
         if (cpp_unlikely(!full_batch)) {
-            first_ctx.input  = 0;
-            first_ctx.output = 0;
+            // The output is completely overwritten by the forward pass
+            etl::slice(first_ctx.input, 0, n) = inputs;
 
-            for (size_t i = 0; i < etl::dim<0>(inputs); ++i) {
-                first_ctx.input(i) = inputs(i);
-            }
+            clear_tail(first_ctx.input, n);
         } else {
             first_ctx.input = inputs;
         }
 
-        if constexpr (Train) {
-            first_layer.train_forward_batch(first_ctx.output, first_ctx.input);
+        dll::auto_timer timer(layer_timers<0>::forward());
+
+        if constexpr (conv_pool_next<0>()) {
+            // The convolution is computed by the next layer
+            cpp_unused(first_layer);
+            cpp_unused(frozen);
+        } else if (Train && frozen) {
+            forward_context_layer<false>(first_layer, first_ctx);
         } else {
-            first_layer.test_forward_batch(first_ctx.output, first_ctx.input);
+            forward_context_layer<Train>(first_layer, first_ctx);
         }
+    }
 
-        cpp::for_each_pair(full_context, [this](auto& layer_ctx_1, auto& layer_ctx_2) {
-            this->template forward_layer<Train>(layer_ctx_2.first, get_output(*layer_ctx_1.second), *layer_ctx_2.second);
-        });
+    /*!
+     * \brief Forward the inputs already in the context of the first layer
+     * through the main context
+     * \return The output of the last layer
+     */
+    template <bool Train>
+    auto& forward_inplace() {
+        auto& first_layer = std::get<0>(full_context).first;
+        auto& first_ctx   = *std::get<0>(full_context).second;
 
-        return last_ctx.output;
+        if constexpr (compressed_activations) {
+            expand_layer<0>();
+        }
+
+        if constexpr (!conv_pool_next<0>()) {
+            dll::auto_timer timer(layer_timers<0>::forward());
+
+            if (Train && frozen_prefix) {
+                forward_context_layer<false>(first_layer, first_ctx);
+            } else {
+                forward_context_layer<Train>(first_layer, first_ctx);
+            }
+        }
+
+        if constexpr (checkpoint_every > 1) {
+            checkpoint_forward<Train, true, 1, layers>();
+        } else if constexpr (compressed_activations) {
+            compressed_forward<Train, 1>();
+        } else {
+            cpp::for_each_pair(full_context, [this](auto& layer_ctx_1, auto& layer_ctx_2) {
+                this_type::template forward_prefix_pair<Train>(layer_ctx_1, layer_ctx_2, frozen_prefix);
+            });
+        }
+
+        return std::get<layers - 1>(full_context).second->output;
     }
 
     /*!
@@ -901,6 +2776,17 @@ struct sgd_trainer {
             static constexpr size_t N = std::tuple_size<decltype(layer.trainable_parameters())>();
 
             update_variables<UT>(epoch, layer, context, n, std::make_index_sequence<N>());
+
+            // Refresh the values cached from the weights (Winograd filters)
+            if constexpr (has_weights_changed<L>::value) {
+                layer.weights_changed();
+            }
+
+            // The sparse gradients have been consumed
+            if constexpr (has_sparse_rows<C>::value) {
+                zero_rows(std::get<0>(context.up.context)->grad, context.rows);
+                context.rows.clear();
+            }
         }
     }
 
@@ -911,146 +2797,450 @@ struct sgd_trainer {
 
     template <size_t I, updater_type UT, typename L, typename C>
     void update_variable(size_t epoch, L& layer, C& context, size_t n) {
-        // 1. Decay the learning rate (if necessary)
+        // 1. Compute the learning rate (schedule and decay)
 
-        auto eps             = dbn.learning_rate;
+        weight eps           = dbn_t::lr_schedule_t::rate(dbn, epoch, iteration, max_epochs);
         const auto eps_decay = dbn.learning_rate_decay;
 
         if (eps_decay > 0.0) {
             eps *= 1.0 / (1.0 + eps_decay * iteration);
         }
 
-        //2. Update the gradients (L1/L2 and gradient clipping)
-
-        auto& w      = std::get<I>(layer.trainable_parameters());
-        auto& w_grad = std::get<I>(context.up.context)->grad;
+        // 2. Prepare the update of the gradients (L1/L2 and gradient clipping)
 
         // Note the distinction for w and b for decay is far from optimal...
-        if constexpr (I == 0) {
-            this->update_grad<w_decay(dbn_traits<dbn_t>::decay())>(w, w_grad, n);
+        static constexpr decay_type decay = I == 0 ? w_decay(dbn_traits<dbn_t>::decay()) : b_decay(dbn_traits<dbn_t>::decay());
+
+        auto& w   = std::get<I>(layer.trainable_parameters());
+        auto& ctx = *std::get<I>(context.up.context);
+
+        if constexpr (gpu_resident && !(I == 0 && has_sparse_rows<C>::value)) {
+            // The variable, its gradients and the state of the updater stay on the device
+            apply_gradients_device<I, UT, decay>(w, ctx, n, eps);
+
+            return;
+        }
+
+        w.ensure_cpu_up_to_date();
+        ctx.grad.ensure_cpu_up_to_date();
+
+        grad_params params;
+        params.l1      = dbn.l1_weight_cost;
+        params.l2      = dbn.l2_weight_cost;
+        params.unscale = 1.0 / dbn.loss_scale;
+        params.keep    = 1.0 - eps * dbn.l2_weight_cost;
+        params.scale   = clip_scale<decay>(w, ctx.grad, params, n);
+
+        // 3. Apply the gradients, in a single pass over the variable (or
+        // only over its rows with non-zero gradients, lazily)
+
+        update_range range{etl::size(w)};
+
+        if constexpr (I == 0 && has_sparse_rows<C>::value) {
+            range.rows     = &context.rows;
+            range.row_size = etl::dim<1>(w);
+        }
+
+        apply_gradients<I, UT, decay>(epoch, w, ctx, n, eps, params, range);
+
+        w.invalidate_gpu();
+
+        nan_check_deep(w);
+    }
+
+    /*!
+     * \brief Apply the gradients to the given variable with ETL
+     * expressions only, which are evaluated on the GPU when the training
+     * stays on the GPU.
+     *
+     * The gradients are first updated in place (loss scale, decay and
+     * clipping). The norm of the gradients for clipping is the only value
+     * read back by the host.
+     */
+    template <size_t I, updater_type UT, decay_type decay, typename V, typename C>
+    void apply_gradients_device(V& w, C& ctx, size_t n, weight eps) {
+        dll::auto_timer timer("sgd::apply_grad:device");
+
+        auto& g = ctx.grad;
+
+        const weight f = eps / n;
+        const weight e = 1e-8;
+
+        // 1. Update the gradients, the loss scale and the decay in a single expression
+
+        const weight u = dbn_traits<dbn_t>::has_loss_scaling() ? weight(1.0 / dbn.loss_scale) : weight(1.0);
+
+        if constexpr (decay == decay_type::L1) {
+            g = u * g - dbn.l1_weight_cost * etl::abs(w);
+        } else if constexpr (decay == decay_type::L2) {
+            g = u * g - dbn.l2_weight_cost * w;
+        } else if constexpr (decay == decay_type::L1L2) {
+            g = u * g - dbn.l1_weight_cost * etl::abs(w) - dbn.l2_weight_cost * w;
+        } else if constexpr (dbn_traits<dbn_t>::has_loss_scaling()) {
+            g *= u;
+        }
+
+        if constexpr (dbn_traits<dbn_t>::has_clip_gradients()) {
+            const auto t            = dbn.gradient_clip;
+            const auto grad_l2_norm = std::sqrt(etl::sum(g >> g) / (n * n));
+
+            if (grad_l2_norm > t) {
+                g *= weight(t / grad_l2_norm);
+            }
+        }
+
+        // 2. Apply the gradients
+
+        if constexpr (decay == decay_type::DECOUPLED) {
+            w *= weight(1.0 - eps * dbn.l2_weight_cost);
+        }
+
+        if constexpr (UT == updater_type::SGD) {
+            w += f * g;
+        } else if constexpr (UT == updater_type::MOMENTUM) {
+            ctx.inc = dbn.momentum * ctx.inc + f * g;
+
+            w += ctx.inc;
+        } else if constexpr (UT == updater_type::NESTEROV) {
+            const weight momentum = dbn.momentum;
+
+            // -momentum * inc + (1 + momentum) * (momentum * inc + f * g)
+            w += (momentum * momentum) * ctx.inc + ((1.0 + momentum) * f) * g;
+
+            ctx.inc = momentum * ctx.inc + f * g;
+        } else if constexpr (UT == updater_type::ADAGRAD) {
+            ctx.inc += g >> g;
+
+            w += (eps * g) / etl::sqrt(ctx.inc + e);
+        } else if constexpr (UT == updater_type::ADADELTA) {
+            const weight beta = dbn.adadelta_beta;
+
+            ctx.g = beta * ctx.g + (1.0 - beta) * (g >> g);
+            ctx.v = (etl::sqrt(ctx.x + e) >> g) / etl::sqrt(ctx.g + e);
+            ctx.x = beta * ctx.x + (1.0 - beta) * (ctx.v >> ctx.v);
+
+            w += ctx.v;
+        } else if constexpr (UT == updater_type::ADAM || UT == updater_type::ADAM_CORRECT) {
+            const weight beta1 = dbn.adam_beta1;
+            const weight beta2 = dbn.adam_beta2;
+
+            ctx.m = beta1 * ctx.m + (1.0 - beta1) * g;
+            ctx.v = beta2 * ctx.v + (1.0 - beta2) * (g >> g);
+
+            if constexpr (UT == updater_type::ADAM_CORRECT) {
+                const weight c1 = 1.0 / (1.0 - std::pow(beta1, iteration));
+                const weight c2 = 1.0 / (1.0 - std::pow(beta2, iteration));
+
+                w += ((eps * c1) * ctx.m) / (etl::sqrt(c2 * ctx.v) + e);
+            } else {
+                w += (eps * ctx.m) / (etl::sqrt(ctx.v) + e);
+            }
+        } else if constexpr (UT == updater_type::ADAMAX) {
+            const weight beta1 = dbn.adam_beta1;
+            const weight beta2 = dbn.adam_beta2;
+
+            ctx.m = beta1 * ctx.m + (1.0 - beta1) * g;
+            ctx.v = etl::max(beta2 * ctx.v, etl::abs(g));
+
+            w += (eps * ctx.m) / ctx.v;
+        } else if constexpr (UT == updater_type::NADAM) {
+            const weight beta1          = dbn.adam_beta1;
+            const weight beta2          = dbn.adam_beta2;
+            const weight schedule_decay = dbn.nadam_schedule_decay;
+            const weight t              = iteration;
+
+            auto& m_schedule = ctx.m_schedule;
+
+            weight momentum_cache_t   = beta1 * (1.0 - 0.5 * (std::pow(0.96, t * schedule_decay)));
+            weight momentum_cache_t_1 = beta1 * (1.0 - 0.5 * (std::pow(0.96, (t + 1) * schedule_decay)));
+
+            weight m_schedule_new  = m_schedule * momentum_cache_t;
+            weight m_schedule_next = m_schedule * momentum_cache_t * momentum_cache_t_1;
+
+            if constexpr (I == 0) {
+                m_schedule = m_schedule_new;
+            }
+
+            const weight c1 = 1.0 / (1.0 - m_schedule_next);
+            const weight c2 = 1.0 / (1.0 - std::pow(beta2, t));
+
+            const weight m1 = eps * ((1.0 - momentum_cache_t) / (1.0 - m_schedule_new));
+            const weight m2 = eps * momentum_cache_t_1 * c1;
+
+            ctx.m = beta1 * ctx.m + (1.0 - beta1) * g;
+            ctx.v = beta2 * ctx.v + (1.0 - beta2) * (g >> g);
+
+            w += (m1 * g + m2 * ctx.m) / (etl::sqrt(c2 * ctx.v) + e);
+        } else if constexpr (UT == updater_type::RMSPROP) {
+            const weight decay_rate = dbn.rmsprop_decay;
+
+            ctx.inc = decay_rate * ctx.inc + (1.0 - decay_rate) * (g >> g);
+
+            w += (eps * g) / etl::sqrt(ctx.inc + e);
+        }
+    }
+
+    /*!
+     * \brief The parameters used to update the gradients on the fly in the
+     * fused update kernels
+     */
+    struct grad_params {
+        weight l1;      ///< The L1 weight cost
+        weight l2;      ///< The L2 weight cost
+        weight unscale; ///< The inverse of the loss scale (loss scaling)
+        weight scale;   ///< The scaling factor of the gradients (clipping)
+        weight keep;    ///< The factor of the variable (decoupled weight decay)
+    };
+
+    /*!
+     * \brief The elements of a variable updated by the update kernels, all
+     * the elements or only the rows with sparse gradients
+     */
+    struct update_range {
+        size_t size;                               ///< The number of elements of the variable
+        const std::vector<size_t>* rows = nullptr; ///< The rows to update (all the elements if nullptr)
+        size_t row_size                 = 0;       ///< The number of elements of a row
+
+        /*!
+         * \brief Call the given functor with the index of each element to update
+         */
+        template <typename F>
+        void operator()(F&& f) const {
+            if (!rows) {
+                for (size_t i = 0; i < size; ++i) {
+                    f(i);
+                }
+            } else {
+                for (auto r : *rows) {
+                    for (size_t i = r * row_size; i < (r + 1) * row_size; ++i) {
+                        f(i);
+                    }
+                }
+            }
+        }
+    };
+
+    /*!
+     * \brief Returns one gradient, unscaled from the loss scale, updated
+     * according to the given decay function and scaled for clipping
+     */
+    template <decay_type decay>
+    static weight effective_grad(weight g, weight w, const grad_params& params) {
+        if constexpr (dbn_traits<dbn_t>::has_loss_scaling()) {
+            g *= params.unscale;
+        }
+
+        if constexpr (decay == decay_type::L1) {
+            g -= params.l1 * std::abs(w);
+        } else if constexpr (decay == decay_type::L2) {
+            g -= params.l2 * w;
+        } else if constexpr (decay == decay_type::L1L2) {
+            g -= params.l1 * std::abs(w) + params.l2 * w;
+        }
+
+        if constexpr (dbn_traits<dbn_t>::has_clip_gradients()) {
+            g *= params.scale;
+        }
+
+        return g;
+    }
+
+    /*!
+     * \brief Returns one value of the variable before its update, shrunk
+     * for decoupled weight decay. The decay does not go through the
+     * gradients, and therefore through the moments of the adaptive
+     * updaters (AdamW).
+     */
+    template <decay_type decay>
+    static weight decayed(weight w, const grad_params& params) {
+        if constexpr (decay == decay_type::DECOUPLED) {
+            return params.keep * w;
         } else {
-            this->update_grad<b_decay(dbn_traits<dbn_t>::decay())>(w, w_grad, n);
+            cpp_unused(params);
+            return w;
         }
+    }
+
+    /*!
+     * \brief Compute the scaling factor of the gradients for clipping.
+     *
+     * This is the only additional pass, and it only reads the gradients
+     * (and the weights when they are decayed).
+     */
+    template <decay_type decay, typename V, typename G>
+    weight clip_scale(const V& value, const G& grad, const grad_params& params, size_t n) {
+        if constexpr (dbn_traits<dbn_t>::has_clip_gradients()) {
+            const auto t = dbn.gradient_clip;
+
+            const weight* w_p = value.memory_start();
+            const weight* g_p = grad.memory_start();
+
+            grad_params unscaled = params;
+            unscaled.scale       = 1.0;
+
+            double sum = 0.0;
 
-        // 3. Apply the gradients
+            for (size_t i = 0; i < etl::size(grad); ++i) {
+                const weight g = effective_grad<decay>(g_p[i], w_p[i], unscaled);
 
-        apply_gradients<I, UT>(epoch, layer, context, n, eps);
+                sum += g * g;
+            }
+
+            const auto grad_l2_norm = std::sqrt(sum / (n * n));
+
+            if (grad_l2_norm > t) {
+                return t / grad_l2_norm;
+            }
+        } else {
+            cpp_unused(value);
+            cpp_unused(grad);
+            cpp_unused(params);
+            cpp_unused(n);
+        }
+
+        return 1.0;
     }
 
     /*!
-     * \brief Apply the gradients to the given layer
+     * \brief Apply the gradients to the given variable
      */
-    template <size_t I, updater_type UT, typename L, typename C, cpp_enable_iff(UT == updater_type::SGD)>
-    void apply_gradients(size_t epoch, L& layer, C& context, size_t n, weight eps) {
+    template <size_t I, updater_type UT, decay_type decay, typename V, typename C, cpp_enable_iff(UT == updater_type::SGD)>
+    void apply_gradients(size_t epoch, V& value, C& ctx, size_t n, weight eps, const grad_params& params, const update_range& range) {
         dll::auto_timer timer("sgd::apply_grad:sgd");
 
-        auto& w      = std::get<I>(layer.trainable_parameters());
-        auto& w_grad = std::get<I>(context.up.context)->grad;
+        const weight f = eps / n;
 
-        w += (eps / n) * w_grad;
+        weight* w_p       = value.memory_start();
+        const weight* g_p = ctx.grad.memory_start();
 
-        nan_check_deep(w);
+        range([&](size_t i) {
+            w_p[i] = decayed<decay>(w_p[i], params) + f * effective_grad<decay>(g_p[i], w_p[i], params);
+        });
 
         cpp_unused(epoch);
     }
 
     /*!
-     * \brief Apply the gradients to the given layer
+     * \brief Apply the gradients to the given variable
      */
-    template <size_t I, updater_type UT, typename L, typename C, cpp_enable_iff(UT == updater_type::MOMENTUM)>
-    void apply_gradients(size_t epoch, L& layer, C& context, size_t n, weight eps) {
+    template <size_t I, updater_type UT, decay_type decay, typename V, typename C, cpp_enable_iff(UT == updater_type::MOMENTUM)>
+    void apply_gradients(size_t epoch, V& value, C& ctx, size_t n, weight eps, const grad_params& params, const update_range& range) {
         dll::auto_timer timer("sgd::apply_grad:momentum");
 
-        const auto momentum = dbn.momentum;
+        const weight momentum = dbn.momentum;
+        const weight f        = eps / n;
 
-        auto& w      = std::get<I>(layer.trainable_parameters());
-        auto& w_grad = std::get<I>(context.up.context)->grad;
-        auto& w_inc  = std::get<I>(context.up.context)->inc;
+        ctx.inc.ensure_cpu_up_to_date();
+
+        weight* w_p       = value.memory_start();
+        const weight* g_p = ctx.grad.memory_start();
+        weight* inc_p     = ctx.inc.memory_start();
 
         //Update with momentum and learning rate
 
-        w_inc = momentum * w_inc + (eps / n) * w_grad;
+        range([&](size_t i) {
+            const weight g = effective_grad<decay>(g_p[i], w_p[i], params);
 
-        w += w_inc;
+            inc_p[i] = momentum * inc_p[i] + f * g;
+            w_p[i] = decayed<decay>(w_p[i], params) + inc_p[i];
+        });
 
-        nan_check_deep(w);
+        ctx.inc.invalidate_gpu();
 
         cpp_unused(epoch);
     }
 
     /*!
-     * \brief Apply the gradients to the given layer
+     * \brief Apply the gradients to the given variable
      */
-    template <size_t I, updater_type UT, typename L, typename C, cpp_enable_iff(UT == updater_type::NESTEROV)>
-    void apply_gradients(size_t epoch, L& layer, C& context, size_t n, weight eps) {
+    template <size_t I, updater_type UT, decay_type decay, typename V, typename C, cpp_enable_iff(UT == updater_type::NESTEROV)>
+    void apply_gradients(size_t epoch, V& value, C& ctx, size_t n, weight eps, const grad_params& params, const update_range& range) {
         dll::auto_timer timer("sgd::apply_grad:nesterov");
 
-        const auto momentum = dbn.momentum;
+        const weight momentum = dbn.momentum;
+        const weight f        = eps / n;
 
-        auto& w          = std::get<I>(layer.trainable_parameters());
-        auto& w_grad     = std::get<I>(context.up.context)->grad;
-        auto& w_inc      = std::get<I>(context.up.context)->inc;
-        auto& w_inc_prev = std::get<I>(context.up.context)->inc_prev;
+        ctx.inc.ensure_cpu_up_to_date();
 
-        //Update with momentum and learning rate
+        weight* w_p       = value.memory_start();
+        const weight* g_p = ctx.grad.memory_start();
+        weight* inc_p     = ctx.inc.memory_start();
 
-        w_inc_prev = w_inc;
+        //Update with momentum and learning rate
 
-        w_inc = momentum * w_inc + (eps / n) * w_grad;
+        range([&](size_t i) {
+            const weight g        = effective_grad<decay>(g_p[i], w_p[i], params);
+            const weight inc_prev = inc_p[i];
 
-        w += -momentum * w_inc_prev + (1.0 + momentum) * w_inc;
+            inc_p[i] = momentum * inc_prev + f * g;
+            w_p[i] = decayed<decay>(w_p[i], params) + -momentum * inc_prev + (1.0 + momentum) * inc_p[i];
+        });
 
-        nan_check_deep(w);
+        ctx.inc.invalidate_gpu();
 
         cpp_unused(epoch);
     }
 
     /*!
-     * \brief Apply the gradients to the given layer
+     * \brief Apply the gradients to the given variable
      */
-    template <size_t I, updater_type UT, typename L, typename C, cpp_enable_iff(UT == updater_type::ADAGRAD)>
-    void apply_gradients(size_t epoch, L& layer, C& context, size_t n, weight eps) {
+    template <size_t I, updater_type UT, decay_type decay, typename V, typename C, cpp_enable_iff(UT == updater_type::ADAGRAD)>
+    void apply_gradients(size_t epoch, V& value, C& ctx, size_t n, weight eps, const grad_params& params, const update_range& range) {
         dll::auto_timer timer("sgd::apply_grad:adagrad");
 
-        const auto e = 1e-8;
+        const weight e = 1e-8;
 
-        auto& w      = std::get<I>(layer.trainable_parameters());
-        auto& w_grad = std::get<I>(context.up.context)->grad;
-        auto& w_inc  = std::get<I>(context.up.context)->inc;
+        ctx.inc.ensure_cpu_up_to_date();
 
-        w_inc = w_inc + (w_grad >> w_grad);
+        weight* w_p       = value.memory_start();
+        const weight* g_p = ctx.grad.memory_start();
+        weight* inc_p     = ctx.inc.memory_start();
 
-        w += (eps * w_grad) / etl::sqrt(w_inc + e);
+        range([&](size_t i) {
+            const weight g = effective_grad<decay>(g_p[i], w_p[i], params);
 
-        nan_check_deep(w);
+            inc_p[i] += g * g;
+            w_p[i] = decayed<decay>(w_p[i], params) + (eps * g) / std::sqrt(inc_p[i] + e);
+        });
+
+        ctx.inc.invalidate_gpu();
 
         cpp_unused(n);
         cpp_unused(epoch);
     }
 
     /*!
-     * \brief Apply the gradients to the given layer
+     * \brief Apply the gradients to the given variable
      */
-    template <size_t I, updater_type UT, typename L, typename C, cpp_enable_iff(UT == updater_type::ADADELTA)>
-    void apply_gradients(size_t epoch, L& layer, C& context, size_t n, weight eps) {
+    template <size_t I, updater_type UT, decay_type decay, typename V, typename C, cpp_enable_iff(UT == updater_type::ADADELTA)>
+    void apply_gradients(size_t epoch, V& value, C& ctx, size_t n, weight eps, const grad_params& params, const update_range& range) {
         dll::auto_timer timer("sgd::apply_grad:adadelta");
 
-        const auto beta = dbn.adadelta_beta;
-        const auto e = 1e-8;
+        const weight beta = dbn.adadelta_beta;
+        const weight e    = 1e-8;
 
-        auto& w      = std::get<I>(layer.trainable_parameters());
-        auto& w_grad = std::get<I>(context.up.context)->grad;
-        auto& w_g    = std::get<I>(context.up.context)->g;
-        auto& w_v    = std::get<I>(context.up.context)->v;
-        auto& w_x    = std::get<I>(context.up.context)->x;
+        ctx.g.ensure_cpu_up_to_date();
+        ctx.x.ensure_cpu_up_to_date();
 
-        w_g = beta * w_g + ((1.0 - beta) * (w_grad >> w_grad));
-        w_v = (sqrt(w_x + e) >> w_grad) / sqrt(w_g + e);
-        w_x = beta * w_x + ((1.0 - beta) * (w_v >> w_v));
+        weight* w_p       = value.memory_start();
+        const weight* g_p = ctx.grad.memory_start();
+        weight* m_g_p     = ctx.g.memory_start();
+        weight* m_v_p     = ctx.v.memory_start();
+        weight* m_x_p     = ctx.x.memory_start();
 
-        w += w_v;
+        range([&](size_t i) {
+            const weight g = effective_grad<decay>(g_p[i], w_p[i], params);
 
-        nan_check_deep(w);
+            m_g_p[i] = beta * m_g_p[i] + (1.0 - beta) * (g * g);
+            m_v_p[i] = (std::sqrt(m_x_p[i] + e) * g) / std::sqrt(m_g_p[i] + e);
+            m_x_p[i] = beta * m_x_p[i] + (1.0 - beta) * (m_v_p[i] * m_v_p[i]);
+
+            w_p[i] = decayed<decay>(w_p[i], params) + m_v_p[i];
+        });
+
+        ctx.g.invalidate_gpu();
+        ctx.v.invalidate_gpu();
+        ctx.x.invalidate_gpu();
 
         cpp_unused(n);
         cpp_unused(epoch);
@@ -1058,113 +3248,134 @@ struct sgd_trainer {
     }
 
     /*!
-     * \brief Apply the gradients to the given layer
+     * \brief Apply the gradients to the given variable
      */
-    template <size_t I, updater_type UT, typename L, typename C, cpp_enable_iff(UT == updater_type::ADAM)>
-    void apply_gradients(size_t epoch, L& layer, C& context, size_t n, weight eps) {
+    template <size_t I, updater_type UT, decay_type decay, typename V, typename C, cpp_enable_iff(UT == updater_type::ADAM)>
+    void apply_gradients(size_t epoch, V& value, C& ctx, size_t n, weight eps, const grad_params& params, const update_range& range) {
         dll::auto_timer timer("sgd::apply_grad:adam");
 
-        const auto beta1 = dbn.adam_beta1;
-        const auto beta2 = dbn.adam_beta2;
-        const auto e = 1e-8;
+        const weight beta1 = dbn.adam_beta1;
+        const weight beta2 = dbn.adam_beta2;
+        const weight e     = 1e-8;
 
-        auto& w      = std::get<I>(layer.trainable_parameters());
-        auto& w_grad = std::get<I>(context.up.context)->grad;
-        auto& w_m    = std::get<I>(context.up.context)->m;
-        auto& w_v    = std::get<I>(context.up.context)->v;
+        ctx.m.ensure_cpu_up_to_date();
+        ctx.v.ensure_cpu_up_to_date();
 
-        // Standard Adam estimations of the first and second moments
+        weight* w_p       = value.memory_start();
+        const weight* g_p = ctx.grad.memory_start();
+        weight* m_p       = ctx.m.memory_start();
+        weight* v_p       = ctx.v.memory_start();
 
-        w_m = beta1 * w_m + ((1.0 - beta1) * w_grad);
-        w_v = beta2 * w_v + ((1.0 - beta2) * (w_grad >> w_grad));
+        range([&](size_t i) {
+            const weight g = effective_grad<decay>(g_p[i], w_p[i], params);
 
-        // Update the parameters
+            // Standard Adam estimations of the first and second moments
 
-        w += (eps * w_m) / (etl::sqrt(w_v) + e);
+            m_p[i] = beta1 * m_p[i] + (1.0 - beta1) * g;
+            v_p[i] = beta2 * v_p[i] + (1.0 - beta2) * (g * g);
 
-        nan_check_deep(w);
+            // Update the parameters
+
+            w_p[i] = decayed<decay>(w_p[i], params) + (eps * m_p[i]) / (std::sqrt(v_p[i]) + e);
+        });
+
+        ctx.m.invalidate_gpu();
+        ctx.v.invalidate_gpu();
 
         cpp_unused(n);
         cpp_unused(epoch);
     }
 
     /*!
-     * \brief Apply the gradients to the given layer
+     * \brief Apply the gradients to the given variable
      */
-    template <size_t I, updater_type UT, typename L, typename C, cpp_enable_iff(UT == updater_type::ADAM_CORRECT)>
-    void apply_gradients(size_t epoch, L& layer, C& context, size_t n, weight eps) {
+    template <size_t I, updater_type UT, decay_type decay, typename V, typename C, cpp_enable_iff(UT == updater_type::ADAM_CORRECT)>
+    void apply_gradients(size_t epoch, V& value, C& ctx, size_t n, weight eps, const grad_params& params, const update_range& range) {
         dll::auto_timer timer("sgd::apply_grad:adam_correct");
 
-        const auto beta1 = dbn.adam_beta1;
-        const auto beta2 = dbn.adam_beta2;
-        const auto e = 1e-8;
-        const auto t = iteration;
+        const weight beta1 = dbn.adam_beta1;
+        const weight beta2 = dbn.adam_beta2;
+        const weight e     = 1e-8;
+        const auto t       = iteration;
 
-        auto& w      = std::get<I>(layer.trainable_parameters());
-        auto& w_grad = std::get<I>(context.up.context)->grad;
-        auto& w_m    = std::get<I>(context.up.context)->m;
-        auto& w_mt   = std::get<I>(context.up.context)->mt;
-        auto& w_v    = std::get<I>(context.up.context)->v;
-        auto& w_vt   = std::get<I>(context.up.context)->vt;
+        // Correction of the bias (towards zero) of the first and second moments
+        const weight c1 = 1.0 / (1.0 - std::pow(beta1, t));
+        const weight c2 = 1.0 / (1.0 - std::pow(beta2, t));
 
-        // Standard Adam estimations of the first and second moments
+        ctx.m.ensure_cpu_up_to_date();
+        ctx.v.ensure_cpu_up_to_date();
 
-        w_m = beta1 * w_m + ((1.0 - beta1) * w_grad);
-        w_v = beta2 * w_v + ((1.0 - beta2) * (w_grad >> w_grad));
+        weight* w_p       = value.memory_start();
+        const weight* g_p = ctx.grad.memory_start();
+        weight* m_p       = ctx.m.memory_start();
+        weight* v_p       = ctx.v.memory_start();
 
-        // Correct the bias (towards zero) of the first and second moments
+        range([&](size_t i) {
+            const weight g = effective_grad<decay>(g_p[i], w_p[i], params);
 
-        w_mt = w_m / (1.0 - std::pow(beta1, t));
-        w_vt = w_v / (1.0 - std::pow(beta2, t));
+            // Standard Adam estimations of the first and second moments
 
-        // Update the parameters
+            m_p[i] = beta1 * m_p[i] + (1.0 - beta1) * g;
+            v_p[i] = beta2 * v_p[i] + (1.0 - beta2) * (g * g);
 
-        w += (eps * w_m) / (etl::sqrt(w_v) + e);
+            // Update the parameters with the corrected estimates
 
-        nan_check_deep(w);
+            w_p[i] = decayed<decay>(w_p[i], params) + (eps * (c1 * m_p[i])) / (std::sqrt(c2 * v_p[i]) + e);
+        });
+
+        ctx.m.invalidate_gpu();
+        ctx.v.invalidate_gpu();
 
         cpp_unused(n);
         cpp_unused(epoch);
     }
 
     /*!
-     * \brief Apply the gradients to the given layer
+     * \brief Apply the gradients to the given variable
      */
-    template <size_t I, updater_type UT, typename L, typename C, cpp_enable_iff(UT == updater_type::ADAMAX)>
-    void apply_gradients(size_t epoch, L& layer, C& context, size_t n, weight eps) {
+    template <size_t I, updater_type UT, decay_type decay, typename V, typename C, cpp_enable_iff(UT == updater_type::ADAMAX)>
+    void apply_gradients(size_t epoch, V& value, C& ctx, size_t n, weight eps, const grad_params& params, const update_range& range) {
         dll::auto_timer timer("sgd::apply_grad:adamax");
 
-        const auto beta1 = dbn.adam_beta1;
-        const auto beta2 = dbn.adam_beta2;
+        const weight beta1 = dbn.adam_beta1;
+        const weight beta2 = dbn.adam_beta2;
 
-        auto& w      = std::get<I>(layer.trainable_parameters());
-        auto& w_grad = std::get<I>(context.up.context)->grad;
-        auto& w_m    = std::get<I>(context.up.context)->m;
-        auto& w_v    = std::get<I>(context.up.context)->v;
+        ctx.m.ensure_cpu_up_to_date();
+        ctx.v.ensure_cpu_up_to_date();
 
-        // Standard Adam estimations of the first moment
+        weight* w_p       = value.memory_start();
+        const weight* g_p = ctx.grad.memory_start();
+        weight* m_p       = ctx.m.memory_start();
+        weight* v_p       = ctx.v.memory_start();
 
-        w_m = beta1 * w_m + ((1.0 - beta1) >> w_grad);
+        range([&](size_t i) {
+            const weight g = effective_grad<decay>(g_p[i], w_p[i], params);
 
-        // Estimation of the second moment with infinite-norm
+            // Standard Adam estimations of the first moment
 
-        w_v = etl::max(beta2 * w_v, etl::abs(w_grad));
+            m_p[i] = beta1 * m_p[i] + (1.0 - beta1) * g;
 
-        // Update the parameters
+            // Estimation of the second moment with infinite-norm
 
-        w += (eps >> w_m) / w_v;
+            v_p[i] = std::max(beta2 * v_p[i], std::abs(g));
 
-        nan_check_deep(w);
+            // Update the parameters
+
+            w_p[i] = decayed<decay>(w_p[i], params) + (eps * m_p[i]) / v_p[i];
+        });
+
+        ctx.m.invalidate_gpu();
+        ctx.v.invalidate_gpu();
 
         cpp_unused(n);
         cpp_unused(epoch);
     }
 
     /*!
-     * \brief Apply the gradients to the given layer
+     * \brief Apply the gradients to the given variable
      */
-    template <size_t I, updater_type UT, typename L, typename C, cpp_enable_iff(UT == updater_type::NADAM)>
-    void apply_gradients(size_t epoch, L& layer, C& context, size_t n, weight eps) {
+    template <size_t I, updater_type UT, decay_type decay, typename V, typename C, cpp_enable_iff(UT == updater_type::NADAM)>
+    void apply_gradients(size_t epoch, V& value, C& ctx, size_t n, weight eps, const grad_params& params, const update_range& range) {
         dll::auto_timer timer("sgd::apply_grad:nadam");
 
         const weight beta1          = dbn.adam_beta1;
@@ -1173,13 +3384,7 @@ struct sgd_trainer {
         const weight e              = 1e-8;
         const weight t              = iteration;
 
-        auto& w          = std::get<I>(layer.trainable_parameters());
-        auto& w_grad     = std::get<I>(context.up.context)->grad;
-        auto& w_m        = std::get<I>(context.up.context)->m;
-        auto& w_mt       = std::get<I>(context.up.context)->mt;
-        auto& w_v        = std::get<I>(context.up.context)->v;
-        auto& w_vt       = std::get<I>(context.up.context)->vt;
-        auto& m_schedule = std::get<I>(context.up.context)->m_schedule;
+        auto& m_schedule = ctx.m_schedule;
 
         // Compute the schedule for momentum
 
@@ -1193,17 +3398,10 @@ struct sgd_trainer {
             m_schedule = m_schedule_new;
         }
 
-        // Standard Adam estimations of the first and second order moments
+        // Correction of the bias (towards zero) of the first and second moments
 
-        w_m = beta1 * w_m + ((1.0 - beta1) >> w_grad);
-        w_v = beta2 * w_v + ((1.0 - beta2) >> (w_grad >> w_grad));
-
-        // Correct the bias (towards zero) of the first and second moments
-
-        w_mt = w_m / (1.0 - m_schedule_next);
-        w_vt = w_v / (1.0 - std::pow(beta2, t));
-
-        // Update the parameters
+        const weight c1 = 1.0 / (1.0 - m_schedule_next);
+        const weight c2 = 1.0 / (1.0 - std::pow(beta2, t));
 
         weight f1 = 1.0 - momentum_cache_t;
         weight f2 = 1.0 - m_schedule_new;
@@ -1211,67 +3409,61 @@ struct sgd_trainer {
         weight m1 = eps * (f1 / f2);
         weight m2 = eps * momentum_cache_t_1;
 
-        w += (m1 * w_grad + m2 * w_mt) / (etl::sqrt(w_vt) + e);
-
-        nan_check_deep(w);
+        ctx.m.ensure_cpu_up_to_date();
+        ctx.v.ensure_cpu_up_to_date();
 
-        cpp_unused(n);
-        cpp_unused(epoch);
-    }
+        weight* w_p       = value.memory_start();
+        const weight* g_p = ctx.grad.memory_start();
+        weight* m_p       = ctx.m.memory_start();
+        weight* v_p       = ctx.v.memory_start();
 
-    /*!
-     * \brief Apply the gradients to the given layer
-     */
-    template <size_t I, updater_type UT, typename L, typename C, cpp_enable_iff(UT == updater_type::RMSPROP)>
-    void apply_gradients(size_t epoch, L& layer, C& context, size_t n, weight eps) {
-        dll::auto_timer timer("sgd::apply_grad:rmsprop");
+        range([&](size_t i) {
+            const weight g = effective_grad<decay>(g_p[i], w_p[i], params);
 
-        const auto decay = dbn.rmsprop_decay;
-        const auto e = 1e-8;
+            // Standard Adam estimations of the first and second order moments
 
-        auto& w      = std::get<I>(layer.trainable_parameters());
-        auto& w_grad = std::get<I>(context.up.context)->grad;
-        auto& w_inc  = std::get<I>(context.up.context)->inc;
+            m_p[i] = beta1 * m_p[i] + (1.0 - beta1) * g;
+            v_p[i] = beta2 * v_p[i] + (1.0 - beta2) * (g * g);
 
-        w_inc = decay * w_inc + (1 - decay) * (w_grad >> w_grad);
+            // Update the parameters
 
-        w += (eps >> w_grad) / etl::sqrt(w_inc + e);
+            w_p[i] = decayed<decay>(w_p[i], params) + (m1 * g + m2 * (c1 * m_p[i])) / (std::sqrt(c2 * v_p[i]) + e);
+        });
 
-        nan_check_deep(w);
+        ctx.m.invalidate_gpu();
+        ctx.v.invalidate_gpu();
 
         cpp_unused(n);
         cpp_unused(epoch);
     }
 
     /*!
-     * \brief Update the given gradients according to the given decay function
+     * \brief Apply the gradients to the given variable
      */
-    template <typename G>
-    void clip_gradients(G& grad, size_t n) {
-        if constexpr (dbn_traits<dbn_t>::has_clip_gradients()) {
-            const auto t            = dbn.gradient_clip;
-            const auto grad_l2_norm = std::sqrt(etl::sum(grad >> grad) / (n * n));
+    template <size_t I, updater_type UT, decay_type decay, typename V, typename C, cpp_enable_iff(UT == updater_type::RMSPROP)>
+    void apply_gradients(size_t epoch, V& value, C& ctx, size_t n, weight eps, const grad_params& params, const update_range& range) {
+        dll::auto_timer timer("sgd::apply_grad:rmsprop");
 
-            if (grad_l2_norm > t) {
-                grad = grad >> (t / grad_l2_norm);
-            }
-        }
-    }
+        const weight decay_rate = dbn.rmsprop_decay;
+        const weight e          = 1e-8;
 
-    /*!
-     * \brief Update the given gradients according to the given decay function
-     */
-    template <decay_type decay, typename V, typename G>
-    void update_grad(const V& value, G& grad, size_t n) {
-        if constexpr (decay == decay_type::L1) {
-            grad = grad - dbn.l1_weight_cost * abs(value);
-        } else if constexpr (decay == decay_type::L2) {
-            grad = grad - dbn.l2_weight_cost * value;
-        } else if constexpr (decay == decay_type::L1L2) {
-            grad = grad - dbn.l1_weight_cost * abs(value) - dbn.l2_weight_cost * value;
-        }
+        ctx.inc.ensure_cpu_up_to_date();
+
+        weight* w_p       = value.memory_start();
+        const weight* g_p = ctx.grad.memory_start();
+        weight* inc_p     = ctx.inc.memory_start();
+
+        range([&](size_t i) {
+            const weight g = effective_grad<decay>(g_p[i], w_p[i], params);
+
+            inc_p[i] = decay_rate * inc_p[i] + (1 - decay_rate) * (g * g);
+            w_p[i] = decayed<decay>(w_p[i], params) + (eps * g) / std::sqrt(inc_p[i] + e);
+        });
+
+        ctx.inc.invalidate_gpu();
 
-        clip_gradients(grad, n);
+        cpp_unused(n);
+        cpp_unused(epoch);
     }
 
     /*!
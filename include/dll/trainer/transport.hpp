@@ -0,0 +1,206 @@
+//=======================================================================
+// Copyright (c) 2014-2017 Baptiste Wicht
+// Distributed under the terms of the MIT License.
+// (See accompanying file LICENSE or copy at
+//  http://opensource.org/licenses/MIT)
+//=======================================================================
+
+/*!
+ * \file
+ * \brief Transports of the distributed SGD trainer.
+ *
+ * A transport connects the processes (ranks) training the same network.
+ * It gives the rank of the process and the number of ranks, sums buffers
+ * over all the ranks (all_reduce), copies a buffer of the rank 0 to all
+ * the ranks (broadcast) and concatenates the buffers of all the ranks
+ * (all_gather). The collective operations must be called in the same order
+ * by all the ranks.
+ *
+ * The local transport has a single rank and does nothing. The MPI
+ * transport is available when DLL_MPI is defined.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cstdlib>
+#include <type_traits>
+#include <utility>
+
+#ifdef DLL_MPI
+#include <mpi.h>
+#endif
+
+namespace dll {
+
+/*!
+ * \brief Transport of a single process (this is the default)
+ */
+struct local_transport {
+    /*!
+     * \brief Returns the rank of the process
+     */
+    size_t rank() const {
+        return 0;
+    }
+
+    /*!
+     * \brief Returns the number of ranks
+     */
+    size_t size() const {
+        return 1;
+    }
+
+    /*!
+     * \brief Sum the given buffer over all the ranks
+     * \param values The buffer, replaced by the sum
+     * \param n The number of values in the buffer
+     */
+    template <typename T>
+    void all_reduce(T* values, size_t n) {
+        cpp_unused(values);
+        cpp_unused(n);
+    }
+
+    /*!
+     * \brief Copy the given buffer of the rank 0 to all the ranks
+     * \param values The buffer
+     * \param n The number of values in the buffer
+     */
+    template <typename T>
+    void broadcast(T* values, size_t n) {
+        cpp_unused(values);
+        cpp_unused(n);
+    }
+
+    /*!
+     * \brief Concatenate the given buffers of all the ranks, in the order
+     * of the ranks
+     * \param values The buffer of this rank
+     * \param n The number of values in the buffer, the same for all the ranks
+     * \param gathered The buffers of all the ranks (n * size() values)
+     */
+    template <typename T>
+    void all_gather(const T* values, size_t n, T* gathered) {
+        std::copy(values, values + n, gathered);
+    }
+};
+
+#ifdef DLL_MPI
+
+/*!
+ * \brief Transport over MPI (MPI_COMM_WORLD)
+ *
+ * MPI is initialized by the first transport if necessary, and finalized
+ * at the exit of the program. The collective operations may be called from
+ * another thread than the main thread, but never concurrently.
+ */
+struct mpi_transport {
+    mpi_transport() {
+        int initialized = 0;
+        MPI_Initialized(&initialized);
+
+        if (!initialized) {
+            int provided = 0;
+            MPI_Init_thread(nullptr, nullptr, MPI_THREAD_SERIALIZED, &provided);
+
+            std::atexit([] {
+                int finalized = 0;
+                MPI_Finalized(&finalized);
+
+                if (!finalized) {
+                    MPI_Finalize();
+                }
+            });
+        }
+
+        int r = 0;
+        int s = 1;
+
+        MPI_Comm_rank(MPI_COMM_WORLD, &r);
+        MPI_Comm_size(MPI_COMM_WORLD, &s);
+
+        rank_ = r;
+        size_ = s;
+    }
+
+    mpi_transport(const mpi_transport& rhs) = delete;
+    mpi_transport& operator=(const mpi_transport& rhs) = delete;
+
+    /*!
+     * \copydoc local_transport::rank
+     */
+    size_t rank() const {
+        return rank_;
+    }
+
+    /*!
+     * \copydoc local_transport::size
+     */
+    size_t size() const {
+        return size_;
+    }
+
+    /*!
+     * \copydoc local_transport::all_reduce
+     */
+    template <typename T>
+    void all_reduce(T* values, size_t n) {
+        MPI_Allreduce(MPI_IN_PLACE, values, int(n), datatype<T>(), MPI_SUM, MPI_COMM_WORLD);
+    }
+
+    /*!
+     * \copydoc local_transport::broadcast
+     */
+    template <typename T>
+    void broadcast(T* values, size_t n) {
+        MPI_Bcast(values, int(n), datatype<T>(), 0, MPI_COMM_WORLD);
+    }
+
+    /*!
+     * \copydoc local_transport::all_gather
+     */
+    template <typename T>
+    void all_gather(const T* values, size_t n, T* gathered) {
+        static_assert(std::is_trivially_copyable<T>::value, "mpi_transport::all_gather only supports trivially copyable types");
+
+        // The buffers are exchanged as raw bytes (compressed gradients)
+        MPI_Allgather(values, int(n * sizeof(T)), MPI_BYTE, gathered, int(n * sizeof(T)), MPI_BYTE, MPI_COMM_WORLD);
+    }
+
+private:
+    /*!
+     * \brief Returns the MPI datatype of T
+     */
+    template <typename T>
+    static MPI_Datatype datatype() {
+        static_assert(std::is_same<T, float>::value || std::is_same<T, double>::value, "mpi_transport only supports float and double");
+
+        if constexpr (std::is_same<T, float>::value) {
+            return MPI_FLOAT;
+        } else {
+            return MPI_DOUBLE;
+        }
+    }
+
+    size_t rank_ = 0; ///< The rank of the process
+    size_t size_ = 1; ///< The number of ranks
+};
+
+#endif
+
+/*!
+ * \brief Returns the range [first, last) of the n samples that is the
+ * shard of the rank of the given transport.
+ *
+ * All the shards have the same size, the remaining samples are dropped, so
+ * that all the ranks train the same number of batches.
+ */
+template <typename Transport>
+std::pair<size_t, size_t> shard_range(const Transport& transport, size_t n) {
+    const size_t shard = n / transport.size();
+
+    return {transport.rank() * shard, (transport.rank() + 1) * shard};
+}
+
+} //end of dll namespace
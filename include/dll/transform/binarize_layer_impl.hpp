@@ -28,6 +28,8 @@ struct binarize_layer_impl : transform_layer<binarize_layer_impl<Desc>> {
 
     static constexpr size_t Threshold = desc::T;
 
+    static constexpr bool element_wise = true; ///< The layer is applied independently to each value
+
     binarize_layer_impl() = default;
 
     /*!
@@ -62,6 +64,16 @@ struct binarize_layer_impl : transform_layer<binarize_layer_impl<Desc>> {
         }
     }
 
+    /*!
+     * \brief Apply the layer to a single value
+     * \param x The input value
+     * \return the output value
+     */
+    template <typename T>
+    static T apply_one(T x) {
+        return x > Threshold ? T(1) : T(0);
+    }
+
     /*!
      * \brief Adapt the errors, called before backpropagation of the errors.
      *
@@ -124,15 +136,11 @@ struct layer_base_traits<binarize_layer_impl<Desc>> {
  * \brief Specialization of sgd_context for binarize_layer_impl
  */
 template <typename DBN, typename Desc, size_t L>
-struct sgd_context<DBN, binarize_layer_impl<Desc>, L> {
+struct sgd_context<DBN, binarize_layer_impl<Desc>, L> : transform_sgd_context<previous_output_t<DBN, L>, true> {
     using layer_t          = binarize_layer_impl<Desc>;                            ///< The current layer type
     using previous_layer   = typename DBN::template layer_type<L - 1>;          ///< The previous layer type
     using previous_context = sgd_context<DBN, previous_layer, L - 1>;           ///< The previous layer's context
-    using inputs_t         = decltype(std::declval<previous_context>().output); ///< The type of inputs
-
-    inputs_t input;  ///< A batch of input
-    inputs_t output; ///< A batch of output
-    inputs_t errors; ///< A batch of errors
+    using inputs_t         = previous_output_t<DBN, L>;                         ///< The type of inputs
 
     sgd_context(const layer_t& /*layer*/){}
 };
@@ -171,8 +179,11 @@ struct cg_context<binarize_layer_impl<Desc>> {
     etl::fast_matrix<weight, 1, 1> gr_w_tmp;
     etl::fast_vector<weight, 1> gr_b_tmp;
 
-    std::vector<etl::dyn_vector<weight>> gr_probs_a;
-    std::vector<etl::dyn_vector<weight>> gr_probs_s;
+    etl::dyn_matrix<weight, 2> gr_probs_a;
+    etl::dyn_matrix<weight, 2> gr_errors;
+
+    std::vector<etl::dyn_matrix<weight, 2>> gr_w_parts;
+    std::vector<etl::dyn_matrix<weight, 1>> gr_b_parts;
 };
 
 } //end of dll namespace
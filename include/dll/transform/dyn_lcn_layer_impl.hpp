@@ -79,13 +79,7 @@ struct dyn_lcn_layer_impl : transform_layer<dyn_lcn_layer_impl<Desc>> {
     void forward_batch(Output&& output, Input&& input) const {
         inherit_dim(output, input);
 
-        using weight_t = etl::value_t<Input>;
-
-        auto w = filter<weight_t>(sigma);
-
-        for (size_t b = 0; b < etl::dim<0>(input); ++b) {
-            lcn_compute(output(b), input(b), w, K, Mid);
-        }
+        lcn_compute_batch(output, input, sigma, K, Mid);
     }
 };
 
@@ -117,7 +111,7 @@ struct sgd_context<DBN, dyn_lcn_layer_impl<Desc>, L> {
     using layer_t          = dyn_lcn_layer_impl<Desc>;                            ///< The current layer type
     using previous_layer   = typename DBN::template layer_type<L - 1>;          ///< The previous layer type
     using previous_context = sgd_context<DBN, previous_layer, L - 1>;           ///< The previous layer's context
-    using inputs_t         = decltype(std::declval<previous_context>().output); ///< The type of inputs
+    using inputs_t         = std::decay_t<decltype(std::declval<previous_context>().output)>; ///< The type of inputs
 
     inputs_t input;  ///< A batch of input
     inputs_t output; ///< A batch of output
@@ -24,6 +24,8 @@ struct dyn_shape_1d_layer_impl : transform_layer<dyn_shape_1d_layer_impl<Desc>>
 
     static constexpr size_t D = 1; ///< The number of dimensions
 
+    static constexpr bool shape_only = true; ///< The layer only gives a shape to its input
+
     using input_one_t  = etl::dyn_matrix<weight, 1>; ///< The preferred type of input
     using output_one_t = etl::dyn_matrix<weight, 1>; ///< The type of output
 
@@ -92,6 +94,16 @@ struct dyn_shape_1d_layer_impl : transform_layer<dyn_shape_1d_layer_impl<Desc>>
         output = input;
     }
 
+    /*!
+     * \brief Returns a view of the batch of input with the shape of the
+     * layer, without copying it
+     * \param input The batch of input
+     */
+    template <typename Input>
+    auto view_batch(const Input& input) const {
+        return etl::reshape(input, etl::dim<0>(input), S);
+    }
+
     /*!
      * \brief Adapt the errors, called before backpropagation of the errors.
      *
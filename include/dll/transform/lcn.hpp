@@ -7,6 +7,11 @@
 
 #pragma once
 
+#include <algorithm>
+#include <vector>
+
+#include "dll/util/scheduler.hpp"
+
 namespace dll {
 
 inline double gaussian(double x, double y, double sigma) {
@@ -25,6 +30,160 @@ void lcn_filter(W& w, size_t K, size_t Mid, double sigma){
     w /= etl::sum(w);
 }
 
+/*!
+ * \brief Fill the separable (1D) LCN filter.
+ *
+ * The normalized 2D Gaussian of lcn_filter is the outer product of this
+ * filter with itself.
+ *
+ * \param u The 1D filter
+ * \param K The size of the filter
+ * \param Mid The center of the filter
+ * \param sigma The standard deviation of the Gaussian
+ */
+template <typename U>
+void lcn_filter_1d(U& u, size_t K, size_t Mid, double sigma){
+    for (size_t i = 0; i < K; ++i) {
+        auto x = double(i) - double(Mid);
+        u[i]   = std::exp(-(x * x) / (2.0 * sigma * sigma));
+    }
+
+    u /= etl::sum(u);
+}
+
+/*!
+ * \brief Apply the layer to the input, with the separable filter.
+ *
+ * The weighted sums of the neighborhoods are computed in a horizontal
+ * and a vertical pass, over zero-padded rows, in O(K) per pixel. The
+ * results are the same as lcn_compute with the 2D filter.
+ *
+ * \param y The output
+ * \param x The input to apply the layer to
+ * \param u The separable filter (lcn_filter_1d)
+ * \param K The size of the filter
+ * \param Mid The center of the filter
+ */
+template <typename Input, typename Output, typename U>
+void lcn_compute_separable(Output&& y, const Input& x, const U& u, size_t K, size_t Mid){
+    using weight_t = etl::value_t<Input>;
+
+    const size_t H  = etl::dim<1>(x);
+    const size_t W  = etl::dim<2>(x);
+    const size_t PW = W + 2 * Mid;
+
+    std::vector<weight_t> px(PW, weight_t(0));  // The padded row
+    std::vector<weight_t> px2(PW, weight_t(0)); // The squares of the padded row
+
+    // The horizontal sums, with Mid zero rows above and below
+    std::vector<weight_t> h1((H + 2 * Mid) * W, weight_t(0));
+    std::vector<weight_t> h2((H + 2 * Mid) * W, weight_t(0));
+
+    std::vector<weight_t> s1(W);
+    std::vector<weight_t> s2(W);
+
+    std::vector<weight_t> v(H * W);
+    std::vector<weight_t> o(H * W);
+
+    for (size_t c = 0; c < etl::dim<0>(x); ++c) {
+        //1. Horizontal pass over the padded rows
+
+        for (size_t j = 0; j < H; ++j) {
+            for (size_t k = 0; k < W; ++k) {
+                px[Mid + k]  = x(c, j, k);
+                px2[Mid + k] = px[Mid + k] * px[Mid + k];
+            }
+
+            weight_t* r1 = h1.data() + (j + Mid) * W;
+            weight_t* r2 = h2.data() + (j + Mid) * W;
+
+            std::fill_n(r1, W, weight_t(0));
+            std::fill_n(r2, W, weight_t(0));
+
+            for (size_t q = 0; q < K; ++q) {
+                const weight_t uq  = u[q];
+                const weight_t* a1 = px.data() + q;
+                const weight_t* a2 = px2.data() + q;
+
+                for (size_t k = 0; k < W; ++k) {
+                    r1[k] += uq * a1[k];
+                    r2[k] += uq * a2[k];
+                }
+            }
+        }
+
+        //2. Vertical pass, remove the mean of the neighborhood and compute its norm
+
+        weight_t total(0);
+
+        for (size_t j = 0; j < H; ++j) {
+            std::fill(s1.begin(), s1.end(), weight_t(0));
+            std::fill(s2.begin(), s2.end(), weight_t(0));
+
+            for (size_t p = 0; p < K; ++p) {
+                const weight_t up  = u[p];
+                const weight_t* a1 = h1.data() + (j + p) * W;
+                const weight_t* a2 = h2.data() + (j + p) * W;
+
+                for (size_t k = 0; k < W; ++k) {
+                    s1[k] += up * a1[k];
+                    s2[k] += up * a2[k];
+                }
+            }
+
+            for (size_t k = 0; k < W; ++k) {
+                v[j * W + k] = x(c, j, k) - s1[k];
+                o[j * W + k] = std::sqrt(s2[k]);
+                total += o[j * W + k];
+            }
+        }
+
+        //3. Scale down norm of the patch if norm is bigger than the mean norm
+
+        const weight_t cst = total / weight_t(H * W);
+
+        for (size_t j = 0; j < H; ++j) {
+            for (size_t k = 0; k < W; ++k) {
+                y(c, j, k) = v[j * W + k] / std::max(o[j * W + k], cst);
+            }
+        }
+    }
+}
+
+/*!
+ * \brief Apply the layer to a batch of inputs, with the separable filter.
+ *
+ * The samples of the batch are split between the threads of the scheduler.
+ *
+ * \param output The batch of output
+ * \param input The batch of input to apply the layer to
+ * \param sigma The standard deviation of the Gaussian
+ * \param K The size of the filter
+ * \param Mid The center of the filter
+ */
+template <typename Input, typename Output>
+void lcn_compute_batch(Output&& output, const Input& input, double sigma, size_t K, size_t Mid){
+    using weight_t = etl::value_t<Input>;
+
+    etl::dyn_vector<weight_t> u(K);
+    lcn_filter_1d(u, K, Mid, sigma);
+
+    const size_t B = etl::dim<0>(input);
+
+    // Not worth the threads for small batches
+    if (etl::size(input) * K < 1024 * 1024) {
+        for (size_t b = 0; b < B; ++b) {
+            lcn_compute_separable(output(b), input(b), u, K, Mid);
+        }
+
+        return;
+    }
+
+    dll::scheduler().parallel_for(B, [&](size_t b) {
+        lcn_compute_separable(output(b), input(b), u, K, Mid);
+    });
+}
+
 /*!
  * \brief Apply the layer to the input
  * \param y The output
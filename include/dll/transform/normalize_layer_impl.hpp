@@ -56,6 +56,15 @@ struct normalize_layer_impl : transform_layer<normalize_layer_impl<Desc>> {
         cpp::normalize(output);
     }
 
+    /*!
+     * \brief Apply the layer in place to the given batch
+     * \param batch The batch of input, replaced by the batch of output
+     */
+    template <typename Batch>
+    static void forward_in_place(Batch& batch) {
+        cpp::normalize(batch);
+    }
+
     /*!
      * \brief Adapt the errors, called before backpropagation of the errors.
      *
@@ -113,15 +122,11 @@ struct layer_base_traits<normalize_layer_impl<Desc>> {
  * \brief Specialization of sgd_context for normalize_layer_impl
  */
 template <typename DBN, typename Desc, size_t L>
-struct sgd_context<DBN, normalize_layer_impl<Desc>, L> {
+struct sgd_context<DBN, normalize_layer_impl<Desc>, L> : transform_sgd_context<previous_output_t<DBN, L>, true> {
     using layer_t          = normalize_layer_impl<Desc>;                            ///< The current layer type
     using previous_layer   = typename DBN::template layer_type<L - 1>;          ///< The previous layer type
     using previous_context = sgd_context<DBN, previous_layer, L - 1>;           ///< The previous layer's context
-    using inputs_t         = decltype(std::declval<previous_context>().output); ///< The type of inputs
-
-    inputs_t input;  ///< A batch of input
-    inputs_t output; ///< A batch of output
-    inputs_t errors; ///< A batch of errors
+    using inputs_t         = previous_output_t<DBN, L>;                         ///< The type of inputs
 
     sgd_context(const layer_t& /*layer*/){}
 };
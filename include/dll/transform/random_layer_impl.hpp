@@ -81,7 +81,7 @@ struct sgd_context<DBN, random_layer_impl<Desc>, L> {
     using layer_t          = random_layer_impl<Desc>;                            ///< The current layer type
     using previous_layer   = typename DBN::template layer_type<L - 1>;          ///< The previous layer type
     using previous_context = sgd_context<DBN, previous_layer, L - 1>;           ///< The previous layer's context
-    using inputs_t         = decltype(std::declval<previous_context>().output); ///< The type of inputs
+    using inputs_t         = std::decay_t<decltype(std::declval<previous_context>().output)>; ///< The type of inputs
 
     inputs_t input;  ///< A batch of input
     inputs_t output; ///< A batch of output
@@ -29,6 +29,8 @@ struct rectifier_layer_impl : transform_layer<rectifier_layer_impl<Desc>> {
 
     static_assert(method == rectifier_method::ABS, "Only ABS rectifier has been implemented");
 
+    static constexpr bool element_wise = true; ///< The layer is applied independently to each value
+
     /*!
      * \brief Returns a string representation of the layer
      */
@@ -58,6 +60,16 @@ struct rectifier_layer_impl : transform_layer<rectifier_layer_impl<Desc>> {
             output = etl::abs(input);
         }
     }
+
+    /*!
+     * \brief Apply the layer to a single value
+     * \param x The input value
+     * \return the output value
+     */
+    template <typename T>
+    static T apply_one(T x) {
+        return std::abs(x);
+    }
 };
 
 //Allow odr-use of the constexpr static members
@@ -89,15 +101,11 @@ struct layer_base_traits<rectifier_layer_impl<Desc>> {
  * \brief Specialization of sgd_context for rectifier_layer_impl
  */
 template <typename DBN, typename Desc, size_t L>
-struct sgd_context<DBN, rectifier_layer_impl<Desc>, L> {
+struct sgd_context<DBN, rectifier_layer_impl<Desc>, L> : transform_sgd_context<previous_output_t<DBN, L>, true> {
     using layer_t          = rectifier_layer_impl<Desc>;                            ///< The current layer type
     using previous_layer   = typename DBN::template layer_type<L - 1>;          ///< The previous layer type
     using previous_context = sgd_context<DBN, previous_layer, L - 1>;           ///< The previous layer's context
-    using inputs_t         = decltype(std::declval<previous_context>().output); ///< The type of inputs
-
-    inputs_t input;  ///< A batch of input
-    inputs_t output; ///< A batch of output
-    inputs_t errors; ///< A batch of errors
+    using inputs_t         = previous_output_t<DBN, L>;                         ///< The type of inputs
 
     sgd_context(const layer_t& /*layer*/){}
 };
@@ -29,6 +29,8 @@ struct scale_layer_impl : transform_layer<scale_layer_impl<Desc>> {
     static constexpr int A = desc::A; ///< The scale multiplier
     static constexpr int B = desc::B; ///< The scale divisor
 
+    static constexpr bool element_wise = true; ///< The layer is applied independently to each value
+
     /*!
      * \brief Returns a string representation of the layer
      */
@@ -57,6 +59,16 @@ struct scale_layer_impl : transform_layer<scale_layer_impl<Desc>> {
         output = input * (double(A) / double(B));
     }
 
+    /*!
+     * \brief Apply the layer to a single value
+     * \param x The input value
+     * \return the output value
+     */
+    template <typename T>
+    static T apply_one(T x) {
+        return x * T(double(A) / double(B));
+    }
+
     /*!
      * \brief Adapt the errors, called before backpropagation of the errors.
      *
@@ -114,15 +126,11 @@ struct layer_base_traits<scale_layer_impl<Desc>> {
  * \brief Specialization of sgd_context for scale_layer_impl
  */
 template <typename DBN, typename Desc, size_t L>
-struct sgd_context<DBN, scale_layer_impl<Desc>, L> {
+struct sgd_context<DBN, scale_layer_impl<Desc>, L> : transform_sgd_context<previous_output_t<DBN, L>, true> {
     using layer_t          = scale_layer_impl<Desc>;                            ///< The current layer type
     using previous_layer   = typename DBN::template layer_type<L - 1>;          ///< The previous layer type
     using previous_context = sgd_context<DBN, previous_layer, L - 1>;           ///< The previous layer's context
-    using inputs_t         = decltype(std::declval<previous_context>().output); ///< The type of inputs
-
-    inputs_t input;  ///< A batch of input
-    inputs_t output; ///< A batch of output
-    inputs_t errors; ///< A batch of errors
+    using inputs_t         = previous_output_t<DBN, L>;                         ///< The type of inputs
 
     sgd_context(const layer_t& /*layer*/){}
 };
@@ -27,6 +27,8 @@ struct shape_1d_layer_impl : transform_layer<shape_1d_layer_impl<Desc>> {
     static constexpr size_t Size = desc::S; ///< The input size
     static constexpr size_t D    = 1;       ///< The number of dimensions
 
+    static constexpr bool shape_only = true; ///< The layer only gives a shape to its input
+
     using input_one_t  = etl::fast_dyn_matrix<weight, Size>; ///< The preferred type of input
     using output_one_t = etl::fast_dyn_matrix<weight, Size>; ///< The type of output
 
@@ -86,6 +88,20 @@ struct shape_1d_layer_impl : transform_layer<shape_1d_layer_impl<Desc>> {
         output = input;
     }
 
+    /*!
+     * \brief Returns a view of the batch of input with the shape of the
+     * layer, without copying it
+     * \param input The batch of input
+     */
+    template <typename Input>
+    static auto view_batch(const Input& input) {
+        if constexpr (etl::all_fast<Input>) {
+            return etl::reshape<etl::dim<0, Input>(), Size>(input);
+        } else {
+            return etl::reshape(input, etl::dim<0>(input), Size);
+        }
+    }
+
     /*!
      * \brief Adapt the errors, called before backpropagation of the errors.
      *
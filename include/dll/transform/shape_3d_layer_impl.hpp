@@ -29,6 +29,8 @@ struct shape_3d_layer_impl : transform_layer<shape_3d_layer_impl<Desc>> {
     static constexpr size_t W = desc::W; ///< The height of the input
     static constexpr size_t H = desc::H; ///< The width of the input
 
+    static constexpr bool shape_only = true; ///< The layer only gives a shape to its input
+
     using input_one_t  = etl::fast_dyn_matrix<weight, C, W, H>; ///< The preferred type of input
     using output_one_t = etl::fast_dyn_matrix<weight, C, W, H>; ///< The type of output
 
@@ -88,6 +90,20 @@ struct shape_3d_layer_impl : transform_layer<shape_3d_layer_impl<Desc>> {
         output = input;
     }
 
+    /*!
+     * \brief Returns a view of the batch of input with the shape of the
+     * layer, without copying it
+     * \param input The batch of input
+     */
+    template <typename Input>
+    static auto view_batch(const Input& input) {
+        if constexpr (etl::all_fast<Input>) {
+            return etl::reshape<etl::dim<0, Input>(), C, W, H>(input);
+        } else {
+            return etl::reshape(input, etl::dim<0>(input), C, W, H);
+        }
+    }
+
     /*!
      * \brief Adapt the errors, called before backpropagation of the errors.
      *
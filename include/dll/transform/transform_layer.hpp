@@ -10,6 +10,7 @@
 #include "dll/layer.hpp"
 #include "dll/layer_traits.hpp"
 #include "dll/dbn_traits.hpp"
+#include "dll/trainer/context_fwd.hpp"
 
 namespace dll {
 
@@ -60,6 +61,30 @@ struct transform_layer : layer<Derived> {
         //Nothing to change
     }
 
+    /*!
+     * \brief Apply the layer in place to the given batch, for the layers
+     * applied independently to each value
+     * \param batch The batch of input, replaced by the batch of output
+     */
+    template <typename Batch>
+    static void forward_in_place(Batch& batch) {
+        if constexpr (etl::all_dma<Batch>) {
+            batch.ensure_cpu_up_to_date();
+
+            auto* ptr = batch.memory_start();
+
+            for (size_t i = 0; i < etl::size(batch); ++i) {
+                ptr[i] = derived_t::apply_one(ptr[i]);
+            }
+
+            batch.invalidate_gpu();
+        } else {
+            for (auto& value : batch) {
+                value = derived_t::apply_one(value);
+            }
+        }
+    }
+
 private:
     /*!
      * \brief Returns a reference to the derived object, i.e. the object using the CRTP injector.
@@ -83,4 +108,46 @@ void inherit_dim([[maybe_unused]] Output& output, [[maybe_unused]] const Input&
     }
 }
 
+/*!
+ * \brief The type of the batch of output of the SGD context of the layer
+ * before the layer L
+ */
+template <typename DBN, size_t L>
+using previous_output_t = std::decay_t<decltype(std::declval<sgd_context<DBN, typename DBN::template layer_type<L - 1>, L - 1>>().output)>;
+
+/*!
+ * \brief The buffers of the SGD context of a transform layer
+ *
+ * When the layer is computed in place, the output is the input, the
+ * layer only needs its output for its backward pass.
+ *
+ * \tparam Inputs The type of a batch of input
+ * \tparam InPlace Indicates if the layer is computed in place
+ */
+template <typename Inputs, bool InPlace>
+struct transform_sgd_context {
+    static constexpr bool in_place = false; ///< Indicates if the layer is computed in place
+
+    Inputs input;  ///< A batch of input
+    Inputs output; ///< A batch of output
+    Inputs errors; ///< A batch of errors
+};
+
+/*!
+ * \copydoc transform_sgd_context
+ */
+template <typename Inputs>
+struct transform_sgd_context<Inputs, true> {
+    static constexpr bool in_place = true; ///< Indicates if the layer is computed in place
+
+    Inputs input;   ///< A batch of input, replaced by the batch of output
+    Inputs& output; ///< A batch of output (the input)
+    Inputs errors;  ///< A batch of errors
+
+    transform_sgd_context() : output(input) {}
+
+    transform_sgd_context(const transform_sgd_context&) = delete;
+    transform_sgd_context& operator=(const transform_sgd_context&) = delete;
+};
+
 } //end of dll namespace
@@ -0,0 +1,20 @@
+//=======================================================================
+// Copyright (c) 2014-2017 Baptiste Wicht
+// Distributed under the terms of the MIT License.
+// (See accompanying file LICENSE or copy at
+//  http://opensource.org/licenses/MIT)
+//=======================================================================
+
+#pragma once
+
+namespace dll {
+
+/*!
+ * \brief The interpolation of the upsample layers
+ */
+enum class upsample_type {
+    NEAREST, ///< Each value is replicated over its block
+    BILINEAR ///< Bilinear interpolation of the last two dimensions (half-pixel centers)
+};
+
+} //end of dll namespace
@@ -0,0 +1,322 @@
+//=======================================================================
+// Copyright (c) 2014-2017 Baptiste Wicht
+// Distributed under the terms of the MIT License.
+// (See accompanying file LICENSE or copy at
+//  http://opensource.org/licenses/MIT)
+//=======================================================================
+
+/*!
+ * \file
+ * \brief Pinning of the threads to cores or NUMA nodes and interleaving of
+ * allocations over the NUMA nodes
+ *
+ * The execution policy is global and must be set before the networks and
+ * the generators are created. The pages of memory are placed by the
+ * kernel on the node of the thread touching them first: the buffers built
+ * by a pinned thread are local to its node.
+ *
+ * The topology is read from /sys/devices/system/node. Pinning and
+ * interleaving are only supported on Linux, they do nothing elsewhere.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef __linux__
+#include <dirent.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#endif
+
+namespace dll {
+
+/*!
+ * \brief The pinning of a set of threads
+ */
+enum class affinity_type {
+    NONE, ///< The threads are not pinned
+    CORE, ///< Each thread is pinned to one core, filling the NUMA nodes one after another
+    NODE  ///< Each thread is pinned to the cores of one NUMA node, the threads being spread over the nodes
+};
+
+/*!
+ * \brief The execution policy of the networks and of the generators
+ */
+struct execution_policy {
+    affinity_type pool       = affinity_type::NONE; ///< The pinning of the workers of the thread pools of the networks
+    affinity_type generators = affinity_type::NONE; ///< The pinning of the threads of the generators
+    affinity_type stages     = affinity_type::NONE; ///< The pinning of the threads of the stages of the pipelines
+    size_t huge_pages        = 0;                   ///< The minimum size (bytes) of the buffers backed by huge pages (0 to disable)
+    bool hugetlb             = false;               ///< Use explicit hugetlb pages instead of transparent huge pages
+};
+
+/*!
+ * \brief Returns the global execution policy
+ */
+inline execution_policy& execution() {
+    static execution_policy policy;
+    return policy;
+}
+
+/*!
+ * \brief Parse a list of cpus of the kernel (0-3,8-11)
+ */
+inline std::vector<size_t> parse_cpu_list(const std::string& list) {
+    std::vector<size_t> cpus;
+
+    size_t i = 0;
+
+    while (i < list.size()) {
+        const size_t end  = list.find(',', i);
+        const auto range  = list.substr(i, end == std::string::npos ? std::string::npos : end - i);
+        const size_t dash = range.find('-');
+
+        if (!range.empty() && range[0] != '\n') {
+            const size_t first = std::stoul(range.substr(0, dash));
+            const size_t last  = dash == std::string::npos ? first : std::stoul(range.substr(dash + 1));
+
+            for (size_t c = first; c <= last; ++c) {
+                cpus.push_back(c);
+            }
+        }
+
+        if (end == std::string::npos) {
+            break;
+        }
+
+        i = end + 1;
+    }
+
+    return cpus;
+}
+
+/*!
+ * \brief Returns the cpus of each NUMA node of the machine.
+ *
+ * Without any NUMA information, all the cpus form a single node.
+ */
+inline const std::vector<std::vector<size_t>>& numa_nodes() {
+    static const std::vector<std::vector<size_t>> nodes = [] {
+        std::vector<std::vector<size_t>> nodes;
+
+        for (size_t node = 0;; ++node) {
+            std::ifstream stream("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+
+            if (!stream) {
+                break;
+            }
+
+            std::string list;
+            std::getline(stream, list);
+
+            auto cpus = parse_cpu_list(list);
+
+            if (!cpus.empty()) {
+                nodes.push_back(std::move(cpus));
+            }
+        }
+
+        if (nodes.empty()) {
+            nodes.emplace_back();
+
+            for (size_t c = 0; c < std::max(1u, std::thread::hardware_concurrency()); ++c) {
+                nodes.back().push_back(c);
+            }
+        }
+
+        return nodes;
+    }();
+
+    return nodes;
+}
+
+/*!
+ * \brief Pin the current thread, the ith thread of its set, with the
+ * given affinity
+ * \param type The affinity
+ * \param i The index of the thread in its set
+ * \return true if the thread has been pinned, false otherwise
+ */
+inline bool pin_thread(affinity_type type, size_t i) {
+#ifdef __linux__
+    if (type == affinity_type::NONE) {
+        return false;
+    }
+
+    auto& nodes = numa_nodes();
+
+    cpu_set_t set;
+    CPU_ZERO(&set);
+
+    if (type == affinity_type::CORE) {
+        size_t cpus = 0;
+
+        for (auto& node : nodes) {
+            cpus += node.size();
+        }
+
+        size_t c = i % cpus;
+
+        for (auto& node : nodes) {
+            if (c < node.size()) {
+                CPU_SET(node[c], &set);
+                break;
+            }
+
+            c -= node.size();
+        }
+    } else {
+        for (auto cpu : nodes[i % nodes.size()]) {
+            CPU_SET(cpu, &set);
+        }
+    }
+
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+    cpp_unused(type);
+    cpp_unused(i);
+
+    return false;
+#endif
+}
+
+/*!
+ * \brief Pin the n workers of the given thread pool with the given
+ * affinity.
+ *
+ * Each worker runs exactly one of the n tasks, since no task completes
+ * before all of them have started.
+ */
+template <typename Pool>
+void pin_pool(Pool& pool, affinity_type type, size_t n) {
+    if (type == affinity_type::NONE) {
+        return;
+    }
+
+    std::mutex lock;
+    std::condition_variable condition;
+    size_t started = 0;
+
+    for (size_t t = 0; t < n; ++t) {
+        pool.do_task([&lock, &condition, &started, type, n] {
+            size_t i;
+
+            {
+                std::unique_lock<std::mutex> ulock(lock);
+
+                i = started++;
+
+                condition.notify_all();
+                condition.wait(ulock, [&started, n] { return started == n; });
+            }
+
+            pin_thread(type, i);
+        });
+    }
+
+    pool.wait();
+}
+
+/*!
+ * \brief Restrict all the threads of the process, and the threads they
+ * create, to the first n cpus, filling the NUMA nodes one after another.
+ *
+ * This limits the cores used by all the threads of DLL and ETL together,
+ * regardless of the size of their pools.
+ *
+ * \param n The number of cpus, 0 for all the cpus
+ * \return true if all the threads have been restricted, false otherwise
+ */
+inline bool limit_process_cpus(size_t n) {
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+
+    size_t count = 0;
+
+    for (auto& node : numa_nodes()) {
+        for (auto cpu : node) {
+            if (!n || count < n) {
+                CPU_SET(cpu, &set);
+                ++count;
+            }
+        }
+    }
+
+    DIR* tasks = opendir("/proc/self/task");
+
+    if (!tasks) {
+        return false;
+    }
+
+    bool limited = true;
+
+    while (auto* entry = readdir(tasks)) {
+        if (entry->d_name[0] != '.') {
+            limited &= sched_setaffinity(std::stoi(entry->d_name), sizeof(set), &set) == 0;
+        }
+    }
+
+    closedir(tasks);
+
+    return limited;
+#else
+    cpp_unused(n);
+
+    return false;
+#endif
+}
+
+/*!
+ * \brief Interleave the pages of memory first touched by the current thread
+ * over all the NUMA nodes during the lifetime of the scope.
+ *
+ * This is intended for the construction of large shared weights, for
+ * instance: { dll::interleave_scope scope; net = std::make_unique<net_t>(); }
+ */
+struct interleave_scope {
+    interleave_scope() {
+#ifdef __linux__
+        auto& nodes = numa_nodes();
+
+        if (nodes.size() > 1) {
+            unsigned long mask = 0;
+
+            for (size_t node = 0; node < nodes.size() && node < 8 * sizeof(mask); ++node) {
+                mask |= 1UL << node;
+            }
+
+            // MPOL_INTERLEAVE
+            active = syscall(SYS_set_mempolicy, 3, &mask, 8 * sizeof(mask) + 1) == 0;
+        }
+#endif
+    }
+
+    interleave_scope(const interleave_scope& rhs) = delete;
+    interleave_scope& operator=(const interleave_scope& rhs) = delete;
+
+    /*!
+     * \brief Restore the default allocation policy of the thread
+     */
+    ~interleave_scope() {
+#ifdef __linux__
+        if (active) {
+            // MPOL_DEFAULT
+            syscall(SYS_set_mempolicy, 0, nullptr, 0);
+        }
+#endif
+    }
+
+    bool active = false; ///< Indicates if the allocations are interleaved
+};
+
+} //end of dll namespace
@@ -0,0 +1,281 @@
+//=======================================================================
+// Copyright (c) 2014-2017 Baptiste Wicht
+// Distributed under the terms of the MIT License.
+// (See accompanying file LICENSE or copy at
+//  http://opensource.org/licenses/MIT)
+//=======================================================================
+
+/*!
+ * \file
+ * \brief Fused kernels of the 4D batch normalization
+ *
+ * The kernels work on contiguous B x K x P batches (P being the number of
+ * pixels of one feature map). The statistics of each feature map are
+ * computed plane by plane and merged with the parallel formula of Chan et
+ * al., so that the input is only read once for the statistics and once
+ * for the normalized output. The normalized input is never stored, it is
+ * recomputed from the input, the mean and the inverse deviation.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+#include <vector>
+
+#include "dll/util/scheduler.hpp"
+
+namespace dll {
+
+namespace bn_detail {
+
+constexpr size_t lanes = 8; ///< The number of independent accumulators of the reductions
+
+/*!
+ * \brief Returns the sum of the given values
+ */
+template <typename T>
+T sum(const T* p, size_t n) {
+    T acc[lanes] = {};
+
+    size_t i = 0;
+
+    for (; i + lanes <= n; i += lanes) {
+        for (size_t l = 0; l < lanes; ++l) {
+            acc[l] += p[i + l];
+        }
+    }
+
+    T s(0);
+
+    for (; i < n; ++i) {
+        s += p[i];
+    }
+
+    for (size_t l = 0; l < lanes; ++l) {
+        s += acc[l];
+    }
+
+    return s;
+}
+
+/*!
+ * \brief Returns the sum of the squared deviations of the given values
+ * from m
+ */
+template <typename T>
+T sum_sq_dev(const T* p, size_t n, T m) {
+    T acc[lanes] = {};
+
+    size_t i = 0;
+
+    for (; i + lanes <= n; i += lanes) {
+        for (size_t l = 0; l < lanes; ++l) {
+            const T d = p[i + l] - m;
+            acc[l] += d * d;
+        }
+    }
+
+    T s(0);
+
+    for (; i < n; ++i) {
+        const T d = p[i] - m;
+        s += d * d;
+    }
+
+    for (size_t l = 0; l < lanes; ++l) {
+        s += acc[l];
+    }
+
+    return s;
+}
+
+/*!
+ * \brief Returns the sum of dy and the sum of dy * (x - m)
+ */
+template <typename T>
+std::pair<T, T> sum_dot_dev(const T* dy, const T* x, size_t n, T m) {
+    T acc1[lanes] = {};
+    T acc2[lanes] = {};
+
+    size_t i = 0;
+
+    for (; i + lanes <= n; i += lanes) {
+        for (size_t l = 0; l < lanes; ++l) {
+            acc1[l] += dy[i + l];
+            acc2[l] += dy[i + l] * (x[i + l] - m);
+        }
+    }
+
+    T s1(0);
+    T s2(0);
+
+    for (; i < n; ++i) {
+        s1 += dy[i];
+        s2 += dy[i] * (x[i] - m);
+    }
+
+    for (size_t l = 0; l < lanes; ++l) {
+        s1 += acc1[l];
+        s2 += acc2[l];
+    }
+
+    return {s1, s2};
+}
+
+/*!
+ * \brief Call the functor for each of the K feature maps, splitting them
+ * between the threads of the scheduler for large batches
+ * \param K The number of feature maps
+ * \param work The number of values of the batch
+ * \param functor The functor to call for each feature map
+ */
+template <typename Functor>
+void for_each_kernel(size_t K, size_t work, Functor&& functor) {
+    // Not worth the threads for small batches
+    if (work < 256 * 1024) {
+        for (size_t k = 0; k < K; ++k) {
+            functor(k);
+        }
+
+        return;
+    }
+
+    dll::scheduler().parallel_for(K, functor);
+}
+
+} //end of namespace bn_detail
+
+/*!
+ * \brief Compute the statistics of the batch and the normalized output in
+ * one fused kernel
+ * \param x The input batch (B x K x P)
+ * \param y The output batch (B x K x P)
+ * \param gamma The scale of each feature map
+ * \param beta The shift of each feature map
+ * \param e The epsilon added to the variance
+ * \param mean The mean of each feature map (output)
+ * \param var The (biased) variance of each feature map (output)
+ * \param inv_var The inverse deviation of each feature map (output)
+ */
+template <typename T>
+void batch_norm_4d_forward(const T* x, T* y, size_t B, size_t K, size_t P, const T* gamma, const T* beta, T e, T* mean, T* var, T* inv_var) {
+    bn_detail::for_each_kernel(K, B * K * P, [=](size_t k) {
+        // Merge the statistics of the planes of the feature map
+        double n  = 0;
+        double m  = 0;
+        double m2 = 0;
+
+        for (size_t b = 0; b < B; ++b) {
+            const T* p = x + (b * K + k) * P;
+
+            const T mp = bn_detail::sum(p, P) / T(P);
+            const T qp = bn_detail::sum_sq_dev(p, P, mp);
+
+            const double np    = double(P);
+            const double delta = double(mp) - m;
+            const double nn    = n + np;
+
+            m += delta * np / nn;
+            m2 += double(qp) + delta * delta * n * np / nn;
+            n = nn;
+        }
+
+        mean[k]    = T(m);
+        var[k]     = T(m2 / n);
+        inv_var[k] = T(1.0 / std::sqrt(m2 / n + double(e)));
+
+        // y = gamma * (x - mean) * inv_var + beta
+        const T a = gamma[k] * inv_var[k];
+        const T c = beta[k] - mean[k] * a;
+
+        for (size_t b = 0; b < B; ++b) {
+            const T* p = x + (b * K + k) * P;
+            T* q       = y + (b * K + k) * P;
+
+            for (size_t i = 0; i < P; ++i) {
+                q[i] = p[i] * a + c;
+            }
+        }
+    });
+}
+
+/*!
+ * \brief Backpropagate the errors of the batch normalization in one fused
+ * kernel
+ * \param x The input batch (B x K x P)
+ * \param dy The errors of the output (B x K x P)
+ * \param dx The errors of the input (B x K x P)
+ * \param gamma The scale of each feature map
+ * \param mean The mean of each feature map in the batch
+ * \param inv_var The inverse deviation of each feature map in the batch
+ */
+template <typename T>
+void batch_norm_4d_backward(const T* x, const T* dy, T* dx, size_t B, size_t K, size_t P, const T* gamma, const T* mean, const T* inv_var) {
+    const T S = T(B * P);
+
+    bn_detail::for_each_kernel(K, B * K * P, [=](size_t k) {
+        const T m   = mean[k];
+        const T inv = inv_var[k];
+
+        T sdy(0);
+        T sdyx(0);
+
+        for (size_t b = 0; b < B; ++b) {
+            auto [s1, s2] = bn_detail::sum_dot_dev(dy + (b * K + k) * P, x + (b * K + k) * P, P, m);
+
+            sdy += s1;
+            sdyx += s2;
+        }
+
+        // The sums of dxhat and dxhat * xhat
+        const T d1 = gamma[k] * sdy;
+        const T d2 = gamma[k] * sdyx * inv;
+
+        // dx = (inv / S) * (S * dxhat - d1 - xhat * d2)
+        const T a = inv * gamma[k];
+        const T c = -inv * inv * d2 / S;
+        const T o = -inv * d1 / S - m * c;
+
+        for (size_t b = 0; b < B; ++b) {
+            const T* pdy = dy + (b * K + k) * P;
+            const T* px  = x + (b * K + k) * P;
+            T* pdx       = dx + (b * K + k) * P;
+
+            for (size_t i = 0; i < P; ++i) {
+                pdx[i] = a * pdy[i] + c * px[i] + o;
+            }
+        }
+    });
+}
+
+/*!
+ * \brief Compute the gradients of the scale and of the shift of the batch
+ * normalization in one fused kernel
+ * \param x The input batch (B x K x P)
+ * \param dy The errors of the output (B x K x P)
+ * \param mean The mean of each feature map in the batch
+ * \param inv_var The inverse deviation of each feature map in the batch
+ * \param dgamma The gradients of the scale (output)
+ * \param dbeta The gradients of the shift (output)
+ */
+template <typename T>
+void batch_norm_4d_gradients(const T* x, const T* dy, size_t B, size_t K, size_t P, const T* mean, const T* inv_var, T* dgamma, T* dbeta) {
+    bn_detail::for_each_kernel(K, B * K * P, [=](size_t k) {
+        T sdy(0);
+        T sdyx(0);
+
+        for (size_t b = 0; b < B; ++b) {
+            auto [s1, s2] = bn_detail::sum_dot_dev(dy + (b * K + k) * P, x + (b * K + k) * P, P, mean[k]);
+
+            sdy += s1;
+            sdyx += s2;
+        }
+
+        dgamma[k] = sdyx * inv_var[k];
+        dbeta[k]  = sdy;
+    });
+}
+
+} //end of dll namespace
@@ -0,0 +1,365 @@
+//=======================================================================
+// Copyright (c) 2014-2017 Baptiste Wicht
+// Distributed under the terms of the MIT License.
+// (See accompanying file LICENSE or copy at
+//  http://opensource.org/licenses/MIT)
+//=======================================================================
+
+/*!
+ * \file
+ * \brief Benchmark harness for the performance programs, with statistics
+ * and JSON output
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "dll/util/timers.hpp"
+
+namespace dll {
+
+/*!
+ * \brief A phase of the training, measured by the sum of some timers
+ */
+struct benchmark_phase {
+    std::string name;                ///< The name of the phase
+    std::vector<std::string> timers; ///< The timers measuring the phase
+};
+
+/*!
+ * \brief Returns the default phases of the SGD training
+ */
+inline std::vector<benchmark_phase> default_benchmark_phases() {
+    return {
+        {"data", {"generator:wait", "sgd::stage_batch"}},
+        {"forward", {"sgd::forward"}},
+        {"backward", {"sgd::backward"}},
+        {"update", {"sgd::grad"}}};
+}
+
+/*!
+ * \brief Statistical summary of the samples of a benchmark
+ */
+struct benchmark_stats {
+    double min    = 0.0; ///< The minimum
+    double median = 0.0; ///< The median
+    double p95    = 0.0; ///< The 95th percentile (nearest rank)
+    double mean   = 0.0; ///< The mean
+    double stddev = 0.0; ///< The standard deviation
+    double max    = 0.0; ///< The maximum
+};
+
+/*!
+ * \brief Compute the statistical summary of the given samples
+ */
+inline benchmark_stats compute_benchmark_stats(std::vector<double> samples) {
+    benchmark_stats stats;
+
+    if (samples.empty()) {
+        return stats;
+    }
+
+    std::sort(samples.begin(), samples.end());
+
+    const size_t n = samples.size();
+
+    stats.min    = samples.front();
+    stats.max    = samples.back();
+    stats.median = n % 2 ? samples[n / 2] : 0.5 * (samples[n / 2 - 1] + samples[n / 2]);
+    stats.p95    = samples[size_t(std::ceil(0.95 * n)) - 1];
+
+    for (auto sample : samples) {
+        stats.mean += sample;
+    }
+
+    stats.mean /= n;
+
+    for (auto sample : samples) {
+        stats.stddev += (sample - stats.mean) * (sample - stats.mean);
+    }
+
+    stats.stddev = std::sqrt(stats.stddev / n);
+
+    return stats;
+}
+
+/*!
+ * \brief The measures of one benchmark
+ */
+struct benchmark_result {
+    std::string name;                        ///< The name of the benchmark
+    std::vector<double> times;               ///< The time of each repetition (s)
+    std::vector<std::vector<double>> phases; ///< The time of each phase, for each repetition (s)
+};
+
+/*!
+ * \brief A suite of benchmarks.
+ *
+ * Each benchmark is run a number of times without being measured (warmup)
+ * and then a number of times with measures (repetitions). For each
+ * repetition, the timers are reset and the wall time of the repetition
+ * and the time of each phase (from the timers) are recorded. The summary
+ * of the suite (min, median, 95th percentile, ...) is printed and can be
+ * written as JSON, for regression tracking.
+ *
+ * The command line of the program can select the benchmarks to run and
+ * override the parameters:
+ *   --warmup=N      The number of warmup runs
+ *   --repeat=N      The number of measured repetitions
+ *   --json=<file>   Write the results as JSON in the given file
+ *   <name>          Only run the given benchmarks
+ */
+struct benchmark_suite {
+    std::string name;                    ///< The name of the suite
+    size_t warmup;                       ///< The number of warmup runs
+    size_t repeat;                       ///< The number of measured repetitions
+    std::string json_file;               ///< The file of the JSON output (none if empty)
+    std::vector<std::string> filters;    ///< The selected benchmarks (all if empty)
+    std::vector<benchmark_phase> phases; ///< The phases measured in each repetition
+
+    /*!
+     * \brief Create a new suite, configured from the command line
+     * \param name The name of the suite
+     * \param argc The number of arguments
+     * \param argv The arguments
+     * \param warmup The default number of warmup runs
+     * \param repeat The default number of measured repetitions
+     */
+    benchmark_suite(std::string name, int argc, char* argv[], size_t warmup = 1, size_t repeat = 5)
+            : name(std::move(name)), warmup(warmup), repeat(repeat), phases(default_benchmark_phases()) {
+        for (int i = 1; i < argc; ++i) {
+            std::string arg(argv[i]);
+
+            if (arg.find("--warmup=") == 0) {
+                this->warmup = std::stoul(arg.substr(9));
+            } else if (arg.find("--repeat=") == 0) {
+                this->repeat = std::max<size_t>(1, std::stoul(arg.substr(9)));
+            } else if (arg.find("--json=") == 0) {
+                json_file = arg.substr(7);
+            } else {
+                filters.push_back(arg);
+            }
+        }
+    }
+
+    /*!
+     * \brief Indicates if the given benchmark is selected
+     * \param bench The name of the benchmark (or of its group)
+     * \param def Indicates if the benchmark runs when none is selected
+     */
+    bool selected(const std::string& bench, bool def = true) const {
+        if (filters.empty()) {
+            return def;
+        }
+
+        return std::find(filters.begin(), filters.end(), bench) != filters.end();
+    }
+
+    /*!
+     * \brief Run the given benchmark
+     * \param bench The name of the benchmark
+     * \param functor The functor to run in each repetition
+     */
+    template <typename Functor>
+    void run(const std::string& bench, Functor&& functor) {
+        benchmark_result result;
+        result.name = bench;
+
+        for (size_t i = 0; i < warmup; ++i) {
+            functor();
+        }
+
+        for (size_t i = 0; i < repeat; ++i) {
+            dll::reset_timers();
+
+            auto start = std::chrono::steady_clock::now();
+
+            functor();
+
+            auto end = std::chrono::steady_clock::now();
+
+            result.times.push_back(std::chrono::duration<double>(end - start).count());
+            result.phases.push_back(phase_times());
+        }
+
+        std::cout << "[bench] " << name << "/" << bench << ": median ";
+        std::cout << to_string_precision(compute_benchmark_stats(result.times).median, 4) << "s" << std::endl;
+
+        results.push_back(std::move(result));
+    }
+
+    /*!
+     * \brief Returns the results of the benchmarks run so far
+     */
+    const std::vector<benchmark_result>& get_results() const {
+        return results;
+    }
+
+    /*!
+     * \brief Print the summary of the suite and write the JSON output
+     * \return The exit status of the program
+     */
+    int finish() const {
+        summary();
+
+        if (!json_file.empty()) {
+            std::ofstream os(json_file);
+
+            dump_json(os);
+
+            if (!os) {
+                std::cerr << "ERROR: Impossible to write benchmark results to " << json_file << std::endl;
+                return 1;
+            }
+
+            std::cout << "Benchmark results written to " << json_file << std::endl;
+        }
+
+        return 0;
+    }
+
+    /*!
+     * \brief Print the summary of the suite on the standard output
+     */
+    void summary() const {
+        std::cout << "Benchmarks: " << name << " (warmup: " << warmup << ", repeat: " << repeat << ")" << std::endl;
+
+        for (auto& result : results) {
+            auto stats = compute_benchmark_stats(result.times);
+
+            std::cout << "  " << result.name
+                      << ": median " << to_string_precision(stats.median, 4) << "s"
+                      << ", p95 " << to_string_precision(stats.p95, 4) << "s"
+                      << ", min " << to_string_precision(stats.min, 4) << "s"
+                      << ", stddev " << to_string_precision(stats.stddev, 4) << "s" << std::endl;
+
+            for (size_t p = 0; p < phases.size(); ++p) {
+                auto phase_stats = compute_benchmark_stats(phase_samples(result, p));
+
+                std::cout << "    " << phases[p].name
+                          << ": median " << to_string_precision(phase_stats.median, 4) << "s"
+                          << ", p95 " << to_string_precision(phase_stats.p95, 4) << "s" << std::endl;
+            }
+        }
+    }
+
+    /*!
+     * \brief Write the results of the suite as JSON in the given stream
+     */
+    void dump_json(std::ostream& os) const {
+        os << std::setprecision(9);
+
+        os << "{\n";
+        os << "  \"suite\": \"" << escape(name) << "\",\n";
+        os << "  \"warmup\": " << warmup << ",\n";
+        os << "  \"repeat\": " << repeat << ",\n";
+        os << "  \"benchmarks\": [";
+
+        for (size_t b = 0; b < results.size(); ++b) {
+            auto& result = results[b];
+
+            os << (b ? ",\n" : "\n");
+            os << "    {\n";
+            os << "      \"name\": \"" << escape(result.name) << "\",\n";
+            os << "      \"time\": ";
+            dump_json_stats(os, result.times);
+            os << ",\n";
+            os << "      \"phases\": {";
+
+            for (size_t p = 0; p < phases.size(); ++p) {
+                os << (p ? ",\n" : "\n");
+                os << "        \"" << escape(phases[p].name) << "\": ";
+                dump_json_stats(os, phase_samples(result, p));
+            }
+
+            os << "\n      }\n";
+            os << "    }";
+        }
+
+        os << "\n  ]\n";
+        os << "}\n";
+    }
+
+private:
+    /*!
+     * \brief Returns the time of each phase from the current timers
+     */
+    std::vector<double> phase_times() const {
+        auto timers = merged_timers();
+
+        std::vector<double> times(phases.size(), 0.0);
+
+        for (size_t p = 0; p < phases.size(); ++p) {
+            for (auto& timer : timers) {
+                if (std::find(phases[p].timers.begin(), phases[p].timers.end(), timer.name) != phases[p].timers.end()) {
+                    times[p] += timer.duration * 1e-9;
+                }
+            }
+        }
+
+        return times;
+    }
+
+    /*!
+     * \brief Returns the samples of the given phase of the given result
+     */
+    static std::vector<double> phase_samples(const benchmark_result& result, size_t p) {
+        std::vector<double> samples;
+
+        for (auto& times : result.phases) {
+            samples.push_back(times[p]);
+        }
+
+        return samples;
+    }
+
+    /*!
+     * \brief Write the statistics of the given samples as a JSON object
+     */
+    static void dump_json_stats(std::ostream& os, const std::vector<double>& samples) {
+        auto stats = compute_benchmark_stats(samples);
+
+        os << "{\"min\": " << stats.min
+           << ", \"median\": " << stats.median
+           << ", \"p95\": " << stats.p95
+           << ", \"mean\": " << stats.mean
+           << ", \"stddev\": " << stats.stddev
+           << ", \"max\": " << stats.max
+           << ", \"samples\": [";
+
+        for (size_t i = 0; i < samples.size(); ++i) {
+            os << (i ? ", " : "") << samples[i];
+        }
+
+        os << "]}";
+    }
+
+    /*!
+     * \brief Escape the given string for JSON
+     */
+    static std::string escape(const std::string& str) {
+        std::string escaped;
+
+        for (auto c : str) {
+            if (c == '"' || c == '\\') {
+                escaped += '\\';
+            }
+
+            escaped += c;
+        }
+
+        return escaped;
+    }
+
+    std::vector<benchmark_result> results; ///< The results of the benchmarks run so far
+};
+
+} //end of dll namespace
@@ -0,0 +1,430 @@
+//=======================================================================
+// Copyright (c) 2014-2017 Baptiste Wicht
+// Distributed under the terms of the MIT License.
+// (See accompanying file LICENSE or copy at
+//  http://opensource.org/licenses/MIT)
+//=======================================================================
+
+/*!
+ * \file
+ * \brief Compact model files, with the weights stored in half precision or
+ * quantized to int8, and optionally compressed.
+ *
+ * A compact model is a packed model (see model_file.hpp) with its own magic
+ * number, in which each record holds the encoded weights of one layer
+ * after a small header. The records are decoded independently, in
+ * parallel.
+ *
+ * The int8 encoding is symmetric, with one scale per block of
+ * compact_block values, so that the biases are not quantized with the
+ * scale of the weights.
+ *
+ * The compression uses zstd, it is only available when DLL_ZSTD_SUPPORT is
+ * defined (link with -lzstd).
+ */
+
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#ifdef DLL_ZSTD_SUPPORT
+#include <zstd.h>
+#endif
+
+#include "cpp_utils/assert.hpp"
+
+#include "dll/util/model_file.hpp"
+
+namespace dll {
+
+/*!
+ * \brief The encoding of the weights of a compact model
+ */
+enum class model_encoding : uint32_t {
+    RAW  = 0, ///< The weights are stored unchanged
+    FP16 = 1, ///< The weights are stored as IEEE half-precision floats
+    BF16 = 2, ///< The weights are stored as bfloat16
+    INT8 = 3  ///< The weights are quantized to int8, with one scale per block
+};
+
+constexpr uint32_t compact_model_magic = 0x444C4C43; ///< The magic number of the compact models ("DLLC")
+constexpr size_t compact_block         = 256;        ///< The number of values sharing a scale (INT8)
+
+/*!
+ * \brief The header of a record of a compact model
+ */
+struct compact_record_header {
+    uint32_t encoding;   ///< The encoding of the values
+    uint32_t compressed; ///< Indicates if the encoded values are compressed
+    uint64_t values;     ///< The number of values
+    uint64_t encoded;    ///< The number of bytes of the encoded values (before compression)
+    uint64_t stored;     ///< The number of bytes stored after the header
+};
+
+namespace compact_detail {
+
+/*!
+ * \brief Convert a float to a half-precision float, rounding to nearest
+ * even
+ */
+inline uint16_t float_to_half(float value) {
+    uint32_t x;
+    std::memcpy(&x, &value, sizeof(x));
+
+    const uint32_t sign = (x >> 16) & 0x8000;
+    const uint32_t abs  = x & 0x7FFFFFFF;
+
+    // NaN and infinity
+    if (abs >= 0x7F800000) {
+        return sign | 0x7C00 | (abs > 0x7F800000 ? 0x200 : 0);
+    }
+
+    // Overflow to infinity
+    if (abs >= 0x477FF000) {
+        return sign | 0x7C00;
+    }
+
+    // Subnormal halves (and zero)
+    if (abs < 0x38800000) {
+        if (abs < 0x33000000) {
+            return sign;
+        }
+
+        const uint32_t exponent = abs >> 23;
+        const uint32_t mantissa = (abs & 0x7FFFFF) | 0x800000;
+        const uint32_t shift    = 126 - exponent;
+
+        uint32_t half = mantissa >> shift;
+
+        const uint32_t rest = mantissa & ((1u << shift) - 1);
+        const uint32_t mid  = 1u << (shift - 1);
+
+        if (rest > mid || (rest == mid && (half & 1))) {
+            ++half;
+        }
+
+        return sign | half;
+    }
+
+    // Normal halves, the carry of the rounding can increase the exponent
+    uint32_t half = ((abs - 0x38000000) >> 13);
+
+    const uint32_t rest = abs & 0x1FFF;
+
+    if (rest > 0x1000 || (rest == 0x1000 && (half & 1))) {
+        ++half;
+    }
+
+    return sign | half;
+}
+
+/*!
+ * \brief Convert a half-precision float to a float
+ */
+inline float half_to_float(uint16_t half) {
+    const uint32_t sign     = uint32_t(half & 0x8000) << 16;
+    const uint32_t exponent = (half >> 10) & 0x1F;
+    const uint32_t mantissa = half & 0x3FF;
+
+    uint32_t x;
+
+    if (exponent == 0x1F) {
+        x = sign | 0x7F800000 | (mantissa << 13);
+    } else if (exponent) {
+        x = sign | ((exponent + 112) << 23) | (mantissa << 13);
+    } else if (mantissa) {
+        // Subnormal half, normalized as a float
+        uint32_t e = 113;
+        uint32_t m = mantissa;
+
+        while (!(m & 0x400)) {
+            m <<= 1;
+            --e;
+        }
+
+        x = sign | (e << 23) | ((m & 0x3FF) << 13);
+    } else {
+        x = sign;
+    }
+
+    float value;
+    std::memcpy(&value, &x, sizeof(value));
+    return value;
+}
+
+/*!
+ * \brief Convert a float to a bfloat16, rounding to nearest even
+ */
+inline uint16_t float_to_bf16(float value) {
+    uint32_t x;
+    std::memcpy(&x, &value, sizeof(x));
+
+    if ((x & 0x7FFFFFFF) > 0x7F800000) {
+        return (x >> 16) | 0x40;
+    }
+
+    x += 0x7FFF + ((x >> 16) & 1);
+
+    return x >> 16;
+}
+
+/*!
+ * \brief Convert a bfloat16 to a float
+ */
+inline float bf16_to_float(uint16_t bf16) {
+    const uint32_t x = uint32_t(bf16) << 16;
+
+    float value;
+    std::memcpy(&value, &x, sizeof(value));
+    return value;
+}
+
+/*!
+ * \brief Encode the given values
+ */
+template <typename T>
+std::string encode(const T* values, size_t n, model_encoding encoding) {
+    std::string encoded;
+
+    auto append = [&encoded](const auto& v) { encoded.append(reinterpret_cast<const char*>(&v), sizeof(v)); };
+
+    switch (encoding) {
+        case model_encoding::RAW:
+            encoded.assign(reinterpret_cast<const char*>(values), n * sizeof(T));
+            break;
+
+        case model_encoding::FP16:
+            encoded.reserve(n * sizeof(uint16_t));
+
+            for (size_t i = 0; i < n; ++i) {
+                append(float_to_half(float(values[i])));
+            }
+
+            break;
+
+        case model_encoding::BF16:
+            encoded.reserve(n * sizeof(uint16_t));
+
+            for (size_t i = 0; i < n; ++i) {
+                append(float_to_bf16(float(values[i])));
+            }
+
+            break;
+
+        case model_encoding::INT8:
+            // The scale of each block followed by its values
+            encoded.reserve(n + (n + compact_block - 1) / compact_block * sizeof(float));
+
+            for (size_t first = 0; first < n; first += compact_block) {
+                const size_t last = std::min(n, first + compact_block);
+
+                float max = 0;
+
+                for (size_t i = first; i < last; ++i) {
+                    max = std::max(max, float(std::abs(values[i])));
+                }
+
+                const float scale = max > 0 ? max / 127.0f : 1.0f;
+
+                append(scale);
+
+                for (size_t i = first; i < last; ++i) {
+                    append(int8_t(std::lround(std::max(-127.0f, std::min(127.0f, float(values[i]) / scale)))));
+                }
+            }
+
+            break;
+    }
+
+    return encoded;
+}
+
+/*!
+ * \brief Decode the given values
+ * \return true if the values were decoded, false otherwise
+ */
+template <typename T>
+bool decode(const char* encoded, size_t bytes, model_encoding encoding, T* values, size_t n) {
+    auto read = [&encoded](auto& v) {
+        std::memcpy(&v, encoded, sizeof(v));
+        encoded += sizeof(v);
+    };
+
+    switch (encoding) {
+        case model_encoding::RAW:
+            if (bytes != n * sizeof(T)) {
+                return false;
+            }
+
+            std::memcpy(values, encoded, bytes);
+            return true;
+
+        case model_encoding::FP16:
+        case model_encoding::BF16:
+            if (bytes != n * sizeof(uint16_t)) {
+                return false;
+            }
+
+            for (size_t i = 0; i < n; ++i) {
+                uint16_t v;
+                read(v);
+                values[i] = encoding == model_encoding::FP16 ? half_to_float(v) : bf16_to_float(v);
+            }
+
+            return true;
+
+        case model_encoding::INT8:
+            if (bytes != n + (n + compact_block - 1) / compact_block * sizeof(float)) {
+                return false;
+            }
+
+            for (size_t first = 0; first < n; first += compact_block) {
+                const size_t last = std::min(n, first + compact_block);
+
+                float scale;
+                read(scale);
+
+                for (size_t i = first; i < last; ++i) {
+                    int8_t v;
+                    read(v);
+                    values[i] = T(v * scale);
+                }
+            }
+
+            return true;
+    }
+
+    return false;
+}
+
+} //end of namespace compact_detail
+
+/*!
+ * \brief Indicates if the compact models can be compressed
+ */
+constexpr bool compact_compression_support() {
+#ifdef DLL_ZSTD_SUPPORT
+    return true;
+#else
+    return false;
+#endif
+}
+
+/*!
+ * \brief Encode a record of raw weights (as written by the store function
+ * of a layer) into a record of a compact model
+ *
+ * \param raw The raw weights
+ * \param encoding The encoding of the weights
+ * \param compress Indicates if the encoded weights are compressed
+ *
+ * \return The record of the compact model
+ */
+template <typename T>
+std::string encode_compact_record(const std::string& raw, model_encoding encoding, bool compress) {
+    const size_t n = raw.size() / sizeof(T);
+
+    std::vector<T> values(n);
+    std::memcpy(values.data(), raw.data(), n * sizeof(T));
+
+    auto encoded = compact_detail::encode(values.data(), n, encoding);
+
+    compact_record_header header;
+    std::memset(&header, 0, sizeof(header));
+
+    header.encoding = uint32_t(encoding);
+    header.values   = n;
+    header.encoded  = encoded.size();
+
+#ifdef DLL_ZSTD_SUPPORT
+    if (compress) {
+        std::string compressed(ZSTD_compressBound(encoded.size()), '\0');
+
+        const size_t length = ZSTD_compress(&compressed[0], compressed.size(), encoded.data(), encoded.size(), 3);
+
+        // Only keep the compressed values if they are smaller
+        if (!ZSTD_isError(length) && length < encoded.size()) {
+            compressed.resize(length);
+            encoded.swap(compressed);
+            header.compressed = 1;
+        }
+    }
+#else
+    cpp_unused(compress);
+#endif
+
+    header.stored = encoded.size();
+
+    std::string record(reinterpret_cast<const char*>(&header), sizeof(header));
+    record += encoded;
+
+    return record;
+}
+
+/*!
+ * \brief Decode a record of a compact model into raw weights (as read by
+ * the load function of a layer)
+ *
+ * \param record The first byte of the record
+ * \param length The number of bytes of the record
+ * \param raw The raw weights
+ *
+ * \return true if the record was decoded, false otherwise
+ */
+template <typename T>
+bool decode_compact_record(const char* record, size_t length, std::string& raw) {
+    compact_record_header header;
+
+    if (length < sizeof(header)) {
+        return false;
+    }
+
+    std::memcpy(&header, record, sizeof(header));
+
+    if (header.encoding > uint32_t(model_encoding::INT8) || sizeof(header) + header.stored != length) {
+        return false;
+    }
+
+    const char* encoded = record + sizeof(header);
+
+    std::string decompressed;
+
+    if (header.compressed) {
+#ifdef DLL_ZSTD_SUPPORT
+        decompressed.resize(header.encoded);
+
+        const size_t n = ZSTD_decompress(&decompressed[0], decompressed.size(), encoded, header.stored);
+
+        if (ZSTD_isError(n) || n != header.encoded) {
+            return false;
+        }
+
+        encoded = decompressed.data();
+#else
+        std::cerr << "ERROR: The compact model is compressed, DLL_ZSTD_SUPPORT is required" << std::endl;
+        return false;
+#endif
+    } else if (header.encoded != header.stored) {
+        return false;
+    }
+
+    raw.resize(header.values * sizeof(T));
+
+    std::vector<T> values(header.values);
+
+    if (!compact_detail::decode(encoded, header.encoded, model_encoding(header.encoding), values.data(), values.size())) {
+        return false;
+    }
+
+    std::memcpy(&raw[0], values.data(), raw.size());
+
+    return true;
+}
+
+} //end of dll namespace
@@ -0,0 +1,100 @@
+//=======================================================================
+// Copyright (c) 2014-2017 Baptiste Wicht
+// Distributed under the terms of the MIT License.
+// (See accompanying file LICENSE or copy at
+//  http://opensource.org/licenses/MIT)
+//=======================================================================
+
+/*!
+ * \file
+ * \brief Fused bias and activation epilogue of the convolutional layers
+ */
+
+#pragma once
+
+#include "cpp_utils/assert.hpp"
+
+#include "etl/etl.hpp"
+
+#include "dll/function.hpp"
+
+namespace dll {
+
+/*!
+ * \brief The epilogue of a convolution, adding the bias of the output
+ * channel and applying the activation function to a single value.
+ *
+ * \tparam F The activation function
+ * \tparam Bias Indicates if the biases are added
+ */
+template <function F, bool Bias, typename T>
+struct conv_epilogue_op {
+    const T* b = nullptr; ///< The biases
+
+    conv_epilogue_op() = default;
+
+    /*!
+     * \brief Construct the epilogue for the given biases
+     */
+    template <typename B>
+    explicit conv_epilogue_op(const B& biases) {
+        if constexpr (Bias) {
+            biases.ensure_cpu_up_to_date();
+            b = biases.memory_start();
+        } else {
+            cpp_unused(biases);
+        }
+    }
+
+    /*!
+     * \brief Compute the final value of an output of the given channel
+     * \param k The output channel
+     * \param x The result of the convolution
+     */
+    T operator()(size_t k, T x) const {
+        if constexpr (Bias) {
+            return f_activate_one<F>(x + b[k]);
+        } else {
+            cpp_unused(k);
+            return f_activate_one<F>(x);
+        }
+    }
+};
+
+/*!
+ * \brief Add the biases and apply the activation function to a batch of
+ * convolution outputs, in a single pass over the memory.
+ *
+ * \param output The batch of outputs [B, K, H, W]
+ * \param b The biases [K]
+ * \tparam F The activation function
+ * \tparam Bias Indicates if the biases are added
+ */
+template <function F, bool Bias, typename O, typename B>
+void conv_epilogue(O&& output, const B& b) {
+    using T = etl::value_t<std::decay_t<O>>;
+
+    const size_t N = etl::dim<0>(output) * etl::dim<1>(output);
+    const size_t K = etl::dim<1>(output);
+    const size_t S = etl::dim<2>(output) * etl::dim<3>(output);
+
+    conv_epilogue_op<F, Bias, T> op(b);
+
+    output.ensure_cpu_up_to_date();
+
+    T* out = output.memory_start();
+
+    for (size_t i = 0; i < N; ++i) {
+        const size_t k = i % K;
+
+        T* map = out + i * S;
+
+        for (size_t j = 0; j < S; ++j) {
+            map[j] = op(k, map[j]);
+        }
+    }
+
+    output.invalidate_gpu();
+}
+
+} //end of dll namespace
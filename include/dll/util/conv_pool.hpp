@@ -0,0 +1,167 @@
+//=======================================================================
+// Copyright (c) 2014-2017 Baptiste Wicht
+// Distributed under the terms of the MIT License.
+// (See accompanying file LICENSE or copy at
+//  http://opensource.org/licenses/MIT)
+//=======================================================================
+
+/*!
+ * \file
+ * \brief Fused convolution, activation and pooling of a convolutional
+ * layer followed by a pooling layer
+ *
+ * The batch is convolved by tiles of a few samples whose feature maps fit
+ * in cache, and each tile is pooled as soon as it is computed: the
+ * feature maps of the whole batch are never written to memory. In
+ * training, only the pooled output and the position of the max of each
+ * window are kept. Since the activation of the convolution is
+ * element-wise, its derivative at the position of the max only depends on
+ * the pooled output.
+ */
+
+#pragma once
+
+#include <algorithm>
+
+#include "etl/etl.hpp"
+
+#include "dll/layer_traits.hpp"
+#include "dll/function.hpp"
+#include "dll/util/max_pool_indices.hpp"
+#include "dll/util/timers.hpp" // for auto_timer
+
+namespace dll {
+
+namespace conv_pool_detail {
+
+constexpr size_t tile_values = 65536; ///< The maximum number of values of the feature maps of a tile
+
+/*!
+ * \brief Call the functor on each tile of the batch, with the feature maps
+ * of the tile and the range of its samples
+ */
+template <typename Conv, typename Functor>
+void for_each_tile(size_t n, Functor&& functor) {
+    using weight = typename Conv::weight;
+
+    constexpr size_t map = Conv::K * Conv::NH1 * Conv::NH2;
+
+    const size_t tile = std::max(size_t(1), std::min(n, tile_values / map));
+
+    etl::dyn_matrix<weight, 4> maps(tile, Conv::K, Conv::NH1, Conv::NH2);
+
+    for (size_t first = 0; first < n; first += tile) {
+        const size_t last = std::min(n, first + tile);
+
+        if (last - first == tile) {
+            functor(maps, first, last);
+        } else {
+            etl::dyn_matrix<weight, 4> partial(last - first, Conv::K, Conv::NH1, Conv::NH2);
+
+            functor(partial, first, last);
+        }
+    }
+}
+
+} //end of namespace conv_pool_detail
+
+/*!
+ * \brief Indicates if the convolutional layer Conv and the following
+ * pooling layer Pool can be fused for inference
+ */
+template <typename Conv, typename Pool>
+constexpr bool conv_pool_fusion() {
+    return decay_layer_traits<Conv>::has_pool_fusion() && decay_layer_traits<Pool>::has_conv_fusion();
+}
+
+/*!
+ * \brief Indicates if the convolutional layer Conv and the following
+ * pooling layer Pool can be fused for training
+ */
+template <typename Conv, typename Pool>
+constexpr bool conv_pool_train_fusion() {
+    return decay_layer_traits<Conv>::has_pool_fusion() && decay_layer_traits<Pool>::has_conv_train_fusion();
+}
+
+/*!
+ * \brief Compute the test representation of the pooling layer Pool
+ * following the given convolutional layer, without materializing the
+ * output of the convolution
+ *
+ * \param conv The convolutional layer
+ * \param output The output of the pooling layer
+ * \param input The input of the convolutional layer
+ */
+template <typename Pool, typename Conv, typename Output, typename Input>
+void conv_pool_forward(const Conv& conv, Output& output, const Input& input) {
+    dll::auto_timer timer("conv_pool:forward_batch");
+
+    conv_pool_detail::for_each_tile<Conv>(etl::dim<0>(input), [&](auto& maps, size_t first, size_t last) {
+        conv.test_forward_batch(maps, etl::slice(input, first, last));
+
+        auto pooled = etl::slice(output, first, last);
+
+        Pool::forward_batch(pooled, maps);
+    });
+}
+
+/*!
+ * \brief Compute the training representation of the max pooling layer
+ * Pool following the given convolutional layer, recording the position of
+ * the max of each window in the context of the pooling layer. The output
+ * of the convolution is not materialized.
+ *
+ * \param conv The convolutional layer
+ * \param input The input of the convolutional layer
+ * \param context The training context of the pooling layer
+ */
+template <typename Pool, typename Conv, typename Input, typename Context>
+void conv_pool_train_forward(const Conv& conv, const Input& input, Context& context) {
+    dll::auto_timer timer("conv_pool:forward_batch");
+
+    const size_t O = Pool::O1 * Pool::O2 * Pool::O3;
+
+    context.indices.resize(etl::size(context.output));
+
+    conv_pool_detail::for_each_tile<Conv>(etl::dim<0>(input), [&](auto& maps, size_t first, size_t last) {
+        conv.forward_batch(maps, etl::slice(input, first, last));
+
+        maps.ensure_cpu_up_to_date();
+
+        max_pool_2d_forward_indices(maps.memory_start(), context.output.memory_start() + first * O, context.indices.data() + first * O,
+                                    (last - first) * Pool::I1, Pool::I2, Pool::I3, Pool::C1, Pool::C2, Pool::S1, Pool::S2, Pool::P1, Pool::P2);
+    });
+
+    context.output.invalidate_gpu();
+}
+
+/*!
+ * \brief Backpropagate the errors of the max pooling layer Pool through
+ * the activation of the previous convolutional layer Conv.
+ *
+ * The errors are multiplied by the derivative of the activation, taken
+ * from the pooled output, and scattered to the positions of the max. The
+ * errors of the convolutional layer must not be adapted again.
+ *
+ * \param errors The errors of the convolutional layer
+ * \param context The training context of the pooling layer
+ */
+template <typename Conv, typename Pool, typename Errors, typename Context>
+void conv_pool_backward(Errors&& errors, Context& context) {
+    dll::auto_timer timer("conv_pool:backward_batch");
+
+    constexpr auto F = Conv::activation_function;
+
+    if constexpr (F != function::IDENTITY) {
+        context.errors = f_derivative<F>(context.output) >> context.errors;
+    }
+
+    context.errors.ensure_cpu_up_to_date();
+
+    max_pool_2d_backward_indices(context.errors.memory_start(), context.indices.data(), errors.memory_start(),
+                                 etl::dim<0>(context.errors) * Pool::I1, Pool::I2, Pool::I3, Pool::C1, Pool::C2, Pool::S1, Pool::S2, Pool::P1, Pool::P2);
+
+    errors.invalidate_gpu();
+}
+
+} //end of dll namespace
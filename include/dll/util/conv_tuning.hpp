@@ -0,0 +1,188 @@
+//=======================================================================
+// Copyright (c) 2014-2017 Baptiste Wicht
+// Distributed under the terms of the MIT License.
+// (See accompanying file LICENSE or copy at
+//  http://opensource.org/licenses/MIT)
+//=======================================================================
+
+/*!
+ * \file
+ * \brief Selection of the implementation of the convolutions of each layer
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace dll {
+
+/*!
+ * \brief An implementation of a convolution
+ */
+enum class conv_impl {
+    AUTO,     ///< The default selection of the layer
+    ETL,      ///< The generic ETL convolution
+    WINOGRAD, ///< The Winograd F(2x2, 3x3) convolution
+    GEMM      ///< The GEMM formulation of the transposed convolution
+};
+
+/*!
+ * \brief Returns a string representation of the given implementation
+ */
+inline std::string to_string(conv_impl impl) {
+    switch (impl) {
+        case conv_impl::ETL:
+            return "ETL";
+        case conv_impl::WINOGRAD:
+            return "WINOGRAD";
+        case conv_impl::GEMM:
+            return "GEMM";
+        case conv_impl::AUTO:
+        default:
+            return "AUTO";
+    }
+}
+
+/*!
+ * \brief Returns the implementation with the given name (AUTO if the name is unknown)
+ */
+inline conv_impl parse_conv_impl(const std::string& name) {
+    for (auto impl : {conv_impl::ETL, conv_impl::WINOGRAD, conv_impl::GEMM}) {
+        if (name == to_string(impl)) {
+            return impl;
+        }
+    }
+
+    return conv_impl::AUTO;
+}
+
+/*!
+ * \brief The implementations selected for the three convolutions of a layer
+ */
+struct conv_tuning {
+    conv_impl forward   = conv_impl::AUTO; ///< The implementation of the forward pass
+    conv_impl backward  = conv_impl::AUTO; ///< The implementation of the backpropagation of the errors
+    conv_impl gradients = conv_impl::AUTO; ///< The implementation of the gradients of the filters
+};
+
+/*!
+ * \brief A cache of the implementations selected for each layer shape.
+ *
+ * The cache is stored in a text file, one layer shape per line, with the
+ * key and the three implementations separated with tabulations.
+ */
+struct conv_tuning_cache {
+    std::map<std::string, conv_tuning> entries; ///< The tuning of each layer shape
+
+    /*!
+     * \brief Load the entries of the given file
+     * \return true if the file was loaded, false otherwise
+     */
+    bool load(const std::string& file) {
+        std::ifstream stream(file);
+
+        if (!stream) {
+            return false;
+        }
+
+        std::string line;
+        while (std::getline(stream, line)) {
+            std::vector<std::string> fields;
+            std::stringstream line_stream(line);
+            std::string field;
+
+            while (std::getline(line_stream, field, '\t')) {
+                fields.push_back(field);
+            }
+
+            if (fields.size() != 4) {
+                continue;
+            }
+
+            auto& tuning     = entries[fields[0]];
+            tuning.forward   = parse_conv_impl(fields[1]);
+            tuning.backward  = parse_conv_impl(fields[2]);
+            tuning.gradients = parse_conv_impl(fields[3]);
+        }
+
+        return true;
+    }
+
+    /*!
+     * \brief Save the entries to the given file
+     * \return true if the file was saved, false otherwise
+     */
+    bool save(const std::string& file) const {
+        std::ofstream stream(file);
+
+        if (!stream) {
+            std::cerr << "ERROR: Impossible to write the tuning cache " << file << std::endl;
+            return false;
+        }
+
+        for (auto& [key, tuning] : entries) {
+            stream << key << '\t' << to_string(tuning.forward) << '\t' << to_string(tuning.backward) << '\t' << to_string(tuning.gradients) << '\n';
+        }
+
+        return static_cast<bool>(stream);
+    }
+
+    /*!
+     * \brief Indicates if the cache contains the given layer shape
+     */
+    bool contains(const std::string& key) const {
+        return entries.count(key);
+    }
+};
+
+/*!
+ * \brief Returns the fastest of the given implementations.
+ *
+ * Each implementation is run once without being measured and then the
+ * best of repeat runs is kept.
+ *
+ * \param impls The candidate implementations
+ * \param repeat The number of measured runs of each implementation
+ * \param functor The functor running the convolution with the given implementation
+ */
+template <typename Functor>
+conv_impl fastest_conv_impl(const std::vector<conv_impl>& impls, size_t repeat, Functor&& functor) {
+    conv_impl best   = impls.front();
+    double best_time = std::numeric_limits<double>::max();
+
+    // Nothing to select
+    if (impls.size() == 1) {
+        return best;
+    }
+
+    for (auto impl : impls) {
+        functor(impl);
+
+        double time = std::numeric_limits<double>::max();
+
+        for (size_t i = 0; i < repeat; ++i) {
+            auto start = std::chrono::steady_clock::now();
+            functor(impl);
+            auto end = std::chrono::steady_clock::now();
+
+            time = std::min(time, std::chrono::duration<double, std::nano>(end - start).count());
+        }
+
+        if (time < best_time) {
+            best      = impl;
+            best_time = time;
+        }
+    }
+
+    return best;
+}
+
+} //end of dll namespace
@@ -7,12 +7,17 @@
 
 #pragma once
 
+#include "cpp_utils/assert.hpp"
 #include "cpp_utils/tmp.hpp"
 
+#include <algorithm>
+#include <iterator>
 #include <list>
 #include <vector>
 #include <deque>
 
+#include "dll/util/scheduler.hpp"
+
 namespace dll {
 
 #define debug_convert(X) etl::inc_counter(X)
@@ -466,4 +471,114 @@ struct converter_many <Container<From>, Container<To>> {
     }
 };
 
+/*!
+ * \brief Traits to test if a type is a standard container of values
+ * (std::vector<float>, std::deque<double>, ...) used as a 1D sample
+ */
+template <typename T, typename Enable = void>
+struct is_std_sample_impl : std::false_type {};
+
+/*!
+ * \copydoc is_std_sample_impl
+ */
+template <typename T>
+struct is_std_sample_impl<T, std::void_t<typename T::value_type, decltype(std::declval<const T&>().size())>>
+        : std::bool_constant<!etl::is_etl_expr<T> && std::is_arithmetic<typename T::value_type>::value> {};
+
+/*!
+ * \brief Indicates if the given type is a standard container of values
+ */
+template <typename T>
+constexpr bool is_std_sample = is_std_sample_impl<T>::value;
+
+/*!
+ * \brief Helper to get the value type of a sample, either an ETL
+ * expression or a standard container of values
+ */
+template <typename T, typename Enable = void>
+struct sample_value {
+    using type = etl::value_t<T>; ///< The value type
+};
+
+/*!
+ * \copydoc sample_value
+ */
+template <typename T>
+struct sample_value<T, std::enable_if_t<is_std_sample<T>>> {
+    using type = typename T::value_type; ///< The value type
+};
+
+/*!
+ * \brief Helper to get the value type of a sample
+ */
+template <typename T>
+using sample_value_t = typename sample_value<T>::type;
+
+/*!
+ * \brief Converter of a whole range of samples into one contiguous tensor.
+ *
+ * Instead of converting the samples one by one into temporaries, the
+ * samples are copied directly into the rows of a preallocated 2D ETL
+ * matrix. With random access iterators, the copy is split between the
+ * threads of the scheduler.
+ */
+struct converter_bulk {
+    static constexpr size_t grain = 1024; ///< The minimum number of samples copied by one task
+
+    /*!
+     * \brief Allocate the tensor for the given range of samples
+     * \param first Iterator to the first sample
+     * \param last Iterator to the last sample
+     * \param to The 2D matrix to allocate
+     */
+    template <typename Iterator, typename To>
+    static void init(Iterator first, Iterator last, To& to) {
+        auto& one = *first;
+        to        = To(std::distance(first, last), one.size());
+    }
+
+    /*!
+     * \brief Convert the given range of samples into the rows of the
+     * given preallocated matrix
+     * \param first Iterator to the first sample
+     * \param last Iterator to the last sample
+     * \param to The 2D matrix to fill, with one row per sample
+     */
+    template <typename Iterator, typename To>
+    static void convert(Iterator first, Iterator last, To& to) {
+        debug_convert("converter::bulk");
+
+        using value_type = etl::value_t<To>;
+
+        const size_t n     = std::distance(first, last);
+        const size_t width = etl::dim<1>(to);
+
+        cpp_assert(etl::dim<0>(to) >= n, "The tensor is too small for the samples");
+
+        auto* out = to.memory_start();
+
+        auto copy = [=](size_t begin, size_t end) {
+            auto it = std::next(first, begin);
+
+            for (size_t i = begin; i < end; ++i, ++it) {
+                auto& sample = *it;
+
+                cpp_assert(sample.size() == width, "All the samples must have the same size");
+
+                std::transform(sample.begin(), sample.end(), out + i * width, [](auto v) { return static_cast<value_type>(v); });
+            }
+        };
+
+        constexpr bool random = std::is_base_of<std::random_access_iterator_tag, typename std::iterator_traits<Iterator>::iterator_category>::value;
+
+        if constexpr (random) {
+            dll::scheduler().parallel_ranges(n, grain, copy);
+        } else {
+            copy(0, n);
+        }
+
+        to.invalidate_gpu();
+    }
+};
+
 } //end of dll namespace
@@ -0,0 +1,204 @@
+//=======================================================================
+// Copyright (c) 2014-2017 Baptiste Wicht
+// Distributed under the terms of the MIT License.
+// (See accompanying file LICENSE or copy at
+//  http://opensource.org/licenses/MIT)
+//=======================================================================
+
+/*!
+ * \file
+ * \brief GEMM-based (col2im / im2col) kernels of the deconvolutional layers
+ */
+
+#pragma once
+
+#include "cpp_utils/assert.hpp"
+
+#include "etl/etl.hpp"
+
+#include "dll/util/conv_epilogue.hpp"
+
+namespace dll {
+
+/*!
+ * \brief Deconvolution of batches of images as matrix products.
+ *
+ * The forward pass (full convolution with flipped filters) is a transposed
+ * GEMM of the filters with each image, giving the columns of the patches
+ * of the output, that are then accumulated (col2im) in the output. The
+ * backward pass (valid convolution with flipped filters) extracts the
+ * patches of the errors (im2col) and multiplies them with the filters.
+ *
+ * The filters [C, K, NW1, NW2] are seen as a [C, K * NW1 * NW2] matrix.
+ * The forward pass needs its transpose, computed once with
+ * transpose_filters, so that the layers can cache it between the batches.
+ */
+template <typename T>
+struct deconv_gemm {
+    /*!
+     * \brief Transpose the filters for the forward pass
+     * \param w The filters [C, K, NW1, NW2]
+     * \param w_t The transposed filters [K * NW1 * NW2, C]
+     */
+    template <typename W, typename WT>
+    static void transpose_filters(const W& w, WT& w_t) {
+        const size_t C = etl::dim<0>(w);
+        const size_t P = etl::size(w) / C;
+
+        cpp_assert(etl::dim<0>(w_t) == P && etl::dim<1>(w_t) == C, "Invalid dimensions for the transposed filters");
+
+        w.ensure_cpu_up_to_date();
+
+        const T* w_ptr = w.memory_start();
+        T* t_ptr       = w_t.memory_start();
+
+        for (size_t c = 0; c < C; ++c) {
+            for (size_t p = 0; p < P; ++p) {
+                t_ptr[p * C + c] = w_ptr[c * P + p];
+            }
+        }
+
+        w_t.invalidate_gpu();
+    }
+
+    /*!
+     * \brief Compute the full convolution of the input with the flipped
+     * filters.
+     *
+     * \param input The batch of input [B, C, H, W]
+     * \param w_t The transposed filters [K * NW1 * NW2, C]
+     * \param output The batch of output [B, K, H + NW1 - 1, W + NW2 - 1]
+     * \param epilogue The operation applied to each output value once it is complete
+     */
+    template <typename In, typename WT, typename Out, typename E = conv_epilogue_op<function::IDENTITY, false, T>>
+    static void forward(const In& input, const WT& w_t, Out&& output, E epilogue = E()) {
+        const size_t B   = etl::dim<0>(input);
+        const size_t C   = etl::dim<1>(input);
+        const size_t H   = etl::dim<2>(input);
+        const size_t W   = etl::dim<3>(input);
+        const size_t K   = etl::dim<1>(output);
+        const size_t OH  = etl::dim<2>(output);
+        const size_t OW  = etl::dim<3>(output);
+        const size_t NW1 = OH - H + 1;
+        const size_t NW2 = OW - W + 1;
+
+        cpp_assert(etl::dim<0>(w_t) == K * NW1 * NW2 && etl::dim<1>(w_t) == C, "Invalid dimensions for deconv_gemm");
+
+        etl::dyn_matrix<T, 2> image(C, H * W);
+        etl::dyn_matrix<T, 2> cols(K * NW1 * NW2, H * W);
+
+        input.ensure_cpu_up_to_date();
+
+        const T* in_ptr = input.memory_start();
+        T* out_ptr      = output.memory_start();
+
+        for (size_t b = 0; b < B; ++b) {
+            // 1. Columns of the patches of the output
+
+            std::copy_n(in_ptr + b * C * H * W, C * H * W, image.memory_start());
+            image.invalidate_gpu();
+
+            cols = w_t * image;
+
+            cols.ensure_cpu_up_to_date();
+
+            // 2. Accumulate the patches in the output (col2im)
+
+            const T* c_ptr = cols.memory_start();
+            T* out_b       = out_ptr + b * K * OH * OW;
+
+            std::fill_n(out_b, K * OH * OW, T(0));
+
+            for (size_t k = 0; k < K; ++k) {
+                T* map = out_b + k * OH * OW;
+
+                for (size_t p = 0; p < NW1; ++p) {
+                    for (size_t q = 0; q < NW2; ++q) {
+                        const T* col = c_ptr + ((k * NW1 + p) * NW2 + q) * H * W;
+
+                        for (size_t i = 0; i < H; ++i) {
+                            T* row = map + (i + NW1 - 1 - p) * OW + (NW2 - 1 - q);
+
+                            for (size_t j = 0; j < W; ++j) {
+                                row[j] += col[i * W + j];
+                            }
+                        }
+                    }
+                }
+
+                // 3. The output of the channel is complete
+
+                for (size_t j = 0; j < OH * OW; ++j) {
+                    map[j] = epilogue(k, map[j]);
+                }
+            }
+        }
+
+        output.invalidate_gpu();
+    }
+
+    /*!
+     * \brief Compute the valid convolution of the errors with the flipped
+     * filters.
+     *
+     * \param errors The batch of errors [B, K, OH, OW]
+     * \param w The filters [C, K, NW1, NW2]
+     * \param output The batch of output [B, C, OH - NW1 + 1, OW - NW2 + 1], of any shape
+     */
+    template <typename E, typename W, typename Out>
+    static void backward(const E& errors, const W& w, Out&& output) {
+        const size_t B   = etl::dim<0>(errors);
+        const size_t K   = etl::dim<1>(errors);
+        const size_t OH  = etl::dim<2>(errors);
+        const size_t OW  = etl::dim<3>(errors);
+        const size_t C   = etl::dim<0>(w);
+        const size_t NW1 = etl::dim<2>(w);
+        const size_t NW2 = etl::dim<3>(w);
+        const size_t H   = OH - NW1 + 1;
+        const size_t Wd  = OW - NW2 + 1;
+
+        cpp_assert(etl::size(output) == B * C * H * Wd, "Invalid output size for deconv_gemm");
+
+        etl::dyn_matrix<T, 2> cols(K * NW1 * NW2, H * Wd);
+        etl::dyn_matrix<T, 2> image(C, H * Wd);
+
+        errors.ensure_cpu_up_to_date();
+
+        const T* e_ptr = errors.memory_start();
+        T* out_ptr     = output.memory_start();
+
+        for (size_t b = 0; b < B; ++b) {
+            // 1. Patches of the errors (im2col)
+
+            T* c_ptr = cols.memory_start();
+
+            for (size_t k = 0; k < K; ++k) {
+                const T* map = e_ptr + (b * K + k) * OH * OW;
+
+                for (size_t p = 0; p < NW1; ++p) {
+                    for (size_t q = 0; q < NW2; ++q) {
+                        T* col = c_ptr + ((k * NW1 + p) * NW2 + q) * H * Wd;
+
+                        for (size_t i = 0; i < H; ++i) {
+                            std::copy_n(map + (i + p) * OW + q, Wd, col + i * Wd);
+                        }
+                    }
+                }
+            }
+
+            cols.invalidate_gpu();
+
+            // 2. Product with the filters
+
+            image = etl::reshape(w, C, K * NW1 * NW2) * cols;
+
+            image.ensure_cpu_up_to_date();
+
+            std::copy_n(image.memory_start(), C * H * Wd, out_ptr + b * C * H * Wd);
+        }
+
+        output.invalidate_gpu();
+    }
+};
+
+} //end of dll namespace
@@ -0,0 +1,99 @@
+//=======================================================================
+// Copyright (c) 2014-2017 Baptiste Wicht
+// Distributed under the terms of the MIT License.
+// (See accompanying file LICENSE or copy at
+//  http://opensource.org/licenses/MIT)
+//=======================================================================
+
+/*!
+ * \file
+ * \brief Combined backward pass of the dense layers
+ */
+
+#pragma once
+
+#include <algorithm>
+
+#include "cpp_utils/assert.hpp"
+
+#include "etl/etl.hpp"
+
+namespace dll {
+
+/*!
+ * \brief The backward pass of a dense layer, computing the errors of the
+ * inputs, the gradients of the weights and the gradients of the biases in
+ * one sweep over the errors.
+ *
+ * The batch is processed by blocks of samples small enough for the block
+ * of errors and the block of inputs to remain in cache during the three
+ * products.
+ */
+template <typename T>
+struct dense_backward {
+    using matrix_t = etl::custom_dyn_matrix<T, 2>; ///< The type of a view of a matrix
+
+    static constexpr size_t block_bytes = 256 * 1024; ///< The size of the blocks of inputs and errors
+
+    /*!
+     * \brief Compute the backward pass of a batch
+     *
+     * \param in The batch of inputs [B, V]
+     * \param e The batch of errors [B, H]
+     * \param w The weights [V, H]
+     * \param out The errors of the inputs [B, V], nullptr to skip them
+     * \param w_grad The gradients of the weights [V, H]
+     * \param b_grad The gradients of the biases [H], nullptr to skip them
+     * \param B The number of samples
+     * \param V The number of inputs
+     * \param H The number of outputs
+     */
+    static void backward(const T* in, const T* e, const T* w, T* out, T* w_grad, T* b_grad, size_t B, size_t V, size_t H) {
+        cpp_assert(in && e && w && w_grad, "Invalid pointers for dense_backward");
+
+        const size_t rows = block_rows(V, H);
+
+        matrix_t w_m(const_cast<T*>(w), V, H);
+        matrix_t w_grad_m(w_grad, V, H);
+
+        w_grad_m = T(0);
+
+        if (b_grad) {
+            std::fill_n(b_grad, H, T(0));
+        }
+
+        for (size_t first = 0; first < B; first += rows) {
+            const size_t n = std::min(rows, B - first);
+
+            const T* e_b = e + first * H;
+
+            matrix_t e_m(const_cast<T*>(e_b), n, H);
+
+            if (out) {
+                matrix_t out_m(out + first * V, n, V);
+
+                out_m = e_m * etl::transpose(w_m);
+            }
+
+            w_grad_m += etl::transpose(matrix_t(const_cast<T*>(in + first * V), n, V)) * e_m;
+
+            if (b_grad) {
+                for (size_t i = 0; i < n; ++i) {
+                    for (size_t j = 0; j < H; ++j) {
+                        b_grad[j] += e_b[i * H + j];
+                    }
+                }
+            }
+        }
+    }
+
+private:
+    /*!
+     * \brief Returns the number of samples of each block
+     */
+    static size_t block_rows(size_t V, size_t H) {
+        return std::max<size_t>(8, block_bytes / ((V + H) * sizeof(T)));
+    }
+};
+
+} //end of dll namespace
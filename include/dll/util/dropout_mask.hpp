@@ -0,0 +1,135 @@
+//=======================================================================
+// Copyright (c) 2014-2017 Baptiste Wicht
+// Distributed under the terms of the MIT License.
+// (See accompanying file LICENSE or copy at
+//  http://opensource.org/licenses/MIT)
+//=======================================================================
+
+/*!
+ * \file
+ * \brief Inverted dropout masks regenerated from a counter-based generator
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+
+#include "etl/etl.hpp"
+
+#include "dll/util/random.hpp"
+
+namespace dll {
+
+/*!
+ * \brief An inverted dropout mask.
+ *
+ * The mask is never stored: the bit of each element only depends on the
+ * key of the mask and on the index of the element and the bits are
+ * generated 32 at a time, as packed words. The same mask can therefore be
+ * applied again in the backward pass, as long as the key is not changed.
+ *
+ * The keys of the successive masks are derived from the DLL random seed,
+ * the stream of the mask and the number of masks already drawn, so that
+ * the masks do not depend on the other consumers of random numbers.
+ */
+struct dropout_mask {
+    static constexpr size_t bits = 32; ///< The number of elements of a packed word
+
+    uint64_t key       = 0;             ///< The key of the current mask
+    uint64_t threshold = 0;             ///< The elements whose random number is lower than the threshold are dropped
+    float scale        = 1;             ///< The scale of the kept elements
+    uint64_t stream    = next_stream(); ///< The stream of the masks
+    uint64_t draws     = 0;             ///< The number of masks drawn
+
+    dropout_mask() = default;
+
+    /*!
+     * \brief Construct a new dropout_mask
+     * \param p The dropout probability
+     */
+    explicit dropout_mask(float p)
+            : threshold(uint64_t(double(p) * 4294967296.0)), scale(p < 1.0f ? 1.0f / (1.0f - p) : 0.0f) {
+        // Nothing else to init
+    }
+
+    /*!
+     * \brief Draw a new mask
+     */
+    void next() {
+        key = random_key(stream, draws++);
+    }
+
+    /*!
+     * \brief Returns the packed bits (one if kept) of the elements
+     * [w * 32, (w + 1) * 32)
+     * \param w The index of the word
+     */
+    uint32_t word(size_t w) const {
+        uint32_t m = 0;
+
+        for (size_t i = 0; i < bits; ++i) {
+            m |= uint32_t(counter_random(key, w * bits + i) >= threshold) << i;
+        }
+
+        return m;
+    }
+
+    /*!
+     * \brief Apply the mask and the scale to the input, in one pass.
+     *
+     * The output can be the input itself.
+     *
+     * \param output The output
+     * \param input The input
+     */
+    template <typename Output, typename Input>
+    void apply(Output&& output, const Input& input) const {
+        if constexpr (etl::all_dma<Output, Input>) {
+            using T = etl::value_t<Output>;
+
+            const size_t n = etl::size(output);
+
+            input.ensure_cpu_up_to_date();
+
+            const auto* in = input.memory_start();
+            T* out         = output.memory_start();
+
+            const T s = scale;
+
+            for (size_t w = 0; w * bits < n; ++w) {
+                const uint32_t m = word(w);
+
+                const size_t first = w * bits;
+                const size_t last  = std::min(n, first + bits);
+
+                for (size_t i = first; i < last; ++i) {
+                    out[i] = ((m >> (i - first)) & 1) ? s * in[i] : T(0);
+                }
+            }
+
+            output.invalidate_gpu();
+        } else if constexpr (etl::all_dma<Output>) {
+            output = input;
+            apply(output, output);
+        } else {
+            auto tmp = etl::force_temporary(input);
+            apply(tmp, tmp);
+            output = tmp;
+        }
+    }
+
+private:
+    /*!
+     * \brief Returns the stream of a new mask.
+     *
+     * The masks are numbered in their order of construction.
+     */
+    static uint64_t next_stream() {
+        static std::atomic<uint64_t> streams(0);
+
+        return streams++;
+    }
+};
+
+} //end of dll namespace
@@ -0,0 +1,152 @@
+//=======================================================================
+// Copyright (c) 2014-2017 Baptiste Wicht
+// Distributed under the terms of the MIT License.
+// (See accompanying file LICENSE or copy at
+//  http://opensource.org/licenses/MIT)
+//=======================================================================
+
+/*!
+ * \file
+ * \brief Batched gather of the rows of an embedding (embedding layers)
+ *
+ * The words of the batch are sorted so that each row of the embedding is
+ * read only once from memory, in increasing order, the next rows being
+ * prefetched while the current one is copied. The duplicates of a word
+ * are copied from its first output, already in cache.
+ */
+
+#pragma once
+
+#include <vector>
+#include <utility>
+#include <algorithm>
+
+#include "cpp_utils/assert.hpp"
+
+#include "etl/etl.hpp"
+
+#include "dll/util/scheduler.hpp"
+
+namespace dll {
+
+namespace embedding_detail {
+
+constexpr size_t prefetch_distance = 4;     ///< The number of rows prefetched ahead of the copies
+constexpr size_t parallel_values   = 16384; ///< The minimum number of values copied by a thread
+
+/*!
+ * \brief Prefetch a row of the embedding in cache
+ */
+template <typename T>
+inline void prefetch_row(const T* row, size_t K) {
+#if defined(__GNUC__) || defined(__clang__)
+    // One prefetch per cache line
+    for (size_t k = 0; k < K; k += 64 / sizeof(T)) {
+        __builtin_prefetch(row + k, 0, 1);
+    }
+#else
+    cpp_unused(row);
+    cpp_unused(K);
+#endif
+}
+
+} //end of namespace embedding_detail
+
+/*!
+ * \brief Gather the embeddings of a batch of words, reading each distinct
+ * row of the embedding only once.
+ *
+ * \param output The batch of embeddings [B, I, K]
+ * \param input The batch of input words [B, I]
+ * \param w The embedding [V, K]
+ */
+template <typename O, typename In, typename W>
+void embedding_gather(O&& output, const In& input, const W& w) {
+    using T = etl::value_t<W>;
+
+    const size_t N = etl::size(input);
+    const size_t K = etl::dim<1>(w);
+
+    cpp_assert(etl::size(output) == N * K, "Invalid output for the embedding");
+
+    input.ensure_cpu_up_to_date();
+    w.ensure_cpu_up_to_date();
+
+    const auto* in = input.memory_start();
+    const T* ws    = w.memory_start();
+    T* out         = output.memory_start();
+
+    // The positions of the batch, sorted by word
+    std::vector<std::pair<size_t, size_t>> words(N);
+
+    for (size_t p = 0; p < N; ++p) {
+        words[p] = {size_t(in[p]), p};
+
+        cpp_assert(words[p].first < etl::dim<0>(w), "Invalid word for the embedding");
+    }
+
+    std::sort(words.begin(), words.end());
+
+    // The first position of each distinct word
+    std::vector<size_t> groups;
+    groups.reserve(N + 1);
+
+    for (size_t p = 0; p < N; ++p) {
+        if (!p || words[p].first != words[p - 1].first) {
+            groups.push_back(p);
+        }
+    }
+
+    const size_t G = groups.size();
+
+    groups.push_back(N);
+
+    auto gather = [&](size_t first, size_t last) {
+        for (size_t g = first; g < last; ++g) {
+            if (g + embedding_detail::prefetch_distance < last) {
+                embedding_detail::prefetch_row(ws + words[groups[g + embedding_detail::prefetch_distance]].first * K, K);
+            }
+
+            const T* row = ws + words[groups[g]].first * K;
+            T* target    = out + words[groups[g]].second * K;
+
+            std::copy_n(row, K, target);
+
+            // The duplicates are copied from the first output, in cache
+            for (size_t p = groups[g] + 1; p < groups[g + 1]; ++p) {
+                std::copy_n(target, K, out + words[p].second * K);
+            }
+        }
+    };
+
+    if (N * K >= 2 * embedding_detail::parallel_values) {
+        dll::scheduler().parallel_ranges(G, std::max(size_t(1), embedding_detail::parallel_values / K), gather);
+    } else {
+        gather(0, G);
+    }
+
+    output.invalidate_gpu();
+}
+
+/*!
+ * \brief Compute the embeddings of a batch of words, with a batched gather
+ * when the memory of the output and of the embedding is directly
+ * accessible.
+ *
+ * \param output The batch of embeddings [B, I, K]
+ * \param input The batch of input words [B, I]
+ * \param w The embedding [V, K]
+ */
+template <typename O, typename In, typename W>
+void batch_embedding_gather(O&& output, const In& input, const W& w) {
+    if constexpr (etl::all_dma<std::decay_t<O>, In, W>) {
+        if (etl::size(output) == etl::size(input) * etl::dim<1>(w)) {
+            embedding_gather(output, input, w);
+            return;
+        }
+    }
+
+    output = batch_embedding_lookup(input, w);
+}
+
+} //end of dll namespace
@@ -0,0 +1,138 @@
+//=======================================================================
+// Copyright (c) 2014-2017 Baptiste Wicht
+// Distributed under the terms of the MIT License.
+// (See accompanying file LICENSE or copy at
+//  http://opensource.org/licenses/MIT)
+//=======================================================================
+
+/*!
+ * \file
+ * \brief Sampling of the counters of ETL (allocations, temporaries,
+ * transfers between CPU and GPU and evaluations)
+ *
+ * The counters are only maintained by ETL when ETL_COUNTERS is defined
+ * before including ETL. They are global to the process: the counters of a
+ * scope also include the operations of the other threads running at the
+ * same time.
+ *
+ * The counters of ETL are named, each of them is accumulated in the kind
+ * given by its name.
+ */
+
+#pragma once
+
+#include <array>
+#include <cstring>
+#include <iostream>
+#include <tuple>
+
+#include "etl/etl.hpp"
+
+namespace dll {
+
+/*!
+ * \brief The kinds of counters of ETL
+ */
+enum etl_counter : size_t {
+    ETL_ALLOCATIONS = 0, ///< The number of allocations (CPU and GPU)
+    ETL_TEMPORARIES = 1, ///< The number of temporaries created by the expressions
+    ETL_SYNCS       = 2, ///< The number of copies between CPU and GPU
+    ETL_EVALUATIONS = 3  ///< The number of evaluated expressions
+};
+
+constexpr size_t etl_counter_kinds = 4; ///< The number of kinds of counters
+
+using etl_values = std::array<size_t, etl_counter_kinds>; ///< The values of the counters
+
+/*!
+ * \brief Returns the kind of the ETL counter of the given name, or
+ * etl_counter_kinds if it is not collected
+ */
+inline size_t etl_counter_kind(const char* name) {
+    auto contains = [name](const char* part) { return std::strstr(name, part) != nullptr; };
+
+    if (contains("cpu_to_gpu") || contains("gpu_to_cpu")) {
+        return ETL_SYNCS;
+    } else if (contains("temp")) {
+        return ETL_TEMPORARIES;
+    } else if (contains("alloc")) {
+        return ETL_ALLOCATIONS;
+    } else if (contains("eval")) {
+        return ETL_EVALUATIONS;
+    }
+
+    return etl_counter_kinds;
+}
+
+#ifdef ETL_COUNTERS
+
+/*!
+ * \brief Indicates if the counters of ETL are maintained
+ */
+constexpr bool etl_counters_enabled() {
+    return true;
+}
+
+/*!
+ * \brief Read the counters of ETL, accumulated by kind
+ * \param values The values to fill
+ */
+inline void read_etl_counters(etl_values& values) {
+    values.fill(0);
+
+    decltype(auto) counters = etl::get_counters();
+
+    // The kind of each slot, computed once its name is known
+    static thread_local std::array<size_t, std::tuple_size<decltype(counters.counters)>::value> kinds{};
+    static thread_local std::array<const char*, std::tuple_size<decltype(counters.counters)>::value> names{};
+
+    for (size_t i = 0; i < counters.counters.size(); ++i) {
+        auto& counter = counters.counters[i];
+
+        const char* name = counter.name;
+
+        if (!name) {
+            break;
+        }
+
+        if (names[i] != name) {
+            kinds[i] = etl_counter_kind(name);
+            names[i] = name;
+        }
+
+        if (kinds[i] < etl_counter_kinds) {
+            values[kinds[i]] += counter.count.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+#else
+
+/*!
+ * \brief Indicates if the counters of ETL are maintained
+ */
+constexpr bool etl_counters_enabled() {
+    return false;
+}
+
+/*!
+ * \brief Read the counters of ETL, accumulated by kind
+ * \param values The values to fill
+ */
+inline void read_etl_counters(etl_values& values) {
+    values.fill(0);
+}
+
+#endif
+
+/*!
+ * \brief Print the given values of the counters of ETL
+ */
+inline void dump_etl_values(std::ostream& os, const etl_values& values) {
+    os << "etl: " << values[ETL_ALLOCATIONS] << " allocations, "
+       << values[ETL_TEMPORARIES] << " temporaries, "
+       << values[ETL_SYNCS] << " CPU/GPU copies, "
+       << values[ETL_EVALUATIONS] << " evaluations" << std::endl;
+}
+
+} //end of dll namespace
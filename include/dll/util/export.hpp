@@ -12,9 +12,18 @@
 
 #pragma once
 
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
 #include <string>
 #include <iostream>
 #include <fstream>
+#include <type_traits>
+#include <vector>
+
+#include "cpp_utils/assert.hpp"
+
+#include "etl/etl.hpp"
 
 #include "format.hpp"
 
@@ -39,4 +48,259 @@ void export_features_dll(const Features& features, const std::string& file) {
     os << '\n';
 }
 
+/*!
+ * \brief The header of a binary features file (format::BINARY)
+ *
+ * The header is followed by the features of all the samples, stored
+ * contiguously as little-endian values, with a fixed stride.
+ */
+struct features_header {
+    static constexpr uint32_t file_magic   = 0x464C4C44; ///< The magic number ("DLLF")
+    static constexpr uint32_t file_version = 1;          ///< The current version of the format
+    static constexpr size_t max_dimensions = 4;          ///< The maximum number of dimensions of the features of a sample
+    static constexpr size_t size           = 64;         ///< The size of the header
+
+    uint32_t magic;                ///< The magic number
+    uint32_t version;              ///< The version of the format
+    uint32_t weight_size;          ///< The size of one value (in bytes)
+    uint32_t dimensions;           ///< The number of dimensions of the features of a sample
+    uint64_t samples;              ///< The number of samples
+    uint64_t dims[max_dimensions]; ///< The dimensions of the features of a sample
+};
+
+static_assert(sizeof(features_header) <= features_header::size, "The features header is too large");
+
+/*!
+ * \brief Writer of the features of many samples into one file.
+ *
+ * The features are staged in a large buffer and written in blocks. In the
+ * DLL format, the features of each sample are written on one line,
+ * separated with ';'. In the BINARY and NPY formats, the values are
+ * written as values of type T, after a header that is completed with the
+ * number of samples when the writer is closed.
+ *
+ * \tparam T The type of the values in the binary formats
+ */
+template <typename T = float>
+struct features_writer {
+    static constexpr size_t buffer_size = 4 * 1024 * 1024; ///< The size of the staging buffer
+    static constexpr size_t npy_size    = 128;             ///< The size of the header of the NPY format
+
+    /*!
+     * \brief Open the given file
+     * \param file The file into which to export the features
+     * \param f The format of the exported features
+     */
+    features_writer(const std::string& file, format f) : file(file), f(f), os(file, std::ios::binary) {
+        if (!os) {
+            std::cerr << "ERROR: Impossible to write the features to " << file << std::endl;
+        }
+
+        buffer.reserve(buffer_size);
+    }
+
+    features_writer(const features_writer& rhs) = delete;
+    features_writer& operator=(const features_writer& rhs) = delete;
+
+    /*!
+     * \brief Complete and close the file
+     */
+    ~features_writer() {
+        close();
+    }
+
+    /*!
+     * \brief Append the features of one sample
+     * \param features The features to append
+     */
+    template <typename Features>
+    void write(const Features& features) {
+        if (f == format::DLL) {
+            write_text(features);
+        } else {
+            static_assert(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__ || !sizeof(Features), "The binary formats are written on little-endian hosts only");
+
+            if (!samples) {
+                stride = etl::size(features);
+
+                dims.clear();
+                for (size_t d = 0; d < etl::dimensions<Features>(); ++d) {
+                    dims.push_back(etl::dim(features, d));
+                }
+
+                // The header is completed when the file is closed
+                buffer.resize(f == format::NPY ? npy_size : features_header::size, 0);
+            }
+
+            cpp_assert(etl::size(features) == stride, "All the samples must have the same number of features");
+
+            if (buffer.size() + stride * sizeof(T) > buffer_size) {
+                flush();
+            }
+
+            const size_t offset = buffer.size();
+            buffer.resize(offset + stride * sizeof(T));
+
+            auto* out = buffer.data() + offset;
+
+            for (auto value : features) {
+                const T v(value);
+                std::memcpy(out, &v, sizeof(T));
+                out += sizeof(T);
+            }
+        }
+
+        ++samples;
+    }
+
+    /*!
+     * \brief Write the pending features, complete the header and close
+     * the file
+     */
+    void close() {
+        if (!os.is_open()) {
+            return;
+        }
+
+        flush();
+
+        if (f != format::DLL && samples) {
+            os.seekp(0);
+
+            if (f == format::NPY) {
+                auto header = npy_header();
+                os.write(header.data(), header.size());
+            } else {
+                std::vector<char> header(features_header::size, 0);
+                auto raw = binary_header();
+                std::memcpy(header.data(), &raw, sizeof(raw));
+                os.write(header.data(), header.size());
+            }
+        }
+
+        if (!os) {
+            std::cerr << "ERROR: Impossible to write the features to " << file << std::endl;
+        }
+
+        os.close();
+    }
+
+    /*!
+     * \brief Returns the number of samples written so far
+     */
+    size_t size() const {
+        return samples;
+    }
+
+private:
+    /*!
+     * \brief Append the features of one sample as one text line
+     */
+    template <typename Features>
+    void write_text(const Features& features) {
+        char value[32];
+
+        bool first = true;
+
+        for (auto& feature : features) {
+            // Enough room for the longest representation of one value
+            if (buffer.size() + sizeof(value) + 2 > buffer_size) {
+                flush();
+            }
+
+            if (!first) {
+                buffer.push_back(';');
+            }
+
+            const int n = snprintf(value, sizeof(value), "%g", double(feature));
+            buffer.insert(buffer.end(), value, value + n);
+
+            first = false;
+        }
+
+        buffer.push_back('\n');
+    }
+
+    /*!
+     * \brief Write the staging buffer to the file
+     */
+    void flush() {
+        if (!buffer.empty()) {
+            os.write(buffer.data(), buffer.size());
+            buffer.clear();
+        }
+    }
+
+    /*!
+     * \brief Returns the header of the BINARY format
+     */
+    features_header binary_header() const {
+        features_header header;
+        std::memset(&header, 0, sizeof(header));
+
+        header.magic       = features_header::file_magic;
+        header.version     = features_header::file_version;
+        header.weight_size = sizeof(T);
+        header.dimensions  = std::min(dims.size(), features_header::max_dimensions);
+        header.samples     = samples;
+
+        for (size_t d = 0; d < header.dimensions; ++d) {
+            header.dims[d] = dims[d];
+        }
+
+        return header;
+    }
+
+    /*!
+     * \brief Returns the header of the NPY format (version 1.0), padded
+     * to npy_size bytes
+     */
+    std::string npy_header() const {
+        std::string shape = std::to_string(samples) + ",";
+
+        for (size_t d = 0; d < dims.size(); ++d) {
+            shape += (d ? ", " : " ") + std::to_string(dims[d]);
+        }
+
+        std::string descr = std::string("<") + (std::is_floating_point<T>::value ? "f" : std::is_signed<T>::value ? "i" : "u") + std::to_string(sizeof(T));
+
+        std::string dict = "{'descr': '" + descr + "', 'fortran_order': False, 'shape': (" + shape + "), }";
+
+        // Magic (6), version (2) and length (2), then the padded dictionary
+        dict.resize(npy_size - 10 - 1, ' ');
+        dict += '\n';
+
+        std::string header("\x93NUMPY\x01\x00", 8);
+        header += char((npy_size - 10) & 0xFF);
+        header += char((npy_size - 10) >> 8);
+        header += dict;
+
+        return header;
+    }
+
+    std::string file;         ///< The path of the file
+    format f;                 ///< The format of the file
+    std::ofstream os;         ///< The stream of the file
+    std::vector<char> buffer; ///< The staging buffer
+    std::vector<size_t> dims; ///< The dimensions of the features of one sample
+    size_t stride  = 0;       ///< The number of features of one sample
+    size_t samples = 0;       ///< The number of samples written so far
+};
+
+/*!
+ * \brief Export the given features to the given file with the given format
+ * \param features The features to be exported
+ * \param file The file into which to export the features
+ * \param f The format of the exported features
+ */
+template <typename Features>
+void export_features(const Features& features, const std::string& file, format f) {
+    if (f == format::DLL) {
+        export_features_dll(features, file);
+    } else {
+        features_writer<> writer(file, f);
+        writer.write(features);
+    }
+}
+
 } //end of dll namespace
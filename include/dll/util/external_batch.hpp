@@ -0,0 +1,55 @@
+//=======================================================================
+// Copyright (c) 2014-2017 Baptiste Wicht
+// Distributed under the terms of the MIT License.
+// (See accompanying file LICENSE or copy at
+//  http://opensource.org/licenses/MIT)
+//=======================================================================
+
+/*!
+ * \file
+ * \brief Views of batches stored in memory owned by the caller
+ */
+
+#pragma once
+
+#include "etl/etl.hpp"
+
+namespace dll {
+
+/*!
+ * \brief Returns a view of a batch stored contiguously in memory owned by
+ * the caller.
+ *
+ * The view does not copy nor own the memory, which must outlive it. The
+ * view can be given as input, or as output, to the forward passes of the
+ * layers and of the inference sessions.
+ *
+ * \param memory The memory of the batch
+ * \param batch The number of samples of the batch
+ * \param dims The dimensions of one sample
+ *
+ * \return A view of the batch [batch, dims...]
+ */
+template <typename T, typename... Dims>
+etl::custom_dyn_matrix<T, sizeof...(Dims) + 1> external_batch(T* memory, size_t batch, Dims... dims) {
+    return etl::custom_dyn_matrix<T, sizeof...(Dims) + 1>(memory, batch, size_t(dims)...);
+}
+
+/*!
+ * \brief Returns a view of an input batch stored contiguously in read-only
+ * memory owned by the caller.
+ *
+ * The forward passes only read their inputs, the view must not be written.
+ *
+ * \param memory The memory of the batch
+ * \param batch The number of samples of the batch
+ * \param dims The dimensions of one sample
+ *
+ * \return A view of the batch [batch, dims...]
+ */
+template <typename T, typename... Dims>
+etl::custom_dyn_matrix<T, sizeof...(Dims) + 1> external_batch(const T* memory, size_t batch, Dims... dims) {
+    return external_batch(const_cast<T*>(memory), batch, dims...);
+}
+
+} //end of dll namespace
@@ -0,0 +1,333 @@
+//=======================================================================
+// Copyright (c) 2014-2017 Baptiste Wicht
+// Distributed under the terms of the MIT License.
+// (See accompanying file LICENSE or copy at
+//  http://opensource.org/licenses/MIT)
+//=======================================================================
+
+/*!
+ * \file
+ * \brief Structured pruning of the filters of the convolutional layers.
+ *
+ * The filters of smallest score of a dynamic convolutional layer are
+ * removed from the layer and the matching input channels are removed from
+ * the following layers, up to the next convolutional or dense layer. The
+ * layers physically shrink: the inference of the pruned network is faster
+ * and, once pruned, the shapes of the network can be used to generate its
+ * static equivalent (see static_desc.hpp).
+ */
+
+#pragma once
+
+#include <cmath>
+#include <numeric>
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <type_traits>
+
+#include "cpp_utils/assert.hpp"
+
+#include "etl/etl.hpp"
+
+#include "dll/layer_traits.hpp"
+
+namespace dll {
+
+/*!
+ * \brief The score of the filters for structured pruning
+ */
+enum class filter_score {
+    L1,      ///< The L1 norm of the weights of the filter
+    L2,      ///< The L2 norm of the weights of the filter
+    BN_GAMMA ///< The absolute value of gamma of the following batch normalization (L1 without normalization)
+};
+
+/*!
+ * \brief Compute the score of each filter of the given weights, the
+ * filters being the first dimension of the weights
+ */
+template <typename W>
+std::vector<double> filter_scores(const W& w, filter_score score) {
+    const size_t k     = etl::dim<0>(w);
+    const size_t block = etl::size(w) / k;
+
+    w.ensure_cpu_up_to_date();
+
+    const auto* ptr = w.memory_start();
+
+    std::vector<double> scores(k, 0.0);
+
+    for (size_t f = 0; f < k; ++f) {
+        for (size_t i = 0; i < block; ++i) {
+            const double v = ptr[f * block + i];
+            scores[f] += score == filter_score::L2 ? v * v : std::abs(v);
+        }
+
+        if (score == filter_score::L2) {
+            scores[f] = std::sqrt(scores[f]);
+        }
+    }
+
+    return scores;
+}
+
+/*!
+ * \brief Select the filters to keep, removing the given fraction of the
+ * filters of smallest score (at least one filter is kept)
+ * \return The indices of the kept filters, in increasing order
+ */
+inline std::vector<size_t> select_filters(const std::vector<double>& scores, double ratio) {
+    cpp_assert(ratio >= 0.0 && ratio <= 1.0, "Invalid ratio for select_filters");
+
+    const size_t n    = scores.size();
+    const size_t keep = std::max(size_t(1), n - std::min(n, size_t(ratio * n)));
+
+    std::vector<size_t> kept(n);
+    std::iota(kept.begin(), kept.end(), 0);
+
+    std::stable_sort(kept.begin(), kept.end(), [&scores](size_t a, size_t b) { return scores[a] > scores[b]; });
+
+    kept.resize(std::min(n, keep));
+
+    std::sort(kept.begin(), kept.end());
+
+    return kept;
+}
+
+/*!
+ * \brief Returns a new container of the given dimensions with the kept
+ * blocks of the given container.
+ *
+ * The source is seen as a sequence of groups of count blocks of block
+ * values, only the kept blocks of each group are copied.
+ *
+ * \param src The source container
+ * \param kept The indices of the kept blocks in each group
+ * \param count The number of blocks of each group
+ * \param block The number of values of each block
+ * \param dims The dimensions of the new container
+ */
+template <typename M, typename... Dims>
+M kept_blocks(const M& src, const std::vector<size_t>& kept, size_t count, size_t block, Dims... dims) {
+    M dst(dims...);
+
+    cpp_assert(etl::size(dst) * count == etl::size(src) * kept.size(), "Invalid dimensions for kept_blocks");
+
+    src.ensure_cpu_up_to_date();
+
+    const auto* s = src.memory_start();
+    auto* d       = dst.memory_start();
+
+    const size_t groups = etl::size(src) / (count * block);
+
+    for (size_t o = 0; o < groups; ++o) {
+        for (size_t i = 0; i < kept.size(); ++i) {
+            std::copy_n(s + (o * count + kept[i]) * block, block, d + (o * kept.size() + i) * block);
+        }
+    }
+
+    dst.invalidate_gpu();
+
+    return dst;
+}
+
+namespace filter_detail {
+
+/*!
+ * \brief Traits to test if the filters of a layer can be pruned
+ */
+template <typename Layer, typename Enable = void>
+struct has_keep_filters : std::false_type {};
+
+/*!
+ * \copydoc has_keep_filters
+ */
+template <typename Layer>
+struct has_keep_filters<Layer, std::void_t<decltype(std::declval<Layer&>().keep_filters(std::declval<const std::vector<size_t>&>()))>> : std::true_type {};
+
+/*!
+ * \brief Traits to test if the input channels of a layer can be pruned
+ */
+template <typename Layer, typename Enable = void>
+struct has_keep_channels : std::false_type {};
+
+/*!
+ * \copydoc has_keep_channels
+ */
+template <typename Layer>
+struct has_keep_channels<Layer, std::void_t<decltype(std::declval<Layer&>().keep_channels(std::declval<const std::vector<size_t>&>(), size_t()))>> : std::true_type {};
+
+/*!
+ * \brief Traits to test if a layer has a gamma per channel
+ */
+template <typename Layer, typename Enable = void>
+struct has_gamma : std::false_type {};
+
+/*!
+ * \copydoc has_gamma
+ */
+template <typename Layer>
+struct has_gamma<Layer, std::void_t<decltype(std::declval<const Layer&>().gamma)>> : std::true_type {};
+
+/*!
+ * \brief Indicates if the pruning of the channels stops at the given layer
+ */
+template <typename Layer>
+constexpr bool consumes_channels() {
+    return decay_layer_traits<Layer>::is_convolutional_layer() || decay_layer_traits<Layer>::is_dense_layer();
+}
+
+/*!
+ * \brief Indicates if the input channels of the layer I, and of the
+ * following layers up to the next convolutional or dense layer, can be
+ * pruned
+ */
+template <size_t I, typename DBN>
+bool prunable_channels(const DBN& dbn) {
+    if constexpr (I >= DBN::layers) {
+        cpp_unused(dbn);
+        return false;
+    } else {
+        using layer_t = typename DBN::template layer_type<I>;
+
+        if constexpr (has_keep_channels<layer_t>::value) {
+            if (!dbn.template layer_get<I>().can_keep_channels()) {
+                return false;
+            }
+
+            if constexpr (consumes_channels<layer_t>()) {
+                return true;
+            } else {
+                return prunable_channels<I + 1>(dbn);
+            }
+        } else if constexpr (decay_layer_traits<layer_t>::is_transform_layer()) {
+            return prunable_channels<I + 1>(dbn);
+        } else {
+            return false;
+        }
+    }
+}
+
+/*!
+ * \brief Prune the input channels of the layer I and of the following
+ * layers up to the next convolutional or dense layer
+ */
+template <size_t I, typename DBN>
+void keep_channels(DBN& dbn, const std::vector<size_t>& kept, size_t channels) {
+    if constexpr (I < DBN::layers) {
+        using layer_t = typename DBN::template layer_type<I>;
+
+        if constexpr (has_keep_channels<layer_t>::value) {
+            dbn.template layer_get<I>().keep_channels(kept, channels);
+
+            if constexpr (!consumes_channels<layer_t>()) {
+                keep_channels<I + 1>(dbn, kept, channels);
+            }
+        } else {
+            keep_channels<I + 1>(dbn, kept, channels);
+        }
+    }
+}
+
+/*!
+ * \brief Compute the score of the filters from the gamma of the first
+ * batch normalization following the layer I - 1
+ * \return true if a batch normalization was found, false otherwise
+ */
+template <size_t I, typename DBN>
+bool gamma_scores(const DBN& dbn, std::vector<double>& scores) {
+    if constexpr (I < DBN::layers) {
+        using layer_t = typename DBN::template layer_type<I>;
+
+        if constexpr (has_gamma<layer_t>::value && has_keep_channels<layer_t>::value) {
+            auto& gamma = dbn.template layer_get<I>().gamma;
+
+            scores.resize(etl::size(gamma));
+
+            for (size_t c = 0; c < scores.size(); ++c) {
+                scores[c] = std::abs(gamma[c]);
+            }
+
+            return true;
+        } else if constexpr (!consumes_channels<layer_t>()) {
+            return gamma_scores<I + 1>(dbn, scores);
+        }
+    }
+
+    cpp_unused(dbn);
+    cpp_unused(scores);
+
+    return false;
+}
+
+/*!
+ * \brief Prune the filters of the layers from the layer I
+ * \return The number of removed filters
+ */
+template <size_t I, typename DBN>
+size_t prune_filters(DBN& dbn, double ratio, filter_score score) {
+    if constexpr (I >= DBN::layers) {
+        cpp_unused(dbn);
+        cpp_unused(ratio);
+        cpp_unused(score);
+
+        return 0;
+    } else {
+        using layer_t = typename DBN::template layer_type<I>;
+
+        size_t removed = 0;
+
+        if constexpr (has_keep_filters<layer_t>::value) {
+            auto& layer = dbn.template layer_get<I>();
+
+            if (!layer.can_keep_filters() || !prunable_channels<I + 1>(dbn)) {
+                std::cerr << "WARNING: The filters of the layer " << I << " cannot be pruned (grouped convolution or unsupported next layers)" << std::endl;
+            } else {
+                std::vector<double> scores;
+
+                if (score != filter_score::BN_GAMMA || !gamma_scores<I + 1>(dbn, scores)) {
+                    scores = filter_scores(layer.w, score == filter_score::L2 ? filter_score::L2 : filter_score::L1);
+                }
+
+                auto kept = select_filters(scores, ratio);
+
+                if (kept.size() < scores.size()) {
+                    layer.keep_filters(kept);
+                    keep_channels<I + 1>(dbn, kept, scores.size());
+
+                    removed = scores.size() - kept.size();
+                }
+            }
+        } else if constexpr (decay_layer_traits<layer_t>::is_convolutional_layer() && !decay_layer_traits<layer_t>::is_dynamic()) {
+            std::cerr << "WARNING: The filters of the static layer " << I << " cannot be pruned, use the dynamic network (dyn_dbn_desc)" << std::endl;
+        }
+
+        return removed + prune_filters<I + 1>(dbn, ratio, score);
+    }
+}
+
+} //end of namespace filter_detail
+
+/*!
+ * \brief Prune the filters of the dynamic convolutional layers of the given
+ * network.
+ *
+ * The given fraction of the filters of each layer, of smallest score, is
+ * removed, along with the matching input channels of the following layers
+ * (batch normalization, pooling and transform layers) up to the next
+ * convolutional or dense layer. A layer is not pruned if one of these
+ * layers cannot remove channels.
+ *
+ * \param dbn The network
+ * \param ratio The fraction of the filters of each layer to remove
+ * \param score The score of the filters
+ *
+ * \return The number of removed filters
+ */
+template <typename DBN>
+size_t prune_filters(DBN& dbn, double ratio, filter_score score = filter_score::L1) {
+    return filter_detail::prune_filters<0>(dbn, ratio, score);
+}
+
+} //end of dll namespace
@@ -18,7 +18,9 @@ namespace dll {
  * \brief An activation function
  */
 enum class format {
-    DLL ///< Default simple format of the DLL library
+    DLL,    ///< Default simple format of the DLL library
+    BINARY, ///< Raw little-endian values with a fixed stride, after a header
+    NPY     ///< NumPy array file
 };
 
 } //end of dll namespace
@@ -0,0 +1,155 @@
+//=======================================================================
+// Copyright (c) 2014-2017 Baptiste Wicht
+// Distributed under the terms of the MIT License.
+// (See accompanying file LICENSE or copy at
+//  http://opensource.org/licenses/MIT)
+//=======================================================================
+
+/*!
+ * \file
+ * \brief Fused errors and metrics kernels of the mean squared error and of
+ * the binary cross-entropy.
+ *
+ * The kernels compute, in a single pass over the outputs, the errors of
+ * the loss and, if requested, the metrics of the batch. The outputs of the
+ * binary cross-entropy are clipped in registers, without any temporary.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+#include "etl/etl.hpp"
+
+#include "dll/loss.hpp"
+
+namespace dll {
+
+/*!
+ * \brief Compute the errors and the metrics of the mean squared error of
+ * N rows of M outputs
+ * \param out The outputs (N x M)
+ * \param labels The labels (N x M)
+ * \param errors The errors of the loss, 2 * (labels - outputs) (N x M)
+ * \return a pair containing the sum of the absolute errors and the sum of
+ * the loss of the rows (0 without Metrics)
+ */
+template <bool Metrics, typename T, typename L>
+std::pair<double, double> mse_errors(const T* out, const L* labels, T* errors, size_t N, size_t M) {
+    double error = 0.0;
+    double loss  = 0.0;
+
+    for (size_t n = 0; n < N; ++n) {
+        const T* row   = out + n * M;
+        const L* label = labels + n * M;
+        T* error_row   = errors + n * M;
+
+        T row_error = 0;
+        T row_loss  = 0;
+
+        for (size_t m = 0; m < M; ++m) {
+            const T d = T(label[m]) - row[m];
+
+            error_row[m] = T(2) * d;
+
+            if constexpr (Metrics) {
+                row_error += std::abs(d);
+                row_loss += d * d;
+            }
+        }
+
+        error += row_error;
+        loss += 0.5 * row_loss;
+    }
+
+    return {error, loss};
+}
+
+/*!
+ * \brief Compute the errors and the metrics of the binary cross-entropy of
+ * N rows of M outputs.
+ *
+ * The outputs are clipped to [0.001, 0.999] to avoid infinite errors and
+ * losses.
+ *
+ * \param out The outputs (N x M)
+ * \param labels The labels (N x M)
+ * \param errors The errors of the loss, (labels - outputs) / ((1 - outputs) * outputs) (N x M)
+ * \return a pair containing the sum of the absolute errors and the sum of
+ * the loss of the rows, both divided by M (0 without Metrics)
+ */
+template <bool Metrics, typename T, typename L>
+std::pair<double, double> bce_errors(const T* out, const L* labels, T* errors, size_t N, size_t M) {
+    double error = 0.0;
+    double loss  = 0.0;
+
+    for (size_t n = 0; n < N; ++n) {
+        const T* row   = out + n * M;
+        const L* label = labels + n * M;
+        T* error_row   = errors + n * M;
+
+        T row_error = 0;
+        T row_loss  = 0;
+
+        for (size_t m = 0; m < M; ++m) {
+            const T l = label[m];
+            const T c = std::min(std::max(row[m], T(0.001)), T(0.999));
+
+            error_row[m] = (l - c) / ((T(1) - c) * c);
+
+            if constexpr (Metrics) {
+                row_error += std::abs(l - row[m]);
+                row_loss -= l * std::log(c) + (T(1) - l) * std::log(T(1) - c);
+            }
+        }
+
+        error += row_error;
+        loss += row_loss;
+    }
+
+    return {error / M, loss / M};
+}
+
+/*!
+ * \brief Compute the errors and the metrics of the given loss on the n
+ * first rows of the ETL outputs.
+ *
+ * The metrics are not normalized by the number of rows: divided by n,
+ * they are the metrics of the network for the batch.
+ *
+ * \param output The outputs of the last layer
+ * \param labels The labels of the n first rows
+ * \param errors The errors of the loss
+ * \param n The number of rows
+ * \return a pair containing the error and the loss of the rows (0 without Metrics)
+ */
+template <loss_function F, bool Metrics, typename Output, typename Labels, typename Errors>
+std::pair<double, double> fused_loss_errors(const Output& output, const Labels& labels, Errors& errors, size_t n) {
+    static_assert(F == loss_function::MEAN_SQUARED_ERROR || F == loss_function::BINARY_CROSS_ENTROPY, "Only MSE and BCE have fused kernels");
+    static_assert(etl::all_dma<Output, Errors>, "The fused losses need direct memory access to the output and the errors");
+
+    if constexpr (etl::all_dma<Labels>) {
+        output.ensure_cpu_up_to_date();
+        labels.ensure_cpu_up_to_date();
+
+        const size_t M = etl::size(output) / etl::dim<0>(output);
+
+        std::pair<double, double> metrics;
+
+        if constexpr (F == loss_function::MEAN_SQUARED_ERROR) {
+            metrics = mse_errors<Metrics>(output.memory_start(), labels.memory_start(), errors.memory_start(), n, M);
+        } else {
+            metrics = bce_errors<Metrics>(output.memory_start(), labels.memory_start(), errors.memory_start(), n, M);
+        }
+
+        errors.invalidate_gpu();
+
+        return metrics;
+    } else {
+        return fused_loss_errors<F, Metrics>(output, etl::force_temporary(labels), errors, n);
+    }
+}
+
+} //end of dll namespace
@@ -0,0 +1,197 @@
+//=======================================================================
+// Copyright (c) 2014-2017 Baptiste Wicht
+// Distributed under the terms of the MIT License.
+// (See accompanying file LICENSE or copy at
+//  http://opensource.org/licenses/MIT)
+//=======================================================================
+
+/*!
+ * \file
+ * \brief Prefetching of the batches of the generators to the GPU.
+ *
+ * Each slot holds a device copy of one batch, a pinned host buffer and its
+ * own CUDA stream. A batch is copied to the pinned buffer and then to the
+ * device asynchronously, so that the next batch is already on the device
+ * when the trainer asks for it. The device copies are only useful when the
+ * training stays on the GPU (ETL_GPU), otherwise the slots are plain host
+ * copies.
+ */
+
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <algorithm>
+
+#include "etl/etl.hpp"
+
+#ifdef ETL_GPU
+#include <cuda_runtime.h>
+#endif
+
+namespace dll {
+
+/*!
+ * \brief Indicates if the batches can be prefetched to the GPU
+ */
+constexpr bool gpu_prefetch_support() {
+#ifdef ETL_GPU
+    return true;
+#else
+    return false;
+#endif
+}
+
+/*!
+ * \brief Device copies of the batches of a generator.
+ *
+ * The copies of the different slots are independent, they can be started
+ * from different threads. A slot can only be uploaded again once its
+ * batch is not used anymore.
+ *
+ * \tparam T The type of the values
+ * \tparam D The number of dimensions of a batch
+ */
+template <typename T, size_t D>
+struct gpu_batch_slots {
+    using weight  = T;                     ///< The type of the values
+    using batch_t = etl::dyn_matrix<T, D>; ///< The type of a batch
+
+    gpu_batch_slots() = default;
+
+    gpu_batch_slots(const gpu_batch_slots& rhs) = delete;
+    gpu_batch_slots& operator=(const gpu_batch_slots& rhs) = delete;
+
+    /*!
+     * \brief Prepare n slots for batches of batch_size samples of the shape
+     * of the given sample
+     */
+    template <typename S>
+    void init(size_t n, size_t batch_size, const S& sample) {
+        slots.clear();
+
+        for (size_t s = 0; s < n; ++s) {
+            slots.emplace_back(std::make_unique<slot_t>(make_batch(batch_size, sample, std::make_index_sequence<D - 1>())));
+        }
+    }
+
+    /*!
+     * \brief Returns the number of slots
+     */
+    size_t size() const {
+        return slots.size();
+    }
+
+    /*!
+     * \brief Start the copy of the given batch to the given slot
+     */
+    template <typename E>
+    void upload(size_t s, const E& batch) {
+        auto& slot = *slots[s];
+
+        const size_t n = etl::size(batch);
+
+        batch.ensure_cpu_up_to_date();
+
+#ifdef ETL_GPU
+        // The previous copy must be over before the pinned buffer is reused
+        cudaEventSynchronize(slot.ready);
+
+        std::copy_n(batch.memory_start(), n, slot.pinned);
+
+        slot.batch.ensure_gpu_allocated();
+
+        cudaMemcpyAsync(slot.batch.gpu_memory(), slot.pinned, n * sizeof(weight), cudaMemcpyHostToDevice, slot.stream);
+        cudaEventRecord(slot.ready, slot.stream);
+#else
+        std::copy_n(batch.memory_start(), n, slot.batch.memory_start());
+#endif
+
+        slot.samples = etl::dim<0>(batch);
+        slot.pending = true;
+    }
+
+    /*!
+     * \brief Returns the batch of the given slot, waiting for its copy
+     */
+    auto batch(size_t s) {
+        auto& slot = *slots[s];
+
+        if (slot.pending) {
+#ifdef ETL_GPU
+            cudaEventSynchronize(slot.ready);
+
+            // Only the device copy is up to date
+            slot.batch.validate_gpu();
+            slot.batch.invalidate_cpu();
+#endif
+
+            slot.pending = false;
+        }
+
+        return etl::slice(slot.batch, 0, slot.samples);
+    }
+
+    /*!
+     * \brief Returns the number of bytes of the host memory of the slots
+     */
+    size_t memory() const {
+        size_t bytes = 0;
+
+        for (auto& slot : slots) {
+            // The host copy of the batch and the pinned buffer
+            bytes += (gpu_prefetch_support() ? 2 : 1) * etl::size(slot->batch) * sizeof(weight);
+        }
+
+        return bytes;
+    }
+
+private:
+    /*!
+     * \brief One slot: the batch, its pinned buffer, its stream and the
+     * event of the end of its copy
+     */
+    struct slot_t {
+        batch_t batch;          ///< The batch
+        size_t samples = 0;     ///< The number of samples of the last uploaded batch
+        bool pending   = false; ///< Indicates if the last upload was not waited for
+
+#ifdef ETL_GPU
+        weight* pinned = nullptr; ///< The pinned host buffer
+        cudaStream_t stream;      ///< The stream of the copies
+        cudaEvent_t ready;        ///< The end of the last copy
+#endif
+
+        explicit slot_t(batch_t batch) : batch(std::move(batch)) {
+#ifdef ETL_GPU
+            cudaMallocHost(reinterpret_cast<void**>(&pinned), etl::size(this->batch) * sizeof(weight));
+            cudaStreamCreateWithFlags(&stream, cudaStreamNonBlocking);
+            cudaEventCreateWithFlags(&ready, cudaEventDisableTiming);
+#endif
+        }
+
+        slot_t(const slot_t& rhs) = delete;
+        slot_t& operator=(const slot_t& rhs) = delete;
+
+        ~slot_t() {
+#ifdef ETL_GPU
+            cudaEventSynchronize(ready);
+            cudaEventDestroy(ready);
+            cudaStreamDestroy(stream);
+            cudaFreeHost(pinned);
+#endif
+        }
+    };
+
+    /*!
+     * \brief Create a batch of n samples of the shape of the given sample
+     */
+    template <typename S, size_t... I>
+    static batch_t make_batch(size_t n, const S& sample, std::index_sequence<I...> /*seq*/) {
+        return batch_t(n, etl::dim<I>(sample)...);
+    }
+
+    std::vector<std::unique_ptr<slot_t>> slots; ///< The slots
+};
+
+} //end of dll namespace
@@ -0,0 +1,395 @@
+//=======================================================================
+// Copyright (c) 2014-2017 Baptiste Wicht
+// Distributed under the terms of the MIT License.
+// (See accompanying file LICENSE or copy at
+//  http://opensource.org/licenses/MIT)
+//=======================================================================
+
+/*!
+ * \file
+ * \brief Kernels of the grouped (and depthwise) convolutions and of the
+ * dilated convolutions
+ */
+
+#pragma once
+
+#include <algorithm>
+
+#include "cpp_utils/assert.hpp"
+
+#include "etl/etl.hpp"
+
+namespace dll {
+
+/*!
+ * \brief The shape of a grouped convolution.
+ *
+ * The C input channels and the K filters are split into G groups, the
+ * filters of a group only seeing the input channels of their group. The
+ * filters are stored as [K, C / G, NW1, NW2]. A depthwise convolution is
+ * a grouped convolution with G = C = K.
+ *
+ * The taps of a dilated filter are D1 (D2) pixels apart, the filter
+ * covering D1 * (NW1 - 1) + 1 pixels without any additional weight.
+ */
+struct grouped_conv_shape {
+    size_t c;   ///< The number of input channels
+    size_t nv1; ///< The first dimension of the input
+    size_t nv2; ///< The second dimension of the input
+    size_t k;   ///< The number of filters
+    size_t nw1; ///< The first dimension of the filters
+    size_t nw2; ///< The second dimension of the filters
+    size_t s1;  ///< The stride of the first dimension
+    size_t s2;  ///< The stride of the second dimension
+    size_t p1;  ///< The padding of the first dimension
+    size_t p2;  ///< The padding of the second dimension
+    size_t g;   ///< The number of groups
+    size_t d1 = 1; ///< The dilation of the first dimension
+    size_t d2 = 1; ///< The dilation of the second dimension
+
+    /*!
+     * \brief Returns the first dimension covered by the filters
+     */
+    size_t ew1() const {
+        return d1 * (nw1 - 1) + 1;
+    }
+
+    /*!
+     * \brief Returns the second dimension covered by the filters
+     */
+    size_t ew2() const {
+        return d2 * (nw2 - 1) + 1;
+    }
+
+    /*!
+     * \brief Returns the first dimension of the output
+     */
+    size_t nh1() const {
+        return (nv1 - ew1() + 2 * p1) / s1 + 1;
+    }
+
+    /*!
+     * \brief Returns the second dimension of the output
+     */
+    size_t nh2() const {
+        return (nv2 - ew2() + 2 * p2) / s2 + 1;
+    }
+
+    /*!
+     * \brief Returns the number of input channels of each group
+     */
+    size_t cg() const {
+        return c / g;
+    }
+
+    /*!
+     * \brief Returns the number of filters of each group
+     */
+    size_t kg() const {
+        return k / g;
+    }
+
+    /*!
+     * \brief Indicates if the convolution is pointwise (1x1 filters, no
+     * stride, no padding), i.e. a matrix multiplication per group
+     */
+    bool pointwise() const {
+        return nw1 == 1 && nw2 == 1 && s1 == 1 && s2 == 1 && p1 == 0 && p2 == 0;
+    }
+
+    /*!
+     * \brief Indicates if the filters are dilated
+     */
+    bool dilated() const {
+        return (d1 > 1 && nw1 > 1) || (d2 > 1 && nw2 > 1);
+    }
+};
+
+/*!
+ * \brief The kernels of the grouped convolutions of a batch.
+ *
+ * The pointwise convolutions are computed with one matrix multiplication
+ * per group and per sample, the other ones directly. The ungrouped
+ * pointwise convolutions (G == 1) and the dilated convolutions are also
+ * using these kernels.
+ *
+ * The direct kernels iterate over the taps of the filters and, for each
+ * tap, only over the outputs whose input is inside the image: the dilated
+ * filters are never expanded and the padding is never materialized.
+ */
+template <typename T>
+struct grouped_conv {
+    using matrix_t = etl::custom_dyn_matrix<T, 2>; ///< The type of a view of a matrix
+
+    /*!
+     * \brief Compute the forward pass of a batch
+     * \param input The batch of inputs [B, C, NV1, NV2]
+     * \param w The filters [K, C / G, NW1, NW2]
+     * \param output The batch of outputs [B, K, NH1, NH2]
+     * \param s The shape of the convolution
+     */
+    template <typename I, typename W, typename O>
+    static void forward(const I& input, const W& w, O&& output, const grouped_conv_shape& s) {
+        const size_t B  = etl::dim<0>(input);
+        const size_t NI = s.c * s.nv1 * s.nv2;
+        const size_t NO = s.k * s.nh1() * s.nh2();
+        const size_t NK = s.cg() * s.nw1 * s.nw2;
+
+        cpp_assert(etl::size(input) == B * NI && etl::size(output) == B * NO && etl::size(w) == s.k * NK, "Invalid sizes for grouped_conv::forward");
+
+        input.ensure_cpu_up_to_date();
+        w.ensure_cpu_up_to_date();
+
+        const T* in_ptr = input.memory_start();
+        const T* w_ptr  = w.memory_start();
+        T* out_ptr      = output.memory_start();
+
+        const size_t HW = s.nh1() * s.nh2();
+
+        for (size_t b = 0; b < B; ++b) {
+            for (size_t g = 0; g < s.g; ++g) {
+                const T* in_g = in_ptr + b * NI + g * s.cg() * s.nv1 * s.nv2;
+                const T* w_g  = w_ptr + g * s.kg() * NK;
+                T* out_g      = out_ptr + b * NO + g * s.kg() * HW;
+
+                if (s.pointwise()) {
+                    matrix_t out_m(out_g, s.kg(), HW);
+
+                    out_m = matrix_t(const_cast<T*>(w_g), s.kg(), s.cg()) * matrix_t(const_cast<T*>(in_g), s.cg(), HW);
+                } else {
+                    std::fill_n(out_g, s.kg() * HW, T(0));
+
+                    for (size_t k = 0; k < s.kg(); ++k) {
+                        for (size_t c = 0; c < s.cg(); ++c) {
+                            correlate(in_g + c * s.nv1 * s.nv2, w_g + (k * s.cg() + c) * s.nw1 * s.nw2, out_g + k * HW, s);
+                        }
+                    }
+                }
+            }
+        }
+
+        output.invalidate_gpu();
+    }
+
+    /*!
+     * \brief Backpropagate the errors of a batch to the inputs
+     * \param errors The batch of errors [B, K, NH1, NH2]
+     * \param w The filters [K, C / G, NW1, NW2]
+     * \param output The batch of errors of the inputs [B, C, NV1, NV2]
+     * \param s The shape of the convolution
+     */
+    template <typename E, typename W, typename O>
+    static void backward(const E& errors, const W& w, O&& output, const grouped_conv_shape& s) {
+        const size_t B  = etl::dim<0>(errors);
+        const size_t NI = s.c * s.nv1 * s.nv2;
+        const size_t NO = s.k * s.nh1() * s.nh2();
+        const size_t NK = s.cg() * s.nw1 * s.nw2;
+
+        cpp_assert(etl::size(errors) == B * NO && etl::size(output) == B * NI && etl::size(w) == s.k * NK, "Invalid sizes for grouped_conv::backward");
+
+        errors.ensure_cpu_up_to_date();
+        w.ensure_cpu_up_to_date();
+
+        const T* e_ptr = errors.memory_start();
+        const T* w_ptr = w.memory_start();
+        T* out_ptr     = output.memory_start();
+
+        const size_t HW = s.nh1() * s.nh2();
+
+        for (size_t b = 0; b < B; ++b) {
+            for (size_t g = 0; g < s.g; ++g) {
+                const T* e_g = e_ptr + b * NO + g * s.kg() * HW;
+                const T* w_g = w_ptr + g * s.kg() * NK;
+                T* out_g     = out_ptr + b * NI + g * s.cg() * s.nv1 * s.nv2;
+
+                if (s.pointwise()) {
+                    matrix_t out_m(out_g, s.cg(), HW);
+
+                    out_m = etl::transpose(matrix_t(const_cast<T*>(w_g), s.kg(), s.cg())) * matrix_t(const_cast<T*>(e_g), s.kg(), HW);
+                } else {
+                    std::fill_n(out_g, s.cg() * s.nv1 * s.nv2, T(0));
+
+                    for (size_t k = 0; k < s.kg(); ++k) {
+                        for (size_t c = 0; c < s.cg(); ++c) {
+                            scatter(e_g + k * HW, w_g + (k * s.cg() + c) * s.nw1 * s.nw2, out_g + c * s.nv1 * s.nv2, s);
+                        }
+                    }
+                }
+            }
+        }
+
+        output.invalidate_gpu();
+    }
+
+    /*!
+     * \brief Compute the gradients of the filters from a batch
+     * \param input The batch of inputs [B, C, NV1, NV2]
+     * \param errors The batch of errors [B, K, NH1, NH2]
+     * \param grad The gradients of the filters [K, C / G, NW1, NW2]
+     * \param s The shape of the convolution
+     */
+    template <typename I, typename E, typename G>
+    static void backward_filter(const I& input, const E& errors, G&& grad, const grouped_conv_shape& s) {
+        const size_t B  = etl::dim<0>(input);
+        const size_t NI = s.c * s.nv1 * s.nv2;
+        const size_t NO = s.k * s.nh1() * s.nh2();
+        const size_t NK = s.cg() * s.nw1 * s.nw2;
+
+        cpp_assert(etl::size(input) == B * NI && etl::size(errors) == B * NO && etl::size(grad) == s.k * NK, "Invalid sizes for grouped_conv::backward_filter");
+
+        input.ensure_cpu_up_to_date();
+        errors.ensure_cpu_up_to_date();
+
+        const T* in_ptr = input.memory_start();
+        const T* e_ptr  = errors.memory_start();
+        T* g_ptr        = grad.memory_start();
+
+        const size_t HW = s.nh1() * s.nh2();
+
+        std::fill_n(g_ptr, s.k * NK, T(0));
+
+        for (size_t b = 0; b < B; ++b) {
+            for (size_t g = 0; g < s.g; ++g) {
+                const T* in_g = in_ptr + b * NI + g * s.cg() * s.nv1 * s.nv2;
+                const T* e_g  = e_ptr + b * NO + g * s.kg() * HW;
+                T* grad_g     = g_ptr + g * s.kg() * NK;
+
+                if (s.pointwise()) {
+                    matrix_t grad_m(grad_g, s.kg(), s.cg());
+
+                    grad_m += matrix_t(const_cast<T*>(e_g), s.kg(), HW) * etl::transpose(matrix_t(const_cast<T*>(in_g), s.cg(), HW));
+                } else {
+                    for (size_t k = 0; k < s.kg(); ++k) {
+                        for (size_t c = 0; c < s.cg(); ++c) {
+                            accumulate_filter(in_g + c * s.nv1 * s.nv2, e_g + k * HW, grad_g + (k * s.cg() + c) * s.nw1 * s.nw2, s);
+                        }
+                    }
+                }
+            }
+        }
+
+        grad.invalidate_gpu();
+    }
+
+private:
+    /*!
+     * \brief Compute the range of the outputs whose input, for the given
+     * offset of the tap in the filter, is inside the image
+     * \param offset The offset of the tap (index times dilation)
+     * \param s The stride
+     * \param p The padding
+     * \param nv The dimension of the input
+     * \param nh The dimension of the output
+     * \param first The first valid output
+     * \param last The end of the valid outputs
+     */
+    static void valid_outputs(size_t offset, size_t s, size_t p, size_t nv, size_t nh, size_t& first, size_t& last) {
+        // o * s + offset - p must be in [0, nv)
+        first = offset >= p ? 0 : (p - offset + s - 1) / s;
+        last  = nv + p > offset ? std::min(nh, (nv + p - offset - 1) / s + 1) : 0;
+        first = std::min(first, last);
+    }
+
+    /*!
+     * \brief Add the correlation of one input channel with one filter to
+     * one output channel
+     */
+    static void correlate(const T* in, const T* w, T* out, const grouped_conv_shape& s) {
+        const size_t nh1 = s.nh1();
+        const size_t nh2 = s.nh2();
+
+        for (size_t i = 0; i < s.nw1; ++i) {
+            size_t oh_first;
+            size_t oh_last;
+            valid_outputs(i * s.d1, s.s1, s.p1, s.nv1, nh1, oh_first, oh_last);
+
+            for (size_t j = 0; j < s.nw2; ++j) {
+                size_t ow_first;
+                size_t ow_last;
+                valid_outputs(j * s.d2, s.s2, s.p2, s.nv2, nh2, ow_first, ow_last);
+
+                const T w_ij = w[i * s.nw2 + j];
+
+                for (size_t oh = oh_first; oh < oh_last; ++oh) {
+                    const size_t ih = oh * s.s1 + i * s.d1 - s.p1;
+
+                    for (size_t ow = ow_first; ow < ow_last; ++ow) {
+                        const size_t iw = ow * s.s2 + j * s.d2 - s.p2;
+
+                        out[oh * nh2 + ow] += w_ij * in[ih * s.nv2 + iw];
+                    }
+                }
+            }
+        }
+    }
+
+    /*!
+     * \brief Add the errors of one output channel, through one filter, to
+     * the errors of one input channel
+     */
+    static void scatter(const T* errors, const T* w, T* out, const grouped_conv_shape& s) {
+        const size_t nh1 = s.nh1();
+        const size_t nh2 = s.nh2();
+
+        for (size_t i = 0; i < s.nw1; ++i) {
+            size_t oh_first;
+            size_t oh_last;
+            valid_outputs(i * s.d1, s.s1, s.p1, s.nv1, nh1, oh_first, oh_last);
+
+            for (size_t j = 0; j < s.nw2; ++j) {
+                size_t ow_first;
+                size_t ow_last;
+                valid_outputs(j * s.d2, s.s2, s.p2, s.nv2, nh2, ow_first, ow_last);
+
+                const T w_ij = w[i * s.nw2 + j];
+
+                for (size_t oh = oh_first; oh < oh_last; ++oh) {
+                    const size_t ih = oh * s.s1 + i * s.d1 - s.p1;
+
+                    for (size_t ow = ow_first; ow < ow_last; ++ow) {
+                        const size_t iw = ow * s.s2 + j * s.d2 - s.p2;
+
+                        out[ih * s.nv2 + iw] += w_ij * errors[oh * nh2 + ow];
+                    }
+                }
+            }
+        }
+    }
+
+    /*!
+     * \brief Add the gradients of one filter from one input channel and the
+     * errors of one output channel
+     */
+    static void accumulate_filter(const T* in, const T* errors, T* grad, const grouped_conv_shape& s) {
+        const size_t nh1 = s.nh1();
+        const size_t nh2 = s.nh2();
+
+        for (size_t i = 0; i < s.nw1; ++i) {
+            size_t oh_first;
+            size_t oh_last;
+            valid_outputs(i * s.d1, s.s1, s.p1, s.nv1, nh1, oh_first, oh_last);
+
+            for (size_t j = 0; j < s.nw2; ++j) {
+                size_t ow_first;
+                size_t ow_last;
+                valid_outputs(j * s.d2, s.s2, s.p2, s.nv2, nh2, ow_first, ow_last);
+
+                T sum(0);
+
+                for (size_t oh = oh_first; oh < oh_last; ++oh) {
+                    const size_t ih = oh * s.s1 + i * s.d1 - s.p1;
+
+                    for (size_t ow = ow_first; ow < ow_last; ++ow) {
+                        const size_t iw = ow * s.s2 + j * s.d2 - s.p2;
+
+                        sum += errors[oh * nh2 + ow] * in[ih * s.nv2 + iw];
+                    }
+                }
+
+                grad[i * s.nw2 + j] += sum;
+            }
+        }
+    }
+};
+
+} //end of dll namespace
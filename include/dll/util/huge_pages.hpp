@@ -0,0 +1,253 @@
+//=======================================================================
+// Copyright (c) 2014-2017 Baptiste Wicht
+// Distributed under the terms of the MIT License.
+// (See accompanying file LICENSE or copy at
+//  http://opensource.org/licenses/MIT)
+//=======================================================================
+
+/*!
+ * \file
+ * \brief Huge pages for the large buffers of DLL
+ *
+ * The large buffers owned by DLL (flat storage of the gradients and of the
+ * updater state) are allocated 2MB-aligned, directly from the kernel, and
+ * backed by transparent huge pages (MADV_HUGEPAGE) or by explicit hugetlb
+ * pages (MAP_HUGETLB), following the execution policy.
+ *
+ * The large buffers allocated by ETL (generator caches, contexts,
+ * weights) are advised to use transparent huge pages: the pages not yet
+ * touched are directly allocated as huge pages, the others are collapsed
+ * by the kernel in the background.
+ *
+ * Huge pages are only supported on Linux, they do nothing elsewhere.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+#include "etl/etl.hpp"
+
+#include "dll/util/affinity.hpp"
+#include "dll/util/memory.hpp"
+
+namespace dll {
+
+constexpr size_t huge_page_size = 2 * 1024 * 1024; ///< The size of a huge page
+
+/*!
+ * \brief Indicates if a buffer of the given size must use huge pages
+ */
+inline bool use_huge_pages(size_t bytes) {
+    return execution().huge_pages && bytes >= execution().huge_pages;
+}
+
+/*!
+ * \brief Advise the kernel to back the given memory with transparent huge
+ * pages, if it is large enough for the execution policy.
+ *
+ * Only the 2MB-aligned part of the memory is advised.
+ *
+ * \param memory The memory
+ * \param bytes The number of bytes of the memory
+ * \return true if the memory has been advised, false otherwise
+ */
+inline bool advise_huge_pages(const void* memory, size_t bytes) {
+#ifdef __linux__
+    if (!memory || !use_huge_pages(bytes)) {
+        return false;
+    }
+
+    const auto address = reinterpret_cast<std::uintptr_t>(memory);
+    const auto first   = (address + huge_page_size - 1) & ~std::uintptr_t(huge_page_size - 1);
+    const auto last    = (address + bytes) & ~std::uintptr_t(huge_page_size - 1);
+
+    if (last <= first) {
+        return false;
+    }
+
+    return madvise(reinterpret_cast<void*>(first), last - first, MADV_HUGEPAGE) == 0;
+#else
+    cpp_unused(memory);
+    cpp_unused(bytes);
+
+    return false;
+#endif
+}
+
+/*!
+ * \brief Advise the kernel to back the large buffers held by the given
+ * values with transparent huge pages.
+ *
+ * The ETL containers advise their elements, the standard containers,
+ * tuples and smart pointers advise what they hold and the types with a
+ * buffers() function advise what it returns. Everything else is ignored.
+ */
+template <typename T>
+void advise_huge_pages(const T& value) {
+    if constexpr (etl::is_etl_expr<T>) {
+        if constexpr (etl::is_dma<T>) {
+            advise_huge_pages(value.memory_start(), etl::size(value) * sizeof(etl::value_t<T>));
+        }
+    } else if constexpr (memory_detail::is_vector<T>::value) {
+        if constexpr (std::is_arithmetic<typename T::value_type>::value) {
+            advise_huge_pages(value.data(), value.size() * sizeof(typename T::value_type));
+        } else {
+            for (auto& v : value) {
+                advise_huge_pages(v);
+            }
+        }
+    } else if constexpr (memory_detail::is_tuple<T>::value) {
+        std::apply([](auto&... v) { (advise_huge_pages(v), ...); }, value);
+    } else if constexpr (memory_detail::is_pointer<T>::value) {
+        if (value) {
+            advise_huge_pages(*value);
+        }
+    } else if constexpr (memory_detail::has_buffers<T>::value) {
+        advise_huge_pages(value.buffers());
+    }
+}
+
+/*!
+ * \brief A buffer of n values allocated with huge pages when it is large
+ * enough for the execution policy, and from the heap otherwise. The values
+ * are zero-initialized.
+ */
+template <typename T>
+struct huge_buffer {
+    static_assert(std::is_trivial<T>::value, "huge_buffer only holds trivial values");
+
+    huge_buffer() = default;
+
+    /*!
+     * \brief Allocate a buffer of n values
+     */
+    explicit huge_buffer(size_t n) {
+        const size_t bytes = n * sizeof(T);
+
+#ifdef __linux__
+        if (use_huge_pages(bytes)) {
+            mapped = (bytes + huge_page_size - 1) & ~(huge_page_size - 1);
+
+            if (execution().hugetlb) {
+                void* ptr = mmap(nullptr, mapped, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+
+                if (ptr != MAP_FAILED) {
+                    memory = static_cast<T*>(ptr);
+                    return;
+                }
+            }
+
+            // Over-allocate to keep only a 2MB-aligned region
+            void* ptr = mmap(nullptr, mapped + huge_page_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+            if (ptr != MAP_FAILED) {
+                const auto address = reinterpret_cast<std::uintptr_t>(ptr);
+                const auto aligned = (address + huge_page_size - 1) & ~std::uintptr_t(huge_page_size - 1);
+
+                if (aligned > address) {
+                    munmap(ptr, aligned - address);
+                }
+
+                if (address + huge_page_size > aligned) {
+                    munmap(reinterpret_cast<void*>(aligned + mapped), address + huge_page_size - aligned);
+                }
+
+                memory = reinterpret_cast<T*>(aligned);
+
+                madvise(memory, mapped, MADV_HUGEPAGE);
+
+                return;
+            }
+
+            mapped = 0;
+        }
+#endif
+
+        heap   = std::make_unique<T[]>(n);
+        memory = heap.get();
+    }
+
+    huge_buffer(const huge_buffer& rhs) = delete;
+    huge_buffer& operator=(const huge_buffer& rhs) = delete;
+
+    huge_buffer(huge_buffer&& rhs) noexcept : memory(rhs.memory), mapped(rhs.mapped), heap(std::move(rhs.heap)) {
+        rhs.memory = nullptr;
+        rhs.mapped = 0;
+    }
+
+    huge_buffer& operator=(huge_buffer&& rhs) noexcept {
+        if (this != &rhs) {
+            release();
+
+            memory = rhs.memory;
+            mapped = rhs.mapped;
+            heap   = std::move(rhs.heap);
+
+            rhs.memory = nullptr;
+            rhs.mapped = 0;
+        }
+
+        return *this;
+    }
+
+    /*!
+     * \brief Release the buffer
+     */
+    ~huge_buffer() {
+        release();
+    }
+
+    /*!
+     * \brief Returns a pointer to the values of the buffer
+     */
+    T* get() const noexcept {
+        return memory;
+    }
+
+    /*!
+     * \brief Indicates if the buffer is allocated
+     */
+    explicit operator bool() const noexcept {
+        return memory;
+    }
+
+    /*!
+     * \brief Indicates if the buffer is backed by huge pages
+     */
+    bool huge() const noexcept {
+        return mapped;
+    }
+
+private:
+    /*!
+     * \brief Release the memory of the buffer
+     */
+    void release() {
+#ifdef __linux__
+        if (mapped) {
+            munmap(memory, mapped);
+        }
+#endif
+
+        heap.reset();
+
+        memory = nullptr;
+        mapped = 0;
+    }
+
+    T* memory     = nullptr;   ///< The values
+    size_t mapped = 0;         ///< The number of bytes mapped from the kernel (0 if from the heap)
+    std::unique_ptr<T[]> heap; ///< The values allocated from the heap
+};
+
+} //end of dll namespace
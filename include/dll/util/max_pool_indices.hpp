@@ -0,0 +1,199 @@
+//=======================================================================
+// Copyright (c) 2014-2017 Baptiste Wicht
+// Distributed under the terms of the MIT License.
+// (See accompanying file LICENSE or copy at
+//  http://opensource.org/licenses/MIT)
+//=======================================================================
+
+/*!
+ * \file
+ * \brief Max pooling kernels recording the position of the max of each
+ * pooling window
+ *
+ * The position of the max is stored as one byte per output, its index
+ * inside the pooling window. The backward pass is then a scatter of the
+ * errors to these positions and does not read the input again.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+namespace dll {
+
+/*!
+ * \brief The maximum number of values of a pooling window with max pooling
+ * indices
+ */
+constexpr size_t max_pool_indices_window = 256;
+
+/*!
+ * \brief Max pooling (2D) of N planes of I2xI3, recording the position of
+ * the max of each C1xC2 window
+ *
+ * The windows are taken with a stride of S1xS2 in the input padded with
+ * P1xP2. The padding is never part of the max.
+ *
+ * \param in The input (N x I2 x I3)
+ * \param out The output (N x O2 x O3)
+ * \param indices The positions of the max (N x O2 x O3)
+ */
+template <typename T>
+void max_pool_2d_forward_indices(const T* in, T* out, uint8_t* indices, size_t N, size_t I2, size_t I3, size_t C1, size_t C2,
+                                 size_t S1, size_t S2, size_t P1, size_t P2) {
+    const size_t O2 = (I2 - C1 + 2 * P1) / S1 + 1;
+    const size_t O3 = (I3 - C2 + 2 * P2) / S2 + 1;
+
+    for (size_t n = 0; n < N; ++n) {
+        const T* plane = in + n * I2 * I3;
+
+        for (size_t j = 0; j < O2; ++j) {
+            for (size_t k = 0; k < O3; ++k) {
+                T max       = std::numeric_limits<T>::lowest();
+                uint8_t pos = 0;
+
+                for (size_t a = 0; a < C1; ++a) {
+                    const size_t y = j * S1 + a;
+
+                    if (y < P1 || y - P1 >= I2) {
+                        continue;
+                    }
+
+                    for (size_t b = 0; b < C2; ++b) {
+                        const size_t x = k * S2 + b;
+
+                        if (x >= P2 && x - P2 < I3 && plane[(y - P1) * I3 + x - P2] > max) {
+                            max = plane[(y - P1) * I3 + x - P2];
+                            pos = uint8_t(a * C2 + b);
+                        }
+                    }
+                }
+
+                const size_t o = (n * O2 + j) * O3 + k;
+
+                out[o]     = max;
+                indices[o] = pos;
+            }
+        }
+    }
+}
+
+/*!
+ * \brief Backpropagate the errors of a max pooling (2D) to the recorded
+ * positions of the max
+ *
+ * The errors of overlapping windows are accumulated.
+ *
+ * \param errors The errors of the output (N x O2 x O3)
+ * \param indices The positions of the max (N x O2 x O3)
+ * \param out The errors of the input (N x I2 x I3)
+ */
+template <typename T>
+void max_pool_2d_backward_indices(const T* errors, const uint8_t* indices, T* out, size_t N, size_t I2, size_t I3, size_t C1, size_t C2,
+                                  size_t S1, size_t S2, size_t P1, size_t P2) {
+    const size_t O2 = (I2 - C1 + 2 * P1) / S1 + 1;
+    const size_t O3 = (I3 - C2 + 2 * P2) / S2 + 1;
+
+    std::fill_n(out, N * I2 * I3, T(0));
+
+    for (size_t n = 0; n < N; ++n) {
+        T* plane = out + n * I2 * I3;
+
+        for (size_t j = 0; j < O2; ++j) {
+            for (size_t k = 0; k < O3; ++k) {
+                const size_t o = (n * O2 + j) * O3 + k;
+
+                const size_t a = indices[o] / C2;
+                const size_t b = indices[o] % C2;
+
+                plane[(j * S1 + a - P1) * I3 + k * S2 + b - P2] += errors[o];
+            }
+        }
+    }
+}
+
+/*!
+ * \brief Max pooling (3D) of N volumes of I1xI2xI3, recording the position
+ * of the max of each C1xC2xC3 window
+ * \param in The input (N x I1 x I2 x I3)
+ * \param out The output (N x I1/C1 x I2/C2 x I3/C3)
+ * \param indices The positions of the max (N x I1/C1 x I2/C2 x I3/C3)
+ */
+template <typename T>
+void max_pool_3d_forward_indices(const T* in, T* out, uint8_t* indices, size_t N, size_t I1, size_t I2, size_t I3, size_t C1, size_t C2, size_t C3) {
+    const size_t O1 = I1 / C1;
+    const size_t O2 = I2 / C2;
+    const size_t O3 = I3 / C3;
+
+    for (size_t n = 0; n < N; ++n) {
+        const T* volume = in + n * I1 * I2 * I3;
+
+        for (size_t i = 0; i < O1; ++i) {
+            for (size_t j = 0; j < O2; ++j) {
+                for (size_t k = 0; k < O3; ++k) {
+                    const T* window = volume + (i * C1 * I2 + j * C2) * I3 + k * C3;
+
+                    T max       = window[0];
+                    uint8_t pos = 0;
+
+                    for (size_t a = 0; a < C1; ++a) {
+                        for (size_t b = 0; b < C2; ++b) {
+                            for (size_t c = 0; c < C3; ++c) {
+                                const T v = window[(a * I2 + b) * I3 + c];
+
+                                if (v > max) {
+                                    max = v;
+                                    pos = uint8_t((a * C2 + b) * C3 + c);
+                                }
+                            }
+                        }
+                    }
+
+                    const size_t o = ((n * O1 + i) * O2 + j) * O3 + k;
+
+                    out[o]     = max;
+                    indices[o] = pos;
+                }
+            }
+        }
+    }
+}
+
+/*!
+ * \brief Backpropagate the errors of a max pooling (3D) to the recorded
+ * positions of the max
+ * \param errors The errors of the output (N x I1/C1 x I2/C2 x I3/C3)
+ * \param indices The positions of the max (N x I1/C1 x I2/C2 x I3/C3)
+ * \param out The errors of the input (N x I1 x I2 x I3)
+ */
+template <typename T>
+void max_pool_3d_backward_indices(const T* errors, const uint8_t* indices, T* out, size_t N, size_t I1, size_t I2, size_t I3, size_t C1, size_t C2, size_t C3) {
+    const size_t O1 = I1 / C1;
+    const size_t O2 = I2 / C2;
+    const size_t O3 = I3 / C3;
+
+    std::fill_n(out, N * I1 * I2 * I3, T(0));
+
+    for (size_t n = 0; n < N; ++n) {
+        T* volume = out + n * I1 * I2 * I3;
+
+        for (size_t i = 0; i < O1; ++i) {
+            for (size_t j = 0; j < O2; ++j) {
+                for (size_t k = 0; k < O3; ++k) {
+                    const size_t o = ((n * O1 + i) * O2 + j) * O3 + k;
+
+                    const size_t a = indices[o] / (C2 * C3);
+                    const size_t b = (indices[o] / C3) % C2;
+                    const size_t c = indices[o] % C3;
+
+                    volume[((i * C1 + a) * I2 + j * C2 + b) * I3 + k * C3 + c] = errors[o];
+                }
+            }
+        }
+    }
+}
+
+} //end of dll namespace
@@ -0,0 +1,201 @@
+//=======================================================================
+// Copyright (c) 2014-2017 Baptiste Wicht
+// Distributed under the terms of the MIT License.
+// (See accompanying file LICENSE or copy at
+//  http://opensource.org/licenses/MIT)
+//=======================================================================
+
+/*!
+ * \file
+ * \brief Accounting of the memory held by the layers, the trainers and the
+ * generators
+ */
+
+#pragma once
+
+#include <memory>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "etl/etl.hpp"
+
+#include "dll/util/timers.hpp" // for to_string_precision
+
+namespace dll {
+
+namespace memory_detail {
+
+template <typename T>
+struct is_vector : std::false_type {};
+
+template <typename T, typename A>
+struct is_vector<std::vector<T, A>> : std::true_type {};
+
+template <typename T>
+struct is_tuple : std::false_type {};
+
+template <typename... T>
+struct is_tuple<std::tuple<T...>> : std::true_type {};
+
+template <typename T1, typename T2>
+struct is_tuple<std::pair<T1, T2>> : std::true_type {};
+
+template <typename T>
+struct is_pointer : std::false_type {};
+
+template <typename T, typename D>
+struct is_pointer<std::unique_ptr<T, D>> : std::true_type {};
+
+template <typename T>
+struct is_pointer<std::shared_ptr<T>> : std::true_type {};
+
+template <typename T, typename Enable = void>
+struct has_memory : std::false_type {};
+
+template <typename T>
+struct has_memory<T, std::void_t<decltype(std::declval<const T&>().memory())>> : std::true_type {};
+
+template <typename T, typename Enable = void>
+struct has_buffers : std::false_type {};
+
+template <typename T>
+struct has_buffers<T, std::void_t<decltype(std::declval<const T&>().buffers())>> : std::true_type {};
+
+} //end of namespace memory_detail
+
+/*!
+ * \brief Returns the number of bytes of the elements held by the given
+ * values.
+ *
+ * ETL containers count their elements, the standard containers, tuples
+ * and smart pointers count the bytes of what they hold and the types with
+ * a memory() function count what it returns. Everything else is ignored.
+ */
+template <typename... T>
+size_t memory_bytes(const T&... values);
+
+/*!
+ * \copydoc memory_bytes
+ */
+template <typename T>
+size_t memory_bytes(const T& value) {
+    if constexpr (etl::is_etl_expr<T>) {
+        return etl::size(value) * sizeof(etl::value_t<T>);
+    } else if constexpr (memory_detail::has_memory<T>::value) {
+        return value.memory();
+    } else if constexpr (memory_detail::is_vector<T>::value) {
+        using value_type = typename T::value_type;
+
+        if constexpr (std::is_arithmetic<value_type>::value) {
+            return value.size() * sizeof(value_type);
+        } else {
+            size_t bytes = 0;
+
+            for (auto& v : value) {
+                bytes += memory_bytes(v);
+            }
+
+            return bytes;
+        }
+    } else if constexpr (memory_detail::is_tuple<T>::value) {
+        return std::apply([](auto&... v) { return memory_bytes(v...); }, value);
+    } else if constexpr (memory_detail::is_pointer<T>::value) {
+        return value ? memory_bytes(*value) : 0;
+    } else {
+        return 0;
+    }
+}
+
+template <typename... T>
+size_t memory_bytes(const T&... values) {
+    return (size_t(0) + ... + memory_bytes(values));
+}
+
+/*!
+ * \brief Returns a human-readable representation of the given number of
+ * bytes
+ */
+inline std::string memory_str(size_t bytes) {
+    if (bytes >= 1024UL * 1024 * 1024) {
+        return to_string_precision(bytes / (1024.0 * 1024 * 1024), 3) + "GB";
+    } else if (bytes >= 1024UL * 1024) {
+        return to_string_precision(bytes / (1024.0 * 1024), 3) + "MB";
+    } else if (bytes >= 1024UL) {
+        return to_string_precision(bytes / 1024.0, 3) + "KB";
+    } else {
+        return std::to_string(bytes) + "B";
+    }
+}
+
+/*!
+ * \brief The memory held by one layer during the training
+ */
+struct layer_memory {
+    size_t parameters = 0; ///< The parameters of the layer
+    size_t context    = 0; ///< The inputs, outputs and errors of the layer
+    size_t updater    = 0; ///< The gradients and the state of the updater
+
+    /*!
+     * \brief Returns the total memory of the layer
+     */
+    size_t total() const {
+        return parameters + context + updater;
+    }
+};
+
+/*!
+ * \brief The memory held by a network and its training
+ */
+struct memory_report {
+    std::vector<layer_memory> layers; ///< The memory of each layer
+    size_t trainer   = 0;             ///< The other buffers of the trainer (micro-batches, accumulation, staging, ...)
+    size_t generator = 0;             ///< The caches of the generators
+
+    /*!
+     * \brief Indicates if the report is empty (no training was accounted)
+     */
+    bool empty() const {
+        return layers.empty();
+    }
+
+    /*!
+     * \brief Returns the memory of all the layers together
+     */
+    layer_memory layers_total() const {
+        layer_memory sum;
+
+        for (auto& layer : layers) {
+            sum.parameters += layer.parameters;
+            sum.context += layer.context;
+            sum.updater += layer.updater;
+        }
+
+        return sum;
+    }
+
+    /*!
+     * \brief Returns the total memory of the report
+     */
+    size_t total() const {
+        return layers_total().total() + trainer + generator;
+    }
+
+    /*!
+     * \brief Print the report on one line to the given stream
+     */
+    void dump(std::ostream& os) const {
+        auto sum = layers_total();
+
+        os << "memory: " << memory_str(total())
+           << " (parameters " << memory_str(sum.parameters)
+           << ", contexts " << memory_str(sum.context)
+           << ", updater " << memory_str(sum.updater)
+           << ", trainer " << memory_str(trainer)
+           << ", generators " << memory_str(generator) << ")" << std::endl;
+    }
+};
+
+} //end of dll namespace
@@ -0,0 +1,259 @@
+//=======================================================================
+// Copyright (c) 2014-2017 Baptiste Wicht
+// Distributed under the terms of the MIT License.
+// (See accompanying file LICENSE or copy at
+//  http://opensource.org/licenses/MIT)
+//=======================================================================
+
+/*!
+ * \file
+ * \brief Packed model files, loaded through a memory mapping.
+ *
+ * The packed model format is a fixed-size header followed by a table of
+ * records (offset, length and checksum) and then by the records
+ * themselves, each aligned on a cache line. The data of the records
+ * starts on a page. Each record holds the weights of one layer.
+ */
+
+#pragma once
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <streambuf>
+#include <string>
+#include <vector>
+
+namespace dll {
+
+/*!
+ * \brief The header of a packed model file
+ */
+struct packed_model_header {
+    static constexpr uint32_t file_magic   = 0x444C4C4D; ///< The magic number ("DLLM")
+    static constexpr uint32_t file_version = 1;          ///< The current version of the format
+    static constexpr size_t data_alignment = 4096;       ///< The alignment of the data section
+    static constexpr size_t alignment      = 64;         ///< The alignment of each record
+
+    uint32_t magic;       ///< The magic number
+    uint32_t version;     ///< The version of the format
+    uint32_t weight_size; ///< The size of one value (in bytes)
+    uint32_t records;     ///< The number of records
+    uint64_t length;      ///< The total length of the file
+};
+
+/*!
+ * \brief An entry of the table of records of a packed model file
+ */
+struct packed_model_record {
+    uint64_t offset;   ///< The offset of the record from the start of the file
+    uint64_t length;   ///< The length of the record (in bytes)
+    uint64_t checksum; ///< The checksum of the record
+};
+
+/*!
+ * \brief Compute the checksum (64-bit FNV-1a) of the given bytes
+ * \param data The first byte
+ * \param n The number of bytes
+ * \return The checksum of the bytes
+ */
+inline uint64_t packed_model_checksum(const char* data, size_t n) {
+    uint64_t hash = 0xcbf29ce484222325ULL;
+
+    for (size_t i = 0; i < n; ++i) {
+        hash ^= uint64_t(static_cast<unsigned char>(data[i]));
+        hash *= 0x100000001b3ULL;
+    }
+
+    return hash;
+}
+
+/*!
+ * \brief Write a packed model file from the given records
+ * \param path The path to the file to write
+ * \param records The content of each record
+ * \param weight_size The size of one value of the model (in bytes)
+ * \param magic The magic number of the file
+ * \return true if the file was written, false otherwise
+ */
+inline bool write_packed_model(const std::string& path, const std::vector<std::string>& records, size_t weight_size, uint32_t magic = packed_model_header::file_magic) {
+    auto align = [](size_t v, size_t a) { return (v + a - 1) / a * a; };
+
+    std::vector<packed_model_record> table(records.size());
+
+    size_t offset = align(sizeof(packed_model_header) + records.size() * sizeof(packed_model_record), packed_model_header::data_alignment);
+
+    for (size_t r = 0; r < records.size(); ++r) {
+        table[r].offset   = offset;
+        table[r].length   = records[r].size();
+        table[r].checksum = packed_model_checksum(records[r].data(), records[r].size());
+
+        offset = align(offset + records[r].size(), packed_model_header::alignment);
+    }
+
+    packed_model_header header;
+    std::memset(&header, 0, sizeof(header));
+
+    header.magic       = magic;
+    header.version     = packed_model_header::file_version;
+    header.weight_size = weight_size;
+    header.records     = records.size();
+    header.length      = offset;
+
+    std::vector<char> buffer(offset, 0);
+
+    std::memcpy(buffer.data(), &header, sizeof(header));
+    std::memcpy(buffer.data() + sizeof(header), table.data(), table.size() * sizeof(packed_model_record));
+
+    for (size_t r = 0; r < records.size(); ++r) {
+        std::memcpy(buffer.data() + table[r].offset, records[r].data(), records[r].size());
+    }
+
+    std::ofstream os(path, std::ios::binary);
+
+    if (!os) {
+        std::cerr << "ERROR: Impossible to write packed model to " << path << std::endl;
+        return false;
+    }
+
+    os.write(buffer.data(), buffer.size());
+
+    return bool(os);
+}
+
+/*!
+ * \brief A read-only stream buffer on a range of memory, to read a record
+ * without copying it first.
+ */
+struct packed_record_buffer : std::streambuf {
+    /*!
+     * \brief Create a stream buffer on the given range
+     * \param data The first byte
+     * \param n The number of bytes
+     */
+    packed_record_buffer(const char* data, size_t n) {
+        // The buffer is only used for reading
+        char* first = const_cast<char*>(data);
+        setg(first, first, first + n);
+    }
+};
+
+/*!
+ * \brief A read-only memory mapping of a packed model file
+ */
+struct packed_model_file {
+    int fd        = -1;      ///< The file descriptor
+    void* mapping = nullptr; ///< The start of the mapping
+    size_t length = 0;       ///< The length of the mapping
+
+    std::vector<packed_model_record> table; ///< The table of records
+
+    /*!
+     * \brief Map the given file in memory and validate its records
+     * \param path The path to the packed model
+     * \param weight_size The expected size of one value (in bytes)
+     * \param magic The expected magic number of the file
+     */
+    packed_model_file(const std::string& path, size_t weight_size, uint32_t magic = packed_model_header::file_magic) {
+        fd = ::open(path.c_str(), O_RDONLY);
+
+        if (fd < 0) {
+            std::cerr << "ERROR: Impossible to open packed model " << path << std::endl;
+            return;
+        }
+
+        struct stat st;
+
+        packed_model_header header;
+
+        if (::fstat(fd, &st) < 0 || size_t(st.st_size) < sizeof(header)
+                || ::pread(fd, &header, sizeof(header), 0) != ssize_t(sizeof(header))
+                || header.magic != magic
+                || header.version != packed_model_header::file_version
+                || header.weight_size != weight_size
+                || header.length != size_t(st.st_size)) {
+            std::cerr << "ERROR: Incompatible packed model " << path << std::endl;
+            return;
+        }
+
+        length  = st.st_size;
+        mapping = ::mmap(nullptr, length, PROT_READ, MAP_SHARED, fd, 0);
+
+        if (mapping == MAP_FAILED) {
+            std::cerr << "ERROR: Impossible to map packed model " << path << std::endl;
+            mapping = nullptr;
+            return;
+        }
+
+        ::madvise(mapping, length, MADV_WILLNEED);
+
+        const char* base = static_cast<const char*>(mapping);
+
+        if (sizeof(header) + header.records * sizeof(packed_model_record) > length) {
+            std::cerr << "ERROR: Truncated packed model " << path << std::endl;
+            ::munmap(mapping, length);
+            mapping = nullptr;
+            return;
+        }
+
+        table.resize(header.records);
+        std::memcpy(table.data(), base + sizeof(header), table.size() * sizeof(packed_model_record));
+
+        for (auto& record : table) {
+            if (record.offset + record.length > length || packed_model_checksum(base + record.offset, record.length) != record.checksum) {
+                std::cerr << "ERROR: Corrupted packed model " << path << std::endl;
+                table.clear();
+                ::munmap(mapping, length);
+                mapping = nullptr;
+                return;
+            }
+        }
+    }
+
+    packed_model_file(const packed_model_file& rhs) = delete;
+    packed_model_file& operator=(const packed_model_file& rhs) = delete;
+
+    /*!
+     * \brief Unmap the file
+     */
+    ~packed_model_file() {
+        if (mapping) {
+            ::munmap(mapping, length);
+        }
+
+        if (fd >= 0) {
+            ::close(fd);
+        }
+    }
+
+    /*!
+     * \brief Indicates if the file has been mapped and validated
+     */
+    bool valid() const {
+        return mapping != nullptr;
+    }
+
+    /*!
+     * \brief Returns the number of records of the file
+     */
+    size_t records() const {
+        return table.size();
+    }
+
+    /*!
+     * \brief Returns a stream buffer reading the given record directly in
+     * the mapping
+     * \param r The index of the record
+     */
+    packed_record_buffer record(size_t r) const {
+        return {static_cast<const char*>(mapping) + table[r].offset, table[r].length};
+    }
+};
+
+} //end of dll namespace
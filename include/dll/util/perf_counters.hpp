@@ -0,0 +1,238 @@
+//=======================================================================
+// Copyright (c) 2014-2017 Baptiste Wicht
+// Distributed under the terms of the MIT License.
+// (See accompanying file LICENSE or copy at
+//  http://opensource.org/licenses/MIT)
+//=======================================================================
+
+/*!
+ * \file
+ * \brief Sampling of the hardware performance counters of the threads
+ *
+ * The counters are read with perf_event_open, one group of counters per
+ * thread, counting in user space only. They are only supported on Linux
+ * and depend on the kernel.perf_event_paranoid setting (at most 2).
+ *
+ * There is no generic event for the floating point operations, they are
+ * only counted if the DLL_PERF_FP_EVENT environment variable contains the
+ * raw (hexadecimal) event of the processor, for instance 0x5301c7 for
+ * FP_ARITH_INST_RETIRED.SCALAR_SINGLE on recent Intel processors.
+ */
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace dll {
+
+/*!
+ * \brief The hardware events sampled by the counters
+ */
+enum perf_counter : size_t {
+    PERF_CYCLES         = 0, ///< The number of cycles
+    PERF_INSTRUCTIONS   = 1, ///< The number of retired instructions
+    PERF_LLC_REFERENCES = 2, ///< The number of accesses to the last level cache
+    PERF_LLC_MISSES     = 3, ///< The number of misses of the last level cache
+    PERF_FP_OPS         = 4  ///< The number of floating point operations (DLL_PERF_FP_EVENT)
+};
+
+constexpr size_t perf_events = 5; ///< The number of sampled events
+
+using perf_values = std::array<size_t, perf_events>; ///< The values of the counters
+
+namespace perf_detail {
+
+/*!
+ * \brief The group of counters of one thread
+ */
+struct perf_group {
+    std::array<int, perf_events> fds;     ///< The descriptor of each counter (-1 if not available)
+    std::array<uint64_t, perf_events> ids; ///< The kernel id of each counter
+
+    /*!
+     * \brief Open the counters of the current thread
+     */
+    perf_group() {
+        fds.fill(-1);
+        ids.fill(0);
+
+#ifdef __linux__
+        open_counter(PERF_CYCLES, PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+
+        if (fds[PERF_CYCLES] < 0) {
+            return;
+        }
+
+        open_counter(PERF_INSTRUCTIONS, PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+        open_counter(PERF_LLC_REFERENCES, PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_REFERENCES);
+        open_counter(PERF_LLC_MISSES, PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+
+        if (auto* fp = std::getenv("DLL_PERF_FP_EVENT")) {
+            open_counter(PERF_FP_OPS, PERF_TYPE_RAW, std::strtoull(fp, nullptr, 16));
+        }
+
+        ioctl(fds[PERF_CYCLES], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+        ioctl(fds[PERF_CYCLES], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+#endif
+    }
+
+    perf_group(const perf_group& rhs) = delete;
+    perf_group& operator=(const perf_group& rhs) = delete;
+
+    /*!
+     * \brief Close the counters
+     */
+    ~perf_group() {
+#ifdef __linux__
+        for (auto fd : fds) {
+            if (fd >= 0) {
+                close(fd);
+            }
+        }
+#endif
+    }
+
+    /*!
+     * \brief Indicates if the counters of the thread are available
+     */
+    bool available() const noexcept {
+        return fds[PERF_CYCLES] >= 0;
+    }
+
+    /*!
+     * \brief Read the current values of the counters, with a single system
+     * call for the whole group
+     * \param values The values to fill, 0 for the unavailable events
+     * \return true if the counters have been read, false otherwise
+     */
+    bool read_values(perf_values& values) const {
+        values.fill(0);
+
+#ifdef __linux__
+        if (!available()) {
+            return false;
+        }
+
+        // nr, then one (value, id) pair per counter
+        uint64_t buffer[1 + 2 * perf_events];
+
+        if (::read(fds[PERF_CYCLES], buffer, sizeof(buffer)) <= 0) {
+            return false;
+        }
+
+        for (size_t i = 0; i < buffer[0] && i < perf_events; ++i) {
+            for (size_t e = 0; e < perf_events; ++e) {
+                if (fds[e] >= 0 && ids[e] == buffer[2 + 2 * i]) {
+                    values[e] = buffer[1 + 2 * i];
+                }
+            }
+        }
+
+        return true;
+#else
+        return false;
+#endif
+    }
+
+private:
+#ifdef __linux__
+    /*!
+     * \brief Open the counter of the given event, in the group of the
+     * cycles counter
+     */
+    void open_counter(size_t event, uint32_t type, uint64_t config) {
+        perf_event_attr attr;
+        std::memset(&attr, 0, sizeof(attr));
+
+        attr.size           = sizeof(attr);
+        attr.type           = type;
+        attr.config         = config;
+        attr.disabled       = event == PERF_CYCLES;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv     = 1;
+        attr.read_format    = PERF_FORMAT_GROUP | PERF_FORMAT_ID;
+
+        const int fd = syscall(SYS_perf_event_open, &attr, 0, -1, event == PERF_CYCLES ? -1 : fds[PERF_CYCLES], 0);
+
+        if (fd >= 0) {
+            fds[event] = fd;
+            ioctl(fd, PERF_EVENT_IOC_ID, &ids[event]);
+        }
+    }
+#endif
+};
+
+/*!
+ * \brief Returns the group of counters of the current thread, opened on
+ * first use
+ */
+inline const perf_group& local_group() {
+    thread_local perf_group group;
+    return group;
+}
+
+/*!
+ * \brief Returns the flag indicating if the counters are sampled
+ */
+inline std::atomic<bool>& sampling() {
+    static std::atomic<bool> flag{false};
+    return flag;
+}
+
+} //end of namespace perf_detail
+
+/*!
+ * \brief Start sampling the hardware performance counters in the timers.
+ *
+ * Each timer then accumulates the counters of its thread between its
+ * start and its end, reported by dump_timers_pretty().
+ *
+ * \return true if the counters are available, false otherwise
+ */
+inline bool enable_perf_counters() {
+    if (!perf_detail::local_group().available()) {
+        std::cerr << "ERROR: The hardware performance counters are not available (check kernel.perf_event_paranoid)" << std::endl;
+        return false;
+    }
+
+    perf_detail::sampling() = true;
+
+    return true;
+}
+
+/*!
+ * \brief Stop sampling the hardware performance counters in the timers.
+ */
+inline void disable_perf_counters() {
+    perf_detail::sampling() = false;
+}
+
+/*!
+ * \brief Indicates if the hardware performance counters are sampled
+ */
+inline bool perf_counters_enabled() {
+    return perf_detail::sampling().load(std::memory_order_relaxed);
+}
+
+/*!
+ * \brief Read the hardware performance counters of the current thread
+ * \param values The values to fill
+ * \return true if the counters have been read, false otherwise
+ */
+inline bool read_perf_counters(perf_values& values) {
+    return perf_detail::local_group().read_values(values);
+}
+
+} //end of dll namespace
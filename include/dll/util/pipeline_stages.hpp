@@ -0,0 +1,237 @@
+//=======================================================================
+// Copyright (c) 2014-2017 Baptiste Wicht
+// Distributed under the terms of the MIT License.
+// (See accompanying file LICENSE or copy at
+//  http://opensource.org/licenses/MIT)
+//=======================================================================
+
+/*!
+ * \file
+ * \brief Threads and synchronization of the stages of pipeline-parallel
+ * networks (model parallelism across groups of layers)
+ *
+ * Each stage owns a contiguous group of layers and is run by its own
+ * thread, pinned with execution().stages, so that the weights of its
+ * layers stay in the caches (or the NUMA node) of its cores. The
+ * micro-batches flow, in order, from one stage to the next.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <condition_variable>
+
+#include "etl/etl.hpp"
+
+#include "dll/util/affinity.hpp"
+
+namespace dll {
+
+/*!
+ * \brief Persistent threads running the stages of a pipeline, one thread
+ * per stage
+ */
+struct stage_workers {
+    /*!
+     * \brief Start the threads of the given number of stages
+     */
+    explicit stage_workers(size_t stages) : stages(stages) {
+        for (size_t s = 0; s < stages; ++s) {
+            threads.emplace_back([this, s] { work(s); });
+        }
+    }
+
+    stage_workers(const stage_workers& rhs) = delete;
+    stage_workers& operator=(const stage_workers& rhs) = delete;
+
+    /*!
+     * \brief Stop the threads
+     */
+    ~stage_workers() {
+        {
+            std::lock_guard<std::mutex> l(lock);
+            stop = true;
+        }
+
+        start_condition.notify_all();
+
+        for (auto& thread : threads) {
+            thread.join();
+        }
+    }
+
+    /*!
+     * \brief Returns the number of stages
+     */
+    size_t size() const noexcept {
+        return stages;
+    }
+
+    /*!
+     * \brief Run the functor on each stage, called with the index of the
+     * stage, and wait for all the stages to be done
+     */
+    template <typename Functor>
+    void run(Functor&& functor) {
+        std::unique_lock<std::mutex> l(lock);
+
+        task = std::ref(functor);
+        done = 0;
+
+        ++generation;
+
+        start_condition.notify_all();
+
+        done_condition.wait(l, [this] { return done == stages; });
+
+        task = nullptr;
+    }
+
+private:
+    /*!
+     * \brief The main loop of the thread of the stage s
+     */
+    void work(size_t s) {
+        pin_thread(execution().stages, s);
+
+        size_t seen = 0;
+
+        std::unique_lock<std::mutex> l(lock);
+
+        while (true) {
+            start_condition.wait(l, [this, seen] { return stop || generation != seen; });
+
+            if (stop) {
+                return;
+            }
+
+            seen = generation;
+
+            l.unlock();
+
+            // The threads of the pool of ETL are not used by the stages
+            SERIAL_SECTION {
+                task(s);
+            }
+
+            l.lock();
+
+            if (++done == stages) {
+                done_condition.notify_one();
+            }
+        }
+    }
+
+    const size_t stages;              ///< The number of stages
+    std::vector<std::thread> threads; ///< The thread of each stage
+
+    std::function<void(size_t)> task; ///< The task of the current run
+    size_t generation = 0;            ///< The index of the current run
+    size_t done       = 0;            ///< The number of stages done with the current run
+    bool stop         = false;        ///< Indicates if the threads must stop
+
+    std::mutex lock;                         ///< The lock protecting the runs
+    std::condition_variable start_condition; ///< The condition of the stages
+    std::condition_variable done_condition;  ///< The condition of the caller
+};
+
+/*!
+ * \brief The progress of the micro-batches through the stages of a
+ * pipeline: the number of micro-batches done by each stage.
+ */
+struct stage_progress {
+    /*!
+     * \brief Create the progress of the given number of stages
+     */
+    explicit stage_progress(size_t stages) : counts(stages, 0) {}
+
+    /*!
+     * \brief Reset the progress of all the stages
+     */
+    void reset() {
+        std::lock_guard<std::mutex> l(lock);
+        std::fill(counts.begin(), counts.end(), 0);
+    }
+
+    /*!
+     * \brief Mark one more micro-batch as done by the stage s
+     */
+    void publish(size_t s) {
+        {
+            std::lock_guard<std::mutex> l(lock);
+            ++counts[s];
+        }
+
+        condition.notify_all();
+    }
+
+    /*!
+     * \brief Wait for the stage s to be done with n micro-batches
+     */
+    void wait(size_t s, size_t n) {
+        std::unique_lock<std::mutex> l(lock);
+        condition.wait(l, [this, s, n] { return counts[s] >= n; });
+    }
+
+private:
+    std::vector<size_t> counts; ///< The number of micro-batches done by each stage
+
+    std::mutex lock;                   ///< The lock protecting the counts
+    std::condition_variable condition; ///< The condition of the waiting stages
+};
+
+/*!
+ * \brief Partition the layers in contiguous stages of balanced costs.
+ *
+ * Each stage has at least one layer.
+ *
+ * \param costs The cost of each layer (its number of parameters)
+ * \param stages The number of stages
+ *
+ * \return The stage of each layer
+ */
+inline std::vector<size_t> partition_stages(const std::vector<size_t>& costs, size_t stages) {
+    const size_t n = costs.size();
+
+    stages = std::max(size_t(1), std::min(stages, n));
+
+    double total = 0.0;
+
+    for (auto cost : costs) {
+        total += cost;
+    }
+
+    std::vector<size_t> stage_of(n, 0);
+
+    double prefix = 0.0;
+
+    for (size_t i = 0; i < n; ++i) {
+        // The stage of the middle of the layer in the cumulated costs
+        size_t s = total > 0.0 ? size_t((prefix + 0.5 * costs[i]) * stages / total) : i * stages / n;
+
+        s = std::min(s, stages - 1);
+
+        if (i) {
+            // The stages are contiguous, none of them is empty
+            s = std::max(s, stage_of[i - 1]);
+            s = std::min(s, stage_of[i - 1] + 1);
+        } else {
+            s = 0;
+        }
+
+        // Enough layers must remain for the next stages
+        s = std::max(s, (stages + i) > n ? stages + i - n : size_t(0));
+
+        stage_of[i] = s;
+
+        prefix += costs[i];
+    }
+
+    return stage_of;
+}
+
+} //end of dll namespace
@@ -0,0 +1,329 @@
+//=======================================================================
+// Copyright (c) 2014-2017 Baptiste Wicht
+// Distributed under the terms of the MIT License.
+// (See accompanying file LICENSE or copy at
+//  http://opensource.org/licenses/MIT)
+//=======================================================================
+
+/*!
+ * \file
+ * \brief Pooling kernels with strides and zero-padding, and global average
+ * pooling kernels
+ *
+ * The 2D kernels accumulate one window offset at a time into a complete
+ * output row. The innermost loop therefore runs over the output columns,
+ * without any branch, and is contiguous (and vectorized) with a stride of
+ * one. The padding is never part of the max and counts as zero in the
+ * averages.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <limits>
+
+#include "etl/etl.hpp"
+
+namespace dll {
+
+/*!
+ * \brief Compute the range of the outputs whose window has its offset b
+ * inside the input.
+ * \param b The offset inside the window
+ * \param I The dimension of the input
+ * \param O The dimension of the output
+ * \param S The stride
+ * \param P The padding
+ * \param first The first valid output
+ * \param last The end of the valid outputs
+ */
+inline void pool_valid_range(size_t b, size_t I, size_t O, size_t S, size_t P, size_t& first, size_t& last) {
+    first = b < P ? (P - b + S - 1) / S : 0;
+    last  = I + P > b ? std::min(O, (I + P - b - 1) / S + 1) : 0;
+    last  = std::max(first, last);
+}
+
+/*!
+ * \brief Max pooling (2D) of N planes of I2xI3 with C1xC2 windows
+ * \param in The input (N x I2 x I3)
+ * \param out The output (N x O2 x O3)
+ */
+template <typename T>
+void max_pool_2d_forward(const T* in, T* out, size_t N, size_t I2, size_t I3, size_t C1, size_t C2, size_t S1, size_t S2, size_t P1, size_t P2) {
+    const size_t O2 = (I2 - C1 + 2 * P1) / S1 + 1;
+    const size_t O3 = (I3 - C2 + 2 * P2) / S2 + 1;
+
+    std::fill_n(out, N * O2 * O3, std::numeric_limits<T>::lowest());
+
+    for (size_t n = 0; n < N; ++n) {
+        for (size_t j = 0; j < O2; ++j) {
+            T* out_row = out + (n * O2 + j) * O3;
+
+            for (size_t a = 0; a < C1; ++a) {
+                if (j * S1 + a < P1 || j * S1 + a - P1 >= I2) {
+                    continue;
+                }
+
+                const T* in_row = in + (n * I2 + j * S1 + a - P1) * I3;
+
+                for (size_t b = 0; b < C2; ++b) {
+                    size_t first;
+                    size_t last;
+                    pool_valid_range(b, I3, O3, S2, P2, first, last);
+
+                    for (size_t k = first; k < last; ++k) {
+                        out_row[k] = std::max(out_row[k], in_row[k * S2 + b - P2]);
+                    }
+                }
+            }
+        }
+    }
+}
+
+/*!
+ * \brief Backpropagate the errors of a max pooling (2D) to the max of each
+ * window, searched again in the input
+ * \param in The input (N x I2 x I3)
+ * \param out The output of the forward pass (N x O2 x O3)
+ * \param errors The errors of the output (N x O2 x O3)
+ * \param grad The errors of the input (N x I2 x I3)
+ */
+template <typename T>
+void max_pool_2d_backward(const T* in, const T* out, const T* errors, T* grad, size_t N, size_t I2, size_t I3, size_t C1, size_t C2, size_t S1, size_t S2, size_t P1, size_t P2) {
+    const size_t O2 = (I2 - C1 + 2 * P1) / S1 + 1;
+    const size_t O3 = (I3 - C2 + 2 * P2) / S2 + 1;
+
+    std::fill_n(grad, N * I2 * I3, T(0));
+
+    for (size_t n = 0; n < N; ++n) {
+        const T* in_plane = in + n * I2 * I3;
+        T* grad_plane     = grad + n * I2 * I3;
+
+        for (size_t j = 0; j < O2; ++j) {
+            for (size_t k = 0; k < O3; ++k) {
+                const size_t o = (n * O2 + j) * O3 + k;
+
+                // The first position of the max of the window gets the errors
+                bool found = false;
+
+                for (size_t a = 0; a < C1 && !found; ++a) {
+                    const size_t y = j * S1 + a;
+
+                    if (y < P1 || y - P1 >= I2) {
+                        continue;
+                    }
+
+                    for (size_t b = 0; b < C2 && !found; ++b) {
+                        const size_t x = k * S2 + b;
+
+                        if (x >= P2 && x - P2 < I3 && in_plane[(y - P1) * I3 + x - P2] == out[o]) {
+                            grad_plane[(y - P1) * I3 + x - P2] += errors[o];
+
+                            found = true;
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+/*!
+ * \brief Average pooling (2D) of N planes of I2xI3 with C1xC2 windows
+ * \param in The input (N x I2 x I3)
+ * \param out The output (N x O2 x O3)
+ */
+template <typename T>
+void avg_pool_2d_forward(const T* in, T* out, size_t N, size_t I2, size_t I3, size_t C1, size_t C2, size_t S1, size_t S2, size_t P1, size_t P2) {
+    const size_t O2 = (I2 - C1 + 2 * P1) / S1 + 1;
+    const size_t O3 = (I3 - C2 + 2 * P2) / S2 + 1;
+
+    const T scale = T(1) / T(C1 * C2);
+
+    std::fill_n(out, N * O2 * O3, T(0));
+
+    for (size_t n = 0; n < N; ++n) {
+        for (size_t j = 0; j < O2; ++j) {
+            T* out_row = out + (n * O2 + j) * O3;
+
+            for (size_t a = 0; a < C1; ++a) {
+                if (j * S1 + a < P1 || j * S1 + a - P1 >= I2) {
+                    continue;
+                }
+
+                const T* in_row = in + (n * I2 + j * S1 + a - P1) * I3;
+
+                for (size_t b = 0; b < C2; ++b) {
+                    size_t first;
+                    size_t last;
+                    pool_valid_range(b, I3, O3, S2, P2, first, last);
+
+                    for (size_t k = first; k < last; ++k) {
+                        out_row[k] += in_row[k * S2 + b - P2];
+                    }
+                }
+            }
+
+            for (size_t k = 0; k < O3; ++k) {
+                out_row[k] *= scale;
+            }
+        }
+    }
+}
+
+/*!
+ * \brief Backpropagate the errors of an average pooling (2D)
+ * \param errors The errors of the output (N x O2 x O3)
+ * \param grad The errors of the input (N x I2 x I3)
+ */
+template <typename T>
+void avg_pool_2d_backward(const T* errors, T* grad, size_t N, size_t I2, size_t I3, size_t C1, size_t C2, size_t S1, size_t S2, size_t P1, size_t P2) {
+    const size_t O2 = (I2 - C1 + 2 * P1) / S1 + 1;
+    const size_t O3 = (I3 - C2 + 2 * P2) / S2 + 1;
+
+    const T scale = T(1) / T(C1 * C2);
+
+    std::fill_n(grad, N * I2 * I3, T(0));
+
+    for (size_t n = 0; n < N; ++n) {
+        for (size_t j = 0; j < O2; ++j) {
+            const T* errors_row = errors + (n * O2 + j) * O3;
+
+            for (size_t a = 0; a < C1; ++a) {
+                if (j * S1 + a < P1 || j * S1 + a - P1 >= I2) {
+                    continue;
+                }
+
+                T* grad_row = grad + (n * I2 + j * S1 + a - P1) * I3;
+
+                for (size_t b = 0; b < C2; ++b) {
+                    size_t first;
+                    size_t last;
+                    pool_valid_range(b, I3, O3, S2, P2, first, last);
+
+                    for (size_t k = first; k < last; ++k) {
+                        grad_row[k * S2 + b - P2] += scale * errors_row[k];
+                    }
+                }
+            }
+        }
+    }
+}
+
+/*!
+ * \brief Global average pooling of N planes of M values
+ * \param in The input (N x M)
+ * \param out The output (N)
+ */
+template <typename T>
+void global_avg_pool_forward(const T* in, T* out, size_t N, size_t M) {
+    const T scale = T(1) / T(M);
+
+    for (size_t n = 0; n < N; ++n) {
+        const T* plane = in + n * M;
+
+        T sum = 0;
+
+        for (size_t m = 0; m < M; ++m) {
+            sum += plane[m];
+        }
+
+        out[n] = scale * sum;
+    }
+}
+
+/*!
+ * \brief Backpropagate the errors of a global average pooling
+ * \param errors The errors of the output (N)
+ * \param grad The errors of the input (N x M)
+ */
+template <typename T>
+void global_avg_pool_backward(const T* errors, T* grad, size_t N, size_t M) {
+    const T scale = T(1) / T(M);
+
+    for (size_t n = 0; n < N; ++n) {
+        T* plane = grad + n * M;
+
+        const T e = scale * errors[n];
+
+        for (size_t m = 0; m < M; ++m) {
+            plane[m] = e;
+        }
+    }
+}
+
+/*!
+ * \brief Max pooling (2D) of the ETL input (... x I2 x I3) into the ETL
+ * output
+ *
+ * An input without direct memory access is evaluated into a temporary.
+ */
+template <typename Output, typename Input>
+void max_pool_2d_forward(Output&& output, const Input& input, size_t I2, size_t I3, size_t C1, size_t C2, size_t S1, size_t S2, size_t P1, size_t P2) {
+    static_assert(etl::all_dma<std::decay_t<Output>>, "The strided max pooling needs direct memory access to the output");
+
+    if constexpr (etl::all_dma<Input>) {
+        input.ensure_cpu_up_to_date();
+
+        max_pool_2d_forward(input.memory_start(), output.memory_start(), etl::size(input) / (I2 * I3), I2, I3, C1, C2, S1, S2, P1, P2);
+
+        output.invalidate_gpu();
+    } else {
+        max_pool_2d_forward(output, etl::force_temporary(input), I2, I3, C1, C2, S1, S2, P1, P2);
+    }
+}
+
+/*!
+ * \brief Backpropagate the errors of a max pooling (2D) of ETL containers
+ */
+template <typename Grad, typename Input, typename Output, typename Errors>
+void max_pool_2d_backward(Grad&& grad, const Input& input, const Output& output, const Errors& errors, size_t I2, size_t I3, size_t C1, size_t C2, size_t S1, size_t S2, size_t P1, size_t P2) {
+    static_assert(etl::all_dma<std::decay_t<Grad>, Input, Output, Errors>, "The strided max pooling backward needs direct memory access");
+
+    input.ensure_cpu_up_to_date();
+    output.ensure_cpu_up_to_date();
+    errors.ensure_cpu_up_to_date();
+
+    max_pool_2d_backward(input.memory_start(), output.memory_start(), errors.memory_start(), grad.memory_start(),
+                         etl::size(input) / (I2 * I3), I2, I3, C1, C2, S1, S2, P1, P2);
+
+    grad.invalidate_gpu();
+}
+
+/*!
+ * \brief Average pooling (2D) of the ETL input (... x I2 x I3) into the ETL
+ * output
+ *
+ * An input without direct memory access is evaluated into a temporary.
+ */
+template <typename Output, typename Input>
+void avg_pool_2d_forward(Output&& output, const Input& input, size_t I2, size_t I3, size_t C1, size_t C2, size_t S1, size_t S2, size_t P1, size_t P2) {
+    static_assert(etl::all_dma<std::decay_t<Output>>, "The strided average pooling needs direct memory access to the output");
+
+    if constexpr (etl::all_dma<Input>) {
+        input.ensure_cpu_up_to_date();
+
+        avg_pool_2d_forward(input.memory_start(), output.memory_start(), etl::size(input) / (I2 * I3), I2, I3, C1, C2, S1, S2, P1, P2);
+
+        output.invalidate_gpu();
+    } else {
+        avg_pool_2d_forward(output, etl::force_temporary(input), I2, I3, C1, C2, S1, S2, P1, P2);
+    }
+}
+
+/*!
+ * \brief Backpropagate the errors of an average pooling (2D) of ETL
+ * containers
+ */
+template <typename Grad, typename Errors>
+void avg_pool_2d_backward(Grad&& grad, const Errors& errors, size_t I2, size_t I3, size_t C1, size_t C2, size_t S1, size_t S2, size_t P1, size_t P2) {
+    static_assert(etl::all_dma<std::decay_t<Grad>, Errors>, "The strided average pooling backward needs direct memory access");
+
+    errors.ensure_cpu_up_to_date();
+
+    avg_pool_2d_backward(errors.memory_start(), grad.memory_start(), etl::size(grad) / (I2 * I3), I2, I3, C1, C2, S1, S2, P1, P2);
+
+    grad.invalidate_gpu();
+}
+
+} //end of dll namespace
@@ -0,0 +1,252 @@
+//=======================================================================
+// Copyright (c) 2014-2017 Baptiste Wicht
+// Distributed under the terms of the MIT License.
+// (See accompanying file LICENSE or copy at
+//  http://opensource.org/licenses/MIT)
+//=======================================================================
+
+/*!
+ * \file
+ * \brief Post-training int8 quantization of the dense and convolutional
+ * layers, for inference.
+ */
+
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <vector>
+#include <algorithm>
+
+#include "cpp_utils/assert.hpp"
+
+#include "etl/etl.hpp"
+
+namespace dll {
+
+/*!
+ * \brief The int8 weights of a layer and the int8 kernels using them.
+ *
+ * The quantization is symmetric. The weights of each output channel have
+ * their own scale and the input of the layer has a single scale,
+ * calibrated from the range of its values. The products are accumulated
+ * in int32 and the result is scaled back to the weight type before the
+ * epilogue (biases and activation) of the layer.
+ *
+ * The weights are stored as a [N, K] matrix, with N the number of output
+ * channels, so that each output is the dot product of two contiguous
+ * rows.
+ */
+template <typename T>
+struct int8_quantization {
+    bool active   = false; ///< Indicates if the layer uses the quantized weights
+    T input_scale = 1;     ///< The scale of the input values
+
+    size_t N = 0; ///< The number of output channels
+    size_t K = 0; ///< The number of weights of an output channel
+
+    std::vector<int8_t> w; ///< The quantized weights [N, K]
+    std::vector<T> scales; ///< The scale of the weights of each output channel
+
+    /*!
+     * \brief Quantize the given weights.
+     *
+     * \param weights The weights, [N, K] or [K, N] if transposed
+     * \param n The number of output channels
+     * \param k The number of weights of an output channel
+     * \param transposed Indicates if the weights are stored as [K, N]
+     * \param input_range The maximum absolute value of the input of the layer
+     */
+    template <typename W>
+    void quantize(const W& weights, size_t n, size_t k, bool transposed, T input_range) {
+        cpp_assert(etl::size(weights) == n * k, "Invalid weights for int8_quantization");
+
+        N = n;
+        K = k;
+
+        w.resize(N * K);
+        scales.resize(N);
+
+        weights.ensure_cpu_up_to_date();
+
+        const T* src = weights.memory_start();
+
+        auto get = [&](size_t o, size_t i) { return transposed ? src[i * N + o] : src[o * K + i]; };
+
+        for (size_t o = 0; o < N; ++o) {
+            T max = 0;
+
+            for (size_t i = 0; i < K; ++i) {
+                max = std::max(max, T(std::abs(get(o, i))));
+            }
+
+            scales[o] = max > T(0) ? max / T(127) : T(1);
+
+            for (size_t i = 0; i < K; ++i) {
+                w[o * K + i] = quantize_one(get(o, i), T(1) / scales[o]);
+            }
+        }
+
+        input_scale = input_range > T(0) ? input_range / T(127) : T(1);
+
+        active = true;
+    }
+
+    /*!
+     * \brief Quantize one value
+     * \param x The value
+     * \param inv_scale The inverse of the scale of the value
+     */
+    static int8_t quantize_one(T x, T inv_scale) {
+        return int8_t(std::max(-127L, std::min(127L, std::lround(x * inv_scale))));
+    }
+
+    /*!
+     * \brief Compute c = a * b^T of int8 matrices with int32 accumulation
+     * \param a The first matrix [M, K]
+     * \param b The second matrix [N, K]
+     * \param c The result [M, N]
+     */
+    static void gemm(const int8_t* a, const int8_t* b, int32_t* c, size_t M, size_t N, size_t K) {
+        for (size_t m = 0; m < M; ++m) {
+            const int8_t* a_row = a + m * K;
+
+            for (size_t n = 0; n < N; ++n) {
+                const int8_t* b_row = b + n * K;
+
+                int32_t acc = 0;
+
+                for (size_t k = 0; k < K; ++k) {
+                    acc += int32_t(a_row[k]) * int32_t(b_row[k]);
+                }
+
+                c[m * N + n] = acc;
+            }
+        }
+    }
+
+    /*!
+     * \brief Compute the output of a dense layer
+     * \param input The batch of input [B, K]
+     * \param output The batch of output [B, N]
+     * \param epilogue The operation applied to each output value
+     */
+    template <typename In, typename Out, typename E>
+    void dense(const In& input, Out&& output, E epilogue) const {
+        const size_t B = etl::dim<0>(input);
+
+        cpp_assert(etl::size(input) == B * K && etl::size(output) == B * N, "Invalid dimensions for int8_quantization");
+
+        std::vector<int8_t> q(B * K);
+        std::vector<int32_t> acc(B * N);
+
+        input.ensure_cpu_up_to_date();
+
+        const T* in = input.memory_start();
+
+        const T inv_scale = T(1) / input_scale;
+
+        for (size_t i = 0; i < B * K; ++i) {
+            q[i] = quantize_one(in[i], inv_scale);
+        }
+
+        gemm(q.data(), w.data(), acc.data(), B, N, K);
+
+        T* out = output.memory_start();
+
+        for (size_t b = 0; b < B; ++b) {
+            for (size_t n = 0; n < N; ++n) {
+                out[b * N + n] = epilogue(n, T(acc[b * N + n]) * input_scale * scales[n]);
+            }
+        }
+
+        output.invalidate_gpu();
+    }
+
+    /*!
+     * \brief Compute the output of a convolutional layer.
+     *
+     * The patches of each quantized image are extracted (im2col) and
+     * multiplied with the quantized filters.
+     *
+     * \param input The batch of input, with B * C * H * W values
+     * \param output The batch of output [B, N, OH, OW]
+     * \param C The number of input channels
+     * \param H The first dimension of the input images
+     * \param W The second dimension of the input images
+     * \param NW1 The first dimension of the filters
+     * \param NW2 The second dimension of the filters
+     * \param S1 The stride of the first dimension
+     * \param S2 The stride of the second dimension
+     * \param P1 The padding of the first dimension
+     * \param P2 The padding of the second dimension
+     * \param epilogue The operation applied to each output value
+     */
+    template <typename In, typename Out, typename E>
+    void conv(const In& input, Out&& output, size_t C, size_t H, size_t W, size_t NW1, size_t NW2, size_t S1, size_t S2, size_t P1, size_t P2, E epilogue) const {
+        const size_t B  = etl::dim<0>(input);
+        const size_t OH = (H - NW1 + 2 * P1) / S1 + 1;
+        const size_t OW = (W - NW2 + 2 * P2) / S2 + 1;
+        const size_t P  = OH * OW;
+
+        cpp_assert(K == C * NW1 * NW2, "Invalid filters for int8_quantization");
+        cpp_assert(etl::size(input) == B * C * H * W && etl::size(output) == B * N * P, "Invalid dimensions for int8_quantization");
+
+        std::vector<int8_t> image(C * H * W);
+        std::vector<int8_t> cols(P * K);
+        std::vector<int32_t> acc(N * P);
+
+        input.ensure_cpu_up_to_date();
+
+        const T* in = input.memory_start();
+        T* out      = output.memory_start();
+
+        const T inv_scale = T(1) / input_scale;
+
+        for (size_t b = 0; b < B; ++b) {
+            // 1. Quantize the image
+
+            for (size_t i = 0; i < C * H * W; ++i) {
+                image[i] = quantize_one(in[b * C * H * W + i], inv_scale);
+            }
+
+            // 2. Patches of the image (im2col), zero being the padding
+
+            for (size_t i = 0; i < OH; ++i) {
+                for (size_t j = 0; j < OW; ++j) {
+                    int8_t* col = cols.data() + (i * OW + j) * K;
+
+                    for (size_t c = 0; c < C; ++c) {
+                        for (size_t p = 0; p < NW1; ++p) {
+                            const long y = long(i * S1 + p) - long(P1);
+
+                            for (size_t q = 0; q < NW2; ++q) {
+                                const long x = long(j * S2 + q) - long(P2);
+
+                                col[(c * NW1 + p) * NW2 + q] = (y >= 0 && y < long(H) && x >= 0 && x < long(W)) ? image[(c * H + y) * W + x] : int8_t(0);
+                            }
+                        }
+                    }
+                }
+            }
+
+            // 3. Product with the filters
+
+            gemm(w.data(), cols.data(), acc.data(), N, P, K);
+
+            T* out_b = out + b * N * P;
+
+            for (size_t n = 0; n < N; ++n) {
+                const T scale = input_scale * scales[n];
+
+                for (size_t p = 0; p < P; ++p) {
+                    out_b[n * P + p] = epilogue(n, T(acc[n * P + p]) * scale);
+                }
+            }
+        }
+
+        output.invalidate_gpu();
+    }
+};
+
+} //end of dll namespace
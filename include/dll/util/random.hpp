@@ -7,7 +7,11 @@
 
 #pragma once
 
+#include <cmath>
 #include <random>
+#include <cstdint>
+#include <atomic>
+#include <type_traits>
 
 namespace dll {
 
@@ -62,4 +66,340 @@ inline random_engine& rand_engine(){
     return engine;
 }
 
+/*!
+ * \brief Derive a seed for a given stream from the DLL random seed.
+ *
+ * This is used to give independent, but reproducible, random engines
+ * to the workers of a multithreaded computation.
+ *
+ * \param stream The identifier of the stream
+ * \param counter The position in the stream
+ *
+ * \return A seed to initialize a random engine with
+ */
+inline size_t derived_seed(size_t stream, size_t counter = 0){
+    // splitmix64 finalizer on the combined value
+    uint64_t z = uint64_t(seed()) + 0x9E3779B97F4A7C15ULL * (uint64_t(stream) + 1) + uint64_t(counter) * 0xBF58476D1CE4E5B9ULL;
+
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    z = z ^ (z >> 31);
+
+    return size_t(z);
+}
+
+/*!
+ * \brief Counter-based random generator.
+ *
+ * The number only depends on the key and the counter, so that any number
+ * of the stream can be generated again without storing it.
+ *
+ * \param key The key of the stream
+ * \param counter The position in the stream
+ *
+ * \return A uniform 32 bits random number
+ */
+inline uint32_t counter_random(uint64_t key, uint64_t counter){
+    uint64_t z = key + 0x9E3779B97F4A7C15ULL * (counter + 1);
+
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    z = z ^ (z >> 31);
+
+    return uint32_t(z >> 32);
+}
+
+/*!
+ * \brief Returns a new seed derived from the DLL random seed.
+ *
+ * Unlike rand_engine(), this can be used concurrently from several
+ * threads.
+ */
+inline size_t next_stream_seed(){
+    static std::atomic<size_t> stream(0);
+
+    return derived_seed(stream++);
+}
+
+namespace detail {
+
+/*!
+ * \brief Mix the bits of a 64 bits value (splitmix64 finalizer)
+ */
+inline uint64_t mix_bits(uint64_t z){
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+} // end of namespace detail
+
+/*!
+ * \brief Derive the key of a random stream from the DLL random seed and
+ * the given identifiers (for instance the epoch, the batch and the layer).
+ *
+ * The order of the identifiers matters: (1, 2) and (2, 1) are different
+ * streams.
+ */
+template <typename... Ids>
+uint64_t random_key(Ids... ids){
+    uint64_t key = detail::mix_bits(uint64_t(seed()));
+
+    ((key = detail::mix_bits(key ^ (uint64_t(ids) + 0x9E3779B97F4A7C15ULL))), ...);
+
+    return key;
+}
+
+/*!
+ * \brief Compute one block of the Philox4x32-10 counter-based generator
+ * \param counter The counter of the block (128 bits)
+ * \param key The key of the stream (64 bits)
+ * \param block The four random numbers of the block
+ */
+inline void philox4x32(const uint32_t (&counter)[4], uint64_t key, uint32_t (&block)[4]){
+    uint32_t c0 = counter[0];
+    uint32_t c1 = counter[1];
+    uint32_t c2 = counter[2];
+    uint32_t c3 = counter[3];
+
+    uint32_t k0 = uint32_t(key);
+    uint32_t k1 = uint32_t(key >> 32);
+
+    for (size_t r = 0; r < 10; ++r) {
+        const uint64_t p0 = uint64_t(0xD2511F53U) * c0;
+        const uint64_t p1 = uint64_t(0xCD9E8D57U) * c2;
+
+        const uint32_t n0 = uint32_t(p1 >> 32) ^ c1 ^ k0;
+        const uint32_t n2 = uint32_t(p0 >> 32) ^ c3 ^ k1;
+
+        c0 = n0;
+        c1 = uint32_t(p1);
+        c2 = n2;
+        c3 = uint32_t(p0);
+
+        k0 += 0x9E3779B9U;
+        k1 += 0xBB67AE85U;
+    }
+
+    block[0] = c0;
+    block[1] = c1;
+    block[2] = c2;
+    block[3] = c3;
+}
+
+/*!
+ * \brief A counter-based random stream (Philox4x32-10).
+ *
+ * The numbers of the stream only depend on its key and on their position,
+ * so that independent streams can be created concurrently by the threads
+ * of a parallel computation, for instance one per (epoch, batch, layer),
+ * and give the same numbers regardless of the number of threads.
+ *
+ * The stream can be used as the random engine of the standard
+ * distributions and of std::shuffle.
+ */
+struct random_stream {
+    using result_type = uint32_t; ///< The type of the generated numbers
+
+    /*!
+     * \brief Construct the stream of the given identifiers
+     * \param ids The identifiers of the stream (see random_key)
+     */
+    template <typename... Ids, typename = std::enable_if_t<(std::is_integral<Ids>::value && ...)>>
+    explicit random_stream(Ids... ids) : key(random_key(ids...)) {
+        // Nothing else to init
+    }
+
+    /*!
+     * \brief Returns the smallest number of the stream
+     */
+    static constexpr result_type min() {
+        return 0;
+    }
+
+    /*!
+     * \brief Returns the largest number of the stream
+     */
+    static constexpr result_type max() {
+        return 0xFFFFFFFFU;
+    }
+
+    /*!
+     * \brief Returns the next number of the stream
+     */
+    result_type operator()() {
+        if (cpp_unlikely(next == 4)) {
+            generate(counter++, buffer);
+            next = 0;
+        }
+
+        return buffer[next++];
+    }
+
+    /*!
+     * \brief Skip the next n numbers of the stream
+     */
+    void discard(uint64_t n) {
+        while (n && next < 4) {
+            ++next;
+            --n;
+        }
+
+        counter += n / 4;
+
+        for (n %= 4; n; --n) {
+            (*this)();
+        }
+    }
+
+    /*!
+     * \brief Fill the given buffer with the next n uniform numbers in [0,1)
+     * of the stream.
+     *
+     * The blocks of the stream are independent from each other, so that
+     * they are generated in a loop without dependencies, which can be
+     * vectorized by the compiler. The numbers are the same as the ones
+     * that would have been drawn one by one.
+     *
+     * \param out The buffer to fill
+     * \param n The number of values
+     */
+    template <typename T>
+    void fill_uniform(T* out, size_t n) {
+        size_t i = 0;
+
+        // Consume the numbers that are already buffered
+
+        for (; i < n && next < 4; ++i) {
+            out[i] = to_uniform<T>(buffer[next++]);
+        }
+
+        const size_t blocks = (n - i) / 4;
+
+        for (size_t b = 0; b < blocks; ++b) {
+            uint32_t block[4];
+            generate(counter + b, block);
+
+            for (size_t l = 0; l < 4; ++l) {
+                out[i + 4 * b + l] = to_uniform<T>(block[l]);
+            }
+        }
+
+        counter += blocks;
+
+        for (i += 4 * blocks; i < n; ++i) {
+            out[i] = to_uniform<T>((*this)());
+        }
+    }
+
+    /*!
+     * \brief Converts a random number to a uniform number in [0,1)
+     */
+    template <typename T>
+    static T to_uniform(uint32_t x) {
+        // The 24 high bits give an exact float in [0,1)
+        return T(x >> 8) * T(1.0 / 16777216.0);
+    }
+
+private:
+    /*!
+     * \brief Generate the block of the given counter
+     */
+    void generate(uint64_t c, uint32_t (&block)[4]) const {
+        const uint32_t ctr[4] = {uint32_t(c), uint32_t(c >> 32), 0, 0};
+
+        philox4x32(ctr, key, block);
+    }
+
+    uint64_t key;         ///< The key of the stream
+    uint64_t counter = 0; ///< The counter of the next block
+    uint32_t buffer[4];   ///< The current block
+    size_t next = 4;      ///< The position of the next number in the block
+};
+
+/*!
+ * \brief A fast random generator of uniform numbers in [0,1).
+ *
+ * The generator is made of several independent xorshift lanes that are
+ * advanced together, so that the generation of a block of numbers can be
+ * vectorized by the compiler. This is not a high-quality generator, but
+ * it is largely sufficient for sampling units.
+ */
+struct lane_random {
+    static constexpr size_t lanes = 16; ///< The number of independent lanes
+
+    uint32_t state[lanes]; ///< The state of each lane
+    float block[lanes];    ///< The current block of numbers
+    size_t next = lanes;   ///< The position of the next number in the block
+
+    /*!
+     * \brief Construct a new lane_random from the given seed
+     * \param seed The seed of the generator
+     */
+    explicit lane_random(size_t seed) {
+        for (size_t l = 0; l < lanes; ++l) {
+            // splitmix64 to decorrelate the lanes, xorshift states cannot be zero
+            uint64_t z = uint64_t(seed) + 0x9E3779B97F4A7C15ULL * (uint64_t(l) + 1);
+
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+            z = z ^ (z >> 31);
+
+            state[l] = uint32_t(z) | 1;
+        }
+    }
+
+    /*!
+     * \brief Generate a new block of numbers
+     */
+    void refill() {
+        for (size_t l = 0; l < lanes; ++l) {
+            uint32_t x = state[l];
+
+            x ^= x << 13;
+            x ^= x >> 17;
+            x ^= x << 5;
+
+            state[l] = x;
+
+            // The 24 high bits give an exact float in [0,1)
+            block[l] = float(x >> 8) * (1.0f / 16777216.0f);
+        }
+
+        next = 0;
+    }
+
+    /*!
+     * \brief Generate a new block of standard normal numbers.
+     *
+     * The two halves of a uniform block are combined with the Box-Muller
+     * transform, which is vectorized as well.
+     */
+    void refill_normal() {
+        refill();
+
+        constexpr size_t half = lanes / 2;
+
+        for (size_t l = 0; l < half; ++l) {
+            // 1 - u is in (0, 1], its logarithm is finite
+            const float r     = std::sqrt(-2.0f * std::log(1.0f - block[l]));
+            const float theta = 6.28318530718f * block[l + half];
+
+            block[l]        = r * std::cos(theta);
+            block[l + half] = r * std::sin(theta);
+        }
+    }
+
+    /*!
+     * \brief Returns the next uniform number in [0,1)
+     */
+    float operator()() {
+        if (cpp_unlikely(next == lanes)) {
+            refill();
+        }
+
+        return block[next++];
+    }
+};
+
 } //end of dll namespace
@@ -0,0 +1,128 @@
+//=======================================================================
+// Copyright (c) 2014-2017 Baptiste Wicht
+// Distributed under the terms of the MIT License.
+// (See accompanying file LICENSE or copy at
+//  http://opensource.org/licenses/MIT)
+//=======================================================================
+
+/*!
+ * \file
+ * \brief Random fill of the weights, in parallel for large tensors
+ */
+
+#pragma once
+
+#include <cmath>
+#include <algorithm>
+
+#include "etl/etl.hpp"
+
+#include "dll/util/random.hpp"
+#include "dll/util/scheduler.hpp"
+
+namespace dll {
+
+namespace random_fill_detail {
+
+constexpr size_t chunk     = 64 * 1024;   ///< The number of values of each chunk, each chunk being one random stream
+constexpr size_t threshold = 1024 * 1024; ///< The minimum number of values of a tensor to fill it in parallel
+
+/*!
+ * \brief Call the functor on each chunk of the given buffer, with the
+ * random stream of the chunk, splitting the chunks between the threads
+ * of the scheduler.
+ *
+ * The stream of a chunk only depends on its index and on one number drawn
+ * from the DLL random engine, the values are therefore the same regardless
+ * of the number of threads.
+ *
+ * \param out The buffer to fill
+ * \param n The number of values of the buffer
+ * \param functor The functor to call for each chunk (stream, out, n)
+ */
+template <typename T, typename Functor>
+void for_each_chunk(T* out, size_t n, Functor&& functor) {
+    const size_t chunks = (n + chunk - 1) / chunk;
+    const uint64_t key  = uint64_t(dll::rand_engine()());
+
+    dll::scheduler().parallel_for(chunks, [&](size_t c) {
+        random_stream stream(key, c);
+
+        const size_t first = c * chunk;
+
+        functor(stream, out + first, std::min(chunk, n - first));
+    });
+}
+
+} //end of namespace random_fill_detail
+
+/*!
+ * \brief Fill the given tensor with uniform numbers in [a, b).
+ *
+ * The small tensors are filled from the DLL random engine, the large ones
+ * in parallel from counter-based streams.
+ *
+ * \param m The tensor to fill
+ * \param a The lower bound
+ * \param b The upper bound
+ */
+template <typename M>
+void random_uniform(M& m, etl::value_t<M> a, etl::value_t<M> b) {
+    using T = etl::value_t<M>;
+
+    if (etl::size(m) < random_fill_detail::threshold) {
+        m = etl::uniform_generator<T>(dll::rand_engine(), a, b);
+        return;
+    }
+
+    random_fill_detail::for_each_chunk(m.memory_start(), etl::size(m), [a, b](random_stream& stream, T* out, size_t n) {
+        stream.fill_uniform(out, n);
+
+        for (size_t i = 0; i < n; ++i) {
+            out[i] = a + (b - a) * out[i];
+        }
+    });
+
+    m.invalidate_gpu();
+}
+
+/*!
+ * \brief Fill the given tensor with normal numbers.
+ *
+ * The small tensors are filled from the DLL random engine, the large ones
+ * in parallel from counter-based streams (Box-Muller transform).
+ *
+ * \param m The tensor to fill
+ * \param mean The mean of the distribution
+ * \param stddev The standard deviation of the distribution
+ */
+template <typename M>
+void random_normal(M& m, etl::value_t<M> mean, etl::value_t<M> stddev) {
+    using T = etl::value_t<M>;
+
+    if (etl::size(m) < random_fill_detail::threshold) {
+        m = etl::normal_generator<T>(dll::rand_engine(), mean, stddev);
+        return;
+    }
+
+    random_fill_detail::for_each_chunk(m.memory_start(), etl::size(m), [mean, stddev](random_stream& stream, T* out, size_t n) {
+        for (size_t i = 0; i < n; i += 2) {
+            const T u1 = random_stream::to_uniform<T>(stream());
+            const T u2 = random_stream::to_uniform<T>(stream());
+
+            // 1 - u1 is in (0, 1], its logarithm is finite
+            const T r     = std::sqrt(T(-2) * std::log(T(1) - u1));
+            const T theta = T(6.28318530718) * u2;
+
+            out[i] = mean + stddev * r * std::cos(theta);
+
+            if (i + 1 < n) {
+                out[i + 1] = mean + stddev * r * std::sin(theta);
+            }
+        }
+    });
+
+    m.invalidate_gpu();
+}
+
+} //end of dll namespace
@@ -0,0 +1,362 @@
+//=======================================================================
+// Copyright (c) 2014-2017 Baptiste Wicht
+// Distributed under the terms of the MIT License.
+// (See accompanying file LICENSE or copy at
+//  http://opensource.org/licenses/MIT)
+//=======================================================================
+
+/*!
+ * \file
+ * \brief Work-stealing task scheduler shared by the layers, the trainers and
+ * the utilities of DLL
+ *
+ * Each worker owns a deque of tasks: it pops its own tasks from the back
+ * and, once idle, steals the oldest tasks of the other workers from the
+ * front. The tasks submitted by threads that are not workers are pushed
+ * in a separate injection deque.
+ *
+ * A thread waiting for a group of tasks keeps running tasks until the
+ * group is complete, parallel regions can therefore be nested (merge
+ * branches inside a parallel forward, kernels inside the branches) without
+ * blocking any worker.
+ *
+ * The scheduler uses etl::threads threads, counting the waiting thread,
+ * and the tasks are run in serial sections so that ETL does not start its
+ * own threads underneath.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "etl/etl.hpp"
+
+#include "dll/util/affinity.hpp"
+
+namespace dll {
+
+struct task_group;
+
+/*!
+ * \brief A work-stealing pool of threads
+ */
+struct task_scheduler {
+    using task_t = std::function<void()>; ///< The type of a task
+
+    /*!
+     * \brief Create a scheduler using the given number of threads,
+     * counting the threads waiting for their tasks
+     * \param threads The number of threads
+     */
+    explicit task_scheduler(size_t threads) : budget(std::max(size_t(1), threads)) {
+        // One deque per worker and the injection deque
+        for (size_t w = 0; w < budget; ++w) {
+            queues.push_back(std::make_unique<queue>());
+        }
+
+        for (size_t w = 0; w + 1 < budget; ++w) {
+            workers.emplace_back([this, w] { work(w); });
+        }
+    }
+
+    task_scheduler(const task_scheduler& rhs) = delete;
+    task_scheduler& operator=(const task_scheduler& rhs) = delete;
+
+    /*!
+     * \brief Stop the workers once all the tasks are done
+     */
+    ~task_scheduler() {
+        {
+            std::unique_lock<std::mutex> ulock(sleep_lock);
+            stop = true;
+        }
+
+        sleep_condition.notify_all();
+
+        for (auto& worker : workers) {
+            worker.join();
+        }
+    }
+
+    /*!
+     * \brief Returns the number of threads of the scheduler, counting the
+     * waiting thread
+     */
+    size_t threads() const noexcept {
+        return budget;
+    }
+
+    /*!
+     * \brief Call the functor for each index in [0, n), the indices being
+     * split in ranges run concurrently. The calling thread runs ranges
+     * until all of them are done.
+     *
+     * \param n The number of indices
+     * \param functor The functor to call for each index
+     */
+    template <typename Functor>
+    void parallel_for(size_t n, Functor&& functor);
+
+    /*!
+     * \brief Call the functor for each range of at least grain indices in
+     * [0, n). The calling thread runs ranges until all of them are done.
+     *
+     * \param n The number of indices
+     * \param grain The minimum number of indices of a range
+     * \param functor The functor to call for each range (first, last)
+     */
+    template <typename Functor>
+    void parallel_ranges(size_t n, size_t grain, Functor&& functor);
+
+private:
+    /*!
+     * \brief A deque of tasks
+     */
+    struct queue {
+        std::mutex lock;          ///< The lock protecting the tasks
+        std::deque<task_t> tasks; ///< The tasks
+    };
+
+    /*!
+     * \brief Returns the index of the current thread in the scheduler, the
+     * injection deque for the threads not being workers
+     */
+    size_t current() const {
+        return self_scheduler() == this ? self_index() : budget - 1;
+    }
+
+    static const task_scheduler*& self_scheduler() {
+        static thread_local const task_scheduler* scheduler = nullptr;
+        return scheduler;
+    }
+
+    static size_t& self_index() {
+        static thread_local size_t index = 0;
+        return index;
+    }
+
+    /*!
+     * \brief Push a task in the deque of the current thread
+     */
+    void push(task_t task) {
+        auto& q = *queues[current()];
+
+        {
+            std::unique_lock<std::mutex> ulock(q.lock);
+            q.tasks.push_back(std::move(task));
+        }
+
+        ++queued;
+
+        {
+            // Make sure a worker about to sleep sees the task
+            std::unique_lock<std::mutex> ulock(sleep_lock);
+        }
+
+        sleep_condition.notify_one();
+    }
+
+    /*!
+     * \brief Run one task, from the deque of the given thread first and
+     * then stolen from the others
+     * \return true if a task has been run, false if there were none
+     */
+    bool run_one(size_t self) {
+        task_t task;
+
+        if (!pop(self, task)) {
+            return false;
+        }
+
+        // The threads are already used by the scheduler
+        SERIAL_SECTION {
+            task();
+        }
+
+        return true;
+    }
+
+    /*!
+     * \brief Take a task, the newest of the own deque or the oldest of
+     * another deque
+     */
+    bool pop(size_t self, task_t& task) {
+        if (!queued) {
+            return false;
+        }
+
+        {
+            auto& q = *queues[self];
+            std::unique_lock<std::mutex> ulock(q.lock);
+
+            if (!q.tasks.empty()) {
+                task = std::move(q.tasks.back());
+                q.tasks.pop_back();
+                --queued;
+                return true;
+            }
+        }
+
+        for (size_t i = 1; i < budget; ++i) {
+            auto& q = *queues[(self + i) % budget];
+            std::unique_lock<std::mutex> ulock(q.lock);
+
+            if (!q.tasks.empty()) {
+                task = std::move(q.tasks.front());
+                q.tasks.pop_front();
+                --queued;
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    /*!
+     * \brief The loop of the worker w
+     */
+    void work(size_t w) {
+        self_scheduler() = this;
+        self_index()     = w;
+
+        pin_thread(execution().pool, w);
+
+        while (true) {
+            if (run_one(w)) {
+                continue;
+            }
+
+            std::unique_lock<std::mutex> ulock(sleep_lock);
+
+            sleep_condition.wait(ulock, [this] { return stop || queued; });
+
+            if (stop && !queued) {
+                return;
+            }
+        }
+    }
+
+    /*!
+     * \brief Run tasks until the given number of pending tasks is zero
+     */
+    void wait(const std::atomic<size_t>& pending) {
+        const size_t self = current();
+
+        while (pending) {
+            if (!run_one(self)) {
+                std::this_thread::yield();
+            }
+        }
+    }
+
+    const size_t budget; ///< The number of threads, counting the waiting thread
+
+    std::vector<std::unique_ptr<queue>> queues; ///< The deque of each worker and the injection deque
+    std::vector<std::thread> workers;           ///< The worker threads
+
+    std::atomic<size_t> queued{0};           ///< The number of tasks in the deques
+    std::mutex sleep_lock;                   ///< The lock of the idle workers
+    std::condition_variable sleep_condition; ///< The condition of the idle workers
+    bool stop = false;                       ///< Indicates that the workers must stop
+
+    friend struct task_group;
+};
+
+/*!
+ * \brief Returns the scheduler shared by DLL, using etl::threads threads
+ */
+inline task_scheduler& scheduler() {
+    static task_scheduler instance(etl::threads);
+    return instance;
+}
+
+/*!
+ * \brief A group of tasks run on the scheduler and waited for together
+ */
+struct task_group {
+    /*!
+     * \brief Create a group of tasks on the given scheduler
+     */
+    explicit task_group(task_scheduler& scheduler = dll::scheduler()) : sched(scheduler) {}
+
+    task_group(const task_group& rhs) = delete;
+    task_group& operator=(const task_group& rhs) = delete;
+
+    /*!
+     * \brief Wait for the remaining tasks
+     */
+    ~task_group() {
+        wait();
+    }
+
+    /*!
+     * \brief Run the given functor as a task of the group
+     */
+    template <typename Functor>
+    void run(Functor&& functor) {
+        ++pending;
+
+        sched.push([this, f = std::forward<Functor>(functor)]() mutable {
+            f();
+            --pending;
+        });
+    }
+
+    /*!
+     * \brief Run tasks until all the tasks of the group are done
+     */
+    void wait() {
+        sched.wait(pending);
+    }
+
+private:
+    task_scheduler& sched;           ///< The scheduler
+    std::atomic<size_t> pending{0}; ///< The number of tasks not done
+};
+
+template <typename Functor>
+void task_scheduler::parallel_ranges(size_t n, size_t grain, Functor&& functor) {
+    // A few ranges per thread leave some work to steal
+    const size_t ranges = std::min((n + grain - 1) / std::max(size_t(1), grain), 4 * budget);
+
+    if (budget == 1 || ranges <= 1) {
+        if (n) {
+            functor(size_t(0), n);
+        }
+
+        return;
+    }
+
+    const size_t chunk = (n + ranges - 1) / ranges;
+
+    task_group group(*this);
+
+    for (size_t first = chunk; first < n; first += chunk) {
+        group.run([&functor, first, last = std::min(n, first + chunk)] { functor(first, last); });
+    }
+
+    // The calling thread takes the first range
+    SERIAL_SECTION {
+        functor(size_t(0), chunk);
+    }
+
+    group.wait();
+}
+
+template <typename Functor>
+void task_scheduler::parallel_for(size_t n, Functor&& functor) {
+    parallel_ranges(n, 1, [&functor](size_t first, size_t last) {
+        for (size_t i = first; i < last; ++i) {
+            functor(i);
+        }
+    });
+}
+
+} //end of dll namespace
@@ -0,0 +1,305 @@
+//=======================================================================
+// Copyright (c) 2014-2017 Baptiste Wicht
+// Distributed under the terms of the MIT License.
+// (See accompanying file LICENSE or copy at
+//  http://opensource.org/licenses/MIT)
+//=======================================================================
+
+/*!
+ * \file
+ * \brief Arenas of scratch memory for the trainers and the layers
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <memory>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "cpp_utils/assert.hpp"
+
+#include "etl/etl.hpp"
+
+namespace dll {
+
+/*!
+ * \brief A bump-pointer arena of scratch memory.
+ *
+ * The memory is allocated once with reserve() and then handed as views
+ * (etl::custom_dyn_matrix) to the computations of a batch. reset() makes
+ * the whole memory available again, without any deallocation, for the
+ * next batch.
+ */
+template <typename T>
+struct scratch_arena {
+    using value_type = T; ///< The type of value of the arena
+
+    static constexpr size_t alignment = 64; ///< The alignment of each view (in bytes)
+
+    /*!
+     * \brief Reserve memory for views of the given total number of
+     * elements. The previous views are invalidated.
+     * \param n The total number of elements of the views
+     * \param views The number of views that will be taken at once
+     */
+    void reserve(size_t n, size_t views = 1) {
+        const size_t required = n + views * (alignment / sizeof(T));
+
+        if (required > capacity) {
+            memory   = std::make_unique<T[]>(required);
+            capacity = required;
+        }
+
+        reset();
+    }
+
+    /*!
+     * \brief Make all the memory of the arena available again
+     */
+    void reset() {
+        offset = 0;
+    }
+
+    /*!
+     * \brief Returns the number of elements allocated by the arena
+     */
+    size_t size() const {
+        return capacity;
+    }
+
+    /*!
+     * \brief Returns a view of the given dimensions in the arena
+     * \param sizes The dimensions of the view
+     * \return An etl::custom_dyn_matrix of D dimensions over the memory of the arena
+     */
+    template <size_t D, typename... S>
+    etl::custom_dyn_matrix<T, D> matrix(S... sizes) {
+        static_assert(sizeof...(S) == D, "Invalid number of dimensions");
+
+        const size_t n = (size_t(sizes) * ...);
+
+        T* ptr = align(memory.get() + offset);
+
+        cpp_assert(size_t(ptr - memory.get()) + n <= capacity, "scratch_arena: the arena has not been reserved large enough");
+
+        offset = size_t(ptr - memory.get()) + n;
+
+        return etl::custom_dyn_matrix<T, D>(ptr, sizes...);
+    }
+
+private:
+    /*!
+     * \brief Align the given pointer on the next boundary
+     */
+    static T* align(T* ptr) {
+        const auto address = reinterpret_cast<std::uintptr_t>(ptr);
+        const auto aligned = (address + alignment - 1) & ~std::uintptr_t(alignment - 1);
+        return reinterpret_cast<T*>(aligned);
+    }
+
+    std::unique_ptr<T[]> memory; ///< The memory of the arena
+    size_t capacity = 0;         ///< The number of allocated elements
+    size_t offset   = 0;         ///< The offset of the next view
+};
+
+/*!
+ * \brief A growing arena of memory for the temporaries of the layers.
+ *
+ * The temporaries are taken in a stack order, inside temporary_scope
+ * objects, and are released when their scope ends. The arena grows with
+ * new blocks when a temporary does not fit in the current block. Once all
+ * the temporaries are released (at the end of a batch), the blocks are
+ * merged into a single block large enough for the whole batch: in steady
+ * state, the temporaries do not allocate any memory.
+ */
+template <typename T>
+struct temporary_arena {
+    using value_type = T; ///< The type of value of the arena
+
+    static constexpr size_t alignment = 64; ///< The alignment of each temporary (in bytes)
+
+    /*!
+     * \brief A position in the arena
+     */
+    struct position {
+        size_t block;  ///< The index of the block
+        size_t offset; ///< The offset in the block
+    };
+
+    temporary_arena() = default;
+
+    temporary_arena(const temporary_arena& rhs) = delete;
+    temporary_arena& operator=(const temporary_arena& rhs) = delete;
+
+    /*!
+     * \brief Returns the current position in the arena
+     */
+    position mark() const {
+        return {current, offset};
+    }
+
+    /*!
+     * \brief Release all the temporaries taken after the given position
+     */
+    void release(position p) {
+        current = p.block;
+        offset  = p.offset;
+
+        if (!current && !offset && blocks.size() > 1) {
+            const size_t total = size();
+
+            blocks.clear();
+            blocks.emplace_back(std::make_unique<T[]>(total), total);
+        }
+    }
+
+    /*!
+     * \brief Release all the temporaries of the arena
+     */
+    void reset() {
+        release({0, 0});
+    }
+
+    /*!
+     * \brief Returns the number of elements allocated by the arena
+     */
+    size_t size() const {
+        size_t total = 0;
+
+        for (auto& block : blocks) {
+            total += block.second;
+        }
+
+        return total;
+    }
+
+    /*!
+     * \brief Returns a temporary of the given dimensions in the arena
+     * \param sizes The dimensions of the temporary
+     * \return An etl::custom_dyn_matrix of D dimensions over the memory of the arena
+     */
+    template <size_t D, typename... S>
+    etl::custom_dyn_matrix<T, D> matrix(S... sizes) {
+        static_assert(sizeof...(S) == D, "Invalid number of dimensions");
+
+        return etl::custom_dyn_matrix<T, D>(allocate((size_t(sizes) * ...)), sizes...);
+    }
+
+private:
+    /*!
+     * \brief Take n aligned elements from the arena
+     */
+    T* allocate(size_t n) {
+        const size_t required = n + alignment / sizeof(T);
+
+        if (blocks.empty()) {
+            blocks.emplace_back(std::make_unique<T[]>(required), required);
+        } else if (offset + required > blocks[current].second) {
+            // The next blocks are free, the first large enough is used
+            ++current;
+            offset = 0;
+
+            while (current < blocks.size() && blocks[current].second < required) {
+                ++current;
+            }
+
+            if (current == blocks.size()) {
+                const size_t grow = std::max(required, size());
+
+                blocks.emplace_back(std::make_unique<T[]>(grow), grow);
+            }
+        }
+
+        T* base = blocks[current].first.get();
+        T* ptr  = align(base + offset);
+
+        offset = size_t(ptr - base) + n;
+
+        return ptr;
+    }
+
+    /*!
+     * \brief Align the given pointer on the next boundary
+     */
+    static T* align(T* ptr) {
+        const auto address = reinterpret_cast<std::uintptr_t>(ptr);
+        const auto aligned = (address + alignment - 1) & ~std::uintptr_t(alignment - 1);
+        return reinterpret_cast<T*>(aligned);
+    }
+
+    std::vector<std::pair<std::unique_ptr<T[]>, size_t>> blocks; ///< The blocks of memory and their sizes
+    size_t current = 0;                                          ///< The index of the current block
+    size_t offset  = 0;                                          ///< The offset of the next temporary in the current block
+};
+
+/*!
+ * \brief Returns the arena of temporaries of the current thread
+ */
+template <typename T>
+temporary_arena<T>& temporaries() {
+    thread_local temporary_arena<T> arena;
+    return arena;
+}
+
+/*!
+ * \brief A scope of temporaries in the arena of the current thread. The
+ * temporaries taken from the scope are released at the end of the scope.
+ */
+template <typename T>
+struct temporary_scope {
+    temporary_scope() : arena(temporaries<T>()), start(arena.mark()) {}
+
+    temporary_scope(const temporary_scope& rhs) = delete;
+    temporary_scope& operator=(const temporary_scope& rhs) = delete;
+
+    /*!
+     * \brief Release the temporaries of the scope
+     */
+    ~temporary_scope() {
+        arena.release(start);
+    }
+
+    /*!
+     * \brief Returns a temporary of the given dimensions
+     * \param sizes The dimensions of the temporary
+     */
+    template <size_t D, typename... S>
+    etl::custom_dyn_matrix<T, D> matrix(S... sizes) {
+        return arena.template matrix<D>(sizes...);
+    }
+
+    /*!
+     * \brief Returns a temporary with the dimensions of the given
+     * expression, the values are not initialized
+     */
+    template <typename E>
+    auto like(const E& e) {
+        return like(e, std::make_index_sequence<etl::decay_traits<E>::dimensions()>());
+    }
+
+    /*!
+     * \brief Returns a temporary holding the value of the given expression
+     */
+    template <typename E>
+    auto value(const E& e) {
+        auto t = like(e);
+        t = e;
+        return t;
+    }
+
+private:
+    /*!
+     * \copydoc like
+     */
+    template <typename E, size_t... I>
+    etl::custom_dyn_matrix<T, sizeof...(I)> like(const E& e, std::index_sequence<I...>) {
+        return arena.template matrix<sizeof...(I)>(etl::dim<I>(e)...);
+    }
+
+    temporary_arena<T>& arena;                  ///< The arena of the thread
+    typename temporary_arena<T>::position start; ///< The start of the scope
+};
+
+} //end of dll namespace
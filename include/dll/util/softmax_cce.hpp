@@ -0,0 +1,124 @@
+//=======================================================================
+// Copyright (c) 2014-2017 Baptiste Wicht
+// Distributed under the terms of the MIT License.
+// (See accompanying file LICENSE or copy at
+//  http://opensource.org/licenses/MIT)
+//=======================================================================
+
+/*!
+ * \file
+ * \brief Fused softmax and categorical cross-entropy kernel
+ *
+ * The kernel takes the logits of the last layer and computes, row by row
+ * while the row is in cache, the softmax, the errors of the loss and the
+ * metrics of the batch. The loss is computed from the log-softmax
+ * (z - max - log(sum)), which remains finite even when a probability
+ * underflows to zero.
+ */
+
+#pragma once
+
+#include <cmath>
+#include <utility>
+
+#include "etl/etl.hpp"
+
+namespace dll {
+
+/*!
+ * \brief Compute the softmax, the errors and the metrics of the categorical
+ * cross-entropy of N rows of M logits
+ * \param out The logits, replaced by the probabilities (N x M)
+ * \param labels The labels (N x M)
+ * \param errors The errors of the loss, labels - probabilities (N x M)
+ * \return a pair containing the number of misclassified rows and the sum
+ * of the loss of the rows
+ */
+template <typename T, typename L>
+std::pair<double, double> softmax_cce(T* out, const L* labels, T* errors, size_t N, size_t M) {
+    double error = 0.0;
+    double loss  = 0.0;
+
+    for (size_t n = 0; n < N; ++n) {
+        T* row         = out + n * M;
+        const L* label = labels + n * M;
+        T* error_row   = errors + n * M;
+
+        // The max (and its position) of the logits and of the labels
+
+        size_t max_i = 0;
+        size_t max_l = 0;
+
+        for (size_t m = 1; m < M; ++m) {
+            if (row[m] > row[max_i]) {
+                max_i = m;
+            }
+
+            if (label[m] > label[max_l]) {
+                max_l = m;
+            }
+        }
+
+        const T max = row[max_i];
+
+        // The exponentials, with the terms of the loss
+
+        T sum   = 0;
+        T dot   = 0;
+        T total = 0;
+
+        for (size_t m = 0; m < M; ++m) {
+            dot += T(label[m]) * (row[m] - max);
+            total += T(label[m]);
+
+            row[m] = std::exp(row[m] - max);
+            sum += row[m];
+        }
+
+        // The normalization and the errors
+
+        const T inv = T(1) / sum;
+
+        for (size_t m = 0; m < M; ++m) {
+            row[m] *= inv;
+            error_row[m] = T(label[m]) - row[m];
+        }
+
+        // -sum(l * log(p)) with log(p) = z - max - log(sum)
+        loss += double(total * std::log(sum) - dot);
+        error += double(max_i != max_l);
+    }
+
+    return {error, loss};
+}
+
+/*!
+ * \brief Compute the softmax, the errors and the metrics of the categorical
+ * cross-entropy of the n first rows of the ETL logits
+ * \param output The logits, replaced by the probabilities
+ * \param labels The labels of the n first rows
+ * \param errors The errors of the loss
+ * \param n The number of rows
+ * \return a pair containing the number of misclassified rows and the sum
+ * of the loss of the rows
+ */
+template <typename Output, typename Labels, typename Errors>
+std::pair<double, double> softmax_cce(Output& output, const Labels& labels, Errors& errors, size_t n) {
+    static_assert(etl::all_dma<Output, Errors>, "The fused softmax needs direct memory access to the output and the errors");
+
+    if constexpr (etl::all_dma<Labels>) {
+        output.ensure_cpu_up_to_date();
+        labels.ensure_cpu_up_to_date();
+
+        auto metrics = softmax_cce(output.memory_start(), labels.memory_start(), errors.memory_start(), n, etl::size(output) / etl::dim<0>(output));
+
+        output.invalidate_gpu();
+        errors.invalidate_gpu();
+
+        return metrics;
+    } else {
+        return softmax_cce(output, etl::force_temporary(labels), errors, n);
+    }
+}
+
+} //end of dll namespace
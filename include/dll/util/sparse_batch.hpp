@@ -0,0 +1,160 @@
+//=======================================================================
+// Copyright (c) 2014-2017 Baptiste Wicht
+// Distributed under the terms of the MIT License.
+// (See accompanying file LICENSE or copy at
+//  http://opensource.org/licenses/MIT)
+//=======================================================================
+
+/*!
+ * \file
+ * \brief Batches of sparse inputs stored in CSR, for the products of the
+ * first layer with its weights.
+ */
+
+#pragma once
+
+#include <vector>
+#include <algorithm>
+
+#include "cpp_utils/assert.hpp"
+
+#include "etl/etl.hpp"
+
+namespace dll {
+
+/*!
+ * \brief A batch of inputs [B, K] stored in CSR (one row per sample).
+ *
+ * With very sparse inputs (bag-of-words for instance), the products of the
+ * batch with the weights only depend on the non-zero inputs.
+ */
+template <typename T>
+struct sparse_batch {
+    static constexpr double max_density = 0.1; ///< The maximum density at which the sparse batch is used
+
+    bool active = false; ///< Indicates if the sparse batch is used
+
+    size_t B = 0; ///< The number of samples
+    size_t K = 0; ///< The number of inputs
+
+    std::vector<size_t> rows;   ///< The start of each sample in the values [B + 1]
+    std::vector<uint32_t> cols; ///< The input of each value
+    std::vector<T> values;      ///< The non-zero inputs
+
+    /*!
+     * \brief Build the sparse batch from the given batch.
+     *
+     * The sparse batch is only built (and used) if the density of the batch
+     * is below max_density.
+     *
+     * \param input The batch [B, K]
+     */
+    template <typename V>
+    void update(const V& input) {
+        B = etl::dim<0>(input);
+        K = etl::size(input) / B;
+
+        input.ensure_cpu_up_to_date();
+
+        const T* ptr = input.memory_start();
+
+        const size_t nnz = B * K - std::count(ptr, ptr + B * K, T(0));
+
+        active = nnz <= max_density * B * K;
+
+        if (!active) {
+            return;
+        }
+
+        rows.resize(B + 1);
+        cols.resize(nnz);
+        values.resize(nnz);
+
+        size_t j = 0;
+
+        for (size_t b = 0; b < B; ++b) {
+            rows[b] = j;
+
+            for (size_t k = 0; k < K; ++k) {
+                if (ptr[b * K + k] != T(0)) {
+                    cols[j]   = k;
+                    values[j] = ptr[b * K + k];
+                    ++j;
+                }
+            }
+        }
+
+        rows[B] = j;
+    }
+
+    /*!
+     * \brief Compute the product of the batch with the given weights
+     * \param w The weights [K, N]
+     * \param output The output [B, N]
+     */
+    template <typename W, typename Out>
+    void multiply(const W& w, Out&& output) const {
+        const size_t N = etl::dim<1>(w);
+
+        cpp_assert(etl::dim<0>(w) == K && etl::size(output) == B * N, "Invalid dimensions for sparse_batch::multiply");
+
+        w.ensure_cpu_up_to_date();
+
+        const T* weights = w.memory_start();
+        T* out           = output.memory_start();
+
+        std::fill_n(out, B * N, T(0));
+
+        for (size_t b = 0; b < B; ++b) {
+            T* y = out + b * N;
+
+            for (size_t j = rows[b]; j < rows[b + 1]; ++j) {
+                const T v    = values[j];
+                const T* w_k = weights + cols[j] * N;
+
+                for (size_t n = 0; n < N; ++n) {
+                    y[n] += v * w_k[n];
+                }
+            }
+        }
+
+        output.invalidate_gpu();
+    }
+
+    /*!
+     * \brief Compute the outer product of the batch with the given batch,
+     * i.e. the gradients of the weights
+     * \param h The batch [B, N]
+     * \param grad The gradients [K, N]
+     */
+    template <typename H, typename G>
+    void outer(const H& h, G&& grad) const {
+        const size_t N = etl::dim<1>(grad);
+
+        cpp_assert(etl::dim<0>(grad) == K && etl::size(h) == B * N, "Invalid dimensions for sparse_batch::outer");
+
+        h.ensure_cpu_up_to_date();
+
+        const T* in = h.memory_start();
+        T* g        = grad.memory_start();
+
+        std::fill_n(g, K * N, T(0));
+
+        for (size_t b = 0; b < B; ++b) {
+            const T* h_b = in + b * N;
+
+            for (size_t j = rows[b]; j < rows[b + 1]; ++j) {
+                const T v = values[j];
+                T* g_k    = g + cols[j] * N;
+
+                for (size_t n = 0; n < N; ++n) {
+                    g_k[n] += v * h_b[n];
+                }
+            }
+        }
+
+        grad.invalidate_gpu();
+    }
+};
+
+} //end of dll namespace
@@ -0,0 +1,152 @@
+//=======================================================================
+// Copyright (c) 2014-2017 Baptiste Wicht
+// Distributed under the terms of the MIT License.
+// (See accompanying file LICENSE or copy at
+//  http://opensource.org/licenses/MIT)
+//=======================================================================
+
+/*!
+ * \file
+ * \brief Gradients with only some non-zero rows (embedding layers)
+ *
+ * The gradients are stored as dense matrices, but only the rows listed in
+ * the (sorted) list of rows can be non-zero. Only these rows are reset,
+ * reduced and updated.
+ */
+
+#pragma once
+
+#include <vector>
+#include <iterator>
+#include <algorithm>
+
+#include "cpp_utils/assert.hpp"
+
+#include "etl/etl.hpp"
+
+namespace dll {
+
+/*!
+ * \brief Reset the given rows of the gradients to zero
+ * \param grad The gradients [V, K]
+ * \param rows The rows to reset
+ */
+template <typename G>
+void zero_rows(G& grad, const std::vector<size_t>& rows) {
+    const size_t K = etl::dim<1>(grad);
+
+    grad.ensure_cpu_up_to_date();
+
+    auto* g = grad.memory_start();
+
+    for (auto r : rows) {
+        std::fill_n(g + r * K, K, typename G::value_type(0));
+    }
+
+    grad.invalidate_gpu();
+}
+
+/*!
+ * \brief Compute the gradients of the embeddings of a batch, only writing
+ * to the rows of the words of the batch.
+ *
+ * The rows of the previous gradients are reset and the rows of the batch
+ * are added to the list of rows.
+ *
+ * \param grad The gradients of the embeddings [V, K]
+ * \param rows The rows with non-zero gradients
+ * \param input The batch of input words [B, I]
+ * \param errors The batch of errors [B, I, K]
+ */
+template <typename G, typename In, typename E>
+void embedding_row_gradients(G& grad, std::vector<size_t>& rows, const In& input, const E& errors) {
+    const size_t B = etl::dim<0>(input);
+    const size_t I = etl::dim<1>(input);
+    const size_t K = etl::dim<1>(grad);
+
+    zero_rows(grad, rows);
+
+    input.ensure_cpu_up_to_date();
+    errors.ensure_cpu_up_to_date();
+
+    auto* g       = grad.memory_start();
+    const auto* e = errors.memory_start();
+
+    std::vector<size_t> batch_rows;
+    batch_rows.reserve(B * I);
+
+    for (size_t b = 0; b < B; ++b) {
+        for (size_t i = 0; i < I; ++i) {
+            const size_t r = input(b, i);
+
+            cpp_assert(r < etl::dim<0>(grad), "Invalid word for the embedding");
+
+            const auto* e_row = e + (b * I + i) * K;
+            auto* g_row       = g + r * K;
+
+            for (size_t k = 0; k < K; ++k) {
+                g_row[k] += e_row[k];
+            }
+
+            batch_rows.push_back(r);
+        }
+    }
+
+    grad.invalidate_gpu();
+
+    std::sort(batch_rows.begin(), batch_rows.end());
+    batch_rows.erase(std::unique(batch_rows.begin(), batch_rows.end()), batch_rows.end());
+
+    std::vector<size_t> all_rows;
+    all_rows.reserve(rows.size() + batch_rows.size());
+
+    std::set_union(rows.begin(), rows.end(), batch_rows.begin(), batch_rows.end(), std::back_inserter(all_rows));
+
+    rows = std::move(all_rows);
+}
+
+/*!
+ * \brief Add the row gradients of a micro-batch to the row gradients of
+ * the batch. The gradients of the micro-batch are reset.
+ *
+ * \param grad The gradients of the batch
+ * \param rows The rows of the gradients of the batch
+ * \param micro_grad The gradients of the micro-batch
+ * \param micro_rows The rows of the gradients of the micro-batch
+ * \param first Indicates if this is the first micro-batch
+ */
+template <typename G, typename MG>
+void reduce_rows(G& grad, std::vector<size_t>& rows, MG& micro_grad, std::vector<size_t>& micro_rows, bool first) {
+    const size_t K = etl::dim<1>(grad);
+
+    if (first) {
+        zero_rows(grad, rows);
+        rows.clear();
+    }
+
+    grad.ensure_cpu_up_to_date();
+    micro_grad.ensure_cpu_up_to_date();
+
+    auto* g        = grad.memory_start();
+    const auto* mg = micro_grad.memory_start();
+
+    for (auto r : micro_rows) {
+        for (size_t k = 0; k < K; ++k) {
+            g[r * K + k] += mg[r * K + k];
+        }
+    }
+
+    grad.invalidate_gpu();
+
+    std::vector<size_t> all_rows;
+    all_rows.reserve(rows.size() + micro_rows.size());
+
+    std::set_union(rows.begin(), rows.end(), micro_rows.begin(), micro_rows.end(), std::back_inserter(all_rows));
+
+    rows = std::move(all_rows);
+
+    zero_rows(micro_grad, micro_rows);
+    micro_rows.clear();
+}
+
+} //end of dll namespace
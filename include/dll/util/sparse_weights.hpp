@@ -0,0 +1,185 @@
+//=======================================================================
+// Copyright (c) 2014-2017 Baptiste Wicht
+// Distributed under the terms of the MIT License.
+// (See accompanying file LICENSE or copy at
+//  http://opensource.org/licenses/MIT)
+//=======================================================================
+
+/*!
+ * \file
+ * \brief Pruned weights of the dense layers, stored in CSR, for inference.
+ */
+
+#pragma once
+
+#include <cmath>
+#include <vector>
+#include <algorithm>
+
+#include "cpp_utils/assert.hpp"
+
+#include "etl/etl.hpp"
+
+namespace dll {
+
+/*!
+ * \brief Prune the given weights to the given sparsity, setting the
+ * weights of smallest magnitude to zero.
+ *
+ * \param w The weights
+ * \param sparsity The fraction of the weights to set to zero
+ */
+template <typename W>
+void magnitude_prune(W& w, double sparsity) {
+    using T = etl::value_t<W>;
+
+    cpp_assert(sparsity >= 0.0 && sparsity <= 1.0, "Invalid sparsity for magnitude_prune");
+
+    const size_t n    = etl::size(w);
+    const size_t zero = std::min(n, size_t(sparsity * n));
+
+    if (!zero) {
+        return;
+    }
+
+    w.ensure_cpu_up_to_date();
+
+    T* ptr = w.memory_start();
+
+    std::vector<T> magnitudes(n);
+
+    for (size_t i = 0; i < n; ++i) {
+        magnitudes[i] = std::abs(ptr[i]);
+    }
+
+    std::nth_element(magnitudes.begin(), magnitudes.begin() + (zero - 1), magnitudes.end());
+
+    const T threshold = magnitudes[zero - 1];
+
+    for (size_t i = 0; i < n; ++i) {
+        if (std::abs(ptr[i]) <= threshold) {
+            ptr[i] = T(0);
+        }
+    }
+
+    w.invalidate_gpu();
+}
+
+/*!
+ * \brief The weights [K, N] of a dense layer stored in CSR (one row per
+ * input), used for inference when there are few non-zero weights.
+ */
+template <typename T>
+struct sparse_weights {
+    static constexpr double max_density = 0.3; ///< The maximum density at which the sparse weights are used
+
+    bool active = false; ///< Indicates if the sparse weights are used
+
+    size_t K = 0; ///< The number of inputs
+    size_t N = 0; ///< The number of outputs
+
+    std::vector<size_t> rows;    ///< The start of each row in the values [K + 1]
+    std::vector<uint32_t> cols;  ///< The column of each value
+    std::vector<T> values;       ///< The non-zero weights
+
+    /*!
+     * \brief Update the sparse weights from the given weights.
+     *
+     * The sparse weights are only built (and used) if the density of the
+     * weights is below max_density.
+     *
+     * \param w The weights [K, N]
+     */
+    template <typename W>
+    void update(const W& w) {
+        K = etl::dim<0>(w);
+        N = etl::dim<1>(w);
+
+        w.ensure_cpu_up_to_date();
+
+        const T* ptr = w.memory_start();
+
+        const size_t nnz = K * N - std::count(ptr, ptr + K * N, T(0));
+
+        active = nnz <= max_density * K * N;
+
+        if (!active) {
+            rows.clear();
+            cols.clear();
+            values.clear();
+            return;
+        }
+
+        rows.resize(K + 1);
+        cols.resize(nnz);
+        values.resize(nnz);
+
+        size_t j = 0;
+
+        for (size_t k = 0; k < K; ++k) {
+            rows[k] = j;
+
+            for (size_t n = 0; n < N; ++n) {
+                if (ptr[k * N + n] != T(0)) {
+                    cols[j]   = n;
+                    values[j] = ptr[k * N + n];
+                    ++j;
+                }
+            }
+        }
+
+        rows[K] = j;
+    }
+
+    /*!
+     * \brief Returns the fraction of non-zero weights
+     */
+    double density() const {
+        return K * N ? double(values.size()) / (K * N) : 1.0;
+    }
+
+    /*!
+     * \brief Compute the output of the dense layer
+     * \param input The batch of input [B, K]
+     * \param output The batch of output [B, N]
+     * \param epilogue The operation applied to each output value
+     */
+    template <typename In, typename Out, typename E>
+    void forward(const In& input, Out&& output, E epilogue) const {
+        const size_t B = etl::dim<0>(input);
+
+        cpp_assert(etl::size(input) == B * K && etl::size(output) == B * N, "Invalid dimensions for sparse_weights");
+
+        input.ensure_cpu_up_to_date();
+
+        const T* in = input.memory_start();
+        T* out      = output.memory_start();
+
+        for (size_t b = 0; b < B; ++b) {
+            const T* x = in + b * K;
+            T* y       = out + b * N;
+
+            std::fill_n(y, N, T(0));
+
+            for (size_t k = 0; k < K; ++k) {
+                const T v = x[k];
+
+                if (v == T(0)) {
+                    continue;
+                }
+
+                for (size_t j = rows[k]; j < rows[k + 1]; ++j) {
+                    y[cols[j]] += v * values[j];
+                }
+            }
+
+            for (size_t n = 0; n < N; ++n) {
+                y[n] = epilogue(n, y[n]);
+            }
+        }
+
+        output.invalidate_gpu();
+    }
+};
+
+} //end of dll namespace
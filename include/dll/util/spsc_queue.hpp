@@ -0,0 +1,87 @@
+//=======================================================================
+// Copyright (c) 2014-2017 Baptiste Wicht
+// Distributed under the terms of the MIT License.
+// (See accompanying file LICENSE or copy at
+//  http://opensource.org/licenses/MIT)
+//=======================================================================
+
+/*!
+ * \file
+ * \brief Bounded lock-free queue with a single producer and a single consumer
+ */
+
+#pragma once
+
+#include <atomic>
+
+namespace dll {
+
+/*!
+ * \brief A bounded lock-free queue for one producer thread and one consumer
+ * thread.
+ *
+ * The producer never blocks: when the queue is full, the value is dropped
+ * and counted.
+ *
+ * \tparam T The type of the values
+ * \tparam N The capacity of the queue (a power of two)
+ */
+template <typename T, size_t N>
+struct spsc_queue {
+    static_assert(N && !(N & (N - 1)), "The capacity of spsc_queue must be a power of two");
+
+    /*!
+     * \brief Push a value in the queue (producer only)
+     * \param value The value to push
+     * \return true if the value was pushed, false if the queue was full
+     */
+    bool push(const T& value) {
+        const size_t t = tail.load(std::memory_order_relaxed);
+
+        if (t - head.load(std::memory_order_acquire) == N) {
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+
+        values[t & (N - 1)] = value;
+
+        tail.store(t + 1, std::memory_order_release);
+
+        return true;
+    }
+
+    /*!
+     * \brief Pop a value from the queue (consumer only)
+     * \param value The popped value
+     * \return true if a value was popped, false if the queue was empty
+     */
+    bool pop(T& value) {
+        const size_t h = head.load(std::memory_order_relaxed);
+
+        if (h == tail.load(std::memory_order_acquire)) {
+            return false;
+        }
+
+        value = values[h & (N - 1)];
+
+        head.store(h + 1, std::memory_order_release);
+
+        return true;
+    }
+
+    /*!
+     * \brief Returns the number of values dropped because the queue was full
+     */
+    size_t drops() const {
+        return dropped.load(std::memory_order_relaxed);
+    }
+
+private:
+    T values[N]; ///< The storage of the values
+
+    alignas(64) std::atomic<size_t> head{0};    ///< The next position to pop
+    alignas(64) std::atomic<size_t> tail{0};    ///< The next position to push
+    alignas(64) std::atomic<size_t> dropped{0}; ///< The number of dropped values
+};
+
+} //end of dll namespace
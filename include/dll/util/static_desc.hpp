@@ -0,0 +1,123 @@
+//=======================================================================
+// Copyright (c) 2014-2017 Baptiste Wicht
+// Distributed under the terms of the MIT License.
+// (See accompanying file LICENSE or copy at
+//  http://opensource.org/licenses/MIT)
+//=======================================================================
+
+/*!
+ * \file
+ * \brief Generation of the static descriptor of a configured dynamic network
+ *
+ * Once the shapes of a dynamic network are known (after a search over the
+ * architectures or after loading a configuration), the source of the
+ * equivalent network of static layers can be generated, compiled and used
+ * in place of the dynamic network. The weights of the dynamic and static
+ * layers are stored in the same format: the weights stored from the
+ * dynamic network can be loaded directly into the static network.
+ */
+
+#pragma once
+
+#include <iostream>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "dll/function.hpp"
+#include "dll/loss.hpp"
+#include "dll/updater_type.hpp"
+
+namespace dll {
+
+/*!
+ * \brief Traits to test if a layer can generate the descriptor of its
+ * static equivalent
+ */
+template <typename Layer, typename Enable = void>
+struct has_static_desc : std::false_type {};
+
+/*!
+ * \copydoc has_static_desc
+ */
+template <typename Layer>
+struct has_static_desc<Layer, std::void_t<decltype(std::declval<const Layer&>().static_desc())>> : std::true_type {};
+
+namespace detail {
+
+/*!
+ * \brief Returns the weight_type parameter of a static layer of the given
+ * data type (nothing for the default float type)
+ */
+template <typename W>
+std::string static_weight_param() {
+    if constexpr (std::is_same<W, double>::value) {
+        return ", dll::weight_type<double>";
+    } else {
+        return "";
+    }
+}
+
+/*!
+ * \brief Returns the activation parameter of a static layer
+ */
+inline std::string static_activation_param(function f) {
+    return ", dll::activation<dll::function::" + to_string(f) + ">";
+}
+
+/*!
+ * \brief Generate the source of a static network from the descriptors of
+ * its layers
+ */
+inline std::string static_network_source(const std::vector<std::string>& layers, size_t batch_size, updater_type updater, loss_function loss, const std::string& name) {
+    std::string source = "using " + name + " = dll::fast_network_desc<\n    dll::network_layers<";
+
+    for (size_t i = 0; i < layers.size(); ++i) {
+        source += (i ? ",\n        " : "\n        ") + layers[i];
+    }
+
+    source += ">\n    , dll::batch_size<" + std::to_string(batch_size) + ">";
+    source += "\n    , dll::updater<dll::updater_type::" + to_string(updater) + ">";
+    source += "\n    , dll::loss<dll::loss_function::" + to_string(loss) + ">\n    >::network_t;\n";
+
+    return source;
+}
+
+} //end of namespace detail
+
+/*!
+ * \brief Generate the source of the static network equivalent to the given
+ * configured network.
+ *
+ * The source declares an alias of the given name to the static network. Only
+ * the batch size, the updater and the loss of the network are part of it,
+ * the other options of the network (trainer, ...) must be added by hand.
+ *
+ * \param dbn The network, with all its layers initialized
+ * \param name The name of the alias
+ * \return The source of the static network, an empty string if a layer has
+ * no static equivalent
+ */
+template <typename DBN>
+std::string static_network_desc(const DBN& dbn, const std::string& name = "network_t") {
+    std::vector<std::string> layers;
+
+    bool valid = true;
+
+    dbn.for_each_layer([&layers, &valid](auto& layer) {
+        if constexpr (has_static_desc<std::decay_t<decltype(layer)>>::value) {
+            layers.push_back(layer.static_desc());
+        } else {
+            std::cerr << "ERROR: The layer " << layer.to_short_string() << " has no static equivalent" << std::endl;
+            valid = false;
+        }
+    });
+
+    if (!valid) {
+        return "";
+    }
+
+    return detail::static_network_source(layers, DBN::batch_size, DBN::updater, DBN::loss, name);
+}
+
+} //end of dll namespace
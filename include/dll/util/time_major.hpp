@@ -0,0 +1,509 @@
+//=======================================================================
+// Copyright (c) 2014-2017 Baptiste Wicht
+// Distributed under the terms of the MIT License.
+// (See accompanying file LICENSE or copy at
+//  http://opensource.org/licenses/MIT)
+//=======================================================================
+
+/*!
+ * \file
+ * \brief Rearrangement of batches of sequences between the batch-major and
+ * the time-major layouts of the recurrent layers
+ *
+ * When a recurrent layer is directly followed by a recurrent_last layer,
+ * its batch-major outputs and errors only hold the last time step of the
+ * sequences ([B, N] instead of [B, T, N]).
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <vector>
+
+#include "etl/etl.hpp"
+
+namespace dll {
+
+/*!
+ * \brief Exchange the first two dimensions of a batch of sequences, i.e.
+ * rearrange [B, T, N] into [T, B, N] (or the reverse).
+ *
+ * The rows of N elements are contiguous in both layouts, so they are
+ * copied as blocks, in the order of the destination.
+ *
+ * \param dst The rearranged batch
+ * \param src The batch to rearrange
+ */
+template <typename D, typename S>
+void swap_batch_time(D&& dst, const S& src) {
+    const size_t A = etl::dim<0>(src);
+    const size_t B = etl::dim<1>(src);
+
+    cpp_assert(etl::dim<0>(dst) == B && etl::dim<1>(dst) == A, "Invalid dimensions for swap_batch_time");
+
+    if constexpr (etl::all_dma<D, S>) {
+        const size_t N = etl::size(src) / (A * B);
+
+        src.ensure_cpu_up_to_date();
+
+        const auto* in = src.memory_start();
+        auto* out      = dst.memory_start();
+
+        for (size_t b = 0; b < B; ++b) {
+            for (size_t a = 0; a < A; ++a) {
+                std::copy_n(in + (a * B + b) * N, N, out + (b * A + a) * N);
+            }
+        }
+
+        dst.invalidate_gpu();
+    } else {
+        for (size_t b = 0; b < B; ++b) {
+            for (size_t a = 0; a < A; ++a) {
+                dst(b)(a) = src(a)(b);
+            }
+        }
+    }
+}
+
+/*!
+ * \brief Rearrange a window of time steps of a batch-major batch of
+ * sequences into the time-major layout, i.e. dst(t)(b) = src(b)(first + t).
+ *
+ * \param dst The time-major window [W, B, N]
+ * \param src The batch-major batch [B, T, N]
+ * \param first The first time step of the window
+ */
+template <typename D, typename S>
+void batch_to_time_window(D&& dst, const S& src, size_t first) {
+    const size_t W = etl::dim<0>(dst);
+    const size_t B = etl::dim<0>(src);
+    const size_t T = etl::dim<1>(src);
+
+    cpp_assert(etl::dim<1>(dst) == B && first + W <= T, "Invalid dimensions for batch_to_time_window");
+
+    if constexpr (etl::all_dma<D, S>) {
+        const size_t N = etl::size(src) / (B * T);
+
+        src.ensure_cpu_up_to_date();
+
+        const auto* in = src.memory_start();
+        auto* out      = dst.memory_start();
+
+        for (size_t t = 0; t < W; ++t) {
+            for (size_t b = 0; b < B; ++b) {
+                std::copy_n(in + (b * T + first + t) * N, N, out + (t * B + b) * N);
+            }
+        }
+
+        dst.invalidate_gpu();
+    } else {
+        for (size_t t = 0; t < W; ++t) {
+            for (size_t b = 0; b < B; ++b) {
+                dst(t)(b) = src(b)(first + t);
+            }
+        }
+    }
+}
+
+/*!
+ * \brief Write a time-major window of time steps into a batch-major batch
+ * of sequences, i.e. dst(b)(first + t) = src(t)(b).
+ *
+ * \param dst The batch-major batch [B, T, N]
+ * \param src The time-major window [W, B, N]
+ * \param first The first time step of the window
+ */
+template <typename D, typename S>
+void time_window_to_batch(D&& dst, const S& src, size_t first) {
+    const size_t W = etl::dim<0>(src);
+    const size_t B = etl::dim<0>(dst);
+    const size_t T = etl::dim<1>(dst);
+
+    cpp_assert(etl::dim<1>(src) == B && first + W <= T, "Invalid dimensions for time_window_to_batch");
+
+    if constexpr (etl::all_dma<D, S>) {
+        const size_t N = etl::size(dst) / (B * T);
+
+        src.ensure_cpu_up_to_date();
+        dst.ensure_cpu_up_to_date();
+
+        const auto* in = src.memory_start();
+        auto* out      = dst.memory_start();
+
+        for (size_t b = 0; b < B; ++b) {
+            for (size_t t = 0; t < W; ++t) {
+                std::copy_n(in + (t * B + b) * N, N, out + (b * T + first + t) * N);
+            }
+        }
+
+        dst.invalidate_gpu();
+    } else {
+        for (size_t b = 0; b < B; ++b) {
+            for (size_t t = 0; t < W; ++t) {
+                dst(b)(first + t) = src(t)(b);
+            }
+        }
+    }
+}
+
+/*!
+ * \brief Indicates if the given batch-major batch only holds the last time
+ * step of the sequences ([B, N] instead of [B, T, N])
+ */
+template <typename E>
+constexpr bool is_last_step = etl::decay_traits<E>::dimensions() == 2;
+
+/*!
+ * \brief Write the time-major outputs [T, B, N] into the batch-major
+ * outputs, the complete sequences [B, T, N] or only their last time step
+ * [B, N].
+ *
+ * \param dst The batch-major outputs
+ * \param src The time-major outputs
+ */
+template <typename D, typename S>
+void outputs_to_batch(D&& dst, const S& src) {
+    if constexpr (is_last_step<D>) {
+        dst = src(etl::dim<0>(src) - 1);
+    } else {
+        swap_batch_time(dst, src);
+    }
+}
+
+/*!
+ * \brief Write a time-major window of outputs [W, B, N] into the
+ * batch-major outputs, the complete sequences [B, T, N] or only their last
+ * time step [B, N].
+ *
+ * \param dst The batch-major outputs
+ * \param src The time-major window
+ * \param first The first time step of the window
+ * \param time_steps The number of time steps of the sequences
+ */
+template <typename D, typename S>
+void outputs_window_to_batch(D&& dst, const S& src, size_t first, size_t time_steps) {
+    if constexpr (is_last_step<D>) {
+        if (first + etl::dim<0>(src) == time_steps) {
+            dst = src(etl::dim<0>(src) - 1);
+        }
+    } else {
+        cpp_unused(time_steps);
+
+        time_window_to_batch(dst, src, first);
+    }
+}
+
+/*!
+ * \brief Rearrange the batch-major errors, of the complete sequences
+ * [B, T, N] or only of their last time step [B, N], into the time-major
+ * errors [T, B, N]. The time steps without errors are set to zero.
+ *
+ * \param dst The time-major errors
+ * \param src The batch-major errors
+ */
+template <typename D, typename S>
+void errors_to_time(D&& dst, const S& src) {
+    if constexpr (is_last_step<S>) {
+        dst = 0;
+        dst(etl::dim<0>(dst) - 1) = src;
+    } else {
+        swap_batch_time(dst, src);
+    }
+}
+
+/*!
+ * \brief Rearrange a window of the batch-major errors, of the complete
+ * sequences [B, T, N] or only of their last time step [B, N], into the
+ * time-major window [W, B, N]. The time steps without errors are set to
+ * zero.
+ *
+ * \param dst The time-major window
+ * \param src The batch-major errors
+ * \param first The first time step of the window
+ * \param time_steps The number of time steps of the sequences
+ */
+template <typename D, typename S>
+void errors_to_time_window(D&& dst, const S& src, size_t first, size_t time_steps) {
+    if constexpr (is_last_step<S>) {
+        dst = 0;
+
+        if (first + etl::dim<0>(dst) == time_steps) {
+            dst(etl::dim<0>(dst) - 1) = src;
+        }
+    } else {
+        cpp_unused(time_steps);
+
+        batch_to_time_window(dst, src, first);
+    }
+}
+
+/*!
+ * \brief Returns the length of a zero-padded sequence [T, N], i.e. the
+ * number of time steps up to its last non-zero one.
+ *
+ * \param seq The first element of the sequence
+ * \param time_steps The number of time steps T
+ * \param n The number of elements per time step N
+ */
+template <typename T>
+size_t padded_length(const T* seq, size_t time_steps, size_t n) {
+    for (size_t t = time_steps; t > 0; --t) {
+        const T* row = seq + (t - 1) * n;
+
+        if (std::any_of(row, row + n, [](T v) { return v != T(0); })) {
+            return t;
+        }
+    }
+
+    return 0;
+}
+
+/*!
+ * \brief Compute the lengths of the zero-padded sequences of a time-major
+ * batch.
+ *
+ * active[t] is the number of leading rows of the batch containing all the
+ * sequences still running at step t. When the batch is sorted by
+ * decreasing length, these rows are exactly the running sequences.
+ *
+ * \param lengths The length of each sequence [B]
+ * \param active The number of active rows at each time step [T]
+ * \param src The time-major batch [T, B, N]
+ */
+template <typename S>
+void padded_lengths(std::vector<size_t>& lengths, std::vector<size_t>& active, const S& src) {
+    const size_t T = etl::dim<0>(src);
+    const size_t B = etl::dim<1>(src);
+    const size_t N = etl::dim<2>(src);
+
+    lengths.assign(B, 0);
+    active.assign(T, 0);
+
+    src.ensure_cpu_up_to_date();
+
+    const auto* in = src.memory_start();
+
+    for (size_t b = 0; b < B; ++b) {
+        for (size_t t = T; t > 0; --t) {
+            const auto* row = in + ((t - 1) * B + b) * N;
+
+            if (std::any_of(row, row + N, [](auto v) { return v != 0; })) {
+                lengths[b] = t;
+                break;
+            }
+        }
+
+        for (size_t t = 0; t < lengths[b]; ++t) {
+            active[t] = b + 1;
+        }
+    }
+}
+
+/*!
+ * \brief Write the time-major outputs [T, B, N] of zero-padded sequences
+ * into the batch-major outputs. When only the last time step is output
+ * [B, N], this is the last step of each sequence.
+ *
+ * \param dst The batch-major outputs
+ * \param src The time-major outputs
+ * \param lengths The length of each sequence
+ */
+template <typename D, typename S>
+void outputs_to_batch(D&& dst, const S& src, const std::vector<size_t>& lengths) {
+    if constexpr (is_last_step<D>) {
+        for (size_t b = 0; b < lengths.size(); ++b) {
+            if (lengths[b]) {
+                dst(b) = src(lengths[b] - 1)(b);
+            } else {
+                dst(b) = 0;
+            }
+        }
+    } else {
+        swap_batch_time(dst, src);
+    }
+}
+
+/*!
+ * \brief Rearrange the batch-major errors of zero-padded sequences into the
+ * time-major errors [T, B, N]. The errors of the padding are set to zero.
+ * When only the last time step is output [B, N], its errors are placed at
+ * the last step of each sequence.
+ *
+ * \param dst The time-major errors
+ * \param src The batch-major errors
+ * \param lengths The length of each sequence
+ */
+template <typename D, typename S>
+void errors_to_time(D&& dst, const S& src, const std::vector<size_t>& lengths) {
+    if constexpr (is_last_step<S>) {
+        dst = 0;
+
+        for (size_t b = 0; b < lengths.size(); ++b) {
+            if (lengths[b]) {
+                dst(lengths[b] - 1)(b) = src(b);
+            }
+        }
+    } else {
+        swap_batch_time(dst, src);
+
+        for (size_t b = 0; b < lengths.size(); ++b) {
+            for (size_t t = lengths[b]; t < etl::dim<0>(dst); ++t) {
+                dst(t)(b) = 0;
+            }
+        }
+    }
+}
+
+/*!
+ * \brief Reverse the time steps of a batch-major batch of sequences, i.e.
+ * dst(b)(t) = src(b)(T - 1 - t). With Add, the reversed sequences are
+ * added to dst instead.
+ *
+ * \param dst The reversed batch [B, T, N]
+ * \param src The batch to reverse [B, T, N]
+ */
+template <bool Add = false, typename D, typename S>
+void reverse_time(D&& dst, const S& src) {
+    const size_t B = etl::dim<0>(src);
+    const size_t T = etl::dim<1>(src);
+
+    cpp_assert(etl::dim<0>(dst) == B && etl::dim<1>(dst) == T, "Invalid dimensions for reverse_time");
+
+    if constexpr (etl::all_dma<D, S>) {
+        const size_t N = etl::size(src) / (B * T);
+
+        src.ensure_cpu_up_to_date();
+
+        if constexpr (Add) {
+            dst.ensure_cpu_up_to_date();
+        }
+
+        const auto* in = src.memory_start();
+        auto* out      = dst.memory_start();
+
+        for (size_t b = 0; b < B; ++b) {
+            for (size_t t = 0; t < T; ++t) {
+                const auto* src_row = in + (b * T + T - 1 - t) * N;
+                auto* dst_row       = out + (b * T + t) * N;
+
+                if constexpr (Add) {
+                    for (size_t n = 0; n < N; ++n) {
+                        dst_row[n] += src_row[n];
+                    }
+                } else {
+                    std::copy_n(src_row, N, dst_row);
+                }
+            }
+        }
+
+        dst.invalidate_gpu();
+    } else {
+        for (size_t b = 0; b < B; ++b) {
+            for (size_t t = 0; t < T; ++t) {
+                if constexpr (Add) {
+                    dst(b)(t) += src(b)(T - 1 - t);
+                } else {
+                    dst(b)(t) = src(b)(T - 1 - t);
+                }
+            }
+        }
+    }
+}
+
+/*!
+ * \brief Write time-major outputs [T, B, N] into the columns
+ * [first, first + N) of batch-major outputs [B, T, M], optionally reversing
+ * the time steps, i.e. dst(b)(t)[first + n] = src(t')(b)[n] with
+ * t' = T - 1 - t when reversed.
+ *
+ * \param dst The batch-major outputs [B, T, M]
+ * \param src The time-major outputs [T, B, N]
+ * \param first The first column of the slice
+ * \param reverse Indicates if the time steps are reversed
+ */
+template <typename D, typename S>
+void time_to_batch_slice(D&& dst, const S& src, size_t first, bool reverse) {
+    const size_t T = etl::dim<0>(src);
+    const size_t B = etl::dim<1>(src);
+    const size_t N = etl::dim<2>(src);
+    const size_t M = etl::dim<2>(dst);
+
+    cpp_assert(etl::dim<0>(dst) == B && etl::dim<1>(dst) == T && first + N <= M, "Invalid dimensions for time_to_batch_slice");
+
+    if constexpr (etl::all_dma<D, S>) {
+        src.ensure_cpu_up_to_date();
+        dst.ensure_cpu_up_to_date();
+
+        const auto* in = src.memory_start();
+        auto* out      = dst.memory_start();
+
+        for (size_t b = 0; b < B; ++b) {
+            for (size_t t = 0; t < T; ++t) {
+                const size_t tt = reverse ? T - 1 - t : t;
+
+                std::copy_n(in + (tt * B + b) * N, N, out + (b * T + t) * M + first);
+            }
+        }
+
+        dst.invalidate_gpu();
+    } else {
+        for (size_t b = 0; b < B; ++b) {
+            for (size_t t = 0; t < T; ++t) {
+                const size_t tt = reverse ? T - 1 - t : t;
+
+                for (size_t n = 0; n < N; ++n) {
+                    dst(b, t, first + n) = src(tt, b, n);
+                }
+            }
+        }
+    }
+}
+
+/*!
+ * \brief Extract the columns [first, first + N) of batch-major sequences
+ * [B, T, M] into batch-major sequences [B, T, N], optionally reversing the
+ * time steps.
+ *
+ * \param dst The extracted sequences [B, T, N]
+ * \param src The batch-major sequences [B, T, M]
+ * \param first The first column of the slice
+ * \param reverse Indicates if the time steps are reversed
+ */
+template <typename D, typename S>
+void batch_slice_to_batch(D&& dst, const S& src, size_t first, bool reverse) {
+    const size_t B = etl::dim<0>(dst);
+    const size_t T = etl::dim<1>(dst);
+    const size_t N = etl::dim<2>(dst);
+    const size_t M = etl::dim<2>(src);
+
+    cpp_assert(etl::dim<0>(src) == B && etl::dim<1>(src) == T && first + N <= M, "Invalid dimensions for batch_slice_to_batch");
+
+    if constexpr (etl::all_dma<D, S>) {
+        src.ensure_cpu_up_to_date();
+
+        const auto* in = src.memory_start();
+        auto* out      = dst.memory_start();
+
+        for (size_t b = 0; b < B; ++b) {
+            for (size_t t = 0; t < T; ++t) {
+                const size_t tt = reverse ? T - 1 - t : t;
+
+                std::copy_n(in + (b * T + tt) * M + first, N, out + (b * T + t) * N);
+            }
+        }
+
+        dst.invalidate_gpu();
+    } else {
+        for (size_t b = 0; b < B; ++b) {
+            for (size_t t = 0; t < T; ++t) {
+                const size_t tt = reverse ? T - 1 - t : t;
+
+                for (size_t n = 0; n < N; ++n) {
+                    dst(b, t, n) = src(b, tt, first + n);
+                }
+            }
+        }
+    }
+}
+
+} //end of dll namespace
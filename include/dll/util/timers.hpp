@@ -8,12 +8,24 @@
 #pragma once
 
 #include <chrono>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "dll/util/perf_counters.hpp"
+#include "dll/util/etl_counters.hpp"
 
 #ifndef DLL_NO_TIMERS
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <fstream>
 #include <iosfwd>
-#include <iomanip>
-#include <sstream>
+#include <memory>
+#include <mutex>
+#include <numeric>
 
 #endif
 
@@ -42,6 +54,67 @@ struct stop_timer {
     }
 };
 
+inline std::string to_string_precision(double duration, int precision = 6) {
+    std::ostringstream out;
+    out << std::setprecision(precision) << duration;
+    return out.str();
+}
+
+inline std::string duration_str(double duration, int precision = 6) {
+    if (duration > 1000.0 * 1000.0 * 1000.0) {
+        return to_string_precision(duration / (1000.0 * 1000.0 * 1000.0), precision) + "s";
+    } else if (duration > 1000.0 * 1000.0) {
+        return to_string_precision(duration / (1000.0 * 1000.0), precision) + "ms";
+    } else if (duration > 1000.0) {
+        return to_string_precision(duration / 1000.0, precision) + "us";
+    } else {
+        return to_string_precision(duration, precision) + "ns";
+    }
+}
+
+/*!
+ * \brief The names of the timers of the layer L in the trainers
+ */
+template <size_t L>
+struct layer_timers {
+    /*!
+     * \brief Returns the name of the timer of the forward pass of the layer
+     */
+    static const char* forward() {
+        static const std::string name = "layer_" + std::to_string(L) + ":forward";
+        return name.c_str();
+    }
+
+    /*!
+     * \brief Returns the name of the timer of the backward pass (errors and
+     * gradients) of the layer
+     */
+    static const char* backward() {
+        static const std::string name = "layer_" + std::to_string(L) + ":backward";
+        return name.c_str();
+    }
+
+    /*!
+     * \brief Returns the name of the timer of the test forward pass of the
+     * layer in the network
+     */
+    static const char* test() {
+        static const std::string name = "layer_" + std::to_string(L) + ":test";
+        return name.c_str();
+    }
+};
+
+/*!
+ * \brief The merged values of a timer
+ */
+struct timer_t {
+    const char* name;          ///< The name of the timer
+    size_t count;              ///< The number of times it was incremented
+    size_t duration;           ///< The total duration
+    perf_values counters = {}; ///< The total of the hardware counters (if sampled)
+    etl_values etl       = {}; ///< The total of the counters of ETL (if ETL_COUNTERS)
+};
+
 #ifdef DLL_NO_TIMERS
 
 /*!
@@ -70,6 +143,55 @@ inline void dump_timers_pretty() {
     std::cout << "Timers have been disabled by defining DLL_NO_TIMERS" << std::endl;
 }
 
+/*!
+ * \brief Returns the timers of all the threads, merged by name.
+ *
+ * This is always empty if the timers were disabled.
+ */
+inline std::vector<timer_t> merged_timers() {
+    return {};
+}
+
+/*!
+ * \brief Reset all timers.
+ *
+ * This has no effect if the timers were disabled.
+ */
+inline void reset_timers() {}
+
+/*!
+ * \brief Dump the tree of the timers to the console.
+ *
+ * This has no effect if the timers were disabled.
+ */
+inline void dump_timers_tree() {
+    std::cout << "Timers have been disabled by defining DLL_NO_TIMERS" << std::endl;
+}
+
+/*!
+ * \brief Start recording the timeline of the timers.
+ *
+ * This has no effect if the timers were disabled.
+ */
+inline void enable_trace() {}
+
+/*!
+ * \brief Stop recording the timeline of the timers.
+ *
+ * This has no effect if the timers were disabled.
+ */
+inline void disable_trace() {}
+
+/*!
+ * \brief Write the timeline of the timers to the given file.
+ *
+ * This has no effect if the timers were disabled.
+ */
+inline bool dump_trace(const std::string& /*file*/) {
+    std::cout << "Timers have been disabled by defining DLL_NO_TIMERS" << std::endl;
+    return false;
+}
+
 struct auto_timer {
     auto_timer(const char* /*name*/) {}
 };
@@ -80,114 +202,406 @@ struct unsafe_auto_timer {
 
 #else
 
-constexpr size_t max_timers = 128; ///< The maximum number of timers
+constexpr size_t max_timers       = 256;     ///< The maximum number of timers (scopes) of each thread
+constexpr size_t max_trace_events = 1 << 20; ///< The maximum number of events of the timeline of each thread
+
+namespace timers_detail {
 
 /*!
- * \brief A timer
+ * \brief A scope in the tree of timers of a thread
  */
-struct timer_t {
-    const char* name;             ///< The name of the timer
-    std::atomic<size_t> count;    ///< The number of times it was incremented
-    std::atomic<size_t> duration; ///< The total duration
+struct timer_node {
+    const char* name    = nullptr; ///< The name of the timer
+    size_t parent       = 0;       ///< The index of the parent scope
+    size_t first_child  = 0;       ///< The index of the first child scope (owner only)
+    size_t next_sibling = 0;       ///< The index of the next sibling scope (owner only)
 
-    /*!
-     * \brief Initialize an empty counter
-     */
-    timer_t()
-            : name(nullptr), count(0), duration(0) {}
+    std::atomic<size_t> count{0};    ///< The number of times the scope was entered
+    std::atomic<size_t> duration{0}; ///< The total duration
 
-    /*!
-     * \brief Copy a timer
-     */
-    timer_t(const timer_t& rhs)
-            : name(rhs.name), count(rhs.count.load()), duration(rhs.duration.load()) {}
+    std::array<std::atomic<size_t>, perf_events> counters{};  ///< The total of the hardware counters
+    std::array<std::atomic<size_t>, etl_counter_kinds> etl{}; ///< The total of the counters of ETL
+};
+
+/*!
+ * \brief An event of the timeline, one run of a timer
+ */
+struct trace_event {
+    const char* name; ///< The name of the timer
+    size_t begin;     ///< The start time (ns)
+    size_t end;       ///< The end time (ns)
+};
+
+/*!
+ * \brief The tree of timers of one thread.
+ *
+ * Each scope is identified by its name and its parent scope, giving the
+ * call path of the timers. Only the owning thread creates and increments
+ * the scopes, with plain loads and stores, without any lock nor atomic
+ * read-modify-write operation. The other threads only read the scopes,
+ * once the number of scopes has been published.
+ */
+struct thread_timers {
+    std::array<timer_node, max_timers> nodes; ///< The scopes, the first one is the root
+    std::atomic<size_t> size{1};              ///< The number of published scopes
+    std::atomic<bool> alive{true};            ///< Indicates if the owning thread is still running
+
+    size_t current = 0;    ///< The current scope (owner only)
+    bool overflow  = false; ///< Indicates if some scopes could not be created (owner only)
+
+    size_t tid = 0;                  ///< The index of the thread in the timeline
+    std::vector<trace_event> events; ///< The events of the timeline
+    std::mutex trace_lock;           ///< The lock protecting the events (only contended by the dumps)
 
     /*!
-     * \brief Copy assign a timer
+     * \brief Enter the given scope from the current scope
+     * \param name The name of the timer
+     * \return The index of the scope, max_timers if there is no room left
      */
-    timer_t& operator=(const timer_t& rhs) {
-        if (&rhs != this) {
-            name     = rhs.name;
-            count    = rhs.count.load();
-            duration = rhs.duration.load();
+    size_t enter(const char* name) {
+        for (size_t c = nodes[current].first_child; c; c = nodes[c].next_sibling) {
+            if (nodes[c].name == name) {
+                return current = c;
+            }
         }
 
-        return *this;
+        // At this point the scope does not exist, create it
+
+        const size_t n = size.load(std::memory_order_relaxed);
+
+        if (n == max_timers) {
+            if (!overflow) {
+                std::cerr << "Unable to register timer " << name << std::endl;
+                overflow = true;
+            }
+
+            return max_timers;
+        }
+
+        nodes[n].name         = name;
+        nodes[n].parent       = current;
+        nodes[n].next_sibling = nodes[current].first_child;
+
+        size.store(n + 1, std::memory_order_release);
+
+        nodes[current].first_child = n;
+
+        return current = n;
     }
 
     /*!
-     * \brief Move construct a timer
+     * \brief Leave the given scope and go back to its parent
+     * \param node The index of the scope
+     * \param parent The index of the parent scope
+     * \param duration The duration spent in the scope
+     * \param counters The hardware counters of the scope (nullptr if not sampled)
+     * \param etl The counters of ETL of the scope (nullptr if not sampled)
      */
-    timer_t(timer_t&& rhs)
-            : name(std::move(rhs.name)), count(rhs.count.load()), duration(rhs.duration.load()) {}
+    void leave(size_t node, size_t parent, size_t duration, const perf_values* counters = nullptr, const etl_values* etl = nullptr) {
+        if (node != max_timers) {
+            auto& n = nodes[node];
+
+            n.count.store(n.count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            n.duration.store(n.duration.load(std::memory_order_relaxed) + duration, std::memory_order_relaxed);
+
+            if (counters) {
+                for (size_t e = 0; e < perf_events; ++e) {
+                    n.counters[e].store(n.counters[e].load(std::memory_order_relaxed) + (*counters)[e], std::memory_order_relaxed);
+                }
+            }
+
+            if (etl) {
+                for (size_t e = 0; e < etl_counter_kinds; ++e) {
+                    n.etl[e].store(n.etl[e].load(std::memory_order_relaxed) + (*etl)[e], std::memory_order_relaxed);
+                }
+            }
+        }
+
+        current = parent;
+    }
 
     /*!
-     * \brief Move assign a timer
+     * \brief Add an event to the timeline of the thread
+     * \param node The index of the scope
+     * \param begin The start time (ns)
+     * \param end The end time (ns)
      */
-    timer_t& operator=(timer_t&& rhs) {
-        if (&rhs != this) {
-            name     = std::move(rhs.name);
-            count    = rhs.count.load();
-            duration = rhs.duration.load();
+    void trace(size_t node, size_t begin, size_t end) {
+        if (node == max_timers) {
+            return;
         }
 
-        return *this;
+        std::lock_guard<std::mutex> l(trace_lock);
+
+        if (events.size() < max_trace_events) {
+            events.push_back({nodes[node].name, begin, end});
+        }
     }
 };
 
 /*!
- * \brief The structure holding all the timers
+ * \brief The registry of the timers of all the threads
  */
-struct timers_t {
-    std::array<timer_t, max_timers> timers; ///< The timers
-    std::mutex lock; ///< The lock to protect the timers
+struct timers_registry {
+    std::vector<std::shared_ptr<thread_timers>> threads; ///< The timers of each thread
+    std::mutex lock;                                     ///< The lock to protect the list of threads
+    size_t next_tid = 0;                                 ///< The index of the next thread in the timeline
+    std::atomic<bool> tracing{false};                    ///< Indicates if the timeline is recorded
+};
 
-    /*!
-     * \brief Reset the status of the timers
-     */
-    void reset(){
-        std::lock_guard<std::mutex> l(lock);
+/*!
+ * \brief Get a reference to the registry of the timers
+ */
+inline timers_registry& get_registry() {
+    static timers_registry registry;
+    return registry;
+}
 
-        for(auto& timer : timers){
-            timer.name = nullptr;
-            timer.duration = 0;
-            timer.count = 0;
-        }
+/*!
+ * \brief The handle of the timers of a thread, registering them on
+ * creation. The timers remain in the registry once the thread exits.
+ */
+struct thread_timers_handle {
+    std::shared_ptr<thread_timers> timers; ///< The timers of the thread
+
+    thread_timers_handle() : timers(std::make_shared<thread_timers>()) {
+        decltype(auto) registry = get_registry();
+
+        std::lock_guard<std::mutex> l(registry.lock);
+        timers->tid = registry.next_tid++;
+        registry.threads.push_back(timers);
+    }
+
+    ~thread_timers_handle() {
+        timers->alive = false;
     }
 };
 
 /*!
- * \brief Get a reference to the timer structure
+ * \brief Get a reference to the timers of the current thread
  */
-inline timers_t& get_timers() {
-    static timers_t timers;
-    return timers;
+inline thread_timers& local_timers() {
+    thread_local thread_timers_handle handle;
+    return *handle.timers;
 }
 
-inline std::string to_string_precision(double duration, int precision = 6) {
-    std::ostringstream out;
-    out << std::setprecision(precision) << duration;
-    return out.str();
+/*!
+ * \brief A scope of the merged tree of timers
+ */
+struct merged_node {
+    const char* name;             ///< The name of the timer
+    size_t parent;                ///< The index of the parent scope
+    size_t count;                 ///< The number of times the scope was entered
+    size_t duration;              ///< The total duration
+    std::vector<size_t> children; ///< The index of the children scopes
+    perf_values counters;         ///< The total of the hardware counters
+    etl_values etl;               ///< The total of the counters of ETL
+};
+
+/*!
+ * \brief Merge the trees of timers of all the threads, by call path. The
+ * first node is the root.
+ */
+inline std::vector<merged_node> merged_tree() {
+    std::vector<merged_node> tree;
+    tree.push_back({nullptr, 0, 0, 0, {}, {}, {}});
+
+    decltype(auto) registry = get_registry();
+
+    std::lock_guard<std::mutex> l(registry.lock);
+
+    std::vector<size_t> mapping;
+
+    for (auto& thread : registry.threads) {
+        const size_t n = thread->size.load(std::memory_order_acquire);
+
+        mapping.assign(n, 0);
+
+        // A scope is always created after its parent
+        for (size_t i = 1; i < n; ++i) {
+            auto& node         = thread->nodes[i];
+            const size_t parent = mapping[node.parent];
+
+            size_t m = 0;
+
+            for (auto c : tree[parent].children) {
+                if (tree[c].name == node.name) {
+                    m = c;
+                    break;
+                }
+            }
+
+            if (!m) {
+                m = tree.size();
+                tree.push_back({node.name, parent, 0, 0, {}, {}, {}});
+                tree[parent].children.push_back(m);
+            }
+
+            tree[m].count += node.count.load(std::memory_order_relaxed);
+            tree[m].duration += node.duration.load(std::memory_order_relaxed);
+
+            for (size_t e = 0; e < perf_events; ++e) {
+                tree[m].counters[e] += node.counters[e].load(std::memory_order_relaxed);
+            }
+
+            for (size_t e = 0; e < etl_counter_kinds; ++e) {
+                tree[m].etl[e] += node.etl[e].load(std::memory_order_relaxed);
+            }
+
+            mapping[i] = m;
+        }
+    }
+
+    return tree;
 }
 
-inline std::string duration_str(double duration, int precision = 6) {
-    if (duration > 1000.0 * 1000.0 * 1000.0) {
-        return to_string_precision(duration / (1000.0 * 1000.0 * 1000.0), precision) + "s";
-    } else if (duration > 1000.0 * 1000.0) {
-        return to_string_precision(duration / (1000.0 * 1000.0), precision) + "ms";
-    } else if (duration > 1000.0) {
-        return to_string_precision(duration / 1000.0, precision) + "us";
-    } else {
-        return to_string_precision(duration, precision) + "ns";
+} //end of namespace timers_detail
+
+/*!
+ * \brief Returns the timers of all the threads, merged by name.
+ *
+ * The time of a timer nested in a timer of the same name is not counted
+ * twice.
+ */
+inline std::vector<timer_t> merged_timers() {
+    auto tree = timers_detail::merged_tree();
+
+    std::vector<timer_t> timers;
+
+    for (size_t i = 1; i < tree.size(); ++i) {
+        auto& node = tree[i];
+
+        if (!node.count) {
+            continue;
+        }
+
+        bool nested = false;
+
+        for (size_t p = node.parent; p && !nested; p = tree[p].parent) {
+            nested = tree[p].name == node.name;
+        }
+
+        auto it = std::find_if(timers.begin(), timers.end(), [&node](auto& timer) { return timer.name == node.name; });
+
+        if (it == timers.end()) {
+            timers.push_back({node.name, 0, 0});
+            it = timers.end() - 1;
+        }
+
+        it->count += node.count;
+
+        if (!nested) {
+            it->duration += node.duration;
+
+            for (size_t e = 0; e < perf_events; ++e) {
+                it->counters[e] += node.counters[e];
+            }
+
+            for (size_t e = 0; e < etl_counter_kinds; ++e) {
+                it->etl[e] += node.etl[e];
+            }
+        }
     }
+
+    //Sort the timers by duration (DESC)
+    std::sort(timers.begin(), timers.end(), [](auto& left, auto& right) {
+        return left.duration > right.duration;
+    });
+
+    return timers;
 }
 
 /*!
  * \brief Reset all timers
  */
 inline void reset_timers() {
-    decltype(auto) timers = get_timers();
-    timers.reset();
+    decltype(auto) registry = timers_detail::get_registry();
+
+    std::lock_guard<std::mutex> l(registry.lock);
+
+    // The timers of the finished threads are released
+    registry.threads.erase(std::remove_if(registry.threads.begin(), registry.threads.end(), [](auto& thread) { return !thread->alive; }), registry.threads.end());
+
+    for (auto& thread : registry.threads) {
+        const size_t n = thread->size.load(std::memory_order_acquire);
+
+        for (size_t i = 0; i < n; ++i) {
+            thread->nodes[i].count    = 0;
+            thread->nodes[i].duration = 0;
+
+            for (auto& counter : thread->nodes[i].counters) {
+                counter = 0;
+            }
+
+            for (auto& counter : thread->nodes[i].etl) {
+                counter = 0;
+            }
+        }
+
+        std::lock_guard<std::mutex> tl(thread->trace_lock);
+        thread->events.clear();
+    }
+}
+
+/*!
+ * \brief Start recording the timeline of the timers.
+ *
+ * Each run of a timer is recorded with its start and end times, in the
+ * timeline of its thread, until disable_trace() is called.
+ */
+inline void enable_trace() {
+    timers_detail::get_registry().tracing = true;
+}
+
+/*!
+ * \brief Stop recording the timeline of the timers.
+ */
+inline void disable_trace() {
+    timers_detail::get_registry().tracing = false;
+}
+
+/*!
+ * \brief Write the timeline of the timers to the given file, in the Chrome
+ * Trace Event format (chrome://tracing or Perfetto).
+ *
+ * \param file The path to the file
+ * \return true if the file was written, false otherwise
+ */
+inline bool dump_trace(const std::string& file) {
+    std::ofstream os(file);
+
+    if (!os) {
+        std::cerr << "ERROR: Impossible to write trace to " << file << std::endl;
+        return false;
+    }
+
+    decltype(auto) registry = timers_detail::get_registry();
+
+    std::lock_guard<std::mutex> l(registry.lock);
+
+    os << "{\"traceEvents\":[";
+
+    bool first = true;
+
+    for (auto& thread : registry.threads) {
+        std::lock_guard<std::mutex> tl(thread->trace_lock);
+
+        os << (first ? "\n" : ",\n")
+           << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":" << thread->tid
+           << ",\"args\":{\"name\":\"thread " << thread->tid << "\"}}";
+
+        first = false;
+
+        for (auto& event : thread->events) {
+            os << ",\n{\"name\":\"" << event.name << "\",\"cat\":\"dll\",\"ph\":\"X\",\"pid\":0,\"tid\":" << thread->tid
+               << ",\"ts\":" << to_string_precision(event.begin / 1000.0, 15)
+               << ",\"dur\":" << to_string_precision((event.end - event.begin) / 1000.0, 15) << "}";
+        }
+    }
+
+    os << "\n],\"displayTimeUnit\":\"ms\"}\n";
+
+    return bool(os);
 }
 
 /*!
@@ -196,12 +610,7 @@ inline void reset_timers() {
  * This has no effect if the timers were disabled.
  */
 inline void dump_timers() {
-    decltype(auto) timers = get_timers().timers;
-
-    //Sort the timers by duration (DESC)
-    std::sort(timers.begin(), timers.end(), [](auto& left, auto& right) {
-        return left.duration > right.duration;
-    });
+    auto timers = merged_timers();
 
     // Print all the used timers
     for (decltype(auto) timer : timers) {
@@ -222,18 +631,13 @@ inline void dump_timers() {
  * The total is the counter with the maximum total time
  */
 inline void dump_timers_one() {
-    decltype(auto) timers = get_timers().timers;
+    auto timers = merged_timers();
 
     if(timers.empty()){
         return;
     }
 
-    //Sort the timers by duration (DESC)
-    std::sort(timers.begin(), timers.end(), [](auto& left, auto& right) {
-        return left.duration > right.duration;
-    });
-
-    double total_duration = timers.front().duration.load();
+    double total_duration = timers.front().duration;
 
     // Print all the used timers
     for (decltype(auto) timer : timers) {
@@ -249,9 +653,15 @@ inline void dump_timers_one() {
 
 /*!
  * \brief Dump all timers values to the console in the form of a nice table.
+ *
+ * When the hardware counters have been sampled, the table also shows the
+ * instructions per cycle and the miss rate of the last level cache of each
+ * timer, and its floating point operations per cycle if they were counted.
+ * When ETL_COUNTERS is defined, it also shows the allocations, temporaries,
+ * copies between CPU and GPU and evaluations of ETL during each timer.
  */
 inline void dump_timers_pretty() {
-    decltype(auto) timers = get_timers().timers;
+    auto timers = merged_timers();
 
     if(timers.empty()){
         std::cout << "No timers have been recorded!" << std::endl;
@@ -260,194 +670,270 @@ inline void dump_timers_pretty() {
 
     std::cout << std::endl;
 
-    //Sort the timers by duration (DESC)
-    std::sort(timers.begin(), timers.end(), [](auto& left, auto& right) {
-        return left.duration > right.duration;
-    });
+    double total_duration = timers.front().duration;
+
+    bool perf = false;
+    bool fp   = false;
+    bool etl  = false;
+
+    for (decltype(auto) timer : timers) {
+        perf |= timer.counters[PERF_CYCLES] > 0;
+        fp |= timer.counters[PERF_FP_OPS] > 0;
 
-    double total_duration = timers.front().duration.load();
+        for (auto value : timer.etl) {
+            etl |= value > 0;
+        }
+    }
 
-    constexpr size_t columns = 5;
+    std::vector<std::string> column_name{"%", "Timer", "Count", "Total", "Average"};
 
-    std::string column_name[columns];
-    column_name[0] = "%";
-    column_name[1] = "Timer";
-    column_name[2] = "Count";
-    column_name[3] = "Total";
-    column_name[4] = "Average";
+    if (perf) {
+        column_name.push_back("IPC");
+        column_name.push_back("LLC miss");
+    }
 
-    size_t column_length[columns];
-    column_length[0] = 8;
-    column_length[1] = column_name[1].size();
-    column_length[2] = column_name[2].size();
-    column_length[3] = column_name[3].size();
-    column_length[4] = column_name[4].size();
+    if (fp) {
+        column_name.push_back("FP/cycle");
+    }
+
+    if (etl) {
+        column_name.push_back("Allocs");
+        column_name.push_back("Temps");
+        column_name.push_back("Syncs");
+        column_name.push_back("Evals");
+    }
+
+    const size_t columns = column_name.size();
+
+    auto ratio = [](size_t num, size_t den, double scale, const char* unit) {
+        return den ? to_string_precision(scale * (num / double(den)), 4) + unit : std::string("-");
+    };
+
+    std::vector<std::vector<std::string>> rows;
 
-    // Compute the width of each column
     for (decltype(auto) timer : timers) {
         if (timer.name) {
             size_t count = timer.count;
             size_t duration = timer.duration;
 
-            column_length[1] = std::max(column_length[1], std::string(timer.name).size());
-            column_length[2] = std::max(column_length[2], std::to_string(count).size());
-            column_length[3] = std::max(column_length[3], duration_str(duration).size());
-            column_length[4] = std::max(column_length[4], duration_str(duration / count).size());
+            char percent[32];
+            snprintf(percent, sizeof(percent), "%.3f%%", 100.0 * (duration / double(total_duration)));
+
+            rows.push_back({percent, timer.name, std::to_string(count), duration_str(duration), duration_str(duration / count)});
+
+            auto& c = timer.counters;
+
+            if (perf) {
+                rows.back().push_back(ratio(c[PERF_INSTRUCTIONS], c[PERF_CYCLES], 1.0, ""));
+                rows.back().push_back(ratio(c[PERF_LLC_MISSES], c[PERF_LLC_REFERENCES], 100.0, "%"));
+            }
+
+            if (fp) {
+                rows.back().push_back(ratio(c[PERF_FP_OPS], c[PERF_CYCLES], 1.0, ""));
+            }
+
+            if (etl) {
+                for (auto value : timer.etl) {
+                    rows.back().push_back(std::to_string(value));
+                }
+            }
         }
     }
 
-    const size_t line_length = (columns + 1) * 1 + 2 + (columns - 1) * 2 + std::accumulate(column_length, column_length + columns, 0);
+    // Compute the width of each column
+    std::vector<size_t> column_length(columns);
+
+    for (size_t i = 0; i < columns; ++i) {
+        column_length[i] = column_name[i].size();
+    }
+
+    column_length[0] = 8;
+
+    for (auto& row : rows) {
+        for (size_t i = 0; i < columns; ++i) {
+            column_length[i] = std::max(column_length[i], row[i].size());
+        }
+    }
+
+    const size_t line_length = 3 * columns + 1 + std::accumulate(column_length.begin(), column_length.end(), size_t(0));
+
+    auto print_row = [&](const std::vector<std::string>& row, bool header) {
+        std::cout << " |";
+
+        for (size_t i = 0; i < columns; ++i) {
+            // The percentages are aligned to the right
+            if (i == 0 && !header) {
+                printf(" %*s |", int(column_length[i]), row[i].c_str());
+            } else {
+                printf(" %-*s |", int(column_length[i]), row[i].c_str());
+            }
+        }
+
+        printf("\n");
+    };
 
     std::cout << " " << std::string(line_length, '-') << '\n';
 
-    printf(" | %-*s | %-*s | %-*s | %-*s | %-*s |\n",
-        int(column_length[0]), column_name[0].c_str(),
-        int(column_length[1]), column_name[1].c_str(),
-        int(column_length[2]), column_name[2].c_str(),
-        int(column_length[3]), column_name[3].c_str(),
-        int(column_length[4]), column_name[4].c_str());
+    print_row(column_name, true);
 
     std::cout << " " << std::string(line_length, '-') << '\n';
 
     // Print all the used timers
-    for (decltype(auto) timer : timers) {
-        if (timer.name) {
-            size_t count = timer.count;
-            size_t duration = timer.duration;
-
-            printf(" | %*.3f%% | %-*s | %-*s | %-*s | %-*s |\n",
-                int(column_length[0] - 1), 100.0 * (duration / double(total_duration)),
-                int(column_length[1]), timer.name,
-                int(column_length[2]), std::to_string(count).c_str(),
-                int(column_length[3]), duration_str(duration).c_str(),
-                int(column_length[4]), duration_str(duration / count).c_str());
-        }
+    for (auto& row : rows) {
+        print_row(row, false);
     }
 
     std::cout << " " << std::string(line_length, '-') << '\n';
 }
 
+namespace timers_detail {
+
 /*!
- * \brief Automatic timer with RAII.
+ * \brief Dump the given scope and its children, sorted by duration
  */
-struct auto_timer {
-    const char* name;                               ///< The name of the timer
-    std::chrono::time_point<std::chrono::steady_clock> start; ///< The start time
-    std::chrono::time_point<std::chrono::steady_clock> end;   ///< The end time
-
-    /*!
-     * \brief Create an auto_timer witht the given name
-     * \param name The name of the timer
-     */
-    auto_timer(const char* name) : name(name) {
-        start = std::chrono::steady_clock::now();
-    }
+inline void dump_tree(const std::vector<merged_node>& tree, size_t i, size_t depth) {
+    auto children = tree[i].children;
 
-    /*!
-     * \brief Destructs the timer, effectively incrementing the timer.
-     */
-    ~auto_timer() {
-        end           = std::chrono::steady_clock::now();
-        auto duration = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+    std::sort(children.begin(), children.end(), [&tree](size_t left, size_t right) {
+        return tree[left].duration > tree[right].duration;
+    });
 
-        decltype(auto) timers = get_timers();
+    for (auto c : children) {
+        auto& node = tree[c];
 
-        // Try to increment without the lock
+        if (!node.count) {
+            continue;
+        }
 
-        for (decltype(auto) timer : timers.timers) {
-            if (timer.name == name) {
-                timer.duration += duration;
-                ++timer.count;
+        std::cout << std::string(2 * depth, ' ') << node.name << "(" << node.count << ") : "
+                  << duration_str(node.duration)
+                  << " (";
 
-                return;
-            }
+        if (i) {
+            std::cout << 100.0 * (node.duration / double(tree[i].duration)) << "%, ";
         }
 
-        {
-            std::lock_guard<std::mutex> lock(timers.lock);
+        std::cout << duration_str(node.duration / node.count) << ")";
 
-            // Retry again to increment with lock
+        if (etl_counters_enabled()) {
+            std::cout << " [" << node.etl[ETL_ALLOCATIONS] << " allocs, " << node.etl[ETL_TEMPORARIES] << " temps, "
+                      << node.etl[ETL_SYNCS] << " syncs, " << node.etl[ETL_EVALUATIONS] << " evals]";
+        }
 
-            for (decltype(auto) timer : timers.timers) {
-                if (timer.name == name) {
-                    timer.duration += duration;
-                    ++timer.count;
+        std::cout << std::endl;
 
-                    return;
-                }
-            }
-
-            // At this point the timer does not exist, create it
+        dump_tree(tree, c, depth + 1);
+    }
+}
 
-            for (decltype(auto) timer : timers.timers) {
-                if (!timer.name) {
-                    timer.name     = name;
-                    timer.duration = duration;
-                    timer.count    = 1;
+} //end of namespace timers_detail
 
-                    return;
-                }
-            }
-        }
+/*!
+ * \brief Dump the tree of the timers to the console.
+ *
+ * Each timer is shown under the timer in which it was started, with its
+ * percentage of the time of its parent, merged over all the threads.
+ */
+inline void dump_timers_tree() {
+    auto tree = timers_detail::merged_tree();
 
-        // If there are no more timers
-        std::cerr << "Unable to register timer " << name << std::endl;
+    if (tree.size() == 1) {
+        std::cout << "No timers have been recorded!" << std::endl;
+        return;
     }
-};
+
+    timers_detail::dump_tree(tree, 0, 0);
+}
 
 /*!
- * \brief Automatic timer with RAII, without synchronization.
+ * \brief Automatic timer with RAII.
+ *
+ * The timer is a scope in the tree of timers of the current thread: the
+ * timers started while it is running are its children. While the hardware
+ * counters are enabled, the timer also accumulates the counters of the
+ * thread during the scope, and the counters of ETL when ETL_COUNTERS is
+ * defined.
  */
-struct unsafe_auto_timer {
-    const char* name;                                         ///< The name of the timer
+struct auto_timer {
+    timers_detail::thread_timers& timers; ///< The timers of the current thread
+    size_t parent;                        ///< The parent scope
+    size_t node;                          ///< The scope of the timer
+
+    bool sampled = false;   ///< Indicates if the hardware counters are sampled
+    perf_values perf_start; ///< The hardware counters at the start
+    etl_values etl_start;   ///< The counters of ETL at the start
+
     std::chrono::time_point<std::chrono::steady_clock> start; ///< The start time
-    std::chrono::time_point<std::chrono::steady_clock> end;   ///< The end time
 
     /*!
-     * \brief Create an unsafe_auto_timer witht the given name
+     * \brief Create an auto_timer witht the given name
      * \param name The name of the timer
      */
-    unsafe_auto_timer(const char* name) : name(name) {
+    auto_timer(const char* name) : timers(timers_detail::local_timers()) {
+        parent = timers.current;
+        node   = timers.enter(name);
+
+        if (perf_counters_enabled()) {
+            sampled = read_perf_counters(perf_start);
+        }
+
+        if constexpr (etl_counters_enabled()) {
+            read_etl_counters(etl_start);
+        }
+
         start = std::chrono::steady_clock::now();
     }
 
+    auto_timer(const auto_timer& rhs) = delete;
+    auto_timer& operator=(const auto_timer& rhs) = delete;
+
     /*!
      * \brief Destructs the timer, effectively incrementing the timer.
      */
-    ~unsafe_auto_timer() {
-        end           = std::chrono::steady_clock::now();
+    ~auto_timer() {
+        auto end      = std::chrono::steady_clock::now();
         auto duration = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
 
-        decltype(auto) timers = get_timers();
-
-        // Increment the timer if it exists
-
-        for (decltype(auto) timer : timers.timers) {
-            if (timer.name == name) {
-                timer.duration += duration;
-                ++timer.count;
+        perf_values counters;
 
-                return;
+        if (sampled && read_perf_counters(counters)) {
+            for (size_t e = 0; e < perf_events; ++e) {
+                counters[e] -= perf_start[e];
             }
+        } else {
+            sampled = false;
         }
 
-        // At this point the timer does not exist, create it
+        etl_values etl;
 
-        for (decltype(auto) timer : timers.timers) {
-            if (!timer.name) {
-                timer.name     = name;
-                timer.duration = duration;
-                timer.count    = 1;
+        if constexpr (etl_counters_enabled()) {
+            read_etl_counters(etl);
 
-                return;
+            for (size_t e = 0; e < etl_counter_kinds; ++e) {
+                etl[e] -= etl_start[e];
             }
         }
 
-        // If there are no more timers
-        std::cerr << "Unable to register timer " << name << std::endl;
+        if (timers_detail::get_registry().tracing.load(std::memory_order_relaxed)) {
+            timers.trace(node,
+                         std::chrono::duration_cast<std::chrono::nanoseconds>(start.time_since_epoch()).count(),
+                         std::chrono::duration_cast<std::chrono::nanoseconds>(end.time_since_epoch()).count());
+        }
+
+        timers.leave(node, parent, duration, sampled ? &counters : nullptr, etl_counters_enabled() ? &etl : nullptr);
     }
 };
 
+/*!
+ * \brief Automatic timer with RAII.
+ *
+ * Since the timers are local to each thread, this is the same as
+ * auto_timer.
+ */
+struct unsafe_auto_timer : auto_timer {
+    using auto_timer::auto_timer;
+};
+
 #endif
 
 } //end of namespace dll
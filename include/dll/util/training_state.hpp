@@ -0,0 +1,193 @@
+//=======================================================================
+// Copyright (c) 2014-2017 Baptiste Wicht
+// Distributed under the terms of the MIT License.
+// (See accompanying file LICENSE or copy at
+//  http://opensource.org/licenses/MIT)
+//=======================================================================
+
+/*!
+ * \file
+ * \brief Binary storage of the training state (updater state, counters and
+ * position of the generators) used to resume a training
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "etl/etl.hpp"
+
+#include "dll/util/memory.hpp"
+
+namespace dll {
+
+/*!
+ * \brief The header of a training state
+ */
+struct training_state_header {
+    static constexpr uint32_t file_magic   = 0x444C4C53; ///< The magic number ("DLLS")
+    static constexpr uint32_t file_version = 1;          ///< The current version of the format
+
+    uint32_t magic   = file_magic;   ///< The magic number
+    uint32_t version = file_version; ///< The version of the format
+    uint32_t weight  = 0;            ///< The size of one value (in bytes)
+};
+
+/*!
+ * \brief Write a value of the training state
+ */
+template <typename T>
+void state_write(std::ostream& os, const T& value) {
+    static_assert(std::is_trivially_copyable<T>::value, "Only trivial values can be written directly");
+    os.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+/*!
+ * \brief Read a value of the training state
+ * \return true if the value was read, false otherwise
+ */
+template <typename T>
+bool state_read(std::istream& is, T& value) {
+    static_assert(std::is_trivially_copyable<T>::value, "Only trivial values can be read directly");
+    return bool(is.read(reinterpret_cast<char*>(&value), sizeof(T)));
+}
+
+/*!
+ * \brief Write the given bytes, preceded by their number of elements
+ */
+inline void state_write_raw(std::ostream& os, const void* data, uint64_t n, size_t element) {
+    state_write(os, n);
+    os.write(static_cast<const char*>(data), n * element);
+}
+
+/*!
+ * \brief Read the given number of elements, checking that the stored
+ * number of elements matches
+ * \return true if the values were read, false otherwise
+ */
+inline bool state_read_raw(std::istream& is, void* data, uint64_t n, size_t element) {
+    uint64_t stored = 0;
+
+    if (!state_read(is, stored) || stored != n) {
+        return false;
+    }
+
+    return bool(is.read(static_cast<char*>(data), n * element));
+}
+
+/*!
+ * \brief Write the buffers held by the given values: the ETL containers
+ * write their elements, the standard containers, tuples and smart pointers
+ * write what they hold and the types with a buffers() function write what
+ * it returns. Everything else is ignored.
+ */
+template <typename T>
+void store_buffers(std::ostream& os, const T& value) {
+    if constexpr (etl::is_etl_expr<T>) {
+        if constexpr (etl::is_dma<T>) {
+            value.ensure_cpu_up_to_date();
+
+            state_write_raw(os, value.memory_start(), etl::size(value), sizeof(etl::value_t<T>));
+        }
+    } else if constexpr (memory_detail::is_vector<T>::value) {
+        if constexpr (std::is_arithmetic<typename T::value_type>::value) {
+            state_write_raw(os, value.data(), value.size(), sizeof(typename T::value_type));
+        } else {
+            for (auto& v : value) {
+                store_buffers(os, v);
+            }
+        }
+    } else if constexpr (memory_detail::is_tuple<T>::value) {
+        std::apply([&os](auto&... v) { (store_buffers(os, v), ...); }, value);
+    } else if constexpr (memory_detail::is_pointer<T>::value) {
+        if (value) {
+            store_buffers(os, *value);
+        }
+    } else if constexpr (memory_detail::has_buffers<T>::value) {
+        store_buffers(os, value.buffers());
+    }
+}
+
+/*!
+ * \brief Read the buffers held by the given values, in the order of
+ * store_buffers. The buffers must already have their sizes.
+ *
+ * The buffers() functions only give const access, the buffers are however
+ * owned by non-const objects, they are written through a const_cast.
+ *
+ * \return true if all the buffers were read, false otherwise
+ */
+template <typename T>
+bool load_buffers(std::istream& is, const T& value) {
+    if constexpr (etl::is_etl_expr<T>) {
+        if constexpr (etl::is_dma<T>) {
+            auto& target = const_cast<T&>(value);
+
+            target.ensure_cpu_up_to_date();
+
+            const bool ok = state_read_raw(is, target.memory_start(), etl::size(target), sizeof(etl::value_t<T>));
+
+            target.invalidate_gpu();
+
+            return ok;
+        } else {
+            return true;
+        }
+    } else if constexpr (memory_detail::is_vector<T>::value) {
+        if constexpr (std::is_arithmetic<typename T::value_type>::value) {
+            return state_read_raw(is, const_cast<T&>(value).data(), value.size(), sizeof(typename T::value_type));
+        } else {
+            bool ok = true;
+
+            for (auto& v : value) {
+                ok = ok && load_buffers(is, v);
+            }
+
+            return ok;
+        }
+    } else if constexpr (memory_detail::is_tuple<T>::value) {
+        return std::apply([&is](auto&... v) { return (load_buffers(is, v) && ... && true); }, value);
+    } else if constexpr (memory_detail::is_pointer<T>::value) {
+        return !value || load_buffers(is, *value);
+    } else if constexpr (memory_detail::has_buffers<T>::value) {
+        return load_buffers(is, value.buffers());
+    } else {
+        cpp_unused(is);
+        cpp_unused(value);
+
+        return true;
+    }
+}
+
+/*!
+ * \brief Traits to test if a trainer can store and load its state
+ */
+template <typename Trainer, typename Enable = void>
+struct has_trainer_state : std::false_type {};
+
+/*!
+ * \copydoc has_trainer_state
+ */
+template <typename Trainer>
+struct has_trainer_state<Trainer, std::void_t<decltype(std::declval<Trainer&>().load_state(std::declval<std::istream&>()))>> : std::true_type {};
+
+/*!
+ * \brief Traits to test if a generator can store and load its position
+ */
+template <typename Generator, typename Enable = void>
+struct has_generator_state : std::false_type {};
+
+/*!
+ * \copydoc has_generator_state
+ */
+template <typename Generator>
+struct has_generator_state<Generator, std::void_t<decltype(std::declval<Generator&>().load_state(std::declval<std::istream&>()))>> : std::true_type {};
+
+} //end of dll namespace
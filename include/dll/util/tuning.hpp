@@ -0,0 +1,214 @@
+//=======================================================================
+// Copyright (c) 2014-2017 Baptiste Wicht
+// Distributed under the terms of the MIT License.
+// (See accompanying file LICENSE or copy at
+//  http://opensource.org/licenses/MIT)
+//=======================================================================
+
+/*!
+ * \file
+ * \brief Tuning of the batch size and of the number of cores for the
+ * throughput of the training and of the inference
+ */
+
+#pragma once
+
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "dll/util/affinity.hpp"
+#include "dll/util/memory.hpp"
+#include "dll/util/timers.hpp"
+
+namespace dll {
+
+/*!
+ * \brief The options of the tuning
+ */
+struct tuning_options {
+    std::vector<size_t> threads; ///< The numbers of cores to try (powers of two up to all the cores if empty)
+    size_t memory_limit = 0;     ///< The maximum memory of the training in bytes (0 for no limit)
+    size_t epochs       = 1;     ///< The number of measured epochs of each configuration
+    double tolerance    = 0.05;  ///< The loss of throughput accepted to use fewer cores
+};
+
+/*!
+ * \brief The measures of one configuration
+ */
+struct tuning_result {
+    size_t batch_size = 0;    ///< The batch size
+    size_t threads    = 0;    ///< The number of cores
+    size_t memory     = 0;    ///< The memory of the training (bytes)
+    bool fits         = true; ///< Indicates if the memory is within the limit
+    double train      = 0.0;  ///< The training throughput (samples per second)
+    double inference  = 0.0;  ///< The inference throughput (samples per second)
+};
+
+/*!
+ * \brief The measures of all the configurations and the recommended one
+ */
+struct tuning_report {
+    std::vector<tuning_result> results; ///< The measures of each configuration
+    tuning_result recommended;          ///< The recommended configuration
+
+    /*!
+     * \brief Print the report to the given stream
+     */
+    void dump(std::ostream& os) const {
+        os << "Tuning (batch size, cores: training / inference samples per second, memory)" << std::endl;
+
+        for (auto& result : results) {
+            os << "  " << result.batch_size << ", " << result.threads << ": ";
+
+            if (result.fits) {
+                os << to_string_precision(result.train, 4) << " / " << to_string_precision(result.inference, 4);
+            } else {
+                os << "over the memory limit";
+            }
+
+            os << ", " << memory_str(result.memory) << std::endl;
+        }
+
+        if (recommended.batch_size) {
+            os << "Recommended: batch_size<" << recommended.batch_size << ">, " << recommended.threads << " cores"
+               << " (" << to_string_precision(recommended.train, 4) << " samples/s)" << std::endl;
+        } else {
+            os << "No configuration fits in the memory limit" << std::endl;
+        }
+    }
+};
+
+namespace tuning_detail {
+
+/*!
+ * \brief Returns the numbers of cores to try
+ */
+inline std::vector<size_t> thread_counts(const tuning_options& options) {
+    if (!options.threads.empty()) {
+        return options.threads;
+    }
+
+    const size_t cores = std::max(1u, std::thread::hardware_concurrency());
+
+    std::vector<size_t> counts;
+
+    for (size_t t = 1; t < cores; t *= 2) {
+        counts.push_back(t);
+    }
+
+    counts.push_back(cores);
+
+    return counts;
+}
+
+/*!
+ * \brief Returns the number of seconds elapsed while running the functor
+ */
+template <typename Functor>
+double seconds(Functor&& functor) {
+    auto start = std::chrono::steady_clock::now();
+
+    functor();
+
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+/*!
+ * \brief Measure the configurations of the batch size B
+ */
+template <template <size_t> typename Network, size_t B, typename Factory>
+void tune_batch(tuning_report& report, Factory& factory, const tuning_options& options) {
+    auto generator = factory(std::integral_constant<size_t, B>());
+    auto net       = std::make_unique<Network<B>>();
+
+    // The first epoch allocates all the buffers and accounts the memory
+    net->fine_tune(*generator, 1);
+
+    const size_t memory = net->memory.total();
+    const size_t n      = generator->size();
+
+    for (auto threads : thread_counts(options)) {
+        tuning_result result;
+        result.batch_size = B;
+        result.threads    = threads;
+        result.memory     = memory;
+        result.fits       = !options.memory_limit || memory <= options.memory_limit;
+
+        if (result.fits) {
+            limit_process_cpus(threads);
+
+            const double train = seconds([&] { net->fine_tune(*generator, options.epochs); });
+            const double test  = seconds([&] { net->evaluate_error(*generator); });
+
+            result.train     = train > 0.0 ? n * options.epochs / train : 0.0;
+            result.inference = test > 0.0 ? n / test : 0.0;
+        }
+
+        report.results.push_back(result);
+    }
+
+    limit_process_cpus(0);
+}
+
+} //end of namespace tuning_detail
+
+/*!
+ * \brief Measure the training and inference throughput of a network for
+ * several batch sizes and numbers of cores, and recommend a configuration.
+ *
+ * The network is given as an alias template on the batch size, for
+ * instance template <size_t B> using net_t = dll::dbn_desc<..., dll::batch_size<B>>::dbn_t.
+ * The factory returns the generator of the given batch size, it is called
+ * with a std::integral_constant<size_t, B>.
+ *
+ * The number of threads of ETL is fixed when it starts, the number of
+ * cores is therefore swept by restricting all the threads of the process
+ * to the first cores. The recommended configuration is the batch size with
+ * the best training throughput, within the memory limit, with the fewest
+ * cores reaching its throughput within the tolerance.
+ *
+ * \param factory The factory of the generators
+ * \param options The options of the tuning
+ * \return The report of the tuning
+ */
+template <template <size_t> typename Network, size_t... B, typename Factory>
+tuning_report tune_throughput(Factory&& factory, const tuning_options& options = tuning_options()) {
+    static_assert(sizeof...(B) > 0, "At least one batch size must be tuned");
+
+    tuning_report report;
+
+    (tuning_detail::tune_batch<Network, B>(report, factory, options), ...);
+
+    // The batch size with the best training throughput
+
+    const tuning_result* best = nullptr;
+
+    for (auto& result : report.results) {
+        if (result.fits && (!best || result.train > best->train)) {
+            best = &result;
+        }
+    }
+
+    if (!best) {
+        return report;
+    }
+
+    // The fewest cores reaching this throughput
+
+    report.recommended = *best;
+
+    for (auto& result : report.results) {
+        if (result.fits && result.batch_size == best->batch_size && result.threads < report.recommended.threads
+                && result.train >= (1.0 - options.tolerance) * best->train) {
+            report.recommended = result;
+        }
+    }
+
+    return report;
+}
+
+} //end of dll namespace
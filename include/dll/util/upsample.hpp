@@ -0,0 +1,289 @@
+//=======================================================================
+// Copyright (c) 2014-2017 Baptiste Wicht
+// Distributed under the terms of the MIT License.
+// (See accompanying file LICENSE or copy at
+//  http://opensource.org/licenses/MIT)
+//=======================================================================
+
+/*!
+ * \file
+ * \brief Nearest and bilinear upsample kernels (3D) and their backward
+ * passes
+ *
+ * The kernels work one row at a time. A row is expanded (forward) or
+ * reduced (backward) once into a small buffer, which is then copied to, or
+ * accumulated from, all the rows of its block. The errors are therefore
+ * read only once and the large output is written only once.
+ *
+ * The bilinear interpolation only applies to the last two dimensions, the
+ * first one (usually the channels) is replicated. It uses half-pixel
+ * centers, with the coordinates clamped at the borders.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <vector>
+
+#include "etl/etl.hpp"
+
+#include "dll/upsample_type.hpp"
+
+namespace dll {
+
+/*!
+ * \brief The interpolation of one output coordinate
+ */
+template <typename T>
+struct upsample_coord {
+    size_t lo; ///< The lower input coordinate
+    size_t hi; ///< The higher input coordinate
+    T w;       ///< The weight of the higher input coordinate
+};
+
+/*!
+ * \brief Compute the bilinear interpolation of the I * C output
+ * coordinates of one dimension
+ */
+template <typename T>
+std::vector<upsample_coord<T>> upsample_coords(size_t I, size_t C) {
+    std::vector<upsample_coord<T>> coords(I * C);
+
+    for (size_t o = 0; o < I * C; ++o) {
+        const T src = std::max(T(0), (T(o) + T(0.5)) / T(C) - T(0.5));
+
+        const size_t lo = std::min(size_t(src), I - 1);
+        const size_t hi = std::min(lo + 1, I - 1);
+
+        coords[o] = {lo, hi, src - T(lo)};
+    }
+
+    return coords;
+}
+
+/*!
+ * \brief Nearest upsample of N volumes of I1xI2xI3 by C1xC2xC3
+ * \param in The input (N x I1 x I2 x I3)
+ * \param out The output (N x I1*C1 x I2*C2 x I3*C3)
+ */
+template <typename T>
+void upsample_3d_nearest_forward(const T* in, T* out, size_t N, size_t I1, size_t I2, size_t I3, size_t C1, size_t C2, size_t C3) {
+    const size_t O2 = I2 * C2;
+    const size_t O3 = I3 * C3;
+
+    for (size_t n = 0; n < N; ++n) {
+        for (size_t i = 0; i < I1; ++i) {
+            for (size_t j = 0; j < I2; ++j) {
+                const T* in_row = in + ((n * I1 + i) * I2 + j) * I3;
+
+                T* first_row = out + (((n * I1 + i) * C1) * O2 + j * C2) * O3;
+
+                for (size_t k = 0; k < I3; ++k) {
+                    std::fill_n(first_row + k * C3, C3, in_row[k]);
+                }
+
+                for (size_t a = 0; a < C1; ++a) {
+                    for (size_t b = 0; b < C2; ++b) {
+                        if (a || b) {
+                            std::copy_n(first_row, O3, out + (((n * I1 + i) * C1 + a) * O2 + j * C2 + b) * O3);
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+/*!
+ * \brief Backpropagate the errors of a nearest upsample (3D): each input
+ * gets the sum of the errors of its block
+ * \param errors The errors of the output (N x I1*C1 x I2*C2 x I3*C3)
+ * \param grad The errors of the input (N x I1 x I2 x I3)
+ */
+template <typename T>
+void upsample_3d_nearest_backward(const T* errors, T* grad, size_t N, size_t I1, size_t I2, size_t I3, size_t C1, size_t C2, size_t C3) {
+    const size_t O2 = I2 * C2;
+    const size_t O3 = I3 * C3;
+
+    std::vector<T> row(O3);
+
+    for (size_t n = 0; n < N; ++n) {
+        for (size_t i = 0; i < I1; ++i) {
+            for (size_t j = 0; j < I2; ++j) {
+                std::fill(row.begin(), row.end(), T(0));
+
+                for (size_t a = 0; a < C1; ++a) {
+                    for (size_t b = 0; b < C2; ++b) {
+                        const T* errors_row = errors + (((n * I1 + i) * C1 + a) * O2 + j * C2 + b) * O3;
+
+                        for (size_t x = 0; x < O3; ++x) {
+                            row[x] += errors_row[x];
+                        }
+                    }
+                }
+
+                T* grad_row = grad + ((n * I1 + i) * I2 + j) * I3;
+
+                for (size_t k = 0; k < I3; ++k) {
+                    T sum = 0;
+
+                    for (size_t c = 0; c < C3; ++c) {
+                        sum += row[k * C3 + c];
+                    }
+
+                    grad_row[k] = sum;
+                }
+            }
+        }
+    }
+}
+
+/*!
+ * \brief Bilinear upsample of N volumes of I1xI2xI3 by C1xC2xC3
+ * \param in The input (N x I1 x I2 x I3)
+ * \param out The output (N x I1*C1 x I2*C2 x I3*C3)
+ */
+template <typename T>
+void upsample_3d_bilinear_forward(const T* in, T* out, size_t N, size_t I1, size_t I2, size_t I3, size_t C1, size_t C2, size_t C3) {
+    const size_t O2 = I2 * C2;
+    const size_t O3 = I3 * C3;
+
+    const auto rows = upsample_coords<T>(I2, C2);
+    const auto cols = upsample_coords<T>(I3, C3);
+
+    std::vector<T> row(I3);
+
+    for (size_t n = 0; n < N; ++n) {
+        for (size_t i = 0; i < I1; ++i) {
+            const T* in_plane = in + (n * I1 + i) * I2 * I3;
+
+            for (size_t y = 0; y < O2; ++y) {
+                const T* lo_row = in_plane + rows[y].lo * I3;
+                const T* hi_row = in_plane + rows[y].hi * I3;
+                const T wy      = rows[y].w;
+
+                for (size_t k = 0; k < I3; ++k) {
+                    row[k] = lo_row[k] + wy * (hi_row[k] - lo_row[k]);
+                }
+
+                T* first_row = out + (((n * I1 + i) * C1) * O2 + y) * O3;
+
+                for (size_t x = 0; x < O3; ++x) {
+                    first_row[x] = row[cols[x].lo] + cols[x].w * (row[cols[x].hi] - row[cols[x].lo]);
+                }
+
+                for (size_t a = 1; a < C1; ++a) {
+                    std::copy_n(first_row, O3, out + (((n * I1 + i) * C1 + a) * O2 + y) * O3);
+                }
+            }
+        }
+    }
+}
+
+/*!
+ * \brief Backpropagate the errors of a bilinear upsample (3D)
+ * \param errors The errors of the output (N x I1*C1 x I2*C2 x I3*C3)
+ * \param grad The errors of the input (N x I1 x I2 x I3)
+ */
+template <typename T>
+void upsample_3d_bilinear_backward(const T* errors, T* grad, size_t N, size_t I1, size_t I2, size_t I3, size_t C1, size_t C2, size_t C3) {
+    const size_t O2 = I2 * C2;
+    const size_t O3 = I3 * C3;
+
+    const auto rows = upsample_coords<T>(I2, C2);
+    const auto cols = upsample_coords<T>(I3, C3);
+
+    std::vector<T> sum(O3);
+    std::vector<T> row(I3);
+
+    std::fill_n(grad, N * I1 * I2 * I3, T(0));
+
+    for (size_t n = 0; n < N; ++n) {
+        for (size_t i = 0; i < I1; ++i) {
+            T* grad_plane = grad + (n * I1 + i) * I2 * I3;
+
+            for (size_t y = 0; y < O2; ++y) {
+                // Sum the replicated planes
+                std::copy_n(errors + (((n * I1 + i) * C1) * O2 + y) * O3, O3, sum.begin());
+
+                for (size_t a = 1; a < C1; ++a) {
+                    const T* errors_row = errors + (((n * I1 + i) * C1 + a) * O2 + y) * O3;
+
+                    for (size_t x = 0; x < O3; ++x) {
+                        sum[x] += errors_row[x];
+                    }
+                }
+
+                // Transpose of the horizontal interpolation
+                std::fill(row.begin(), row.end(), T(0));
+
+                for (size_t x = 0; x < O3; ++x) {
+                    row[cols[x].lo] += (T(1) - cols[x].w) * sum[x];
+                    row[cols[x].hi] += cols[x].w * sum[x];
+                }
+
+                // Transpose of the vertical interpolation
+                T* lo_row  = grad_plane + rows[y].lo * I3;
+                T* hi_row  = grad_plane + rows[y].hi * I3;
+                const T wy = rows[y].w;
+
+                for (size_t k = 0; k < I3; ++k) {
+                    lo_row[k] += (T(1) - wy) * row[k];
+                }
+
+                for (size_t k = 0; k < I3; ++k) {
+                    hi_row[k] += wy * row[k];
+                }
+            }
+        }
+    }
+}
+
+/*!
+ * \brief Upsample (3D) the ETL input (... x I1 x I2 x I3) into the ETL
+ * output
+ *
+ * An input without direct memory access is evaluated into a temporary.
+ */
+template <upsample_type UT, typename Output, typename Input>
+void upsample_3d_forward(Output&& output, const Input& input, size_t I1, size_t I2, size_t I3, size_t C1, size_t C2, size_t C3) {
+    static_assert(etl::all_dma<std::decay_t<Output>>, "The upsample kernels need direct memory access to the output");
+
+    if constexpr (etl::all_dma<Input>) {
+        input.ensure_cpu_up_to_date();
+
+        const size_t N = etl::size(input) / (I1 * I2 * I3);
+
+        if constexpr (UT == upsample_type::BILINEAR) {
+            upsample_3d_bilinear_forward(input.memory_start(), output.memory_start(), N, I1, I2, I3, C1, C2, C3);
+        } else {
+            upsample_3d_nearest_forward(input.memory_start(), output.memory_start(), N, I1, I2, I3, C1, C2, C3);
+        }
+
+        output.invalidate_gpu();
+    } else {
+        upsample_3d_forward<UT>(output, etl::force_temporary(input), I1, I2, I3, C1, C2, C3);
+    }
+}
+
+/*!
+ * \brief Backpropagate the errors of an upsample (3D) of ETL containers
+ */
+template <upsample_type UT, typename Grad, typename Errors>
+void upsample_3d_backward(Grad&& grad, const Errors& errors, size_t I1, size_t I2, size_t I3, size_t C1, size_t C2, size_t C3) {
+    static_assert(etl::all_dma<std::decay_t<Grad>, Errors>, "The upsample kernels need direct memory access");
+
+    errors.ensure_cpu_up_to_date();
+
+    const size_t N = etl::size(grad) / (I1 * I2 * I3);
+
+    if constexpr (UT == upsample_type::BILINEAR) {
+        upsample_3d_bilinear_backward(errors.memory_start(), grad.memory_start(), N, I1, I2, I3, C1, C2, C3);
+    } else {
+        upsample_3d_nearest_backward(errors.memory_start(), grad.memory_start(), N, I1, I2, I3, C1, C2, C3);
+    }
+
+    grad.invalidate_gpu();
+}
+
+} //end of dll namespace
@@ -0,0 +1,249 @@
+//=======================================================================
+// Copyright (c) 2014-2017 Baptiste Wicht
+// Distributed under the terms of the MIT License.
+// (See accompanying file LICENSE or copy at
+//  http://opensource.org/licenses/MIT)
+//=======================================================================
+
+/*!
+ * \file
+ * \brief Winograd F(2x2, 3x3) convolution for the 3x3 convolutional layers
+ */
+
+#pragma once
+
+#include "cpp_utils/assert.hpp"
+
+#include "etl/etl.hpp"
+
+#include "dll/util/conv_epilogue.hpp"
+
+namespace dll {
+
+/*!
+ * \brief Winograd F(2x2, 3x3) correlation of batches of images with 3x3
+ * filters.
+ *
+ * The input is cut in 4x4 tiles (with a stride of 2) that are transformed
+ * once. The transformed tiles are multiplied with the transformed filters
+ * as 16 matrix products (one per element of the tiles) over the channels
+ * and each tile gives a 2x2 block of the output. This needs 16
+ * multiplications per output block instead of 36 with the direct
+ * convolution.
+ *
+ * The filters are transformed separately (transform_filters) so that the
+ * layers can cache them between the batches.
+ */
+template <typename T>
+struct winograd_conv {
+    static constexpr size_t tile  = 4;  ///< The size of an input tile
+    static constexpr size_t block = 2;  ///< The size of an output block
+    static constexpr size_t N     = 16; ///< The number of elements of a tile
+
+    /*!
+     * \brief Transform the given filters.
+     *
+     * For the backward pass, the filters are rotated by 180 degrees and
+     * the input and output channels exchanged, so that the gradients of
+     * the input are a correlation of the errors with the transformed
+     * filters.
+     *
+     * \param w The filters [K, C, 3, 3]
+     * \param u The transformed filters [16, K, C] or [16, C, K] for the backward pass
+     * \param backward Indicates if the filters are transformed for the backward pass
+     */
+    template <typename W, typename U>
+    static void transform_filters(const W& w, U& u, bool backward) {
+        const size_t K = etl::dim<0>(w);
+        const size_t C = etl::dim<1>(w);
+
+        cpp_assert(etl::dim<2>(w) == 3 && etl::dim<3>(w) == 3, "winograd_conv only works with 3x3 filters");
+
+        w.ensure_cpu_up_to_date();
+
+        const T* w_ptr = w.memory_start();
+        T* u_ptr       = u.memory_start();
+
+        const size_t O = backward ? C : K; // The number of output channels
+        const size_t I = backward ? K : C; // The number of input channels
+
+        for (size_t k = 0; k < K; ++k) {
+            for (size_t c = 0; c < C; ++c) {
+                const T* f = w_ptr + (k * C + c) * 9;
+
+                T g[3][3];
+
+                for (size_t a = 0; a < 3; ++a) {
+                    for (size_t b = 0; b < 3; ++b) {
+                        g[a][b] = backward ? f[(2 - a) * 3 + (2 - b)] : f[a * 3 + b];
+                    }
+                }
+
+                // t = G g
+
+                T t[4][3];
+
+                for (size_t b = 0; b < 3; ++b) {
+                    t[0][b] = g[0][b];
+                    t[1][b] = T(0.5) * (g[0][b] + g[1][b] + g[2][b]);
+                    t[2][b] = T(0.5) * (g[0][b] - g[1][b] + g[2][b]);
+                    t[3][b] = g[2][b];
+                }
+
+                // U = t G^T
+
+                const size_t o = backward ? c : k;
+                const size_t i = backward ? k : c;
+
+                for (size_t a = 0; a < 4; ++a) {
+                    T r[4];
+
+                    r[0] = t[a][0];
+                    r[1] = T(0.5) * (t[a][0] + t[a][1] + t[a][2]);
+                    r[2] = T(0.5) * (t[a][0] - t[a][1] + t[a][2]);
+                    r[3] = t[a][2];
+
+                    for (size_t b = 0; b < 4; ++b) {
+                        u_ptr[((a * 4 + b) * O + o) * I + i] = r[b];
+                    }
+                }
+            }
+        }
+
+        u.invalidate_gpu();
+    }
+
+    /*!
+     * \brief Compute the correlation of the input with the transformed
+     * filters.
+     *
+     * \param input The batch of input [B, I, H, W]
+     * \param u The transformed filters [16, O, I]
+     * \param output The batch of output [B, O, H + 2 * p1 - 2, W + 2 * p2 - 2]
+     * \param p1 The padding of the first dimension
+     * \param p2 The padding of the second dimension
+     * \param epilogue The operation applied to each output value before it is written
+     */
+    template <typename In, typename U, typename Out, typename E = conv_epilogue_op<function::IDENTITY, false, T>>
+    static void apply(const In& input, const U& u, Out&& output, size_t p1, size_t p2, E epilogue = E()) {
+        const size_t B  = etl::dim<0>(input);
+        const size_t I  = etl::dim<1>(input);
+        const size_t H  = etl::dim<2>(input);
+        const size_t W  = etl::dim<3>(input);
+        const size_t O  = etl::dim<1>(output);
+        const size_t OH = etl::dim<2>(output);
+        const size_t OW = etl::dim<3>(output);
+
+        cpp_assert(etl::dim<0>(output) == B, "Invalid batch size for winograd_conv");
+        cpp_assert(OH == H + 2 * p1 - 2 && OW == W + 2 * p2 - 2, "Invalid output size for winograd_conv");
+
+        const size_t TH = (OH + 1) / 2; // The number of tiles in the first dimension
+        const size_t TW = (OW + 1) / 2; // The number of tiles in the second dimension
+        const size_t P  = B * TH * TW;  // The number of tiles
+
+        etl::dyn_matrix<T, 3> v(N, I, P);
+        etl::dyn_matrix<T, 3> m(N, O, P);
+
+        input.ensure_cpu_up_to_date();
+
+        const T* in_ptr = input.memory_start();
+        T* v_ptr        = v.memory_start();
+
+        // 1. Transform the input tiles, V = B^T d B
+
+        for (size_t b = 0; b < B; ++b) {
+            for (size_t i = 0; i < I; ++i) {
+                const T* image = in_ptr + (b * I + i) * H * W;
+
+                for (size_t th = 0; th < TH; ++th) {
+                    for (size_t tw = 0; tw < TW; ++tw) {
+                        T d[4][4];
+
+                        for (size_t a = 0; a < 4; ++a) {
+                            const long y = long(th * 2 + a) - long(p1);
+
+                            for (size_t c = 0; c < 4; ++c) {
+                                const long x = long(tw * 2 + c) - long(p2);
+
+                                d[a][c] = (y >= 0 && y < long(H) && x >= 0 && x < long(W)) ? image[y * W + x] : T(0);
+                            }
+                        }
+
+                        T r[4][4];
+
+                        for (size_t c = 0; c < 4; ++c) {
+                            r[0][c] = d[0][c] - d[2][c];
+                            r[1][c] = d[1][c] + d[2][c];
+                            r[2][c] = d[2][c] - d[1][c];
+                            r[3][c] = d[1][c] - d[3][c];
+                        }
+
+                        const size_t p = (b * TH + th) * TW + tw;
+
+                        for (size_t a = 0; a < 4; ++a) {
+                            v_ptr[((a * 4 + 0) * I + i) * P + p] = r[a][0] - r[a][2];
+                            v_ptr[((a * 4 + 1) * I + i) * P + p] = r[a][1] + r[a][2];
+                            v_ptr[((a * 4 + 2) * I + i) * P + p] = r[a][2] - r[a][1];
+                            v_ptr[((a * 4 + 3) * I + i) * P + p] = r[a][1] - r[a][3];
+                        }
+                    }
+                }
+            }
+        }
+
+        v.invalidate_gpu();
+
+        // 2. Multiply the transformed tiles with the transformed filters
+
+        for (size_t x = 0; x < N; ++x) {
+            m(x) = u(x) * v(x);
+        }
+
+        m.ensure_cpu_up_to_date();
+
+        const T* m_ptr = m.memory_start();
+        T* out_ptr     = output.memory_start();
+
+        // 3. Transform the output blocks, Y = A^T M A
+
+        for (size_t b = 0; b < B; ++b) {
+            for (size_t o = 0; o < O; ++o) {
+                T* image = out_ptr + (b * O + o) * OH * OW;
+
+                for (size_t th = 0; th < TH; ++th) {
+                    for (size_t tw = 0; tw < TW; ++tw) {
+                        const size_t p = (b * TH + th) * TW + tw;
+
+                        T s[2][4];
+
+                        for (size_t c = 0; c < 4; ++c) {
+                            const T m0 = m_ptr[((0 * 4 + c) * O + o) * P + p];
+                            const T m1 = m_ptr[((1 * 4 + c) * O + o) * P + p];
+                            const T m2 = m_ptr[((2 * 4 + c) * O + o) * P + p];
+                            const T m3 = m_ptr[((3 * 4 + c) * O + o) * P + p];
+
+                            s[0][c] = m0 + m1 + m2;
+                            s[1][c] = m1 - m2 - m3;
+                        }
+
+                        for (size_t a = 0; a < 2; ++a) {
+                            const size_t y = th * 2 + a;
+
+                            if (y < OH) {
+                                image[y * OW + tw * 2] = epilogue(o, s[a][0] + s[a][1] + s[a][2]);
+
+                                if (tw * 2 + 1 < OW) {
+                                    image[y * OW + tw * 2 + 1] = epilogue(o, s[a][1] - s[a][2] - s[a][3]);
+                                }
+                            }
+                        }
+                    }
+                }
+            }
+        }
+
+        output.invalidate_gpu();
+    }
+};
+
+} //end of dll namespace
@@ -9,7 +9,8 @@
 
 #include "dll/neural_layer.hpp"
 
-#include "dll/util/timers.hpp" // for auto_timer
+#include "dll/util/timers.hpp"          // for auto_timer
+#include "dll/trainer/chained_input.hpp" // for owned_input_t
 
 namespace dll {
 
@@ -284,8 +285,8 @@ template <typename DBN, typename... Layers, size_t L>
 struct sgd_context<DBN, dyn_group_layer_impl<dyn_group_layer_desc<Layers...>>, L> {
     using layer_t = dyn_group_layer_impl<dyn_group_layer_desc<Layers...>>;
 
-    using input_type  = decltype(std::declval<sgd_context<DBN, cpp::first_type_t<Layers...>, L>>().input);
-    using output_type = decltype(std::declval<sgd_context<DBN, cpp::last_type_t<Layers...>, L>>().output);
+    using input_type  = owned_input_t<sgd_context<DBN, cpp::first_type_t<Layers...>, L>>;
+    using output_type = std::decay_t<decltype(std::declval<sgd_context<DBN, cpp::last_type_t<Layers...>, L>>().output)>;
 
     input_type input;
     output_type output;
@@ -9,7 +9,8 @@
 
 #include "dll/neural_layer.hpp"
 
-#include "dll/util/timers.hpp" // for auto_timer
+#include "dll/util/timers.hpp"          // for auto_timer
+#include "dll/trainer/chained_input.hpp" // for owned_input_t
 
 namespace dll {
 
@@ -276,8 +277,8 @@ template <typename DBN, size_t D, typename... Layers, size_t L>
 struct sgd_context<DBN, merge_layer_impl<merge_layer_desc<D, Layers...>>, L> {
     using layer_t = merge_layer_impl<merge_layer_desc<D, Layers...>>;
 
-    using input_type  = decltype(std::declval<sgd_context<DBN, cpp::first_type_t<Layers...>, L>>().input);
-    using output_type = typename merge_output_types<D + 1, decltype(std::declval<sgd_context<DBN, Layers, L>>().output)...>::type;
+    using input_type  = owned_input_t<sgd_context<DBN, cpp::first_type_t<Layers...>, L>>;
+    using output_type = typename merge_output_types<D + 1, std::decay_t<decltype(std::declval<sgd_context<DBN, Layers, L>>().output)>...>::type;
 
     input_type input;
     output_type output;
@@ -15,6 +15,9 @@
 #include "cpp_utils/stop_watch.hpp"
 
 #include "trainer/rbm_training_context.hpp"
+#include "generators/generator_stats.hpp"
+#include "util/memory.hpp"
+#include "util/etl_counters.hpp"
 #include "layer_traits.hpp"
 #include "dbn_traits.hpp"
 
@@ -99,6 +102,11 @@ struct default_rbm_watcher {
 
         std::cout << formatted << std::endl;
 
+        // The buffers of the trainer do not change during the training
+        if (epoch == 0 && context.trainer_memory) {
+            std::cout << "  trainer memory: " << memory_str(context.trainer_memory) << std::endl;
+        }
+
         cpp_unused(rbm);
     }
 
@@ -143,6 +151,7 @@ struct default_dbn_watcher {
     dll::stop_timer ft_epoch_timer;              ///< Timer for an epoch
     dll::stop_timer ft_batch_timer;              ///< Timer for a batch
     cpp::stop_watch<std::chrono::seconds> watch; ///< Timer for the entire training
+    etl_values ft_epoch_etl;                     ///< The counters of ETL at the start of the epoch
 
     /*!
      * \brief Indicates that the pretraining has begun for the given
@@ -243,6 +252,19 @@ struct default_dbn_watcher {
             std::cout << " weight_cost(L2)=" << dbn.l2_weight_cost << std::endl;
         }
 
+        if (w_decay(dbn_traits<DBN>::decay()) == decay_type::DECOUPLED) {
+            std::cout << "weight_cost(dec)=" << dbn.l2_weight_cost << std::endl;
+        }
+
+        if (!dbn.memory.empty()) {
+            std::cout << "          memory=" << memory_str(dbn.memory.total()) << std::endl;
+
+            if constexpr (dbn_traits<DBN>::is_verbose()) {
+                std::cout << "   ";
+                dbn.memory.dump(std::cout);
+            }
+        }
+
         std::cout << std::endl;
 
         ft_max_epochs = max_epochs;
@@ -262,6 +284,8 @@ struct default_dbn_watcher {
         cpp_unused(dbn);
         ft_epoch_timer.start();
 
+        read_etl_counters(ft_epoch_etl);
+
         last_line_length = 0;
     }
 
@@ -294,6 +318,9 @@ struct default_dbn_watcher {
         }
 
         std::cout.flush();
+
+        print_generator_stats();
+        print_etl_stats();
     }
 
     /*!
@@ -325,6 +352,47 @@ struct default_dbn_watcher {
         }
 
         std::cout.flush();
+
+        print_generator_stats();
+        print_etl_stats();
+    }
+
+    /*!
+     * \brief Print the counters of the generators for the epoch and
+     * reset them.
+     *
+     * The counters are only printed in verbose mode or when the training
+     * had to wait for the generators.
+     */
+    void print_generator_stats() {
+        auto& stats = global_generator_stats();
+
+        if (stats.fills.load() && (dbn_traits<DBN>::is_verbose() || stats.waits.load())) {
+            std::cout << "  ";
+            stats.dump(std::cout);
+        }
+
+        stats.reset();
+    }
+
+    /*!
+     * \brief Print the counters of ETL for the epoch.
+     *
+     * The counters are only printed in verbose mode and when ETL_COUNTERS
+     * is defined.
+     */
+    void print_etl_stats() {
+        if constexpr (etl_counters_enabled() && dbn_traits<DBN>::is_verbose()) {
+            etl_values values;
+            read_etl_counters(values);
+
+            for (size_t e = 0; e < etl_counter_kinds; ++e) {
+                values[e] -= ft_epoch_etl[e];
+            }
+
+            std::cout << "  ";
+            dump_etl_values(std::cout, values);
+        }
     }
 
     /*!
@@ -73,7 +73,12 @@ struct layer {
 
     virtual bool parse(const layers_t& layers, const std::vector<std::string>& lines, size_t& i) = 0;
 
-    virtual void set(std::ostream& /*out*/, const std::string& /*lhs*/) const {/* Nothing */};
+    /*!
+     * \brief Write the runtime parameters of the layer to the given stream
+     * \param out The stream of the parameters file
+     * \param prefix The prefix of the parameters of the layer
+     */
+    virtual void write_params(std::ostream& /*out*/, const std::string& /*prefix*/) const {/* Nothing */};
 };
 
 enum class parse_result {
@@ -116,7 +121,7 @@ struct base_rbm_layer : layer {
     bool shuffle       = false; ///< Indicates if the RBM is trained with shuffle
 
     void print(std::ostream& out) const override;
-    void set(std::ostream& out, const std::string& lhs) const override;
+    void write_params(std::ostream& out, const std::string& prefix) const override;
 
     parse_result base_parse(const std::vector<std::string>& lines, size_t& i);
 };
@@ -73,34 +73,33 @@ dllp::parse_result dllp::base_rbm_layer::base_parse(const std::vector<std::strin
     return parse_result::NOT_PARSED;
 }
 
-void dllp::base_rbm_layer::set(std::ostream& out, const std::string& lhs) const {
+void dllp::base_rbm_layer::write_params(std::ostream& out, const std::string& prefix) const {
     if (learning_rate != dll::processor::stupid_default) {
-        out << lhs << ".learning_rate = " << learning_rate << ";\n";
+        dll::processor::write_param(out, prefix + ".learning_rate", learning_rate);
     }
 
     if (momentum != dll::processor::stupid_default) {
-        out << lhs << ".initial_momentum = " << momentum << ";\n";
-        out << lhs << ".final_momentum = " << momentum << ";\n";
+        dll::processor::write_param(out, prefix + ".momentum", momentum);
     }
 
     if (l1_weight_cost != dll::processor::stupid_default) {
-        out << lhs << ".l1_weight_cost = " << l1_weight_cost << ";\n";
+        dll::processor::write_param(out, prefix + ".l1_weight_cost", l1_weight_cost);
     }
 
     if (l2_weight_cost != dll::processor::stupid_default) {
-        out << lhs << ".l2_weight_cost = " << l2_weight_cost << ";\n";
+        dll::processor::write_param(out, prefix + ".l2_weight_cost", l2_weight_cost);
     }
 
     if (sparsity_target != dll::processor::stupid_default) {
-        out << lhs << ".sparsity_target = " << sparsity_target << ";\n";
+        dll::processor::write_param(out, prefix + ".sparsity_target", sparsity_target);
     }
 
     if (pbias != dll::processor::stupid_default) {
-        out << lhs << ".pbias = " << pbias << ";\n";
+        dll::processor::write_param(out, prefix + ".pbias", pbias);
     }
 
     if (pbias_lambda != dll::processor::stupid_default) {
-        out << lhs << ".pbias_lambda = " << pbias_lambda << ";\n";
+        dll::processor::write_param(out, prefix + ".pbias_lambda", pbias_lambda);
     }
 }
 
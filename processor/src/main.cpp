@@ -22,7 +22,7 @@
 namespace {
 
 void print_usage() {
-    std::cout << "Usage: dllp conf_file action" << std::endl;
+    std::cout << "Usage: dllp [--mkl] [--cufft] [--cublas] [--cache] [--profile default|native|lto|pgo] conf_file action" << std::endl;
 }
 
 void parse_options(int argc, char* argv[], dll::processor::options& opt, std::vector<std::string>& actions, std::string& source_file) {
@@ -41,6 +41,9 @@ void parse_options(int argc, char* argv[], dll::processor::options& opt, std::ve
         } else if (std::string(argv[i]) == "--cache") {
             opt.cache = true;
             ++i;
+        } else if (std::string(argv[i]) == "--profile" && i + 1 < size_t(argc)) {
+            opt.profile = argv[i + 1];
+            i += 2;
         } else {
             break;
         }
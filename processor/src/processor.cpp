@@ -11,6 +11,10 @@
 #include <fstream>
 #include <memory>
 #include <cstdlib>
+#include <cstdio>
+#include <cstdint>
+#include <algorithm>
+#include <sstream>
 
 #include <sys/stat.h>
 #include <sys/types.h>
@@ -26,6 +30,9 @@ namespace dllp {
 
 using options = dll::processor::options;
 
+constexpr const char* params_file     = ".dbn.params"; ///< The runtime parameters of the generated program
+constexpr const char* cache_directory = ".dllp_cache"; ///< The directory of the compiled programs
+
 std::string command_result(const std::string& command) {
     std::stringstream output;
 
@@ -115,9 +122,6 @@ void parse_datasource_pack(dll::processor::datasource_pack& pack, const std::vec
     pack.labels.limit  = limit;
 }
 
-void generate(const std::vector<std::unique_ptr<dllp::layer>>& layers, const dll::processor::task& t, const std::vector<std::string>& actions);
-bool compile(const options& opt);
-
 void process_includes(std::vector<std::string>& lines){
     for (size_t i = 0; i < lines.size();) {
         auto& current_line = lines[i];
@@ -157,6 +161,25 @@ void process_data(size_t& i, const std::vector<std::string>& lines, dll::process
     }
 }
 
+void process_sweep(size_t& i, const std::vector<std::string>& lines, dll::processor::task& t){
+    ++i;
+
+    while (i < lines.size()) {
+        auto separator = lines[i].find(": ");
+
+        if (dllp::starts_with(lines[i], "parallel: ")) {
+            t.sweep.parallel = std::stol(dllp::extract_value(lines[i], "parallel: "));
+            ++i;
+        } else if (separator != std::string::npos && lines[i].find('.') < separator) {
+            // A swept parameter, with its values separated with spaces
+            t.sweep.grid.emplace_back(lines[i].substr(0, separator), lines[i].substr(separator + 2));
+            ++i;
+        } else {
+            break;
+        }
+    }
+}
+
 bool process_options(size_t& i, const std::vector<std::string>& lines, dll::processor::task& t) {
     ++i;
 
@@ -185,6 +208,9 @@ bool process_options(size_t& i, const std::vector<std::string>& lines, dll::proc
                 } else if (dllp::starts_with(lines[i], "big_batch: ")) {
                     t.general_desc.big_batch = std::stol(dllp::extract_value(lines[i], "big_batch: "));
                     ++i;
+                } else if (dllp::starts_with(lines[i], "profile: ")) {
+                    t.general_desc.profile = dllp::extract_value(lines[i], "profile: ");
+                    ++i;
                 } else {
                     break;
                 }
@@ -376,6 +402,8 @@ bool parse_file(const std::string& source_file, dll::processor::task& t, std::ve
             if(!process_options(i, lines, t)){
                 return false;
             }
+        } else if (current_line == "sweep:") {
+            process_sweep(i, lines, t);
         } else {
             std::cout << "dllp: error: invalid line: " << i << ":" << current_line << std::endl;
 
@@ -391,128 +419,6 @@ bool parse_file(const std::string& source_file, dll::processor::task& t, std::ve
     return true;
 }
 
-bool compile_exe(const dllp::options& opt, const std::vector<std::string>& actions, const std::string& source_file, const dll::processor::task& t, const std::vector<std::unique_ptr<dllp::layer>>& layers) {
-    bool process = true;
-
-    if (opt.cache) {
-        struct stat attr_conf;
-        struct stat attr_exec;
-
-        if (!stat(source_file.c_str(), &attr_conf)) {
-            if (!stat("./.dbn.out", &attr_exec)) {
-                auto mtime_conf = attr_conf.st_mtime;
-                auto mtime_exec = attr_exec.st_mtime;
-
-                if (mtime_exec > mtime_conf) {
-                    if (!opt.quiet) {
-                        std::cout << "Skip compilation" << std::endl;
-                    }
-                    process = false;
-                }
-            }
-        }
-    }
-
-    if (process) {
-        //Generate the CPP file
-        dllp::generate(layers, t, actions);
-
-        //Compile the generate file
-        if (!dllp::compile(opt)) {
-            return false;
-        }
-    }
-
-    return true;
-}
-
-std::string datasource_to_string(const std::string& lhs, const dll::processor::datasource& ds) {
-    std::string result;
-
-    result += lhs + ".source_file = \"" + ds.source_file + "\";\n";
-    result += lhs + ".reader = \"" + ds.reader + "\";\n";
-    result += lhs + ".binarize = " + (ds.binarize ? "true" : "false") + ";\n";
-    result += lhs + ".normalize = " + (ds.normalize ? "true" : "false") + ";\n";
-    result += lhs + ".scale = " + (ds.scale ? "true" : "false") + ";\n";
-    result += lhs + ".scale_d = " + std::to_string(ds.scale_d) + ";\n";
-    result += lhs + ".normal_noise = " + (ds.normal_noise ? "true" : "false") + ";\n";
-    result += lhs + ".normal_noise_d = " + std::to_string(ds.normal_noise_d) + ";\n";
-    result += lhs + ".limit = " + std::to_string(ds.limit) + ";\n";
-
-    return result;
-}
-
-std::string pt_desc_to_string(const std::string& lhs, const dll::processor::pretraining_desc& desc) {
-    std::string result;
-
-    result += lhs + ".epochs = " + std::to_string(desc.epochs) + ";";
-
-    return result;
-}
-
-std::string ft_desc_to_string(const std::string& lhs, const dll::processor::training_desc& desc) {
-    std::string result;
-
-    result += lhs + ".epochs = " + std::to_string(desc.epochs) + ";";
-
-    return result;
-}
-
-std::string w_desc_to_string(const std::string& lhs, const dll::processor::weights_desc& desc) {
-    std::string result;
-
-    result += lhs + ".file = \"" + desc.file + "\";";
-
-    return result;
-}
-
-std::string task_to_string(const std::string& name, const dll::processor::task& t) {
-    std::string result;
-
-    result += "   dll::processor::task ";
-    result += name;
-    result += ";\n\n";
-    result += datasource_to_string("   " + name + ".pretraining.samples", t.pretraining.samples);
-    result += "\n";
-    result += datasource_to_string("   " + name + ".pretraining_clean.samples", t.pretraining_clean.samples);
-    result += "\n";
-    result += datasource_to_string("   " + name + ".training.samples", t.training.samples);
-    result += "\n";
-    result += datasource_to_string("   " + name + ".training.labels", t.training.labels);
-    result += "\n";
-    result += datasource_to_string("   " + name + ".testing.samples", t.testing.samples);
-    result += "\n";
-    result += datasource_to_string("   " + name + ".testing.labels", t.testing.labels);
-    result += "\n";
-    result += pt_desc_to_string("   " + name + ".pt_desc", t.pt_desc);
-    result += "\n";
-    result += ft_desc_to_string("   " + name + ".ft_desc", t.ft_desc);
-    result += "\n";
-    result += w_desc_to_string("   " + name + ".w_desc", t.w_desc);
-    result += "\n";
-
-    return result;
-}
-
-std::string vector_to_string(const std::string& name, const std::vector<std::string>& vec) {
-    std::string result;
-
-    result += "   std::vector<std::string> ";
-    result += name;
-    result += "{";
-    std::string comma = "";
-    for (auto& value : vec) {
-        result += comma;
-        result += "\"";
-        result += value;
-        result += "\"";
-        comma = ", ";
-    }
-    result += "};";
-
-    return result;
-}
-
 std::string get_data_type(const std::vector<std::unique_ptr<dllp::layer>>& layers, const dll::processor::task& t){
     std::string reader;
     if(!t.training.samples.reader.empty()){
@@ -534,7 +440,7 @@ std::string get_data_type(const std::vector<std::unique_ptr<dllp::layer>>& layer
         } else {
             return "etl::fast_dyn_vector<float, 784>";
         }
-    } else if(reader == "text"){
+    } else if(reader == "text" || reader == "packed"){
         if(layers.front()->is_conv()){
             return "etl::dyn_matrix<float, 3>";
         } else {
@@ -546,8 +452,8 @@ std::string get_data_type(const std::vector<std::unique_ptr<dllp::layer>>& layer
     }
 }
 
-void generate(const std::vector<std::unique_ptr<dllp::layer>>& layers, const dll::processor::task& t, const std::vector<std::string>& actions) {
-    std::ofstream out_stream(".dbn.cpp");
+std::string generate(const std::vector<std::unique_ptr<dllp::layer>>& layers, const dll::processor::task& t) {
+    std::stringstream out_stream;
 
     out_stream << "#include <memory>\n";
 
@@ -604,44 +510,55 @@ void generate(const std::vector<std::unique_ptr<dllp::layer>>& layers, const dll
 
     out_stream << ">::dbn_t;\n\n";
 
+    // The code only depends on the type of the network, the runtime
+    // parameters are read from the parameters file given as argument
+
     out_stream << "int main(int argc, char* argv[]){\n";
-    out_stream << "   auto dbn = std::make_unique<dbn_t>();\n";
+    out_stream << "   dll::processor::params p;\n";
+    out_stream << "   if (argc < 2 || !p.load(argv[1])) {\n";
+    out_stream << "      std::cout << \"Impossible to read the parameters file\" << std::endl;\n";
+    out_stream << "      return 1;\n";
+    out_stream << "   }\n\n";
+    out_stream << "   using data_type = " << get_data_type(layers, t) << ";\n";
+    out_stream << "   static constexpr bool three = " << layers.front()->is_conv() << ";\n";
+    out_stream << "   return dll::processor::run<dbn_t, data_type, three>(p);\n";
+    out_stream << "}\n";
+
+    return out_stream.str();
+}
+
+void write_params(const std::string& file, const std::vector<std::unique_ptr<dllp::layer>>& layers, const dll::processor::task& t, const std::vector<std::string>& actions) {
+    std::ofstream out(file);
 
     if (t.ft_desc.learning_rate != dll::processor::stupid_default) {
-        out_stream << "   dbn->learning_rate = " << t.ft_desc.learning_rate << ";\n";
+        dll::processor::write_param(out, "dbn.learning_rate", t.ft_desc.learning_rate);
     }
 
     if (t.ft_desc.momentum != dll::processor::stupid_default) {
-        out_stream << "   dbn->initial_momentum = " << t.ft_desc.momentum << ";\n";
-        out_stream << "   dbn->final_momentum = " << t.ft_desc.momentum << ";\n";
+        dll::processor::write_param(out, "dbn.momentum", t.ft_desc.momentum);
     }
 
     if (t.ft_desc.l1_weight_cost != dll::processor::stupid_default) {
-        out_stream << "   dbn->l1_weight_cost = " << t.ft_desc.l1_weight_cost << ";\n";
+        dll::processor::write_param(out, "dbn.l1_weight_cost", t.ft_desc.l1_weight_cost);
     }
 
     if (t.ft_desc.l2_weight_cost != dll::processor::stupid_default) {
-        out_stream << "   dbn->l2_weight_cost = " << t.ft_desc.l2_weight_cost << ";\n";
+        dll::processor::write_param(out, "dbn.l2_weight_cost", t.ft_desc.l2_weight_cost);
     }
 
     for (size_t i = 0; i < layers.size(); ++i) {
-        auto& layer = layers[i];
-
-        layer->set(out_stream, "   dbn->layer_get<" + std::to_string(i) + ">()");
+        layers[i]->write_params(out, "layer." + std::to_string(i));
     }
 
+    dll::processor::write_task(out, t);
+
     auto final_actions = actions;
 
     if(std::find(actions.begin(), actions.end(), "auto") != actions.end()){
         final_actions = t.default_actions;
     }
 
-    out_stream << task_to_string("t", t) << "\n";
-    out_stream << vector_to_string("actions", final_actions) << "\n";
-    out_stream << "   using data_type = " << get_data_type(layers, t) << ";\n";
-    out_stream << "   static constexpr bool three = " << layers.front()->is_conv() << ";\n";
-    out_stream << "   dll::processor::execute<data_type, three>(*dbn, t, actions);\n";
-    out_stream << "}\n";
+    dll::processor::write_param(out, "actions", final_actions);
 }
 
 bool append_pkg_flags(std::string& flags, const std::string& pkg) {
@@ -667,46 +584,67 @@ bool append_pkg_flags(std::string& flags, const std::string& pkg) {
     return true;
 }
 
-bool compile(const options& opt) {
-    if (!opt.quiet) {
-        std::cout << "Compiling the program..." << std::endl;
+bool compile_flags(const options& opt, const std::string& profile, std::string& flags) {
+    if (profile == "default") {
+        flags += " -g -O2 ";
+    } else if (profile == "native" || profile == "pgo") {
+        flags += " -O3 -march=native ";
+    } else if (profile == "lto") {
+        flags += " -O3 -march=native -flto ";
+    } else {
+        std::cout << "dllp: error: invalid build profile must be one of [default, native, lto, pgo]" << std::endl;
+        return false;
     }
 
-    const auto* cxx = std::getenv("CXX");
-
-    std::string compile_command(cxx);
-
-    compile_command += " -o .dbn.out ";
-    compile_command += " -g ";
-    compile_command += " -O2 -DETL_VECTORIZE_FULL ";
-    compile_command += " -std=c++1z ";
-    compile_command += " -pthread ";
-    compile_command += " .dbn.cpp ";
+    flags += " -DETL_VECTORIZE_FULL ";
+    flags += " -std=c++1z ";
+    flags += " -pthread ";
 
     if (opt.mkl) {
-        compile_command += " -DETL_MKL_MODE ";
+        flags += " -DETL_MKL_MODE ";
 
-        if (!append_pkg_flags(compile_command, "mkl")) {
+        if (!append_pkg_flags(flags, "mkl")) {
             return false;
         }
     }
 
     if (opt.cublas) {
-        compile_command += " -DETL_CUBLAS_MODE ";
+        flags += " -DETL_CUBLAS_MODE ";
 
-        if (!append_pkg_flags(compile_command, "cublas")) {
+        if (!append_pkg_flags(flags, "cublas")) {
             return false;
         }
     }
 
     if (opt.cufft) {
-        compile_command += " -DETL_CUFFT_MODE ";
+        flags += " -DETL_CUFFT_MODE ";
 
-        if (!append_pkg_flags(compile_command, "cufft")) {
+        if (!append_pkg_flags(flags, "cufft")) {
             return false;
         }
     }
 
+    return true;
+}
+
+bool compile(const options& opt, const std::string& flags, const std::string& source, const std::string& exe) {
+    if (!opt.quiet) {
+        std::cout << "Compiling the program..." << std::endl;
+    }
+
+    {
+        std::ofstream out_stream(".dbn.cpp");
+        out_stream << source;
+    }
+
+    const auto* cxx = std::getenv("CXX");
+
+    std::string compile_command(cxx);
+
+    compile_command += " -o " + exe + " ";
+    compile_command += " .dbn.cpp ";
+    compile_command += flags;
+
     int compile_result = system(compile_command.c_str());
 
     if (compile_result) {
@@ -721,6 +659,171 @@ bool compile(const options& opt) {
     return true;
 }
 
+void remove_directory(const std::string& directory) {
+    auto result = system(("rm -rf " + directory).c_str());
+    cpp_unused(result);
+}
+
+/*!
+ * \brief Compile the program with profile-guided optimizations.
+ *
+ * The program is first compiled with instrumentation and run on the
+ * training actions for one epoch, then compiled again with the collected
+ * profile.
+ */
+bool compile_pgo(const options& opt, const std::string& flags, const std::string& source, const std::string& exe,
+                 const std::vector<std::unique_ptr<dllp::layer>>& layers, const dll::processor::task& t, const std::vector<std::string>& actions) {
+    const std::string profile_dir = exe + ".pgo";
+
+    // Never mix the profile of a previous program
+    remove_directory(profile_dir);
+    mkdir(profile_dir.c_str(), 0755);
+
+    const bool clang = command_result(std::string(std::getenv("CXX")) + " --version").find("clang") != std::string::npos;
+
+    std::string generate_flags;
+    std::string use_flags;
+
+    if (clang) {
+        generate_flags = " -fprofile-instr-generate=" + profile_dir + "/%p.profraw ";
+        use_flags      = " -fprofile-instr-use=" + profile_dir + "/default.profdata ";
+    } else {
+        generate_flags = " -fprofile-generate -fprofile-dir=" + profile_dir + " ";
+        use_flags      = " -fprofile-use -fprofile-dir=" + profile_dir + " -fprofile-correction -Wno-missing-profile ";
+    }
+
+    //1. Compile the instrumented program (GCC names the profile after the output)
+
+    if (!dllp::compile(opt, flags + generate_flags, source, exe)) {
+        return false;
+    }
+
+    //2. Run a short training to collect the profile
+
+    auto profile_task = t;
+    profile_task.pt_desc.epochs = 1;
+    profile_task.ft_desc.epochs = 1;
+    profile_task.sweep          = {};
+
+    auto profile_actions = std::find(actions.begin(), actions.end(), "auto") != actions.end() ? t.default_actions : actions;
+
+    // The weights must not be overwritten by the profiling run
+    profile_actions.erase(std::remove(profile_actions.begin(), profile_actions.end(), "save"), profile_actions.end());
+
+    const std::string profile_params = std::string(params_file) + ".pgo";
+
+    dllp::write_params(profile_params, layers, profile_task, profile_actions);
+
+    if (!opt.quiet) {
+        std::cout << "Profiling the program..." << std::endl;
+    }
+
+    if (system((exe + " " + profile_params + " > /dev/null").c_str())) {
+        std::cout << "Profiling run failed" << std::endl;
+        return false;
+    }
+
+    std::remove(profile_params.c_str());
+
+    if (clang && system(("llvm-profdata merge -output=" + profile_dir + "/default.profdata " + profile_dir + "/*.profraw").c_str())) {
+        std::cout << "Failed to merge the profile (llvm-profdata must be available)" << std::endl;
+        return false;
+    }
+
+    //3. Compile the optimized program
+
+    if (!dllp::compile(opt, flags + use_flags, source, exe)) {
+        return false;
+    }
+
+    remove_directory(profile_dir);
+
+    return true;
+}
+
+/*!
+ * \brief Returns the build profile of the program, the command line
+ * overriding the configuration file
+ */
+std::string build_profile(const options& opt, const dll::processor::task& t) {
+    return opt.profile.empty() ? t.general_desc.profile : opt.profile;
+}
+
+/*!
+ * \brief Returns the FNV-1a hash of the given string
+ */
+uint64_t hash_string(const std::string& value) {
+    uint64_t h = 14695981039346656037ULL;
+
+    for (auto c : value) {
+        h ^= static_cast<unsigned char>(c);
+        h *= 1099511628211ULL;
+    }
+
+    return h;
+}
+
+/*!
+ * \brief Generate and compile the program of the given network.
+ *
+ * With the cache, the program is compiled once for each network type,
+ * compiler and compilation flags, in the cache directory. The runtime
+ * parameters are written in the parameters file.
+ *
+ * \param exe The path to the compiled program
+ * \return true if the program is ready, false otherwise
+ */
+bool compile_exe(const dllp::options& opt, const std::vector<std::string>& actions, const dll::processor::task& t, const std::vector<std::unique_ptr<dllp::layer>>& layers, std::string& exe) {
+    auto source = dllp::generate(layers, t);
+
+    dllp::write_params(params_file, layers, t, actions);
+
+    auto profile = build_profile(opt, t);
+
+    std::string flags;
+    if (!dllp::compile_flags(opt, profile, flags)) {
+        return false;
+    }
+
+    auto build = [&](const std::string& target) {
+        if (profile == "pgo") {
+            return dllp::compile_pgo(opt, flags, source, target, layers, t, actions);
+        } else {
+            return dllp::compile(opt, flags, source, target);
+        }
+    };
+
+    if (!opt.cache) {
+        exe = "./.dbn.out";
+        return build(exe);
+    }
+
+    std::stringstream key;
+    key << std::hex << hash_string(std::string(std::getenv("CXX")) + '\n' + profile + '\n' + flags + '\n' + source);
+
+    exe = std::string(cache_directory) + "/dbn-" + key.str() + ".out";
+
+    struct stat attr_exec;
+    if (!stat(exe.c_str(), &attr_exec)) {
+        if (!opt.quiet) {
+            std::cout << "Skip compilation (cached in " << exe << ")" << std::endl;
+        }
+
+        return true;
+    }
+
+    mkdir(cache_directory, 0755);
+
+    // Compile to a temporary file to never cache an incomplete program
+    auto tmp = exe + ".tmp";
+
+    if (!build(tmp)) {
+        return false;
+    }
+
+    return !rename(tmp.c_str(), exe.c_str());
+}
+
 } //end of namespace dllp
 
 int dll::processor::process_file(const dllp::options& opt, const std::vector<std::string>& actions, const std::string& source_file) {
@@ -735,7 +838,8 @@ int dll::processor::process_file(const dllp::options& opt, const std::vector<std
 
     //2. Generate the executable
 
-    if (!dllp::compile_exe(opt, actions, source_file, t, layers)) {
+    std::string exe;
+    if (!dllp::compile_exe(opt, actions, t, layers, exe)) {
         return 1;
     }
 
@@ -745,7 +849,7 @@ int dll::processor::process_file(const dllp::options& opt, const std::vector<std
         std::cout << "Executing the program" << std::endl;
     }
 
-    auto exec_result = system("./.dbn.out");
+    auto exec_result = system((exe + " " + dllp::params_file).c_str());
 
     if (exec_result) {
         std::cout << "Impossible to execute the generated file" << std::endl;
@@ -767,11 +871,12 @@ std::string dll::processor::process_file_result(const dllp::options& opt, const
 
     //2. Generate the executable
 
-    if (!dllp::compile_exe(opt, actions, source_file, t, layers)) {
+    std::string exe;
+    if (!dllp::compile_exe(opt, actions, t, layers, exe)) {
         return "";
     }
 
     //3. Execute and return the result directly
 
-    return dllp::command_result("./.dbn.out");
+    return dllp::command_result(exe + " " + dllp::params_file);
 }
@@ -0,0 +1,57 @@
+//=======================================================================
+// Copyright (c) 2014-2017 Baptiste Wicht
+// Distributed under the terms of the MIT License.
+// (See accompanying file LICENSE or copy at
+//  http://opensource.org/licenses/MIT)
+//=======================================================================
+
+#include "dll_test.hpp"
+
+#include "dll/neural/dense_layer.hpp"
+#include "dll/dbn.hpp"
+
+#include "mnist/mnist_reader.hpp"
+#include "mnist/mnist_utils.hpp"
+
+namespace {
+
+template <template <typename> typename Trainer>
+using perf_dbn_t = typename dll::dbn_desc<
+    dll::dbn_layers<
+        dll::dense_layer_desc<28 * 28, 100>::layer_t,
+        dll::dense_layer_desc<100, 10, dll::activation<dll::function::SOFTMAX>>::layer_t>,
+    dll::updater<dll::updater_type::MOMENTUM>, dll::batch_size<20>, dll::trainer<Trainer>>::dbn_t;
+
+template <typename DBN, typename Dataset>
+void train_and_report(const char* name, const Dataset& dataset, size_t epochs) {
+    auto dbn = std::make_unique<DBN>();
+
+    dbn->learning_rate = 0.05;
+
+    dll::stop_timer timer;
+    timer.start();
+
+    auto ft_error = dbn->fine_tune(dataset.training_images, dataset.training_labels, epochs);
+
+    auto duration = timer.stop();
+
+    auto test_error = dbn->evaluate_error(dataset.test_images, dataset.test_labels);
+
+    std::cout << name << ": ft_error:" << ft_error << " test_error:" << test_error << " time:" << duration << "ms" << std::endl;
+
+    CHECK(ft_error < 5e-2);
+    CHECK(test_error < 0.3);
+}
+
+} // end of anonymous namespace
+
+// Compare the convergence of the synchronous and asynchronous SGD trainers
+TEST_CASE("dbn/sgd/perf/async/1", "[dbn][mnist][sgd][perf]") {
+    auto dataset = mnist::read_dataset_direct<std::vector, etl::dyn_matrix<float, 1>>(2000);
+    REQUIRE(!dataset.training_images.empty());
+
+    mnist::normalize_dataset(dataset);
+
+    train_and_report<perf_dbn_t<dll::sgd_trainer>>("sgd", dataset, 50);
+    train_and_report<perf_dbn_t<dll::async_sgd_trainer>>("async_sgd", dataset, 50);
+}
@@ -63,3 +63,23 @@ TEST_CASE("crbm/mnist_144", "crbm::slow") {
     auto error = rbm.train(dataset.training_images, 25);
     REQUIRE(error < 1e-1);
 }
+
+// The filter gradients computed over 4 slices of the batch in parallel
+TEST_CASE("crbm/mnist_140/parallel_gradients", "crbm::slow_parallel") {
+    dll::conv_rbm_square_desc<
+        2, 28, 40, 17,
+        dll::batch_size<100>,
+        dll::parallel_gradients<4>,
+        dll::momentum, dll::weight_type<float>>::layer_t rbm;
+
+    auto dataset = mnist::read_dataset_direct<std::vector, etl::fast_dyn_matrix<float, 2, 28, 28>>(500);
+
+    REQUIRE(!dataset.training_images.empty());
+
+    mnist::binarize_dataset(dataset);
+
+    auto error = rbm.train(dataset.training_images, 25);
+    REQUIRE(error < 1);
+
+    dll::dump_timers();
+}
@@ -10,6 +10,7 @@
 #include "catch.hpp"
 
 #include "dll/rbm/rbm.hpp"
+#include "dll/neural/dense_layer.hpp"
 #include "dll/dbn.hpp"
 
 #include "mnist/mnist_reader.hpp"
@@ -61,3 +62,40 @@ TEST_CASE("dbn/perf/3", "[dbn][bench][slow]") {
 
     dll::dump_timers();
 }
+
+TEST_CASE("dbn/perf/sparse", "[dbn][bench][fast]") {
+    typedef dll::dbn_desc<
+        dll::dbn_layers<
+            dll::dense_layer_desc<28 * 28, 1000>::layer_t,
+            dll::dense_layer_desc<1000, 1000>::layer_t,
+            dll::dense_layer_desc<1000, 10, dll::softmax>::layer_t>,
+        dll::batch_size<64>>::dbn_t dbn_t;
+
+    auto dbn = std::make_unique<dbn_t>();
+
+    etl::fast_dyn_matrix<float, 64, 28 * 28> batch;
+    batch = etl::uniform_generator(-1.0, 1.0);
+
+    auto bench = [&](const char* name) {
+        auto start = std::chrono::steady_clock::now();
+
+        for (size_t i = 0; i < 20; ++i) {
+            auto output = dbn->forward_batch(batch);
+            REQUIRE(etl::size(output) == 64 * 10);
+        }
+
+        auto end = std::chrono::steady_clock::now();
+
+        std::cout << name << ": " << std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() / 20 << "us/batch" << std::endl;
+    };
+
+    bench("dense");
+
+    dbn->prune(0.9);
+
+    bench("sparse (90%)");
+
+    dbn->prune(0.98);
+
+    bench("sparse (98%)");
+}
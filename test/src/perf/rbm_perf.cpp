@@ -8,6 +8,9 @@
 #include "catch.hpp"
 
 #include "dll/rbm/rbm.hpp"
+#include "dll/rbm/dyn_rbm.hpp"
+#include "dll/rbm/conv_rbm.hpp"
+#include "dll/rbm/conv_rbm_mp.hpp"
 
 #include "mnist/mnist_reader.hpp"
 #include "mnist/mnist_utils.hpp"
@@ -46,3 +49,120 @@ TEST_CASE("rbm/perf/2", "rbm::slow") {
 
     dll::dump_timers();
 }
+
+namespace {
+
+template <typename RBM, typename Dataset>
+void pretrain_and_report(const char* name, RBM& rbm, const Dataset& dataset, size_t epochs) {
+    dll::stop_timer timer;
+    timer.start();
+
+    auto error = rbm.train(dataset.training_images, epochs);
+
+    auto duration = timer.stop();
+
+    std::cout << name << ": error:" << error << " time:" << duration << "ms" << std::endl;
+
+    REQUIRE(error < 5e-1);
+}
+
+template <size_t R>
+using perf_rbm_t = typename dll::rbm_desc<28 * 28, 500, dll::batch_size<64>, dll::momentum, dll::data_parallel<R>>::layer_t;
+
+template <size_t R>
+using perf_dyn_rbm_t = typename dll::dyn_rbm_desc<dll::batch_size<64>, dll::momentum, dll::data_parallel<R>>::layer_t;
+
+template <size_t R>
+using perf_crbm_t = typename dll::conv_rbm_square_desc<1, 28, 20, 17, dll::batch_size<64>, dll::momentum, dll::data_parallel<R>>::layer_t;
+
+template <size_t R>
+using perf_crbm_mp_t = typename dll::conv_rbm_mp_desc_square<1, 28, 20, 17, 2, dll::batch_size<64>, dll::momentum, dll::data_parallel<R>>::layer_t;
+
+template <typename RBM>
+using perf_cd3_trainer_t = dll::cd_trainer<3, RBM>;
+
+template <typename RBM>
+using perf_mf_cd3_trainer_t = dll::mean_field_cd_trainer<3, RBM>;
+
+template <template <typename> class Trainer>
+using perf_cd_rbm_t = typename dll::rbm_desc<28 * 28, 500, dll::batch_size<64>, dll::momentum, dll::trainer_rbm<Trainer>>::layer_t;
+
+} // end of anonymous namespace
+
+// Scaling of the data-parallel pretraining with the number of micro-batches
+TEST_CASE("rbm/perf/data_parallel", "rbm::data_parallel") {
+    auto dataset = mnist::read_dataset_direct<std::vector, etl::dyn_vector<float>>(2048);
+    REQUIRE(!dataset.training_images.empty());
+
+    mnist::binarize_dataset(dataset);
+
+    {
+        perf_rbm_t<1> rbm;
+        pretrain_and_report("rbm R=1", rbm, dataset, 5);
+    }
+
+    {
+        perf_rbm_t<2> rbm;
+        pretrain_and_report("rbm R=2", rbm, dataset, 5);
+    }
+
+    {
+        perf_rbm_t<4> rbm;
+        pretrain_and_report("rbm R=4", rbm, dataset, 5);
+    }
+
+    {
+        perf_dyn_rbm_t<1> rbm(28 * 28, 500);
+        pretrain_and_report("dyn_rbm R=1", rbm, dataset, 5);
+    }
+
+    {
+        perf_dyn_rbm_t<4> rbm(28 * 28, 500);
+        pretrain_and_report("dyn_rbm R=4", rbm, dataset, 5);
+    }
+}
+
+TEST_CASE("crbm/perf/data_parallel", "crbm::data_parallel") {
+    auto dataset = mnist::read_dataset_direct<std::vector, etl::fast_dyn_matrix<float, 1, 28, 28>>(1024);
+    REQUIRE(!dataset.training_images.empty());
+
+    mnist::binarize_dataset(dataset);
+
+    {
+        perf_crbm_t<1> rbm;
+        pretrain_and_report("crbm R=1", rbm, dataset, 5);
+    }
+
+    {
+        perf_crbm_t<4> rbm;
+        pretrain_and_report("crbm R=4", rbm, dataset, 5);
+    }
+
+    {
+        perf_crbm_mp_t<1> rbm;
+        pretrain_and_report("crbm_mp R=1", rbm, dataset, 5);
+    }
+
+    {
+        perf_crbm_mp_t<4> rbm;
+        pretrain_and_report("crbm_mp R=4", rbm, dataset, 5);
+    }
+}
+
+// Sampled and mean-field negative phases of CD-3
+TEST_CASE("rbm/perf/mean_field", "rbm::mean_field") {
+    auto dataset = mnist::read_dataset_direct<std::vector, etl::dyn_vector<float>>(2048);
+    REQUIRE(!dataset.training_images.empty());
+
+    mnist::binarize_dataset(dataset);
+
+    {
+        perf_cd_rbm_t<perf_cd3_trainer_t> rbm;
+        pretrain_and_report("rbm CD-3", rbm, dataset, 5);
+    }
+
+    {
+        perf_cd_rbm_t<perf_mf_cd3_trainer_t> rbm;
+        pretrain_and_report("rbm mean-field CD-3", rbm, dataset, 5);
+    }
+}
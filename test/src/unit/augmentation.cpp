@@ -11,6 +11,7 @@
  */
 
 #include <deque>
+#include <numeric>
 
 #include "dll_test.hpp"
 
@@ -328,3 +329,429 @@ TEST_CASE("unit/augment/mnist/8", "[dbn][unit]") {
     std::cout << "test_error:" << test_error << std::endl;
     REQUIRE(test_error < 0.3);
 }
+
+// Use a out-memory generator with several workers for fine-tuning with augmentation
+TEST_CASE("unit/augment/mnist/9", "[dbn][unit]") {
+    typedef dll::dbn_desc<
+        dll::dbn_layers<
+            dll::dense_layer_desc<28 * 28, 300>::layer_t,
+            dll::dense_layer_desc<300, 10, dll::activation<dll::function::SOFTMAX>>::layer_t>,
+        dll::batch_size<25>>::dbn_t dbn_t;
+
+    auto dataset = mnist::read_dataset_direct<std::vector, etl::dyn_matrix<float, 1>>(500);
+    REQUIRE(!dataset.training_images.empty());
+
+    using train_generator_t = dll::outmemory_data_generator_desc<dll::batch_size<25>, dll::big_batch_size<4>, dll::workers<3>, dll::noise<20>, dll::categorical, dll::scale_pre<255>>;
+
+    auto train_generator = dll::make_generator(
+        dataset.training_images, dataset.training_labels,
+        dataset.training_images.size(), 10,
+        train_generator_t{});
+
+    auto test_generator = dll::make_generator(
+        dataset.test_images, dataset.test_labels,
+        dataset.test_images.size(), 10,
+        train_generator_t{});
+
+    auto dbn = std::make_unique<dbn_t>();
+
+    auto error = dbn->fine_tune(*train_generator, 50);
+    std::cout << "error:" << error << std::endl;
+    CHECK(error < 5e-2);
+
+    auto test_error = dbn->evaluate_error(*test_generator);
+    std::cout << "test_error:" << test_error << std::endl;
+    CHECK(test_error < 0.3);
+}
+
+// Use a memory-mapped generator over a packed dataset for fine-tuning with augmentation
+TEST_CASE("unit/augment/mnist/10", "[dbn][unit]") {
+    typedef dll::dbn_desc<
+        dll::dbn_layers<
+            dll::dense_layer_desc<28 * 28, 300>::layer_t,
+            dll::dense_layer_desc<300, 10, dll::activation<dll::function::SOFTMAX>>::layer_t>,
+        dll::batch_size<25>>::dbn_t dbn_t;
+
+    auto dataset = mnist::read_dataset_direct<std::vector, etl::dyn_matrix<float, 1>>(500);
+    REQUIRE(!dataset.training_images.empty());
+
+    REQUIRE(dll::write_packed_dataset(".tmp.train.dlld", dataset.training_images, dataset.training_labels));
+    REQUIRE(dll::write_packed_dataset(".tmp.test.dlld", dataset.test_images, dataset.test_labels));
+
+    using generator_t = dll::mmap_data_generator_desc<dll::batch_size<25>, dll::big_batch_size<4>, dll::workers<2>, dll::noise<20>, dll::categorical, dll::scale_pre<255>>;
+
+    auto train_generator = dll::make_mmap_generator<float, 1>(".tmp.train.dlld", 10, generator_t{});
+    auto test_generator  = dll::make_mmap_generator<float, 1>(".tmp.test.dlld", 10, generator_t{});
+
+    REQUIRE(train_generator->size() == dataset.training_images.size());
+    REQUIRE(test_generator->size() == dataset.test_images.size());
+
+    auto dbn = std::make_unique<dbn_t>();
+
+    auto error = dbn->fine_tune(*train_generator, 50);
+    std::cout << "error:" << error << std::endl;
+    CHECK(error < 5e-2);
+
+    auto test_error = dbn->evaluate_error(*test_generator);
+    std::cout << "test_error:" << test_error << std::endl;
+    CHECK(test_error < 0.3);
+}
+
+// Use a memory-mapped generator reading uint8_t samples from several shards
+TEST_CASE("unit/augment/mnist/shards", "[dbn][unit]") {
+    typedef dll::dbn_desc<
+        dll::dbn_layers<
+            dll::dense_layer_desc<28 * 28, 300>::layer_t,
+            dll::dense_layer_desc<300, 10, dll::activation<dll::function::SOFTMAX>>::layer_t>,
+        dll::batch_size<25>>::dbn_t dbn_t;
+
+    auto dataset = mnist::read_dataset_direct<std::vector, etl::dyn_matrix<float, 1>>(500);
+    REQUIRE(!dataset.training_images.empty());
+
+    auto& images = dataset.training_images;
+    auto& labels = dataset.training_labels;
+
+    const size_t half = images.size() / 2;
+
+    decltype(dataset.training_images) first_images(images.begin(), images.begin() + half);
+    decltype(dataset.training_images) second_images(images.begin() + half, images.end());
+    decltype(dataset.training_labels) first_labels(labels.begin(), labels.begin() + half);
+    decltype(dataset.training_labels) second_labels(labels.begin() + half, labels.end());
+
+    REQUIRE(dll::write_packed_dataset<uint8_t>(".tmp.train.0.dlld", first_images, first_labels));
+    REQUIRE(dll::write_packed_dataset<uint8_t>(".tmp.train.1.dlld", second_images, second_labels));
+
+    using generator_t = dll::mmap_data_generator_desc<dll::batch_size<25>, dll::big_batch_size<4>, dll::workers<2>, dll::categorical, dll::scale_pre<255>>;
+
+    auto generator = dll::make_mmap_generator<float, 1, uint8_t>(std::vector<std::string>{".tmp.train.0.dlld", ".tmp.train.1.dlld"}, 10, generator_t{});
+
+    REQUIRE(generator->size() == images.size());
+
+    // The samples of the second shard follow the samples of the first one
+    generator->reset();
+
+    for (size_t b = 0; b < half / 25; ++b) {
+        generator->data_batch();
+        generator->next_batch();
+    }
+
+    auto batch  = generator->data_batch();
+    auto target = generator->label_batch();
+
+    CHECK(batch(0)[200] == Approx(images[half][200] / 255.0f));
+    CHECK(target(0)(labels[half]) == Approx(1.0f));
+
+    auto dbn = std::make_unique<dbn_t>();
+
+    auto error = dbn->fine_tune(*generator, 50);
+    std::cout << "error:" << error << std::endl;
+    CHECK(error < 5e-2);
+}
+
+// Use a in-memory generator with lazily generated augmented copies
+TEST_CASE("unit/augment/mnist/11", "[dbn][unit]") {
+    typedef dll::dbn_desc<
+        dll::dbn_layers<
+            dll::dense_layer_desc<28 * 28, 300>::layer_t,
+            dll::dense_layer_desc<300, 10, dll::activation<dll::function::SOFTMAX>>::layer_t>,
+        dll::batch_size<25>>::dbn_t dbn_t;
+
+    auto dataset = mnist::read_dataset_direct<std::vector, etl::dyn_matrix<float, 1>>(490);
+    REQUIRE(!dataset.training_images.empty());
+
+    using train_generator_t = dll::inmemory_data_generator_desc<dll::batch_size<25>, dll::copy<3>, dll::noise<20>, dll::categorical, dll::scale_pre<255>>;
+    using test_generator_t  = dll::inmemory_data_generator_desc<dll::batch_size<25>, dll::categorical, dll::scale_pre<255>>;
+
+    auto train_generator = dll::make_generator(
+        dataset.training_images, dataset.training_labels,
+        dataset.training_images.size(), 10,
+        train_generator_t{});
+
+    auto test_generator = dll::make_generator(
+        dataset.test_images, dataset.test_labels,
+        dataset.test_images.size(), 10,
+        test_generator_t{});
+
+    REQUIRE(train_generator->size() == 3 * dataset.training_images.size());
+
+    auto dbn = std::make_unique<dbn_t>();
+
+    auto error = dbn->fine_tune(*train_generator, 25);
+    std::cout << "error:" << error << std::endl;
+    CHECK(error < 5e-2);
+
+    auto test_error = dbn->evaluate_error(*test_generator);
+    std::cout << "test_error:" << test_error << std::endl;
+    CHECK(test_error < 0.3);
+}
+
+// Use disjoint shards of the dataset in several generators
+TEST_CASE("unit/augment/mnist/12", "[dbn][unit]") {
+    typedef dll::dbn_desc<
+        dll::dbn_layers<
+            dll::dense_layer_desc<28 * 28, 300>::layer_t,
+            dll::dense_layer_desc<300, 10, dll::activation<dll::function::SOFTMAX>>::layer_t>,
+        dll::batch_size<25>>::dbn_t dbn_t;
+
+    auto dataset = mnist::read_dataset_direct<std::vector, etl::dyn_matrix<float, 1>>(1000);
+    REQUIRE(!dataset.training_images.empty());
+
+    using train_generator_t = dll::inmemory_data_generator_desc<dll::batch_size<25>, dll::categorical, dll::scale_pre<255>>;
+
+    const size_t n = dataset.training_images.size();
+
+    auto shard_0 = dll::make_generator(dataset.training_images, dataset.training_labels, 10, dll::shard(0, 2), train_generator_t{});
+    auto shard_1 = dll::make_generator(dataset.training_images, dataset.training_labels, 10, dll::shard(1, 2), train_generator_t{});
+
+    REQUIRE(shard_0->size() + shard_1->size() == n);
+    REQUIRE(shard_0->size() == n / 2);
+
+    // The two shards must be disjoint
+    auto m0 = dll::shard(0, 2).members(n);
+    auto m1 = dll::shard(1, 2).members(n);
+
+    for (size_t i = 0; i < n; ++i) {
+        REQUIRE(m0[i] != m1[i]);
+    }
+
+    auto test_generator = dll::make_generator(
+        dataset.test_images, dataset.test_labels,
+        dataset.test_images.size(), 10,
+        train_generator_t{});
+
+    auto dbn = std::make_unique<dbn_t>();
+
+    auto error = dbn->fine_tune(*shard_0, 50);
+    std::cout << "error:" << error << std::endl;
+    CHECK(error < 5e-2);
+
+    auto test_error = dbn->evaluate_error(*test_generator);
+    std::cout << "test_error:" << test_error << std::endl;
+    CHECK(test_error < 0.3);
+}
+
+// The counters of a threaded generator cover every batch of an epoch
+TEST_CASE("unit/augment/mnist/13", "[dbn][unit]") {
+    auto dataset = mnist::read_dataset_direct<std::vector, etl::dyn_matrix<float, 1>>(500);
+    REQUIRE(!dataset.training_images.empty());
+
+    using generator_t = dll::inmemory_data_generator_desc<dll::batch_size<25>, dll::big_batch_size<4>, dll::noise<20>, dll::categorical, dll::scale_pre<255>>;
+
+    auto generator = dll::make_generator(
+        dataset.training_images, dataset.training_labels,
+        dataset.training_images.size(), 10,
+        generator_t{});
+
+    generator->reset();
+
+    while (generator->has_next_batch()) {
+        auto data = generator->data_batch();
+        REQUIRE(etl::dim<0>(data) > 0);
+
+        generator->next_batch();
+    }
+
+    auto& stats = generator->stats();
+
+    REQUIRE(stats.batches() == dataset.training_images.size() / 25);
+    REQUIRE(stats.fills.load() >= stats.batches());
+    REQUIRE(stats.waits.load() <= stats.batches());
+
+    // The counters are also added to the counters of all the generators
+    REQUIRE(dll::global_generator_stats().batches() >= stats.batches());
+}
+
+// The indexed shuffle only permutes the indices and gathers the batches
+TEST_CASE("unit/augment/mnist/14", "[dbn][unit]") {
+    auto dataset = mnist::read_dataset_direct<std::vector, etl::dyn_matrix<float, 1>>(500);
+    REQUIRE(!dataset.training_images.empty());
+
+    using generator_t = dll::inmemory_data_generator_desc<dll::batch_size<25>, dll::indexed_shuffle, dll::categorical, dll::scale_pre<255>>;
+
+    auto generator = dll::make_generator(
+        dataset.training_images, dataset.training_labels,
+        dataset.training_images.size(), 10,
+        generator_t{});
+
+    etl::dyn_matrix<float, 2> inputs(generator->input_cache);
+
+    generator->reset_shuffle();
+
+    // The cache is not permuted
+    REQUIRE(etl::max(etl::abs(generator->input_cache - inputs)) == 0.0f);
+
+    std::vector<size_t> seen(generator->size(), 0);
+
+    size_t k = 0;
+
+    while (generator->has_next_batch()) {
+        auto data   = generator->data_batch();
+        auto labels = generator->label_batch();
+
+        for (size_t i = 0; i < etl::dim<0>(data); ++i, ++k) {
+            const size_t s = generator->order[k];
+
+            ++seen[s];
+
+            REQUIRE(etl::max(etl::abs(data(i) - inputs(s))) == 0.0f);
+            REQUIRE(labels(i, dataset.training_labels[s]) == 1.0f);
+        }
+
+        generator->next_batch();
+    }
+
+    REQUIRE(k == generator->size());
+    REQUIRE(std::count(seen.begin(), seen.end(), 1) == long(generator->size()));
+}
+
+// The auto-encoder generators do not copy their labels
+TEST_CASE("unit/augment/mnist/shared_labels", "[dbn][unit]") {
+    auto dataset = mnist::read_dataset_direct<std::vector, etl::dyn_matrix<float, 1>>(100);
+    REQUIRE(!dataset.training_images.empty());
+
+    using in_generator_t  = dll::inmemory_data_generator_desc<dll::batch_size<10>, dll::autoencoder, dll::binarize_pre<30>>;
+    using out_generator_t = dll::outmemory_data_generator_desc<dll::batch_size<10>, dll::autoencoder, dll::binarize_pre<30>>;
+
+    auto in_generator = dll::make_generator(
+        dataset.training_images, dataset.training_images,
+        dataset.training_images.size(), 10,
+        in_generator_t{});
+
+    auto out_generator = dll::make_generator(
+        dataset.training_images, dataset.training_images,
+        dataset.training_images.size(), 10,
+        out_generator_t{});
+
+    REQUIRE(in_generator->shared_labels);
+    REQUIRE(out_generator->shared_labels);
+
+    REQUIRE(etl::sum(in_generator->label_batch() - in_generator->data_batch()) == 0.0);
+    REQUIRE(etl::sum(out_generator->label_batch() - out_generator->data_batch()) == 0.0);
+
+    in_generator->shuffle();
+
+    REQUIRE(etl::sum(in_generator->label_batch() - in_generator->data_batch()) == 0.0);
+}
+
+// The mirroring is folded in the copy of the random crop
+TEST_CASE("unit/augment/crop_mirror", "[unit]") {
+    using desc = dll::outmemory_data_generator_desc<dll::batch_size<25>, dll::random_crop<3, 2>, dll::horizontal_mirroring, dll::vertical_mirroring>;
+
+    etl::dyn_matrix<float, 3> image(2, 4, 5);
+    std::iota(image.begin(), image.end(), 0.0f);
+
+    dll::random_cropper<desc> cropper(image);
+
+    etl::dyn_matrix<float, 3> a(2, 2, 3);
+    etl::dyn_matrix<float, 3> b(2, 2, 3);
+    etl::dyn_matrix<float, 3> c(2, 2, 3);
+
+    for (size_t seed = 0; seed < 10; ++seed) {
+        std::mt19937_64 g1(seed);
+        std::mt19937_64 g2(seed);
+        std::mt19937_64 g3(seed);
+
+        cropper.transform_first(a, image, g1);
+        cropper.transform_first(b, image, g2, true, false);
+        cropper.transform_first(c, image, g3, false, true);
+
+        for (size_t ch = 0; ch < 2; ++ch) {
+            for (size_t y = 0; y < 2; ++y) {
+                for (size_t x = 0; x < 3; ++x) {
+                    REQUIRE(b(ch, y, x) == a(ch, y, 2 - x));
+                    REQUIRE(c(ch, y, x) == a(ch, 1 - y, x));
+                }
+            }
+        }
+    }
+
+    // The center crop
+    cropper.transform_first_test(a, image);
+
+    REQUIRE(a(0, 0, 0) == image(0, 1, 1));
+    REQUIRE(a(1, 1, 2) == image(1, 2, 3));
+}
+
+// The fused preprocessing must match the chain of the transformers
+TEST_CASE("unit/augment/preprocessing", "[unit]") {
+    using desc_t = dll::inmemory_data_generator_desc<dll::scale_pre<255>, dll::normalize_pre>;
+    using bin_t  = dll::inmemory_data_generator_desc<dll::binarize_pre<30>>;
+
+    etl::dyn_matrix<float, 2> batch(8, 100);
+    batch = 255.0f * etl::uniform_generator(0.0, 1.0);
+
+    etl::dyn_matrix<float, 2> expected(batch);
+    etl::dyn_matrix<float, 2> bin_expected(batch);
+
+    dll::pre_scaler<desc_t>::transform_all(expected);
+    dll::pre_normalizer<desc_t>::transform_all(expected);
+
+    dll::pre_binarizer<bin_t>::transform_all(bin_expected);
+
+    etl::dyn_matrix<float, 2> bin_batch(batch);
+
+    dll::pre_transformer<desc_t>::transform_all(batch);
+    dll::pre_transformer<bin_t>::transform_all(bin_batch);
+
+    for (size_t i = 0; i < etl::size(batch); ++i) {
+        REQUIRE(batch[i] == Approx(expected[i]).epsilon(1e-3));
+        REQUIRE(bin_batch[i] == bin_expected[i]);
+    }
+}
+
+// Use a pipeline generator, with several workers per stage, for fine-tuning
+TEST_CASE("unit/augment/mnist/pipeline", "[dbn][unit]") {
+    typedef dll::dbn_desc<
+        dll::dbn_layers<
+            dll::dense_layer_desc<28 * 28, 300>::layer_t,
+            dll::dense_layer_desc<300, 10, dll::activation<dll::function::SOFTMAX>>::layer_t>,
+        dll::batch_size<25>>::dbn_t dbn_t;
+
+    auto dataset = mnist::read_dataset_direct<std::vector, etl::dyn_matrix<float, 1>>(500);
+    REQUIRE(!dataset.training_images.empty());
+
+    using train_generator_t = dll::outmemory_data_generator_desc<dll::batch_size<25>, dll::big_batch_size<6>, dll::categorical, dll::scale_pre<255>>;
+
+    dll::pipeline_options options;
+    options.decode     = {2, 2};
+    options.preprocess = {3, 1};
+    options.augment    = {1, 2};
+
+    auto train_generator = dll::make_pipeline_generator(
+        dataset.training_images, dataset.training_labels,
+        dataset.training_images.size(), 10,
+        options, train_generator_t{});
+
+    // The batches are collated in the order of the dataset
+    train_generator->reset();
+
+    size_t i = 0;
+    while (train_generator->has_next_batch()) {
+        auto batch  = train_generator->data_batch();
+        auto labels = train_generator->label_batch();
+
+        for (size_t b = 0; b < etl::dim<0>(batch); ++b, ++i) {
+            REQUIRE(batch(b, 200) == Approx(dataset.training_images[i][200] / 255.0f));
+            REQUIRE(labels(b, dataset.training_labels[i]) == 1.0f);
+        }
+
+        train_generator->next_batch();
+    }
+
+    REQUIRE(i == dataset.training_images.size());
+
+    auto test_generator = dll::make_pipeline_generator(
+        dataset.test_images, dataset.test_labels,
+        dataset.test_images.size(), 10,
+        options, train_generator_t{});
+
+    auto dbn = std::make_unique<dbn_t>();
+
+    auto error = dbn->fine_tune(*train_generator, 50);
+    std::cout << "error:" << error << std::endl;
+    CHECK(error < 5e-2);
+
+    auto test_error = dbn->evaluate_error(*test_generator);
+    std::cout << "test_error:" << test_error << std::endl;
+    CHECK(test_error < 0.3);
+}
@@ -0,0 +1,104 @@
+//=======================================================================
+// Copyright (c) 2014-2017 Baptiste Wicht
+// Distributed under the terms of the MIT License.
+// (See accompanying file LICENSE or copy at
+//  http://opensource.org/licenses/MIT)
+//=======================================================================
+
+#include "dll_test.hpp"
+
+#include "dll/neural/dense_layer.hpp"
+#include "dll/neural/rnn_layer.hpp"
+#include "dll/neural/lstm_layer.hpp"
+#include "dll/neural/bidirectional_layer.hpp"
+#include "dll/neural/recurrent_last_layer.hpp"
+#include "dll/network.hpp"
+#include "dll/datasets.hpp"
+
+// Bidirectional LSTM
+TEST_CASE("unit/bidirectional/1", "[unit][bidirectional]") {
+    auto dataset = dll::make_mnist_dataset_nc_sub(0, 1000, dll::batch_size<100>{}, dll::scale_pre<255>{});
+
+    constexpr size_t time_steps      = 28;
+    constexpr size_t sequence_length = 28;
+    constexpr size_t hidden_units    = 30;
+
+    using network_t = dll::network_desc<
+        dll::network_layers<
+            dll::bidirectional_layer<dll::lstm_layer<time_steps, sequence_length, hidden_units>>,
+            dll::recurrent_last_layer<time_steps, 2 * hidden_units>,
+            dll::dense_layer<2 * hidden_units, 10, dll::softmax>
+        >
+        , dll::updater<dll::updater_type::ADAM>      // Adam
+        , dll::batch_size<100>                       // The mini-batch size
+    >::network_t;
+
+    auto net = std::make_unique<network_t>();
+
+    REQUIRE(net->fine_tune(dataset.train(), 30) < 0.25);
+    REQUIRE(net->evaluate_error(dataset.test()) < 0.5);
+}
+
+// Deep dynamic bidirectional RNN
+TEST_CASE("unit/bidirectional/2", "[unit][bidirectional]") {
+    auto dataset = dll::make_mnist_dataset_nc_sub(0, 1000, dll::batch_size<100>{}, dll::scale_pre<255>{});
+
+    constexpr size_t time_steps      = 28;
+    constexpr size_t sequence_length = 28;
+    constexpr size_t hidden_units    = 30;
+
+    using network_t = dll::dyn_network_desc<
+        dll::network_layers<
+            dll::bidirectional_layer<dll::rnn_layer<time_steps, sequence_length, hidden_units>>,
+            dll::bidirectional_layer<dll::rnn_layer<time_steps, 2 * hidden_units, hidden_units>>,
+            dll::recurrent_last_layer<time_steps, 2 * hidden_units>,
+            dll::dense_layer<2 * hidden_units, 10, dll::softmax>
+        >
+        , dll::updater<dll::updater_type::ADAM>      // Adam
+        , dll::batch_size<100>                       // The mini-batch size
+    >::network_t;
+
+    auto net = std::make_unique<network_t>();
+
+    REQUIRE(net->fine_tune(dataset.train(), 30) < 0.3);
+    REQUIRE(net->evaluate_error(dataset.test()) < 0.5);
+}
+
+// The two directions against the layers run separately
+TEST_CASE("unit/bidirectional/directions/1", "[unit][bidirectional]") {
+    constexpr size_t time_steps      = 5;
+    constexpr size_t sequence_length = 7;
+    constexpr size_t hidden_units    = 6;
+
+    using rnn_t = dll::rnn_layer<time_steps, sequence_length, hidden_units>;
+
+    dll::bidirectional_layer<rnn_t> layer;
+
+    etl::fast_matrix<float, 4, time_steps, sequence_length> x;
+    etl::fast_matrix<float, 4, time_steps, sequence_length> x_rev;
+    etl::fast_matrix<float, 4, time_steps, 2 * hidden_units> h;
+    etl::fast_matrix<float, 4, time_steps, hidden_units> h_fwd;
+    etl::fast_matrix<float, 4, time_steps, hidden_units> h_bwd;
+
+    x = etl::uniform_generator(-1.0, 1.0);
+
+    for (size_t b = 0; b < 4; ++b) {
+        for (size_t t = 0; t < time_steps; ++t) {
+            x_rev(b)(t) = x(b)(time_steps - 1 - t);
+        }
+    }
+
+    layer.forward_batch(h, x);
+
+    layer.layers[0].forward_batch(h_fwd, x);
+    layer.layers[1].forward_batch(h_bwd, x_rev);
+
+    for (size_t b = 0; b < 4; ++b) {
+        for (size_t t = 0; t < time_steps; ++t) {
+            for (size_t n = 0; n < hidden_units; ++n) {
+                REQUIRE(h(b, t, n) == Approx(h_fwd(b, t, n)));
+                REQUIRE(h(b, t, hidden_units + n) == Approx(h_bwd(b, time_steps - 1 - t, n)));
+            }
+        }
+    }
+}
@@ -204,3 +204,136 @@ TEST_CASE("unit/bn/5", "[unit][bn]") {
     FT_CHECK_2_VAL(net, dataset, 50, 5e-2);
     TEST_CHECK_2(net, dataset, 0.25);
 }
+
+// Folding of the BN layers for inference
+TEST_CASE("unit/bn/fold/1", "[unit][bn]") {
+    using network_t = dll::network_desc<
+        dll::network_layers<
+            dll::conv_layer_desc<1, 28, 28, 6, 5, 5, dll::no_activation>::layer_t,
+            dll::batch_normalization_4d_layer_desc<6, 24, 24>::layer_t,
+            dll::activation_layer_desc<dll::function::RELU>::layer_t,
+
+            dll::dense_layer_desc<6 * 24 * 24, 100, dll::no_bias, dll::no_activation>::layer_t,
+            dll::batch_normalization_2d_layer_desc<100>::layer_t,
+            dll::activation_layer_desc<dll::function::SIGMOID>::layer_t,
+
+            dll::dense_layer_desc<100, 10, dll::no_activation>::layer_t,
+            dll::activation_layer_desc<dll::function::SOFTMAX>::layer_t
+        >,
+        dll::updater<dll::updater_type::ADADELTA>, dll::batch_size<25>>::network_t;
+
+    auto dataset = dll::make_mnist_dataset_val(0, 500, 1000, dll::batch_size<25>{}, dll::scale_pre<255>{});
+
+    auto net = std::make_unique<network_t>();
+
+    net->learning_rate = 0.01;
+
+    FT_CHECK_2_VAL(net, dataset, 5, 0.2);
+
+    auto error = net->evaluate_error(dataset.test());
+
+    net->fold_batch_norm();
+
+    REQUIRE(net->template layer_get<1>().folded);
+    REQUIRE(!net->template layer_get<1>().folded_shift);
+    REQUIRE(net->template layer_get<4>().folded);
+    REQUIRE(net->template layer_get<4>().folded_shift);
+
+    REQUIRE(std::abs(net->evaluate_error(dataset.test()) - error) < 1e-3);
+}
+
+// The fused kernels against the direct computation
+TEST_CASE("unit/bn/fused/1", "[unit][bn]") {
+    const size_t B = 7;
+    const size_t K = 3;
+    const size_t P = 5 * 5;
+    const size_t S = B * P;
+
+    etl::dyn_matrix<float, 3> x(B, K, P);
+    etl::dyn_matrix<float, 3> dy(B, K, P);
+
+    x  = etl::uniform_generator(1.0, 5.0);
+    dy = etl::uniform_generator(-1.0, 1.0);
+
+    etl::dyn_vector<float> gamma(K);
+    etl::dyn_vector<float> beta(K);
+
+    gamma = etl::uniform_generator(0.5, 1.5);
+    beta  = etl::uniform_generator(-0.5, 0.5);
+
+    etl::dyn_matrix<float, 3> y(B, K, P);
+    etl::dyn_matrix<float, 3> dx(B, K, P);
+
+    etl::dyn_vector<float> mean(K);
+    etl::dyn_vector<float> var(K);
+    etl::dyn_vector<float> inv_var(K);
+
+    etl::dyn_vector<float> dgamma(K);
+    etl::dyn_vector<float> dbeta(K);
+
+    const float e = 1e-8;
+
+    dll::batch_norm_4d_forward(x.memory_start(), y.memory_start(), B, K, P, gamma.memory_start(), beta.memory_start(), e,
+                               mean.memory_start(), var.memory_start(), inv_var.memory_start());
+
+    dll::batch_norm_4d_backward(x.memory_start(), dy.memory_start(), dx.memory_start(), B, K, P, gamma.memory_start(), mean.memory_start(), inv_var.memory_start());
+
+    dll::batch_norm_4d_gradients(x.memory_start(), dy.memory_start(), B, K, P, mean.memory_start(), inv_var.memory_start(), dgamma.memory_start(), dbeta.memory_start());
+
+    for (size_t k = 0; k < K; ++k) {
+        double m = 0;
+
+        for (size_t b = 0; b < B; ++b) {
+            for (size_t i = 0; i < P; ++i) {
+                m += x(b, k, i);
+            }
+        }
+
+        m /= S;
+
+        double v = 0;
+
+        for (size_t b = 0; b < B; ++b) {
+            for (size_t i = 0; i < P; ++i) {
+                v += (x(b, k, i) - m) * (x(b, k, i) - m);
+            }
+        }
+
+        v /= S;
+
+        const double inv = 1.0 / std::sqrt(v + e);
+
+        REQUIRE(std::abs(mean(k) - m) < 1e-4);
+        REQUIRE(std::abs(var(k) - v) < 1e-4);
+
+        double dxhat_l      = 0;
+        double dxhat_xhat_l = 0;
+        double dy_xhat_l    = 0;
+        double dy_l         = 0;
+
+        for (size_t b = 0; b < B; ++b) {
+            for (size_t i = 0; i < P; ++i) {
+                const double xhat = (x(b, k, i) - m) * inv;
+
+                REQUIRE(std::abs(y(b, k, i) - (gamma(k) * xhat + beta(k))) < 1e-3);
+
+                dxhat_l += dy(b, k, i) * gamma(k);
+                dxhat_xhat_l += dy(b, k, i) * gamma(k) * xhat;
+                dy_xhat_l += dy(b, k, i) * xhat;
+                dy_l += dy(b, k, i);
+            }
+        }
+
+        REQUIRE(std::abs(dgamma(k) - dy_xhat_l) < 1e-3);
+        REQUIRE(std::abs(dbeta(k) - dy_l) < 1e-3);
+
+        for (size_t b = 0; b < B; ++b) {
+            for (size_t i = 0; i < P; ++i) {
+                const double xhat = (x(b, k, i) - m) * inv;
+                const double ref  = (1.0 / S) * inv * (S * dy(b, k, i) * gamma(k) - dxhat_l - xhat * dxhat_xhat_l);
+
+                REQUIRE(std::abs(dx(b, k, i) - ref) < 1e-3);
+            }
+        }
+    }
+}
@@ -113,3 +113,89 @@ TEST_CASE("conv/ae/2", "[dense][dbn][mnist][sgd][ae]") {
     std::cout << "test_error:" << test_error << std::endl;
     REQUIRE(test_error < 0.15);
 }
+
+TEST_CASE("unit/deconv/gemm/1", "[deconv][unit]") {
+    using layer_t = dll::deconv_layer_desc<3, 9, 8, 4, 5, 3, dll::activation<dll::function::SIGMOID>>::layer_t;
+
+    layer_t layer;
+
+    layer.b = etl::uniform_generator(-1.0, 1.0);
+
+    struct {
+        etl::fast_matrix<float, 6, 4, 13, 10> errors;
+    } context;
+
+    etl::fast_matrix<float, 6, 3, 9, 8> v;
+    etl::fast_matrix<float, 6, 4, 13, 10> h;
+    etl::fast_matrix<float, 6, 3, 9, 8> dv;
+
+    v              = etl::uniform_generator(-1.0, 1.0);
+    context.errors = etl::uniform_generator(-1.0, 1.0);
+
+    layer.forward_batch(h, v);
+    layer.backward_batch(dv, context);
+
+    REQUIRE(etl::max(etl::abs(h - etl::sigmoid(etl::bias_add_4d(etl::conv_4d_full_flipped(v, layer.w), layer.b)))) < 1e-4);
+    REQUIRE(etl::max(etl::abs(dv - etl::conv_4d_valid_flipped(context.errors, layer.w))) < 1e-4);
+
+    // The cached filters must follow the new weights
+    layer.w = etl::uniform_generator(-1.0, 1.0);
+    layer.weights_changed();
+
+    layer.forward_batch(h, v);
+
+    REQUIRE(etl::max(etl::abs(h - etl::sigmoid(etl::bias_add_4d(etl::conv_4d_full_flipped(v, layer.w), layer.b)))) < 1e-4);
+}
+
+// The upsample kernels: forward against ETL and backward as the adjoint of the forward
+TEST_CASE("unit/upsample/1", "[unit][upsample]") {
+    using nearest_t  = dll::upsample_3d_layer_desc<2, 4, 5, 1, 2, 3>::layer_t;
+    using bilinear_t = dll::upsample_3d_layer_desc<2, 4, 5, 1, 2, 3, dll::upsample<dll::upsample_type::BILINEAR>>::layer_t;
+    using dyn_t      = dll::dyn_upsample_3d_layer_desc<dll::upsample<dll::upsample_type::BILINEAR>>::layer_t;
+
+    struct context_t {
+        etl::fast_dyn_matrix<float, 3, 2, 4, 5> input;
+        etl::fast_dyn_matrix<float, 3, 2, 8, 15> output;
+        etl::fast_dyn_matrix<float, 3, 2, 8, 15> errors;
+    };
+
+    nearest_t nearest;
+    bilinear_t bilinear;
+    dyn_t dyn_bilinear;
+
+    bilinear_t::dyn_init(dyn_bilinear);
+
+    context_t context;
+
+    context.input  = etl::uniform_generator(-1.0, 1.0);
+    context.errors = etl::uniform_generator(-1.0, 1.0);
+
+    etl::fast_dyn_matrix<float, 3, 2, 8, 15> expected;
+    etl::fast_dyn_matrix<float, 3, 2, 4, 5> back;
+
+    // Nearest
+
+    nearest.forward_batch(context.output, context.input);
+
+    expected = etl::upsample_3d<1, 2, 3>(context.input);
+    REQUIRE(etl::approx_equals(context.output, expected, 1e-6));
+
+    nearest.backward_batch(back, context);
+    REQUIRE(etl::sum(back) == Approx(etl::sum(context.errors)).epsilon(1e-4));
+    REQUIRE(etl::sum(context.output >> context.errors) == Approx(etl::sum(context.input >> back)).epsilon(1e-4));
+
+    // Bilinear
+
+    bilinear.forward_batch(context.output, context.input);
+
+    REQUIRE(context.output(0, 0, 0, 0) == Approx(context.input(0, 0, 0, 0)));
+    REQUIRE(context.output(1, 1, 7, 14) == Approx(context.input(1, 1, 3, 4)));
+    REQUIRE(context.output(2, 1, 1, 1) == Approx(0.75f * context.input(2, 1, 0, 0) + 0.25f * context.input(2, 1, 1, 0)));
+
+    dyn_bilinear.forward_batch(expected, context.input);
+    REQUIRE(etl::approx_equals(context.output, expected, 1e-6));
+
+    bilinear.backward_batch(back, context);
+    REQUIRE(etl::sum(back) == Approx(etl::sum(context.errors)).epsilon(1e-4));
+    REQUIRE(etl::sum(context.output >> context.errors) == Approx(etl::sum(context.input >> back)).epsilon(1e-4));
+}
@@ -67,6 +67,9 @@ TEST_CASE("unit/cdbn/mnist/2", "[cdbn][svm][unit]") {
     auto gs_result = dbn->svm_grid_search(dataset.training_images, dataset.training_labels, 3, g);
     REQUIRE(gs_result);
 
+    // The problem built by the grid search is searched again
+    REQUIRE(dbn->svm_grid_search_problem(3, g));
+
     auto test_error = dll::test_set(dbn, dataset.training_images, dataset.training_labels, dll::svm_predictor());
     std::cout << "test_error:" << test_error << std::endl;
     REQUIRE(test_error < 0.1);
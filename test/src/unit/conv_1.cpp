@@ -162,3 +162,227 @@ TEST_CASE("unit/conv/sgd/partial/1", "[conv][dbn][mnist][sgd]") {
 
     TEST_CHECK(0.25);
 }
+
+TEST_CASE("unit/conv/winograd/1", "[conv][winograd][unit]") {
+    using layer_t = dll::conv_layer_desc<3, 11, 10, 5, 3, 3, dll::activation<dll::function::IDENTITY>>::layer_t;
+
+    static_assert(layer_t::winograd, "3x3 conv_layer must use the Winograd convolution");
+
+    layer_t layer;
+
+    struct {
+        etl::fast_matrix<float, 8, 5, 9, 8> errors;
+    } context;
+
+    etl::fast_matrix<float, 8, 3, 11, 10> v;
+    etl::fast_matrix<float, 8, 5, 9, 8> h;
+    etl::fast_matrix<float, 8, 3, 11, 10> dv;
+
+    v              = etl::uniform_generator(-1.0, 1.0);
+    context.errors = etl::uniform_generator(-1.0, 1.0);
+
+    layer.forward_batch(h, v);
+    layer.backward_batch(dv, context);
+
+    REQUIRE(etl::max(etl::abs(h - etl::bias_add_4d(etl::ml::convolution_forward(v, layer.w), layer.b))) < 1e-4);
+    REQUIRE(etl::max(etl::abs(dv - etl::ml::convolution_backward(context.errors, layer.w))) < 1e-4);
+}
+
+TEST_CASE("unit/conv/epilogue/1", "[conv][unit]") {
+    using relu_t    = dll::conv_layer_desc<2, 12, 12, 4, 5, 5, dll::activation<dll::function::RELU>>::layer_t;
+    using sigmoid_t = dll::conv_layer_desc<2, 12, 12, 4, 3, 3, dll::activation<dll::function::SIGMOID>>::layer_t;
+
+    relu_t relu;
+    sigmoid_t sigmoid;
+
+    etl::fast_matrix<float, 6, 2, 12, 12> v;
+    etl::fast_matrix<float, 6, 4, 8, 8> h_relu;
+    etl::fast_matrix<float, 6, 4, 10, 10> h_sigmoid;
+
+    v         = etl::uniform_generator(-1.0, 1.0);
+    relu.b    = etl::uniform_generator(-1.0, 1.0);
+    sigmoid.b = etl::uniform_generator(-1.0, 1.0);
+
+    relu.forward_batch(h_relu, v);
+    sigmoid.forward_batch(h_sigmoid, v);
+
+    REQUIRE(etl::max(etl::abs(h_relu - etl::relu(etl::bias_add_4d(etl::ml::convolution_forward(v, relu.w), relu.b)))) < 1e-4);
+    REQUIRE(etl::max(etl::abs(h_sigmoid - etl::sigmoid(etl::bias_add_4d(etl::ml::convolution_forward(v, sigmoid.w), sigmoid.b)))) < 1e-4);
+}
+
+TEST_CASE("unit/conv/stride/1", "[conv][unit]") {
+    using strided_t = dll::conv_layer_desc<2, 12, 11, 4, 5, 5, dll::stride<2>, dll::padding<1>, dll::activation<dll::function::RELU>>::layer_t;
+    using padded_t  = dll::conv_layer_desc<2, 12, 11, 4, 5, 5, dll::padding<1>, dll::activation<dll::function::RELU>>::layer_t;
+
+    static_assert(strided_t::NH1 == 5 && strided_t::NH2 == 5, "Invalid output of the strided convolution");
+    static_assert(padded_t::NH1 == 10 && padded_t::NH2 == 9, "Invalid output of the padded convolution");
+
+    strided_t strided;
+    padded_t padded;
+
+    padded.w = strided.w;
+    padded.b = etl::uniform_generator(-1.0, 1.0);
+    strided.b = padded.b;
+
+    etl::fast_matrix<float, 4, 2, 12, 11> v;
+    etl::fast_matrix<float, 4, 4, 5, 5> h;
+    etl::fast_matrix<float, 4, 4, 10, 9> h_full;
+
+    v = etl::uniform_generator(-1.0, 1.0);
+
+    strided.forward_batch(h, v);
+    padded.forward_batch(h_full, v);
+
+    // The strided convolution is the subsampled padded convolution
+    for (size_t b = 0; b < 4; ++b) {
+        for (size_t k = 0; k < 4; ++k) {
+            for (size_t i = 0; i < 5; ++i) {
+                for (size_t j = 0; j < 5; ++j) {
+                    REQUIRE(std::abs(h(b, k, i, j) - h_full(b, k, 2 * i, 2 * j)) < 1e-4);
+                }
+            }
+        }
+    }
+}
+
+TEST_CASE("unit/conv/stride/2", "[unit][conv][dbn][mnist][sgd]") {
+    typedef dll::dbn_desc<
+        dll::dbn_layers<
+            dll::conv_layer_desc<1, 28, 28, 8, 5, 5, dll::stride<2>, dll::padding<2>, dll::activation<dll::function::RELU>>::layer_t,
+            dll::dense_layer_desc<8 * 14 * 14, 10, dll::activation<dll::function::SOFTMAX>>::layer_t>,
+        dll::trainer<dll::sgd_trainer>, dll::updater<dll::updater_type::MOMENTUM>, dll::batch_size<10>>::dbn_t dbn_t;
+
+    auto dataset = dll::make_mnist_dataset_sub(0, 500, dll::batch_size<10>{}, dll::scale_pre<255>{});
+
+    auto dbn = std::make_unique<dbn_t>();
+
+    dbn->learning_rate = 0.05;
+
+    FT_CHECK_DATASET(25, 5e-2);
+    TEST_CHECK_DATASET(0.25);
+}
+
+TEST_CASE("unit/conv/winograd/2", "[conv][winograd][unit]") {
+    using layer_t = dll::conv_layer_desc<3, 11, 10, 5, 3, 3, dll::padding<1>, dll::activation<dll::function::IDENTITY>>::layer_t;
+
+    static_assert(layer_t::winograd, "Padded 3x3 conv_layer must use the Winograd convolution");
+
+    layer_t layer;
+
+    struct {
+        etl::fast_matrix<float, 8, 5, 11, 10> errors;
+    } context;
+
+    etl::fast_matrix<float, 8, 3, 11, 10> v;
+    etl::fast_matrix<float, 8, 5, 11, 10> h;
+    etl::fast_matrix<float, 8, 3, 11, 10> dv;
+
+    v              = etl::uniform_generator(-1.0, 1.0);
+    context.errors = etl::uniform_generator(-1.0, 1.0);
+
+    layer.forward_batch(h, v);
+    layer.backward_batch(dv, context);
+
+    REQUIRE(etl::max(etl::abs(h - etl::bias_add_4d(etl::ml::convolution_forward<1, 1, 1, 1>(v, layer.w), layer.b))) < 1e-4);
+    REQUIRE(etl::max(etl::abs(dv - etl::ml::convolution_backward<1, 1, 1, 1>(context.errors, layer.w))) < 1e-4);
+}
+
+TEST_CASE("unit/conv/int8/1", "[conv][unit]") {
+    using layer_t = dll::conv_layer_desc<2, 12, 11, 4, 5, 5, dll::stride<2>, dll::padding<1>, dll::activation<dll::function::RELU>>::layer_t;
+
+    layer_t layer;
+
+    layer.b = etl::uniform_generator(-1.0, 1.0);
+
+    etl::fast_matrix<float, 4, 2, 12, 11> v;
+    etl::fast_matrix<float, 4, 4, 5, 5> h;
+    etl::fast_matrix<float, 4, 4, 5, 5> h_int8;
+
+    v = etl::uniform_generator(-1.0, 1.0);
+
+    layer.test_forward_batch(h, v);
+
+    layer.quantize(etl::max(etl::abs(v)));
+    layer.test_forward_batch(h_int8, v);
+
+    REQUIRE(etl::max(etl::abs(h_int8 - h)) < 0.05 * etl::max(etl::abs(h)));
+
+    // Modifying the weights drops the quantized filters
+    layer.weights_changed();
+    layer.test_forward_batch(h_int8, v);
+
+    REQUIRE(etl::max(etl::abs(h_int8 - h)) < 1e-5);
+}
+
+TEST_CASE("unit/conv/autotune/1", "[conv][winograd][unit]") {
+    typedef dll::dbn_desc<
+        dll::dbn_layers<
+            dll::conv_layer_desc<1, 14, 14, 4, 3, 3, dll::padding<1>, dll::activation<dll::function::RELU>>::layer_t,
+            dll::conv_layer_desc<4, 14, 14, 4, 5, 5, dll::activation<dll::function::RELU>>::layer_t,
+            dll::dense_layer_desc<4 * 10 * 10, 10, dll::activation<dll::function::SOFTMAX>>::layer_t>,
+        dll::trainer<dll::sgd_trainer>, dll::batch_size<8>>::dbn_t dbn_t;
+
+    auto dbn = std::make_unique<dbn_t>();
+
+    auto& layer = dbn->template layer_get<0>();
+
+    REQUIRE(layer.conv_impls().size() == 2);
+    REQUIRE(dbn->template layer_get<1>().conv_impls().size() == 1);
+
+    // Both implementations compute the same convolutions
+    struct {
+        etl::fast_matrix<float, 8, 4, 14, 14> errors;
+    } context;
+
+    etl::fast_matrix<float, 8, 1, 14, 14> v;
+    etl::fast_matrix<float, 8, 4, 14, 14> h_winograd;
+    etl::fast_matrix<float, 8, 4, 14, 14> h_etl;
+    etl::fast_matrix<float, 8, 1, 14, 14> dv_winograd;
+    etl::fast_matrix<float, 8, 1, 14, 14> dv_etl;
+
+    v              = etl::uniform_generator(-1.0, 1.0);
+    context.errors = etl::uniform_generator(-1.0, 1.0);
+
+    layer.tuning.forward  = dll::conv_impl::WINOGRAD;
+    layer.tuning.backward = dll::conv_impl::WINOGRAD;
+    layer.forward_batch(h_winograd, v);
+    layer.backward_batch(dv_winograd, context);
+
+    layer.tuning.forward  = dll::conv_impl::ETL;
+    layer.tuning.backward = dll::conv_impl::ETL;
+    layer.forward_batch(h_etl, v);
+    layer.backward_batch(dv_etl, context);
+
+    REQUIRE(etl::max(etl::abs(h_winograd - h_etl)) < 1e-4);
+    REQUIRE(etl::max(etl::abs(dv_winograd - dv_etl)) < 1e-4);
+
+    // The tuning is stored in the cache file and reused
+    const std::string file = "unit_conv_autotune.cache";
+    std::remove(file.c_str());
+
+    auto cache = dbn->autotune(file);
+
+    REQUIRE(cache.entries.size() == 2);
+    REQUIRE(layer.tuning.forward != dll::conv_impl::AUTO);
+    REQUIRE(layer.tuning.backward != dll::conv_impl::AUTO);
+    REQUIRE(layer.tuning.gradients == dll::conv_impl::ETL);
+    REQUIRE(dbn->template layer_get<1>().tuning.forward == dll::conv_impl::ETL);
+
+    auto key = layer.tuning_key() + ":b8";
+    REQUIRE(cache.contains(key));
+
+    // A cached shape is not timed again
+    cache.entries[key].forward = dll::conv_impl::ETL;
+    cache.save(file);
+
+    dbn->autotune(file);
+
+    REQUIRE(layer.tuning.forward == dll::conv_impl::ETL);
+
+    dll::conv_tuning_cache loaded;
+    REQUIRE(loaded.load(file));
+    REQUIRE(loaded.entries.size() == 2);
+    REQUIRE(loaded.entries[key].forward == dll::conv_impl::ETL);
+
+    std::remove(file.c_str());
+}
@@ -14,6 +14,7 @@
 #include "dll/dbn.hpp"
 #include "dll/pooling/mp_layer.hpp"
 #include "dll/pooling/avgp_layer.hpp"
+#include "dll/pooling/global_avgp_layer.hpp"
 
 #include "mnist/mnist_reader.hpp"
 #include "mnist/mnist_utils.hpp"
@@ -92,3 +93,267 @@ TEST_CASE("unit/conv/sgd/8", "[unit][conv][dbn][mnist][sgd]") {
     FT_CHECK(25, 6e-2);
     TEST_CHECK(0.25);
 }
+
+// The max pooling indices against the standard max pooling
+TEST_CASE("unit/mp/indices/1", "[unit][mp]") {
+    using layer_2d_t = dll::mp_2d_layer_desc<3, 8, 8, 2, 2, dll::max_pool_indices>::layer_t;
+    using layer_3d_t = dll::mp_3d_layer_desc<4, 6, 6, 2, 3, 2, dll::max_pool_indices>::layer_t;
+
+    struct context_2d_t {
+        etl::fast_dyn_matrix<float, 5, 3, 8, 8> input;
+        etl::fast_dyn_matrix<float, 5, 3, 4, 4> output;
+        etl::fast_dyn_matrix<float, 5, 3, 4, 4> errors;
+        std::vector<uint8_t> indices;
+    };
+
+    struct context_3d_t {
+        etl::fast_dyn_matrix<float, 5, 4, 6, 6> input;
+        etl::fast_dyn_matrix<float, 5, 2, 2, 3> output;
+        etl::fast_dyn_matrix<float, 5, 2, 2, 3> errors;
+        std::vector<uint8_t> indices;
+    };
+
+    layer_2d_t layer_2d;
+    layer_3d_t layer_3d;
+
+    context_2d_t context_2d;
+    context_3d_t context_3d;
+
+    context_2d.input  = etl::uniform_generator(-1.0, 1.0);
+    context_2d.errors = etl::uniform_generator(-1.0, 1.0);
+    context_3d.input  = etl::uniform_generator(-1.0, 1.0);
+    context_3d.errors = etl::uniform_generator(-1.0, 1.0);
+
+    layer_2d.train_forward_batch(context_2d.output, context_2d.input, context_2d);
+    layer_3d.train_forward_batch(context_3d.output, context_3d.input, context_3d);
+
+    REQUIRE(context_2d.indices.size() == etl::size(context_2d.output));
+    REQUIRE(context_3d.indices.size() == etl::size(context_3d.output));
+
+    etl::fast_dyn_matrix<float, 5, 3, 4, 4> expected_2d;
+    etl::fast_dyn_matrix<float, 5, 2, 2, 3> expected_3d;
+
+    expected_2d = etl::ml::max_pool_forward<2, 2>(context_2d.input);
+    expected_3d = etl::ml::max_pool_3d_forward<2, 3, 2>(context_3d.input);
+
+    REQUIRE(etl::approx_equals(context_2d.output, expected_2d, 1e-6));
+    REQUIRE(etl::approx_equals(context_3d.output, expected_3d, 1e-6));
+
+    etl::fast_dyn_matrix<float, 5, 3, 8, 8> back_2d;
+    etl::fast_dyn_matrix<float, 5, 3, 8, 8> back_expected_2d;
+    etl::fast_dyn_matrix<float, 5, 4, 6, 6> back_3d;
+    etl::fast_dyn_matrix<float, 5, 4, 6, 6> back_expected_3d;
+
+    layer_2d.backward_batch(back_2d, context_2d);
+    layer_3d.backward_batch(back_3d, context_3d);
+
+    back_expected_2d = etl::ml::max_pool_backward<2, 2>(context_2d.input, context_2d.output, context_2d.errors);
+    back_expected_3d = etl::ml::max_pool_3d_backward<2, 3, 2>(context_3d.input, context_3d.output, context_3d.errors);
+
+    REQUIRE(etl::approx_equals(back_2d, back_expected_2d, 1e-6));
+    REQUIRE(etl::approx_equals(back_3d, back_expected_3d, 1e-6));
+}
+
+// Training with the max pooling indices
+TEST_CASE("unit/mp/indices/2", "[unit][conv][dbn][mnist][sgd]") {
+    typedef dll::dbn_desc<
+        dll::dbn_layers<
+            dll::conv_layer_desc<1, 28, 28, 6, 5, 5, dll::activation<dll::function::RELU>>::layer_t,
+            dll::mp_2d_layer_desc<6, 24, 24, 2, 2, dll::max_pool_indices>::layer_t,
+            dll::conv_layer_desc<6, 12, 12, 5, 3, 3, dll::activation<dll::function::RELU>>::layer_t,
+            dll::dense_layer_desc<5 * 10 * 10, 100, dll::activation<dll::function::RELU>>::layer_t,
+            dll::dense_layer_desc<100, 10, dll::activation<dll::function::SOFTMAX>>::layer_t>,
+        dll::updater<dll::updater_type::MOMENTUM>, dll::trainer<dll::sgd_trainer>, dll::batch_size<20>>::dbn_t dbn_t;
+
+    auto dataset = mnist::read_dataset_direct<std::vector, etl::fast_dyn_matrix<float, 1, 28, 28>>(2000);
+    REQUIRE(!dataset.training_images.empty());
+
+    dll_test::mnist_scale(dataset);
+
+    auto dbn = std::make_unique<dbn_t>();
+
+    dbn->learning_rate = 0.005;
+
+    FT_CHECK(50, 6e-2);
+    TEST_CHECK(0.25);
+}
+
+// The overlapping and padded pooling against a direct computation
+TEST_CASE("unit/pooling/strided/1", "[unit][mp][avgp]") {
+    using mp_t      = dll::mp_2d_layer_desc<2, 7, 7, 3, 3, dll::stride<2>, dll::padding<1>>::layer_t;
+    using mp_ind_t  = dll::mp_2d_layer_desc<2, 7, 7, 3, 3, dll::stride<2>, dll::padding<1>, dll::max_pool_indices>::layer_t;
+    using avgp_t    = dll::avgp_2d_layer_desc<2, 7, 7, 3, 3, dll::stride<2>, dll::padding<1>>::layer_t;
+    using dyn_mp_t  = dll::dyn_mp_2d_layer_desc<>::layer_t;
+
+    static_assert(mp_t::O2 == 4 && mp_t::O3 == 4, "Invalid output of the strided pooling");
+
+    struct context_t {
+        etl::fast_dyn_matrix<float, 3, 2, 7, 7> input;
+        etl::fast_dyn_matrix<float, 3, 2, 4, 4> output;
+        etl::fast_dyn_matrix<float, 3, 2, 4, 4> errors;
+        std::vector<uint8_t> indices;
+    };
+
+    mp_t mp;
+    mp_ind_t mp_ind;
+    avgp_t avgp;
+    dyn_mp_t dyn_mp;
+
+    dyn_mp.init_layer(2, 7, 7, 3, 3, 2, 2, 1, 1);
+
+    REQUIRE(dyn_mp.output_size() == mp_t::output_size());
+
+    context_t context;
+
+    context.input  = etl::uniform_generator(-1.0, 1.0);
+    context.errors = etl::uniform_generator(-1.0, 1.0);
+
+    etl::fast_dyn_matrix<float, 3, 2, 4, 4> max_expected;
+    etl::fast_dyn_matrix<float, 3, 2, 4, 4> avg_expected;
+    etl::fast_dyn_matrix<float, 3, 2, 7, 7> max_back_expected;
+    etl::fast_dyn_matrix<float, 3, 2, 7, 7> avg_back_expected;
+
+    max_back_expected = 0;
+    avg_back_expected = 0;
+
+    for (size_t b = 0; b < 3; ++b) {
+        for (size_t c = 0; c < 2; ++c) {
+            for (size_t j = 0; j < 4; ++j) {
+                for (size_t k = 0; k < 4; ++k) {
+                    float max  = -1e9;
+                    float sum  = 0.0;
+                    size_t max_y = 0;
+                    size_t max_x = 0;
+
+                    for (long y = long(j * 2) - 1; y < long(j * 2) + 2; ++y) {
+                        for (long x = long(k * 2) - 1; x < long(k * 2) + 2; ++x) {
+                            if (y >= 0 && y < 7 && x >= 0 && x < 7) {
+                                if (context.input(b, c, y, x) > max) {
+                                    max   = context.input(b, c, y, x);
+                                    max_y = y;
+                                    max_x = x;
+                                }
+
+                                sum += context.input(b, c, y, x);
+                            }
+                        }
+                    }
+
+                    for (long y = long(j * 2) - 1; y < long(j * 2) + 2; ++y) {
+                        for (long x = long(k * 2) - 1; x < long(k * 2) + 2; ++x) {
+                            if (y >= 0 && y < 7 && x >= 0 && x < 7) {
+                                avg_back_expected(b, c, y, x) += context.errors(b, c, j, k) / 9.0f;
+                            }
+                        }
+                    }
+
+                    max_expected(b, c, j, k) = max;
+                    avg_expected(b, c, j, k) = sum / 9.0f;
+
+                    max_back_expected(b, c, max_y, max_x) += context.errors(b, c, j, k);
+                }
+            }
+        }
+    }
+
+    etl::fast_dyn_matrix<float, 3, 2, 7, 7> back;
+
+    // Max pooling
+
+    mp.forward_batch(context.output, context.input);
+    REQUIRE(etl::approx_equals(context.output, max_expected, 1e-6));
+
+    mp.backward_batch(back, context);
+    REQUIRE(etl::approx_equals(back, max_back_expected, 1e-5));
+
+    // Max pooling with indices
+
+    mp_ind.train_forward_batch(context.output, context.input, context);
+    REQUIRE(etl::approx_equals(context.output, max_expected, 1e-6));
+
+    mp_ind.backward_batch(back, context);
+    REQUIRE(etl::approx_equals(back, max_back_expected, 1e-5));
+
+    // Dynamic max pooling
+
+    dyn_mp.forward_batch(context.output, context.input);
+    REQUIRE(etl::approx_equals(context.output, max_expected, 1e-6));
+
+    // Average pooling
+
+    avgp.forward_batch(context.output, context.input);
+    REQUIRE(etl::approx_equals(context.output, avg_expected, 1e-5));
+
+    avgp.backward_batch(back, context);
+    REQUIRE(etl::approx_equals(back, avg_back_expected, 1e-5));
+}
+
+// Training with overlapping max pooling and global average pooling
+TEST_CASE("unit/pooling/strided/2", "[unit][conv][dbn][mnist][sgd]") {
+    typedef dll::dbn_desc<
+        dll::dbn_layers<
+            dll::conv_layer_desc<1, 28, 28, 8, 5, 5, dll::activation<dll::function::RELU>>::layer_t,
+            dll::mp_2d_layer_desc<8, 24, 24, 3, 3, dll::stride<2>, dll::padding<1>>::layer_t,
+            dll::conv_layer_desc<8, 12, 12, 10, 3, 3, dll::activation<dll::function::RELU>>::layer_t,
+            dll::global_avgp_layer_desc<10, 10, 10>::layer_t,
+            dll::dense_layer_desc<10, 10, dll::activation<dll::function::SOFTMAX>>::layer_t>,
+        dll::updater<dll::updater_type::MOMENTUM>, dll::trainer<dll::sgd_trainer>, dll::batch_size<20>>::dbn_t dbn_t;
+
+    auto dataset = mnist::read_dataset_direct<std::vector, etl::fast_dyn_matrix<float, 1, 28, 28>>(2000);
+    REQUIRE(!dataset.training_images.empty());
+
+    dll_test::mnist_scale(dataset);
+
+    auto dbn = std::make_unique<dbn_t>();
+
+    dbn->learning_rate = 0.01;
+
+    FT_CHECK(50, 2e-1);
+    TEST_CHECK(0.4);
+}
+
+// The global average pooling against the mean of each channel
+TEST_CASE("unit/pooling/global/1", "[unit][avgp]") {
+    using layer_t     = dll::global_avgp_layer_desc<3, 5, 4>::layer_t;
+    using dyn_layer_t = dll::dyn_global_avgp_layer_desc<>::layer_t;
+
+    struct context_t {
+        etl::fast_dyn_matrix<float, 2, 3, 5, 4> input;
+        etl::fast_dyn_matrix<float, 2, 3> output;
+        etl::fast_dyn_matrix<float, 2, 3> errors;
+    };
+
+    layer_t layer;
+    dyn_layer_t dyn_layer;
+
+    layer_t::dyn_init(dyn_layer);
+
+    REQUIRE(dyn_layer.output_size() == 3);
+
+    context_t context;
+
+    context.input  = etl::uniform_generator(-1.0, 1.0);
+    context.errors = etl::uniform_generator(-1.0, 1.0);
+
+    layer.forward_batch(context.output, context.input);
+
+    for (size_t b = 0; b < 2; ++b) {
+        for (size_t c = 0; c < 3; ++c) {
+            REQUIRE(context.output(b, c) == Approx(etl::mean(context.input(b)(c))));
+        }
+    }
+
+    etl::fast_dyn_matrix<float, 2, 3> dyn_output;
+    dyn_layer.forward_batch(dyn_output, context.input);
+    REQUIRE(etl::approx_equals(dyn_output, context.output, 1e-6));
+
+    etl::fast_dyn_matrix<float, 2, 3, 5, 4> back;
+    layer.backward_batch(back, context);
+
+    for (size_t b = 0; b < 2; ++b) {
+        for (size_t c = 0; c < 3; ++c) {
+            REQUIRE(back(b, c, 4, 3) == Approx(context.errors(b, c) / 20.0f));
+            REQUIRE(etl::sum(back(b)(c)) == Approx(context.errors(b, c)));
+        }
+    }
+}
@@ -10,11 +10,16 @@
 #include "dll_test.hpp"
 
 #include "dll/neural/conv_layer.hpp"
+#include "dll/neural/depthwise_conv_layer.hpp"
+#include "dll/neural/dyn_conv_layer.hpp"
+#include "dll/neural/dyn_conv_same_layer.hpp"
+#include "dll/neural/dyn_dense_layer.hpp"
 #include "dll/neural/dense_layer.hpp"
 #include "dll/neural/activation_layer.hpp"
 #include "dll/dbn.hpp"
 #include "dll/pooling/mp_layer.hpp"
 #include "dll/pooling/avgp_layer.hpp"
+#include "dll/pooling/dyn_mp_layer.hpp"
 
 #include "mnist/mnist_reader.hpp"
 #include "mnist/mnist_utils.hpp"
@@ -70,3 +75,278 @@ TEST_CASE("unit/conv/sgd/10", "[unit][conv][dbn][mnist][sgd]") {
     FT_CHECK(25, 6e-2);
     TEST_CHECK(0.22);
 }
+
+// A grouped convolution is the concatenation of the convolutions of its groups
+TEST_CASE("unit/conv/grouped/1", "[unit][conv]") {
+    using grouped_t = dll::conv_layer_desc<4, 8, 8, 6, 3, 3, dll::groups<2>, dll::padding<1, 1>, dll::activation<dll::function::IDENTITY>>::layer_t;
+    using group_t   = dll::conv_layer_desc<2, 8, 8, 3, 3, 3, dll::padding<1, 1>, dll::activation<dll::function::IDENTITY>>::layer_t;
+
+    grouped_t grouped;
+    group_t group_0;
+    group_t group_1;
+
+    grouped.b = etl::uniform_generator(-1.0, 1.0);
+
+    group_0.w = etl::slice(grouped.w, 0, 3);
+    group_1.w = etl::slice(grouped.w, 3, 6);
+    group_0.b = etl::slice(grouped.b, 0, 3);
+    group_1.b = etl::slice(grouped.b, 3, 6);
+
+    group_0.weights_changed();
+    group_1.weights_changed();
+
+    etl::fast_dyn_matrix<float, 5, 4, 8, 8> input;
+    input = etl::uniform_generator(-1.0, 1.0);
+
+    etl::fast_dyn_matrix<float, 5, 6, 8, 8> output;
+    etl::fast_dyn_matrix<float, 5, 3, 8, 8> output_0;
+    etl::fast_dyn_matrix<float, 5, 3, 8, 8> output_1;
+
+    etl::fast_dyn_matrix<float, 5, 2, 8, 8> input_0;
+    etl::fast_dyn_matrix<float, 5, 2, 8, 8> input_1;
+
+    for (size_t b = 0; b < 5; ++b) {
+        input_0(b) = etl::slice(input(b), 0, 2);
+        input_1(b) = etl::slice(input(b), 2, 4);
+    }
+
+    grouped.forward_batch(output, input);
+    group_0.forward_batch(output_0, input_0);
+    group_1.forward_batch(output_1, input_1);
+
+    for (size_t b = 0; b < 5; ++b) {
+        REQUIRE(etl::max(etl::abs(etl::slice(output(b), 0, 3) - output_0(b))) < 1e-4);
+        REQUIRE(etl::max(etl::abs(etl::slice(output(b), 3, 6) - output_1(b))) < 1e-4);
+    }
+}
+
+// A dilated convolution is a convolution with an expanded, sparse, filter
+TEST_CASE("unit/conv/dilated/1", "[unit][conv]") {
+    using dilated_t  = dll::conv_layer_desc<2, 8, 8, 3, 3, 3, dll::dilation<2, 2>, dll::padding<2, 2>, dll::activation<dll::function::IDENTITY>>::layer_t;
+    using expanded_t = dll::conv_layer_desc<2, 8, 8, 3, 5, 5, dll::padding<2, 2>, dll::activation<dll::function::IDENTITY>>::layer_t;
+    using same_t     = dll::dyn_conv_same_desc<dll::dilation<2, 2>, dll::activation<dll::function::IDENTITY>>::layer_t;
+
+    dilated_t dilated;
+    expanded_t expanded;
+    same_t same;
+
+    same.init_layer(2, 8, 8, 3, 3, 3);
+
+    dilated.b = etl::uniform_generator(-1.0, 1.0);
+
+    expanded.w = 0;
+    expanded.b = dilated.b;
+    same.w     = dilated.w;
+    same.b     = dilated.b;
+
+    for (size_t k = 0; k < 3; ++k) {
+        for (size_t c = 0; c < 2; ++c) {
+            for (size_t i = 0; i < 3; ++i) {
+                for (size_t j = 0; j < 3; ++j) {
+                    expanded.w(k, c, 2 * i, 2 * j) = dilated.w(k, c, i, j);
+                }
+            }
+        }
+    }
+
+    expanded.weights_changed();
+
+    etl::fast_dyn_matrix<float, 5, 2, 8, 8> input;
+    input = etl::uniform_generator(-1.0, 1.0);
+
+    etl::fast_dyn_matrix<float, 5, 3, 8, 8> output;
+    etl::fast_dyn_matrix<float, 5, 3, 8, 8> ref_output;
+    etl::dyn_matrix<float, 4> same_output(5, 3, 8, 8);
+
+    dilated.forward_batch(output, input);
+    expanded.forward_batch(ref_output, input);
+    same.forward_batch(same_output, input);
+
+    REQUIRE(etl::max(etl::abs(output - ref_output)) < 1e-4);
+    REQUIRE(etl::max(etl::abs(same_output - ref_output)) < 1e-4);
+
+    // The errors of the inputs and the gradients of the filters
+
+    etl::fast_dyn_matrix<float, 5, 3, 8, 8> errors;
+    errors = etl::uniform_generator(-1.0, 1.0);
+
+    etl::fast_dyn_matrix<float, 5, 2, 8, 8> input_errors;
+    etl::fast_dyn_matrix<float, 5, 2, 8, 8> ref_input_errors;
+
+    dll::grouped_conv<float>::backward(errors, dilated.w, input_errors, dilated_t::shape());
+    ref_input_errors = etl::ml::convolution_backward<1, 1, 2, 2>(errors, expanded.w);
+
+    REQUIRE(etl::max(etl::abs(input_errors - ref_input_errors)) < 1e-4);
+
+    etl::fast_dyn_matrix<float, 3, 2, 3, 3> grad;
+    etl::fast_dyn_matrix<float, 3, 2, 5, 5> ref_grad;
+
+    dll::grouped_conv<float>::backward_filter(input, errors, grad, dilated_t::shape());
+    ref_grad = etl::ml::convolution_backward_filter<1, 1, 2, 2>(input, errors);
+
+    for (size_t k = 0; k < 3; ++k) {
+        for (size_t c = 0; c < 2; ++c) {
+            for (size_t i = 0; i < 3; ++i) {
+                for (size_t j = 0; j < 3; ++j) {
+                    REQUIRE(grad(k, c, i, j) == Approx(ref_grad(k, c, 2 * i, 2 * j)).epsilon(1e-3));
+                }
+            }
+        }
+    }
+}
+
+TEST_CASE("unit/conv/depthwise/1", "[unit][conv][dbn][mnist][sgd]") {
+    typedef dll::dbn_desc<
+        dll::dbn_layers<
+            dll::conv_layer_desc<1, 28, 28, 8, 3, 3, dll::activation<dll::function::RELU>>::layer_t,
+            dll::depthwise_conv_layer_desc<8, 26, 26, 3, 3, dll::stride<2, 2>, dll::activation<dll::function::RELU>>::layer_t,
+            dll::conv_layer_desc<8, 12, 12, 16, 1, 1, dll::activation<dll::function::RELU>>::layer_t,
+            dll::dense_layer_desc<16 * 12 * 12, 10, dll::activation<dll::function::SOFTMAX>>::layer_t>,
+        dll::updater<dll::updater_type::MOMENTUM>, dll::trainer<dll::sgd_trainer>, dll::batch_size<25>>::dbn_t dbn_t;
+
+    auto dataset = mnist::read_dataset_direct<std::vector, etl::fast_dyn_matrix<float, 1, 28, 28>>(500);
+    REQUIRE(!dataset.training_images.empty());
+
+    dll_test::mnist_scale(dataset);
+
+    auto dbn = std::make_unique<dbn_t>();
+
+    REQUIRE(etl::size(dbn->template layer_get<1>().w) == 8 * 3 * 3);
+
+    dbn->learning_rate = 0.05;
+
+    FT_CHECK(25, 6e-2);
+    TEST_CHECK(0.3);
+}
+
+TEST_CASE("unit/conv/pointwise/1", "[unit][conv]") {
+    using layer_t = dll::conv_layer_desc<4, 6, 6, 5, 1, 1, dll::activation<dll::function::IDENTITY>>::layer_t;
+
+    layer_t layer;
+
+    layer.b = etl::uniform_generator(-1.0, 1.0);
+
+    etl::fast_dyn_matrix<float, 3, 4, 6, 6> input;
+    input = etl::uniform_generator(-1.0, 1.0);
+
+    etl::fast_dyn_matrix<float, 3, 5, 6, 6> output;
+
+    layer.forward_batch(output, input);
+
+    for (size_t b = 0; b < 3; ++b) {
+        for (size_t k = 0; k < 5; ++k) {
+            for (size_t i = 0; i < 6; ++i) {
+                for (size_t j = 0; j < 6; ++j) {
+                    float expected = layer.b(k);
+
+                    for (size_t c = 0; c < 4; ++c) {
+                        expected += layer.w(k, c, 0, 0) * input(b, c, i, j);
+                    }
+
+                    REQUIRE(output(b, k, i, j) == Approx(expected).epsilon(1e-4));
+                }
+            }
+        }
+    }
+}
+
+// Pruning filters with null weights does not change the network
+TEST_CASE("unit/conv/prune_filters/1", "[unit][conv][dbn][mnist][sgd]") {
+    typedef dll::dbn_desc<
+        dll::dbn_layers<
+            dll::dyn_conv_layer_desc<dll::activation<dll::function::RELU>>::layer_t,
+            dll::dyn_mp_2d_layer_desc<>::layer_t,
+            dll::dyn_conv_layer_desc<dll::activation<dll::function::RELU>>::layer_t,
+            dll::dyn_dense_layer_desc<dll::activation<dll::function::SOFTMAX>>::layer_t>,
+        dll::updater<dll::updater_type::MOMENTUM>, dll::trainer<dll::sgd_trainer>, dll::batch_size<25>>::dbn_t dbn_t;
+
+    auto dataset = mnist::read_dataset_direct<std::vector, etl::fast_dyn_matrix<float, 1, 28, 28>>(500);
+    REQUIRE(!dataset.training_images.empty());
+
+    dll_test::mnist_scale(dataset);
+
+    auto dbn = std::make_unique<dbn_t>();
+
+    dbn->template layer_get<0>().init_layer(1, 28, 28, 8, 5, 5);
+    dbn->template layer_get<1>().init_layer(8, 24, 24, 2, 2);
+    dbn->template layer_get<2>().init_layer(8, 12, 12, 8, 5, 5);
+    dbn->template layer_get<3>().init_layer(8 * 8 * 8, 10);
+
+    dbn->learning_rate = 0.05;
+
+    FT_CHECK(10, 6e-2);
+
+    // Null the first half of the filters of the convolutional layers
+    for (size_t f = 0; f < 4; ++f) {
+        dbn->template layer_get<0>().w(f) = 0.0;
+        dbn->template layer_get<0>().b(f) = 0.0;
+        dbn->template layer_get<2>().w(f) = 0.0;
+        dbn->template layer_get<2>().b(f) = 0.0;
+    }
+
+    auto before = dbn->forward_one(dataset.test_images[0]);
+    auto error  = dbn->evaluate_error(dataset.test_images, dataset.test_labels);
+
+    REQUIRE(dbn->prune_filters(0.5) == 8);
+
+    REQUIRE(dbn->template layer_get<0>().k == 4);
+    REQUIRE(dbn->template layer_get<1>().i1 == 4);
+    REQUIRE(dbn->template layer_get<2>().nc == 4);
+    REQUIRE(dbn->template layer_get<2>().k == 4);
+    REQUIRE(dbn->template layer_get<3>().num_visible == 4 * 8 * 8);
+
+    auto after = dbn->forward_one(dataset.test_images[0]);
+
+    for (size_t i = 0; i < 10; ++i) {
+        REQUIRE(after[i] == Approx(before[i]).epsilon(1e-4));
+    }
+
+    REQUIRE(dbn->evaluate_error(dataset.test_images, dataset.test_labels) == Approx(error));
+
+    auto desc = dll::static_network_desc(*dbn);
+
+    REQUIRE(desc.find("dll::conv_layer_desc<1, 28, 28, 4, 5, 5") != std::string::npos);
+    REQUIRE(desc.find("dll::dense_layer_desc<256, 10") != std::string::npos);
+
+    // The pruned network can be trained again
+    FT_CHECK(5, 6e-2);
+}
+
+// The pooling layers pool the convolutions on the fly
+TEST_CASE("unit/conv/pool_fusion/1", "[unit][conv][dbn][mnist][sgd]") {
+    typedef dll::dbn_desc<
+        dll::dbn_layers<
+            dll::conv_layer_desc<1, 28, 28, 6, 5, 5, dll::relu>::layer_t,
+            dll::mp_2d_layer_desc<6, 24, 24, 2, 2>::layer_t,
+            dll::conv_layer_desc<6, 12, 12, 8, 5, 5, dll::relu>::layer_t,
+            dll::avgp_2d_layer_desc<8, 8, 8, 2, 2>::layer_t,
+            dll::dense_layer_desc<8 * 4 * 4, 10, dll::softmax>::layer_t>,
+        dll::updater<dll::updater_type::MOMENTUM>, dll::trainer<dll::sgd_trainer>, dll::batch_size<25>>::dbn_t dbn_t;
+
+    auto dataset = mnist::read_dataset_direct<std::vector, etl::fast_dyn_matrix<float, 1, 28, 28>>(500);
+    REQUIRE(!dataset.training_images.empty());
+
+    dll_test::mnist_scale(dataset);
+
+    auto dbn = std::make_unique<dbn_t>();
+
+    dbn->learning_rate = 0.05;
+
+    FT_CHECK(25, 6e-2);
+    TEST_CHECK(0.3);
+
+    // The fused forward is the forward of the layers one by one
+    etl::dyn_matrix<float, 4> batch(7, 1, 28, 28);
+
+    for (size_t i = 0; i < 7; ++i) {
+        batch(i) = dataset.test_images[i];
+    }
+
+    auto c1 = dbn->template layer_get<0>().test_forward_batch(batch);
+    auto p1 = dbn->template layer_get<1>().test_forward_batch(c1);
+    auto c2 = dbn->template layer_get<2>().test_forward_batch(p1);
+    auto p2 = dbn->template layer_get<3>().test_forward_batch(c2);
+
+    REQUIRE(etl::max(etl::abs(dbn->template forward_batch<1>(batch) - p1)) < 1e-5);
+    REQUIRE(etl::max(etl::abs(dbn->template forward_batch<3>(batch) - p2)) < 1e-5);
+}
@@ -58,3 +58,37 @@ TEST_CASE("unit/conv/same/2", "[conv][dbn][mnist][sgd]") {
     FT_CHECK(100, 5e-2);
     TEST_CHECK(0.2);
 }
+
+TEST_CASE("unit/conv/same/winograd/1", "[conv][winograd][unit]") {
+    using layer_t = dll::conv_same_desc<2, 9, 9, 4, 3, 3, dll::activation<dll::function::IDENTITY>>::layer_t;
+
+    static_assert(layer_t::winograd, "3x3 conv_same_layer must use the Winograd convolution");
+
+    layer_t layer;
+
+    struct {
+        etl::fast_matrix<float, 10, 4, 9, 9> errors;
+    } context;
+
+    etl::fast_matrix<float, 10, 2, 9, 9> v;
+    etl::fast_matrix<float, 10, 4, 9, 9> h;
+    etl::fast_matrix<float, 10, 2, 9, 9> dv;
+
+    v              = etl::uniform_generator(-1.0, 1.0);
+    context.errors = etl::uniform_generator(-1.0, 1.0);
+
+    layer.forward_batch(h, v);
+    layer.backward_batch(dv, context);
+
+    REQUIRE(etl::max(etl::abs(h - etl::bias_add_4d(etl::ml::convolution_forward<1, 1, 1, 1>(v, layer.w), layer.b))) < 1e-4);
+    REQUIRE(etl::max(etl::abs(dv - etl::ml::convolution_backward<1, 1, 1, 1>(context.errors, layer.w))) < 1e-4);
+
+    // The transformed filters must follow the weights
+
+    layer.w *= 2.0;
+    layer.weights_changed();
+
+    layer.forward_batch(h, v);
+
+    REQUIRE(etl::max(etl::abs(h - etl::bias_add_4d(etl::ml::convolution_forward<1, 1, 1, 1>(v, layer.w), layer.b))) < 1e-4);
+}
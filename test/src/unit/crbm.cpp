@@ -59,6 +59,68 @@ TEST_CASE("unit/crbm/mnist/2", "[crbm][parallel][unit]") {
     REQUIRE(error < 0.1);
 }
 
+TEST_CASE("unit/crbm/mnist/data_parallel/1", "[crbm][parallel][unit]") {
+    dll::conv_rbm_square_desc<
+        1, 28, 20, 17,
+        dll::batch_size<10>,
+        dll::data_parallel<2>,
+        dll::momentum>::layer_t rbm;
+
+    auto dataset = mnist::read_dataset_direct<std::vector, etl::fast_dyn_matrix<float, 1, 28, 28>>(100);
+    REQUIRE(!dataset.training_images.empty());
+
+    mnist::binarize_dataset(dataset);
+
+    auto error = rbm.train(dataset.training_images, 25);
+    REQUIRE(error < 5e-2);
+}
+
+TEST_CASE("unit/crbm/mnist/parallel_gradients/1", "[crbm][parallel][unit]") {
+    dll::conv_rbm_square_desc<
+        1, 28, 20, 17,
+        dll::batch_size<10>,
+        dll::parallel_gradients<4>,
+        dll::momentum>::layer_t rbm;
+
+    auto dataset = mnist::read_dataset_direct<std::vector, etl::fast_dyn_matrix<float, 1, 28, 28>>(100);
+    REQUIRE(!dataset.training_images.empty());
+
+    mnist::binarize_dataset(dataset);
+
+    auto error = rbm.train(dataset.training_images, 25);
+    REQUIRE(error < 5e-2);
+}
+
+TEST_CASE("unit/crbm/fft/1", "[crbm][fft][unit]") {
+    dll::conv_rbm_square_desc<
+        1, 28, 20, 17,
+        dll::batch_size<10>>::layer_t rbm;
+
+    REQUIRE(rbm.prefer_fft(1, 20, 28, 28, 17, 17));
+
+    etl::fast_matrix<float, 10, 1, 28, 28> v;
+    etl::fast_matrix<float, 10, 20, 12, 12> h_direct;
+    etl::fast_matrix<float, 10, 20, 12, 12> h_fft;
+    etl::fast_matrix<float, 10, 1, 28, 28> v_direct;
+    etl::fast_matrix<float, 10, 1, 28, 28> v_fft;
+
+    v = etl::uniform_generator(0.0, 1.0);
+
+    rbm.batch_activate_hidden<true, false>(h_direct, h_direct, v, v);
+    rbm.batch_activate_visible<true, false>(h_direct, h_direct, v_direct, v_direct);
+
+    rbm.prepare_filters(v);
+    REQUIRE(rbm.fft_filters);
+
+    rbm.batch_activate_hidden<true, false>(h_fft, h_fft, v, v);
+    rbm.batch_activate_visible<true, false>(h_direct, h_direct, v_fft, v_fft);
+
+    rbm.release_filters();
+
+    REQUIRE(etl::max(etl::abs(h_direct - h_fft)) < 1e-3);
+    REQUIRE(etl::max(etl::abs(v_direct - v_fft)) < 1e-3);
+}
+
 TEST_CASE("unit/crbm/mnist/4", "[crbm][unit]") {
     dll::conv_rbm_square_desc<
         1, 28, 20, 17,
@@ -160,3 +222,39 @@ TEST_CASE("unit/crbm/mnist/7", "[crbm][unit]") {
     auto error = rbm.train(dataset.training_images, 50);
     REQUIRE(error < 7e-2);
 }
+
+TEST_CASE("unit/crbm/mnist/batch_energy/1", "[crbm][energy][unit]") {
+    dll::conv_rbm_square_desc<
+        1, 28, 20, 17,
+        dll::batch_size<10>,
+        dll::momentum>::layer_t rbm;
+
+    auto dataset = mnist::read_dataset_direct<std::vector, etl::fast_dyn_matrix<float, 1, 28, 28>>(100);
+    REQUIRE(!dataset.training_images.empty());
+
+    mnist::binarize_dataset(dataset);
+
+    rbm.train(dataset.training_images, 5);
+
+    etl::fast_dyn_matrix<float, 10, 1, 28, 28> v;
+    etl::fast_dyn_matrix<float, 10, 20, 12, 12> h;
+
+    for (size_t i = 0; i < 10; ++i) {
+        v(i) = dataset.training_images[i];
+    }
+
+    rbm.batch_activate_hidden(h, v);
+
+    etl::dyn_vector<float> energies(10);
+    etl::dyn_vector<float> free_energies(10);
+
+    rbm.batch_energy(energies, v, h);
+    rbm.batch_free_energy(free_energies, v);
+
+    for (size_t i = 0; i < 10; ++i) {
+        rbm.h1_a = h(i);
+
+        REQUIRE(energies[i] == Approx(rbm.energy(dataset.training_images[i], rbm.h1_a)).epsilon(1e-3));
+        REQUIRE(free_energies[i] == Approx(rbm.free_energy(dataset.training_images[i])).epsilon(1e-3));
+    }
+}
@@ -157,3 +157,55 @@ TEST_CASE("unit/crbm_mp/mnist/7", "[crbm_mp][lee][gaussian][unit]") {
     auto error = rbm.train(dataset.training_images, 30);
     REQUIRE(error < 0.1);
 }
+
+TEST_CASE("unit/crbm_mp/mnist/8", "[crbm_mp][pmp][unit]") {
+    dll::conv_rbm_mp_desc_square<
+        1, 28, 10, 13, 2,
+        dll::weight_type<float>,
+        dll::batch_size<10>>::layer_t rbm;
+
+    auto dataset = mnist::read_dataset_direct<std::vector, etl::fast_dyn_matrix<float, 1, 28, 28>>(100);
+    REQUIRE(!dataset.training_images.empty());
+
+    mnist::binarize_dataset(dataset);
+
+    rbm.train(dataset.training_images, 5);
+
+    etl::fast_dyn_matrix<float, 10, 1, 28, 28> v;
+    etl::fast_dyn_matrix<float, 10, 10, 16, 16> h_a;
+    etl::fast_dyn_matrix<float, 10, 10, 16, 16> h_s;
+    etl::fast_dyn_matrix<float, 10, 10, 8, 8> p_a;
+    etl::fast_dyn_matrix<float, 10, 10, 8, 8> p_s;
+
+    for (size_t b = 0; b < 10; ++b) {
+        v(b) = dataset.training_images[b];
+    }
+
+    rbm.batch_activate_hidden<true, true>(h_a, h_s, v, v);
+    rbm.batch_activate_pooling<true, true>(p_a, p_s, v, v);
+
+    for (size_t b = 0; b < 10; ++b) {
+        for (size_t k = 0; k < 10; ++k) {
+            for (size_t i = 0; i < 8; ++i) {
+                for (size_t j = 0; j < 8; ++j) {
+                    float sum    = 0.0;
+                    float active = 0.0;
+
+                    for (size_t ii = 0; ii < 2; ++ii) {
+                        for (size_t jj = 0; jj < 2; ++jj) {
+                            sum += h_a(b, k, 2 * i + ii, 2 * j + jj);
+                            active += h_s(b, k, 2 * i + ii, 2 * j + jj);
+                        }
+                    }
+
+                    // At most one unit of a block is on
+                    REQUIRE(active <= 1.0f);
+
+                    // The pooling unit is on if one unit of the block is on
+                    REQUIRE(std::abs(sum - p_a(b, k, i, j)) < 1e-4);
+                    REQUIRE((p_s(b, k, i, j) == 0.0f || p_s(b, k, i, j) == 1.0f));
+                }
+            }
+        }
+    }
+}
@@ -169,6 +169,35 @@ TEST_CASE("unit/dbn/mnist/5", "[dbn][sgd][unit]") {
     TEST_CHECK(0.3);
 }
 
+TEST_CASE("unit/dbn/mnist/pipeline/1", "[dbn][sgd][unit]") {
+    using dbn_t = dll::dbn_desc<
+        dll::dbn_layers<
+            dll::rbm_desc<28 * 28, 150, dll::momentum, dll::batch_size<25>, dll::init_weights>::layer_t,
+            dll::rbm_desc<150, 200, dll::momentum, dll::batch_size<25>>::layer_t,
+            dll::rbm_desc<200, 10, dll::momentum, dll::batch_size<25>, dll::hidden<dll::unit_type::SOFTMAX>>::layer_t>,
+        dll::batch_mode, dll::pipeline_pretrain,
+        dll::trainer<dll::sgd_trainer>, dll::updater<dll::updater_type::MOMENTUM>, dll::batch_size<25>>::dbn_t;
+
+    auto dataset = mnist::read_dataset_direct<std::vector, etl::dyn_matrix<float, 1>>(250);
+
+    REQUIRE(!dataset.training_images.empty());
+
+    mnist::binarize_dataset(dataset);
+
+    auto dbn = std::make_unique<dbn_t>();
+
+    dbn->learning_rate  = 0.05;
+    dbn->pipeline_delay = 5;
+
+    dbn->pretrain(dataset.training_images, 20);
+
+    auto error = dbn->fine_tune(dataset.training_images, dataset.training_labels, 50);
+    std::cout << "ft_error:" << error << std::endl;
+    REQUIRE(error < 1e-1);
+
+    TEST_CHECK(0.3);
+}
+
 TEST_CASE("unit/dbn/mnist/6", "[dbn][dyn][unit]") {
     using dbn_t =
         dll::dbn_desc<
@@ -220,6 +249,34 @@ TEST_CASE("unit/dbn/mnist/7", "[dbn][svm][unit]") {
     REQUIRE(test_error < 0.2);
 }
 
+TEST_CASE("unit/dbn/svm/1", "[dbn][svm][unit]") {
+    using dbn_t = dll::dbn_desc<
+        dll::dbn_layers<
+            dll::rbm_desc<28 * 28, 100, dll::momentum, dll::batch_size<25>, dll::init_weights>::layer_t>,
+        dll::batch_size<25>>::dbn_t;
+
+    auto dataset = mnist::read_dataset_direct<std::vector, etl::dyn_matrix<float, 1>>(200);
+
+    REQUIRE(!dataset.training_images.empty());
+
+    mnist::binarize_dataset(dataset);
+
+    auto dbn = std::make_unique<dbn_t>();
+
+    dbn->pretrain(dataset.training_images, 10);
+    auto result = dbn->svm_train(dataset.training_images, dataset.training_labels);
+
+    REQUIRE(result);
+
+    auto labels = dbn->svm_predict(dataset.training_images.begin(), dataset.training_images.end());
+
+    REQUIRE(labels.size() == dataset.training_images.size());
+
+    for (size_t i = 0; i < labels.size(); ++i) {
+        REQUIRE(labels[i] == Approx(dbn->svm_predict(dataset.training_images[i])));
+    }
+}
+
 // Pretrain with binarize layer
 TEST_CASE("unit/dbn/mnist/8", "[dbn][unit]") {
     typedef dll::dbn_desc<
@@ -358,6 +415,41 @@ TEST_CASE("unit/dbn/mnist/102", "[dbn][denoising][unit]") {
     dbn->pretrain_denoising(dataset.training_images, 50);
 }
 
+TEST_CASE("unit/dbn/mnist/103", "[dbn][denoising][unit]") {
+    using dbn_t =
+        dll::dbn_desc<
+            dll::dbn_layers<
+                dll::rbm_desc<
+                    28 * 28, 200,
+                    dll::batch_size<25>,
+                    dll::momentum,
+                    dll::weight_decay<>,
+                    dll::visible<dll::unit_type::GAUSSIAN>,
+                    dll::shuffle>::layer_t,
+                dll::rbm_desc<
+                    200, 200,
+                    dll::batch_size<25>,
+                    dll::momentum,
+                    dll::weight_decay<>,
+                    dll::visible<dll::unit_type::BINARY>,
+                    dll::shuffle>::layer_t
+            >
+            , dll::trainer<dll::cg_trainer>
+            , dll::noise<50>
+            , dll::noise_kind<dll::noise_type::GAUSSIAN>>::dbn_t;
+
+    auto dbn = std::make_unique<dbn_t>();
+
+    dbn->template layer_get<0>().learning_rate *= 5;
+
+    auto dataset = mnist::read_dataset_direct<std::vector, etl::dyn_vector<float>>(250);
+    REQUIRE(!dataset.training_images.empty());
+
+    mnist::normalize_dataset(dataset);
+
+    dbn->pretrain_denoising(dataset.training_images, 50);
+}
+
 TEST_CASE("unit/dbn/mnist/11", "[dbn][denoising][unit]") {
     using dbn_t =
         dll::dbn_desc<
@@ -431,3 +523,101 @@ TEST_CASE("unit/dbn/mnist/12", "[dbn][unit]") {
 
     dll::dump_timers();
 }
+
+TEST_CASE("unit/dbn/features/1", "[dbn][unit]") {
+    typedef dll::dbn_desc<
+        dll::dbn_layers<
+            dll::rbm<28 * 28, 100, dll::momentum, dll::batch_size<10>>,
+            dll::rbm<100, 10, dll::momentum, dll::batch_size<10>, dll::hidden<dll::unit_type::SOFTMAX>>>,
+        dll::batch_size<10>>::dbn_t dbn_t;
+
+    auto dataset = mnist::read_dataset_direct<std::vector, etl::dyn_matrix<float, 1>>(1100);
+    REQUIRE(!dataset.training_images.empty());
+
+    mnist::binarize_dataset(dataset);
+
+    auto dbn = std::make_unique<dbn_t>();
+
+    const size_t n = dataset.training_images.size();
+
+    auto& images = dataset.training_images;
+
+    dbn->save_features(images.begin(), images.end(), ".tmp.features.txt", dll::format::DLL);
+    dbn->save_features(images.begin(), images.end(), ".tmp.features.bin", dll::format::BINARY);
+    dbn->save_features(images.begin(), images.end(), ".tmp.features.npy", dll::format::NPY);
+
+    // One line per sample in the text format
+    std::ifstream text(".tmp.features.txt");
+    REQUIRE(std::count(std::istreambuf_iterator<char>(text), std::istreambuf_iterator<char>(), '\n') == long(n));
+
+    // The binary format is the header followed by the features
+    std::ifstream binary(".tmp.features.bin", std::ios::binary);
+
+    dll::features_header header;
+    binary.read(reinterpret_cast<char*>(&header), sizeof(header));
+
+    REQUIRE(header.magic == dll::features_header::file_magic);
+    REQUIRE(header.weight_size == sizeof(float));
+    REQUIRE(header.samples == n);
+    REQUIRE(header.dimensions == 1);
+    REQUIRE(header.dims[0] == 10);
+
+    binary.seekg(dll::features_header::size);
+
+    std::vector<float> values(n * 10);
+    binary.read(reinterpret_cast<char*>(values.data()), values.size() * sizeof(float));
+    REQUIRE(binary);
+
+    for (size_t i : {size_t(0), size_t(1023), size_t(1024), n - 1}) {
+        auto probs = dbn->features(images[i]);
+
+        for (size_t j = 0; j < 10; ++j) {
+            REQUIRE(values[i * 10 + j] == Approx(probs[j]));
+        }
+    }
+
+    // The NPY format describes the shape of the array in its header
+    std::ifstream npy(".tmp.features.npy", std::ios::binary);
+
+    std::string npy_header(dll::features_writer<>::npy_size, ' ');
+    npy.read(&npy_header[0], npy_header.size());
+
+    REQUIRE(npy_header.substr(1, 5) == "NUMPY");
+    REQUIRE(npy_header.find("'descr': '<f4'") != std::string::npos);
+    REQUIRE(npy_header.find("'shape': (" + std::to_string(n) + ", 10)") != std::string::npos);
+
+    std::vector<float> npy_values(n * 10);
+    npy.read(reinterpret_cast<char*>(npy_values.data()), npy_values.size() * sizeof(float));
+    REQUIRE(npy);
+    REQUIRE(npy_values == values);
+}
+
+TEST_CASE("unit/dbn/svm/concatenate/1", "[dbn][svm][unit]") {
+    using dbn_t = dll::dbn_desc<
+        dll::dbn_layers<
+            dll::rbm_desc<28 * 28, 100, dll::momentum, dll::batch_size<25>, dll::init_weights>::layer_t,
+            dll::rbm_desc<100, 50, dll::momentum, dll::batch_size<25>>::layer_t>,
+        dll::svm_concatenate, dll::batch_size<25>>::dbn_t;
+
+    auto dataset = mnist::read_dataset_direct<std::vector, etl::dyn_matrix<float, 1>>(110);
+
+    REQUIRE(!dataset.training_images.empty());
+
+    mnist::binarize_dataset(dataset);
+
+    auto dbn = std::make_unique<dbn_t>();
+
+    dbn->pretrain(dataset.training_images, 10);
+    auto result = dbn->svm_train(dataset.training_images, dataset.training_labels);
+
+    REQUIRE(result);
+
+    // The features of the last (padded) batch are concatenated as well
+    auto labels = dbn->svm_predict(dataset.training_images.begin(), dataset.training_images.end());
+
+    REQUIRE(labels.size() == dataset.training_images.size());
+
+    for (size_t i = 0; i < labels.size(); ++i) {
+        REQUIRE(labels[i] == Approx(dbn->svm_predict(dataset.training_images[i])));
+    }
+}
@@ -6,14 +6,23 @@
 //=======================================================================
 
 #include <deque>
+#include <thread>
+#include <future>
 
 #include "dll_test.hpp"
 
 #include "dll/neural/dense_layer.hpp"
 #include "dll/transform/shape_1d_layer.hpp"
 #include "dll/neural/activation_layer.hpp"
+#include "dll/neural/dropout_layer.hpp"
+#include "dll/transform/scale_layer.hpp"
 #include "dll/dbn.hpp"
 #include "dll/datasets.hpp"
+#include "dll/async_watcher.hpp"
+#include "dll/util/huge_pages.hpp"
+#include "dll/util/softmax_cce.hpp"
+#include "dll/util/fused_losses.hpp"
+#include "dll/util/tuning.hpp"
 
 #include "mnist/mnist_reader.hpp"
 #include "mnist/mnist_utils.hpp"
@@ -310,3 +319,1879 @@ TEST_CASE("unit/dense/sgd/14", "[unit][dense][dbn][mnist][sgd]") {
     FT_CHECK(50, 5e-2);
     TEST_CHECK(0.2);
 }
+
+// Test Sigmoid network, with inputs stored as bytes
+TEST_CASE("unit/dense/sgd/15", "[unit][dense][dbn][mnist][sgd]") {
+    using dbn_t = dll::dbn_desc<
+        dll::dbn_layers<
+            dll::dense_layer_desc<28 * 28, 10, dll::softmax>::layer_t>,
+        dll::batch_size<20>
+    >::dbn_t;
+
+    // Load the dataset
+    auto dataset = dll::make_mnist_dataset_sub(0, 1000, dll::storage_type<uint8_t>{}, dll::normalize_pre{}, dll::batch_size<20>{});
+
+    auto dbn = std::make_unique<dbn_t>();
+
+    dbn->learning_rate = 0.03;
+
+    FT_CHECK_DATASET(50, 5e-2);
+    TEST_CHECK_DATASET(0.3);
+}
+
+TEST_CASE("unit/dense/sgd/16", "[unit][dense][dbn][mnist][sgd]") {
+    typedef dll::dbn_desc<
+        dll::dbn_layers<
+            dll::dense_layer_desc<28 * 28, 100>::layer_t,
+            dll::dense_layer_desc<100, 10, dll::softmax>::layer_t>,
+        dll::trainer<dll::sgd_trainer>, dll::updater<dll::updater_type::MOMENTUM>, dll::data_parallel<4>, dll::batch_size<20>>::dbn_t dbn_t;
+
+    auto dataset = mnist::read_dataset_direct<std::vector, etl::fast_dyn_matrix<float, 28 * 28>>(350);
+    REQUIRE(!dataset.training_images.empty());
+
+    mnist::normalize_dataset(dataset);
+
+    auto dbn = std::make_unique<dbn_t>();
+
+    dbn->learning_rate = 0.05;
+
+    FT_CHECK(50, 5e-2);
+    TEST_CHECK(0.3);
+}
+
+TEST_CASE("unit/dense/sgd/17", "[unit][dense][dbn][mnist][sgd]") {
+    typedef dll::dbn_desc<
+        dll::dbn_layers<
+            dll::dense_layer_desc<28 * 28, 100>::layer_t,
+            dll::dense_layer_desc<100, 10, dll::softmax>::layer_t>,
+        dll::trainer<dll::sgd_trainer>, dll::updater<dll::updater_type::MOMENTUM>, dll::grad_accumulate<4>, dll::batch_size<5>>::dbn_t dbn_t;
+
+    auto dataset = mnist::read_dataset_direct<std::vector, etl::fast_dyn_matrix<float, 28 * 28>>(350);
+    REQUIRE(!dataset.training_images.empty());
+
+    mnist::normalize_dataset(dataset);
+
+    auto dbn = std::make_unique<dbn_t>();
+
+    dbn->learning_rate = 0.05;
+
+    FT_CHECK(50, 5e-2);
+    TEST_CHECK(0.3);
+}
+
+TEST_CASE("unit/dense/sgd/18", "[unit][dense][dbn][mnist][sgd]") {
+    typedef dll::dbn_desc<
+        dll::dbn_layers<
+            dll::dense_layer_desc<28 * 28, 100>::layer_t,
+            dll::dense_layer_desc<100, 10, dll::softmax>::layer_t>,
+        dll::trainer<dll::sgd_trainer>, dll::updater<dll::updater_type::MOMENTUM>, dll::loss_scaling, dll::batch_size<20>>::dbn_t dbn_t;
+
+    auto dataset = mnist::read_dataset_direct<std::vector, etl::fast_dyn_matrix<float, 28 * 28>>(350);
+    REQUIRE(!dataset.training_images.empty());
+
+    mnist::normalize_dataset(dataset);
+
+    auto dbn = std::make_unique<dbn_t>();
+
+    dbn->learning_rate     = 0.05;
+    dbn->loss_scale        = 1e38;
+    dbn->loss_scale_window = 10;
+
+    FT_CHECK(50, 5e-2);
+    TEST_CHECK(0.3);
+
+    // The overflows must have reduced the loss scale
+    REQUIRE(dbn->loss_scale < 1e38);
+}
+
+TEST_CASE("unit/dense/sgd/19", "[unit][dense][dbn][mnist][sgd]") {
+    typedef dll::dbn_desc<
+        dll::dbn_layers<
+            dll::dense_layer_desc<28 * 28, 100>::layer_t,
+            dll::dense_layer_desc<100, 10, dll::softmax>::layer_t>,
+        dll::trainer<dll::sgd_trainer>, dll::updater<dll::updater_type::MOMENTUM>, dll::stage_inputs, dll::batch_size<20>>::dbn_t dbn_t;
+
+    auto dataset = mnist::read_dataset_direct<std::vector, etl::fast_dyn_matrix<float, 28 * 28>>(350);
+    REQUIRE(!dataset.training_images.empty());
+
+    mnist::normalize_dataset(dataset);
+
+    auto dbn = std::make_unique<dbn_t>();
+
+    dbn->learning_rate = 0.05;
+
+    FT_CHECK(50, 5e-2);
+    TEST_CHECK(0.3);
+}
+
+TEST_CASE("unit/dense/sgd/20", "[unit][dense][dbn][mnist][sgd]") {
+    typedef dll::dbn_desc<
+        dll::dbn_layers<
+            dll::dense_layer_desc<28 * 28, 100>::layer_t,
+            dll::dense_layer_desc<100, 10, dll::softmax>::layer_t>,
+        dll::trainer<dll::sgd_trainer>, dll::updater<dll::updater_type::MOMENTUM>, dll::lr_schedule<dll::warmup_lr<dll::cosine_lr>>, dll::batch_size<20>>::dbn_t dbn_t;
+
+    auto dataset = mnist::read_dataset_direct<std::vector, etl::fast_dyn_matrix<float, 28 * 28>>(350);
+    REQUIRE(!dataset.training_images.empty());
+
+    mnist::normalize_dataset(dataset);
+
+    auto dbn = std::make_unique<dbn_t>();
+
+    dbn->learning_rate        = 0.1;
+    dbn->lr_min               = 0.01;
+    dbn->lr_warmup_iterations = 20;
+
+    FT_CHECK(50, 5e-2);
+    TEST_CHECK(0.3);
+}
+
+TEST_CASE("unit/dropout/mask/1", "[unit][dropout]") {
+    using layer_t = dll::dropout_layer_desc<30>::layer_t;
+
+    layer_t layer;
+
+    struct {
+        etl::fast_matrix<float, 32, 100> errors;
+    } context;
+
+    etl::fast_matrix<float, 32, 100> v;
+    etl::fast_matrix<float, 32, 100> h;
+    etl::fast_matrix<float, 32, 100> dv;
+
+    v              = etl::uniform_generator(1.0, 2.0);
+    context.errors = etl::uniform_generator(1.0, 2.0);
+
+    layer.train_forward_batch(h, v);
+    layer.backward_batch(dv, context);
+
+    const float scale = 1.0f / (1.0f - 0.3f);
+
+    size_t dropped = 0;
+
+    for (size_t i = 0; i < etl::size(h); ++i) {
+        if (h[i] == 0.0f) {
+            // The backward pass must drop the same units
+            REQUIRE(dv[i] == 0.0f);
+            ++dropped;
+        } else {
+            REQUIRE(std::abs(h[i] - scale * v[i]) < 1e-5);
+            REQUIRE(std::abs(dv[i] - scale * context.errors[i]) < 1e-5);
+        }
+    }
+
+    REQUIRE(dropped > 0.25 * etl::size(h));
+    REQUIRE(dropped < 0.35 * etl::size(h));
+}
+
+TEST_CASE("unit/dense/batcher/1", "[unit][dense][dbn]") {
+    typedef dll::dbn_desc<
+        dll::dbn_layers<
+            dll::dense_layer_desc<20, 30>::layer_t,
+            dll::dense_layer_desc<30, 5, dll::softmax>::layer_t>,
+        dll::batch_size<8>>::dbn_t dbn_t;
+
+    auto dbn = std::make_unique<dbn_t>();
+
+    std::vector<etl::fast_dyn_matrix<float, 20>> inputs(40);
+
+    for (auto& input : inputs) {
+        input = etl::uniform_generator(-1.0, 1.0);
+    }
+
+    std::vector<etl::dyn_matrix<float, 1>> outputs(inputs.size());
+
+    {
+        dbn_t::inference_batcher batcher(*dbn, std::chrono::microseconds(500), 8, 2);
+
+        // Several clients submit their samples concurrently
+        std::vector<std::thread> threads;
+
+        for (size_t t = 0; t < 4; ++t) {
+            threads.emplace_back([&batcher, &inputs, &outputs, t]() {
+                for (size_t i = t; i < inputs.size(); i += 4) {
+                    outputs[i] = batcher.forward(inputs[i]).get();
+                }
+            });
+        }
+
+        for (auto& thread : threads) {
+            thread.join();
+        }
+    }
+
+    for (size_t i = 0; i < inputs.size(); ++i) {
+        auto expected = dbn->forward_one(inputs[i]);
+
+        REQUIRE(etl::size(outputs[i]) == 5);
+        REQUIRE(etl::max(etl::abs(outputs[i] - expected)) < 1e-5);
+    }
+}
+
+TEST_CASE("unit/dense/many/1", "[unit][dense][dbn]") {
+    typedef dll::dbn_desc<
+        dll::dbn_layers<
+            dll::dense_layer_desc<20, 30>::layer_t,
+            dll::dense_layer_desc<30, 5, dll::softmax>::layer_t>,
+        dll::batch_size<8>>::dbn_t dbn_t;
+
+    auto dbn = std::make_unique<dbn_t>();
+
+    // Not a multiple of the batch size, to have a partial chunk
+    std::vector<etl::fast_dyn_matrix<float, 20>> inputs(45);
+
+    for (auto& input : inputs) {
+        input = etl::uniform_generator(-1.0, 1.0);
+    }
+
+    auto outputs   = dbn->forward_many(inputs);
+    auto outputs_2 = dbn->forward_many(inputs.begin(), inputs.end());
+
+    REQUIRE(outputs.size() == inputs.size());
+    REQUIRE(outputs_2.size() == inputs.size());
+
+    for (size_t i = 0; i < inputs.size(); ++i) {
+        auto expected = dbn->forward_one(inputs[i]);
+
+        REQUIRE(etl::max(etl::abs(outputs[i] - expected)) < 1e-5);
+        REQUIRE(etl::max(etl::abs(outputs_2[i] - expected)) < 1e-5);
+    }
+}
+
+TEST_CASE("unit/dense/packed/1", "[unit][dense][dbn]") {
+    typedef dll::dbn_desc<
+        dll::dbn_layers<
+            dll::dense_layer_desc<20, 30>::layer_t,
+            dll::dense_layer_desc<30, 5, dll::softmax>::layer_t>,
+        dll::batch_size<8>>::dbn_t dbn_t;
+
+    auto dbn   = std::make_unique<dbn_t>();
+    auto dbn_2 = std::make_unique<dbn_t>();
+
+    REQUIRE(dbn->store_packed("unit_dense_packed_1.dllm"));
+    REQUIRE(dbn_2->load_packed("unit_dense_packed_1.dllm"));
+
+    etl::fast_dyn_matrix<float, 20> input;
+    input = etl::uniform_generator(-1.0, 1.0);
+
+    REQUIRE(etl::max(etl::abs(dbn->forward_one(input) - dbn_2->forward_one(input))) < 1e-6);
+
+    // A corrupted file must be rejected
+    {
+        std::fstream fs("unit_dense_packed_1.dllm", std::ios::in | std::ios::out | std::ios::binary);
+        fs.seekp(dll::packed_model_header::data_alignment + 7);
+        fs.put(42);
+    }
+
+    REQUIRE(!dbn_2->load_packed("unit_dense_packed_1.dllm"));
+
+    std::remove("unit_dense_packed_1.dllm");
+}
+
+TEST_CASE("unit/dense/compact/1", "[unit][dense][dbn]") {
+    typedef dll::dbn_desc<
+        dll::dbn_layers<
+            dll::dense_layer_desc<20, 30>::layer_t,
+            dll::dense_layer_desc<30, 5, dll::softmax>::layer_t>,
+        dll::batch_size<8>>::dbn_t dbn_t;
+
+    auto dbn   = std::make_unique<dbn_t>();
+    auto dbn_2 = std::make_unique<dbn_t>();
+
+    etl::fast_dyn_matrix<float, 20> input;
+    input = etl::uniform_generator(-1.0, 1.0);
+
+    auto expected = dbn->forward_one(input);
+
+    REQUIRE(dbn->store_compact("unit_dense_compact_1.dllc", dll::model_encoding::FP16));
+    REQUIRE(dbn_2->load_compact("unit_dense_compact_1.dllc"));
+
+    REQUIRE(etl::max(etl::abs(dbn->template layer_get<0>().w - dbn_2->template layer_get<0>().w)) < 1e-3);
+    REQUIRE(etl::max(etl::abs(expected - dbn_2->forward_one(input))) < 1e-2);
+
+    REQUIRE(dbn->store_compact("unit_dense_compact_1.dllc", dll::model_encoding::BF16, true));
+    REQUIRE(dbn_2->load_compact("unit_dense_compact_1.dllc"));
+
+    REQUIRE(etl::max(etl::abs(expected - dbn_2->forward_one(input))) < 5e-2);
+
+    REQUIRE(dbn->store_compact("unit_dense_compact_1.dllc", dll::model_encoding::INT8));
+    REQUIRE(dbn_2->load_compact("unit_dense_compact_1.dllc"));
+
+    REQUIRE(etl::max(etl::abs(expected - dbn_2->forward_one(input))) < 5e-2);
+
+    // A packed model is not a compact model
+    REQUIRE(!dbn_2->load_packed("unit_dense_compact_1.dllc"));
+
+    std::remove("unit_dense_compact_1.dllc");
+}
+
+TEST_CASE("unit/dense/hot/1", "[unit][dense][dbn]") {
+    typedef dll::dbn_desc<
+        dll::dbn_layers<
+            dll::dense_layer_desc<20, 30>::layer_t,
+            dll::dense_layer_desc<30, 5, dll::softmax>::layer_t>,
+        dll::batch_size<8>>::dbn_t dbn_t;
+
+    auto dbn   = std::make_shared<dbn_t>();
+    auto dbn_2 = std::make_unique<dbn_t>();
+
+    etl::fast_dyn_matrix<float, 8, 20> batch;
+    batch = etl::uniform_generator(-1.0, 1.0);
+
+    auto expected   = dbn->test_forward_batch(batch);
+    auto expected_2 = dbn_2->test_forward_batch(batch);
+
+    REQUIRE(dbn_2->store_packed("unit_dense_hot_1.dllm"));
+
+    dbn_t::hot_model hot(dbn);
+
+    REQUIRE(hot.version() == 1);
+    REQUIRE(etl::max(etl::abs(expected - hot.test_forward_batch(batch))) < 1e-5);
+
+    size_t warmups = 0;
+    hot.set_warmup([&warmups, &batch](const dbn_t& net) { net.test_forward_batch(batch); ++warmups; });
+
+    // An in-flight inference keeps the previous weights
+    auto previous = hot.acquire();
+
+    REQUIRE(hot.reload_async("unit_dense_hot_1.dllm").get());
+    REQUIRE(hot.version() == 2);
+    REQUIRE(warmups == 1);
+
+    REQUIRE(etl::max(etl::abs(expected_2 - hot.test_forward_batch(batch))) < 1e-5);
+    REQUIRE(etl::max(etl::abs(expected - previous->test_forward_batch(batch))) < 1e-5);
+
+    // A missing file keeps the current network
+    REQUIRE(!hot.reload("unit_dense_hot_missing.dllm"));
+    REQUIRE(hot.version() == 2);
+
+    std::remove("unit_dense_hot_1.dllm");
+}
+
+TEST_CASE("unit/dense/stream/1", "[unit][dense][dbn][mnist][sgd]") {
+    using dbn_t = dll::dbn_desc<
+        dll::dbn_layers<
+            dll::dense_layer_desc<28 * 28, 10, dll::softmax>::layer_t>,
+        dll::batch_size<20>
+    >::dbn_t;
+
+    auto dataset = mnist::read_dataset_direct<std::vector, etl::dyn_vector<float>>(500);
+    REQUIRE(!dataset.training_images.empty());
+
+    mnist::normalize_dataset(dataset);
+
+    auto val_generator = dll::make_generator(dataset.training_images, dataset.training_labels, dataset.training_images.size(), 10,
+        dll::inmemory_data_generator_desc<dll::batch_size<20>, dll::categorical>{});
+
+    using stream_t = dll::stream_generator<etl::dyn_vector<float>, etl::dyn_vector<float>, 20>;
+
+    // At most two batches are buffered
+    stream_t stream(40);
+
+    // The samples arrive from another thread, in ten passes
+    auto producer = std::async(std::launch::async, [&dataset, &stream]() {
+        etl::dyn_vector<float> label(10);
+
+        for (size_t pass = 0; pass < 10; ++pass) {
+            for (size_t i = 0; i < dataset.training_images.size(); ++i) {
+                label                             = 0.0f;
+                label[dataset.training_labels[i]] = 1.0f;
+
+                stream.push(dataset.training_images[i], label);
+            }
+        }
+
+        stream.close();
+    });
+
+    auto dbn = std::make_unique<dbn_t>();
+
+    dbn->learning_rate = 0.03;
+
+    dll::stream_options options;
+    options.replay_size  = 200;
+    options.eval_batches = 50;
+
+    auto ft_error = dbn->fine_tune_stream(stream, *val_generator, options);
+    std::cout << "ft_error:" << ft_error << std::endl;
+
+    producer.get();
+
+    CHECK(ft_error < 0.3);
+    CHECK(dbn->evaluate_error(*val_generator) < 0.2);
+
+    // A closed stream has no more batches
+    REQUIRE(!stream.has_next_batch());
+    REQUIRE(!stream.push(dataset.training_images[0], etl::dyn_vector<float>(10)));
+}
+
+TEST_CASE("unit/dense/distill/1", "[unit][dense][dbn][mnist][sgd]") {
+    using teacher_t = dll::dbn_desc<
+        dll::dbn_layers<
+            dll::dense_layer_desc<28 * 28, 100>::layer_t,
+            dll::dense_layer_desc<100, 10, dll::softmax>::layer_t>,
+        dll::batch_size<20>
+    >::dbn_t;
+
+    using student_t = dll::dbn_desc<
+        dll::dbn_layers<
+            dll::dense_layer_desc<28 * 28, 10, dll::softmax>::layer_t>,
+        dll::batch_size<20>
+    >::dbn_t;
+
+    auto dataset = mnist::read_dataset_direct<std::vector, etl::fast_dyn_matrix<float, 28 * 28>>(500);
+    REQUIRE(!dataset.training_images.empty());
+
+    mnist::normalize_dataset(dataset);
+
+    auto generator = dll::make_generator(dataset.training_images, dataset.training_labels, dataset.training_images.size(), 10,
+        dll::inmemory_data_generator_desc<dll::batch_size<20>, dll::categorical>{});
+
+    auto teacher = std::make_unique<teacher_t>();
+
+    teacher->learning_rate = 0.05;
+    teacher->fine_tune(*generator, 30);
+
+    auto student = std::make_unique<student_t>();
+
+    student->learning_rate = 0.03;
+
+    dll::distill_options options;
+    options.temperature = 2.0;
+    options.alpha       = 0.8;
+    options.cache       = "unit_dense_distill_1.cache";
+
+    auto ft_error = student->fine_tune_distill(*teacher, *generator, 30, options);
+    std::cout << "ft_error:" << ft_error << std::endl;
+    CHECK(ft_error < 0.1);
+
+    // The outputs of the teacher were cached after the first epoch
+    std::ifstream cache("unit_dense_distill_1.cache", std::ifstream::binary | std::ifstream::ate);
+    REQUIRE(size_t(cache.tellg()) == dataset.training_images.size() * 10 * sizeof(float));
+
+    CHECK(student->evaluate_error(*generator) < 0.1);
+
+    std::remove("unit_dense_distill_1.cache");
+}
+
+TEST_CASE("unit/dense/int8/1", "[unit][dense][dbn]") {
+    typedef dll::dbn_desc<
+        dll::dbn_layers<
+            dll::dense_layer_desc<20, 30>::layer_t,
+            dll::dense_layer_desc<30, 5, dll::softmax>::layer_t>,
+        dll::batch_size<8>>::dbn_t dbn_t;
+
+    auto dbn = std::make_unique<dbn_t>();
+
+    std::vector<etl::dyn_matrix<float, 1>> inputs(40, etl::dyn_matrix<float, 1>(20));
+    std::vector<size_t> labels(40, 0);
+
+    for (auto& input : inputs) {
+        input = etl::uniform_generator(-1.0, 1.0);
+    }
+
+    auto generator = dll::make_generator(inputs, labels, inputs.size(), 5,
+        dll::inmemory_data_generator_desc<dll::batch_size<8>, dll::categorical>{});
+
+    etl::fast_dyn_matrix<float, 8, 20> batch;
+    batch = etl::uniform_generator(-1.0, 1.0);
+
+    auto expected = dbn->forward_batch(batch);
+
+    dbn->quantize(*generator);
+
+    REQUIRE(dbn->layer_get<0>().q8.active);
+    REQUIRE(dbn->layer_get<1>().q8.active);
+
+    auto output = dbn->forward_batch(batch);
+
+    REQUIRE(etl::max(etl::abs(output - expected)) < 0.02);
+}
+
+TEST_CASE("unit/dense/sparse/1", "[unit][dense]") {
+    using layer_t = dll::dense_layer_desc<50, 20, dll::relu>::layer_t;
+
+    layer_t layer;
+
+    etl::fast_matrix<float, 8, 50> v;
+    etl::fast_matrix<float, 8, 20> h;
+    etl::fast_matrix<float, 8, 20> h_sparse;
+
+    v = etl::uniform_generator(-1.0, 1.0);
+
+    REQUIRE(!layer.sparse.active);
+
+    layer.prune(0.9);
+
+    REQUIRE(layer.sparse.active);
+    REQUIRE(layer.sparse.density() <= 0.1 + 1e-6);
+
+    layer.forward_batch(h, v);
+    layer.test_forward_batch(h_sparse, v);
+
+    REQUIRE(etl::max(etl::abs(h_sparse - h)) < 1e-5);
+
+    // Dense weights do not use the sparse weights
+    layer.w = etl::uniform_generator(-1.0, 1.0);
+    layer.weights_changed();
+
+    REQUIRE(!layer.sparse.active);
+}
+
+TEST_CASE("unit/dense/sparse/2", "[unit][dense]") {
+    using layer_t        = dll::dense_layer_desc<100, 20, dll::relu>::layer_t;
+    using sparse_layer_t = dll::dense_layer_desc<100, 20, dll::relu, dll::sparse_input>::layer_t;
+
+    layer_t layer;
+    sparse_layer_t sparse_layer;
+
+    sparse_layer.w = layer.w;
+    sparse_layer.b = layer.b;
+
+    // Two active inputs per sample
+    etl::fast_matrix<float, 8, 100> v(0.0);
+
+    for (size_t i = 0; i < 8; ++i) {
+        v(i, (7 * i) % 100)      = 1.0;
+        v(i, (13 * i + 5) % 100) = 1.0;
+    }
+
+    dll::sparse_batch<float> sparse;
+    sparse.update(v);
+
+    REQUIRE(sparse.active);
+    REQUIRE(sparse.values.size() == 16);
+
+    etl::fast_matrix<float, 8, 20> h;
+    etl::fast_matrix<float, 8, 20> h_sparse;
+
+    layer.forward_batch(h, v);
+    sparse_layer.forward_batch(h_sparse, v);
+
+    REQUIRE(etl::max(etl::abs(h_sparse - h)) < 1e-5);
+
+    etl::fast_matrix<float, 100, 20> grad;
+    etl::fast_matrix<float, 100, 20> grad_sparse;
+
+    grad = etl::batch_outer(v, h);
+    sparse.outer(h, grad_sparse);
+
+    REQUIRE(etl::max(etl::abs(grad_sparse - grad)) < 1e-5);
+}
+
+TEST_CASE("unit/dense/fusion/1", "[unit][dense][dbn]") {
+    typedef dll::dbn_desc<
+        dll::dbn_layers<
+            dll::dense_layer_desc<20, 30, dll::identity>::layer_t,
+            dll::activation_layer_desc<dll::function::RELU>::layer_t,
+            dll::scale_layer_desc<1, 2>::layer_t,
+            dll::dense_layer_desc<30, 5, dll::softmax>::layer_t>,
+        dll::batch_size<8>>::dbn_t dbn_t;
+
+    static_assert(dll::layer_traits<dbn_t::layer_type<1>>::is_element_wise_layer(), "The activation layer must be fused");
+    static_assert(dll::layer_traits<dbn_t::layer_type<2>>::is_element_wise_layer(), "The scale layer must be fused");
+    static_assert(!dll::layer_traits<dbn_t::layer_type<3>>::is_element_wise_layer(), "The dense layer cannot be fused");
+
+    auto dbn = std::make_unique<dbn_t>();
+
+    etl::fast_dyn_matrix<float, 8, 20> batch;
+    batch = etl::uniform_generator(-1.0, 1.0);
+
+    // The layers one by one
+    auto h1 = dbn->layer_get<0>().test_forward_batch(batch);
+    auto h2 = dbn->layer_get<1>().test_forward_batch(h1);
+    auto h3 = dbn->layer_get<2>().test_forward_batch(h2);
+    auto h4 = dbn->layer_get<3>().test_forward_batch(h3);
+
+    REQUIRE(etl::max(etl::abs(dbn->forward_batch(batch) - h4)) < 1e-5);
+
+    // The fused layers are also the last layers
+    REQUIRE(etl::max(etl::abs(dbn->forward_batch<2>(batch) - h3)) < 1e-5);
+}
+
+TEST_CASE("unit/dense/shape/1", "[unit][dense][dbn]") {
+    typedef dll::dbn_desc<
+        dll::dbn_layers<
+            dll::shape_1d_layer_desc<20>::layer_t,
+            dll::dense_layer_desc<20, 30>::layer_t,
+            dll::dense_layer_desc<30, 5, dll::softmax>::layer_t>,
+        dll::batch_size<8>>::dbn_t dbn_t;
+
+    static_assert(dll::layer_traits<dbn_t::layer_type<0>>::is_shape_layer(), "The shape layer must be a view");
+    static_assert(!dll::layer_traits<dbn_t::layer_type<1>>::is_shape_layer(), "The dense layer is not a view");
+
+    auto dbn = std::make_unique<dbn_t>();
+
+    etl::fast_dyn_matrix<float, 8, 20> batch;
+    batch = etl::uniform_generator(-1.0, 1.0);
+
+    // The layers one by one, with the copy of the shape layer
+    auto h1 = dbn->layer_get<0>().test_forward_batch(batch);
+    auto h2 = dbn->layer_get<1>().test_forward_batch(h1);
+    auto h3 = dbn->layer_get<2>().test_forward_batch(h2);
+
+    REQUIRE(etl::max(etl::abs(dbn->forward_batch(batch) - h3)) < 1e-5);
+    REQUIRE(etl::max(etl::abs(dbn->train_forward_batch(batch) - h3)) < 1e-5);
+
+    // The shape layer is also the last layer
+    REQUIRE(etl::max(etl::abs(dbn->forward_batch<0>(batch) - batch)) < 1e-5);
+}
+
+TEST_CASE("unit/dense/planner/1", "[unit][dense][dbn]") {
+    typedef dll::dbn_desc<
+        dll::dbn_layers<
+            dll::dense_layer_desc<20, 30>::layer_t,
+            dll::dense_layer_desc<30, 40>::layer_t,
+            dll::dense_layer_desc<40, 5, dll::softmax>::layer_t>,
+        dll::batch_size<8>>::dbn_t dbn_t;
+
+    auto dbn = std::make_unique<dbn_t>();
+
+    dbn_t::inference_session session(*dbn);
+
+    etl::fast_dyn_matrix<float, 8, 20> batch;
+
+    for (size_t r = 0; r < 3; ++r) {
+        batch = etl::uniform_generator(-1.0, 1.0);
+
+        auto expected = dbn->forward_batch(batch);
+        auto output   = session.planned_forward_batch(batch);
+
+        REQUIRE(etl::size(output) == 8 * 5);
+        REQUIRE(etl::max(etl::abs(output - expected)) < 1e-5);
+    }
+
+    // Two arenas large enough for the largest activation (and the alignment)
+    REQUIRE(session.footprint() <= 2 * (8 * 40 + 16));
+}
+
+TEST_CASE("unit/dense/planner/external", "[unit][dense][dbn]") {
+    typedef dll::dbn_desc<
+        dll::dbn_layers<
+            dll::dense_layer_desc<20, 30>::layer_t,
+            dll::dense_layer_desc<30, 40>::layer_t,
+            dll::dense_layer_desc<40, 5, dll::softmax>::layer_t>,
+        dll::batch_size<8>>::dbn_t dbn_t;
+
+    auto dbn = std::make_unique<dbn_t>();
+
+    dbn_t::inference_session session(*dbn);
+
+    // Buffers owned by the caller, the inputs with a stride of 24 values
+
+    std::vector<float> input_memory(8 * 24);
+    std::vector<float> output_memory(8 * 5);
+
+    std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+
+    for (auto& value : input_memory) {
+        value = dist(dll::rand_engine());
+    }
+
+    etl::fast_dyn_matrix<float, 8, 20> batch;
+
+    for (size_t b = 0; b < 8; ++b) {
+        for (size_t i = 0; i < 20; ++i) {
+            batch(b, i) = input_memory[b * 24 + i];
+        }
+    }
+
+    auto expected = dbn->forward_batch(batch);
+
+    // Contiguous input, the outputs are written in the memory of the caller
+
+    auto output = dll::external_batch(output_memory.data(), 8, 5);
+
+    session.planned_forward_batch(output, dll::external_batch(batch.memory_start(), 8, 20));
+
+    REQUIRE(etl::max(etl::abs(output - expected)) < 1e-5);
+
+    // Strided input, gathered by the session
+
+    std::fill(output_memory.begin(), output_memory.end(), 0.0f);
+
+    session.planned_forward_batch(output, session.strided_batch(input_memory.data(), 24, 8, 20));
+
+    REQUIRE(output_memory[0] == Approx(expected(0, 0)));
+    REQUIRE(etl::max(etl::abs(output - expected)) < 1e-5);
+}
+
+TEST_CASE("unit/dense/ensemble/1", "[unit][dense][dbn]") {
+    typedef dll::dbn_desc<
+        dll::dbn_layers<
+            dll::dense_layer_desc<20, 30>::layer_t,
+            dll::dense_layer_desc<30, 5, dll::softmax>::layer_t>,
+        dll::batch_size<8>>::dbn_t dbn_1_t;
+
+    typedef dll::dbn_desc<
+        dll::dbn_layers<
+            dll::dense_layer_desc<20, 10>::layer_t,
+            dll::dense_layer_desc<10, 40>::layer_t,
+            dll::dense_layer_desc<40, 5, dll::softmax>::layer_t>,
+        dll::batch_size<8>>::dbn_t dbn_2_t;
+
+    auto dbn_1 = std::make_unique<dbn_1_t>();
+    auto dbn_2 = std::make_unique<dbn_2_t>();
+
+    auto ensemble = dll::make_ensemble(*dbn_1, *dbn_2);
+
+    etl::fast_dyn_matrix<float, 8, 20> batch;
+    batch = etl::uniform_generator(-1.0, 1.0);
+
+    auto output = ensemble->forward_batch(batch);
+
+    REQUIRE(etl::size(output) == 8 * 5);
+    REQUIRE(etl::max(etl::abs(output - 0.5 * (dbn_1->forward_batch(batch) + dbn_2->forward_batch(batch)))) < 1e-5);
+
+    ensemble->aggregation = dll::ensemble_aggregation::VOTE;
+
+    auto votes = ensemble->forward_batch(batch);
+    auto labels = ensemble->predict_batch(batch);
+
+    REQUIRE(labels.size() == 8);
+
+    for (size_t b = 0; b < 8; ++b) {
+        REQUIRE(etl::sum(votes(b)) == Approx(1.0));
+        REQUIRE(votes(b, labels[b]) >= 0.5);
+    }
+}
+
+TEST_CASE("unit/dense/cascade/1", "[unit][dense][dbn]") {
+    typedef dll::dbn_desc<
+        dll::dbn_layers<
+            dll::dense_layer_desc<20, 30>::layer_t,
+            dll::dense_layer_desc<30, 40>::layer_t,
+            dll::dense_layer_desc<40, 5, dll::softmax>::layer_t>,
+        dll::batch_size<8>>::dbn_t dbn_t;
+
+    typedef dll::dbn_desc<
+        dll::dbn_layers<
+            dll::dense_layer_desc<30, 5, dll::softmax>::layer_t>,
+        dll::batch_size<8>>::dbn_t head_t;
+
+    auto dbn  = std::make_unique<dbn_t>();
+    auto head = std::make_unique<head_t>();
+
+    etl::fast_dyn_matrix<float, 8, 20> batch;
+    batch = etl::uniform_generator(-1.0, 1.0);
+
+    auto expected      = dbn->forward_batch(batch);
+    auto head_expected = head->forward_batch(dbn->forward_batch<0>(batch));
+
+    auto cascade = dll::make_cascade<0>(*dbn, 0.0f, *head);
+
+    // All the samples exit at the head
+    REQUIRE(etl::max(etl::abs(cascade->forward_batch(batch) - head_expected)) < 1e-5);
+    REQUIRE(cascade->exited[0] == 8);
+
+    // No sample exits at the head
+    cascade->threshold = 2.0f;
+
+    REQUIRE(etl::max(etl::abs(cascade->forward_batch(batch) - expected)) < 1e-5);
+    REQUIRE(cascade->exited[1] == 8);
+
+    // Only the confident samples exit at the head
+    cascade->threshold = etl::max(head_expected);
+
+    auto output = cascade->forward_batch(batch);
+
+    REQUIRE(cascade->exited[0] == 9);
+    REQUIRE(cascade->exited[1] == 15);
+
+    for (size_t b = 0; b < 8; ++b) {
+        if (etl::max(head_expected(b)) >= cascade->threshold) {
+            REQUIRE(etl::max(etl::abs(output(b) - head_expected(b))) < 1e-5);
+        } else {
+            REQUIRE(etl::max(etl::abs(output(b) - expected(b))) < 1e-5);
+        }
+    }
+}
+
+TEST_CASE("unit/dense/checkpoint/1", "[unit][dense][dbn]") {
+    typedef dll::dbn_desc<
+        dll::dbn_layers<
+            dll::dense_layer_desc<20, 30>::layer_t,
+            dll::dense_layer_desc<30, 5, dll::softmax>::layer_t>,
+        dll::batch_size<8>>::dbn_t dbn_t;
+
+    auto dbn = std::make_unique<dbn_t>();
+
+    dbn->enable_checkpoints("unit_dense_checkpoint_1");
+
+    dbn->checkpoint();
+    REQUIRE(dbn->flush_checkpoints());
+    REQUIRE(dbn->checkpoints->written() == 2);
+
+    // Only the changed layer is rewritten
+    dbn->template layer_get<1>().w *= 2.0;
+
+    dbn->checkpoint();
+    REQUIRE(dbn->flush_checkpoints());
+    REQUIRE(dbn->checkpoints->written() == 3);
+
+    dbn->checkpoint();
+    REQUIRE(dbn->flush_checkpoints());
+    REQUIRE(dbn->checkpoints->written() == 3);
+
+    auto copy = std::make_unique<dbn_t>();
+
+    REQUIRE(copy->load_checkpoint("unit_dense_checkpoint_1"));
+
+    REQUIRE(etl::max(etl::abs(copy->template layer_get<0>().w - dbn->template layer_get<0>().w)) < 1e-6);
+    REQUIRE(etl::max(etl::abs(copy->template layer_get<1>().w - dbn->template layer_get<1>().w)) < 1e-6);
+
+    REQUIRE(!copy->load_checkpoint("unit_dense_checkpoint_missing"));
+}
+
+TEST_CASE("unit/dense/checkpoint/resume", "[unit][dense][dbn][mnist][sgd]") {
+    typedef dll::dbn_desc<
+        dll::dbn_layers<
+            dll::dense_layer_desc<28 * 28, 50>::layer_t,
+            dll::dense_layer_desc<50, 10, dll::softmax>::layer_t>,
+        dll::trainer<dll::sgd_trainer>, dll::updater<dll::updater_type::ADAM>, dll::batch_size<20>>::dbn_t dbn_t;
+
+    auto dataset = mnist::read_dataset_direct<std::vector, etl::fast_dyn_matrix<float, 28 * 28>>(350);
+    REQUIRE(!dataset.training_images.empty());
+
+    mnist::normalize_dataset(dataset);
+
+    auto first  = std::make_unique<dbn_t>();
+    auto direct = std::make_unique<dbn_t>();
+
+    first->learning_rate  = 0.005;
+    direct->learning_rate = 0.005;
+
+    std::stringstream initial;
+    first->store(initial);
+    direct->load(initial);
+
+    // One epoch, checkpointed inside the epoch and at the end
+    first->enable_checkpoints("unit_dense_checkpoint_resume", 1, 5);
+    first->fine_tune(dataset.training_images, dataset.training_labels, 1);
+
+    // The second epoch resumes with the state of Adam
+    auto resumed = std::make_unique<dbn_t>();
+
+    REQUIRE(resumed->resume("unit_dense_checkpoint_resume"));
+    REQUIRE(resumed->learning_rate == Approx(0.005));
+
+    resumed->fine_tune(dataset.training_images, dataset.training_labels, 2);
+
+    direct->fine_tune(dataset.training_images, dataset.training_labels, 2);
+
+    REQUIRE(etl::max(etl::abs(resumed->template layer_get<0>().w - direct->template layer_get<0>().w)) < 1e-3);
+    REQUIRE(etl::max(etl::abs(resumed->template layer_get<1>().w - direct->template layer_get<1>().w)) < 1e-3);
+
+    REQUIRE(!resumed->resume("unit_dense_checkpoint_missing"));
+}
+
+TEST_CASE("unit/dense/flops/1", "[unit][dense][dbn][mnist][sgd]") {
+    typedef dll::dbn_desc<
+        dll::dbn_layers<
+            dll::dense_layer_desc<28 * 28, 100>::layer_t,
+            dll::dense_layer_desc<100, 10, dll::softmax>::layer_t>,
+        dll::batch_size<20>>::dbn_t dbn_t;
+
+    auto dataset = mnist::read_dataset_direct<std::vector, etl::fast_dyn_matrix<float, 28 * 28>>(200);
+    REQUIRE(!dataset.training_images.empty());
+
+    mnist::normalize_dataset(dataset);
+
+    auto dbn = std::make_unique<dbn_t>();
+
+    REQUIRE(dbn->template layer_get<0>().forward_flops() == 2 * 28 * 28 * 100);
+    REQUIRE(dbn->template layer_get<1>().backward_flops() == 4 * 100 * 10);
+
+    dll::reset_timers();
+
+    dbn->fine_tune(dataset.training_images, dataset.training_labels, 2);
+
+    auto timers = dll::merged_timers();
+
+    auto find = [&timers](const char* name) {
+        return std::find_if(timers.begin(), timers.end(), [name](auto& timer) { return timer.name == name; });
+    };
+
+    REQUIRE(find(dll::layer_timers<0>::forward()) != timers.end());
+    REQUIRE(find(dll::layer_timers<1>::backward()) != timers.end());
+
+    dbn->display_throughput();
+}
+
+TEST_CASE("unit/dense/perf_counters/1", "[unit][dense][dbn][mnist][sgd]") {
+    typedef dll::dbn_desc<
+        dll::dbn_layers<
+            dll::dense_layer_desc<28 * 28, 100>::layer_t,
+            dll::dense_layer_desc<100, 10, dll::softmax>::layer_t>,
+        dll::batch_size<20>>::dbn_t dbn_t;
+
+    auto dataset = mnist::read_dataset_direct<std::vector, etl::fast_dyn_matrix<float, 28 * 28>>(200);
+    REQUIRE(!dataset.training_images.empty());
+
+    mnist::normalize_dataset(dataset);
+
+    auto dbn = std::make_unique<dbn_t>();
+
+    // The counters depend on the kernel, the timers must work without them
+    const bool perf = dll::enable_perf_counters();
+
+    dll::reset_timers();
+
+    dbn->fine_tune(dataset.training_images, dataset.training_labels, 1);
+
+    etl::dyn_matrix<float, 2> batch(20, 28 * 28);
+
+    for (size_t i = 0; i < 20; ++i) {
+        batch(i) = dataset.training_images[i];
+    }
+
+    auto output = dbn->test_forward_batch(batch);
+
+    REQUIRE(etl::dim<0>(output) == 20);
+
+    auto timers = dll::merged_timers();
+
+    auto find = [&timers](const char* name) {
+        return std::find_if(timers.begin(), timers.end(), [name](auto& timer) { return timer.name == name; });
+    };
+
+    auto forward = find(dll::layer_timers<0>::forward());
+
+    REQUIRE(forward != timers.end());
+    REQUIRE(find(dll::layer_timers<1>::test()) != timers.end());
+
+    if (perf) {
+        REQUIRE(forward->counters[dll::PERF_CYCLES] > 0);
+        REQUIRE(forward->counters[dll::PERF_INSTRUCTIONS] > 0);
+    }
+
+    dll::dump_timers_pretty();
+
+    dll::disable_perf_counters();
+}
+
+TEST_CASE("unit/dense/etl_counters/1", "[unit][dense][dbn][mnist][sgd]") {
+    typedef dll::dbn_desc<
+        dll::dbn_layers<
+            dll::dense_layer_desc<28 * 28, 100>::layer_t,
+            dll::dense_layer_desc<100, 10, dll::softmax>::layer_t>,
+        dll::batch_size<20>>::dbn_t dbn_t;
+
+    REQUIRE(dll::etl_counter_kind("gpu:cpu_to_gpu") == dll::ETL_SYNCS);
+    REQUIRE(dll::etl_counter_kind("temp:allocate") == dll::ETL_TEMPORARIES);
+    REQUIRE(dll::etl_counter_kind("gpu:allocate") == dll::ETL_ALLOCATIONS);
+    REQUIRE(dll::etl_counter_kind("evaluate:direct") == dll::ETL_EVALUATIONS);
+    REQUIRE(dll::etl_counter_kind("other") == dll::etl_counter_kinds);
+
+    auto dataset = mnist::read_dataset_direct<std::vector, etl::fast_dyn_matrix<float, 28 * 28>>(200);
+    REQUIRE(!dataset.training_images.empty());
+
+    mnist::normalize_dataset(dataset);
+
+    auto dbn = std::make_unique<dbn_t>();
+
+    dll::reset_timers();
+
+    dbn->fine_tune(dataset.training_images, dataset.training_labels, 1);
+
+    auto timers = dll::merged_timers();
+
+    auto forward = std::find_if(timers.begin(), timers.end(), [](auto& timer) { return timer.name == dll::layer_timers<0>::forward(); });
+
+    REQUIRE(forward != timers.end());
+
+    // Without ETL_COUNTERS, nothing is collected
+    if (!dll::etl_counters_enabled()) {
+        for (auto value : forward->etl) {
+            REQUIRE(value == 0);
+        }
+    }
+
+    dll::dump_timers_pretty();
+    dll::dump_timers_tree();
+}
+
+namespace {
+
+template <size_t B>
+using tuning_dbn_t = typename dll::dbn_desc<
+    dll::dbn_layers<
+        dll::dense_layer_desc<28 * 28, 50>::layer_t,
+        dll::dense_layer_desc<50, 10, dll::softmax>::layer_t>,
+    dll::batch_size<B>>::dbn_t;
+
+} // end of anonymous namespace
+
+TEST_CASE("unit/dense/tuning/1", "[unit][dense][dbn][mnist][sgd]") {
+    auto dataset = mnist::read_dataset_direct<std::vector, etl::dyn_vector<float>>(200);
+    REQUIRE(!dataset.training_images.empty());
+
+    mnist::normalize_dataset(dataset);
+
+    auto factory = [&dataset](auto batch) {
+        using desc = dll::inmemory_data_generator_desc<dll::batch_size<decltype(batch)::value>, dll::categorical>;
+
+        return dll::make_generator(dataset.training_images, dataset.training_labels, dataset.training_images.size(), 10, desc{});
+    };
+
+    dll::tuning_options options;
+    options.threads = {1, 2};
+
+    auto report = dll::tune_throughput<tuning_dbn_t, 10, 50>(factory, options);
+
+    REQUIRE(report.results.size() == 4);
+    REQUIRE(report.recommended.batch_size > 0);
+    REQUIRE(report.recommended.train > 0.0);
+    REQUIRE(report.recommended.inference > 0.0);
+
+    // Nothing fits in one byte
+    options.memory_limit = 1;
+
+    auto none = dll::tune_throughput<tuning_dbn_t, 10>(factory, options);
+
+    REQUIRE(none.results.size() == 2);
+    REQUIRE(!none.results[0].fits);
+    REQUIRE(none.recommended.batch_size == 0);
+
+    report.dump(std::cout);
+}
+
+TEST_CASE("unit/dense/memory/1", "[unit][dense][dbn][mnist][sgd]") {
+    typedef dll::dbn_desc<
+        dll::dbn_layers<
+            dll::dense_layer_desc<28 * 28, 100>::layer_t,
+            dll::dense_layer_desc<100, 10, dll::softmax>::layer_t>,
+        dll::updater<dll::updater_type::MOMENTUM>, dll::batch_size<20>>::dbn_t dbn_t;
+
+    auto dataset = mnist::read_dataset_direct<std::vector, etl::fast_dyn_matrix<float, 28 * 28>>(200);
+    REQUIRE(!dataset.training_images.empty());
+
+    mnist::normalize_dataset(dataset);
+
+    auto dbn = std::make_unique<dbn_t>();
+
+    REQUIRE(dbn->memory.empty());
+
+    dbn->fine_tune(dataset.training_images, dataset.training_labels, 1);
+
+    auto& memory = dbn->memory;
+
+    REQUIRE(memory.layers.size() == 2);
+
+    REQUIRE(memory.layers[0].parameters == (28 * 28 * 100 + 100) * sizeof(float));
+    REQUIRE(memory.layers[1].parameters == (100 * 10 + 10) * sizeof(float));
+
+    // The input, the output and the errors of the batch
+    REQUIRE(memory.layers[0].context == 20 * (28 * 28 + 100 + 100) * sizeof(float));
+    REQUIRE(memory.layers[1].context == 20 * (100 + 10 + 10) * sizeof(float));
+
+    // The gradients and the momentum of each parameter
+    REQUIRE(memory.layers[0].updater == 2 * memory.layers[0].parameters);
+    REQUIRE(memory.layers[1].updater == 2 * memory.layers[1].parameters);
+
+    // The generator holds the training set
+    REQUIRE(memory.generator >= 200 * 28 * 28 * sizeof(float));
+
+    REQUIRE(memory.total() == memory.layers_total().total() + memory.trainer + memory.generator);
+
+    dbn->display_pretty();
+}
+
+// The element-wise activation layer is computed in place
+TEST_CASE("unit/dense/memory/2", "[unit][dense][dbn][mnist][sgd]") {
+    typedef dll::dbn_desc<
+        dll::dbn_layers<
+            dll::dense_layer_desc<28 * 28, 100, dll::no_activation>::layer_t,
+            dll::activation_layer_desc<dll::function::RELU>::layer_t,
+            dll::dense_layer_desc<100, 10, dll::no_activation>::layer_t,
+            dll::activation_layer_desc<dll::function::SOFTMAX>::layer_t>,
+        dll::updater<dll::updater_type::MOMENTUM>, dll::batch_size<20>>::dbn_t dbn_t;
+
+    auto dataset = mnist::read_dataset_direct<std::vector, etl::fast_dyn_matrix<float, 28 * 28>>(200);
+    REQUIRE(!dataset.training_images.empty());
+
+    mnist::normalize_dataset(dataset);
+
+    auto dbn = std::make_unique<dbn_t>();
+
+    dbn->learning_rate = 0.05;
+
+    auto error = dbn->fine_tune(dataset.training_images, dataset.training_labels, 10);
+    REQUIRE(error < 0.2);
+
+    auto& memory = dbn->memory;
+
+    REQUIRE(memory.layers.size() == 4);
+
+    // The output of the RELU layer is its input
+    REQUIRE(memory.layers[1].context == 20 * (100 + 100) * sizeof(float));
+
+    // The softmax is not computed in place
+    REQUIRE(memory.layers[3].context == 20 * (10 + 10 + 10) * sizeof(float));
+}
+
+TEST_CASE("unit/dense/watcher/async", "[unit][dense][dbn][mnist][sgd]") {
+    typedef dll::dbn_desc<
+        dll::dbn_layers<
+            dll::dense_layer_desc<28 * 28, 100>::layer_t,
+            dll::dense_layer_desc<100, 10, dll::softmax>::layer_t>,
+        dll::batch_size<20>, dll::watcher<dll::async_dbn_watcher>>::dbn_t dbn_t;
+
+    auto dataset = mnist::read_dataset_direct<std::vector, etl::fast_dyn_matrix<float, 28 * 28>>(400);
+    REQUIRE(!dataset.training_images.empty());
+
+    mnist::normalize_dataset(dataset);
+
+    auto dbn = std::make_unique<dbn_t>();
+
+    dbn->learning_rate = 0.1;
+
+    using watcher_t = dll::async_dbn_watcher<dbn_t>;
+
+    watcher_t::interval_ms = 1;
+    watcher_t::file        = "unit_dense_watcher_async.json";
+
+    FT_CHECK(25, 5e-2);
+    TEST_CHECK(0.3);
+
+    watcher_t::interval_ms = 1000;
+    watcher_t::file.clear();
+
+    // Each epoch is flushed in the report file
+    std::ifstream report("unit_dense_watcher_async.json");
+    REQUIRE(report);
+
+    size_t lines = 0;
+    std::string line;
+
+    while (std::getline(report, line)) {
+        REQUIRE(line.find("\"epoch\": ") != std::string::npos);
+        ++lines;
+    }
+
+    REQUIRE(lines >= 25);
+}
+
+// Samples in standard containers are converted in bulk into the generator
+TEST_CASE("unit/dense/sgd/std", "[unit][dense][dbn][mnist][sgd]") {
+    typedef dll::dbn_desc<
+        dll::dbn_layers<
+            dll::dense_layer_desc<28 * 28, 150>::layer_t,
+            dll::dense_layer_desc<150, 10>::layer_t>,
+        dll::trainer<dll::sgd_trainer>, dll::batch_size<10>, dll::normalize_pre>::dbn_t dbn_t;
+
+    auto dataset = mnist::read_dataset_direct<std::vector, std::vector<float>>(350);
+    REQUIRE(!dataset.training_images.empty());
+
+    auto dbn = std::make_unique<dbn_t>();
+
+    dbn->learning_rate = 0.03;
+
+    auto ft_error = dbn->fine_tune(dataset.training_images.begin(), dataset.training_images.end(), dataset.training_labels.begin(), dataset.training_labels.end(), 50);
+    std::cout << "ft_error:" << ft_error << std::endl;
+    CHECK(ft_error < 5e-2);
+
+    TEST_CHECK(0.3);
+}
+
+// The categorical labels are stored as class indices
+TEST_CASE("unit/dense/sgd/compact", "[unit][dense][dbn][mnist][sgd]") {
+    using dbn_t = dll::dbn_desc<
+        dll::dbn_layers<
+            dll::dense_layer_desc<28 * 28, 10, dll::softmax>::layer_t>,
+        dll::batch_size<20>
+    >::dbn_t;
+
+    auto dataset = mnist::read_dataset_direct<std::vector, etl::fast_dyn_matrix<float, 28 * 28>>(1000);
+    REQUIRE(!dataset.training_images.empty());
+
+    auto generator = dll::make_generator(
+        dataset.training_images, dataset.training_labels, 10,
+        dll::inmemory_data_generator_desc<dll::batch_size<20>, dll::categorical, dll::compact_labels, dll::normalize_pre>{});
+
+    REQUIRE(etl::dimensions(generator->label_cache) == 1);
+    REQUIRE(etl::size(generator->label_cache) == dataset.training_labels.size());
+
+    // The batches are still categorical
+    auto labels = generator->label_batch();
+    REQUIRE(etl::dim<1>(labels) == 10);
+    REQUIRE(etl::sum(labels) == 20.0f);
+    REQUIRE(labels(0, dataset.training_labels[0]) == 1.0f);
+
+    auto dbn = std::make_unique<dbn_t>();
+
+    dbn->learning_rate = 0.03;
+
+    auto ft_error = dbn->fine_tune(*generator, 50);
+    std::cout << "ft_error:" << ft_error << std::endl;
+    CHECK(ft_error < 5e-2);
+}
+
+// The preprocessed dataset is reused from its snapshot
+TEST_CASE("unit/dense/sgd/snapshot", "[unit][dense][dbn][mnist][sgd]") {
+    using dbn_t = dll::dbn_desc<
+        dll::dbn_layers<
+            dll::dense_layer_desc<28 * 28, 10, dll::softmax>::layer_t>,
+        dll::batch_size<20>
+    >::dbn_t;
+
+    dll::dataset_snapshots::directory = ".";
+
+    auto first   = dll::make_mnist_dataset_sub(0, 1000, dll::normalize_pre{}, dll::batch_size<20>{});
+    auto dataset = dll::make_mnist_dataset_sub(0, 1000, dll::normalize_pre{}, dll::batch_size<20>{});
+
+    dll::dataset_snapshots::directory.clear();
+
+    REQUIRE(dataset.train().size() == 1000);
+    REQUIRE(etl::approx_equals(dataset.train().input_cache, first.train().input_cache, 1e-6));
+    REQUIRE(etl::approx_equals(dataset.train().label_cache, first.train().label_cache, 1e-6));
+    REQUIRE(etl::approx_equals(dataset.test().input_cache, first.test().input_cache, 1e-6));
+
+    auto dbn = std::make_unique<dbn_t>();
+
+    dbn->learning_rate = 0.03;
+
+    FT_CHECK_DATASET(50, 5e-2);
+    TEST_CHECK_DATASET(0.3);
+}
+
+// The fused softmax and cross-entropy matches the separate computations
+TEST_CASE("unit/dense/softmax_cce/1", "[unit][dense][sgd]") {
+    etl::fast_matrix<float, 4, 7> logits;
+    etl::fast_matrix<float, 4, 7> labels;
+    etl::fast_matrix<float, 4, 7> errors;
+
+    logits = etl::normal_generator<float>(0.0, 3.0);
+    labels = 0.0f;
+
+    for (size_t i = 0; i < 4; ++i) {
+        labels(i, (i * 3) % 7) = 1.0f;
+    }
+
+    etl::fast_matrix<float, 4, 7> probs;
+    probs = etl::stable_softmax(logits);
+
+    const double loss  = etl::ml::cce_loss(probs, labels, -1.0);
+    const double error = etl::ml::cce_error(probs, labels, 1.0);
+
+    auto metrics = dll::softmax_cce(logits, labels, errors, 4);
+
+    REQUIRE(etl::approx_equals(logits, probs, 1e-5));
+    REQUIRE(etl::approx_equals(errors, labels - probs, 1e-5));
+    REQUIRE(metrics.first == Approx(error));
+    REQUIRE(metrics.second == Approx(loss).epsilon(1e-4));
+
+    // The loss remains finite when the probability of the label underflows
+
+    etl::fast_matrix<float, 1, 3> big_logits = {1000.0f, -1000.0f, 0.0f};
+    etl::fast_matrix<float, 1, 3> big_labels = {0.0f, 1.0f, 0.0f};
+    etl::fast_matrix<float, 1, 3> big_errors;
+
+    auto big_metrics = dll::softmax_cce(big_logits, big_labels, big_errors, 1);
+
+    REQUIRE(big_metrics.first == 1.0);
+    REQUIRE(big_metrics.second == Approx(2000.0));
+    REQUIRE(big_logits(0, 0) == Approx(1.0f));
+    REQUIRE(big_errors(0, 1) == Approx(1.0f));
+}
+
+// The fused MSE and BCE kernels match the separate computations
+TEST_CASE("unit/dense/fused_losses/1", "[unit][dense][sgd]") {
+    etl::fast_matrix<float, 4, 7> output;
+    etl::fast_matrix<float, 4, 7> labels;
+    etl::fast_matrix<float, 4, 7> errors;
+
+    output = etl::uniform_generator<float>(0.0, 1.0);
+    labels = etl::uniform_generator<float>(0.0, 1.0);
+
+    // Some outputs must be clipped by the BCE
+    output(0, 0) = 0.0f;
+    output(1, 1) = 1.0f;
+
+    auto mse = dll::fused_loss_errors<dll::loss_function::MEAN_SQUARED_ERROR, true>(output, labels, errors, 4);
+
+    REQUIRE(etl::approx_equals(errors, 2.0f * (labels - output), 1e-5));
+    REQUIRE(mse.first == Approx(etl::asum(labels - output)).epsilon(1e-4));
+    REQUIRE(mse.second == Approx(0.5 * etl::sum((output - labels) >> (output - labels))).epsilon(1e-4));
+
+    etl::fast_matrix<float, 4, 7> out;
+    out = etl::clip(output, 0.001, 0.999);
+
+    auto bce = dll::fused_loss_errors<dll::loss_function::BINARY_CROSS_ENTROPY, true>(output, labels, errors, 4);
+
+    REQUIRE(etl::approx_equals(errors, (labels - out) / ((1.0 - out) >> out), 1e-3));
+    REQUIRE(bce.first == Approx(etl::asum(labels - output) / 7.0).epsilon(1e-4));
+    REQUIRE(bce.second == Approx(-etl::sum((labels >> log(out)) + ((1.0 - labels) >> log(1.0 - out))) / 7.0).epsilon(1e-4));
+
+    // Only the rows of a partial batch are computed
+
+    errors = 42.0f;
+
+    dll::fused_loss_errors<dll::loss_function::MEAN_SQUARED_ERROR, false>(output, etl::slice(labels, 0, 2), errors, 2);
+
+    REQUIRE(errors(1, 6) == Approx(2.0f * (labels(1, 6) - output(1, 6))));
+    REQUIRE(errors(2, 0) == 42.0f);
+}
+
+// A single rank of the distributed trainer trains like the SGD trainer
+TEST_CASE("unit/dense/sgd/distributed", "[unit][dense][dbn][mnist][sgd]") {
+    typedef dll::dbn_desc<
+        dll::dbn_layers<
+            dll::dense_layer_desc<28 * 28, 150>::layer_t,
+            dll::dense_layer_desc<150, 10, dll::softmax>::layer_t>,
+        dll::trainer<dll::distributed_sgd_trainer>, dll::transport<dll::local_transport>, dll::batch_size<10>>::dbn_t dbn_t;
+
+    auto dataset = mnist::read_dataset_direct<std::vector, etl::fast_dyn_matrix<float, 28 * 28>>(350);
+    REQUIRE(!dataset.training_images.empty());
+
+    mnist::normalize_dataset(dataset);
+
+    // The shard of the only rank is the complete dataset
+    auto shard = dll::shard_range(dll::local_transport{}, dataset.training_images.size());
+
+    REQUIRE(shard.first == 0);
+    REQUIRE(shard.second == dataset.training_images.size());
+
+    auto dbn = std::make_unique<dbn_t>();
+
+    dbn->learning_rate = 0.03;
+
+    FT_CHECK(50, 5e-2);
+    TEST_CHECK(0.3);
+}
+
+// The gradients compressed with top-k (error feedback) and int8
+TEST_CASE("unit/dense/sgd/distributed_compression", "[unit][dense][dbn][mnist][sgd]") {
+    typedef dll::dbn_desc<
+        dll::dbn_layers<
+            dll::dense_layer_desc<28 * 28, 150>::layer_t,
+            dll::dense_layer_desc<150, 10, dll::softmax>::layer_t>,
+        dll::trainer<dll::distributed_sgd_trainer>, dll::transport<dll::local_transport>, dll::batch_size<10>>::dbn_t dbn_t;
+
+    auto dataset = mnist::read_dataset_direct<std::vector, etl::fast_dyn_matrix<float, 28 * 28>>(350);
+    REQUIRE(!dataset.training_images.empty());
+
+    mnist::normalize_dataset(dataset);
+
+    auto dbn = std::make_unique<dbn_t>();
+
+    dbn->learning_rate = 0.03;
+
+    dbn->gradient_compression[0].method = dll::grad_compression::TOP_K;
+    dbn->gradient_compression[0].ratio  = 0.1;
+    dbn->gradient_compression[1].method = dll::grad_compression::INT8;
+
+    // The payloads are smaller than the full gradients
+    REQUIRE(dll::compressed_bytes<float>(dbn->gradient_compression[0], 28 * 28 * 150 + 150, 2) < (28 * 28 * 150 + 150) * sizeof(float));
+    REQUIRE(dll::compressed_bytes<float>(dbn->gradient_compression[1], 150 * 10 + 10, 2) < (150 * 10 + 10) * sizeof(float));
+
+    FT_CHECK(50, 8e-2);
+    TEST_CHECK(0.35);
+}
+
+// The gradients and the state of the updater in contiguous buffers
+TEST_CASE("unit/dense/sgd/flat", "[unit][dense][dbn][mnist][sgd]") {
+    typedef dll::dbn_desc<
+        dll::dbn_layers<
+            dll::dense_layer_desc<28 * 28, 100>::layer_t,
+            dll::dense_layer_desc<100, 10, dll::softmax>::layer_t>,
+        dll::trainer<dll::sgd_trainer>, dll::updater<dll::updater_type::ADAM>, dll::flat_parameters, dll::batch_size<20>>::dbn_t dbn_t;
+
+    auto dataset = mnist::read_dataset_direct<std::vector, etl::fast_dyn_matrix<float, 28 * 28>>(350);
+    REQUIRE(!dataset.training_images.empty());
+
+    mnist::normalize_dataset(dataset);
+
+    auto dbn = std::make_unique<dbn_t>();
+
+    dbn->learning_rate = 0.005;
+
+    {
+        dll::sgd_trainer<dbn_t> trainer(*dbn);
+
+        // The gradients and the two moments of Adam
+        REQUIRE(trainer.flat->size(0) >= 28 * 28 * 100 + 100 + 100 * 10 + 10);
+        REQUIRE(trainer.flat->size(1) == trainer.flat->size(0));
+        REQUIRE(trainer.flat->size(2) == trainer.flat->size(0));
+        REQUIRE(trainer.flat->size(3) == 0);
+
+        auto& w_ctx = *std::get<0>(std::get<0>(trainer.full_context).second->up.context);
+
+        REQUIRE(w_ctx.grad.memory_start() >= trainer.flat->data(0));
+        REQUIRE(w_ctx.grad.memory_start() < trainer.flat->data(0) + trainer.flat->size(0));
+        REQUIRE(w_ctx.m.memory_start() - trainer.flat->data(1) == w_ctx.grad.memory_start() - trainer.flat->data(0));
+    }
+
+    FT_CHECK(50, 5e-2);
+    TEST_CHECK(0.3);
+}
+
+TEST_CASE("unit/dense/sgd/huge_pages", "[unit][dense][dbn][mnist][sgd]") {
+    typedef dll::dbn_desc<
+        dll::dbn_layers<
+            dll::dense_layer_desc<28 * 28, 1000>::layer_t,
+            dll::dense_layer_desc<1000, 10, dll::softmax>::layer_t>,
+        dll::trainer<dll::sgd_trainer>, dll::updater<dll::updater_type::ADAM>, dll::flat_parameters, dll::batch_size<20>>::dbn_t dbn_t;
+
+    auto previous = dll::execution();
+
+    dll::execution().huge_pages = dll::huge_page_size;
+
+    {
+        // Small buffers stay on the heap
+        dll::huge_buffer<float> small(100);
+
+        REQUIRE(small);
+        REQUIRE(!small.huge());
+
+        dll::huge_buffer<float> large(dll::huge_page_size);
+
+        REQUIRE(large);
+        REQUIRE(reinterpret_cast<std::uintptr_t>(large.get()) % dll::huge_page_size == 0);
+        REQUIRE(large.get()[0] == 0.0f);
+        REQUIRE(large.get()[dll::huge_page_size - 1] == 0.0f);
+    }
+
+    auto dataset = mnist::read_dataset_direct<std::vector, etl::fast_dyn_matrix<float, 28 * 28>>(350);
+    REQUIRE(!dataset.training_images.empty());
+
+    mnist::normalize_dataset(dataset);
+
+    auto dbn = std::make_unique<dbn_t>();
+
+    dbn->learning_rate = 0.005;
+
+    {
+        dll::sgd_trainer<dbn_t> trainer(*dbn);
+
+        // The gradients are large enough for huge pages
+        REQUIRE(reinterpret_cast<std::uintptr_t>(trainer.flat->data(0)) % dll::huge_page_size == 0);
+    }
+
+    FT_CHECK(25, 5e-2);
+    TEST_CHECK(0.3);
+
+    dll::execution() = previous;
+}
+
+// The training error of the epochs accumulated from the batches
+TEST_CASE("unit/dense/sgd/running_error", "[unit][dense][dbn][mnist][sgd]") {
+    typedef dll::dbn_desc<
+        dll::dbn_layers<
+            dll::dense_layer_desc<28 * 28, 100>::layer_t,
+            dll::dense_layer_desc<100, 10, dll::softmax>::layer_t>,
+        dll::trainer<dll::sgd_trainer>, dll::updater<dll::updater_type::MOMENTUM>, dll::running_error, dll::batch_size<10>>::dbn_t dbn_t;
+
+    auto dataset = mnist::read_dataset_direct<std::vector, etl::fast_dyn_matrix<float, 28 * 28>>(350);
+    REQUIRE(!dataset.training_images.empty());
+
+    mnist::normalize_dataset(dataset);
+
+    auto dbn = std::make_unique<dbn_t>();
+
+    dbn->learning_rate = 0.05;
+
+    FT_CHECK(50, 5e-2);
+    TEST_CHECK(0.3);
+}
+
+// Each epoch validated on a snapshot while the next one is trained
+TEST_CASE("unit/dense/sgd/async_validation", "[unit][dense][dbn][mnist][sgd]") {
+    using network_t = dll::network_desc<
+        dll::network_layers<
+            dll::dense_layer_desc<28 * 28, 100>::layer_t,
+            dll::dense_layer_desc<100, 10, dll::softmax>::layer_t>,
+        dll::updater<dll::updater_type::MOMENTUM>, dll::async_validation, dll::batch_size<25>>::network_t;
+
+    auto dataset = dll::make_mnist_dataset_val(0, 1000, 2000, dll::batch_size<25>{}, dll::scale_pre<255>{});
+
+    auto net = std::make_unique<network_t>();
+
+    net->learning_rate = 0.05;
+
+    FT_CHECK_2_VAL(net, dataset, 30, 5e-2);
+    TEST_CHECK_2(net, dataset, 0.25);
+}
+
+// Early stopping on a subset of the validation set
+TEST_CASE("unit/dense/sgd/validation_subset", "[unit][dense][dbn][mnist][sgd]") {
+    using network_t = dll::network_desc<
+        dll::network_layers<
+            dll::dense_layer_desc<28 * 28, 100>::layer_t,
+            dll::dense_layer_desc<100, 10, dll::softmax>::layer_t>,
+        dll::updater<dll::updater_type::MOMENTUM>, dll::early_stopping<dll::strategy::ERROR_BEST>, dll::batch_size<25>>::network_t;
+
+    auto dataset = dll::make_mnist_dataset_val(0, 1000, 2000, dll::batch_size<25>{}, dll::scale_pre<255>{});
+
+    auto net = std::make_unique<network_t>();
+
+    net->learning_rate          = 0.05;
+    net->patience               = 5;
+    net->validation_subset      = 200;
+    net->validation_full_epochs = 5;
+
+    FT_CHECK_2_VAL(net, dataset, 30, 5e-2);
+    TEST_CHECK_2(net, dataset, 0.25);
+}
+
+// Frozen first layer
+TEST_CASE("unit/dense/sgd/frozen", "[unit][dense][dbn][mnist][sgd]") {
+    using network_t = dll::network_desc<
+        dll::network_layers<
+            dll::dense_layer_desc<28 * 28, 100>::layer_t,
+            dll::dense_layer_desc<100, 100>::layer_t,
+            dll::dense_layer_desc<100, 10, dll::softmax>::layer_t>,
+        dll::updater<dll::updater_type::MOMENTUM>, dll::batch_size<25>>::network_t;
+
+    auto dataset = dll::make_mnist_dataset_sub(0, 1000, dll::batch_size<25>{}, dll::scale_pre<255>{});
+
+    auto net = std::make_unique<network_t>();
+
+    net->learning_rate = 0.05;
+
+    // Only the last layer is trained
+
+    net->frozen.set(0);
+    net->frozen.set(1);
+
+    auto w_0 = net->template layer_get<0>().w;
+    auto w_1 = net->template layer_get<1>().w;
+    auto w_2 = net->template layer_get<2>().w;
+
+    FT_CHECK_2(net, dataset, 30, 0.3);
+
+    REQUIRE(etl::max(etl::abs(net->template layer_get<0>().w - w_0)) == 0.0f);
+    REQUIRE(etl::max(etl::abs(net->template layer_get<1>().w - w_1)) == 0.0f);
+    REQUIRE(etl::max(etl::abs(net->template layer_get<2>().w - w_2)) > 0.0f);
+
+    // A frozen layer in the middle is still backpropagated
+
+    net->frozen.reset();
+    net->frozen.set(1);
+
+    w_0 = net->template layer_get<0>().w;
+
+    FT_CHECK_2(net, dataset, 10, 0.2);
+
+    REQUIRE(etl::max(etl::abs(net->template layer_get<1>().w - w_1)) == 0.0f);
+    REQUIRE(etl::max(etl::abs(net->template layer_get<0>().w - w_0)) > 0.0f);
+}
+
+// Head trained from the cached features of the frozen layers
+TEST_CASE("unit/dense/sgd/feature_cache", "[unit][dense][dbn][mnist][sgd]") {
+    using network_t = dll::network_desc<
+        dll::network_layers<
+            dll::dense_layer_desc<28 * 28, 100>::layer_t,
+            dll::dense_layer_desc<100, 100>::layer_t,
+            dll::dense_layer_desc<100, 10, dll::softmax>::layer_t>,
+        dll::updater<dll::updater_type::MOMENTUM>, dll::batch_size<25>>::network_t;
+
+    auto dataset = dll::make_mnist_dataset_sub(0, 1000, dll::batch_size<25>{}, dll::scale_pre<255>{});
+
+    auto net = std::make_unique<network_t>();
+
+    net->learning_rate = 0.05;
+
+    net->frozen.set(0);
+    net->frozen.set(1);
+
+    net->feature_cache.enabled  = true;
+    net->feature_cache.encoding = dll::model_encoding::BF16;
+
+    auto w_0 = net->template layer_get<0>().w;
+    auto w_1 = net->template layer_get<1>().w;
+
+    dll::reset_timers();
+
+    FT_CHECK_2(net, dataset, 30, 0.3);
+
+    REQUIRE(etl::max(etl::abs(net->template layer_get<0>().w - w_0)) == 0.0f);
+    REQUIRE(etl::max(etl::abs(net->template layer_get<1>().w - w_1)) == 0.0f);
+
+    // The frozen layers are only forwarded once, to build the cache
+    auto timers = dll::merged_timers();
+
+    auto build = std::find_if(timers.begin(), timers.end(), [](auto& timer) { return std::string(timer.name) == "net:feature_cache:build"; });
+
+    REQUIRE(build != timers.end());
+}
+
+// Combined backward pass against the separate products
+TEST_CASE("unit/dense/backward/fused", "[unit][dense]") {
+    constexpr size_t B = 300;
+    constexpr size_t V = 700;
+    constexpr size_t H = 50;
+
+    etl::dyn_matrix<float, 2> input(B, V);
+    etl::dyn_matrix<float, 2> errors(B, H);
+    etl::dyn_matrix<float, 2> w(V, H);
+
+    input  = etl::uniform_generator(-1.0, 1.0);
+    errors = etl::uniform_generator(-1.0, 1.0);
+    w      = etl::uniform_generator(-1.0, 1.0);
+
+    etl::dyn_matrix<float, 2> output(B, V);
+    etl::dyn_matrix<float, 2> w_grad(V, H);
+    etl::dyn_matrix<float, 1> b_grad(H);
+
+    dll::dense_backward<float>::backward(input.memory_start(), errors.memory_start(), w.memory_start(),
+                                         output.memory_start(), w_grad.memory_start(), b_grad.memory_start(), B, V, H);
+
+    etl::dyn_matrix<float, 2> ref_output(B, V);
+    etl::dyn_matrix<float, 2> ref_w_grad(V, H);
+    etl::dyn_matrix<float, 1> ref_b_grad(H);
+
+    ref_output = errors * etl::transpose(w);
+    ref_w_grad = etl::transpose(input) * errors;
+    ref_b_grad = etl::bias_batch_sum_2d(errors);
+
+    REQUIRE(etl::max(etl::abs(output - ref_output)) < 1e-3);
+    REQUIRE(etl::max(etl::abs(w_grad - ref_w_grad)) < 1e-3);
+    REQUIRE(etl::max(etl::abs(b_grad - ref_b_grad)) < 1e-3);
+
+    // Without the errors of the inputs (first layer) and the biases
+
+    w_grad = 0;
+
+    dll::dense_backward<float>::backward(input.memory_start(), errors.memory_start(), w.memory_start(),
+                                         nullptr, w_grad.memory_start(), nullptr, B, V, H);
+
+    REQUIRE(etl::max(etl::abs(w_grad - ref_w_grad)) < 1e-3);
+}
+
+// The batched test set gives the same error as the predictor
+TEST_CASE("unit/dense/test_set/batch", "[unit][dense][dbn][mnist][sgd]") {
+    typedef dll::dbn_desc<
+        dll::dbn_layers<
+            dll::dense_layer_desc<28 * 28, 100>::layer_t,
+            dll::dense_layer_desc<100, 10, dll::activation<dll::function::SOFTMAX>>::layer_t>,
+        dll::trainer<dll::sgd_trainer>, dll::batch_size<16>>::dbn_t dbn_t;
+
+    auto dataset = mnist::read_dataset_direct<std::vector, etl::fast_dyn_matrix<float, 28 * 28>>(350);
+    REQUIRE(!dataset.training_images.empty());
+
+    mnist::binarize_dataset(dataset);
+
+    auto dbn = std::make_unique<dbn_t>();
+
+    FT_CHECK(10, 5e-2);
+
+    // 350 samples are not a multiple of the batch size
+    auto error = dll::test_set(dbn, dataset.training_images, dataset.training_labels, dll::predictor());
+
+    REQUIRE(dll::test_set_batch(dbn, dataset.training_images, dataset.training_labels) == Approx(error));
+    REQUIRE(dll::test_set_batch(dbn, dataset.training_images, dataset.training_labels, true) == Approx(error));
+}
+
+// Adam with decoupled weight decay (AdamW)
+TEST_CASE("unit/dense/sgd/adamw", "[unit][dense][dbn][mnist][sgd]") {
+    typedef dll::dbn_desc<
+        dll::dbn_layers<
+            dll::dense_layer_desc<28 * 28, 100>::layer_t,
+            dll::dense_layer_desc<100, 10, dll::softmax>::layer_t>,
+        dll::trainer<dll::sgd_trainer>, dll::updater<dll::updater_type::ADAM>,
+        dll::weight_decay<dll::decay_type::DECOUPLED>, dll::batch_size<20>>::dbn_t dbn_t;
+
+    auto dataset = mnist::read_dataset_direct<std::vector, etl::fast_dyn_matrix<float, 28 * 28>>(350);
+    REQUIRE(!dataset.training_images.empty());
+
+    mnist::normalize_dataset(dataset);
+
+    auto dbn = std::make_unique<dbn_t>();
+
+    dbn->learning_rate  = 0.005;
+    dbn->l2_weight_cost = 0.01;
+
+    FT_CHECK(50, 5e-2);
+    TEST_CHECK(0.3);
+}
+
+TEST_CASE("unit/dense/sgd/gpu_prefetch", "[unit][dense][dbn][mnist][sgd]") {
+    using dbn_t = dll::dbn_desc<
+        dll::dbn_layers<
+            dll::dense_layer_desc<28 * 28, 10, dll::softmax>::layer_t>,
+        dll::batch_size<20>
+    >::dbn_t;
+
+    auto dataset = mnist::read_dataset_direct<std::vector, etl::fast_dyn_matrix<float, 28 * 28>>(1000);
+    REQUIRE(!dataset.training_images.empty());
+
+    auto generator = dll::make_generator(
+        dataset.training_images, dataset.training_labels, 10,
+        dll::inmemory_data_generator_desc<dll::batch_size<20>, dll::categorical, dll::gpu_prefetch, dll::normalize_pre>{});
+
+    // The prefetched batches are the same as the batches of the cache
+    auto batch = generator->data_batch();
+    REQUIRE(etl::dim<0>(batch) == 20);
+    REQUIRE(batch(3)(42) == generator->input_cache(3)(42));
+
+    auto dbn = std::make_unique<dbn_t>();
+
+    dbn->learning_rate = 0.03;
+
+    auto ft_error = dbn->fine_tune(*generator, 50);
+    std::cout << "ft_error:" << ft_error << std::endl;
+    CHECK(ft_error < 5e-2);
+}
+
+TEST_CASE("unit/dense/inference_only", "[unit][dense][dbn]") {
+    using layers_t = dll::dbn_layers<
+        dll::dense_layer_desc<20, 30>::layer_t,
+        dll::dense_layer_desc<30, 5, dll::softmax>::layer_t>;
+
+    using dbn_t       = dll::dbn_desc<layers_t, dll::batch_size<8>>::dbn_t;
+    using inference_t = dll::dbn_desc<layers_t, dll::batch_size<8>, dll::inference_only>::dbn_t;
+
+    static_assert(dll::dbn_traits<inference_t>::inference_only(), "inference_only not detected");
+    static_assert(sizeof(inference_t) < sizeof(dbn_t), "The training state is not removed");
+
+    auto dbn       = std::make_unique<dbn_t>();
+    auto inference = std::make_unique<inference_t>();
+
+    etl::fast_dyn_matrix<float, 8, 20> batch;
+    batch = etl::uniform_generator(-1.0, 1.0);
+
+    std::stringstream weights;
+    dbn->store(weights);
+    inference->load(weights);
+
+    REQUIRE(etl::max(etl::abs(dbn->test_forward_batch(batch) - inference->test_forward_batch(batch))) < 1e-5);
+}
+
+// The inputs of the contexts are the outputs of the previous contexts
+TEST_CASE("unit/dense/sgd/chained_inputs", "[unit][dense][dbn][mnist][sgd]") {
+    typedef dll::dbn_desc<
+        dll::dbn_layers<
+            dll::dense_layer_desc<28 * 28, 100>::layer_t,
+            dll::dense_layer_desc<100, 50>::layer_t,
+            dll::dense_layer_desc<50, 10, dll::softmax>::layer_t>,
+        dll::trainer<dll::sgd_trainer>, dll::updater<dll::updater_type::MOMENTUM>, dll::batch_size<20>>::dbn_t dbn_t;
+
+    auto dataset = mnist::read_dataset_direct<std::vector, etl::fast_dyn_matrix<float, 28 * 28>>(350);
+    REQUIRE(!dataset.training_images.empty());
+
+    mnist::normalize_dataset(dataset);
+
+    auto dbn = std::make_unique<dbn_t>();
+
+    dbn->learning_rate = 0.05;
+
+    if constexpr (!dll::sgd_trainer<dbn_t>::gpu_resident) {
+        dll::sgd_trainer<dbn_t> trainer(*dbn);
+
+        auto& ctx_0 = *std::get<0>(trainer.full_context).second;
+        auto& ctx_1 = *std::get<1>(trainer.full_context).second;
+        auto& ctx_2 = *std::get<2>(trainer.full_context).second;
+
+        REQUIRE(ctx_1.input_storage.chained());
+        REQUIRE(ctx_2.input_storage.chained());
+        REQUIRE(ctx_1.input.memory_start() == ctx_0.output.memory_start());
+        REQUIRE(ctx_2.input.memory_start() == ctx_1.output.memory_start());
+        REQUIRE(ctx_1.input_storage.memory() == 0);
+    }
+
+    FT_CHECK(50, 5e-2);
+    TEST_CHECK(0.3);
+}
+
+// The train and validation sets are views of a single cache
+TEST_CASE("unit/dense/sgd/validation_views", "[unit][dense][dbn][mnist][sgd]") {
+    using network_t = dll::network_desc<
+        dll::network_layers<
+            dll::dense_layer_desc<28 * 28, 100>::layer_t,
+            dll::dense_layer_desc<100, 10, dll::softmax>::layer_t>,
+        dll::updater<dll::updater_type::MOMENTUM>, dll::batch_size<25>>::network_t;
+
+    auto dataset = dll::make_mnist_dataset_val(0, 1000, 2000, dll::batch_size<25>{}, dll::scale_pre<255>{});
+
+    auto& train = dataset.train();
+    auto& val   = dataset.val();
+
+    REQUIRE(train.size() == 1000);
+    REQUIRE(val.size() == 1000);
+    REQUIRE(train.source);
+    REQUIRE(train.source == val.source);
+    REQUIRE(train.source->size() == 2000);
+    REQUIRE(train.memory() < train.source->memory());
+
+    // The samples are gathered from the shared cache
+    REQUIRE(val.data_batch()(3)(0, 14, 14) == train.source->input_cache(1003)(0, 14, 14));
+    REQUIRE(val.label_batch()(3)(2) == train.source->labels()(1003)(2));
+
+    auto net = std::make_unique<network_t>();
+
+    net->learning_rate = 0.05;
+
+    FT_CHECK_2_VAL(net, dataset, 30, 5e-2);
+    TEST_CHECK_2(net, dataset, 0.25);
+}
+
+TEST_CASE("unit/dense/sgd/mapped_mnist", "[unit][dense][dbn][mnist][sgd]") {
+    using network_t = dll::network_desc<
+        dll::network_layers<
+            dll::dense_layer_desc<28 * 28, 100>::layer_t,
+            dll::dense_layer_desc<100, 10, dll::softmax>::layer_t>,
+        dll::updater<dll::updater_type::MOMENTUM>, dll::batch_size<25>>::network_t;
+
+    auto dataset = dll::make_mnist_dataset_sub(100, 1000, dll::batch_size<25>{}, dll::scale_pre<255>{});
+    auto direct  = mnist::read_dataset_direct<std::vector, etl::dyn_matrix<float, 1>>(1100);
+
+    auto& train = dataset.train();
+
+    // The decoded images are scaled and at the right offset
+    REQUIRE(train.input_cache(7)(0, 14, 14) == Approx(direct.training_images[107][14 * 28 + 14] / 255.0f));
+    REQUIRE(train.input_cache(999)(0, 20, 9) == Approx(direct.training_images[1099][20 * 28 + 9] / 255.0f));
+    REQUIRE(train.label_cache(7)(direct.training_labels[107]) == 1.0f);
+
+    auto net = std::make_unique<network_t>();
+
+    net->learning_rate = 0.05;
+
+    FT_CHECK_2(net, dataset, 30, 5e-2);
+    TEST_CHECK_2(net, dataset, 0.25);
+}
+
+TEST_CASE("unit/dense/sgd/pipeline_stages", "[unit][dense][dbn][mnist][sgd]") {
+    typedef dll::dbn_desc<
+        dll::dbn_layers<
+            dll::dense_layer_desc<28 * 28, 100>::layer_t,
+            dll::dense_layer_desc<100, 50>::layer_t,
+            dll::dense_layer_desc<50, 10, dll::softmax>::layer_t>,
+        dll::trainer<dll::sgd_trainer>, dll::updater<dll::updater_type::MOMENTUM>, dll::data_parallel<4>, dll::pipeline_stages<2>, dll::batch_size<20>>::dbn_t dbn_t;
+
+    auto dataset = mnist::read_dataset_direct<std::vector, etl::fast_dyn_matrix<float, 28 * 28>>(350);
+    REQUIRE(!dataset.training_images.empty());
+
+    mnist::normalize_dataset(dataset);
+
+    auto dbn = std::make_unique<dbn_t>();
+
+    dbn->learning_rate = 0.05;
+
+    FT_CHECK(50, 5e-2);
+    TEST_CHECK(0.3);
+}
+
+TEST_CASE("unit/dense/pipeline/1", "[unit][dense][dbn]") {
+    typedef dll::dbn_desc<
+        dll::dbn_layers<
+            dll::dense_layer_desc<20, 30>::layer_t,
+            dll::dense_layer_desc<30, 40>::layer_t,
+            dll::dense_layer_desc<40, 5, dll::softmax>::layer_t>,
+        dll::batch_size<8>>::dbn_t dbn_t;
+
+    auto dbn = std::make_unique<dbn_t>();
+
+    etl::fast_dyn_matrix<float, 13, 20> batch;
+    batch = etl::uniform_generator(-1.0, 1.0);
+
+    auto expected = dbn->forward_batch(batch);
+
+    auto pipeline = dll::make_pipeline<0, 1>(*dbn, 3);
+
+    // The last micro-batch is partial
+    REQUIRE(etl::max(etl::abs(pipeline->forward_batch(batch) - expected)) < 1e-5);
+
+    // The threads of the stages are reused
+    REQUIRE(etl::max(etl::abs(pipeline->forward_batch(batch) - expected)) < 1e-5);
+}
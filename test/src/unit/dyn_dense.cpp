@@ -6,12 +6,16 @@
 //=======================================================================
 
 #include <deque>
+#include <sstream>
 
 #include "dll_test.hpp"
 
+#include "dll/neural/dense_layer.hpp"
 #include "dll/neural/dyn_dense_layer.hpp"
 #include "dll/transform/shape_1d_layer.hpp"
 #include "dll/dbn.hpp"
+#include "dll/runtime_network.hpp"
+#include "dll/util/static_desc.hpp"
 
 #include "mnist/mnist_reader.hpp"
 #include "mnist/mnist_utils.hpp"
@@ -192,3 +196,178 @@ TEST_CASE("unit/dyn_dense/sgd/7", "[unit][dyn_dense][dbn][mnist][sgd]") {
     FT_CHECK(50, 5e-2);
     TEST_CHECK(0.2);
 }
+
+// Test Relu -> Relu -> Relu -> Softmax network with checkpointing
+TEST_CASE("unit/dyn_dense/sgd/8", "[unit][dyn_dense][dbn][mnist][sgd]") {
+    typedef dll::dbn_desc<
+        dll::dbn_layers<
+            dll::dyn_dense_layer_desc<dll::activation<dll::function::RELU>>::layer_t,
+            dll::dyn_dense_layer_desc<dll::activation<dll::function::RELU>>::layer_t,
+            dll::dyn_dense_layer_desc<dll::activation<dll::function::RELU>>::layer_t,
+            dll::dyn_dense_layer_desc<dll::activation<dll::function::SOFTMAX>>::layer_t>,
+        dll::updater<dll::updater_type::MOMENTUM>, dll::checkpoint<2>, dll::trainer<dll::sgd_trainer>, dll::batch_size<10>>::dbn_t dbn_t;
+
+    auto dataset = mnist::read_dataset_direct<std::vector, etl::fast_dyn_matrix<float, 28 * 28>>(500);
+    REQUIRE(!dataset.training_images.empty());
+
+    dll_test::mnist_scale(dataset);
+
+    auto dbn = std::make_unique<dbn_t>();
+
+    dbn->template layer_get<0>().init_layer(28 * 28, 150);
+    dbn->template layer_get<1>().init_layer(150, 150);
+    dbn->template layer_get<2>().init_layer(150, 150);
+    dbn->template layer_get<3>().init_layer(150, 10);
+
+    dbn->initial_momentum = 0.9;
+    dbn->final_momentum   = 0.9;
+    dbn->learning_rate    = 0.01;
+
+    FT_CHECK(50, 5e-2);
+    TEST_CHECK(0.2);
+}
+
+// Test Relu -> Relu -> Relu -> Softmax network with compressed activations
+TEST_CASE("unit/dyn_dense/sgd/9", "[unit][dyn_dense][dbn][mnist][sgd]") {
+    typedef dll::dbn_desc<
+        dll::dbn_layers<
+            dll::dyn_dense_layer_desc<dll::activation<dll::function::RELU>>::layer_t,
+            dll::dyn_dense_layer_desc<dll::activation<dll::function::RELU>>::layer_t,
+            dll::dyn_dense_layer_desc<dll::activation<dll::function::RELU>>::layer_t,
+            dll::dyn_dense_layer_desc<dll::activation<dll::function::SOFTMAX>>::layer_t>,
+        dll::updater<dll::updater_type::MOMENTUM>, dll::compressed_activations, dll::trainer<dll::sgd_trainer>, dll::batch_size<10>>::dbn_t dbn_t;
+
+    auto dataset = mnist::read_dataset_direct<std::vector, etl::fast_dyn_matrix<float, 28 * 28>>(500);
+    REQUIRE(!dataset.training_images.empty());
+
+    dll_test::mnist_scale(dataset);
+
+    auto dbn = std::make_unique<dbn_t>();
+
+    dbn->template layer_get<0>().init_layer(28 * 28, 150);
+    dbn->template layer_get<1>().init_layer(150, 150);
+    dbn->template layer_get<2>().init_layer(150, 150);
+    dbn->template layer_get<3>().init_layer(150, 10);
+
+    dbn->initial_momentum = 0.9;
+    dbn->final_momentum   = 0.9;
+    dbn->learning_rate    = 0.01;
+
+    if constexpr (dll::sgd_trainer<dbn_t>::compressed_activations) {
+        dll::sgd_trainer<dbn_t> trainer(*dbn);
+
+        etl::dyn_matrix<float, 2> inputs(10, 28 * 28);
+
+        for (size_t i = 0; i < 10; ++i) {
+            inputs(i) = dataset.training_images[i];
+        }
+
+        trainer.template forward_batch_helper<true>(inputs);
+
+        // The shared outputs of the RELU layers are only kept as bitmasks and bfloat16
+        auto& ctx_1 = *std::get<1>(trainer.full_context).second;
+
+        REQUIRE(etl::size(ctx_1.output) == 0);
+        REQUIRE(trainer.compressed[1].output_compressed);
+        REQUIRE(trainer.compressed[1].mask.size() == (10 * 150 + 63) / 64);
+        REQUIRE(trainer.compressed[2].input_shared);
+        REQUIRE(trainer.compressed[2].input.size() == 10 * 150);
+    }
+
+    FT_CHECK(50, 5e-2);
+    TEST_CHECK(0.2);
+}
+
+// Test a network composed at runtime
+TEST_CASE("unit/dyn_dense/runtime/1", "[unit][dyn_dense][mnist][sgd]") {
+    auto net = dll::make_runtime_network<float, 10>(
+        "# A simple MLP\n"
+        "dense 784 100 sigmoid\n"
+        "dense 100 10 softmax\n");
+
+    REQUIRE(net);
+    REQUIRE(net->layers.size() == 2);
+    REQUIRE(!dll::make_runtime_network<float, 10>("dense 784 100\ndense 50 10 softmax\n"));
+
+    auto dataset = mnist::read_dataset_direct<std::vector, etl::fast_dyn_matrix<float, 28 * 28>>(350);
+    REQUIRE(!dataset.training_images.empty());
+
+    mnist::binarize_dataset(dataset);
+
+    net->learning_rate = 0.1;
+
+    etl::dyn_matrix<float, 2> inputs(10, 28 * 28);
+    etl::dyn_matrix<float, 2> labels(10, 10);
+
+    double error = 1.0;
+
+    for (size_t epoch = 0; epoch < 25; ++epoch) {
+        error = 0.0;
+
+        for (size_t b = 0; b < dataset.training_images.size() / 10; ++b) {
+            labels = 0.0;
+
+            for (size_t i = 0; i < 10; ++i) {
+                inputs(i) = dataset.training_images[b * 10 + i];
+                labels(i, dataset.training_labels[b * 10 + i]) = 1.0;
+            }
+
+            error += net->train_batch(inputs, labels).first;
+        }
+
+        error /= dataset.training_images.size() / 10;
+    }
+
+    REQUIRE(error < 0.2);
+}
+
+// Test the generation of the equivalent static network
+TEST_CASE("unit/dyn_dense/static/1", "[unit][dyn_dense][dbn][mnist][sgd]") {
+    typedef dll::dbn_desc<
+        dll::dbn_layers<
+            dll::dyn_dense_layer_desc<>::layer_t,
+            dll::dyn_dense_layer_desc<dll::activation<dll::function::SOFTMAX>>::layer_t>,
+        dll::trainer<dll::sgd_trainer>, dll::batch_size<10>>::dbn_t dbn_t;
+
+    // The network generated from dbn_t
+    typedef dll::fast_network_desc<
+        dll::network_layers<
+            dll::dense_layer_desc<784, 100, dll::activation<dll::function::SIGMOID>>::layer_t,
+            dll::dense_layer_desc<100, 10, dll::activation<dll::function::SOFTMAX>>::layer_t>
+        , dll::batch_size<10>
+        , dll::updater<dll::updater_type::SGD>
+        , dll::loss<dll::loss_function::CATEGORICAL_CROSS_ENTROPY>
+        >::network_t static_t;
+
+    auto dataset = mnist::read_dataset_direct<std::vector, etl::fast_dyn_matrix<float, 28 * 28>>(350);
+    REQUIRE(!dataset.training_images.empty());
+
+    mnist::binarize_dataset(dataset);
+
+    auto dbn = std::make_unique<dbn_t>();
+
+    dbn->template layer_get<0>().init_layer(28 * 28, 100);
+    dbn->template layer_get<1>().init_layer(100, 10);
+
+    dbn->learning_rate = 0.1;
+
+    FT_CHECK(25, 5e-2);
+
+    REQUIRE(dll::static_network_desc(*dbn, "static_t") ==
+        "using static_t = dll::fast_network_desc<\n"
+        "    dll::network_layers<\n"
+        "        dll::dense_layer_desc<784, 100, dll::activation<dll::function::SIGMOID>>::layer_t,\n"
+        "        dll::dense_layer_desc<100, 10, dll::activation<dll::function::SOFTMAX>>::layer_t>\n"
+        "    , dll::batch_size<10>\n"
+        "    , dll::updater<dll::updater_type::SGD>\n"
+        "    , dll::loss<dll::loss_function::CATEGORICAL_CROSS_ENTROPY>\n"
+        "    >::network_t;\n");
+
+    std::stringstream weights;
+    dbn->store(weights);
+
+    auto net = std::make_unique<static_t>();
+    net->load(weights);
+
+    REQUIRE(net->evaluate_error(dataset.test_images, dataset.test_labels) == Approx(dbn->evaluate_error(dataset.test_images, dataset.test_labels)));
+}
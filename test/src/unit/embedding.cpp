@@ -142,3 +142,111 @@ TEST_CASE("unit/embedding/2", "[unit][embedding]") {
     REQUIRE(net->fine_tune(samples, labels, 50) < 5e-2);
     REQUIRE(net->evaluate_error(samples, labels) < 5e-2);
 }
+
+// Sparse gradients of the embeddings
+TEST_CASE("unit/embedding/sparse/1", "[unit][embedding]") {
+    etl::fast_matrix<float, 4, 3> input;
+    etl::fast_matrix<float, 4, 3, 5> errors;
+    etl::fast_matrix<float, 10, 5> w;
+
+    input  = etl::uniform_generator(0.0, 9.0);
+    input  = etl::floor(input);
+    errors = etl::normal_generator(0.0, 1.0);
+
+    etl::fast_matrix<float, 10, 5> grad;
+    std::vector<size_t> rows;
+
+    grad = 0;
+
+    // The rows of the previous batch are reset
+    grad(7) = 1.0;
+    rows.push_back(7);
+
+    dll::embedding_row_gradients(grad, rows, input, errors);
+
+    etl::fast_matrix<float, 10, 5> expected;
+    expected = etl::batch_embedding_gradients(input, errors, w);
+
+    REQUIRE(etl::max(etl::abs(grad - expected)) < 1e-5);
+
+    REQUIRE(std::is_sorted(rows.begin(), rows.end()));
+
+    for (size_t b = 0; b < 4; ++b) {
+        for (size_t i = 0; i < 3; ++i) {
+            REQUIRE(std::binary_search(rows.begin(), rows.end(), size_t(input(b, i))));
+        }
+    }
+}
+
+// Batched gather of the embeddings, with duplicated words
+TEST_CASE("unit/embedding/gather/1", "[unit][embedding]") {
+    etl::dyn_matrix<float, 2> input(64, 20);
+    etl::dyn_matrix<float, 2> w(50, 32);
+
+    input = etl::uniform_generator(0.0, 49.0);
+    input = etl::floor(input);
+    w     = etl::normal_generator(0.0, 1.0);
+
+    etl::dyn_matrix<float, 3> output(64, 20, 32);
+    etl::dyn_matrix<float, 3> expected(64, 20, 32);
+
+    dll::embedding_gather(output, input, w);
+
+    expected = etl::batch_embedding_lookup(input, w);
+
+    REQUIRE(etl::max(etl::abs(output - expected)) == 0.0f);
+}
+
+// Embedding trained with sparse updates
+TEST_CASE("unit/embedding/sparse/2", "[unit][embedding]") {
+    std::vector<size_t> labels;
+    auto samples = generate_samples(labels);
+
+    constexpr size_t embedding = 8;
+    constexpr size_t length = 15;
+
+    using embedding_network_t = dll::dyn_network_desc<
+        dll::network_layers<
+            dll::embedding_layer<26, length, embedding>,
+              dll::conv_layer<1, length, embedding, 16, 3, embedding>
+            , dll::mp_2d_layer<16, length - 3 + 1, 1, length - 3 + 1, 1>
+            , dll::dense_layer<16, 10, dll::softmax>
+        >
+        , dll::updater<dll::updater_type::ADAM>      // Adam
+        , dll::batch_size<50>                        // The mini-batch size
+        , dll::shuffle                               // Shuffle before each epoch
+    >::network_t;
+
+    auto net = std::make_unique<embedding_network_t>();
+
+    REQUIRE(net->fine_tune(samples, labels, 50) < 5e-2);
+    REQUIRE(net->evaluate_error(samples, labels) < 0.25);
+}
+
+// Embedding trained by a parameter server
+TEST_CASE("unit/embedding/param_server/1", "[unit][embedding]") {
+    std::vector<size_t> labels;
+    auto samples = generate_samples(labels);
+
+    constexpr size_t embedding = 8;
+    constexpr size_t length = 15;
+
+    using embedding_network_t = dll::dyn_network_desc<
+        dll::network_layers<
+            dll::embedding_layer<26, length, embedding>,
+              dll::conv_layer<1, length, embedding, 16, 3, embedding>
+            , dll::mp_2d_layer<16, length - 3 + 1, 1, length - 3 + 1, 1>
+            , dll::dense_layer<16, 10, dll::softmax>
+        >
+        , dll::trainer<dll::param_server_trainer>    // Parameter server
+        , dll::workers<2>                            // Two workers
+        , dll::updater<dll::updater_type::ADAGRAD>   // Adagrad
+        , dll::batch_size<50>                        // The mini-batch size
+        , dll::shuffle                               // Shuffle before each epoch
+    >::network_t;
+
+    auto net = std::make_unique<embedding_network_t>();
+
+    REQUIRE(net->fine_tune(samples, labels, 50) < 5e-2);
+    REQUIRE(net->evaluate_error(samples, labels) < 0.25);
+}
@@ -0,0 +1,108 @@
+//=======================================================================
+// Copyright (c) 2014-2017 Baptiste Wicht
+// Distributed under the terms of the MIT License.
+// (See accompanying file LICENSE or copy at
+//  http://opensource.org/licenses/MIT)
+//=======================================================================
+
+#include "dll_test.hpp"
+
+#include "dll/neural/dense_layer.hpp"
+#include "dll/neural/gru_layer.hpp"
+#include "dll/neural/recurrent_last_layer.hpp"
+#include "dll/network.hpp"
+#include "dll/datasets.hpp"
+
+// Simple GRU
+TEST_CASE("unit/gru/1", "[unit][gru]") {
+    auto dataset = dll::make_mnist_dataset_nc_sub(0, 2000, dll::batch_size<100>{}, dll::scale_pre<255>{});
+
+    constexpr size_t time_steps      = 28;
+    constexpr size_t sequence_length = 28;
+    constexpr size_t hidden_units    = 75;
+
+    using network_t = dll::dyn_network_desc<
+        dll::network_layers<
+            dll::gru_layer<time_steps, sequence_length, hidden_units, dll::last_only>,
+            dll::recurrent_last_layer<time_steps, hidden_units>,
+            dll::dense_layer<hidden_units, 10, dll::softmax>
+        >
+        , dll::updater<dll::updater_type::ADAM>      // Adam
+        , dll::batch_size<100>                       // The mini-batch size
+    >::network_t;
+
+    auto net = std::make_unique<network_t>();
+
+    REQUIRE(net->fine_tune(dataset.train(), 30) < 0.15);
+    REQUIRE(net->evaluate_error(dataset.test()) < 0.25);
+}
+
+// Deep GRU with truncation
+TEST_CASE("unit/gru/2", "[unit][gru]") {
+    auto dataset = dll::make_mnist_dataset_nc_sub(0, 1000, dll::batch_size<100>{}, dll::scale_pre<255>{});
+
+    constexpr size_t time_steps      = 28;
+    constexpr size_t sequence_length = 28;
+    constexpr size_t hidden_units    = 30;
+
+    using network_t = dll::network_desc<
+        dll::network_layers<
+            dll::gru_layer<time_steps, sequence_length, hidden_units, dll::truncate<20>>,
+            dll::gru_layer<time_steps, hidden_units, hidden_units, dll::last_only>,
+            dll::recurrent_last_layer<time_steps, hidden_units>,
+            dll::dense_layer<hidden_units, 10, dll::softmax>
+        >
+        , dll::updater<dll::updater_type::ADAM>      // Adam
+        , dll::batch_size<100>                       // The mini-batch size
+    >::network_t;
+
+    auto net = std::make_unique<network_t>();
+
+    REQUIRE(net->fine_tune(dataset.train(), 30) < 0.25);
+    REQUIRE(net->evaluate_error(dataset.test()) < 0.5);
+}
+
+// Fused gates against the separate gates
+TEST_CASE("unit/gru/fused/1", "[unit][gru]") {
+    constexpr size_t time_steps      = 5;
+    constexpr size_t sequence_length = 7;
+    constexpr size_t hidden_units    = 6;
+
+    dll::gru_layer<time_steps, sequence_length, hidden_units> layer;
+
+    layer.b_z = etl::uniform_generator(-1.0, 1.0);
+    layer.b_r = etl::uniform_generator(-1.0, 1.0);
+    layer.b_h = etl::uniform_generator(-1.0, 1.0);
+
+    etl::fast_matrix<float, 4, time_steps, sequence_length> x;
+    etl::fast_matrix<float, 4, time_steps, hidden_units> h;
+
+    x = etl::uniform_generator(-1.0, 1.0);
+
+    layer.forward_batch(h, x);
+
+    for (size_t b = 0; b < 4; ++b) {
+        etl::fast_matrix<float, hidden_units> prev(0.0);
+
+        for (size_t t = 0; t < time_steps; ++t) {
+            etl::fast_matrix<float, 1, sequence_length> x_b;
+            etl::fast_matrix<float, 1, hidden_units> h_b;
+
+            x_b(0) = x(b)(t);
+            h_b(0) = prev;
+
+            etl::fast_matrix<float, 1, hidden_units> a_z = x_b * layer.u_z + h_b * layer.w_z;
+            etl::fast_matrix<float, 1, hidden_units> a_r = x_b * layer.u_r + h_b * layer.w_r;
+            etl::fast_matrix<float, 1, hidden_units> a_h = x_b * layer.u_h;
+            etl::fast_matrix<float, 1, hidden_units> m   = h_b * layer.w_h;
+
+            auto z = etl::force_temporary(etl::sigmoid(a_z(0) + layer.b_z));
+            auto r = etl::force_temporary(etl::sigmoid(a_r(0) + layer.b_r));
+            auto n = etl::force_temporary(etl::tanh(a_h(0) + layer.b_h + (r >> m(0))));
+
+            prev = ((1.0f - z) >> n) + (z >> prev);
+
+            REQUIRE(etl::max(etl::abs(h(b)(t) - prev)) < 1e-4);
+        }
+    }
+}
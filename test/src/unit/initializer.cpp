@@ -219,3 +219,32 @@ TEST_CASE("initializer/he", "[dense][unit][mnist][sgd]") {
 
     TEST_CHECK(0.2);
 }
+
+TEST_CASE("initializer/parallel", "[unit]") {
+    etl::dyn_matrix<float, 2> a(2048, 1024);
+    etl::dyn_matrix<float, 2> b(2048, 1024);
+
+    // The large tensors are filled in parallel, with the same values for the same seed
+
+    dll::set_seed(42);
+    dll::rand_engine().seed(dll::seed());
+
+    dll::init_he::initialize(a, 1024, 2048);
+
+    dll::rand_engine().seed(dll::seed());
+
+    dll::init_he::initialize(b, 1024, 2048);
+
+    REQUIRE(etl::max(etl::abs(a - b)) == 0.0f);
+
+    // The statistics are the ones of the distribution
+
+    REQUIRE(std::abs(etl::mean(a)) < 1e-3);
+    REQUIRE(std::abs(etl::stddev(a) - std::sqrt(2.0 / 1024)) < 1e-3);
+
+    dll::init_uniform<std::ratio<-1, 10>, std::ratio<1, 10>>::initialize(a, 1024, 2048);
+
+    REQUIRE(etl::min(a) >= -0.1f);
+    REQUIRE(etl::max(a) < 0.1f);
+    REQUIRE(std::abs(etl::mean(a)) < 1e-3);
+}
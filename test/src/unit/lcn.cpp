@@ -260,3 +260,25 @@ TEST_CASE("unit/cdbn/lcn/mnist/8", "[cdbn][lcn][svm][unit]") {
     std::cout << "test_error:" << test_error << std::endl;
     REQUIRE(test_error < 0.1);
 }
+
+TEST_CASE("unit/lcn/separable", "[lcn][unit]") {
+    using layer_t = dll::lcn_layer_desc<9>::layer_t;
+
+    etl::fast_dyn_matrix<float, 4, 2, 12, 12> input;
+    etl::fast_dyn_matrix<float, 4, 2, 12, 12> output;
+    etl::fast_dyn_matrix<float, 2, 12, 12> expected;
+
+    input = etl::uniform_generator(-1.0, 1.0);
+
+    layer_t layer;
+    layer.forward_batch(output, input);
+
+    // The separable filter gives the same results as the 2D filter
+    auto w = layer_t::filter<float>(layer.sigma);
+
+    for (size_t b = 0; b < 4; ++b) {
+        dll::lcn_compute(expected, input(b), w, 9, 4);
+
+        REQUIRE(etl::approx_equals(output(b), expected, 1e-4));
+    }
+}
@@ -5,6 +5,8 @@
 //  http://opensource.org/licenses/MIT)
 //=======================================================================
 
+#include <thread>
+
 #include "dll_test.hpp"
 
 #include "dll/neural/dense_layer.hpp"
@@ -13,6 +15,8 @@
 #include "dll/network.hpp"
 #include "dll/datasets.hpp"
 
+#include "mnist/mnist_reader.hpp"
+
 // Simple LSTM
 TEST_CASE("unit/lstm/1", "[unit][lstm]") {
     auto dataset = dll::make_mnist_dataset_nc_sub(0, 2000, dll::batch_size<100>{}, dll::scale_pre<255>{});
@@ -85,3 +89,312 @@ TEST_CASE("unit/lstm/3", "[unit][lstm]") {
     REQUIRE(net->fine_tune(dataset.train(), 50) < 0.5);
     REQUIRE(net->evaluate_error(dataset.test()) < 0.5);
 }
+
+// Fused gates against the separate gates
+TEST_CASE("unit/lstm/fused/1", "[unit][lstm]") {
+    constexpr size_t time_steps      = 5;
+    constexpr size_t sequence_length = 7;
+    constexpr size_t hidden_units    = 6;
+
+    dll::lstm_layer<time_steps, sequence_length, hidden_units> layer;
+
+    etl::fast_matrix<float, 4, time_steps, sequence_length> x;
+    etl::fast_matrix<float, 4, time_steps, hidden_units> h;
+
+    x = etl::uniform_generator(-1.0, 1.0);
+
+    layer.forward_batch(h, x);
+
+    for (size_t b = 0; b < 4; ++b) {
+        etl::fast_matrix<float, hidden_units> s;
+        etl::fast_matrix<float, hidden_units> prev;
+
+        for (size_t t = 0; t < time_steps; ++t) {
+            etl::fast_matrix<float, 1, hidden_units> z_i;
+            etl::fast_matrix<float, 1, hidden_units> z_g;
+            etl::fast_matrix<float, 1, hidden_units> z_f;
+            etl::fast_matrix<float, 1, hidden_units> z_o;
+
+            etl::fast_matrix<float, 1, sequence_length> x_b;
+            etl::fast_matrix<float, 1, hidden_units> h_b;
+
+            x_b(0) = x(b)(t);
+            h_b(0) = prev;
+
+            z_i = x_b * layer.u_i;
+            z_g = x_b * layer.u_g;
+            z_f = x_b * layer.u_f;
+            z_o = x_b * layer.u_o;
+
+            if (t > 0) {
+                z_i += h_b * layer.w_i;
+                z_g += h_b * layer.w_g;
+                z_f += h_b * layer.w_f;
+                z_o += h_b * layer.w_o;
+            }
+
+            auto i = etl::force_temporary(etl::sigmoid(z_i(0) + layer.b_i));
+            auto g = etl::force_temporary(etl::tanh(z_g(0) + layer.b_g));
+            auto f = etl::force_temporary(etl::sigmoid(z_f(0) + layer.b_f));
+            auto o = etl::force_temporary(etl::sigmoid(z_o(0) + layer.b_o));
+
+            if (t == 0) {
+                s    = g >> i;
+                prev = etl::tanh(s) >> o;
+            } else {
+                s    = etl::tanh((g >> i) + (s >> f));
+                prev = s >> o;
+            }
+
+            REQUIRE(etl::max(etl::abs(h(b)(t) - prev)) < 1e-4);
+        }
+    }
+}
+
+// Windowed BPTT
+TEST_CASE("unit/lstm/window/1", "[unit][lstm]") {
+    constexpr size_t time_steps      = 6;
+    constexpr size_t sequence_length = 7;
+    constexpr size_t hidden_units    = 5;
+
+    dll::lstm_layer<time_steps, sequence_length, hidden_units> layer;
+    dll::lstm_layer<time_steps, sequence_length, hidden_units, dll::bptt_window<2>> windowed;
+
+    windowed.w_i = layer.w_i;
+    windowed.u_i = layer.u_i;
+    windowed.b_i = layer.b_i;
+    windowed.w_g = layer.w_g;
+    windowed.u_g = layer.u_g;
+    windowed.b_g = layer.b_g;
+    windowed.w_f = layer.w_f;
+    windowed.u_f = layer.u_f;
+    windowed.b_f = layer.b_f;
+    windowed.w_o = layer.w_o;
+    windowed.u_o = layer.u_o;
+    windowed.b_o = layer.b_o;
+
+    windowed.weights_changed();
+
+    etl::fast_matrix<float, 4, time_steps, sequence_length> x;
+    etl::fast_matrix<float, 4, time_steps, hidden_units> h;
+    etl::fast_matrix<float, 4, time_steps, hidden_units> h_w;
+
+    x = etl::uniform_generator(-1.0, 1.0);
+
+    layer.forward_batch(h, x);
+    windowed.forward_batch(h_w, x);
+
+    // The state is carried between the windows
+    REQUIRE(etl::max(etl::abs(h - h_w)) < 1e-5);
+}
+
+// Windowed BPTT
+TEST_CASE("unit/lstm/window/2", "[unit][lstm]") {
+    auto dataset = dll::make_mnist_dataset_nc_sub(0, 2000, dll::batch_size<100>{}, dll::scale_pre<255>{});
+
+    constexpr size_t time_steps      = 28;
+    constexpr size_t sequence_length = 28;
+    constexpr size_t hidden_units    = 75;
+
+    using network_t = dll::dyn_network_desc<
+        dll::network_layers<
+            dll::lstm_layer<time_steps, sequence_length, hidden_units, dll::last_only, dll::bptt_window<14>>,
+            dll::recurrent_last_layer<time_steps, hidden_units>,
+            dll::dense_layer<hidden_units, 10, dll::softmax>
+        >
+        , dll::updater<dll::updater_type::ADAM>      // Adam
+        , dll::batch_size<100>                       // The mini-batch size
+    >::network_t;
+
+    auto net = std::make_unique<network_t>();
+
+    REQUIRE(net->fine_tune(dataset.train(), 30) < 0.2);
+    REQUIRE(net->evaluate_error(dataset.test()) < 0.3);
+}
+
+TEST_CASE("unit/lstm/session/1", "[unit][lstm]") {
+    constexpr size_t time_steps      = 8;
+    constexpr size_t sequence_length = 6;
+    constexpr size_t hidden_units    = 10;
+
+    using network_t = dll::dyn_network_desc<
+        dll::network_layers<
+            dll::lstm_layer<time_steps, sequence_length, hidden_units, dll::last_only>,
+            dll::recurrent_last_layer<time_steps, hidden_units>,
+            dll::dense_layer<hidden_units, 4, dll::softmax>
+        >
+        , dll::batch_size<16>
+    >::network_t;
+
+    auto net = std::make_unique<network_t>();
+
+    std::vector<etl::fast_dyn_matrix<float, 16, time_steps, sequence_length>> inputs(4);
+    std::vector<etl::fast_dyn_matrix<float, 16, 4>> expected(4);
+    std::vector<etl::fast_dyn_matrix<float, 16, 4>> outputs(4);
+
+    for (size_t i = 0; i < 4; ++i) {
+        inputs[i]   = etl::uniform_generator(-1.0, 1.0);
+        expected[i] = net->forward_batch(inputs[i]);
+    }
+
+    // Each thread forwards its batches with its own session on the same network
+    std::vector<std::thread> threads;
+
+    for (size_t i = 0; i < 4; ++i) {
+        threads.emplace_back([&net, &inputs, &outputs, i]() {
+            network_t::inference_session session(*net);
+
+            for (size_t r = 0; r < 10; ++r) {
+                outputs[i] = session.forward_batch(inputs[i]);
+            }
+        });
+    }
+
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    for (size_t i = 0; i < 4; ++i) {
+        REQUIRE(etl::max(etl::abs(outputs[i] - expected[i])) < 1e-5);
+    }
+}
+
+// Only the last time step is output before recurrent_last
+TEST_CASE("unit/lstm/last/1", "[unit][lstm]") {
+    constexpr size_t time_steps      = 8;
+    constexpr size_t sequence_length = 6;
+    constexpr size_t hidden_units    = 10;
+
+    using network_t = dll::network_desc<
+        dll::network_layers<
+            dll::lstm_layer<time_steps, sequence_length, hidden_units, dll::last_only>,
+            dll::recurrent_last_layer<time_steps, hidden_units>,
+            dll::dense_layer<hidden_units, 4, dll::softmax>
+        >
+        , dll::batch_size<16>
+    >::network_t;
+
+    auto net = std::make_unique<network_t>();
+
+    etl::fast_dyn_matrix<float, 16, time_steps, sequence_length> x;
+    etl::fast_dyn_matrix<float, 16, time_steps, hidden_units> h;
+    etl::fast_dyn_matrix<float, 16, hidden_units> last;
+    etl::fast_dyn_matrix<float, 16, 4> y;
+
+    x = etl::uniform_generator(-1.0, 1.0);
+
+    // The complete sequences, layer by layer
+    net->template layer_get<0>().test_forward_batch(h, x);
+    net->template layer_get<1>().test_forward_batch(last, h);
+    net->template layer_get<2>().test_forward_batch(y, last);
+
+    auto output = net->forward_batch(x);
+
+    REQUIRE(etl::max(etl::abs(output - y)) < 1e-5);
+}
+
+// Variable length sequences against the complete sequences
+TEST_CASE("unit/lstm/variable/1", "[unit][lstm]") {
+    constexpr size_t time_steps      = 6;
+    constexpr size_t sequence_length = 5;
+    constexpr size_t hidden_units    = 4;
+
+    dll::lstm_layer<time_steps, sequence_length, hidden_units> layer;
+    dll::lstm_layer<time_steps, sequence_length, hidden_units, dll::variable_length> var_layer;
+
+    var_layer.w_i = layer.w_i;
+    var_layer.u_i = layer.u_i;
+    var_layer.w_g = layer.w_g;
+    var_layer.u_g = layer.u_g;
+    var_layer.w_f = layer.w_f;
+    var_layer.u_f = layer.u_f;
+    var_layer.w_o = layer.w_o;
+    var_layer.u_o = layer.u_o;
+    var_layer.weights_changed();
+
+    const size_t lengths[4] = {6, 4, 1, 3};
+
+    etl::fast_matrix<float, 4, time_steps, sequence_length> x;
+    etl::fast_matrix<float, 4, time_steps, hidden_units> h;
+    etl::fast_matrix<float, 4, time_steps, hidden_units> h_var;
+    etl::fast_matrix<float, 4, hidden_units> h_last;
+
+    x = etl::uniform_generator(-1.0, 1.0);
+
+    for (size_t b = 0; b < 4; ++b) {
+        for (size_t t = lengths[b]; t < time_steps; ++t) {
+            x(b)(t) = 0;
+        }
+    }
+
+    layer.forward_batch(h, x);
+    var_layer.forward_batch(h_var, x);
+
+    for (size_t b = 0; b < 4; ++b) {
+        for (size_t t = 0; t < time_steps; ++t) {
+            if (t < lengths[b]) {
+                REQUIRE(etl::max(etl::abs(h_var(b)(t) - h(b)(t))) < 1e-5);
+            } else {
+                REQUIRE(etl::max(etl::abs(h_var(b)(t))) == 0.0f);
+            }
+        }
+    }
+
+    // The last step output is the last step of each sequence
+    var_layer.forward_batch(h_last, x);
+
+    for (size_t b = 0; b < 4; ++b) {
+        REQUIRE(etl::max(etl::abs(h_last(b) - h(b)(lengths[b] - 1))) < 1e-5);
+    }
+}
+
+// Variable length sequences, bucketed by length
+TEST_CASE("unit/lstm/variable/2", "[unit][lstm]") {
+    constexpr size_t time_steps      = 28;
+    constexpr size_t sequence_length = 28;
+    constexpr size_t hidden_units    = 50;
+
+    auto dataset = mnist::read_dataset_direct<std::vector, etl::fast_dyn_matrix<float, time_steps, sequence_length>>(1000);
+    REQUIRE(!dataset.training_images.empty());
+
+    // Truncate the images to random lengths
+    std::uniform_int_distribution<size_t> length_dist(14, time_steps);
+
+    for (auto& image : dataset.training_images) {
+        const size_t length = length_dist(dll::random_engine());
+
+        for (size_t t = length; t < time_steps; ++t) {
+            image(t) = 0;
+        }
+    }
+
+    using generator_t = dll::inmemory_data_generator_desc<dll::batch_size<100>, dll::length_bucketing, dll::categorical, dll::scale_pre<255>>;
+
+    auto generator = dll::make_generator(
+        dataset.training_images, dataset.training_labels,
+        dataset.training_images.size(), 10,
+        generator_t{});
+
+    generator->reset_shuffle();
+
+    // The batches are sorted by decreasing length
+    for (size_t i = 1; i < generator->size(); ++i) {
+        if (i % 100) {
+            REQUIRE(generator->lengths[generator->order[i]] <= generator->lengths[generator->order[i - 1]]);
+        }
+    }
+
+    using network_t = dll::dyn_network_desc<
+        dll::network_layers<
+            dll::lstm_layer<time_steps, sequence_length, hidden_units, dll::variable_length, dll::last_only>,
+            dll::recurrent_last_layer<time_steps, hidden_units>,
+            dll::dense_layer<hidden_units, 10, dll::softmax>
+        >
+        , dll::updater<dll::updater_type::ADAM>      // Adam
+        , dll::batch_size<100>                       // The mini-batch size
+    >::network_t;
+
+    auto net = std::make_unique<network_t>();
+
+    REQUIRE(net->fine_tune(*generator, 30) < 0.3);
+}
@@ -204,6 +204,70 @@ TEST_CASE("unit/processor/dense/sgd/1", "[unit][dense][dbn][mnist][sgd][proc]")
     TEST_ERROR_BELOW(0.3);
 }
 
+TEST_CASE("unit/processor/cache/1", "[unit][dense][dbn][mnist][sgd][proc]") {
+    auto opt  = default_options();
+    opt.cache = true;
+
+    auto lines = get_result(opt, {"auto"}, "dense_sgd_1.conf");
+    REQUIRE(!lines.empty());
+
+    FT_ERROR_BELOW(5e-2);
+    TEST_ERROR_BELOW(0.3);
+
+    // The actions are runtime parameters, the cached program is reused
+    lines = get_result(opt, {"train"}, "dense_sgd_1.conf");
+    REQUIRE(!lines.empty());
+
+    FT_ERROR_BELOW(5e-2);
+
+    double test_error = 1.0;
+    REQUIRE(!get_test_error(lines, test_error));
+}
+
+TEST_CASE("unit/processor/profile/1", "[unit][dense][dbn][mnist][sgd][proc]") {
+    auto opt    = default_options();
+    opt.profile = "native";
+
+    auto lines = get_result(opt, {"auto"}, "dense_sgd_1.conf");
+    REQUIRE(!lines.empty());
+
+    FT_ERROR_BELOW(5e-2);
+    TEST_ERROR_BELOW(0.3);
+}
+
+TEST_CASE("unit/processor/dense/sgd/packed", "[unit][dense][dbn][mnist][sgd][proc]") {
+    auto dataset = mnist::read_dataset_direct<std::vector, etl::dyn_matrix<float, 1>>(350);
+    REQUIRE(!dataset.training_images.empty());
+
+    REQUIRE(dll::write_packed_dataset(".tmp.proc.train.dlld", dataset.training_images, dataset.training_labels));
+    REQUIRE(dll::write_packed_dataset(".tmp.proc.test.dlld", dataset.test_images, dataset.test_labels));
+
+    auto lines = get_result(default_options(), {"auto"}, "dense_sgd_packed.conf");
+    REQUIRE(!lines.empty());
+
+    FT_ERROR_BELOW(5e-2);
+    TEST_ERROR_BELOW(0.3);
+}
+
+TEST_CASE("unit/processor/dense/sgd/sweep", "[unit][dense][dbn][mnist][sgd][proc]") {
+    auto lines = get_result(default_options(), {"auto"}, "dense_sgd_sweep.conf");
+    REQUIRE(!lines.empty());
+
+    FT_ERROR_BELOW(5e-2);
+    TEST_ERROR_BELOW(0.3);
+
+    // The summary of the sweep lists each configuration
+    size_t configurations = 0;
+
+    for (auto& line : lines) {
+        if (line.find("| dbn.learning_rate=") != std::string::npos) {
+            ++configurations;
+        }
+    }
+
+    REQUIRE(configurations == 2);
+}
+
 TEST_CASE("unit/processor/dense/sgd/2", "[unit][dense][dbn][mnist][sgd][proc]") {
     auto lines = get_result(default_options(), {"train", "test"}, "dense_sgd_2.conf");
     REQUIRE(!lines.empty());
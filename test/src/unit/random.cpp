@@ -73,3 +73,41 @@ TEST_CASE("unit/cdbn/random/mnist/2", "[cdbn][rectifier][svm][unit]") {
     std::cout << "test_error:" << test_error << std::endl;
     REQUIRE(test_error < 1.0);
 }
+
+TEST_CASE("unit/random/stream/1", "[random][unit]") {
+    dll::random_stream a(1, 2, 3);
+    dll::random_stream b(1, 2, 3);
+    dll::random_stream c(1, 3, 2);
+
+    size_t same = 0;
+
+    for (size_t i = 0; i < 100; ++i) {
+        auto x = a();
+
+        REQUIRE(x == b());
+
+        same += x == c();
+    }
+
+    REQUIRE(same < 5);
+
+    // The bulk generation gives the same numbers as the sequential one
+
+    dll::random_stream d(7);
+    dll::random_stream e(7);
+
+    std::vector<float> values(37);
+
+    d();
+    d.fill_uniform(values.data(), values.size());
+
+    e();
+
+    for (auto v : values) {
+        REQUIRE(v >= 0.0f);
+        REQUIRE(v < 1.0f);
+        REQUIRE(v == dll::random_stream::to_uniform<float>(e()));
+    }
+
+    REQUIRE(d() == e());
+}
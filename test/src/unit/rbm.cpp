@@ -126,6 +126,85 @@ TEST_CASE("unit/rbm/mnist/6", "[rbm][pcd][unit]") {
     }
 }
 
+TEST_CASE("unit/rbm/mnist/pt/1", "[rbm][pt][unit]") {
+    dll::rbm_desc<
+        28 * 28, 100,
+        dll::batch_size<5>,
+        dll::momentum,
+        dll::trainer_rbm<dll::pt_cd_trainer>>::layer_t rbm;
+
+    rbm.pt_chains = 4;
+
+    auto dataset = mnist::read_dataset_direct<std::vector, etl::dyn_vector<float>>(100);
+    REQUIRE(!dataset.training_images.empty());
+
+    mnist::binarize_dataset(dataset);
+
+    auto error = rbm.train(dataset.training_images, 100);
+
+    if (std::isfinite(error)) {
+        REQUIRE(error < 15e-2);
+    }
+}
+
+TEST_CASE("unit/rbm/mnist/data_parallel/1", "[rbm][parallel][unit]") {
+    dll::rbm_desc<
+        28 * 28, 100,
+        dll::batch_size<20>,
+        dll::data_parallel<4>,
+        dll::momentum>::layer_t rbm;
+
+    auto dataset = mnist::read_dataset_direct<std::vector, etl::dyn_vector<float>>(100);
+    REQUIRE(!dataset.training_images.empty());
+
+    mnist::binarize_dataset(dataset);
+
+    auto error = rbm.train(dataset.training_images, 100);
+
+    REQUIRE(error < 5e-2);
+}
+
+TEST_CASE("unit/rbm/mnist/monitor/1", "[rbm][unit]") {
+    dll::rbm_desc<
+        28 * 28, 100,
+        dll::batch_size<10>,
+        dll::momentum>::layer_t rbm;
+
+    // Only gather the statistics of 2 of the 10 batches
+    rbm.monitor_batches = 2;
+
+    auto dataset = mnist::read_dataset_direct<std::vector, etl::dyn_vector<float>>(100);
+    REQUIRE(!dataset.training_images.empty());
+
+    mnist::binarize_dataset(dataset);
+
+    auto error = rbm.train(dataset.training_images, 100);
+
+    REQUIRE(std::isfinite(error));
+    REQUIRE(error < 5e-2);
+}
+
+TEST_CASE("unit/rbm/mnist/early/1", "[rbm][unit]") {
+    dll::rbm_desc<
+        28 * 28, 100,
+        dll::batch_size<10>,
+        dll::momentum,
+        dll::early_stopping<dll::strategy::ERROR_BEST>>::layer_t rbm;
+
+    // Stop when the error does not decrease by 1% for 3 epochs
+    rbm.min_delta = 0.01;
+    rbm.patience  = 3;
+
+    auto dataset = mnist::read_dataset_direct<std::vector, etl::dyn_vector<float>>(100);
+    REQUIRE(!dataset.training_images.empty());
+
+    mnist::binarize_dataset(dataset);
+
+    auto error = rbm.train(dataset.training_images, 100);
+
+    REQUIRE(error < 5e-2);
+}
+
 TEST_CASE("unit/rbm/mnist/7", "[rbm][relu][unit]") {
     dll::rbm_desc<
         28 * 28, 100,
@@ -212,3 +291,81 @@ TEST_CASE("unit/rbm/mnist/10", "[rbm][pcd][unit]") {
         REQUIRE(error < 15e-2);
     }
 }
+
+template <typename RBM>
+using mf_cd3_trainer_t = dll::mean_field_cd_trainer<3, RBM>;
+
+TEST_CASE("unit/rbm/mnist/mean_field", "[rbm][unit]") {
+    dll::rbm_desc<
+        28 * 28, 100,
+        dll::batch_size<10>,
+        dll::momentum,
+        dll::trainer_rbm<mf_cd3_trainer_t>>::layer_t rbm;
+
+    auto dataset = mnist::read_dataset_direct<std::vector, etl::dyn_vector<float>>(100);
+    REQUIRE(!dataset.training_images.empty());
+
+    mnist::binarize_dataset(dataset);
+
+    auto error = rbm.train(dataset.training_images, 100);
+
+    REQUIRE(error < 5e-2);
+}
+
+TEST_CASE("unit/rbm/transposed/1", "[rbm][unit]") {
+    dll::rbm_desc<
+        28 * 28, 100,
+        dll::batch_size<10>,
+        dll::visible<dll::unit_type::GAUSSIAN>>::layer_t rbm;
+
+    etl::fast_matrix<float, 10, 100> h;
+    etl::fast_matrix<float, 10, 28 * 28> v_direct;
+    etl::fast_matrix<float, 10, 28 * 28> v_transposed;
+
+    h = etl::uniform_generator(0.0, 1.0);
+
+    rbm.batch_activate_visible<true, false>(h, h, v_direct, v_direct);
+
+    rbm.prepare_weights();
+    REQUIRE(rbm.transposed_weights);
+
+    rbm.batch_activate_visible<true, false>(h, h, v_transposed, v_transposed);
+
+    rbm.release_weights();
+
+    REQUIRE(etl::max(etl::abs(v_direct - v_transposed)) < 1e-3);
+}
+
+TEST_CASE("unit/rbm/mnist/batch_energy/1", "[rbm][energy][unit]") {
+    dll::rbm_desc<
+        28 * 28, 100,
+        dll::batch_size<10>,
+        dll::momentum>::layer_t rbm;
+
+    auto dataset = mnist::read_dataset_direct<std::vector, etl::dyn_vector<float>>(100);
+    REQUIRE(!dataset.training_images.empty());
+
+    mnist::binarize_dataset(dataset);
+
+    rbm.train(dataset.training_images, 10);
+
+    etl::dyn_matrix<float, 2> v(10, 28 * 28);
+    etl::dyn_matrix<float, 2> h(10, 100);
+
+    for (size_t i = 0; i < 10; ++i) {
+        v(i) = dataset.training_images[i];
+    }
+
+    rbm.batch_activate_hidden(h, v);
+
+    etl::dyn_vector<float> energies(10);
+    etl::dyn_vector<float> free_energies(10);
+
+    rbm.batch_energy(energies, v, h);
+    rbm.batch_free_energy(free_energies, v);
+
+    for (size_t i = 0; i < 10; ++i) {
+        REQUIRE(energies[i] == Approx(rbm.energy(dataset.training_images[i], etl::dyn_vector<float>(h(i)))).epsilon(1e-3));
+        REQUIRE(free_energies[i] == Approx(rbm.free_energy(dataset.training_images[i])).epsilon(1e-3));
+    }
+}
@@ -85,3 +85,53 @@ TEST_CASE("unit/rnn/3", "[unit][rnn]") {
     REQUIRE(net->fine_tune(dataset.train(), 50) < 0.5);
     REQUIRE(net->evaluate_error(dataset.test()) < 0.5);
 }
+
+// Windowed BPTT
+TEST_CASE("unit/rnn/window/1", "[unit][rnn]") {
+    constexpr size_t time_steps      = 6;
+    constexpr size_t sequence_length = 7;
+    constexpr size_t hidden_units    = 5;
+
+    dll::rnn_layer<time_steps, sequence_length, hidden_units> layer;
+    dll::rnn_layer<time_steps, sequence_length, hidden_units, dll::bptt_window<3>> windowed;
+
+    windowed.w = layer.w;
+    windowed.u = layer.u;
+    windowed.b = layer.b;
+
+    etl::fast_matrix<float, 4, time_steps, sequence_length> x;
+    etl::fast_matrix<float, 4, time_steps, hidden_units> s;
+    etl::fast_matrix<float, 4, time_steps, hidden_units> s_w;
+
+    x = etl::uniform_generator(-1.0, 1.0);
+
+    layer.forward_batch(s, x);
+    windowed.forward_batch(s_w, x);
+
+    // The state is carried between the windows
+    REQUIRE(etl::max(etl::abs(s - s_w)) < 1e-5);
+}
+
+// Windowed BPTT
+TEST_CASE("unit/rnn/window/2", "[unit][rnn]") {
+    auto dataset = dll::make_mnist_dataset_nc_sub(0, 2000, dll::batch_size<100>{}, dll::scale_pre<255>{});
+
+    constexpr size_t time_steps      = 28;
+    constexpr size_t sequence_length = 28;
+    constexpr size_t hidden_units    = 75;
+
+    using network_t = dll::dyn_network_desc<
+        dll::network_layers<
+            dll::rnn_layer<time_steps, sequence_length, hidden_units, dll::last_only, dll::bptt_window<14>>,
+            dll::recurrent_last_layer<time_steps, hidden_units>,
+            dll::dense_layer<hidden_units, 10, dll::softmax>
+        >
+        , dll::updater<dll::updater_type::ADAM>      // Adam
+        , dll::batch_size<100>                       // The mini-batch size
+    >::network_t;
+
+    auto net = std::make_unique<network_t>();
+
+    REQUIRE(net->fine_tune(dataset.train(), 30) < 0.2);
+    REQUIRE(net->evaluate_error(dataset.test()) < 0.3);
+}
@@ -0,0 +1,74 @@
+//=======================================================================
+// Copyright (c) 2014-2017 Baptiste Wicht
+// Distributed under the terms of the MIT License.
+// (See accompanying file LICENSE or copy at
+//  http://opensource.org/licenses/MIT)
+//=======================================================================
+
+#include <atomic>
+#include <vector>
+
+#include "dll_test.hpp"
+
+#include "dll/util/scheduler.hpp"
+
+TEST_CASE("unit/scheduler/parallel_for", "[unit][scheduler]") {
+    dll::task_scheduler scheduler(4);
+
+    REQUIRE(scheduler.threads() == 4);
+
+    // Nested regions must complete without blocking the workers
+
+    std::vector<std::atomic<size_t>> hits(64 * 32);
+
+    scheduler.parallel_for(64, [&](size_t i) {
+        scheduler.parallel_for(32, [&](size_t j) {
+            ++hits[i * 32 + j];
+        });
+    });
+
+    for (auto& hit : hits) {
+        REQUIRE(hit == 1);
+    }
+
+    std::vector<size_t> ranges(1000, 0);
+
+    scheduler.parallel_ranges(1000, 100, [&](size_t first, size_t last) {
+        for (size_t i = first; i < last; ++i) {
+            ++ranges[i];
+        }
+    });
+
+    for (auto& range : ranges) {
+        REQUIRE(range == 1);
+    }
+}
+
+TEST_CASE("unit/scheduler/group", "[unit][scheduler]") {
+    std::atomic<size_t> done{0};
+
+    {
+        dll::task_group group;
+
+        for (size_t t = 0; t < 100; ++t) {
+            group.run([&done] { ++done; });
+        }
+
+        group.wait();
+
+        REQUIRE(done == 100);
+
+        group.run([&done] { ++done; });
+    }
+
+    // The group waits for its tasks when destroyed
+    REQUIRE(done == 101);
+
+    // A single thread runs all the tasks itself
+    dll::task_scheduler serial(1);
+
+    size_t sum = 0;
+    serial.parallel_for(10, [&sum](size_t i) { sum += i; });
+
+    REQUIRE(sum == 45);
+}
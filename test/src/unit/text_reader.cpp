@@ -8,6 +8,7 @@
 #include "dll_test.hpp"
 
 #include "dll/text_reader.hpp"
+#include "dll/generators.hpp"
 
 TEST_CASE("unit/text_reader/labels/1", "[unit][reader]") {
     auto labels = dll::text::read_labels<std::vector, uint8_t>("test/text_db/labels", 20);
@@ -124,3 +125,51 @@ TEST_CASE("unit/text_reader/images/5", "[unit][reader]") {
     REQUIRE(samples[7](0, 17, 16) == 9);
     REQUIRE(samples[8](0, 17, 15) == 253);
 }
+
+TEST_CASE("unit/text_reader/stream/1", "[unit][reader]") {
+    auto samples = dll::text::read_images<std::vector, etl::dyn_matrix<float, 1>, false>("test/text_db/images", 20);
+
+    dll::text::image_stream<etl::dyn_matrix<float, 1>> stream("test/text_db/images", 20, 3);
+
+    REQUIRE(stream.size() == 9);
+
+    size_t i = 0;
+    for (auto& sample : stream) {
+        REQUIRE(sample.size() == 28 * 28);
+        REQUIRE(sample == samples[i++]);
+    }
+
+    REQUIRE(i == 9);
+}
+
+TEST_CASE("unit/text_reader/stream/2", "[unit][reader]") {
+    dll::text::image_stream<etl::dyn_matrix<float, 3>, true> stream("test/text_db/images", 20);
+
+    auto labels = dll::text::read_labels<std::vector, uint8_t>("test/text_db/labels", 20);
+
+    REQUIRE(labels.size() == stream.size());
+
+    using generator_t = dll::outmemory_data_generator_desc<dll::batch_size<4>, dll::categorical, dll::scale_pre<255>>;
+
+    auto generator = dll::make_generator(stream.begin(), stream.end(), labels.begin(), labels.end(), stream.size(), 10, generator_t{});
+
+    for (size_t epoch = 0; epoch < 2; ++epoch) {
+        size_t n = 0;
+
+        generator->reset();
+
+        while (generator->has_next_batch()) {
+            auto batch = generator->data_batch();
+
+            REQUIRE(etl::dim<1>(batch) == 1);
+            REQUIRE(etl::dim<2>(batch) == 28);
+            REQUIRE(etl::dim<3>(batch) == 28);
+
+            n += etl::dim<0>(batch);
+
+            generator->next_batch();
+        }
+
+        REQUIRE(n == 9);
+    }
+}
@@ -0,0 +1,121 @@
+#!/usr/bin/env python3
+#=======================================================================
+# Copyright (c) 2014-2017 Baptiste Wicht
+# Distributed under the terms of the MIT License.
+# (See accompanying file LICENSE or copy at
+#  http://opensource.org/licenses/MIT)
+#=======================================================================
+
+"""Compare the JSON results of the benchmark suites against a baseline.
+
+The baseline contains the median time of each benchmark (keyed by
+suite/benchmark) and the tolerance of the comparison, globally and
+optionally per benchmark:
+
+    {
+      "tolerance": 0.10,
+      "benchmarks": {
+        "sgd_perf/dense_dense_dense": {"median": 12.5, "tolerance": 0.15}
+      }
+    }
+
+A benchmark regresses when its median is slower than the median of the
+baseline by more than the tolerance. The script exits with 1 if any
+benchmark regressed. With --update, the baseline is rewritten with the
+medians of the results, keeping the tolerances.
+"""
+
+import argparse
+import json
+import sys
+
+
+def read_results(files):
+    results = {}
+
+    for path in files:
+        with open(path) as f:
+            suite = json.load(f)
+
+        for bench in suite["benchmarks"]:
+            results[suite["suite"] + "/" + bench["name"]] = bench["time"]["median"]
+
+    return results
+
+
+def update(baseline_file, baseline, results):
+    benchmarks = baseline.setdefault("benchmarks", {})
+
+    for name, median in sorted(results.items()):
+        benchmarks.setdefault(name, {})["median"] = median
+
+    with open(baseline_file, "w") as f:
+        json.dump(baseline, f, indent=2, sort_keys=True)
+        f.write("\n")
+
+    print("Baseline updated with {} benchmarks in {}".format(len(results), baseline_file))
+
+    return 0
+
+
+def compare(baseline, results):
+    default_tolerance = baseline.get("tolerance", 0.10)
+    benchmarks = baseline.get("benchmarks", {})
+
+    regressions = 0
+
+    for name, median in sorted(results.items()):
+        if name not in benchmarks or "median" not in benchmarks[name]:
+            print("  NEW        {}: {:.4f}s (no baseline)".format(name, median))
+            continue
+
+        reference = benchmarks[name]["median"]
+        tolerance = benchmarks[name].get("tolerance", default_tolerance)
+        change = (median - reference) / reference if reference > 0 else 0.0
+
+        if change > tolerance:
+            status = "REGRESSION"
+            regressions += 1
+        elif change < -tolerance:
+            status = "FASTER"
+        else:
+            status = "OK"
+
+        print("  {:<10} {}: {:.4f}s (baseline {:.4f}s, {:+.1f}%, tolerance {:.1f}%)".format(
+            status, name, median, reference, 100.0 * change, 100.0 * tolerance))
+
+    for name in sorted(benchmarks):
+        if name not in results:
+            print("  MISSING    {}: not run".format(name))
+
+    if regressions:
+        print("{} benchmark(s) regressed".format(regressions))
+        return 1
+
+    print("No regression")
+    return 0
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Compare benchmark results against a baseline")
+    parser.add_argument("baseline", help="The baseline JSON file")
+    parser.add_argument("results", nargs="+", help="The JSON results of the benchmark suites")
+    parser.add_argument("--update", action="store_true", help="Update the baseline with the results")
+    args = parser.parse_args()
+
+    try:
+        with open(args.baseline) as f:
+            baseline = json.load(f)
+    except FileNotFoundError:
+        baseline = {"tolerance": 0.10, "benchmarks": {}}
+
+    results = read_results(args.results)
+
+    if args.update:
+        return update(args.baseline, baseline, results)
+
+    return compare(baseline, results)
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -8,17 +8,26 @@
 #include <iostream>
 
 #include "dll/rbm/conv_rbm_mp.hpp"
-#include "dll/ocv_visualizer.hpp"
+#include "dll/async_visualizer.hpp"
 
 #include "mnist/mnist_reader.hpp"
 #include "mnist/mnist_utils.hpp"
 
-int main(int /*argc*/, char* /*argv*/ []) {
-    dll::conv_rbm_mp_desc_square<
+int main(int argc, char* argv []) {
+    using rbm_t = dll::conv_rbm_mp_desc_square<
         1, 28, 40, 17, 2,
         dll::momentum,
         dll::batch_size<50>,
-        dll::watcher<dll::opencv_rbm_visualizer>>::layer_t rbm;
+        dll::watcher<dll::async_rbm_visualizer>>::layer_t;
+
+    // With a directory, the filters are written as PNG tiles instead of being shown
+    if (argc > 1) {
+        dll::async_rbm_visualizer<rbm_t>::directory = argv[1];
+    } else {
+        dll::async_rbm_visualizer<rbm_t>::display = true;
+    }
+
+    rbm_t rbm;
 
     auto dataset = mnist::read_dataset<std::vector, std::vector, double>();
 
@@ -8,18 +8,27 @@
 #include <iostream>
 
 #include "dll/rbm/conv_rbm.hpp"
-#include "dll/ocv_visualizer.hpp"
+#include "dll/async_visualizer.hpp"
 
 #include "mnist/mnist_reader.hpp"
 #include "mnist/mnist_utils.hpp"
 
-int main(int /*argc*/, char* /*argv*/ []) {
-    dll::conv_rbm_square_desc<
+int main(int argc, char* argv []) {
+    using rbm_t = dll::conv_rbm_square_desc<
         1, 28, 40, 17,
         dll::momentum,
         dll::batch_size<50>,
         dll::sparsity<dll::sparsity_method::LEE>,
-        dll::watcher<dll::opencv_rbm_visualizer>>::layer_t rbm;
+        dll::watcher<dll::async_rbm_visualizer>>::layer_t;
+
+    // With a directory, the filters are written as PNG tiles instead of being shown
+    if (argc > 1) {
+        dll::async_rbm_visualizer<rbm_t>::directory = argv[1];
+    } else {
+        dll::async_rbm_visualizer<rbm_t>::display = true;
+    }
+
+    rbm_t rbm;
 
     auto dataset = mnist::read_dataset<std::vector, std::vector, double>();
 
@@ -8,19 +8,28 @@
 #include <iostream>
 
 #include "dll/rbm/rbm.hpp"
-#include "dll/ocv_visualizer.hpp"
+#include "dll/async_visualizer.hpp"
 
 #include "mnist/mnist_reader.hpp"
 #include "mnist/mnist_utils.hpp"
 
-int main(int /*argc*/, char* /*argv*/ []) {
-    dll::rbm_desc<
+int main(int argc, char* argv []) {
+    using rbm_t = dll::rbm_desc<
         28 * 28, 10 * 10,
         dll::momentum,
         dll::trainer_rbm<dll::pcd1_trainer_t>,
         dll::batch_size<50>,
         dll::visible<dll::unit_type::GAUSSIAN>,
-        dll::watcher<dll::opencv_rbm_visualizer>>::layer_t rbm;
+        dll::watcher<dll::async_rbm_visualizer>>::layer_t;
+
+    // With a directory, the filters are written as PNG tiles instead of being shown
+    if (argc > 1) {
+        dll::async_rbm_visualizer<rbm_t>::directory = argv[1];
+    } else {
+        dll::async_rbm_visualizer<rbm_t>::display = true;
+    }
+
+    rbm_t rbm;
 
     auto dataset = mnist::read_dataset_direct<std::vector, etl::dyn_vector<float>>();
 
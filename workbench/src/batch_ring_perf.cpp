@@ -0,0 +1,78 @@
+//=======================================================================
+// Copyright (c) 2014-2017 Baptiste Wicht
+// Distributed under the terms of the MIT License.
+// (See accompanying file LICENSE or copy at
+//  http://opensource.org/licenses/MIT)
+//=======================================================================
+
+#include <chrono>
+#include <iostream>
+
+#include "dll/generators.hpp"
+
+namespace {
+
+/*!
+ * \brief Measure the average handoff time of a batch through the given ring.
+ *
+ * The producers do no work at all, so the measured time is only the cost
+ * of the synchronization between the producers and the consumer.
+ */
+template <typename Ring>
+double handoff_ns(size_t batches, size_t producers) {
+    Ring ring(batches);
+
+    std::vector<std::thread> threads;
+
+    for (size_t p = 0; p < producers; ++p) {
+        threads.emplace_back([&ring] {
+            size_t pos = 0;
+
+            while (ring.acquire(pos)) {
+                ring.end_read(pos);
+                ring.publish(pos);
+            }
+        });
+    }
+
+    auto start = std::chrono::steady_clock::now();
+
+    for (size_t b = 0; b < batches; ++b) {
+        ring.wait_ready(b);
+        ring.release(b);
+    }
+
+    auto end = std::chrono::steady_clock::now();
+
+    ring.stop();
+
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count() / double(batches);
+}
+
+template <size_t N>
+void compare(size_t batches, size_t producers) {
+    auto locked    = handoff_ns<dll::locked_batch_ring<N>>(batches, producers);
+    auto lock_free = handoff_ns<dll::lock_free_batch_ring<N>>(batches, producers);
+
+    std::cout << "slots=" << N << " producers=" << producers << std::endl;
+    std::cout << "     locked: " << locked << "ns/batch" << std::endl;
+    std::cout << "  lock-free: " << lock_free << "ns/batch" << std::endl;
+}
+
+} // end of anonymous namespace
+
+int main(int /*argc*/, char* /*argv*/ []) {
+    constexpr size_t batches = 1000000;
+
+    compare<1>(batches, 1);
+    compare<2>(batches, 1);
+    compare<8>(batches, 1);
+    compare<8>(batches, 2);
+    compare<8>(batches, 4);
+
+    return 0;
+}
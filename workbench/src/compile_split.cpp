@@ -0,0 +1,21 @@
+//=======================================================================
+// Copyright (c) 2014-2017 Baptiste Wicht
+// Distributed under the terms of the MIT License.
+// (See accompanying file LICENSE or copy at
+//  http://opensource.org/licenses/MIT)
+//=======================================================================
+
+#include "compile_split.hpp"
+
+// The training of the network is not instantiated here
+
+int main(int, char**) {
+    auto dataset = dll::make_mnist_dataset(dll::batch_size<100>{}, dll::normalize_pre{});
+
+    auto net = std::make_unique<network_t>();
+
+    net->fine_tune(dataset.train(), 5);
+    net->evaluate(dataset.test());
+
+    return 0;
+}
@@ -0,0 +1,30 @@
+//=======================================================================
+// Copyright (c) 2014-2017 Baptiste Wicht
+// Distributed under the terms of the MIT License.
+// (See accompanying file LICENSE or copy at
+//  http://opensource.org/licenses/MIT)
+//=======================================================================
+
+#pragma once
+
+#include "dll/neural/dense_layer.hpp"
+#include "dll/network.hpp"
+#include "dll/datasets.hpp"
+#include "dll/instantiate.hpp"
+
+// The network and the generator shared by the two translation units
+
+using network_t = dll::dyn_network_desc<
+    dll::network_layers<
+        dll::dense_layer<28 * 28, 500>,
+        dll::dense_layer<500, 250>,
+        dll::dense_layer<250, 10, dll::softmax>
+    >
+    , dll::updater<dll::updater_type::NADAM>
+    , dll::batch_size<100>
+>::network_t;
+
+using generator_t = decltype(dll::make_mnist_generator_train(0UL, 60000UL, dll::batch_size<100>{}, dll::normalize_pre{}))::element_type;
+
+// The training is compiled in compile_split_train.cpp
+DLL_EXTERN_TRAINING(network_t, generator_t);
@@ -0,0 +1,12 @@
+//=======================================================================
+// Copyright (c) 2014-2017 Baptiste Wicht
+// Distributed under the terms of the MIT License.
+// (See accompanying file LICENSE or copy at
+//  http://opensource.org/licenses/MIT)
+//=======================================================================
+
+#include "compile_split.hpp"
+
+// The complete training stack of the network, compiled once
+
+DLL_INSTANTIATE_TRAINING(network_t, generator_t);
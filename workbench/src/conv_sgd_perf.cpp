@@ -15,6 +15,7 @@
 #include "dll/pooling/mp_layer.hpp"
 #include "dll/test.hpp"
 #include "dll/dbn.hpp"
+#include "dll/util/benchmark.hpp"
 
 #include "mnist/mnist_reader.hpp"
 #include "mnist/mnist_utils.hpp"
@@ -40,13 +41,8 @@ void mnist_scale(Dataset& dataset) {
     }
 }
 
-void first_ex(){
+void first_ex(dll::benchmark_suite& bench){
     // First experiment : Conv -> Conv -> Dense -> Dense
-    // Current speed on frigg:
-    //   21 seconds (mkl-threads, default options)
-    //   27-29 seconds (mkl, default options)
-    //   40 seconds (mkl, conv4_prefer_blas)
-    //   36 seconds (mkl-threads, conv4_prefer_blas)
 
     auto dataset = mnist::read_dataset_direct<std::vector, etl::fast_dyn_matrix<float, 1, 28, 28>>(3000);
 
@@ -69,24 +65,19 @@ void first_ex(){
 
     auto net = std::make_unique<dbn_t>();
 
-    // Train the network for performance sake
     net->display();
-    net->fine_tune(dataset.training_images, dataset.training_labels, 20);
 
-    std::cout << "DLL Timers" << std::endl;
-    dll::dump_timers_one();
+    // Train the network for performance sake
+    bench.run("conv_conv_dense_dense", [&] {
+        net->fine_tune(dataset.training_images, dataset.training_labels, 20);
+    });
 
     std::cout << "ETL Counters" << std::endl;
     etl::dump_counters();
 }
 
-void second_ex(){
+void second_ex(dll::benchmark_suite& bench){
     // Second experiment : Conv -> Pooling -> Conv -> Dense -> Dense
-    // Current speed on frigg:
-    //   12-13 seconds (mkl-threads, default-options)
-    //   12-13 seconds (mkl, default-options)
-    //   14 seconds (mkl, conv4_prefer_blas)
-    //   19 seconds (mkl-threads, conv4_prefer_blas)
 
     auto dataset = mnist::read_dataset_direct<std::vector, etl::fast_dyn_matrix<float, 1, 28, 28>>(3000);
 
@@ -110,24 +101,19 @@ void second_ex(){
 
     auto net = std::make_unique<dbn_t>();
 
-    // Train the network for performance sake
     net->display();
-    net->fine_tune(dataset.training_images, dataset.training_labels, 20);
 
-    std::cout << "DLL Timers" << std::endl;
-    dll::dump_timers_one();
+    // Train the network for performance sake
+    bench.run("conv_mp_conv_dense_dense", [&] {
+        net->fine_tune(dataset.training_images, dataset.training_labels, 20);
+    });
 
     std::cout << "ETL Counters" << std::endl;
     etl::dump_counters();
 }
 
-void third_ex(){
+void third_ex(dll::benchmark_suite& bench){
     // Third experiment : Conv -> Pooling -> Conv -> Pooling -> Dense -> Dense
-    // Current speed on frigg:
-    //   24 seconds (mkl-threads, default-options)
-    //   21 seconds (mkl, default-options)
-    //   25 seconds (mkl, conv4_prefer_blas)
-    //   38 seconds (mkl-threads, conv4_prefer_blas)
 
     auto dataset = mnist::read_dataset_direct<std::vector, etl::fast_dyn_matrix<float, 1, 28, 28>>(6000);
 
@@ -154,25 +140,20 @@ void third_ex(){
 
     net->learning_rate = 0.05;
 
-    // Train the network for performance sake
     net->display();
-    net->fine_tune(dataset.training_images, dataset.training_labels, 20);
 
-    std::cout << "DLL Timers" << std::endl;
-    dll::dump_timers_one();
+    // Train the network for performance sake
+    bench.run("conv_mp_conv_mp_dense_dense", [&] {
+        net->fine_tune(dataset.training_images, dataset.training_labels, 20);
+    });
 
     std::cout << "ETL Counters" << std::endl;
     etl::dump_counters();
 }
 
-void fourth_ex(){
+void fourth_ex(dll::benchmark_suite& bench){
     // Third experiment (CIFAR) : Conv -> Pooling -> Conv -> Pooling -> Dense -> Dense
     // This also uses momentum and RELU, more realistic
-    // Current speed on frigg:
-    //   146 seconds (mkl-threads, default-options)
-    //   109 seconds (mkl, default-options)
-    //   109 seconds (mkl, conv4_prefer_blas)
-    //   177 seconds (mkl-threads, conv4_prefer_blas)
 
     auto dataset = cifar::read_dataset_direct<std::vector, etl::fast_dyn_matrix<float, 3, 32, 32>>();
 
@@ -197,25 +178,20 @@ void fourth_ex(){
     net->momentum = 0.9;
     net->goal = -1.0;
 
-    // Train the network for performance sake
     net->display();
-    net->fine_tune(dataset.training_images, dataset.training_labels, 5);
 
-    std::cout << "DLL Timers" << std::endl;
-    dll::dump_timers_one();
+    // Train the network for performance sake
+    bench.run("cifar_conv_mp_conv_mp_dense_dense", [&] {
+        net->fine_tune(dataset.training_images, dataset.training_labels, 5);
+    });
 
     std::cout << "ETL Counters" << std::endl;
     etl::dump_counters();
 }
 
-void fifth_ex(){
+void fifth_ex(dll::benchmark_suite& bench){
     // Third experiment (MNIST) : Conv -> Conv -> Pooling -> Conv -> Conv -> Pooling -> Dense -> Dense
     // This also uses momentum and RELU, more realistic
-    // Current speed on frigg:
-    //   50 seconds (mkl-threads, default-options)
-    //   30-34 seconds (mkl, default-options)
-    //   12-13 seconds (mkl, conv4_prefer_blas)
-    //   27 seconds (mkl-threads, conv4_prefer_blas)
 
     auto dataset = mnist::read_dataset_direct<std::vector, etl::fast_dyn_matrix<float, 1, 28, 28>>(3000);
 
@@ -246,37 +222,111 @@ void fifth_ex(){
     net->momentum = 0.9;
     net->goal = -1.0;
 
-    // Train the network for performance sake
     net->display();
-    net->fine_tune(dataset.training_images, dataset.training_labels, 5);
 
-    std::cout << "DLL Timers" << std::endl;
-    dll::dump_timers_one();
+    // Train the network for performance sake
+    bench.run("conv_conv_mp_conv_conv_mp_dense_dense", [&] {
+        net->fine_tune(dataset.training_images, dataset.training_labels, 5);
+    });
 
     std::cout << "ETL Counters" << std::endl;
     etl::dump_counters();
 }
 
+/*!
+ * \brief Train a network until its training error reaches the goal and
+ * report the time it took
+ */
+template <typename Net, typename Dataset>
+void time_to_accuracy(const char* name, Net& net, Dataset& dataset, size_t max_epochs) {
+    dll::stop_timer timer;
+    timer.start();
+
+    auto ft_error = net.fine_tune(dataset.training_images, dataset.training_labels, max_epochs);
+
+    auto duration = timer.stop();
+
+    auto test_error = net.evaluate_error(dataset.test_images, dataset.test_labels);
+
+    std::cout << name << ": ft_error:" << ft_error << " test_error:" << test_error << " time:" << duration << "ms" << std::endl;
+}
+
+void sixth_ex(){
+    // Sixth experiment (MNIST) : Time-to-accuracy of a large-batch
+    // Conv -> Pooling -> Dense -> Dense network, with a constant learning
+    // rate and with warmup followed by cosine annealing
+
+    auto dataset = mnist::read_dataset_direct<std::vector, etl::fast_dyn_matrix<float, 1, 28, 28>>(10000);
+
+    mnist_scale(dataset);
+
+    using constant_dbn_t = dll::dbn_desc<
+        dll::dbn_layers<
+            dll::conv_layer_desc<1, 28, 28, 8, 5, 5, dll::activation<dll::function::RELU>>::layer_t,
+            dll::mp_2d_layer_desc<8, 24, 24, 2, 2>::layer_t,
+            dll::dense_layer_desc<8 * 12 * 12, 100, dll::activation<dll::function::RELU>>::layer_t,
+            dll::dense_layer_desc<100, 10, dll::activation<dll::function::SOFTMAX>>::layer_t>,
+        dll::updater<dll::updater_type::MOMENTUM>, dll::batch_size<500>, dll::trainer<dll::sgd_trainer>>::dbn_t;
+
+    using schedule_dbn_t = dll::dbn_desc<
+        dll::dbn_layers<
+            dll::conv_layer_desc<1, 28, 28, 8, 5, 5, dll::activation<dll::function::RELU>>::layer_t,
+            dll::mp_2d_layer_desc<8, 24, 24, 2, 2>::layer_t,
+            dll::dense_layer_desc<8 * 12 * 12, 100, dll::activation<dll::function::RELU>>::layer_t,
+            dll::dense_layer_desc<100, 10, dll::activation<dll::function::SOFTMAX>>::layer_t>,
+        dll::updater<dll::updater_type::MOMENTUM>, dll::batch_size<500>, dll::trainer<dll::sgd_trainer>,
+        dll::lr_schedule<dll::warmup_lr<dll::cosine_lr>>>::dbn_t;
+
+    constexpr size_t epochs = 30;
+
+    auto constant_net = std::make_unique<constant_dbn_t>();
+
+    constant_net->learning_rate    = 0.1;
+    constant_net->initial_momentum = 0.9;
+    constant_net->momentum         = 0.9;
+    constant_net->goal             = 0.02;
+
+    time_to_accuracy("constant", *constant_net, dataset, epochs);
+
+    auto schedule_net = std::make_unique<schedule_dbn_t>();
+
+    schedule_net->learning_rate        = 0.4;
+    schedule_net->lr_warmup_iterations = 40;
+    schedule_net->initial_momentum     = 0.9;
+    schedule_net->momentum             = 0.9;
+    schedule_net->goal                 = 0.02;
+
+    time_to_accuracy("warmup+cosine", *schedule_net, dataset, epochs);
+}
+
 } // end of anonymous namespace
 
 int main(int argc, char* argv []) {
-    if(argc == 1){
-        first_ex();
-        return 0;
+    dll::benchmark_suite bench("conv_sgd_perf", argc, argv, 0, 3);
+
+    if(bench.selected("A")){
+        first_ex(bench);
+    }
+
+    if(bench.selected("B", false)){
+        second_ex(bench);
+    }
+
+    if(bench.selected("C", false)){
+        third_ex(bench);
+    }
+
+    if(bench.selected("D", false)){
+        fourth_ex(bench);
+    }
+
+    if(bench.selected("E", false)){
+        fifth_ex(bench);
     }
 
-    std::string select(argv[1]);
-    if(select == "A"){
-        first_ex();
-    } else if(select == "B"){
-        second_ex();
-    } else if(select == "C"){
-        third_ex();
-    } else if(select == "D"){
-        fourth_ex();
-    } else if(select == "E"){
-        fifth_ex();
+    if(bench.selected("F", false)){
+        sixth_ex();
     }
 
-    return 0;
+    return bench.finish();
 }
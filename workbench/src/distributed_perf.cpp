@@ -0,0 +1,282 @@
+//=======================================================================
+// Copyright (c) 2014-2017 Baptiste Wicht
+// Distributed under the terms of the MIT License.
+// (See accompanying file LICENSE or copy at
+//  http://opensource.org/licenses/MIT)
+//=======================================================================
+
+/*
+ * Time-to-accuracy of the distributed trainer with compressed gradients.
+ *
+ * Each network is trained with the gradients exchanged in full precision,
+ * with top-k (error feedback) and with int8 quantization. After each
+ * epoch, the validation error is recorded together with the training time
+ * of the epoch and the time of the communication of its gradients. The
+ * communication time is modeled from the bytes sent by each rank for the
+ * given number of ranks and bandwidth: a ring all_reduce of the full
+ * gradients (2 (p - 1) / p times the gradients) and a ring all_gather of
+ * the compressed gradients ((p - 1) times the payload).
+ *
+ * Built with DLL_MPI, the networks are trained over MPI, each rank on its
+ * shard of the data, and the measured time already includes the real
+ * communication.
+ *
+ * Usage: dll_distributed_perf [options] [mnist] [cifar]
+ *   --epochs=N      The maximum number of epochs of each run (default 10)
+ *   --target=X      The validation error to reach (default 0.05 for mnist, 0.55 for cifar)
+ *   --ratio=X       The fraction of the gradients sent by top-k (default 0.01)
+ *   --ranks=N       The number of ranks of the communication model (default 8)
+ *   --bandwidth=X   The bandwidth of the communication model, in Gbit/s (default 10)
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+
+#include "dll/neural/dense_layer.hpp"
+#include "dll/dbn.hpp"
+#include "dll/trainer/distributed_sgd_trainer.hpp"
+
+#include "mnist/mnist_reader.hpp"
+#include "cifar/cifar10_reader.hpp"
+
+namespace {
+
+using clock_type = std::chrono::steady_clock;
+
+#ifdef DLL_MPI
+using transport_type = dll::mpi_transport;
+#else
+using transport_type = dll::local_transport;
+#endif
+
+/*!
+ * \brief The configuration of the benchmark
+ */
+struct bench_options {
+    size_t epochs    = 10;   ///< The maximum number of epochs of each run
+    double target    = 0.0;  ///< The validation error to reach (0 for the default of the dataset)
+    double ratio     = 0.01; ///< The fraction of the gradients sent by top-k
+    size_t ranks     = 8;    ///< The number of ranks of the communication model
+    double bandwidth = 10.0; ///< The bandwidth of the communication model (Gbit/s)
+};
+
+/*!
+ * \brief The measures of one epoch
+ */
+struct epoch_result {
+    double seconds;   ///< The training time of the epoch (s)
+    double val_error; ///< The validation error at the end of the epoch
+};
+
+std::vector<epoch_result> epochs;   ///< The epochs of the current run
+clock_type::time_point epoch_start; ///< The start of the current epoch
+
+/*!
+ * \brief Watcher recording the time and the validation error of each epoch
+ */
+template <typename DBN>
+struct epoch_watcher : dll::mute_dbn_watcher<DBN> {
+    using dll::mute_dbn_watcher<DBN>::ft_epoch_end;
+
+    void fine_tuning_begin(const DBN& /*dbn*/, size_t /*max_epochs*/) {
+        epochs.clear();
+        epoch_start = clock_type::now();
+    }
+
+    void ft_epoch_end(size_t /*epoch*/, double /*train_error*/, double /*train_loss*/, double val_error, double /*val_loss*/, const DBN& /*dbn*/) {
+        auto now = clock_type::now();
+
+        epochs.push_back({std::chrono::duration<double>(now - epoch_start).count(), val_error});
+
+        epoch_start = now;
+    }
+};
+
+/*!
+ * \brief Returns the modeled communication time of one batch of the given
+ * network (s)
+ */
+template <typename DBN>
+double communication_time(const DBN& dbn, const bench_options& options) {
+    const double p     = options.ranks;
+    const double bytes = options.bandwidth * 1e9 / 8.0;
+
+    double seconds = 0.0;
+
+    dbn.for_each_layer_i([&](size_t l, auto& layer) {
+        const size_t n = etl::size(layer.w) + etl::size(layer.b);
+
+        auto& compression = dbn.gradient_compression[l];
+
+        if (compression.method == dll::grad_compression::NONE) {
+            seconds += 2.0 * (p - 1.0) / p * n * sizeof(typename DBN::weight) / bytes;
+        } else {
+            seconds += (p - 1.0) * dll::compressed_bytes<typename DBN::weight>(compression, n, 2) / bytes;
+        }
+    });
+
+    return seconds;
+}
+
+/*!
+ * \brief Train the network with each compression of the gradients and
+ * report the time to reach the target error
+ */
+template <typename DBN, typename Images, typename Labels>
+void time_to_accuracy(const std::string& name, const Images& train_images, const Labels& train_labels, const Images& test_images, const Labels& test_labels, double target, const bench_options& options) {
+    using generator_t = dll::inmemory_data_generator_desc<dll::batch_size<DBN::batch_size>, dll::categorical, dll::scale_pre<255>>;
+
+    transport_type transport;
+
+    // Each rank trains on its own shard of the training set
+    auto shard = dll::shard_range(transport, train_images.size());
+
+    Images shard_images(train_images.begin() + shard.first, train_images.begin() + shard.second);
+    Labels shard_labels(train_labels.begin() + shard.first, train_labels.begin() + shard.second);
+
+    const size_t batches = shard_images.size() / DBN::batch_size;
+
+    for (auto method : {dll::grad_compression::NONE, dll::grad_compression::TOP_K, dll::grad_compression::INT8}) {
+        auto train_generator = dll::make_generator(shard_images, shard_labels, shard_images.size(), 10, generator_t{});
+        auto test_generator  = dll::make_generator(test_images, test_labels, test_images.size(), 10, generator_t{});
+
+        auto dbn = std::make_unique<DBN>();
+
+        dbn->learning_rate = 0.05;
+
+        for (auto& compression : dbn->gradient_compression) {
+            compression.method = method;
+            compression.ratio  = options.ratio;
+        }
+
+        dbn->fine_tune_val(*train_generator, *test_generator, options.epochs);
+
+        const double communication = batches * communication_time(*dbn, options);
+
+        const char* method_name = method == dll::grad_compression::NONE ? "none" : method == dll::grad_compression::TOP_K ? "top_k" : "int8";
+
+        double measured = 0.0;
+        double modeled  = 0.0;
+        size_t reached  = 0;
+
+        for (size_t e = 0; e < epochs.size(); ++e) {
+            measured += epochs[e].seconds;
+            modeled += epochs[e].seconds + communication;
+
+            if (epochs[e].val_error <= target) {
+                reached = e + 1;
+                break;
+            }
+        }
+
+        if (transport.rank() > 0) {
+            continue;
+        }
+
+        std::cout << "[tta] " << name << "/" << method_name
+                  << ": final error " << (epochs.empty() ? 1.0 : epochs.back().val_error)
+                  << ", communication " << std::setprecision(4) << 1e3 * communication << "ms/epoch (" << options.ranks << " ranks)";
+
+        if (reached) {
+            std::cout << ", target " << target << " reached after " << reached << " epochs"
+                      << ", " << measured << "s measured, " << modeled << "s modeled" << std::endl;
+        } else {
+            std::cout << ", target " << target << " not reached after " << epochs.size() << " epochs" << std::endl;
+        }
+    }
+}
+
+/*!
+ * \brief MLP on MNIST
+ */
+void mnist_mlp(const bench_options& options) {
+    using dbn_t = dll::dbn_desc<
+        dll::dbn_layers<
+            dll::dense_layer_desc<28 * 28, 500>::layer_t,
+            dll::dense_layer_desc<500, 10, dll::softmax>::layer_t>,
+        dll::trainer<dll::distributed_sgd_trainer>, dll::transport<transport_type>, dll::batch_size<100>,
+        dll::watcher<epoch_watcher>>::dbn_t;
+
+    auto dataset = mnist::read_dataset_direct<std::vector, etl::fast_dyn_matrix<float, 28 * 28>>();
+
+    if (dataset.training_images.empty()) {
+        std::cerr << "ERROR: Impossible to read the MNIST dataset" << std::endl;
+        return;
+    }
+
+    time_to_accuracy<dbn_t>("mnist_mlp", dataset.training_images, dataset.training_labels, dataset.test_images, dataset.test_labels,
+                            options.target > 0.0 ? options.target : 0.05, options);
+}
+
+/*!
+ * \brief MLP on CIFAR-10
+ */
+void cifar_mlp(const bench_options& options) {
+    using dbn_t = dll::dbn_desc<
+        dll::dbn_layers<
+            dll::dense_layer_desc<3 * 32 * 32, 500>::layer_t,
+            dll::dense_layer_desc<500, 10, dll::softmax>::layer_t>,
+        dll::trainer<dll::distributed_sgd_trainer>, dll::transport<transport_type>, dll::batch_size<100>,
+        dll::watcher<epoch_watcher>>::dbn_t;
+
+    auto dataset = cifar::read_dataset_direct<std::vector, etl::fast_dyn_matrix<float, 3, 32, 32>>();
+
+    if (dataset.training_images.empty()) {
+        std::cerr << "ERROR: Impossible to read the CIFAR-10 dataset" << std::endl;
+        return;
+    }
+
+    // The dense layers take the flattened images
+    auto flatten = [](const auto& images) {
+        std::vector<etl::fast_dyn_matrix<float, 3 * 32 * 32>> flat(images.size());
+
+        for (size_t i = 0; i < images.size(); ++i) {
+            std::copy(images[i].begin(), images[i].end(), flat[i].begin());
+        }
+
+        return flat;
+    };
+
+    time_to_accuracy<dbn_t>("cifar_mlp", flatten(dataset.training_images), dataset.training_labels, flatten(dataset.test_images), dataset.test_labels,
+                            options.target > 0.0 ? options.target : 0.55, options);
+}
+
+} // end of anonymous namespace
+
+int main(int argc, char* argv[]) {
+    bench_options options;
+    std::vector<std::string> datasets;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg(argv[i]);
+
+        if (arg.find("--epochs=") == 0) {
+            options.epochs = std::max<size_t>(1, std::stoul(arg.substr(9)));
+        } else if (arg.find("--target=") == 0) {
+            options.target = std::stod(arg.substr(9));
+        } else if (arg.find("--ratio=") == 0) {
+            options.ratio = std::stod(arg.substr(8));
+        } else if (arg.find("--ranks=") == 0) {
+            options.ranks = std::max<size_t>(1, std::stoul(arg.substr(8)));
+        } else if (arg.find("--bandwidth=") == 0) {
+            options.bandwidth = std::stod(arg.substr(12));
+        } else {
+            datasets.push_back(arg);
+        }
+    }
+
+    auto selected = [&](const std::string& dataset) {
+        return datasets.empty() || std::find(datasets.begin(), datasets.end(), dataset) != datasets.end();
+    };
+
+    if (selected("mnist")) {
+        mnist_mlp(options);
+    }
+
+    if (selected("cifar")) {
+        cifar_mlp(options);
+    }
+
+    return 0;
+}
@@ -0,0 +1,105 @@
+//=======================================================================
+// Copyright (c) 2014-2017 Baptiste Wicht
+// Distributed under the terms of the MIT License.
+// (See accompanying file LICENSE or copy at
+//  http://opensource.org/licenses/MIT)
+//=======================================================================
+
+/*
+ * Convert the training set of ImageNet into shards of packed datasets.
+ *
+ * The JPEG files are decoded once and stored as 3x256x256 uint8_t images,
+ * in random order, so that the training only reads the shards
+ * sequentially (see dll::make_mmap_generator<float, 3, uint8_t>).
+ *
+ * The shards are named <prefix>.<index>.dlld
+ */
+
+#include <atomic>
+#include <cstdio>
+#include <random>
+#include <thread>
+
+#include "dll/datasets.hpp"
+#include "dll/datasets/imagenet.hpp"
+
+int main(int argc, char* argv[]) {
+    if (argc < 3) {
+        std::cout << "Usage: dll_imagenet_pack <imagenet_folder> <prefix> [shards]" << std::endl;
+        return 1;
+    }
+
+    const std::string folder = argv[1];
+    const std::string prefix = argv[2];
+    const size_t shards      = argc > 3 ? std::max(std::stoul(argv[3]), 1ul) : 16;
+
+    std::vector<std::pair<size_t, size_t>> files;
+    std::unordered_map<size_t, float> labels;
+
+    dll::imagenet::read_files(files, labels, folder + "/train");
+
+    if (files.empty()) {
+        std::cerr << "ERROR: No images in " << folder << std::endl;
+        return 1;
+    }
+
+    std::cout << files.size() << " images in " << labels.size() << " classes" << std::endl;
+
+    // The shards are only shuffled by blocks during the training
+    std::shuffle(files.begin(), files.end(), std::default_random_engine(std::random_device()()));
+
+    const size_t per_shard = (files.size() + shards - 1) / shards;
+    const size_t threads   = std::max(size_t(1), std::min(shards, size_t(std::thread::hardware_concurrency())));
+
+    std::atomic<size_t> next(0);
+    std::atomic<size_t> done(0);
+    std::atomic<bool> failed(false);
+
+    auto worker = [&]() {
+        dll::imagenet::image_type image;
+
+        size_t s;
+        while ((s = next++) < shards) {
+            const size_t first = s * per_shard;
+            const size_t last  = std::min(first + per_shard, files.size());
+
+            if (first >= last) {
+                continue;
+            }
+
+            char suffix[16];
+            std::snprintf(suffix, sizeof(suffix), ".%03zu.dlld", s);
+
+            dll::packed_dataset_writer<uint8_t, 3> writer(prefix + suffix, {3, 256, 256});
+
+            for (size_t i = first; i < last; ++i) {
+                dll::imagenet::decode_image(image, dll::imagenet::image_path(folder, files[i]));
+
+                if (!writer.add(image, size_t(labels.at(files[i].first)))) {
+                    failed = true;
+                    break;
+                }
+            }
+
+            if (!writer.close()) {
+                failed = true;
+            }
+
+            std::cout << "Shard " << prefix + suffix << " written (" << ++done << "/" << shards << ")" << std::endl;
+        }
+    };
+
+    std::vector<std::thread> pool;
+
+    for (size_t t = 1; t < threads; ++t) {
+        pool.emplace_back(worker);
+    }
+
+    worker();
+
+    for (auto& thread : pool) {
+        thread.join();
+    }
+
+    return failed ? 1 : 0;
+}
@@ -15,6 +15,7 @@
 #include "dll/pooling/mp_layer.hpp"
 #include "dll/test.hpp"
 #include "dll/dbn.hpp"
+#include "dll/util/benchmark.hpp"
 
 #include "mnist/mnist_reader.hpp"
 #include "mnist/mnist_utils.hpp"
@@ -22,10 +23,8 @@
 
 namespace {
 
-void first_ex(){
+void first_ex(dll::benchmark_suite& bench){
     // First experiment : Conv -> Conv -> Dense -> Dense
-    // Current training speed on frigg:
-    //  ~100 seconds (mkl, default options)
 
     constexpr size_t N = 4096;
     constexpr size_t B = 128;
@@ -73,21 +72,19 @@ void first_ex(){
 
     auto net = std::make_unique<dbn_t>();
 
-    // Train the network for performance sake
     net->display();
-    net->fine_tune(training_images, training_labels, 1);
 
-    std::cout << "DLL Timers" << std::endl;
-    dll::dump_timers_one();
+    // Train the network for performance sake
+    bench.run("imagenet_conv_254", [&] {
+        net->fine_tune(training_images, training_labels, 1);
+    });
 
     std::cout << "ETL Counters" << std::endl;
     etl::dump_counters();
 }
 
-void second_ex(){
+void second_ex(dll::benchmark_suite& bench){
     // Second experiment : Conv -> Conv -> Dense -> Dense
-    // Current training speed on frigg:
-    //  ~185 seconds (mkl, default options)
 
     constexpr size_t N = 4096;
     constexpr size_t B = 128;
@@ -135,12 +132,12 @@ void second_ex(){
 
     auto net = std::make_unique<dbn_t>();
 
-    // Train the network for performance sake
     net->display();
-    net->fine_tune(training_images, training_labels, 1);
 
-    std::cout << "DLL Timers" << std::endl;
-    dll::dump_timers_one();
+    // Train the network for performance sake
+    bench.run("imagenet_conv_same_256", [&] {
+        net->fine_tune(training_images, training_labels, 1);
+    });
 
     std::cout << "ETL Counters" << std::endl;
     etl::dump_counters();
@@ -149,17 +146,15 @@ void second_ex(){
 } // end of anonymous namespace
 
 int main(int argc, char* argv []) {
-    if(argc == 1){
-        first_ex();
-        return 0;
+    dll::benchmark_suite bench("imagenet_perf", argc, argv, 0, 1);
+
+    if(bench.selected("A")){
+        first_ex(bench);
     }
 
-    std::string select(argv[1]);
-    if(select == "A"){
-        first_ex();
-    } else if(select == "B"){
-        second_ex();
+    if(bench.selected("B", false)){
+        second_ex(bench);
     }
 
-    return 0;
+    return bench.finish();
 }
@@ -0,0 +1,396 @@
+//=======================================================================
+// Copyright (c) 2014-2017 Baptiste Wicht
+// Distributed under the terms of the MIT License.
+// (See accompanying file LICENSE or copy at
+//  http://opensource.org/licenses/MIT)
+//=======================================================================
+
+/*
+ * Load test of the inference of trained networks.
+ *
+ * Client threads issue requests at a fixed rate (open loop) or as fast as
+ * possible (closed loop) and the latency of each request is measured, from
+ * the time at which it was scheduled, so that the queueing delays of a
+ * saturated server are not hidden. Two paths are measured:
+ *   direct   Each client forwards its requests through its own inference session
+ *   batcher  The clients submit single samples to a shared micro-batching front-end
+ *
+ * Usage: dll_inference_perf [options] [mlp] [cnn] [conv]
+ *   --clients=N     The number of client threads (default 4)
+ *   --qps=N         The total target rate of requests, 0 for closed loop (default 0)
+ *   --seconds=N     The duration of each run (default 5)
+ *   --batch=N       The number of samples of a direct request (default 1)
+ *   --workers=N     The number of workers of the batcher (default 1)
+ *   --delay=N       The maximum delay of the batcher, in microseconds (default 1000)
+ *   --weights=DIR   Load the weights of each network from DIR/<name>.dat
+ *   --json=FILE     Write the results as JSON in the given file
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <thread>
+
+#include "dll/neural/conv_layer.hpp"
+#include "dll/neural/dense_layer.hpp"
+#include "dll/pooling/mp_layer.hpp"
+#include "dll/network.hpp"
+#include "dll/dbn.hpp"
+#include "dll/inference_session.hpp"
+#include "dll/inference_batcher.hpp"
+
+namespace {
+
+using clock_type = std::chrono::steady_clock;
+
+/*!
+ * \brief The configuration of the load test
+ */
+struct load_options {
+    size_t clients = 4;    ///< The number of client threads
+    double qps     = 0.0;  ///< The total target rate of requests (0 for closed loop)
+    double seconds = 5.0;  ///< The duration of each run
+    size_t batch   = 1;    ///< The number of samples of a direct request
+    size_t workers = 1;    ///< The number of workers of the batcher
+    size_t delay   = 1000; ///< The maximum delay of the batcher (us)
+    std::string weights;   ///< The folder of the weights (none if empty)
+    std::string json_file; ///< The file of the JSON output (none if empty)
+};
+
+/*!
+ * \brief The measures of one run
+ */
+struct load_result {
+    std::string name;              ///< The name of the run
+    std::vector<double> latencies; ///< The latency of each request (s)
+    size_t samples  = 0;           ///< The number of forwarded samples
+    double duration = 0.0;         ///< The duration of the run (s)
+};
+
+std::vector<load_result> results;
+
+/*!
+ * \brief Returns the given percentile of the sorted samples (nearest rank)
+ */
+double percentile(const std::vector<double>& sorted, double p) {
+    if (sorted.empty()) {
+        return 0.0;
+    }
+
+    return sorted[std::max(size_t(1), size_t(std::ceil(p * sorted.size()))) - 1];
+}
+
+/*!
+ * \brief Traits to test if the first layer can size one input by itself
+ */
+template <typename Layer, typename = void>
+struct has_prepare_input : std::false_type {};
+
+template <typename Layer>
+struct has_prepare_input<Layer, std::void_t<decltype(std::declval<const Layer&>().prepare_input(std::declval<typename Layer::input_one_t&>()))>> : std::true_type {};
+
+/*!
+ * \brief Create a random sample for the given network
+ */
+template <typename Network>
+typename Network::input_one_t make_sample(const Network& net) {
+    typename Network::input_one_t sample;
+
+    using first_t = std::decay_t<decltype(net.template layer_get<0>())>;
+
+    if constexpr (has_prepare_input<first_t>::value) {
+        net.template layer_get<0>().prepare_input(sample);
+    }
+
+    sample = etl::uniform_generator(0.0, 1.0);
+
+    return sample;
+}
+
+/*!
+ * \brief Run the clients, each of them calling the given functor for each
+ * of its requests, and record the latencies
+ * \param name The name of the run
+ * \param options The configuration of the load test
+ * \param samples The number of samples of a request
+ * \param request The functor issuing one request, called with the index of the client
+ */
+template <typename Functor>
+void run_clients(const std::string& name, const load_options& options, size_t samples, Functor&& request) {
+    std::vector<std::vector<double>> latencies(options.clients);
+    std::atomic<bool> go(false);
+
+    const auto duration = std::chrono::duration_cast<clock_type::duration>(std::chrono::duration<double>(options.seconds));
+
+    // Each client issues its requests at the same fraction of the total rate
+    const auto interval = options.qps > 0.0
+        ? std::chrono::duration_cast<clock_type::duration>(std::chrono::duration<double>(options.clients / options.qps))
+        : clock_type::duration::zero();
+
+    clock_type::time_point start;
+
+    auto client = [&](size_t c) {
+        while (!go) {
+            std::this_thread::yield();
+        }
+
+        // The clients are staggered over the first interval
+        auto next = start + interval * c / options.clients;
+
+        while (next < start + duration) {
+            if (interval.count()) {
+                std::this_thread::sleep_until(next);
+            } else {
+                next = clock_type::now();
+            }
+
+            request(c);
+
+            latencies[c].push_back(std::chrono::duration<double>(clock_type::now() - next).count());
+
+            next += interval;
+        }
+    };
+
+    std::vector<std::thread> threads;
+
+    for (size_t c = 0; c < options.clients; ++c) {
+        threads.emplace_back(client, c);
+    }
+
+    start = clock_type::now();
+    go    = true;
+
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    load_result result;
+    result.name     = name;
+    result.duration = std::chrono::duration<double>(clock_type::now() - start).count();
+
+    for (auto& client_latencies : latencies) {
+        result.latencies.insert(result.latencies.end(), client_latencies.begin(), client_latencies.end());
+    }
+
+    std::sort(result.latencies.begin(), result.latencies.end());
+
+    result.samples = result.latencies.size() * samples;
+
+    std::cout << "[load] " << name
+              << ": " << result.latencies.size() / result.duration << " req/s"
+              << ", " << result.samples / result.duration << " samples/s"
+              << ", p50 " << 1e3 * percentile(result.latencies, 0.50) << "ms"
+              << ", p90 " << 1e3 * percentile(result.latencies, 0.90) << "ms"
+              << ", p99 " << 1e3 * percentile(result.latencies, 0.99) << "ms"
+              << ", p99.9 " << 1e3 * percentile(result.latencies, 0.999) << "ms"
+              << ", max " << 1e3 * (result.latencies.empty() ? 0.0 : result.latencies.back()) << "ms" << std::endl;
+
+    results.push_back(std::move(result));
+}
+
+/*!
+ * \brief Load test the direct path and the batcher on the given network
+ */
+template <typename Network>
+void load_test(const std::string& name, Network& net, const load_options& options) {
+    if (!options.weights.empty()) {
+        net.load(options.weights + "/" + name + ".dat");
+    }
+
+    net.display();
+
+    auto sample = make_sample(net);
+
+    // Direct path: one session per client, forwarding batches of options.batch samples
+
+    {
+        using batcher_t = dll::dbn_inference_batcher<Network>;
+
+        typename batcher_t::batch_t batch;
+
+        if constexpr (batcher_t::input_dimensions == 1) {
+            batch = typename batcher_t::batch_t(options.batch, etl::dim<0>(sample));
+        } else {
+            batch = typename batcher_t::batch_t(options.batch, etl::dim<0>(sample), etl::dim<1>(sample), etl::dim<2>(sample));
+        }
+
+        for (size_t b = 0; b < options.batch; ++b) {
+            batch(b) = sample;
+        }
+
+        std::vector<std::unique_ptr<dll::dbn_inference_session<Network>>> sessions;
+
+        for (size_t c = 0; c < options.clients; ++c) {
+            sessions.push_back(std::make_unique<dll::dbn_inference_session<Network>>(net));
+        }
+
+        run_clients(name + "/direct", options, options.batch, [&](size_t c) {
+            auto output = sessions[c]->planned_forward_batch(batch);
+            cpp_unused(output);
+        });
+    }
+
+    // Micro-batching front-end: single samples gathered by the workers
+
+    {
+        dll::dbn_inference_batcher<Network> batcher(net, std::chrono::microseconds(options.delay), Network::batch_size, options.workers);
+
+        run_clients(name + "/batcher", options, 1, [&](size_t /*c*/) {
+            batcher.forward(sample).get();
+        });
+    }
+}
+
+/*!
+ * \brief The MLP of examples/src/mnist_mlp.cpp
+ */
+void mlp(const load_options& options) {
+    using network_t = dll::dyn_network_desc<
+        dll::network_layers<
+            dll::dense_layer<28 * 28, 500>,
+            dll::dropout_layer<50>,
+            dll::dense_layer<500, 250>,
+            dll::dropout_layer<50>,
+            dll::dense_layer<250, 10, dll::softmax>
+        >
+        , dll::batch_size<100>
+    >::network_t;
+
+    auto net = std::make_unique<network_t>();
+
+    load_test("mlp", *net, options);
+}
+
+/*!
+ * \brief The CNN of examples/src/mnist_cnn.cpp
+ */
+void cnn(const load_options& options) {
+    using network_t = dll::dyn_network_desc<
+        dll::network_layers<
+            dll::conv_layer<1, 28, 28, 8, 5, 5>,
+            dll::mp_2d_layer<8, 24, 24, 2, 2>,
+            dll::conv_layer<8, 12, 12, 8, 5, 5>,
+            dll::mp_2d_layer<8, 8, 8, 2, 2>,
+            dll::dense_layer<8 * 4 * 4, 150>,
+            dll::dense_layer<150, 10, dll::softmax>
+        >
+        , dll::batch_size<100>
+    >::network_t;
+
+    auto net = std::make_unique<network_t>();
+
+    load_test("cnn", *net, options);
+}
+
+/*!
+ * \brief The first network of workbench/src/conv_sgd_perf.cpp
+ */
+void conv(const load_options& options) {
+    using dbn_t = dll::dbn_desc<
+        dll::dbn_layers<
+            dll::conv_layer_desc<1, 28, 28, 6, 5, 5>::layer_t,
+            dll::conv_layer_desc<6, 24, 24, 6, 5, 5>::layer_t,
+            dll::dense_layer_desc<6 * 20 * 20, 500>::layer_t,
+            dll::dense_layer_desc<500, 10, dll::activation<dll::function::SOFTMAX>>::layer_t>,
+        dll::batch_size<100>>::dbn_t;
+
+    auto net = std::make_unique<dbn_t>();
+
+    load_test("conv", *net, options);
+}
+
+/*!
+ * \brief Write the results as JSON in the given stream
+ */
+void dump_json(std::ostream& os, const load_options& options) {
+    os << std::setprecision(9);
+
+    os << "{\n";
+    os << "  \"suite\": \"inference_perf\",\n";
+    os << "  \"clients\": " << options.clients << ",\n";
+    os << "  \"qps\": " << options.qps << ",\n";
+    os << "  \"runs\": [";
+
+    for (size_t r = 0; r < results.size(); ++r) {
+        auto& result = results[r];
+
+        os << (r ? ",\n" : "\n");
+        os << "    {\"name\": \"" << result.name << "\""
+           << ", \"requests\": " << result.latencies.size()
+           << ", \"throughput\": " << result.samples / result.duration
+           << ", \"p50\": " << percentile(result.latencies, 0.50)
+           << ", \"p90\": " << percentile(result.latencies, 0.90)
+           << ", \"p99\": " << percentile(result.latencies, 0.99)
+           << ", \"p999\": " << percentile(result.latencies, 0.999)
+           << ", \"max\": " << (result.latencies.empty() ? 0.0 : result.latencies.back()) << "}";
+    }
+
+    os << "\n  ]\n";
+    os << "}\n";
+}
+
+} // end of anonymous namespace
+
+int main(int argc, char* argv[]) {
+    load_options options;
+    std::vector<std::string> models;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg(argv[i]);
+
+        if (arg.find("--clients=") == 0) {
+            options.clients = std::max<size_t>(1, std::stoul(arg.substr(10)));
+        } else if (arg.find("--qps=") == 0) {
+            options.qps = std::stod(arg.substr(6));
+        } else if (arg.find("--seconds=") == 0) {
+            options.seconds = std::stod(arg.substr(10));
+        } else if (arg.find("--batch=") == 0) {
+            options.batch = std::max<size_t>(1, std::stoul(arg.substr(8)));
+        } else if (arg.find("--workers=") == 0) {
+            options.workers = std::max<size_t>(1, std::stoul(arg.substr(10)));
+        } else if (arg.find("--delay=") == 0) {
+            options.delay = std::stoul(arg.substr(8));
+        } else if (arg.find("--weights=") == 0) {
+            options.weights = arg.substr(10);
+        } else if (arg.find("--json=") == 0) {
+            options.json_file = arg.substr(7);
+        } else {
+            models.push_back(arg);
+        }
+    }
+
+    auto selected = [&](const std::string& model) {
+        return models.empty() || std::find(models.begin(), models.end(), model) != models.end();
+    };
+
+    if (selected("mlp")) {
+        mlp(options);
+    }
+
+    if (selected("cnn")) {
+        cnn(options);
+    }
+
+    if (selected("conv")) {
+        conv(options);
+    }
+
+    if (!options.json_file.empty()) {
+        std::ofstream os(options.json_file);
+
+        dump_json(os, options);
+
+        if (!os) {
+            std::cerr << "ERROR: Impossible to write load test results to " << options.json_file << std::endl;
+            return 1;
+        }
+
+        std::cout << "Load test results written to " << options.json_file << std::endl;
+    }
+
+    return 0;
+}
@@ -0,0 +1,229 @@
+//=======================================================================
+// Copyright (c) 2014-2017 Baptiste Wicht
+// Distributed under the terms of the MIT License.
+// (See accompanying file LICENSE or copy at
+//  http://opensource.org/licenses/MIT)
+//=======================================================================
+
+/*
+ * Microbenchmarks of the layers in isolation.
+ *
+ * Each layer family is instantiated over a few shapes and batch sizes, in
+ * its static and its dynamic version. The forward pass (train_forward_batch),
+ * the backward pass (backward_batch) and the gradients (compute_gradients)
+ * are timed separately, on the SGD context of the layer.
+ *
+ * The families to run can be selected on the command line (dense, conv,
+ * conv_same, deconv, mp, avgp, upsample, rnn, lstm, gru, embedding, bn, lcn,
+ * dropout), together with the options of the benchmark suite.
+ */
+
+#include <string>
+#include <type_traits>
+
+#include "dll/neural/conv_layer.hpp"
+#include "dll/neural/conv_same_layer.hpp"
+#include "dll/neural/deconv_layer.hpp"
+#include "dll/neural/dense_layer.hpp"
+#include "dll/neural/dropout_layer.hpp"
+#include "dll/neural/embedding_layer.hpp"
+#include "dll/neural/gru_layer.hpp"
+#include "dll/neural/lstm_layer.hpp"
+#include "dll/neural/rnn_layer.hpp"
+#include "dll/neural/batch_normalization_layer.hpp"
+#include "dll/pooling/mp_layer.hpp"
+#include "dll/pooling/avgp_layer.hpp"
+#include "dll/pooling/global_avgp_layer.hpp"
+#include "dll/pooling/upsample_layer.hpp"
+#include "dll/transform/lcn_layer.hpp"
+#include "dll/dbn.hpp"
+#include "dll/util/benchmark.hpp"
+
+namespace {
+
+/*!
+ * \brief Indicates if the layer can backpropagate its errors (the
+ * embeddings and the LCN cannot)
+ */
+template <typename Layer, typename Context, typename Enable = void>
+struct has_backward_batch : std::false_type {};
+
+/*!
+ * \copydoc has_backward_batch
+ */
+template <typename Layer, typename Context>
+struct has_backward_batch<Layer, Context, std::void_t<decltype(std::declval<const Layer&>().backward_batch(std::declval<Context&>().input, std::declval<Context&>()))>>
+        : std::true_type {};
+
+/*!
+ * \brief Fill the inputs with uniform values
+ */
+struct uniform_inputs {
+    template <typename Input>
+    void operator()(Input& input) const {
+        input = etl::uniform_generator(-1.0, 1.0);
+    }
+};
+
+/*!
+ * \brief Fill the inputs with indices in the vocabulary
+ */
+template <size_t V>
+struct index_inputs {
+    template <typename Input>
+    void operator()(Input& input) const {
+        for (size_t i = 0; i < etl::size(input); ++i) {
+            input[i] = i % V;
+        }
+    }
+};
+
+/*!
+ * \brief Benchmark the last layer of the given network, on its SGD context
+ */
+template <typename Net, typename Init>
+void bench_last_layer(dll::benchmark_suite& bench, const std::string& name, Init init) {
+    constexpr size_t L = Net::layers - 1;
+
+    auto net = std::make_unique<Net>();
+
+    auto context = dll::build_context<dll::full_sgd_context>(*net);
+    dll::sgd_trainer<Net>::inherit_dimensions(context);
+
+    auto& layer = std::get<L>(context).first;
+    auto& ctx   = *std::get<L>(context).second;
+
+    using layer_t   = std::decay_t<decltype(layer)>;
+    using context_t = std::decay_t<decltype(ctx)>;
+
+    init(ctx.input);
+    ctx.errors = etl::uniform_generator(-1.0, 1.0);
+
+    // The errors of the previous layer
+    auto back = ctx.input;
+
+    bench.run(name + ":forward", [&] {
+        layer.train_forward_batch(ctx.output, ctx.input);
+    });
+
+    if constexpr (has_backward_batch<layer_t, context_t>::value) {
+        bench.run(name + ":backward", [&] {
+            layer.backward_batch(back, ctx);
+        });
+    }
+
+    if constexpr (dll::decay_layer_traits<layer_t>::is_neural_layer()) {
+        bench.run(name + ":gradients", [&] {
+            layer.compute_gradients(ctx);
+        });
+    }
+}
+
+/*!
+ * \brief Benchmark the last of the given layers, in a static and in a
+ * dynamic network, for the given batch size
+ */
+template <size_t B, typename... Layers>
+struct layer_bench {
+    using static_net = typename dll::network_desc<dll::network_layers<Layers...>, dll::batch_size<B>>::network_t;
+    using dyn_net    = typename dll::dyn_network_desc<dll::network_layers<Layers...>, dll::batch_size<B>>::network_t;
+
+    template <typename Init = uniform_inputs>
+    static void run(dll::benchmark_suite& bench, const std::string& name, Init init = Init()) {
+        const auto prefix = name + "/b" + std::to_string(B);
+
+        bench_last_layer<static_net>(bench, prefix + "/static", init);
+        bench_last_layer<dyn_net>(bench, prefix + "/dyn", init);
+    }
+};
+
+/*!
+ * \brief Benchmark all the selected layer families for the given batch size
+ */
+template <size_t B>
+void bench_batch(dll::benchmark_suite& bench) {
+    if (bench.selected("dense")) {
+        layer_bench<B, dll::dense_layer_desc<784, 500>::layer_t>::run(bench, "dense/784-500");
+        layer_bench<B, dll::dense_layer_desc<1024, 1024>::layer_t>::run(bench, "dense/1024-1024");
+    }
+
+    if (bench.selected("conv")) {
+        layer_bench<B, dll::conv_layer_desc<1, 28, 28, 16, 5, 5>::layer_t>::run(bench, "conv/1x28x28-16x5x5");
+        layer_bench<B, dll::conv_layer_desc<16, 32, 32, 32, 3, 3>::layer_t>::run(bench, "conv/16x32x32-32x3x3");
+    }
+
+    if (bench.selected("conv_same")) {
+        layer_bench<B, dll::conv_same_desc<16, 32, 32, 32, 3, 3>::layer_t>::run(bench, "conv_same/16x32x32-32x3x3");
+    }
+
+    if (bench.selected("deconv")) {
+        layer_bench<B, dll::deconv_layer_desc<16, 12, 12, 8, 5, 5>::layer_t>::run(bench, "deconv/16x12x12-8x5x5");
+    }
+
+    if (bench.selected("mp")) {
+        layer_bench<B, dll::mp_2d_layer_desc<16, 32, 32, 2, 2>::layer_t>::run(bench, "mp_2d/16x32x32-2x2");
+        layer_bench<B, dll::mp_3d_layer_desc<16, 32, 32, 2, 2, 2>::layer_t>::run(bench, "mp_3d/16x32x32-2x2x2");
+        layer_bench<B, dll::mp_2d_layer_desc<16, 32, 32, 3, 3, dll::stride<2>, dll::padding<1>>::layer_t>::run(bench, "mp_2d/16x32x32-3x3s2p1");
+    }
+
+    if (bench.selected("avgp")) {
+        layer_bench<B, dll::avgp_2d_layer_desc<16, 32, 32, 2, 2>::layer_t>::run(bench, "avgp_2d/16x32x32-2x2");
+        layer_bench<B, dll::avgp_3d_layer_desc<16, 32, 32, 2, 2, 2>::layer_t>::run(bench, "avgp_3d/16x32x32-2x2x2");
+        layer_bench<B, dll::avgp_2d_layer_desc<16, 32, 32, 3, 3, dll::stride<2>, dll::padding<1>>::layer_t>::run(bench, "avgp_2d/16x32x32-3x3s2p1");
+        layer_bench<B, dll::global_avgp_layer_desc<16, 32, 32>::layer_t>::run(bench, "global_avgp/16x32x32");
+    }
+
+    if (bench.selected("upsample")) {
+        layer_bench<B, dll::upsample_3d_layer_desc<16, 16, 16, 1, 2, 2>::layer_t>::run(bench, "upsample_3d/16x16x16-1x2x2");
+        layer_bench<B, dll::upsample_3d_layer_desc<16, 16, 16, 1, 2, 2, dll::upsample<dll::upsample_type::BILINEAR>>::layer_t>::run(bench, "upsample_3d/16x16x16-1x2x2-bilinear");
+    }
+
+    if (bench.selected("rnn")) {
+        layer_bench<B, dll::rnn_layer_desc<10, 100, 100>::layer_t>::run(bench, "rnn/10x100-100");
+    }
+
+    if (bench.selected("lstm")) {
+        layer_bench<B, dll::lstm_layer_desc<10, 100, 100>::layer_t>::run(bench, "lstm/10x100-100");
+    }
+
+    if (bench.selected("gru")) {
+        layer_bench<B, dll::gru_layer_desc<10, 100, 100>::layer_t>::run(bench, "gru/10x100-100");
+    }
+
+    if (bench.selected("embedding")) {
+        layer_bench<B, dll::embedding_layer_desc<1000, 20, 50>::layer_t>::run(bench, "embedding/1000-20x50", index_inputs<1000>());
+    }
+
+    if (bench.selected("bn")) {
+        layer_bench<B, dll::batch_normalization_2d_layer_desc<500>::layer_t>::run(bench, "bn_2d/500");
+        layer_bench<B, dll::batch_normalization_4d_layer_desc<16, 32, 32>::layer_t>::run(bench, "bn_4d/16x32x32");
+    }
+
+    // The transform layers take the dimensions of the previous layer
+
+    if (bench.selected("lcn")) {
+        layer_bench<B,
+                    dll::conv_same_desc<3, 32, 32, 3, 3, 3>::layer_t,
+                    dll::lcn_layer_desc<9>::layer_t>::run(bench, "lcn/3x32x32-9");
+    }
+
+    if (bench.selected("dropout")) {
+        layer_bench<B,
+                    dll::dense_layer_desc<500, 500>::layer_t,
+                    dll::dropout_layer_desc<50>::layer_t>::run(bench, "dropout/500");
+    }
+}
+
+} // end of anonymous namespace
+
+int main(int argc, char* argv []) {
+    dll::benchmark_suite bench("layer_perf", argc, argv, 3, 20);
+
+    // The layers are timed directly, not through the SGD trainer
+    bench.phases.clear();
+
+    bench_batch<32>(bench);
+    bench_batch<128>(bench);
+
+    return bench.finish();
+}
@@ -9,6 +9,7 @@
 #include <chrono>
 
 #include "dll/rbm/conv_rbm.hpp"
+#include "dll/neural/deconv_layer.hpp"
 
 #include "mnist/mnist_reader.hpp"
 #include "mnist/mnist_utils.hpp"
@@ -58,6 +59,43 @@ int main(int argc, char* argv []) {
         MEASURE(crbm_1, "batch", dataset.training_images);
     }
 
+    if(sub.empty() || sub == "deconv"){
+        using layer_t = dll::deconv_layer_desc<16, 12, 12, 8, 5, 5, dll::activation<dll::function::RELU>>::layer_t;
+
+        auto layer = std::make_unique<layer_t>();
+
+        struct {
+            etl::fast_matrix<float, 64, 8, 16, 16> errors;
+        } context;
+
+        etl::fast_matrix<float, 64, 16, 12, 12> input;
+        etl::fast_matrix<float, 64, 8, 16, 16> output;
+        etl::fast_matrix<float, 64, 16, 12, 12> back;
+
+        input          = etl::uniform_generator(-1.0, 1.0);
+        context.errors = etl::uniform_generator(-1.0, 1.0);
+
+        size_t f_min = std::numeric_limits<size_t>::max();
+        size_t b_min = std::numeric_limits<size_t>::max();
+
+        for (size_t i = 0; i < EPOCHS; ++i) {
+            time_point start = clock::now();
+            for (size_t j = 0; j < 10; ++j) {
+                layer->forward_batch(output, input);
+            }
+            time_point middle = clock::now();
+            for (size_t j = 0; j < 10; ++j) {
+                layer->backward_batch(back, context);
+            }
+            time_point end = clock::now();
+
+            f_min = std::min(f_min, size_t(std::chrono::duration_cast<resolution>(middle - start).count()));
+            b_min = std::min(b_min, size_t(std::chrono::duration_cast<resolution>(end - middle).count()));
+        }
+
+        std::cout << "deconv: forward:" << f_min << "ms backward:" << b_min << "ms" << std::endl;
+    }
+
     if(!sub.empty()){
         dll::dump_timers();
     }
@@ -0,0 +1,59 @@
+//=======================================================================
+// Copyright (c) 2014-2017 Baptiste Wicht
+// Distributed under the terms of the MIT License.
+// (See accompanying file LICENSE or copy at
+//  http://opensource.org/licenses/MIT)
+//=======================================================================
+
+/*
+ * Benchmarks of the pretraining of the RBM and of the CRBM.
+ *
+ * The benchmarks to run can be selected on the command line (rbm, crbm),
+ * together with the options of the benchmark suite.
+ */
+
+#include "dll/rbm/rbm.hpp"
+#include "dll/rbm/conv_rbm.hpp"
+#include "dll/util/benchmark.hpp"
+
+#include "mnist/mnist_reader.hpp"
+#include "mnist/mnist_utils.hpp"
+
+int main(int argc, char* argv []) {
+    dll::benchmark_suite bench("pretrain_perf", argc, argv, 0, 3);
+
+    // The pretraining is measured by the contrastive divergence
+    bench.phases = {
+        {"gradients", {"cd:batch_compute_gradients:std", "cd:batch_compute_gradients_conv"}},
+        {"update", {"cd:update:normal", "cd:update:conv"}}};
+
+    if (bench.selected("rbm")) {
+        auto dataset = mnist::read_dataset_direct<std::vector, etl::dyn_vector<float>>(2048);
+
+        mnist::binarize_dataset(dataset);
+
+        using rbm_t = dll::rbm_desc<28 * 28, 500, dll::batch_size<64>, dll::momentum>::layer_t;
+
+        auto rbm = std::make_unique<rbm_t>();
+
+        bench.run("rbm_784_500", [&] {
+            rbm->train(dataset.training_images, 5);
+        });
+    }
+
+    if (bench.selected("crbm")) {
+        auto dataset = mnist::read_dataset_direct<std::vector, etl::fast_dyn_matrix<float, 1, 28, 28>>(1024);
+
+        mnist::binarize_dataset(dataset);
+
+        using crbm_t = dll::conv_rbm_square_desc<1, 28, 20, 17, dll::batch_size<64>, dll::momentum>::layer_t;
+
+        auto crbm = std::make_unique<crbm_t>();
+
+        bench.run("crbm_1x28x28_20x12x12", [&] {
+            crbm->train(dataset.training_images, 5);
+        });
+    }
+
+    return bench.finish();
+}
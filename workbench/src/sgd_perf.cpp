@@ -12,15 +12,15 @@
 #include "dll/neural/dense_layer.hpp"
 #include "dll/test.hpp"
 #include "dll/dbn.hpp"
+#include "dll/util/benchmark.hpp"
 
 #include "mnist/mnist_reader.hpp"
 #include "mnist/mnist_utils.hpp"
 
-int main(int /*argc*/, char* /*argv*/ []) {
+int main(int argc, char* argv []) {
     // First experiment : Dense - Dense - Dense
-    // Current speed on frigg:
-    //   ~20 seconds (mkl, default options)
-    //   ~13 seconds (mkl-threads, default options)
+
+    dll::benchmark_suite bench("sgd_perf", argc, argv, 0, 3);
 
     auto dataset = mnist::read_dataset_direct<std::vector, etl::dyn_vector<float>>();
     dataset.training_images.resize(10000);
@@ -40,15 +40,18 @@ int main(int /*argc*/, char* /*argv*/ []) {
 
     auto net = std::make_unique<dbn_t>();
 
-    // Train the network for performance sake
     net->display();
-    net->fine_tune(dataset.training_images, dataset.training_labels, 20);
 
-    std::cout << "DLL Timers" << std::endl;
-    dll::dump_timers();
+    // Clean slate
+    etl::reset_counters();
+
+    // Train the network for performance sake
+    bench.run("dense_dense_dense", [&] {
+        net->fine_tune(dataset.training_images, dataset.training_labels, 20);
+    });
 
     std::cout << "ETL Counters" << std::endl;
     etl::dump_counters();
 
-    return 0;
+    return bench.finish();
 }
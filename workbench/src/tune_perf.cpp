@@ -0,0 +1,52 @@
+//=======================================================================
+// Copyright (c) 2014-2017 Baptiste Wicht
+// Distributed under the terms of the MIT License.
+// (See accompanying file LICENSE or copy at
+//  http://opensource.org/licenses/MIT)
+//=======================================================================
+
+#include <string>
+
+#include "dll/neural/dense_layer.hpp"
+#include "dll/dbn.hpp"
+#include "dll/util/tuning.hpp"
+
+#include "mnist/mnist_reader.hpp"
+#include "mnist/mnist_utils.hpp"
+
+template <size_t B>
+using dbn_t = typename dll::dbn_desc<
+    dll::dbn_layers<
+        dll::dense_layer_desc<28 * 28, 500>::layer_t,
+        dll::dense_layer_desc<500, 250>::layer_t,
+        dll::dense_layer_desc<250, 10, dll::activation<dll::function::SOFTMAX>>::layer_t>,
+    dll::updater<dll::updater_type::MOMENTUM>, dll::batch_size<B>, dll::trainer<dll::sgd_trainer>>::dbn_t;
+
+int main(int argc, char* argv []) {
+    dll::tuning_options options;
+
+    // --memory=<MiB> limits the memory of the training
+    for (int i = 1; i < argc; ++i) {
+        std::string arg(argv[i]);
+
+        if (arg.find("--memory=") == 0) {
+            options.memory_limit = std::stoul(arg.substr(9)) * 1024 * 1024;
+        }
+    }
+
+    auto dataset = mnist::read_dataset_direct<std::vector, etl::dyn_vector<float>>();
+    dataset.training_images.resize(10000);
+    dataset.training_labels.resize(10000);
+
+    mnist::binarize_dataset(dataset);
+
+    auto report = dll::tune_throughput<dbn_t, 32, 64, 128, 256>([&dataset](auto batch) {
+        using desc = dll::inmemory_data_generator_desc<dll::batch_size<decltype(batch)::value>, dll::categorical>;
+
+        return dll::make_generator(dataset.training_images, dataset.training_labels, dataset.training_images.size(), 10, desc{});
+    }, options);
+
+    report.dump(std::cout);
+
+    return 0;
+}